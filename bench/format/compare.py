@@ -0,0 +1,156 @@
+#!/usr/bin/env python
+# Copyright 2010-2014 RethinkDB, all rights reserved.
+
+# Compares two results files written by results.py, a baseline and a candidate, and
+# flags the runs whose throughput or latency got significantly worse.
+#
+# Throughput and latency are compared on their per-second samples, after dropping
+# the first --warmup fraction of each run. A change counts as a regression if a
+# Mann-Whitney U test says it's significant at --alpha *and* the medians moved by
+# more than --threshold in the wrong direction; the test catches shifts that are
+# just noise, the threshold catches significant shifts that are too small to care
+# about. The latencies of replicated acks from dbench/replication-faults are
+# compared the same way, on the latency of each write. The other numbers (latency
+# percentiles, CPU, IO, backfill throughput, failover time) are single values per
+# run, so they're only printed alongside for context.
+#
+# Exits with status 1 if there were regressions, so that it can gate a build.
+
+import sys, json, math, argparse
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Compare a bench run against a baseline and report regressions')
+    parser.add_argument('baseline', type=str, help='results.json of the baseline run.')
+    parser.add_argument('candidate', type=str, help='results.json of the run to check.')
+    parser.add_argument('--alpha', type=float, help='Significance level (default: 0.01).', default=0.01)
+    parser.add_argument('--threshold', type=float, help='Smallest relative change of the median to report, in percent (default: 5).', default=5.0)
+    parser.add_argument('--warmup', type=float, help='Fraction of each run\'s samples to drop as warm-up (default: 0.1).', default=0.1)
+    return parser.parse_args()
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    return (values[(n - 1) // 2] + values[n // 2]) / 2.0
+
+def trim_warmup(samples, warmup):
+    return [x for x in samples[int(len(samples) * warmup):] if x is not None]
+
+# Two-sided p-value of the Mann-Whitney U test that xs and ys come from the same
+# distribution, from the normal approximation with a correction for ties. That's
+# fine for the hundreds of samples a run has; with very few it's only rough.
+def mann_whitney_p(xs, ys):
+    n1, n2 = len(xs), len(ys)
+    combined = sorted([(x, 0) for x in xs] + [(y, 1) for y in ys])
+    ranks = [0.0] * len(combined)
+    tie_term = 0.0
+    i = 0
+    while i < len(combined):
+        j = i
+        while j + 1 < len(combined) and combined[j + 1][0] == combined[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2.0 + 1
+        t = j - i + 1
+        tie_term += t ** 3 - t
+        i = j + 1
+    r1 = sum(rank for rank, (value, group) in zip(ranks, combined) if group == 0)
+    u = r1 - n1 * (n1 + 1) / 2.0
+    n = n1 + n2
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0:
+        return 1.0
+    z = (abs(u - n1 * n2 / 2.0) - 0.5) / math.sqrt(variance)
+    return min(1.0, math.erfc(max(z, 0) / math.sqrt(2)))
+
+class Comparison(object):
+    def __init__(self, run, metric, baseline, candidate, higher_is_better, args):
+        self.run = run
+        self.metric = metric
+        self.baseline = median(baseline)
+        self.candidate = median(candidate)
+        self.change = 100.0 * (self.candidate - self.baseline) / self.baseline if self.baseline else 0.0
+        self.p = mann_whitney_p(baseline, candidate)
+        worse = self.change < 0 if higher_is_better else self.change > 0
+        significant = self.p < args.alpha and abs(self.change) > args.threshold
+        self.regression = significant and worse
+        self.improvement = significant and not worse
+
+    def __str__(self):
+        flag = 'REGRESSION' if self.regression else 'improvement' if self.improvement else ''
+        return '  %-10s %14.1f %14.1f %+8.1f%%  p=%-8.2g %s' % (self.metric, self.baseline, self.candidate, self.change, self.p, flag)
+
+def format_change(baseline, candidate):
+    if baseline is None or candidate is None:
+        return 'n/a'
+    if baseline == 0:
+        return '%.1f -> %.1f' % (baseline, candidate)
+    return '%.1f -> %.1f (%+.1f%%)' % (baseline, candidate, 100.0 * (candidate - baseline) / baseline)
+
+def lookup(results, path):
+    for key in path:
+        if not isinstance(results, dict):
+            return None
+        results = results.get(key)
+    return results if isinstance(results, (int, long, float)) else None
+
+def replication_context(baseline, candidate):
+    context = []
+    for label, path in [('backfill docs/s', ['backfill', 'documents_per_sec']),
+                        ('replication lag p50', ['acks', 'lag', 'p50']),
+                        ('replication lag p99', ['acks', 'lag', 'p99']),
+                        ('failover s', ['failover', 'seconds'])]:
+        context.append('%s %s' % (label, format_change(lookup(baseline, path), lookup(candidate, path))))
+    return context
+
+def compare_run(name, baseline, candidate, args):
+    comparisons = []
+    for metric, key, higher_is_better in [('qps', 'qps', True), ('latency', 'latency', False)]:
+        xs = trim_warmup(baseline[key]['samples'], args.warmup)
+        ys = trim_warmup(candidate[key]['samples'], args.warmup)
+        if len(xs) < 2 or len(ys) < 2:
+            continue
+        comparisons.append(Comparison(name, metric, xs, ys, higher_is_better, args))
+    if 'replication' in baseline and 'replication' in candidate:
+        xs = baseline['replication'].get('acks', {}).get('replicated', {}).get('samples', [])
+        ys = candidate['replication'].get('acks', {}).get('replicated', {}).get('samples', [])
+        if len(xs) >= 2 and len(ys) >= 2:
+            comparisons.append(Comparison(name, 'acks', xs, ys, False, args))
+
+    print name
+    for comparison in comparisons:
+        print comparison
+    context = []
+    for p in ['p50', 'p99', 'p99.9']:
+        context.append('%s latency %s' % (p, format_change(baseline['latency'].get(p), candidate['latency'].get(p))))
+    for stat in ['user', 'system', 'iowait']:
+        context.append('cpu %s %s' % (stat, format_change(baseline['cpu'].get(stat), candidate['cpu'].get(stat))))
+    print '    ' + ', '.join(context)
+    if 'replication' in baseline and 'replication' in candidate:
+        print '    ' + ', '.join(replication_context(baseline['replication'], candidate['replication']))
+    return comparisons
+
+def main():
+    args = parse_args()
+    baseline = json.load(open(args.baseline))
+    candidate = json.load(open(args.candidate))
+    print 'Baseline:  %s (%s)' % (baseline['commit'], baseline['date'])
+    print 'Candidate: %s (%s)' % (candidate['commit'], candidate['date'])
+    print '  %-10s %14s %14s %9s' % ('', 'baseline', 'candidate', 'change')
+
+    comparisons = []
+    for name in sorted(set(baseline['runs']) & set(candidate['runs'])):
+        comparisons += compare_run(name, baseline['runs'][name], candidate['runs'][name], args)
+    for name in sorted(set(baseline['runs']) ^ set(candidate['runs'])):
+        print '%s: only in the %s' % (name, 'baseline' if name in baseline['runs'] else 'candidate')
+
+    regressions = [c for c in comparisons if c.regression]
+    print
+    if regressions:
+        print '%d regressions:' % len(regressions)
+        for c in regressions:
+            print '  %s %s %+.1f%% (p=%.2g)' % (c.run, c.metric, c.change, c.p)
+        sys.exit(1)
+    print 'No regressions.'
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+# Copyright 2010-2014 RethinkDB, all rights reserved.
+
+# Boils the output of a full_bench run down to one JSON file of numbers, so that
+# runs can be compared across commits with compare.py. For every run (and every
+# run of a multirun, as "multirun/run") it records:
+#
+#   qps      the client's per-second throughput, and its mean and standard deviation
+#   latency  percentiles over all of the client's latency samples, in microseconds,
+#            and the mean latency of each second
+#   latency_percentiles
+#            the per-operation percentiles from the stress client's -H file
+#   cpu      vmstat's mean user, system, idle and iowait percentages
+#   io       iostat's mean transfers and blocks read and written per second, by device
+#   server   the mean of each numeric rdbstat counter
+#   replication
+#            for the runs of dbench/replication-faults, what it measured: backfill
+#            throughput, hard-durability ack latencies and replication lag, and
+#            failover time
+#   scaling  for the runs of dbench/reql-scaling, the nodes, cores and CPU shards
+#            the run had
+#
+# The file is written to BENCH_DIR/results.json and, with --store, also copied to
+# STORE/<date>-<commit>.json, which is where compare.py's baselines come from.
+
+import os, sys, json, math, time, shutil, argparse
+from plot import IOStat, VMStat, QPS, RDBStats
+
+LATENCY_PERCENTILES = [50, 90, 95, 99, 99.9]
+
+BENCH_OUTPUT_DIR = 'bench_output'
+MULTIRUN_FLAG = 'multirun'
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Summarize the results of a full_bench run as JSON')
+    parser.add_argument('bench_dir', type=str, help='Directory full_bench ran in, the one containing %s.' % BENCH_OUTPUT_DIR)
+    parser.add_argument('--commit', type=str, help='Commit the server was built from.', default='unknown')
+    parser.add_argument('--store', type=str, help='Directory to keep a copy of the results in, for later comparisons.')
+    return parser.parse_args()
+
+def mean(values):
+    return sum(values) / float(len(values)) if values else None
+
+def stdev(values):
+    if len(values) < 2:
+        return None
+    m = mean(values)
+    return (sum((x - m) ** 2 for x in values) / float(len(values) - 1)) ** 0.5
+
+# Nearest-rank percentile of a sorted list.
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return None
+    rank = int(math.ceil(p / 100.0 * len(sorted_values))) - 1
+    return sorted_values[max(0, min(rank, len(sorted_values) - 1))]
+
+def read_lines(file_name):
+    try:
+        return open(file_name).readlines()
+    except IOError:
+        return []
+
+def qps_results(run_dir):
+    samples = QPS().read(os.path.join(run_dir, 'client/qps.txt')).data['qps']
+    return {'samples': samples, 'mean': mean(samples), 'stdev': stdev(samples)}
+
+# latency.txt has a "<second> <latency in us>" line per sampled operation. The plot
+# module's parser throws the seconds away, and we want them for the per-second means.
+def latency_results(run_dir):
+    by_second = {}
+    for line in read_lines(os.path.join(run_dir, 'client/latency.txt')):
+        fields = line.split()
+        if len(fields) != 2:
+            continue
+        by_second.setdefault(int(fields[0]), []).append(float(fields[1]))
+    all_samples = sorted(x for samples in by_second.itervalues() for x in samples)
+    res = {'count': len(all_samples),
+           'mean': mean(all_samples),
+           'max': all_samples[-1] if all_samples else None,
+           'samples': [mean(by_second[second]) for second in sorted(by_second)]}
+    for p in LATENCY_PERCENTILES:
+        res['p%g' % p] = percentile(all_samples, p)
+    return res
+
+# latency_percentiles.txt is a table with a header line "op count p50 p90 ...", then a line
+# per kind of operation and a last one for all of them together.
+def latency_percentiles_results(run_dir):
+    lines = read_lines(os.path.join(run_dir, 'client/latency_percentiles.txt'))
+    if not lines:
+        return {}
+    header = lines[0].split()
+    res = {}
+    for line in lines[1:]:
+        fields = line.split()
+        if len(fields) != len(header):
+            continue
+        res[fields[0]] = dict((name, float(value)) for name, value in zip(header[1:], fields[1:]))
+    return res
+
+def cpu_results(run_dir):
+    data = VMStat().read(os.path.join(run_dir, 'vmstat/output.txt')).data
+    return dict((name, mean(data[key])) for name, key in
+                [('user', 'us'), ('system', 'sy'), ('idle', 'id'), ('iowait', 'wa')] if key in data)
+
+def io_results(run_dir):
+    data = IOStat().read(os.path.join(run_dir, 'iostat/output.txt')).data
+    res = {}
+    for key, values in data.iteritems():
+        if not key.startswith('dev:'):
+            continue
+        device, stat = key[len('dev:'):].split('_', 1)
+        name = {'tps': 'tps', ' Blk_read/s': 'blocks_read_per_sec', ' Blk_wrtn/s': 'blocks_written_per_sec'}.get(stat)
+        if name:
+            res.setdefault(device, {})[name] = mean(values)
+    return res
+
+def server_results(run_dir):
+    data = RDBStats().read(os.path.join(run_dir, 'rdbstat/output.txt')).data
+    res = {}
+    for key, values in data.iteritems():
+        values = [x for x in values if isinstance(x, (int, long, float))]
+        if values:
+            res[key] = mean(values)
+    return res
+
+# The JSON files that the harnesses other than dbench write into their runs.
+HARNESS_RESULTS = ['replication', 'scaling']
+
+def harness_results(run_dir, name):
+    try:
+        return json.load(open(os.path.join(run_dir, name + '.json')))
+    except IOError:
+        return None
+
+def run_results(run_dir):
+    res = {'qps': qps_results(run_dir),
+           'latency': latency_results(run_dir),
+           'latency_percentiles': latency_percentiles_results(run_dir),
+           'cpu': cpu_results(run_dir),
+           'io': io_results(run_dir),
+           'server': server_results(run_dir)}
+    for name in HARNESS_RESULTS:
+        harness = harness_results(run_dir, name)
+        if harness is not None:
+            res[name] = harness
+    return res
+
+def subdirs(dir):
+    try:
+        return sorted(name for name in os.listdir(dir) if os.path.isdir(os.path.join(dir, name)))
+    except OSError:
+        return []
+
+def collect(bench_dir, commit):
+    output_dir = os.path.join(bench_dir, BENCH_OUTPUT_DIR)
+    runs = {}
+    for run in subdirs(output_dir):
+        run_dir = os.path.join(output_dir, run)
+        if os.path.isfile(os.path.join(run_dir, MULTIRUN_FLAG)):
+            for sub_run in subdirs(run_dir):
+                runs[run + '/' + sub_run] = run_results(os.path.join(run_dir, sub_run, '1'))
+        else:
+            runs[run] = run_results(os.path.join(run_dir, '1'))
+    return {'commit': commit,
+            'date': time.strftime('%Y-%m-%d %H:%M:%S'),
+            'bench_dir': os.path.abspath(bench_dir),
+            'runs': runs}
+
+def main():
+    args = parse_args()
+    results = collect(args.bench_dir, args.commit)
+    if not results['runs']:
+        print >> sys.stderr, 'No bench runs found in %s' % os.path.join(args.bench_dir, BENCH_OUTPUT_DIR)
+        sys.exit(1)
+    out_file = os.path.join(args.bench_dir, 'results.json')
+    with open(out_file, 'w') as f:
+        json.dump(results, f, indent=1, sort_keys=True)
+    print 'Wrote results of %d runs to %s' % (len(results['runs']), out_file)
+    if args.store:
+        if not os.path.isdir(args.store):
+            os.makedirs(args.store)
+        stored_file = os.path.join(args.store, '%s-%s.json' % (time.strftime('%Y-%m-%d-%H:%M'), args.commit[:12]))
+        shutil.copy(out_file, stored_file)
+        print 'Stored them as %s' % stored_file
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python
+# Copyright 2010-2014 RethinkDB, all rights reserved.
+
+# Draws the scalability curves of the runs of dbench/reql-scaling, from the
+# results.json that results.py wrote. Every multirun of such runs is one curve,
+# over whichever of nodes, cores and CPU shards its runs differ in. For each
+# point it prints and plots the mean throughput, the throughput per core, and,
+# when cores or nodes are what changes, the efficiency: the throughput per core
+# relative to that of the first point. Where the efficiency first drops below
+# --knee is where the curve stops scaling; that's marked.
+#
+# The curves go to BENCH_DIR/scaling/<multirun>.png, and the tables to
+# BENCH_DIR/scaling/scaling.txt.
+
+import os, sys, json, argparse
+import matplotlib as mpl
+mpl.use('Agg') # can't use tk since we don't have X11
+import matplotlib.pyplot as plt
+
+DIMENSIONS = ['nodes', 'cores', 'cpu_shards']
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Plot the scalability curves of reql-scaling runs')
+    parser.add_argument('bench_dir', type=str, help='Directory full_bench ran in, the one containing results.json.')
+    parser.add_argument('--knee', type=float, help='Efficiency below which a curve stops scaling (default: 0.8).', default=0.8)
+    return parser.parse_args()
+
+# Returns {multirun: (dimension, [point, ...])}, each point a dict of the run's
+# scaling.json with its mean throughput.
+def collect_curves(results):
+    by_multirun = {}
+    for name, run in results['runs'].iteritems():
+        if 'scaling' not in run or run['qps']['mean'] is None or '/' not in name:
+            continue
+        point = dict(run['scaling'])
+        point['qps'] = run['qps']['mean']
+        by_multirun.setdefault(name.split('/')[0], []).append(point)
+
+    curves = {}
+    for multirun, points in by_multirun.iteritems():
+        varying = [d for d in DIMENSIONS if len(set(p[d] for p in points)) > 1]
+        if len(points) < 2 or not varying:
+            continue
+        # Nodes times cores per node is cores, so when nodes change, cores change too.
+        dimension = varying[0]
+        curves[multirun] = (dimension, sorted(points, key=lambda p: p[dimension]))
+    return curves
+
+def analyze(dimension, points, knee):
+    base_per_core = points[0]['qps'] / points[0]['cores']
+    knee_point = None
+    for point in points:
+        point['qps_per_core'] = point['qps'] / point['cores']
+        if dimension == 'cpu_shards':
+            point['efficiency'] = None
+        else:
+            point['efficiency'] = point['qps_per_core'] / base_per_core
+            if knee_point is None and point['efficiency'] < knee:
+                knee_point = point
+    return knee_point
+
+def format_table(multirun, dimension, points, knee_point, knee):
+    lines = [multirun,
+             '  %10s %8s %14s %14s %11s' % (dimension, 'cores' if dimension != 'cores' else '', 'qps', 'qps/core', 'efficiency')]
+    for point in points:
+        efficiency = '%10.0f%%' % (100 * point['efficiency']) if point['efficiency'] is not None else '%11s' % '-'
+        cores = '%8d' % point['cores'] if dimension != 'cores' else '%8s' % ''
+        lines.append('  %10d %s %14.0f %14.0f %s' % (point[dimension], cores, point['qps'], point['qps_per_core'], efficiency))
+    if knee_point is not None:
+        lines.append('  Stops scaling at %s %d: efficiency below %.0f%%' % (dimension, knee_point[dimension], 100 * knee))
+    elif dimension == 'cpu_shards':
+        best = max(points, key=lambda p: p['qps'])
+        lines.append('  Best throughput with %d CPU shards' % best['cpu_shards'])
+    return lines
+
+def plot(out_file, multirun, dimension, points, knee_point):
+    xs = [p[dimension] for p in points]
+    fig = plt.figure(figsize=(12, 4.5))
+    qps_ax = fig.add_subplot(1, 2, 1)
+    qps_ax.plot(xs, [p['qps'] for p in points], 'o-', label='measured')
+    if dimension != 'cpu_shards':
+        # Perfect scaling: the first point's throughput per core, times the cores.
+        base_per_core = points[0]['qps'] / points[0]['cores']
+        qps_ax.plot(xs, [base_per_core * p['cores'] for p in points], '--', color='gray', label='linear')
+    if knee_point is not None:
+        qps_ax.axvline(knee_point[dimension], color='red', linestyle=':', label='stops scaling')
+    qps_ax.set_xlabel(dimension.replace('_', ' '))
+    qps_ax.set_ylabel('queries per second')
+    qps_ax.legend(loc='upper left')
+    per_core_ax = fig.add_subplot(1, 2, 2)
+    per_core_ax.plot(xs, [p['qps_per_core'] for p in points], 'o-')
+    per_core_ax.set_xlabel(dimension.replace('_', ' '))
+    per_core_ax.set_ylabel('queries per second per core')
+    per_core_ax.set_ylim(bottom=0)
+    fig.suptitle(multirun.replace('_', ' '))
+    plt.savefig(out_file, bbox_inches='tight')
+    plt.close(fig)
+
+def main():
+    args = parse_args()
+    results = json.load(open(os.path.join(args.bench_dir, 'results.json')))
+    curves = collect_curves(results)
+    if not curves:
+        print >> sys.stderr, 'No scaling runs found in %s' % os.path.join(args.bench_dir, 'results.json')
+        sys.exit(1)
+
+    out_dir = os.path.join(args.bench_dir, 'scaling')
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+    lines = []
+    for multirun in sorted(curves):
+        dimension, points = curves[multirun]
+        knee_point = analyze(dimension, points, args.knee)
+        lines += format_table(multirun, dimension, points, knee_point, args.knee) + ['']
+        plot(os.path.join(out_dir, multirun + '.png'), multirun, dimension, points, knee_point)
+    with open(os.path.join(out_dir, 'scaling.txt'), 'w') as f:
+        print >> f, '\n'.join(lines)
+    print '\n'.join(lines)
+
+if __name__ == '__main__':
+    main()
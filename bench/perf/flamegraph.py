@@ -0,0 +1,154 @@
+# Copyright 2010-2014 RethinkDB, all rights reserved.
+
+# Turns stack samples into flame graphs. Stacks are "folded": one line per
+# distinct stack, its frames from the root to the leaf separated by semicolons,
+# then a space and the stack's weight (samples for on-CPU profiles, microseconds
+# for off-CPU ones). That's the format of Brendan Gregg's FlameGraph tools and of
+# bcc's offcputime -f, so the files we write work with those tools too.
+
+import re, cgi
+
+# The entry point of every coroutine. A coroutine's stack ends there (see
+# artificial_stack_t()); anything an unwinder reports below it is garbage.
+COROUTINE_ENTRY = 'coro_t::run'
+
+# Frame lines of `perf script`: "\t  7f0a1b2c3d4e symbol+0x12 (/path/to/dso)".
+frame_re = re.compile(r'^\s+[0-9a-f]+\s+(.*?)(\+0x[0-9a-f]+)?\s+\((.*)\)$')
+
+def frame_name(symbol, dso):
+    if symbol == '[unknown]':
+        return '[%s]' % dso.split('/')[-1]
+    # Drop the argument lists of C++ symbols; they make the graphs unreadable.
+    if '(' in symbol:
+        symbol = symbol[:symbol.index('(')]
+    return symbol
+
+def annotate_stack(comm, frames):
+    # Roots a coroutine's stack at a "[coroutine]" frame under its thread's name,
+    # so that everything the coroutines did adds up in one place.
+    for i, frame in enumerate(frames):
+        if frame == COROUTINE_ENTRY:
+            return [comm, '[coroutine]'] + frames[i:]
+    return [comm] + frames
+
+# Folds the output of `perf script` (an iterable of lines), counting one per sample.
+def fold_perf_script(lines):
+    folded = {}
+    comm = None
+    frames = []
+
+    def finish_sample():
+        if comm is not None:
+            frames.reverse()
+            stack = ';'.join(annotate_stack(comm, frames))
+            folded[stack] = folded.get(stack, 0) + 1
+
+    for line in lines:
+        line = line.rstrip('\n')
+        if not line.strip():
+            finish_sample()
+            comm = None
+            frames = []
+        elif line[0] not in ' \t':
+            # The header of a sample: "comm pid [cpu] time: period event:". Comms
+            # can have spaces in them, so take everything before the pid.
+            fields = line.split()
+            pid_index = next((i for i, f in enumerate(fields) if f.split('/')[0].isdigit()), 1)
+            comm = '-'.join(fields[:pid_index]) or '[unknown]'
+        else:
+            m = frame_re.match(line)
+            if m:
+                frames.append(frame_name(m.group(1), m.group(3)))
+    finish_sample()
+    return folded
+
+# Reads a folded file, as written by write_folded() or by offcputime -f, putting
+# coroutine stacks under a "[coroutine]" frame as fold_perf_script() does.
+def read_folded(file_name):
+    folded = {}
+    for line in open(file_name):
+        line = line.strip()
+        if not line or ' ' not in line:
+            continue
+        stack, weight = line.rsplit(' ', 1)
+        frames = stack.split(';')
+        stack = ';'.join(annotate_stack(frames[0], frames[1:]))
+        try:
+            folded[stack] = folded.get(stack, 0) + int(weight)
+        except ValueError:
+            continue
+    return folded
+
+def write_folded(folded, file_name):
+    with open(file_name, 'w') as f:
+        for stack in sorted(folded):
+            print >> f, '%s %d' % (stack, folded[stack])
+
+class Node(object):
+    def __init__(self, name):
+        self.name = name
+        self.weight = 0
+        self.children = {}
+
+def build_tree(folded):
+    root = Node('all')
+    for stack, weight in folded.iteritems():
+        root.weight += weight
+        node = root
+        for frame in stack.split(';'):
+            node = node.children.setdefault(frame, Node(frame))
+            node.weight += weight
+    return root
+
+def frame_color(name):
+    # Stable colors, so the same function looks the same in every graph.
+    h = 0
+    for c in name:
+        h = (h * 31 + ord(c)) & 0xffffffff
+    if name.startswith('['):
+        return 'rgb(180,180,180)'
+    return 'rgb(%d,%d,%d)' % (205 + h % 50, 80 + (h >> 8) % 120, (h >> 16) % 55)
+
+WIDTH = 1200
+FRAME_HEIGHT = 16
+FONT_SIZE = 12
+MIN_WIDTH = 0.1 # Frames narrower than this many pixels are left out.
+
+def write_svg(folded, file_name, title, unit='samples'):
+    root = build_tree(folded)
+    if root.weight == 0:
+        return False
+
+    def depth(node):
+        return 1 + max([depth(c) for c in node.children.itervalues()] or [0])
+    height = (depth(root) + 2) * FRAME_HEIGHT
+    scale = float(WIDTH - 20) / root.weight
+
+    rects = []
+    def draw(node, x, level):
+        w = node.weight * scale
+        if w < MIN_WIDTH:
+            return
+        y = height - (level + 1) * FRAME_HEIGHT
+        label = '%s (%d %s, %.2f%%)' % (node.name, node.weight, unit, 100.0 * node.weight / root.weight)
+        chars = int(w / (FONT_SIZE * 0.6))
+        text = node.name if len(node.name) <= chars else node.name[:max(chars - 2, 0)] + '..' if chars > 3 else ''
+        rects.append('<g><title>%s</title><rect x="%.1f" y="%d" width="%.1f" height="%d" fill="%s" rx="2"/>'
+                     '<text x="%.1f" y="%d">%s</text></g>'
+                     % (cgi.escape(label), x, y, w, FRAME_HEIGHT - 1, frame_color(node.name),
+                        x + 3, y + FONT_SIZE, cgi.escape(text)))
+        for child in sorted(node.children.itervalues(), key=lambda c: c.name):
+            draw(child, x, level + 1)
+            x += child.weight * scale
+    draw(root, 10, 0)
+
+    with open(file_name, 'w') as f:
+        print >> f, '<?xml version="1.0" standalone="no"?>'
+        print >> f, '<svg version="1.1" width="%d" height="%d" xmlns="http://www.w3.org/2000/svg">' % (WIDTH, height + FRAME_HEIGHT)
+        print >> f, '<style>text { font-family: Verdana, sans-serif; font-size: %dpx; pointer-events: none; }</style>' % FONT_SIZE
+        print >> f, '<rect width="100%" height="100%" fill="rgb(250,250,238)"/>'
+        print >> f, '<text x="%d" y="%d" text-anchor="middle" style="font-size: %dpx">%s</text>' % (WIDTH / 2, FRAME_HEIGHT + 4, FONT_SIZE + 4, cgi.escape(title))
+        for rect in rects:
+            print >> f, rect
+        print >> f, '</svg>'
+    return True
@@ -161,9 +161,11 @@ public:
         : clients(64), duration(10000000L, duration_t::queries_t), op_ratios(op_ratios_t()),
             keys(distr_t(8, 16)), values(distr_t(8, 128)),
             batch_factor(distr_t(1, 16)), range_size(distr_t(16, 128)),
-            distr(rnd_uniform_t), mu(1), pipeline_limit(0), ignore_protocol_errors(0)
+            distr(rnd_uniform_t), mu(1), theta(0.99), pipeline_limit(0), ignore_protocol_errors(0),
+            rate(0), arrival_distr(arrival_poisson_t)
         {
             latency_file[0] = 0;
+            histogram_file[0] = 0;
             worst_latency_file[0] = 0;
             qps_file[0] = 0;
             out_file[0] = 0;
@@ -199,9 +201,19 @@ public:
             printf("normal\n");
             printf("MU................%d\n", mu);
         }
+        if(distr == rnd_zipf_t || distr == rnd_latest_t) {
+            printf("%s\n", distr == rnd_zipf_t ? "zipf" : "latest");
+            printf("Theta.............%g\n", theta);
+        }
         // Adding one because users are 1-based, unlike our code for
         // pipelines, which is 0-based
         printf("Pipeline-limit....%d\n", pipeline_limit + 1);
+        if (rate > 0) {
+            printf("Rate..............%g/s, %s arrivals\n", rate,
+                   arrival_distr == arrival_constant_t ? "constant" : "poisson");
+        } else {
+            printf("Rate..............closed-loop\n");
+        }
         printf("\n");
     }
 
@@ -217,7 +229,9 @@ public:
     distr_t range_size;
     rnd_distr_t distr;
     int mu;
+    double theta;
     char latency_file[MAX_FILE];
+    char histogram_file[MAX_FILE];
     char worst_latency_file[MAX_FILE];
     char qps_file[MAX_FILE];
     char out_file[MAX_FILE];
@@ -225,6 +239,8 @@ public:
     char db_file[MAX_FILE];
     int pipeline_limit;
     int ignore_protocol_errors;
+    double rate;
+    arrival_distr_t arrival_distr;
 };
 
 /* List supported protocols. */
@@ -238,7 +254,8 @@ void list_protocols() {
 #ifdef USE_LIBMEMCACHED
     printf("libmemcached,");
 #endif
-    printf("sqlite");
+    printf("sqlite,");
+    printf("reql");
 }
 
 /* Usage */
@@ -295,6 +312,9 @@ void usage(const char *name) {
     printf("].\n");
     printf("\t-l, --latency-file\n\t\tFile name to output individual latency information (in us).\n" \
            "\t\tThe information is not outputted if this argument is skipped.\n");
+    printf("\t-H, --histogram-file\n\t\tFile name to output latency percentiles for each kind of operation\n" \
+           "\t\t(in us) at the end of the run. '-' for stdout.\n" \
+           "\t\tThe information is not outputted if this argument is skipped.\n");
     printf("\t-L, --worst-latency-file\n\t\tFile name to output worst latency each second.\n" \
            "\t\tThe information is not outputted if this argument is skipped.\n");
     printf("\t-q, --qps-file\n\t\tFile name to output QPS information. '-' for stdout.\n" \
@@ -303,9 +323,19 @@ void usage(const char *name) {
     printf("\t-i, --in-file\n\t\tIf present, populate initial keys from this file\n"\
            "\t\tand don't drop the database (for relevant protocols).\n");
     printf("\t-f, --db-file\n\t\tIf present drop kv pairs into sqlite and verify correctness on read.\n");
-    printf("\t-r, --distr\n\t\tA key access distrubution. Possible values: 'uniform' (default), and 'normal'.\n");
+    printf("\t-r, --distr\n\t\tA key access distrubution. Possible values: 'uniform' (default), 'normal',\n" \
+           "\t\t'zipf' (the oldest keys are the hottest) and 'latest' (the newest keys are\n" \
+           "\t\tthe hottest).\n");
     printf("\t-m, --mu\n\t\tControl normal distribution. Percent of the database size within one standard\n\t\tdistribution (defaults to 1%%).\n");
+    printf("\t-z, --theta\n\t\tControl the zipf and latest distributions. The higher, the more skewed\n" \
+           "\t\t(defaults to %g, as in YCSB).\n", _d.theta);
     printf("\t-p, --pipeline\n\t\tMaximum number of operations that may be queued to server (defaults to 1).\n");
+    printf("\t-T, --rate\n\t\tRun open-loop: schedule this many operations per second, split evenly\n" \
+           "\t\tbetween the clients, and measure latency from when each operation was\n" \
+           "\t\tscheduled. Defaults to closed-loop, which sends each operation when the\n" \
+           "\t\tlast one finishes and hides the time operations spend waiting to be sent.\n");
+    printf("\t-A, --arrival\n\t\tHow open-loop operations are spaced out. Possible values: 'poisson'\n" \
+           "\t\t(default) and 'constant'.\n");
 
     printf("\nAdditional information:\n");
     printf("\t\tDISTR format describes a range and can be specified in as NUM or MIN-MAX.\n\n");
@@ -317,6 +347,8 @@ void usage(const char *name) {
     printf("].\n\n");
 
     printf("\t\tFor memcached and rethinkdb protocols the host argument should be in the form host:port.\n");
+    printf("\t\tFor the reql protocol the host argument should be in the form\n" \
+           "\t\thost:port[/db/table][?index=NAME&insert_batch=N&auth=KEY].\n");
 #ifdef USE_MYSQL
     printf("\t\tFor mysql protocol the host argument should be in the following\n" \
            "\t\tformat: username/password@host:port+database.\n\n");
@@ -346,6 +378,7 @@ void parse(config_t *config, int argc, char *argv[]) {
                 {"batch-factor",       required_argument, 0, 'b'},
                 {"range-size",         required_argument, 0, 'R'},
                 {"latency-file",       required_argument, 0, 'l'},
+                {"histogram-file",     required_argument, 0, 'H'},
                 {"worst-latency-file", required_argument, 0, 'L'},
                 {"qps-file",           required_argument, 0, 'q'},
                 {"out-file",           required_argument, 0, 'o'},
@@ -353,7 +386,10 @@ void parse(config_t *config, int argc, char *argv[]) {
                 {"db-file",            required_argument, 0, 'f'},
                 {"distr",              required_argument, 0, 'r'},
                 {"mu",                 required_argument, 0, 'm'},
+                {"theta",              required_argument, 0, 'z'},
                 {"pipeline",           required_argument, 0, 'p'},
+                {"rate",               required_argument, 0, 'T'},
+                {"arrival",            required_argument, 0, 'A'},
                 {"client-suffix",      no_argument, 0, 'a'},
                 {"ignore-protocol-errors", no_argument, &config->ignore_protocol_errors, 1},
                 {"help",               no_argument, &do_help, 1},
@@ -361,7 +397,7 @@ void parse(config_t *config, int argc, char *argv[]) {
             };
 
         int option_index = 0;
-        int c = getopt_long(argc, argv, "s:n:p:r:c:w:k:K:v:d:b:R:l:L:q:o:i:h:f:m:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "s:n:p:r:c:w:k:K:v:d:b:R:l:H:L:q:o:i:h:f:m:z:T:A:", long_options, &option_index);
 
         if(do_help)
             c = 'h';
@@ -411,6 +447,9 @@ void parse(config_t *config, int argc, char *argv[]) {
         case 'l':
             strncpy(config->latency_file, optarg, MAX_FILE);
             break;
+        case 'H':
+            strncpy(config->histogram_file, optarg, MAX_FILE);
+            break;
         case 'L':
             strncpy(config->worst_latency_file, optarg, MAX_FILE);
             break;
@@ -435,11 +474,22 @@ void parse(config_t *config, int argc, char *argv[]) {
                 config->distr = rnd_uniform_t;
             } else if(strcmp(optarg, "normal") == 0) {
                 config->distr = rnd_normal_t;
+            } else if(strcmp(optarg, "zipf") == 0) {
+                config->distr = rnd_zipf_t;
+            } else if(strcmp(optarg, "latest") == 0) {
+                config->distr = rnd_latest_t;
             }
             break;
         case 'm':
             config->mu = atoi(optarg);
             break;
+        case 'z':
+            config->theta = atof(optarg);
+            if (config->theta <= 0) {
+                fprintf(stderr, "Theta must be positive.\n");
+                usage(argv[0]);
+            }
+            break;
         case 'p':
             config->pipeline_limit = atoi(optarg);
             if(config->pipeline_limit < 1) {
@@ -449,6 +499,23 @@ void parse(config_t *config, int argc, char *argv[]) {
             // the code is structured in a way where zero means no pipelining, so we subtract one
             config->pipeline_limit--;
             break;
+        case 'T':
+            config->rate = atof(optarg);
+            if (config->rate <= 0) {
+                fprintf(stderr, "Rate must be positive.\n");
+                usage(argv[0]);
+            }
+            break;
+        case 'A':
+            if (strcmp(optarg, "poisson") == 0) {
+                config->arrival_distr = arrival_poisson_t;
+            } else if (strcmp(optarg, "constant") == 0) {
+                config->arrival_distr = arrival_constant_t;
+            } else {
+                fprintf(stderr, "Unknown arrival distribution \"%s\".\n", optarg);
+                usage(argv[0]);
+            }
+            break;
         case 'h':
             usage(argv[0]);
             break;
@@ -465,13 +532,18 @@ void parse(config_t *config, int argc, char *argv[]) {
 
     //validation:
     bool only_sockmemcached = true;
+    bool only_reql = true;
     for (size_t i = 0; i < config->servers.size(); i++) {
         if(config->servers[i].protocol != protocol_sockmemcached) {
             only_sockmemcached = false;
-            break;
+        }
+        if(config->servers[i].protocol != protocol_reql) {
+            only_reql = false;
         }
     }
-    if (config->pipeline_limit > 0) {
+    if (config->pipeline_limit > 0 && !only_reql) {
+        // The reql protocol matches responses to queries by token, so other
+        // operations can run while reads are pipelined.
         if (config->op_ratios.deletes > 0 ||
             config->op_ratios.updates > 0 ||
             config->op_ratios.inserts > 0 ||
@@ -481,7 +553,7 @@ void parse(config_t *config, int argc, char *argv[]) {
             config->op_ratios.verifies > 0 ||
             !only_sockmemcached)
         {
-            fprintf(stderr, "Pipelining can only be used with read operations on a sockmemcached protocol.\n");
+            fprintf(stderr, "Pipelining can only be used with read operations on a sockmemcached protocol, or with a reql protocol.\n");
             usage(argv[0]);
         }
     }
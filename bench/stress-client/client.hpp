@@ -2,6 +2,7 @@
 #ifndef __STRESS_CLIENT_CLIENT_HPP__
 #define __STRESS_CLIENT_CLIENT_HPP__
 
+#include <math.h>
 #include <pthread.h>
 #include <stdint.h>
 #include "op.hpp"
@@ -10,20 +11,28 @@
 
 using namespace std;
 
-/* Structure that represents a running client */
+/* Structure that represents a running client. By default it's closed-loop: it sends each
+operation as soon as the previous one has finished (or, with pipelining, as soon as there's room
+in the pipeline). Given a rate, it's open-loop instead: it schedules operations at that rate and
+reports each one's latency from its scheduled time, so a server that falls behind is charged for
+the operations that were kept waiting rather than just for the ones in flight. */
 struct client_t {
 
-    client_t(int _pipeline_limit = 0, int _ignore_protocol_errors = 0) :
+    client_t(int _pipeline_limit = 0, int _ignore_protocol_errors = 0,
+             double _rate = 0, arrival_distr_t _arrival_distr = arrival_poisson_t) :
         total_freq(0),
         pipeline_limit(_pipeline_limit),
         ignore_protocol_errors(_ignore_protocol_errors),
+        rate(_rate),
+        arrival_distr(_arrival_distr),
         keep_running(false),
         print_further_protocol_errors(true)
         { }
 
-    void add_op(int freq, op_generator_t *op_gen) {
+    void add_op(int freq, op_generator_t *op_gen, const char *name = "") {
         ops.push_back(op_gen);
         freqs.push_back(freq);
+        names.push_back(name);
         total_freq += freq;
     }
 
@@ -60,11 +69,16 @@ struct client_t {
     // The ops that we are running against the database
     std::vector<op_generator_t *> ops;
     std::vector<int> freqs;   // One entry in freqs for each entry in ops
+    std::vector<const char *> names;   // And one in names
     int total_freq;
 
     int pipeline_limit;
     int ignore_protocol_errors;
 
+    // Operations per second to schedule, or 0 to run closed-loop
+    double rate;
+    arrival_distr_t arrival_distr;
+
 private:
     // This spinlock protects keep_running from race conditions
     spinlock_t spinlock;
@@ -80,13 +94,38 @@ private:
         return NULL;
     }
 
+    /* The time from one scheduled operation to the next */
+    ticks_t next_interval() {
+        double mean = 1000000000.0 / rate;
+        if (arrival_distr == arrival_constant_t) {
+            return mean;
+        }
+        // Exponentially distributed gaps make the arrivals a Poisson process
+        double u = xrandom(1, 1 << 30) / static_cast<double>(1 << 30);
+        return -log(u) * mean;
+    }
+
     void run() {
 
         spinlock.lock();
         std::queue<op_t *> outstanding_ops;
+        ticks_t scheduled_time = get_ticks();
         while(keep_running) {
             spinlock.unlock();
 
+            ticks_t schedule_lag = 0;
+            if (rate > 0) {
+                ticks_t now = get_ticks();
+                if (now < scheduled_time) {
+                    sleep_ticks(scheduled_time - now);
+                    now = get_ticks();
+                }
+                if (now > scheduled_time) {
+                    schedule_lag = now - scheduled_time;
+                }
+                scheduled_time += next_interval();
+            }
+
             /* Select which operation to perform */
             int op_counter = xrandom(0, total_freq - 1);
             op_t *op_to_do = NULL;
@@ -104,6 +143,8 @@ private:
                 exit(-1);
             }
 
+            op_to_do->schedule_lag = schedule_lag;
+
             try {
                 op_to_do->start();
                 outstanding_ops.push(op_to_do);
@@ -52,6 +52,7 @@ int main(int argc, char *argv[])
     /* Open output files */
     FILE *qps_fd = get_out_file(config.qps_file, "QPS");
     FILE *latencies_fd = get_out_file(config.latency_file, "latencies");
+    FILE *histogram_fd = get_out_file(config.histogram_file, "latency percentiles");
     FILE *worst_latencies_fd = get_out_file(config.worst_latency_file, "worst latencies");
 
     /* make a directory for our sqlite files */
@@ -132,7 +133,7 @@ int main(int argc, char *argv[])
             delete_chooser(&model),
             delete_op_generator(config->pipeline_limit + 1, &kg, &delete_chooser, &sqlite_mirror, protocol),
 
-            live_chooser(&model, config->distr, config->mu),
+            live_chooser(&model, config->distr, config->mu, config->theta),
             read_op_generator(config->pipeline_limit + 1, &kg, &live_chooser, protocol, config->batch_factor),
             update_op_generator(config->pipeline_limit + 1, &kg, &live_chooser, &sqlite_mirror, protocol, config->values),
             append_op_generator(config->pipeline_limit + 1, &kg, &live_chooser, &sqlite_mirror, protocol, true, config->values),
@@ -143,23 +144,24 @@ int main(int argc, char *argv[])
             range_read_op_generator(config->pipeline_limit + 1, protocol, distr_t(50, 50), config->range_size, config->key_prefix),
 
             /* Construct the client object */
-            client(config->pipeline_limit, config->ignore_protocol_errors)
+            client(config->pipeline_limit, config->ignore_protocol_errors,
+                   config->rate / config->clients, config->arrival_distr)
         {
             int expected_batch_factor = (config->batch_factor.min + config->batch_factor.max) / 2;
 
             /* We multiply the ratio by expected_batch_factor to get nicer rounding for reads (instead of dividing the reads frequency) */
-            client.add_op(config->op_ratios.inserts * expected_batch_factor, &insert_op_generator);
+            client.add_op(config->op_ratios.inserts * expected_batch_factor, &insert_op_generator, "insert");
 
-            client.add_op(config->op_ratios.deletes * expected_batch_factor, &delete_op_generator);
+            client.add_op(config->op_ratios.deletes * expected_batch_factor, &delete_op_generator, "delete");
 
-            client.add_op(config->op_ratios.reads, &read_op_generator);
-            client.add_op(config->op_ratios.updates * expected_batch_factor, &update_op_generator);
-            client.add_op(config->op_ratios.appends * expected_batch_factor, &append_op_generator);
-            client.add_op(config->op_ratios.prepends * expected_batch_factor, &prepend_op_generator);
+            client.add_op(config->op_ratios.reads, &read_op_generator, "read");
+            client.add_op(config->op_ratios.updates * expected_batch_factor, &update_op_generator, "update");
+            client.add_op(config->op_ratios.appends * expected_batch_factor, &append_op_generator, "append");
+            client.add_op(config->op_ratios.prepends * expected_batch_factor, &prepend_op_generator, "prepend");
 
-            client.add_op(config->op_ratios.verifies * expected_batch_factor, &verify_op_generator);
+            client.add_op(config->op_ratios.verifies * expected_batch_factor, &verify_op_generator, "verify");
 
-            client.add_op(config->op_ratios.range_reads * expected_batch_factor, &range_read_op_generator);
+            client.add_op(config->op_ratios.range_reads * expected_batch_factor, &range_read_op_generator, "range_read");
         }
 
         ~client_stuff_t() {
@@ -227,6 +229,10 @@ int main(int argc, char *argv[])
     query_stats_t total_stats;
     int total_time = 0, total_inserts_minus_deletes = 0;
 
+    /* Every client has the same kinds of operations in the same order, so we can keep the
+    histogram of each kind over the whole run by its index. */
+    std::vector<latency_histogram_t> op_histograms(clients[0]->client.ops.size());
+
     // TODO: If an workload contains contains no inserts and there are no keys available for a
     // particular client (and the duration is specified in q/i), it'll just loop forever.
 
@@ -258,6 +264,7 @@ int main(int argc, char *argv[])
             the Python interface. */
             for (int j = 0; j < (int)c->client.ops.size(); j++) {
                 round_stats.aggregate(c->client.ops[j]->query_stats);
+                op_histograms[j] += c->client.ops[j]->query_stats.latency_histogram;
             }
 
             /* Count total number of keys inserted and deleted (we will use this if our
@@ -327,6 +334,7 @@ int main(int argc, char *argv[])
         client_stuff_t *c = clients[i];
         for (int j = 0; j < (int)c->client.ops.size(); j++) {
             total_stats.aggregate(c->client.ops[j]->query_stats);
+            op_histograms[j] += c->client.ops[j]->query_stats.latency_histogram;
         }
         total_inserts_minus_deletes += c->insert_op_generator.query_stats.queries - c->delete_op_generator.query_stats.queries;
     }
@@ -335,6 +343,26 @@ int main(int argc, char *argv[])
     printf("Total operations: %d\n", total_stats.queries);
     printf("Total keys inserted minus keys deleted: %d\n", total_inserts_minus_deletes);
 
+    if (histogram_fd) {
+        static const double percentiles[] = { 50, 90, 99, 99.9, 99.99, 100 };
+        fprintf(histogram_fd, "op\t\tcount");
+        for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+            fprintf(histogram_fd, "\tp%g", percentiles[i]);
+        }
+        fprintf(histogram_fd, "\n");
+        for (size_t j = 0; j <= op_histograms.size(); j++) {
+            const latency_histogram_t &h = j < op_histograms.size() ? op_histograms[j] : total_stats.latency_histogram;
+            if (h.total == 0) continue;
+            fprintf(histogram_fd, "%-12s\t%llu", j < op_histograms.size() ? clients[0]->client.names[j] : "all",
+                static_cast<unsigned long long>(h.total));
+            for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+                fprintf(histogram_fd, "\t%.1f", ticks_to_us(h.percentile(percentiles[i])));
+            }
+            fprintf(histogram_fd, "\n");
+        }
+        fflush(histogram_fd);
+    }
+
     // Dump key vectors if we have an out file
     if(config.out_file[0] != 0) {
         FILE *out_file = fopen(config.out_file, "w");
@@ -358,6 +386,7 @@ int main(int argc, char *argv[])
 
     if (qps_fd && qps_fd != stdout) fclose(qps_fd);
     if (latencies_fd && latencies_fd != stdout) fclose(latencies_fd);
+    if (histogram_fd && histogram_fd != stdout) fclose(histogram_fd);
     if (worst_latencies_fd && worst_latencies_fd != stdout) fclose(worst_latencies_fd);
 
     return 0;
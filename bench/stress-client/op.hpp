@@ -12,6 +12,8 @@ struct query_stats_t {
     bool enable_latency_samples;
     reservoir_sample_t<ticks_t> latency_samples;
 
+    latency_histogram_t latency_histogram;
+
 
     query_stats_t() : queries(0), worst_latency(0), enable_latency_samples(true) { }
 
@@ -20,6 +22,7 @@ struct query_stats_t {
         worst_latency = 0;
 
         latency_samples.clear();
+        latency_histogram.clear();
     }
 
     void push(ticks_t latency, int batch_count) {
@@ -29,6 +32,7 @@ struct query_stats_t {
         if (enable_latency_samples) {
             for (int i = 0; i < batch_count; i++) latency_samples.push(latency);
         }
+        latency_histogram.record(latency, batch_count);
         lock.unlock();
     }
 
@@ -36,6 +40,7 @@ struct query_stats_t {
         queries += other.queries;
         worst_latency = std::max(worst_latency, other.worst_latency);
         latency_samples += other.latency_samples;
+        latency_histogram += other.latency_histogram;
     }
 
     void set_enable_latency_samples(bool val) {
@@ -50,15 +55,20 @@ public:
 
 struct op_t {
 
-    op_t(query_stats_t *_stats) : stats(_stats) { }
+    op_t(query_stats_t *_stats) : stats(_stats), schedule_lag(0) { }
     virtual ~op_t() { }
 
     void push_stats(float latency, int count) {
-        stats->push(latency, count);
+        stats->push(latency + schedule_lag, count);
     }
 
     query_stats_t *stats;
 
+    /* In open-loop mode, the client sets this to how long after its scheduled time the
+    operation was started, so that the latency it reports is measured from when it should
+    have been sent rather than from when the client got around to sending it. */
+    ticks_t schedule_lag;
+
     virtual void start() = 0;
 
     virtual bool end_maybe() = 0;
@@ -103,13 +103,29 @@ public:
     middle of the seed range. */
 
     struct live_chooser_t : public seed_chooser_t {
-        live_chooser_t(consecutive_seed_model_t *p, rnd_distr_t distr, int mu) :
-            parent(p), rnd(xrandom_create(distr, mu)) { }
+        live_chooser_t(consecutive_seed_model_t *p, rnd_distr_t distr, int mu, double theta = 0.99) :
+            parent(p), rnd(xrandom_create(distr, mu, theta)) { }
 
         int choose_seeds(seed_t *seeds, int nseeds) {
 
             nseeds = std::min(nseeds, (int)(parent->max_seed - parent->min_seed));
 
+            /* The Zipfian distributions rank the live seeds by age instead: seeds are
+            inserted in order, so a seed keeps its rank from the oldest (for "zipf") as
+            more are inserted, and the hottest keys stay hot. For "latest", the hottest
+            keys are the newest ones, as in YCSB's workload D. Consecutive seeds map to
+            unrelated keys, so the hot keys are spread over the key space. */
+            if (rnd.rnd_distr == rnd_zipf_t || rnd.rnd_distr == rnd_latest_t) {
+                if (nseeds == 0) return 0;
+                seed_t seed = parent->min_seed + xrandom(rnd, 0, parent->max_seed - parent->min_seed - 1);
+                for (int i = 0; i < nseeds; i++) {
+                    seeds[i] = seed;
+                    seed++;
+                    if (seed == parent->max_seed) seed = parent->min_seed;
+                }
+                return nseeds;
+            }
+
             /* We group the seeds into 16 "classes"; each seed's class is the seed modulo
             16. We use the user-specified random distribution to pick a class and then we
             use a uniform distribution to pick within that class.
@@ -8,6 +8,7 @@
 #ifdef USE_MYSQL
 #  include "protocols/mysql_protocol.hpp"
 #endif
+#include "protocols/reql_protocol.hpp"
 #include "protocols/sqlite_protocol.hpp"
 
 protocol_t *server_t::connect() {
@@ -24,6 +25,8 @@ protocol_t *server_t::connect() {
 #endif
     case protocol_sqlite:
         return new sqlite_protocol_t(host);
+    case protocol_reql:
+        return new reql_protocol_t(host);
     default:
         fprintf(stderr, "Unknown protocol\n");
         exit(-1);
@@ -66,6 +66,7 @@ enum protocol_enum_t {
     protocol_libmemcached,
 #endif
     protocol_sqlite,
+    protocol_reql,
 };
 
 struct server_t {
@@ -86,6 +87,8 @@ struct server_t {
 #endif
         } else if(strcmp(name, "sqlite") == 0) {
             return protocol_sqlite;
+        } else if (strcmp(name, "reql") == 0) {
+            return protocol_reql;
         } else {
             fprintf(stderr, "Unknown protocol\n");
             exit(-1);
@@ -120,6 +123,8 @@ struct server_t {
 #endif
         } else if (protocol == protocol_sqlite) {
             printf("sqlite");
+        } else if (protocol == protocol_reql) {
+            printf("reql");
         } else {
             printf("unknown");
         }
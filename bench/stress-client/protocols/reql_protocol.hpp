@@ -0,0 +1,891 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef __STRESS_CLIENT_PROTOCOLS_REQL_PROTOCOL_HPP__
+#define __STRESS_CLIENT_PROTOCOLS_REQL_PROTOCOL_HPP__
+
+#include <climits>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "protocol.hpp"
+
+/* Talks to RethinkDB's client port in the protocol that the drivers use, as
+described in `src/rdb_protocol/ql2.proto`.  The protobufs are encoded and decoded
+by hand so that the stress client doesn't depend on libprotobuf.
+
+The host string is
+
+    host:port[/db/table][?option=value&...]
+
+with the options `index` (read through this secondary index with `get_all` and
+`between` instead of through the primary key), `insert_batch` (send inserts to
+the server in groups of this many) and `auth` (the authorization key).  The
+database and table default to `test` and `stress`, and must already exist.
+
+Each key is stored as the document `{id: key, key: key, val: value}`, so an
+index created on `key` finds the same documents as the primary key does.
+
+Reads are pipelined: each query has its own token, and responses that arrive
+before they're waited for are kept until they are, so any operation can run while
+reads are outstanding.  Batched inserts are buffered in the client and sent once
+the batch is full, or before any other operation, so they are visible to every
+later operation on the same connection. */
+
+namespace reql {
+
+// From `src/rdb_protocol/ql2.proto`.
+enum {
+    VERSION_V0_2 = 0x723081e1
+};
+
+enum {
+    QUERY_START = 1,
+    QUERY_CONTINUE = 2,
+    QUERY_STOP = 3
+};
+
+enum {
+    RESPONSE_SUCCESS_ATOM = 1,
+    RESPONSE_SUCCESS_SEQUENCE = 2,
+    RESPONSE_SUCCESS_PARTIAL = 3,
+    RESPONSE_CLIENT_ERROR = 16
+};
+
+enum {
+    R_NULL = 1,
+    R_BOOL = 2,
+    R_NUM = 3,
+    R_STR = 4,
+    R_ARRAY = 5,
+    R_OBJECT = 6
+};
+
+enum {
+    TERM_DATUM = 1,
+    TERM_MAKE_ARRAY = 2,
+    TERM_MAKE_OBJ = 3,
+    TERM_VAR = 10,
+    TERM_DB = 14,
+    TERM_TABLE = 15,
+    TERM_GET = 16,
+    TERM_ADD = 24,
+    TERM_GET_FIELD = 31,
+    TERM_BETWEEN = 36,
+    TERM_UPDATE = 53,
+    TERM_DELETE = 54,
+    TERM_INSERT = 56,
+    TERM_FUNC = 69,
+    TERM_LIMIT = 71,
+    TERM_GET_ALL = 78
+};
+
+enum {
+    WIRE_VARINT = 0,
+    WIRE_FIXED64 = 1,
+    WIRE_LENGTH_DELIMITED = 2,
+    WIRE_FIXED32 = 5
+};
+
+inline void append_varint(std::string *out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+inline void append_tag(std::string *out, int field, int wire_type) {
+    append_varint(out, (static_cast<uint64_t>(field) << 3) | wire_type);
+}
+
+inline void append_varint_field(std::string *out, int field, uint64_t value) {
+    append_tag(out, field, WIRE_VARINT);
+    append_varint(out, value);
+}
+
+inline void append_bytes_field(std::string *out, int field, const char *data, size_t size) {
+    append_tag(out, field, WIRE_LENGTH_DELIMITED);
+    append_varint(out, size);
+    out->append(data, size);
+}
+
+inline void append_bytes_field(std::string *out, int field, const std::string &data) {
+    append_bytes_field(out, field, data.data(), data.size());
+}
+
+/* Encoded `Datum`s. */
+
+inline std::string str_datum(const char *data, size_t size) {
+    std::string datum;
+    append_varint_field(&datum, 1, R_STR);
+    append_bytes_field(&datum, 4, data, size);
+    return datum;
+}
+
+inline std::string str_datum(const std::string &str) {
+    return str_datum(str.data(), str.size());
+}
+
+inline std::string num_datum(double num) {
+    std::string datum;
+    append_varint_field(&datum, 1, R_NUM);
+    append_tag(&datum, 3, WIRE_FIXED64);
+    uint64_t bits;
+    memcpy(&bits, &num, sizeof(bits));
+    for (int i = 0; i < 8; i++) {
+        datum.push_back(static_cast<char>(bits >> (8 * i)));
+    }
+    return datum;
+}
+
+inline std::string bool_datum(bool value) {
+    std::string datum;
+    append_varint_field(&datum, 1, R_BOOL);
+    append_varint_field(&datum, 2, value ? 1 : 0);
+    return datum;
+}
+
+inline std::string array_datum(const std::vector<std::string> &elements) {
+    std::string datum;
+    append_varint_field(&datum, 1, R_ARRAY);
+    for (size_t i = 0; i < elements.size(); i++) {
+        append_bytes_field(&datum, 5, elements[i]);
+    }
+    return datum;
+}
+
+inline std::string document_datum(const char *key, size_t key_size,
+                                  const char *value, size_t value_size) {
+    const char *field_names[3] = { "id", "key", "val" };
+    std::string field_values[3] = {
+        str_datum(key, key_size), str_datum(key, key_size), str_datum(value, value_size)
+    };
+    std::string datum;
+    append_varint_field(&datum, 1, R_OBJECT);
+    for (int i = 0; i < 3; i++) {
+        std::string pair;
+        append_bytes_field(&pair, 1, field_names[i], strlen(field_names[i]));
+        append_bytes_field(&pair, 2, field_values[i]);
+        append_bytes_field(&datum, 6, pair);
+    }
+    return datum;
+}
+
+/* Encoded `Term`s.  `optargs` are pairs of names and encoded terms. */
+
+typedef std::vector<std::pair<std::string, std::string> > optargs_t;
+
+inline std::string term(int type, const std::vector<std::string> &args,
+                        const optargs_t &optargs = optargs_t()) {
+    std::string term;
+    append_varint_field(&term, 1, type);
+    for (size_t i = 0; i < args.size(); i++) {
+        append_bytes_field(&term, 3, args[i]);
+    }
+    for (size_t i = 0; i < optargs.size(); i++) {
+        std::string pair;
+        append_bytes_field(&pair, 1, optargs[i].first);
+        append_bytes_field(&pair, 2, optargs[i].second);
+        append_bytes_field(&term, 4, pair);
+    }
+    return term;
+}
+
+inline std::string term(int type, const std::string &arg) {
+    return term(type, std::vector<std::string>(1, arg));
+}
+
+inline std::string term(int type, const std::string &arg1, const std::string &arg2) {
+    std::vector<std::string> args;
+    args.push_back(arg1);
+    args.push_back(arg2);
+    return term(type, args);
+}
+
+inline std::string datum_term(const std::string &datum) {
+    std::string term;
+    append_varint_field(&term, 1, TERM_DATUM);
+    append_bytes_field(&term, 2, datum);
+    return term;
+}
+
+inline std::string str_term(const char *data, size_t size) {
+    return datum_term(str_datum(data, size));
+}
+
+inline std::string str_term(const std::string &str) {
+    return datum_term(str_datum(str));
+}
+
+inline std::string num_term(double num) {
+    return datum_term(num_datum(num));
+}
+
+/* Reads the fields of an encoded message one at a time. */
+class message_reader_t {
+public:
+    message_reader_t(const char *data, size_t size) : pos(data), end(data + size) { }
+
+    /* Returns false at the end of the message.  `value` is set for varint fields,
+    and `data` and `size` for the others. */
+    bool next(int *field, int *wire_type, uint64_t *value, const char **data, size_t *size) {
+        if (pos == end) {
+            return false;
+        }
+        uint64_t tag = read_varint();
+        *field = tag >> 3;
+        *wire_type = tag & 7;
+        *value = 0;
+        *data = NULL;
+        *size = 0;
+        switch (*wire_type) {
+        case WIRE_VARINT:
+            *value = read_varint();
+            break;
+        case WIRE_FIXED64:
+            *size = 8;
+            break;
+        case WIRE_LENGTH_DELIMITED:
+            *size = read_varint();
+            break;
+        case WIRE_FIXED32:
+            *size = 4;
+            break;
+        default:
+            throw protocol_error_t("Malformed protobuf in response");
+        }
+        if (*size > static_cast<size_t>(end - pos)) {
+            throw protocol_error_t("Truncated protobuf in response");
+        }
+        *data = pos;
+        pos += *size;
+        return true;
+    }
+
+private:
+    uint64_t read_varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos == end) {
+                throw protocol_error_t("Truncated varint in response");
+            }
+            const uint8_t byte = *pos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw protocol_error_t("Overlong varint in response");
+    }
+
+    const char *pos;
+    const char *end;
+};
+
+/* The string or number in an encoded `Datum`, or the empty string or 0 if it
+isn't one. */
+
+inline std::string datum_as_str(const std::string &datum) {
+    message_reader_t reader(datum.data(), datum.size());
+    int field, wire_type;
+    uint64_t value;
+    const char *data;
+    size_t size;
+    while (reader.next(&field, &wire_type, &value, &data, &size)) {
+        if (field == 4 && wire_type == WIRE_LENGTH_DELIMITED) {
+            return std::string(data, size);
+        }
+    }
+    return std::string();
+}
+
+inline double datum_as_num(const std::string &datum) {
+    message_reader_t reader(datum.data(), datum.size());
+    int field, wire_type;
+    uint64_t value;
+    const char *data;
+    size_t size;
+    while (reader.next(&field, &wire_type, &value, &data, &size)) {
+        if (field == 3 && wire_type == WIRE_FIXED64) {
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+            }
+            double num;
+            memcpy(&num, &bits, sizeof(num));
+            return num;
+        }
+    }
+    return 0;
+}
+
+/* The fields of an encoded object `Datum`, as encoded `Datum`s. */
+inline std::map<std::string, std::string> datum_as_object(const std::string &datum) {
+    std::map<std::string, std::string> object;
+    message_reader_t reader(datum.data(), datum.size());
+    int field, wire_type;
+    uint64_t value;
+    const char *data;
+    size_t size;
+    while (reader.next(&field, &wire_type, &value, &data, &size)) {
+        if (field != 6 || wire_type != WIRE_LENGTH_DELIMITED) {
+            continue;
+        }
+        message_reader_t pair_reader(data, size);
+        std::string key, val;
+        while (pair_reader.next(&field, &wire_type, &value, &data, &size)) {
+            if (field == 1) {
+                key.assign(data, size);
+            } else if (field == 2) {
+                val.assign(data, size);
+            }
+        }
+        object[key] = val;
+    }
+    return object;
+}
+
+struct response_t {
+    response_t() : type(0) { }
+    int type;
+    // Encoded `Datum`s.
+    std::vector<std::string> data;
+};
+
+}  // namespace reql
+
+struct reql_protocol_t : public protocol_t {
+    reql_protocol_t(const char *conn_str)
+        : db("test"), table("stress"), insert_batch_size(1),
+          sockfd(-1), next_token(1), recv_start(0)
+    {
+        // Parse the host string
+        char _host[MAX_HOST];
+        strncpy(_host, conn_str, MAX_HOST);
+        _host[MAX_HOST - 1] = '\0';
+
+        std::string auth_key;
+        if (char *_options = strchr(_host, '?')) {
+            *_options = '\0';
+            _options++;
+            char *saveptr;
+            for (char *option = strtok_r(_options, "&", &saveptr); option; option = strtok_r(NULL, "&", &saveptr)) {
+                char *value = strchr(option, '=');
+                if (!value) {
+                    fprintf(stderr, "Cannot parse option string: \"%s\".\n", option);
+                    exit(-1);
+                }
+                *value = '\0';
+                value++;
+                if (strcmp(option, "index") == 0) {
+                    index = value;
+                } else if (strcmp(option, "insert_batch") == 0) {
+                    insert_batch_size = atoi(value);
+                    if (insert_batch_size <= 0) {
+                        fprintf(stderr, "Cannot parse insert batch size: \"%s\".\n", value);
+                        exit(-1);
+                    }
+                } else if (strcmp(option, "auth") == 0) {
+                    auth_key = value;
+                } else {
+                    fprintf(stderr, "Unknown option: \"%s\".\n", option);
+                    exit(-1);
+                }
+            }
+        }
+
+        if (char *_db = strchr(_host, '/')) {
+            *_db = '\0';
+            _db++;
+            char *_table = strchr(_db, '/');
+            if (!_table) {
+                fprintf(stderr, "Please use host string of the form host:port/db/table.\n");
+                exit(-1);
+            }
+            *_table = '\0';
+            _table++;
+            db = _db;
+            table = _table;
+        }
+
+        int port;
+        if (char *_port = strchr(_host, ':')) {
+            *_port = '\0';
+            _port++;
+            port = atoi(_port);
+            if (port == 0) {
+                fprintf(stderr, "Cannot parse port string: \"%s\".\n", _port);
+                exit(-1);
+            }
+        } else {
+            fprintf(stderr, "Please use host string of the form host:port.\n");
+            exit(-1);
+        }
+
+        // init the socket
+        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sockfd < 0) {
+            fprintf(stderr, "Could not create socket\n");
+            exit(-1);
+        }
+
+        // Setup the host/port data structures
+        struct sockaddr_in sin;
+        struct hostent *host = gethostbyname(_host);
+        if (!host) {
+            herror("Could not gethostbyname()");
+            exit(-1);
+        }
+        memcpy(&sin.sin_addr.s_addr, host->h_addr, host->h_length);
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(port);
+
+        // Connect to server
+        int res = ::connect(sockfd, (struct sockaddr *)&sin, sizeof(sin));
+        if (res < 0) {
+            int err = errno;
+            fprintf(stderr, "Could not connect to server (%d)\n", err);
+            exit(-1);
+        }
+
+        handshake(auth_key);
+
+        table_term = reql::term(reql::TERM_TABLE,
+                                reql::term(reql::TERM_DB, reql::str_term(db)),
+                                reql::str_term(table));
+    }
+
+    virtual ~reql_protocol_t() {
+        try {
+            flush_inserts();
+            while (!pipeline.empty()) {
+                wait_for(pipeline.front());
+                pipeline.pop_front();
+            }
+        } catch (protocol_error_t &e) {
+            fprintf(stderr, "Protocol error: %s\n", e.c_str());
+        }
+        if (sockfd != -1) {
+            int res = close(sockfd);
+            if (res != 0) {
+                fprintf(stderr, "Could not close socket\n");
+                exit(-1);
+            }
+        }
+    }
+
+    virtual void remove(const char *key, size_t key_size) {
+        flush_inserts();
+        std::vector<std::string> get_args;
+        get_args.push_back(table_term);
+        get_args.push_back(reql::str_term(key, key_size));
+        check_write(run(reql::term(reql::TERM_DELETE,
+                                   reql::term(reql::TERM_GET, get_args))));
+    }
+
+    virtual void update(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        flush_inserts();
+        reql::optargs_t optargs;
+        optargs.push_back(std::make_pair(std::string("upsert"),
+                                         reql::datum_term(reql::bool_datum(true))));
+        std::vector<std::string> args;
+        args.push_back(table_term);
+        args.push_back(reql::datum_term(reql::document_datum(key, key_size, value, value_size)));
+        check_write(run(reql::term(reql::TERM_INSERT, args, optargs)));
+    }
+
+    virtual void insert(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        pending_inserts.push_back(reql::document_datum(key, key_size, value, value_size));
+        if (static_cast<int>(pending_inserts.size()) >= insert_batch_size) {
+            flush_inserts();
+        }
+    }
+
+    virtual void read(payload_t *keys, int count, payload_t *values = NULL) {
+        enqueue_read(keys, count, values);
+        dequeue_read(keys, count, values);
+    }
+
+    /* add a read to the pipeline */
+    virtual void enqueue_read(payload_t *keys, int count, UNUSED payload_t *values = NULL) {
+        flush_inserts();
+        std::vector<std::string> args;
+        args.push_back(table_term);
+        for (int i = 0; i < count; i++) {
+            args.push_back(reql::str_term(keys[i].first, keys[i].second));
+        }
+        std::string query;
+        if (count == 1 && index.empty()) {
+            query = reql::term(reql::TERM_GET, args);
+        } else {
+            query = reql::term(reql::TERM_GET_ALL, args, index_optargs());
+        }
+        pipeline.push_back(send_start(query));
+    }
+
+    virtual bool dequeue_read_maybe(payload_t *keys, int count, payload_t *values = NULL) {
+        receive(false);
+        if (arrived.count(pipeline.front()) == 0) {
+            return false;
+        }
+        dequeue_read(keys, count, values);
+        return true;
+    }
+
+    /* Wait until the oldest pipelined read has been returned */
+    virtual void dequeue_read(payload_t *keys, int count, payload_t *values = NULL) {
+        const int64_t token = pipeline.front();
+        pipeline.pop_front();
+        reql::response_t response = wait_for(token);
+        if (response.type == reql::RESPONSE_SUCCESS_PARTIAL) {
+            finish_sequence(token, &response, INT_MAX);
+        }
+
+        if (values) {
+            std::map<std::string, std::string> found;
+            for (size_t i = 0; i < response.data.size(); i++) {
+                std::map<std::string, std::string> document = reql::datum_as_object(response.data[i]);
+                found[reql::datum_as_str(document["id"])] = reql::datum_as_str(document["val"]);
+            }
+            for (int i = 0; i < count; i++) {
+                const std::string expected(values[i].first, values[i].second);
+                const std::string &got = found[std::string(keys[i].first, keys[i].second)];
+                if (got != expected) {
+                    fprintf(stderr, "Got unexpected value: %s instead of %s\n", got.c_str(), expected.c_str());
+                }
+            }
+        }
+    }
+
+    virtual void range_read(char* lkey, size_t lkey_size, char* rkey, size_t rkey_size, int count_limit, payload_t *values = NULL) {
+        flush_inserts();
+        std::vector<std::string> args;
+        args.push_back(table_term);
+        args.push_back(reql::str_term(lkey, lkey_size));
+        args.push_back(reql::str_term(rkey, rkey_size));
+        reql::optargs_t optargs = index_optargs();
+        optargs.push_back(std::make_pair(std::string("right_bound"), reql::str_term("closed")));
+        const std::string between = reql::term(reql::TERM_BETWEEN, args, optargs);
+        const int64_t token = send_start(reql::term(reql::TERM_LIMIT, between, reql::num_term(count_limit)));
+
+        reql::response_t response = wait_for(token);
+        if (response.type == reql::RESPONSE_SUCCESS_PARTIAL) {
+            finish_sequence(token, &response, count_limit);
+        }
+
+        if (values) {
+            fprintf(stderr, "Value verification not implemented for range reads\n");
+        }
+    }
+
+    virtual void append(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        flush_inserts();
+        concat(key, key_size, value, value_size, true);
+    }
+
+    virtual void prepend(const char *key, size_t key_size,
+                         const char *value, size_t value_size) {
+        flush_inserts();
+        concat(key, key_size, value, value_size, false);
+    }
+
+    /* For `replay`, which sends queries that were encoded elsewhere and carry their
+    own tokens.  Sending and receiving don't share any state, so one thread may
+    send while another receives. */
+    void send_encoded_query(const std::string &query) {
+        send_query(query);
+    }
+
+    /* Waits up to `timeout_ms` for the response to any query.  Returns false if
+    none arrived. */
+    bool receive_any(int64_t *token_out, reql::response_t *response_out, int timeout_ms) {
+        if (arrived.empty()) {
+            receive(false);
+        }
+        if (arrived.empty()) {
+            struct pollfd pfd;
+            pfd.fd = sockfd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, timeout_ms) <= 0) {
+                return false;
+            }
+            receive(true);
+        }
+        std::map<int64_t, reql::response_t>::iterator it = arrived.begin();
+        *token_out = it->first;
+        std::swap(*response_out, it->second);
+        arrived.erase(it);
+        return true;
+    }
+
+private:
+    void handshake(const std::string &auth_key) {
+        std::string handshake;
+        append_le32(&handshake, reql::VERSION_V0_2);
+        append_le32(&handshake, auth_key.size());
+        handshake += auth_key;
+        send_all(handshake);
+
+        std::string reply;
+        for (;;) {
+            char c;
+            const ssize_t res = recv(sockfd, &c, 1, 0);
+            if (res <= 0) {
+                fprintf(stderr, "reql_protocol: handshake: error: server closed the connection\n");
+                exit(-1);
+            }
+            if (c == '\0') {
+                break;
+            }
+            reply.push_back(c);
+        }
+        if (reply != "SUCCESS") {
+            fprintf(stderr, "reql_protocol: handshake: error: %s\n", reply.c_str());
+            exit(-1);
+        }
+    }
+
+    reql::optargs_t index_optargs() const {
+        reql::optargs_t optargs;
+        if (!index.empty()) {
+            optargs.push_back(std::make_pair(std::string("index"), reql::str_term(index)));
+        }
+        return optargs;
+    }
+
+    void flush_inserts() {
+        if (pending_inserts.empty()) {
+            return;
+        }
+        std::string documents;
+        if (pending_inserts.size() == 1) {
+            documents = pending_inserts[0];
+        } else {
+            documents = reql::array_datum(pending_inserts);
+        }
+        pending_inserts.clear();
+        check_write(run(reql::term(reql::TERM_INSERT, table_term, reql::datum_term(documents))));
+    }
+
+    /* Sets `val` to `val + value` or `value + val`. */
+    void concat(const char *key, size_t key_size,
+                const char *value, size_t value_size, bool append) {
+        std::vector<std::string> get_args;
+        get_args.push_back(table_term);
+        get_args.push_back(reql::str_term(key, key_size));
+
+        const std::string old_val = reql::term(reql::TERM_GET_FIELD,
+                                               reql::term(reql::TERM_VAR, reql::num_term(1)),
+                                               reql::str_term("val"));
+        const std::string new_val = append
+            ? reql::term(reql::TERM_ADD, old_val, reql::str_term(value, value_size))
+            : reql::term(reql::TERM_ADD, reql::str_term(value, value_size), old_val);
+        reql::optargs_t fields;
+        fields.push_back(std::make_pair(std::string("val"), new_val));
+        const std::string func = reql::term(reql::TERM_FUNC,
+                                            reql::term(reql::TERM_MAKE_ARRAY, reql::num_term(1)),
+                                            reql::term(reql::TERM_MAKE_OBJ, std::vector<std::string>(), fields));
+
+        check_write(run(reql::term(reql::TERM_UPDATE,
+                                   reql::term(reql::TERM_GET, get_args), func)));
+    }
+
+    /* Throws if a write's result says that it failed. */
+    void check_write(const reql::response_t &response) {
+        if (response.data.empty()) {
+            return;
+        }
+        std::map<std::string, std::string> result = reql::datum_as_object(response.data[0]);
+        if (result.count("errors") && reql::datum_as_num(result["errors"]) > 0) {
+            throw protocol_error_t("Write failed: " + reql::datum_as_str(result["first_error"]));
+        }
+    }
+
+    reql::response_t run(const std::string &term) {
+        return wait_for(send_start(term));
+    }
+
+    int64_t send_start(const std::string &term) {
+        const int64_t token = next_token++;
+        std::string query;
+        reql::append_varint_field(&query, 1, reql::QUERY_START);
+        reql::append_bytes_field(&query, 2, term);
+        reql::append_varint_field(&query, 3, token);
+        send_query(query);
+        return token;
+    }
+
+    /* Gets the rest of a partial sequence, up to `limit` elements, and stops the
+    query if there are more. */
+    void finish_sequence(int64_t token, reql::response_t *response, int limit) {
+        while (response->type == reql::RESPONSE_SUCCESS_PARTIAL) {
+            std::string query;
+            const int type = static_cast<int>(response->data.size()) < limit
+                ? reql::QUERY_CONTINUE : reql::QUERY_STOP;
+            reql::append_varint_field(&query, 1, type);
+            reql::append_varint_field(&query, 3, token);
+            send_query(query);
+            reql::response_t more = wait_for(token);
+            response->type = more.type;
+            response->data.insert(response->data.end(), more.data.begin(), more.data.end());
+        }
+    }
+
+    void send_query(const std::string &query) {
+        std::string message;
+        append_le32(&message, query.size());
+        message += query;
+        send_all(message);
+    }
+
+    void send_all(const std::string &data) {
+        size_t count = 0;
+        while (count < data.size()) {
+            const ssize_t res = write(sockfd, data.data() + count, data.size() - count);
+            if (res < 0) {
+                fprintf(stderr, "Could not send query (%d)\n", errno);
+                exit(-1);
+            }
+            count += res;
+        }
+    }
+
+    static void append_le32(std::string *out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out->push_back(static_cast<char>(value >> (8 * i)));
+        }
+    }
+
+    /* Blocks until the response with `token` has arrived, and throws if it's an
+    error. */
+    reql::response_t wait_for(int64_t token) {
+        std::map<int64_t, reql::response_t>::iterator it;
+        while ((it = arrived.find(token)) == arrived.end()) {
+            receive(true);
+        }
+        reql::response_t response;
+        std::swap(response, it->second);
+        arrived.erase(it);
+        if (response.type >= reql::RESPONSE_CLIENT_ERROR) {
+            throw protocol_error_t("Query failed: "
+                + (response.data.empty() ? std::string() : reql::datum_as_str(response.data[0])));
+        }
+        return response;
+    }
+
+    /* Reads from the socket and moves every complete response into `arrived`.  If
+    `block` is true, waits for at least one. */
+    void receive(bool block) {
+        bool got_one = false;
+        for (;;) {
+            while (parse_response()) {
+                got_one = true;
+            }
+            if (got_one || !block) {
+                // One non-blocking read, in case more has arrived.
+                if (!read_some(false)) {
+                    return;
+                }
+                block = false;
+                continue;
+            }
+            read_some(true);
+        }
+    }
+
+    /* Returns false if there was nothing to read without blocking. */
+    bool read_some(bool block) {
+        if (recv_start > 0 && recv_start == recv_buffer.size()) {
+            recv_buffer.clear();
+            recv_start = 0;
+        } else if (recv_start > 64 * 1024) {
+            recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + recv_start);
+            recv_start = 0;
+        }
+        const size_t old_size = recv_buffer.size();
+        recv_buffer.resize(old_size + 16 * 1024);
+        const ssize_t bytes_read = recv(sockfd, recv_buffer.data() + old_size, 16 * 1024, block ? 0 : MSG_DONTWAIT);
+        if (bytes_read < 0 && !block && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            recv_buffer.resize(old_size);
+            return false;
+        } else if (bytes_read == 0) {
+            fprintf(stderr, "reql_protocol: receive: error: server closed the connection\n");
+            exit(-1);
+        } else if (bytes_read < 0) {
+            perror("Unable to read from socket");
+            exit(-1);
+        }
+        recv_buffer.resize(old_size + bytes_read);
+        return true;
+    }
+
+    /* Moves one complete response from the buffer into `arrived`, if there is
+    one. */
+    bool parse_response() {
+        const size_t available = recv_buffer.size() - recv_start;
+        if (available < 4) {
+            return false;
+        }
+        const uint8_t *header = reinterpret_cast<const uint8_t *>(recv_buffer.data() + recv_start);
+        const size_t size = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+        if (available < 4 + size) {
+            return false;
+        }
+
+        reql::message_reader_t reader(recv_buffer.data() + recv_start + 4, size);
+        recv_start += 4 + size;
+        int field, wire_type;
+        uint64_t value;
+        const char *data;
+        size_t data_size;
+        int64_t token = 0;
+        reql::response_t response;
+        while (reader.next(&field, &wire_type, &value, &data, &data_size)) {
+            if (field == 1) {
+                response.type = value;
+            } else if (field == 2) {
+                token = value;
+            } else if (field == 3) {
+                response.data.push_back(std::string(data, data_size));
+            }
+        }
+        std::swap(arrived[token], response);
+        return true;
+    }
+
+    std::string db, table, index;
+    int insert_batch_size;
+
+    int sockfd;
+    int64_t next_token;
+    std::string table_term;
+
+    // Documents waiting to be inserted as a batch.
+    std::vector<std::string> pending_inserts;
+
+    // Tokens of pipelined reads, oldest first.
+    std::deque<int64_t> pipeline;
+    std::map<int64_t, reql::response_t> arrived;
+
+    std::vector<char> recv_buffer;
+    size_t recv_start;
+};
+
+#endif  // __STRESS_CLIENT_PROTOCOLS_REQL_PROTOCOL_HPP__
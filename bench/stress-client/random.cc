@@ -1,5 +1,6 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 
+#include <math.h>
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -56,15 +57,70 @@ rnd_distr_t distr_with_name(const char *distr_name) {
         return rnd_uniform_t;
     } else if (strcmp(distr_name, "normal") == 0) {
         return rnd_normal_t;
+    } else if (strcmp(distr_name, "zipf") == 0) {
+        return rnd_zipf_t;
+    } else if (strcmp(distr_name, "latest") == 0) {
+        return rnd_latest_t;
     } else {
         fprintf(stderr, "There is no such thing as a \"%s\" distribution. At least, I don't know "
-            "what that means. I only know about \"uniform\" and \"normal\".\n", distr_name);
+            "what that means. I only know about \"uniform\", \"normal\", \"zipf\" and "
+            "\"latest\".\n", distr_name);
         exit(-1);
     }
 }
 
 /* Returns random number between [min, max] using various distributions */
-rnd_gen_t xrandom_create(rnd_distr_t rnd_distr, int mu) {
+/* Returns a number in [0, n) from a Zipfian distribution with exponent `theta`, so
+that 0 is the most likely and the probability of `k` is proportional to
+`1 / (k + 1)^theta`.  This is the rejection-inversion method of Hormann and
+Derflinger, which needs no table and so works for an `n` that changes from one
+call to the next, as the number of keys in the database does. */
+static double zipf_h_integral(double x, double theta) {
+    const double log_x = log(x);
+    if (fabs(1 - theta) < 1e-8) {
+        return log_x;
+    }
+    return (exp((1 - theta) * log_x) - 1) / (1 - theta);
+}
+
+static double zipf_h_integral_inverse(double x, double theta) {
+    if (fabs(1 - theta) < 1e-8) {
+        return exp(x);
+    }
+    double t = x * (1 - theta);
+    if (t < -1) {
+        // Rounding can take us just outside the domain
+        t = -1;
+    }
+    return exp(log1p(t) / (1 - theta));
+}
+
+static size_t zipf_random(size_t n, double theta) {
+    if (n <= 1) {
+        return 0;
+    }
+    const double h_integral_x1 = zipf_h_integral(1.5, theta) - 1;
+    const double h_integral_n = zipf_h_integral(n + 0.5, theta);
+    const double s = 2 - zipf_h_integral_inverse(
+        zipf_h_integral(2.5, theta) - exp(-theta * log(2.0)), theta);
+    for (;;) {
+        const double uniform = (xorshf96() >> 11) * (1.0 / 9007199254740992.0);
+        const double u = h_integral_n + uniform * (h_integral_x1 - h_integral_n);
+        const double x = zipf_h_integral_inverse(u, theta);
+        double k = floor(x + 0.5);
+        if (k < 1) {
+            k = 1;
+        } else if (k > n) {
+            k = n;
+        }
+        if (k - x <= s
+            || u >= zipf_h_integral(k + 0.5, theta) - exp(-theta * log(k))) {
+            return static_cast<size_t>(k) - 1;
+        }
+    }
+}
+
+rnd_gen_t xrandom_create(rnd_distr_t rnd_distr, int mu, double theta) {
     rnd_gen_t rnd;
     rnd.rnd_distr = rnd_distr;
 #ifdef USE_LIBGSL
@@ -72,6 +128,7 @@ rnd_gen_t xrandom_create(rnd_distr_t rnd_distr, int mu) {
     gsl_rng_set((gsl_rng *)rnd.gsl_rnd, get_ticks());
 #endif
     rnd.mu = mu;
+    rnd.theta = theta;
     return rnd;
 }
 
@@ -101,6 +158,12 @@ size_t xrandom(rnd_gen_t rnd, size_t min, size_t max) {
         exit(-1);
         break;
 #endif
+    case rnd_zipf_t:
+        tmp = min + zipf_random(max - min + 1, rnd.theta);
+        break;
+    case rnd_latest_t:
+        tmp = max - zipf_random(max - min + 1, rnd.theta);
+        break;
     }
 
     if(tmp < min) {
@@ -139,6 +202,11 @@ size_t seeded_xrandom(rnd_gen_t rnd, size_t min, size_t max, unsigned long seed)
         exit(-1);
         break;
 #endif
+    case rnd_zipf_t:
+    case rnd_latest_t:
+        fprintf(stderr, "The Zipfian distributions can't be seeded\n");
+        exit(-1);
+        break;
     }
 
     if(tmp < min)
@@ -0,0 +1,521 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+
+/* Sends the queries of a trace that a server captured (see
+`src/rdb_protocol/query_capture.hpp` and `/ajax/query_capture`) to another server,
+to see how it copes with the same load.
+
+Every connection of the trace gets a connection of its own, with a thread that
+sends its queries at the times they were captured at, divided by the rate, and
+one that receives the responses; so the replay has the original concurrency as
+well as the original timing.  The queries are sent as they were captured, tokens
+included.  A query doesn't go out before the server has answered the previous one
+with its token, since the CONTINUE of a stream can only follow the response that
+the client continued.  How far behind the schedule each query was sent is
+reported as its lateness; if it's large, the server couldn't keep up and the
+replay ran slower than the trace.
+
+The output files have the stress client's formats, so bench/format/results.py can
+read them: the responses per second (-q), the latency of each response (-l), and
+the latency percentiles of each type of query (-H). */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "protocols/reql_protocol.hpp"
+#include "utils.hpp"
+
+// From `src/rdb_protocol/query_capture.hpp`.
+static const char trace_magic[] = "RQLTRACE";
+static const uint32_t trace_version = 1;
+
+// From `src/rdb_protocol/ql2.proto`.
+enum {
+    QUERY_NOREPLY_WAIT = 4,
+    NUM_QUERY_TYPES = 5
+};
+static const char *query_type_names[NUM_QUERY_TYPES] = { "unknown", "start", "continue", "stop", "noreply_wait" };
+
+struct replay_config_t {
+    replay_config_t()
+        : host(NULL), trace_file(NULL), rate(1.0), timeout_secs(30),
+          qps_file(NULL), latency_file(NULL), histogram_file(NULL) { }
+    const char *host;
+    const char *trace_file;
+    double rate;
+    int timeout_secs;
+    const char *qps_file;
+    const char *latency_file;
+    const char *histogram_file;
+};
+
+struct trace_query_t {
+    int64_t time_us;
+    int type;
+    int64_t token;
+    bool noreply;
+    // The encoded `Query`.
+    std::string query;
+};
+
+struct replay_connection_t {
+    replay_connection_t()
+        : proto(NULL), start(0), timeout(0), rate(1.0), sender_done(false),
+          sent(0), responses(0), errors(0), unanswered(0) {
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&cond, NULL);
+    }
+    ~replay_connection_t() {
+        pthread_mutex_destroy(&mutex);
+        pthread_cond_destroy(&cond);
+    }
+
+    std::vector<trace_query_t> queries;
+    reql_protocol_t *proto;
+    ticks_t start;
+    ticks_t timeout;
+    double rate;
+
+    // Protect everything below.
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    // The queries waiting for a response by token, with when and as which type
+    // they were sent.
+    std::map<int64_t, std::pair<ticks_t, int> > outstanding;
+    bool sender_done;
+
+    uint64_t sent, responses, errors, unanswered;
+    latency_histogram_t latency[NUM_QUERY_TYPES];
+    latency_histogram_t lateness;
+    std::map<int, int> responses_per_second;
+    // Seconds since the start and latencies in microseconds.
+    std::vector<std::pair<int, float> > latency_samples;
+
+    pthread_t sender, receiver;
+
+private:
+    DISABLE_COPYING(replay_connection_t);
+};
+
+static uint32_t read_le32(const char *data) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t read_le64(const char *data) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+/* Whether the encoded `Term` is the boolean datum `true`. */
+static bool is_true_term(const char *term, size_t term_size) {
+    reql::message_reader_t reader(term, term_size);
+    int field, wire_type;
+    uint64_t value;
+    const char *data;
+    size_t size;
+    bool is_datum = false;
+    std::string datum;
+    while (reader.next(&field, &wire_type, &value, &data, &size)) {
+        if (field == 1 && wire_type == reql::WIRE_VARINT) {
+            is_datum = value == reql::TERM_DATUM;
+        } else if (field == 2 && wire_type == reql::WIRE_LENGTH_DELIMITED) {
+            datum.assign(data, size);
+        }
+    }
+    if (!is_datum) {
+        return false;
+    }
+    reql::message_reader_t datum_reader(datum.data(), datum.size());
+    bool is_bool = false, is_true = false;
+    while (datum_reader.next(&field, &wire_type, &value, &data, &size)) {
+        if (field == 1 && wire_type == reql::WIRE_VARINT) {
+            is_bool = value == reql::R_BOOL;
+        } else if (field == 2 && wire_type == reql::WIRE_VARINT) {
+            is_true = value != 0;
+        }
+    }
+    return is_bool && is_true;
+}
+
+/* Fills in the type, token and `noreply` of `query` from its encoding. */
+static void parse_query(trace_query_t *query) {
+    reql::message_reader_t reader(query->query.data(), query->query.size());
+    int field, wire_type;
+    uint64_t value;
+    const char *data;
+    size_t size;
+    query->type = 0;
+    query->token = 0;
+    query->noreply = false;
+    while (reader.next(&field, &wire_type, &value, &data, &size)) {
+        if (field == 1 && wire_type == reql::WIRE_VARINT) {
+            query->type = value < NUM_QUERY_TYPES ? value : 0;
+        } else if (field == 3 && wire_type == reql::WIRE_VARINT) {
+            query->token = value;
+        } else if (field == 6 && wire_type == reql::WIRE_LENGTH_DELIMITED) {
+            // A global optarg, an `AssocPair` of a key and a term.
+            reql::message_reader_t pair_reader(data, size);
+            std::string key;
+            const char *val = NULL;
+            size_t val_size = 0;
+            while (pair_reader.next(&field, &wire_type, &value, &data, &size)) {
+                if (field == 1) {
+                    key.assign(data, size);
+                } else if (field == 2) {
+                    val = data;
+                    val_size = size;
+                }
+            }
+            if (key == "noreply" && val != NULL) {
+                query->noreply = is_true_term(val, val_size);
+            }
+        }
+    }
+}
+
+/* Reads the trace into one list of queries per connection, in the order they
+were captured. */
+static void read_trace(const char *file_name, std::vector<replay_connection_t *> *connections) {
+    FILE *f = fopen(file_name, "rb");
+    if (!f) {
+        fprintf(stderr, "Could not open trace %s: %s\n", file_name, strerror(errno));
+        exit(-1);
+    }
+    std::string trace;
+    char chunk[64 * 1024];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        trace.append(chunk, count);
+    }
+    fclose(f);
+
+    const size_t header_size = sizeof(trace_magic) - 1 + 4 + 8;
+    if (trace.size() < header_size || trace.compare(0, sizeof(trace_magic) - 1, trace_magic) != 0) {
+        fprintf(stderr, "%s is not a query trace\n", file_name);
+        exit(-1);
+    }
+    if (read_le32(trace.data() + sizeof(trace_magic) - 1) != trace_version) {
+        fprintf(stderr, "%s is a trace of an unknown version\n", file_name);
+        exit(-1);
+    }
+
+    std::map<uint32_t, replay_connection_t *> by_id;
+    size_t pos = header_size;
+    while (pos + 16 <= trace.size()) {
+        const uint32_t size = read_le32(trace.data() + pos);
+        if (pos + 16 + size > trace.size()) {
+            fprintf(stderr, "Ignoring the truncated last record of %s\n", file_name);
+            break;
+        }
+        trace_query_t query;
+        query.time_us = read_le64(trace.data() + pos + 4);
+        const uint32_t connection_id = read_le32(trace.data() + pos + 12);
+        query.query.assign(trace.data() + pos + 16, size);
+        pos += 16 + size;
+        try {
+            parse_query(&query);
+        } catch (protocol_error_t &e) {
+            fprintf(stderr, "Skipping a malformed query in %s: %s\n", file_name, e.c_str());
+            continue;
+        }
+        replay_connection_t *&connection = by_id[connection_id];
+        if (!connection) {
+            connection = new replay_connection_t;
+        }
+        connection->queries.push_back(query);
+    }
+    for (std::map<uint32_t, replay_connection_t *>::iterator it = by_id.begin(); it != by_id.end(); ++it) {
+        connections->push_back(it->second);
+    }
+}
+
+static void timespec_after(ticks_t ticks, struct timespec *out) {
+    clock_gettime(CLOCK_REALTIME, out);
+    const uint64_t nsec = out->tv_nsec + ticks;
+    out->tv_sec += nsec / 1000000000ULL;
+    out->tv_nsec = nsec % 1000000000ULL;
+}
+
+static void *run_sender(void *arg) {
+    replay_connection_t *c = reinterpret_cast<replay_connection_t *>(arg);
+    for (size_t i = 0; i < c->queries.size(); i++) {
+        const trace_query_t &query = c->queries[i];
+        const ticks_t scheduled = c->start + static_cast<ticks_t>(query.time_us * 1000 / c->rate);
+        const ticks_t now = get_ticks();
+        if (now < scheduled) {
+            sleep_ticks(scheduled - now);
+        }
+
+        pthread_mutex_lock(&c->mutex);
+        // Wait for the response to the previous query with this token, but not
+        // forever: it may never come.
+        while (c->outstanding.count(query.token) != 0) {
+            struct timespec deadline;
+            timespec_after(c->timeout, &deadline);
+            if (pthread_cond_timedwait(&c->cond, &c->mutex, &deadline) == ETIMEDOUT
+                && c->outstanding.count(query.token) != 0) {
+                c->outstanding.erase(query.token);
+                c->unanswered++;
+            }
+        }
+        const ticks_t sent = get_ticks();
+        // A STOP is answered by the query it stops, if that one's still running.
+        if (query.type != reql::QUERY_STOP && !query.noreply) {
+            c->outstanding[query.token] = std::make_pair(sent, query.type);
+        }
+        c->lateness.record(sent > scheduled ? sent - scheduled : 0);
+        c->sent++;
+        pthread_mutex_unlock(&c->mutex);
+
+        c->proto->send_encoded_query(query.query);
+    }
+    pthread_mutex_lock(&c->mutex);
+    c->sender_done = true;
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+static void *run_receiver(void *arg) {
+    replay_connection_t *c = reinterpret_cast<replay_connection_t *>(arg);
+    ticks_t give_up = 0;
+    for (;;) {
+        int64_t token;
+        reql::response_t response;
+        bool got_one;
+        try {
+            got_one = c->proto->receive_any(&token, &response, 100);
+        } catch (protocol_error_t &e) {
+            fprintf(stderr, "Protocol error: %s\n", e.c_str());
+            exit(-1);
+        }
+        const ticks_t now = get_ticks();
+
+        pthread_mutex_lock(&c->mutex);
+        if (got_one) {
+            std::map<int64_t, std::pair<ticks_t, int> >::iterator it = c->outstanding.find(token);
+            if (it != c->outstanding.end()) {
+                const ticks_t latency = now - it->second.first;
+                c->latency[it->second.second].record(latency);
+                const int second = ticks_to_secs(now - c->start);
+                c->responses_per_second[second]++;
+                c->latency_samples.push_back(std::make_pair(second, ticks_to_us(latency)));
+                c->responses++;
+                if (response.type >= reql::RESPONSE_CLIENT_ERROR) {
+                    c->errors++;
+                }
+                c->outstanding.erase(it);
+                pthread_cond_broadcast(&c->cond);
+            }
+        }
+        if (c->sender_done) {
+            if (give_up == 0) {
+                give_up = now + c->timeout;
+            }
+            if (c->outstanding.empty() || now > give_up) {
+                c->unanswered += c->outstanding.size();
+                c->outstanding.clear();
+                pthread_mutex_unlock(&c->mutex);
+                return NULL;
+            }
+        }
+        pthread_mutex_unlock(&c->mutex);
+    }
+}
+
+static FILE *open_out_file(const char *file_name, const char *what) {
+    if (!file_name) {
+        return NULL;
+    }
+    FILE *f = fopen(file_name, "w");
+    if (!f) {
+        fprintf(stderr, "Could not open %s file %s: %s\n", what, file_name, strerror(errno));
+        exit(-1);
+    }
+    return f;
+}
+
+static void usage(const char *name) {
+    printf("Usage:\n");
+    printf("\t%s [OPTIONS] HOST TRACE\n", name);
+    printf("\nReplays a query trace captured by a server against HOST, given as host:port[?auth=key].\n");
+    printf("\nOptions:\n");
+    printf("  -r, --rate\t\tHow many times faster than captured to send the queries. Defaults to 1.\n");
+    printf("  -t, --timeout\t\tSeconds to wait for a response before giving up on it. Defaults to 30.\n");
+    printf("  -q, --qps-file\tWrite the responses per second to this file.\n");
+    printf("  -l, --latency-file\tWrite the latency of every response to this file.\n");
+    printf("  -H, --histogram-file\tWrite the latency percentiles of each type of query to this file.\n");
+    exit(-1);
+}
+
+static void parse_args(int argc, char *argv[], replay_config_t *config) {
+    struct option long_options[] = {
+        {"rate", required_argument, 0, 'r'},
+        {"timeout", required_argument, 0, 't'},
+        {"qps-file", required_argument, 0, 'q'},
+        {"latency-file", required_argument, 0, 'l'},
+        {"histogram-file", required_argument, 0, 'H'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    for (;;) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "r:t:q:l:H:h", long_options, &option_index);
+        if (c == -1) {
+            break;
+        }
+        switch (c) {
+        case 'r':
+            config->rate = atof(optarg);
+            if (config->rate <= 0) {
+                fprintf(stderr, "The rate must be positive.\n");
+                exit(-1);
+            }
+            break;
+        case 't':
+            config->timeout_secs = atoi(optarg);
+            break;
+        case 'q':
+            config->qps_file = optarg;
+            break;
+        case 'l':
+            config->latency_file = optarg;
+            break;
+        case 'H':
+            config->histogram_file = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+    }
+    config->host = argv[optind];
+    config->trace_file = argv[optind + 1];
+}
+
+int main(int argc, char *argv[]) {
+    replay_config_t config;
+    parse_args(argc, argv, &config);
+
+    std::vector<replay_connection_t *> connections;
+    read_trace(config.trace_file, &connections);
+    if (connections.empty()) {
+        fprintf(stderr, "%s has no queries\n", config.trace_file);
+        exit(-1);
+    }
+    size_t total_queries = 0;
+    for (size_t i = 0; i < connections.size(); i++) {
+        total_queries += connections[i]->queries.size();
+    }
+    printf("Replaying %zu queries of %zu connections at %gx...\n", total_queries, connections.size(), config.rate);
+
+    // Connect everything before the clock starts, so the first queries aren't late.
+    for (size_t i = 0; i < connections.size(); i++) {
+        connections[i]->proto = new reql_protocol_t(config.host);
+    }
+    const ticks_t start = get_ticks() + secs_to_ticks(0.1);
+    for (size_t i = 0; i < connections.size(); i++) {
+        replay_connection_t *c = connections[i];
+        c->start = start;
+        c->rate = config.rate;
+        c->timeout = secs_to_ticks(config.timeout_secs);
+        if (pthread_create(&c->receiver, NULL, &run_receiver, c) != 0
+            || pthread_create(&c->sender, NULL, &run_sender, c) != 0) {
+            fprintf(stderr, "Could not create a thread for connection %zu\n", i);
+            exit(-1);
+        }
+    }
+
+    uint64_t sent = 0, responses = 0, errors = 0, unanswered = 0;
+    latency_histogram_t latency[NUM_QUERY_TYPES], all_latency, lateness;
+    std::map<int, int> responses_per_second;
+    FILE *latency_fd = open_out_file(config.latency_file, "latency");
+    for (size_t i = 0; i < connections.size(); i++) {
+        replay_connection_t *c = connections[i];
+        pthread_join(c->sender, NULL);
+        pthread_join(c->receiver, NULL);
+        sent += c->sent;
+        responses += c->responses;
+        errors += c->errors;
+        unanswered += c->unanswered;
+        for (int t = 0; t < NUM_QUERY_TYPES; t++) {
+            latency[t] += c->latency[t];
+            all_latency += c->latency[t];
+        }
+        lateness += c->lateness;
+        for (std::map<int, int>::iterator it = c->responses_per_second.begin(); it != c->responses_per_second.end(); ++it) {
+            responses_per_second[it->first] += it->second;
+        }
+        if (latency_fd) {
+            for (size_t j = 0; j < c->latency_samples.size(); j++) {
+                fprintf(latency_fd, "%d\t\t%.2f\n", c->latency_samples[j].first, c->latency_samples[j].second);
+            }
+        }
+        delete c->proto;
+        delete c;
+    }
+    const float duration = ticks_to_secs(get_ticks() - start);
+    if (latency_fd) {
+        fclose(latency_fd);
+    }
+
+    if (FILE *qps_fd = open_out_file(config.qps_file, "QPS")) {
+        const int last_second = responses_per_second.empty() ? -1 : responses_per_second.rbegin()->first;
+        for (int second = 0; second <= last_second; second++) {
+            fprintf(qps_fd, "%d\t\t%d\n", second + 1, responses_per_second[second]);
+        }
+        fclose(qps_fd);
+    }
+
+    static const double percentiles[] = { 50, 90, 99, 99.9, 99.99, 100 };
+    const size_t num_percentiles = sizeof(percentiles) / sizeof(percentiles[0]);
+    if (FILE *histogram_fd = open_out_file(config.histogram_file, "latency percentiles")) {
+        fprintf(histogram_fd, "op\t\tcount");
+        for (size_t i = 0; i < num_percentiles; i++) {
+            fprintf(histogram_fd, "\tp%g", percentiles[i]);
+        }
+        fprintf(histogram_fd, "\n");
+        for (int t = 0; t <= NUM_QUERY_TYPES; t++) {
+            const latency_histogram_t &h = t < NUM_QUERY_TYPES ? latency[t] : all_latency;
+            if (h.total == 0) {
+                continue;
+            }
+            fprintf(histogram_fd, "%-12s\t%llu", t < NUM_QUERY_TYPES ? query_type_names[t] : "all",
+                    static_cast<unsigned long long>(h.total));
+            for (size_t i = 0; i < num_percentiles; i++) {
+                fprintf(histogram_fd, "\t%.1f", ticks_to_us(h.percentile(percentiles[i])));
+            }
+            fprintf(histogram_fd, "\n");
+        }
+        fclose(histogram_fd);
+    }
+
+    printf("Sent %llu queries in %.1fs (%.0f qps): %llu responses, %llu errors, %llu unanswered\n",
+           static_cast<unsigned long long>(sent), duration, duration > 0 ? responses / duration : 0.0,
+           static_cast<unsigned long long>(responses), static_cast<unsigned long long>(errors),
+           static_cast<unsigned long long>(unanswered));
+    if (all_latency.total > 0) {
+        printf("Latency (us): p50 %.1f, p99 %.1f, max %.1f\n", ticks_to_us(all_latency.percentile(50)),
+               ticks_to_us(all_latency.percentile(99)), ticks_to_us(all_latency.percentile(100)));
+    }
+    printf("Behind schedule (us): p50 %.1f, p99 %.1f, max %.1f\n", ticks_to_us(lateness.percentile(50)),
+           ticks_to_us(lateness.percentile(99)), ticks_to_us(lateness.percentile(100)));
+    return 0;
+}
@@ -4,6 +4,8 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <string.h>
 #include <algorithm>
 
 #define UNUSED __attribute__((unused))
@@ -16,7 +18,9 @@ void initialize_clock_monotonic();
 /* Returns random number between [min, max] using various distributions */
 enum rnd_distr_t {
     rnd_uniform_t,
-    rnd_normal_t
+    rnd_normal_t,
+    rnd_zipf_t,     // `min` is the most likely, then `min + 1`, and so on
+    rnd_latest_t    // Zipfian the other way round: `max` is the most likely
 };
 
 struct rnd_gen_t
@@ -24,9 +28,17 @@ struct rnd_gen_t
     void *gsl_rnd;
     rnd_distr_t rnd_distr;
     int mu;
+    double theta;   // The skew of the Zipfian distributions
 };
 rnd_distr_t distr_with_name(const char *name);
-rnd_gen_t xrandom_create(rnd_distr_t rnd_distr, int mu);
+
+/* How an open-loop client spaces out the operations it sends */
+enum arrival_distr_t {
+    arrival_constant_t,
+    arrival_poisson_t
+};
+
+rnd_gen_t xrandom_create(rnd_distr_t rnd_distr, int mu, double theta = 0.99);
 size_t xrandom(size_t min, size_t max);
 size_t xrandom(rnd_gen_t rnd, size_t min, size_t max);
 size_t seeded_xrandom(size_t min, size_t max, unsigned long seed);
@@ -185,5 +197,70 @@ struct reservoir_sample_t {
     }
 };
 
+/* A latency histogram in the style of HdrHistogram. Values below 256 get a bucket each, and
+above that each power of two is split into 128 buckets, so every bucket is narrower than 1% of
+the values in it. That makes percentiles accurate to 1% at any scale, without keeping every
+sample and without the sampling error of a reservoir in the tail. */
+struct latency_histogram_t {
+
+    /* Values of 2^max_bits ticks (about 73 minutes) or more are counted in the last bucket. */
+    static const int sub_bucket_bits = 7;
+    static const int max_bits = 42;
+    static const int num_buckets = (2 << sub_bucket_bits) + (max_bits - sub_bucket_bits - 1) * (1 << sub_bucket_bits);
+
+    uint64_t total;
+    uint64_t counts[num_buckets];
+
+    latency_histogram_t() : total(0) {
+        memset(counts, 0, sizeof(counts));
+    }
+
+    void record(uint64_t value, uint64_t count = 1) {
+        counts[bucket_of(value)] += count;
+        total += count;
+    }
+
+    latency_histogram_t &operator+=(const latency_histogram_t &h) {
+        for (int i = 0; i < num_buckets; i++) counts[i] += h.counts[i];
+        total += h.total;
+        return *this;
+    }
+
+    void clear() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+    }
+
+    /* The smallest value that at least `percent` percent of the recorded values are less than
+    or equal to, rounded up to the top of its bucket. */
+    uint64_t percentile(double percent) const {
+        uint64_t goal = static_cast<uint64_t>(percent / 100.0 * total + 0.5);
+        if (goal == 0) goal = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < num_buckets; i++) {
+            seen += counts[i];
+            if (seen >= goal) return highest_in_bucket(i);
+        }
+        return 0;
+    }
+
+private:
+    static int bucket_of(uint64_t value) {
+        if (value < (2u << sub_bucket_bits)) return value;
+        int top_bit = 63 - __builtin_clzll(value);
+        if (top_bit >= max_bits) return num_buckets - 1;
+        int shift = top_bit - sub_bucket_bits;
+        return (2 << sub_bucket_bits) + (shift - 1) * (1 << sub_bucket_bits)
+            + ((value >> shift) - (1 << sub_bucket_bits));
+    }
+
+    static uint64_t highest_in_bucket(int bucket) {
+        if (bucket < (2 << sub_bucket_bits)) return bucket;
+        int shift = (bucket - (2 << sub_bucket_bits)) / (1 << sub_bucket_bits) + 1;
+        uint64_t sub_bucket = (bucket - (2 << sub_bucket_bits)) % (1 << sub_bucket_bits) + (1 << sub_bucket_bits);
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+};
+
 #endif // __STRESS_CLIENT_UTILS_HPP__
 
@@ -0,0 +1,39 @@
+# Automatically generated by ./configure
+# Command line: 
+CONFIGURE_STATUS := started
+CONFIGURE_ERROR := 
+CONFIGURE_COMMAND_LINE :=  
+CONFIGURE_MAGIC_NUMBER := 2
+# Bash
+FETCH_LIST := 
+FETCH_VERSIONS := 
+LIB_SEARCH_PATHS := 
+# Operating System
+OS := Linux
+# OS Version
+PTHREAD_LIBS := -pthread
+RT_LIBS := -lrt
+M_LIBS := -lm
+# Without tcmalloc
+NO_TCMALLOC := 0
+# Build client drivers
+BUILD_DRIVERS := 0
+# Architecture
+GCC_ARCH := x86_64
+GCC_ARCH_REDUCED := x86_64
+DEB_ARCH := x86_64
+# Use ccache
+USE_CCACHE := 0
+# C++ Compiler
+COMPILER := GCC
+CXX := /usr/bin/c++
+# Precompiled web assets
+USE_PRECOMPILED_WEB_ASSETS := 0
+# Protobuf compiler
+PROTOC := /usr/bin/protoc
+PROTOC_BIN_DEP := 
+# Node.js package manager
+NPM := /usr/bin/npm
+NPM_BIN_DEP := 
+# LESS css
+CONFIGURE_ERROR := missing LESSC. Install it, specify the full path with LESSC= or run ./configure with --allow-fetch
@@ -379,6 +379,12 @@ class RqlQuery(object):
     def max(self, *args):
         return Max(self, *[func_wrap(arg) for arg in args])
 
+    def approx_count_distinct(self, *args):
+        return ApproxCountDistinct(self, *[func_wrap(arg) for arg in args])
+
+    def approx_quantile(self, *args):
+        return ApproxQuantile(self, *[func_wrap(arg) for arg in args])
+
     def map(self, func):
         return Map(self, func_wrap(func))
 
@@ -961,9 +967,13 @@ class Table(RqlQuery):
     def get_all(self, *keys, **kwargs):
         return GetAll(self, *keys, **kwargs)
 
-    def index_create(self, name, fundef=(), multi=()):
+    def index_create(self, name, fundef=(), multi=(), covering=(), count=()):
         args = [self, name] + ([func_wrap(fundef)] if fundef else [])
         kwargs = {"multi" : multi} if multi else {}
+        if covering:
+            kwargs["covering"] = covering
+        if count:
+            kwargs["count"] = count
         return IndexCreate(*args, **kwargs)
 
     def index_drop(self, name):
@@ -981,6 +991,9 @@ class Table(RqlQuery):
     def sync(self):
         return Sync(self)
 
+    def changes(self):
+        return Changes(self)
+
     def compose(self, args, optargs):
         if isinstance(self.args[0], DB):
             return T(args[0], '.table(', args[1], ')')
@@ -1015,6 +1028,14 @@ class Max(RqlMethodQuery):
     tt = p.Term.MAX
     st = 'max'
 
+class ApproxCountDistinct(RqlMethodQuery):
+    tt = p.Term.APPROX_COUNT_DISTINCT
+    st = 'approx_count_distinct'
+
+class ApproxQuantile(RqlMethodQuery):
+    tt = p.Term.APPROX_QUANTILE
+    st = 'approx_quantile'
+
 class Map(RqlMethodQuery):
     tt = p.Term.MAP
     st = 'map'
@@ -1171,6 +1192,10 @@ class Sync(RqlMethodQuery):
     tt = p.Term.SYNC
     st = 'sync'
 
+class Changes(RqlMethodQuery):
+    tt = p.Term.CHANGES
+    st = 'changes'
+
 class Branch(RqlTopLevelQuery):
     tt = p.Term.BRANCH
     st = "branch"
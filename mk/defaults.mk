@@ -37,6 +37,10 @@ SERVER_EXEC_NAME ?= rethinkdb
 # Set SYMBOLS to 1 to enable symbols, even in release mode
 SYMBOLS ?= 0
 
+# Set PERF to 1 for a release build that perf can unwind: it implies SYMBOLS and
+# NO_OMIT_FRAME_POINTER
+PERF ?= 0
+
 # Add numeric indices to json objects in the json adapter
 JSON_SHORTCUTS ?= 0
 
@@ -134,5 +138,6 @@ NO_EVENTFD ?= 0
 NO_EPOLL ?= 0
 LEGACY_PROC_STAT ?= 0
 UNIT_TEST_FILTER ?= *
+MICROBENCH_FILTER ?= *
 PACKAGE_FOR_SUSE_10 ?= 0
 NO_COMPILE_JS ?= 0
@@ -17,11 +17,13 @@
 #include "config/args.hpp"
 #include "backtrace.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "arch/io/disk/aio.hpp"
 #include "arch/io/disk/filestat.hpp"
 #include "arch/io/disk/pool.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
 #include "arch/io/disk/stats.hpp"
 #include "arch/io/disk/accounting.hpp"
+#include "arch/io/disk/write_combining.hpp"
 #include "do_on_thread.hpp"
 #include "logger.hpp"
 
@@ -44,12 +46,14 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         bool use_kernel_aio,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
-        accounter(batch_factor),
+        accounter(batch_factor, stats),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
+        backend(queue, backend_stats.producer, max_concurrent_io_requests,
+                use_kernel_aio),
         outstanding_txn(0)
     {
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
@@ -73,8 +77,9 @@ public:
         rassert(outstanding_txn == 0, "Closing a file with outstanding txns\n");
     }
 
-    void *create_account(int pri, int outstanding_requests_limit) {
-        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
+    void *create_account(int pri, int outstanding_requests_limit, int latency_target_ms) {
+        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit,
+                                                   latency_target_ms);
     }
 
     void delayed_destroy(void *_account) {
@@ -161,7 +166,7 @@ private:
     holding back operations that must be run after other, currently-running, operations.
     Then it goes to the account manager, which queues up running IO operations according
     to which account they are part of. Finally the "backend" pops the IO operations
-    from the queue.
+    from the queue, and submits them with kernel AIO or runs them in its blocker pool.
 
     At two points in the process--once as soon as it is submitted, and again right
     as the backend pops it off the queue--its statistics are recorded. The "stack stats"
@@ -174,7 +179,7 @@ private:
     conflict_resolving_diskmgr_t conflict_resolver;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
+    aio_diskmgr_t backend;
 
 
     int outstanding_txn;
@@ -188,6 +193,9 @@ io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
       diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
                                        DEFAULT_IO_BATCH_FACTOR,
                                        max_concurrent_io_requests,
+                                       // Kernel AIO only helps with O_DIRECT files.
+                                       _direct_io_mode
+                                       != file_direct_io_mode_t::buffered_desired,
                                        &stats)) { }
 
 io_backender_t::~io_backender_t() { }
@@ -197,7 +205,8 @@ file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct
 
 /* Disk file object */
 
-linux_file_t::linux_file_t(scoped_fd_t &&_fd, int64_t _file_size, linux_disk_manager_t *_diskmgr)
+linux_file_t::linux_file_t(scoped_fd_t &&_fd, int64_t _file_size, linux_disk_manager_t *_diskmgr,
+                           bool combine_writes)
     : fd(std::move(_fd)), file_size(_file_size), diskmgr(_diskmgr) {
     // TODO: Why do we care whether we're in a thread pool?  (Maybe it's that you can't create a
     // file_account_t outside of the thread pool?  But they're associated with the diskmgr,
@@ -205,6 +214,17 @@ linux_file_t::linux_file_t(scoped_fd_t &&_fd, int64_t _file_size, linux_disk_man
     if (linux_thread_pool_t::get_thread()) {
         default_account.init(new file_account_t(this, 1, UNLIMITED_OUTSTANDING_REQUESTS));
     }
+    if (combine_writes) {
+        linux_disk_manager_t *mgr = diskmgr;
+        const fd_t raw_fd = fd.get();
+        write_combiner.init(new write_combiner_t(
+            [mgr, raw_fd](int64_t offset, size_t length, const void *buf,
+                          void *account, linux_iocallback_t *cb,
+                          bool wrap_in_datasyncs) {
+                mgr->submit_write(raw_fd, buf, length, offset, account, cb,
+                                  wrap_in_datasyncs);
+            }));
+    }
 }
 
 int64_t linux_file_t::get_size() {
@@ -228,13 +248,67 @@ void linux_file_t::set_size(int64_t size) {
 void linux_file_t::set_size_at_least(int64_t size) {
     /* Grow in large chunks at a time */
     if (file_size < size) {
-        set_size(ceil_aligned(size, DEVICE_BLOCK_SIZE * 128));
+        const int64_t new_size = ceil_aligned(size, DEVICE_BLOCK_SIZE * 128);
+
+        // Unlike ftruncate(), fallocate() never shrinks the file, so this is safe to
+        // do while a preallocate() call is running.
+        if (perform_fallocate(fd.get(), 0, file_size, new_size - file_size) == 0) {
+            int errcode = perform_datasync(fd.get());
+            guarantee_xerr(errcode == 0, errcode, "Could not sync after fallocate");
+            file_size = std::max(file_size, new_size);
+        } else {
+            set_size(new_size);
+        }
+    }
+}
+
+bool linux_file_t::preallocate(int64_t size) {
+    const int64_t offset = file_size;
+    if (size <= offset) {
+        return true;
+    }
+
+    int errcode;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        errcode = perform_fallocate(fd.get(), 0, offset, size - offset);
+        if (errcode == 0) {
+            int sync_errcode = perform_datasync(fd.get());
+            guarantee_xerr(sync_errcode == 0, sync_errcode, "Could not sync after fallocate");
+        }
+    });
+
+    if (errcode != 0) {
+        return false;
+    }
+    file_size = std::max(file_size, size);
+    return true;
+}
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+bool linux_file_t::punch_hole(int64_t offset, int64_t length) {
+    if (write_combiner.has()) {
+        // A buffered write into the range would undo the hole.
+        write_combiner->flush_and_wait();
     }
+    int errcode;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        errcode = perform_fallocate(fd.get(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                                    offset, length);
+    });
+    return errcode == 0;
+}
+#else  // FALLOC_FL_PUNCH_HOLE
+bool linux_file_t::punch_hole(UNUSED int64_t offset, UNUSED int64_t length) {
+    return false;
 }
+#endif  // FALLOC_FL_PUNCH_HOLE
 
 void linux_file_t::read_async(int64_t offset, size_t length, void *buf, file_account_t *account, linux_iocallback_t *callback) {
     rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
     verify_aligned_file_access(file_size, offset, length, buf);
+    if (write_combiner.has()) {
+        write_combiner->before_read(offset, length);
+    }
     diskmgr->submit_read(fd.get(), buf, length, offset,
         account == DEFAULT_DISK_ACCOUNT ? default_account->get_account() : account->get_account(),
         callback);
@@ -245,9 +319,18 @@ void linux_file_t::write_async(int64_t offset, size_t length, const void *buf,
                                wrap_in_datasyncs_t wrap_in_datasyncs) {
     rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
     verify_aligned_file_access(file_size, offset, length, buf);
-    diskmgr->submit_write(fd.get(), buf, length, offset,
-                          account == DEFAULT_DISK_ACCOUNT ? default_account->get_account() : account->get_account(),
-                          callback,
+    void *disk_account = account == DEFAULT_DISK_ACCOUNT
+        ? default_account->get_account()
+        : account->get_account();
+    if (write_combiner.has()) {
+        if (wrap_in_datasyncs == WRAP_IN_DATASYNCS) {
+            write_combiner->write_barrier(offset, length, buf, disk_account, callback);
+        } else {
+            write_combiner->write(offset, length, buf, disk_account, callback);
+        }
+        return;
+    }
+    diskmgr->submit_write(fd.get(), buf, length, offset, disk_account, callback,
                           wrap_in_datasyncs == WRAP_IN_DATASYNCS);
 }
 
@@ -258,6 +341,15 @@ void linux_file_t::writev_async(int64_t offset, size_t length,
             "No diskmgr has been constructed (are we running without an event queue?)");
     verify_aligned_file_access(file_size, offset, length, bufs);
 
+    if (write_combiner.has()) {
+        write_combiner->writev(offset, length, bufs.data(), bufs.size(),
+                               account == DEFAULT_DISK_ACCOUNT
+                               ? default_account->get_account()
+                               : account->get_account(),
+                               callback);
+        return;
+    }
+
 #ifndef USE_WRITEV
 #error "USE_WRITEV not defined.  Did you include pool.hpp?"
 #elif USE_WRITEV
@@ -318,8 +410,10 @@ bool linux_file_t::coop_lock_and_check() {
     return true;
 }
 
-void *linux_file_t::create_account(int priority, int outstanding_requests_limit) {
-    return diskmgr->create_account(priority, outstanding_requests_limit);
+void *linux_file_t::create_account(int priority, int outstanding_requests_limit,
+                                   int latency_target_ms) {
+    return diskmgr->create_account(priority, outstanding_requests_limit,
+                                   latency_target_ms);
 }
 
 void linux_file_t::destroy_account(void *account) {
@@ -423,7 +517,8 @@ file_open_result_t open_file(const char *path, const int mode, io_backender_t *b
     file_open_result_t open_res;
 
     switch (backender->get_direct_io_mode()) {
-    case file_direct_io_mode_t::direct_desired: {
+    case file_direct_io_mode_t::direct_desired:  // fallthrough
+    case file_direct_io_mode_t::write_combining_desired: {
 #ifdef __linux__
         // fcntl(2) is documented to take an argument of type long, not of type int, with the
         // F_SETFL command, on Linux.  But POSIX says it's supposed to take an int?  Passing long
@@ -455,7 +550,9 @@ file_open_result_t open_file(const char *path, const int mode, io_backender_t *b
     // created file's directory entry is persisted to disk.
     guarantee_fsync_parent_directory(path);
 
-    out->init(new linux_file_t(std::move(fd), file_size, backender->get_diskmgr_ptr()));
+    out->init(new linux_file_t(std::move(fd), file_size, backender->get_diskmgr_ptr(),
+                               backender->get_direct_io_mode()
+                               == file_direct_io_mode_t::write_combining_desired));
 
     return open_res;
 }
@@ -517,6 +614,22 @@ int perform_datasync(fd_t fd) {
 #endif  // __MACH__
 }
 
+#ifdef __linux__
+int perform_fallocate(fd_t fd, int mode, int64_t offset, int64_t length) {
+    int res;
+    do {
+        res = fallocate(fd, mode, offset, length);
+    } while (res == -1 && get_errno() == EINTR);
+
+    return res == -1 ? get_errno() : 0;
+}
+#else  // __linux__
+int perform_fallocate(UNUSED fd_t fd, UNUSED int mode,
+                      UNUSED int64_t offset, UNUSED int64_t length) {
+    return EOPNOTSUPP;
+}
+#endif  // __linux__
+
 MUST_USE int fsync_parent_directory(const char *path) {
     // Locate the parent directory
     char absolute_path[PATH_MAX];
@@ -22,6 +22,8 @@ class linux_iocallback_t;
 
 class linux_disk_manager_t;
 
+class write_combiner_t;
+
 class io_backender_t : public home_thread_mixin_debug_only_t {
 public:
     // This takes what is effectively a global flag whether to use O_DIRECT here.  Nothing technical
@@ -72,6 +74,9 @@ public:
     void set_size(int64_t size);
     void set_size_at_least(int64_t size);
 
+    bool preallocate(int64_t size);
+    bool punch_hole(int64_t offset, int64_t length);
+
     void read_async(int64_t offset, size_t length, void *buf, file_account_t *account, linux_iocallback_t *cb);
     void write_async(int64_t offset, size_t length, const void *buf, file_account_t *account, linux_iocallback_t *cb,
                      wrap_in_datasyncs_t wrap_in_datasyncs);
@@ -82,13 +87,15 @@ public:
 
     bool coop_lock_and_check();
 
-    void *create_account(int priority, int outstanding_requests_limit);
+    void *create_account(int priority, int outstanding_requests_limit,
+                         int latency_target_ms);
     void destroy_account(void *account);
 
     ~linux_file_t();
 
 private:
-    linux_file_t(scoped_fd_t &&fd, int64_t file_size, linux_disk_manager_t *diskmgr);
+    linux_file_t(scoped_fd_t &&fd, int64_t file_size, linux_disk_manager_t *diskmgr,
+                 bool combine_writes);
     friend file_open_result_t open_file(const char *path, int mode,
                                         io_backender_t *backender,
                                         scoped_ptr_t<file_t> *out);
@@ -100,6 +107,9 @@ private:
 
     scoped_ptr_t<file_account_t> default_account;
 
+    // Only used in file_direct_io_mode_t::write_combining_desired mode.
+    scoped_ptr_t<write_combiner_t> write_combiner;
+
     DISABLE_COPYING(linux_file_t);
 };
 
@@ -127,6 +137,10 @@ void verify_aligned_file_access(int64_t file_size, int64_t offset, size_t length
 // Makes blocking syscalls.  Upon error, returns the errno value.
 int perform_datasync(fd_t fd);
 
+// Makes a blocking fallocate() call.  Upon error (or if fallocate() isn't available),
+// returns the errno value.
+int perform_fallocate(fd_t fd, int mode, int64_t offset, int64_t length);
+
 // Calls fsync() on the parent directory of the given path.
 // Returns the errno value in case of an error and 0 otherwise.
 MUST_USE int fsync_parent_directory(const char *path);
@@ -1,35 +1,82 @@
 #include "arch/io/disk/accounting.hpp"
-
-/* Each account on the `accounting_diskmgr_t` has its own
-   `unlimited_fifo_queue_t` associated with it. Operations for that account
-   queue up on that queue while they wait for the `accounting_queue_t` on the
-   `accounting_diskmgr_t` to draw from that account. */
-struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_t {
+#include "concurrency/background_governor.hpp"
+#include "config/args.hpp"
+
+/* Each account on the `accounting_diskmgr_t` has its own queue associated with it.
+Operations for that account queue up on that queue while they wait for the
+`accounting_queue_t` on the `accounting_diskmgr_t` to draw from that account.  The
+queue tells the `accounting_queue_t` how long its oldest operation has been waiting,
+for accounts with a latency target. */
+struct accounting_diskmgr_eager_account_t
+    : public semaphore_available_callback_t,
+      public passive_producer_t<accounting_diskmgr_action_t *>,
+      public latency_sensitive_source_t {
     typedef accounting_diskmgr_action_t action_t;
 
     accounting_diskmgr_eager_account_t(accounting_diskmgr_t *par,
                                        int pri,
-                                       int outstanding_requests_limit) :
+                                       int outstanding_requests_limit,
+                                       int latency_target_ms) :
+        passive_producer_t<action_t *>(&available_control),
+        queue_delay(par->get_queue_delay_sampler(pri)),
         outstanding_requests_limiter(outstanding_requests_limit == UNLIMITED_OUTSTANDING_REQUESTS ? SEMAPHORE_NO_LIMIT : outstanding_requests_limit),
-        account(&par->queue, &queue, pri),
-        accounter_lock(par->get_auto_drainer()) {
+        accounter_lock(par->get_auto_drainer()),
+        latency_target(latency_target_ms == NO_IO_LATENCY_TARGET
+                       ? NO_IO_LATENCY_TARGET
+                       : static_cast<ticks_t>(latency_target_ms) * MILLION) {
         rassert(outstanding_requests_limit == UNLIMITED_OUTSTANDING_REQUESTS || outstanding_requests_limit > 0);
+        rassert(latency_target_ms == NO_IO_LATENCY_TARGET || latency_target_ms > 0);
+        if (latency_target_ms == NO_IO_LATENCY_TARGET) {
+            account.init(new accounting_queue_t<action_t *>::account_t(
+                &par->queue, this, pri));
+        } else {
+            account.init(new accounting_queue_t<action_t *>::account_t(
+                &par->queue, this, pri, this,
+                static_cast<ticks_t>(latency_target_ms) * MILLION));
+        }
+    }
+
+    ~accounting_diskmgr_eager_account_t() {
+        // The account must go away before the queue it reads from.
+        account.reset();
     }
 
     void push(action_t *action) {
+        action->enqueue_time = get_ticks();
         throttled_queue.push_back(action);
         outstanding_requests_limiter.lock(this, 1);
     }
     void on_semaphore_available() {
         action_t *action = throttled_queue.head();
         throttled_queue.pop_front();
-        queue.push(action);
+        queue.push_back(action);
+        available_control.set_available(true);
     }
     semaphore_t *get_outstanding_requests_limiter() {
         return &outstanding_requests_limiter;
     }
 
+    bool get_head_enqueue_time(ticks_t *enqueue_time_out) {
+        if (queue.empty()) {
+            return false;
+        }
+        *enqueue_time_out = queue.head()->enqueue_time;
+        return true;
+    }
+
 private:
+    action_t *produce_next_value() {
+        action_t *action = queue.head();
+        queue.pop_front();
+        available_control.set_available(!queue.empty());
+        const ticks_t waited = get_ticks() - action->enqueue_time;
+        queue_delay->record(ticks_to_secs(waited));
+        if (latency_target != NO_IO_LATENCY_TARGET) {
+            record_foreground_io_wait(waited > static_cast<ticks_t>(latency_target));
+        }
+        return action;
+    }
+
     // It would be nice if we could just use a limited_fifo_queue to
     // implement the limitation of outstanding requests.
     // However this part of the code must not rely on coroutines, therefore
@@ -37,19 +84,25 @@ private:
     // throttled_queue contains requests which can not be put on queue right now,
     // because the number of outstanding requests has been exceeded
     intrusive_list_t<action_t> throttled_queue;
-    unlimited_fifo_queue_t<action_t *, intrusive_list_t<action_t> > queue;
+    intrusive_list_t<action_t> queue;
+    availability_control_t available_control;
+    perfmon_sampler_t *queue_delay;
     static_semaphore_t outstanding_requests_limiter;
-    accounting_queue_t<action_t *>::account_t account;
+    scoped_ptr_t<accounting_queue_t<action_t *>::account_t> account;
     auto_drainer_t::lock_t accounter_lock;
+    // In ticks, or NO_IO_LATENCY_TARGET.
+    const int64_t latency_target;
 
     DISABLE_COPYING(accounting_diskmgr_eager_account_t);
 };
 
 accounting_diskmgr_account_t::accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                                            int _pri,
-                                                           int _outstanding_requests_limit)
+                                                           int _outstanding_requests_limit,
+                                                           int _latency_target_ms)
         : par(_par), pri(_pri),
-          outstanding_requests_limit(_outstanding_requests_limit) { }
+          outstanding_requests_limit(_outstanding_requests_limit),
+          latency_target_ms(_latency_target_ms) { }
 
 accounting_diskmgr_account_t::~accounting_diskmgr_account_t() {
     par->assert_thread();
@@ -73,7 +126,8 @@ semaphore_t *accounting_diskmgr_account_t::get_outstanding_requests_limiter() {
 void accounting_diskmgr_account_t::maybe_init(){
     if (!eager_account.has()) {
         par->assert_thread();
-        eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit));
+        eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit,
+                                                latency_target_ms));
     }
 }
 
@@ -89,6 +143,20 @@ void debug_print(printf_buffer_t *buf,
 }
 
 
+accounting_diskmgr_t::priority_stats_t::priority_stats_t(perfmon_collection_t *parent,
+                                                        int pri)
+    : queue_delay(secs_to_ticks(1), false),
+      membership(parent, &queue_delay, strprintf("queue_delay_priority_%d", pri)) { }
+
+perfmon_sampler_t *accounting_diskmgr_t::get_queue_delay_sampler(int pri) {
+    assert_thread();
+    scoped_ptr_t<priority_stats_t> *entry = &stats_by_priority[pri];
+    if (!entry->has()) {
+        entry->init(new priority_stats_t(stats, pri));
+    }
+    return &(*entry)->queue_delay;
+}
+
 accounting_diskmgr_t::~accounting_diskmgr_t() {
     auto_drainer.reset();  // Make absolutely sure this happens first.
 }
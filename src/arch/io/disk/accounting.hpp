@@ -2,6 +2,8 @@
 #ifndef ARCH_IO_DISK_ACCOUNTING_HPP_
 #define ARCH_IO_DISK_ACCOUNTING_HPP_
 
+#include <map>
+
 #include "errors.hpp"
 #include <boost/function.hpp>
 
@@ -9,10 +11,10 @@
 #include "containers/scoped.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/queue/accounting.hpp"
-#include "concurrency/queue/unlimited_fifo.hpp"
 #include "concurrency/semaphore.hpp"
 #include "arch/io/disk.hpp"
 #include "arch/io/disk/stats_2.hpp"
+#include "perfmon/perfmon.hpp"
 
 /* `casting_passive_producer_t` is useful when you have a
 `passive_producer_t<X>` but you need a `passive_producer_t<Y>`, where `X` can
@@ -33,7 +35,10 @@ private:
 };
 
 /* `accounting_diskmgr_t` shares disk throughput proportionally between a
-number of different "accounts". */
+number of different "accounts".  An account with a latency target gets its
+requests served out of turn once they have been queued for longer than the
+target (see `accounting_queue_t`).  The time requests spend queued here is
+sampled per account priority, in the "queue_delay_priority_<priority>" stats. */
 
 typedef stats_diskmgr_2_t::action_t accounting_payload_t;
 
@@ -46,9 +51,11 @@ struct accounting_diskmgr_eager_account_t;
 struct accounting_diskmgr_account_t {
     typedef accounting_diskmgr_action_t action_t;
 
+    // _latency_target_ms may be NO_IO_LATENCY_TARGET.
     accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                  int _pri,
-                                 int _outstanding_requests_limit);
+                                 int _outstanding_requests_limit,
+                                 int _latency_target_ms);
 
     ~accounting_diskmgr_account_t();
 
@@ -64,6 +71,7 @@ private:
     accounting_diskmgr_t *par;
     int pri;
     int outstanding_requests_limit;
+    int latency_target_ms;
     scoped_ptr_t<eager_account_t> eager_account;
 
     DISABLE_COPYING(accounting_diskmgr_account_t);
@@ -73,6 +81,8 @@ struct accounting_diskmgr_action_t
     : public intrusive_list_node_t<accounting_diskmgr_action_t>,
       public accounting_payload_t {
     accounting_diskmgr_account_t *account;
+    // When the action was submitted to the `accounting_diskmgr_t`.
+    ticks_t enqueue_time;
 };
 
 void debug_print(printf_buffer_t *buf,
@@ -80,8 +90,9 @@ void debug_print(printf_buffer_t *buf,
 
 class accounting_diskmgr_t : public home_thread_mixin_t {
 public:
-    explicit accounting_diskmgr_t(int batch_factor)
+    accounting_diskmgr_t(int batch_factor, perfmon_collection_t *_stats)
         : producer(&caster),
+          stats(_stats),
           queue(batch_factor),
           caster(&queue),
           auto_drainer(new auto_drainer_t()) { }
@@ -106,6 +117,18 @@ public:
 private:
     friend struct accounting_diskmgr_eager_account_t;
 
+    struct priority_stats_t {
+        priority_stats_t(perfmon_collection_t *parent, int pri);
+        perfmon_sampler_t queue_delay;
+        perfmon_membership_t membership;
+    };
+
+    // Returns the queue delay sampler shared by all accounts of priority pri.
+    perfmon_sampler_t *get_queue_delay_sampler(int pri);
+
+    perfmon_collection_t *stats;
+    std::map<int, scoped_ptr_t<priority_stats_t> > stats_by_priority;
+
     accounting_queue_t<action_t *> queue;
     casting_passive_producer_t<action_t *, accounting_payload_t *> caster;
     scoped_ptr_t<auto_drainer_t> auto_drainer;
@@ -0,0 +1,312 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/aio.hpp"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "config/args.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+#if USE_KERNEL_AIO
+// glibc doesn't wrap the kernel AIO syscalls, and we don't want to depend on libaio
+// just for these.
+int aio_setup(unsigned nr_events, aio_context_t *ctx_out) {
+    return syscall(__NR_io_setup, nr_events, ctx_out);
+}
+
+int aio_destroy(aio_context_t ctx) {
+    return syscall(__NR_io_destroy, ctx);
+}
+
+int aio_submit(aio_context_t ctx, long nr, iocb **iocbpp) {  // NOLINT(runtime/int)
+    return syscall(__NR_io_submit, ctx, nr, iocbpp);
+}
+
+int aio_getevents(aio_context_t ctx, long min_nr, long nr,  // NOLINT(runtime/int)
+                  io_event *events, timespec *timeout) {
+    return syscall(__NR_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+#endif  // USE_KERNEL_AIO
+
+aio_diskmgr_t::aio_diskmgr_t(linux_event_queue_t *_queue,
+                             passive_producer_t<action_t *> *_source,
+                             int max_concurrent_io_requests,
+                             UNUSED bool use_kernel_aio)
+    : queue_depth(blocker_pool_queue_depth(max_concurrent_io_requests)),
+      adaptive_depth(std::min(DISK_MIN_QUEUE_DEPTH, queue_depth), queue_depth),
+      source(_source),
+      fallback(_queue, &fallback_source, max_concurrent_io_requests),
+      n_fallback_pending(0)
+#if USE_KERNEL_AIO
+      , queue(_queue),
+      context(0),
+      pump_requested(false),
+      n_aio_pending(0)
+#endif
+{
+    fallback.done_fun = std::bind(&aio_diskmgr_t::on_fallback_done, this, ph::_1);
+
+#if USE_KERNEL_AIO
+    if (use_kernel_aio) {
+        if (aio_setup(queue_depth, &context) == 0) {
+            queue->watch_resource(event.get_notify_fd(), poll_event_in, this);
+        } else {
+            logINF("Kernel AIO is unavailable (%s), so disk I/O will go through a "
+                   "thread pool.", errno_string(get_errno()).c_str());
+            context = 0;
+        }
+    }
+#endif
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+}
+
+aio_diskmgr_t::~aio_diskmgr_t() {
+    assert_thread();
+    source->available->unset_callback();
+#if USE_KERNEL_AIO
+    if (context != 0) {
+        guarantee(n_aio_pending == 0);
+        queue->forget_resource(event.get_notify_fd(), this);
+        const int res = aio_destroy(context);
+        guarantee_err(res == 0, "Could not destroy the AIO context");
+    }
+#endif
+}
+
+void aio_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (!source->available->get()) {
+        return;
+    }
+#if USE_KERNEL_AIO
+    if (context != 0) {
+        // We let the requests pile up until the next pass of the event loop, so
+        // that they can go in a single io_submit.
+        if (!pump_requested) {
+            pump_requested = true;
+            event.wakey_wakey();
+        }
+        return;
+    }
+#endif
+    pump();
+}
+
+void aio_diskmgr_t::pump() {
+    assert_thread();
+#if USE_KERNEL_AIO
+    std::vector<action_t *> actions;
+    while (source->available->get()
+           && n_aio_pending + n_fallback_pending < adaptive_depth.get()) {
+        action_t *a = source->pop();
+        a->backend_start_time = get_ticks();
+        if (context != 0 && can_submit(a)) {
+            actions.push_back(a);
+            ++n_aio_pending;
+        } else {
+            ++n_fallback_pending;
+            fallback_source.push(a);
+        }
+    }
+    if (!actions.empty()) {
+        submit(&actions);
+    }
+#else
+    while (source->available->get() && n_fallback_pending < adaptive_depth.get()) {
+        ++n_fallback_pending;
+        action_t *a = source->pop();
+        a->backend_start_time = get_ticks();
+        fallback_source.push(a);
+    }
+#endif
+    if (source->available->get()) {
+        adaptive_depth.note_limited();
+    }
+}
+
+void aio_diskmgr_t::on_fallback_done(action_t *a) {
+    assert_thread();
+    --n_fallback_pending;
+    pump();
+    finish(a);
+}
+
+void aio_diskmgr_t::finish(action_t *a) {
+    const ticks_t now = get_ticks();
+    adaptive_depth.record(now - a->backend_start_time, now);
+    done_fun(a);
+}
+
+#if USE_KERNEL_AIO
+bool aio_diskmgr_t::can_submit(action_t *a) const {
+    // Only the blocker pool knows how to pretend that the disk is slow.
+    if (a->wrap_in_datasyncs || get_injected_disk_latency() != 0) {
+        return false;
+    }
+    iovec *vecs;
+    size_t vecs_len;
+    a->get_bufs(&vecs, &vecs_len);
+    if (vecs_len > IOV_MAX) {
+        return false;
+    }
+    // Files that fell back to buffered I/O would make io_submit block.
+    const int flags = fcntl(a->get_fd(), F_GETFL);
+    return flags != -1 && (flags & O_DIRECT) != 0;
+}
+
+// One io_submit request, for the actions whose contiguous ranges it covers.
+struct aio_diskmgr_t::request_t {
+    fd_t fd;
+    bool is_read;
+    int64_t offset;
+    size_t count;
+    std::vector<action_t *> actions;
+    std::vector<iovec> iovecs;
+};
+
+bool action_precedes(aio_diskmgr_t::action_t *x, aio_diskmgr_t::action_t *y) {
+    if (x->get_fd() != y->get_fd()) {
+        return x->get_fd() < y->get_fd();
+    }
+    if (x->get_is_read() != y->get_is_read()) {
+        return x->get_is_read();
+    }
+    return x->get_offset() < y->get_offset();
+}
+
+void aio_diskmgr_t::submit(std::vector<action_t *> *actions) {
+    // Sorting doesn't break any ordering guarantees: the actions we get at the same
+    // time are all for disjoint ranges.
+    std::stable_sort(actions->begin(), actions->end(), &action_precedes);
+
+    std::vector<request_t *> requests;
+    for (auto it = actions->begin(); it != actions->end(); ++it) {
+        action_t *a = *it;
+        iovec *vecs;
+        size_t vecs_len;
+        a->get_bufs(&vecs, &vecs_len);
+
+        request_t *last = requests.empty() ? NULL : requests.back();
+        if (last == NULL
+            || last->fd != a->get_fd()
+            || last->is_read != a->get_is_read()
+            || last->offset + static_cast<int64_t>(last->count) != a->get_offset()
+            || last->count + a->get_count() > DISK_MERGED_REQUEST_MAX_SIZE
+            || last->iovecs.size() + vecs_len > IOV_MAX) {
+            last = new request_t;
+            last->fd = a->get_fd();
+            last->is_read = a->get_is_read();
+            last->offset = a->get_offset();
+            last->count = 0;
+            requests.push_back(last);
+        }
+        last->count += a->get_count();
+        last->actions.push_back(a);
+        last->iovecs.insert(last->iovecs.end(), vecs, vecs + vecs_len);
+    }
+
+    std::vector<iocb> iocbs(requests.size());
+    std::vector<iocb *> pointers(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        request_t *request = requests[i];
+        iocb *cb = &iocbs[i];
+        memset(cb, 0, sizeof(*cb));
+        cb->aio_data = reinterpret_cast<uintptr_t>(request);
+        cb->aio_fildes = request->fd;
+        cb->aio_offset = request->offset;
+        cb->aio_flags = IOCB_FLAG_RESFD;
+        cb->aio_resfd = event.get_notify_fd();
+        if (request->iovecs.size() == 1) {
+            cb->aio_lio_opcode = request->is_read ? IOCB_CMD_PREAD : IOCB_CMD_PWRITE;
+            cb->aio_buf = reinterpret_cast<uintptr_t>(request->iovecs[0].iov_base);
+            cb->aio_nbytes = request->iovecs[0].iov_len;
+        } else {
+            cb->aio_lio_opcode = request->is_read ? IOCB_CMD_PREADV : IOCB_CMD_PWRITEV;
+            cb->aio_buf = reinterpret_cast<uintptr_t>(request->iovecs.data());
+            cb->aio_nbytes = request->iovecs.size();
+        }
+        pointers[i] = cb;
+    }
+
+    size_t i = 0;
+    while (i < pointers.size()) {
+        const int res = aio_submit(context, pointers.size() - i, pointers.data() + i);
+        if (res > 0) {
+            i += res;
+        } else {
+            // The kernel won't take the first of the remaining requests (maybe the
+            // filesystem doesn't do AIO), so its actions go to the blocker pool.
+            rassert(res == -1);
+            send_to_fallback(requests[i]);
+            ++i;
+        }
+    }
+}
+
+void aio_diskmgr_t::send_to_fallback(request_t *request) {
+    for (auto it = request->actions.begin(); it != request->actions.end(); ++it) {
+        --n_aio_pending;
+        ++n_fallback_pending;
+        fallback_source.push(*it);
+    }
+    delete request;
+}
+
+void aio_diskmgr_t::on_event(int events) {
+    assert_thread();
+    if (events != poll_event_in) {
+        logERR("Unexpected event mask: %d", events);
+    }
+    event.consume_wakey_wakeys();
+    collect_completions();
+    pump_requested = false;
+    pump();
+}
+
+void aio_diskmgr_t::collect_completions() {
+    const int max_events = 64;
+    io_event events[max_events];
+    timespec no_wait;
+    no_wait.tv_sec = 0;
+    no_wait.tv_nsec = 0;
+
+    int res;
+    do {
+        do {
+            res = aio_getevents(context, 0, max_events, events, &no_wait);
+        } while (res == -1 && get_errno() == EINTR);
+        guarantee_err(res >= 0, "Could not get AIO completions");
+
+        for (int i = 0; i < res; ++i) {
+            request_t *request = reinterpret_cast<request_t *>(events[i].data);
+            if (request->actions.size() > 1
+                && events[i].res != static_cast<int64_t>(request->count)) {
+                // We can't tell which of the merged actions failed, so they each
+                // get another try on their own.
+                send_to_fallback(request);
+                continue;
+            }
+            for (auto it = request->actions.begin(); it != request->actions.end(); ++it) {
+                action_t *a = *it;
+                // Like the blocker pool, a negative result is minus the errno.
+                a->io_result = request->actions.size() == 1
+                    ? events[i].res
+                    : a->get_count();
+                --n_aio_pending;
+                finish(a);
+            }
+            delete request;
+        }
+    } while (res == max_events);
+}
+#endif  // USE_KERNEL_AIO
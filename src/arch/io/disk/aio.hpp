@@ -0,0 +1,99 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_AIO_HPP_
+#define ARCH_IO_DISK_AIO_HPP_
+
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+#include "arch/io/disk/pool.hpp"
+#include "arch/io/disk/queue_depth.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+#include "concurrency/queue/unlimited_fifo.hpp"
+
+#if defined(__linux) && !defined(NO_EVENTFD) && !defined(NO_KERNEL_AIO)
+#define USE_KERNEL_AIO 1
+#else
+#define USE_KERNEL_AIO 0
+#endif
+
+#if USE_KERNEL_AIO
+#include <linux/aio_abi.h>
+
+#include "arch/runtime/system_event/eventfd_event.hpp"
+#endif
+
+/* The AIO disk manager hands the IO requests it draws from its source to the kernel
+with io_submit, instead of tying up a blocker pool thread (and paying for a context
+switch) for each one.  The requests that become available during one pass of the
+event loop are submitted together, in a single io_submit call on the next pass, and
+completions are collected through an eventfd that the event queue watches.
+
+Requests in the same batch that read (or write) contiguous ranges of the same file
+are merged into one vectored request, up to DISK_MERGED_REQUEST_MAX_SIZE, and the
+result is split back out between them when it's done.  This keeps the conflict
+semantics of the layers above: they never let two requests for overlapping ranges
+reach us at the same time, and contiguous requests don't overlap.
+
+Kernel AIO is only asynchronous for files opened with O_DIRECT, and it can't wrap a
+write in datasyncs, so those requests, and any the kernel refuses, are run by a
+pool_diskmgr_t instead.  So is everything if use_kernel_aio is false or the kernel
+won't give us an AIO context.
+
+How many requests we keep in flight, counting both kinds, is decided by an
+adaptive_queue_depth_t. */
+class aio_diskmgr_t : private availability_callback_t,
+#if USE_KERNEL_AIO
+                      private linux_event_callback_t,
+#endif
+                      public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    /* The `aio_diskmgr_t` will draw actions to run from `source`. It will call
+    `done_fun` on each one when it's done. */
+    aio_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
+                  int max_concurrent_io_requests, bool use_kernel_aio);
+    boost::function<void(action_t *)> done_fun;
+    ~aio_diskmgr_t();
+
+private:
+    void on_source_availability_changed();
+    void pump();
+    void on_fallback_done(action_t *a);
+    void finish(action_t *a);
+
+    const int queue_depth;
+    adaptive_queue_depth_t adaptive_depth;
+    passive_producer_t<action_t *> *const source;
+
+    // The requests that go to the blocker pool.
+    unlimited_fifo_queue_t<action_t *> fallback_source;
+    pool_diskmgr_t fallback;
+    int n_fallback_pending;
+
+#if USE_KERNEL_AIO
+    struct request_t;
+
+    bool can_submit(action_t *a) const;
+    void submit(std::vector<action_t *> *actions);
+    void send_to_fallback(request_t *request);
+    void on_event(int events);
+    void collect_completions();
+
+    linux_event_queue_t *const queue;
+    // Zero if we aren't using kernel AIO.
+    aio_context_t context;
+    // Rung by the kernel on every completion, and by us to run pump() on the next
+    // pass of the event loop.
+    eventfd_event_t event;
+    bool pump_requested;
+    int n_aio_pending;
+#endif
+
+    DISABLE_COPYING(aio_diskmgr_t);
+};
+
+#endif  // ARCH_IO_DISK_AIO_HPP_
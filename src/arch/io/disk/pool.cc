@@ -9,6 +9,17 @@
 #include "arch/io/disk.hpp"
 #include "config/args.hpp"
 
+static int64_t injected_disk_latency = 0;
+
+void set_injected_disk_latency(int64_t microseconds) {
+    guarantee(microseconds >= 0 && microseconds <= MILLION);
+    injected_disk_latency = microseconds;
+}
+
+int64_t get_injected_disk_latency() {
+    return injected_disk_latency;
+}
+
 int blocker_pool_queue_depth(int max_concurrent_io_requests) {
     guarantee(max_concurrent_io_requests > 0);
     guarantee(max_concurrent_io_requests < MAXIMUM_MAX_CONCURRENT_IO_REQUESTS);
@@ -45,6 +56,10 @@ pool_diskmgr_t::~pool_diskmgr_t() {
 }
 
 void pool_diskmgr_t::action_t::run() {
+    if (injected_disk_latency != 0) {
+        usleep(injected_disk_latency);
+    }
+
     if (wrap_in_datasyncs) {
         int errcode = perform_datasync(fd);
         if (errcode != 0) {
@@ -87,6 +87,7 @@ struct pool_diskmgr_action_t
 
 private:
     friend class pool_diskmgr_t;
+    friend class aio_diskmgr_t;
     pool_diskmgr_t *parent;
 
     bool is_read;
@@ -103,6 +104,9 @@ private:
 
     int64_t io_result;
 
+    // When the aio_diskmgr_t took the action from its source.
+    ticks_t backend_start_time;
+
     void run();
     void done();
 
@@ -112,6 +116,19 @@ private:
 void debug_print(printf_buffer_t *buf,
                  const pool_diskmgr_action_t &action);
 
+// How many requests a disk manager with max_concurrent_io_requests threads keeps
+// in flight.
+int blocker_pool_queue_depth(int max_concurrent_io_requests);
+
+/* For benchmarks of how the cluster copes with slow disks (see
+`--inject-disk-latency`): if the latency is non-zero, every request of every disk
+manager sleeps that long in its blocker pool thread before it runs. That holds on
+to the thread, so the throughput suffers as it would with a slower disk, not just
+the latency. The `aio_diskmgr_t` sends every request to its blocker pool while
+the latency is non-zero. It should be set before any files are opened. */
+void set_injected_disk_latency(int64_t microseconds);
+int64_t get_injected_disk_latency();
+
 class pool_diskmgr_t : private availability_callback_t, public home_thread_mixin_debug_only_t {
 public:
     friend struct pool_diskmgr_action_t;
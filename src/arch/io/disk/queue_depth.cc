@@ -0,0 +1,97 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/queue_depth.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+adaptive_queue_depth_t::adaptive_queue_depth_t(int _min_depth, int _max_depth)
+    : min_depth(_min_depth), max_depth(_max_depth),
+      depth_estimate(std::max(_min_depth, _max_depth / 4)),
+      depth(std::max(_min_depth, _max_depth / 4)),
+      window_start(0), window_completions(0), window_latency_sum(0),
+      limited_in_window(false),
+      min_latency(0), windows_since_min_latency_reset(0), probing(false),
+      have_previous(false), previous_latency(0), previous_throughput(0),
+      previous_depth(0) {
+    guarantee(min_depth > 0);
+    guarantee(min_depth <= max_depth);
+}
+
+void adaptive_queue_depth_t::record(ticks_t latency, ticks_t now) {
+    if (window_completions == 0) {
+        window_start = now;
+    }
+    ++window_completions;
+    window_latency_sum += latency;
+    if (window_completions == DISK_QUEUE_DEPTH_WINDOW_SIZE) {
+        end_window(now);
+    }
+}
+
+void adaptive_queue_depth_t::end_window(ticks_t now) {
+    const double latency = static_cast<double>(window_latency_sum) / window_completions;
+    const double throughput
+        = window_completions / std::max(ticks_to_secs(now - window_start), 1e-9);
+    const bool counts = limited_in_window;
+
+    window_completions = 0;
+    window_latency_sum = 0;
+    limited_in_window = false;
+
+    if (probing) {
+        // Whether or not the backend was limited, this window ran at a depth low
+        // enough to show the latency of an unloaded device.
+        probing = false;
+        min_latency = latency;
+        windows_since_min_latency_reset = 0;
+        depth = static_cast<int>(depth_estimate);
+        have_previous = false;
+        return;
+    }
+
+    if (!counts) {
+        have_previous = false;
+        return;
+    }
+
+    if (min_latency == 0) {
+        min_latency = latency;
+    }
+    min_latency = std::min(min_latency, latency);
+
+    // Below one when requests wait in the device.  We don't let a single window cut
+    // the depth by more than half.
+    const double gradient
+        = std::max(0.5, std::min(1.0, min_latency / std::max(latency, 1.0)));
+    // The square root lets the depth grow quickly while it's low, and allows for
+    // some queueing in the device at any depth.
+    double target = depth_estimate * gradient + sqrt(depth_estimate);
+
+    if (have_previous && depth > previous_depth
+        && throughput < previous_throughput * 1.05
+        && latency > previous_latency) {
+        // The last increase didn't pay off, so don't go further.
+        target = std::min(target, depth_estimate);
+    }
+
+    depth_estimate = 0.8 * depth_estimate + 0.2 * target;
+    depth_estimate = std::max<double>(min_depth,
+                                      std::min<double>(max_depth, depth_estimate));
+
+    have_previous = true;
+    previous_latency = latency;
+    previous_throughput = throughput;
+    previous_depth = depth;
+    depth = static_cast<int>(depth_estimate);
+
+    ++windows_since_min_latency_reset;
+    if (windows_since_min_latency_reset >= DISK_QUEUE_DEPTH_MIN_LATENCY_RESET_WINDOWS) {
+        // Measuring at the depth we settled on would only confirm it, so we
+        // measure at half of it.
+        probing = true;
+        depth = std::max(min_depth, depth / 2);
+    }
+}
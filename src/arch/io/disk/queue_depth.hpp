@@ -0,0 +1,65 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_QUEUE_DEPTH_HPP_
+#define ARCH_IO_DISK_QUEUE_DEPTH_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+#include "utils.hpp"
+
+/* `adaptive_queue_depth_t` picks how many requests the disk backend keeps in flight.
+More requests in flight let the device reorder and parallelize them, until it
+saturates; past that point, they only wait in the device's queue instead of ours,
+where the accounting layer can't prioritize them any more.
+
+We start at a quarter of the maximum depth.  The backend reports every completed request with its latency.  Every
+DISK_QUEUE_DEPTH_WINDOW_SIZE completions, we compare the window's average latency
+with the lowest one we have seen, which approximates the latency of an idle device.
+A ratio close to one means that the device isn't saturated, and we raise the depth;
+a higher ratio lowers it in proportion, like the gradient algorithm of TCP Vegas.  We
+also stop raising the depth when doing so didn't buy throughput but did cost
+latency.  Windows in which the backend never had more requests than the depth are
+ignored, since they say nothing about how the device would cope with more.
+
+Every DISK_QUEUE_DEPTH_MIN_LATENCY_RESET_WINDOWS windows, we run one window at half
+the depth and take its latency as the new lowest one, so that we follow the device
+if it gets slower.  (Simply forgetting the lowest latency would let the depth creep
+up: the latency at the current depth would become the new baseline.) */
+class adaptive_queue_depth_t {
+public:
+    adaptive_queue_depth_t(int min_depth, int max_depth);
+
+    int get() const { return depth; }
+
+    // Tells us that the backend had a request it couldn't send because of the depth.
+    void note_limited() { limited_in_window = true; }
+
+    // Reports a completed request.  now is passed in for the unit tests' sake.
+    void record(ticks_t latency, ticks_t now);
+
+private:
+    void end_window(ticks_t now);
+
+    const int min_depth, max_depth;
+    double depth_estimate;
+    int depth;
+
+    ticks_t window_start;
+    int window_completions;
+    ticks_t window_latency_sum;
+    bool limited_in_window;
+
+    double min_latency;
+    int windows_since_min_latency_reset;
+    // Whether the current window runs at a reduced depth to measure min_latency.
+    bool probing;
+
+    // The previous window's results, if it counted.
+    bool have_previous;
+    double previous_latency, previous_throughput;
+    int previous_depth;
+
+    DISABLE_COPYING(adaptive_queue_depth_t);
+};
+
+#endif  // ARCH_IO_DISK_QUEUE_DEPTH_HPP_
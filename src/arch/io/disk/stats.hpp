@@ -9,17 +9,25 @@
 
 #include "arch/io/disk/pool.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
-#include "perfmon/types.hpp"
+#include "perfmon/perfmon.hpp"
 
 /* There are two types of stat-collectors in the disk stack. One type is a passive
 consumer and active producer of disk operations. The other type is an active consumer
-and passive producer. */
+and passive producer.
+
+Both keep latency histograms for reads and writes.  The "stack" ones, at the top of
+the stack, include the time operations spend queued in the disk manager; the
+"backend" ones, at the bottom, only the time the device (and the kernel or the
+blocker pool) takes.  If the backend latencies look fine while the stack ones don't,
+the time goes to our own queueing. */
 
 struct stats_diskmgr_t {
     stats_diskmgr_t(perfmon_collection_t *stats, const std::string &name);
 
     struct action_t : public conflict_resolving_diskmgr_action_t {
         ticks_t start_time;
+        // Unlike start_time, always set.
+        ticks_t submit_time;
     };
 
     void submit(action_t *a);
@@ -32,6 +40,7 @@ struct stats_diskmgr_t {
 
 private:
     perfmon_duration_sampler_t read_sampler, write_sampler;
+    perfmon_latency_histogram_t read_latency, write_latency;
     perfmon_multi_membership_t stats_membership;
 };
 
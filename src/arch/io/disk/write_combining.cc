@@ -0,0 +1,188 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/write_combining.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+#include "utils.hpp"
+
+// A write of the buffer's contents to the disk manager.  It owns the data.
+class write_combiner_t::flush_t : public linux_iocallback_t {
+public:
+    flush_t(write_combiner_t *_parent, uint64_t _seq, scoped_malloc_t<char> &&_data)
+        : parent(_parent), seq(_seq), data(std::move(_data)),
+          keepalive(_parent->drainer.get()) { }
+
+    void on_io_complete() {
+        parent->on_flush_done(seq);
+        delete this;
+    }
+
+    char *get_data() { return data.get(); }
+
+private:
+    write_combiner_t *const parent;
+    const uint64_t seq;
+    scoped_malloc_t<char> data;
+    auto_drainer_t::lock_t keepalive;
+
+    DISABLE_COPYING(flush_t);
+};
+
+write_combiner_t::write_combiner_t(const write_fun_t &_write_fun)
+    : write_fun(_write_fun),
+      buffer_offset(0), buffer_length(0), buffer_account(NULL),
+      next_flush_seq(0),
+      flushes_done_cond(NULL),
+      acks_scheduled(false),
+      drainer(new auto_drainer_t) { }
+
+write_combiner_t::~write_combiner_t() {
+    assert_thread();
+    // Whatever is left in the buffer was written after the last barrier, so nothing
+    // that needs to be crash safe depends on it.  But we have to wait for the
+    // flushes we started.
+    drainer.reset();
+    rassert(waiting_barriers.empty());
+    rassert(!acks_scheduled);
+}
+
+void write_combiner_t::write(int64_t offset, size_t length, const void *buf,
+                             void *account, linux_iocallback_t *cb) {
+    assert_thread();
+    append(offset, buf, length, account);
+    acknowledge(cb);
+}
+
+void write_combiner_t::writev(int64_t offset, size_t length, const iovec *bufs,
+                              size_t num_bufs, void *account, linux_iocallback_t *cb) {
+    assert_thread();
+    int64_t partial_offset = offset;
+    for (size_t i = 0; i < num_bufs; ++i) {
+        append(partial_offset, bufs[i].iov_base, bufs[i].iov_len, account);
+        partial_offset += bufs[i].iov_len;
+    }
+    guarantee(partial_offset - offset == static_cast<int64_t>(length));
+    acknowledge(cb);
+}
+
+void write_combiner_t::write_barrier(int64_t offset, size_t length, const void *buf,
+                                     void *account, linux_iocallback_t *cb) {
+    assert_thread();
+    // The barrier might overwrite a buffered range, so it must also come after the
+    // buffer's contents.
+    flush();
+    barrier_t barrier;
+    barrier.offset = offset;
+    barrier.length = length;
+    barrier.buf = buf;
+    barrier.account = account;
+    barrier.cb = cb;
+    barrier.flush_seq = next_flush_seq;
+    waiting_barriers.push_back(barrier);
+    maybe_pass_barriers();
+}
+
+void write_combiner_t::before_read(int64_t offset, size_t length) {
+    assert_thread();
+    if (buffer_length > 0
+        && offset < buffer_offset + static_cast<int64_t>(buffer_length)
+        && buffer_offset < offset + static_cast<int64_t>(length)) {
+        flush();
+    }
+}
+
+void write_combiner_t::flush_and_wait() {
+    assert_thread();
+    flush();
+    if (!flushes_in_flight.empty()) {
+        cond_t done;
+        rassert(flushes_done_cond == NULL);
+        flushes_done_cond = &done;
+        done.wait();
+    }
+}
+
+void write_combiner_t::append(int64_t offset, const void *buf, size_t length,
+                              void *account) {
+    if (buffer_length > 0
+        && offset != buffer_offset + static_cast<int64_t>(buffer_length)) {
+        flush();
+    }
+    const char *data = static_cast<const char *>(buf);
+    while (length > 0) {
+        if (buffer_length == 0) {
+            if (!buffer.has()) {
+                buffer.init(malloc_aligned(WRITE_COMBINING_BUFFER_SIZE,
+                                           DEVICE_BLOCK_SIZE));
+            }
+            buffer_offset = offset;
+            buffer_account = account;
+        }
+        const size_t n = std::min<size_t>(length,
+                                          WRITE_COMBINING_BUFFER_SIZE - buffer_length);
+        memcpy(buffer.get() + buffer_length, data, n);
+        buffer_length += n;
+        offset += n;
+        data += n;
+        length -= n;
+        if (buffer_length == WRITE_COMBINING_BUFFER_SIZE) {
+            flush();
+        }
+    }
+}
+
+void write_combiner_t::flush() {
+    if (buffer_length == 0) {
+        return;
+    }
+    const uint64_t seq = next_flush_seq++;
+    flushes_in_flight.insert(seq);
+    flush_t *f = new flush_t(this, seq, std::move(buffer));
+    const int64_t offset = buffer_offset;
+    const size_t length = buffer_length;
+    buffer_length = 0;
+    write_fun(offset, length, f->get_data(), buffer_account, f, false);
+}
+
+void write_combiner_t::on_flush_done(uint64_t seq) {
+    assert_thread();
+    flushes_in_flight.erase(seq);
+    maybe_pass_barriers();
+    if (flushes_in_flight.empty() && flushes_done_cond != NULL) {
+        cond_t *cond = flushes_done_cond;
+        flushes_done_cond = NULL;
+        cond->pulse();
+    }
+}
+
+void write_combiner_t::maybe_pass_barriers() {
+    while (!waiting_barriers.empty()
+           && (flushes_in_flight.empty()
+               || *flushes_in_flight.begin() >= waiting_barriers.front().flush_seq)) {
+        barrier_t barrier = waiting_barriers.front();
+        waiting_barriers.pop_front();
+        write_fun(barrier.offset, barrier.length, barrier.buf, barrier.account,
+                  barrier.cb, true);
+    }
+}
+
+void write_combiner_t::acknowledge(linux_iocallback_t *cb) {
+    pending_acks.push_back(cb);
+    if (!acks_scheduled) {
+        acks_scheduled = true;
+        call_later_on_this_thread(this);
+    }
+}
+
+void write_combiner_t::on_thread_switch() {
+    acks_scheduled = false;
+    std::vector<linux_iocallback_t *> acks;
+    acks.swap(pending_acks);
+    for (auto it = acks.begin(); it != acks.end(); ++it) {
+        (*it)->on_io_complete();
+    }
+}
@@ -0,0 +1,106 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_WRITE_COMBINING_HPP_
+#define ARCH_IO_DISK_WRITE_COMBINING_HPP_
+
+#include <sys/uio.h>
+
+#include <deque>
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "arch/types.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
+
+/* `write_combiner_t` sits between a `linux_file_t` in write combining mode and the
+disk manager.  Network-attached block storage charges for (and is limited by) the
+number of I/O operations, whatever their size, so it does badly with the small
+writes the serializer makes when it's not writing whole extents.
+
+Writes to contiguous ranges are copied into a buffer of WRITE_COMBINING_BUFFER_SIZE
+bytes, which is written out as a single request when it's full, or when a write
+doesn't continue where the previous one ended.  The writes are acknowledged as soon
+as they have been copied, so this is write-back caching: until a barrier, an
+acknowledged write may not be on disk.
+
+Writes that are wrapped in datasyncs (the serializer's metablock writes, which make
+the preceding writes reachable) are barriers.  A barrier flushes the buffer and is
+only passed on to the disk manager once every write acknowledged before it has been
+written, so its datasyncs cover them.  That keeps the serializer's crash safety: the
+writes a metablock refers to are on disk before it is.
+
+Reads overlapping the buffer flush it first.  The disk manager orders them after the
+flush, like any read after a write to the same range. */
+class write_combiner_t : private linux_thread_message_t,
+                         public home_thread_mixin_debug_only_t {
+public:
+    // Passes a write on to the disk manager.  The account is a disk manager account.
+    typedef std::function<void(int64_t offset, size_t length, const void *buf,
+                               void *account, linux_iocallback_t *cb,
+                               bool wrap_in_datasyncs)> write_fun_t;
+
+    explicit write_combiner_t(const write_fun_t &write_fun);
+    ~write_combiner_t();
+
+    // Copies the data, and calls cb->on_io_complete() from the event loop soon after.
+    void write(int64_t offset, size_t length, const void *buf, void *account,
+               linux_iocallback_t *cb);
+    void writev(int64_t offset, size_t length, const iovec *bufs, size_t num_bufs,
+                void *account, linux_iocallback_t *cb);
+
+    // buf must stay valid until cb is called, like for any write.
+    void write_barrier(int64_t offset, size_t length, const void *buf, void *account,
+                       linux_iocallback_t *cb);
+
+    // Must be called before reading [offset, offset + length).
+    void before_read(int64_t offset, size_t length);
+
+    // Blocks until every write acknowledged so far is on disk.
+    void flush_and_wait();
+
+private:
+    class flush_t;
+    struct barrier_t {
+        int64_t offset;
+        size_t length;
+        const void *buf;
+        void *account;
+        linux_iocallback_t *cb;
+        // The barrier waits for the flushes with lower sequence numbers.
+        uint64_t flush_seq;
+    };
+
+    void append(int64_t offset, const void *buf, size_t length, void *account);
+    void flush();
+    void on_flush_done(uint64_t seq);
+    void maybe_pass_barriers();
+    void acknowledge(linux_iocallback_t *cb);
+    void on_thread_switch();
+
+    const write_fun_t write_fun;
+
+    // The buffered range is [buffer_offset, buffer_offset + buffer_length).
+    scoped_malloc_t<char> buffer;
+    int64_t buffer_offset;
+    size_t buffer_length;
+    // The account of the first write in the buffer.
+    void *buffer_account;
+
+    uint64_t next_flush_seq;
+    std::set<uint64_t> flushes_in_flight;
+    std::deque<barrier_t> waiting_barriers;
+    // Pulsed by on_flush_done() when flushes_in_flight becomes empty.
+    cond_t *flushes_done_cond;
+
+    std::vector<linux_iocallback_t *> pending_acks;
+    bool acks_scheduled;
+
+    scoped_ptr_t<auto_drainer_t> drainer;
+
+    DISABLE_COPYING(write_combiner_t);
+};
+
+#endif  // ARCH_IO_DISK_WRITE_COMBINING_HPP_
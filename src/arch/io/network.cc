@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
@@ -11,6 +12,9 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
+
+#include <algorithm>
 
 #include "utils.hpp"
 #include <boost/bind.hpp>
@@ -74,6 +78,16 @@ int connect_ipv6_internal(fd_t socket, int local_port, const in6_addr &addr, int
     return res;
 }
 
+/* Fills in the address of the socket named `name` in the abstract namespace,
+which starts with a zero byte, and returns its length. */
+socklen_t make_local_sockaddr(const std::string &name, sockaddr_un *sa) {
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    guarantee(name.size() + 1 <= sizeof(sa->sun_path));
+    memcpy(sa->sun_path + 1, name.data(), name.size());
+    return offsetof(sockaddr_un, sun_path) + 1 + name.size();
+}
+
 int create_socket_wrapper(int address_family) {
     int res = socket(address_family, SOCK_STREAM, 0);
     if (res == INVALID_FD) {
@@ -96,10 +110,15 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
         sock(create_socket_wrapper(peer.get_address_family())),
         event_watcher(new linux_event_watcher_t(sock.get(), this)),
         read_in_progress(false), write_in_progress(false),
+        read_buffer_start(0), read_buffer_end(0),
+        read_chunk_size(IO_BUFFER_SIZE),
         write_handler(this),
         write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
         write_coro_pool(1, &write_queue, &write_handler),
         current_write_buffer(get_write_buffer()),
+        coalesced_flush(this),
+        coalesced_flush_scheduled(false),
+        coalesced_data_pending(false),
         drainer(new auto_drainer_t) {
     guarantee_err(fcntl(sock.get(), F_SETFL, O_NONBLOCK) == 0, "Could not make socket non-blocking");
 
@@ -137,15 +156,55 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
     }
 }
 
+linux_tcp_conn_t::linux_tcp_conn_t(const std::string &local_name,
+                                   signal_t *interruptor) THROWS_ONLY(connect_failed_exc_t, interrupted_exc_t) :
+        write_perfmon(NULL),
+        sock(create_socket_wrapper(AF_UNIX)),
+        event_watcher(new linux_event_watcher_t(sock.get(), this)),
+        read_in_progress(false), write_in_progress(false),
+        read_buffer_start(0), read_buffer_end(0),
+        read_chunk_size(IO_BUFFER_SIZE),
+        write_handler(this),
+        write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
+        write_coro_pool(1, &write_queue, &write_handler),
+        current_write_buffer(get_write_buffer()),
+        coalesced_flush(this),
+        coalesced_flush_scheduled(false),
+        coalesced_data_pending(false),
+        drainer(new auto_drainer_t) {
+    guarantee_err(fcntl(sock.get(), F_SETFL, O_NONBLOCK) == 0, "Could not make socket non-blocking");
+
+    sockaddr_un sa;
+    socklen_t sa_len = make_local_sockaddr(local_name, &sa);
+    int res;
+    do {
+        res = connect(sock.get(), reinterpret_cast<sockaddr *>(&sa), sa_len);
+    } while (res == -1 && get_errno() == EINTR);
+
+    /* Unlike TCP, a Unix domain socket either connects right away or fails with
+    `EAGAIN` when the listener's backlog is full. */
+    if (res != 0) {
+        throw linux_tcp_conn_t::connect_failed_exc_t(get_errno());
+    }
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+}
+
 linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
     write_perfmon(NULL),
     sock(s),
     event_watcher(new linux_event_watcher_t(sock.get(), this)),
     read_in_progress(false), write_in_progress(false),
+    read_buffer_start(0), read_buffer_end(0),
+    read_chunk_size(IO_BUFFER_SIZE),
     write_handler(this),
     write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
     write_coro_pool(1, &write_queue, &write_handler),
     current_write_buffer(get_write_buffer()),
+    coalesced_flush(this),
+    coalesced_flush_scheduled(false),
+    coalesced_data_pending(false),
     drainer(new auto_drainer_t)
 {
     rassert(sock.get() != INVALID_FD);
@@ -192,6 +251,26 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
     assert_thread();
     rassert(!read_closed.is_pulsed());
 
+    while (tls.has()) {
+        size_t bytes;
+        tls_conn_t::result_t res = tls->read(buffer, size, &bytes);
+        if (res == tls_conn_t::done) {
+            return bytes;
+        } else if (res == tls_conn_t::want_read || res == tls_conn_t::want_write) {
+            wait_for_tls(res, poll_event_in, &read_closed);
+            if (read_closed.is_pulsed()) {
+                throw tcp_conn_read_closed_exc_t();
+            }
+        } else {
+            if (res == tls_conn_t::failed) {
+                logERR("Could not read from TLS connection: %s",
+                       tls_conn_t::error_string().c_str());
+            }
+            on_shutdown_read();
+            throw tcp_conn_read_closed_exc_t();
+        }
+    }
+
     while (true) {
         ssize_t res = ::read(sock.get(), buffer, size);
 
@@ -231,49 +310,170 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
     }
 }
 
+void linux_tcp_conn_t::wait_for_tls(tls_conn_t::result_t res, int own_event,
+                                    signal_t *closed) {
+    rassert(res == tls_conn_t::want_read || res == tls_conn_t::want_write);
+    const int event = res == tls_conn_t::want_read ? poll_event_in : poll_event_out;
+    if (event == own_event) {
+        linux_event_watcher_t::watch_t watch(event_watcher.get(), event);
+        wait_any_t waiter(&watch, closed);
+        waiter.wait_lazily_unordered();
+    } else {
+        signal_timer_t timer;
+        timer.start(TLS_POLL_INTERVAL_MS);
+        wait_any_t waiter(&timer, closed);
+        waiter.wait_lazily_unordered();
+    }
+}
+
+void linux_tcp_conn_t::start_tls(tls_ctx_t *ctx, bool is_server, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
+    assert_thread();
+    rassert(!tls.has());
+    rassert(!read_in_progress && !write_in_progress);
+    rassert(read_buffer_size() == 0);
+    rassert(current_write_buffer->size == 0);
+
+    tls.init(new tls_conn_t(ctx, sock.get(), is_server));
+
+    /* The handshake both reads and writes, so nothing else may do either until
+    it's done. */
+    read_in_progress = write_in_progress = true;
+    wait_any_t stop(closer, &read_closed, &write_closed);
+    bool succeeded = false;
+    while (!stop.is_pulsed()) {
+        tls_conn_t::result_t res = tls->handshake();
+        if (res == tls_conn_t::done) {
+            succeeded = true;
+            break;
+        } else if (res == tls_conn_t::want_read || res == tls_conn_t::want_write) {
+            wait_for_tls(res, res == tls_conn_t::want_read ? poll_event_in : poll_event_out,
+                         &stop);
+        } else {
+            ip_address_t peer;
+            std::string peer_str = getpeername(&peer) == 0 ? peer.to_string() : "unknown";
+            logWRN("TLS handshake with %s failed: %s", peer_str.c_str(),
+                   res == tls_conn_t::failed ? tls_conn_t::error_string().c_str()
+                                             : "the connection was closed");
+            break;
+        }
+    }
+    read_in_progress = write_in_progress = false;
+
+    if (!succeeded) {
+        if (is_read_open()) {
+            shutdown_read();
+        }
+        if (is_write_open()) {
+            shutdown_write();
+        }
+        throw tcp_conn_read_closed_exc_t();
+    }
+}
+
+void linux_tcp_conn_t::consume_read_buffer(void *buf, size_t size) {
+    rassert(size <= read_buffer_size());
+    if (size > 0) {
+        memcpy(buf, read_buffer_data(), size);
+        pop_read_buffer(size);
+    }
+}
+
+void linux_tcp_conn_t::pop_read_buffer(size_t size) {
+    rassert(size <= read_buffer_size());
+    read_buffer_start += size;
+    if (read_buffer_start == read_buffer_end) {
+        read_buffer_start = read_buffer_end = 0;
+        /* Don't hold on to a big buffer once the connection has gone quiet. */
+        if (read_buffer.has() && read_buffer.size() > 2 * read_chunk_size) {
+            read_buffer.reset();
+        }
+    }
+}
+
+void linux_tcp_conn_t::fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t) {
+    const size_t chunk = read_chunk_size;
+    const size_t capacity = read_buffer.has() ? read_buffer.size() : 0;
+    if (capacity - read_buffer_end < chunk) {
+        /* Move the unconsumed data to the front of a buffer with enough room. We
+        reuse the current buffer if it's big enough and the consumed prefix is at
+        least as big as what's left, so that moving the data costs no more than
+        the reads that consumed it. */
+        const size_t unconsumed = read_buffer_size();
+        if (unconsumed + chunk <= capacity && read_buffer_start >= unconsumed) {
+            memmove(read_buffer.data(), read_buffer_data(), unconsumed);
+        } else {
+            scoped_array_t<char> new_buffer(std::max(unconsumed + chunk, capacity));
+            if (unconsumed > 0) {
+                memcpy(new_buffer.data(), read_buffer_data(), unconsumed);
+            }
+            read_buffer.swap(new_buffer);
+        }
+        read_buffer_start = 0;
+        read_buffer_end = unconsumed;
+    }
+
+    size_t delta = read_internal(read_buffer.data() + read_buffer_end, chunk);
+    read_buffer_end += delta;
+
+    if (delta == chunk) {
+        read_chunk_size = std::min<size_t>(2 * chunk, TCP_MAX_READ_CHUNK_SIZE);
+    } else if (delta < chunk / 4) {
+        read_chunk_size = std::max<size_t>(chunk / 2, IO_BUFFER_SIZE);
+    }
+}
+
 size_t linux_tcp_conn_t::read_some(void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     rassert(size > 0);
     read_op_wrapper_t sentry(this, closer);
 
-    if (read_buffer.size()) {
-        /* Return the data from the peek buffer */
-        size_t read_buffer_bytes = std::min(read_buffer.size(), size);
-        memcpy(buf, read_buffer.data(), read_buffer_bytes);
-        read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
-        return read_buffer_bytes;
-    } else {
-        /* Go to the kernel _once_. */
-        return read_internal(buf, size);
+    if (read_buffer_size() == 0) {
+        if (size >= read_chunk_size) {
+            /* Go to the kernel _once_, straight into the caller's buffer. */
+            return read_internal(buf, size);
+        }
+        /* Go to the kernel _once_, for as much as it has, so that the next small
+        reads don't need to. */
+        fill_read_buffer();
     }
+
+    /* Return the data from the peek buffer */
+    size_t read_buffer_bytes = std::min(read_buffer_size(), size);
+    consume_read_buffer(buf, read_buffer_bytes);
+    return read_buffer_bytes;
 }
 
 void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
 
     /* First, consume any data in the peek buffer */
-    int read_buffer_bytes = std::min(read_buffer.size(), size);
-    memcpy(buf, read_buffer.data(), read_buffer_bytes);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
+    size_t read_buffer_bytes = std::min(read_buffer_size(), size);
+    consume_read_buffer(buf, read_buffer_bytes);
     buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + read_buffer_bytes);
     size -= read_buffer_bytes;
 
-    /* Now go to the kernel for any more data that we need */
+    /* Now go to the kernel for any more data that we need. Big reads go straight
+    into `buf`; small ones go through the peek buffer, which then keeps whatever
+    else the kernel had for us. */
     while (size > 0) {
-        size_t delta = read_internal(buf, size);
-        rassert(delta <= size);
-        buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + delta);
-        size -= delta;
+        if (size >= read_chunk_size) {
+            size_t delta = read_internal(buf, size);
+            rassert(delta <= size);
+            buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + delta);
+            size -= delta;
+        } else {
+            fill_read_buffer();
+            size_t delta = std::min(read_buffer_size(), size);
+            consume_read_buffer(buf, delta);
+            buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + delta);
+            size -= delta;
+        }
     }
 }
 
 void linux_tcp_conn_t::read_more_buffered(signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
 
-    size_t old_size = read_buffer.size();
-    read_buffer.resize(old_size + IO_BUFFER_SIZE);
-    size_t delta = read_internal(read_buffer.data() + old_size, IO_BUFFER_SIZE);
-
-    read_buffer.resize(old_size + delta);
+    fill_read_buffer();
 }
 
 const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -281,14 +481,14 @@ const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_
     rassert(!read_in_progress);   // Is there a read already in progress?
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
-    return const_charslice(read_buffer.data(), read_buffer.data() + read_buffer.size());
+    return const_charslice(read_buffer_data(), read_buffer_data() + read_buffer_size());
 }
 
 const_charslice linux_tcp_conn_t::peek(size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
-    while (read_buffer.size() < size) {
+    while (read_buffer_size() < size) {
         read_more_buffered(closer);
     }
-    return const_charslice(read_buffer.data(), read_buffer.data() + size);
+    return const_charslice(read_buffer_data(), read_buffer_data() + size);
 }
 
 void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -297,7 +497,7 @@ void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_re
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
     peek(len, closer);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + len);  // INEFFICIENT
+    pop_read_buffer(len);
 }
 
 void linux_tcp_conn_t::shutdown_read() {
@@ -325,7 +525,9 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
+    if (operation->iov != NULL) {
+        parent->perform_writev(operation->iov, operation->iovcnt);
+    } else if (operation->buffer != NULL) {
         parent->perform_write(operation->buffer, operation->size);
         if (operation->dealloc != NULL) {
             parent->release_write_buffer(operation->dealloc);
@@ -342,15 +544,20 @@ void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *ope
 }
 
 void linux_tcp_conn_t::internal_flush_write_buffer() {
+    rassert(write_in_progress);
+    queue_current_write_buffer(true);
+}
+
+void linux_tcp_conn_t::queue_current_write_buffer(bool block) {
     write_queue_op_t *op = get_write_queue_op();
     assert_thread();
-    rassert(write_in_progress);
 
     /* Swap in a new write buffer, and set up the old write buffer to be
     released once the write is over. */
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
     op->dealloc = current_write_buffer.release();
+    op->iov = NULL;
     op->cond = NULL;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
     current_write_buffer.init(get_write_buffer());
@@ -359,12 +566,47 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     to be released once the write is completed by the coroutine pool */
     rassert(op->size <= WRITE_CHUNK_SIZE);
     rassert(WRITE_CHUNK_SIZE < WRITE_QUEUE_MAX_SIZE);
-    write_queue_limiter.co_lock(op->size);
+    if (block) {
+        write_queue_limiter.co_lock(op->size);
+    } else {
+        write_queue_limiter.force_lock(op->size);
+    }
 
     write_queue.push(op);
 }
 
+void linux_tcp_conn_t::schedule_coalesced_flush() {
+    assert_thread();
+    if (!coalesced_flush_scheduled) {
+        coalesced_flush_scheduled = true;
+        coalesced_flush.keepalive = auto_drainer_t::lock_t(drainer.get());
+        call_later_on_this_thread(&coalesced_flush);
+    }
+}
+
+void linux_tcp_conn_t::coalesced_flush_t::on_thread_switch() {
+    auto_drainer_t::lock_t lock(std::move(keepalive));
+    parent->coalesced_flush_scheduled = false;
+    /* If a write is in progress, the write will schedule us again when it's done
+    (see `write_op_wrapper_t`). We can't block here, so we push the buffer past the
+    semaphore's limit; but only one chunk per event loop pass, and write_coalesced()
+    itself still blocks when the queue is backed up. */
+    if (!parent->write_in_progress && parent->coalesced_data_pending) {
+        parent->coalesced_data_pending = false;
+        if (!parent->write_closed.is_pulsed() && parent->current_write_buffer->size > 0) {
+            parent->queue_current_write_buffer(false);
+        }
+    }
+}
+
 void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+    iovec iov;
+    iov.iov_base = const_cast<void *>(buf);
+    iov.iov_len = size;
+    perform_writev(&iov, 1);
+}
+
+void linux_tcp_conn_t::perform_writev(const iovec *iov_in, size_t iovcnt) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -374,8 +616,22 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    if (tls.has() && !tls->kernel_encrypts_writes()) {
+        perform_tls_writev(iov_in, iovcnt);
+        return;
+    }
+
+    /* `::writev()` may write only part of the buffers, so we keep our own copy
+    of the ones that are left and trim it as we go. */
+    std::vector<iovec> iov(iov_in, iov_in + iovcnt);
+    size_t next = 0;
+    while (next < iov.size() && iov[next].iov_len == 0) {
+        ++next;
+    }
+
+    while (next < iov.size()) {
+        const int count = std::min<size_t>(iov.size() - next, IOV_MAX);
+        ssize_t res = ::writev(sock.get(), &iov[next], count);
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
@@ -413,10 +669,47 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) write_perfmon->record(res);
+            size_t written = res;
+            while (next < iov.size() && written >= iov[next].iov_len) {
+                written -= iov[next].iov_len;
+                ++next;
+            }
+            if (written > 0) {
+                rassert(next < iov.size());
+                iov[next].iov_base = static_cast<char *>(iov[next].iov_base) + written;
+                iov[next].iov_len -= written;
+            }
+        }
+    }
+}
+
+void linux_tcp_conn_t::perform_tls_writev(const iovec *iov, size_t iovcnt) {
+    /* OpenSSL has no gather write, so the buffers go out one at a time; it
+    combines them into records of its own anyway. */
+    for (size_t i = 0; i < iovcnt; ++i) {
+        const char *data = static_cast<const char *>(iov[i].iov_base);
+        size_t left = iov[i].iov_len;
+        while (left > 0) {
+            size_t written;
+            tls_conn_t::result_t res = tls->write(data, left, &written);
+            if (res == tls_conn_t::done) {
+                if (write_perfmon) write_perfmon->record(written);
+                data += written;
+                left -= written;
+            } else if (res == tls_conn_t::want_read || res == tls_conn_t::want_write) {
+                wait_for_tls(res, poll_event_out, &write_closed);
+                if (write_closed.is_pulsed()) {
+                    return;
+                }
+            } else {
+                if (res == tls_conn_t::failed) {
+                    logERR("Could not write to TLS connection: %s",
+                           tls_conn_t::error_string().c_str());
+                }
+                on_shutdown_write();
+                return;
+            }
         }
     }
 }
@@ -436,6 +729,8 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Enqueue the write so it will happen eventually */
     op.buffer = buf;
     op.size = size;
+    op.iov = NULL;
+    op.iovcnt = 0;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -448,6 +743,30 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
+void linux_tcp_conn_t::writev(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
+
+    /* As in `write()`, we block until the write is done, so the caller's buffers
+    stay valid and we don't need the write semaphore. */
+    op.buffer = NULL;
+    op.size = 0;
+    op.iov = iov;
+    op.iovcnt = iovcnt;
+    op.dealloc = NULL;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    to_signal_when_done.wait();
+
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
 void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -471,6 +790,14 @@ void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *c
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
+void linux_tcp_conn_t::write_coalesced(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_buffered(buf, size, closer);
+    if (current_write_buffer->size > 0) {
+        coalesced_data_pending = true;
+        schedule_coalesced_flush();
+    }
+}
+
 void linux_tcp_conn_t::writef(signal_t *closer, const char *format, ...) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     va_list ap;
     va_start(ap, format);
@@ -495,6 +822,7 @@ void linux_tcp_conn_t::flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write
     write_queue_op_t op;
     cond_t to_signal_when_done;
     op.buffer = NULL;
+    op.iov = NULL;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -551,6 +879,8 @@ void linux_tcp_conn_t::rethread(threadnum_t new_thread) {
     if (home_thread() == get_thread_id() && new_thread == INVALID_THREAD) {
         rassert(!read_in_progress);
         rassert(!write_in_progress);
+        // The flush would be delivered on this thread. Call flush_buffer() first.
+        rassert(!coalesced_flush_scheduled);
         rassert(event_watcher.has());
         event_watcher.reset();
 
@@ -579,7 +909,12 @@ int linux_tcp_conn_t::getsockname(ip_address_t *ip) {
     socklen_t mutable_buflength = buflength;
     int res = ::getsockname(sock.get(), reinterpret_cast<sockaddr *>(&buf[0]), &mutable_buflength);
     if (res == 0) {
-        *ip = ip_address_t(reinterpret_cast<sockaddr *>(&buf[0]));
+        if (reinterpret_cast<sockaddr *>(&buf[0])->sa_family == AF_UNIX) {
+            // Connections over a local socket never leave the host.
+            *ip = ip_address_t("127.0.0.1");
+        } else {
+            *ip = ip_address_t(reinterpret_cast<sockaddr *>(&buf[0]));
+        }
     }
     return res;
 }
@@ -590,7 +925,12 @@ int linux_tcp_conn_t::getpeername(ip_address_t *ip) {
     socklen_t mutable_buflength = buflength;
     int res = ::getpeername(sock.get(), reinterpret_cast<sockaddr *>(&buf[0]), &mutable_buflength);
     if (res == 0) {
-        *ip = ip_address_t(reinterpret_cast<sockaddr *>(&buf[0]));
+        if (reinterpret_cast<sockaddr *>(&buf[0])->sa_family == AF_UNIX) {
+            // Connections over a local socket never leave the host.
+            *ip = ip_address_t("127.0.0.1");
+        } else {
+            *ip = ip_address_t(reinterpret_cast<sockaddr *>(&buf[0]));
+        }
     }
     return res;
 }
@@ -633,10 +973,12 @@ void linux_tcp_conn_descriptor_t::make_overcomplicated(linux_tcp_conn_t **tcp_co
 /* Network listener object */
 linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
         const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb) :
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb,
+        bool _reuse_port) :
     callback(cb),
     local_addresses(bind_addresses),
     port(_port),
+    reuse_port(_reuse_port),
     bound(false),
     socks(),
     last_used_socket_index(0),
@@ -707,6 +1049,15 @@ int linux_nonthrowing_tcp_listener_t::init_sockets() {
         int res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set REUSEADDR option");
 
+        if (reuse_port) {
+#ifdef SO_REUSEPORT
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+            guarantee_err(res != -1, "Could not set REUSEPORT option");
+#else
+            crash("SO_REUSEPORT is not supported on this platform");
+#endif
+        }
+
         /* XXX Making our socket NODELAY prevents the problem where responses to
          * pipelined requests are delayed, since the TCP Nagle algorithm will
          * notice when we send multiple small packets and try to coalesce them. But
@@ -937,8 +1288,137 @@ void linux_nonthrowing_tcp_listener_t::on_event(int) {
     via event_listener.watch(). */
 }
 
+linux_local_listener_t::linux_local_listener_t(
+        const std::string &_name,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb) :
+    name(_name), callback(cb) { }
+
+linux_local_listener_t::~linux_local_listener_t() {
+    /* Interrupt the accept loop */
+    accept_loop_drainer.reset();
+}
+
+bool linux_local_listener_t::begin_listening() {
+    rassert(sock.get() == INVALID_FD);
+    sock.reset(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (sock.get() == INVALID_FD) {
+        return false;
+    }
+
+    sockaddr_un sa;
+    socklen_t sa_len = make_local_sockaddr(name, &sa);
+    if (bind(sock.get(), reinterpret_cast<sockaddr *>(&sa), sa_len) != 0) {
+        sock.reset();
+        return false;
+    }
+
+    const int RDB_LISTEN_BACKLOG = 256;
+    int res = listen(sock.get(), RDB_LISTEN_BACKLOG);
+    guarantee_err(res == 0, "Couldn't listen to the socket");
+    res = fcntl(sock.get(), F_SETFL, O_NONBLOCK);
+    guarantee_err(res == 0, "Could not make socket non-blocking");
+
+    event_watcher.init(new linux_event_watcher_t(sock.get(), this));
+    accept_loop_drainer.init(new auto_drainer_t);
+    coro_t::spawn_sometime(std::bind(
+        &linux_local_listener_t::accept_loop, this, auto_drainer_t::lock_t(accept_loop_drainer.get())));
+    return true;
+}
+
+void linux_local_listener_t::accept_loop(auto_drainer_t::lock_t lock) {
+    bool log_next_error = true;
+    while (!lock.get_drain_signal()->is_pulsed()) {
+        fd_t new_sock = accept(sock.get(), NULL, NULL);
+
+        if (new_sock != INVALID_FD) {
+            coro_t::spawn_now_dangerously(std::bind(&linux_local_listener_t::handle, this, new_sock));
+            log_next_error = true;
+        } else if (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK) {
+            linux_event_watcher_t::watch_t watch(event_watcher.get(), poll_event_in);
+            wait_any_t waiter(&watch, lock.get_drain_signal());
+            waiter.wait_lazily_unordered();
+        } else if (get_errno() == EINTR) {
+            /* Harmless error; just try again. */
+        } else {
+            if (log_next_error) {
+                logERR("accept() failed: %s.", errno_string(get_errno()).c_str());
+                log_next_error = false;
+            }
+            try {
+                nap(100, lock.get_drain_signal());
+            } catch (const interrupted_exc_t &) {
+                return;
+            }
+        }
+    }
+}
+
+void linux_local_listener_t::handle(fd_t socket) {
+    scoped_ptr_t<linux_tcp_conn_descriptor_t> nconn(new linux_tcp_conn_descriptor_t(socket));
+    callback(nconn);
+}
+
+void linux_local_listener_t::on_event(int) {
+    /* This is only called in cases of error; normal input events are recieved
+    via event_listener.watch(). */
+}
+
 void noop_fun(UNUSED const scoped_ptr_t<linux_tcp_conn_descriptor_t>& arg) { }
 
+bool tcp_reuse_port_is_supported() {
+#ifdef SO_REUSEPORT
+    scoped_fd_t sock(socket(AF_INET, SOCK_STREAM, 0));
+    if (sock.get() == INVALID_FD) {
+        return false;
+    }
+    int sockoptval = 1;
+    return setsockopt(sock.get(), SOL_SOCKET, SO_REUSEPORT,
+                      &sockoptval, sizeof(sockoptval)) == 0;
+#else
+    return false;
+#endif
+}
+
+linux_reuseport_tcp_listener_t::linux_reuseport_tcp_listener_t(
+        const std::set<ip_address_t> &bind_addresses, int _port, int num_threads,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback) :
+    listeners(num_threads),
+    port(_port)
+{
+    guarantee(num_threads > 0);
+    /* The first listener picks the port if we were given `ANY_PORT`; the others bind
+    to the same one. The thread switches only happen at startup. */
+    bool listening = true;
+    for (int i = 0; i < num_threads && listening; ++i) {
+        on_thread_t thread_switcher((threadnum_t(i)));
+        listeners[i].init(new linux_nonthrowing_tcp_listener_t(bind_addresses, port,
+                                                               callback, true));
+        listening = listeners[i]->begin_listening();
+        if (i == 0) {
+            port = listeners[i]->get_port();
+        }
+    }
+
+    if (!listening) {
+        for (int i = 0; i < num_threads; ++i) {
+            on_thread_t thread_switcher((threadnum_t(i)));
+            listeners[i].reset();
+        }
+        throw address_in_use_exc_t("localhost", port);
+    }
+}
+
+linux_reuseport_tcp_listener_t::~linux_reuseport_tcp_listener_t() {
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        on_thread_t thread_switcher((threadnum_t(i)));
+        listeners[i].reset();
+    }
+}
+
+int linux_reuseport_tcp_listener_t::get_port() const {
+    return port;
+}
+
 linux_tcp_bound_socket_t::linux_tcp_bound_socket_t(const std::set<ip_address_t> &bind_addresses, int port) :
     listener(new linux_nonthrowing_tcp_listener_t(bind_addresses, port, noop_fun))
 {
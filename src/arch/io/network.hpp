@@ -8,6 +8,7 @@
 #include <ifaddrs.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/uio.h>
 
 #include <set>
 #include <stdexcept>
@@ -22,6 +23,7 @@
 #include "arch/address.hpp"
 #include "arch/io/event_watcher.hpp"
 #include "arch/io/io_utils.hpp"
+#include "arch/io/tls.hpp"
 #include "arch/runtime/event_queue.hpp"
 #include "arch/types.hpp"
 #include "concurrency/cond_var.hpp"
@@ -58,6 +60,10 @@ public:
     // NB. interruptor cannot be NULL.
     linux_tcp_conn_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port = ANY_PORT) THROWS_ONLY(connect_failed_exc_t, interrupted_exc_t);
 
+    /* Connects to the `linux_local_listener_t` listening under `local_name` on
+    this host, over a Unix domain socket instead of TCP. */
+    linux_tcp_conn_t(const std::string &local_name, signal_t *interruptor) THROWS_ONLY(connect_failed_exc_t, interrupted_exc_t);
+
     /* Reading */
 
     /* If you know beforehand how many bytes you want to read, use read() with a
@@ -104,11 +110,25 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* writev() is like write(), but sends the `iovcnt` buffers described by `iov`
+    in order, without copying them.  They are handed to the kernel in as few
+    `::writev()` calls as the socket allows, so use this instead of calling
+    write() once per buffer when the data is already split into segments (for
+    example a serialized `write_message_t`). */
+    void writev(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
     void write_buffered(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* write_coalesced() is like write_buffered(), but you don't need to flush: the
+    buffered data is sent once the event loop has handled the other work that is
+    ready on this thread. Small writes made close together, such as responses to
+    pipelined requests, go out in one system call and packet instead of one each.
+    Like write_buffered(), it only blocks if the write queue is backed up. */
+    void write_coalesced(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     void writef(signal_t *closer, const char *format, ...) THROWS_ONLY(tcp_conn_write_closed_exc_t) __attribute__ ((format (printf, 3, 4)));
 
     void flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);   // Blocks until flush is done
@@ -121,6 +141,18 @@ public:
     /* Returns false if the half of the pipe that goes from us to the peer has been closed. */
     bool is_write_open();
 
+    /* Encryption */
+
+    /* start_tls() does a TLS handshake with the peer, as the server if
+    `is_server` is true, and from then on everything read and written is
+    encrypted. It must be called before anything else is read or written. If the
+    handshake fails (for example because the peer's certificate isn't trusted) or
+    `closer` is pulsed, it closes the connection and throws
+    tcp_conn_read_closed_exc_t. `ctx` must outlive the connection. */
+    void start_tls(tls_ctx_t *ctx, bool is_server, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t);
+
+    bool is_tls() const { return tls.has(); }
+
     /* Put a `perfmon_rate_monitor_t` here if you want to record stats on how fast data is being
     transmitted over the network. */
     perfmon_rate_monitor_t *write_perfmon;
@@ -194,6 +226,9 @@ private:
         }
         ~write_op_wrapper_t() {
             parent->write_in_progress = false;
+            if (parent->coalesced_data_pending) {
+                parent->schedule_coalesced_flush();
+            }
         }
     private:
         void run() {
@@ -223,13 +258,44 @@ private:
     /* These are pulsed if and only if the read/write end of the connection has been closed. */
     cond_t read_closed, write_closed;
 
-    /* Holds data that we read from the socket but hasn't been consumed yet */
-    std::vector<char> read_buffer;
+    /* Holds data that we read from the socket but hasn't been consumed yet. The
+    unconsumed data is `read_buffer[read_buffer_start, read_buffer_end)`; consuming
+    data just advances `read_buffer_start`, and the consumed prefix is dropped when
+    we need the room. */
+    scoped_array_t<char> read_buffer;
+    size_t read_buffer_start, read_buffer_end;
+
+    /* How much we ask the kernel for when we fill `read_buffer`. See
+    `TCP_MAX_READ_CHUNK_SIZE`. */
+    size_t read_chunk_size;
+
+    size_t read_buffer_size() const { return read_buffer_end - read_buffer_start; }
+    const char *read_buffer_data() const {
+        return read_buffer.has() ? read_buffer.data() + read_buffer_start : NULL;
+    }
+
+    /* Moves `size` bytes out of `read_buffer`, which must hold that many. */
+    void consume_read_buffer(void *buf, size_t size);
+    void pop_read_buffer(size_t size);
+
+    /* Makes one call to read_internal() for up to `read_chunk_size` more bytes
+    in `read_buffer`, and adapts `read_chunk_size` to how much we got. */
+    void fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
     /* Reads up to the given number of bytes, but not necessarily that many. Simple wrapper around
     ::read(). Returns the number of bytes read or throws tcp_conn_read_closed_exc_t. Bypasses read_buffer. */
     size_t read_internal(void *buffer, size_t size) THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
+    /* Waits until a `tls` operation that returned `res` (`want_read` or
+    `want_write`) can be retried, or `closed` is pulsed. `own_event` is the event
+    the calling half of the connection watches for. The other half may be watching
+    the other event, so if `res` asks for that one we poll for it instead; it only
+    happens for TLS control messages, which are rare. */
+    void wait_for_tls(tls_conn_t::result_t res, int own_event, signal_t *closed);
+
+    /* The TLS state, if start_tls() has been called. */
+    scoped_ptr_t<tls_conn_t> tls;
+
     static const size_t WRITE_QUEUE_MAX_SIZE = 128 * KILOBYTE;
     static const size_t WRITE_CHUNK_SIZE = 8 * KILOBYTE;
 
@@ -243,6 +309,9 @@ private:
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        // If non-NULL, the op writes these buffers instead of `buffer`.
+        const iovec *iov;
+        size_t iovcnt;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
@@ -282,6 +351,11 @@ private:
     data to be completely written. */
     void internal_flush_write_buffer();
 
+    /* Does the work of internal_flush_write_buffer(). If `block` is false, it
+    doesn't wait for the `write_queue_limiter` semaphore, and the queue may go over
+    its limit by one chunk. */
+    void queue_current_write_buffer(bool block);
+
     /* Used to queue up buffers to write. The functions in `write_queue` will all be
     `std::bind()`s of the `perform_write()` function below. */
     unlimited_fifo_queue_t<write_queue_op_t*, intrusive_list_t<write_queue_op_t> > write_queue;
@@ -297,9 +371,28 @@ private:
     certain size, we push it onto `write_queue`. */
     scoped_ptr_t<write_buffer_t> current_write_buffer;
 
+    /* Sends what write_coalesced() buffered, from the event loop. */
+    class coalesced_flush_t : public linux_thread_message_t {
+    public:
+        explicit coalesced_flush_t(linux_tcp_conn_t *_parent) : parent(_parent) { }
+        // Keeps the connection alive until the message is delivered.
+        auto_drainer_t::lock_t keepalive;
+    private:
+        void on_thread_switch();
+        linux_tcp_conn_t *parent;
+    } coalesced_flush;
+    bool coalesced_flush_scheduled;
+    /* True if write_coalesced() buffered data that hasn't been flushed yet. */
+    bool coalesced_data_pending;
+    void schedule_coalesced_flush();
+
     /* Used to actually perform a write. If the write end of the connection is open, then writes
     `size` bytes from `buffer` to the socket. */
     void perform_write(const void *buffer, size_t size);
+    void perform_writev(const iovec *iov, size_t iovcnt);
+    /* Like perform_writev(), for TLS connections whose writes aren't encrypted by
+    the kernel. */
+    void perform_tls_writev(const iovec *iov, size_t iovcnt);
 
     scoped_ptr_t<auto_drainer_t> drainer;
 };
@@ -316,6 +409,7 @@ public:
 
 private:
     friend class linux_nonthrowing_tcp_listener_t;
+    friend class linux_local_listener_t;
 
     explicit linux_tcp_conn_descriptor_t(fd_t fd);
 
@@ -331,8 +425,12 @@ the provided callback will be called in a new coroutine every time something con
 
 class linux_nonthrowing_tcp_listener_t : private linux_event_callback_t {
 public:
+    /* If `reuse_port` is true, the sockets are bound with `SO_REUSEPORT`, so several
+    listeners can bind the same port and the kernel spreads connections across them.
+    Check `tcp_reuse_port_is_supported()` first. */
     linux_nonthrowing_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+        bool reuse_port = false);
 
     ~linux_nonthrowing_tcp_listener_t();
 
@@ -372,6 +470,8 @@ private:
     // The port we're asked to bind to
     int port;
 
+    const bool reuse_port;
+
     // Inidicates successful binding to a port
     bool bound;
 
@@ -412,6 +512,34 @@ private:
     scoped_ptr_t<linux_nonthrowing_tcp_listener_t> listener;
 };
 
+/* Returns true if the kernel lets several sockets bind the same port with
+`SO_REUSEPORT` (Linux 3.9 and later). */
+bool tcp_reuse_port_is_supported();
+
+/* `linux_reuseport_tcp_listener_t` is like `linux_tcp_listener_t`, but it binds
+one `SO_REUSEPORT` listener on each of the threads [0, `num_threads`) to the same
+port. The kernel spreads incoming connections across them, so accepting doesn't
+bottleneck on one thread, and `callback` is called on the thread that accepted the
+connection, which should then serve it there. Requires
+`tcp_reuse_port_is_supported()`. Throws `address_in_use_exc_t` like
+`linux_tcp_listener_t`. */
+class linux_reuseport_tcp_listener_t {
+public:
+    linux_reuseport_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
+        int num_threads,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+    ~linux_reuseport_tcp_listener_t();
+
+    int get_port() const;
+
+private:
+    // `listeners[i]` lives on thread `i`.
+    scoped_array_t<scoped_ptr_t<linux_nonthrowing_tcp_listener_t> > listeners;
+    int port;
+
+    DISABLE_COPYING(linux_reuseport_tcp_listener_t);
+};
+
 /* Like a linux tcp listener but repeatedly tries to bind to its port until successful */
 class linux_repeated_nonthrowing_tcp_listener_t {
 public:
@@ -430,6 +558,37 @@ private:
     auto_drainer_t drainer;
 };
 
+/* `linux_local_listener_t` accepts connections from processes on the same host
+over a Unix domain socket, which skips the TCP stack. The socket is named
+`name` in Linux's abstract namespace, so there's no file to clean up, and
+connecting to it with `linux_tcp_conn_t(name, ...)` gives a `linux_tcp_conn_t`
+like any other. `callback` is called in a new coroutine for every connection. */
+class linux_local_listener_t : private linux_event_callback_t {
+public:
+    linux_local_listener_t(const std::string &name,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+    ~linux_local_listener_t();
+
+    /* Returns false if the socket couldn't be bound, e.g. because another
+    process is already listening under the same name. */
+    MUST_USE bool begin_listening();
+
+private:
+    void accept_loop(auto_drainer_t::lock_t lock);
+    void handle(fd_t sock);
+
+    /* event_watcher sends any error conditions to here */
+    void on_event(int events);
+
+    const std::string name;
+    boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> callback;
+    scoped_fd_t sock;
+    scoped_ptr_t<linux_event_watcher_t> event_watcher;
+    scoped_ptr_t<auto_drainer_t> accept_loop_drainer;
+
+    DISABLE_COPYING(linux_local_listener_t);
+};
+
 std::vector<std::string> get_ips();
 
 #endif // ARCH_IO_NETWORK_HPP_
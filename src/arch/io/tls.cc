@@ -0,0 +1,188 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/tls.hpp"
+
+#include <limits.h>
+#include <pthread.h>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "utils.hpp"
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+/* Before 1.1.0, OpenSSL needs to be initialized, and to be told how to lock its
+shared state, which connections on different threads use. */
+static std::vector<pthread_mutex_t> *openssl_mutexes;
+
+static void openssl_locking_callback(int mode, int n, const char *, int) {
+    if (mode & CRYPTO_LOCK) {
+        pthread_mutex_lock(&(*openssl_mutexes)[n]);
+    } else {
+        pthread_mutex_unlock(&(*openssl_mutexes)[n]);
+    }
+}
+
+static unsigned long openssl_thread_id_callback() {  // NOLINT(runtime/int)
+    return static_cast<unsigned long>(pthread_self());  // NOLINT(runtime/int)
+}
+
+static void initialize_openssl_once() {
+    SSL_library_init();
+    SSL_load_error_strings();
+    openssl_mutexes = new std::vector<pthread_mutex_t>(CRYPTO_num_locks());
+    for (size_t i = 0; i < openssl_mutexes->size(); ++i) {
+        guarantee(pthread_mutex_init(&(*openssl_mutexes)[i], NULL) == 0);
+    }
+    CRYPTO_set_id_callback(&openssl_thread_id_callback);
+    CRYPTO_set_locking_callback(&openssl_locking_callback);
+}
+#else
+static void initialize_openssl_once() {
+    OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS, NULL);
+}
+#endif
+
+static pthread_once_t openssl_initialized = PTHREAD_ONCE_INIT;
+
+tls_ctx_t::tls_ctx_t(const std::string &cert_file,
+                     const std::string &key_file,
+                     const std::string &ca_file) {
+    guarantee(pthread_once(&openssl_initialized, &initialize_openssl_once) == 0);
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    ctx = SSL_CTX_new(SSLv23_method());
+#else
+    ctx = SSL_CTX_new(TLS_method());
+#endif
+    guarantee(ctx != NULL, "Could not create a TLS context: %s",
+              tls_conn_t::error_string().c_str());
+
+    long options = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_COMPRESSION;  // NOLINT(runtime/int)
+#ifdef SSL_OP_NO_RENEGOTIATION
+    /* Renegotiation would make writes wait for reads, which `linux_tcp_conn_t`
+    does in separate coroutines. */
+    options |= SSL_OP_NO_RENEGOTIATION;
+#endif
+#ifdef SSL_OP_ENABLE_KTLS
+    // Let the kernel encrypt and decrypt records once the handshake is done.
+    options |= SSL_OP_ENABLE_KTLS;
+#endif
+    SSL_CTX_set_options(ctx, options);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE
+                     | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    try {
+        if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1) {
+            throw tls_config_exc_t(strprintf("Could not load the TLS certificate `%s`: %s",
+                                             cert_file.c_str(),
+                                             tls_conn_t::error_string().c_str()));
+        }
+        if (SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+            || SSL_CTX_check_private_key(ctx) != 1) {
+            throw tls_config_exc_t(strprintf("Could not load the TLS key `%s`: %s",
+                                             key_file.c_str(),
+                                             tls_conn_t::error_string().c_str()));
+        }
+        if (!ca_file.empty()) {
+            if (SSL_CTX_load_verify_locations(ctx, ca_file.c_str(), NULL) != 1) {
+                throw tls_config_exc_t(strprintf(
+                    "Could not load the TLS CA certificates `%s`: %s",
+                    ca_file.c_str(), tls_conn_t::error_string().c_str()));
+            }
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+                               NULL);
+        }
+    } catch (...) {
+        SSL_CTX_free(ctx);
+        throw;
+    }
+}
+
+tls_ctx_t::~tls_ctx_t() {
+    SSL_CTX_free(ctx);
+}
+
+tls_conn_t::tls_conn_t(tls_ctx_t *ctx, fd_t sock, bool is_server)
+    : ssl(SSL_new(ctx->get())), kernel_send(false) {
+    guarantee(ssl != NULL, "Could not create a TLS connection: %s",
+              error_string().c_str());
+    guarantee(SSL_set_fd(ssl, sock) == 1);
+    if (is_server) {
+        SSL_set_accept_state(ssl);
+    } else {
+        SSL_set_connect_state(ssl);
+    }
+}
+
+tls_conn_t::~tls_conn_t() {
+    SSL_free(ssl);
+}
+
+tls_conn_t::result_t tls_conn_t::handshake() {
+    ERR_clear_error();
+    result_t res = translate(SSL_do_handshake(ssl));
+    if (res == done) {
+#ifdef BIO_get_ktls_send
+        kernel_send = BIO_get_ktls_send(SSL_get_wbio(ssl));
+#endif
+    }
+    return res;
+}
+
+tls_conn_t::result_t tls_conn_t::read(void *buf, size_t size, size_t *bytes_out) {
+    rassert(size > 0);
+    ERR_clear_error();
+    int res = SSL_read(ssl, buf, std::min<size_t>(size, INT_MAX));
+    if (res > 0) {
+        *bytes_out = res;
+        return done;
+    }
+    return translate(res);
+}
+
+tls_conn_t::result_t tls_conn_t::write(const void *buf, size_t size, size_t *bytes_out) {
+    rassert(size > 0);
+    ERR_clear_error();
+    int res = SSL_write(ssl, buf, std::min<size_t>(size, INT_MAX));
+    if (res > 0) {
+        *bytes_out = res;
+        return done;
+    }
+    return translate(res);
+}
+
+tls_conn_t::result_t tls_conn_t::translate(int res) {
+    if (res > 0) {
+        return done;
+    }
+    switch (SSL_get_error(ssl, res)) {
+    case SSL_ERROR_WANT_READ:
+        return want_read;
+    case SSL_ERROR_WANT_WRITE:
+        return want_write;
+    case SSL_ERROR_ZERO_RETURN:
+        return closed;
+    case SSL_ERROR_SYSCALL:
+        // The peer went away without a close_notify, or the socket failed.
+        return ERR_peek_error() == 0 ? closed : failed;
+    default:
+        return failed;
+    }
+}
+
+std::string tls_conn_t::error_string() {
+    std::string s;
+    while (unsigned long err = ERR_get_error()) {  // NOLINT(runtime/int)
+        char buf[256];
+        ERR_error_string_n(err, buf, sizeof(buf));
+        if (!s.empty()) {
+            s += "; ";
+        }
+        s += buf;
+    }
+    return s.empty() ? "unknown error" : s;
+}
@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_TLS_HPP_
+#define ARCH_IO_TLS_HPP_
+
+#include <exception>
+#include <string>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "errors.hpp"
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+
+class tls_config_exc_t : public std::exception {
+public:
+    explicit tls_config_exc_t(const std::string &_info) : info(_info) { }
+    ~tls_config_exc_t() throw () { }
+    const char *what() const throw () { return info.c_str(); }
+private:
+    std::string info;
+};
+
+/* `tls_ctx_t` holds what TLS connections of one kind share: our certificate and
+key, and the certificates we trust.  It can be used on any thread.
+
+If `ca_file` isn't empty, peers must present a certificate signed by one of the
+certificates in it, and the handshake fails otherwise.  Otherwise we encrypt but
+don't check who's on the other end; that's what the driver port does, because
+drivers don't have certificates. */
+class tls_ctx_t {
+public:
+    // Throws `tls_config_exc_t` if the files can't be loaded.
+    tls_ctx_t(const std::string &cert_file,
+              const std::string &key_file,
+              const std::string &ca_file);
+    ~tls_ctx_t();
+
+    SSL_CTX *get() { return ctx; }
+
+private:
+    SSL_CTX *ctx;
+
+    DISABLE_COPYING(tls_ctx_t);
+};
+
+/* `tls_conn_t` is the TLS state of one non-blocking socket.  `linux_tcp_conn_t`
+owns one once `start_tls()` has been called, and does all its I/O through it.
+None of the methods block; when they return `want_read` or `want_write`, wait for
+the socket to become readable or writable and call them again with the same
+arguments. */
+class tls_conn_t {
+public:
+    enum result_t { done, want_read, want_write, closed, failed };
+
+    tls_conn_t(tls_ctx_t *ctx, fd_t sock, bool is_server);
+    ~tls_conn_t();
+
+    result_t handshake();
+
+    // Like `::read()` and `::write()`; the number of bytes is only set if the
+    // result is `done`.
+    result_t read(void *buf, size_t size, size_t *bytes_out);
+    result_t write(const void *buf, size_t size, size_t *bytes_out);
+
+    /* True if, after the handshake, the kernel encrypts what we write to the socket
+    (kernel TLS). Then we can write to the socket directly, with `::writev()`,
+    instead of going through `write()`. */
+    bool kernel_encrypts_writes() const { return kernel_send; }
+
+    // Describes (and clears) the errors from a `failed` result.
+    static std::string error_string();
+
+private:
+    result_t translate(int res);
+
+    SSL *ssl;
+    bool kernel_send;
+
+    DISABLE_COPYING(tls_conn_t);
+};
+
+#endif  // ARCH_IO_TLS_HPP_
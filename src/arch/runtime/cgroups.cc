@@ -0,0 +1,279 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/cgroups.hpp"
+
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "utils.hpp"
+
+static const char *cgroup_root = "/sys/fs/cgroup";
+
+// cgroup v1 reports "no memory limit" as a huge number rather than as "max".
+static const uint64_t cgroup_v1_no_memory_limit = 1ULL << 60;
+
+static bool read_file(const std::string &path, std::string *contents_out) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+    contents_out->clear();
+    char buffer[4096];
+    size_t res;
+    while ((res = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents_out->append(buffer, res);
+    }
+    const bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static std::string strip_trailing_whitespace(const std::string &s) {
+    size_t end = s.size();
+    while (end > 0 && (s[end - 1] == '\n' || s[end - 1] == ' ')) {
+        --end;
+    }
+    return s.substr(0, end);
+}
+
+static bool read_int64(const std::string &path, int64_t *out) {
+    std::string contents;
+    return read_file(path, &contents)
+        && strtoi64_strict(strip_trailing_whitespace(contents), 10, out);
+}
+
+/* Reads the "key value" lines of a file such as "cpu.stat". */
+static bool read_key_values(const std::string &path, std::map<std::string, uint64_t> *out) {
+    std::string contents;
+    if (!read_file(path, &contents)) {
+        return false;
+    }
+    size_t line_start = 0;
+    while (line_start < contents.size()) {
+        size_t line_end = contents.find('\n', line_start);
+        if (line_end == std::string::npos) {
+            line_end = contents.size();
+        }
+        const std::string line = contents.substr(line_start, line_end - line_start);
+        const size_t space = line.find(' ');
+        uint64_t value;
+        if (space != std::string::npos
+            && strtou64_strict(line.substr(space + 1), 10, &value)) {
+            (*out)[line.substr(0, space)] = value;
+        }
+        line_start = line_end + 1;
+    }
+    return true;
+}
+
+/* The directories of the groups whose limits on `controller` apply to us,
+innermost first, and whether they're in the v2 hierarchy.  In a container the
+group is usually what's mounted at the root, so the directory for our own path
+often doesn't exist, but the root one does. */
+static bool get_cgroup_directories(const std::string &controller,
+                                   std::vector<std::string> *dirs_out,
+                                   bool *v2_out) {
+    std::string contents;
+    std::map<std::string, std::string> paths;
+    if (!read_file("/proc/self/cgroup", &contents) || !parse_proc_cgroup(contents, &paths)) {
+        return false;
+    }
+    std::string base;
+    auto it = paths.find(controller);
+    if (it != paths.end()) {
+        base = std::string(cgroup_root) + "/" + controller;
+        *v2_out = false;
+    } else if ((it = paths.find("")) != paths.end()) {
+        base = cgroup_root;
+        *v2_out = true;
+    } else {
+        return false;
+    }
+
+    dirs_out->clear();
+    std::string path = it->second;
+    while (!path.empty() && path != "/") {
+        dirs_out->push_back(base + path);
+        path = path.substr(0, path.rfind('/'));
+    }
+    dirs_out->push_back(base);
+    return true;
+}
+
+bool parse_proc_cgroup(const std::string &contents,
+                       std::map<std::string, std::string> *paths_out) {
+    paths_out->clear();
+    size_t line_start = 0;
+    while (line_start < contents.size()) {
+        size_t line_end = contents.find('\n', line_start);
+        if (line_end == std::string::npos) {
+            line_end = contents.size();
+        }
+        const std::string line = contents.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+        if (line.empty()) {
+            continue;
+        }
+
+        // "hierarchy-ID:controller-list:cgroup-path"; the path may have colons.
+        const size_t first_colon = line.find(':');
+        if (first_colon == std::string::npos) {
+            return false;
+        }
+        const size_t second_colon = line.find(':', first_colon + 1);
+        if (second_colon == std::string::npos) {
+            return false;
+        }
+        const std::string controllers =
+            line.substr(first_colon + 1, second_colon - first_colon - 1);
+        const std::string path = line.substr(second_colon + 1);
+        if (controllers.empty()) {
+            (*paths_out)[""] = path;
+            continue;
+        }
+        size_t start = 0;
+        while (start <= controllers.size()) {
+            size_t comma = controllers.find(',', start);
+            if (comma == std::string::npos) {
+                comma = controllers.size();
+            }
+            (*paths_out)[controllers.substr(start, comma - start)] = path;
+            start = comma + 1;
+        }
+    }
+    return true;
+}
+
+bool parse_cgroup_cpu_max(const std::string &line, double *cpus_out) {
+    const std::string stripped = strip_trailing_whitespace(line);
+    const size_t space = stripped.find(' ');
+    if (space == std::string::npos) {
+        return false;
+    }
+    uint64_t period;
+    if (!strtou64_strict(stripped.substr(space + 1), 10, &period) || period == 0) {
+        return false;
+    }
+    const std::string quota_str = stripped.substr(0, space);
+    uint64_t quota;
+    if (quota_str == "max") {
+        *cpus_out = 0;
+    } else if (strtou64_strict(quota_str, 10, &quota)) {
+        *cpus_out = static_cast<double>(quota) / period;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+cgroup_limits_t get_cgroup_limits() {
+    cgroup_limits_t limits;
+    limits.cpu_quota = 0;
+    limits.memory_limit = 0;
+
+    std::vector<std::string> dirs;
+    bool v2;
+    if (get_cgroup_directories("cpu", &dirs, &v2)) {
+        for (auto it = dirs.begin(); it != dirs.end(); ++it) {
+            double cpus = 0;
+            if (v2) {
+                std::string line;
+                if (!read_file(*it + "/cpu.max", &line) || !parse_cgroup_cpu_max(line, &cpus)) {
+                    continue;
+                }
+            } else {
+                int64_t quota, period;
+                if (!read_int64(*it + "/cpu.cfs_quota_us", &quota)
+                    || !read_int64(*it + "/cpu.cfs_period_us", &period)
+                    || period <= 0) {
+                    continue;
+                }
+                // The quota is -1 if there isn't one.
+                cpus = quota > 0 ? static_cast<double>(quota) / period : 0;
+            }
+            if (cpus > 0 && (limits.cpu_quota == 0 || cpus < limits.cpu_quota)) {
+                limits.cpu_quota = cpus;
+            }
+        }
+    }
+
+    if (get_cgroup_directories("memory", &dirs, &v2)) {
+        for (auto it = dirs.begin(); it != dirs.end(); ++it) {
+            std::string contents;
+            if (!read_file(*it + (v2 ? "/memory.max" : "/memory.limit_in_bytes"), &contents)) {
+                continue;
+            }
+            uint64_t limit;
+            if (!strtou64_strict(strip_trailing_whitespace(contents), 10, &limit)
+                || (!v2 && limit >= cgroup_v1_no_memory_limit)) {
+                // Including v2's "max".
+                continue;
+            }
+            if (limits.memory_limit == 0 || limit < limits.memory_limit) {
+                limits.memory_limit = limit;
+            }
+        }
+    }
+
+    return limits;
+}
+
+cgroup_usage_t get_cgroup_usage() {
+    cgroup_usage_t usage;
+    usage.has_memory = false;
+    usage.memory_usage = 0;
+    usage.has_throttling = false;
+    usage.throttled_periods = 0;
+    usage.throttled_usecs = 0;
+
+    // Our own group's usage is in the innermost directory that exists.
+    std::vector<std::string> dirs;
+    bool v2;
+    if (get_cgroup_directories("memory", &dirs, &v2)) {
+        for (auto it = dirs.begin(); it != dirs.end() && !usage.has_memory; ++it) {
+            std::string contents;
+            usage.has_memory =
+                read_file(*it + (v2 ? "/memory.current" : "/memory.usage_in_bytes"), &contents)
+                && strtou64_strict(strip_trailing_whitespace(contents), 10, &usage.memory_usage);
+        }
+    }
+
+    if (get_cgroup_directories("cpu", &dirs, &v2)) {
+        for (auto it = dirs.begin(); it != dirs.end() && !usage.has_throttling; ++it) {
+            std::map<std::string, uint64_t> stats;
+            if (!read_key_values(*it + "/cpu.stat", &stats)
+                || stats.count("nr_throttled") == 0) {
+                continue;
+            }
+            usage.throttled_periods = stats["nr_throttled"];
+            if (v2) {
+                usage.throttled_usecs = stats["throttled_usec"];
+            } else {
+                usage.throttled_usecs = stats["throttled_time"] / THOUSAND;
+            }
+            usage.has_throttling = true;
+        }
+    }
+
+    return usage;
+}
+
+int get_usable_cpu_count() {
+    int cpus = get_cpu_count();
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0 && CPU_COUNT(&mask) > 0) {
+        cpus = CPU_COUNT(&mask);
+    }
+#endif
+    const cgroup_limits_t limits = get_cgroup_limits();
+    if (limits.cpu_quota > 0) {
+        cpus = std::min(cpus, static_cast<int>(ceil(limits.cpu_quota)));
+    }
+    return std::max(cpus, 1);
+}
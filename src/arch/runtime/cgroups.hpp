@@ -0,0 +1,53 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_CGROUPS_HPP_
+#define ARCH_RUNTIME_CGROUPS_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "errors.hpp"
+
+/* What the control groups this process is in allow it, from the cgroup v2
+hierarchy or the v1 "cpu" and "memory" controllers.  A limit on any ancestor
+group counts.  Outside a container, or where we can't tell, there are no limits. */
+struct cgroup_limits_t {
+    // How many CPUs' worth of time we may use, or 0 if there's no quota.
+    double cpu_quota;
+    // In bytes, or 0 if there's no limit.
+    uint64_t memory_limit;
+};
+
+cgroup_limits_t get_cgroup_limits();
+
+/* The use of what the limits limit.  Each `has_` field says whether we could
+read the fields after it. */
+struct cgroup_usage_t {
+    bool has_memory;
+    uint64_t memory_usage;
+
+    bool has_throttling;
+    // How many of the quota's periods we ran out of quota in, and for how long we
+    // then weren't allowed to run.
+    uint64_t throttled_periods;
+    uint64_t throttled_usecs;
+};
+
+cgroup_usage_t get_cgroup_usage();
+
+/* The number of CPUs this process may run on, or fewer if its CPU quota is less
+than that, but at least one.  This is what we default the number of threads to. */
+int get_usable_cpu_count();
+
+/* Parses the contents of "/proc/self/cgroup" into the path of each controller's
+group.  The v2 hierarchy, which has no controller names, is under "".  Returns
+false if it's malformed. */
+bool parse_proc_cgroup(const std::string &contents,
+                       std::map<std::string, std::string> *paths_out);
+
+/* Parses cgroup v2's "cpu.max", e.g. "150000 100000", into a number of CPUs, or 0
+for "max".  Returns false if it's malformed. */
+bool parse_cgroup_cpu_max(const std::string &line, double *cpus_out);
+
+#endif  // ARCH_RUNTIME_CGROUPS_HPP_
@@ -16,6 +16,7 @@
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/concurrency.hpp"
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "errors.hpp"
 #include "utils.hpp"
@@ -38,9 +39,16 @@ bool artificial_stack_context_ref_t::is_nil() {
 }
 
 artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_size)
-    : stack_size(_stack_size) {
-    /* Allocate the stack */
-    stack = malloc_aligned(stack_size, getpagesize());
+    : stack_size(ceil_aligned(_stack_size, getpagesize())) {
+    /* Allocate the stack. We map it ourselves rather than using `malloc()`, so
+    that the OS only commits the pages the coroutine actually touches; most
+    coroutines never get far from the base, so a stack costs a few pages of
+    memory rather than `stack_size`. */
+    stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (stack == MAP_FAILED) {
+        crash_or_trap("Out of memory.");
+    }
 
     /* Protect the end of the stack so that we crash when we get a stack
     overflow instead of corrupting memory. */
@@ -87,8 +95,14 @@ artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_
 #elif defined(__x86_64__)
     /* These registers (r12, r13, r14, r15, rbx, rbp) are going to be popped off
     the stack by swapcontext; they're callee-saved, so whatever happens to be in
-    them will be ignored. */
+    them will be ignored. Except by profilers: `initial_fun` pushes the `rbp` we
+    pop here as its caller's frame pointer, and together with the zero return
+    address above it, a zero there is what tells frame-pointer and DWARF
+    unwinders (perf, gdb) that the coroutine's stack ends at `initial_fun`. */
     sp -= 6;
+    for (int i = 0; i < 6; ++i) {
+        sp[i] = 0;
+    }
 #else
 #error "Unsupported architecture."
 #endif
@@ -97,6 +111,7 @@ artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_
 
     /* Set up stack pointer. */
     context.pointer = sp;
+    deepest_pointer = sp;
 
     /* Our coroutines never return, so we don't put anything else on the stack.
     */
@@ -130,11 +145,34 @@ artificial_stack_t::~artificial_stack_t() {
 #endif
 #endif
 
-    /* Undo protections changes */
-    mprotect(stack, getpagesize(), PROT_READ | PROT_WRITE);
+    /* Release the stack we allocated, along with its protection page */
+    munmap(stack, stack_size);
+}
 
-    /* Release the stack we allocated */
-    free(stack);
+size_t artificial_stack_t::get_high_water_mark() {
+    return reinterpret_cast<uintptr_t>(get_stack_base())
+        - reinterpret_cast<uintptr_t>(deepest_pointer);
+}
+
+void artificial_stack_t::release_unused_pages() {
+    if (get_high_water_mark() > COROUTINE_STACK_RETAINED_SIZE) {
+        /* Everything past the protection page up to the retained part. Pages
+        deeper than the high-water mark may have been touched too, so we don't
+        stop there. */
+        char *start = static_cast<char *>(stack) + getpagesize();
+        char *end = reinterpret_cast<char *>(
+            floor_aligned(reinterpret_cast<uintptr_t>(get_stack_base())
+                          - COROUTINE_STACK_RETAINED_SIZE,
+                          getpagesize()));
+#ifndef NDEBUG
+        char dummy;
+        rassert(&dummy > end, "release_unused_pages() called from too deep in the stack");
+#endif
+        if (start < end) {
+            madvise(start, end - start, MADV_DONTNEED);
+        }
+    }
+    deepest_pointer = get_stack_base();
 }
 
 bool artificial_stack_t::address_in_stack(void *addr) {
@@ -197,7 +235,18 @@ asm(
 #endif
 #endif // defined(__x86_64__)
 ".text\n"
+#if defined(__ELF__)
+/* Give the symbol a type and a size so that profilers attribute samples in it
+to it rather than to whatever function precedes it. */
+".type _lightweight_swapcontext, @function\n"
+#endif
 "_lightweight_swapcontext:\n"
+#if defined(__x86_64__)
+/* Call frame information, so that unwinders can get through a sample that lands
+in here. The stack switch doesn't disturb it: both stacks have the six registers
+right below the return address, at the same offsets from `%rsp`. */
+".cfi_startproc\n"
+#endif
 
 #if defined(__i386__)
     /* `current_pointer_out` is in `4(%ebp)`. `dest_pointer` is in `8(%ebp)`. */
@@ -214,11 +263,23 @@ asm(
     "push %ebp\n"
 #elif defined(__x86_64__)
     "pushq %r12\n"
+    ".cfi_adjust_cfa_offset 8\n"
+    ".cfi_rel_offset %r12, 0\n"
     "pushq %r13\n"
+    ".cfi_adjust_cfa_offset 8\n"
+    ".cfi_rel_offset %r13, 0\n"
     "pushq %r14\n"
+    ".cfi_adjust_cfa_offset 8\n"
+    ".cfi_rel_offset %r14, 0\n"
     "pushq %r15\n"
+    ".cfi_adjust_cfa_offset 8\n"
+    ".cfi_rel_offset %r15, 0\n"
     "pushq %rbx\n"
+    ".cfi_adjust_cfa_offset 8\n"
+    ".cfi_rel_offset %rbx, 0\n"
     "pushq %rbp\n"
+    ".cfi_adjust_cfa_offset 8\n"
+    ".cfi_rel_offset %rbp, 0\n"
 #endif
 
     /* Save old stack pointer. */
@@ -250,11 +311,23 @@ asm(
     "pop %esi\n"
 #elif defined(__x86_64__)
     "popq %rbp\n"
+    ".cfi_adjust_cfa_offset -8\n"
+    ".cfi_restore %rbp\n"
     "popq %rbx\n"
+    ".cfi_adjust_cfa_offset -8\n"
+    ".cfi_restore %rbx\n"
     "popq %r15\n"
+    ".cfi_adjust_cfa_offset -8\n"
+    ".cfi_restore %r15\n"
     "popq %r14\n"
+    ".cfi_adjust_cfa_offset -8\n"
+    ".cfi_restore %r14\n"
     "popq %r13\n"
+    ".cfi_adjust_cfa_offset -8\n"
+    ".cfi_restore %r13\n"
     "popq %r12\n"
+    ".cfi_adjust_cfa_offset -8\n"
+    ".cfi_restore %r12\n"
 #endif
 
     /* The following ret should return to the address set with
@@ -262,6 +335,12 @@ asm(
     instruction pointer is saved on the stack from the previous call (or
     initialized with `artificial_stack_t()`). */
     "ret\n"
+#if defined(__x86_64__)
+".cfi_endproc\n"
+#endif
+#if defined(__ELF__)
+".size _lightweight_swapcontext, .-_lightweight_swapcontext\n"
+#endif
 #else
 #error "Unsupported architecture."
 #endif
@@ -3,6 +3,7 @@
 #define ARCH_RUNTIME_CONTEXT_SWITCHING_HPP_
 
 #include <pthread.h>
+#include <stdint.h>
 
 #include "errors.hpp"
 
@@ -59,6 +60,26 @@ public:
     /* Returns `true` if the given address is in the stack's protection page. */
     bool address_is_stack_overflow(void *addr);
 
+    /* Called with an address in the current stack frame whenever the coroutine
+    on this stack switches out. The deepest such address is the stack's
+    high-water mark; it misses deeper calls that return without switching out,
+    but it's cheap enough to track all the time. */
+    void note_stack_pointer(void *addr) {
+        if (reinterpret_cast<uintptr_t>(addr) < reinterpret_cast<uintptr_t>(deepest_pointer)) {
+            deepest_pointer = addr;
+        }
+    }
+
+    /* Returns how many bytes of the stack were in use at the high-water mark. */
+    size_t get_high_water_mark();
+
+    /* Must be called from near the base of the stack, once the coroutine has no
+    frames left on it that it needs. If the high-water mark is deeper than
+    `COROUTINE_STACK_RETAINED_SIZE`, hands the pages beyond that back to the OS so
+    that a stack waiting on the free list doesn't keep memory that some deep call
+    once needed. Then resets the high-water mark. */
+    void release_unused_pages();
+
     /* Returns the base of the stack */
     void *get_stack_base() { return static_cast<char*>(stack) + stack_size; }
 
@@ -68,6 +89,7 @@ public:
 private:
     void *stack;
     size_t stack_size;
+    void *deepest_pointer;
 #ifdef VALGRIND
     int valgrind_stack_id;
 #endif
@@ -174,6 +196,12 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound();
 
+    /* See `artificial_stack_t`. The thread's stack belongs to pthreads, so we
+    don't track or release anything. */
+    void note_stack_pointer(void *) { }
+    size_t get_high_water_mark() { return 0; }
+    void release_unused_pages() { }
+
 private:
     static void *internal_run(void *p);
     void get_stack_addr_size(void **stackaddr_out, size_t *stacksize_out);
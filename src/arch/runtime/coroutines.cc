@@ -12,6 +12,7 @@
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/coro_profiler.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "arch/runtime/sampling_profiler.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "config/args.hpp"
 #include "do_on_thread.hpp"
@@ -92,9 +93,12 @@ TLS_with_init(coro_globals_t *, cglobals, NULL);
 // construction depends on coro_t::coroutines_have_been_initialized() which in turn
 // depends on cglobals.
 static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines;
+// The high-water mark of each coroutine's stack, in bytes, recorded when it finishes.
+static perfmon_sampler_t pm_coroutine_stack_usage(secs_to_ticks(1), false);
 static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_collection(),
     &pm_active_coroutines, "active_coroutines",
-    &pm_allocated_coroutines, "allocated_coroutines");
+    &pm_allocated_coroutines, "allocated_coroutines",
+    &pm_coroutine_stack_usage, "coroutine_stack_usage");
 
 coro_runtime_t::coro_runtime_t() {
     rassert(!TLS_get_cglobals(), "coro runtime initialized twice on this thread");
@@ -124,7 +128,8 @@ coro_t::coro_t() :
     stack(&coro_t::run, coro_stack_size),
     current_thread_(linux_thread_pool_t::get_thread_id()),
     notified_(false),
-    waiting_(false)
+    waiting_(false),
+    run_timer_(NULL)
 #ifndef NDEBUG
     , selfname_number(get_thread_id().threadnum + MAX_THREADS *
           // The comma here is the comma operator, to implement the semantics
@@ -191,8 +196,10 @@ void coro_t::run() {
         TLS_get_cglobals()->active_coroutines.insert(coro);
 #endif
         PROFILER_CORO_RESUME;
+        sampling_profiler_t::get_global_profiler().on_coro_resume(&coro->sampling_state);
         coro->action_wrapper.run();
         PROFILER_CORO_YIELD(0);
+        sampling_profiler_t::get_global_profiler().on_coro_yield(&coro->sampling_state, false);
 #ifndef NDEBUG
         TLS_get_cglobals()->running_coroutine_counts[coro->coroutine_type.c_str()]--;
         TLS_get_cglobals()->active_coroutines.erase(coro);
@@ -203,6 +210,9 @@ void coro_t::run() {
         // Destroy the Callable object which was either allocated within the coro_t or on the heap
         coro->action_wrapper.reset();
 
+        pm_coroutine_stack_usage.record(coro->stack.get_high_water_mark());
+        coro->stack.release_unused_pages();
+
         /* Return the context to the free-contexts list we took it from. */
         do_on_thread(coro->home_thread(), std::bind(&coro_t::return_coro_to_free_list, coro));
         --pm_active_coroutines;
@@ -245,18 +255,60 @@ void coro_t::wait() {   /* class method */
     self()->waiting_ = true;
 
     PROFILER_CORO_YIELD(1);
+    sampling_profiler_t::get_global_profiler().on_coro_yield(&self()->sampling_state, true);
+    self()->pause_run_timers();
+    char stack_marker;
+    self()->stack.note_stack_pointer(&stack_marker);
     if (TLS_get_cglobals()->prev_coro) {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->prev_coro->stack.context);
     } else {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->scheduler);
     }
     PROFILER_CORO_RESUME;
+    sampling_profiler_t::get_global_profiler().on_coro_resume(&self()->sampling_state);
+    self()->resume_run_timers();
 
     rassert(self());
     rassert(self()->waiting_);
     self()->waiting_ = false;
 }
 
+void coro_t::pause_run_timers() {
+    if (run_timer_ != NULL) {
+        const ticks_t now = get_ticks();
+        for (coro_run_timer_t *t = run_timer_; t != NULL; t = t->outer) {
+            t->run_time += now - t->resumed_at;
+        }
+    }
+}
+
+void coro_t::resume_run_timers() {
+    if (run_timer_ != NULL) {
+        const ticks_t now = get_ticks();
+        for (coro_run_timer_t *t = run_timer_; t != NULL; t = t->outer) {
+            t->resumed_at = now;
+        }
+    }
+}
+
+coro_run_timer_t::coro_run_timer_t()
+    : coro(coro_t::self()), outer(NULL), run_time(0), resumed_at(get_ticks()) {
+    guarantee(coro != NULL, "coro_run_timer_t has to be created in a coroutine");
+    outer = coro->run_timer_;
+    coro->run_timer_ = this;
+}
+
+coro_run_timer_t::~coro_run_timer_t() {
+    rassert(coro_t::self() == coro);
+    rassert(coro->run_timer_ == this);
+    coro->run_timer_ = outer;
+}
+
+ticks_t coro_run_timer_t::get_run_time() const {
+    rassert(coro_t::self() == coro);
+    return run_time + (get_ticks() - resumed_at);
+}
+
 void coro_t::yield() {  /* class method */
     rassert(self(), "Not in a coroutine context");
     self()->notify_sometime();
@@ -287,6 +339,8 @@ void coro_t::notify_now_deprecated() {
 
     if (coro_t::self() != NULL) {
         PROFILER_CORO_YIELD(1);
+        sampling_profiler_t::get_global_profiler().on_coro_yield(&coro_t::self()->sampling_state, true);
+        coro_t::self()->pause_run_timers();
     }
     coro_t *prev_prev_coro = TLS_get_cglobals()->prev_coro;
     TLS_get_cglobals()->prev_coro = TLS_get_cglobals()->current_coro;
@@ -303,6 +357,8 @@ void coro_t::notify_now_deprecated() {
     TLS_get_cglobals()->prev_coro = prev_prev_coro;
     if (coro_t::self() != NULL) {
         PROFILER_CORO_RESUME;
+        sampling_profiler_t::get_global_profiler().on_coro_resume(&coro_t::self()->sampling_state);
+        coro_t::self()->resume_run_timers();
     }
 
 #ifndef NDEBUG
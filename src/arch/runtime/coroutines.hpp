@@ -9,6 +9,7 @@
 #include "arch/runtime/callable_action.hpp"
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/runtime_utils.hpp"
+#include "arch/runtime/sampling_profiler.hpp"
 #include "utils.hpp"
 
 const size_t MAX_COROUTINE_STACK_SIZE = 8*1024*1024;
@@ -21,6 +22,7 @@ const size_t MAX_COROUTINE_STACK_SIZE = 8*1024*1024;
 
 threadnum_t get_thread_id();
 struct coro_globals_t;
+class coro_run_timer_t;
 
 
 struct coro_profiler_mixin_t {
@@ -195,6 +197,11 @@ private:
     friend struct coro_globals_t;
     ~coro_t();
 
+    // Keep the coroutine's `coro_run_timer_t`s, if it has any, from counting the
+    // time it waits.
+    void pause_run_timers();
+    void resume_run_timers();
+
     virtual void on_thread_switch();
 
     coro_stack_t stack;
@@ -205,8 +212,14 @@ private:
     bool notified_;
     bool waiting_;
 
+    friend class coro_run_timer_t;
+    // The innermost run timer, or NULL.
+    coro_run_timer_t *run_timer_;
+
     callable_action_wrapper_t action_wrapper;
 
+    sampling_profiler_t::coro_state_t sampling_state;
+
 #ifndef NDEBUG
     int64_t selfname_number;
     std::string coroutine_type;
@@ -221,6 +234,31 @@ private:
     DISABLE_COPYING(coro_t);
 };
 
+/* `coro_run_timer_t` measures how long the coroutine that creates it runs, as
+opposed to waits, for as long as it exists.  Coroutines aren't preempted, so
+that's the CPU time the thread spent on the coroutine (give or take the time
+the kernel took the thread away).  It has to be destroyed in the coroutine
+that created it; they can nest.  While no coroutine has one, the only cost is
+a branch per coroutine switch. */
+class coro_run_timer_t {
+public:
+    coro_run_timer_t();
+    ~coro_run_timer_t();
+
+    // Must be called from the coroutine.
+    ticks_t get_run_time() const;
+
+private:
+    friend class coro_t;
+
+    coro_t *coro;
+    coro_run_timer_t *outer;
+    ticks_t run_time;
+    ticks_t resumed_at;
+
+    DISABLE_COPYING(coro_run_timer_t);
+};
+
 /* Returns true if the given address is in the protection page of the current coroutine. */
 bool is_coroutine_stack_overflow(void *addr);
 bool coroutines_have_been_initialized();
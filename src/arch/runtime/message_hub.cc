@@ -20,6 +20,8 @@ linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
     : queue_(queue),
       thread_pool_(thread_pool),
       is_woken_up_(false),
+      incoming_head_(&incoming_stub_),
+      incoming_tail_(&incoming_stub_),
       current_thread_(current_thread) {
 
 #ifndef NDEBUG
@@ -43,7 +45,7 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_tail_ == &incoming_stub_ && incoming_stub_.incoming_next == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -90,19 +92,81 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
-    }
+    msg_list_t msgs;
+    msgs.push_back(msg);
+    push_incoming(&msgs);
 
     // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    if (!check_and_set_is_woken_up()) {
         event_.wakey_wakey();
     }
 }
 
+void linux_message_hub_t::push_incoming(msg_list_t *msgs) {
+    linux_thread_message_t *first = msgs->head();
+    if (first == NULL) {
+        return;
+    }
+    linux_thread_message_t *last = first;
+    msgs->pop_front();
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->pop_front();
+        last->incoming_next = m;
+        last = m;
+    }
+    last->incoming_next = NULL;
+
+    // Full barrier, so the links above are visible before the batch is.
+    linux_thread_message_t *prev = __sync_lock_test_and_set(&incoming_head_, last);
+    __sync_synchronize();
+    prev->incoming_next = first;
+}
+
+linux_thread_message_t *linux_message_hub_t::pop_incoming() {
+    linux_thread_message_t *tail = incoming_tail_;
+    linux_thread_message_t *next = tail->incoming_next;
+    if (tail == &incoming_stub_) {
+        if (next == NULL) {
+            return NULL;
+        }
+        incoming_tail_ = next;
+        tail = next;
+        next = next->incoming_next;
+    }
+    if (next != NULL) {
+        incoming_tail_ = next;
+        tail->incoming_next = NULL;
+        return tail;
+    }
+    if (tail != incoming_head_) {
+        // A producer is between its two steps; its batch will be linked soon.
+        return NULL;
+    }
+    // `tail` is the last message; put the stub behind it so we can take it.
+    msg_list_t stub;
+    stub.push_back(&incoming_stub_);
+    push_incoming(&stub);
+    next = tail->incoming_next;
+    if (next != NULL) {
+        incoming_tail_ = next;
+        tail->incoming_next = NULL;
+        return tail;
+    }
+    return NULL;
+}
+
+bool linux_message_hub_t::has_pending_messages() const {
+    if (!queues_[current_thread_.threadnum].msg_local_list.empty()) {
+        return true;
+    }
+    for (int i = 0; i < NUM_SCHEDULER_PRIORITIES; ++i) {
+        if (!priority_msg_lists_[i].empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 linux_message_hub_t::msg_list_t &linux_message_hub_t::get_priority_msg_list(int priority) {
     rassert(priority >= MESSAGE_SCHEDULER_MIN_PRIORITY);
     rassert(priority <= MESSAGE_SCHEDULER_MAX_PRIORITY);
@@ -174,12 +238,7 @@ void linux_message_hub_t::on_event(int events) {
             // Place wakey_wakey and then yield to the event processing.
             // It will wake us up again immediately, but can handle a few
             // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
+            if (!check_and_set_is_woken_up()) {
                 event_.wakey_wakey();
             }
             break;
@@ -188,22 +247,12 @@ void linux_message_hub_t::on_event(int events) {
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
-
-    // 1. Pull the messages
-    msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
-    }
-
-    // 2. Sort the messages into their respective priority queues
-    while (linux_thread_message_t *m = new_messages.head()) {
-        new_messages.remove(m);
+    // Producers that add messages after this wake us up again, so we don't miss
+    // any that we don't see below.
+    __sync_lock_release(&is_woken_up_);
+    __sync_synchronize();
+
+    while (linux_thread_message_t *m = pop_incoming()) {
         int effective_priority = m->priority;
         if (m->is_ordered) {
             // Ordered messages are treated as if they had
@@ -218,9 +267,7 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
 }
 
 bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
+    return __sync_lock_test_and_set(&is_woken_up_, 1) != 0;
 }
 
 // Pushes messages collected locally global lists available to all
@@ -233,21 +280,13 @@ void linux_message_hub_t::push_messages() {
         if (!queue->msg_local_list.empty()) {
             // Transfer messages to the other core
 
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
+            linux_message_hub_t *target = &thread_pool_->threads[i]->message_hub;
+            target->push_incoming(&queue->msg_local_list);
 
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
+            // Wakey wakey, perhaps eggs and bakey. We only need to do a wake up if
+            // we're the first people to do a wake up.
+            if (!target->check_and_set_is_woken_up()) {
+                target->event_.wakey_wakey();
             }
         }
     }
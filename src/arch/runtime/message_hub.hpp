@@ -8,7 +8,6 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "utils.hpp"
@@ -49,6 +48,11 @@ public:
     // (which does not have an event queue)
     void insert_external_message(linux_thread_message_t *msg);
 
+    /* Returns true if messages for this thread are waiting to be processed. Must be
+    called on this thread. Doesn't count messages that other threads haven't pushed
+    to us yet. */
+    bool has_pending_messages() const;
+
     ~linux_message_hub_t();
 
 private:
@@ -56,7 +60,7 @@ private:
     // debug mode.
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
-    // Moves messages from incoming_messages_ into the respective entries of
+    // Moves messages from the incoming queue into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority();
 
@@ -70,15 +74,33 @@ private:
         //TODO this doesn't need to be a class anymore
 
         /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
+        have to touch the other thread's queue as often */
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
+    /* Messages from all threads to this one go through a lock-free intrusive
+    multi-producer single-consumer queue (Dmitry Vyukov's): a producer links a
+    whole batch of messages together and appends it with one atomic exchange of
+    `incoming_head_`, and only this thread takes messages from
+    `incoming_tail_`. A consumer can briefly find the end of the queue unlinked
+    while a producer is between its two steps; that producer then sees that we
+    aren't woken up and wakes us up again. */
+    // Empties `msgs`. Can be called from any thread.
+    void push_incoming(msg_list_t *msgs);
+    linux_thread_message_t *pop_incoming();
+
+    /* Returns true if we need to notify `event_`, i.e. if no one has since we
+    last took messages off the queue. Can be called from any thread. */
     bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    volatile int is_woken_up_;
+
+    // Always in the queue, so that it's never empty and producers never touch
+    // `incoming_tail_`.
+    class stub_message_t : public linux_thread_message_t {
+        void on_thread_switch() { unreachable(); }
+    } incoming_stub_;
+    linux_thread_message_t *volatile incoming_head_;
+    linux_thread_message_t *incoming_tail_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
@@ -91,7 +113,7 @@ private:
     void on_event(int events);
 
     // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // message is put onto the incoming queue.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
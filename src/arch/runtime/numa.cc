@@ -0,0 +1,153 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/numa.hpp"
+
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "utils.hpp"
+
+static const char *numa_node_directory = "/sys/devices/system/node";
+
+static bool read_line(const std::string &path, std::string *line_out) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+    char buffer[4096];
+    const bool ok = fgets(buffer, sizeof(buffer), file) != NULL;
+    fclose(file);
+    if (ok) {
+        *line_out = buffer;
+    }
+    return ok;
+}
+
+#ifdef __linux__
+static std::vector<int> get_allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &mask)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+#else
+static std::vector<int> get_allowed_cpus() {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < get_cpu_count(); ++cpu) {
+        cpus.push_back(cpu);
+    }
+    return cpus;
+}
+#endif
+
+numa_topology_t::numa_topology_t() {
+    const std::vector<int> allowed = get_allowed_cpus();
+
+    // Ordered by node number.
+    std::map<int, std::vector<int> > found;
+    if (DIR *dir = opendir(numa_node_directory)) {
+        while (struct dirent *entry = readdir(dir)) {
+            int node;
+            char dummy;
+            if (sscanf(entry->d_name, "node%d%c", &node, &dummy) != 1) {
+                continue;
+            }
+            std::string list;
+            std::vector<int> cpus;
+            if (!read_line(strprintf("%s/%s/cpulist", numa_node_directory, entry->d_name),
+                           &list)
+                || !parse_cpu_list(list, &cpus)) {
+                continue;
+            }
+            std::vector<int> *usable = &found[node];
+            for (auto it = cpus.begin(); it != cpus.end(); ++it) {
+                if (std::binary_search(allowed.begin(), allowed.end(), *it)) {
+                    usable->push_back(*it);
+                }
+            }
+        }
+        closedir(dir);
+    }
+
+    for (auto it = found.begin(); it != found.end(); ++it) {
+        if (!it->second.empty()) {
+            nodes.push_back(it->second);
+        }
+    }
+    if (nodes.empty() && !allowed.empty()) {
+        nodes.push_back(allowed);
+    }
+}
+
+numa_topology_t::numa_topology_t(const std::vector<std::vector<int> > &_nodes) {
+    for (auto it = _nodes.begin(); it != _nodes.end(); ++it) {
+        if (!it->empty()) {
+            nodes.push_back(*it);
+        }
+    }
+}
+
+int numa_topology_t::cpu_for_thread(int thread, int num_threads) const {
+    rassert(thread >= 0 && thread < num_threads);
+    size_t total_cpus = 0;
+    for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+        total_cpus += it->size();
+    }
+    if (total_cpus == 0) {
+        return -1;
+    }
+    /* We lay the CPUs of all nodes out in a row and give the threads evenly spaced
+    positions on it. */
+    size_t position = static_cast<size_t>(thread) * total_cpus / num_threads;
+    for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+        if (position < it->size()) {
+            return (*it)[position];
+        }
+        position -= it->size();
+    }
+    unreachable();
+}
+
+bool numa_topology_t::parse_cpu_list(const std::string &list, std::vector<int> *cpus_out) {
+    cpus_out->clear();
+    const char *p = list.c_str();
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        const long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus_out->push_back(cpu);
+        }
+        if (*p == ',') {
+            ++p;
+        } else if (*p != '\0' && *p != '\n') {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_NUMA_HPP_
+#define ARCH_RUNTIME_NUMA_HPP_
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+
+/* The CPUs of each NUMA node that this process is allowed to run on. Where the
+system doesn't tell us about its nodes, all the CPUs are on a single node. */
+class numa_topology_t {
+public:
+    // Reads the topology from sysfs.
+    numa_topology_t();
+    // For testing; nodes without any CPUs are dropped.
+    explicit numa_topology_t(const std::vector<std::vector<int> > &nodes);
+
+    size_t num_nodes() const { return nodes.size(); }
+    const std::vector<int> &node_cpus(size_t node) const { return nodes[node]; }
+
+    /* Returns the CPU to pin thread `thread` of `num_threads` to. The threads are
+    spread over the nodes in proportion to the nodes' CPUs, with neighbouring
+    threads on the same node; on a node, each thread gets a CPU of its own as long
+    as there are enough of them. Returns -1 if there are no CPUs we know of. */
+    int cpu_for_thread(int thread, int num_threads) const;
+
+    /* Parses a sysfs CPU list such as "0-3,8,10-11". Returns false if it's
+    malformed. */
+    static bool parse_cpu_list(const std::string &list, std::vector<int> *cpus_out);
+
+private:
+    std::vector<std::vector<int> > nodes;
+};
+
+#endif  // ARCH_RUNTIME_NUMA_HPP_
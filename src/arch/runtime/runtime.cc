@@ -61,8 +61,9 @@ private:
 };
 
 // Runs the action 'fun()' on thread zero.
-void run_in_thread_pool(const std::function<void()> &fun, int worker_threads) {
-    linux_thread_pool_t thread_pool(worker_threads, false);
+void run_in_thread_pool(const std::function<void()> &fun, int worker_threads,
+                        bool pin_threads) {
+    linux_thread_pool_t thread_pool(worker_threads, pin_threads);
     starter_t starter(&thread_pool, fun);
     thread_pool.run_thread_pool(&starter);
 }
@@ -0,0 +1,165 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/sampling_profiler.hpp"
+
+#include "arch/runtime/runtime.hpp"
+#include "backtrace.hpp"
+#include "rethinkdb_backtrace.hpp"
+#include "thread_local.hpp"
+
+TLS_with_init(int, sampling_profiler_countdown, SAMPLING_PROFILER_PERIOD);
+
+void sampling_profiler_t::histogram_t::record(ticks_t duration) {
+    ++count;
+    total += duration;
+    const uint64_t micros = duration / THOUSAND;
+    size_t bucket = 0;
+    if (micros > 0) {
+        // Bucket `i` holds durations from 2^(i-1) up to 2^i microseconds.
+        bucket = 64 - __builtin_clzll(micros);
+    }
+    ++buckets[std::min<size_t>(bucket, SAMPLING_PROFILER_NUM_BUCKETS - 1)];
+}
+
+void sampling_profiler_t::histogram_t::add(const histogram_t &other) {
+    count += other.count;
+    total += other.total;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        buckets[i] += other.buckets[i];
+    }
+}
+
+sampling_profiler_t::sampling_profiler_t() : enabled(false) { }
+
+sampling_profiler_t &sampling_profiler_t::get_global_profiler() {
+    // Singleton implementation as in `coro_profiler_t`.
+    static sampling_profiler_t profiler;
+    return profiler;
+}
+
+void sampling_profiler_t::set_enabled(bool _enabled) {
+    enabled = _enabled;
+}
+
+void sampling_profiler_t::reset() {
+    for (size_t i = 0; i < per_thread_samples.size(); ++i) {
+        per_thread_samples_t *samples = &per_thread_samples[i].value;
+        spinlock_acq_t lock(&samples->spinlock);
+        samples->execution_points.clear();
+    }
+}
+
+void sampling_profiler_t::get_report(report_t *report_out) {
+    report_out->clear();
+    for (size_t i = 0; i < per_thread_samples.size(); ++i) {
+        per_thread_samples_t *samples = &per_thread_samples[i].value;
+        spinlock_acq_t lock(&samples->spinlock);
+        for (auto it = samples->execution_points.begin();
+             it != samples->execution_points.end(); ++it) {
+            execution_point_stats_t *stats = &(*report_out)[it->first];
+            stats->run_time.add(it->second.run_time);
+            stats->wait_time.add(it->second.wait_time);
+        }
+    }
+}
+
+void sampling_profiler_t::record_resume(coro_state_t *state) {
+    ticks_t now = 0;
+    if (state->wait_started_at != 0) {
+        now = get_ticks();
+        rassert(now >= state->wait_started_at);
+        const trace_t trace(state->trace, state->trace + state->trace_size);
+        per_thread_samples_t *samples =
+            &per_thread_samples[get_thread_id().threadnum].value;
+        {
+            spinlock_acq_t lock(&samples->spinlock);
+            samples->execution_points[trace].wait_time.record(
+                now - state->wait_started_at);
+        }
+        state->wait_started_at = 0;
+    }
+
+    if (!enabled) {
+        return;
+    }
+    const int countdown = TLS_get_sampling_profiler_countdown() - 1;
+    if (countdown > 0) {
+        TLS_set_sampling_profiler_countdown(countdown);
+        return;
+    }
+    TLS_set_sampling_profiler_countdown(SAMPLING_PROFILER_PERIOD);
+    state->run_started_at = now != 0 ? now : get_ticks();
+}
+
+void sampling_profiler_t::record_yield(coro_state_t *state, bool will_resume) {
+    const ticks_t now = get_ticks();
+    rassert(now >= state->run_started_at);
+    const ticks_t run_time = now - state->run_started_at;
+    state->run_started_at = 0;
+
+    // We strip ourselves, `coro_t::wait()` and the frames that are inside
+    // `rethinkdb_backtrace()`.
+    const int levels_to_strip = 2 + NUM_FRAMES_INSIDE_RETHINKDB_BACKTRACE;
+    void *frames[SAMPLING_PROFILER_BACKTRACE_DEPTH + levels_to_strip];
+    const int num_frames = rethinkdb_backtrace(frames,
+        SAMPLING_PROFILER_BACKTRACE_DEPTH + levels_to_strip);
+    state->trace_size = std::max(0, num_frames - levels_to_strip);
+    for (int i = 0; i < state->trace_size; ++i) {
+        state->trace[i] = frames[i + levels_to_strip];
+    }
+
+    const trace_t trace(state->trace, state->trace + state->trace_size);
+    per_thread_samples_t *samples =
+        &per_thread_samples[get_thread_id().threadnum].value;
+    {
+        spinlock_acq_t lock(&samples->spinlock);
+        samples->execution_points[trace].run_time.record(run_time);
+    }
+
+    if (will_resume) {
+        state->wait_started_at = get_ticks();
+    }
+}
+
+std::string describe_trace_frame(void *addr) {
+    backtrace_frame_t frame(addr);
+    frame.initialize_symbols();
+    try {
+        return frame.get_demangled_name();
+    } catch (const demangle_failed_exc_t &) {
+        if (!frame.get_name().empty()) {
+            return frame.get_name();
+        }
+        return strprintf("%p", addr);
+    }
+}
+
+std::string format_folded_stacks(const sampling_profiler_t::report_t &report,
+                                 bool wait_time) {
+    std::map<void *, std::string> frame_descriptions;
+    std::string result;
+    for (auto it = report.begin(); it != report.end(); ++it) {
+        const sampling_profiler_t::histogram_t &histogram =
+            wait_time ? it->second.wait_time : it->second.run_time;
+        const int64_t micros = histogram.total / THOUSAND;
+        if (micros == 0) {
+            continue;
+        }
+        std::string line;
+        for (auto frame = it->first.rbegin(); frame != it->first.rend(); ++frame) {
+            auto description = frame_descriptions.find(*frame);
+            if (description == frame_descriptions.end()) {
+                description = frame_descriptions.insert(
+                    std::make_pair(*frame, describe_trace_frame(*frame))).first;
+            }
+            if (!line.empty()) {
+                line += ";";
+            }
+            line += description->second;
+        }
+        if (line.empty()) {
+            line = "<unknown>";
+        }
+        result += strprintf("%s %" PRIi64 "\n", line.c_str(), micros);
+    }
+    return result;
+}
@@ -0,0 +1,123 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_SAMPLING_PROFILER_HPP_
+#define ARCH_RUNTIME_SAMPLING_PROFILER_HPP_
+
+#include <array>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+/* Depth of the backtraces that identify an execution point. */
+#define SAMPLING_PROFILER_BACKTRACE_DEPTH       16
+
+/* Time histograms have one bucket per power of two microseconds; the last bucket
+also holds everything that's even slower. */
+#define SAMPLING_PROFILER_NUM_BUCKETS           24
+
+/*
+ * The `sampling_profiler_t` is a low-overhead variant of the `coro_profiler_t`
+ * that is compiled into every build and can be turned on and off while the server
+ * is running (see `profiler_http_app_t`).
+ *
+ * Rather than recording every time a coroutine yields, it picks one in every
+ * `SAMPLING_PROFILER_PERIOD` coroutine resumes on each thread. For that run of the
+ * coroutine, it records how long it ran and where it yielded (a backtrace of depth
+ * `SAMPLING_PROFILER_BACKTRACE_DEPTH`, the "execution point"), and then how long
+ * the coroutine waited at that point before it was resumed again. Run and wait
+ * times go into a histogram per execution point.
+ *
+ * While the profiler is off, the only cost is one branch per coroutine switch.
+ */
+class sampling_profiler_t {
+public:
+    /* The part of the profiler's state that lives in each `coro_t`. */
+    struct coro_state_t {
+        coro_state_t() : run_started_at(0), wait_started_at(0), trace_size(0) { }
+        // Non-zero if the current run of the coroutine is being sampled.
+        ticks_t run_started_at;
+        // Non-zero if the coroutine is waiting at a sampled execution point.
+        ticks_t wait_started_at;
+        int trace_size;
+        void *trace[SAMPLING_PROFILER_BACKTRACE_DEPTH];
+    };
+
+    struct histogram_t {
+        histogram_t() : count(0), total(0) {
+            buckets.fill(0);
+        }
+        void record(ticks_t duration);
+        void add(const histogram_t &other);
+        int64_t count;
+        ticks_t total;
+        std::array<int64_t, SAMPLING_PROFILER_NUM_BUCKETS> buckets;
+    };
+
+    struct execution_point_stats_t {
+        histogram_t run_time;
+        histogram_t wait_time;
+    };
+
+    typedef std::vector<void *> trace_t;
+    typedef std::map<trace_t, execution_point_stats_t> report_t;
+
+    sampling_profiler_t();
+
+    static sampling_profiler_t &get_global_profiler();
+
+    void set_enabled(bool enabled);
+    bool is_enabled() const { return enabled; }
+
+    /* Forgets everything that has been recorded so far. */
+    void reset();
+
+    /* Collects the samples of all threads. Can be called on any thread. */
+    void get_report(report_t *report_out);
+
+    /* Cheap enough to call on every coroutine switch; `coro_t` does that.
+    `will_resume` is false if the coroutine has finished. */
+    void on_coro_resume(coro_state_t *state) {
+        if (enabled || state->wait_started_at != 0) {
+            record_resume(state);
+        }
+    }
+    void on_coro_yield(coro_state_t *state, bool will_resume) {
+        if (state->run_started_at != 0) {
+            record_yield(state, will_resume);
+        }
+    }
+
+private:
+    struct per_thread_samples_t {
+        spinlock_t spinlock;
+        report_t execution_points;
+    };
+
+    void record_resume(coro_state_t *state);
+    void record_yield(coro_state_t *state, bool will_resume);
+
+    volatile bool enabled;
+
+    // Like in `coro_profiler_t`, one_per_thread_t would make the construction
+    // order tricky.
+    std::array<cache_line_padded_t<per_thread_samples_t>, MAX_THREADS> per_thread_samples;
+
+    DISABLE_COPYING(sampling_profiler_t);
+};
+
+/* Returns the name of the function at `addr`, for showing a trace. */
+std::string describe_trace_frame(void *addr);
+
+/* Formats a report as "folded stacks", one line per execution point with the
+frames from the outermost to the innermost separated by semicolons, followed by
+the total run or wait time in microseconds. That's the input format of most flame
+graph tools. */
+std::string format_folded_stacks(const sampling_profiler_t::report_t &report,
+                                 bool wait_time);
+
+#endif /* ARCH_RUNTIME_SAMPLING_PROFILER_HPP_ */
@@ -11,6 +11,7 @@
 #include "arch/os_signal.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "errors.hpp"
 #include "logger.hpp"
@@ -188,6 +189,8 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
     // Start child threads
     thread_barrier_t barrier(n_threads + 1);
 
+    numa_topology_t topology;
+
     for (int i = 0; i < n_threads; i++) {
         thread_data_t *tdata = new thread_data_t();
         tdata->barrier = &barrier;
@@ -199,16 +202,21 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
         int res = pthread_create(&pthreads[i], NULL, &start_thread, tdata);
         guarantee_xerr(res == 0, res, "Could not create thread");
 
-        if (do_set_affinity) {
+        // The utility thread isn't pinned; it does too little to be worth a core.
+        if (do_set_affinity && i < n_threads - 1) {
             // On Apple, the thread affinity API has awful documentation, so we don't even bother.
 #ifdef _GNU_SOURCE
-            // Distribute threads evenly among CPUs
-            int ncpus = get_cpu_count();
-            cpu_set_t mask;
-            CPU_ZERO(&mask);
-            CPU_SET(i % ncpus, &mask);
-            res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
-            guarantee_xerr(res == 0, res, "Could not set thread affinity");
+            /* Distribute threads evenly among the NUMA nodes and their CPUs. The
+            memory a thread touches first is allocated on its own node, so this
+            also keeps each thread's caches in local memory. */
+            const int cpu = topology.cpu_for_thread(i, n_threads - 1);
+            if (cpu != -1) {
+                cpu_set_t mask;
+                CPU_ZERO(&mask);
+                CPU_SET(cpu, &mask);
+                res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
+                guarantee_xerr(res == 0, res, "Could not set thread affinity");
+            }
 #endif
         }
     }
@@ -378,6 +386,7 @@ linux_thread_t::linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id)
     : queue(this),
       message_hub(&queue, parent_pool, threadnum_t(thread_id)),
       timer_handler(&queue),
+      work_queue(threadnum_t(thread_id)),
       do_shutdown(false)
 #ifndef NDEBUG
       , coroutine_counts_at_shutdown(NULL)
@@ -405,6 +414,8 @@ linux_thread_t::~linux_thread_t() {
 }
 
 void linux_thread_t::pump() {
+    // This may spawn a coroutine, whose message needs to be pushed.
+    work_queue.on_event_loop_pass(message_hub.has_pending_messages());
     message_hub.push_messages();
 }
 
@@ -12,6 +12,8 @@
 #include "arch/runtime/system_event.hpp"
 #include "arch/runtime/message_hub.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/work_stealing.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/timer.hpp"
@@ -163,6 +165,7 @@ public:
     linux_event_queue_t queue;
     linux_message_hub_t message_hub;
     timer_handler_t timer_handler;
+    work_stealing_queue_t work_queue;
 
     /* Never accessed; its constructor and destructor set up and tear down thread-local variables
     for coroutines. */
@@ -0,0 +1,141 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/work_stealing.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/thread_pool.hpp"
+
+void spawn_stealable(const std::function<void()> &action) {
+    linux_thread_pool_t::get_thread()->work_queue.push(action);
+}
+
+static work_stealing_queue_t *get_work_queue(int threadnum) {
+    return &linux_thread_pool_t::get_thread_pool()->threads[threadnum]->work_queue;
+}
+
+work_stealing_queue_t::work_stealing_queue_t(threadnum_t _thread)
+    : thread(_thread),
+      num_actions(0),
+      // Until its first event loop pass, the thread is waiting for events.
+      state(idle),
+      run_message(this),
+      run_scheduled(false),
+      wake_up_message(this) { }
+
+work_stealing_queue_t::~work_stealing_queue_t() {
+    guarantee(actions.empty());
+    guarantee(!run_scheduled);
+}
+
+void work_stealing_queue_t::push(const std::function<void()> &action) {
+    rassert(get_thread_id() == thread);
+    {
+        spinlock_acq_t acq(&lock);
+        actions.push_back(action);
+        num_actions = actions.size();
+    }
+    if (!run_scheduled) {
+        run_scheduled = true;
+        call_later_on_this_thread(&run_message);
+    }
+    wake_up_idle_thread(thread);
+}
+
+bool work_stealing_queue_t::take_front(std::function<void()> *action_out) {
+    spinlock_acq_t acq(&lock);
+    if (actions.empty()) {
+        return false;
+    }
+    *action_out = actions.front();
+    actions.pop_front();
+    num_actions = actions.size();
+    return true;
+}
+
+bool work_stealing_queue_t::take_back(std::function<void()> *action_out) {
+    spinlock_acq_t acq(&lock);
+    if (actions.empty()) {
+        return false;
+    }
+    *action_out = actions.back();
+    actions.pop_back();
+    num_actions = actions.size();
+    return true;
+}
+
+void work_stealing_queue_t::run_message_t::on_thread_switch() {
+    rassert(parent->run_scheduled);
+    std::function<void()> action;
+    if (parent->take_front(&action)) {
+        coro_t::spawn_sometime(action);
+    }
+    /* We run one action per message, so that the actions don't hold up the other
+    messages on this thread, and so that idle threads get a chance to take some. */
+    if (parent->num_actions > 0) {
+        call_later_on_this_thread(this);
+    } else {
+        parent->run_scheduled = false;
+    }
+}
+
+void work_stealing_queue_t::wake_up_message_t::on_thread_switch() {
+    __sync_bool_compare_and_swap(&parent->state, wake_up_pending, busy);
+    parent->try_steal();
+}
+
+void work_stealing_queue_t::on_event_loop_pass(bool has_work) {
+    // Only db threads take part; the utility thread must stay responsive.
+    if (thread.threadnum >= get_num_db_threads()) {
+        return;
+    }
+    if (has_work || run_scheduled) {
+        __sync_bool_compare_and_swap(&state, idle, busy);
+        return;
+    }
+    /* We become idle before we look for work, so that an action queued while we
+    look still wakes us up. */
+    __sync_bool_compare_and_swap(&state, busy, idle);
+    if (try_steal()) {
+        __sync_bool_compare_and_swap(&state, idle, busy);
+    }
+}
+
+bool work_stealing_queue_t::try_steal() {
+    const int num_db_threads = get_num_db_threads();
+    for (int i = 1; i < num_db_threads; ++i) {
+        work_stealing_queue_t *victim
+            = get_work_queue((thread.threadnum + i) % num_db_threads);
+        if (victim->num_actions == 0) {
+            continue;
+        }
+        std::function<void()> action;
+        if (victim->take_back(&action)) {
+            coro_t::spawn_sometime(action);
+            if (victim->num_actions > 0) {
+                // Get more help.
+                wake_up_idle_thread(thread);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_stealing_queue_t::wake_up_idle_thread(threadnum_t except) {
+    const int num_db_threads = get_num_db_threads();
+    for (int i = 0; i < num_db_threads; ++i) {
+        if (i == except.threadnum) {
+            continue;
+        }
+        work_stealing_queue_t *q = get_work_queue(i);
+        if (q->state == idle
+            && __sync_bool_compare_and_swap(&q->state, idle, wake_up_pending)) {
+            /* This goes straight to the other thread, rather than waiting for the
+            end of our event loop pass like other messages, because we're probably
+            busy. */
+            linux_thread_pool_t::get_thread_pool()->threads[i]->message_hub
+                .insert_external_message(&q->wake_up_message);
+            return;
+        }
+    }
+}
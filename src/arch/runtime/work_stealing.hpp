@@ -0,0 +1,90 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_WORK_STEALING_HPP_
+#define ARCH_RUNTIME_WORK_STEALING_HPP_
+
+#include <deque>
+#include <functional>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "arch/spinlock.hpp"
+#include "utils.hpp"
+
+/* Coroutines normally run on the thread that spawned them, so a busy thread stays
+busy while other threads have nothing to do. `spawn_stealable()` spawns a coroutine
+that may start on another db thread instead. Only use it for work that doesn't
+touch per-thread state (caches, `one_per_thread_t`s, connections...) and doesn't
+care where it runs; once the coroutine has started, it stays on that thread like
+any other.
+
+The action goes on the spawning thread's `work_stealing_queue_t`. That thread runs
+the actions on its queue in order, from its event loop, but a db thread whose event
+loop has run out of messages takes the newest action off the queue of another db
+thread and runs it itself. Threads that are waiting for events are woken up when
+an action is queued, so that they can take it. */
+void spawn_stealable(const std::function<void()> &action);
+
+/* There is one `work_stealing_queue_t` per thread; see `linux_thread_t`. */
+class work_stealing_queue_t {
+public:
+    explicit work_stealing_queue_t(threadnum_t thread);
+    ~work_stealing_queue_t();
+
+    // Must be called on the queue's thread.
+    void push(const std::function<void()> &action);
+
+    /* Called by the event loop of the queue's thread after every pass, with
+    `has_work` false if it has no messages left to process. */
+    void on_event_loop_pass(bool has_work);
+
+private:
+    enum state_t { busy = 0, idle = 1, wake_up_pending = 2 };
+
+    class run_message_t : public linux_thread_message_t {
+    public:
+        explicit run_message_t(work_stealing_queue_t *_parent) : parent(_parent) { }
+    private:
+        void on_thread_switch();
+        work_stealing_queue_t *parent;
+    };
+
+    class wake_up_message_t : public linux_thread_message_t {
+    public:
+        explicit wake_up_message_t(work_stealing_queue_t *_parent) : parent(_parent) { }
+    private:
+        void on_thread_switch();
+        work_stealing_queue_t *parent;
+    };
+
+    // Both can be called from any thread. `take_front()` is for the queue's own
+    // thread and `take_back()` for thieves.
+    bool take_front(std::function<void()> *action_out);
+    bool take_back(std::function<void()> *action_out);
+
+    /* Runs an action from another db thread's queue here. Returns false if there
+    was none. */
+    bool try_steal();
+
+    /* Wakes up one idle db thread other than `except`, if there is one. */
+    static void wake_up_idle_thread(threadnum_t except);
+
+    const threadnum_t thread;
+
+    spinlock_t lock;
+    std::deque<std::function<void()> > actions;
+    // The size of `actions`, so that thieves can skip empty queues without taking
+    // the lock.
+    volatile size_t num_actions;
+
+    /* A `state_t`. Only this thread sets it to `idle`, and only the thread that
+    sets it from `idle` to `wake_up_pending` sends `wake_up_message`, so that the
+    message is never sent twice at once. */
+    volatile int state;
+
+    run_message_t run_message;
+    bool run_scheduled;
+    wake_up_message_t wake_up_message;
+
+    DISABLE_COPYING(work_stealing_queue_t);
+};
+
+#endif  // ARCH_RUNTIME_WORK_STEALING_HPP_
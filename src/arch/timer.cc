@@ -3,11 +3,15 @@
 #include "arch/runtime/thread_pool.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t>,
+                      public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
+    friend class timer_wheel_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
+    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL),
+                      precision(PRECISE_TIMER), wheel_tick(-1), wheel_level(-1),
+                      wheel_slot(-1) { }
 
     friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
 
@@ -20,6 +24,15 @@ private:
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
 
+    // Precise tokens live in the `token_queue`, coarse ones in the `wheel`.
+    timer_precision_t precision;
+
+    // For coarse tokens: the tick of the next 'ring', and where in the wheel the
+    // token is. `wheel_level` is -1 while the token isn't in the wheel.
+    int64_t wheel_tick;
+    int wheel_level;
+    int wheel_slot;
+
     DISABLE_COPYING(timer_token_t);
 };
 
@@ -27,14 +40,146 @@ bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *rig
     return left->next_time_in_nanos < right->next_time_in_nanos;
 }
 
+/* timer_wheel_t */
+
+timer_wheel_t::timer_wheel_t() : current_tick(0), num_tokens(0) {
+    for (int level = 0; level < num_levels; ++level) {
+        nonempty[level] = 0;
+    }
+}
+
+timer_wheel_t::~timer_wheel_t() {
+    guarantee(num_tokens == 0);
+}
+
+int64_t timer_wheel_t::tick_at(int64_t nanos) {
+    return nanos / (TIMER_WHEEL_TICK_MS * MILLION);
+}
+
+int64_t timer_wheel_t::first_tick_after(int64_t nanos) {
+    return ceil_divide(nanos, TIMER_WHEEL_TICK_MS * MILLION);
+}
+
+int64_t timer_wheel_t::nanos_at(int64_t tick) {
+    return tick * TIMER_WHEEL_TICK_MS * MILLION;
+}
+
+void timer_wheel_t::insert(timer_token_t *token, int64_t now_tick) {
+    if (num_tokens == 0) {
+        // Nothing to keep track of, so we don't have to go through the ticks that
+        // passed since we were last advanced.
+        current_tick = std::max(current_tick, now_tick);
+    }
+    // The wheel may be a little ahead of `now_tick` when the oneshot came early.
+    token->wheel_tick = std::max(token->wheel_tick, current_tick + 1);
+    place(token);
+    ++num_tokens;
+}
+
+void timer_wheel_t::remove(timer_token_t *token) {
+    rassert(token->wheel_level != -1);
+    intrusive_list_t<timer_token_t> *slot = &slots[token->wheel_level][token->wheel_slot];
+    slot->remove(token);
+    if (slot->empty()) {
+        nonempty[token->wheel_level] &= ~(uint64_t(1) << token->wheel_slot);
+    }
+    token->wheel_level = token->wheel_slot = -1;
+    --num_tokens;
+}
+
+void timer_wheel_t::place(timer_token_t *token) {
+    rassert(token->wheel_tick >= current_tick);
+    int64_t tick = token->wheel_tick;
+    const int64_t max_delta = (int64_t(1) << (slot_bits * num_levels)) - 1;
+    if (tick - current_tick > max_delta) {
+        // Too far ahead; it will be placed again when this slot comes up.
+        tick = current_tick + max_delta;
+    }
+    const int64_t delta = tick - current_tick;
+    int level = 0;
+    while (delta >= (int64_t(1) << (slot_bits * (level + 1)))) {
+        ++level;
+    }
+    const int slot = (tick >> (slot_bits * level)) & (slots_per_level - 1);
+    token->wheel_level = level;
+    token->wheel_slot = slot;
+    slots[level][slot].push_back(token);
+    nonempty[level] |= uint64_t(1) << slot;
+}
+
+int64_t timer_wheel_t::next_event_tick() const {
+    int64_t next = -1;
+    for (int level = 0; level < num_levels; ++level) {
+        if (nonempty[level] == 0) {
+            continue;
+        }
+        /* The slot at position `p` of a level comes up at tick `p << shift`, and
+        the slots up to the current tick's position have come up already. */
+        const int shift = slot_bits * level;
+        const int64_t start = (current_tick >> shift) + 1;
+        const int rotation = start & (slots_per_level - 1);
+        const uint64_t rotated = rotation == 0
+            ? nonempty[level]
+            : (nonempty[level] >> rotation) | (nonempty[level] << (64 - rotation));
+        const int64_t tick = (start + __builtin_ctzll(rotated)) << shift;
+        if (next == -1 || tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+void timer_wheel_t::process_slot(int level, int slot,
+                                 intrusive_list_t<timer_token_t> *rung_out) {
+    intrusive_list_t<timer_token_t> *list = &slots[level][slot];
+    nonempty[level] &= ~(uint64_t(1) << slot);
+    while (timer_token_t *token = list->head()) {
+        list->remove(token);
+        if (level == 0) {
+            rassert(token->wheel_tick <= current_tick);
+            token->wheel_level = token->wheel_slot = -1;
+            --num_tokens;
+            rung_out->push_back(token);
+        } else {
+            // Its ring is less than a slot of this level away now, so this goes to
+            // a lower level (or to this level's furthest slot, if it's very far).
+            place(token);
+        }
+    }
+}
+
+void timer_wheel_t::advance(int64_t tick, intrusive_list_t<timer_token_t> *rung_out) {
+    while (true) {
+        const int64_t next = next_event_tick();
+        if (next == -1 || next > tick) {
+            current_tick = std::max(current_tick, tick);
+            return;
+        }
+        // Nothing happens in the ticks in between, so we skip straight there.
+        current_tick = next;
+        // Higher levels first, so that what moves down is handled in this tick too.
+        for (int level = num_levels - 1; level >= 0; --level) {
+            const int shift = slot_bits * level;
+            if ((current_tick & ((int64_t(1) << shift) - 1)) == 0) {
+                process_slot(level, (current_tick >> shift) & (slots_per_level - 1),
+                             rung_out);
+            }
+        }
+    }
+}
+
+/* timer_handler_t */
+
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      expected_oneshot_time_in_nanos(-1) {
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
 }
 
 timer_handler_t::~timer_handler_t() {
     guarantee(token_queue.empty());
+    guarantee(wheel.empty());
+    guarantee(ringing_coarse_tokens.empty());
 }
 
 void timer_handler_t::on_oneshot() {
@@ -43,13 +188,15 @@ void timer_handler_t::on_oneshot() {
     // threshold.  So we bump the real time up to the threshold when processing the priority queue.
     int64_t real_ticks = get_ticks();
     int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
+    expected_oneshot_time_in_nanos = -1;
 
     while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
         timer_token_t *token = token_queue.pop();
+        const bool once = token->interval_nanos == 0;
 
         // Put the repeating timer back on the queue before the callback can be called (so that it
         // may be canceled).
-        if (token->interval_nanos != 0) {
+        if (!once) {
             token->next_time_in_nanos = real_ticks + token->interval_nanos;
             token_queue.push(token);
         }
@@ -57,55 +204,111 @@ void timer_handler_t::on_oneshot() {
         token->callback->on_timer();
 
         // Delete nonrepeating timer tokens.
-        if (token->interval_nanos == 0) {
+        if (once) {
+            delete token;
+        }
+    }
+
+    // All the coarse timers that are due ring in one batch.
+    wheel.advance(timer_wheel_t::tick_at(ticks), &ringing_coarse_tokens);
+    while (timer_token_t *token = ringing_coarse_tokens.head()) {
+        ringing_coarse_tokens.remove(token);
+        const bool once = token->interval_nanos == 0;
+
+        if (!once) {
+            token->wheel_tick =
+                timer_wheel_t::first_tick_after(real_ticks + token->interval_nanos);
+            wheel.insert(token, timer_wheel_t::tick_at(real_ticks));
+        }
+
+        token->callback->on_timer();
+
+        if (once) {
             delete token;
         }
     }
 
     // We've processed young tokens.  Now schedule a new one-shot (if necessary).
+    schedule_next_oneshot();
+}
+
+void timer_handler_t::schedule_next_oneshot() {
+    int64_t next_time_in_nanos = -1;
     if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
+        next_time_in_nanos = token_queue.peek()->next_time_in_nanos;
+    }
+    if (!wheel.empty()) {
+        const int64_t wheel_time = timer_wheel_t::nanos_at(wheel.next_event_tick());
+        if (next_time_in_nanos == -1 || wheel_time < next_time_in_nanos) {
+            next_time_in_nanos = wheel_time;
+        }
+    }
+
+    if (next_time_in_nanos != -1
+        && (expected_oneshot_time_in_nanos == -1
+            || next_time_in_nanos < expected_oneshot_time_in_nanos)) {
+        timer_provider.schedule_oneshot(next_time_in_nanos, this);
+        expected_oneshot_time_in_nanos = next_time_in_nanos;
     }
 }
 
-timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callback_t *callback, const bool once) {
+timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callback_t *callback,
+                                                   const bool once,
+                                                   const timer_precision_t precision) {
     const int64_t nanos = ms * MILLION;
     rassert(nanos > 0);
 
-    const int64_t next_time_in_nanos = get_ticks() + nanos;
+    const int64_t now = get_ticks();
+    const int64_t next_time_in_nanos = now + nanos;
 
     timer_token_t *const token = new timer_token_t;
     token->interval_nanos = once ? 0 : nanos;
     token->next_time_in_nanos = next_time_in_nanos;
     token->callback = callback;
+    token->precision = precision;
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
-
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
-        timer_provider.schedule_oneshot(next_time_in_nanos, this);
+    if (precision == COARSE_TIMER) {
+        token->wheel_tick = timer_wheel_t::first_tick_after(next_time_in_nanos);
+        wheel.insert(token, timer_wheel_t::tick_at(now));
+    } else {
+        token_queue.push(token);
     }
 
+    schedule_next_oneshot();
+
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    if (token->precision == COARSE_TIMER) {
+        if (token->wheel_level == -1) {
+            // It's about to ring in the current `on_oneshot()`.
+            ringing_coarse_tokens.remove(token);
+        } else {
+            wheel.remove(token);
+        }
+    } else {
+        token_queue.remove(token);
+    }
     delete token;
 
-    if (token_queue.empty()) {
+    if (token_queue.empty() && wheel.empty()) {
         timer_provider.unschedule_oneshot();
+        expected_oneshot_time_in_nanos = -1;
     }
 }
 
 
 
-timer_token_t *add_timer(int64_t ms, timer_callback_t *callback) {
-    return linux_thread_pool_t::get_thread()->timer_handler.add_timer_internal(ms, callback, false);
+timer_token_t *add_timer(int64_t ms, timer_callback_t *callback, timer_precision_t precision) {
+    return linux_thread_pool_t::get_thread()->timer_handler.add_timer_internal(ms, callback, false,
+                                                                               precision);
 }
 
-timer_token_t *fire_timer_once(int64_t ms, timer_callback_t *callback) {
-    return linux_thread_pool_t::get_thread()->timer_handler.add_timer_internal(ms, callback, true);
+timer_token_t *fire_timer_once(int64_t ms, timer_callback_t *callback,
+                               timer_precision_t precision) {
+    return linux_thread_pool_t::get_thread()->timer_handler.add_timer_internal(ms, callback, true,
+                                                                               precision);
 }
 
 void cancel_timer(timer_token_t *timer) {
@@ -2,6 +2,7 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
+#include "containers/intrusive_list.hpp"
 #include "containers/intrusive_priority_queue.hpp"
 #include "arch/io/timer_provider.hpp"
 
@@ -12,6 +13,66 @@ struct timer_callback_t {
     virtual ~timer_callback_t() { }
 };
 
+/* Precise timers ring as close to their time as the OS lets us. Coarse timers may
+ring up to `TIMER_WHEEL_TICK_MS` late, but stay cheap to add and cancel when there
+are a great many of them; use them for timeouts, which usually get canceled before
+they ring. */
+enum timer_precision_t {
+    PRECISE_TIMER,
+    COARSE_TIMER
+};
+
+/* A hierarchical timing wheel for coarse timers. Adding and canceling a timer takes
+constant time, and all the timers that ring in the same tick are handled together.
+
+Time is counted in ticks of `TIMER_WHEEL_TICK_MS`. Each level has 64 slots, and a
+slot of level `n` spans 64^n ticks. A timer goes into the lowest level whose slots
+reach far enough ahead, and is moved down a level each time its slot comes up,
+until it rings from level 0. Timers further ahead than the top level reaches (about
+two days) wait in its furthest slot. */
+class timer_wheel_t {
+public:
+    timer_wheel_t();
+    ~timer_wheel_t();
+
+    bool empty() const { return num_tokens == 0; }
+
+    /* `token->wheel_tick`, the tick at which it should ring, must be set and be
+    after `now_tick`, the tick of the current time. */
+    void insert(timer_token_t *token, int64_t now_tick);
+    void remove(timer_token_t *token);
+
+    /* Returns the tick at which the wheel next has to be advanced, or -1 if it's
+    empty. No timer rings before that, but one might not ring then either. */
+    int64_t next_event_tick() const;
+
+    /* Moves the wheel forward to `tick` and appends the timers that rang to
+    `rung_out`. */
+    void advance(int64_t tick, intrusive_list_t<timer_token_t> *rung_out);
+
+    // Rounded down and up, respectively.
+    static int64_t tick_at(int64_t nanos);
+    static int64_t first_tick_after(int64_t nanos);
+    static int64_t nanos_at(int64_t tick);
+
+private:
+    static const int num_levels = 4;
+    static const int slot_bits = 6;
+    static const int slots_per_level = 1 << slot_bits;
+
+    void place(timer_token_t *token);
+    void process_slot(int level, int slot, intrusive_list_t<timer_token_t> *rung_out);
+
+    // The last tick we've advanced to; the timers on slots up to it are handled.
+    int64_t current_tick;
+    size_t num_tokens;
+    intrusive_list_t<timer_token_t> slots[num_levels][slots_per_level];
+    // Bit `i` of `nonempty[n]` is set if `slots[n][i]` is not empty.
+    uint64_t nonempty[num_levels];
+
+    DISABLE_COPYING(timer_wheel_t);
+};
+
 /* This timer class uses the underlying OS timer provider to get one-shot timing events. It then
  * manages a list of application timers based on that lower level interface. Everyone who needs a
  * timer should use this class (through the thread pool). */
@@ -20,22 +81,33 @@ public:
     explicit timer_handler_t(linux_event_queue_t *queue);
     ~timer_handler_t();
 
-    timer_token_t *add_timer_internal(int64_t ms, timer_callback_t *callback, bool once);
+    timer_token_t *add_timer_internal(int64_t ms, timer_callback_t *callback, bool once,
+                                      timer_precision_t precision = PRECISE_TIMER);
     void cancel_timer(timer_token_t *timer);
 
 private:
     void on_oneshot();
 
+    /* Asks the timer provider for a oneshot at the next time that a precise timer
+    rings or the wheel needs to advance, unless one is scheduled before then
+    already. */
+    void schedule_next_oneshot();
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
     // The expected time of the next on_oneshot call.  If the oneshot arrived earlier than this
-    // time, we pretend that it had arrived on time.
+    // time, we pretend that it had arrived on time.  -1 if there is none.
     int64_t expected_oneshot_time_in_nanos;
 
-    // A priority queue of timer tokens, ordered by the soonest.
+    // A priority queue of precise timer tokens, ordered by the soonest.
     intrusive_priority_queue_t<timer_token_t> token_queue;
 
+    // The coarse timer tokens.
+    timer_wheel_t wheel;
+    // Coarse timer tokens that are ringing in the current `on_oneshot()`.
+    intrusive_list_t<timer_token_t> ringing_coarse_tokens;
+
     DISABLE_COPYING(timer_handler_t);
 };
 
@@ -44,8 +116,10 @@ private:
  * executed on the same thread that they were created on. Thus, non-thread-safe
  * (but coroutine-safe) concurrency primitives can be used where appropriate.
  */
-timer_token_t *add_timer(int64_t ms, timer_callback_t *callback);
-timer_token_t *fire_timer_once(int64_t ms, timer_callback_t *callback);
+timer_token_t *add_timer(int64_t ms, timer_callback_t *callback,
+                         timer_precision_t precision = PRECISE_TIMER);
+timer_token_t *fire_timer_once(int64_t ms, timer_callback_t *callback,
+                               timer_precision_t precision = PRECISE_TIMER);
 void cancel_timer(timer_token_t *timer);
 
 
@@ -33,14 +33,14 @@ signal_timer_t::~signal_timer_t() {
     }
 }
 
-void signal_timer_t::start(int64_t ms) {
+void signal_timer_t::start(int64_t ms, timer_precision_t precision) {
     guarantee(timer == NULL);
     guarantee(!is_pulsed());
     if (ms == 0) {
         pulse();
     } else {
         guarantee(ms > 0);
-        timer = fire_timer_once(ms, this);
+        timer = fire_timer_once(ms, this, precision);
     }
 }
 
@@ -25,8 +25,9 @@ public:
     explicit signal_timer_t();
     ~signal_timer_t();
 
-    // Starts the timer, cannot be called if the timer is already running
-    void start(int64_t ms);
+    // Starts the timer, cannot be called if the timer is already running. Use a
+    // `COARSE_TIMER` for timeouts.
+    void start(int64_t ms, timer_precision_t precision = PRECISE_TIMER);
 
     // Stops the timer from running
     // Returns true if the timer was canceled, false if there was no timer to cancel
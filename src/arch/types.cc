@@ -1,8 +1,10 @@
 #include "arch/types.hpp"
 
-file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit) :
+file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit,
+                               int latency_target_ms) :
     parent(par),
-    account(parent->create_account(pri, outstanding_requests_limit)) { }
+    account(parent->create_account(pri, outstanding_requests_limit,
+                                   latency_target_ms)) { }
 
 file_account_t::~file_account_t() {
     parent->destroy_account(account);
@@ -11,6 +11,7 @@ struct iovec;
 
 #define DEFAULT_DISK_ACCOUNT (static_cast<file_account_t *>(0))
 #define UNLIMITED_OUTSTANDING_REQUESTS (-1)
+#define NO_IO_LATENCY_TARGET (-1)
 
 // TODO: Remove this from this header.
 
@@ -96,9 +97,15 @@ typedef linux_nonthrowing_tcp_listener_t non_throwing_tcp_listener_t;
 class linux_tcp_listener_t;
 typedef linux_tcp_listener_t tcp_listener_t;
 
+class linux_reuseport_tcp_listener_t;
+typedef linux_reuseport_tcp_listener_t reuseport_tcp_listener_t;
+
 class linux_repeated_nonthrowing_tcp_listener_t;
 typedef linux_repeated_nonthrowing_tcp_listener_t repeated_nonthrowing_tcp_listener_t;
 
+class linux_local_listener_t;
+typedef linux_local_listener_t local_listener_t;
+
 class linux_tcp_conn_descriptor_t;
 typedef linux_tcp_conn_descriptor_t tcp_conn_descriptor_t;
 
@@ -107,7 +114,9 @@ typedef linux_tcp_conn_t tcp_conn_t;
 
 enum class file_direct_io_mode_t {
     direct_desired,
-    buffered_desired
+    buffered_desired,
+    // Like direct_desired, but writes go through a write_combiner_t.
+    write_combining_desired
 };
 
 
@@ -138,6 +147,17 @@ public:
     virtual void set_size(int64_t size) = 0;
     virtual void set_size_at_least(int64_t size) = 0;
 
+    // Grows the file to at least `size` bytes and allocates disk space for all of it.
+    // The work happens in a blocker pool thread, so this blocks the calling coroutine
+    // but not its thread.  Returns false if the space couldn't be allocated (for
+    // example because the file system doesn't support it).
+    virtual bool preallocate(int64_t size) = 0;
+    // Gives the disk space of [offset, offset + length) back to the file system
+    // without changing the file size.  The range reads back as zeros afterwards.
+    // Blocks the calling coroutine like preallocate().  Returns false if the file
+    // system doesn't support it.
+    virtual bool punch_hole(int64_t offset, int64_t length) = 0;
+
     virtual void read_async(int64_t offset, size_t length, void *buf,
                             file_account_t *account, linux_iocallback_t *cb) = 0;
     virtual void write_async(int64_t offset, size_t length, const void *buf,
@@ -147,7 +167,10 @@ public:
     virtual void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                               file_account_t *account, linux_iocallback_t *cb) = 0;
 
-    virtual void *create_account(int priority, int outstanding_requests_limit) = 0;
+    // latency_target_ms is how long (in milliseconds) the account's requests should
+    // at most wait to be sent to the disk, or NO_IO_LATENCY_TARGET.
+    virtual void *create_account(int priority, int outstanding_requests_limit,
+                                 int latency_target_ms) = 0;
     virtual void destroy_account(void *account) = 0;
 
     virtual bool coop_lock_and_check() = 0;
@@ -158,7 +181,8 @@ private:
 
 class file_account_t {
 public:
-    file_account_t(file_t *f, int p, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS);
+    file_account_t(file_t *f, int p, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS,
+                   int latency_target_ms = NO_IO_LATENCY_TARGET);
     ~file_account_t();
     void *get_account() { return account; }
 
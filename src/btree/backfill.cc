@@ -84,8 +84,14 @@ struct backfill_traversal_helper_t : public btree_traversal_helper_t, public hom
             block_id_t id;
             ids_source->get_block_id_and_bounding_interval(i, &id, &left, &right);
             if (overlaps(left, right, key_range_.left, key_range_.right)) {
-                repli_timestamp_t recency;
-                {
+                // Acquiring the child would load it, which for a mostly cold table
+                // means reading every child, changed or not.  The cache can tell us
+                // the child's recency without that.  (It might report a newer
+                // recency than our snapshot of the child has, which only costs us a
+                // visit.  If the child has been deleted since our snapshot, we have
+                // to acquire it after all.)
+                repli_timestamp_t recency = parent.cache()->peek_recency(id);
+                if (recency == repli_timestamp_t::invalid) {
                     buf_lock_t lock(parent, id, access_t::read);
                     recency = lock.get_recency();
                 }
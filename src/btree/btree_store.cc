@@ -1,11 +1,18 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/btree_store.hpp"
 
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "btree/compact.hpp"
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
 #include "buffer_cache/alt/alt.hpp"
+#include "concurrency/background_governor.hpp"
 #include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "containers/archive/vector_stream.hpp"
+#include "logger.hpp"
 #include "serializer/config.hpp"
 #include "stl_utils.hpp"
 
@@ -25,6 +32,7 @@ template <class protocol_t>
 btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
                                          const std::string &perfmon_name,
                                          int64_t cache_target,
+                                         cache_balancer_t *balancer,
                                          bool create,
                                          perfmon_collection_t *parent_perfmon_collection,
                                          typename protocol_t::context_t *,
@@ -32,13 +40,20 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
                                          const base_path_t &base_path)
     : store_view_t<protocol_t>(protocol_t::region_t::universe()),
       perfmon_collection(),
+      pm_read_latency(secs_to_ticks(1)),
+      pm_write_latency(secs_to_ticks(1)),
+      pm_query_cpu(secs_to_ticks(1)),
+      pm_latency_membership(&perfmon_collection,
+                            &pm_read_latency, "read_latency",
+                            &pm_write_latency, "write_latency",
+                            &pm_query_cpu, "query_cpu"),
       io_backender_(io_backender), base_path_(base_path),
       perfmon_collection_membership(parent_perfmon_collection, &perfmon_collection, perfmon_name)
 {
     {
         alt_cache_config_t config;
         config.page_config.memory_limit = cache_target;
-        cache.init(new cache_t(serializer, config, &perfmon_collection));
+        cache.init(new cache_t(serializer, config, balancer, &perfmon_collection));
         general_cache_conn.init(new cache_conn_t(cache.get()));
     }
 
@@ -94,6 +109,31 @@ btree_store_t<protocol_t>::~btree_store_t() {
     assert_thread();
 }
 
+template <class protocol_t>
+void btree_store_t<protocol_t>::use_cache_warmup_file(const std::string &filepath) {
+    assert_thread();
+    cache->use_warmup_file(filepath);
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::use_cache_flash_file(const std::string &filepath,
+                                                     uint64_t size) {
+    assert_thread();
+    scoped_ptr_t<file_t> file;
+    // Whatever the file holds is from an earlier run, and no good to us.
+    const file_open_result_t res
+        = open_file(filepath.c_str(),
+                    linux_file_t::mode_read | linux_file_t::mode_write
+                    | linux_file_t::mode_create | linux_file_t::mode_truncate,
+                    io_backender_, &file);
+    if (res.outcome == file_open_result_t::ERROR) {
+        logWRN("Could not open the flash cache file \"%s\": %s",
+               filepath.c_str(), errno_string(res.errsv).c_str());
+        return;
+    }
+    cache->use_flash_cache(std::move(file), size);
+}
+
 template <class protocol_t>
 void btree_store_t<protocol_t>::read(
         DEBUG_ONLY(const metainfo_checker_t<protocol_t>& metainfo_checker, )
@@ -104,6 +144,10 @@ void btree_store_t<protocol_t>::read(
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
+    // Queries shouldn't have to wait for the backfills that run on this thread.
+    with_latency_class_t latency_class(LATENCY_CLASS_INTERACTIVE);
+    const ticks_t start_time = get_ticks();
+    coro_run_timer_t run_timer;
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> superblock;
 
@@ -114,6 +158,8 @@ void btree_store_t<protocol_t>::read(
     DEBUG_ONLY(check_metainfo(DEBUG_ONLY(metainfo_checker, ) superblock.get());)
 
     protocol_read(read, response, btree.get(), superblock.get(), interruptor);
+    pm_read_latency.record(get_ticks() - start_time);
+    pm_query_cpu.record(ticks_to_secs(run_timer.get_run_time()));
 }
 
 template <class protocol_t>
@@ -129,6 +175,8 @@ void btree_store_t<protocol_t>::write(
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
+    const ticks_t start_time = get_ticks();
+    coro_run_timer_t run_timer;
 
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> real_superblock;
@@ -142,6 +190,8 @@ void btree_store_t<protocol_t>::write(
     scoped_ptr_t<superblock_t> superblock(real_superblock.release());
     protocol_write(write, response, timestamp, btree.get(), &superblock,
                    interruptor);
+    pm_write_latency.record(get_ticks() - start_time);
+    pm_query_cpu.record(ticks_to_secs(run_timer.get_run_time()));
 }
 
 // TODO: Figure out wtf does the backfill filtering, figure out wtf constricts delete range operations to hit only a certain hash-interval, figure out what filters keys.
@@ -239,6 +289,45 @@ void btree_store_t<protocol_t>::reset_data(
                         interruptor);
 }
 
+template <class protocol_t>
+void btree_store_t<protocol_t>::compact_primary_btree(value_sizer_t<void> *sizer,
+                                                      signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+
+    store_key_t cursor = store_key_t::min();
+    bool more = true;
+    while (more) {
+        {
+            write_token_pair_t token_pair;
+            this->new_write_token_pair(&token_pair);
+            wait_interruptible(token_pair.main_write_token.get(), interruptor);
+
+            // Merging moves keys between leaves, so the leaves a merge writes need
+            // a recency at least as recent as any of the keys it might move there,
+            // or a backfill could skip them.  Every write acquires the superblock,
+            // and we hold the write token, so nothing can be more recent than it.
+            const repli_timestamp_t timestamp = cache->peek_recency(SUPERBLOCK_ID);
+
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_write(timestamp,
+                                         2 * BTREE_COMPACT_BATCH_LEAVES,
+                                         write_durability_t::SOFT,
+                                         &token_pair,
+                                         &txn,
+                                         &superblock,
+                                         interruptor);
+            more = btree_compact_leaves(sizer, superblock.get(),
+                                        BTREE_COMPACT_BATCH_LEAVES, &cursor);
+        }
+        if (more) {
+            nap(BTREE_COMPACT_INTERVAL_MS, interruptor);
+            wait_for_background_turn(interruptor);
+        }
+    }
+}
+
 template <class protocol_t>
 void btree_store_t<protocol_t>::lock_sindex_queue(buf_lock_t *sindex_block,
                                                   mutex_t::acq_t *acq) {
@@ -26,6 +26,7 @@ struct rdb_protocol_t;
 template <class T> class btree_store_t;
 
 class btree_slice_t;
+class cache_balancer_t;
 class io_backender_t;
 class superblock_t;
 class real_superblock_t;
@@ -47,6 +48,7 @@ public:
     btree_store_t(serializer_t *serializer,
                   const std::string &perfmon_name,
                   int64_t cache_target,
+                  cache_balancer_t *balancer,
                   bool create,
                   perfmon_collection_t *parent_perfmon_collection,
                   typename protocol_t::context_t *,
@@ -54,6 +56,15 @@ public:
                   const base_path_t &base_path);
     virtual ~btree_store_t();
 
+    // Keeps the store's page cache warm across restarts, see
+    // page_cache_t::use_warmup_file.
+    void use_cache_warmup_file(const std::string &filepath);
+
+    // Gives the store's page cache a flash cache of size bytes in the file at
+    // filepath, see page_cache_t::use_flash_cache.  If the file can't be opened,
+    // the cache does without.
+    void use_cache_flash_file(const std::string &filepath, uint64_t size);
+
     /* store_view_t interface */
     void new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out);
     void new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out);
@@ -117,6 +128,13 @@ public:
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t);
 
+    /* Merges and levels the underfull nodes of the primary btree, a few leaves per
+    write txn (see btree_compact_leaves), until it has visited every leaf.  The
+    txns queue up behind the store's other writes, and there's a pause between
+    them, so that a compaction doesn't hold up the writes for long. */
+    void compact_primary_btree(value_sizer_t<void> *sizer, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
     void lock_sindex_queue(buf_lock_t *sindex_block, mutex_t::acq_t *acq);
 
     void register_sindex_queue(
@@ -331,6 +349,10 @@ public:
     fifo_enforcer_sink_t main_token_sink, sindex_token_sink;
 
     perfmon_collection_t perfmon_collection;
+    perfmon_latency_histogram_t pm_read_latency, pm_write_latency;
+    // The CPU time that reads and writes take, in seconds per second.
+    perfmon_rate_monitor_t pm_query_cpu;
+    perfmon_multi_membership_t pm_latency_membership;
     // Mind the constructor ordering. We must destruct the cache and btree
     // before we destruct perfmon_collection
     scoped_ptr_t<cache_t> cache;
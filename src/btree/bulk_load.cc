@@ -0,0 +1,172 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/bulk_load.hpp"
+
+#include <algorithm>
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "btree/operations.hpp"
+
+btree_bulk_loader_t::btree_bulk_loader_t(value_sizer_t<void> *sizer,
+                                         superblock_t *superblock,
+                                         repli_timestamp_t tstamp)
+    : sizer_(sizer), superblock_(superblock), tstamp_(tstamp),
+      has_last_key_(false), num_added_(0), finished_(false) {
+    ensure_stat_block(superblock_);
+
+    // Walk down the right edge of the tree, keeping every node on it acquired for
+    // write.  These are the only nodes a bulk load modifies.
+    std::vector<buf_lock_t> top_down;
+    top_down.push_back(get_root(sizer_, superblock_));
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&top_down.back());
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                const leaf_node_t *leaf_node = reinterpret_cast<const leaf_node_t *>(node);
+                const btree_key_t *greatest = leaf::greatest_key(leaf_node);
+                if (greatest != NULL) {
+                    has_last_key_ = true;
+                    last_key_.assign(greatest);
+                }
+                break;
+            }
+            const internal_node_t *internal = reinterpret_cast<const internal_node_t *>(node);
+            rassert(internal->npairs >= 2);
+            // The keys of the rightmost child are greater than the node's last
+            // real key.
+            has_last_key_ = true;
+            last_key_.assign(
+                &internal_node::get_pair_by_index(internal, internal->npairs - 2)->key);
+            child_id = internal_node::get_pair_by_index(internal,
+                                                        internal->npairs - 1)->lnode;
+        }
+        buf_lock_t child(&top_down.back(), child_id, access_t::write);
+        top_down.push_back(std::move(child));
+    }
+
+    for (auto it = top_down.rbegin(); it != top_down.rend(); ++it) {
+        right_edge_.push_back(std::move(*it));
+    }
+}
+
+btree_bulk_loader_t::~btree_bulk_loader_t() {
+    rassert(finished_, "btree_bulk_loader_t destroyed without calling finish()");
+}
+
+void btree_bulk_loader_t::add(const btree_key_t *key, const void *value) {
+    guarantee(!finished_);
+    guarantee(!has_last_key_ || btree_key_cmp(last_key_.btree_key(), key) < 0,
+              "Bulk loaded keys must be increasing, and greater than the keys already "
+              "in the btree.");
+
+    bool leaf_is_full;
+    {
+        buf_read_t read(&right_edge_[0]);
+        leaf_is_full = leaf::is_full(sizer_,
+                                     static_cast<const leaf_node_t *>(read.get_data_read()),
+                                     key, value);
+    }
+    if (leaf_is_full) {
+        buf_lock_t new_leaf(buf_parent_t(txn()), alt_create_t::create);
+        {
+            buf_write_t write(&new_leaf);
+            leaf::init(sizer_, static_cast<leaf_node_t *>(write.get_data_write()));
+        }
+        // A full leaf can't be empty, so we have its last key.
+        rassert(has_last_key_);
+        add_node(1, last_key_.btree_key(), &new_leaf);
+    }
+
+    {
+        buf_write_t write(&right_edge_[0]);
+        leaf::insert(sizer_, static_cast<leaf_node_t *>(write.get_data_write()),
+                     key, value, tstamp_, key_modification_proof_t::real_proof());
+    }
+    has_last_key_ = true;
+    last_key_.assign(key);
+    ++num_added_;
+}
+
+void btree_bulk_loader_t::add_node(size_t level, const btree_key_t *separator,
+                                   buf_lock_t *new_node) {
+    const block_size_t block_size = sizer_->block_size();
+    const block_id_t old_child_id = right_edge_[level - 1].block_id();
+
+    if (level == right_edge_.size()) {
+        // The old root gets a new parent, which becomes the root.
+        buf_lock_t new_root(buf_parent_t(txn()), alt_create_t::create);
+        {
+            buf_write_t write(&new_root);
+            internal_node_t *node = static_cast<internal_node_t *>(write.get_data_write());
+            internal_node::init(block_size, node);
+            guarantee(internal_node::insert(block_size, node, separator,
+                                            old_child_id, new_node->block_id()));
+        }
+        insert_root(new_root.block_id(), superblock_);
+        right_edge_.push_back(std::move(new_root));
+    } else {
+        bool parent_is_full;
+        {
+            buf_read_t read(&right_edge_[level]);
+            parent_is_full = internal_node::is_full(
+                static_cast<const internal_node_t *>(read.get_data_read()));
+        }
+
+        if (!parent_is_full) {
+            // The parent's last pair points at the old child.  This gives the old
+            // child the separator as its key and makes the new node the last child.
+            buf_write_t write(&right_edge_[level]);
+            internal_node_t *node = static_cast<internal_node_t *>(write.get_data_write());
+            guarantee(internal_node::insert(block_size, node, separator,
+                                            old_child_id, new_node->block_id()));
+        } else {
+            // We start a new parent.  It gets the old child along with the new node,
+            // so that no internal node is left with a single child (and an empty
+            // key) for later merges to trip over.
+            store_key_t parent_separator;
+            {
+                buf_write_t write(&right_edge_[level]);
+                internal_node_t *node
+                    = static_cast<internal_node_t *>(write.get_data_write());
+                rassert(node->npairs >= 2);
+                parent_separator.assign(
+                    &internal_node::get_pair_by_index(node, node->npairs - 2)->key);
+                // The separator is greater than every key in the node, so this
+                // removes the last pair, and the pair before it takes its place.
+                internal_node::remove(block_size, node, separator);
+            }
+
+            buf_lock_t new_parent(buf_parent_t(txn()), alt_create_t::create);
+            {
+                buf_write_t write(&new_parent);
+                internal_node_t *node
+                    = static_cast<internal_node_t *>(write.get_data_write());
+                internal_node::init(block_size, node);
+                guarantee(internal_node::insert(block_size, node, separator,
+                                                old_child_id, new_node->block_id()));
+            }
+            add_node(level + 1, parent_separator.btree_key(), &new_parent);
+        }
+    }
+
+    // This releases the old child, which we won't touch again.
+    right_edge_[level - 1] = std::move(*new_node);
+}
+
+void btree_bulk_loader_t::finish() {
+    guarantee(!finished_);
+    finished_ = true;
+
+    if (num_added_ > 0) {
+        buf_lock_t stat_block(buf_parent_t(txn()), superblock_->get_stat_block_id(),
+                              access_t::write);
+        buf_write_t write(&stat_block);
+        static_cast<btree_statblock_t *>(write.get_data_write())->population
+            += num_added_;
+    }
+
+    right_edge_.clear();
+}
@@ -0,0 +1,75 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_BULK_LOAD_HPP_
+#define BTREE_BULK_LOAD_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "repli_timestamp.hpp"
+
+class superblock_t;
+template <class> class value_sizer_t;
+
+/* Appends key/value pairs at the right edge of a btree, filling leaf nodes one after
+another and building the internal nodes above them bottom-up, instead of inserting
+each pair with a root-to-leaf descent.  New nodes are left full, apart from the ones
+on the right edge, so a bulk load doesn't leave behind a trail of half-empty nodes
+the way a sequence of random-order inserts and leaf splits does.
+
+The keys passed to add() must be strictly increasing and greater than every key
+already in the tree.  That makes this suitable for loading a table from sorted input
+(an import, or a backfill of an empty table), batch by batch.  A loader works within
+a single txn, holding the superblock and the right edge of the tree for write until
+finish() is called; to load more data than one txn should hold, use a new txn and a
+new loader for each batch.
+
+The values must already be in the sizer's format, with any blobs they reference
+already written.  The loader only maintains the primary btree and its stat block;
+secondary indexes have to be brought up to date by the caller. */
+class btree_bulk_loader_t {
+public:
+    // superblock must be acquired for write, and must outlive the loader.
+    btree_bulk_loader_t(value_sizer_t<void> *sizer,
+                        superblock_t *superblock,
+                        repli_timestamp_t tstamp);
+    ~btree_bulk_loader_t();
+
+    void add(const btree_key_t *key, const void *value);
+
+    // Updates the stat block and releases the right edge of the tree.  No more pairs
+    // may be added afterwards.
+    void finish();
+
+    int64_t num_added() const { return num_added_; }
+
+private:
+    // Makes *new_node, whose keys are all greater than separator, the rightmost node
+    // at level - 1 (in place of right_edge_[level - 1], whose keys are all less than
+    // or equal to separator) by linking it into the internal node at `level`.
+    void add_node(size_t level, const btree_key_t *separator, buf_lock_t *new_node);
+
+    txn_t *txn() { return right_edge_[0].txn(); }
+
+    value_sizer_t<void> *const sizer_;
+    superblock_t *const superblock_;
+    const repli_timestamp_t tstamp_;
+
+    // The rightmost node at every level of the tree, from the rightmost leaf up to
+    // the root.
+    std::vector<buf_lock_t> right_edge_;
+
+    // The greatest key in the tree (or a lower bound of the keys in the rightmost
+    // leaf, if it is empty), if there is one.
+    bool has_last_key_;
+    store_key_t last_key_;
+
+    int64_t num_added_;
+    bool finished_;
+
+    DISABLE_COPYING(btree_bulk_loader_t);
+};
+
+#endif  // BTREE_BULK_LOAD_HPP_
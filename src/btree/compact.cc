@@ -0,0 +1,94 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/compact.hpp"
+
+#include "btree/internal_node.hpp"
+#include "btree/node.hpp"
+#include "btree/operations.hpp"
+#include "buffer_cache/alt/alt.hpp"
+
+int internal_npairs(buf_lock_t *buf) {
+    buf_read_t read(buf);
+    return static_cast<const internal_node_t *>(read.get_data_read())->npairs;
+}
+
+// Visits the leaf that `key` belongs in.  Sets *bound_out to the greatest key that
+// can be in the leaf, and returns false if the leaf is on the right edge of the
+// btree and has no such bound.
+bool compact_leaf(value_sizer_t<void> *sizer, superblock_t *superblock,
+                  const btree_key_t *key, store_key_t *bound_out) {
+    bool has_bound = false;
+    buf_lock_t last_buf;
+    buf_lock_t buf = get_root(sizer, superblock);
+
+    for (;;) {
+        if (!last_buf.empty()) {
+            // A merged node can still be underfull, so we keep going as long as
+            // there's a sibling to merge it with.
+            for (;;) {
+                const int parent_npairs = internal_npairs(&last_buf);
+                check_and_handle_underfull(sizer, &buf, &last_buf, superblock, key);
+                if (superblock->get_root_block_id() == buf.block_id()) {
+                    // The parent was the root, and buf was left as its only
+                    // child, so buf has replaced it.
+                    last_buf.reset_buf_lock();
+                    break;
+                }
+                if (internal_npairs(&last_buf) == parent_npairs) {
+                    // Nothing was merged (though the nodes might have been
+                    // leveled).
+                    break;
+                }
+            }
+        }
+
+        if (!last_buf.empty()) {
+            // The keys of the parent's last child are bounded by the parent's
+            // bound, which we already have.
+            buf_read_t read(&last_buf);
+            const internal_node_t *parent
+                = static_cast<const internal_node_t *>(read.get_data_read());
+            const int index = internal_node::get_offset_index(parent, key);
+            if (index < parent->npairs - 1) {
+                has_bound = true;
+                bound_out->assign(&internal_node::get_pair_by_index(parent, index)->key);
+            }
+        }
+
+        block_id_t child_id;
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                break;
+            }
+            child_id = internal_node::lookup(
+                reinterpret_cast<const internal_node_t *>(node), key);
+        }
+        rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+
+        last_buf.reset_buf_lock();
+        buf_lock_t child(&buf, child_id, access_t::write);
+        last_buf = std::move(buf);
+        buf = std::move(child);
+    }
+
+    return has_bound;
+}
+
+bool btree_compact_leaves(value_sizer_t<void> *sizer,
+                          superblock_t *superblock,
+                          int max_leaves,
+                          store_key_t *cursor) {
+    for (int i = 0; i < max_leaves; ++i) {
+        store_key_t bound;
+        if (!compact_leaf(sizer, superblock, cursor->btree_key(), &bound)) {
+            return false;
+        }
+        // The smallest key greater than bound is in the next leaf.
+        *cursor = bound;
+        if (!cursor->increment()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_COMPACT_HPP_
+#define BTREE_COMPACT_HPP_
+
+#include "btree/keys.hpp"
+
+class superblock_t;
+template <class> class value_sizer_t;
+
+/* Writes only merge and level the nodes on the path to the key they change, so an
+erase range that thins out a stretch of the btree (erasing one hash shard's keys from
+it, say) leaves a run of nearly empty leaves behind, which scans then have to walk
+and the cache has to hold.  This walks the leaves in key order, starting with the one
+`*cursor` belongs in, and merges or levels each one that is underfull with a sibling,
+the way a delete would.  The internal nodes on the way down are merged and leveled
+too, and the root is replaced by its only child once it has just one, so the btree
+gets shallower as it empties out.
+
+At most max_leaves leaves are visited, all within the txn of `superblock`, which must
+be acquired for write.  *cursor is then left in the next leaf to visit, for the next
+call.  Returns false once the rightmost leaf has been visited. */
+bool btree_compact_leaves(value_sizer_t<void> *sizer,
+                          superblock_t *superblock,
+                          int max_leaves,
+                          store_key_t *cursor);
+
+#endif  // BTREE_COMPACT_HPP_
@@ -1,9 +1,17 @@
 #include "btree/concurrent_traversal.hpp"
 
+#include <algorithm>
+#include <vector>
+
 #include "arch/runtime/coroutines.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/operations.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/semaphore.hpp"
 #include "concurrency/fifo_enforcer.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/profile.hpp"
 
 class incr_decr_t {
 public:
@@ -31,12 +39,16 @@ static const int max_semaphore_capacity = 30;
 class concurrent_traversal_adapter_t : public depth_first_traversal_callback_t {
 public:
 
-    explicit concurrent_traversal_adapter_t(concurrent_traversal_callback_t *cb,
-                                            cond_t *failure_cond)
+    // If predecessor_done isn't NULL, pairs don't get exclusive access until it is
+    // pulsed.
+    concurrent_traversal_adapter_t(concurrent_traversal_callback_t *cb,
+                                   cond_t *failure_cond,
+                                   signal_t *predecessor_done)
         : semaphore_(concurrent_traversal::initial_semaphore_capacity, 0.5),
           sink_waiters_(0),
           cb_(cb),
-          failure_cond_(failure_cond) { }
+          failure_cond_(failure_cond),
+          predecessor_done_(predecessor_done) { }
 
     void handle_pair_coro(scoped_key_value_t *fragile_keyvalue,
                           semaphore_acq_t *fragile_acq,
@@ -101,6 +113,10 @@ private:
     // the query.
     cond_t *failure_cond_;
 
+    // Signals when the traversal of the partition before ours is done, if there is
+    // one whose pairs have to come first.
+    signal_t *predecessor_done_;
+
     // We don't use the drainer's drain signal, we use failure_cond_
     auto_drainer_t drainer_;
     DISABLE_COPYING(concurrent_traversal_adapter_t);
@@ -135,6 +151,9 @@ void concurrent_traversal_fifo_enforcer_signal_t::wait_interruptible()
     }
 
     ::wait_interruptible(eval_exclusivity_signal_, parent_->failure_cond_);
+    if (parent_->predecessor_done_ != NULL) {
+        ::wait_interruptible(parent_->predecessor_done_, parent_->failure_cond_);
+    }
 }
 
 bool btree_concurrent_traversal(btree_slice_t *slice,
@@ -144,7 +163,7 @@ bool btree_concurrent_traversal(btree_slice_t *slice,
     cond_t failure_cond;
     bool failure_seen;
     {
-        concurrent_traversal_adapter_t adapter(cb, &failure_cond);
+        concurrent_traversal_adapter_t adapter(cb, &failure_cond, NULL);
         failure_seen = !btree_depth_first_traversal(slice, superblock,
                                                     range, &adapter, direction);
     }
@@ -155,3 +174,106 @@ bool btree_concurrent_traversal(btree_slice_t *slice,
     guarantee(!(failure_seen && !failure_cond.is_pulsed()));
     return !failure_cond.is_pulsed();
 }
+
+bool btree_partitioned_concurrent_traversal(btree_slice_t *slice,
+                                            superblock_t *superblock,
+                                            const key_range_t &range,
+                                            concurrent_traversal_callback_t *cb,
+                                            direction_t direction,
+                                            size_t max_partitions,
+                                            partition_order_t order) {
+    const block_id_t root_block_id = superblock->get_root_block_id();
+    if (root_block_id == NULL_BLOCK_ID) {
+        superblock->release();
+        return true;
+    }
+
+    counted_t<counted_buf_lock_t> root_block;
+    {
+        profile::starter_t starter("Acquire block for read.", cb->get_trace());
+        profile::count_blocks_read(cb->get_trace(), 1);
+        root_block = make_counted<counted_buf_lock_t>(superblock->expose_buf(),
+                                                      root_block_id,
+                                                      access_t::read);
+        superblock->release();
+        root_block->read_acq_signal()->wait();
+    }
+
+    // The root's children that may hold keys in `range`, in the order we traverse
+    // them.
+    std::vector<block_id_t> children;
+    {
+        buf_read_t read(root_block.get());
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_internal(node)) {
+            const internal_node_t *inode
+                = reinterpret_cast<const internal_node_t *>(node);
+            int start_index;
+            int end_index;
+            internal_node_range_indices(inode, range, &start_index, &end_index);
+            for (int i = 0; i < end_index - start_index; ++i) {
+                int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
+                children.push_back(
+                    internal_node::get_pair_by_index(inode, true_index)->lnode);
+            }
+        }
+    }
+
+    cond_t failure_cond;
+    bool failure_seen = false;
+    if (max_partitions < 2 || children.size() < 2) {
+        concurrent_traversal_adapter_t adapter(cb, &failure_cond, NULL);
+        failure_seen = !btree_depth_first_traversal(slice, std::move(root_block),
+                                                    range, &adapter, direction);
+    } else {
+        const size_t num_partitions = std::min(max_partitions, children.size());
+
+        // The partitions' traversals overlap, so they can't record nested events.
+        profile::disabler_t disabler(cb->get_trace());
+
+        // Unordered partitions share one adapter, so that they share its fifo and
+        // take turns with exclusive access.  Ordered partitions each have their
+        // own, and wait for the one before them.
+        scoped_array_t<cond_t> partition_done(num_partitions);
+        scoped_ptr_t<concurrent_traversal_adapter_t> shared_adapter;
+        if (order == partition_order_t::UNORDERED) {
+            shared_adapter.init(
+                new concurrent_traversal_adapter_t(cb, &failure_cond, NULL));
+        }
+
+        pmap(static_cast<int>(num_partitions), [&](int p) {
+            scoped_ptr_t<concurrent_traversal_adapter_t> own_adapter;
+            concurrent_traversal_adapter_t *adapter = shared_adapter.get_or_null();
+            if (adapter == NULL) {
+                own_adapter.init(new concurrent_traversal_adapter_t(
+                    cb, &failure_cond, p == 0 ? NULL : &partition_done[p - 1]));
+                adapter = own_adapter.get();
+            }
+
+            const size_t begin = children.size() * p / num_partitions;
+            const size_t end = children.size() * (p + 1) / num_partitions;
+            for (size_t i = begin; i < end; ++i) {
+                profile::count_blocks_read(adapter->get_trace(), 1);
+                counted_t<counted_buf_lock_t> lock
+                    = make_counted<counted_buf_lock_t>(root_block.get(), children[i],
+                                                       access_t::read);
+                if (!btree_depth_first_traversal(slice, std::move(lock), range,
+                                                 adapter, direction)) {
+                    failure_seen = true;
+                    break;
+                }
+            }
+
+            // This waits for the partition's pairs to be handled.
+            own_adapter.reset();
+            partition_done[p].pulse();
+        });
+
+        // This waits for the remaining pairs, if the partitions share an adapter.
+        shared_adapter.reset();
+    }
+    // As in btree_concurrent_traversal, the adapters are destroyed and the
+    // operations that might have failed have all drained.
+    guarantee(!(failure_seen && !failure_cond.is_pulsed()));
+    return !failure_cond.is_pulsed();
+}
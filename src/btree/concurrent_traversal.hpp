@@ -48,6 +48,24 @@ bool btree_concurrent_traversal(btree_slice_t *slice,
                                 concurrent_traversal_callback_t *cb,
                                 direction_t direction);
 
+enum class partition_order_t { ORDERED, UNORDERED };
 
+/* Like btree_concurrent_traversal, but splits `range` at the boundaries between the
+root node's children into at most `max_partitions` sub-ranges, and walks them on
+separate coroutines, so that their blocks get loaded at the same time.  Each
+partition only reads ahead as far as btree_concurrent_traversal does.
+
+`cb`'s regions of exclusive access still happen one at a time.  With `ORDERED`, they
+happen in key order (in the given direction), so partitions after the first one
+wait with what they have read ahead until the ones before them are done.  With
+`UNORDERED`, they happen in whatever order the pairs are loaded, which suits
+aggregations that don't care about the order. */
+bool btree_partitioned_concurrent_traversal(btree_slice_t *slice,
+                                            superblock_t *superblock,
+                                            const key_range_t &range,
+                                            concurrent_traversal_callback_t *cb,
+                                            direction_t direction,
+                                            size_t max_partitions,
+                                            partition_order_t order);
 
 #endif  // BTREE_CONCURRENT_TRAVERSAL_HPP_
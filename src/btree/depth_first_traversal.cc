@@ -4,13 +4,18 @@
 #include "btree/operations.hpp"
 #include "rdb_protocol/profile.hpp"
 
-/* Returns `true` if we reached the end of the subtree or range, and `false` if
-`cb->handle_value()` returned `false`. */
-bool btree_depth_first_traversal(btree_slice_t *slice,
-                                 counted_t<counted_buf_lock_t> block,
+void internal_node_range_indices(const internal_node_t *node,
                                  const key_range_t &range,
-                                 depth_first_traversal_callback_t *cb,
-                                 direction_t direction);
+                                 int *start_index_out, int *end_index_out) {
+    *start_index_out = internal_node::get_offset_index(node, range.left.btree_key());
+    if (range.right.unbounded) {
+        *end_index_out = node->npairs;
+    } else {
+        store_key_t r = range.right.key;
+        r.decrement();
+        *end_index_out = internal_node::get_offset_index(node, r.btree_key()) + 1;
+    }
+}
 
 bool btree_depth_first_traversal(btree_slice_t *slice, superblock_t *superblock,
                                  const key_range_t &range,
@@ -27,6 +32,7 @@ bool btree_depth_first_traversal(btree_slice_t *slice, superblock_t *superblock,
             // get_block_id() above -- so `starter` won't measure time waiting for
             // the parent to become acquired.
             profile::starter_t starter("Acquire block for read.", cb->get_trace());
+            profile::count_blocks_read(cb->get_trace(), 1);
             root_block = make_counted<counted_buf_lock_t>(superblock->expose_buf(),
                                                           root_block_id,
                                                           access_t::read);
@@ -46,25 +52,21 @@ bool btree_depth_first_traversal(btree_slice_t *slice,
                                  const key_range_t &range,
                                  depth_first_traversal_callback_t *cb,
                                  direction_t direction) {
+    slice->stats.pm_nodes_touched.record();
     buf_read_t read(block.get());
     const node_t *node = static_cast<const node_t *>(read.get_data_read());
     if (node::is_internal(node)) {
         const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
-        int start_index = internal_node::get_offset_index(inode, range.left.btree_key());
+        int start_index;
         int end_index;
-        if (range.right.unbounded) {
-            end_index = inode->npairs;
-        } else {
-            store_key_t r = range.right.key;
-            r.decrement();
-            end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
-        }
+        internal_node_range_indices(inode, range, &start_index, &end_index);
         for (int i = 0; i < end_index - start_index; ++i) {
             int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
             counted_t<counted_buf_lock_t> lock;
             {
                 profile::starter_t starter("Acquire block for read.", cb->get_trace());
+                profile::count_blocks_read(cb->get_trace(), 1);
                 lock = make_counted<counted_buf_lock_t>(block.get(), pair->lnode,
                                                         access_t::read);
             }
@@ -8,6 +8,7 @@
 #include "containers/archive/archive.hpp"
 
 class superblock_t;
+struct internal_node_t;
 
 namespace profile { class trace_t; }
 
@@ -85,4 +86,18 @@ bool btree_depth_first_traversal(btree_slice_t *slice, superblock_t *superblock,
                                  depth_first_traversal_callback_t *cb,
                                  direction_t direction);
 
+/* The same, for the subtree rooted at `block`.  `range` may extend beyond the
+subtree's keys. */
+bool btree_depth_first_traversal(btree_slice_t *slice,
+                                 counted_t<counted_buf_lock_t> block,
+                                 const key_range_t &range,
+                                 depth_first_traversal_callback_t *cb,
+                                 direction_t direction);
+
+/* Sets `*start_index_out` and `*end_index_out` to the range of indices of `node`'s
+pairs whose children may hold keys in `range`. */
+void internal_node_range_indices(const internal_node_t *node,
+                                 const key_range_t &range,
+                                 int *start_index_out, int *end_index_out);
+
 #endif /* BTREE_DEPTH_FIRST_TRAVERSAL_HPP_ */
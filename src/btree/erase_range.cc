@@ -1,22 +1,106 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/erase_range.hpp"
 
+#include <algorithm>
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/alt/alt.hpp"
+#include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
+#include "concurrency/background_governor.hpp"
 #include "concurrency/fifo_checker.hpp"
+#include "config/args.hpp"
+
+detached_subtree_reclaimer_t::detached_subtree_reclaimer_t(cache_conn_t *cache_conn,
+                                                           value_sizer_t<void> *sizer,
+                                                           value_deleter_t *deleter)
+    : cache_conn_(cache_conn), sizer_(sizer), deleter_(deleter), reclaiming_(false) { }
+
+void detached_subtree_reclaimer_t::add_subtree(block_id_t root_id) {
+    assert_thread();
+    pending_.push_back(root_id);
+    if (!reclaiming_) {
+        reclaiming_ = true;
+        coro_t::spawn_sometime(std::bind(&detached_subtree_reclaimer_t::reclaim_subtrees,
+                                         this, drainer_.lock()));
+    }
+}
+
+void detached_subtree_reclaimer_t::reclaim_subtrees(auto_drainer_t::lock_t keepalive) {
+    with_priority_t p(CORO_PRIORITY_RESET_DATA);
+    try {
+        while (!pending_.empty()) {
+            {
+                // Small txns, with a pause between them, so that the reclamation
+                // never holds up the other txns on the connection for long.
+                txn_t txn(cache_conn_, write_durability_t::SOFT,
+                          repli_timestamp_t::distant_past,
+                          ERASE_RANGE_RECLAIM_BATCH_SIZE);
+                for (int i = 0;
+                     i < ERASE_RANGE_RECLAIM_BATCH_SIZE && !pending_.empty();
+                     ++i) {
+                    // Taking the most recently added block makes this a depth-first
+                    // walk, which keeps pending_ small.
+                    const block_id_t block_id = pending_.back();
+                    pending_.pop_back();
+                    reclaim_block(&txn, block_id);
+                }
+            }
+            nap(ERASE_RANGE_RECLAIM_INTERVAL_MS, keepalive.get_drain_signal());
+            wait_for_background_turn(keepalive.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're being destroyed, and the blocks still in pending_ are leaked.
+    }
+    reclaiming_ = false;
+}
+
+void detached_subtree_reclaimer_t::reclaim_block(txn_t *txn, block_id_t block_id) {
+    // The block has been detached from its parent, so the txn is its parent now.
+    buf_lock_t lock(buf_parent_t(txn), block_id, access_t::write);
+    {
+        buf_read_t read(&lock);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_leaf(node)) {
+            const leaf_node_t *leaf_node = reinterpret_cast<const leaf_node_t *>(node);
+            scoped_malloc_t<char> value(sizer_->max_possible_size());
+            for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+                const void *v = (*it).second;
+                memcpy(value.get(), v, sizer_->size(v));
+                deleter_->delete_value(buf_parent_t(&lock), value.get());
+            }
+        } else {
+            const internal_node_t *internal
+                = reinterpret_cast<const internal_node_t *>(node);
+            for (int i = 0; i < internal->npairs; ++i) {
+                const block_id_t child_id
+                    = internal_node::get_pair_by_index(internal, i)->lnode;
+                lock.detach_child(child_id);
+                pending_.push_back(child_id);
+            }
+        }
+    }
+    lock.mark_deleted();
+}
 
 class erase_range_helper_t : public btree_traversal_helper_t {
 public:
     erase_range_helper_t(value_sizer_t<void> *sizer, key_tester_t *tester,
                          value_deleter_t *deleter,
                          const btree_key_t *left_exclusive_or_null,
-                         const btree_key_t *right_inclusive_or_null)
+                         const btree_key_t *right_inclusive_or_null,
+                         superblock_t *superblock,
+                         detached_subtree_reclaimer_t *reclaimer)
         : sizer_(sizer), tester_(tester), deleter_(deleter),
           left_exclusive_or_null_(left_exclusive_or_null),
-          right_inclusive_or_null_(right_inclusive_or_null)
+          right_inclusive_or_null_(right_inclusive_or_null),
+          superblock_(superblock), reclaimer_(reclaimer)
     { }
 
     void process_a_leaf(buf_lock_t *leaf_node_buf,
@@ -61,19 +145,46 @@ public:
         // We don't want to do anything here.
     }
 
-    void filter_interesting_children(buf_parent_t,
+    void filter_interesting_children(buf_parent_t parent,
                                      ranged_block_ids_t *ids_source,
                                      interesting_children_callback_t *cb) {
-        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
+        std::vector<int> interesting;
+        std::vector<int> contained;
+        const int num_block_ids = ids_source->num_block_ids();
+        for (int i = 0; i < num_block_ids; ++i) {
             block_id_t block_id;
             const btree_key_t *left, *right;
             ids_source->get_block_id_and_bounding_interval(i, &block_id, &left, &right);
 
-            if (overlaps(left, right, left_exclusive_or_null_, right_inclusive_or_null_)) {
-                cb->receive_interesting_child(i);
+            if (reclaimer_ != NULL
+                && contains(left_exclusive_or_null_, right_inclusive_or_null_,
+                            left, right)) {
+                contained.push_back(i);
+            } else if (overlaps(left, right, left_exclusive_or_null_, right_inclusive_or_null_)) {
+                interesting.push_back(i);
             }
         }
 
+        if (!contained.empty()) {
+            if (ids_source->get_level() == 0) {
+                // The range covers the whole btree.
+                cut_out_root(parent, ids_source);
+            } else {
+                // We leave internal nodes at least two children, which is what the
+                // rest of the btree code expects.  The subtrees we can't cut out are
+                // erased key by key.
+                while (num_block_ids - static_cast<int>(contained.size()) < 2) {
+                    interesting.push_back(contained.back());
+                    contained.pop_back();
+                }
+                std::sort(interesting.begin(), interesting.end());
+                cut_out_children(parent, ids_source, contained);
+            }
+        }
+
+        for (auto it = interesting.begin(); it != interesting.end(); ++it) {
+            cb->receive_interesting_child(*it);
+        }
         cb->no_more_interesting_children();
     }
 
@@ -96,6 +207,13 @@ public:
         rassert(key_in_range(k, left_excl, right_incl));
     }
 
+    // Checks if (y_l_excl, y_r_incl] is a subset of (x_l_excl, x_r_incl].
+    static bool contains(const btree_key_t *x_l_excl, const btree_key_t *x_r_incl,
+                         const btree_key_t *y_l_excl, const btree_key_t *y_r_incl) {
+        return (x_l_excl == NULL || (y_l_excl != NULL && btree_key_cmp(x_l_excl, y_l_excl) <= 0))
+            && (x_r_incl == NULL || (y_r_incl != NULL && btree_key_cmp(y_r_incl, x_r_incl) <= 0));
+    }
+
     // Checks if (x_l_excl, x_r_incl] intersects (y_l_excl, y_r_incl].
     static bool overlaps(const btree_key_t *x_l_excl, const btree_key_t *x_r_incl,
                          const btree_key_t *y_l_excl, const btree_key_t *y_r_incl) {
@@ -104,11 +222,50 @@ public:
     }
 
 private:
+    void cut_out_root(buf_parent_t superblock_buf, ranged_block_ids_t *ids_source) {
+        block_id_t root_id;
+        const btree_key_t *left, *right;
+        ids_source->get_block_id_and_bounding_interval(0, &root_id, &left, &right);
+
+        superblock_->set_root_block_id(NULL_BLOCK_ID);
+        superblock_buf.detach_child(root_id);
+        reclaimer_->add_subtree(root_id);
+
+        buf_lock_t stat_block(superblock_buf, superblock_->get_stat_block_id(),
+                              access_t::write);
+        buf_write_t write(&stat_block);
+        static_cast<btree_statblock_t *>(write.get_data_write())->population = 0;
+    }
+
+    void cut_out_children(buf_parent_t parent, ranged_block_ids_t *ids_source,
+                          const std::vector<int> &indices) {
+        buf_lock_t *node_buf = parent.lock_or_null();
+        guarantee(node_buf != NULL);
+        {
+            buf_write_t write(node_buf);
+            internal_node_t *node = static_cast<internal_node_t *>(write.get_data_write());
+            // Going backwards keeps the indices of the pairs yet to be removed valid.
+            for (auto it = indices.rbegin(); it != indices.rend(); ++it) {
+                internal_node::remove_by_index(sizer_->block_size(), node, *it);
+            }
+        }
+
+        for (auto it = indices.begin(); it != indices.end(); ++it) {
+            block_id_t block_id;
+            const btree_key_t *left, *right;
+            ids_source->get_block_id_and_bounding_interval(*it, &block_id, &left, &right);
+            parent.detach_child(block_id);
+            reclaimer_->add_subtree(block_id);
+        }
+    }
+
     value_sizer_t<void> *sizer_;
     key_tester_t *tester_;
     value_deleter_t *deleter_;
     const btree_key_t *left_exclusive_or_null_;
     const btree_key_t *right_inclusive_or_null_;
+    superblock_t *superblock_;
+    detached_subtree_reclaimer_t *reclaimer_;
 
     DISABLE_COPYING(erase_range_helper_t);
 };
@@ -117,9 +274,11 @@ void btree_erase_range_generic(value_sizer_t<void> *sizer,
         key_tester_t *tester, value_deleter_t *deleter,
         const btree_key_t *left_exclusive_or_null,
         const btree_key_t *right_inclusive_or_null,
-        superblock_t *superblock, signal_t *interruptor, bool release_superblock) {
+        superblock_t *superblock, signal_t *interruptor, bool release_superblock,
+        detached_subtree_reclaimer_t *reclaimer) {
     erase_range_helper_t helper(sizer, tester, deleter,
-                                left_exclusive_or_null, right_inclusive_or_null);
+                                left_exclusive_or_null, right_inclusive_or_null,
+                                superblock, reclaimer);
     btree_parallel_traversal(superblock, &helper, interruptor,
                              release_superblock);
 }
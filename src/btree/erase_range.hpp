@@ -2,11 +2,16 @@
 #ifndef BTREE_ERASE_RANGE_HPP_
 #define BTREE_ERASE_RANGE_HPP_
 
+#include <vector>
+
 #include "errors.hpp"
 #include "btree/node.hpp"
 #include "buffer_cache/types.hpp"
+#include "concurrency/auto_drainer.hpp"
 
 class buf_parent_t;
+class cache_conn_t;
+class txn_t;
 struct store_key_t;
 struct btree_key_t;
 class order_token_t;
@@ -41,6 +46,45 @@ protected:
     DISABLE_COPYING(value_deleter_t);
 };
 
+/* Frees the blocks of subtrees that have been cut out of a btree, a few at a time,
+in the background.  The subtrees are freed in txns on the cache_conn_t passed to the
+constructor, so the txn that cut a subtree out must be on that same connection: that
+way the cut always reaches the disk before the subtree's blocks are freed.
+
+Subtrees that haven't been freed yet when the reclaimer is destroyed are leaked. */
+class detached_subtree_reclaimer_t : public home_thread_mixin_debug_only_t {
+public:
+    // sizer and deleter must outlive the reclaimer.
+    detached_subtree_reclaimer_t(cache_conn_t *cache_conn,
+                                 value_sizer_t<void> *sizer,
+                                 value_deleter_t *deleter);
+
+    // The subtree must already be unlinked from its parent, with detach_child.
+    void add_subtree(block_id_t root_id);
+
+private:
+    void reclaim_subtrees(auto_drainer_t::lock_t keepalive);
+    void reclaim_block(txn_t *txn, block_id_t block_id);
+
+    cache_conn_t *const cache_conn_;
+    value_sizer_t<void> *const sizer_;
+    value_deleter_t *const deleter_;
+
+    // Blocks whose subtrees are waiting to be freed.
+    std::vector<block_id_t> pending_;
+    bool reclaiming_;
+
+    auto_drainer_t drainer_;
+
+    DISABLE_COPYING(detached_subtree_reclaimer_t);
+};
+
+/* If reclaimer is non-NULL, the subtrees that lie entirely within the range are cut
+out of the btree and handed to the reclaimer instead of being erased key by key, so
+only the leaves that straddle the range's boundaries are modified in the foreground.
+That's only correct if the tester erases every key in the range.  The stat block's
+population, which is only used as an estimate, isn't lowered for the keys of the
+subtrees that are cut out, unless the range covers the whole btree. */
 void btree_erase_range_generic(value_sizer_t<void> *sizer,
                                key_tester_t *tester,
                                value_deleter_t *deleter,
@@ -48,7 +92,8 @@ void btree_erase_range_generic(value_sizer_t<void> *sizer,
                                const btree_key_t *right_inclusive_or_null,
                                superblock_t *superblock,
                                signal_t *interruptor,
-                               bool release_superblock = true);
+                               bool release_superblock = true,
+                               detached_subtree_reclaimer_t *reclaimer = NULL);
 
 void erase_all(value_sizer_t<void> *sizer,
                value_deleter_t *deleter,
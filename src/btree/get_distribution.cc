@@ -1,11 +1,15 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/get_distribution.hpp"
 
+#include <algorithm>
+
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
 #include "btree/leaf_node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "buffer_cache/alt/alt.hpp"
+#include "concurrency/pmap.hpp"
 #include "utils.hpp"
 
 class get_distribution_traversal_helper_t : public btree_traversal_helper_t, public home_thread_mixin_debug_only_t {
@@ -97,3 +101,111 @@ void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
     btree_parallel_traversal(superblock, &helper, &non_interruptor);
     *key_count_out = helper.key_count;
 }
+
+struct sampled_key_t {
+    store_key_t key;
+    // How many keys in the btree this key stands for.
+    double weight;
+    int64_t bytes;
+
+    bool operator<(const sampled_key_t &other) const {
+        return key < other.key;
+    }
+};
+
+void sample_a_leaf(buf_lock_t *root, value_size_estimator_t *estimator,
+                   std::vector<sampled_key_t> *keys_out) {
+    buf_lock_t node_lock;
+    buf_lock_t *node_buf = root;
+    // The inverse of the probability of getting to the current node.
+    double weight = 1;
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(node_buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                const leaf_node_t *leaf_node = reinterpret_cast<const leaf_node_t *>(node);
+                for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+                    sampled_key_t sampled;
+                    sampled.key.assign((*it).first);
+                    sampled.weight = weight;
+                    sampled.bytes = (*it).first->size
+                        + estimator->value_bytes((*it).second);
+                    keys_out->push_back(sampled);
+                }
+                return;
+            }
+
+            const internal_node_t *internal
+                = reinterpret_cast<const internal_node_t *>(node);
+            weight *= internal->npairs;
+            child_id = internal_node::get_pair_by_index(internal,
+                                                        randint(internal->npairs))->lnode;
+        }
+        buf_lock_t child(node_buf, child_id, access_t::read);
+        node_lock = std::move(child);
+        node_buf = &node_lock;
+    }
+}
+
+void sample_btree_key_distribution(superblock_t *superblock,
+                                   value_size_estimator_t *estimator,
+                                   int num_samples, int num_buckets,
+                                   key_distribution_histogram_t *histogram_out) {
+    guarantee(num_samples > 0);
+    guarantee(num_buckets > 0);
+    rassert(histogram_out->split_keys.empty());
+
+    std::vector<std::vector<sampled_key_t> > samples(num_samples);
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        superblock->release();
+    } else {
+        buf_lock_t root(superblock->expose_buf(), root_id, access_t::read);
+        superblock->release();
+        pmap(num_samples, [&](int i) {
+            sample_a_leaf(&root, estimator, &samples[i]);
+        });
+    }
+
+    std::vector<sampled_key_t> keys;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        for (auto jt = it->begin(); jt != it->end(); ++jt) {
+            keys.push_back(*jt);
+            // Averaging over the samples makes the sums of the weights estimates
+            // for the whole btree.
+            keys.back().weight /= num_samples;
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    double total_weight = 0;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        total_weight += it->weight;
+    }
+    const double weight_per_bucket = total_weight / num_buckets;
+
+    std::vector<double> key_counts(1, 0);
+    std::vector<double> byte_counts(1, 0);
+    double cumulative_weight = 0;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        // A leaf may have been sampled more than once, but we mustn't split between
+        // copies of the same key.
+        if (it != keys.begin() && (it - 1)->key < it->key
+            && static_cast<int>(key_counts.size()) < num_buckets
+            && cumulative_weight >= weight_per_bucket * key_counts.size()) {
+            histogram_out->split_keys.push_back(it->key);
+            key_counts.push_back(0);
+            byte_counts.push_back(0);
+        }
+        key_counts.back() += it->weight;
+        byte_counts.back() += it->weight * it->bytes;
+        cumulative_weight += it->weight;
+    }
+
+    for (size_t i = 0; i < key_counts.size(); ++i) {
+        histogram_out->key_counts.push_back(static_cast<int64_t>(key_counts[i] + 0.5));
+        histogram_out->byte_counts.push_back(static_cast<int64_t>(byte_counts[i] + 0.5));
+    }
+}
@@ -2,6 +2,8 @@
 #ifndef BTREE_GET_DISTRIBUTION_HPP_
 #define BTREE_GET_DISTRIBUTION_HPP_
 
+#include <stdint.h>
+
 #include <vector>
 
 #include "btree/keys.hpp"
@@ -13,4 +15,41 @@ void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
                                 std::vector<store_key_t> *keys_out);
 
+/* Tells sample_btree_key_distribution how many bytes a value stands for, including
+any data it refers to outside of its leaf node. */
+class value_size_estimator_t {
+public:
+    value_size_estimator_t() { }
+    virtual int64_t value_bytes(const void *value) = 0;
+
+protected:
+    virtual ~value_size_estimator_t() { }
+
+    DISABLE_COPYING(value_size_estimator_t);
+};
+
+/* An equi-depth histogram of the keys in a btree.  Bucket i holds the keys in
+[split_keys[i - 1], split_keys[i]); the first bucket starts at the left end of the
+btree and the last one ends at its right end.  So there is one more bucket than
+there are split keys. */
+struct key_distribution_histogram_t {
+    std::vector<store_key_t> split_keys;
+    std::vector<int64_t> key_counts;
+    std::vector<int64_t> byte_counts;
+};
+
+/* Builds a histogram of at most num_buckets buckets out of the leaves reached by
+num_samples descents from the root, each along randomly chosen children.  A sampled
+key stands for as many keys as the inverse of the probability of reaching its leaf,
+so leaves under internal nodes with few children aren't over-represented, and the
+counts in the histogram are estimates for the whole btree.  Unlike
+get_btree_key_distribution, which only looks at the internal nodes down to a depth
+limit, this looks at actual keys, so its buckets follow skewed distributions.
+
+Releases the superblock once it has the root. */
+void sample_btree_key_distribution(superblock_t *superblock,
+                                   value_size_estimator_t *estimator,
+                                   int num_samples, int num_buckets,
+                                   key_distribution_histogram_t *histogram_out);
+
 #endif /* BTREE_GET_DISTRIBUTION_HPP_ */
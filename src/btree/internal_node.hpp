@@ -31,6 +31,9 @@ void init(block_size_t block_size, internal_node_t *node, const internal_node_t
 block_id_t lookup(const internal_node_t *node, const btree_key_t *key);
 bool insert(block_size_t block_size, internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode);
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key);
+// Removes the pair at index, giving its keys to the child of the next pair (or, for
+// the last pair, to the child of the pair before it).
+void remove_by_index(block_size_t block_size, internal_node_t *node, int index);
 void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median);
 void merge(block_size_t block_size, const internal_node_t *node, internal_node_t *rnode, const internal_node_t *parent);
 bool level(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *replacement_key, const internal_node_t *parent);
@@ -1,6 +1,41 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "btree/keys.hpp"
 
+#include <stdint.h>
+
+#include <algorithm>
+
+int btree_key_cmp_skipping_prefix(const btree_key_t *left, const btree_key_t *right,
+                                  int skip, int *common_out) {
+    const int min_len = std::min<int>(left->size, right->size);
+    rassert(skip <= min_len);
+    int i = skip;
+    // Keys in the same node (secondary index keys especially) tend to share long
+    // prefixes, so we compare eight bytes at a time.  Read big-endian, the words
+    // compare the way their bytes do, so a mismatching word gives us the answer
+    // without looking at its bytes one by one.
+    while (i + static_cast<int>(sizeof(uint64_t)) <= min_len) {
+        uint64_t x, y;
+        memcpy(&x, left->contents + i, sizeof(x));
+        memcpy(&y, right->contents + i, sizeof(y));
+        if (x != y) {
+            x = __builtin_bswap64(x);
+            y = __builtin_bswap64(y);
+            *common_out = i + __builtin_clzll(x ^ y) / 8;
+            return x < y ? -1 : 1;
+        }
+        i += sizeof(uint64_t);
+    }
+    while (i < min_len && left->contents[i] == right->contents[i]) {
+        ++i;
+    }
+    *common_out = i;
+    if (i < min_len) {
+        return static_cast<int>(left->contents[i]) - static_cast<int>(right->contents[i]);
+    }
+    return left->size - right->size;
+}
+
 bool unescaped_str_to_key(const char *str, int len, store_key_t *buf) {
     if (len <= MAX_KEY_SIZE) {
         memcpy(buf->contents(), str, len);
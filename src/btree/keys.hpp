@@ -34,6 +34,12 @@ inline int btree_key_cmp(const btree_key_t *left, const btree_key_t *right) {
     return sized_strcmp(left->contents, left->size, right->contents, right->size);
 }
 
+// Compares left to right like btree_key_cmp, given that their first `skip` bytes are
+// known to be equal.  Sets *common_out to the length of their common prefix.  The
+// node searches use this to avoid comparing the same prefix over and over.
+int btree_key_cmp_skipping_prefix(const btree_key_t *left, const btree_key_t *right,
+                                  int skip, int *common_out);
+
 struct store_key_t {
 public:
     store_key_t() {
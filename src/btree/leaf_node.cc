@@ -1126,20 +1126,32 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     // beg == 0 or key > *(beg - 1).
     // end == num_pairs or key < *end.
 
+    // The length of the common prefix of key and *(beg - 1), and of key and *end
+    // (zero when there's no such entry).  The keys are sorted, so every entry in
+    // [beg, end) shares the shorter of these prefixes with key, and we don't have to
+    // compare those bytes again.
+    int beg_common = 0;
+    int end_common = 0;
+
     while (beg < end) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
         const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
 
-        int res = sized_strcmp(key->contents, key->size, ek->contents, ek->size);
+        int common;
+        int res = btree_key_cmp_skipping_prefix(key, ek,
+                                                std::min(beg_common, end_common),
+                                                &common);
 
         if (res < 0) {
             // key < *test_point.
             end = test_point;
+            end_common = common;
         } else if (res > 0) {
             // key > *test_point.  Since test_point < end, we have test_point + 1 <= end.
             beg = test_point + 1;
+            beg_common = common;
         } else {
             // We found the key!
             *index_out = test_point;
@@ -1168,6 +1180,13 @@ bool lookup(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key
     return false;
 }
 
+const btree_key_t *greatest_key(const leaf_node_t *node) {
+    if (node->num_pairs == 0) {
+        return NULL;
+    }
+    return entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1]));
+}
+
 /* `insert()` and `remove()` call this to insert a new entry into the leaf node.
 
 First it removes any existing entry for `key`; then it makes room in the leaf
@@ -364,6 +364,43 @@ buf_lock_t get_root(value_sizer_t<void> *sizer, superblock_t *sb) {
     }
 }
 
+block_id_t lookup_child_for_read(buf_lock_t *buf, const btree_key_t *key) {
+    buf_read_t read(buf);
+    const block_id_t child_id
+        = internal_node::lookup(static_cast<const internal_node_t *>(read.get_data_read()),
+                                key);
+    rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+    return child_id;
+}
+
+void acquire_child_for_read(buf_lock_t *buf, const btree_key_t *key) {
+    block_id_t child_id = lookup_child_for_read(buf, key);
+
+    if (buf->has_optimistic_read()) {
+        // We read the node before some writers in front of us got to it.  We can
+        // only let go of it if it's still valid, and if the child can be read right
+        // away too (because otherwise we'd end up reading the child after them).
+        // Checking the node before acquiring the child means no writer has touched
+        // the child in between, so it can't have been deleted.
+        if (buf->optimistic_read_is_valid()) {
+            buf_lock_t child(buf_parent_t(buf->txn()), child_id, access_t::read);
+            if (child.read_optimistically()) {
+                buf->reset_buf_lock();
+                *buf = std::move(child);
+                return;
+            }
+        }
+        // Wait for our turn and read the node again.
+        buf->abandon_optimistic_read();
+        child_id = lookup_child_for_read(buf, key);
+    }
+
+    buf_lock_t child(buf, child_id, access_t::read);
+    buf->reset_buf_lock();
+    child.read_optimistically();
+    *buf = std::move(child);
+}
+
 // Split the node if necessary. If the node is a leaf_node, provide the new
 // value that will be inserted; if it's an internal node, provide NULL (we
 // split internal nodes proactively).
@@ -3,6 +3,7 @@
 #define BTREE_OPERATIONS_HPP_
 
 #include <algorithm>
+#include <functional>
 #include <utility>
 #include <vector>
 
@@ -206,6 +207,11 @@ private:
 
 buf_lock_t get_root(value_sizer_t<void> *sizer, superblock_t *sb);
 
+/* Replaces `*buf`, an internal node acquired for read, with the child that `key`
+belongs under.  Nodes are read optimistically where possible, so that point reads
+don't queue behind writers that haven't yet modified the nodes on their path. */
+void acquire_child_for_read(buf_lock_t *buf, const btree_key_t *key);
+
 void check_and_handle_split(value_sizer_t<void> *sizer,
                             buf_lock_t *buf,
                             buf_lock_t *last_buf,
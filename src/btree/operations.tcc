@@ -48,6 +48,7 @@ void find_keyvalue_location_for_write(
         profile::starter_t starter("Acquiring block for write.\n", trace);
         buf = get_root(&sizer, superblock);
     }
+    stats->pm_nodes_touched.record();
 
     // Walk down the tree to the leaf.
     for (;;) {
@@ -102,6 +103,7 @@ void find_keyvalue_location_for_write(
             last_buf = std::move(buf);
             buf = std::move(tmp);
         }
+        stats->pm_nodes_touched.record();
     }
 
     {
@@ -122,6 +124,108 @@ void find_keyvalue_location_for_write(
     keyvalue_location_out->buf.swap(buf);
 }
 
+/* Points *keyvalue_location, which was filled in by
+ * find_keyvalue_location_for_write() (and possibly passed to
+ * apply_keyvalue_change() since), at `key` without walking down from the root
+ * again.  `key` must be no less than the keys *keyvalue_location was used for
+ * before.  This works if `key` belongs in the same leaf, or in one of its siblings
+ * under the parent we hold.  Since we don't hold the nodes above the parent, it
+ * also refuses to go on if changing the leaf could split the parent or leave it
+ * with a single child.  When it returns false, *keyvalue_location is unchanged and
+ * the key needs a find_keyvalue_location_for_write() of its own. */
+template <class Value>
+bool find_nearby_keyvalue_location_for_write(
+        const btree_key_t *key,
+        keyvalue_location_t<Value> *keyvalue_location) {
+    value_sizer_t<Value> sizer(keyvalue_location->buf.cache()->max_block_size());
+
+    // If there's no parent, the leaf is the root and holds every key.
+    if (!keyvalue_location->last_buf.empty()) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&keyvalue_location->last_buf);
+            auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+            if (internal_node::is_full(parent) || parent->npairs <= 2) {
+                return false;
+            }
+            const int index = internal_node::get_offset_index(parent, key);
+            child_id = internal_node::get_pair_by_index(parent, index)->lnode;
+            if (index == parent->npairs - 1) {
+                // The parent doesn't tell us where its last child's keys end.  If the
+                // key is no greater than one that's in the leaf, it belongs there.
+                if (child_id != keyvalue_location->buf.block_id()) {
+                    return false;
+                }
+                buf_read_t leaf_read(&keyvalue_location->buf);
+                const btree_key_t *greatest = leaf::greatest_key(
+                    static_cast<const leaf_node_t *>(leaf_read.get_data_read()));
+                if (greatest == NULL || btree_key_cmp(key, greatest) > 0) {
+                    return false;
+                }
+            }
+        }
+        if (child_id != keyvalue_location->buf.block_id()) {
+            buf_lock_t child(&keyvalue_location->last_buf, child_id, access_t::write);
+            keyvalue_location->buf = std::move(child);
+        }
+    }
+
+    keyvalue_location->there_originally_was_value = false;
+    keyvalue_location->value.reset();
+
+    scoped_malloc_t<Value> tmp(sizer.max_possible_size());
+    buf_read_t read(&keyvalue_location->buf);
+    auto node = static_cast<const leaf_node_t *>(read.get_data_read());
+    if (leaf::lookup(&sizer, node, key, tmp.get())) {
+        keyvalue_location->there_originally_was_value = true;
+        keyvalue_location->value = std::move(tmp);
+    }
+    return true;
+}
+
+// Walks down from `buf`, which must be the root, to the leaf for `key` and looks
+// the key up there.
+template <class Value>
+void find_keyvalue_location_below_root(
+        buf_lock_t &&root, const btree_key_t *key, value_sizer_t<Value> *sizer,
+        keyvalue_location_t<Value> *keyvalue_location_out,
+        btree_stats_t *stats, profile::trace_t *trace) {
+    buf_lock_t buf(std::move(root));
+    stats->pm_nodes_touched.record();
+    for (;;) {
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+#ifndef NDEBUG
+            node::validate(sizer, node);
+#endif  // NDEBUG
+            if (!node::is_internal(node)) {
+                break;
+            }
+        }
+
+        profile::starter_t starter("Acquire a block for read.", trace);
+        profile::count_blocks_read(trace, 1);
+        acquire_child_for_read(&buf, key);
+        stats->pm_nodes_touched.record();
+    }
+
+    // Got down to the leaf, now probe it.
+    scoped_malloc_t<Value> value(sizer->max_possible_size());
+    bool value_found;
+    {
+        buf_read_t read(&buf);
+        const leaf_node_t *leaf
+            = static_cast<const leaf_node_t *>(read.get_data_read());
+        value_found = leaf::lookup(sizer, leaf, key, value.get());
+    }
+    if (value_found) {
+        keyvalue_location_out->buf = std::move(buf);
+        keyvalue_location_out->there_originally_was_value = true;
+        keyvalue_location_out->value = std::move(value);
+    }
+}
+
 template <class Value>
 void find_keyvalue_location_for_read(
         superblock_t *superblock, const btree_key_t *key,
@@ -142,61 +246,48 @@ void find_keyvalue_location_for_read(
     buf_lock_t buf;
     {
         profile::starter_t starter("Acquire a block for read.", trace);
+        profile::count_blocks_read(trace, 1);
         buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
         superblock->release();
+        tmp.read_optimistically();
         buf = std::move(tmp);
     }
 
-#ifndef NDEBUG
-    {
-        buf_read_t read(&buf);
-        node::validate(&sizer, static_cast<const node_t *>(read.get_data_read()));
-    }
-#endif  // NDEBUG
-
-    for (;;) {
-        block_id_t node_id;
-        {
-            buf_read_t read(&buf);
-            const void *data = read.get_data_read();
-            if (!node::is_internal(static_cast<const node_t *>(data))) {
-                break;
-            }
+    find_keyvalue_location_below_root(std::move(buf), key, &sizer,
+                                      keyvalue_location_out, stats, trace);
+}
 
-            node_id = internal_node::lookup(static_cast<const internal_node_t *>(data),
-                                            key);
-        }
-        rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+// Like `find_keyvalue_location_for_read`, but for several keys under one
+// superblock acquisition.  `cb` is called with the index of each key and its
+// location, in order; the superblock is released afterwards.
+template <class Value>
+void find_keyvalue_locations_for_read(
+        superblock_t *superblock, const std::vector<const btree_key_t *> &keys,
+        const std::function<void(size_t, keyvalue_location_t<Value> *)> &cb,
+        btree_stats_t *stats, profile::trace_t *trace) {
+    value_sizer_t<Value> sizer(superblock->cache()->max_block_size());
 
-        {
-            profile::starter_t starter("Acquire a block for read.", trace);
-            buf_lock_t tmp(&buf, node_id, access_t::read);
-            buf.reset_buf_lock();
-            buf = std::move(tmp);
-        }
+    const block_id_t root_id = superblock->get_root_block_id();
+    rassert(root_id != SUPERBLOCK_ID);
 
-#ifndef NDEBUG
-        {
-            buf_read_t read(&buf);
-            node::validate(&sizer, static_cast<const node_t *>(read.get_data_read()));
+    for (size_t i = 0; i < keys.size(); ++i) {
+        stats->pm_keys_read.record();
+        keyvalue_location_t<Value> location;
+        if (root_id != NULL_BLOCK_ID) {
+            buf_lock_t buf;
+            {
+                profile::starter_t starter("Acquire a block for read.", trace);
+                profile::count_blocks_read(trace, 1);
+                buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+                tmp.read_optimistically();
+                buf = std::move(tmp);
+            }
+            find_keyvalue_location_below_root(std::move(buf), keys[i], &sizer,
+                                              &location, stats, trace);
         }
-#endif  // NDEBUG
-    }
-
-    // Got down to the leaf, now probe it.
-    scoped_malloc_t<Value> value(sizer.max_possible_size());
-    bool value_found;
-    {
-        buf_read_t read(&buf);
-        const leaf_node_t *leaf
-            = static_cast<const leaf_node_t *>(read.get_data_read());
-        value_found = leaf::lookup(&sizer, leaf, key, value.get());
-    }
-    if (value_found) {
-        keyvalue_location_out->buf = std::move(buf);
-        keyvalue_location_out->there_originally_was_value = true;
-        keyvalue_location_out->value = std::move(value);
+        cb(i, &location);
     }
+    superblock->release();
 }
 
 enum class expired_t { NO, YES };
@@ -8,9 +8,6 @@
 #include "concurrency/cond_var.hpp"
 #include "repli_timestamp.hpp"
 
-// Run backfilling at a reduced priority
-#define BACKFILL_CACHE_PRIORITY 10
-
 void btree_slice_t::init_superblock(buf_lock_t *superblock,
                                     const std::vector<char> &metainfo_key,
                                     const std::vector<char> &metainfo_value) {
@@ -36,6 +33,9 @@ btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent,
                              const std::string &identifier)
     : stats(parent, identifier),
       cache_(c),
-      backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY)) { }
+      backfill_account_(cache()->create_cache_account(
+              BACKFILL_CACHE_PRIORITY,
+              0,
+              cache()->memory_limit() / 100 * BACKFILL_CACHE_MEMORY_LIMIT_PERCENT)) { }
 
 btree_slice_t::~btree_slice_t() { }
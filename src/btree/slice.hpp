@@ -26,10 +26,12 @@ public:
           pm_keys_read(secs_to_ticks(1)),
           pm_keys_set(secs_to_ticks(1)),
           pm_keys_expired(secs_to_ticks(1)),
+          pm_nodes_touched(secs_to_ticks(1)),
           pm_keys_membership(&btree_collection,
               &pm_keys_read, "keys_read",
               &pm_keys_set, "keys_set",
-              &pm_keys_expired, "keys_expired")
+              &pm_keys_expired, "keys_expired",
+              &pm_nodes_touched, "nodes_touched")
     { }
 
     perfmon_collection_t btree_collection;
@@ -37,7 +39,10 @@ public:
     perfmon_rate_monitor_t
         pm_keys_read,
         pm_keys_set,
-        pm_keys_expired;
+        pm_keys_expired,
+        // The nodes that operations on this btree (the primary one or a secondary
+        // index) acquired.
+        pm_nodes_touched;
     perfmon_multi_membership_t pm_keys_membership;
 };
 
@@ -54,7 +54,11 @@ private:
 };
 
 alt_memory_tracker_t::alt_memory_tracker_t()
-    : unwritten_changes_semaphore_(SOFT_UNWRITTEN_CHANGES_LIMIT) { }
+    : stats_(NULL),
+      unwritten_changes_semaphore_(SOFT_UNWRITTEN_CHANGES_LIMIT) { }
+alt_memory_tracker_t::alt_memory_tracker_t(alt_cache_stats_t *stats)
+    : stats_(stats),
+      unwritten_changes_semaphore_(SOFT_UNWRITTEN_CHANGES_LIMIT) { }
 alt_memory_tracker_t::~alt_memory_tracker_t() { }
 
 void alt_memory_tracker_t::inform_memory_change(UNUSED uint64_t in_memory_size,
@@ -62,6 +66,61 @@ void alt_memory_tracker_t::inform_memory_change(UNUSED uint64_t in_memory_size,
     // KSI: implement this (for issue 97).
 }
 
+void alt_memory_tracker_t::inform_page_access(cache_segment_access_t access) {
+    if (stats_ == NULL) {
+        return;
+    }
+    switch (access) {
+    case cache_segment_access_t::PROBATIONARY_HIT:
+        ++stats_->pm_probationary_hits;
+        break;
+    case cache_segment_access_t::PROTECTED_HIT:
+        ++stats_->pm_protected_hits;
+        break;
+    case cache_segment_access_t::MISS:
+        ++stats_->pm_misses;
+        break;
+    default:
+        unreachable();
+    }
+}
+
+void alt_memory_tracker_t::inform_cold_tier_miss() {
+    if (stats_ == NULL) {
+        return;
+    }
+    ++stats_->pm_cold_tier_misses;
+}
+
+void alt_memory_tracker_t::inform_flash_cache_hit() {
+    if (stats_ == NULL) {
+        return;
+    }
+    ++stats_->pm_flash_cache_hits;
+}
+
+void alt_memory_tracker_t::inform_flash_cache_write() {
+    if (stats_ == NULL) {
+        return;
+    }
+    ++stats_->pm_flash_cache_writes;
+}
+
+void alt_memory_tracker_t::inform_flash_cache_write_dropped() {
+    if (stats_ == NULL) {
+        return;
+    }
+    ++stats_->pm_flash_cache_dropped_writes;
+}
+
+void alt_memory_tracker_t::inform_page_evicted(uint32_t ser_buf_size) {
+    if (stats_ == NULL) {
+        return;
+    }
+    ++stats_->pm_evictions;
+    stats_->pm_evicted_bytes += ser_buf_size;
+}
+
 // KSI: An interface problem here is that this is measured in blocks while
 // inform_memory_change is measured in bytes.
 tracker_acq_t alt_memory_tracker_t::begin_txn_or_throttle(int64_t expected_change_count) {
@@ -76,10 +135,11 @@ void alt_memory_tracker_t::end_txn(UNUSED tracker_acq_t acq) {
 }
 
 cache_t::cache_t(serializer_t *serializer, const alt_cache_config_t &config,
+                 cache_balancer_t *balancer,
                  perfmon_collection_t *perfmon_collection)
     : stats_(make_scoped<alt_cache_stats_t>(perfmon_collection)),
-      tracker_(),
-      page_cache_(serializer, config.page_config, &tracker_) { }
+      tracker_(stats_.get()),
+      page_cache_(serializer, config.page_config, &tracker_, balancer) { }
 
 cache_t::~cache_t() { }
 
@@ -91,6 +151,33 @@ cache_account_t cache_t::create_cache_account(int priority) {
     return page_cache_.create_cache_account(priority);
 }
 
+cache_account_t cache_t::create_cache_account(int priority,
+                                              uint64_t memory_reservation,
+                                              uint64_t memory_limit) {
+    return page_cache_.create_cache_account(priority, memory_reservation,
+                                            memory_limit);
+}
+
+uint64_t cache_t::memory_limit() const {
+    return page_cache_.memory_limit();
+}
+
+void cache_t::use_warmup_file(const std::string &filepath) {
+    page_cache_.use_warmup_file(filepath);
+}
+
+void cache_t::use_flash_cache(scoped_ptr_t<file_t> &&file, uint64_t size) {
+    page_cache_.use_flash_cache(std::move(file), size);
+}
+
+void cache_t::change_outside_memory(int64_t delta) {
+    page_cache_.change_outside_memory(delta);
+}
+
+repli_timestamp_t cache_t::peek_recency(block_id_t block_id) {
+    return page_cache_.peek_recency(block_id);
+}
+
 alt_snapshot_node_t *
 cache_t::matching_snapshot_node_or_null(block_id_t block_id,
                                         block_version_t block_version) {
@@ -666,11 +753,39 @@ repli_timestamp_t buf_lock_t::get_recency() const {
     return current_page_acq()->recency();
 }
 
+bool buf_lock_t::read_optimistically() {
+    guarantee(!empty());
+    if (snapshot_node_ != NULL) {
+        return false;
+    }
+    return current_page_acq_->try_optimistic_read(txn_->account());
+}
+
+bool buf_lock_t::has_optimistic_read() const {
+    guarantee(!empty());
+    return snapshot_node_ == NULL && current_page_acq_->has_optimistic_read();
+}
+
+bool buf_lock_t::optimistic_read_is_valid() {
+    guarantee(!empty());
+    return snapshot_node_ != NULL || current_page_acq_->optimistic_read_is_valid();
+}
+
+void buf_lock_t::abandon_optimistic_read() {
+    guarantee(!empty());
+    guarantee(access_ref_count_ == 0);
+    if (snapshot_node_ == NULL) {
+        current_page_acq_->abandon_optimistic_read();
+    }
+}
+
 page_t *buf_lock_t::get_held_page_for_read() {
     guarantee(!empty());
     current_page_acq_t *cpa = current_page_acq();
     guarantee(cpa != NULL);
-    cpa->read_acq_signal()->wait();
+    if (!has_optimistic_read()) {
+        cpa->read_acq_signal()->wait();
+    }
 
     ASSERT_FINITE_CORO_WAITING;
     guarantee(!empty());
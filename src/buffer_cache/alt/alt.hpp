@@ -3,6 +3,7 @@
 #define BUFFER_CACHE_ALT_ALT_HPP_
 
 #include <map>
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -24,6 +25,8 @@ class alt_snapshot_node_t;
 class alt_memory_tracker_t : public memory_tracker_t {
 public:
     alt_memory_tracker_t();
+    // Counts page accesses per cache segment in stats.
+    explicit alt_memory_tracker_t(alt_cache_stats_t *stats);
     ~alt_memory_tracker_t();
 
     alt::tracker_acq_t begin_txn_or_throttle(int64_t expected_change_count);
@@ -34,6 +37,15 @@ private:
 
     void inform_memory_change(uint64_t in_memory_size,
                               uint64_t memory_limit);
+    void inform_page_access(cache_segment_access_t access);
+    void inform_cold_tier_miss();
+    void inform_flash_cache_hit();
+    void inform_flash_cache_write();
+    void inform_flash_cache_write_dropped();
+    void inform_page_evicted(uint32_t ser_buf_size);
+
+    // Possibly NULL.
+    alt_cache_stats_t *const stats_;
 
     new_semaphore_t unwritten_changes_semaphore_;
     DISABLE_COPYING(alt_memory_tracker_t);
@@ -41,9 +53,11 @@ private:
 
 class cache_t : public home_thread_mixin_t {
 public:
-    explicit cache_t(serializer_t *serializer,
-                     const alt_cache_config_t &dynamic_config,
-                     perfmon_collection_t *perfmon_collection);
+    // balancer may be NULL.
+    cache_t(serializer_t *serializer,
+            const alt_cache_config_t &dynamic_config,
+            cache_balancer_t *balancer,
+            perfmon_collection_t *perfmon_collection);
     ~cache_t();
 
     block_size_t max_block_size() const;
@@ -56,6 +70,24 @@ public:
     // i.e. define a "default" priority etc.  TODO: As soon as we can support it, we
     // might consider supporting a mem_cap paremeter.
     cache_account_t create_cache_account(int priority);
+    // See page_cache_t::create_cache_account.
+    cache_account_t create_cache_account(int priority,
+                                         uint64_t memory_reservation,
+                                         uint64_t memory_limit);
+
+    uint64_t memory_limit() const;
+
+    // See page_cache_t::use_warmup_file.
+    void use_warmup_file(const std::string &filepath);
+
+    // See page_cache_t::use_flash_cache.
+    void use_flash_cache(scoped_ptr_t<file_t> &&file, uint64_t size);
+
+    // See page_cache_t::change_outside_memory.
+    void change_outside_memory(int64_t delta);
+
+    // See page_cache_t::peek_recency.
+    repli_timestamp_t peek_recency(block_id_t block_id);
 
 private:
     friend class txn_t;
@@ -219,6 +251,16 @@ public:
 
     void mark_deleted();
 
+    // Optimistic reads (see current_page_acq_t::try_optimistic_read) for bufs
+    // acquired for read that aren't snapshotted.  read_optimistically() returns true
+    // if a buf_read_t can read the block without waiting, and never blocks.  While
+    // we hold an optimistic read, buf_read_t returns the version we read, even if
+    // optimistic_read_is_valid() later returns false.
+    bool read_optimistically();
+    bool has_optimistic_read() const;
+    bool optimistic_read_is_valid();
+    void abandon_optimistic_read();
+
     txn_t *txn() const { return txn_; }
     cache_t *cache() const { return txn_->cache(); }
 
@@ -294,6 +336,11 @@ public:
         return txn_ == NULL;
     }
 
+    // The lock this parent refers to, or NULL if the parent is a txn.
+    buf_lock_t *lock_or_null() const {
+        return lock_or_null_;
+    }
+
     txn_t *txn() const {
         guarantee(!empty());
         return txn_;
@@ -1,5 +1,9 @@
 #include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
 
+#include <algorithm>
+
+#include "config/args.hpp"
+
 void write_onto_blob(buf_parent_t parent, blob_t *blob,
                      const write_message_t &wm) {
     blob->clear(parent);
@@ -18,3 +22,71 @@ void write_onto_blob(buf_parent_t parent, blob_t *blob,
               "Blob not filled by write_message_t (Was it made too big?)");
 }
 
+
+blob_read_stream_t::blob_read_stream_t(buf_parent_t parent, char *ref, int maxreflen,
+                                       int64_t start_offset)
+    : parent_(parent),
+      blob_(parent.cache()->max_block_size(), ref, maxreflen),
+      value_size_(blob_.valuesize()),
+      value_offset_(blob::ref_value_offset(ref, maxreflen)),
+      chunk_end_(start_offset) {
+    guarantee(start_offset >= 0 && start_offset <= value_size_);
+}
+
+blob_read_stream_t::~blob_read_stream_t() {
+    release_chunk();
+}
+
+int64_t blob_read_stream_t::read(void *p, int64_t n) {
+    char *out = static_cast<char *>(p);
+    int64_t total = 0;
+    while (total < n) {
+        if (group_stream_.has()) {
+            const int64_t res = group_stream_->read(out + total, n - total);
+            if (res == -1) {
+                return -1;
+            }
+            total += res;
+            if (res != 0) {
+                continue;
+            }
+        }
+        if (chunk_end_ == value_size_) {
+            break;
+        }
+        acquire_next_chunk();
+    }
+    return total;
+}
+
+bool blob_read_stream_t::entire_stream_consumed() const {
+    return chunk_end_ == value_size_
+        && (!group_stream_.has() || group_stream_->entire_stream_consumed());
+}
+
+void blob_read_stream_t::release_chunk() {
+    // The buffer group points into the buffers the blob_acq_t holds.
+    group_stream_.reset();
+    group_.reset();
+    acq_.reset();
+}
+
+void blob_read_stream_t::acquire_next_chunk() {
+    release_chunk();
+
+    // Chunks end on leaf boundaries, so that no leaf gets acquired twice.  (The
+    // value doesn't necessarily start at the beginning of a leaf.)
+    const int64_t leaf_size = blob::stepsize(parent_.cache()->max_block_size(), 1);
+    const int64_t internal_end = value_offset_ + chunk_end_;
+    const int64_t next_chunk_end
+        = (internal_end / leaf_size + BLOB_READ_STREAM_CHUNK_LEAVES) * leaf_size
+        - value_offset_;
+    const int64_t size = std::min(value_size_, next_chunk_end) - chunk_end_;
+
+    acq_.init(new blob_acq_t);
+    group_.init(new buffer_group_t);
+    blob_.expose_region(parent_, access_t::read, chunk_end_, size,
+                        group_.get(), acq_.get());
+    group_stream_.init(new buffer_group_read_stream_t(const_view(group_.get())));
+    chunk_end_ += size;
+}
@@ -5,6 +5,43 @@
 #include "buffer_cache/alt/blob.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
+#include "containers/buffer_group.hpp"
+#include "containers/scoped.hpp"
+
+// Reads a blob's value as a stream.  Unlike expose_all, which acquires every leaf
+// buffer of the blob up front, this acquires BLOB_READ_STREAM_CHUNK_LEAVES leaves at
+// a time, as the reader gets to them, and releases each chunk before acquiring the
+// next one.  So deserializing a large value doesn't hold the whole blob in the cache
+// at once.  The blob must not be modified while the stream exists.  The stream
+// starts `start_offset` bytes into the value.
+class blob_read_stream_t : public read_stream_t {
+public:
+    blob_read_stream_t(buf_parent_t parent, char *ref, int maxreflen,
+                       int64_t start_offset = 0);
+    virtual ~blob_read_stream_t();
+
+    virtual MUST_USE int64_t read(void *p, int64_t n);
+
+    bool entire_stream_consumed() const;
+
+private:
+    void release_chunk();
+    void acquire_next_chunk();
+
+    buf_parent_t parent_;
+    blob_t blob_;
+    const int64_t value_size_;
+    // Where the value starts in the blob's first leaf.
+    const int64_t value_offset_;
+    // The offset (in the value) of the end of the chunk we've acquired.
+    int64_t chunk_end_;
+
+    scoped_ptr_t<blob_acq_t> acq_;
+    scoped_ptr_t<buffer_group_t> group_;
+    scoped_ptr_t<buffer_group_read_stream_t> group_stream_;
+
+    DISABLE_COPYING(blob_read_stream_t);
+};
 
 void write_onto_blob(buf_parent_t parent, blob_t *blob,
                      const write_message_t &wm);
@@ -225,6 +225,10 @@ int64_t ref_value_offset(const char *ref, int maxreflen) {
     return is_small(ref, maxreflen) ? 0 : big_offset(ref, maxreflen);
 }
 
+const char *inline_value_data(const char *ref, int maxreflen) {
+    return is_small(ref, maxreflen) ? ref + big_size_offset(maxreflen) : NULL;
+}
+
 int64_t stepsize(block_size_t block_size, int levels) {
     rassert(levels > 0);
     int64_t step = leaf_size(block_size);
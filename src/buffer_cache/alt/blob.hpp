@@ -106,6 +106,10 @@ int ref_size(block_size_t block_size, const char *ref, int maxreflen);
 // data_length).
 bool ref_fits(block_size_t block_size, int data_length, const char *ref, int maxreflen);
 
+// Returns true if a value of proposed_size bytes would be stored inline in a blob
+// ref, without any blocks of its own.
+bool size_would_be_small(int64_t proposed_size, int maxreflen);
+
 // Returns what the maxreflen would be, given the desired number of
 // block ids in the blob ref.
 int maxreflen_from_blockid_count(int count);
@@ -142,6 +146,11 @@ const char *leaf_node_data(const void *buf);
 // Returns the internal offset of the ref value, which is especially useful when it's not inlined.
 int64_t ref_value_offset(const char *ref, int maxreflen);
 
+// Returns the bytes of a value that's stored inline in its blob ref, or NULL if
+// the value has blocks of its own.  Reading an inline value needs no blocks beyond
+// the one the ref is in.
+const char *inline_value_data(const char *ref, int maxreflen);
+
 }  // namespace blob
 
 class blob_t {
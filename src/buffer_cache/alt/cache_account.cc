@@ -1,12 +1,14 @@
 #include "buffer_cache/alt/cache_account.hpp"
 
 #include "arch/types.hpp"
+#include "buffer_cache/alt/evicter.hpp"
 
 cache_account_t::cache_account_t()
     : thread_(-1), io_account_(NULL) { }
 
 cache_account_t::cache_account_t(cache_account_t &&movee)
-    : thread_(movee.thread_), io_account_(movee.io_account_) {
+    : thread_(movee.thread_), io_account_(movee.io_account_),
+      quota_(std::move(movee.quota_)) {
     movee.thread_ = threadnum_t(-1);
     movee.io_account_ = NULL;
 }
@@ -15,6 +17,7 @@ cache_account_t &cache_account_t::operator=(cache_account_t &&movee) {
     cache_account_t tmp(std::move(movee));
     std::swap(thread_, tmp.thread_);
     std::swap(io_account_, tmp.io_account_);
+    quota_.swap(tmp.quota_);
     return *this;
 }
 
@@ -26,12 +29,14 @@ void cache_account_t::init(threadnum_t thread, file_account_t *io_account) {
 }
 
 
-cache_account_t::cache_account_t(threadnum_t thread, file_account_t *io_account)
-    : thread_(thread), io_account_(io_account) {
+cache_account_t::cache_account_t(threadnum_t thread, file_account_t *io_account,
+                                 counted_t<alt::account_quota_t> &&quota)
+    : thread_(thread), io_account_(io_account), quota_(std::move(quota)) {
     rassert(io_account != NULL);
 }
 
 void cache_account_t::reset() {
+    quota_.reset();
     if (io_account_ != NULL) {
         threadnum_t local_thread = thread_;
         file_account_t *local_account = io_account_;
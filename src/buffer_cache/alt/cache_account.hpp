@@ -1,12 +1,15 @@
 #ifndef BUFFER_CACHE_ALT_CACHE_ACCOUNT_HPP_
 #define BUFFER_CACHE_ALT_CACHE_ACCOUNT_HPP_
 
+#include "containers/counted.hpp"
 #include "utils.hpp"
 
 class file_account_t;
 
 namespace alt {
+class account_quota_t;
 class page_cache_t;
+class page_t;
 }
 
 class cache_account_t {
@@ -21,14 +24,19 @@ public:
     }
 private:
     friend class alt::page_cache_t;
+    friend class alt::page_t;
     void init(threadnum_t thread, file_account_t *io_account);
-    cache_account_t(threadnum_t thread, file_account_t *io_account);
+    cache_account_t(threadnum_t thread, file_account_t *io_account,
+                    counted_t<alt::account_quota_t> &&quota);
     void reset();
 
     // KSI: I hate having this thread_ variable, and it looks like the file_account_t
     // already worries about going to the right thread anyway.
     threadnum_t thread_;
     file_account_t *io_account_;
+    // The memory bounds of the pages charged to this account, or NULL if it has
+    // none.
+    counted_t<alt::account_quota_t> quota_;
     DISABLE_COPYING(cache_account_t);
 };
 
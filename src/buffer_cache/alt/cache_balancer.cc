@@ -0,0 +1,139 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/cache_balancer.hpp"
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "buffer_cache/alt/evicter.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
+
+cache_balancer_t::cache_balancer_t(uint64_t memory_budget)
+    : evicters_by_thread_(get_num_threads()),
+      memory_budget_(memory_budget),
+      rebalance_in_progress_(false),
+      timer_(CACHE_BALANCER_REBALANCE_INTERVAL_MS, this) { }
+
+cache_balancer_t::~cache_balancer_t() {
+    assert_thread();
+#ifndef NDEBUG
+    for (size_t i = 0; i < evicters_by_thread_.size(); ++i) {
+        rassert(evicters_by_thread_[i].empty());
+    }
+#endif
+}
+
+void cache_balancer_t::add_evicter(alt::evicter_t *evicter) {
+    std::set<alt::evicter_t *> *evicters
+        = &evicters_by_thread_[get_thread_id().threadnum];
+    auto res = evicters->insert(evicter);
+    guarantee(res.second);
+}
+
+void cache_balancer_t::remove_evicter(alt::evicter_t *evicter) {
+    std::set<alt::evicter_t *> *evicters
+        = &evicters_by_thread_[get_thread_id().threadnum];
+    size_t num_erased = evicters->erase(evicter);
+    guarantee(num_erased == 1);
+}
+
+void cache_balancer_t::on_ring() {
+    assert_thread();
+    // A rebalance has to visit every thread, which can take longer than the timer
+    // interval on a busy server.
+    if (!rebalance_in_progress_) {
+        rebalance_in_progress_ = true;
+        coro_t::spawn_sometime(std::bind(&cache_balancer_t::rebalance,
+                                         this, drainer_.lock()));
+    }
+}
+
+void cache_balancer_t::collect_samples(
+        int thread,
+        std::vector<std::vector<evicter_sample_t> > *samples) {
+    on_thread_t th((threadnum_t(thread)));
+    std::set<alt::evicter_t *> *evicters = &evicters_by_thread_[thread];
+    for (auto it = evicters->begin(); it != evicters->end(); ++it) {
+        evicter_sample_t sample;
+        sample.evicter = *it;
+        sample.configured_memory_limit = (*it)->configured_memory_limit();
+        sample.memory_limit = (*it)->memory_limit();
+        sample.refaults = (*it)->take_refault_count();
+        sample.new_memory_limit = sample.memory_limit;
+        (*samples)[thread].push_back(sample);
+    }
+}
+
+void cache_balancer_t::apply_new_limits(
+        int thread,
+        const std::vector<std::vector<evicter_sample_t> > *samples) {
+    on_thread_t th((threadnum_t(thread)));
+    std::set<alt::evicter_t *> *evicters = &evicters_by_thread_[thread];
+    const std::vector<evicter_sample_t> &thread_samples = (*samples)[thread];
+    for (auto it = thread_samples.begin(); it != thread_samples.end(); ++it) {
+        // The evicter might have gone away while we were on other threads.
+        if (evicters->find(it->evicter) != evicters->end()) {
+            it->evicter->update_memory_limit(it->new_memory_limit);
+        }
+    }
+}
+
+void cache_balancer_t::rebalance(auto_drainer_t::lock_t lock) {
+    assert_thread();
+    std::vector<std::vector<evicter_sample_t> > samples(get_num_threads());
+    pmap(get_num_threads(), std::bind(&cache_balancer_t::collect_samples,
+                                      this, ph::_1, &samples));
+
+    uint64_t total_configured = 0;
+    uint64_t total_refaults = 0;
+    for (auto thread = samples.begin(); thread != samples.end(); ++thread) {
+        for (auto it = thread->begin(); it != thread->end(); ++it) {
+            total_configured += it->configured_memory_limit;
+            total_refaults += it->refaults;
+        }
+    }
+
+    // Over budget, every cache's configured limit counts for less.
+    const bool over_budget = memory_budget_ != 0 && total_configured > memory_budget_;
+    const double scale = over_budget
+        ? static_cast<double>(memory_budget_) / total_configured
+        : 1.0;
+    uint64_t total_floor = 0;
+    for (auto thread = samples.begin(); thread != samples.end(); ++thread) {
+        for (auto it = thread->begin(); it != thread->end(); ++it) {
+            it->configured_memory_limit =
+                static_cast<uint64_t>(it->configured_memory_limit * scale);
+            total_floor += it->configured_memory_limit / 100
+                * CACHE_BALANCER_MIN_SHARE_PERCENT;
+        }
+    }
+    const uint64_t total_available = over_budget ? memory_budget_ : total_configured;
+
+    // If nobody is missing pages they once had, we have nothing to go by, and the
+    // current limits are as good as any -- unless they add up to more than the
+    // budget, in which case we move them towards their scaled-down limits.
+    if ((total_refaults > 0 || over_budget) && !lock.get_drain_signal()->is_pulsed()) {
+        const uint64_t spare = total_available - total_floor;
+        for (auto thread = samples.begin(); thread != samples.end(); ++thread) {
+            for (auto it = thread->begin(); it != thread->end(); ++it) {
+                const uint64_t floor = it->configured_memory_limit / 100
+                    * CACHE_BALANCER_MIN_SHARE_PERCENT;
+                const uint64_t target = total_refaults > 0
+                    ? floor + static_cast<uint64_t>(
+                        static_cast<double>(spare) * it->refaults / total_refaults)
+                    : it->configured_memory_limit;
+                // We only move halfway towards the target each time, so that a
+                // single burst of misses doesn't throw every other cache's pages
+                // out.  This also pulls the sum of the limits back towards
+                // total_configured after caches come and go.
+                it->new_memory_limit = it->memory_limit / 2 + target / 2;
+            }
+        }
+
+        pmap(get_num_threads(), std::bind(&cache_balancer_t::apply_new_limits,
+                                          this, ph::_1, &samples));
+    }
+
+    rebalance_in_progress_ = false;
+}
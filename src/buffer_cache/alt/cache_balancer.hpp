@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_CACHE_BALANCER_HPP_
+#define BUFFER_CACHE_ALT_CACHE_BALANCER_HPP_
+
+#include <stdint.h>
+
+#include <set>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+namespace alt {
+class evicter_t;
+}  // namespace alt
+
+// Shifts memory between the page caches on this server, so that operators don't
+// have to size each table's cache by hand.  Every evicter registers with the
+// balancer along with its configured memory limit.  Periodically the balancer
+// redistributes the sum of those limits, giving each cache a share proportional to
+// how often it had to reload a page it had evicted -- the misses a bigger cache
+// would have avoided.  Idle caches thereby give their memory to busy ones, but every
+// cache keeps at least CACHE_BALANCER_MIN_SHARE_PERCENT of its configured limit.
+//
+// If the sum of the limits is more than `memory_budget` (when that isn't 0), the
+// balancer distributes `memory_budget` instead, as if every configured limit were
+// scaled down to fit.  That's how the server keeps its caches within a container's
+// memory limit.
+class cache_balancer_t : public home_thread_mixin_t,
+                         private repeating_timer_callback_t {
+public:
+    explicit cache_balancer_t(uint64_t memory_budget = 0);
+    ~cache_balancer_t();
+
+private:
+    friend class alt::evicter_t;
+
+    // These are called on the evicter's home thread.
+    void add_evicter(alt::evicter_t *evicter);
+    void remove_evicter(alt::evicter_t *evicter);
+
+    struct evicter_sample_t {
+        alt::evicter_t *evicter;
+        uint64_t configured_memory_limit;
+        uint64_t memory_limit;
+        uint64_t refaults;
+        uint64_t new_memory_limit;
+    };
+
+    void on_ring();
+    void rebalance(auto_drainer_t::lock_t lock);
+    void collect_samples(int thread,
+                         std::vector<std::vector<evicter_sample_t> > *samples);
+    void apply_new_limits(int thread,
+                          const std::vector<std::vector<evicter_sample_t> > *samples);
+
+    // The evicters on each thread, indexed by thread number.  Each set is only
+    // accessed on its own thread.
+    scoped_array_t<std::set<alt::evicter_t *> > evicters_by_thread_;
+
+    const uint64_t memory_budget_;
+
+    bool rebalance_in_progress_;
+
+    auto_drainer_t drainer_;
+    repeating_timer_t timer_;
+
+    DISABLE_COPYING(cache_balancer_t);
+};
+
+#endif  // BUFFER_CACHE_ALT_CACHE_BALANCER_HPP_
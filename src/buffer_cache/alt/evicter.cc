@@ -1,15 +1,80 @@
 #include "buffer_cache/alt/evicter.hpp"
 
+#include "buffer_cache/alt/cache_balancer.hpp"
+#include "buffer_cache/alt/flash_cache.hpp"
 #include "buffer_cache/alt/page.hpp"
+#include "config/args.hpp"
 
 namespace alt {
 
-evicter_t::evicter_t(memory_tracker_t *tracker, uint64_t memory_limit)
-    : tracker_(tracker), memory_limit_(memory_limit),
-      access_time_counter_(INITIAL_ACCESS_TIME) { }
+evicter_t::evicter_t(memory_tracker_t *tracker, uint64_t memory_limit,
+                     cache_balancer_t *balancer)
+    : tracker_(tracker), balancer_(balancer),
+      configured_memory_limit_(memory_limit), memory_limit_(memory_limit),
+      outside_memory_(0),
+      refaults_(0),
+      access_time_counter_(INITIAL_ACCESS_TIME) {
+    if (balancer_ != NULL) {
+        balancer_->add_evicter(this);
+    }
+}
 
 evicter_t::~evicter_t() {
     assert_thread();
+    rassert(quotas_.empty());
+    rassert(outside_memory_ == 0);
+    if (balancer_ != NULL) {
+        balancer_->remove_evicter(this);
+    }
+}
+
+uint64_t evicter_t::take_refault_count() {
+    assert_thread();
+    uint64_t ret = refaults_;
+    refaults_ = 0;
+    return ret;
+}
+
+void evicter_t::update_memory_limit(uint64_t new_memory_limit) {
+    assert_thread();
+    memory_limit_ = new_memory_limit;
+    inform_tracker();
+    evict_if_necessary();
+}
+
+void evicter_t::change_outside_memory(int64_t delta) {
+    assert_thread();
+    rassert(delta >= 0 || static_cast<uint64_t>(-delta) <= outside_memory_);
+    outside_memory_ += delta;
+    inform_tracker();
+    evict_if_necessary();
+}
+
+account_quota_t::account_quota_t(evicter_t *evicter,
+                                 uint64_t memory_reservation,
+                                 uint64_t memory_limit)
+    : evicter_(evicter),
+      memory_reservation_(memory_reservation),
+      memory_limit_(memory_limit) {
+    evicter_->assert_thread();
+    evicter_->quotas_.push_back(this);
+}
+
+account_quota_t::~account_quota_t() {
+    evicter_->assert_thread();
+    // Every page charged to us holds a reference, so there can't be any left.
+    rassert(evictable_.size() == 0);
+    evicter_->quotas_.remove(this);
+}
+
+counted_t<account_quota_t> evicter_t::make_account_quota(uint64_t memory_reservation,
+                                                         uint64_t memory_limit) {
+    assert_thread();
+    if (memory_reservation == 0 && memory_limit == 0) {
+        return counted_t<account_quota_t>();
+    }
+    rassert(memory_limit == 0 || memory_reservation <= memory_limit);
+    return make_counted<account_quota_t>(this, memory_reservation, memory_limit);
 }
 
 
@@ -40,7 +105,10 @@ void evicter_t::add_to_evictable_unbacked(page_t *page) {
 
 void evicter_t::add_to_evictable_disk_backed(page_t *page) {
     assert_thread();
-    evictable_disk_backed_.add(page, page->ser_buf_size_);
+    // Pages given to us by read-ahead have never been accessed, so they start out
+    // probationary.
+    rassert(!page->is_protected());
+    evictable_probationary_.add(page, page->ser_buf_size_);
     inform_tracker();
     evict_if_necessary();
 }
@@ -50,8 +118,10 @@ void evicter_t::move_unevictable_to_evictable(page_t *page) {
     rassert(unevictable_.has_page(page));
     unevictable_.remove(page, page->ser_buf_size_);
     eviction_bag_t *new_bag = correct_eviction_category(page);
-    rassert(new_bag == &evictable_disk_backed_
-            || new_bag == &evictable_unbacked_);
+    rassert(new_bag == &evictable_probationary_
+            || new_bag == &evictable_protected_
+            || new_bag == &evictable_unbacked_
+            || (page->quota_.has() && new_bag == &page->quota_->evictable_));
     new_bag->add(page, page->ser_buf_size_);
     inform_tracker();
     evict_if_necessary();
@@ -75,7 +145,12 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     } else if (!page->buf_.has()) {
         return &evicted_;
     } else if (page->block_token_.has()) {
-        return &evictable_disk_backed_;
+        if (page->quota_.has()) {
+            return &page->quota_->evictable_;
+        }
+        return page->is_protected()
+            ? &evictable_protected_
+            : &evictable_probationary_;
     } else {
         return &evictable_unbacked_;
     }
@@ -91,11 +166,52 @@ void evicter_t::remove_page(page_t *page) {
     evict_if_necessary();
 }
 
+void evicter_t::record_page_access(page_t *page) {
+    assert_thread();
+    cache_segment_access_t access;
+    if (!page->buf_.has()) {
+        access = cache_segment_access_t::MISS;
+        if (evicted_.has_page(page)) {
+            ++refaults_;
+        }
+    } else if (page->is_protected()) {
+        access = cache_segment_access_t::PROTECTED_HIT;
+    } else {
+        access = cache_segment_access_t::PROBATIONARY_HIT;
+    }
+    tracker_->inform_page_access(access);
+}
+
+void evicter_t::record_cold_tier_miss() {
+    assert_thread();
+    tracker_->inform_cold_tier_miss();
+}
+
+void evicter_t::use_flash_cache(scoped_ptr_t<file_t> &&file, uint64_t size,
+                                uint32_t slot_size) {
+    assert_thread();
+    rassert(!flash_cache_.has());
+    flash_cache_.init(new flash_cache_t(std::move(file), size, slot_size, tracker_));
+}
+
 uint64_t evicter_t::in_memory_size() const {
     assert_thread();
+    uint64_t quotas_size = 0;
+    for (account_quota_t *quota = quotas_.head();
+         quota != NULL;
+         quota = quotas_.next(quota)) {
+        quotas_size += quota->evictable_.size();
+    }
     return unevictable_.size()
-        + evictable_disk_backed_.size()
-        + evictable_unbacked_.size();
+        + evictable_probationary_.size()
+        + evictable_protected_.size()
+        + evictable_unbacked_.size()
+        + quotas_size
+        + outside_memory_;
+}
+
+uint64_t evicter_t::protected_segment_limit() const {
+    return memory_limit_ / 100 * CACHE_PROTECTED_SEGMENT_PERCENT;
 }
 
 bool evicter_t::interested_in_read_ahead_block(uint32_t ser_block_size) const {
@@ -109,17 +225,85 @@ void evicter_t::evict_if_necessary() {
     // currently in the process of being evicted, to avoid reflushing a page
     // currently being written for the purpose of eviction.
 
+    // Accounts that are over their own limit pay for it first, whether or not the
+    // cache as a whole needs room.
     page_t *page;
-    while (in_memory_size() > memory_limit_
-           && evictable_disk_backed_.remove_oldish(&page, access_time_counter_)) {
-        evicted_.add(page, page->ser_buf_size_);
-        page->evict_self();
+    account_quota_t *quota = quotas_.head();
+    while (quota != NULL) {
+        // Evicting the quota's last page could destroy it before we've moved on.
+        counted_t<account_quota_t> keepalive(quota);
+        while (quota->memory_limit_ != 0
+               && quota->evictable_.size() > quota->memory_limit_
+               && quota->evictable_.remove_oldish(&page, access_time_counter_)) {
+            evict_page(page);
+        }
+        quota = quotas_.next(quota);
     }
+
+    while (in_memory_size() > memory_limit_) {
+        // Pages charged to an account beyond its reservation go before anybody
+        // else's.
+        if (evict_from_quotas(false)) {
+            continue;
+        }
+
+        // If the protected segment has outgrown its share, demote one of its older
+        // pages back to probation instead of evicting it outright.  It gets the
+        // remaining probationary pages' chance of being reused before eviction.
+        if (evictable_protected_.size() > protected_segment_limit()
+            && evictable_protected_.remove_oldish(&page, access_time_counter_)) {
+            page->demote();
+            page->access_time_ = next_access_time();
+            evictable_probationary_.add(page, page->ser_buf_size_);
+            continue;
+        }
+
+        if (evictable_probationary_.remove_oldish(&page, access_time_counter_)
+            || evictable_protected_.remove_oldish(&page, access_time_counter_)) {
+            evict_page(page);
+            continue;
+        }
+
+        // Reservations are not a promise we can keep if the reserved pages are all
+        // that's left.
+        if (!evict_from_quotas(true)) {
+            break;
+        }
+    }
+}
+
+bool evicter_t::evict_from_quotas(bool ignore_reservations) {
+    page_t *page;
+    for (account_quota_t *quota = quotas_.head();
+         quota != NULL;
+         quota = quotas_.next(quota)) {
+        if ((ignore_reservations
+             || quota->evictable_.size() > quota->memory_reservation_)
+            && quota->evictable_.remove_oldish(&page, access_time_counter_)) {
+            evict_page(page);
+            return true;
+        }
+    }
+    return false;
+}
+
+void evicter_t::evict_page(page_t *page) {
+    tracker_->inform_page_evicted(page->ser_buf_size_);
+    evicted_.add(page, page->ser_buf_size_);
+    // This can drop the last reference to the page's quota.
+    page->evict_self(flash_cache_.get());
 }
 
 void evicter_t::inform_tracker() const {
     tracker_->inform_memory_change(in_memory_size(),
                                    memory_limit_);
+    for (account_quota_t *quota = quotas_.head();
+         quota != NULL;
+         quota = quotas_.next(quota)) {
+        tracker_->inform_account_memory_change(quota->evictable_.size(),
+                                               quota->memory_reservation_,
+                                               quota->memory_limit_);
+    }
 }
 
 
@@ -4,17 +4,79 @@
 #include <stdint.h>
 
 #include "buffer_cache/alt/eviction_bag.hpp"
+#include "containers/counted.hpp"
+#include "containers/intrusive_list.hpp"
+#include "containers/scoped.hpp"
 #include "utils.hpp"
 
+class cache_balancer_t;
+class file_t;
+
+// Which segment of the cache a page acquisition was served from.
+enum class cache_segment_access_t {
+    // The page had been loaded but not yet reused.
+    PROBATIONARY_HIT,
+    // The page had been used at least twice since it was loaded.
+    PROTECTED_HIT,
+    // The page had to be loaded from disk.
+    MISS
+};
+
 class memory_tracker_t {
 public:
     virtual ~memory_tracker_t() { }
     virtual void inform_memory_change(uint64_t in_memory_size,
                                       uint64_t memory_limit) = 0;
+    virtual void inform_page_access(UNUSED cache_segment_access_t access) { }
+    // Called for the misses whose page was loaded from the serializer's cold tier.
+    virtual void inform_cold_tier_miss() { }
+    // Called for the misses whose page was read from the flash cache, for evicted
+    // pages the flash cache finished writing, and for evicted pages it had no room
+    // to take.
+    virtual void inform_flash_cache_hit() { }
+    virtual void inform_flash_cache_write() { }
+    virtual void inform_flash_cache_write_dropped() { }
+    virtual void inform_page_evicted(UNUSED uint32_t ser_buf_size) { }
+    // Called alongside inform_memory_change for every cache account that has a
+    // memory quota.  in_memory_size is the size of the evictable pages currently
+    // charged to the account.
+    virtual void inform_account_memory_change(UNUSED uint64_t in_memory_size,
+                                              UNUSED uint64_t memory_reservation,
+                                              UNUSED uint64_t memory_limit) { }
 };
 
 namespace alt {
 
+class evicter_t;
+class flash_cache_t;
+
+// The memory bounds of a cache account.  A loaded page is charged to the account
+// it was last acquired through, if that account has a quota.  The evicter keeps the
+// evictable pages charged to the account under memory_limit, and doesn't evict them
+// to relieve the rest of the cache while they're under memory_reservation (unless
+// nothing else is left to evict).  Pages hold references to the quota, so it can
+// outlive its cache_account_t.
+class account_quota_t : public single_threaded_countable_t<account_quota_t>,
+                        public intrusive_list_node_t<account_quota_t> {
+public:
+    account_quota_t(evicter_t *evicter,
+                    uint64_t memory_reservation,
+                    uint64_t memory_limit);
+    ~account_quota_t();
+
+private:
+    friend class evicter_t;
+
+    evicter_t *const evicter_;
+    const uint64_t memory_reservation_;
+    const uint64_t memory_limit_;
+
+    // The disk backed evictable pages charged to this quota.
+    eviction_bag_t evictable_;
+
+    DISABLE_COPYING(account_quota_t);
+};
+
 class evicter_t : public home_thread_mixin_debug_only_t {
 public:
     void add_not_yet_loaded(page_t *page);
@@ -27,37 +89,103 @@ public:
     eviction_bag_t *correct_eviction_category(page_t *page);
     void remove_page(page_t *page);
 
-    explicit evicter_t(memory_tracker_t *tracker,
-                       uint64_t memory_limit);
+    // Called whenever a page acquirer starts waiting on the page, before the page is
+    // told about the new waiter.
+    void record_page_access(page_t *page);
+
+    // Called when a page that missed was loaded from the serializer's cold tier.
+    void record_cold_tier_miss();
+
+    // Makes evicted disk backed pages go to a flash cache of size bytes in file.
+    // See flash_cache_t.
+    void use_flash_cache(scoped_ptr_t<file_t> &&file, uint64_t size,
+                         uint32_t slot_size);
+    // NULL if we don't have a flash cache.
+    flash_cache_t *flash_cache() { return flash_cache_.get(); }
+
+    // Returns NULL if both the reservation and the limit are zero, which means the
+    // account's pages are treated like everybody else's.
+    counted_t<account_quota_t> make_account_quota(uint64_t memory_reservation,
+                                                  uint64_t memory_limit);
+
+    // balancer may be NULL, in which case memory_limit never changes.
+    evicter_t(memory_tracker_t *tracker,
+              uint64_t memory_limit,
+              cache_balancer_t *balancer);
     ~evicter_t();
 
+    uint64_t memory_limit() const { return memory_limit_; }
+
+    // Counts memory that the cache's user keeps on the side (like a store's key
+    // filter) against memory_limit, so that the pages get that much less room.
+    // delta may be negative, to give the room back.
+    void change_outside_memory(int64_t delta);
+
     bool interested_in_read_ahead_block(uint32_t ser_block_size) const;
 
     uint64_t next_access_time() {
         return ++access_time_counter_;
     }
 
+    uint64_t access_time_counter() const { return access_time_counter_; }
+
     static const uint64_t INITIAL_ACCESS_TIME = UINT64_MAX - 100;
 
 private:
+    friend class account_quota_t;
+    friend class ::cache_balancer_t;
+
+    // These are used by the cache balancer.
+    uint64_t configured_memory_limit() const { return configured_memory_limit_; }
+    uint64_t take_refault_count();
+    void update_memory_limit(uint64_t new_memory_limit);
+
     void evict_if_necessary();
+    void evict_page(page_t *page);
+    bool evict_from_quotas(bool ignore_reservations);
     uint64_t in_memory_size() const;
+    uint64_t protected_segment_limit() const;
 
     void inform_tracker() const;
 
     // LSI: Implement issue 97.
     memory_tracker_t *const tracker_;
+    cache_balancer_t *const balancer_;
+    // The limit we were created with, which the balancer treats as our share of the
+    // server's cache memory.  memory_limit_ is what the balancer currently lets us
+    // use.
+    const uint64_t configured_memory_limit_;
     uint64_t memory_limit_;
 
+    // See change_outside_memory.
+    uint64_t outside_memory_;
+
+    // How many times a page that we had evicted was acquired again since the
+    // balancer last asked.
+    uint64_t refaults_;
+
     // This gets incremented every time a page is accessed.
     uint64_t access_time_counter_;
 
-    // These track whether every page's eviction status.
+    // These track whether every page's eviction status.  Disk backed evictable pages
+    // are split into two segments:  pages that have been accessed at most once since
+    // they were loaded are probationary, while pages that have been reused are
+    // protected.  We evict probationary pages first, and the protected segment is
+    // capped at CACHE_PROTECTED_SEGMENT_PERCENT of the memory limit, so that a
+    // sequential scan only churns through the probationary segment.
     eviction_bag_t unevictable_;
-    eviction_bag_t evictable_disk_backed_;
+    eviction_bag_t evictable_probationary_;
+    eviction_bag_t evictable_protected_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
 
+    // The quotas of cache accounts, whose evictable_ bags hold the disk backed
+    // evictable pages charged to them instead of the two segments above.
+    intrusive_list_t<account_quota_t> quotas_;
+
+    // Where evicted pages' buffers go, if anywhere.
+    scoped_ptr_t<flash_cache_t> flash_cache_;
+
     DISABLE_COPYING(evicter_t);
 };
 
@@ -0,0 +1,91 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/flash_cache.hpp"
+
+#include "arch/arch.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/evicter.hpp"
+#include "config/args.hpp"
+
+namespace alt {
+
+flash_cache_t::flash_cache_t(scoped_ptr_t<file_t> &&file, uint64_t size,
+                             uint32_t slot_size, memory_tracker_t *tracker)
+    : file_(std::move(file)),
+      slot_size_(slot_size),
+      tracker_(tracker),
+      slot_entries_(size / slot_size, NO_ENTRY),
+      next_entry_(1),
+      writes_in_flight_(0) {
+    guarantee(divides(DEVICE_BLOCK_SIZE, slot_size_));
+    guarantee(!slot_entries_.empty());
+    file_->set_size(static_cast<int64_t>(slot_entries_.size()) * slot_size_);
+}
+
+flash_cache_t::~flash_cache_t() {
+    assert_thread();
+}
+
+size_t flash_cache_t::slot_for(uint64_t entry) const {
+    rassert(entry != NO_ENTRY);
+    return (entry - 1) % slot_entries_.size();
+}
+
+bool flash_cache_t::contains(uint64_t entry) const {
+    assert_thread();
+    return entry != NO_ENTRY && slot_entries_[slot_for(entry)] == entry;
+}
+
+uint64_t flash_cache_t::write(scoped_malloc_t<ser_buffer_t> &&buf) {
+    assert_thread();
+    const size_t slot = slot_for(next_entry_);
+    if (writes_in_flight_ >= FLASH_CACHE_MAX_WRITES_IN_FLIGHT
+        || slot_entries_[slot] == WRITING) {
+        buf.reset();
+        tracker_->inform_flash_cache_write_dropped();
+        return NO_ENTRY;
+    }
+    const uint64_t entry = next_entry_;
+    ++next_entry_;
+    slot_entries_[slot] = WRITING;
+    ++writes_in_flight_;
+    // The buffer is passed as a raw pointer because spawned functions get copied.
+    coro_t::spawn_sometime(std::bind(&flash_cache_t::do_write, this, entry,
+                                     buf.release(), drainer_.lock()));
+    return entry;
+}
+
+void flash_cache_t::do_write(uint64_t entry, ser_buffer_t *buf_ptr,
+                             auto_drainer_t::lock_t) {
+    scoped_malloc_t<ser_buffer_t> buf(buf_ptr);
+    const size_t slot = slot_for(entry);
+    co_write(file_.get(), static_cast<int64_t>(slot) * slot_size_, slot_size_,
+             buf.get(), DEFAULT_DISK_ACCOUNT, file_t::NO_DATASYNCS);
+    rassert(slot_entries_[slot] == WRITING);
+    slot_entries_[slot] = entry;
+    --writes_in_flight_;
+    tracker_->inform_flash_cache_write();
+}
+
+bool flash_cache_t::read(uint64_t entry, ser_buffer_t *buf) {
+    assert_thread();
+    if (!contains(entry)) {
+        return false;
+    }
+    co_read(file_.get(), static_cast<int64_t>(slot_for(entry)) * slot_size_,
+            slot_size_, buf, DEFAULT_DISK_ACCOUNT);
+    // The slot could have been reused while we were reading it.
+    if (!contains(entry)) {
+        return false;
+    }
+    tracker_->inform_flash_cache_hit();
+    return true;
+}
+
+void flash_cache_t::invalidate(uint64_t entry) {
+    assert_thread();
+    if (contains(entry)) {
+        slot_entries_[slot_for(entry)] = NO_ENTRY;
+    }
+}
+
+}  // namespace alt
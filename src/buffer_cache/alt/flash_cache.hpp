@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_FLASH_CACHE_HPP_
+#define BUFFER_CACHE_ALT_FLASH_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "arch/types.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+
+class memory_tracker_t;
+
+namespace alt {
+
+/* A `flash_cache_t` is a second level below the page cache, in a file on a local
+SSD.  The evicter hands it the buffers of the disk backed pages it evicts, which it
+writes to the file in the background, and the next time one of those pages is
+loaded it's read from the file instead of the serializer.
+
+The file is a ring of slots of the serializer's block size that we write in turn,
+so the oldest copies are overwritten first.  Its index is in memory: every write
+gets an entry number, which the page_t remembers, and a slot is only read for an
+entry if the slot still holds it.  Nothing in the file survives a restart.
+
+A cached copy is only good as long as the page's block token is, so the page
+forgets its entry (and invalidates it) when it's modified. */
+class flash_cache_t : public home_thread_mixin_t {
+public:
+    // The entry of pages that have no copy in the flash cache.
+    static const uint64_t NO_ENTRY = 0;
+
+    // file holds size bytes' worth of slot_size slots.  slot_size must be a
+    // multiple of DEVICE_BLOCK_SIZE.
+    flash_cache_t(scoped_ptr_t<file_t> &&file, uint64_t size, uint32_t slot_size,
+                  memory_tracker_t *tracker);
+    ~flash_cache_t();
+
+    // True if entry has been written and its slot hasn't been reused since.
+    bool contains(uint64_t entry) const;
+
+    // Starts writing buf, which must be slot_size bytes, to the next slot, and frees
+    // it when it's done.  Returns the entry, or NO_ENTRY if we can't take another
+    // write right now (buf is freed right away then).
+    uint64_t write(scoped_malloc_t<ser_buffer_t> &&buf);
+
+    // Reads entry into buf, which must be slot_size bytes.  Returns false if the
+    // flash cache doesn't (or no longer) hold entry, in which case buf's contents
+    // are garbage.
+    bool read(uint64_t entry, ser_buffer_t *buf);
+
+    // Forgets entry, because the page it was a copy of has changed.
+    void invalidate(uint64_t entry);
+
+private:
+    size_t slot_for(uint64_t entry) const;
+    void do_write(uint64_t entry, ser_buffer_t *buf_ptr, auto_drainer_t::lock_t lock);
+
+    scoped_ptr_t<file_t> file_;
+    const uint32_t slot_size_;
+    memory_tracker_t *const tracker_;
+
+    // What slot_entries_ holds for a slot while it's being written.
+    static const uint64_t WRITING = UINT64_MAX;
+
+    // The entry each slot holds, NO_ENTRY if it's empty or WRITING.
+    std::vector<uint64_t> slot_entries_;
+    // The entry the next write gets.  Entries count up from 1, so entry e goes to
+    // slot (e - 1) % slot_entries_.size().
+    uint64_t next_entry_;
+    int writes_in_flight_;
+
+    auto_drainer_t drainer_;
+
+    DISABLE_COPYING(flash_cache_t);
+};
+
+}  // namespace alt
+
+#endif  // BUFFER_CACHE_ALT_FLASH_CACHE_HPP_
@@ -1,6 +1,7 @@
 #include "buffer_cache/alt/page.hpp"
 
 #include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/flash_cache.hpp"
 #include "buffer_cache/alt/page_cache.hpp"
 #include "serializer/serializer.hpp"
 
@@ -17,7 +18,9 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache,
                cache_account_t *account)
     : destroy_ptr_(NULL),
       ser_buf_size_(0),
+      flash_entry_(flash_cache_t::NO_ENTRY),
       access_time_(page_cache->evicter().next_access_time()),
+      access_count_(0),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_with_block_id,
@@ -32,7 +35,9 @@ page_t::page_t(block_size_t block_size, scoped_malloc_t<ser_buffer_t> buf,
     : destroy_ptr_(NULL),
       ser_buf_size_(block_size.ser_value()),
       buf_(std::move(buf)),
+      flash_entry_(flash_cache_t::NO_ENTRY),
       access_time_(page_cache->evicter().next_access_time()),
+      access_count_(0),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
@@ -45,7 +50,9 @@ page_t::page_t(scoped_malloc_t<ser_buffer_t> buf,
       ser_buf_size_(block_token->block_size().ser_value()),
       buf_(std::move(buf)),
       block_token_(block_token),
+      flash_entry_(flash_cache_t::NO_ENTRY),
       access_time_(READ_AHEAD_ACCESS_TIME),
+      access_count_(0),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
@@ -54,7 +61,9 @@ page_t::page_t(scoped_malloc_t<ser_buffer_t> buf,
 page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *account)
     : destroy_ptr_(NULL),
       ser_buf_size_(0),
+      flash_entry_(flash_cache_t::NO_ENTRY),
       access_time_(page_cache->evicter().next_access_time()),
+      access_count_(0),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
@@ -139,6 +148,10 @@ void page_t::load_with_block_id(page_t *page, block_id_t block_id,
                                account->get());
     }
 
+    if (block_token->in_cold_tier()) {
+        page_cache->evicter().record_cold_tier_miss();
+    }
+
     ASSERT_FINITE_CORO_WAITING;
     if (page_destroyed) {
         return;
@@ -199,10 +212,17 @@ void page_t::pulse_waiters_or_make_evictable(page_cache_t *page_cache) {
 }
 
 void page_t::add_waiter(page_acq_t *acq, cache_account_t *account) {
-    eviction_bag_t *old_bag
-        = acq->page_cache()->evicter().correct_eviction_category(this);
+    evicter_t *evicter = &acq->page_cache()->evicter();
+    evicter->record_page_access(this);
+    eviction_bag_t *old_bag = evicter->correct_eviction_category(this);
     waiters_.push_back(acq);
-    acq->page_cache()->evicter().change_to_correct_eviction_bag(old_bag, this);
+    evicter->change_to_correct_eviction_bag(old_bag, this);
+    // The page is unevictable while it has waiters, so bumping the access count or
+    // recharging it to this account can't change its eviction bag out from under us.
+    if (access_count_ < PROTECTED_ACCESS_COUNT) {
+        ++access_count_;
+    }
+    quota_ = account->quota_;
     if (buf_.has()) {
         acq->buf_ready_signal_.pulse();
     } else if (destroy_ptr_ != NULL) {
@@ -231,16 +251,27 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache,
     counted_t<standard_block_token_t> block_token = page->block_token_;
     rassert(block_token.has());
 
-    scoped_malloc_t<ser_buffer_t> buf;
-    {
-        serializer_t *const serializer = page_cache->serializer_;
-        buf = serializer->malloc();  // Call malloc() on our home thread because
-                                     // we'll destroy it on our home thread and
-                                     // tcmalloc likes that.
-        on_thread_t th(serializer->home_thread());
-        serializer->block_read(block_token,
-                               buf.get(),
-                               account->get());
+    // Call malloc() on our home thread because we'll destroy it on our home thread
+    // and tcmalloc likes that.
+    scoped_malloc_t<ser_buffer_t> buf = page_cache->serializer_->malloc();
+
+    // The page can't change while it's being loaded, so its flash cache copy is as
+    // good as the block token.
+    flash_cache_t *const flash_cache = page_cache->evicter().flash_cache();
+    const bool read_from_flash_cache
+        = flash_cache != NULL && flash_cache->read(page->flash_entry_, buf.get());
+    if (!read_from_flash_cache) {
+        {
+            serializer_t *const serializer = page_cache->serializer_;
+            on_thread_t th(serializer->home_thread());
+            serializer->block_read(block_token,
+                                   buf.get(),
+                                   account->get());
+        }
+
+        if (block_token->in_cold_tier()) {
+            page_cache->evicter().record_cold_tier_miss();
+        }
     }
 
     ASSERT_FINITE_CORO_WAITING;
@@ -270,12 +301,16 @@ void *page_t::get_page_buf(page_cache_t *page_cache) {
     return buf_->cache_data;
 }
 
-void page_t::reset_block_token() {
+void page_t::reset_block_token(page_cache_t *page_cache) {
     // The page is supposed to have its buffer acquired in reset_block_token -- it's
     // the thing modifying the page.  We thus assume that the page is unevictable and
     // resetting block_token_ doesn't change that.
     rassert(!waiters_.empty());
     block_token_.reset();
+    if (flash_entry_ != flash_cache_t::NO_ENTRY) {
+        page_cache->evicter().flash_cache()->invalidate(flash_entry_);
+        flash_entry_ = flash_cache_t::NO_ENTRY;
+    }
 }
 
 
@@ -289,12 +324,17 @@ void page_t::remove_waiter(page_acq_t *acq) {
     rassert(snapshot_refcount_ > 0);
 }
 
-void page_t::evict_self() {
+void page_t::evict_self(flash_cache_t *flash_cache) {
     // A page_t can only self-evict if it has a block token.
     rassert(waiters_.empty());
     rassert(block_token_.has());
     rassert(buf_.has());
+    if (flash_cache != NULL && !flash_cache->contains(flash_entry_)) {
+        flash_entry_ = flash_cache->write(std::move(buf_));
+    }
     buf_.reset();
+    access_count_ = 0;
+    quota_.reset();
 }
 
 
@@ -333,7 +373,7 @@ uint32_t page_acq_t::get_buf_size() {
 
 void *page_acq_t::get_buf_write() {
     buf_ready_signal_.wait();
-    page_->reset_block_token();
+    page_->reset_block_token(page_cache_);
     return page_->get_page_buf(page_cache_);
 }
 
@@ -9,6 +9,8 @@ class cache_account_t;
 
 namespace alt {
 
+class account_quota_t;
+class flash_cache_t;
 class page_cache_t;
 class page_acq_t;
 
@@ -35,7 +37,7 @@ private:
     friend class page_acq_t;
     // These may not be called until the page_acq_t's buf_ready_signal is pulsed.
     void *get_page_buf(page_cache_t *page_cache);
-    void reset_block_token();
+    void reset_block_token(page_cache_t *page_cache);
     uint32_t get_page_buf_size();
 
     bool is_deleted();
@@ -65,7 +67,15 @@ private:
     friend class eviction_bag_t;
     friend backindex_bag_index_t *access_backindex(page_t *page);
 
-    void evict_self();
+    // Hands the buffer to flash_cache (which may be NULL) if it doesn't already
+    // hold a copy.
+    void evict_self(flash_cache_t *flash_cache);
+
+    // A page is protected from being evicted before once-accessed pages after it has
+    // been acquired twice since it was last loaded.
+    bool is_protected() const { return access_count_ >= PROTECTED_ACCESS_COUNT; }
+    void demote() { access_count_ = PROTECTED_ACCESS_COUNT - 1; }
+    static const uint8_t PROTECTED_ACCESS_COUNT = 2;
 
     // KSI: Explain this more.
     // One of destroy_ptr_, buf_, or block_token_ is non-null.
@@ -74,8 +84,20 @@ private:
     scoped_malloc_t<ser_buffer_t> buf_;
     counted_t<standard_block_token_t> block_token_;
 
+    // The flash cache entry of a copy of the page, or flash_cache_t::NO_ENTRY.  It
+    // goes away with block_token_.
+    uint64_t flash_entry_;
+
     uint64_t access_time_;
 
+    // How many times the page has been acquired since it was last loaded, saturating
+    // at PROTECTED_ACCESS_COUNT.
+    uint8_t access_count_;
+
+    // The quota of the cache account the page was last acquired through, if it has
+    // one, while the page is loaded.
+    counted_t<account_quota_t> quota_;
+
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
     size_t snapshot_refcount_;
@@ -91,7 +113,8 @@ private:
     // if destroy_ptr_ is non-null:  unevictable_pages_
     // else if waiters_ is non-empty: unevictable_pages_
     // else if buf_ is null: evicted_pages_ (and block_token_ is non-null)
-    // else if block_token_ is non-null: evictable_disk_backed_pages_
+    // else if block_token_ is non-null: quota_->evictable_ if quota_ is non-null,
+    //     else evictable_protected_ if is_protected(), else evictable_probationary_
     // else: evictable_unbacked_pages_ (buf_ is non-null, block_token_ is null)
     //
     // So, when destroy_ptr_, waiters_, buf_, or block_token_ is touched, we might
@@ -1,11 +1,18 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "buffer_cache/alt/page_cache.hpp"
 
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <stack>
 
+#include "arch/io/io_utils.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/pmap.hpp"
 #include "do_on_thread.hpp"
 #include "serializer/serializer.hpp"
 #include "stl_utils.hpp"
@@ -49,33 +56,32 @@ void page_read_ahead_cb_t::offer_read_ahead_buf(
     assert_thread();
     scoped_malloc_t<ser_buffer_t> buf = std::move(*buf_ptr);
 
-    if (bytes_remaining_ == 0) {
-        return;
+    // Once the warm-up budget is used up, the serializer only reads ahead for
+    // sequential scans.  We keep taking those blocks; the page cache decides whether
+    // it has room for them.
+    if (bytes_remaining_ > 0) {
+        uint32_t size = token->block_size().ser_value();
+        bytes_remaining_ = bytes_remaining_ < size ? 0 : bytes_remaining_ - size;
     }
 
     // Notably, this code relies on do_on_thread to preserve callback order (which it
     // does do).
+    do_on_thread(page_cache_->home_thread(),
+                 std::bind(&page_cache_t::add_read_ahead_buf,
+                           page_cache_,
+                           block_id,
+                           buf.release(),
+                           token));
+}
 
-    uint32_t size = token->block_size().ser_value();
-    if (bytes_remaining_ < size) {
-        bytes_remaining_ = 0;
-    } else {
-        bytes_remaining_ -= size;
-        do_on_thread(page_cache_->home_thread(),
-                     std::bind(&page_cache_t::add_read_ahead_buf,
-                               page_cache_,
-                               block_id,
-                               buf.release(),
-                               token));
-    }
+bool page_read_ahead_cb_t::wants_warmup_read_ahead() const {
+    assert_thread();
+    return bytes_remaining_ > 0;
+}
 
-    if (bytes_remaining_ == 0) {
-        // We know bytes_remaining_ was just set to 0, so this is the only time we
-        // call destroy_read_ahead_cb.
-        do_on_thread(page_cache_->home_thread(),
-                     std::bind(&page_cache_t::have_read_ahead_cb_destroyed,
-                               page_cache_));
-    }
+void page_read_ahead_cb_t::stop_warmup() {
+    assert_thread();
+    bytes_remaining_ = 0;
 }
 
 void page_read_ahead_cb_t::destroy_self() {
@@ -106,7 +112,7 @@ void page_cache_t::add_read_ahead_buf(block_id_t block_id,
     scoped_malloc_t<ser_buffer_t> buf(buf_ptr);
 
     if (!evicter_.interested_in_read_ahead_block(token->block_size().ser_value())) {
-        have_read_ahead_cb_destroyed();
+        stop_read_ahead_warmup();
         return;
     }
 
@@ -132,6 +138,17 @@ void page_cache_t::have_read_ahead_cb_destroyed() {
     }
 }
 
+void page_cache_t::stop_read_ahead_warmup() {
+    assert_thread();
+
+    if (read_ahead_cb_ != NULL) {
+        // This gets to the read ahead cb before have_read_ahead_cb_destroyed() could
+        // tell it to destroy itself, because do_on_thread preserves callback order.
+        do_on_thread(read_ahead_cb_->home_thread(),
+                     std::bind(&page_read_ahead_cb_t::stop_warmup, read_ahead_cb_));
+    }
+}
+
 void page_cache_t::read_ahead_cb_is_destroyed() {
     assert_thread();
     read_ahead_cb_existence_.reset();
@@ -140,13 +157,15 @@ void page_cache_t::read_ahead_cb_is_destroyed() {
 
 page_cache_t::page_cache_t(serializer_t *serializer,
                            const page_cache_config_t &config,
-                           memory_tracker_t *tracker)
+                           memory_tracker_t *tracker,
+                           cache_balancer_t *balancer)
     : dynamic_config_(config),
       serializer_(serializer),
       free_list_(serializer),
-      evicter_(tracker, config.memory_limit),
+      evicter_(tracker, config.memory_limit, balancer),
       read_ahead_cb_(NULL),
-      drainer_(make_scoped<auto_drainer_t>()) {
+      drainer_(make_scoped<auto_drainer_t>()),
+      warmup_file_write_in_progress_(false) {
 
     const bool start_read_ahead = config.memory_limit > 0;
     if (start_read_ahead) {
@@ -160,7 +179,10 @@ page_cache_t::page_cache_t(serializer_t *serializer,
                                                       config.memory_limit);
         }
         default_reads_account_.init(serializer->home_thread(),
-                                    serializer->make_io_account(config.io_priority_reads));
+                                    serializer->make_io_account(
+                                        config.io_priority_reads,
+                                        UNLIMITED_OUTSTANDING_REQUESTS,
+                                        CACHE_READS_IO_LATENCY_TARGET_MS));
         writes_io_account_.init(serializer->make_io_account(config.io_priority_writes));
         index_write_sink_.init(new fifo_enforcer_sink_t);
         recencies_ = serializer->get_all_recencies();
@@ -170,9 +192,15 @@ page_cache_t::page_cache_t(serializer_t *serializer,
 page_cache_t::~page_cache_t() {
     assert_thread();
 
+    warmup_file_timer_.reset();
     have_read_ahead_cb_destroyed();
 
     drainer_.reset();
+    if (!warmup_file_path_.empty()) {
+        // This is the most up to date list we'll ever get, and the one the next
+        // page cache to use this file is going to read.
+        write_warmup_file();
+    }
     for (auto it = current_pages_.begin(); it != current_pages_.end(); ++it) {
         delete *it;
     }
@@ -189,6 +217,242 @@ page_cache_t::~page_cache_t() {
     }
 }
 
+// The warm-up file holds WARMUP_FILE_MAGIC followed by block ids, in native byte
+// order.  It's never moved between machines, so that's fine.
+static const uint64_t WARMUP_FILE_MAGIC = 0x3170756d72617752ULL;  // "Rwarmup1"
+
+static bool read_warmup_file_blocking(const std::string &filepath,
+                                      std::vector<block_id_t> *block_ids_out) {
+    std::string contents;
+    if (!blocking_read_file(filepath.c_str(), &contents)) {
+        return false;
+    }
+    if (contents.size() < sizeof(WARMUP_FILE_MAGIC)
+        || (contents.size() - sizeof(WARMUP_FILE_MAGIC)) % sizeof(block_id_t) != 0) {
+        return false;
+    }
+    uint64_t magic;
+    memcpy(&magic, contents.data(), sizeof(magic));
+    if (magic != WARMUP_FILE_MAGIC) {
+        return false;
+    }
+    block_ids_out->resize((contents.size() - sizeof(WARMUP_FILE_MAGIC))
+                          / sizeof(block_id_t));
+    if (!block_ids_out->empty()) {
+        memcpy(block_ids_out->data(), contents.data() + sizeof(WARMUP_FILE_MAGIC),
+               block_ids_out->size() * sizeof(block_id_t));
+    }
+    return true;
+}
+
+static void write_warmup_file_blocking(const std::string &filepath,
+                                       const std::vector<block_id_t> &block_ids) {
+    std::string contents(reinterpret_cast<const char *>(&WARMUP_FILE_MAGIC),
+                         sizeof(WARMUP_FILE_MAGIC));
+    contents.append(reinterpret_cast<const char *>(block_ids.data()),
+                    block_ids.size() * sizeof(block_id_t));
+
+    // We write a temporary file and rename it over the old one, so that a crash
+    // can't leave a torn list behind.
+    const std::string temporary_path = filepath + ".tmp";
+    scoped_fd_t fd;
+    {
+        int res;
+        do {
+            res = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        } while (res == -1 && get_errno() == EINTR);
+        if (res == -1) {
+            return;
+        }
+        fd.reset(res);
+    }
+
+    size_t written = 0;
+    while (written < contents.size()) {
+        ssize_t res;
+        do {
+            res = write(fd.get(), contents.data() + written, contents.size() - written);
+        } while (res == -1 && get_errno() == EINTR);
+        if (res == -1) {
+            fd.reset();
+            UNUSED int unlink_res = unlink(temporary_path.c_str());
+            return;
+        }
+        written += res;
+    }
+    fd.reset();
+
+    UNUSED int rename_res = rename(temporary_path.c_str(), filepath.c_str());
+}
+
+void page_cache_t::use_warmup_file(const std::string &filepath) {
+    assert_thread();
+    guarantee(!filepath.empty());
+    guarantee(warmup_file_path_.empty());
+    warmup_file_path_ = filepath;
+
+    if (dynamic_config_.memory_limit > 0) {
+        coro_t::spawn_sometime(std::bind(&page_cache_t::load_warmup_file,
+                                         this, drainer_->lock()));
+    }
+    warmup_file_timer_.init(new repeating_timer_t(CACHE_WARMUP_FILE_WRITE_INTERVAL_MS,
+                                                  this));
+}
+
+void page_cache_t::use_flash_cache(scoped_ptr_t<file_t> &&file, uint64_t size) {
+    assert_thread();
+    const uint32_t slot_size = max_block_size().ser_value();
+    if (size < slot_size) {
+        return;
+    }
+    evicter_.use_flash_cache(std::move(file), size, slot_size);
+}
+
+void page_cache_t::change_outside_memory(int64_t delta) {
+    assert_thread();
+    evicter_.change_outside_memory(delta);
+}
+
+void page_cache_t::on_ring() {
+    assert_thread();
+    if (!warmup_file_write_in_progress_) {
+        warmup_file_write_in_progress_ = true;
+        coro_t::spawn_sometime(std::bind(&page_cache_t::write_warmup_file_in_background,
+                                         this, drainer_->lock()));
+    }
+}
+
+std::vector<block_id_t> page_cache_t::hot_block_ids() const {
+    assert_thread();
+
+    // The loaded pages, by how long ago they were last accessed.  We compare access
+    // times relative to the counter, like the evicter does.
+    const uint64_t now = evicter_.access_time_counter();
+    std::vector<std::pair<uint64_t, block_id_t> > pages;
+    for (block_id_t block_id = 0; block_id < current_pages_.size(); ++block_id) {
+        current_page_t *current_page = current_pages_[block_id];
+        if (current_page == NULL || current_page->is_deleted()
+            || !current_page->page_.has()) {
+            continue;
+        }
+        page_t *page = current_page->page_.get_page_for_read();
+        if (page->buf_.has()) {
+            pages.push_back(std::make_pair(now - page->access_time_, block_id));
+        }
+    }
+    std::sort(pages.begin(), pages.end());
+
+    // There's no point in listing more than the cache will be able to hold.
+    std::vector<block_id_t> ret;
+    uint64_t total_size = 0;
+    for (auto it = pages.begin(); it != pages.end(); ++it) {
+        page_t *page = current_pages_[it->second]->page_.get_page_for_read();
+        total_size += page->ser_buf_size_;
+        if (total_size > evicter_.memory_limit()) {
+            break;
+        }
+        ret.push_back(it->second);
+    }
+    return ret;
+}
+
+void page_cache_t::write_warmup_file() {
+    assert_thread();
+    const std::vector<block_id_t> block_ids = hot_block_ids();
+    thread_pool_t::run_in_blocker_pool([&]() {
+        write_warmup_file_blocking(warmup_file_path_, block_ids);
+    });
+}
+
+void page_cache_t::write_warmup_file_in_background(auto_drainer_t::lock_t) {
+    write_warmup_file();
+    warmup_file_write_in_progress_ = false;
+}
+
+void page_cache_t::load_warmup_file(auto_drainer_t::lock_t lock) {
+    assert_thread();
+
+    std::vector<block_id_t> listed_block_ids;
+    bool read_ok;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        read_ok = read_warmup_file_blocking(warmup_file_path_, &listed_block_ids);
+    });
+    if (!read_ok) {
+        return;
+    }
+
+    // The list is sorted by access time, so if we can't load all of it, we load its
+    // front.  Blocks that are already in memory (or are being used) are left alone.
+    std::vector<block_id_t> block_ids;
+    uint64_t total_size = 0;
+    for (auto it = listed_block_ids.begin(); it != listed_block_ids.end(); ++it) {
+        if (total_size >= evicter_.memory_limit()) {
+            break;
+        }
+        if (*it < current_pages_.size() && current_pages_[*it] != NULL) {
+            continue;
+        }
+        block_ids.push_back(*it);
+        total_size += max_block_size().ser_value();
+    }
+
+    // We read the blocks in order of their offset on disk, a batch at a time, so
+    // that the serializer gets to do large sequential reads.
+    std::vector<std::pair<block_id_t, counted_t<standard_block_token_t> > > blocks;
+    {
+        on_thread_t th(serializer_->home_thread());
+        const block_id_t max_block_id = serializer_->max_block_id();
+        for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+            if (*it >= max_block_id) {
+                continue;
+            }
+            counted_t<standard_block_token_t> token = serializer_->index_read(*it);
+            if (token.has()) {
+                blocks.push_back(std::make_pair(*it, token));
+            }
+        }
+    }
+    std::sort(blocks.begin(), blocks.end(),
+              [](const std::pair<block_id_t, counted_t<standard_block_token_t> > &x,
+                 const std::pair<block_id_t, counted_t<standard_block_token_t> > &y) {
+                  return x.second->offset() < y.second->offset();
+              });
+
+    for (size_t i = 0; i < blocks.size(); i += CACHE_WARMUP_FILE_READ_BATCH_SIZE) {
+        if (lock.get_drain_signal()->is_pulsed()) {
+            return;
+        }
+        const size_t batch_size = std::min<size_t>(CACHE_WARMUP_FILE_READ_BATCH_SIZE,
+                                                   blocks.size() - i);
+        scoped_array_t<scoped_malloc_t<ser_buffer_t> > bufs(batch_size);
+        {
+            on_thread_t th(serializer_->home_thread());
+            pmap(batch_size, [&](int j) {
+                bufs[j] = serializer_->malloc();
+                serializer_->block_read(blocks[i + j].second, bufs[j].get(),
+                                        default_reads_account_.get());
+            });
+        }
+
+        for (size_t j = 0; j < batch_size; ++j) {
+            const block_id_t block_id = blocks[i + j].first;
+            const counted_t<standard_block_token_t> &token = blocks[i + j].second;
+            if (!evicter_.interested_in_read_ahead_block(
+                    token->block_size().ser_value())) {
+                return;
+            }
+
+            // Nobody could have changed the block since we looked its token up,
+            // because that would have given it a current_page_t.
+            resize_current_pages_to_id(block_id);
+            if (current_pages_[block_id] == NULL) {
+                current_pages_[block_id]
+                    = new current_page_t(std::move(bufs[j]), token, this);
+            }
+        }
+    }
+}
+
 // We go a bit old-school, with a self-destroying callback.
 class flush_and_destroy_txn_waiter_t : public signal_t::subscription_t {
 public:
@@ -244,6 +508,20 @@ void page_cache_t::flush_and_destroy_txn(
 }
 
 
+repli_timestamp_t page_cache_t::peek_recency(block_id_t block_id) {
+    assert_thread();
+
+    // The acquirers in line for the block have their recencies worked out already,
+    // but recencies_ only catches up when write-acquirers get their turn.
+    if (block_id < current_pages_.size() && current_pages_[block_id] != NULL) {
+        current_page_acq_t *back = current_pages_[block_id]->acquirers_.tail();
+        if (back != NULL) {
+            return back->recency();
+        }
+    }
+    return recency_for_block_id(block_id);
+}
+
 current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     assert_thread();
 
@@ -311,6 +589,12 @@ block_size_t page_cache_t::max_block_size() const {
 }
 
 cache_account_t page_cache_t::create_cache_account(int priority) {
+    return create_cache_account(priority, 0, 0);
+}
+
+cache_account_t page_cache_t::create_cache_account(int priority,
+                                                   uint64_t memory_reservation,
+                                                   uint64_t memory_limit) {
     // We assume that a priority of 100 means that the transaction should have the
     // same priority as all the non-accounted transactions together. Not sure if this
     // makes sense.
@@ -323,6 +607,9 @@ cache_account_t page_cache_t::create_cache_account(int priority) {
     // either.
     int outstanding_requests_limit = std::max(1, 16 * priority / 100);
 
+    counted_t<account_quota_t> quota
+        = evicter_.make_account_quota(memory_reservation, memory_limit);
+
     file_account_t *io_account;
     {
         // KSI: We shouldn't have to switch to the serializer home thread.
@@ -331,7 +618,7 @@ cache_account_t page_cache_t::create_cache_account(int priority) {
                                                   outstanding_requests_limit);
     }
 
-    return cache_account_t(serializer_->home_thread(), io_account);
+    return cache_account_t(serializer_->home_thread(), io_account, std::move(quota));
 }
 
 
@@ -432,6 +719,7 @@ current_page_acq_t::~current_page_acq_t() {
     assert_thread();
     // Checking page_cache_ != NULL makes sure this isn't a default-constructed acq.
     if (page_cache_ != NULL) {
+        optimistic_page_.reset();
         if (the_txn_ != NULL) {
             guarantee(access_ == access_t::write);
             the_txn_->remove_acquirer(this);
@@ -453,6 +741,7 @@ void current_page_acq_t::declare_readonly() {
 void current_page_acq_t::declare_snapshotted() {
     assert_thread();
     rassert(access_ == access_t::read);
+    rassert(!optimistic_page_.has());
 
     // Allow redeclaration of snapshottedness.
     if (!declared_snapshotted_) {
@@ -476,6 +765,9 @@ signal_t *current_page_acq_t::write_acq_signal() {
 page_t *current_page_acq_t::current_page_for_read(cache_account_t *account) {
     assert_thread();
     rassert(snapshotted_page_.has() || current_page_ != NULL);
+    if (optimistic_page_.has()) {
+        return optimistic_page_.get_page_for_read();
+    }
     read_cond_.wait();
     if (snapshotted_page_.has()) {
         return snapshotted_page_.get_page_for_read();
@@ -484,6 +776,41 @@ page_t *current_page_acq_t::current_page_for_read(cache_account_t *account) {
     return current_page_->the_page_for_read(help(), account);
 }
 
+bool current_page_acq_t::try_optimistic_read(cache_account_t *account) {
+    assert_thread();
+    rassert(access_ == access_t::read);
+    if (read_cond_.is_pulsed() || optimistic_page_.has()) {
+        return true;
+    }
+    if (declared_snapshotted_ || current_page_ == NULL
+        || !current_page_->can_read_optimistically(this)) {
+        return false;
+    }
+    optimistic_page_.init(current_page_->the_page_for_read(help(), account),
+                          page_cache_);
+    return true;
+}
+
+bool current_page_acq_t::has_optimistic_read() const {
+    assert_thread();
+    return optimistic_page_.has();
+}
+
+bool current_page_acq_t::optimistic_read_is_valid() {
+    assert_thread();
+    if (!optimistic_page_.has()) {
+        return true;
+    }
+    rassert(current_page_ != NULL);
+    return current_page_->is_current_version(optimistic_page_.get_page_for_read())
+        && current_page_->can_read_optimistically(this);
+}
+
+void current_page_acq_t::abandon_optimistic_read() {
+    assert_thread();
+    optimistic_page_.reset();
+}
+
 repli_timestamp_t current_page_acq_t::recency() const {
     assert_thread();
     return recency_;
@@ -747,6 +1074,31 @@ void current_page_t::mark_deleted(current_page_help_t help) {
     page_.reset();
 }
 
+bool current_page_t::can_read_optimistically(current_page_acq_t *acq) {
+    if (is_deleted_) {
+        return false;
+    }
+    // Once a write-acquirer modifies the page, the page won't be the value it had
+    // when the write-acquirer got in line (and it might be midway through a change
+    // that spans several blocks).  Write-acquirers that haven't touched the page yet
+    // will make a copy of it if they do, because we'll hold a reference to it.  We
+    // also can't pass a write-acquirer whose txn has acquired other blocks since,
+    // because it might be modifying (or deleting) this page's children.
+    for (current_page_acq_t *prev = acquirers_.prev(acq);
+         prev != NULL;
+         prev = acquirers_.prev(prev)) {
+        if (prev->access_ == access_t::write
+            && (prev->dirtied_page_ || prev->the_txn_->live_acqs_.back() != prev)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool current_page_t::is_current_version(page_t *page) const {
+    return page_.has() && page_.get_page_for_read() == page;
+}
+
 void current_page_t::convert_from_serializer_if_necessary(current_page_help_t help,
                                                           cache_account_t *account) {
     rassert(!is_deleted_);
@@ -994,6 +1346,38 @@ page_cache_t::compute_changes(const std::set<page_txn_t *> &txns) {
     return changes;
 }
 
+std::vector<page_cache_t::old_version_t>
+page_cache_t::compute_old_versions_to_spill(
+        const std::set<page_txn_t *> &txns,
+        const std::map<block_id_t, block_change_t> &changes) {
+    std::vector<old_version_t> old_versions;
+    for (auto it = txns.begin(); it != txns.end(); ++it) {
+        page_txn_t *txn = *it;
+        for (size_t i = 0, e = txn->snapshotted_dirtied_pages_.size(); i < e; ++i) {
+            const dirtied_page_t &d = txn->snapshotted_dirtied_pages_[i];
+            if (!d.ptr.has()) {
+                continue;
+            }
+            page_t *page = d.ptr.get_page_for_read();
+            auto jt = changes.find(d.block_id);
+            rassert(jt != changes.end());
+            if (jt->second.page == page) {
+                continue;
+            }
+            // Nobody but our txn refers to the page if it has only one snapshot
+            // reference, so it'll go away with the txn.  (Superseded versions can't
+            // be modified, because a newer version of the block exists.)
+            if (page->num_snapshot_references() > 1
+                && !page->block_token_.has()
+                && page->buf_.has()
+                && page->destroy_ptr_ == NULL) {
+                old_versions.push_back(old_version_t(d.block_id, page));
+            }
+        }
+    }
+    return old_versions;
+}
+
 std::set<page_txn_t *>
 page_cache_t::remove_txn_set_from_graph(page_cache_t *page_cache,
                                         const std::set<page_txn_t *> &txns) {
@@ -1076,6 +1460,7 @@ struct ancillary_info_t {
 
 void page_cache_t::do_flush_changes(page_cache_t *page_cache,
                                     const std::map<block_id_t, block_change_t> &changes,
+                                    const std::vector<old_version_t> &old_versions,
                                     fifo_enforcer_write_token_t index_write_token) {
     rassert(!changes.empty());
     std::vector<block_token_tstamp_t> blocks_by_tokens;
@@ -1084,7 +1469,7 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
     std::vector<ancillary_info_t> ancillary_infos;
     std::vector<buf_write_info_t> write_infos;
     ancillary_infos.reserve(changes.size());
-    write_infos.reserve(changes.size());
+    write_infos.reserve(changes.size() + old_versions.size());
 
     {
         ASSERT_NO_CORO_WAITING;
@@ -1139,8 +1524,18 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
                                                                 NULL));
             }
         }
+
+        // The old versions go at the end of write_infos, after the ones that get
+        // index writes.
+        for (auto it = old_versions.begin(); it != old_versions.end(); ++it) {
+            write_infos.push_back(buf_write_info_t(it->page->buf_.get(),
+                                                   block_size_t::unsafe_make(it->page->ser_buf_size_),
+                                                   it->block_id));
+        }
     }
 
+    std::vector<counted_t<standard_block_token_t> > old_version_tokens;
+
     {
         on_thread_t th(page_cache->serializer_->home_thread());
 
@@ -1156,8 +1551,11 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
                                                     &blocks_releasable_cb);
 
         rassert(tokens.size() == write_infos.size());
-        rassert(write_infos.size() == ancillary_infos.size());
-        for (size_t i = 0; i < write_infos.size(); ++i) {
+        rassert(write_infos.size() == ancillary_infos.size() + old_versions.size());
+        for (size_t i = ancillary_infos.size(); i < tokens.size(); ++i) {
+            old_version_tokens.push_back(std::move(tokens[i]));
+        }
+        for (size_t i = 0; i < ancillary_infos.size(); ++i) {
             blocks_by_tokens.push_back(block_token_tstamp_t(write_infos[i].block_id,
                                                             false,
                                                             std::move(tokens[i]),
@@ -1224,15 +1622,37 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
             page_cache->evicter().change_to_correct_eviction_bag(old_bag, it->page);
         }
     }
+
+    // The old versions can now be evicted like any other page that's on disk.
+    for (size_t i = 0; i < old_versions.size(); ++i) {
+        page_t *page = old_versions[i].page;
+        rassert(!page->block_token_.has());
+        eviction_bag_t *old_bag = page_cache->evicter().correct_eviction_category(page);
+        page->block_token_ = std::move(old_version_tokens[i]);
+        page_cache->evicter().change_to_correct_eviction_bag(old_bag, page);
+    }
+}
+
+void page_cache_t::do_flush_pending_txns(page_cache_t *page_cache,
+                                         auto_drainer_t::lock_t) {
+    page_cache->assert_thread();
+    // Txn sets that become flushable from here on go in the next batch, which gets
+    // its index write token after ours.
+    std::set<page_txn_t *> txns;
+    txns.swap(page_cache->pending_flush_txns_);
+    rassert(!txns.empty());
+
+    std::map<block_id_t, block_change_t> changes = compute_changes(txns);
+    do_flush_txn_set(page_cache, &changes, txns);
 }
 
 void page_cache_t::do_flush_txn_set(page_cache_t *page_cache,
                                     std::map<block_id_t, block_change_t> *changes_ptr,
                                     const std::set<page_txn_t *> &txns) {
-    // This is called with spawn_now_dangerously!  The reason is partly so that we
-    // don't put a zillion coroutines on the message loop when doing a bunch of
-    // reads.  The other reason is that passing changes through a std::bind without
-    // copying it would be very annoying.
+    // This is called by do_flush_pending_txns, which batches up the txn sets that
+    // become flushable at about the same time.  (Read-only txn sets never get here,
+    // so we don't put a zillion coroutines on the message loop when doing a bunch of
+    // reads.)
     page_cache->assert_thread();
 
     // We're going to flush these transactions.  First we need to figure out what the
@@ -1247,7 +1667,9 @@ void page_cache_t::do_flush_txn_set(page_cache_t *page_cache,
 
     // Okay, yield, thank you.
     coro_t::yield();
-    do_flush_changes(page_cache, changes, index_write_token);
+    const std::vector<old_version_t> old_versions
+        = compute_old_versions_to_spill(txns, changes);
+    do_flush_changes(page_cache, changes, old_versions, index_write_token);
 
     // Flush complete.
 
@@ -1338,14 +1760,23 @@ void page_cache_t::im_waiting_for_flush(std::set<page_txn_t *> queue) {
                 (*it)->spawned_flush_ = true;
             }
 
-            std::map<block_id_t, block_change_t> changes
-                = page_cache_t::compute_changes(flush_set);
+            bool has_changes = false;
+            for (auto it = flush_set.begin(); it != flush_set.end(); ++it) {
+                if ((*it)->snapshotted_dirtied_pages_.size() != 0
+                    || (*it)->touched_pages_.size() != 0) {
+                    has_changes = true;
+                    break;
+                }
+            }
 
-            if (!changes.empty()) {
-                coro_t::spawn_now_dangerously(std::bind(&page_cache_t::do_flush_txn_set,
-                                                        this,
-                                                        &changes,
-                                                        flush_set));
+            if (has_changes) {
+                const bool flush_already_pending = !pending_flush_txns_.empty();
+                pending_flush_txns_.insert(flush_set.begin(), flush_set.end());
+                if (!flush_already_pending) {
+                    coro_t::spawn_sometime(std::bind(&page_cache_t::do_flush_pending_txns,
+                                                     this,
+                                                     drainer_->lock()));
+                }
             } else {
                 // Flush complete.  do_flush_txn_set does this in the write case.
                 std::set<page_txn_t *> unblocked
@@ -3,10 +3,12 @@
 #define BUFFER_CACHE_ALT_PAGE_CACHE_HPP_
 
 #include <map>
+#include <string>
 #include <utility>
 #include <vector>
 #include <set>
 
+#include "arch/timing.hpp"
 #include "buffer_cache/alt/block_version.hpp"
 #include "buffer_cache/alt/cache_account.hpp"
 #include "buffer_cache/alt/config.hpp"
@@ -101,6 +103,12 @@ private:
 
     void mark_deleted(current_page_help_t help);
 
+    // Returns true if acq can read the page without waiting for the write-acquirers
+    // in front of it, because none of them has started modifying it.
+    bool can_read_optimistically(current_page_acq_t *acq);
+    // Returns true if page is the current version of the page.
+    bool is_current_version(page_t *page) const;
+
     // page_txn_t should not access our fields directly.
     friend class page_txn_t;
     // Returns the previous last modifier (or NULL, if there's no active
@@ -175,6 +183,26 @@ public:
     page_t *current_page_for_read(cache_account_t *account);
     page_t *current_page_for_write(cache_account_t *account);
 
+    // Optimistic reads let a read-acquirer that's queued behind write-acquirers read
+    // the page right away, as long as none of them has modified it yet.  The
+    // acquirer holds on to the version of the page it saw (the writers will modify a
+    // copy of it), and current_page_for_read returns that version until the
+    // optimistic read is abandoned.  The acquirer stays in line, so that it can
+    // abandon the optimistic read and wait for its turn if the read turns out to be
+    // stale.
+
+    // Returns true if the page can be read without waiting, either because we have
+    // been pulsed for read or because we got an optimistic read.  Never blocks.
+    // (You must be readonly and not snapshotted to get an optimistic read.)
+    bool try_optimistic_read(cache_account_t *account);
+    bool has_optimistic_read() const;
+    // Returns false if some write-acquirer in front of us has modified the page, or
+    // might be about to modify its children, since we got our optimistic read.
+    // Returns true if we don't have an optimistic read.
+    bool optimistic_read_is_valid();
+    // Forgets the optimistic read, so that current_page_for_read waits for our turn.
+    void abandon_optimistic_read();
+
     // Returns current_page_for_read, except it guarantees that the page acq has
     // already snapshotted the page and is not waiting for the page_t *.
     page_t *snapshotted_page_ptr();
@@ -224,6 +252,9 @@ private:
     // acquired page has been deleted, in which case both are null.
     current_page_t *current_page_;
     page_ptr_t snapshotted_page_;
+    // The version of the page we read optimistically, if we did.  Unlike
+    // snapshotted_page_, this can be set while we're still in the acquirers_ list.
+    page_ptr_t optimistic_page_;
     cond_t read_cond_;
     cond_t write_cond_;
 
@@ -255,6 +286,12 @@ public:
                               scoped_malloc_t<ser_buffer_t> *buf,
                               const counted_t<standard_block_token_t> &token);
 
+    bool wants_warmup_read_ahead() const;
+
+    // Makes the serializer stop reading ahead on every read.  It still reads ahead
+    // for sequential scans.
+    void stop_warmup();
+
     void destroy_self();
 
 private:
@@ -263,7 +300,7 @@ private:
     serializer_t *serializer_;
     page_cache_t *page_cache_;
 
-    // How many more bytes of data can we send?
+    // How many more bytes of warm-up read-ahead data can we send?
     uint64_t bytes_remaining_;
 
     DISABLE_COPYING(page_read_ahead_cb_t);
@@ -292,11 +329,14 @@ private:
     DISABLE_COPYING(tracker_acq_t);
 };
 
-class page_cache_t : public home_thread_mixin_t {
+class page_cache_t : public home_thread_mixin_t,
+                     private repeating_timer_callback_t {
 public:
+    // balancer may be NULL, in which case config.memory_limit stays fixed.
     page_cache_t(serializer_t *serializer,
                  const page_cache_config_t &config,
-                 memory_tracker_t *tracker);
+                 memory_tracker_t *tracker,
+                 cache_balancer_t *balancer);
     ~page_cache_t();
 
     // Takes a txn to be flushed.  Calls on_flush_complete() (which resets the
@@ -309,6 +349,12 @@ public:
     current_page_t *page_for_new_block_id(block_id_t *block_id_out);
     current_page_t *page_for_new_chosen_block_id(block_id_t block_id);
 
+    // Returns a recency at least as recent as what a read-acquirer of the block
+    // would see if it got in line now, without acquiring the block (which would
+    // start loading it).  Returns repli_timestamp_t::invalid if the block is
+    // deleted.
+    repli_timestamp_t peek_recency(block_id_t block_id);
+
     // Returns how much memory is being used by all the pages in the cache at this
     // moment in time.
     size_t total_page_memory() const;
@@ -316,12 +362,40 @@ public:
 
     block_size_t max_block_size() const;
 
+    uint64_t memory_limit() const { return dynamic_config_.memory_limit; }
+
     cache_account_t create_cache_account(int priority);
+    // The evictable pages last acquired through the account may use at most
+    // memory_limit bytes (zero means no limit), and the first memory_reservation
+    // bytes of them are only evicted when there's nothing else left to evict.
+    cache_account_t create_cache_account(int priority,
+                                         uint64_t memory_reservation,
+                                         uint64_t memory_limit);
 
     cache_account_t *default_reads_account() {
         return &default_reads_account_;
     }
 
+    // Makes the cache remember its hot blocks across restarts.  If filepath holds a
+    // block list written by an earlier page cache, we load those blocks in the
+    // background, in the order they're laid out on disk, for as long as there's
+    // room for them.  From then on we write the block ids of our loaded pages to
+    // filepath, most recently accessed first, every
+    // CACHE_WARMUP_FILE_WRITE_INTERVAL_MS and when the cache is destroyed.  The
+    // file is only a hint, so failing to read or write it is not an error.
+    void use_warmup_file(const std::string &filepath);
+
+    // Gives the cache a second level in file, which should be on a local SSD, of
+    // at most size bytes.  Evicted pages are written there in the background and
+    // read back from there instead of the serializer.  The file's old contents
+    // are ignored.  If size is less than a block, there's no flash cache.
+    void use_flash_cache(scoped_ptr_t<file_t> &&file, uint64_t size);
+
+    // Counts memory that's kept outside of the cache's pages against the memory
+    // limit (see evicter_t::change_outside_memory).  Whoever adds some has to take
+    // it back out before the cache is destroyed.
+    void change_outside_memory(int64_t delta);
+
 private:
     friend class page_read_ahead_cb_t;
     void add_read_ahead_buf(block_id_t block_id,
@@ -330,8 +404,16 @@ private:
 
     void have_read_ahead_cb_destroyed();
 
+    void stop_read_ahead_warmup();
+
     void read_ahead_cb_is_destroyed();
 
+    void on_ring();
+    std::vector<block_id_t> hot_block_ids() const;
+    void write_warmup_file();
+    void write_warmup_file_in_background(auto_drainer_t::lock_t lock);
+    void load_warmup_file(auto_drainer_t::lock_t lock);
+
 
     current_page_t *internal_page_for_new_chosen(block_id_t block_id);
 
@@ -355,13 +437,27 @@ private:
         repli_timestamp_t tstamp;
     };
 
+    // An old version of a block that some snapshot still holds, but that a flush
+    // won't write because a later change supersedes it.
+    struct old_version_t {
+        old_version_t(block_id_t _block_id, page_t *_page)
+            : block_id(_block_id), page(_page) { }
+        block_id_t block_id;
+        // The page_t's lifetime is kept by some page_txn_t's
+        // snapshotted_dirtied_pages_ field.
+        page_t *page;
+    };
+
     friend class page_txn_t;
     static void do_flush_changes(page_cache_t *page_cache,
                                  const std::map<block_id_t, block_change_t> &changes,
+                                 const std::vector<old_version_t> &old_versions,
                                  fifo_enforcer_write_token_t index_write_token);
     static void do_flush_txn_set(page_cache_t *page_cache,
                                  std::map<block_id_t, block_change_t> *changes_ptr,
                                  const std::set<page_txn_t *> &txns);
+    static void do_flush_pending_txns(page_cache_t *page_cache,
+                                      auto_drainer_t::lock_t lock);
 
     // Returns the set of page_txn_t's that have been unblocked.  The caller must
     // call im_waiting_for_flush on them (or somehow replicate its behavior).
@@ -372,6 +468,15 @@ private:
     static std::map<block_id_t, block_change_t>
     compute_changes(const std::set<page_txn_t *> &txns);
 
+    // Returns the superseded versions of blocks in changes that are still held by
+    // snapshots and have never been written.  Without a block token they could
+    // never be evicted, so we write them out to the serializer (without an index
+    // write) along with the flush.  The snapshots then hold on to disk space
+    // instead of memory.
+    static std::vector<old_version_t>
+    compute_old_versions_to_spill(const std::set<page_txn_t *> &txns,
+                                  const std::map<block_id_t, block_change_t> &changes);
+
     bool exists_flushable_txn_set(page_txn_t *txn,
                                   std::set<page_txn_t *> *flush_set_out);
 
@@ -417,6 +522,13 @@ private:
     fifo_enforcer_source_t index_write_source_;
     scoped_ptr_t<fifo_enforcer_sink_t> index_write_sink_;
 
+    // Txns (with changes) that are ready to flush, but whose flush hasn't started
+    // yet.  Txn sets that become flushable before do_flush_pending_txns gets to run
+    // are flushed together, so that many small txns make for fewer, larger
+    // serializer writes and index writes.  Separate flushes still overlap their
+    // block writes; only their index writes are ordered.
+    std::set<page_txn_t *> pending_flush_txns_;
+
     serializer_t *serializer_;
     segmented_vector_t<repli_timestamp_t> recencies_;
 
@@ -437,6 +549,11 @@ private:
 
     scoped_ptr_t<auto_drainer_t> drainer_;
 
+    // The warm-up file, or empty if we don't have one.  See use_warmup_file.
+    std::string warmup_file_path_;
+    bool warmup_file_write_in_progress_;
+    scoped_ptr_t<repeating_timer_t> warmup_file_timer_;
+
     DISABLE_COPYING(page_cache_t);
 };
 
@@ -6,5 +6,15 @@
 alt_cache_stats_t::alt_cache_stats_t(perfmon_collection_t *parent)
     : cache_collection(),
       cache_membership(parent, &cache_collection, "cache"),
-      cache_collection_membership(&cache_collection) { }
+      cache_collection_membership(&cache_collection,
+                                  &pm_probationary_hits, "probationary_hits",
+                                  &pm_protected_hits, "protected_hits",
+                                  &pm_misses, "misses",
+                                  &pm_cold_tier_misses, "cold_tier_misses",
+                                  &pm_flash_cache_hits, "flash_cache_hits",
+                                  &pm_flash_cache_writes, "flash_cache_writes",
+                                  &pm_flash_cache_dropped_writes,
+                                  "flash_cache_dropped_writes",
+                                  &pm_evictions, "evictions",
+                                  &pm_evicted_bytes, "evicted_bytes") { }
 
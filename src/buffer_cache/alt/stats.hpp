@@ -11,9 +11,22 @@ public:
     perfmon_collection_t cache_collection;
     perfmon_membership_t cache_membership;
 
-    /*
-      LSI: insert perfmons here
-    */
+    // Page acquisitions served by each segment of the evicter, and those that had
+    // to go to disk.  Their ratios tell how well the cache resists scans.
+    perfmon_counter_t pm_probationary_hits;
+    perfmon_counter_t pm_protected_hits;
+    perfmon_counter_t pm_misses;
+    // The misses that were loaded from the serializer's cold tier.  The other ones
+    // tell how much the hot tier is read from.
+    perfmon_counter_t pm_cold_tier_misses;
+    // The misses that were read from the flash cache instead of the serializer, the
+    // evicted pages written to it, and those it was too busy to take.
+    perfmon_counter_t pm_flash_cache_hits;
+    perfmon_counter_t pm_flash_cache_writes;
+    perfmon_counter_t pm_flash_cache_dropped_writes;
+    // Pages the evicter dropped from memory, and their size.
+    perfmon_counter_t pm_evictions;
+    perfmon_counter_t pm_evicted_bytes;
 
     perfmon_multi_membership_t cache_collection_membership;
 };
@@ -5,7 +5,7 @@
 # We assemble path directives.
 LDFLAGS ?=
 CXXFLAGS ?=
-RT_LDFLAGS := $(LDFLAGS) $(RE2_LIBS) $(TERMCAP_LIBS) $(Z_LIBS)
+RT_LDFLAGS := $(LDFLAGS) $(RE2_LIBS) $(TERMCAP_LIBS) $(Z_LIBS) $(SSL_LIBS) $(CRYPTO_LIBS)
 RT_LDFLAGS += $(V8_LIBS) $(PROTOBUF_LIBS) $(TCMALLOC_MINIMAL_LIBS) $(PTHREAD_LIBS)
 RT_CXXFLAGS := $(CXXFLAGS) $(RE2_INCLUDE) $(V8_INCLUDE) $(PROTOBUF_INCLUDE)
 
@@ -159,6 +159,11 @@ ifeq ($(RQL_ERROR_BT),1)
   RT_CXXFLAGS+=-DRQL_ERROR_BT
 endif
 
+ifeq ($(PERF),1)
+  SYMBOLS := 1
+  NO_OMIT_FRAME_POINTER := 1
+endif
+
 # Configure debug vs. release
 ifeq ($(DEBUG),1)
   SYMBOLS := 1
@@ -308,6 +313,11 @@ unit: $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME)
 	$P RUN $(SERVER_UNIT_TEST_NAME)
 	$(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME) --gtest_filter=$(UNIT_TEST_FILTER)
 
+.PHONY: microbench
+microbench: $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME)
+	$P RUN $(SERVER_UNIT_TEST_NAME) microbenchmarks
+	$(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME) --gtest_also_run_disabled_tests --gtest_filter='Microbench.DISABLED_$(MICROBENCH_FILTER)'
+
 .PRECIOUS: $(PROTO_DIR)/. $(QL2_PROTO_HEADERS) $(QL2_PROTO_CODE)
 
 $(PROTO_DIR)/%.pb.h $(PROTO_DIR)/%.pb.cc: $(SOURCE_DIR)/%.proto $(PROTOC_BIN_DEP) | $(PROTO_DIR)/.
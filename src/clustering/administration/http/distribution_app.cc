@@ -3,6 +3,8 @@
 #include <boost/variant.hpp>
 
 #include "clustering/administration/http/distribution_app.hpp"
+#include "clustering/generic/nonoverlapping_regions.hpp"
+#include "clustering/suggester/shard_suggester.hpp"
 #include "containers/uuid.hpp"
 #include "memcached/protocol.hpp"
 #include "memcached/protocol_json_adapter.hpp"
@@ -12,6 +14,24 @@
 #define DEFAULT_DEPTH 1
 #define MAX_DEPTH 2
 #define DEFAULT_LIMIT 128
+#define MAX_SAMPLES 4096
+
+/* Adds to `data` the changes to the table's split points that would even out
+`load` across its shards.  Nothing is suggested while the shards are in
+conflict. */
+template <class protocol_t>
+void add_shard_suggestion(const deletable_t<namespace_semilattice_metadata_t<protocol_t> > &ns,
+                          const std::map<store_key_t, int64_t> &load,
+                          scoped_cJSON_t *data) {
+    shard_suggestion_t suggestion;
+    if (!ns.is_deleted() && !ns.get_ref().shards.in_conflict()) {
+        suggestion = suggest_shard_changes<protocol_t>(ns.get_ref().shards.get(), load);
+    }
+    data->AddItemToObject("split_points_to_add",
+                          render_as_json(&suggestion.split_points_to_add));
+    data->AddItemToObject("split_points_to_remove",
+                          render_as_json(&suggestion.split_points_to_remove));
+}
 
 distribution_app_t::distribution_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<memcached_protocol_t> > > > _namespaces_sl_metadata,
                                        namespace_repo_t<memcached_protocol_t> *_ns_repo,
@@ -60,6 +80,24 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
         }
     }
 
+    // With "samples", rethinkdb tables build their distribution from that many
+    // random descents to the btrees' leaves, and estimate byte counts as well.
+    uint64_t samples = 0;
+    boost::optional<std::string> maybe_samples = req.find_query_param("samples");
+
+    if (maybe_samples) {
+        if (!strtou64_strict(maybe_samples.get(), 10, &samples) || samples == 0
+            || samples > MAX_SAMPLES) {
+            *result = http_error_res("Invalid samples value.");
+            return;
+        }
+    }
+
+    // With "suggest_shards", the result also says which split points to add and
+    // remove to even out the key counts (or byte counts, with "samples") across
+    // the table's shards.
+    bool suggest_shards = static_cast<bool>(req.find_query_param("suggest_shards"));
+
     if (std_contains(ns_snapshot->namespaces, n_id)) {
         try {
             namespace_repo_t<memcached_protocol_t>::access_t ns_access(ns_repo, n_id, interruptor);
@@ -70,8 +108,19 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
                                                         &db_res,
                                                         interruptor);
 
-            scoped_cJSON_t data(render_as_json(&boost::get<distribution_result_t>(db_res.result).key_counts));
-            http_json_res(data.get(), result);
+            std::map<store_key_t, int64_t> *key_counts
+                = &boost::get<distribution_result_t>(db_res.result).key_counts;
+            if (!suggest_shards) {
+                scoped_cJSON_t data(render_as_json(key_counts));
+                http_json_res(data.get(), result);
+            } else {
+                scoped_cJSON_t data(cJSON_CreateObject());
+                data.AddItemToObject("key_counts", render_as_json(key_counts));
+                add_shard_suggestion<memcached_protocol_t>(
+                    ns_snapshot->namespaces.find(n_id)->second,
+                    *key_counts, &data);
+                http_json_res(data.get(), result);
+            }
         } catch (const cannot_perform_query_exc_t &) {
             *result = http_res_t(HTTP_INTERNAL_SERVER_ERROR);
         }
@@ -79,15 +128,32 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
         try {
             namespace_repo_t<rdb_protocol_t>::access_t rdb_ns_access(rdb_ns_repo, n_id, interruptor);
 
-            rdb_protocol_t::distribution_read_t inner_read(depth, limit);
+            rdb_protocol_t::distribution_read_t inner_read(depth, limit, samples);
             rdb_protocol_t::read_t read(inner_read, profile_bool_t::DONT_PROFILE);
             rdb_protocol_t::read_response_t db_res;
             rdb_ns_access.get_namespace_if()->read_outdated(read,
                                                             &db_res,
                                                             interruptor);
 
-            scoped_cJSON_t data(render_as_json(&boost::get<rdb_protocol_t::distribution_read_response_t>(db_res.response).key_counts));
-            http_json_res(data.get(), result);
+            rdb_protocol_t::distribution_read_response_t *dist
+                = &boost::get<rdb_protocol_t::distribution_read_response_t>(db_res.response);
+            if (samples == 0 && !suggest_shards) {
+                scoped_cJSON_t data(render_as_json(&dist->key_counts));
+                http_json_res(data.get(), result);
+            } else {
+                scoped_cJSON_t data(cJSON_CreateObject());
+                data.AddItemToObject("key_counts", render_as_json(&dist->key_counts));
+                if (samples != 0) {
+                    data.AddItemToObject("byte_counts", render_as_json(&dist->byte_counts));
+                }
+                if (suggest_shards) {
+                    add_shard_suggestion<rdb_protocol_t>(
+                        rdb_ns_snapshot->namespaces.find(n_id)->second,
+                        samples != 0 ? dist->byte_counts : dist->key_counts,
+                        &data);
+                }
+                http_json_res(data.get(), result);
+            }
         } catch (const cannot_perform_query_exc_t &) {
             *result = http_res_t(HTTP_INTERNAL_SERVER_ERROR);
         }
@@ -3,8 +3,45 @@
 
 #include "arch/timing.hpp"
 #include "clustering/administration/machine_id_to_peer_id.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/wait_any.hpp"
+#include "http/json.hpp"
 #include "utils.hpp"
 
+/* Writes the response's JSON object a member at a time, as each server's log
+arrives, so the whole response is never in memory at once. */
+class log_object_writer_t {
+public:
+    explicit log_object_writer_t(http_body_writer_t *_writer)
+        : writer(_writer), first(true) {
+        writer->write("{");
+    }
+
+    void add(const std::string &key, cJSON *value) {
+        scoped_cJSON_t json(value);
+        std::string member = strprintf("\"%s\": ", key.c_str());
+        member += cJSON_default_print(json.get());
+        mutex_t::acq_t acq(&mutex);
+        if (!first) {
+            writer->write(", ");
+        }
+        first = false;
+        writer->write(member);
+    }
+
+    void finish() {
+        writer->write("}");
+    }
+
+private:
+    http_body_writer_t *writer;
+    // Keeps the servers' members from interleaving.
+    mutex_t mutex;
+    bool first;
+
+    DISABLE_COPYING(log_object_writer_t);
+};
+
 cJSON *render_as_json(log_message_t *message) {
     std::string timestamp_buffer = strprintf("%ld.%09ld", message->timestamp.tv_sec, message->timestamp.tv_nsec);
     scoped_cJSON_t json(cJSON_CreateObject());
@@ -119,39 +156,48 @@ void log_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
         peer_ids.push_back(pid);
     }
 
-    scoped_cJSON_t map_to_fill(cJSON_CreateObject());
-
-    pmap(peer_ids.size(), boost::bind(
-        &log_http_app_t::fetch_logs, this, _1,
-        machine_ids, peer_ids,
-        max_length, min_timestamp, max_timestamp,
-        map_to_fill.get(),
-        interruptor));
-
-    http_json_res(map_to_fill.get(), result);
+    result->code = HTTP_OK;
+    result->set_body_writer("application/json",
+        [this, machine_ids, peer_ids, max_length, min_timestamp, max_timestamp,
+         interruptor](http_body_writer_t *writer, signal_t *writer_interruptor) {
+            // Stop fetching if the server shuts down, not just if the client goes.
+            wait_any_t combined_interruptor(interruptor, writer_interruptor);
+            log_object_writer_t object_writer(writer);
+            pmap(peer_ids.size(), boost::bind(
+                &log_http_app_t::fetch_logs, this, _1,
+                machine_ids, peer_ids,
+                max_length, min_timestamp, max_timestamp,
+                &object_writer,
+                &combined_interruptor));
+            if (combined_interruptor.is_pulsed()) {
+                throw interrupted_exc_t();
+            }
+            object_writer.finish();
+        });
 }
 
 void log_http_app_t::fetch_logs(int i,
         const std::vector<machine_id_t> &machines, const std::vector<peer_id_t> &peers,
         int max_messages, struct timespec min_timestamp, struct timespec max_timestamp,
-        cJSON *map_to_fill,
+        log_object_writer_t *object_writer,
         signal_t *interruptor) THROWS_NOTHING {
     std::map<peer_id_t, log_server_business_card_t> bcards = log_mailbox_view->get();
     std::string key = uuid_to_str(machines[i]);
     if (bcards.count(peers[i]) == 0) {
-        cJSON_AddItemToObject(map_to_fill, key.c_str(), cJSON_CreateString("lost contact with peer while fetching log"));
+        object_writer->add(key, cJSON_CreateString("lost contact with peer while fetching log"));
+        return;
     }
     try {
         std::vector<log_message_t> messages = fetch_log_file(
             mailbox_manager, bcards[peers[i]],
             max_messages, min_timestamp, max_timestamp,
             interruptor);
-        cJSON_AddItemToObject(map_to_fill, key.c_str(), render_as_json(&messages));
+        object_writer->add(key, render_as_json(&messages));
     } catch (const interrupted_exc_t &) {
         /* ignore */
     } catch (const std::runtime_error &e) {
-        cJSON_AddItemToObject(map_to_fill, key.c_str(), cJSON_CreateString(e.what()));
+        object_writer->add(key, cJSON_CreateString(e.what()));
     } catch (const resource_lost_exc_t &) {
-        cJSON_AddItemToObject(map_to_fill, key.c_str(), cJSON_CreateString("lost contact with peer while fetching log"));
+        object_writer->add(key, cJSON_CreateString("lost contact with peer while fetching log"));
     }
 }
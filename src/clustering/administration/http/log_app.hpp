@@ -9,6 +9,8 @@
 #include "clustering/administration/machine_metadata.hpp"
 #include "http/http.hpp"
 
+class log_object_writer_t;
+
 class log_http_app_t : public http_app_t {
 public:
     log_http_app_t(
@@ -22,7 +24,7 @@ private:
     void fetch_logs(int i,
             const std::vector<machine_id_t> &machines, const std::vector<peer_id_t> &peers,
             int max_messages, struct timespec min_timestamp, struct timespec max_timestamp,
-            cJSON *map_to_fill,
+            log_object_writer_t *object_writer,
             signal_t *interruptor) THROWS_NOTHING;
 
     mailbox_manager_t *mailbox_manager;
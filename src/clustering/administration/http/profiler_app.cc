@@ -0,0 +1,96 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/profiler_app.hpp"
+
+#include <map>
+#include <string>
+
+#include "arch/runtime/sampling_profiler.hpp"
+#include "http/json.hpp"
+
+static cJSON *render_histogram(const sampling_profiler_t::histogram_t &histogram) {
+    scoped_cJSON_t json(cJSON_CreateObject());
+    json.AddItemToObject("count", cJSON_CreateNumber(histogram.count));
+    json.AddItemToObject("total_us", cJSON_CreateNumber(histogram.total / THOUSAND));
+    // Bucket `i` counts the samples that took less than 2^i microseconds (and
+    // more than the bucket before it).
+    scoped_cJSON_t buckets(cJSON_CreateArray());
+    for (size_t i = 0; i < histogram.buckets.size(); ++i) {
+        buckets.AddItemToArray(cJSON_CreateNumber(histogram.buckets[i]));
+    }
+    json.AddItemToObject("buckets", buckets.release());
+    return json.release();
+}
+
+static cJSON *render_histograms(const sampling_profiler_t::report_t &report) {
+    std::map<void *, std::string> frame_descriptions;
+    scoped_cJSON_t json(cJSON_CreateArray());
+    for (auto it = report.begin(); it != report.end(); ++it) {
+        scoped_cJSON_t point(cJSON_CreateObject());
+        scoped_cJSON_t trace(cJSON_CreateArray());
+        // Outermost frame first, like in the folded stacks.
+        for (auto frame = it->first.rbegin(); frame != it->first.rend(); ++frame) {
+            auto description = frame_descriptions.find(*frame);
+            if (description == frame_descriptions.end()) {
+                description = frame_descriptions.insert(
+                    std::make_pair(*frame, describe_trace_frame(*frame))).first;
+            }
+            trace.AddItemToArray(cJSON_CreateString(description->second.c_str()));
+        }
+        point.AddItemToObject("trace", trace.release());
+        point.AddItemToObject("run_time", render_histogram(it->second.run_time));
+        point.AddItemToObject("wait_time", render_histogram(it->second.wait_time));
+        json.AddItemToArray(point.release());
+    }
+    return json.release();
+}
+
+void profiler_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *) {
+    sampling_profiler_t *profiler = &sampling_profiler_t::get_global_profiler();
+
+    http_req_t::resource_t::iterator it = req.resource.begin();
+    if (it == req.resource.end()) {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        scoped_cJSON_t json(cJSON_CreateObject());
+        json.AddItemToObject("enabled", cJSON_CreateBool(profiler->is_enabled()));
+        http_json_res(json.get(), result);
+        return;
+    }
+    std::string command = *it;
+    ++it;
+    if (it != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+
+    if (command == "enable" || command == "disable" || command == "reset") {
+        if (req.method != POST) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        if (command == "reset") {
+            profiler->reset();
+        } else {
+            profiler->set_enabled(command == "enable");
+        }
+        *result = http_res_t(HTTP_OK);
+    } else if (command == "run_time" || command == "wait_time" || command == "histograms") {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        sampling_profiler_t::report_t report;
+        profiler->get_report(&report);
+        if (command == "histograms") {
+            scoped_cJSON_t json(render_histograms(report));
+            http_json_res(json.get(), result);
+        } else {
+            *result = http_res_t(HTTP_OK, "text/plain",
+                                 format_folded_stacks(report, command == "wait_time"));
+        }
+    } else {
+        *result = http_res_t(HTTP_NOT_FOUND);
+    }
+}
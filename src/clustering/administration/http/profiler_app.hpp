@@ -0,0 +1,30 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_PROFILER_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_PROFILER_APP_HPP_
+
+#include "http/http.hpp"
+
+/* Controls this server's `sampling_profiler_t` and serves what it recorded:
+
+    GET  /                 {"enabled": <bool>}
+    POST /enable           starts sampling
+    POST /disable          stops sampling
+    POST /reset            forgets everything recorded so far
+    GET  /run_time         folded stacks of the time coroutines ran before they
+                           yielded at each execution point, in microseconds
+    GET  /wait_time        the same for the time they waited there
+    GET  /histograms       the run and wait time histograms of each execution
+                           point, as JSON
+
+The folded stacks can be fed straight into flame graph tools. */
+class profiler_http_app_t : public http_app_t {
+public:
+    profiler_http_app_t() { }
+
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    DISABLE_COPYING(profiler_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_PROFILER_APP_HPP_ */
@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/query_capture_app.hpp"
+
+#include <string>
+
+#include "http/json.hpp"
+#include "rdb_protocol/query_capture.hpp"
+
+static cJSON *render_status(const query_capture_t::status_t &status) {
+    scoped_cJSON_t json(cJSON_CreateObject());
+    json.AddItemToObject("active", cJSON_CreateBool(status.active));
+    json.AddItemToObject("file", cJSON_CreateString(status.settings.file_name.c_str()));
+    json.AddItemToObject("sample_period", cJSON_CreateNumber(status.settings.sample_period));
+    json.AddItemToObject("max_bytes", cJSON_CreateNumber(status.settings.max_bytes));
+    json.AddItemToObject("connections", cJSON_CreateNumber(status.connections));
+    json.AddItemToObject("queries", cJSON_CreateNumber(status.queries));
+    json.AddItemToObject("bytes", cJSON_CreateNumber(status.bytes));
+    json.AddItemToObject("dropped", cJSON_CreateNumber(status.dropped));
+    if (!status.error.empty()) {
+        json.AddItemToObject("error", cJSON_CreateString(status.error.c_str()));
+    }
+    return json.release();
+}
+
+// Reads the query parameter `name` into `*out` if it's there.  Returns false if
+// it's there but isn't a number.
+static bool find_int_param(const http_req_t &req, const std::string &name,
+                           int64_t *out) {
+    boost::optional<std::string> value = req.find_query_param(name);
+    return !value || strtoi64_strict(*value, 10, out);
+}
+
+void query_capture_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                      signal_t *) {
+    query_capture_t *capture = &query_capture_t::get_global_capture();
+
+    http_req_t::resource_t::iterator it = req.resource.begin();
+    if (it == req.resource.end()) {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        scoped_cJSON_t json(render_status(capture->get_status()));
+        http_json_res(json.get(), result);
+        return;
+    }
+    std::string command = *it;
+    ++it;
+    if (it != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+    if (req.method != POST) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+
+    if (command == "start") {
+        query_capture_t::settings_t settings;
+        boost::optional<std::string> file = req.find_query_param("file");
+        if (!file
+            || !find_int_param(req, "sample_period", &settings.sample_period)
+            || !find_int_param(req, "max_bytes", &settings.max_bytes)) {
+            *result = http_res_t(HTTP_BAD_REQUEST);
+            return;
+        }
+        settings.file_name = *file;
+        std::string error;
+        if (!capture->start(settings, &error)) {
+            *result = http_res_t(HTTP_BAD_REQUEST, "text/plain", error);
+            return;
+        }
+        *result = http_res_t(HTTP_OK);
+    } else if (command == "stop") {
+        capture->stop();
+        *result = http_res_t(HTTP_OK);
+    } else {
+        *result = http_res_t(HTTP_NOT_FOUND);
+    }
+}
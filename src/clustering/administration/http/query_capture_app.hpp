@@ -0,0 +1,28 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_QUERY_CAPTURE_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_QUERY_CAPTURE_APP_HPP_
+
+#include "http/http.hpp"
+
+/* Controls this server's `query_capture_t`:
+
+    GET  /                 {"active": ..., "file": ..., "sample_period": ...,
+                           "max_bytes": ..., "connections": ..., "queries": ...,
+                           "bytes": ..., "dropped": ..., "error": ...}
+    POST /start            starts capturing to the file in the data directory
+                           named by the query parameter `file`, optionally with
+                           `sample_period` and `max_bytes`
+    POST /stop             stops capturing and closes the file
+
+A failed start answers 400 with the reason as the body. */
+class query_capture_http_app_t : public http_app_t {
+public:
+    query_capture_http_app_t() { }
+
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    DISABLE_COPYING(query_capture_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_QUERY_CAPTURE_APP_HPP_ */
@@ -7,8 +7,11 @@
 #include "clustering/administration/http/issues_app.hpp"
 #include "clustering/administration/http/last_seen_app.hpp"
 #include "clustering/administration/http/log_app.hpp"
+#include "clustering/administration/http/profiler_app.hpp"
 #include "clustering/administration/http/progress_app.hpp"
+#include "clustering/administration/http/query_capture_app.hpp"
 #include "clustering/administration/http/semilattice_app.hpp"
+#include "clustering/administration/http/slow_query_log_app.hpp"
 #include "clustering/administration/http/stat_app.hpp"
 #include "clustering/administration/http/combining_app.hpp"
 #include "http/file_app.hpp"
@@ -231,11 +234,15 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     directory_app.init(new directory_http_app_t(_directory_metadata));
     issues_app.init(new issues_http_app_t(&_admin_tracker->issue_aggregator));
     stat_app.init(new stat_http_app_t(mbox_manager, _directory_metadata, _semilattice_metadata));
+    stat_exposition_app.init(new stat_exposition_http_app_t(mbox_manager, _directory_metadata));
     last_seen_app.init(new last_seen_http_app_t(&_admin_tracker->last_seen_tracker));
     log_app.init(new log_http_app_t(mbox_manager,
         _directory_metadata->subview(&get_log_mailbox),
         _directory_metadata->subview(&get_machine_id)));
     progress_app.init(new progress_app_t(_directory_metadata, mbox_manager));
+    profiler_app.init(new profiler_http_app_t);
+    slow_query_log_app.init(new slow_query_log_http_app_t);
+    query_capture_app.init(new query_capture_http_app_t);
     distribution_app.init(new distribution_app_t(metadata_field(&cluster_semilattice_metadata_t::memcached_namespaces, _semilattice_metadata), _namespace_repo,
                                                  metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _semilattice_metadata), _rdb_namespace_repo));
 
@@ -247,9 +254,13 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     ajax_routes["directory"] = directory_app.get();
     ajax_routes["issues"] = issues_app.get();
     ajax_routes["stat"] = stat_app.get();
+    ajax_routes["metrics"] = stat_exposition_app.get();
     ajax_routes["last_seen"] = last_seen_app.get();
     ajax_routes["log"] = log_app.get();
     ajax_routes["progress"] = progress_app.get();
+    ajax_routes["profiler"] = profiler_app.get();
+    ajax_routes["slow_query_log"] = slow_query_log_app.get();
+    ajax_routes["query_capture"] = query_capture_app.get();
     ajax_routes["distribution"] = distribution_app.get();
     ajax_routes["semilattice"] = cluster_semilattice_app.get();
     ajax_routes["auth"] = auth_semilattice_app.get();
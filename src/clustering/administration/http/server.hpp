@@ -22,9 +22,13 @@ class auth_semilattice_http_app_t;
 class directory_http_app_t;
 class issues_http_app_t;
 class stat_http_app_t;
+class stat_exposition_http_app_t;
 class last_seen_http_app_t;
 class log_http_app_t;
 class progress_app_t;
+class profiler_http_app_t;
+class slow_query_log_http_app_t;
+class query_capture_http_app_t;
 class stat_manager_t;
 class distribution_app_t;
 class cyanide_http_app_t;
@@ -58,9 +62,13 @@ private:
     scoped_ptr_t<directory_http_app_t> directory_app;
     scoped_ptr_t<issues_http_app_t> issues_app;
     scoped_ptr_t<stat_http_app_t> stat_app;
+    scoped_ptr_t<stat_exposition_http_app_t> stat_exposition_app;
     scoped_ptr_t<last_seen_http_app_t> last_seen_app;
     scoped_ptr_t<log_http_app_t> log_app;
     scoped_ptr_t<progress_app_t> progress_app;
+    scoped_ptr_t<profiler_http_app_t> profiler_app;
+    scoped_ptr_t<slow_query_log_http_app_t> slow_query_log_app;
+    scoped_ptr_t<query_capture_http_app_t> query_capture_app;
     scoped_ptr_t<distribution_app_t> distribution_app;
     scoped_ptr_t<combining_http_app_t> combining_app;
 #ifndef NDEBUG
@@ -0,0 +1,97 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/slow_query_log_app.hpp"
+
+#include <deque>
+#include <string>
+
+#include "http/json.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
+
+static cJSON *render_thresholds(const slow_query_log_t::thresholds_t &thresholds) {
+    scoped_cJSON_t json(cJSON_CreateObject());
+    json.AddItemToObject("duration_ms", cJSON_CreateNumber(thresholds.duration_ms));
+    json.AddItemToObject("rows_read", cJSON_CreateNumber(thresholds.rows_read));
+    json.AddItemToObject("sample_period", cJSON_CreateNumber(thresholds.sample_period));
+    return json.release();
+}
+
+static cJSON *render_entry(const slow_query_log_t::entry_t &entry) {
+    scoped_cJSON_t json(cJSON_CreateObject());
+    std::string timestamp = strprintf("%ld.%09ld", entry.time.tv_sec, entry.time.tv_nsec);
+    json.AddItemToObject("timestamp", cJSON_CreateString(timestamp.c_str()));
+    json.AddItemToObject("shape", cJSON_CreateString(entry.shape.c_str()));
+    json.AddItemToObject("duration_ms", cJSON_CreateNumber(entry.duration_ms));
+    json.AddItemToObject("rows_returned", cJSON_CreateNumber(entry.rows_returned));
+    if (entry.rows_read >= 0) {
+        json.AddItemToObject("rows_read", cJSON_CreateNumber(entry.rows_read));
+    }
+    if (!entry.profile_json.empty()) {
+        cJSON *profile = cJSON_Parse(entry.profile_json.c_str());
+        if (profile != NULL) {
+            json.AddItemToObject("profile", profile);
+        }
+    }
+    return json.release();
+}
+
+// Reads the query parameter `name` into `*out` if it's there.  Returns false if
+// it's there but isn't a number.
+static bool find_int_param(const http_req_t &req, const std::string &name,
+                           int64_t *out) {
+    boost::optional<std::string> value = req.find_query_param(name);
+    return !value || strtoi64_strict(*value, 10, out);
+}
+
+void slow_query_log_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                       signal_t *) {
+    slow_query_log_t *log = &slow_query_log_t::get_global_log();
+
+    http_req_t::resource_t::iterator it = req.resource.begin();
+    if (it == req.resource.end()) {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        scoped_cJSON_t json(cJSON_CreateObject());
+        json.AddItemToObject("thresholds", render_thresholds(log->get_thresholds()));
+        scoped_cJSON_t entries(cJSON_CreateArray());
+        std::deque<slow_query_log_t::entry_t> log_entries = log->get_entries();
+        for (auto entry = log_entries.begin(); entry != log_entries.end(); ++entry) {
+            entries.AddItemToArray(render_entry(*entry));
+        }
+        json.AddItemToObject("entries", entries.release());
+        http_json_res(json.get(), result);
+        return;
+    }
+    std::string command = *it;
+    ++it;
+    if (it != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+
+    if (command == "thresholds") {
+        if (req.method != POST) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        slow_query_log_t::thresholds_t thresholds = log->get_thresholds();
+        if (!find_int_param(req, "duration_ms", &thresholds.duration_ms)
+            || !find_int_param(req, "rows_read", &thresholds.rows_read)
+            || !find_int_param(req, "sample_period", &thresholds.sample_period)) {
+            *result = http_res_t(HTTP_BAD_REQUEST);
+            return;
+        }
+        log->set_thresholds(thresholds);
+        *result = http_res_t(HTTP_OK);
+    } else if (command == "reset") {
+        if (req.method != POST) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        log->reset();
+        *result = http_res_t(HTTP_OK);
+    } else {
+        *result = http_res_t(HTTP_NOT_FOUND);
+    }
+}
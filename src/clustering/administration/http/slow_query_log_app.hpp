@@ -0,0 +1,27 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_SLOW_QUERY_LOG_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_SLOW_QUERY_LOG_APP_HPP_
+
+#include "http/http.hpp"
+
+/* Serves and configures this server's `slow_query_log_t`:
+
+    GET  /                 {"thresholds": {...}, "entries": [...]}, oldest entry
+                           first
+    POST /thresholds       sets the thresholds given as the query parameters
+                           `duration_ms`, `rows_read` and `sample_period`
+    POST /reset            forgets the entries recorded so far
+
+Each entry has the query's `shape`, its `timestamp`, `duration_ms` and
+`rows_returned`, and, if it was sampled, its `rows_read` and `profile`. */
+class slow_query_log_http_app_t : public http_app_t {
+public:
+    slow_query_log_http_app_t() { }
+
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    DISABLE_COPYING(slow_query_log_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_SLOW_QUERY_LOG_APP_HPP_ */
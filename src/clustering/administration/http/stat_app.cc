@@ -10,12 +10,15 @@
 #include "arch/timing.hpp"
 #include "clustering/administration/http/stat_app.hpp"
 #include "clustering/administration/stat_manager.hpp"
+#include "config/args.hpp"
 #include "http/json.hpp"
+#include "perfmon/exposition.hpp"
 #include "perfmon/perfmon.hpp"
 #include "perfmon/archive.hpp"
 #include "clustering/administration/main/watchable_fields.hpp"
 
 static const char * STAT_REQ_TIMEOUT_PARAM = "timeout";
+static const char * STAT_REQ_MATCH_PARAM = "match";
 static const uint64_t DEFAULT_STAT_REQ_TIMEOUT_MS = 1000;
 static const uint64_t MAX_STAT_REQ_TIMEOUT_MS = 60*1000;
 
@@ -32,7 +35,8 @@ stat_http_app_t::stat_http_app_t(mailbox_manager_t *_mbox_manager,
                                  clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > >& _directory,
                                  boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> >& _semilattice
                                  )
-    : mbox_manager(_mbox_manager), directory(_directory), semilattice(_semilattice)
+    : directory(_directory), semilattice(_semilattice),
+      stats_cache(_mbox_manager, _directory)
 { }
 
 cJSON *render_as_json(perfmon_result_t *target) {
@@ -91,10 +95,12 @@ cJSON *stat_http_app_t::prepare_machine_info(const std::vector<machine_id_t> &no
     return machines.release();
 }
 
+// `match_patterns` may be NULL if the "match" parameter isn't allowed.
 boost::optional<http_res_t> parse_query_params(
     const http_req_t &req,
     std::set<std::string> *filter_paths,
     std::set<std::string> *machine_whitelist,
+    std::set<std::string> *match_patterns,
     uint64_t *timeout) {
 
     typedef boost::escaped_list_separator<char> separator_t;
@@ -113,6 +119,8 @@ boost::optional<http_res_t> parse_query_params(
                 return boost::optional<http_res_t>(http_error_res(
                     "Invalid timeout value: "+it->val));
             }
+        } else if (it->key == STAT_REQ_MATCH_PARAM && match_patterns != NULL) {
+            match_patterns->insert(it->val);
         } else if (it->key == "filter" || it->key == "machine_whitelist") {
             std::set<std::string> *out_set =
                 (it->key == "filter" ? filter_paths : machine_whitelist);
@@ -135,34 +143,48 @@ boost::optional<http_res_t> parse_query_params(
     return boost::none;
 }
 
-void stat_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *interruptor) {
-    if (req.method != GET) {
-        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
-        return;
-    }
-    std::set<std::string> filter_paths;
-    std::set<std::string> machine_whitelist;
-#ifndef VALGRIND
-    uint64_t timeout = DEFAULT_STAT_REQ_TIMEOUT_MS;
-#else
-    uint64_t timeout = DEFAULT_STAT_REQ_TIMEOUT_MS*10;
-#endif
-    if (req.method != GET) {
-        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
-        return;
+cluster_stats_cache_t::cluster_stats_cache_t(
+        mailbox_manager_t *_mbox_manager,
+        const clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > &_directory)
+    : mbox_manager(_mbox_manager), directory(_directory) { }
+
+boost::shared_ptr<cluster_stats_cache_t::stats_t> cluster_stats_cache_t::get_stats(
+        const std::set<std::string> &filter_paths,
+        const std::set<std::string> &machine_whitelist,
+        uint64_t timeout,
+        signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    const microtime_t now = current_microtime();
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (now > it->second->time + STATS_DIGEST_MAX_AGE_MS * THOUSAND) {
+            cache.erase(it++);
+        } else {
+            ++it;
+        }
     }
-    boost::optional<http_res_t> maybe_error_res =
-        parse_query_params(req, &filter_paths, &machine_whitelist, &timeout);
-    if (maybe_error_res) {
-        *result = *maybe_error_res;
-        return;
+
+    const key_t key(filter_paths, machine_whitelist);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return it->second;
     }
 
-    scoped_cJSON_t body(cJSON_CreateObject());
+    boost::shared_ptr<stats_t> stats(new stats_t);
+    stats->time = now;
+    request_stats(filter_paths, machine_whitelist, timeout, interruptor, stats.get());
+    cache[key] = stats;
+    return stats;
+}
 
-    peers_to_metadata_t peers_to_metadata = directory->get().get_inner();
+typedef boost::ptr_map<machine_id_t, stats_request_record_t> stats_promises_t;
 
-    typedef boost::ptr_map<machine_id_t, stats_request_record_t> stats_promises_t;
+void cluster_stats_cache_t::request_stats(
+        const std::set<std::string> &filter_paths,
+        const std::set<std::string> &machine_whitelist,
+        uint64_t timeout,
+        signal_t *interruptor,
+        stats_t *stats_out) THROWS_ONLY(interrupted_exc_t) {
+    std::map<peer_id_t, cluster_directory_metadata_t> peers_to_metadata
+        = directory->get().get_inner();
     stats_promises_t stats_promises;
 
     /* If a machine has disconnected, or the mailbox for the
@@ -172,9 +194,9 @@ void stat_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
     signal_timer_t timer;
     timer.start(static_cast<int64_t>(timeout)); // WTF? why is it accepting an int? negative milliseconds, anyone?
 
-    for (peers_to_metadata_t::iterator it  = peers_to_metadata.begin();
-                                       it != peers_to_metadata.end();
-                                       ++it) {
+    for (auto it  = peers_to_metadata.begin();
+              it != peers_to_metadata.end();
+              ++it) {
         machine_id_t machine = it->second.machine_id; //due to boost bug with not accepting const keys for insert
         if (!machine_whitelist.empty() && // If we have a whitelist, follow it.
             machine_whitelist.find(uuid_to_str(machine)) == machine_whitelist.end()) {
@@ -185,7 +207,6 @@ void stat_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
         send(mbox_manager, it->second.get_stats_mailbox_address, req_record->response_mailbox.get_address(), filter_paths);
     }
 
-    std::vector<machine_id_t> not_replied;
     for (stats_promises_t::iterator it = stats_promises.begin(); it != stats_promises.end(); ++it) {
         machine_id_t machine = it->first;
 
@@ -194,18 +215,101 @@ void stat_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
         waiter.wait();
 
         if (stats_ready->is_pulsed()) {
-            perfmon_result_t stats = it->second->stats.wait();
-            if (stats.get_map_size() != 0) {
-                body.AddItemToObject(uuid_to_str(machine).c_str(), render_as_json(&stats));
-            }
+            stats_out->stats.insert(machine, new perfmon_result_t(it->second->stats.wait()));
         } else if (interruptor->is_pulsed()) {
             throw interrupted_exc_t();
         } else {
-            not_replied.push_back(machine);
+            stats_out->not_replied.push_back(machine);
+        }
+    }
+}
+
+void stat_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *interruptor) {
+    if (req.method != GET) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    std::set<std::string> filter_paths;
+    std::set<std::string> machine_whitelist;
+#ifndef VALGRIND
+    uint64_t timeout = DEFAULT_STAT_REQ_TIMEOUT_MS;
+#else
+    uint64_t timeout = DEFAULT_STAT_REQ_TIMEOUT_MS*10;
+#endif
+    boost::optional<http_res_t> maybe_error_res =
+        parse_query_params(req, &filter_paths, &machine_whitelist, NULL, &timeout);
+    if (maybe_error_res) {
+        *result = *maybe_error_res;
+        return;
+    }
+
+    scoped_cJSON_t body(cJSON_CreateObject());
+
+    boost::shared_ptr<cluster_stats_cache_t::stats_t> stats
+        = stats_cache.get_stats(filter_paths, machine_whitelist, timeout, interruptor);
+
+    for (auto it = stats->stats.begin(); it != stats->stats.end(); ++it) {
+        if (it->second->get_map_size() != 0) {
+            body.AddItemToObject(uuid_to_str(it->first).c_str(), render_as_json(it->second));
         }
     }
 
-    cJSON_AddItemToObject(body.get(), "machines", prepare_machine_info(not_replied));
+    cJSON_AddItemToObject(body.get(), "machines", prepare_machine_info(stats->not_replied));
 
     http_json_res(body.get(), result);
 }
+
+stat_exposition_http_app_t::stat_exposition_http_app_t(
+        mailbox_manager_t *_mbox_manager,
+        clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > >& _directory)
+    : stats_cache(_mbox_manager, _directory) { }
+
+void stat_exposition_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                        signal_t *interruptor) {
+    if (req.method != GET) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    std::set<std::string> filter_paths;
+    std::set<std::string> machine_whitelist;
+    std::set<std::string> match_patterns;
+#ifndef VALGRIND
+    uint64_t timeout = DEFAULT_STAT_REQ_TIMEOUT_MS;
+#else
+    uint64_t timeout = DEFAULT_STAT_REQ_TIMEOUT_MS*10;
+#endif
+    boost::optional<http_res_t> maybe_error_res =
+        parse_query_params(req, &filter_paths, &machine_whitelist, &match_patterns,
+                           &timeout);
+    if (maybe_error_res) {
+        *result = *maybe_error_res;
+        return;
+    }
+
+    boost::shared_ptr<perfmon_exposition_t> exposition(new perfmon_exposition_t);
+    for (auto it = match_patterns.begin(); it != match_patterns.end(); ++it) {
+        std::string error;
+        if (!exposition->add_match_pattern(*it, &error)) {
+            *result = http_error_res(strprintf("Invalid %s pattern %s: %s",
+                                               STAT_REQ_MATCH_PARAM, it->c_str(),
+                                               error.c_str()));
+            return;
+        }
+    }
+
+    boost::shared_ptr<cluster_stats_cache_t::stats_t> stats
+        = stats_cache.get_stats(filter_paths, machine_whitelist, timeout, interruptor);
+
+    // Each server's metrics are written as soon as they're rendered.
+    result->code = HTTP_OK;
+    result->set_body_writer("text/plain; version=0.0.4",
+        [exposition, stats](http_body_writer_t *writer, UNUSED signal_t *writer_interruptor) {
+            for (auto it = stats->stats.begin(); it != stats->stats.end(); ++it) {
+                perfmon_exposition_t::labels_t labels;
+                labels.push_back(std::make_pair("machine", uuid_to_str(it->first)));
+                std::string text;
+                exposition->render(*it->second, labels, &text);
+                writer->write(text);
+            }
+        });
+}
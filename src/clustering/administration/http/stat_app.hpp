@@ -3,14 +3,65 @@
 #define CLUSTERING_ADMINISTRATION_HTTP_STAT_APP_HPP_
 
 #include <map>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "errors.hpp"
+#include <boost/ptr_container/ptr_map.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include "clustering/administration/metadata.hpp"
 #include "containers/clone_ptr.hpp"
 #include "http/http.hpp"
 
 template <class> class watchable_t;
 
+/* `cluster_stats_cache_t` gathers the servers' stats for the admin HTTP apps.
+The stats it gathered for a set of filter paths and servers also answer the
+requests for the same ones that come within `STATS_DIGEST_MAX_AGE_MS`, so a
+dashboard that polls often doesn't make the servers send their stats more
+often.  (The servers themselves answer from a digest of the same age, see
+`stat_manager_t`.) */
+class cluster_stats_cache_t {
+public:
+    struct stats_t {
+        microtime_t time;
+        boost::ptr_map<machine_id_t, perfmon_result_t> stats;
+        // The servers that didn't send their stats before the timeout.
+        std::vector<machine_id_t> not_replied;
+    };
+
+    cluster_stats_cache_t(mailbox_manager_t *_mbox_manager,
+                          const clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > &_directory);
+
+    /* Asks the servers in the directory (or the ones in `machine_whitelist`, if
+    it isn't empty) for the stats that match `filter_paths`, unless it did so
+    recently. */
+    boost::shared_ptr<stats_t> get_stats(const std::set<std::string> &filter_paths,
+                                         const std::set<std::string> &machine_whitelist,
+                                         uint64_t timeout,
+                                         signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
+private:
+    // The filter paths and the machine whitelist.
+    typedef std::pair<std::set<std::string>, std::set<std::string> > key_t;
+
+    void request_stats(const std::set<std::string> &filter_paths,
+                       const std::set<std::string> &machine_whitelist,
+                       uint64_t timeout,
+                       signal_t *interruptor,
+                       stats_t *stats_out) THROWS_ONLY(interrupted_exc_t);
+
+    mailbox_manager_t *mbox_manager;
+    clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > directory;
+    std::map<key_t, boost::shared_ptr<stats_t> > cache;
+
+    DISABLE_COPYING(cluster_stats_cache_t);
+};
+
 class stat_http_app_t : public http_app_t {
 public:
     stat_http_app_t(mailbox_manager_t *_mbox_manager,
@@ -24,12 +75,29 @@ private:
     cJSON *prepare_machine_info(const std::vector<machine_id_t> &not_replied);
 
 private:
-    mailbox_manager_t *mbox_manager;
     clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > directory;
     boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> > semilattice;
+    cluster_stats_cache_t stats_cache;
 
     DISABLE_COPYING(stat_http_app_t);
 };
 
+/* `stat_exposition_http_app_t` serves the same stats in the Prometheus text
+exposition format (see `perfmon_exposition_t`), with the server as a `machine`
+label.  Like the JSON stats, it takes "filter" paths, which the servers apply
+before sending their stats, "machine_whitelist" and "timeout", and also "match",
+extended regular expressions that the metric names must match. */
+class stat_exposition_http_app_t : public http_app_t {
+public:
+    stat_exposition_http_app_t(mailbox_manager_t *_mbox_manager,
+                               clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > >& _directory);
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    cluster_stats_cache_t stats_cache;
+
+    DISABLE_COPYING(stat_exposition_http_app_t);
+};
+
 #endif /* CLUSTERING_ADMINISTRATION_HTTP_STAT_APP_HPP_ */
 
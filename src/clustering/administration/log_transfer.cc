@@ -1,7 +1,10 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/log_transfer.hpp"
 
-#include "concurrency/promise.hpp"
+#include <algorithm>
+
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
 
 RDB_IMPL_SERIALIZABLE_1(log_server_business_card_t, address);
@@ -21,9 +24,19 @@ void log_server_t::handle_request(int max_lines, struct timespec min_timestamp,
         auto_drainer_t::lock_t keepalive) {
     std::string error;
     try {
-        std::vector<log_message_t> messages =
-            writer->tail(max_lines, min_timestamp, max_timestamp, keepalive.get_drain_signal());
-        send(mailbox_manager, cont, boost::variant<std::vector<log_message_t>, std::string>(messages));
+        /* Each batch is read separately, so a big read doesn't hold a blocker
+        thread for long or build one huge message. */
+        int64_t position = -1;
+        bool done = false;
+        while (!done) {
+            std::vector<log_message_t> messages = writer->tail(
+                std::min(max_lines, LOG_TRANSFER_CHUNK_SIZE), min_timestamp, max_timestamp,
+                &position, &done, keepalive.get_drain_signal());
+            max_lines -= messages.size();
+            done = done || max_lines <= 0;
+            send(mailbox_manager, cont,
+                 boost::variant<std::vector<log_message_t>, std::string>(messages), done);
+        }
         return;
     } catch (const std::runtime_error &e) {
         error = e.what();
@@ -33,7 +46,7 @@ void log_server_t::handle_request(int max_lines, struct timespec min_timestamp,
     }
     /* Hack around the fact that we can't call a blocking function (e.g.
     `send()` from within a `catch`-block. */
-    send(mailbox_manager, cont, boost::variant<std::vector<log_message_t>, std::string>(error));
+    send(mailbox_manager, cont, boost::variant<std::vector<log_message_t>, std::string>(error), true);
 }
 
 std::vector<log_message_t> fetch_log_file(
@@ -41,23 +54,39 @@ std::vector<log_message_t> fetch_log_file(
         const log_server_business_card_t &bcard,
         int max_lines, struct timespec min_timestamp, struct timespec max_timestamp,
         signal_t *interruptor) THROWS_ONLY(resource_lost_exc_t, std::runtime_error, interrupted_exc_t) {
-    promise_t<boost::variant<std::vector<log_message_t>, std::string> > promise;
+    /* Messages to the same mailbox arrive in order, and the callback doesn't
+    block, so the batches are appended in the order they were sent. */
+    std::vector<log_message_t> messages;
+    std::string error;
+    bool failed = false;
+    cond_t done;
     log_server_business_card_t::result_mailbox_t reply_mailbox(
         mm,
-        boost::bind(&promise_t<boost::variant<std::vector<log_message_t>, std::string> >::pulse, &promise, _1));
+        [&](const boost::variant<std::vector<log_message_t>, std::string> &batch, bool last) {
+            if (done.is_pulsed()) {
+                return;
+            }
+            if (const std::vector<log_message_t> *batch_messages =
+                    boost::get<std::vector<log_message_t> >(&batch)) {
+                messages.insert(messages.end(), batch_messages->begin(), batch_messages->end());
+            } else {
+                error = boost::get<std::string>(batch);
+                failed = true;
+            }
+            if (last) {
+                done.pulse();
+            }
+        });
     disconnect_watcher_t dw(mm->get_connectivity_service(), bcard.address.get_peer());
     send(mm, bcard.address, max_lines, min_timestamp, max_timestamp, reply_mailbox.get_address());
-    wait_any_t waiter(promise.get_ready_signal(), &dw);
+    wait_any_t waiter(&done, &dw);
     wait_interruptible(&waiter, interruptor);
 
-    boost::variant<std::vector<log_message_t>, std::string> res;
-    if (promise.try_get_value(&res)) {
-        if (std::vector<log_message_t> *messages = boost::get<std::vector<log_message_t> >(&res)) {
-            return *messages;
-        } else {
-            throw std::runtime_error(boost::get<std::string>(res));
-        }
-    } else {
+    if (!done.is_pulsed()) {
         throw resource_lost_exc_t();
+    } else if (failed) {
+        throw std::runtime_error(error);
+    } else {
+        return messages;
     }
 }
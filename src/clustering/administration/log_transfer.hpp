@@ -8,9 +8,12 @@
 #include "clustering/administration/logger.hpp"
 #include "clustering/generic/resource.hpp"
 
+/* The log server answers a request with batches of at most
+`LOG_TRANSFER_CHUNK_SIZE` messages, newest first, the last of which has the `bool`
+set; or with an error message, which is always last. */
 class log_server_business_card_t {
 public:
-    typedef mailbox_t<void(boost::variant<std::vector<log_message_t>, std::string>)> result_mailbox_t;
+    typedef mailbox_t<void(boost::variant<std::vector<log_message_t>, std::string>, bool)> result_mailbox_t;
     typedef mailbox_t<void(int, struct timespec, struct timespec, result_mailbox_t::address_t)> request_mailbox_t;
 
     log_server_business_card_t() { }
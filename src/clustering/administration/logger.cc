@@ -8,11 +8,15 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "arch/runtime/thread_pool.hpp"
+#include "arch/io/concurrency.hpp"
 #include "arch/io/disk/filestat.hpp"
 #include "arch/io/disk.hpp"
 #include "clustering/administration/persist.hpp"
 #include "concurrency/promise.hpp"
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "thread_local.hpp"
 
@@ -176,9 +180,10 @@ void throw_unless(bool condition, const std::string &where) {
     }
 }
 
+/* Reads the lines of a file that come before `end_offset`, last first. */
 class file_reverse_reader_t {
 public:
-    explicit file_reverse_reader_t(const std::string &filename) :
+    file_reverse_reader_t(const std::string &filename, int64_t end_offset) :
         fd(INVALID_FD),
         current_chunk(chunk_size) {
 
@@ -191,7 +196,7 @@ public:
             fd.reset(res);
         }
 
-        int64_t fd_filesize = get_file_size(fd.get());
+        int64_t fd_filesize = std::min(get_file_size(fd.get()), end_offset);
         if (fd_filesize == 0) {
             remaining_in_current_chunk = current_chunk_start = 0;
         } else {
@@ -237,6 +242,11 @@ public:
         }
     }
 
+    // The offset of the start of the last line returned.
+    int64_t position() const {
+        return current_chunk_start + remaining_in_current_chunk;
+    }
+
 private:
     static const int chunk_size = 4096;
     scoped_fd_t fd;
@@ -265,16 +275,30 @@ private:
 
     bool write(const log_message_t &msg, std::string *error_out);
     void initiate_write(log_level_t level, const std::string &message);
+    void note_append(struct timespec timestamp, int64_t offset, int64_t end);
+    void update_index(volatile bool *cancel);
+    int64_t find_end_offset(struct timespec max_timestamp);
     base_path_t filename;
     struct timespec uptime_reference;
     struct flock filelock, fileunlock;
     scoped_fd_t fd;
 
+    /* A sparse index of the log file: the offset and timestamp of a line about
+    every `LOG_INDEX_INTERVAL_BYTES`, in file order, so reads of old messages can
+    start near them instead of at the end of the file.  It covers the file up to
+    `index_end`.  The lines we append there are added as they're written; the rest
+    of the file (what was there when we started, or what another process wrote) is
+    scanned when the log is next read.  Writes and reads happen on different
+    threads, hence the mutex. */
+    system_mutex_t index_mutex;
+    std::vector<std::pair<struct timespec, int64_t> > index;
+    int64_t index_end;
+
     DISABLE_COPYING(fallback_log_writer_t);
 } fallback_log_writer;
 
 fallback_log_writer_t::fallback_log_writer_t() :
-    filename("-") {
+    filename("-"), index_end(0) {
     uptime_reference = clock_monotonic();
 
     filelock.l_type = F_WRLCK;
@@ -361,6 +385,12 @@ bool fallback_log_writer_t::write(const log_message_t &msg, std::string *error_o
         return false;
     }
 
+    // The file is opened with `O_APPEND`, so this is where our line ended.
+    off_t end = lseek(fd.get(), 0, SEEK_CUR);
+    if (end != -1) {
+        note_append(msg.timestamp, end - static_cast<int64_t>(formatted.length()), end);
+    }
+
     res = fcntl(fd.get(), F_SETLK, &fileunlock);
     if (res != 0) {
         error_out->assign("cannot unlock log file: " + errno_string(get_errno()));
@@ -392,7 +422,7 @@ thread_pool_log_writer_t::~thread_pool_log_writer_t() {
     pmap(get_num_threads(), boost::bind(&thread_pool_log_writer_t::uninstall_on_thread, this, _1));
 }
 
-std::vector<log_message_t> thread_pool_log_writer_t::tail(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, signal_t *interruptor) THROWS_ONLY(std::runtime_error, interrupted_exc_t) {
+std::vector<log_message_t> thread_pool_log_writer_t::tail(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, int64_t *position, bool *done_out, signal_t *interruptor) THROWS_ONLY(std::runtime_error, interrupted_exc_t) {
     volatile bool cancel = false;
     class cancel_subscription_t : public signal_t::subscription_t {
     public:
@@ -409,7 +439,9 @@ std::vector<log_message_t> thread_pool_log_writer_t::tail(int max_lines, struct
 
 
     bool ok;
-    thread_pool_t::run_in_blocker_pool(boost::bind(&thread_pool_log_writer_t::tail_blocking, this, max_lines, min_timestamp, max_timestamp, &cancel, &log_messages, &error_message, &ok));
+    thread_pool_t::run_in_blocker_pool([&]() {
+        tail_blocking(max_lines, min_timestamp, max_timestamp, position, done_out, &cancel, &log_messages, &error_message, &ok);
+    });
     if (ok) {
         if (cancel) {
             throw interrupted_exc_t();
@@ -473,11 +505,118 @@ bool operator>=(const struct timespec &t1, const struct timespec &t2) {
     return t2 <= t1;
 }
 
-void thread_pool_log_writer_t::tail_blocking(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, volatile bool *cancel, std::vector<log_message_t> *messages_out, std::string *error_out, bool *ok_out) {
+void fallback_log_writer_t::note_append(struct timespec timestamp, int64_t offset, int64_t end) {
+    system_mutex_t::lock_t lock(&index_mutex);
+    if (offset != index_end) {
+        // There's a gap, which `update_index()` will fill in.
+        return;
+    }
+    if (index.empty() || offset >= index.back().second + LOG_INDEX_INTERVAL_BYTES) {
+        index.push_back(std::make_pair(timestamp, offset));
+    }
+    index_end = end;
+}
+
+/* Brings the index up to the end of the file.  This reads the lines that aren't
+indexed yet, which is the whole file the first time. */
+void fallback_log_writer_t::update_index(volatile bool *cancel) {
+    scoped_fd_t read_fd;
+    {
+        int res;
+        do {
+            res = open(filename.path().c_str(), O_RDONLY);
+        } while (res == INVALID_FD && get_errno() == EINTR);
+        throw_unless(res != INVALID_FD, strprintf("could not open '%s' for reading.", filename.path().c_str()));
+        read_fd.reset(res);
+    }
+    const int64_t file_size = get_file_size(read_fd.get());
+
+    std::vector<std::pair<struct timespec, int64_t> > new_entries;
+    int64_t start;
+    int64_t last_entry_offset;
+    {
+        system_mutex_t::lock_t lock(&index_mutex);
+        if (file_size < index_end) {
+            // The log was truncated or replaced, so start over.
+            index.clear();
+            index_end = 0;
+        }
+        start = index_end;
+        last_entry_offset = index.empty() ? -LOG_INDEX_INTERVAL_BYTES : index.back().second;
+    }
+    if (start == file_size) {
+        return;
+    }
+
+    // We don't hold the mutex while reading, so that logging isn't held up.
+    scoped_array_t<char> buffer(LOG_INDEX_INTERVAL_BYTES);
+    std::string line;
+    int64_t line_start = start;
+    for (int64_t pos = start; pos < file_size && !*cancel;) {
+        const int64_t to_read = std::min<int64_t>(LOG_INDEX_INTERVAL_BYTES, file_size - pos);
+        const ssize_t res = pread(read_fd.get(), buffer.data(), to_read, pos);
+        throw_unless(res == to_read, "could not read from file");
+        for (int64_t i = 0; i < to_read; ++i) {
+            if (buffer[i] != '\n') {
+                if (line_start >= last_entry_offset + LOG_INDEX_INTERVAL_BYTES) {
+                    line.push_back(buffer[i]);
+                }
+                continue;
+            }
+            if (line_start >= last_entry_offset + LOG_INDEX_INTERVAL_BYTES) {
+                try {
+                    struct timespec timestamp = parse_time(line.substr(0, line.find(' ')));
+                    new_entries.push_back(std::make_pair(timestamp, line_start));
+                    last_entry_offset = line_start;
+                } catch (const std::runtime_error &) {
+                    // Not a log message; try the next line.
+                }
+                line.clear();
+            }
+            line_start = pos + i + 1;
+        }
+        pos += to_read;
+    }
+    if (*cancel) {
+        return;
+    }
+
+    system_mutex_t::lock_t lock(&index_mutex);
+    if (index_end == start) {
+        index.insert(index.end(), new_entries.begin(), new_entries.end());
+        index_end = line_start;
+    }
+}
+
+/* Where to start reading back from for the messages from before `max_timestamp`:
+the first indexed line that isn't, or the end of the file. */
+int64_t fallback_log_writer_t::find_end_offset(struct timespec max_timestamp) {
+    system_mutex_t::lock_t lock(&index_mutex);
+    auto it = std::lower_bound(
+        index.begin(), index.end(), max_timestamp,
+        [](const std::pair<struct timespec, int64_t> &entry, const struct timespec &t) {
+            return entry.first < t;
+        });
+    return it == index.end() ? INT64_MAX : it->second;
+}
+
+void thread_pool_log_writer_t::tail_blocking(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, int64_t *position, bool *done_out, volatile bool *cancel, std::vector<log_message_t> *messages_out, std::string *error_out, bool *ok_out) {
     try {
-        file_reverse_reader_t reader(fallback_log_writer.filename.path());
+        if (*position < 0) {
+            fallback_log_writer.update_index(cancel);
+            *position = fallback_log_writer.find_end_offset(max_timestamp);
+        }
+        file_reverse_reader_t reader(fallback_log_writer.filename.path(), *position);
         std::string line;
-        while (messages_out->size() < static_cast<size_t>(max_lines) && reader.get_next(&line) && !*cancel) {
+        *done_out = true;
+        while (!*cancel) {
+            if (messages_out->size() >= static_cast<size_t>(max_lines)) {
+                *done_out = false;
+                break;
+            }
+            if (!reader.get_next(&line)) {
+                break;
+            }
             if (line == "" || line[line.length() - 1] != '\n') {
                 continue;
             }
@@ -486,6 +625,7 @@ void thread_pool_log_writer_t::tail_blocking(int max_lines, struct timespec min_
             if (lm.timestamp <= min_timestamp) break;
             messages_out->push_back(lm);
         }
+        *position = reader.position();
         *ok_out = true;
         return;
     } catch (const std::runtime_error &e) {
@@ -47,7 +47,11 @@ public:
     explicit thread_pool_log_writer_t(local_issue_tracker_t *issue_tracker);
     ~thread_pool_log_writer_t();
 
-    std::vector<log_message_t> tail(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, signal_t *interruptor) THROWS_ONLY(std::runtime_error, interrupted_exc_t);
+    /* Returns up to `max_lines` of the messages from between the two timestamps,
+    newest first, that come before `*position` in the log file.  Start with
+    `*position` at -1 to read from the newest message; each call moves it back past
+    the messages it read, and sets `*done_out` when there are no more to read. */
+    std::vector<log_message_t> tail(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, int64_t *position, bool *done_out, signal_t *interruptor) THROWS_ONLY(std::runtime_error, interrupted_exc_t);
 
 private:
     friend void log_coro(thread_pool_log_writer_t *writer, log_level_t level, const std::string &message, auto_drainer_t::lock_t lock);
@@ -57,7 +61,7 @@ private:
     void uninstall_on_thread(int i);
     void write(const log_message_t &msg);
     void write_blocking(const log_message_t &msg, std::string *error_out, bool *ok_out);
-    void tail_blocking(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, volatile bool *cancel, std::vector<log_message_t> *messages_out, std::string *error_out, bool *ok_out);
+    void tail_blocking(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, int64_t *position, bool *done_out, volatile bool *cancel, std::vector<log_message_t> *messages_out, std::string *error_out, bool *ok_out);
     mutex_t write_mutex;
     local_issue_tracker_t *issue_tracker;
     scoped_ptr_t<local_issue_tracker_t::entry_t> issue;
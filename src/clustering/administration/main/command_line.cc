@@ -21,7 +21,10 @@
 #include <functional>
 
 #include "arch/io/disk.hpp"
+#include "arch/io/disk/pool.hpp"
+#include "arch/io/tls.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/cgroups.hpp"
 #include "arch/runtime/starter.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "clustering/administration/cli/admin_command_parser.hpp"
@@ -306,15 +309,27 @@ std::string get_single_option(const std::map<std::string, options::values_t> &op
 class serve_info_t {
 public:
     serve_info_t(const std::vector<host_and_port_t> &_joins,
+                 const std::vector<base_path_t> &_stripe_paths,
+                 const boost::optional<base_path_t> &_cold_tier_path,
+                 const boost::optional<base_path_t> &_flash_cache_path,
+                 uint64_t _flash_cache_size,
                  service_address_ports_t _ports,
                  std::string _web_assets,
                  boost::optional<std::string> _config_file):
         joins(&_joins),
+        stripe_paths(_stripe_paths),
+        cold_tier_path(_cold_tier_path),
+        flash_cache_path(_flash_cache_path),
+        flash_cache_size(_flash_cache_size),
         ports(_ports),
         web_assets(_web_assets),
         config_file(_config_file) { }
 
     const std::vector<host_and_port_t> *joins;
+    std::vector<base_path_t> stripe_paths;
+    boost::optional<base_path_t> cold_tier_path;
+    boost::optional<base_path_t> flash_cache_path;
+    uint64_t flash_cache_size;
     service_address_ports_t ports;
     std::string web_assets;
     boost::optional<std::string> config_file;
@@ -588,14 +603,48 @@ peer_address_t get_canonical_addresses(const std::map<std::string, options::valu
 service_address_ports_t get_service_address_ports(const std::map<std::string, options::values_t> &opts) {
     const int port_offset = get_single_int(opts, "--port-offset");
     const int cluster_port = offseted_port(get_single_int(opts, "--cluster-port"), port_offset);
-    return service_address_ports_t(get_local_addresses(all_options(opts, "--bind")),
-                                   get_canonical_addresses(opts, cluster_port),
-                                   cluster_port,
-                                   get_single_int(opts, "--client-port"),
-                                   exists_option(opts, "--no-http-admin"),
-                                   offseted_port(get_single_int(opts, "--http-port"), port_offset),
-                                   offseted_port(get_single_int(opts, "--driver-port"), port_offset),
-                                   port_offset);
+    service_address_ports_t address_ports(
+        get_local_addresses(all_options(opts, "--bind")),
+        get_canonical_addresses(opts, cluster_port),
+        cluster_port,
+        get_single_int(opts, "--client-port"),
+        exists_option(opts, "--no-http-admin"),
+        offseted_port(get_single_int(opts, "--http-port"), port_offset),
+        offseted_port(get_single_int(opts, "--driver-port"), port_offset),
+        port_offset,
+        exists_option(opts, "--driver-accept-on-all-threads"));
+
+    address_ports.compress_cluster_traffic = exists_option(opts, "--compress-cluster-traffic");
+    const int max_backfill_bandwidth = get_single_int(opts, "--max-backfill-bandwidth");
+    if (max_backfill_bandwidth < 0) {
+        throw std::logic_error("--max-backfill-bandwidth must not be negative");
+    }
+    address_ports.max_backfill_bandwidth = max_backfill_bandwidth * MEGABYTE;
+    const int background_latency_target
+        = get_single_int(opts, "--background-latency-target");
+    if (background_latency_target < 0) {
+        throw std::logic_error("--background-latency-target must not be negative");
+    }
+    address_ports.background_latency_target = background_latency_target * THOUSAND;
+    const int key_filter_bits_per_key = get_single_int(opts, "--key-filter-bits-per-key");
+    if (key_filter_bits_per_key < 0) {
+        throw std::logic_error("--key-filter-bits-per-key must not be negative");
+    }
+    address_ports.key_filter_bits_per_key = key_filter_bits_per_key;
+
+    const boost::optional<std::string> tls_cert = get_optional_option(opts, "--tls-cert");
+    const boost::optional<std::string> tls_key = get_optional_option(opts, "--tls-key");
+    const boost::optional<std::string> tls_ca = get_optional_option(opts, "--tls-ca");
+    if (tls_cert || tls_key || tls_ca) {
+        if (!tls_cert || !tls_key) {
+            throw std::logic_error("--tls-cert and --tls-key must be given together");
+        }
+        // Drivers don't have certificates, so the driver port doesn't ask for one.
+        address_ports.reql_tls_ctx.reset(new tls_ctx_t(*tls_cert, *tls_key, ""));
+        address_ports.cluster_tls_ctx.reset(
+            new tls_ctx_t(*tls_cert, *tls_key, tls_ca ? *tls_ca : ""));
+    }
+    return address_ports;
 }
 
 
@@ -759,6 +808,10 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
         *result_out = serve(&io_backender,
                             base_path,
+                            serve_info.stripe_paths,
+                            serve_info.cold_tier_path,
+                            serve_info.flash_cache_path,
+                            serve_info.flash_cache_size,
                             cluster_metadata_file.get(),
                             auth_metadata_file.get(),
                             look_up_peers_addresses(*serve_info.joins),
@@ -867,6 +920,28 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
                                              options::OPTIONAL,
                                              "rethinkdb_data"));
     help.add("-d [ --directory ] path", "specify directory to store data and metadata");
+    options_out->push_back(options::option_t(options::names_t("--stripe-directory"),
+                                             options::OPTIONAL_REPEAT));
+    help.add("--stripe-directory path",
+             "stripe the files of each table across this directory in addition to the "
+             "data directory, can be specified multiple times (use the same directories "
+             "every time the server is started)");
+    options_out->push_back(options::option_t(options::names_t("--cold-tier-directory"),
+                                             options::OPTIONAL));
+    help.add("--cold-tier-directory path",
+             "move data that hasn't been written in a day to files in this directory, "
+             "e.g. on cheaper storage (use the same directory every time the server is "
+             "started)");
+    options_out->push_back(options::option_t(options::names_t("--flash-cache-directory"),
+                                             options::OPTIONAL));
+    help.add("--flash-cache-directory path",
+             "keep copies of data evicted from the cache in files in this directory, "
+             "which should be on a local SSD");
+    options_out->push_back(options::option_t(options::names_t("--flash-cache-size"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_FLASH_CACHE_SIZE_MB)));
+    help.add("--flash-cache-size mb",
+             "the size of each table's files in the flash cache directory");
     options_out->push_back(options::option_t(options::names_t("--io-threads"),
                                              options::OPTIONAL,
                                              strprintf("%d", DEFAULT_MAX_CONCURRENT_IO_REQUESTS)));
@@ -875,6 +950,19 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--no-direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--no-direct-io", "disable direct I/O");
+    options_out->push_back(options::option_t(options::names_t("--write-combining"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--write-combining",
+             "combine small writes into large ones before sending them to the disk, "
+             "for network-attached block storage");
+    options_out->push_back(options::option_t(options::names_t("--inject-disk-latency"),
+                                             options::OPTIONAL,
+                                             "0"));
+#ifndef NDEBUG
+    help.add("--inject-disk-latency usecs",
+             "make every disk request take this much longer, to test how a cluster "
+             "copes with slow disks (for development)");
+#endif  // NDEBUG
     return help;
 }
 
@@ -886,6 +974,62 @@ options::help_section_t get_config_file_options(std::vector<options::option_t> *
     return help;
 }
 
+std::vector<base_path_t> parse_stripe_directory_options(
+        const std::map<std::string, options::values_t> &opts) {
+    std::string source;
+    const std::vector<std::string> stripe_strings
+        = all_options(opts, "--stripe-directory", &source);
+    // Every file of a table gets at least one of its hash shards.
+    if (stripe_strings.size() >= static_cast<size_t>(CPU_SHARDING_FACTOR)) {
+        throw options::value_error_t(source, "--stripe-directory",
+                                     strprintf("at most %d stripe directories are supported",
+                                               CPU_SHARDING_FACTOR - 1));
+    }
+    std::vector<base_path_t> stripe_paths;
+    for (auto it = stripe_strings.begin(); it != stripe_strings.end(); ++it) {
+        base_path_t stripe_path(*it);
+        if (!check_existence(stripe_path)) {
+            throw std::runtime_error(strprintf("ERROR: stripe directory not found '%s'",
+                                               stripe_path.path().c_str()).c_str());
+        }
+        stripe_path.make_absolute();
+        stripe_paths.push_back(stripe_path);
+    }
+    return stripe_paths;
+}
+
+boost::optional<base_path_t> parse_cold_tier_directory_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const boost::optional<std::string> cold_tier_string
+        = get_optional_option(opts, "--cold-tier-directory");
+    if (!cold_tier_string) {
+        return boost::none;
+    }
+    base_path_t cold_tier_path(*cold_tier_string);
+    if (!check_existence(cold_tier_path)) {
+        throw std::runtime_error(strprintf("ERROR: cold tier directory not found '%s'",
+                                           cold_tier_path.path().c_str()).c_str());
+    }
+    cold_tier_path.make_absolute();
+    return cold_tier_path;
+}
+
+boost::optional<base_path_t> parse_flash_cache_directory_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const boost::optional<std::string> flash_cache_string
+        = get_optional_option(opts, "--flash-cache-directory");
+    if (!flash_cache_string) {
+        return boost::none;
+    }
+    base_path_t flash_cache_path(*flash_cache_string);
+    if (!check_existence(flash_cache_path)) {
+        throw std::runtime_error(strprintf("ERROR: flash cache directory not found '%s'",
+                                           flash_cache_path.path().c_str()).c_str());
+    }
+    flash_cache_path.make_absolute();
+    return flash_cache_path;
+}
+
 std::vector<host_and_port_t> parse_join_options(const std::map<std::string, options::values_t> &opts,
                                                 int default_port) {
     std::string source;
@@ -935,6 +1079,41 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              strprintf("%d", port_defaults::reql_port)));
     help.add("--driver-port port", "port for rethinkdb protocol client drivers");
 
+    options_out->push_back(options::option_t(options::names_t("--driver-accept-on-all-threads"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--driver-accept-on-all-threads", "accept client driver connections on every thread with SO_REUSEPORT (Linux 3.9 and later), instead of handing them out from one thread");
+
+    options_out->push_back(options::option_t(options::names_t("--tls-cert"),
+                                             options::OPTIONAL));
+    help.add("--tls-cert file", "encrypt client driver and cluster connections with TLS, using the PEM certificate (chain) in this file");
+
+    options_out->push_back(options::option_t(options::names_t("--tls-key"),
+                                             options::OPTIONAL));
+    help.add("--tls-key file", "the PEM private key for --tls-cert");
+
+    options_out->push_back(options::option_t(options::names_t("--tls-ca"),
+                                             options::OPTIONAL));
+    help.add("--tls-ca file", "only accept cluster connections from (and make them to) nodes with a certificate signed by a CA in this PEM file");
+
+    options_out->push_back(options::option_t(options::names_t("--compress-cluster-traffic"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--compress-cluster-traffic", "compress the messages sent to other nodes with zlib, e.g. when they're across a slow link");
+
+    options_out->push_back(options::option_t(options::names_t("--max-backfill-bandwidth"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--max-backfill-bandwidth n", "limit the data this node sends to bring replicas on other nodes up to date to n megabytes per second, or 0 for no limit");
+
+    options_out->push_back(options::option_t(options::names_t("--background-latency-target"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--background-latency-target ms", "hold back backfills, the GC and other background work while the 99th percentile of query latency is above ms milliseconds, or 0 to never hold it back");
+
+    options_out->push_back(options::option_t(options::names_t("--key-filter-bits-per-key"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--key-filter-bits-per-key n", "keep an in-memory Bloom filter of each table's primary keys with n bits per key, taken from the table's cache, so that most reads of missing keys don't go to disk (10 lets about 1% of them through), or 0 for no filters");
+
     options_out->push_back(options::option_t(options::names_t("--port-offset", "-o"),
                                              options::OPTIONAL,
                                              strprintf("%d", port_defaults::port_offset)));
@@ -955,8 +1134,11 @@ options::help_section_t get_cpu_options(std::vector<options::option_t> *options_
     options::help_section_t help("CPU options");
     options_out->push_back(options::option_t(options::names_t("--cores", "-c"),
                                              options::OPTIONAL,
-                                             strprintf("%d", get_cpu_count())));
+                                             strprintf("%d", get_usable_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--pin-threads"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--pin-threads", "pin each thread to a core, spreading the threads evenly over the NUMA nodes");
     return help;
 }
 
@@ -1146,10 +1328,35 @@ MUST_USE bool parse_io_threads_option(const std::map<std::string, options::value
     return true;
 }
 
+MUST_USE bool parse_flash_cache_size_option(const std::map<std::string, options::values_t> &opts,
+                                            uint64_t *flash_cache_size_out) {
+    const int flash_cache_size_mb = get_single_int(opts, "--flash-cache-size");
+    if (flash_cache_size_mb < 0) {
+        fprintf(stderr, "ERROR: flash-cache-size must not be negative\n");
+        return false;
+    }
+    *flash_cache_size_out = static_cast<uint64_t>(flash_cache_size_mb) * MEGABYTE;
+    return true;
+}
+
+MUST_USE bool parse_inject_disk_latency_option(const std::map<std::string, options::values_t> &opts) {
+    const int latency = get_single_int(opts, "--inject-disk-latency");
+    if (latency < 0 || latency > MILLION) {
+        fprintf(stderr, "ERROR: inject-disk-latency must be between 0 and %lld\n", MILLION);
+        return false;
+    }
+    set_injected_disk_latency(latency);
+    return true;
+}
+
 file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, options::values_t> &opts) {
-    return exists_option(opts, "--no-direct-io") ?
-        file_direct_io_mode_t::buffered_desired :
-        file_direct_io_mode_t::direct_desired;
+    if (exists_option(opts, "--no-direct-io")) {
+        return file_direct_io_mode_t::buffered_desired;
+    } else if (exists_option(opts, "--write-combining")) {
+        return file_direct_io_mode_t::write_combining_desired;
+    } else {
+        return file_direct_io_mode_t::direct_desired;
+    }
 }
 
 int main_rethinkdb_create(int argc, char *argv[]) {
@@ -1182,7 +1389,11 @@ int main_rethinkdb_create(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
-        const int num_workers = get_cpu_count();
+        if (!parse_inject_disk_latency_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        const int num_workers = get_usable_cpu_count();
 
         bool is_new_directory = false;
         directory_lock_t data_directory_lock(base_path, true, &is_new_directory);
@@ -1277,6 +1488,12 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         base_path_t base_path(get_single_option(opts, "--directory"));
 
+        const std::vector<base_path_t> stripe_paths = parse_stripe_directory_options(opts);
+        const boost::optional<base_path_t> cold_tier_path
+            = parse_cold_tier_directory_option(opts);
+        const boost::optional<base_path_t> flash_cache_path
+            = parse_flash_cache_directory_option(opts);
+
         const std::vector<host_and_port_t> joins = parse_join_options(opts, port_defaults::peer_port);
 
         service_address_ports_t address_ports = get_service_address_ports(opts);
@@ -1293,12 +1510,24 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_inject_disk_latency_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        uint64_t flash_cache_size;
+        if (!parse_flash_cache_size_option(opts, &flash_cache_size)) {
+            return EXIT_FAILURE;
+        }
+
         // Open and lock the directory, but do not create it
         bool is_new_directory = false;
         directory_lock_t data_directory_lock(base_path, false, &is_new_directory);
         guarantee(!is_new_directory);
 
         recreate_temporary_directory(base_path);
+        for (auto it = stripe_paths.begin(); it != stripe_paths.end(); ++it) {
+            recreate_temporary_directory(*it);
+        }
 
         base_path.make_absolute();
         initialize_logfile(opts, base_path);
@@ -1318,7 +1547,8 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         extproc_spawner_t extproc_spawner;
 
-        serve_info_t serve_info(joins, address_ports, web_path,
+        serve_info_t serve_info(joins, stripe_paths, cold_tier_path, flash_cache_path,
+                                flash_cache_size, address_ports, web_path,
                                 get_optional_option(opts, "--config-file"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
@@ -1332,7 +1562,8 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                      static_cast<cluster_semilattice_metadata_t*>(NULL),
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers,
+                           exists_option(opts, "--pin-threads"));
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
         output_named_error(ex, help);
@@ -1369,7 +1600,7 @@ int main_rethinkdb_admin(int argc, char *argv[]) {
 
         const bool exit_on_failure = exists_option(opts, "--exit-failure");
 
-        const int num_workers = get_cpu_count();
+        const int num_workers = get_usable_cpu_count();
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_admin, joins, canonical_addresses, client_port, command_args, exit_on_failure, &result),
@@ -1418,7 +1649,7 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
         initialize_logfile(opts, base_path);
 
         const std::string web_path = get_web_path(opts, argv);
-        const int num_workers = get_cpu_count();
+        const int num_workers = get_usable_cpu_count();
 
         if (check_pid_file(opts) != EXIT_SUCCESS) {
             return EXIT_FAILURE;
@@ -1435,7 +1666,8 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
 
         extproc_spawner_t extproc_spawner;
 
-        serve_info_t serve_info(joins, address_ports, web_path,
+        serve_info_t serve_info(joins, std::vector<base_path_t>(), boost::none,
+                                boost::none, 0, address_ports, web_path,
                                 get_optional_option(opts, "--config-file"));
 
         bool result;
@@ -1533,6 +1765,12 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        const std::vector<base_path_t> stripe_paths = parse_stripe_directory_options(opts);
+        const boost::optional<base_path_t> cold_tier_path
+            = parse_cold_tier_directory_option(opts);
+        const boost::optional<base_path_t> flash_cache_path
+            = parse_flash_cache_directory_option(opts);
+
         const std::vector<host_and_port_t> joins = parse_join_options(opts, port_defaults::peer_port);
 
         const service_address_ports_t address_ports = get_service_address_ports(opts);
@@ -1549,6 +1787,15 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_inject_disk_latency_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        uint64_t flash_cache_size;
+        if (!parse_flash_cache_size_option(opts, &flash_cache_size)) {
+            return EXIT_FAILURE;
+        }
+
         // Attempt to create the directory early so that the log file can use it.
         // If we create the file, it will be cleaned up unless directory_initialized()
         // is called on it.  This will be done after the metadata files have been created.
@@ -1556,6 +1803,9 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
         directory_lock_t data_directory_lock(base_path, true, &is_new_directory);
 
         recreate_temporary_directory(base_path);
+        for (auto it = stripe_paths.begin(); it != stripe_paths.end(); ++it) {
+            recreate_temporary_directory(*it);
+        }
 
         base_path.make_absolute();
         initialize_logfile(opts, base_path);
@@ -1578,7 +1828,8 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
 
         extproc_spawner_t extproc_spawner;
 
-        serve_info_t serve_info(joins, address_ports, web_path,
+        serve_info_t serve_info(joins, stripe_paths, cold_tier_path, flash_cache_path,
+                                flash_cache_size, address_ports, web_path,
                                 get_optional_option(opts, "--config-file"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
@@ -1593,7 +1844,8 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                      serve_info,
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers,
+                           exists_option(opts, "--pin-threads"));
 
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
@@ -1,8 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 
+#include <algorithm>
+
+#include "btree/parallel_traversal.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
+#include "logger.hpp"
 #include "serializer/config.hpp"
 #include "serializer/translator.hpp"
 #include "serializer/merger.hpp"
@@ -15,26 +19,58 @@ template <class protocol_t>
 struct store_args_t {
     store_args_t(io_backender_t *_io_backender, const base_path_t &_base_path,
             namespace_id_t _namespace_id, int64_t _cache_size,
+            cache_balancer_t *_balancer,
             perfmon_collection_t *_serializers_perfmon_collection, typename
-            protocol_t::context_t *_ctx)
+            protocol_t::context_t *_ctx,
+            bool _use_cache_files,
+            const boost::optional<base_path_t> &_flash_cache_path,
+            uint64_t _flash_cache_size)
         : io_backender(_io_backender), base_path(_base_path),
           namespace_id(_namespace_id), cache_size(_cache_size),
+          balancer(_balancer),
           serializers_perfmon_collection(_serializers_perfmon_collection),
-          ctx(_ctx)
+          ctx(_ctx),
+          use_cache_files(_use_cache_files),
+          flash_cache_path(_flash_cache_path),
+          flash_cache_size(_flash_cache_size)
     { }
 
     io_backender_t *io_backender;
     base_path_t base_path;
     namespace_id_t namespace_id;
     int64_t cache_size;
+    cache_balancer_t *balancer;
     perfmon_collection_t *serializers_perfmon_collection;
     typename protocol_t::context_t *ctx;
+    // Whether the stores use warm-up and flash cache files.
+    bool use_cache_files;
+    boost::optional<base_path_t> flash_cache_path;
+    // Per store.
+    uint64_t flash_cache_size;
 };
 
 std::string hash_shard_perfmon_name(int hash_shard_number) {
     return strprintf("shard_%d", hash_shard_number);
 }
 
+// Every hash shard has its own cache, so they each get a warm-up file.
+std::string cache_warmup_file_name(const base_path_t &base_path,
+                                   namespace_id_t namespace_id,
+                                   int hash_shard_number) {
+    return strprintf("%s/%s.%s.warmup", base_path.path().c_str(),
+                     uuid_to_str(namespace_id).c_str(),
+                     hash_shard_perfmon_name(hash_shard_number).c_str());
+}
+
+// Every hash shard has its own flash cache too.
+std::string cache_flash_file_name(const base_path_t &flash_cache_path,
+                                  namespace_id_t namespace_id,
+                                  int hash_shard_number) {
+    return strprintf("%s/%s.%s.flash", flash_cache_path.path().c_str(),
+                     uuid_to_str(namespace_id).c_str(),
+                     hash_shard_perfmon_name(hash_shard_number).c_str());
+}
+
 template <class protocol_t>
 void do_construct_existing_store(
     const std::vector<threadnum_t> &threads,
@@ -50,8 +86,20 @@ void do_construct_existing_store(
     // TODO: Can we pass serializers_perfmon_collection across threads like this?
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
         multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
-        store_args.cache_size, false, store_args.serializers_perfmon_collection,
+        store_args.cache_size, store_args.balancer, false,
+        store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    if (store_args.use_cache_files) {
+        store->use_cache_warmup_file(cache_warmup_file_name(store_args.base_path,
+                                                            store_args.namespace_id,
+                                                            thread_offset));
+        if (store_args.flash_cache_path) {
+            store->use_cache_flash_file(cache_flash_file_name(*store_args.flash_cache_path,
+                                                              store_args.namespace_id,
+                                                              thread_offset),
+                                        store_args.flash_cache_size);
+        }
+    }
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -68,112 +116,200 @@ void do_create_new_store(
     on_thread_t th(threads[thread_offset]);
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
         multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
-        store_args.cache_size, true, store_args.serializers_perfmon_collection,
+        store_args.cache_size, store_args.balancer, true,
+        store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    if (store_args.use_cache_files) {
+        store->use_cache_warmup_file(cache_warmup_file_name(store_args.base_path,
+                                                            store_args.namespace_id,
+                                                            thread_offset));
+        if (store_args.flash_cache_path) {
+            store->use_cache_flash_file(cache_flash_file_name(*store_args.flash_cache_path,
+                                                              store_args.namespace_id,
+                                                              thread_offset),
+                                        store_args.flash_cache_size);
+        }
+    }
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
 
+std::string stripe_perfmon_name(int file_number) {
+    return strprintf("stripe_%d", file_number);
+}
+
+void do_construct_serializer(
+    const std::vector<threadnum_t> &threads,
+    int file_number,
+    bool create,
+    scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > *file_openers,
+    perfmon_collection_t *serializers_perfmon_collection,
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> > *perfmon_memberships_out,
+    scoped_array_t<scoped_ptr_t<serializer_t> > *serializers_out) {
+
+    on_thread_t th(threads[file_number]);
+    filepath_file_opener_t *file_opener = (*file_openers)[file_number].get();
+
+    // The first file reports into the table's serializer collection, like it did
+    // before tables could be striped, the other ones get a collection of their own.
+    perfmon_collection_t *perfmon_collection = serializers_perfmon_collection;
+    if (file_number != 0) {
+        perfmon_collection = new perfmon_collection_t;
+        (*perfmon_memberships_out)[file_number].init(
+            new perfmon_membership_t(serializers_perfmon_collection, perfmon_collection,
+                                     stripe_perfmon_name(file_number), true));
+    }
+
+    if (create) {
+        standard_serializer_t::create(file_opener,
+                                      standard_serializer_t::static_config_t());
+    }
+
+    // TODO: Could we handle failure when loading the serializer?  Right
+    // now, we don't.
+    scoped_ptr_t<serializer_t> ser
+        = make_scoped<standard_serializer_t>(
+            standard_serializer_t::dynamic_config_t(),
+            file_opener,
+            perfmon_collection);
+    ser = make_scoped<merger_serializer_t>(std::move(ser),
+                                           MERGER_SERIALIZER_MAX_ACTIVE_WRITES,
+                                           perfmon_collection);
+    (*serializers_out)[file_number] = std::move(ser);
+}
+
+/* Hands the backfill chunks of one store to another one, on its thread. */
 template <class protocol_t>
-void
-file_based_svs_by_namespace_t<protocol_t>::get_svs(
+class local_backfill_callback_t : public send_backfill_callback_t<protocol_t> {
+public:
+    explicit local_backfill_callback_t(store_view_t<protocol_t> *_dest) : dest(_dest) { }
+
+    void send_chunk(const typename protocol_t::backfill_chunk_t &chunk,
+                    UNUSED signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        on_thread_t th(dest->home_thread());
+        cond_t non_interruptor;
+        write_token_pair_t token_pair;
+        dest->new_write_token_pair(&token_pair);
+        dest->receive_backfill(chunk, &token_pair, &non_interruptor);
+    }
+
+protected:
+    bool should_backfill_impl(const typename protocol_t::store_t::metainfo_t &) {
+        return true;
+    }
+
+private:
+    store_view_t<protocol_t> *const dest;
+
+    DISABLE_COPYING(local_backfill_callback_t);
+};
+
+// Backfills the keys of `source`'s i'th store into the stores of `dest` whose hash
+// regions overlap it.
+template <class protocol_t>
+void copy_store_data(multistore_ptr_t<protocol_t> *source, multistore_ptr_t<protocol_t> *dest,
+                     int i) {
+    store_view_t<protocol_t> *from = source->get_store(i);
+    on_thread_t th(from->home_thread());
+    for (int j = 0; j < dest->num_stores(); ++j) {
+        store_view_t<protocol_t> *to = dest->get_store(j);
+        const typename protocol_t::region_t region
+            = region_intersection(from->get_region(), to->get_region());
+        if (region_is_empty(region)) {
+            continue;
+        }
+        local_backfill_callback_t<protocol_t> callback(to);
+        traversal_progress_combiner_t progress;
+        read_token_pair_t token_pair;
+        from->new_read_token_pair(&token_pair);
+        cond_t non_interruptor;
+        from->send_backfill(
+            region_map_t<protocol_t, state_timestamp_t>(region, state_timestamp_t::zero()),
+            &callback, &progress, &token_pair, &non_interruptor);
+    }
+}
+
+template <class protocol_t>
+void file_based_svs_by_namespace_t<protocol_t>::open_stores(
             perfmon_collection_t *serializers_perfmon_collection,
             namespace_id_t namespace_id,
             int64_t cache_size,
+            int num_stores_to_create,
+            bool use_cache_files,
+            scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > *file_openers,
             stores_lifetimer_t<protocol_t> *stores_out,
             scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
             typename protocol_t::context_t *ctx) {
     const int num_db_threads = get_num_db_threads();
+    const bool create = num_stores_to_create != 0;
 
-    // TODO: If the server gets killed when starting up, we can
-    // get a database in an invalid startup state.
-
-    // TODO: This is quite suspicious in that we check if the file
-    // exists and then assume it exists or does not exist when
-    // loading or creating it.
-
-    // TODO: We should use N slices on M serializers, not N slices
-    // on N serializers.
-
-    const int num_stores = CPU_SHARDING_FACTOR;
-    scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores
-        = stores_out->stores();
-    stores_out_stores->init(num_stores);
+    // The multiplexer puts every store on one of the files, so the stores (which
+    // are hash shards of the table) get spread evenly across the files.
+    const int num_files = num_serializer_files();
+    guarantee(!create || num_files <= num_stores_to_create);
 
-    const threadnum_t serializer_thread = next_thread(num_db_threads);
-    std::vector<threadnum_t> store_threads;
-    for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+    std::vector<threadnum_t> serializer_threads;
+    for (int i = 0; i < num_files; ++i) {
+        serializer_threads.push_back(next_thread(num_db_threads));
     }
 
-    scoped_ptr_t<serializer_t> serializer;
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> > perfmon_memberships(num_files);
+    scoped_array_t<scoped_ptr_t<serializer_t> > serializers(num_files);
     scoped_ptr_t<serializer_multiplexer_t> multiplexer;
+    scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > stores;
     scoped_ptr_t<multistore_ptr_t<protocol_t> > mptr;
     {
-        on_thread_t th(serializer_thread);
-        scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
+        on_thread_t th(serializer_threads[0]);
+
+        pmap(num_files, boost::bind(do_construct_serializer,
+                                    serializer_threads, _1, create, file_openers,
+                                    serializers_perfmon_collection,
+                                    &perfmon_memberships, &serializers));
+
+        std::vector<serializer_t *> ptrs;
+        for (int i = 0; i < num_files; ++i) {
+            ptrs.push_back(serializers[i].get());
+        }
 
-        const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
-        int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
+        if (create) {
+            serializer_multiplexer_t::create(ptrs, num_stores_to_create);
+        }
+        multiplexer.init(new serializer_multiplexer_t(ptrs));
+
+        // A table keeps the number of stores it was created with.
+        const int num_stores = multiplexer->proxies.size();
+        std::vector<threadnum_t> store_threads;
+        for (int i = 0; i < num_stores; ++i) {
+            store_threads.push_back(next_thread(num_db_threads));
+        }
+
+        stores.init(num_stores);
+        scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
         store_args_t<protocol_t> store_args(io_backender_, base_path_,
                                             namespace_id, cache_size / num_stores,
-                                            serializers_perfmon_collection, ctx);
-        filepath_file_opener_t file_opener(serializer_filepath, io_backender_);
-        if (res == 0) {
-            // TODO: Could we handle failure when loading the serializer?  Right
-            // now, we don't.
-
-            {
-                scoped_ptr_t<serializer_t> ser
-                    = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
-                        serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
-                serializer = std::move(ser);
-            }
-
-            std::vector<serializer_t *> ptrs;
-            ptrs.push_back(serializer.get());
-            multiplexer.init(new serializer_multiplexer_t(ptrs));
+                                            balancer_,
+                                            serializers_perfmon_collection, ctx,
+                                            use_cache_files,
+                                            flash_cache_path_,
+                                            flash_cache_size_ / num_stores);
 
+        if (!create) {
             // TODO: Exceptions?  Can exceptions happen, and then
             // store_views' values would leak.  That is, are we handling
             // them in the pmap?  No.
             pmap(num_stores, boost::bind(do_construct_existing_store<protocol_t>,
                                          store_threads, _1, store_args,
                                          multiplexer.get(),
-                                         stores_out_stores, store_views.data()));
+                                         &stores, store_views.data()));
             mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
         } else {
-            standard_serializer_t::create(&file_opener,
-                                          standard_serializer_t::static_config_t());
-            {
-                scoped_ptr_t<serializer_t> ser
-                    = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
-                        serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
-                serializer = std::move(ser);
-            }
-
-            std::vector<serializer_t *> ptrs;
-            ptrs.push_back(serializer.get());
-            serializer_multiplexer_t::create(ptrs, num_stores);
-            multiplexer.init(new serializer_multiplexer_t(ptrs));
-
             // TODO: How do we specify what the stores' regions are?
             // TODO: Exceptions?  Can exceptions happen, and then store_views'
             // values would leak.
-            // The files do not exist, create them.
-            // TODO: This should use pmap.
             pmap(num_stores, boost::bind(do_create_new_store<protocol_t>,
                                          store_threads, _1, store_args,
                                          multiplexer.get(),
-                                         stores_out_stores, store_views.data()));
+                                         &stores, store_views.data()));
             mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
 
             // Initialize the metadata in the underlying stores.
@@ -189,30 +325,201 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
                 order_source.check_in("file_based_svs_by_namespace_t"),
                 &write_token,
                 &dummy_interruptor);
-
-            // Finally, the store is created.
-            file_opener.move_serializer_file_to_permanent_location();
         }
     } // back on calling thread
 
     svs_out->init(mptr.release());
-    stores_out->serializer()->init(serializer.release());
+    *stores_out->stores() = std::move(stores);
+    *stores_out->serializer_perfmon_memberships() = std::move(perfmon_memberships);
+    *stores_out->serializers() = std::move(serializers);
     stores_out->multiplexer()->init(multiplexer.release());
 }
 
+template <class protocol_t>
+void
+file_based_svs_by_namespace_t<protocol_t>::get_svs(
+            perfmon_collection_t *serializers_perfmon_collection,
+            namespace_id_t namespace_id,
+            int64_t cache_size,
+            int cpu_shards,
+            stores_lifetimer_t<protocol_t> *stores_out,
+            scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
+            typename protocol_t::context_t *ctx) {
+    new_semaphore_acq_t open_acq(&open_semaphore_, 1);
+    open_acq.acquisition_signal()->wait();
+
+    // TODO: If the server gets killed when starting up, we can
+    // get a database in an invalid startup state.
+
+    // TODO: This is quite suspicious in that we check if the file
+    // exists and then assume it exists or does not exist when
+    // loading or creating it.
+
+    // Every file of a table gets at least one of its stores.
+    const int num_files = num_serializer_files();
+    const int num_stores = std::max(std::min(cpu_shards, MAX_CPU_SHARDING_FACTOR), num_files);
+
+    scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > file_openers(num_files);
+    for (int i = 0; i < num_files; ++i) {
+        file_openers[i].init(new filepath_file_opener_t(file_name_for(namespace_id, i),
+                                                        io_backender_,
+                                                        cold_tier_file_name_for(namespace_id, i)));
+    }
+
+    // The first file is moved to its permanent location last when a table is
+    // created, so it tells us whether all of the table's files exist.
+    const serializer_filepath_t serializer_filepath = file_name_for(namespace_id, 0);
+    int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
+    if (res != 0) {
+        // The files do not exist, create them.
+        open_stores(serializers_perfmon_collection, namespace_id, cache_size,
+                    num_stores, true, &file_openers, stores_out, svs_out, ctx);
+
+        // Finally, the store is created.  The first file goes last, see above.
+        for (int i = num_files - 1; i >= 0; --i) {
+            file_openers[i]->move_serializer_file_to_permanent_location();
+        }
+        return;
+    }
+
+    open_stores(serializers_perfmon_collection, namespace_id, cache_size,
+                0, true, &file_openers, stores_out, svs_out, ctx);
+    if ((*svs_out)->num_stores() != num_stores) {
+        resplit_stores(serializers_perfmon_collection, namespace_id, cache_size,
+                       num_stores, stores_out, svs_out, ctx);
+    }
+}
+
+template <class protocol_t>
+void file_based_svs_by_namespace_t<protocol_t>::resplit_stores(
+            perfmon_collection_t *serializers_perfmon_collection,
+            namespace_id_t namespace_id,
+            int64_t cache_size,
+            int num_stores,
+            stores_lifetimer_t<protocol_t> *stores,
+            scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs,
+            typename protocol_t::context_t *ctx) {
+    const int old_num_stores = (*svs)->num_stores();
+    if (cold_tier_path_) {
+        // The new files' cold tier files would need the old ones' names.
+        logWRN("Table %s stays split into %d CPU shards instead of %d, because "
+               "tables with a cold tier can't be split differently.\n",
+               uuid_to_str(namespace_id).c_str(), old_num_stores, num_stores);
+        return;
+    }
+    logINF("Splitting table %s into %d CPU shards instead of %d.  It is "
+           "unavailable on this server until its data has been copied.\n",
+           uuid_to_str(namespace_id).c_str(), num_stores, old_num_stores);
+
+    // The new stores are created in new files at the files' temporary paths.  They
+    // don't use the old stores' warm-up and flash cache files, which are still in
+    // use.
+    const int num_files = num_serializer_files();
+    scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > file_openers(num_files);
+    for (int i = 0; i < num_files; ++i) {
+        file_openers[i].init(new filepath_file_opener_t(file_name_for(namespace_id, i),
+                                                        io_backender_,
+                                                        std::string()));
+    }
+    stores_lifetimer_t<protocol_t> new_stores;
+    scoped_ptr_t<multistore_ptr_t<protocol_t> > new_svs;
+    open_stores(serializers_perfmon_collection, namespace_id, cache_size,
+                num_stores, false, &file_openers, &new_stores, &new_svs, ctx);
+
+    // Every old store is backfilled into the new stores its hash region overlaps,
+    // and then the new stores get the old ones' versions.
+    pmap(old_num_stores, boost::bind(&copy_store_data<protocol_t>,
+                                     svs->get(), new_svs.get(), _1));
+    {
+        cond_t non_interruptor;
+        order_source_t order_source;
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
+        (*svs)->new_read_token(&read_token);
+        region_map_t<protocol_t, binary_blob_t> metainfo;
+        (*svs)->do_get_metainfo(
+            order_source.check_in("file_based_svs_by_namespace_t").with_read_mode(),
+            &read_token, &non_interruptor, &metainfo);
+        object_buffer_t<fifo_enforcer_sink_t::exit_write_t> write_token;
+        new_svs->new_write_token(&write_token);
+        new_svs->set_metainfo(metainfo,
+                              order_source.check_in("file_based_svs_by_namespace_t"),
+                              &write_token, &non_interruptor);
+    }
+
+    // The old stores are closed before the new files replace theirs.  The first
+    // file goes last, like when a table is created, but if we get killed in the
+    // middle a striped table's files won't all be from the same store, and the
+    // server won't start.
+    svs->reset();
+    stores->reset();
+    remove_cache_files(namespace_id, old_num_stores);
+    for (int i = num_files - 1; i >= 0; --i) {
+        file_openers[i]->move_serializer_file_to_permanent_location();
+    }
+
+    *svs = std::move(new_svs);
+    stores->swap(&new_stores);
+}
+
+template<class protocol_t>
+void file_based_svs_by_namespace_t<protocol_t>::remove_cache_files(
+        namespace_id_t namespace_id, int num_stores) {
+    for (int i = 0; i < num_stores; ++i) {
+        const std::string filepath = cache_warmup_file_name(base_path_, namespace_id, i);
+        const int res = ::unlink(filepath.c_str());
+        guarantee_err(res == 0 || get_errno() == ENOENT,
+                      "unlink failed for file %s", filepath.c_str());
+        if (flash_cache_path_) {
+            const std::string flash_filepath
+                = cache_flash_file_name(*flash_cache_path_, namespace_id, i);
+            const int flash_res = ::unlink(flash_filepath.c_str());
+            guarantee_err(flash_res == 0 || get_errno() == ENOENT,
+                          "unlink failed for file %s", flash_filepath.c_str());
+        }
+    }
+}
+
 template<class protocol_t>
 void file_based_svs_by_namespace_t<protocol_t>::destroy_svs(namespace_id_t namespace_id) {
     // TODO: Handle errors?  It seems like we can't really handle the error so
     // let's just ignore it?
-    const std::string filepath = file_name_for(namespace_id).permanent_path();
-    const int res = ::unlink(filepath.c_str());
-    guarantee_err(res == 0 || get_errno() == ENOENT,
-                  "unlink failed for file %s", filepath.c_str());
+    for (int i = 0; i < num_serializer_files(); ++i) {
+        const std::string filepath = file_name_for(namespace_id, i).permanent_path();
+        const int res = ::unlink(filepath.c_str());
+        guarantee_err(res == 0 || get_errno() == ENOENT,
+                      "unlink failed for file %s", filepath.c_str());
+        if (cold_tier_path_) {
+            const std::string cold_filepath = cold_tier_file_name_for(namespace_id, i);
+            const int cold_res = ::unlink(cold_filepath.c_str());
+            guarantee_err(cold_res == 0 || get_errno() == ENOENT,
+                          "unlink failed for file %s", cold_filepath.c_str());
+        }
+    }
+    // We don't know how many stores the table had, so we remove the files of as
+    // many as it could have had.
+    remove_cache_files(namespace_id, MAX_CPU_SHARDING_FACTOR);
+}
+
+template<class protocol_t>
+serializer_filepath_t file_based_svs_by_namespace_t<protocol_t>::file_name_for(
+        namespace_id_t namespace_id, int file_number) {
+    guarantee(file_number >= 0 && file_number < num_serializer_files());
+    const base_path_t &directory
+        = file_number == 0 ? base_path_ : stripe_paths_[file_number - 1];
+    return serializer_filepath_t(directory, uuid_to_str(namespace_id));
 }
 
 template<class protocol_t>
-serializer_filepath_t file_based_svs_by_namespace_t<protocol_t>::file_name_for(namespace_id_t namespace_id) {
-    return serializer_filepath_t(base_path_, uuid_to_str(namespace_id));
+std::string file_based_svs_by_namespace_t<protocol_t>::cold_tier_file_name_for(
+        namespace_id_t namespace_id, int file_number) {
+    guarantee(file_number >= 0 && file_number < num_serializer_files());
+    if (!cold_tier_path_) {
+        return std::string();
+    }
+    // The stripes of a table have the same name in their directories, but share
+    // the cold tier directory.
+    return strprintf("%s/%s_cold_%d", cold_tier_path_->path().c_str(),
+                     uuid_to_str(namespace_id).c_str(), file_number);
 }
 
 template<class protocol_t>
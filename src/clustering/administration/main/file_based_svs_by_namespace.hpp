@@ -3,34 +3,99 @@
 #define CLUSTERING_ADMINISTRATION_MAIN_FILE_BASED_SVS_BY_NAMESPACE_HPP_
 
 #include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
 
 #include "clustering/administration/reactor_driver.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "config/args.hpp"
+
+class cache_balancer_t;
+class filepath_file_opener_t;
 
 template <class protocol_t>
 class file_based_svs_by_namespace_t : public svs_by_namespace_t<protocol_t> {
 public:
+    // Each table is striped across one file in `base_path` and one file in each of
+    // `stripe_paths`.  If there's a `cold_tier_path`, each of the files has a cold
+    // tier file there.  If there's a `flash_cache_path`, the caches of each table
+    // have flash cache files there, `flash_cache_size` bytes in all.  The tables'
+    // caches share memory through `balancer`.
     file_based_svs_by_namespace_t(io_backender_t *io_backender,
-                                  const base_path_t& base_path)
-        : io_backender_(io_backender), base_path_(base_path), thread_counter_(0) { }
+                                  cache_balancer_t *balancer,
+                                  const base_path_t& base_path,
+                                  const std::vector<base_path_t> &stripe_paths,
+                                  const boost::optional<base_path_t> &cold_tier_path,
+                                  const boost::optional<base_path_t> &flash_cache_path,
+                                  uint64_t flash_cache_size)
+        : io_backender_(io_backender), balancer_(balancer), base_path_(base_path),
+          stripe_paths_(stripe_paths), cold_tier_path_(cold_tier_path),
+          flash_cache_path_(flash_cache_path), flash_cache_size_(flash_cache_size),
+          thread_counter_(0),
+          open_semaphore_(MAX_CONCURRENT_TABLE_OPENS) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
                  int64_t cache_size,
+                 int cpu_shards,
                  stores_lifetimer_t<protocol_t> *stores_out,
                  scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                  typename protocol_t::context_t *);
 
     void destroy_svs(namespace_id_t namespace_id);
 
-    serializer_filepath_t file_name_for(namespace_id_t namespace_id);
+    int num_serializer_files() const { return 1 + stripe_paths_.size(); }
+    serializer_filepath_t file_name_for(namespace_id_t namespace_id, int file_number);
+    // The cold tier file of the file_number'th file, or the empty string if there's
+    // no cold tier.
+    std::string cold_tier_file_name_for(namespace_id_t namespace_id, int file_number);
 
 private:
     io_backender_t *io_backender_;
+    cache_balancer_t *balancer_;
     const base_path_t base_path_;
+    const std::vector<base_path_t> stripe_paths_;
+    const boost::optional<base_path_t> cold_tier_path_;
+    const boost::optional<base_path_t> flash_cache_path_;
+    const uint64_t flash_cache_size_;
+
+    // Opens the table's files through `file_openers`, or creates them with
+    // `num_stores_to_create` stores if that's not 0, and the stores on them.
+    void open_stores(perfmon_collection_t *serializers_perfmon_collection,
+                     namespace_id_t namespace_id,
+                     int64_t cache_size,
+                     int num_stores_to_create,
+                     bool use_cache_files,
+                     scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > *file_openers,
+                     stores_lifetimer_t<protocol_t> *stores_out,
+                     scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
+                     typename protocol_t::context_t *ctx);
+
+    // Moves the data of the table's open stores into `num_stores` new ones, in
+    // new files that then replace the old ones.  This runs before the table's
+    // reactor starts, so the table doesn't serve any queries on this server until
+    // all of its data has been copied.
+    void resplit_stores(perfmon_collection_t *serializers_perfmon_collection,
+                        namespace_id_t namespace_id,
+                        int64_t cache_size,
+                        int num_stores,
+                        stores_lifetimer_t<protocol_t> *stores,
+                        scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs,
+                        typename protocol_t::context_t *ctx);
+
+    // Removes the warm-up and flash cache files of the first `num_stores` stores.
+    void remove_cache_files(namespace_id_t namespace_id, int num_stores);
 
     threadnum_t next_thread(int num_db_threads);
     int thread_counter_; // should only be used by `next_thread`
 
+    // Each table's reactor calls `get_svs()` from its own coroutine, and can take
+    // traffic as soon as its own stores are open.  This bounds how many of them
+    // open their files at once, in the order they asked.
+    new_semaphore_t open_semaphore_;
+
     DISABLE_COPYING(file_based_svs_by_namespace_t);
 };
 
@@ -1,10 +1,13 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/main/serve.hpp"
 
+#include <inttypes.h>
 #include <stdio.h>
 
 #include "arch/arch.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/cgroups.hpp"
+#include "buffer_cache/alt/cache_balancer.hpp"
 #include "clustering/administration/admin_tracker.hpp"
 #include "clustering/administration/auto_reconnect.hpp"
 #include "clustering/administration/http/server.hpp"
@@ -24,12 +27,17 @@
 #include "clustering/administration/proc_stats.hpp"
 #include "clustering/administration/reactor_driver.hpp"
 #include "clustering/administration/sys_stats.hpp"
+#include "clustering/immediate_consistency/branch/backfill_throttle.hpp"
+#include "concurrency/background_governor.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "memcached/tcp_conn.hpp"
 #include "mock/dummy_protocol.hpp"
 #include "mock/dummy_protocol_parser.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/key_filter.hpp"
 #include "rdb_protocol/pb_server.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_capture.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/connectivity/multiplexer.hpp"
 #include "rpc/connectivity/heartbeat.hpp"
@@ -66,6 +74,10 @@ bool do_serve(
     bool i_am_a_server,
     // NB. filepath & persistent_file are used iff i_am_a_server is true.
     const base_path_t &base_path,
+    const std::vector<base_path_t> &stripe_paths,
+    const boost::optional<base_path_t> &cold_tier_path,
+    const boost::optional<base_path_t> &flash_cache_path,
+    uint64_t flash_cache_size,
     metadata_persistence::cluster_persistent_file_t *cluster_metadata_file,
     metadata_persistence::auth_persistent_file_t *auth_metadata_file,
     const peer_address_set_t &joins,
@@ -76,6 +88,13 @@ bool do_serve(
     try {
         extproc_pool_t extproc_pool(get_num_threads());
 
+        set_backfill_bandwidth_limit(address_ports.max_backfill_bandwidth);
+        set_background_latency_target(address_ports.background_latency_target);
+        set_key_filter_bits_per_key(address_ports.key_filter_bits_per_key);
+        if (i_am_a_server) {
+            query_capture_t::get_global_capture().set_directory(base_path.path());
+        }
+
         local_issue_tracker_t local_issue_tracker;
 
         thread_pool_log_writer_t log_writer(&local_issue_tracker);
@@ -157,7 +176,9 @@ bool do_serve(
                 address_ports.port,
                 &message_multiplexer_run,
                 address_ports.client_port,
-                &heartbeat_manager));
+                &heartbeat_manager,
+                address_ports.cluster_tls_ctx.get(),
+                address_ports.compress_cluster_traffic));
 
             // Update the directory with the ip addresses that we are passing to peers
             std::set<ip_and_port_t> ips = connectivity_cluster_run->get_ips();
@@ -255,9 +276,35 @@ bool do_serve(
         //This is an annoying chicken and egg problem here
         rdb_ctx.ns_repo = &rdb_namespace_repo;
 
+        ql::changefeed::client_t changefeed_client(&mailbox_manager);
+        rdb_ctx.manager = &mailbox_manager;
+        rdb_ctx.changefeed_client = &changefeed_client;
+
+        // Proxies have no data directory, so their queries can't spill to disk.
+        scoped_ptr_t<ql::spill_storage_t> spill_storage;
+        if (io_backender != NULL) {
+            spill_storage.init(new ql::spill_storage_t(io_backender, base_path,
+                                                       &rdb_ctx.ql_stats_collection));
+            rdb_ctx.spill_storage = spill_storage.get();
+        }
+
         {
             // Reactor drivers
 
+            // Moves cache memory between the tables' caches, and keeps them within
+            // the container's memory limit if there is one.  It has to outlive all
+            // of them.
+            const uint64_t cgroup_memory_limit = get_cgroup_limits().memory_limit;
+            const uint64_t cache_memory_budget =
+                cgroup_memory_limit / 100 * CACHE_BALANCER_CGROUP_MEMORY_PERCENT;
+            if (cache_memory_budget != 0) {
+                logINF("Limiting the table caches to %" PRIu64 " MB of the %" PRIu64
+                       " MB memory limit of our cgroup\n",
+                       static_cast<uint64_t>(cache_memory_budget / MEGABYTE),
+                       static_cast<uint64_t>(cgroup_memory_limit / MEGABYTE));
+            }
+            cache_balancer_t cache_balancer(cache_memory_budget);
+
             // Dummy
             scoped_ptr_t<file_based_svs_by_namespace_t<mock::dummy_protocol_t> > dummy_svs_source;
             scoped_ptr_t<reactor_driver_t<mock::dummy_protocol_t> > dummy_reactor_driver;
@@ -266,7 +313,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 dummy_svs_source.init(new file_based_svs_by_namespace_t<mock::dummy_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, &cache_balancer, base_path, stripe_paths,
+                    cold_tier_path, flash_cache_path, flash_cache_size));
                 dummy_reactor_driver.init(new reactor_driver_t<mock::dummy_protocol_t>(
                     base_path,
                     io_backender,
@@ -299,7 +347,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 memcached_svs_source.init(new file_based_svs_by_namespace_t<memcached_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, &cache_balancer, base_path, stripe_paths,
+                    cold_tier_path, flash_cache_path, flash_cache_size));
                 memcached_reactor_driver.init(new reactor_driver_t<memcached_protocol_t>(
                     base_path,
                     io_backender,
@@ -332,7 +381,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 rdb_svs_source.init(new file_based_svs_by_namespace_t<rdb_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, &cache_balancer, base_path, stripe_paths,
+                    cold_tier_path, flash_cache_path, flash_cache_size));
                 rdb_reactor_driver.init(new reactor_driver_t<rdb_protocol_t>(
                         base_path,
                         io_backender,
@@ -377,7 +427,9 @@ bool do_serve(
                     &perfmon_repo);
 
                 query2_server_t rdb_pb2_server(address_ports.local_addresses,
-                                               address_ports.reql_port, &rdb_ctx);
+                                               address_ports.reql_port, &rdb_ctx,
+                                               address_ports.reql_accept_on_all_threads,
+                                               address_ports.reql_tls_ctx.get());
                 logINF("Listening for client driver connections on port %d\n",
                        rdb_pb2_server.get_port());
 
@@ -479,6 +531,10 @@ bool do_serve(
 
 bool serve(io_backender_t *io_backender,
            const base_path_t &base_path,
+           const std::vector<base_path_t> &stripe_paths,
+           const boost::optional<base_path_t> &cold_tier_path,
+           const boost::optional<base_path_t> &flash_cache_path,
+           uint64_t flash_cache_size,
            metadata_persistence::cluster_persistent_file_t *cluster_persistent_file,
            metadata_persistence::auth_persistent_file_t *auth_persistent_file,
            const peer_address_set_t &joins,
@@ -489,6 +545,10 @@ bool serve(io_backender_t *io_backender,
     return do_serve(io_backender,
                     true,
                     base_path,
+                    stripe_paths,
+                    cold_tier_path,
+                    flash_cache_path,
+                    flash_cache_size,
                     cluster_persistent_file,
                     auth_persistent_file,
                     joins,
@@ -508,6 +568,10 @@ bool serve_proxy(const peer_address_set_t &joins,
     return do_serve(NULL,
                     false,
                     base_path_t(""),
+                    std::vector<base_path_t>(),
+                    boost::none,
+                    boost::none,
+                    0,
                     NULL,
                     NULL,
                     joins,
@@ -4,12 +4,18 @@
 
 #include <set>
 #include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/persist.hpp"
 #include "arch/address.hpp"
 
 class os_signal_cond_t;
+class tls_ctx_t;
 
 class invalid_port_exc_t : public std::exception {
 public:
@@ -43,7 +49,12 @@ struct service_address_ports_t {
         client_port(0),
         http_port(0),
         reql_port(0),
-        port_offset(0) { }
+        port_offset(0),
+        reql_accept_on_all_threads(false),
+        compress_cluster_traffic(false),
+        max_backfill_bandwidth(0),
+        background_latency_target(0),
+        key_filter_bits_per_key(0) { }
 
     service_address_ports_t(const std::set<ip_address_t> &_local_addresses,
                             const peer_address_t &_canonical_addresses,
@@ -52,7 +63,8 @@ struct service_address_ports_t {
                             bool _http_admin_is_disabled,
                             int _http_port,
                             int _reql_port,
-                            int _port_offset) :
+                            int _port_offset,
+                            bool _reql_accept_on_all_threads) :
         local_addresses(_local_addresses),
         canonical_addresses(_canonical_addresses),
         port(_port),
@@ -60,7 +72,12 @@ struct service_address_ports_t {
         http_admin_is_disabled(_http_admin_is_disabled),
         http_port(_http_port),
         reql_port(_reql_port),
-        port_offset(_port_offset)
+        port_offset(_port_offset),
+        reql_accept_on_all_threads(_reql_accept_on_all_threads),
+        compress_cluster_traffic(false),
+        max_backfill_bandwidth(0),
+        background_latency_target(0),
+        key_filter_bits_per_key(0)
     {
             sanitize_port(port, "port", port_offset);
             sanitize_port(client_port, "client_port", port_offset);
@@ -80,13 +97,38 @@ struct service_address_ports_t {
     int http_port;
     int reql_port;
     int port_offset;
+    // Whether every thread accepts client driver connections (with SO_REUSEPORT).
+    bool reql_accept_on_all_threads;
+    // Whether we compress the messages we send to other nodes.
+    bool compress_cluster_traffic;
+    // How many bytes per second we send to backfill other nodes, or 0 for no limit.
+    int64_t max_backfill_bandwidth;
+    // The query latency, in microseconds, above which background work is held
+    // back, or 0 for never (see background_governor.hpp).
+    int64_t background_latency_target;
+    // How many bits per key the tables' Bloom filters of their primary keys get, or
+    // 0 for no filters (see key_filter.hpp).
+    int key_filter_bits_per_key;
+    // If not NULL, client driver and cluster connections use TLS.  They're separate
+    // because only peers are asked for certificates.
+    boost::shared_ptr<tls_ctx_t> reql_tls_ctx;
+    boost::shared_ptr<tls_ctx_t> cluster_tls_ctx;
 };
 
 /* This has been factored out from `command_line.hpp` because it takes a very
 long time to compile. */
 
+// Tables are striped across a file in `base_path` and one in each of `stripe_paths`.
+// If there's a `cold_tier_path`, each of those files moves the blocks that haven't been
+// written in a long time to a file of its own there.  If there's a `flash_cache_path`,
+// the caches of each table keep up to `flash_cache_size` bytes of evicted blocks in
+// files there.
 bool serve(io_backender_t *io_backender,
            const base_path_t &base_path,
+           const std::vector<base_path_t> &stripe_paths,
+           const boost::optional<base_path_t> &cold_tier_path,
+           const boost::optional<base_path_t> &flash_cache_path,
+           uint64_t flash_cache_size,
            metadata_persistence::cluster_persistent_file_t *cluster_persistent_file,
            metadata_persistence::auth_persistent_file_t *auth_persistent_file,
            const peer_address_set_t &joins,
@@ -6,6 +6,46 @@
 
 RDB_IMPL_ME_SERIALIZABLE_2(ack_expectation_t, expectation_, hard_durability_);
 
+template <class protocol_t>
+void join_namespaces(cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > *a,
+                     const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &b) {
+    if (!b->namespaces.empty()) {
+        semilattice_join(a, b);
+    }
+}
+
+void semilattice_join(cluster_semilattice_metadata_t *a, const cluster_semilattice_metadata_t &b) {
+    join_namespaces(&a->dummy_namespaces, b.dummy_namespaces);
+    join_namespaces(&a->memcached_namespaces, b.memcached_namespaces);
+    join_namespaces(&a->rdb_namespaces, b.rdb_namespaces);
+    semilattice_join(&a->machines, b.machines);
+    semilattice_join(&a->datacenters, b.datacenters);
+    semilattice_join(&a->databases, b.databases);
+}
+
+template <class protocol_t>
+void namespace_changes(const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &base,
+                       const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &added,
+                       cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > *changes_out) {
+    /* Copies of the metadata share the namespaces until they're changed. */
+    if (base.get() == added.get()) {
+        return;
+    }
+    typename cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> >::change_t change(changes_out);
+    semilattice_changes(base->namespaces, added->namespaces, &change.get()->namespaces);
+}
+
+void semilattice_changes(const cluster_semilattice_metadata_t &base,
+                         const cluster_semilattice_metadata_t &added,
+                         cluster_semilattice_metadata_t *changes_out) {
+    namespace_changes(base.dummy_namespaces, added.dummy_namespaces, &changes_out->dummy_namespaces);
+    namespace_changes(base.memcached_namespaces, added.memcached_namespaces, &changes_out->memcached_namespaces);
+    namespace_changes(base.rdb_namespaces, added.rdb_namespaces, &changes_out->rdb_namespaces);
+    semilattice_changes(base.machines.machines, added.machines.machines, &changes_out->machines.machines);
+    semilattice_changes(base.datacenters.datacenters, added.datacenters.datacenters, &changes_out->datacenters.datacenters);
+    semilattice_changes(base.databases.databases, added.databases.databases, &changes_out->databases.databases);
+}
+
 bool ack_expectation_t::operator==(ack_expectation_t other) const {
     return expectation_ == other.expectation_ && hard_durability_ == other.hard_durability_;
 }
@@ -258,6 +298,7 @@ json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespace_semi
     res["primary_key"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<std::string>(&target->primary_key, ctx));
     res["database"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<database_id_t>(&target->database, ctx));
     res["cache_size"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->cache_size, ctx));
+    res["cpu_shards"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int32_t>(&target->cpu_shards, ctx));
     return res;
 }
 
@@ -297,6 +338,8 @@ inline json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespa
 
     default_namespace.cache_size = default_namespace.cache_size.make_new_version(GIGABYTE, ctx.us);
 
+    default_namespace.cpu_shards = default_namespace.cpu_shards.make_new_version(CPU_SHARDING_FACTOR, ctx.us);
+
     deletable_t<namespace_semilattice_metadata_t<protocol_t> > default_ns_in_deletable(default_namespace);
     return json_ctx_adapter_with_inserter_t<typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t, vclock_ctx_t>(&target->namespaces, generate_uuid, ctx, default_ns_in_deletable).get_subfields();
 }
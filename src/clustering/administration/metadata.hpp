@@ -26,6 +26,7 @@
 #include "rdb_protocol/protocol.hpp"
 #include "rpc/semilattice/joins/cow_ptr.hpp"
 #include "rpc/semilattice/joins/macros.hpp"
+#include "rpc/semilattice/joins/map.hpp"
 #include "rpc/serialize_macros.hpp"
 
 namespace mock { class dummy_protocol_t; }
@@ -47,7 +48,18 @@ public:
     RDB_MAKE_ME_SERIALIZABLE_6(dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 };
 
-RDB_MAKE_SEMILATTICE_JOINABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
+/* This is the join `RDB_MAKE_SEMILATTICE_JOINABLE_6()` would make, except that it
+leaves the namespaces alone when `b` has none of them. That way joining in the
+few changes the `semilattice_manager_t` sends doesn't copy the namespace maps that
+are shared with copies of the metadata. */
+void semilattice_join(cluster_semilattice_metadata_t *a, const cluster_semilattice_metadata_t &b);
+
+/* Sets `*changes_out` to the namespaces, machines, datacenters and databases
+that are different in `added` than in `base`; see `semilattice_manager_t`. */
+void semilattice_changes(const cluster_semilattice_metadata_t &base,
+                         const cluster_semilattice_metadata_t &added,
+                         cluster_semilattice_metadata_t *changes_out);
+
 RDB_MAKE_EQUALITY_COMPARABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 
 //json adapter concept for cluster_semilattice_metadata_t
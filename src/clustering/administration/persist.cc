@@ -5,12 +5,55 @@
 #include <sys/types.h>
 
 #include "arch/runtime/thread_pool.hpp"
+#include "btree/depth_first_traversal.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
 #include "buffer_cache/alt/alt.hpp"
+#include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
 #include "buffer_cache/alt/blob.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "serializer/config.hpp"
 
+/* The values of the cluster metadata btree: a blob with one serialized entry. */
+struct metadata_value_t {
+    char contents[];
+};
+
+template <>
+class value_sizer_t<metadata_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return blob::ref_size(block_size_, as_metadata(value)->contents,
+                              blob::btree_maxreflen);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return blob::ref_fits(block_size_, length_available,
+                              as_metadata(value)->contents, blob::btree_maxreflen);
+    }
+
+    int max_possible_size() const { return blob::btree_maxreflen; }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'm', 'd', 't', 'l' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    static const metadata_value_t *as_metadata(const void *p) {
+        return static_cast<const metadata_value_t *>(p);
+    }
+
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<metadata_value_t>);
+};
+
 namespace metadata_persistence {
 
 struct auth_metadata_superblock_t {
@@ -21,7 +64,8 @@ struct auth_metadata_superblock_t {
 
 };
 
-// This version is used for the cluster_persistent_file_t
+// The cluster_persistent_file_t superblock from before the metadata was kept in a
+// btree.  We only read it, to convert the file.
 struct cluster_metadata_superblock_t {
     block_magic_t magic;
 
@@ -39,6 +83,151 @@ struct cluster_metadata_superblock_t {
 /* Etymology: (R)ethink(D)B (m)eta(d)ata */
 const block_magic_t expected_magic = { { 'R', 'D', 'm', 'd' } };
 
+struct cluster_btree_superblock_t {
+    block_magic_t magic;
+
+    machine_id_t machine_id;
+
+    block_id_t root_block;
+    block_id_t stat_block;
+};
+
+/* (R)ethink(D)B (m)etadata (b)tree */
+const block_magic_t cluster_btree_expected_magic = { { 'R', 'D', 'm', 'b' } };
+
+/* Lets the btree operations use the cluster metadata file's superblock.  The
+metadata btree has no secondary indexes. */
+class cluster_btree_superblock_buf_t : public superblock_t {
+public:
+    explicit cluster_btree_superblock_buf_t(buf_lock_t &&sb_buf)
+        : sb_buf_(std::move(sb_buf)) { }
+
+    void release() { sb_buf_.reset_buf_lock(); }
+
+    block_id_t get_root_block_id() {
+        buf_read_t read(&sb_buf_);
+        return static_cast<const cluster_btree_superblock_t *>(read.get_data_read())->root_block;
+    }
+    void set_root_block_id(block_id_t new_root_block) {
+        buf_write_t write(&sb_buf_);
+        static_cast<cluster_btree_superblock_t *>(write.get_data_write())->root_block
+            = new_root_block;
+    }
+
+    block_id_t get_stat_block_id() {
+        buf_read_t read(&sb_buf_);
+        return static_cast<const cluster_btree_superblock_t *>(read.get_data_read())->stat_block;
+    }
+    void set_stat_block_id(block_id_t new_stat_block) {
+        buf_write_t write(&sb_buf_);
+        static_cast<cluster_btree_superblock_t *>(write.get_data_write())->stat_block
+            = new_stat_block;
+    }
+
+    block_id_t get_sindex_block_id() { return NULL_BLOCK_ID; }
+    void set_sindex_block_id(UNUSED block_id_t new_block_id) { unreachable(); }
+
+    buf_parent_t expose_buf() { return buf_parent_t(&sb_buf_); }
+
+private:
+    buf_lock_t sb_buf_;
+};
+
+/* The keys of the metadata btree are a prefix naming the kind of entry followed by
+the entry's UUID. */
+static const char *const dummy_namespace_prefix = "namespace/dummy/";
+static const char *const memcached_namespace_prefix = "namespace/memcached/";
+static const char *const rdb_namespace_prefix = "namespace/rdb/";
+static const char *const machine_prefix = "machine/";
+static const char *const datacenter_prefix = "datacenter/";
+static const char *const database_prefix = "database/";
+static const char *const dummy_branch_prefix = "branch/dummy/";
+static const char *const memcached_branch_prefix = "branch/memcached/";
+static const char *const rdb_branch_prefix = "branch/rdb/";
+
+template <class T>
+static void set_metadata_entry(btree_slice_t *slice, superblock_t *superblock,
+                               const std::string &prefix, const uuid_u &id,
+                               const T &value) {
+    const store_key_t key(prefix + uuid_to_str(id));
+    promise_t<superblock_t *> pass_back_superblock;
+    keyvalue_location_t<metadata_value_t> kv_location;
+    find_keyvalue_location_for_write(superblock, key.btree_key(), &kv_location,
+                                     &slice->stats, NULL, &pass_back_superblock);
+    buf_parent_t leaf(&kv_location.buf);
+    const block_size_t block_size = leaf.cache()->get_block_size();
+
+    if (kv_location.value.has()) {
+        blob_t old_blob(block_size, kv_location.value->contents, blob::btree_maxreflen);
+        old_blob.clear(leaf);
+    }
+
+    scoped_malloc_t<metadata_value_t> new_value(blob::btree_maxreflen);
+    memset(new_value.get(), 0, blob::btree_maxreflen);
+    {
+        blob_t blob(block_size, new_value->contents, blob::btree_maxreflen);
+        serialize_onto_blob(leaf, &blob, value);
+    }
+    kv_location.value = std::move(new_value);
+
+    null_key_modification_callback_t<metadata_value_t> null_cb;
+    apply_keyvalue_change(&kv_location, key.btree_key(),
+                          repli_timestamp_t::distant_past, expired_t::NO, &null_cb);
+}
+
+template <class T>
+static void set_metadata_entries(btree_slice_t *slice, superblock_t *superblock,
+                                 const std::string &prefix,
+                                 const std::map<uuid_u, T> &entries) {
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        set_metadata_entry(slice, superblock, prefix, it->first, it->second);
+    }
+}
+
+template <class T>
+class metadata_entry_reader_t : public depth_first_traversal_callback_t {
+public:
+    metadata_entry_reader_t(const std::string &_prefix, std::map<uuid_u, T> *_out)
+        : prefix(_prefix), out(_out) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        const std::string key = key_to_unescaped_str(store_key_t(keyvalue.key()));
+        guarantee(key.compare(0, prefix.size(), prefix) == 0);
+        uuid_u id;
+        guarantee(str_to_uuid(key.substr(prefix.size()), &id),
+                  "Corrupted metadata key in storage.");
+
+        // The const cast is okay because we only read the blob.
+        const metadata_value_t *value
+            = static_cast<const metadata_value_t *>(keyvalue.value());
+        blob_t blob(keyvalue.expose_buf().cache()->get_block_size(),
+                    const_cast<char *>(value->contents), blob::btree_maxreflen);
+        T entry;
+        deserialize_from_blob(keyvalue.expose_buf(), &blob, &entry);
+        (*out)[id] = entry;
+        return true;
+    }
+
+private:
+    const std::string prefix;
+    std::map<uuid_u, T> *const out;
+};
+
+/* Reads the entries whose keys start with `prefix`, and releases `superblock`. */
+template <class T>
+static void get_metadata_entries(btree_slice_t *slice, superblock_t *superblock,
+                                 const std::string &prefix,
+                                 std::map<uuid_u, T> *entries_out) {
+    // All the prefixes end with '/', so the keys with the prefix are the ones
+    // before the prefix ending in the next character instead.
+    std::string prefix_end = prefix;
+    ++prefix_end[prefix_end.size() - 1];
+    const key_range_t range(key_range_t::closed, store_key_t(prefix),
+                            key_range_t::open, store_key_t(prefix_end));
+    metadata_entry_reader_t<T> reader(prefix, entries_out);
+    btree_depth_first_traversal(slice, superblock, range, &reader, FORWARD);
+}
+
 template <class T>
 static void write_blob(buf_parent_t parent, char *ref, int maxreflen,
                        const T &value) {
@@ -123,7 +312,8 @@ void persistent_file_t<metadata_t>::construct_serializer_and_cache(const bool cr
     {
         alt_cache_config_t cache_dynamic_config;
         cache_dynamic_config.page_config.memory_limit = MEGABYTE;
-        cache.init(new cache_t(serializer.get(), cache_dynamic_config, perfmon_parent));
+        cache.init(new cache_t(serializer.get(), cache_dynamic_config, NULL,
+                               perfmon_parent));
         cache_conn.init(new cache_conn_t(cache.get()));
     }
 
@@ -217,7 +407,10 @@ void auth_persistent_file_t::update_metadata(const auth_semilattice_metadata_t &
 cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backender,
                                                      const serializer_filepath_t &filename,
                                                      perfmon_collection_t *perfmon_parent) :
-    persistent_file_t<cluster_semilattice_metadata_t>(io_backender, filename, perfmon_parent, false) {
+    persistent_file_t<cluster_semilattice_metadata_t>(io_backender, filename, perfmon_parent, false),
+    metadata_btree(new btree_slice_t(get_cache(), perfmon_parent, "metadata")),
+    metadata_loaded(false) {
+    convert_from_superblock_blobs();
     construct_branch_history_managers(false);
 }
 
@@ -226,35 +419,29 @@ cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backende
                                                      perfmon_collection_t *perfmon_parent,
                                                      const machine_id_t &machine_id,
                                                      const cluster_semilattice_metadata_t &initial_metadata) :
-    persistent_file_t<cluster_semilattice_metadata_t>(io_backender, filename, perfmon_parent, true) {
+    persistent_file_t<cluster_semilattice_metadata_t>(io_backender, filename, perfmon_parent, true),
+    metadata_btree(new btree_slice_t(get_cache(), perfmon_parent, "metadata")),
+    metadata_loaded(true),
+    persisted_metadata(initial_metadata) {
 
     object_buffer_t<txn_t> txn;
     get_write_transaction(&txn);
-    buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
-                          access_t::write);
-    buf_write_t sb_write(&superblock);
-    cluster_metadata_superblock_t *sb
-        = static_cast<cluster_metadata_superblock_t *>(sb_write.get_data_write());
-
-    memset(sb, 0, get_cache_block_size().value());
-    sb->magic = expected_magic;
-    sb->machine_id = machine_id;
-    write_blob(buf_parent_t(&superblock),
-               sb->metadata_blob,
-               cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN,
-               initial_metadata);
-    write_blob(buf_parent_t(&superblock),
-               sb->dummy_branch_history_blob,
-               cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
-               branch_history_t<mock::dummy_protocol_t>());
-    write_blob(buf_parent_t(&superblock),
-               sb->memcached_branch_history_blob,
-               cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
-               branch_history_t<memcached_protocol_t>());
-    write_blob(buf_parent_t(&superblock),
-               sb->rdb_branch_history_blob,
-               cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
-               branch_history_t<rdb_protocol_t>());
+    {
+        buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
+                              access_t::write);
+        buf_write_t sb_write(&superblock);
+        cluster_btree_superblock_t *sb
+            = static_cast<cluster_btree_superblock_t *>(sb_write.get_data_write());
+
+        memset(sb, 0, get_cache_block_size().value());
+        sb->magic = cluster_btree_expected_magic;
+        sb->machine_id = machine_id;
+        sb->root_block = NULL_BLOCK_ID;
+        sb->stat_block = NULL_BLOCK_ID;
+    }
+    scoped_ptr_t<superblock_t> superblock;
+    get_superblock(txn.get(), access_t::write, &superblock);
+    write_metadata_entries(superblock.get(), initial_metadata);
 
     construct_branch_history_managers(true);
 }
@@ -263,31 +450,166 @@ cluster_persistent_file_t::~cluster_persistent_file_t() {
     // Do nothing
 }
 
-cluster_semilattice_metadata_t cluster_persistent_file_t::read_metadata() {
+void cluster_persistent_file_t::get_superblock(txn_t *txn, access_t access,
+                                               scoped_ptr_t<superblock_t> *superblock_out) {
+    buf_lock_t superblock(buf_parent_t(txn), SUPERBLOCK_ID, access);
+    superblock_out->init(new cluster_btree_superblock_buf_t(std::move(superblock)));
+}
+
+/* Moves the metadata and branch histories out of the blobs of a file written before
+the metadata btree, if this is one. */
+void cluster_persistent_file_t::convert_from_superblock_blobs() {
     object_buffer_t<txn_t> txn;
-    get_read_transaction(&txn);
-    buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
-                          access_t::read);
-    buf_read_t sb_read(&superblock);
+    get_write_transaction(&txn);
+    cluster_semilattice_metadata_t metadata;
+    branch_history_t<mock::dummy_protocol_t> dummy_branch_history;
+    branch_history_t<memcached_protocol_t> memcached_branch_history;
+    branch_history_t<rdb_protocol_t> rdb_branch_history;
+    {
+        buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
+                              access_t::write);
+        {
+            buf_read_t sb_read(&superblock);
+            const block_magic_t magic
+                = static_cast<const cluster_btree_superblock_t *>(sb_read.get_data_read())->magic;
+            if (magic == cluster_btree_expected_magic) {
+                return;
+            }
+            guarantee(magic == expected_magic, "Unrecognized metadata file.");
+        }
+
+        buf_write_t sb_write(&superblock);
+        cluster_metadata_superblock_t *old_sb
+            = static_cast<cluster_metadata_superblock_t *>(sb_write.get_data_write());
+        const machine_id_t machine_id = old_sb->machine_id;
+        read_blob(buf_parent_t(&superblock), old_sb->metadata_blob,
+                  cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &metadata);
+        read_blob(buf_parent_t(&superblock), old_sb->dummy_branch_history_blob,
+                  cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
+                  &dummy_branch_history);
+        read_blob(buf_parent_t(&superblock), old_sb->memcached_branch_history_blob,
+                  cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
+                  &memcached_branch_history);
+        read_blob(buf_parent_t(&superblock), old_sb->rdb_branch_history_blob,
+                  cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
+                  &rdb_branch_history);
+
+        const block_size_t block_size = get_cache_block_size();
+        blob_t(block_size, old_sb->metadata_blob,
+               cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN)
+            .clear(buf_parent_t(&superblock));
+        blob_t(block_size, old_sb->dummy_branch_history_blob,
+               cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN)
+            .clear(buf_parent_t(&superblock));
+        blob_t(block_size, old_sb->memcached_branch_history_blob,
+               cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN)
+            .clear(buf_parent_t(&superblock));
+        blob_t(block_size, old_sb->rdb_branch_history_blob,
+               cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN)
+            .clear(buf_parent_t(&superblock));
+
+        cluster_btree_superblock_t *sb
+            = static_cast<cluster_btree_superblock_t *>(sb_write.get_data_write());
+        memset(sb, 0, block_size.value());
+        sb->magic = cluster_btree_expected_magic;
+        sb->machine_id = machine_id;
+        sb->root_block = NULL_BLOCK_ID;
+        sb->stat_block = NULL_BLOCK_ID;
+    }
+
+    scoped_ptr_t<superblock_t> superblock;
+    get_superblock(txn.get(), access_t::write, &superblock);
+    write_metadata_entries(superblock.get(), metadata);
+    set_metadata_entries(metadata_btree.get(), superblock.get(), dummy_branch_prefix,
+                         dummy_branch_history.branches);
+    set_metadata_entries(metadata_btree.get(), superblock.get(), memcached_branch_prefix,
+                         memcached_branch_history.branches);
+    set_metadata_entries(metadata_btree.get(), superblock.get(), rdb_branch_prefix,
+                         rdb_branch_history.branches);
+
+    metadata_loaded = true;
+    persisted_metadata = metadata;
+}
 
-    const cluster_metadata_superblock_t *sb
-        = static_cast<const cluster_metadata_superblock_t *>(sb_read.get_data_read());
+void cluster_persistent_file_t::load_metadata() {
+    object_buffer_t<txn_t> txn;
+    get_read_transaction(&txn);
     cluster_semilattice_metadata_t metadata;
-    read_blob(buf_parent_t(&superblock), sb->metadata_blob,
-              cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &metadata);
-    return metadata;
+    scoped_ptr_t<superblock_t> superblock;
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t<mock::dummy_protocol_t> >::change_t
+            change(&metadata.dummy_namespaces);
+        get_superblock(txn.get(), access_t::read, &superblock);
+        get_metadata_entries(metadata_btree.get(), superblock.get(),
+                             dummy_namespace_prefix, &change.get()->namespaces);
+    }
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t<memcached_protocol_t> >::change_t
+            change(&metadata.memcached_namespaces);
+        get_superblock(txn.get(), access_t::read, &superblock);
+        get_metadata_entries(metadata_btree.get(), superblock.get(),
+                             memcached_namespace_prefix, &change.get()->namespaces);
+    }
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> >::change_t
+            change(&metadata.rdb_namespaces);
+        get_superblock(txn.get(), access_t::read, &superblock);
+        get_metadata_entries(metadata_btree.get(), superblock.get(),
+                             rdb_namespace_prefix, &change.get()->namespaces);
+    }
+    get_superblock(txn.get(), access_t::read, &superblock);
+    get_metadata_entries(metadata_btree.get(), superblock.get(),
+                         machine_prefix, &metadata.machines.machines);
+    get_superblock(txn.get(), access_t::read, &superblock);
+    get_metadata_entries(metadata_btree.get(), superblock.get(),
+                         datacenter_prefix, &metadata.datacenters.datacenters);
+    get_superblock(txn.get(), access_t::read, &superblock);
+    get_metadata_entries(metadata_btree.get(), superblock.get(),
+                         database_prefix, &metadata.databases.databases);
+
+    metadata_loaded = true;
+    persisted_metadata = metadata;
+}
+
+void cluster_persistent_file_t::write_metadata_entries(
+        superblock_t *superblock, const cluster_semilattice_metadata_t &entries) {
+    btree_slice_t *slice = metadata_btree.get();
+    set_metadata_entries(slice, superblock, dummy_namespace_prefix,
+                         entries.dummy_namespaces->namespaces);
+    set_metadata_entries(slice, superblock, memcached_namespace_prefix,
+                         entries.memcached_namespaces->namespaces);
+    set_metadata_entries(slice, superblock, rdb_namespace_prefix,
+                         entries.rdb_namespaces->namespaces);
+    set_metadata_entries(slice, superblock, machine_prefix,
+                         entries.machines.machines);
+    set_metadata_entries(slice, superblock, datacenter_prefix,
+                         entries.datacenters.datacenters);
+    set_metadata_entries(slice, superblock, database_prefix,
+                         entries.databases.databases);
+}
+
+cluster_semilattice_metadata_t cluster_persistent_file_t::read_metadata() {
+    if (!metadata_loaded) {
+        load_metadata();
+    }
+    return persisted_metadata;
 }
 
 void cluster_persistent_file_t::update_metadata(const cluster_semilattice_metadata_t &metadata) {
+    if (!metadata_loaded) {
+        load_metadata();
+    }
+    // The metadata only grows, so the entries that are new or different are all
+    // there is to write.
+    cluster_semilattice_metadata_t changes;
+    semilattice_changes(persisted_metadata, metadata, &changes);
+
     object_buffer_t<txn_t> txn;
     get_write_transaction(&txn);
-    buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
-                          access_t::write);
-    buf_write_t sb_write(&superblock);
-    cluster_metadata_superblock_t *sb
-        = static_cast<cluster_metadata_superblock_t *>(sb_write.get_data_write());
-    write_blob(buf_parent_t(&superblock), sb->metadata_blob,
-               cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, metadata);
+    scoped_ptr_t<superblock_t> superblock;
+    get_superblock(txn.get(), access_t::write, &superblock);
+    write_metadata_entries(superblock.get(), changes);
+    persisted_metadata = metadata;
 }
 
 machine_id_t cluster_persistent_file_t::read_machine_id() {
@@ -296,8 +618,8 @@ machine_id_t cluster_persistent_file_t::read_machine_id() {
     buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
                           access_t::read);
     buf_read_t sb_read(&superblock);
-    const cluster_metadata_superblock_t *sb
-        = static_cast<const cluster_metadata_superblock_t *>(sb_read.get_data_read());
+    const cluster_btree_superblock_t *sb
+        = static_cast<const cluster_btree_superblock_t *>(sb_read.get_data_read());
     return sb->machine_id;
 }
 
@@ -305,23 +627,20 @@ template <class protocol_t>
 class cluster_persistent_file_t::persistent_branch_history_manager_t : public branch_history_manager_t<protocol_t> {
 public:
     persistent_branch_history_manager_t(cluster_persistent_file_t *p,
-                                        char (cluster_metadata_superblock_t::*fn)[cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN],
+                                        const char *_key_prefix,
                                         bool create) :
-        parent(p), field_name(fn)
+        parent(p), key_prefix(_key_prefix)
     {
         /* If we're not creating, we have to load the existing branch history
-        database from disk */
+        database from disk.  The branches have to be in memory because
+        `get_branch()` and `export_branch_history()` can't block. */
         if (!create) {
             object_buffer_t<txn_t> txn;
             parent->get_read_transaction(&txn);
-            buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
-                                  access_t::read);
-            buf_read_t sb_read(&superblock);
-            const cluster_metadata_superblock_t *sb
-                = static_cast<const cluster_metadata_superblock_t *>(sb_read.get_data_read());
-            read_blob(buf_parent_t(&superblock), sb->*field_name,
-                      cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
-                      &bh);
+            scoped_ptr_t<superblock_t> superblock;
+            parent->get_superblock(txn.get(), access_t::read, &superblock);
+            get_metadata_entries(parent->metadata_btree.get(), superblock.get(),
+                                 key_prefix, &bh.branches);
         }
     }
 
@@ -351,7 +670,9 @@ public:
         std::pair<typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::iterator, bool>
             insert_res = bh.branches.insert(std::make_pair(branch_id, bc));
         guarantee(insert_res.second);
-        flush(interruptor);
+        std::map<branch_id_t, branch_birth_certificate_t<protocol_t> > new_branches;
+        new_branches.insert(*insert_res.first);
+        flush(new_branches, interruptor);
     }
 
     void export_branch_history(branch_id_t branch,
@@ -379,27 +700,32 @@ public:
     void import_branch_history(const branch_history_t<protocol_t> &new_records,
                                signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         home_thread_mixin_t::assert_thread();
+        std::map<branch_id_t, branch_birth_certificate_t<protocol_t> > new_branches;
         for (typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::const_iterator it = new_records.branches.begin(); it != new_records.branches.end(); it++) {
-            bh.branches.insert(std::make_pair(it->first, it->second));
+            if (bh.branches.insert(std::make_pair(it->first, it->second)).second) {
+                new_branches.insert(*it);
+            }
         }
-        flush(interruptor);
+        flush(new_branches, interruptor);
     }
 
 private:
-    void flush(UNUSED signal_t *interruptor) {
+    /* Writes the branches that weren't on disk yet. */
+    void flush(const std::map<branch_id_t, branch_birth_certificate_t<protocol_t> > &new_branches,
+               UNUSED signal_t *interruptor) {
+        if (new_branches.empty()) {
+            return;
+        }
         object_buffer_t<txn_t> txn;
         parent->get_write_transaction(&txn);
-        buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
-                              access_t::write);
-        buf_write_t sb_write(&superblock);
-        cluster_metadata_superblock_t *sb
-            = static_cast<cluster_metadata_superblock_t *>(sb_write.get_data_write());
-        write_blob(buf_parent_t(&superblock), sb->*field_name,
-                   cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN, bh);
+        scoped_ptr_t<superblock_t> superblock;
+        parent->get_superblock(txn.get(), access_t::write, &superblock);
+        set_metadata_entries(parent->metadata_btree.get(), superblock.get(),
+                             key_prefix, new_branches);
     }
 
     cluster_persistent_file_t *parent;
-    char (cluster_metadata_superblock_t::*field_name)[cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN];
+    const std::string key_prefix;
     branch_history_t<protocol_t> bh;
 };
 
@@ -422,11 +748,11 @@ branch_history_manager_t<rdb_protocol_t> *cluster_persistent_file_t::get_rdb_bra
 
 void cluster_persistent_file_t::construct_branch_history_managers(bool create) {
     dummy_branch_history_manager.init(new persistent_branch_history_manager_t<mock::dummy_protocol_t>(
-        this, &cluster_metadata_superblock_t::dummy_branch_history_blob, create));
+        this, dummy_branch_prefix, create));
     memcached_branch_history_manager.init(new persistent_branch_history_manager_t<memcached_protocol_t>(
-        this, &cluster_metadata_superblock_t::memcached_branch_history_blob, create));
+        this, memcached_branch_prefix, create));
     rdb_branch_history_manager.init(new persistent_branch_history_manager_t<rdb_protocol_t>(
-        this, &cluster_metadata_superblock_t::rdb_branch_history_blob, create));
+        this, rdb_branch_prefix, create));
 }
 
 template <class metadata_t>
@@ -10,8 +10,10 @@
 #include "rpc/semilattice/view.hpp"
 #include "serializer/types.hpp"
 
+class btree_slice_t;
 class cache_conn_t;
 class cache_t;
+class superblock_t;
 class txn_t;
 
 template <class> class branch_history_manager_t;
@@ -41,6 +43,7 @@ protected:
     void get_read_transaction(object_buffer_t<txn_t> *txn_out);
 
     block_size_t get_cache_block_size() const;
+    cache_t *get_cache() { return cache.get(); }
 
 private:
     /* Shared between constructors */
@@ -66,6 +69,10 @@ public:
     void update_metadata(const auth_semilattice_metadata_t &metadata);
 };
 
+/* The cluster metadata file keeps each database, datacenter, machine, namespace and
+branch under its own key of a btree, so that a change to the metadata only writes
+the entries that changed.  Files that still hold the metadata as a whole in the
+superblock are converted when they're opened. */
 class cluster_persistent_file_t : public persistent_file_t<cluster_semilattice_metadata_t> {
 public:
     cluster_persistent_file_t(io_backender_t *io_backender, const serializer_filepath_t &filename,
@@ -87,6 +94,20 @@ public:
 private:
     void construct_branch_history_managers(bool create);
 
+    void get_superblock(txn_t *txn, access_t access,
+                        scoped_ptr_t<superblock_t> *superblock_out);
+    void convert_from_superblock_blobs();
+    void load_metadata();
+    void write_metadata_entries(superblock_t *superblock,
+                                const cluster_semilattice_metadata_t &entries);
+
+    scoped_ptr_t<btree_slice_t> metadata_btree;
+
+    /* What's on disk, so `update_metadata()` can tell which entries changed.  It's
+    read the first time it's needed. */
+    bool metadata_loaded;
+    cluster_semilattice_metadata_t persisted_metadata;
+
     template <class protocol_t> class persistent_branch_history_manager_t;
 
     friend class persistent_branch_history_manager_t<mock::dummy_protocol_t>;
@@ -2,21 +2,206 @@
 #include "clustering/administration/proc_stats.hpp"
 
 #include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#include "arch/timing.hpp"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "arch/runtime/cgroups.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/types.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
 #include "utils.hpp"
 
+/* Reads the fields of "/proc/self/stat" that come after the process's name, the
+first of which is the state. */
+static bool read_proc_self_stat(std::vector<std::string> *fields_out) {
+    FILE *file = fopen("/proc/self/stat", "r");
+    if (file == NULL) {
+        return false;
+    }
+    char buffer[4096];
+    const size_t size = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[size] = '\0';
+
+    // The name is in parentheses and may have spaces and parentheses in it.
+    const char *p = strrchr(buffer, ')');
+    if (p == NULL) {
+        return false;
+    }
+    fields_out->clear();
+    ++p;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\n') {
+            ++p;
+        }
+        const char *start = p;
+        while (*p != '\0' && *p != ' ' && *p != '\n') {
+            ++p;
+        }
+        if (p != start) {
+            fields_out->push_back(std::string(start, p - start));
+        }
+    }
+    return true;
+}
+
+proc_stats_collector_t::sample_t::sample_t() :
+    has_proc(false), cpu_ticks(0), cpu_percent(0), major_page_faults(0),
+    threads(0), virtual_memory(0), resident_memory(0),
+    cgroup_cpu_quota(0), cgroup_memory_limit(0),
+    has_cgroup_memory(false), cgroup_memory_usage(0),
+    has_cgroup_throttling(false), cgroup_throttled_periods(0), cgroup_throttled_usecs(0),
+    has_counters(false) {
+    time.tv_sec = 0;
+    time.tv_nsec = 0;
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        counters[i] = 0;
+    }
+}
+
 proc_stats_collector_t::proc_stats_collector_t(perfmon_collection_t *stats) :
-    instantaneous_stats_collector(),
+    counter_fds(get_num_threads() * NUM_COUNTERS),
+    sample_in_progress(false),
+    instantaneous_stats_collector(this),
     stats_membership(stats,
-        &instantaneous_stats_collector, static_cast<const char *>(NULL)) {
+        &instantaneous_stats_collector, static_cast<const char *>(NULL)),
+    timer(SYSTEM_STATS_SAMPLE_INTERVAL_MS, this) {
+    pmap(get_num_threads(), std::bind(&proc_stats_collector_t::open_counters_on_thread,
+                                      this, ph::_1));
+
+    // So that there's something to report before the timer first goes off.
+    sample_t first;
+    thread_pool_t::run_in_blocker_pool(std::bind(&proc_stats_collector_t::sample_blocking,
+                                                 this, &first));
+    spinlock_acq_t acq(&latest_sample_lock);
+    latest_sample = first;
+}
+
+void proc_stats_collector_t::open_counters_on_thread(int thread) {
+#ifdef __linux__
+    // The counters count the thread that opens them, wherever it runs.
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    static const uint64_t configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_REFERENCES,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        // Counting only user space is what unprivileged processes are usually
+        // allowed to do.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        const int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        counter_fds[thread * NUM_COUNTERS + i].reset(fd);
+    }
+#else
+    (void)thread;
+#endif
+}
+
+void proc_stats_collector_t::on_ring() {
+    assert_thread();
+    if (!sample_in_progress) {
+        sample_in_progress = true;
+        coro_t::spawn_sometime(std::bind(&proc_stats_collector_t::sample,
+                                         this, drainer.lock()));
+    }
 }
 
-proc_stats_collector_t::instantaneous_stats_collector_t::instantaneous_stats_collector_t() {
+void proc_stats_collector_t::sample(auto_drainer_t::lock_t) {
+    sample_t new_sample;
+    thread_pool_t::run_in_blocker_pool(std::bind(&proc_stats_collector_t::sample_blocking,
+                                                 this, &new_sample));
+    {
+        spinlock_acq_t acq(&latest_sample_lock);
+        latest_sample = new_sample;
+    }
+    sample_in_progress = false;
+}
+
+void proc_stats_collector_t::sample_blocking(sample_t *sample_out) {
+    sample_t previous;
+    {
+        spinlock_acq_t acq(&latest_sample_lock);
+        previous = latest_sample;
+    }
+    sample_out->time = clock_monotonic();
+
+    // The fields after the name, counting from 0 for the state; see proc(5).
+    std::vector<std::string> fields;
+    if (read_proc_self_stat(&fields) && fields.size() > 21) {
+        uint64_t utime, stime, majflt, num_threads, vsize, rss;
+        if (strtou64_strict(fields[9], 10, &majflt)
+            && strtou64_strict(fields[11], 10, &utime)
+            && strtou64_strict(fields[12], 10, &stime)
+            && strtou64_strict(fields[17], 10, &num_threads)
+            && strtou64_strict(fields[20], 10, &vsize)
+            && strtou64_strict(fields[21], 10, &rss)) {
+            sample_out->has_proc = true;
+            sample_out->cpu_ticks = utime + stime;
+            sample_out->major_page_faults = majflt;
+            sample_out->threads = num_threads;
+            sample_out->virtual_memory = vsize;
+            sample_out->resident_memory = rss * sysconf(_SC_PAGESIZE);
+            if (previous.has_proc && previous.cpu_ticks <= sample_out->cpu_ticks) {
+                const double elapsed_secs =
+                    (sample_out->time.tv_sec - previous.time.tv_sec)
+                    + (sample_out->time.tv_nsec - previous.time.tv_nsec)
+                        / static_cast<double>(BILLION);
+                if (elapsed_secs > 0) {
+                    sample_out->cpu_percent = 100.0
+                        * (sample_out->cpu_ticks - previous.cpu_ticks)
+                        / sysconf(_SC_CLK_TCK) / elapsed_secs;
+                }
+            }
+        }
+    }
+
+    const cgroup_limits_t limits = get_cgroup_limits();
+    sample_out->cgroup_cpu_quota = limits.cpu_quota;
+    sample_out->cgroup_memory_limit = limits.memory_limit;
+    const cgroup_usage_t usage = get_cgroup_usage();
+    sample_out->has_cgroup_memory = usage.has_memory;
+    sample_out->cgroup_memory_usage = usage.memory_usage;
+    sample_out->has_cgroup_throttling = usage.has_throttling;
+    sample_out->cgroup_throttled_periods = usage.throttled_periods;
+    sample_out->cgroup_throttled_usecs = usage.throttled_usecs;
+
+    for (size_t i = 0; i < counter_fds.size(); ++i) {
+        if (counter_fds[i].get() == INVALID_FD) {
+            continue;
+        }
+        uint64_t value;
+        if (read(counter_fds[i].get(), &value, sizeof(value)) == sizeof(value)) {
+            sample_out->has_counters = true;
+            sample_out->counters[i % NUM_COUNTERS] += value;
+        }
+    }
+}
+
+proc_stats_collector_t::instantaneous_stats_collector_t::instantaneous_stats_collector_t(
+        proc_stats_collector_t *_parent) :
+    parent(_parent) {
     struct timespec now = clock_monotonic();
     start_time = now.tv_sec;
 }
@@ -41,5 +226,49 @@ scoped_ptr_t<perfmon_result_t> proc_stats_collector_t::instantaneous_stats_colle
     result->insert("version", new perfmon_result_t(std::string(RETHINKDB_VERSION)));
     result->insert("pid", new perfmon_result_t(strprintf("%d", getpid())));
 
+    sample_t sample;
+    {
+        spinlock_acq_t acq(&parent->latest_sample_lock);
+        sample = parent->latest_sample;
+    }
+
+    if (sample.has_proc) {
+        result->insert("cpu_percent", new perfmon_result_t(strprintf("%.1f", sample.cpu_percent)));
+        result->insert("cpu_seconds", new perfmon_result_t(strprintf(
+            "%.2f", static_cast<double>(sample.cpu_ticks) / sysconf(_SC_CLK_TCK))));
+        result->insert("major_page_faults", new perfmon_result_t(strprintf("%" PRIu64, sample.major_page_faults)));
+        result->insert("threads", new perfmon_result_t(strprintf("%" PRIu64, sample.threads)));
+        result->insert("memory_virtual", new perfmon_result_t(strprintf("%" PRIu64, sample.virtual_memory)));
+        result->insert("memory_resident", new perfmon_result_t(strprintf("%" PRIu64, sample.resident_memory)));
+    }
+
+    if (sample.cgroup_cpu_quota > 0) {
+        result->insert("cgroup_cpu_quota", new perfmon_result_t(strprintf("%.2f", sample.cgroup_cpu_quota)));
+    }
+    if (sample.cgroup_memory_limit > 0) {
+        result->insert("cgroup_memory_limit", new perfmon_result_t(strprintf("%" PRIu64, sample.cgroup_memory_limit)));
+    }
+    if (sample.has_cgroup_memory) {
+        result->insert("cgroup_memory_usage", new perfmon_result_t(strprintf("%" PRIu64, sample.cgroup_memory_usage)));
+    }
+    if (sample.has_cgroup_throttling) {
+        result->insert("cgroup_throttled_periods", new perfmon_result_t(strprintf("%" PRIu64, sample.cgroup_throttled_periods)));
+        result->insert("cgroup_throttled_seconds", new perfmon_result_t(strprintf(
+            "%.3f", sample.cgroup_throttled_usecs / static_cast<double>(MILLION))));
+    }
+
+    if (sample.has_counters) {
+        const uint64_t instructions = sample.counters[COUNTER_INSTRUCTIONS];
+        const uint64_t cycles = sample.counters[COUNTER_CYCLES];
+        result->insert("instructions", new perfmon_result_t(strprintf("%" PRIu64, instructions)));
+        result->insert("cycles", new perfmon_result_t(strprintf("%" PRIu64, cycles)));
+        result->insert("cache_references", new perfmon_result_t(strprintf("%" PRIu64, sample.counters[COUNTER_CACHE_REFERENCES])));
+        result->insert("cache_misses", new perfmon_result_t(strprintf("%" PRIu64, sample.counters[COUNTER_CACHE_MISSES])));
+        if (cycles > 0) {
+            result->insert("instructions_per_cycle", new perfmon_result_t(strprintf(
+                "%.3f", static_cast<double>(instructions) / cycles)));
+        }
+    }
+
     return result;
 }
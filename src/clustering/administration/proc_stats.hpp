@@ -2,27 +2,88 @@
 #ifndef CLUSTERING_ADMINISTRATION_PROC_STATS_HPP_
 #define CLUSTERING_ADMINISTRATION_PROC_STATS_HPP_
 
+#include "arch/io/io_utils.hpp"
+#include "arch/spinlock.hpp"
+#include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "perfmon/perfmon.hpp"
 
-class proc_stats_collector_t : public home_thread_mixin_debug_only_t {
+/* Reports the process's resource use: what `/proc` says about it, what its
+cgroup allows it and how much of that it uses, and hardware counters for the
+server's threads where `perf_event_open()` lets us have them.  Reading all of
+that takes system calls and file reads, so it's sampled in the blocker pool every
+`SYSTEM_STATS_SAMPLE_INTERVAL_MS`, and a stats request gets the latest sample. */
+class proc_stats_collector_t : public home_thread_mixin_debug_only_t,
+                               private repeating_timer_callback_t {
 public:
     explicit proc_stats_collector_t(perfmon_collection_t *stats);
 
 private:
+    enum counter_t {
+        COUNTER_INSTRUCTIONS,
+        COUNTER_CYCLES,
+        COUNTER_CACHE_REFERENCES,
+        COUNTER_CACHE_MISSES,
+        NUM_COUNTERS
+    };
+
+    struct sample_t {
+        sample_t();
+
+        struct timespec time;
+
+        bool has_proc;
+        uint64_t cpu_ticks;
+        double cpu_percent;
+        uint64_t major_page_faults;
+        uint64_t threads;
+        uint64_t virtual_memory;
+        uint64_t resident_memory;
+
+        double cgroup_cpu_quota;
+        uint64_t cgroup_memory_limit;
+        bool has_cgroup_memory;
+        uint64_t cgroup_memory_usage;
+        bool has_cgroup_throttling;
+        uint64_t cgroup_throttled_periods;
+        uint64_t cgroup_throttled_usecs;
+
+        bool has_counters;
+        uint64_t counters[NUM_COUNTERS];
+    };
+
     class instantaneous_stats_collector_t : public perfmon_t {
     public:
-        instantaneous_stats_collector_t();
+        explicit instantaneous_stats_collector_t(proc_stats_collector_t *parent);
         void *begin_stats();
         void visit_stats(void *);
         scoped_ptr_t<perfmon_result_t> end_stats(void *);
     private:
+        proc_stats_collector_t *parent;
         ticks_t start_time;
     };
 
+    void on_ring();
+    void sample(auto_drainer_t::lock_t lock);
+    void sample_blocking(sample_t *sample_out);
+    void open_counters_on_thread(int thread);
+
+    // The `perf_event_open()` file descriptors, `NUM_COUNTERS` for each thread.
+    // They're invalid where the kernel didn't let us have the counter.
+    scoped_array_t<scoped_fd_t> counter_fds;
+
+    spinlock_t latest_sample_lock;
+    sample_t latest_sample;
+    bool sample_in_progress;
+
     instantaneous_stats_collector_t instantaneous_stats_collector;
 
     perfmon_multi_membership_t stats_membership;
+
+    auto_drainer_t drainer;
+    repeating_timer_t timer;
+
+    DISABLE_COPYING(proc_stats_collector_t);
 };
 
 #endif /* CLUSTERING_ADMINISTRATION_PROC_STATS_HPP_ */
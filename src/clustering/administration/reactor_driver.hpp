@@ -13,6 +13,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/reactor/blueprint.hpp"
 #include "concurrency/watchable.hpp"
+#include "perfmon/core.hpp"
 #include "rpc/semilattice/view.hpp"
 #include "serializer/serializer.hpp"
 #include "serializer/translator.hpp"
@@ -34,6 +35,11 @@ class stores_lifetimer_t {
 public:
     stores_lifetimer_t() { }
     ~stores_lifetimer_t() {
+        reset();
+    }
+
+    // Destroys the stores, and then the serializers they're on.
+    void reset() {
         if (stores_.has()) {
             for (int i = 0, e = stores_.size(); i < e; ++i) {
                 // TODO: This should use pmap.
@@ -41,21 +47,42 @@ public:
                 stores_[i].reset();
             }
         }
-        if (serializer_.has()) {
-            on_thread_t th(serializer_->home_thread());
-            serializer_.reset();
+        if (serializers_.has()) {
+            for (int i = 0, e = serializers_.size(); i < e; ++i) {
+                if (serializers_[i].has()) {
+                    on_thread_t th(serializers_[i]->home_thread());
+                    serializers_[i].reset();
+                }
+            }
             if (multiplexer_.has()) {
                 multiplexer_.reset();
             }
         }
+        serializers_.reset();
+        stores_.reset();
+        serializer_perfmon_memberships_.reset();
     }
 
-    scoped_ptr_t<serializer_t> *serializer() { return &serializer_; }
+    void swap(stores_lifetimer_t *other) {
+        serializer_perfmon_memberships_.swap(other->serializer_perfmon_memberships_);
+        serializers_.swap(other->serializers_);
+        multiplexer_.swap(other->multiplexer_);
+        stores_.swap(other->stores_);
+    }
+
+    // One serializer per file the table is striped across.
+    scoped_array_t<scoped_ptr_t<serializer_t> > *serializers() { return &serializers_; }
+    // The perfmon collections of the serializers that don't report into the table's
+    // own serializer collection.  These outlive the serializers.
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> > *serializer_perfmon_memberships() {
+        return &serializer_perfmon_memberships_;
+    }
     scoped_ptr_t<serializer_multiplexer_t> *multiplexer() { return &multiplexer_; }
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores() { return &stores_; }
 
 private:
-    scoped_ptr_t<serializer_t> serializer_;
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> > serializer_perfmon_memberships_;
+    scoped_array_t<scoped_ptr_t<serializer_t> > serializers_;
     scoped_ptr_t<serializer_multiplexer_t> multiplexer_;
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > stores_;
 
@@ -65,8 +92,11 @@ private:
 template <class protocol_t>
 class svs_by_namespace_t {
 public:
+    // `cpu_shards` is the number of stores the table should be split into.  If
+    // the table exists with a different number, its data is moved over to that
+    // many new stores first.
     virtual void get_svs(perfmon_collection_t *perfmon_collection, namespace_id_t namespace_id,
-                         int64_t cache_size,
+                         int64_t cache_size, int cpu_shards,
                          stores_lifetimer_t<protocol_t> *stores_out,
                          scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                          typename protocol_t::context_t *) = 0;
@@ -4,6 +4,7 @@
 
 #include "clustering/administration/reactor_driver.hpp"
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <utility>
@@ -117,16 +118,20 @@ public:
                             reactor_driver_t<protocol_t> *parent,
                             namespace_id_t namespace_id,
                             int64_t _cache_size,
+                            int _cpu_shards,
                             const blueprint_t<protocol_t> &bp,
                             svs_by_namespace_t<protocol_t> *svs_by_namespace,
-                            typename protocol_t::context_t *_ctx) :
+                            typename protocol_t::context_t *_ctx,
+                            watchable_and_reactor_t<protocol_t> *predecessor = NULL) :
         base_path(_base_path),
         watchable(bp),
         ctx(_ctx),
         parent_(parent),
         namespace_id_(namespace_id),
         svs_by_namespace_(svs_by_namespace),
-        cache_size(_cache_size)
+        predecessor_(predecessor),
+        cache_size(_cache_size),
+        cpu_shards(_cpu_shards)
     {
         coro_t::spawn_sometime(boost::bind(&watchable_and_reactor_t<protocol_t>::initialize_reactor, this, io_backender));
     }
@@ -276,6 +281,8 @@ public:
         return compute_write_durability(peer, namespace_id_, parent_->ack_info->per_thread_ack_info());
     }
 
+    int get_cpu_shards() const { return cpu_shards; }
+
 private:
     typedef boost::optional<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > >
         extract_reactor_directory_per_peer_result_type;
@@ -303,8 +310,13 @@ private:
         perfmon_collection_t *namespace_collection = &perfmon_collections->namespace_collection;
         perfmon_collection_t *serializers_collection = &perfmon_collections->serializers_collection;
 
+        // The reactor we replace has to let go of the table's files before we can
+        // open them.
+        predecessor_.reset();
+
         // TODO: We probably shouldn't have to pass in this perfmon collection.
-        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, &stores_lifetimer_, &svs_, ctx);
+        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size,
+                                   cpu_shards, &stores_lifetimer_, &svs_, ctx);
 
         auto const extract_reactor_directory_per_peer_fun =
             boost::bind(&watchable_and_reactor_t<protocol_t>::extract_reactor_directory_per_peer,
@@ -352,12 +364,17 @@ private:
     const namespace_id_t namespace_id_;
     svs_by_namespace_t<protocol_t> *const svs_by_namespace_;
 
+    // The reactor this one replaces because the table's `cpu_shards` changed.  We
+    // destroy it when we start up.
+    scoped_ptr_t<watchable_and_reactor_t<protocol_t> > predecessor_;
+
     stores_lifetimer_t<protocol_t> stores_lifetimer_;
     scoped_ptr_t<multistore_ptr_t<protocol_t> > svs_;
     scoped_ptr_t<reactor_t<protocol_t> > reactor_;
 
     scoped_ptr_t<typename watchable_t<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > >::subscription_t> reactor_directory_subscription_;
     int64_t cache_size;
+    const int cpu_shards;
 
     DISABLE_COPYING(watchable_and_reactor_t);
 };
@@ -516,7 +533,17 @@ void reactor_driver_t<protocol_t>::on_change() {
                 /* Either construct a new reactor (if this is a namespace we
                  * haven't seen before). Or send the new blueprint to the
                  * existing reactor. */
-                if (!std_contains(reactor_data, it->first)) {
+                int cpu_shards;
+                if (it->second.get_ref().cpu_shards.in_conflict()) {
+                    cpu_shards = CPU_SHARDING_FACTOR;
+                } else {
+                    cpu_shards = it->second.get_ref().cpu_shards.get();
+                }
+                cpu_shards = std::min(std::max(cpu_shards, 1), MAX_CPU_SHARDING_FACTOR);
+
+                typename reactor_map_t::iterator existing = reactor_data.find(it->first);
+                if (existing == reactor_data.end()
+                    || existing->second->get_cpu_shards() != cpu_shards) {
                     int64_t cache_size;
                     if (it->second.get_ref().cache_size.in_conflict()) {
                         cache_size = GIGABYTE;
@@ -538,8 +565,16 @@ void reactor_driver_t<protocol_t>::on_change() {
                                 it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str());
                     }
 
+                    /* If the table's `cpu_shards` changed, the new reactor takes
+                    over the old one and destroys it before it opens the table,
+                    which then gets split into the new number of stores. */
+                    watchable_and_reactor_t<protocol_t> *predecessor = NULL;
+                    if (existing != reactor_data.end()) {
+                        predecessor = reactor_data.release(existing).release();
+                    }
+
                     namespace_id_t tmp = it->first;
-                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, bp, svs_by_namespace, ctx));
+                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, cpu_shards, bp, svs_by_namespace, ctx, predecessor));
                 } else {
                     struct op_closure_t {
                         static bool apply(const blueprint_t<protocol_t> &_bp,
@@ -552,7 +587,7 @@ void reactor_driver_t<protocol_t>::on_change() {
                         }
                     };
 
-                    reactor_data.find(it->first)->second->watchable.apply_atomic_op(std::bind(&op_closure_t::apply, std::ref(bp), std::placeholders::_1));
+                    existing->second->watchable.apply_atomic_op(std::bind(&op_closure_t::apply, std::ref(bp), std::placeholders::_1));
                 }
             } else {
                 /* The blueprint does not mentions us so we destroy the
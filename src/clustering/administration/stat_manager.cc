@@ -4,12 +4,14 @@
 
 #include "clustering/administration/stat_manager.hpp"
 #include "concurrency/watchable.hpp"
+#include "config/args.hpp"
 #include "perfmon/collect.hpp"
 #include "perfmon/archive.hpp"
 #include "stl_utils.hpp"
 
 stat_manager_t::stat_manager_t(mailbox_manager_t* mm) :
     mailbox_manager(mm),
+    digest_time(0),
     get_stats_mailbox(mailbox_manager, boost::bind(&stat_manager_t::on_stats_request, this, _1, _2))
     { }
 
@@ -21,9 +23,19 @@ void stat_manager_t::on_stats_request(const return_address_t& reply_address, con
     coro_t::spawn_sometime(boost::bind(&stat_manager_t::perform_stats_request, this, reply_address, requested_stats, auto_drainer_t::lock_t(&drainer)));
 }
 
+scoped_ptr_t<perfmon_result_t> stat_manager_t::get_digest() {
+    mutex_t::acq_t acq(&digest_mutex);
+    if (!digest.has()
+        || current_microtime() > digest_time + STATS_DIGEST_MAX_AGE_MS * THOUSAND) {
+        digest = perfmon_get_stats();
+        digest_time = current_microtime();
+    }
+    return make_scoped<perfmon_result_t>(*digest);
+}
+
 void stat_manager_t::perform_stats_request(const return_address_t& reply_address, const std::set<std::string>& requested_stats, auto_drainer_t::lock_t) {
     perfmon_filter_t request(requested_stats);
-    scoped_ptr_t<perfmon_result_t> perfmon_result(perfmon_get_stats());
+    scoped_ptr_t<perfmon_result_t> perfmon_result = get_digest();
     request.filter(&perfmon_result);
     guarantee(perfmon_result.has());
     send(mailbox_manager, reply_address, *perfmon_result);
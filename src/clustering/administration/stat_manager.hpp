@@ -6,9 +6,17 @@
 #include <map>
 #include <set>
 
+#include "concurrency/mutex.hpp"
+#include "containers/scoped.hpp"
 #include "perfmon/types.hpp"
 #include "rpc/mailbox/typed.hpp"
 
+/* `stat_manager_t` answers other servers' requests for this server's stats.
+Collecting the stats takes a trip to every thread, so it keeps the stats it
+collected last as a digest and answers the requests that come within
+`STATS_DIGEST_MAX_AGE_MS` of it from the digest.  However many servers poll the
+stats, they are collected at most once per interval, and not at all while
+nobody polls them. */
 class stat_manager_t {
 public:
     typedef std::string stat_id_t;
@@ -24,7 +32,16 @@ private:
     void on_stats_request(const return_address_t& reply_address, const std::set<stat_id_t>& requested_stats);
     void perform_stats_request(const return_address_t& reply_address, const std::set<stat_id_t>& requested_stats, auto_drainer_t::lock_t);
 
+    /* Returns a copy of the digest, first collecting the stats again if it's too
+    old.  Only one request collects them at a time; the others wait for it. */
+    scoped_ptr_t<perfmon_result_t> get_digest();
+
     mailbox_manager_t *mailbox_manager;
+
+    mutex_t digest_mutex;
+    scoped_ptr_t<perfmon_result_t> digest;
+    microtime_t digest_time;
+
     get_stats_mailbox_t get_stats_mailbox;
 
     auto_drainer_t drainer;
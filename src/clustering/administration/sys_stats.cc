@@ -3,39 +3,68 @@
 
 #include <sys/statvfs.h>
 
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/types.hpp"
+#include "config/args.hpp"
 #include "errors.hpp"
 
-struct disk_stat_t {
-    int64_t disk_space_free;
-    int64_t disk_space_used;
-    int64_t disk_space_total;
+sys_stats_collector_t::disk_stat_t::disk_stat_t() :
+    disk_space_free(-1), disk_space_used(-1), disk_space_total(-1) { }
 
-    explicit disk_stat_t(const std::string &filepath) {
-        int res;
-        // get disk space data using statvfs
-        struct statvfs fsdata;
+sys_stats_collector_t::sys_stats_collector_t(const base_path_t &path, perfmon_collection_t *stats) :
+    base_path(path),
+    sample_in_progress(false),
+    instantaneous_stats_collector(this),
+    stats_membership(stats, &instantaneous_stats_collector, NULL),
+    timer(SYSTEM_STATS_SAMPLE_INTERVAL_MS, this) {
+    // So that there's something to report before the timer first goes off.
+    disk_stat_t first;
+    thread_pool_t::run_in_blocker_pool(std::bind(&sys_stats_collector_t::sample_blocking,
+                                                 this, &first));
+    spinlock_acq_t acq(&latest_stat_lock);
+    latest_stat = first;
+}
 
-        res = statvfs(filepath.c_str(), &fsdata);
+void sys_stats_collector_t::on_ring() {
+    assert_thread();
+    if (!sample_in_progress) {
+        sample_in_progress = true;
+        coro_t::spawn_sometime(std::bind(&sys_stats_collector_t::sample,
+                                         this, drainer.lock()));
+    }
+}
 
-        if (res < 0) {
-            disk_space_total = -1;
-            disk_space_free = -1;
-            disk_space_used = -1;
-        }
+void sys_stats_collector_t::sample(auto_drainer_t::lock_t) {
+    disk_stat_t stat;
+    thread_pool_t::run_in_blocker_pool(std::bind(&sys_stats_collector_t::sample_blocking,
+                                                 this, &stat));
+    {
+        spinlock_acq_t acq(&latest_stat_lock);
+        latest_stat = stat;
+    }
+    sample_in_progress = false;
+}
 
-        disk_space_total = fsdata.f_bsize * fsdata.f_blocks;
-        disk_space_free = fsdata.f_bsize * fsdata.f_bfree;
-        disk_space_used = disk_space_total - disk_space_free;
+void sys_stats_collector_t::sample_blocking(disk_stat_t *stat_out) {
+    // get disk space data using statvfs
+    struct statvfs fsdata;
+    int res = statvfs(base_path.path().c_str(), &fsdata);
+    if (res < 0) {
+        // Leave them at -1.
+        return;
     }
-};
 
-sys_stats_collector_t::sys_stats_collector_t(const base_path_t &path, perfmon_collection_t *stats) :
-    instantaneous_stats_collector(path),
-    stats_membership(stats, &instantaneous_stats_collector, NULL) {
+    stat_out->disk_space_total = fsdata.f_bsize * fsdata.f_blocks;
+    stat_out->disk_space_free = fsdata.f_bsize * fsdata.f_bfree;
+    stat_out->disk_space_used = stat_out->disk_space_total - stat_out->disk_space_free;
 }
 
-sys_stats_collector_t::instantaneous_stats_collector_t::instantaneous_stats_collector_t(const base_path_t &path) :
-    base_path(path) {
+sys_stats_collector_t::instantaneous_stats_collector_t::instantaneous_stats_collector_t(
+        sys_stats_collector_t *_parent) :
+    parent(_parent) {
 }
 
 void *sys_stats_collector_t::instantaneous_stats_collector_t::begin_stats() {
@@ -48,7 +77,11 @@ scoped_ptr_t<perfmon_result_t>
 sys_stats_collector_t::instantaneous_stats_collector_t::end_stats(void *) {
     scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
 
-    disk_stat_t disk_stat(base_path.path());
+    disk_stat_t disk_stat;
+    {
+        spinlock_acq_t acq(&parent->latest_stat_lock);
+        disk_stat = parent->latest_stat;
+    }
     result->insert("global_disk_space_free", new perfmon_result_t(strprintf("%" PRIi64, disk_stat.disk_space_free)));
     result->insert("global_disk_space_used", new perfmon_result_t(strprintf("%" PRIi64, disk_stat.disk_space_used)));
     result->insert("global_disk_space_total", new perfmon_result_t(strprintf("%" PRIi64, disk_stat.disk_space_total)));
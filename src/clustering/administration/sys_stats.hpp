@@ -4,32 +4,58 @@
 
 #include <string>
 
+#include "arch/spinlock.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "perfmon/perfmon.hpp"
 
 /* Class to get system statistics, such as disk space usage.
-Similar to proc_stats_collector_t, but not based on /proc. */
+Similar to proc_stats_collector_t, but not based on /proc.  Like it, it samples
+them in the blocker pool every `SYSTEM_STATS_SAMPLE_INTERVAL_MS`, because
+`statvfs()` can block for a while on a busy or remote filesystem. */
 
-class sys_stats_collector_t : public home_thread_mixin_debug_only_t {
+class sys_stats_collector_t : public home_thread_mixin_debug_only_t,
+                              private repeating_timer_callback_t {
 public:
     sys_stats_collector_t(const base_path_t &path, perfmon_collection_t *stats);
 
 private:
+    struct disk_stat_t {
+        disk_stat_t();
+        int64_t disk_space_free;
+        int64_t disk_space_used;
+        int64_t disk_space_total;
+    };
+
     // similar to proc_stats_collector_t::instantaneous_stats_collector_t
     class instantaneous_stats_collector_t : public perfmon_t {
     public:
-        explicit instantaneous_stats_collector_t(const base_path_t &path);
+        explicit instantaneous_stats_collector_t(sys_stats_collector_t *parent);
         void *begin_stats();
         void visit_stats(void *);
         scoped_ptr_t<perfmon_result_t> end_stats(void *);
     private:
-        const base_path_t base_path;
+        sys_stats_collector_t *parent;
 
         DISABLE_COPYING(instantaneous_stats_collector_t);
     };
 
+    void on_ring();
+    void sample(auto_drainer_t::lock_t lock);
+    void sample_blocking(disk_stat_t *stat_out);
+
+    const base_path_t base_path;
+
+    spinlock_t latest_stat_lock;
+    disk_stat_t latest_stat;
+    bool sample_in_progress;
+
     instantaneous_stats_collector_t instantaneous_stats_collector;
     perfmon_membership_t stats_membership;
 
+    auto_drainer_t drainer;
+    repeating_timer_t timer;
+
     DISABLE_COPYING(sys_stats_collector_t);
 };
 
@@ -0,0 +1,48 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/immediate_consistency/branch/backfill_throttle.hpp"
+
+#include <algorithm>
+
+#include "arch/timing.hpp"
+#include "config/args.hpp"
+
+static int64_t backfill_bandwidth_limit = 0;
+
+/* When, in microseconds, the budget has room for the next chunk. Every caller of
+`wait_for_backfill_bandwidth()` moves it forward by the time its bytes take at
+the limit. */
+static volatile int64_t backfill_next_send_time = 0;
+
+void set_backfill_bandwidth_limit(int64_t bytes_per_sec) {
+    guarantee(bytes_per_sec >= 0);
+    backfill_bandwidth_limit = bytes_per_sec;
+    backfill_next_send_time = 0;
+}
+
+bool backfill_bandwidth_is_limited() {
+    return backfill_bandwidth_limit != 0;
+}
+
+void wait_for_backfill_bandwidth(int64_t bytes, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    const int64_t limit = backfill_bandwidth_limit;
+    if (limit == 0) {
+        return;
+    }
+
+    const int64_t now = current_microtime();
+    const int64_t duration = bytes * MILLION / limit;
+    int64_t start;
+    for (;;) {
+        const int64_t next = backfill_next_send_time;
+        // Budget that went unused recently may be spent in a burst.
+        start = std::max<int64_t>(next, now - BACKFILL_BANDWIDTH_BURST_MS * THOUSAND);
+        if (__sync_bool_compare_and_swap(&backfill_next_send_time, next, start + duration)) {
+            break;
+        }
+    }
+
+    if (start > now) {
+        nap((start - now) / THOUSAND, interruptor);
+    }
+}
@@ -0,0 +1,25 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_BACKFILL_THROTTLE_HPP_
+#define CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_BACKFILL_THROTTLE_HPP_
+
+#include <stdint.h>
+
+#include "utils.hpp"
+
+class signal_t;
+
+/* The backfillers of all tables on this node share one budget for how many bytes
+of backfill chunks they send per second, so that bringing a new replica up to
+date doesn't crowd out query traffic. There's no limit unless
+`set_backfill_bandwidth_limit()` is called with a non-zero value, which should
+happen before any backfills start. */
+void set_backfill_bandwidth_limit(int64_t bytes_per_sec);
+bool backfill_bandwidth_is_limited();
+
+/* Waits until the budget allows sending `bytes` more bytes, and spends them.
+Callers that wait at the same time, on any thread, are spaced out so that
+together they stay within the budget. */
+void wait_for_backfill_bandwidth(int64_t bytes, signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t);
+
+#endif  // CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_BACKFILL_THROTTLE_HPP_
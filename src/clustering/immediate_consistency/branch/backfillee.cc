@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 
+#include "btree/keys.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
@@ -8,6 +9,8 @@
 #include "concurrency/promise.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
 #include "containers/death_runner.hpp"
+#include "containers/uuid.hpp"
+#include "hash_region.hpp"
 
 #define ALLOCATION_CHUNK 50
 
@@ -142,8 +145,10 @@ void receive_end_point_message(promise_t<std::pair<region_map_t<protocol_t, vers
     promise->pulse(std::make_pair(end_point, associated_branch_history));
 }
 
+/* Backfills `region` in one go, and sets its metainfo to the backfiller's version
+of it when it's done. */
 template<class protocol_t>
-void backfillee(
+void backfill_pass(
         mailbox_manager_t *mailbox_manager,
         branch_history_manager_t<protocol_t> *branch_history_manager,
         store_view_t<protocol_t> *svs,
@@ -319,7 +324,10 @@ void backfillee(
 
         chunk_callback_t<protocol_t> chunk_callback(svs, &chunk_queue, mailbox_manager, allocation_mailbox);
 
-        coro_pool_t<backfill_queue_entry_t<protocol_t> > backfill_workers(10, &chunk_queue, &chunk_callback);
+        /* How many chunks we can apply at once depends on the store and on what
+        else is going on, so let the pool find out. */
+        coro_pool_t<backfill_queue_entry_t<protocol_t> > backfill_workers(
+            adaptive_concurrency_params_t(2, 10, 64), &chunk_queue, &chunk_callback);
 
         /* Now wait for the backfill to be over */
         {
@@ -348,6 +356,78 @@ void backfillee(
         interruptor);
 }
 
+/* For protocols whose regions we don't know how to split, `backfillee()`
+backfills the whole region in one go. */
+template <class region_t>
+std::vector<region_t> backfill_checkpoint_subregions(const region_t &region) {
+    return std::vector<region_t>(1, region);
+}
+
+/* Splits the keys of `region` into up to `BACKFILL_CHECKPOINT_SUBRANGES` ranges by
+their first byte. We don't know how the keys are distributed, so some of the
+ranges may hold more of them than others. */
+std::vector<hash_region_t<key_range_t> > backfill_checkpoint_subregions(
+        const hash_region_t<key_range_t> &region) {
+    const key_range_t &range = region.inner;
+    const int lo = range.left.size() == 0 ? 0 : range.left.contents()[0];
+    int hi = 256;
+    if (!range.right.unbounded) {
+        hi = range.right.key.size() == 0 ? 0 : range.right.key.contents()[0];
+    }
+
+    std::vector<hash_region_t<key_range_t> > subregions;
+    store_key_t left = range.left;
+    int last_boundary = lo;
+    for (int i = 1; i < BACKFILL_CHECKPOINT_SUBRANGES; ++i) {
+        const int boundary = lo + (hi - lo) * i / BACKFILL_CHECKPOINT_SUBRANGES;
+        if (boundary > last_boundary && boundary < hi) {
+            const uint8_t byte = boundary;
+            store_key_t right(1, &byte);
+            subregions.push_back(hash_region_t<key_range_t>(region.beg, region.end,
+                key_range_t(key_range_t::closed, left, key_range_t::open, right)));
+            left = right;
+            last_boundary = boundary;
+        }
+    }
+    subregions.push_back(hash_region_t<key_range_t>(region.beg, region.end,
+        key_range_t(key_range_t::closed, left,
+                    range.right.unbounded ? key_range_t::none : key_range_t::open,
+                    range.right.unbounded ? store_key_t() : range.right.key)));
+    return subregions;
+}
+
+template<class protocol_t>
+void backfillee(
+        mailbox_manager_t *mailbox_manager,
+        branch_history_manager_t<protocol_t> *branch_history_manager,
+        store_view_t<protocol_t> *svs,
+        typename protocol_t::region_t region,
+        clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > backfiller_metadata,
+        backfill_session_id_t backfill_session_id,
+        signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
+{
+    /* Backfill the region one range of keys at a time first. Every pass leaves the
+    version of its range in the metainfo, so if we're interrupted, the next
+    backfill only has to catch up on what changed in the ranges we're done with.
+    The passes each see the backfiller's data at a different time, so a last pass
+    over the whole region brings all of it to the same version. That pass only
+    sends what changed since the earlier ones. */
+    std::vector<typename protocol_t::region_t> subregions =
+        backfill_checkpoint_subregions(region);
+    if (subregions.size() > 1) {
+        for (size_t i = 0; i < subregions.size(); ++i) {
+            /* The backfiller might not be done with the previous pass's session
+            yet, so every pass gets its own. */
+            backfill_pass<protocol_t>(mailbox_manager, branch_history_manager, svs,
+                                      subregions[i], backfiller_metadata,
+                                      generate_uuid(), interruptor);
+        }
+    }
+    backfill_pass<protocol_t>(mailbox_manager, branch_history_manager, svs, region,
+                              backfiller_metadata, backfill_session_id, interruptor);
+}
+
 
 #include "memcached/protocol.hpp"
 #include "mock/dummy_protocol.hpp"
@@ -11,7 +11,9 @@ template <class> class clone_ptr_t;
 template <class> class watchable_t;
 
 /* `backfillee()` contacts the given backfiller and requests a backfill from it.
-It takes responsibility for updating the metainfo. */
+It takes responsibility for updating the metainfo. The metainfo records how far
+the backfill got, so if it's interrupted, running it again picks up where it
+left off instead of starting over. */
 
 template<class protocol_t>
 void backfillee(
@@ -30,7 +32,8 @@ void backfillee(
 
         /* Newly-generated unique ID. The reason this is passed in rather than
         being generated by `backfillee()` is so that we can later identify this
-        backfill for progress-checking purposes. */
+        backfill for progress-checking purposes. Progress is only reported for
+        the last pass of the backfill, which goes over all of `region`. */
         backfill_session_id_t backfill_session_id,
 
         signal_t *interruptor)
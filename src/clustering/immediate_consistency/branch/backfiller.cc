@@ -2,7 +2,9 @@
 #include "clustering/immediate_consistency/branch/backfiller.hpp"
 
 #include "btree/parallel_traversal.hpp"
+#include "clustering/immediate_consistency/branch/backfill_throttle.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
+#include "concurrency/background_governor.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/semaphore.hpp"
 #include "rpc/semilattice/view.hpp"
@@ -93,6 +95,12 @@ void do_send_chunk(mailbox_manager_t *mbox_manager,
                    semaphore_t *chunk_semaphore,
                    signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
     chunk_semaphore->co_lock_interruptible(interruptor);
+    wait_for_background_turn(interruptor);
+    if (backfill_bandwidth_is_limited()) {
+        write_message_t msg;
+        msg << chunk;
+        wait_for_backfill_bandwidth(msg.size(), interruptor);
+    }
     send(mbox_manager, chunk_addr, chunk, fifo_src->enter_write());
 }
 
@@ -18,7 +18,8 @@
 #include "rpc/semilattice/view/member.hpp"
 
 template <class protocol_t>
-broadcaster_t<protocol_t>::write_callback_t::write_callback_t() : write(NULL) { }
+broadcaster_t<protocol_t>::write_callback_t::write_callback_t()
+    : write(NULL), timestamp(state_timestamp_t::zero()) { }
 
 template <class protocol_t>
 broadcaster_t<protocol_t>::write_callback_t::~write_callback_t() {
@@ -193,6 +194,24 @@ private:
     boost::shared_ptr<incomplete_write_t> write;
 };
 
+/* A write that's waiting in a mirror's batch, or that has been sent to the mirror
+   in a batch but hasn't been acked yet. */
+template <class protocol_t>
+class broadcaster_t<protocol_t>::writeread_batch_entry_t {
+public:
+    writeread_batch_entry_t(const incomplete_write_ref_t &_write_ref,
+                            order_token_t _order_token,
+                            fifo_enforcer_write_token_t _fifo_token,
+                            write_durability_t _durability)
+        : write_ref(_write_ref), order_token(_order_token),
+          fifo_token(_fifo_token), durability(_durability) { }
+
+    incomplete_write_ref_t write_ref;
+    order_token_t order_token;
+    fifo_enforcer_write_token_t fifo_token;
+    write_durability_t durability;
+};
+
 /* The `registrar_t` constructs a `dispatchee_t` for every mirror that
    connects to us. */
 
@@ -201,6 +220,7 @@ class broadcaster_t<protocol_t>::dispatchee_t : public intrusive_list_node_t<dis
 public:
     dispatchee_t(broadcaster_t *c, listener_business_card_t<protocol_t> d) THROWS_NOTHING :
         write_mailbox(d.write_mailbox), is_readable(false),
+        writeread_batch_flush_scheduled(false),
         queue_count(),
         queue_count_membership(&c->broadcaster_collection, &queue_count, uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_broadcast_queue_count"),
         background_write_queue(&queue_count),
@@ -309,6 +329,11 @@ public:
     // TODO: Is something wrong with the ordering guarantees between background writes and other writes?
     order_source_t order_source;
 
+    /* Writes to send with the next writeread batch, and whether a coroutine to
+    send it has been spawned yet. */
+    std::vector<writeread_batch_entry_t> writeread_batch;
+    bool writeread_batch_flush_scheduled;
+
     perfmon_counter_t queue_count;
     perfmon_membership_t queue_count_membership;
     unlimited_fifo_queue_t<boost::function<void()> > background_write_queue;
@@ -421,6 +446,7 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
     guarantee(cb->write == NULL);
 
     cb->write = write_wrapper.get();
+    cb->timestamp = current_timestamp;
 
     /* Create a reference so that `write` doesn't declare itself
     complete before we've even started */
@@ -452,8 +478,15 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
                 unreachable();
             }
 
-            it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread, this,
-                it->first, it->second, write_ref, order_token, fifo_enforcer_token, durability));
+            it->first->writeread_batch.push_back(writeread_batch_entry_t(
+                write_ref, order_token, fifo_enforcer_token, durability));
+            if (it->first->writeread_batch.size() >= BROADCASTER_WRITE_BATCH_MAX_SIZE) {
+                flush_writeread_batch(it->first, it->second);
+            } else if (!it->first->writeread_batch_flush_scheduled) {
+                it->first->writeread_batch_flush_scheduled = true;
+                coro_t::spawn_sometime(boost::bind(&broadcaster_t::flush_writeread_batch_later, this,
+                    it->first, it->second));
+            }
         } else {
             it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_write, this,
                 it->first, it->second, write_ref, order_token, fifo_enforcer_token));
@@ -512,25 +545,71 @@ void broadcaster_t<protocol_t>::background_write(dispatchee_t *mirror, auto_drai
 }
 
 template<class protocol_t>
-void broadcaster_t<protocol_t>::background_writeread(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock, incomplete_write_ref_t write_ref, order_token_t order_token, fifo_enforcer_write_token_t token, const write_durability_t durability) THROWS_NOTHING {
+void broadcaster_t<protocol_t>::flush_writeread_batch(dispatchee_t *mirror, const auto_drainer_t::lock_t &mirror_lock) THROWS_NOTHING {
+    ASSERT_FINITE_CORO_WAITING;
+    if (mirror->writeread_batch.empty()) {
+        return;
+    }
+    boost::shared_ptr<std::vector<writeread_batch_entry_t> > batch
+        = boost::make_shared<std::vector<writeread_batch_entry_t> >();
+    batch->swap(mirror->writeread_batch);
+    mirror->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread_batch, this,
+        mirror, mirror_lock, batch));
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::flush_writeread_batch_later(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock) THROWS_NOTHING {
+    DEBUG_VAR mutex_assertion_t::acq_t mutex_acq(&mutex);
+    mirror->writeread_batch_flush_scheduled = false;
+    flush_writeread_batch(mirror, mirror_lock);
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::background_writeread_batch(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock, boost::shared_ptr<std::vector<writeread_batch_entry_t> > batch) THROWS_NOTHING {
     try {
-        cond_t response_cond;
-        typename protocol_t::write_response_t response;
-        mailbox_t<void(typename protocol_t::write_response_t)> response_mailbox(
+        std::vector<listener_writeread_t<protocol_t> > writes;
+        writes.reserve(batch->size());
+        for (auto it = batch->begin(); it != batch->end(); ++it) {
+            writes.push_back(listener_writeread_t<protocol_t>(
+                it->write_ref.get()->write, it->write_ref.get()->timestamp,
+                it->order_token, it->fifo_token, it->durability));
+        }
+
+        size_t responses_left = batch->size();
+        cond_t done_cond;
+        mailbox_t<void(typename listener_business_card_t<protocol_t>::writeread_acks_t)> response_mailbox(
             mailbox_manager,
-            boost::bind(&store_listener_response<typename protocol_t::write_response_t>, &response, _1, &response_cond));
+            boost::bind(&broadcaster_t::on_writeread_response, this,
+                        mirror, batch.get(), &responses_left, &done_cond, _1));
 
-        send(mailbox_manager, mirror->writeread_mailbox, write_ref.get()->write, write_ref.get()->timestamp, order_token, token, response_mailbox.get_address(), durability);
+        send(mailbox_manager, mirror->writeread_mailbox, writes, response_mailbox.get_address());
 
-        wait_interruptible(&response_cond, mirror_lock.get_drain_signal());
+        wait_interruptible(&done_cond, mirror_lock.get_drain_signal());
+    } catch (const interrupted_exc_t &) {
+        return;
+    }
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::on_writeread_response(dispatchee_t *mirror, std::vector<writeread_batch_entry_t> *batch, size_t *responses_left, cond_t *done, const typename listener_business_card_t<protocol_t>::writeread_acks_t &acks) THROWS_NOTHING {
+    /* The writes that wanted hard durability are acked all at once, so they
+    all reach the ack checker at once too. */
+    for (auto it = acks.begin(); it != acks.end(); ++it) {
+        guarantee(it->first < batch->size());
+        writeread_batch_entry_t *entry = &(*batch)[it->first];
+        guarantee(entry->write_ref.get(), "Got two responses to the same write.");
 
         // TODO: Require that everybody provide a callback.
-        if (write_ref.get()->callback) {
-            write_ref.get()->callback->on_response(mirror->get_peer(), response);
+        if (entry->write_ref.get()->callback) {
+            entry->write_ref.get()->callback->on_response(mirror->get_peer(), it->second);
         }
 
-    } catch (const interrupted_exc_t &) {
-        return;
+        /* The write is complete on this mirror even if others in its batch aren't. */
+        entry->write_ref = incomplete_write_ref_t();
+        --*responses_left;
+    }
+    if (*responses_left == 0) {
+        done->pulse();
     }
 }
 
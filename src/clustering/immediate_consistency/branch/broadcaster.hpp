@@ -46,6 +46,10 @@ public:
             const typename protocol_t::write_response_t &response) = 0;
         virtual void on_done() = 0;
 
+        /* The timestamp the write leaves the branch at. Valid once
+        `spawn_write()` has returned. */
+        state_timestamp_t get_timestamp() const { return timestamp; }
+
     protected:
         virtual ~write_callback_t();
 
@@ -54,6 +58,7 @@ public:
         /* This is so that if the write callback is destroyed before `on_done()`
         is called, it will get deregistered. */
         incomplete_write_t *write;
+        state_timestamp_t timestamp;
     };
 
     broadcaster_t(
@@ -94,6 +99,8 @@ public:
 private:
     class incomplete_write_ref_t;
 
+    class writeread_batch_entry_t;
+
     class dispatchee_t;
 
     /* Reads need to pick a single readable mirror to perform the operation.
@@ -114,10 +121,23 @@ private:
         dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
         incomplete_write_ref_t write_ref, order_token_t order_token,
         fifo_enforcer_write_token_t token) THROWS_NOTHING;
-    void background_writeread(
+
+    /* Writes to readable mirrors aren't sent one at a time. `spawn_write()` adds
+    them to the mirror's batch, and the batch is sent as one message when the
+    coroutines that are running right now are done, or when it's full. You must
+    hold `mutex` to call `flush_writeread_batch()`. */
+    void flush_writeread_batch(
+        dispatchee_t *mirror, const auto_drainer_t::lock_t &mirror_lock) THROWS_NOTHING;
+    void flush_writeread_batch_later(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock) THROWS_NOTHING;
+    void background_writeread_batch(
         dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
-        incomplete_write_ref_t write_ref, order_token_t order_token,
-        fifo_enforcer_write_token_t token, write_durability_t durability) THROWS_NOTHING;
+        boost::shared_ptr<std::vector<writeread_batch_entry_t> > batch) THROWS_NOTHING;
+    void on_writeread_response(
+        dispatchee_t *mirror, std::vector<writeread_batch_entry_t> *batch,
+        size_t *responses_left, cond_t *done,
+        const typename listener_business_card_t<protocol_t>::writeread_acks_t &acks)
+        THROWS_NOTHING;
     void end_write(boost::shared_ptr<incomplete_write_t> write) THROWS_NOTHING;
 
     void single_read(
@@ -1,6 +1,11 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/listener.hpp"
 
+#include <functional>
+
+#include "errors.hpp"
+#include <boost/make_shared.hpp>
+
 #include "clustering/generic/registrant.hpp"
 #include "clustering/generic/resource.hpp"
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
@@ -69,6 +74,8 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     uuid_(generate_uuid()),
     perfmon_collection_(),
     perfmon_collection_membership_(backfill_stats_parent, &perfmon_collection_, "backfill-serialization-" + uuid_to_str(uuid_)),
+    pm_coalesced_writes_(),
+    pm_coalesced_writes_membership_(&perfmon_collection_, &pm_coalesced_writes_, "coalesced_writes"),
     /* TODO: Put the file in the data directory, not here */
     write_queue_(io_backender,
                  serializer_filepath_t(base_path, "backfill-serialization-" + uuid_to_str(uuid_)),
@@ -78,7 +85,7 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     write_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
     writeread_mailbox_(mailbox_manager_,
-        boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
+        boost::bind(&listener_t::on_writeread, this, _1, _2)),
     read_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_read, this, _1, _2, _3, _4, _5))
 {
@@ -240,6 +247,8 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     uuid_(generate_uuid()),
     perfmon_collection_(),
     perfmon_collection_membership_(backfill_stats_parent, &perfmon_collection_, "backfill-serialization-" + uuid_to_str(uuid_)),
+    pm_coalesced_writes_(),
+    pm_coalesced_writes_membership_(&perfmon_collection_, &pm_coalesced_writes_, "coalesced_writes"),
     /* TODO: Put the file in the data directory, not here */
     write_queue_(io_backender, serializer_filepath_t(base_path, "backfill-serialization-" + uuid_to_str(uuid_)), &perfmon_collection_),
     write_queue_semaphore_(WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY,
@@ -247,7 +256,7 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     write_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
     writeread_mailbox_(mailbox_manager_,
-        boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
+        boost::bind(&listener_t::on_writeread, this, _1, _2)),
     read_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_read, this, _1, _2, _3, _4, _5))
 {
@@ -414,6 +423,11 @@ void listener_t<protocol_t>::enqueue_write(const typename protocol_t::write_t &w
         write_queue_semaphore_.co_lock_interruptible(keepalive.get_drain_signal());
         write_queue_.push(write_queue_entry_t(write, transition_timestamp, order_token, fifo_token));
 
+        typename protocol_t::region_t overwritten_region;
+        if (write.get_overwritten_region(&overwritten_region)) {
+            queued_overwrites_[overwritten_region] = transition_timestamp.timestamp_before();
+        }
+
         send(mailbox_manager_, ack_addr);
 
     } catch (const interrupted_exc_t &) {
@@ -430,6 +444,26 @@ void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &q
         write_queue_has_drained_.pulse_if_not_already_pulsed();
     }
 
+    /* If a later write in the queue overwrites everything this one does, we don't
+    need to apply this one. We still have to let it through `store_entrance_sink_`
+    and advance the timestamp. The metainfo will briefly claim a version whose
+    write we skipped, but only for keys that a queued write is about to set.
+    Nobody reads from us while we're draining the queue, and if we go away before
+    we're done, a backfill from the metainfo's version resends those keys, because
+    they changed after it. */
+    bool superseded = false;
+    typename protocol_t::region_t overwritten_region;
+    if (!queued_overwrites_.empty() && qe.write.get_overwritten_region(&overwritten_region)) {
+        auto it = queued_overwrites_.find(overwritten_region);
+        if (it != queued_overwrites_.end()) {
+            if (qe.transition_timestamp.timestamp_before() < it->second) {
+                superseded = true;
+            } else {
+                queued_overwrites_.erase(it);
+            }
+        }
+    }
+
     write_token_pair_t write_token_pair;
     {
         fifo_enforcer_sink_t::exit_write_t fifo_exit(&store_entrance_sink_, qe.fifo_token);
@@ -438,6 +472,10 @@ void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &q
         }
         wait_interruptible(&fifo_exit, interruptor);
         advance_current_timestamp_and_pulse_waiters(qe.transition_timestamp);
+        if (superseded) {
+            ++pm_coalesced_writes_;
+            return;
+        }
         svs_->new_write_token_pair(&write_token_pair);
     }
 
@@ -465,21 +503,53 @@ void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &q
 }
 
 template <class protocol_t>
-void listener_t<protocol_t>::on_writeread(const typename protocol_t::write_t &write,
-        transition_timestamp_t transition_timestamp,
-        order_token_t order_token,
-        fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
-        write_durability_t durability) THROWS_NOTHING {
-    rassert(region_is_superset(our_branch_region_, write.get_region()));
-    rassert(!region_is_empty(write.get_region()));
-    rassert(region_is_superset(svs_->get_region(), write.get_region()));
-    order_token.assert_write_mode();
+void listener_t<protocol_t>::on_writeread(
+        const std::vector<listener_writeread_t<protocol_t> > &writes,
+        mailbox_addr_t<void(writeread_acks_t)> ack_addr)
+        THROWS_NOTHING {
+    size_t hard_writes = 0;
+    size_t last_hard_write = 0;
+    for (size_t i = 0; i < writes.size(); ++i) {
+        if (writes[i].durability == write_durability_t::HARD) {
+            ++hard_writes;
+            last_hard_write = i;
+        }
+    }
+    boost::shared_ptr<hard_ack_group_t> hard_acks;
+    if (hard_writes != 0) {
+        hard_acks = boost::make_shared<hard_ack_group_t>(hard_writes);
+    }
 
-    coro_t::spawn_sometime(boost::bind(
-        &listener_t<protocol_t>::perform_writeread, this,
-        write, transition_timestamp, order_token, fifo_token, ack_addr, durability,
-        auto_drainer_t::lock_t(&drainer_)));
+    /* Briefly pass through `write_queue_entrance_sink_` in case we are receiving
+    a mix of writes and write-reads. A batch's tokens are usually consecutive, so
+    each run of them passes at once. */
+    for (size_t i = 0; i < writes.size();) {
+        fifo_enforcer_write_range_token_t run(writes[i].fifo_token);
+        ++i;
+        while (i < writes.size() && run.extend(writes[i].fifo_token)) {
+            ++i;
+        }
+        fifo_enforcer_sink_t::exit_write_range_t fifo_exit(&write_queue_entrance_sink_, run);
+    }
+
+    /* The writes in the batch still get a coroutine each, so that a write can go
+    into the B-tree while the one before it is still finishing. Their fifo tokens
+    keep them in order. */
+    for (size_t i = 0; i < writes.size(); ++i) {
+        const listener_writeread_t<protocol_t> &w = writes[i];
+        rassert(region_is_superset(our_branch_region_, w.write.get_region()));
+        rassert(!region_is_empty(w.write.get_region()));
+        rassert(region_is_superset(svs_->get_region(), w.write.get_region()));
+        w.order_token.assert_write_mode();
+
+        bool is_hard = w.durability == write_durability_t::HARD;
+        coro_t::spawn_sometime(std::bind(
+            &listener_t<protocol_t>::perform_writeread, this,
+            w.write, w.timestamp, w.order_token, w.fifo_token, ack_addr, i,
+            is_hard && i != last_hard_write ? write_durability_t::SOFT : w.durability,
+            is_hard ? hard_acks : boost::shared_ptr<hard_ack_group_t>(),
+            auto_drainer_t::lock_t(&drainer_)));
+    }
 }
 
 template <class protocol_t>
@@ -487,20 +557,17 @@ void listener_t<protocol_t>::perform_writeread(const typename protocol_t::write_
         transition_timestamp_t transition_timestamp,
         order_token_t order_token,
         fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
+        mailbox_addr_t<void(writeread_acks_t)> ack_addr,
+        size_t index_in_batch,
         const write_durability_t durability,
+        boost::shared_ptr<hard_ack_group_t> hard_acks,
         auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
     try {
         write_token_pair_t write_token_pair;
         {
-            {
-                /* Briefly pass through `write_queue_entrance_sink_` in case we
-                are receiving a mix of writes and write-reads */
-                fifo_enforcer_sink_t::exit_write_t fifo_exit_1(&write_queue_entrance_sink_, fifo_token);
-            }
-
-            fifo_enforcer_sink_t::exit_write_t fifo_exit_2(&store_entrance_sink_, fifo_token);
-            wait_interruptible(&fifo_exit_2, keepalive.get_drain_signal());
+            // `on_writeread()` already passed us through `write_queue_entrance_sink_`.
+            fifo_enforcer_sink_t::exit_write_t fifo_exit(&store_entrance_sink_, fifo_token);
+            wait_interruptible(&fifo_exit, keepalive.get_drain_signal());
 
             advance_current_timestamp_and_pulse_waiters(transition_timestamp);
 
@@ -531,7 +598,16 @@ void listener_t<protocol_t>::perform_writeread(const typename protocol_t::write_
                     &write_token_pair,
                     keepalive.get_drain_signal());
 
-        send(mailbox_manager_, ack_addr, response);
+        if (!hard_acks) {
+            send(mailbox_manager_, ack_addr,
+                 writeread_acks_t(1, std::make_pair(index_in_batch, response)));
+        } else {
+            hard_acks->acks.push_back(std::make_pair(index_in_batch, response));
+            --hard_acks->writes_left;
+            if (hard_acks->writes_left == 0) {
+                send(mailbox_manager_, ack_addr, hard_acks->acks);
+            }
+        }
 
     } catch (const interrupted_exc_t &) {
         /* pass */
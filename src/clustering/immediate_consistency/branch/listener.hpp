@@ -171,20 +171,32 @@ private:
     /* See the note at the place where `writeread_mailbox` is declared for an
     explanation of why `on_writeread()` and `on_read()` are here. */
 
-    void on_writeread(const typename protocol_t::write_t &write,
-            transition_timestamp_t transition_timestamp,
-            order_token_t order_token,
-            fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
-            write_durability_t durability)
+    typedef typename listener_business_card_t<protocol_t>::writeread_acks_t writeread_acks_t;
+
+    /* The acks of the writes in a batch that want hard durability.  Only the
+    last of them is written with hard durability; every write also sets the
+    metainfo in the superblock, so flushing the last one flushes all of them.
+    They are acked together once all of them are done. */
+    class hard_ack_group_t {
+    public:
+        explicit hard_ack_group_t(size_t _writes_left) : writes_left(_writes_left) { }
+        writeread_acks_t acks;
+        size_t writes_left;
+    };
+
+    void on_writeread(const std::vector<listener_writeread_t<protocol_t> > &writes,
+            mailbox_addr_t<void(writeread_acks_t)> ack_addr)
         THROWS_NOTHING;
 
+    /* `hard_acks` is empty if the write doesn't want hard durability. */
     void perform_writeread(const typename protocol_t::write_t &write,
             transition_timestamp_t transition_timestamp,
             order_token_t order_token,
             fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
+            mailbox_addr_t<void(writeread_acks_t)> ack_addr,
+            size_t index_in_batch,
             write_durability_t durability,
+            boost::shared_ptr<hard_ack_group_t> hard_acks,
             auto_drainer_t::lock_t keepalive)
         THROWS_NOTHING;
 
@@ -227,6 +239,10 @@ private:
     perfmon_collection_t perfmon_collection_;
     perfmon_membership_t perfmon_collection_membership_;
 
+    /* Counts queued writes that we skipped because of `queued_overwrites_`. */
+    perfmon_counter_t pm_coalesced_writes_;
+    perfmon_membership_t pm_coalesced_writes_membership_;
+
     state_timestamp_t current_timestamp_;
     fifo_enforcer_sink_t store_entrance_sink_;
 
@@ -235,6 +251,13 @@ private:
     std::multimap<state_timestamp_t, cond_t *> synchronize_waiters_;
 
     disk_backed_queue_wrapper_t<write_queue_entry_t> write_queue_;
+
+    /* For every region that a write in `write_queue_` overwrites completely (see
+    `write_t::get_overwritten_region()`), the timestamp of the last such write.
+    An earlier queued write that overwrites the same region gets skipped when it
+    comes out of the queue, so that after a backfill we only apply the final
+    value of keys that were written over and over. */
+    std::map<typename protocol_t::region_t, state_timestamp_t> queued_overwrites_;
     fifo_enforcer_sink_t write_queue_entrance_sink_;
     scoped_ptr_t<boost_function_callback_t<write_queue_entry_t> > write_queue_coro_pool_callback_;
     adjustable_semaphore_t write_queue_semaphore_;
@@ -4,6 +4,7 @@
 
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "clustering/generic/registration_metadata.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
@@ -19,6 +20,30 @@
 
 template <class> class listener_intro_t;
 
+/* One of the writes in a batch that the broadcaster sends to a readable listener.
+The listener replies to it by sending its index in the batch and the response to
+the batch's response mailbox.  The writes in a batch that want hard durability
+are acked together, in one message, once the last of them is on disk. */
+template <class protocol_t>
+class listener_writeread_t {
+public:
+    listener_writeread_t() { }
+    listener_writeread_t(const typename protocol_t::write_t &w,
+                         transition_timestamp_t ts,
+                         order_token_t ot,
+                         fifo_enforcer_write_token_t ft,
+                         write_durability_t d)
+        : write(w), timestamp(ts), order_token(ot), fifo_token(ft), durability(d) { }
+
+    typename protocol_t::write_t write;
+    transition_timestamp_t timestamp;
+    order_token_t order_token;
+    fifo_enforcer_write_token_t fifo_token;
+    write_durability_t durability;
+
+    RDB_MAKE_ME_SERIALIZABLE_5(write, timestamp, order_token, fifo_token, durability);
+};
+
 /* Every `listener_t` constructs a `listener_business_card_t` and sends it to
 the `broadcaster_t`. */
 
@@ -35,12 +60,11 @@ public:
                            fifo_enforcer_write_token_t,
                            mailbox_addr_t<void()> ack_addr)> write_mailbox_t;
 
-    typedef mailbox_t<void(typename protocol_t::write_t,
-                           transition_timestamp_t,
-                           order_token_t,
-                           fifo_enforcer_write_token_t,
-                           mailbox_addr_t<void(typename protocol_t::write_response_t)>,
-                           write_durability_t)> writeread_mailbox_t;
+    /* Writes to readable mirrors come in batches, in the order the broadcaster
+    saw them. */
+    typedef std::vector<std::pair<size_t, typename protocol_t::write_response_t> > writeread_acks_t;
+    typedef mailbox_t<void(std::vector<listener_writeread_t<protocol_t> >,
+                           mailbox_addr_t<void(writeread_acks_t)>)> writeread_mailbox_t;
 
     typedef mailbox_t<void(typename protocol_t::read_t,
                            state_timestamp_t,
@@ -19,6 +19,17 @@ struct multistore_ptr_t<protocol_t>::switch_read_token_t {
     fifo_enforcer_read_token_t token;
 };
 
+// Runs `c` for each of `stores`, without spawning a coroutine when there's only
+// one of them.
+template <class callable_t>
+void pmap_stores(const std::vector<int> &stores, const callable_t &c) {
+    if (stores.size() == 1) {
+        c(stores[0]);
+    } else {
+        pmap(stores.begin(), stores.end(), c);
+    }
+}
+
 template <class protocol_t>
 store_view_t<protocol_t> *multistore_ptr_t<protocol_t>::get_store(int i) const {
     guarantee(0 <= i && i < num_stores());
@@ -141,9 +152,13 @@ void multistore_ptr_t<protocol_t>::do_get_metainfo(order_token_t order_token,
     // This is kind of awkward.
     int count = num_stores();
     scoped_array_t<switch_read_token_t> internal_tokens(count);
+    const std::vector<int> stores = get_stores_touched_by(region_);
 
     for (int i = 0; i < count; ++i) {
-        internal_tokens[i].do_read = true;
+        internal_tokens[i].do_read = false;
+    }
+    for (auto it = stores.begin(); it != stores.end(); ++it) {
+        internal_tokens[*it].do_read = true;
     }
 
     switch_read_tokens(external_token, interruptor, &order_token, &internal_tokens);
@@ -160,8 +175,8 @@ void multistore_ptr_t<protocol_t>::do_get_metainfo(order_token_t order_token,
     // TODO: For getting, we possibly want to cache things on the home
     // thread, but wait until we want a multithreaded listener.
 
-    pmap(count, boost::bind(&multistore_ptr_t<protocol_t>::do_get_a_metainfo,
-                            this, _1, order_token, &internal_tokens, interruptor, out, &out_mutex));
+    pmap_stores(stores, boost::bind(&multistore_ptr_t<protocol_t>::do_get_a_metainfo,
+                                    this, _1, order_token, &internal_tokens, interruptor, out, &out_mutex));
 
     if (interruptor->is_pulsed()) {
         throw interrupted_exc_t();
@@ -178,6 +193,17 @@ typename protocol_t::region_t multistore_ptr_t<protocol_t>::get_a_region(int i)
     return store_views_[i]->get_region();
 }
 
+template <class protocol_t>
+std::vector<int> multistore_ptr_t<protocol_t>::get_stores_touched_by(const typename protocol_t::region_t &region) const {
+    std::vector<int> stores;
+    for (int i = 0; i < num_stores(); ++i) {
+        if (region_overlaps(get_a_region(i), region)) {
+            stores.push_back(i);
+        }
+    }
+    return stores;
+}
+
 template <class protocol_t>
 void multistore_ptr_t<protocol_t>::do_set_a_metainfo(int i,
                                                      const region_map_t<protocol_t, binary_blob_t> &new_metainfo,
@@ -207,11 +233,12 @@ void multistore_ptr_t<protocol_t>::set_metainfo(const region_map_t<protocol_t, b
                                                 order_token_t order_token,
                                                 object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *external_token,
                                                 signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    const std::vector<int> stores = get_stores_touched_by(new_metainfo.get_domain());
     scoped_array_t<fifo_enforcer_write_token_t> internal_tokens;
-    switch_write_tokens(external_token, interruptor, &order_token, &internal_tokens);
+    switch_write_tokens(external_token, interruptor, &order_token, stores, &internal_tokens);
 
-    pmap(num_stores(),
-         boost::bind(&multistore_ptr_t<protocol_t>::do_set_a_metainfo, this, _1, boost::ref(new_metainfo), order_token, boost::ref(internal_tokens), interruptor));
+    pmap_stores(stores,
+                boost::bind(&multistore_ptr_t<protocol_t>::do_set_a_metainfo, this, _1, boost::ref(new_metainfo), order_token, boost::ref(internal_tokens), interruptor));
 
     if (interruptor->is_pulsed()) {
         throw interrupted_exc_t();
@@ -236,17 +263,18 @@ void multistore_ptr_t<protocol_t>::switch_read_tokens(object_buffer_t<fifo_enfor
 
 
 template <class protocol_t>
-void multistore_ptr_t<protocol_t>::switch_write_tokens(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *external_token, signal_t *interruptor, order_token_t *order_token_ref, scoped_array_t<fifo_enforcer_write_token_t> *internal_out) {
+void multistore_ptr_t<protocol_t>::switch_write_tokens(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *external_token, signal_t *interruptor, order_token_t *order_token_ref, const std::vector<int> &stores, scoped_array_t<fifo_enforcer_write_token_t> *internal_out) {
     object_buffer_t<fifo_enforcer_sink_t::exit_write_t>::destruction_sentinel_t destroyer(external_token);
 
     wait_interruptible(external_token->get(), interruptor);
 
     *order_token_ref = external_checkpoint_.get()->check_through(*order_token_ref);
 
-    const int n = num_stores();
-    internal_out->init(n);
-    for (int i = 0; i < n; ++i) {
-        (*internal_out)[i] = (*internal_sources_.get())[i].enter_write();
+    // Only the stores we're going to write to get a token, or the others'
+    // sinks would wait for it forever.
+    internal_out->init(num_stores());
+    for (auto it = stores.begin(); it != stores.end(); ++it) {
+        (*internal_out)[*it] = (*internal_sources_.get())[*it].enter_write();
     }
 }
 
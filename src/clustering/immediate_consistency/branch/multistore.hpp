@@ -66,6 +66,10 @@ private:
     struct switch_read_token_t;
     typename protocol_t::region_t get_a_region(int i) const;
 
+    // The stores whose region overlaps `region`, so that operations don't hop
+    // to the threads of stores they wouldn't touch.
+    std::vector<int> get_stores_touched_by(const typename protocol_t::region_t &region) const;
+
     void do_get_a_metainfo(int i,
                            order_token_t order_token,
                            const scoped_array_t<switch_read_token_t> *internal_tokens,
@@ -86,7 +90,7 @@ private:
 
     void switch_read_tokens(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *external_token, signal_t *interruptor, order_token_t *order_token_ref, scoped_array_t<switch_read_token_t> *internal_out);
 
-    void switch_write_tokens(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *external_token, signal_t *interruptor, order_token_t *order_token_ref, scoped_array_t<fifo_enforcer_write_token_t> *internal_out);
+    void switch_write_tokens(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *external_token, signal_t *interruptor, order_token_t *order_token_ref, const std::vector<int> &stores, scoped_array_t<fifo_enforcer_write_token_t> *internal_out);
 
     void switch_inner_read_token(int i, fifo_enforcer_read_token_t internal_token, signal_t *interruptor, object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *store_token);
 
@@ -1,16 +1,23 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/query/direct_reader.hpp"
 
-#include "protocol_api.hpp"
+#include "arch/timing.hpp"
 #include "btree/btree_store.hpp"
+#include "clustering/immediate_consistency/branch/listener.hpp"
+#include "config/args.hpp"
+#include "protocol_api.hpp"
 
 template <class protocol_t>
 direct_reader_t<protocol_t>::direct_reader_t(
         mailbox_manager_t *mm,
-        store_view_t<protocol_t> *svs_) :
+        store_view_t<protocol_t> *svs_,
+        boost::optional<microtime_t> _stale_since,
+        listener_t<protocol_t> *_listener) :
     mailbox_manager(mm),
     svs(svs_),
-    read_mailbox(mm, boost::bind(&direct_reader_t<protocol_t>::on_read, this, _1, _2))
+    stale_since(_stale_since),
+    listener(_listener),
+    read_mailbox(mm, boost::bind(&direct_reader_t<protocol_t>::on_read, this, _1, _2, _3, _4))
     { }
 
 template <class protocol_t>
@@ -18,22 +25,72 @@ direct_reader_business_card_t<protocol_t> direct_reader_t<protocol_t>::get_busin
     return direct_reader_business_card_t<protocol_t>(read_mailbox.get_address());
 }
 
+template <class protocol_t>
+int64_t direct_reader_t<protocol_t>::get_staleness_ms() const {
+    if (!stale_since) {
+        return 0;
+    }
+    if (*stale_since == 0) {
+        return UNBOUNDED_STALENESS_MS;
+    }
+    microtime_t now = current_microtime();
+    return now > *stale_since ? (now - *stale_since) / 1000 : 0;
+}
+
+template <class protocol_t>
+bool direct_reader_t<protocol_t>::can_reach_version(const version_t &min_version) const {
+    if (min_version == version_t::zero()) {
+        return true;
+    }
+    return listener != NULL && listener->branch_id() == min_version.branch;
+}
+
 template <class protocol_t>
 void direct_reader_t<protocol_t>::on_read(
         const typename protocol_t::read_t &read,
-        const mailbox_addr_t<void(typename protocol_t::read_response_t)> &cont) {
+        int64_t max_staleness_ms,
+        const version_t &min_version,
+        const response_addr_t &cont) {
+    int64_t staleness_ms = get_staleness_ms();
+    if (staleness_ms > max_staleness_ms || !can_reach_version(min_version)) {
+        /* Tell the sender how far behind we are, so it can try another replica
+        and knows not to pick us for a bound this tight again. */
+        send(mailbox_manager, cont,
+             boost::optional<typename protocol_t::read_response_t>(), staleness_ms);
+        return;
+    }
     coro_t::spawn_sometime(boost::bind(
         &direct_reader_t<protocol_t>::perform_read, this,
-        read, cont,
+        read, staleness_ms, min_version, cont,
         auto_drainer_t::lock_t(&drainer)));
 }
 
 template <class protocol_t>
 void direct_reader_t<protocol_t>::perform_read(
         const typename protocol_t::read_t &read,
-        const mailbox_addr_t<void(typename protocol_t::read_response_t)> &cont,
+        int64_t staleness_ms,
+        const version_t &min_version,
+        const response_addr_t &cont,
         auto_drainer_t::lock_t keepalive) {
     try {
+        if (min_version != version_t::zero()) {
+            /* Give the write a little while to reach us, but not so long that
+            the client would have been better off asking someone else. */
+            signal_timer_t timeout;
+            timeout.start(READ_YOUR_WRITES_MAX_WAIT_MS);
+            wait_any_t waiter(&timeout, keepalive.get_drain_signal());
+            try {
+                listener->wait_for_version(min_version.timestamp, &waiter);
+            } catch (const interrupted_exc_t &) {
+                if (keepalive.get_drain_signal()->is_pulsed()) {
+                    throw;
+                }
+                send(mailbox_manager, cont,
+                     boost::optional<typename protocol_t::read_response_t>(), staleness_ms);
+                return;
+            }
+        }
+
         read_token_pair_t token_pair;
         svs->new_read_token_pair(&token_pair);
 
@@ -50,7 +107,9 @@ void direct_reader_t<protocol_t>::perform_read(
                   &token_pair,
                   keepalive.get_drain_signal());
 
-        send(mailbox_manager, cont, response);
+        send(mailbox_manager, cont,
+             boost::optional<typename protocol_t::read_response_t>(response),
+             staleness_ms);
 
     } catch (const interrupted_exc_t &) {
         /* ignore */
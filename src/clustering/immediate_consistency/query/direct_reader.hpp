@@ -5,34 +5,58 @@
 #include "clustering/immediate_consistency/query/direct_reader_metadata.hpp"
 #include "concurrency/fifo_checker.hpp"
 
+template <class> class listener_t;
 template <class> class store_view_t;
 
 /* For each primary and secondary of each shard, there is a `direct_reader_t`.
 The `direct_reader_t` allows the `cluster_namespace_interface_t` to bypass the
 `broadcaster_t` and read directly from the B-tree itself. This reduces network
 traffic and is possible even when the primary is down, but the data it returns
-might be out of date. */
+might be out of date.
+
+`stale_since` is when the store stopped receiving writes from the primary, or
+`boost::none` if it is still receiving them.  A replica that has never been up to
+date passes a `stale_since` of 0, which makes its staleness unknown.
+
+A replica that is receiving writes passes its `listener_t`, so that reads that
+have to see a given write can wait for it to arrive. */
 
 template <class protocol_t>
 class direct_reader_t {
 public:
     direct_reader_t(
             mailbox_manager_t *mm,
-            store_view_t<protocol_t> *svs);
+            store_view_t<protocol_t> *svs,
+            boost::optional<microtime_t> stale_since = boost::none,
+            listener_t<protocol_t> *listener = NULL);
 
     direct_reader_business_card_t<protocol_t> get_business_card();
 
 private:
+    typedef mailbox_addr_t<void(boost::optional<typename protocol_t::read_response_t>, int64_t)> response_addr_t;
+
+    int64_t get_staleness_ms() const;
+
+    /* Whether we're on the branch `min_version` was written to, so that we will
+    see the write once we get to its timestamp. */
+    bool can_reach_version(const version_t &min_version) const;
+
     void on_read(
             const typename protocol_t::read_t &,
-            const mailbox_addr_t<void(typename protocol_t::read_response_t)> &);
+            int64_t max_staleness_ms,
+            const version_t &min_version,
+            const response_addr_t &);
     void perform_read(
             const typename protocol_t::read_t &,
-            const mailbox_addr_t<void(typename protocol_t::read_response_t)> &,
+            int64_t staleness_ms,
+            const version_t &min_version,
+            const response_addr_t &,
             auto_drainer_t::lock_t);
 
     mailbox_manager_t *mailbox_manager;
     store_view_t<protocol_t> *svs;
+    boost::optional<microtime_t> stale_since;
+    listener_t<protocol_t> *listener;
 
     order_source_t order_source;  // TODO: order_token_t::ignore
     auto_drainer_t drainer;
@@ -2,17 +2,34 @@
 #ifndef CLUSTERING_IMMEDIATE_CONSISTENCY_QUERY_DIRECT_READER_METADATA_HPP_
 #define CLUSTERING_IMMEDIATE_CONSISTENCY_QUERY_DIRECT_READER_METADATA_HPP_
 
+#include <stdint.h>
+
+#include <limits>
+
+#include "clustering/immediate_consistency/branch/history.hpp"
+#include "containers/archive/boost_types.hpp"
 #include "rpc/mailbox/typed.hpp"
 
+/* A staleness bound or staleness that means "no bound" or "not known". */
+const int64_t UNBOUNDED_STALENESS_MS = std::numeric_limits<int64_t>::max();
+
 /* Each replica exposes a `direct_reader_business_card_t` for each shard that it
-is a primary or secondary for. */
+is a primary or secondary for.
+
+A read carries the most out of date, in milliseconds, that the replica's data
+may be, and the version of the last write it has to see, which is
+`version_t::zero()` if there isn't one.  The replica answers with how out of
+date its data is, and with the response only if that is within the bound and
+it could catch up with the write. */
 
 template <class protocol_t>
 class direct_reader_business_card_t {
 public:
     typedef mailbox_t< void(
             typename protocol_t::read_t,
-            mailbox_addr_t< void(typename protocol_t::read_response_t)>
+            int64_t,
+            version_t,
+            mailbox_addr_t< void(boost::optional<typename protocol_t::read_response_t>, int64_t)>
             )> read_mailbox_t;
 
     direct_reader_business_card_t() { }
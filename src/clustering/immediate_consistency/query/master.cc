@@ -110,11 +110,13 @@ void master_t<protocol_t>::client_t::perform_request(
         typename protocol_t::write_response_t write_response;
         if (write_callback.response_promise.try_get_value(&write_response)) {
             send(parent->mailbox_manager, write->cont_addr,
-                 boost::variant<typename protocol_t::write_response_t, std::string>(write_response));
+                 boost::variant<typename protocol_t::write_response_t, std::string>(write_response),
+                 version_t(parent->broadcaster->get_branch_id(), write_callback.get_timestamp()));
         } else {
             guarantee(write_callback.done_cond.is_pulsed());
             send(parent->mailbox_manager, write->cont_addr,
-                 boost::variant<typename protocol_t::write_response_t, std::string>("not enough replicas responded"));
+                 boost::variant<typename protocol_t::write_response_t, std::string>("not enough replicas responded"),
+                 version_t::zero());
         }
 
         /* When we return, our multi-throttler ticket will be returned to the
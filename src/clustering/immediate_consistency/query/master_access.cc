@@ -105,12 +105,35 @@ void master_access_t<protocol_t>::write(
         fifo_enforcer_sink_t::exit_write_t *token,
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t) {
+    version_t version;
+    write_with_version(write, response, &version, otok, token, interruptor);
+}
+
+template <class protocol_t>
+void store_write_result(version_t *version_out,
+                        promise_t<boost::variant<typename protocol_t::write_response_t, std::string> > *result_or_failure,
+                        const boost::variant<typename protocol_t::write_response_t, std::string> &result,
+                        const version_t &version) {
+    *version_out = version;
+    result_or_failure->pulse(result);
+}
+
+template <class protocol_t>
+void master_access_t<protocol_t>::write_with_version(
+        const typename protocol_t::write_t &write,
+        typename protocol_t::write_response_t *response,
+        version_t *version_out,
+        order_token_t otok,
+        fifo_enforcer_sink_t::exit_write_t *token,
+        signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t) {
     rassert(region_is_superset(region, write.get_region()));
 
+    version_t version;
     promise_t<boost::variant<typename protocol_t::write_response_t, std::string> > result_or_failure;
-    mailbox_t<void(boost::variant<typename protocol_t::write_response_t, std::string>)> result_or_failure_mailbox(
+    mailbox_t<void(boost::variant<typename protocol_t::write_response_t, std::string>, version_t)> result_or_failure_mailbox(
         mailbox_manager,
-        boost::bind(&promise_t<boost::variant<typename protocol_t::write_response_t, std::string> >::pulse, &result_or_failure, _1));
+        boost::bind(&store_write_result<protocol_t>, &version, &result_or_failure, _1, _2));
 
     wait_interruptible(token, interruptor);
     fifo_enforcer_write_token_t token_for_master = source_for_master.enter_write();
@@ -137,6 +160,7 @@ void master_access_t<protocol_t>::write(
         } else if (const typename protocol_t::write_response_t *result =
                 boost::get<typename protocol_t::write_response_t>(&result_or_failure.wait())) {
             *response = *result;
+            *version_out = version;
         } else {
             unreachable();
         }
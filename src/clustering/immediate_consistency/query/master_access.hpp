@@ -53,6 +53,17 @@ public:
             signal_t *interruptor)
             THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t);
 
+    /* Like `write()`, but also returns the version that the write left the
+    master's branch at. */
+    void write_with_version(
+            const typename protocol_t::write_t &write,
+            typename protocol_t::write_response_t *response,
+            version_t *version_out,
+            order_token_t otok,
+            fifo_enforcer_sink_t::exit_write_t *token,
+            signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t);
+
 private:
     typedef multi_throttling_business_card_t<
             typename master_business_card_t<protocol_t>::request_t,
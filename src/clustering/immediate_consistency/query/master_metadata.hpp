@@ -9,6 +9,7 @@
 
 #include "clustering/generic/multi_throttling_metadata.hpp"
 #include "clustering/generic/registration_metadata.hpp"
+#include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "containers/archive/stl_types.hpp"
@@ -37,6 +38,10 @@ public:
         RDB_MAKE_ME_SERIALIZABLE_4(read, order_token, fifo_token, cont_addr);
     };
 
+    /* The master sends the response to `cont_addr` along with the version that
+    the write left the branch at, so that the client can tell when a replica has
+    caught up with the write. The version is `version_t::zero()` if the write
+    failed. */
     class write_request_t {
     public:
         write_request_t() { }
@@ -44,12 +49,12 @@ public:
                 const typename protocol_t::write_t &w,
                 order_token_t ot,
                 fifo_enforcer_write_token_t ft,
-                const mailbox_addr_t< void(boost::variant<typename protocol_t::write_response_t, std::string>)> &ca) :
+                const mailbox_addr_t< void(boost::variant<typename protocol_t::write_response_t, std::string>, version_t)> &ca) :
             write(w), order_token(ot), fifo_token(ft), cont_addr(ca) { }
         typename protocol_t::write_t write;
         order_token_t order_token;
         fifo_enforcer_write_token_t fifo_token;
-        mailbox_addr_t< void(boost::variant<typename protocol_t::write_response_t, std::string>)> cont_addr;
+        mailbox_addr_t< void(boost::variant<typename protocol_t::write_response_t, std::string>, version_t)> cont_addr;
         RDB_MAKE_ME_SERIALIZABLE_4(write, order_token, fifo_token, cont_addr);
     };
 
@@ -4,8 +4,55 @@
 #include <functional>
 
 #include "clustering/immediate_consistency/query/master_access.hpp"
+#include "config/args.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/watchable.hpp"
+#include "perfmon/perfmon.hpp"
+
+/* How much load the namespace interfaces on this server put on the masters and
+direct readers they route to, summed over all of them. */
+static perfmon_collection_t pm_query_routing;
+static perfmon_membership_t pm_query_routing_membership(&get_global_perfmon_collection(),
+                                                        &pm_query_routing, "query_routing");
+static perfmon_counter_t pm_master_ops_in_flight, pm_direct_reads_in_flight,
+    pm_direct_read_retries;
+static perfmon_latency_histogram_t pm_master_op_latency(secs_to_ticks(1)),
+    pm_direct_read_latency(secs_to_ticks(1));
+static perfmon_multi_membership_t pm_query_routing_stats_membership(&pm_query_routing,
+    &pm_master_ops_in_flight, "master_ops_in_flight",
+    &pm_master_op_latency, "master_op_latency",
+    &pm_direct_reads_in_flight, "direct_reads_in_flight",
+    &pm_direct_read_latency, "direct_read_latency",
+    &pm_direct_read_retries, "direct_read_retries");
+
+/* Counts a request as in flight, both for the service it went to and in the
+stats, for as long as it exists. */
+class in_flight_request_t {
+public:
+    in_flight_request_t(int64_t *_in_flight, perfmon_counter_t *_pm_in_flight)
+        : in_flight(_in_flight), pm_in_flight(_pm_in_flight) {
+        ++*in_flight;
+        ++*pm_in_flight;
+    }
+    ~in_flight_request_t() {
+        --*in_flight;
+        --*pm_in_flight;
+    }
+private:
+    int64_t *in_flight;
+    perfmon_counter_t *pm_in_flight;
+
+    DISABLE_COPYING(in_flight_request_t);
+};
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::service_load_t::record_latency(double secs) {
+    if (latency == 0) {
+        latency = secs;
+    } else {
+        latency += QUERY_ROUTING_LATENCY_EWMA_WEIGHT * (secs - latency);
+    }
+}
 
 template <class protocol_t>
 cluster_namespace_interface_t<protocol_t>::cluster_namespace_interface_t(
@@ -52,7 +99,20 @@ void cluster_namespace_interface_t<protocol_t>::read_outdated(const typename pro
     /* This seems kind of silly. We do it this way because
        `dispatch_outdated_read` needs to be able to see `outdated_read_info_t`,
        which is defined in the `private` section. */
-    dispatch_outdated_read(r, response, interruptor);
+    dispatch_outdated_read(r, response, UNBOUNDED_STALENESS_MS, NULL, interruptor);
+}
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::read_bounded_staleness(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, int64_t max_staleness_ms, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+    guarantee(max_staleness_ms >= 0);
+    dispatch_outdated_read(r, response, max_staleness_ms, NULL, interruptor);
+}
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::read_your_writes(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, const region_map_t<protocol_t, version_t> &versions, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+    dispatch_outdated_read(r, response, UNBOUNDED_STALENESS_MS, &versions, interruptor);
 }
 
 template <class protocol_t>
@@ -66,6 +126,58 @@ void cluster_namespace_interface_t<protocol_t>::write(const typename protocol_t:
                                                                                                                                    w, response, order_token, interruptor);
 }
 
+template <class protocol_t>
+void write_recording_version(region_map_t<protocol_t, version_t> *versions,
+                             master_access_t<protocol_t> *master_access,
+                             const typename protocol_t::write_t &w,
+                             typename protocol_t::write_response_t *response,
+                             order_token_t order_token,
+                             fifo_enforcer_sink_t::exit_write_t *token,
+                             signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t) {
+    version_t version;
+    master_access->write_with_version(w, response, &version, order_token, token, interruptor);
+    versions->update(region_map_t<protocol_t, version_t>(w.get_region(), version));
+}
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::write_with_versions(const typename protocol_t::write_t &w,
+                                                                    typename protocol_t::write_response_t *response,
+                                                                    region_map_t<protocol_t, version_t> *versions,
+                                                                    order_token_t order_token,
+                                                                    signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+    order_token.assert_write_mode();
+    guarantee(versions->get_domain() == protocol_t::region_t::universe());
+    dispatch_immediate_op<typename protocol_t::write_t, fifo_enforcer_sink_t::exit_write_t, typename protocol_t::write_response_t>(&master_access_t<protocol_t>::new_write_token,
+                                                                                                                                   std::bind(&write_recording_version<protocol_t>, versions, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6),
+                                                                                                                                   w, response, order_token, interruptor);
+}
+
+/* The version of the client's last write to `region`, or `version_t::zero()`
+if it hasn't written there.  Returns false if its writes there went to different
+branches, so that only the primary is sure to have seen all of them. */
+template <class protocol_t>
+bool get_version_to_read_at(const region_map_t<protocol_t, version_t> &versions,
+                            const typename protocol_t::region_t &region,
+                            version_t *version_out) {
+    *version_out = version_t::zero();
+    region_map_t<protocol_t, version_t> masked = versions.mask(region);
+    for (auto it = masked.begin(); it != masked.end(); ++it) {
+        if (it->second == version_t::zero()) {
+            continue;
+        }
+        if (*version_out == version_t::zero()) {
+            *version_out = it->second;
+        } else if (it->second.branch != version_out->branch) {
+            return false;
+        } else if (it->second.timestamp > version_out->timestamp) {
+            version_out->timestamp = it->second.timestamp;
+        }
+    }
+    return true;
+}
+
 template <class protocol_t>
 std::set<typename protocol_t::region_t>
 cluster_namespace_interface_t<protocol_t>::get_sharding_scheme() THROWS_ONLY(cannot_perform_query_exc_t) {
@@ -86,17 +198,11 @@ cluster_namespace_interface_t<protocol_t>::get_sharding_scheme() THROWS_ONLY(can
 template <class protocol_t>
 template<class op_type, class fifo_enforcer_token_type, class op_response_type>
 void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
-    /* `how_to_make_token` and `how_to_run_query` have type pointer-to-
-       member-function. */
+    /* `how_to_make_token` has type pointer-to-member-function. */
     void (master_access_t<protocol_t>::*how_to_make_token)(
         fifo_enforcer_token_type *),  // NOLINT
-    void (master_access_t<protocol_t>::*how_to_run_query)(
-        const op_type &,
-        op_response_type *,
-        order_token_t,
-        fifo_enforcer_token_type *,
-        signal_t *) THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t,
-                                cannot_perform_query_exc_t),
+    const typename query_runner_t<op_type, fifo_enforcer_token_type,
+                                  op_response_type>::type &how_to_run_query,
     const op_type &op,
     op_response_type *response,
     order_token_t order_token,
@@ -126,6 +232,7 @@ void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
                 throw cannot_perform_query_exc_t("No master available");
             }
             new_op_info->master_access = chosen_relationship->master_access;
+            new_op_info->master_load = &chosen_relationship->master_load;
             (new_op_info->master_access->*how_to_make_token)(
                 &new_op_info->enforcement_token);
             new_op_info->keepalive = auto_drainer_t::lock_t(
@@ -164,13 +271,8 @@ void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
 template <class protocol_t>
 template<class op_type, class fifo_enforcer_token_type, class op_response_type>
 void cluster_namespace_interface_t<protocol_t>::perform_immediate_op(
-    void (master_access_t<protocol_t>::*how_to_run_query)(
-        const op_type &,
-        op_response_type *,
-        order_token_t,
-        fifo_enforcer_token_type *,
-        signal_t *)
-    /* THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t) */,
+    const typename query_runner_t<op_type, fifo_enforcer_token_type,
+                                  op_response_type>::type &how_to_run_query,
     boost::ptr_vector<immediate_op_info_t<op_type, fifo_enforcer_token_type> > *
         masters_to_contact,
     std::vector<op_response_type> *results,
@@ -184,12 +286,19 @@ void cluster_namespace_interface_t<protocol_t>::perform_immediate_op(
         = &(*masters_to_contact)[i];
 
     try {
-        (master_to_contact->master_access->*how_to_run_query)(
+        in_flight_request_t in_flight(&master_to_contact->master_load->in_flight,
+                                      &pm_master_ops_in_flight);
+        ticks_t start_time = get_ticks();
+        how_to_run_query(
+            master_to_contact->master_access,
             master_to_contact->sharded_op,
             &results->at(i),
             order_token,
             &master_to_contact->enforcement_token,
             interruptor);
+        ticks_t latency = get_ticks() - start_time;
+        pm_master_op_latency.record(latency);
+        master_to_contact->master_load->record_latency(ticks_to_secs(latency));
     } catch (const resource_lost_exc_t&) {
         failures->at(i).assign("lost contact with master");
     } catch (const cannot_perform_query_exc_t& e) {
@@ -202,51 +311,122 @@ void cluster_namespace_interface_t<protocol_t>::perform_immediate_op(
     }
 }
 
+/* Orders the replicas an outdated read can go to: the local one first, then
+the ones that were within the staleness bound the last time we read from them,
+and among those the ones that are expected to answer soonest first. */
+template <class relationship_t>
+class outdated_read_preference_t {
+public:
+    explicit outdated_read_preference_t(int64_t _max_staleness_ms)
+        : max_staleness_ms(_max_staleness_ms) { }
+    int rank(const relationship_t *r) const {
+        if (r->is_local) {
+            return 0;
+        }
+        return r->staleness_ms <= max_staleness_ms ? 1 : 2;
+    }
+    bool operator()(const relationship_t *a, const relationship_t *b) const {
+        if (rank(a) != rank(b)) {
+            return rank(a) < rank(b);
+        }
+        return a->direct_reader_load.cost() < b->direct_reader_load.cost();
+    }
+private:
+    int64_t max_staleness_ms;
+};
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::choose_outdated_read_target(
+        std::vector<relationship_t *> *candidates,
+        int64_t max_staleness_ms) {
+    outdated_read_preference_t<relationship_t> preference(max_staleness_ms);
+    if (candidates->empty() || (*candidates)[0]->is_local) {
+        return;
+    }
+    /* Always sending to the replica that looked best would pile every read on
+    it until its latency catches up, so pick the better of two random replicas
+    among the equally preferred ones instead.  The rest stay in order for if the
+    first one refuses. */
+    size_t equals = 1;
+    while (equals < candidates->size()
+           && preference.rank((*candidates)[equals]) == preference.rank((*candidates)[0])) {
+        ++equals;
+    }
+    if (equals < 2) {
+        return;
+    }
+    size_t a = distributor_rng.randint(equals);
+    size_t b = distributor_rng.randint(equals - 1);
+    if (b >= a) {
+        ++b;
+    }
+    size_t chosen = preference((*candidates)[b], (*candidates)[a]) ? b : a;
+    std::rotate(candidates->begin(), candidates->begin() + chosen,
+                candidates->begin() + chosen + 1);
+}
+
 template <class protocol_t>
 void
 cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
     const typename protocol_t::read_t &op,
     typename protocol_t::read_response_t *response,
+    int64_t max_staleness_ms,
+    const region_map_t<protocol_t, version_t> *versions,
     signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
 
     if (interruptor->is_pulsed()) throw interrupted_exc_t();
+    guarantee(versions == NULL || versions->get_domain() == protocol_t::region_t::universe());
 
     boost::ptr_vector<outdated_read_info_t> direct_readers_to_contact;
 
     scoped_ptr_t<outdated_read_info_t> new_op_info(new outdated_read_info_t());
     for (auto it = relationships.begin(); it != relationships.end(); ++it) {
         if (op.shard(it->first, &new_op_info->sharded_op)) {
-            std::vector<relationship_t *> potential_relationships;
-            relationship_t *chosen_relationship = NULL;
+            std::vector<relationship_t *> *candidates
+                = &new_op_info->relationships;
+
+            bool replicas_can_serve = true;
+            new_op_info->min_version = version_t::zero();
+            if (versions != NULL) {
+                replicas_can_serve = get_version_to_read_at(
+                    *versions, it->first, &new_op_info->min_version);
+            }
 
+            new_op_info->master = NULL;
             const std::set<relationship_t *> *relationship_map = &it->second;
             for (auto jt = relationship_map->begin();
                  jt != relationship_map->end();
                  ++jt) {
-                if ((*jt)->direct_reader_access) {
-                    if ((*jt)->is_local) {
-                        chosen_relationship = *jt;
-                        break;
-                    } else {
-                        potential_relationships.push_back(*jt);
-                    }
+                if ((*jt)->direct_reader_access && replicas_can_serve) {
+                    candidates->push_back(*jt);
+                }
+                if ((*jt)->master_access && versions != NULL) {
+                    new_op_info->master = *jt;
                 }
             }
-            if (!chosen_relationship && !potential_relationships.empty()) {
-                chosen_relationship
-                    = potential_relationships[
-                        distributor_rng.randint(potential_relationships.size())];
+            if (new_op_info->master != NULL) {
+                new_op_info->keepalives.push_back(
+                    auto_drainer_t::lock_t(&new_op_info->master->drainer));
             }
-            if (!chosen_relationship) {
+            if (candidates->empty() && new_op_info->master == NULL) {
                 /* Don't bother looking for masters; if there are no direct
                    readers, there won't be any masters either. */
                 throw cannot_perform_query_exc_t("No direct reader available");
             }
-            new_op_info->direct_reader_access
-                = chosen_relationship->direct_reader_access;
-            new_op_info->keepalive = auto_drainer_t::lock_t(
-                &chosen_relationship->drainer);
+            /* Shuffle first so that replicas we can't tell apart, such as ones
+            we haven't read from yet, share the load. */
+            for (size_t i = candidates->size(); i > 1; --i) {
+                std::swap((*candidates)[i - 1],
+                          (*candidates)[distributor_rng.randint(i)]);
+            }
+            std::stable_sort(candidates->begin(), candidates->end(),
+                             outdated_read_preference_t<relationship_t>(max_staleness_ms));
+            choose_outdated_read_target(candidates, max_staleness_ms);
+            for (auto jt = candidates->begin(); jt != candidates->end(); ++jt) {
+                new_op_info->keepalives.push_back(
+                    auto_drainer_t::lock_t(&(*jt)->drainer));
+            }
             direct_readers_to_contact.push_back(new_op_info.release());
             new_op_info.init(new outdated_read_info_t());
         }
@@ -255,7 +435,7 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
     std::vector<typename protocol_t::read_response_t> results(direct_readers_to_contact.size());
     std::vector<std::string> failures(direct_readers_to_contact.size());
     pmap(direct_readers_to_contact.size(), std::bind(&cluster_namespace_interface_t::perform_outdated_read, this,
-                                                     &direct_readers_to_contact, &results, &failures, ph::_1, interruptor));
+                                                     &direct_readers_to_contact, &results, &failures, max_staleness_ms, ph::_1, interruptor));
 
     if (interruptor->is_pulsed()) throw interrupted_exc_t();
 
@@ -269,8 +449,10 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
 }
 
 template <class protocol_t>
-void outdated_read_store_result(typename protocol_t::read_response_t *result_out, const typename protocol_t::read_response_t &result_in, cond_t *done) {
+void outdated_read_store_result(boost::optional<typename protocol_t::read_response_t> *result_out, int64_t *staleness_ms_out,
+                                const boost::optional<typename protocol_t::read_response_t> &result_in, int64_t staleness_ms, cond_t *done) {
     *result_out = result_in;
+    *staleness_ms_out = staleness_ms;
     done->pulse();
 }
 
@@ -279,28 +461,85 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
     boost::ptr_vector<outdated_read_info_t> *direct_readers_to_contact,
     std::vector<typename protocol_t::read_response_t> *results,
     std::vector<std::string> *failures,
+    int64_t max_staleness_ms,
     int i,
     signal_t *interruptor)
     THROWS_NOTHING
 {
     outdated_read_info_t *direct_reader_to_contact = &(*direct_readers_to_contact)[i];
 
-    try {
-        cond_t done;
-        mailbox_t<void(typename protocol_t::read_response_t)> cont(mailbox_manager,
-                                                                   std::bind(&outdated_read_store_result<protocol_t>, &results->at(i), ph::_1, &done));
-
-        send(mailbox_manager, direct_reader_to_contact->direct_reader_access->access().read_mailbox, direct_reader_to_contact->sharded_op, cont.get_address());
-        wait_any_t waiter(direct_reader_to_contact->direct_reader_access->get_failed_signal(), &done);
-        wait_interruptible(&waiter, interruptor);
-        direct_reader_to_contact->direct_reader_access->access();   /* throws if `get_failed_signal()->is_pulsed()` */
-    } catch (const resource_lost_exc_t &) {
+    /* Try the replicas in order until one of them is within the staleness
+    bound.  Every answer, including a refusal, updates what we know about the
+    replica for the next read. */
+    bool lost_contact = false;
+    for (auto it = direct_reader_to_contact->relationships.begin();
+         it != direct_reader_to_contact->relationships.end();
+         ++it) {
+        relationship_t *relationship = *it;
+        try {
+            cond_t done;
+            boost::optional<typename protocol_t::read_response_t> result;
+            int64_t staleness_ms;
+            mailbox_t<void(boost::optional<typename protocol_t::read_response_t>, int64_t)> cont(mailbox_manager,
+                                                                                                 std::bind(&outdated_read_store_result<protocol_t>, &result, &staleness_ms, ph::_1, ph::_2, &done));
+
+            if (it != direct_reader_to_contact->relationships.begin()) {
+                ++pm_direct_read_retries;
+            }
+            in_flight_request_t in_flight(&relationship->direct_reader_load.in_flight,
+                                          &pm_direct_reads_in_flight);
+            ticks_t start_time = get_ticks();
+            send(mailbox_manager, relationship->direct_reader_access->access().read_mailbox, direct_reader_to_contact->sharded_op, max_staleness_ms, direct_reader_to_contact->min_version, cont.get_address());
+            wait_any_t waiter(relationship->direct_reader_access->get_failed_signal(), &done);
+            wait_interruptible(&waiter, interruptor);
+            relationship->direct_reader_access->access();   /* throws if `get_failed_signal()->is_pulsed()` */
+
+            ticks_t latency = get_ticks() - start_time;
+            pm_direct_read_latency.record(latency);
+            relationship->direct_reader_load.record_latency(ticks_to_secs(latency));
+            relationship->staleness_ms = staleness_ms;
+
+            if (result) {
+                results->at(i) = std::move(*result);
+                return;
+            }
+        } catch (const resource_lost_exc_t &) {
+            lost_contact = true;
+        } catch (const interrupted_exc_t &) {
+            guarantee(interruptor->is_pulsed());
+            /* Ignore `interrupted_exc_t` and return immediately.
+               `read_outdated()` will notice that the interruptor has been pulsed
+               and won't try to access our result. */
+            return;
+        }
+    }
+    if (direct_reader_to_contact->master != NULL) {
+        /* No replica has caught up with the client's writes, but the primary
+        has seen all of them. */
+        master_access_t<protocol_t> *master_access = direct_reader_to_contact->master->master_access;
+        try {
+            fifo_enforcer_sink_t::exit_read_t token;
+            master_access->new_read_token(&token);
+            in_flight_request_t in_flight(&direct_reader_to_contact->master->master_load.in_flight,
+                                          &pm_master_ops_in_flight);
+            master_access->read(direct_reader_to_contact->sharded_op, &results->at(i),
+                                order_token_t::ignore, &token, interruptor);
+        } catch (const resource_lost_exc_t &) {
+            failures->at(i).assign("lost contact with master");
+        } catch (const cannot_perform_query_exc_t &e) {
+            failures->at(i).assign("master error: " + std::string(e.what()));
+        } catch (const interrupted_exc_t &) {
+            guarantee(interruptor->is_pulsed());
+        }
+        return;
+    }
+    if (lost_contact) {
         failures->at(i).assign("lost contact with direct reader");
-    } catch (const interrupted_exc_t &) {
-        guarantee(interruptor->is_pulsed());
-        /* Ignore `interrupted_exc_t` and return immediately.
-           `read_outdated()` will notice that the interruptor has been pulsed
-           and won't try to access our result. */
+    } else if (direct_reader_to_contact->min_version != version_t::zero()) {
+        failures->at(i).assign("no replica has caught up with the client's writes");
+    } else {
+        failures->at(i).assign(strprintf("no replica is within the staleness bound "
+                                         "of %" PRIi64 " ms", max_staleness_ms));
     }
 }
 
@@ -434,6 +673,7 @@ void cluster_namespace_interface_t<protocol_t>::relationship_coroutine(peer_id_t
         relationship_record.region = region;
         relationship_record.master_access = master_access.has() ? master_access.get() : NULL;
         relationship_record.direct_reader_access = direct_reader_access.has() ? direct_reader_access.get() : NULL;
+        relationship_record.staleness_ms = 0;
 
         region_map_set_membership_t<protocol_t, relationship_t *> relationship_map_insertion(&relationships,
                                                                                              region,
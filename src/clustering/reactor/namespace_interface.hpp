@@ -5,6 +5,7 @@
 #include <math.h>
 
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -77,17 +78,48 @@ public:
 
     void read_outdated(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
+    void read_bounded_staleness(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, int64_t max_staleness_ms, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
+
     void write(const typename protocol_t::write_t &w, typename protocol_t::write_response_t *response, order_token_t order_token, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
+    /* `write_with_versions()` is like `write()`, but also records in
+    `versions` the version that the write left each shard it touched at.  A
+    client starts with a map of the whole key space to `version_t::zero()`, and
+    passes it to every write it does and to `read_your_writes()`.  Such a read
+    goes to any replica that has caught up with the client's writes, waiting for
+    a little while if it has to, and to the primary if none of them can. */
+    void write_with_versions(const typename protocol_t::write_t &w, typename protocol_t::write_response_t *response, region_map_t<protocol_t, version_t> *versions, order_token_t order_token, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
+
+    void read_your_writes(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, const region_map_t<protocol_t, version_t> &versions, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
+
     std::set<typename protocol_t::region_t> get_sharding_scheme() THROWS_ONLY(cannot_perform_query_exc_t);
 
 private:
+    /* The load we put on a master or a direct reader: how many of our requests
+    it is working on, and how long they take to come back as a moving average in
+    seconds.  The latency is 0 until a request has come back. */
+    class service_load_t {
+    public:
+        service_load_t() : in_flight(0), latency(0) { }
+        /* How long a new request can expect to wait, roughly. */
+        double cost() const { return latency * (in_flight + 1); }
+        void record_latency(double secs);
+
+        int64_t in_flight;
+        double latency;
+    };
+
     class relationship_t {
     public:
         bool is_local;
         typename protocol_t::region_t region;
         master_access_t<protocol_t> *master_access;
         resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
+        service_load_t master_load;
+        service_load_t direct_reader_load;
+        /* How out of date the replica said its data was the last time we read
+        from it, or 0 if we haven't. */
+        int64_t staleness_ms;
         auto_drainer_t drainer;
     };
 
@@ -100,35 +132,44 @@ private:
     public:
         op_type sharded_op;
         master_access_t<protocol_t> *master_access;
+        service_load_t *master_load;
         fifo_enforcer_token_type enforcement_token;
         auto_drainer_t::lock_t keepalive;
     };
 
+    /* The replicas an outdated read can go to, in the order to try them.  A
+    read that has to see the write at `min_version` falls back to `master` if
+    none of them has caught up with it. */
     class outdated_read_info_t {
     public:
         typename protocol_t::read_t sharded_op;
-        resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
-        auto_drainer_t::lock_t keepalive;
+        std::vector<relationship_t *> relationships;
+        version_t min_version;
+        relationship_t *master;
+        std::vector<auto_drainer_t::lock_t> keepalives;
+    };
+
+    /* A `master_access_t` member function, or something that calls one. */
+    template <class op_type, class fifo_enforcer_token_type, class op_response_type>
+    class query_runner_t {
+    public:
+        typedef std::function<void(master_access_t<protocol_t> *, const op_type &, op_response_type *, order_token_t, fifo_enforcer_token_type *, signal_t *)> type;
     };
 
     template <class op_type, class fifo_enforcer_token_type, class op_response_type>
     void dispatch_immediate_op(
-            /* `how_to_make_token` and `how_to_run_query` have type pointer-to-member-function. */
+            /* `how_to_make_token` has type pointer-to-member-function. */
             void (master_access_t<protocol_t>::*how_to_make_token)(fifo_enforcer_token_type *),  // NOLINT
-            void (master_access_t<protocol_t>::*how_to_run_query)(const op_type &, op_response_type *response, order_token_t, fifo_enforcer_token_type *, signal_t *) THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t),
+            const typename query_runner_t<op_type, fifo_enforcer_token_type, op_response_type>::type &how_to_run_query,
             const op_type &op,
             op_response_type *response,
             order_token_t order_token,
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
-    // The exception specification of `how_to_run_query` is commented out in
-    // order to bypass a clang bug seen on certain versions for OS X, or perhaps
-    // fix a confusing violation of C++.  This function is called only by
-    // dispatch_immediate_op, which still has the exception specification.
     template <class op_type, class fifo_enforcer_token_type, class op_response_type>
     void perform_immediate_op(
-            void (master_access_t<protocol_t>::*how_to_run_query)(const op_type &, op_response_type *, order_token_t, fifo_enforcer_token_type *, signal_t *) /* THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t, cannot_perform_query_exc_t) */,
+            const typename query_runner_t<op_type, fifo_enforcer_token_type, op_response_type>::type &how_to_run_query,
             boost::ptr_vector<immediate_op_info_t<op_type, fifo_enforcer_token_type> > *masters_to_contact,
             std::vector<op_response_type> *results,
             std::vector<std::string> *failures,
@@ -137,9 +178,12 @@ private:
             signal_t *interruptor)
         THROWS_NOTHING;
 
+    /* `versions` is `NULL` unless the read has to see the client's writes. */
     void dispatch_outdated_read(
             const typename protocol_t::read_t &op,
             typename protocol_t::read_response_t *response,
+            int64_t max_staleness_ms,
+            const region_map_t<protocol_t, version_t> *versions,
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
@@ -147,10 +191,16 @@ private:
             boost::ptr_vector<outdated_read_info_t> *direct_readers_to_contact,
             std::vector<typename protocol_t::read_response_t> *results,
             std::vector<std::string> *failures,
+            int64_t max_staleness_ms,
             int i,
             signal_t *interruptor)
         THROWS_NOTHING;
 
+    /* Puts the replica that the outdated read should try first at the front
+    of `candidates`, which is sorted by preference. */
+    void choose_outdated_read_target(std::vector<relationship_t *> *candidates,
+                                     int64_t max_staleness_ms);
+
     void update_registrants(bool is_start);
 
     static boost::optional<boost::optional<master_business_card_t<protocol_t> > > extract_master_business_card(const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &map, const peer_id_t &peer, const reactor_activity_id_t &activity_id);
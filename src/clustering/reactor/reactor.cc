@@ -233,6 +233,18 @@ void reactor_t<protocol_t>::run_cpu_sharded_role(
     }
 }
 
+template<class protocol_t>
+bool reactor_t<protocol_t>::collect_unknown_branches(const branch_history_t<protocol_t> &branch_history, branch_history_t<protocol_t> *branch_history_out) {
+    std::set<branch_id_t> known_branches = branch_history_manager->known_branches();
+    for (auto it = branch_history.branches.begin(); it != branch_history.branches.end(); ++it) {
+        if (!std_contains(known_branches, it->first)) {
+            branch_history_out->branches.insert(branch_history.branches.begin(), branch_history.branches.end());
+            return true;
+        }
+    }
+    return false;
+}
+
 template<class protocol_t>
 bool we_see_our_bcard(const change_tracking_map_t<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &bcards, peer_id_t me) {
     return std_contains(bcards.get_inner(), me);
@@ -128,6 +128,12 @@ private:
     bool find_replier_in_directory(const typename protocol_t::region_t &region, const branch_id_t &b_id, const blueprint_t<protocol_t> &bp, const change_tracking_map_t<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &reactor_directory,
                                       clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > *replier_out, peer_id_t *peer_id_out, reactor_activity_id_t *activity_out);
 
+    bool find_unknown_branch_history(const typename protocol_t::region_t &region, const blueprint_t<protocol_t> &bp, const change_tracking_map_t<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &reactor_directory,
+                                     branch_history_t<protocol_t> *branch_history_out);
+
+    void keep_branch_history_current(typename protocol_t::region_t region, const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &blueprint,
+            signal_t *interruptor, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+
     void be_secondary(typename protocol_t::region_t region, store_view_t<protocol_t> *store, const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &,
             signal_t *interruptor) THROWS_NOTHING;
 
@@ -146,6 +152,10 @@ private:
 
     void wait_for_directory_acks(directory_echo_version_t, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
 
+    /* Adds `branch_history` to `branch_history_out` and returns true if it has
+    any branches we don't know about yet. */
+    bool collect_unknown_branches(const branch_history_t<protocol_t> &branch_history, branch_history_t<protocol_t> *branch_history_out);
+
     bool attempt_backfill_from_peers(directory_entry_t *directory_entry, order_source_t *order_source, const typename protocol_t::region_t &region, store_view_t<protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &blueprint, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
 
     template <class activity_t>
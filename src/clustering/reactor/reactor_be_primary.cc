@@ -118,6 +118,9 @@ boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > extra
  * and the best_backfiller_out parameter will contain a set of backfillers we
  * can use to get the latest version of the data.
  * Otherwise it will return false and best_backfiller_out will be unmodified.
+ * If the peers have branches we don't know about it returns true with
+ * merge_branch_history_out set, and branch_history_to_merge_out holding every
+ * one of their histories that we need to import before trying again.
  */
 template <class protocol_t>
 bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_map_t<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &_reactor_directory,
@@ -129,6 +132,8 @@ bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_m
     typedef reactor_business_card_t<protocol_t> rb_t;
 
     best_backfiller_map_t res = *best_backfiller_out;
+    branch_history_to_merge_out->branches.clear();
+    *merge_branch_history_out = false;
 
     /* Iterator through the peers the blueprint claims we should be able to
      * see. */
@@ -156,16 +161,11 @@ bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_m
                 regions.push_back(intersection);
                 try {
                     if (const typename rb_t::secondary_without_primary_t * secondary_without_primary = boost::get<typename rb_t::secondary_without_primary_t>(&it->second.activity)) {
-                        branch_history_t<protocol_t> bh = secondary_without_primary->branch_history;
-                        std::set<branch_id_t> known_branchs = branch_history_manager->known_branches();
-
-                        for (typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::iterator bt  = bh.branches.begin();
-                                bt != bh.branches.end(); ++bt) {
-                            if (!std_contains(known_branchs, bt->first)) {
-                                *branch_history_to_merge_out = bh;
-                                *merge_branch_history_out = true;
-                                return true;
-                            }
+                        /* Keep checking the other peers so that all of the
+                        branches we're missing get merged in one go. */
+                        if (collect_unknown_branches(secondary_without_primary->branch_history, branch_history_to_merge_out)) {
+                            *merge_branch_history_out = true;
+                            continue;
                         }
 
                         update_best_backfiller(secondary_without_primary->current_state,
@@ -176,16 +176,11 @@ bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_m
                                                    it->first),
                                                &res);
                     } else if (const typename rb_t::nothing_when_safe_t * nothing_when_safe = boost::get<typename rb_t::nothing_when_safe_t>(&it->second.activity)) {
-                        branch_history_t<protocol_t> bh = nothing_when_safe->branch_history;
-                        std::set<branch_id_t> known_branchs = branch_history_manager->known_branches();
-
-                        for (typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::iterator bt  = bh.branches.begin();
-                                bt != bh.branches.end(); ++bt) {
-                            if (!std_contains(known_branchs, bt->first)) {
-                                *branch_history_to_merge_out = bh;
-                                *merge_branch_history_out = true;
-                                return true;
-                            }
+                        /* Keep checking the other peers so that all of the
+                        branches we're missing get merged in one go. */
+                        if (collect_unknown_branches(nothing_when_safe->branch_history, branch_history_to_merge_out)) {
+                            *merge_branch_history_out = true;
+                            continue;
                         }
 
                         update_best_backfiller(nothing_when_safe->current_state,
@@ -227,6 +222,10 @@ bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_m
         }
     }
 
+    if (*merge_branch_history_out) {
+        return true;
+    }
+
     /* If the latest version of the data we've found for a region is incoherent
      * then we don't backfill it automatically. The admin must explicit "bless"
      * the incoherent data making it coherent or get rid of all incoherent data
@@ -449,7 +448,7 @@ void reactor_t<protocol_t>::be_primary(typename protocol_t::region_t region, sto
         listener_t<protocol_t> listener(base_path, io_backender, mailbox_manager, ct_broadcaster_business_card.get_watchable(), branch_history_manager, &broadcaster, &region_perfmon_collection, &ct_interruptor, &order_source);
         replier_t<protocol_t> replier(&listener, mailbox_manager, branch_history_manager);
         master_t<protocol_t> master(mailbox_manager, ack_checker, region, &broadcaster);
-        direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs);
+        direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs, boost::none, &listener);
 
         on_thread_t th4(this->home_thread());
 
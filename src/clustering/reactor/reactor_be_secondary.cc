@@ -143,6 +143,62 @@ bool reactor_t<protocol_t>::find_replier_in_directory(
     }
 }
 
+template <class protocol_t>
+bool reactor_t<protocol_t>::find_unknown_branch_history(
+        const typename protocol_t::region_t &region,
+        const blueprint_t<protocol_t> &bp,
+        const change_tracking_map_t<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &_reactor_directory,
+        branch_history_t<protocol_t> *branch_history_out) {
+    typedef reactor_business_card_t<protocol_t> rb_t;
+
+    branch_history_out->branches.clear();
+    bool found = false;
+    for (auto it = bp.peers_roles.begin(); it != bp.peers_roles.end(); ++it) {
+        auto p_it = _reactor_directory.get_inner().find(it->first);
+        if (it->first == get_me() || p_it == _reactor_directory.get_inner().end()) {
+            continue;
+        }
+        for (auto a_it = p_it->second->activities.begin(); a_it != p_it->second->activities.end(); ++a_it) {
+            if (!region_overlaps(a_it->second.region, region)) {
+                continue;
+            }
+            if (const typename rb_t::secondary_without_primary_t *secondary_without_primary = boost::get<typename rb_t::secondary_without_primary_t>(&a_it->second.activity)) {
+                found = collect_unknown_branches(secondary_without_primary->branch_history, branch_history_out) || found;
+            } else if (const typename rb_t::nothing_when_safe_t *nothing_when_safe = boost::get<typename rb_t::nothing_when_safe_t>(&a_it->second.activity)) {
+                found = collect_unknown_branches(nothing_when_safe->branch_history, branch_history_out) || found;
+            }
+        }
+    }
+    return found;
+}
+
+/* A secondary may be made primary when the old primary goes away, and before
+it can take over it has to know every branch the other peers have data from.
+Importing those branches as they show up, rather than at the time of the
+failover, means the new primary can usually start backfilling straight away. */
+template <class protocol_t>
+void reactor_t<protocol_t>::keep_branch_history_current(
+        typename protocol_t::region_t region,
+        const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &blueprint,
+        signal_t *interruptor,
+        auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
+    wait_any_t wait_any(interruptor, keepalive.get_drain_signal());
+    try {
+        while (true) {
+            branch_history_t<protocol_t> branch_history_to_merge;
+            run_until_satisfied_2(
+                directory_echo_mirror.get_internal(),
+                blueprint,
+                boost::bind(&reactor_t<protocol_t>::find_unknown_branch_history, this, region, _2, _1, &branch_history_to_merge),
+                &wait_any,
+                REACTOR_RUN_UNTIL_SATISFIED_NAP);
+            branch_history_manager->import_branch_history(branch_history_to_merge, &wait_any);
+        }
+    } catch (const interrupted_exc_t &) {
+        /* ignore */
+    }
+}
+
 template<class protocol_t>
 void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, store_view_t<protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &blueprint, signal_t *interruptor) THROWS_NOTHING {
     try {
@@ -151,6 +207,19 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
         /* Tell everyone that we're backfilling so that we can get up to
          * date. */
         directory_entry_t directory_entry(this, region);
+
+        /* When we last stopped being up to date with the primary, so that reads
+        with a staleness bound know how far behind we are.  0 means we haven't
+        been up to date since we started. */
+        microtime_t stale_since = 0;
+
+        /* Keep our branch history in step with the other peers' for as long
+        as we're a secondary, so we're ready to be made primary. */
+        auto_drainer_t branch_history_drainer;
+        coro_t::spawn_sometime(boost::bind(&reactor_t<protocol_t>::keep_branch_history_current, this,
+                                           region, blueprint, interruptor,
+                                           auto_drainer_t::lock_t(&branch_history_drainer)));
+
         while (true) {
             clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > > broadcaster;
             clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > location_to_backfill_from;
@@ -178,7 +247,7 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
                 region_map_t<protocol_t, binary_blob_t> metainfo_blob;
                 svs->do_get_metainfo(order_source.check_in("reactor_t::be_secondary").with_read_mode(), &read_token, &ct_interruptor, &metainfo_blob);
 
-                direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs);
+                direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs, stale_since);
 
                 on_thread_t th2(this->home_thread());
 
@@ -253,7 +322,7 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
                  * us for backfills. */
                 replier_t<protocol_t> replier(&listener, mailbox_manager, branch_history_manager);
 
-                direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs);
+                direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs, boost::none, &listener);
 
                 cross_thread_signal_t ct_broadcaster_lost_signal(listener.get_broadcaster_lost_signal(), this->home_thread());
                 on_thread_t th2(this->home_thread());
@@ -264,6 +333,7 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
 
                 /* Wait for something to change. */
                 wait_interruptible(&ct_broadcaster_lost_signal, interruptor);
+                stale_since = current_microtime();
             } catch (const typename listener_t<protocol_t>::backfiller_lost_exc_t &) {
                 /* We lost the replier which means we should retry, just
                  * going back to the top of the while loop accomplishes this.
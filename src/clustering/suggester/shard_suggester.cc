@@ -0,0 +1,164 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/suggester/shard_suggester.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "clustering/generic/nonoverlapping_regions.hpp"
+#include "config/args.hpp"
+#include "hash_region.hpp"
+
+/* Returns the shards' key ranges in key order, or false if a shard doesn't
+cover the whole hash space. */
+template <class protocol_t>
+bool get_shard_key_ranges(const nonoverlapping_regions_t<protocol_t> &shards,
+                          std::vector<key_range_t> *ranges_out) {
+    ranges_out->clear();
+    for (auto it = shards.begin(); it != shards.end(); ++it) {
+        if (it->beg != 0 || it->end != HASH_REGION_HASH_SIZE) {
+            return false;
+        }
+        ranges_out->push_back(it->inner);
+    }
+    std::sort(ranges_out->begin(), ranges_out->end(),
+              [](const key_range_t &a, const key_range_t &b) {
+                  return a.left < b.left;
+              });
+    return true;
+}
+
+template <class protocol_t>
+shard_suggestion_t suggest_shard_changes(
+        const nonoverlapping_regions_t<protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &load) {
+    shard_suggestion_t suggestion;
+    std::vector<key_range_t> ranges;
+    if (!get_shard_key_ranges(shards, &ranges) || ranges.empty()) {
+        return suggestion;
+    }
+
+    /* Find the load of each shard, keeping the entries that fell in it so we
+    can tell where its middle is. */
+    std::vector<int64_t> shard_loads(ranges.size(), 0);
+    std::vector<std::vector<std::pair<store_key_t, int64_t> > > shard_entries(ranges.size());
+    int64_t total_load = 0;
+    size_t shard = 0;
+    for (auto it = load.begin(); it != load.end(); ++it) {
+        while (shard < ranges.size() && !ranges[shard].contains_key(it->first)) {
+            ++shard;
+        }
+        if (shard == ranges.size()) {
+            break;
+        }
+        shard_loads[shard] += it->second;
+        shard_entries[shard].push_back(*it);
+        total_load += it->second;
+    }
+    if (total_load <= 0) {
+        return suggestion;
+    }
+    double average_load = static_cast<double>(total_load) / ranges.size();
+
+    std::vector<bool> splitting(ranges.size(), false);
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (shard_loads[i] <= SHARD_SPLIT_LOAD_FACTOR * average_load) {
+            continue;
+        }
+        /* Split before the first entry that starts in the second half of the
+        shard's load. */
+        int64_t load_before = 0;
+        for (auto it = shard_entries[i].begin(); it != shard_entries[i].end(); ++it) {
+            if (2 * load_before >= shard_loads[i] && it->first != ranges[i].left) {
+                suggestion.split_points_to_add.insert(it->first);
+                splitting[i] = true;
+                break;
+            }
+            load_before += it->second;
+        }
+    }
+
+    /* Merge runs of cold shards, leaving alone the ones we are splitting. */
+    int64_t run_load = shard_loads[0];
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (!splitting[i - 1] && !splitting[i]
+            && run_load + shard_loads[i] < SHARD_MERGE_LOAD_FACTOR * average_load) {
+            suggestion.split_points_to_remove.insert(ranges[i].left);
+            run_load += shard_loads[i];
+        } else {
+            run_load = shard_loads[i];
+        }
+    }
+
+    return suggestion;
+}
+
+template <class protocol_t>
+bool apply_shard_suggestion(
+        const shard_suggestion_t &suggestion,
+        nonoverlapping_regions_t<protocol_t> *shards) {
+    std::vector<key_range_t> ranges;
+    if (!get_shard_key_ranges(*shards, &ranges) || ranges.empty()) {
+        return false;
+    }
+
+    std::set<store_key_t> split_points;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        split_points.insert(ranges[i].left);
+    }
+    for (auto it = suggestion.split_points_to_remove.begin();
+         it != suggestion.split_points_to_remove.end();
+         ++it) {
+        if (split_points.erase(*it) == 0) {
+            return false;
+        }
+    }
+    for (auto it = suggestion.split_points_to_add.begin();
+         it != suggestion.split_points_to_add.end();
+         ++it) {
+        if (*it == store_key_t::min() || !split_points.insert(*it).second) {
+            return false;
+        }
+    }
+
+    std::vector<typename protocol_t::region_t> regions;
+    key_range_t range;
+    range.left = store_key_t::min();
+    for (auto it = split_points.begin(); it != split_points.end(); ++it) {
+        range.right = key_range_t::right_bound_t(*it);
+        regions.push_back(typename protocol_t::region_t(range));
+        range.left = *it;
+    }
+    range.right = key_range_t::right_bound_t();
+    regions.push_back(typename protocol_t::region_t(range));
+
+    nonoverlapping_regions_t<protocol_t> new_shards;
+    if (!new_shards.set_regions(regions)) {
+        return false;
+    }
+    *shards = new_shards;
+    return true;
+}
+
+
+#include "memcached/protocol.hpp"
+
+template
+shard_suggestion_t suggest_shard_changes<memcached_protocol_t>(
+        const nonoverlapping_regions_t<memcached_protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &load);
+template
+bool apply_shard_suggestion<memcached_protocol_t>(
+        const shard_suggestion_t &suggestion,
+        nonoverlapping_regions_t<memcached_protocol_t> *shards);
+
+
+#include "rdb_protocol/protocol.hpp"
+
+template
+shard_suggestion_t suggest_shard_changes<rdb_protocol_t>(
+        const nonoverlapping_regions_t<rdb_protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &load);
+template
+bool apply_shard_suggestion<rdb_protocol_t>(
+        const shard_suggestion_t &suggestion,
+        nonoverlapping_regions_t<rdb_protocol_t> *shards);
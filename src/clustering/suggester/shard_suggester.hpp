@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_SUGGESTER_SHARD_SUGGESTER_HPP_
+#define CLUSTERING_SUGGESTER_SHARD_SUGGESTER_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+
+#include "btree/keys.hpp"
+
+template <class protocol_t> class nonoverlapping_regions_t;
+
+/* A change to a table's split points that would even out the load on its
+shards. */
+class shard_suggestion_t {
+public:
+    bool empty() const {
+        return split_points_to_add.empty() && split_points_to_remove.empty();
+    }
+
+    std::set<store_key_t> split_points_to_add;
+    std::set<store_key_t> split_points_to_remove;
+};
+
+/* Suggests splitting the shards that carry more than `SHARD_SPLIT_LOAD_FACTOR`
+times the average load at the middle of their load, and merging runs of
+neighbouring shards that together carry less than `SHARD_MERGE_LOAD_FACTOR` times
+the average.
+
+`load` is laid out like a distribution query's result: each entry is the load of
+the keys from its key up to the next entry's key.  It can be key counts, byte
+counts or operation counts; only how they compare matters.  Shards that don't
+cover the whole hash space are left alone. */
+template <class protocol_t>
+shard_suggestion_t suggest_shard_changes(
+        const nonoverlapping_regions_t<protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &load);
+
+/* Returns false and leaves `shards` alone if the suggestion doesn't fit them. */
+template <class protocol_t>
+MUST_USE bool apply_shard_suggestion(
+        const shard_suggestion_t &suggestion,
+        nonoverlapping_regions_t<protocol_t> *shards);
+
+#endif  // CLUSTERING_SUGGESTER_SHARD_SUGGESTER_HPP_
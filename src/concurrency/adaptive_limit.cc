@@ -0,0 +1,58 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/adaptive_limit.hpp"
+
+#include <algorithm>
+
+// How far the baseline moves towards a window average that is worse than it.
+static const double BASELINE_DRIFT = 0.05;
+
+adaptive_concurrency_limit_t::adaptive_concurrency_limit_t(
+        const adaptive_concurrency_params_t &_params)
+    : params(_params),
+      limit(_params.initial_limit),
+      window_latency_sum(0),
+      window_samples(0),
+      window_max_in_flight(0),
+      baseline_latency(0) {
+    guarantee(params.min_limit > 0);
+    guarantee(params.min_limit <= params.initial_limit);
+    guarantee(params.initial_limit <= params.max_limit);
+    guarantee(params.window_size > 0);
+    guarantee(params.latency_tolerance >= 1.0);
+    guarantee(params.backoff_ratio > 0.0 && params.backoff_ratio < 1.0);
+}
+
+bool adaptive_concurrency_limit_t::report_completion(ticks_t latency,
+                                                     size_t in_flight) {
+    window_latency_sum += latency;
+    ++window_samples;
+    window_max_in_flight = std::max(window_max_in_flight, in_flight);
+    if (window_samples < params.window_size) {
+        return false;
+    }
+
+    size_t old_limit = limit;
+    end_window();
+    return limit != old_limit;
+}
+
+void adaptive_concurrency_limit_t::end_window() {
+    double average = static_cast<double>(window_latency_sum) / window_samples;
+    bool saturated = window_max_in_flight >= limit;
+    window_latency_sum = 0;
+    window_samples = 0;
+    window_max_in_flight = 0;
+
+    if (baseline_latency == 0 || average <= baseline_latency) {
+        baseline_latency = average;
+    } else {
+        baseline_latency += (average - baseline_latency) * BASELINE_DRIFT;
+    }
+
+    if (average > baseline_latency * params.latency_tolerance) {
+        size_t reduced = static_cast<size_t>(limit * params.backoff_ratio);
+        limit = std::max(params.min_limit, std::min(reduced, limit - 1));
+    } else if (saturated && limit < params.max_limit) {
+        ++limit;
+    }
+}
@@ -0,0 +1,68 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_ADAPTIVE_LIMIT_HPP_
+#define CONCURRENCY_ADAPTIVE_LIMIT_HPP_
+
+#include <stddef.h>
+
+#include "config/args.hpp"
+#include "utils.hpp"
+
+/* Bounds and tuning for an `adaptive_concurrency_limit_t`. */
+class adaptive_concurrency_params_t {
+public:
+    adaptive_concurrency_params_t(size_t _min_limit, size_t _initial_limit,
+                                  size_t _max_limit)
+        : min_limit(_min_limit),
+          initial_limit(_initial_limit),
+          max_limit(_max_limit),
+          window_size(ADAPTIVE_CONCURRENCY_WINDOW),
+          latency_tolerance(ADAPTIVE_CONCURRENCY_LATENCY_TOLERANCE),
+          backoff_ratio(ADAPTIVE_CONCURRENCY_BACKOFF_RATIO) { }
+
+    size_t min_limit, initial_limit, max_limit;
+    // How many completed items make up one adjustment window.
+    size_t window_size;
+    // How much the average latency of a window may exceed the best recent
+    // average before the limit is cut.
+    double latency_tolerance;
+    // The factor by which the limit is cut.
+    double backoff_ratio;
+};
+
+/* `adaptive_concurrency_limit_t` is an AIMD controller for the number of items that
+should be processed at once. It is fed the latency of every completed item and the
+number of items that were in flight at that time.
+
+As long as latency stays close to the best it has recently been, more concurrency
+is assumed to buy more throughput, and the limit grows by one per window. It only
+grows if the window actually used the whole limit, because otherwise the limit
+wasn't what held throughput back. Once latency climbs above the baseline, the work
+is queueing on some shared resource rather than progressing, and the limit is cut
+multiplicatively. The baseline slowly drifts towards the observed latency, so a
+lasting change in the cost of items doesn't pin the limit to its minimum. */
+class adaptive_concurrency_limit_t {
+public:
+    explicit adaptive_concurrency_limit_t(const adaptive_concurrency_params_t &params);
+
+    size_t get_limit() const { return limit; }
+
+    // Returns true if the limit changed.
+    bool report_completion(ticks_t latency, size_t in_flight);
+
+private:
+    void end_window();
+
+    const adaptive_concurrency_params_t params;
+    size_t limit;
+
+    ticks_t window_latency_sum;
+    size_t window_samples;
+    size_t window_max_in_flight;
+
+    // The best recent window average, 0 until the first window ends.
+    double baseline_latency;
+
+    DISABLE_COPYING(adaptive_concurrency_limit_t);
+};
+
+#endif  // CONCURRENCY_ADAPTIVE_LIMIT_HPP_
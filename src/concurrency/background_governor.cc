@@ -0,0 +1,115 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/background_governor.hpp"
+
+#include "arch/timing.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+
+static int64_t background_latency_target = 0;
+
+/* The counts of the current window, which all threads add to.  Whoever notices
+that the window is over takes the counts and resets them; what the other threads
+add meanwhile may end up in either window, which doesn't matter here. */
+static volatile int64_t latency_buckets[perfmon_latency_histogram::NUM_BUCKETS];
+static volatile int64_t io_waits = 0;
+static volatile int64_t io_waits_missed = 0;
+// When, in microseconds, the current window started.
+static volatile int64_t window_start_time = 0;
+
+// What the last complete window said.
+static volatile bool latency_at_risk = false;
+
+void set_background_latency_target(int64_t microseconds) {
+    guarantee(microseconds >= 0);
+    background_latency_target = microseconds;
+    latency_at_risk = false;
+    window_start_time = current_microtime();
+}
+
+static bool latency_percentile_above_target(const int64_t *counts, int64_t total) {
+    // The percentile is in the bucket where, counting from the slowest queries,
+    // there are more than this many.
+    const int64_t slower = total * (100 - BACKGROUND_GOVERNOR_LATENCY_PERCENTILE) / 100;
+    int64_t seen = 0;
+    for (int i = perfmon_latency_histogram::NUM_BUCKETS - 1; i >= 0; --i) {
+        seen += counts[i];
+        if (seen > slower) {
+            // Only if the whole bucket is above the target, so that a percentile
+            // right at the target doesn't hold back the background work.
+            return static_cast<int64_t>(
+                perfmon_latency_histogram::bucket_lower_bound_micros(i))
+                > background_latency_target;
+        }
+    }
+    return false;
+}
+
+static void maybe_end_window() {
+    const int64_t now = current_microtime();
+    const int64_t start = window_start_time;
+    if (now - start < BACKGROUND_GOVERNOR_WINDOW_MS * THOUSAND
+        || !__sync_bool_compare_and_swap(&window_start_time, start, now)) {
+        return;
+    }
+
+    int64_t counts[perfmon_latency_histogram::NUM_BUCKETS];
+    int64_t total = 0;
+    for (int i = 0; i < perfmon_latency_histogram::NUM_BUCKETS; ++i) {
+        counts[i] = __sync_lock_test_and_set(&latency_buckets[i], 0);
+        total += counts[i];
+    }
+    const int64_t waits = __sync_lock_test_and_set(&io_waits, 0);
+    const int64_t missed = __sync_lock_test_and_set(&io_waits_missed, 0);
+
+    // Too few samples say nothing, and no queries can't be too slow.
+    bool at_risk = false;
+    if (total >= BACKGROUND_GOVERNOR_MIN_SAMPLES) {
+        at_risk = latency_percentile_above_target(counts, total);
+    }
+    if (waits >= BACKGROUND_GOVERNOR_MIN_SAMPLES
+        && missed * 100 > waits * BACKGROUND_GOVERNOR_IO_MISSED_PERCENT) {
+        at_risk = true;
+    }
+    latency_at_risk = at_risk;
+}
+
+void record_foreground_latency(ticks_t duration) {
+    if (background_latency_target == 0) {
+        return;
+    }
+    const int bucket = perfmon_latency_histogram::bucket_for_duration(duration);
+    __sync_fetch_and_add(&latency_buckets[bucket], 1);
+    maybe_end_window();
+}
+
+void record_foreground_io_wait(bool missed_target) {
+    if (background_latency_target == 0) {
+        return;
+    }
+    __sync_fetch_and_add(&io_waits, 1);
+    if (missed_target) {
+        __sync_fetch_and_add(&io_waits_missed, 1);
+    }
+    maybe_end_window();
+}
+
+bool foreground_latency_at_risk() {
+    if (background_latency_target == 0) {
+        return false;
+    }
+    // Without foreground traffic nobody else ends the windows.
+    maybe_end_window();
+    return latency_at_risk;
+}
+
+void wait_for_background_turn(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    if (!foreground_latency_at_risk()) {
+        return;
+    }
+    const int64_t deadline = current_microtime()
+        + BACKGROUND_GOVERNOR_MAX_PAUSE_MS * THOUSAND;
+    do {
+        nap(BACKGROUND_GOVERNOR_WINDOW_MS, interruptor);
+    } while (foreground_latency_at_risk()
+             && static_cast<int64_t>(current_microtime()) < deadline);
+}
@@ -0,0 +1,45 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_BACKGROUND_GOVERNOR_HPP_
+#define CONCURRENCY_BACKGROUND_GOVERNOR_HPP_
+
+#include <stdint.h>
+
+#include "utils.hpp"
+
+class signal_t;
+
+/* The background work governor holds back this node's maintenance work (backfills,
+secondary index post construction, the reclaiming of erased ranges, btree
+compaction, expiry reaping and the GC) while the foreground queries are too slow.
+
+Queries report how long they took, and cache reads report how long they waited
+for the disk.  Over each window of `BACKGROUND_GOVERNOR_WINDOW_MS`, the governor
+looks at the query latency percentile `BACKGROUND_GOVERNOR_LATENCY_PERCENTILE`
+and at how many disk reads missed their latency target.  If either is too high,
+the foreground latency target is at risk until a later window says otherwise.
+While it is, background jobs wait between batches of work and the GC writes at
+its nice I/O priority.
+
+There's no target, and so nothing is ever held back, unless
+`set_background_latency_target()` is called with a non-zero value, which should
+happen before any background work starts.  Like the backfill bandwidth limit, this
+is shared by all threads. */
+void set_background_latency_target(int64_t microseconds);
+
+// Records the duration of a foreground query.
+void record_foreground_latency(ticks_t duration);
+
+// Records how long a foreground disk read waited to be sent to the disk, and
+// whether that was longer than its latency target.
+void record_foreground_io_wait(bool missed_target);
+
+// Whether the foreground latency target is currently at risk.
+bool foreground_latency_at_risk();
+
+/* Background jobs call this between batches of work.  While the foreground
+latency target is at risk, it waits until it no longer is, but for at most
+`BACKGROUND_GOVERNOR_MAX_PAUSE_MS`, so that the background work still makes some
+progress under a load that never lets up. */
+void wait_for_background_turn(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+
+#endif  // CONCURRENCY_BACKGROUND_GOVERNOR_HPP_
@@ -5,12 +5,18 @@
 #include "errors.hpp"
 #include <boost/function.hpp>
 
+#include "concurrency/adaptive_limit.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/queue/passive_producer.hpp"
+#include "containers/scoped.hpp"
 
 /* coro_pool_t maintains a bunch of coroutines; when you give it tasks, it
 distributes them among the coroutines. It draws its tasks from a
-`passive_producer_t`. */
+`passive_producer_t`.
+
+The number of coroutines is either fixed, or adapted to the latency of the tasks
+by an `adaptive_concurrency_limit_t` if the pool is constructed from an
+`adaptive_concurrency_params_t`. */
 
 template <class T>
 class coro_pool_callback_t {
@@ -47,6 +53,18 @@ public:
         source->available->set_callback(this);
     }
 
+    coro_pool_t(const adaptive_concurrency_params_t &params,
+                passive_producer_t<T> *_source, coro_pool_callback_t<T> *_callback)
+        : max_worker_count(params.initial_limit),
+          active_worker_count(0),
+          source(_source),
+          callback(_callback),
+          adaptive_limit(new adaptive_concurrency_limit_t(params)) {
+        rassert(max_worker_count > 0);
+        on_source_availability_changed();   // Start process if necessary
+        source->available->set_callback(this);
+    }
+
     ~coro_pool_t() {
         assert_thread();
         source->available->unset_callback();
@@ -65,7 +83,18 @@ private:
         assert_thread();
         try {
             while (!coro_drain_semaphore_lock.get_drain_signal()->is_pulsed()) {
-                callback->coro_pool_callback(object, coro_drain_semaphore_lock.get_drain_signal());
+                if (adaptive_limit.has()) {
+                    ticks_t start = get_ticks();
+                    callback->coro_pool_callback(object, coro_drain_semaphore_lock.get_drain_signal());
+                    on_task_completed(get_ticks() - start);
+                } else {
+                    callback->coro_pool_callback(object, coro_drain_semaphore_lock.get_drain_signal());
+                }
+                // If the limit was lowered, surplus workers go away as they finish
+                // their current task.
+                if (active_worker_count > max_worker_count) {
+                    break;
+                }
                 if (source->available->get()) {
                     object = source->pop();
                 } else {
@@ -79,6 +108,15 @@ private:
         --active_worker_count;
     }
 
+    void on_task_completed(ticks_t latency) {
+        if (adaptive_limit->report_completion(latency, active_worker_count)) {
+            max_worker_count = adaptive_limit->get_limit();
+            // Make use of a raised limit right away, instead of waiting for the
+            // source to change its availability.
+            on_source_availability_changed();
+        }
+    }
+
     void on_source_availability_changed() {
         assert_thread();
         while (source->available->get() && active_worker_count < max_worker_count) {
@@ -92,6 +130,8 @@ private:
     int max_worker_count, active_worker_count;
     passive_producer_t<T> *source;
     coro_pool_callback_t<T> *callback;
+    // Only set for adaptive pools; owns the value of `max_worker_count`.
+    scoped_ptr_t<adaptive_concurrency_limit_t> adaptive_limit;
     auto_drainer_t coro_drain_semaphore;
 };
 
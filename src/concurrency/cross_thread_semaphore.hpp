@@ -2,6 +2,8 @@
 #ifndef CONCURRENCY_CROSS_THREAD_SEMAPHORE_HPP_
 #define CONCURRENCY_CROSS_THREAD_SEMAPHORE_HPP_
 
+#include <utility>
+
 #include "containers/scoped.hpp"
 #include "containers/intrusive_list.hpp"
 #include "concurrency/promise.hpp"
@@ -18,10 +20,11 @@ public:
     // Constructs max_count elements with the given arguments
     template <class... Args>
     explicit cross_thread_semaphore_t(size_t max_count, Args&&... args) :
-        available_value_index(0), values(max_count)
+        available_value_index(0), values(max_count), all_values(max_count)
     {
         for (size_t i = 0; i < values.size(); ++i) {
             values[i] = new value_t(std::forward<Args>(args)...);
+            all_values[i] = values[i];
         }
     }
 
@@ -31,7 +34,13 @@ public:
     class lock_t {
     public:
         explicit lock_t(cross_thread_semaphore_t *_parent, signal_t *interruptor) :
-            parent(_parent), value(parent->lock(interruptor)) { }
+            parent(_parent), value(parent->lock(interruptor, false, 0)) { }
+
+        // Takes the `preferred % max_count`-th element if it is available, so that
+        //  related work keeps going to the same element
+        lock_t(cross_thread_semaphore_t *_parent, signal_t *interruptor,
+               size_t preferred) :
+            parent(_parent), value(parent->lock(interruptor, true, preferred)) { }
 
         ~lock_t() {
             parent->unlock(value);
@@ -45,6 +54,36 @@ public:
         DISABLE_COPYING(lock_t);
     };
 
+    // Takes an available element that `pred` holds for without waiting, the value
+    //  is NULL if there is none.  `pred` is called with the mutex held.
+    class try_lock_t {
+    public:
+        template <class pred_t>
+        try_lock_t(cross_thread_semaphore_t *_parent, const pred_t &pred) :
+            parent(_parent), value(parent->try_lock(pred)) { }
+
+        ~try_lock_t() {
+            if (value != NULL) {
+                parent->unlock(value);
+            }
+        }
+
+        value_t *get_value() { return value; }
+
+    private:
+        cross_thread_semaphore_t *parent;
+        value_t *value;
+        DISABLE_COPYING(try_lock_t);
+    };
+
+    // The number of elements that are currently acquired
+    size_t count_locked();
+
+    // The number of available elements that `pred` holds for, `pred` is called with
+    //  the mutex held
+    template <class pred_t>
+    size_t count_available(const pred_t &pred);
+
 private:
     // Class used to queue up requests for items
     class request_node_t : public intrusive_list_node_t<request_node_t> {
@@ -91,7 +130,9 @@ private:
         request_node_t *request;
     };
 
-    value_t *lock(signal_t *interruptor);
+    value_t *lock(signal_t *interruptor, bool has_preference, size_t preferred);
+    template <class pred_t>
+    value_t *try_lock(const pred_t &pred);
     void unlock(value_t *value);
 
     // Mutex to control access, since a lock may be constructed from any thread
@@ -104,6 +145,8 @@ private:
 
     size_t available_value_index;
     scoped_array_t<value_t *> values;
+    // Every element in the order they were constructed, for preferred locks
+    scoped_array_t<value_t *> all_values;
     intrusive_list_t<request_node_t> request_queue;
 
     DISABLE_COPYING(cross_thread_semaphore_t);
@@ -113,8 +156,27 @@ private:
 template <class value_t>
 cross_thread_semaphore_t<value_t>::~cross_thread_semaphore_t() {
     for (size_t i = 0; i < values.size(); ++i) {
-        delete lock(NULL);
+        delete lock(NULL, false, 0);
+    }
+}
+
+template <class value_t>
+size_t cross_thread_semaphore_t<value_t>::count_locked() {
+    system_mutex_t::lock_t lock(&mutex);
+    return available_value_index;
+}
+
+template <class value_t>
+template <class pred_t>
+size_t cross_thread_semaphore_t<value_t>::count_available(const pred_t &pred) {
+    system_mutex_t::lock_t lock(&mutex);
+    size_t count = 0;
+    for (size_t i = available_value_index; i < values.size(); ++i) {
+        if (pred(values[i])) {
+            ++count;
+        }
     }
+    return count;
 }
 
 template <class value_t>
@@ -133,7 +195,9 @@ void cross_thread_semaphore_t<value_t>::pass_value_coroutine(request_node_t *req
 }
 
 template <class value_t>
-value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
+value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor,
+                                                  bool has_preference,
+                                                  size_t preferred) {
     system_mutex_t::lock_t lock(&mutex);
     value_t *result = NULL;
 
@@ -142,6 +206,16 @@ value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
         lock.unlock();
         result = request.wait_and_get(interruptor);
     } else {
+        if (has_preference) {
+            // Move the preferred element to the front of the available ones
+            value_t *target = all_values[preferred % all_values.size()];
+            for (size_t i = available_value_index; i < values.size(); ++i) {
+                if (values[i] == target) {
+                    std::swap(values[i], values[available_value_index]);
+                    break;
+                }
+            }
+        }
         result = values[available_value_index];
         values[available_value_index] = NULL;
         ++available_value_index;
@@ -151,6 +225,22 @@ value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
     return result;
 }
 
+template <class value_t>
+template <class pred_t>
+value_t *cross_thread_semaphore_t<value_t>::try_lock(const pred_t &pred) {
+    system_mutex_t::lock_t lock(&mutex);
+    for (size_t i = available_value_index; i < values.size(); ++i) {
+        if (pred(values[i])) {
+            value_t *result = values[i];
+            values[i] = values[available_value_index];
+            values[available_value_index] = NULL;
+            ++available_value_index;
+            return result;
+        }
+    }
+    return NULL;
+}
+
 template <class value_t>
 void cross_thread_semaphore_t<value_t>::unlock(value_t *value) {
     system_mutex_t::lock_t lock(&mutex);
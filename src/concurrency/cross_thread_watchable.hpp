@@ -12,6 +12,14 @@ one thread to another. Create the `cross_thread_watchable_variable_t` on the
 source thread; then call `get_watchable()`, and you will get a watchable that is
 usable on the `_dest_thread` that you passed to the constructor.
 
+If `max_staleness_ms` is nonzero, changes are delivered to `_dest_thread` at most
+once per `max_staleness_ms`. A change that arrives sooner after the previous
+delivery waits for the rest of that period, and any further changes made in the
+meantime go out together with it. So a burst of changes costs one message to the
+destination thread, and the proxy never lags by more than `max_staleness_ms`
+(plus the time the message takes). A single change after a quiet period is still
+delivered right away.
+
 See also: `cross_thread_signal_t`, which is the same thing for `signal_t`. */
 
 template <class value_t>
@@ -19,7 +27,8 @@ class cross_thread_watchable_variable_t
 {
 public:
     cross_thread_watchable_variable_t(const clone_ptr_t<watchable_t<value_t> > &watchable,
-                                      threadnum_t _dest_thread);
+                                      threadnum_t _dest_thread,
+                                      int64_t _max_staleness_ms = 0);
 
     clone_ptr_t<watchable_t<value_t> > get_watchable() {
         return clone_ptr_t<watchable_t<value_t> >(watchable.clone());
@@ -30,7 +39,7 @@ public:
 private:
     friend class cross_thread_watcher_subscription_t;
     void on_value_changed();
-    void deliver(value_t new_value);
+    void deliver(value_t new_value, signal_t *interruptor);
 
     static void call(const boost::function<void()> &f) {
         f();
@@ -75,6 +84,11 @@ private:
     threadnum_t watchable_thread;
     threadnum_t dest_thread;
 
+    const int64_t max_staleness_ms;
+    // When the last value was sent to `dest_thread`. Only used on
+    // `watchable_thread`.
+    ticks_t last_delivery_ticks;
+
     /* This object's constructor rethreads our internal components to our other
     thread, and then reverses it in the destructor. It must be a separate object
     instead of logic in the constructor/destructor because its destructor must
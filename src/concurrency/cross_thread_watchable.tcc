@@ -1,16 +1,20 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "arch/runtime/runtime.hpp"
+#include "arch/timing.hpp"
 
 template <class value_t>
 cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(const clone_ptr_t<watchable_t<value_t> > &w,
-                                                                              threadnum_t _dest_thread) :
+                                                                              threadnum_t _dest_thread,
+                                                                              int64_t _max_staleness_ms) :
     original(w),
     watchable(this),
     watchable_thread(get_thread_id()),
     dest_thread(_dest_thread),
+    max_staleness_ms(_max_staleness_ms),
+    last_delivery_ticks(0),
     rethreader(this),
     subs(boost::bind(&cross_thread_watchable_variable_t<value_t>::on_value_changed, this)),
-    deliver_cb(boost::bind(&cross_thread_watchable_variable_t<value_t>::deliver, this, _1)),
+    deliver_cb(boost::bind(&cross_thread_watchable_variable_t<value_t>::deliver, this, _1, _2)),
     messanger_pool(1, &value_producer, &deliver_cb) //Note it's very important that this coro_pool only have one worker it will be a race condition if it has more
 {
     rassert(original->get_rwi_lock_assertion()->home_thread() == watchable_thread);
@@ -25,7 +29,21 @@ void cross_thread_watchable_variable_t<value_t>::on_value_changed() {
 }
 
 template <class value_t>
-void cross_thread_watchable_variable_t<value_t>::deliver(value_t new_value) {
+void cross_thread_watchable_variable_t<value_t>::deliver(value_t new_value,
+                                                         signal_t *interruptor) {
+    if (max_staleness_ms > 0) {
+        const ticks_t period = static_cast<ticks_t>(max_staleness_ms) * MILLION;
+        const ticks_t since_last_delivery = get_ticks() - last_delivery_ticks;
+        if (since_last_delivery < period) {
+            nap((period - since_last_delivery) / MILLION, interruptor);
+            // Whatever changed while we were napping supersedes `new_value`.
+            if (value_producer.available->get()) {
+                new_value = value_producer.pop();
+            }
+        }
+        last_delivery_ticks = get_ticks();
+    }
+
     on_thread_t thread_switcher(dest_thread);
     value = new_value;
     publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
@@ -17,6 +17,25 @@ void fifo_enforcer_state_t::advance_by_write(fifo_enforcer_write_token_t token)
     num_reads = 0;
 }
 
+void fifo_enforcer_state_t::advance_by_writes(fifo_enforcer_write_range_token_t token) THROWS_NOTHING {
+    rassert(token.num_writes > 0);
+    rassert(timestamp == token.first.timestamp.timestamp_before());
+    rassert(num_reads == token.first.num_preceding_reads);
+    timestamp = token.last.timestamp_after();
+    num_reads = 0;
+}
+
+bool fifo_enforcer_write_range_token_t::extend(fifo_enforcer_write_token_t next) THROWS_NOTHING {
+    rassert(num_writes > 0);
+    if (next.num_preceding_reads != 0
+        || next.timestamp.timestamp_before() != last.timestamp_after()) {
+        return false;
+    }
+    last = next.timestamp;
+    ++num_writes;
+    return true;
+}
+
 fifo_enforcer_read_token_t fifo_enforcer_source_t::enter_read() THROWS_NOTHING {
     assert_thread();
     mutex_assertion_t::acq_t freeze(&lock);
@@ -33,6 +52,49 @@ fifo_enforcer_write_token_t fifo_enforcer_source_t::enter_write() THROWS_NOTHING
     return token;
 }
 
+fifo_enforcer_write_range_token_t fifo_enforcer_source_t::enter_writes(int64_t num_writes) THROWS_NOTHING {
+    assert_thread();
+    guarantee(num_writes > 0);
+    mutex_assertion_t::acq_t freeze(&lock);
+    fifo_enforcer_write_range_token_t token(fifo_enforcer_write_token_t(
+        transition_timestamp_t::starting_from(state.timestamp), state.num_reads));
+    state.timestamp = token.first.timestamp.timestamp_after();
+    for (int64_t i = 1; i < num_writes; ++i) {
+        token.last = transition_timestamp_t::starting_from(state.timestamp);
+        state.timestamp = token.last.timestamp_after();
+    }
+    token.num_writes = num_writes;
+    state.num_reads = 0;
+    return token;
+}
+
+/* Takes the place in the queue of an `exit_write_t` or `exit_write_range_t` that's
+destroyed before it reaches the head of the queue, so that later operations can
+still go through. It's heap-allocated and deletes itself when it's done. */
+class dummy_exit_write_t : public fifo_enforcer_sink_t::internal_exit_write_t {
+public:
+    dummy_exit_write_t(fifo_enforcer_write_range_token_t t, fifo_enforcer_sink_t *s) :
+        token(t), sink(s) { }
+private:
+    fifo_enforcer_write_token_t get_token() const {
+        return token.first;
+    }
+    fifo_enforcer_write_range_token_t get_range() const {
+        return token;
+    }
+    void on_reached_head_of_queue() {
+        // KSI: This probably calls 'delete this' later than it should.
+        sink->internal_write_queue.remove(this);
+        sink->internal_finish_writers(token);
+        delete this;
+    }
+    void on_early_shutdown() {
+        delete this;
+    }
+    fifo_enforcer_write_range_token_t token;
+    fifo_enforcer_sink_t *sink;
+};
+
 fifo_enforcer_sink_t::exit_read_t::exit_read_t() THROWS_NOTHING :
     parent(NULL), ended(false) { }
 
@@ -124,27 +186,8 @@ void fifo_enforcer_sink_t::exit_write_t::end() THROWS_NOTHING {
     } else {
         // KSI: Why would we need a dummy?
         /* Swap us out for a dummy. */
-        class dummy_exit_write_t : public internal_exit_write_t {
-        public:
-            dummy_exit_write_t(fifo_enforcer_write_token_t t, fifo_enforcer_sink_t *s) :
-                token(t), sink(s) { }
-            fifo_enforcer_write_token_t get_token() const {
-                return token;
-            }
-            void on_reached_head_of_queue() {
-                // KSI: This probably calls 'delete this' later than it should.
-                sink->internal_write_queue.remove(this);
-                sink->internal_finish_a_writer(token);
-                delete this;
-            }
-            void on_early_shutdown() {
-                delete this;
-            }
-            fifo_enforcer_write_token_t token;
-            fifo_enforcer_sink_t *sink;
-        };
         parent->internal_write_queue.swap_in_place(this,
-            new dummy_exit_write_t(token, parent));
+            new dummy_exit_write_t(fifo_enforcer_write_range_token_t(token), parent));
     }
     ended = true;
 }
@@ -155,6 +198,28 @@ fifo_enforcer_sink_t::exit_write_t::~exit_write_t() THROWS_NOTHING {
     }
 }
 
+fifo_enforcer_sink_t::exit_write_range_t::exit_write_range_t(
+        fifo_enforcer_sink_t *p, fifo_enforcer_write_range_token_t t) THROWS_NOTHING :
+    parent(p), token(t) {
+    ASSERT_FINITE_CORO_WAITING;
+    rassert(parent != NULL);
+    rassert(token.num_writes > 0);
+    parent->assert_thread();
+    mutex_assertion_t::acq_t acq(&parent->internal_lock);
+    parent->internal_write_queue.push(this);
+    parent->internal_pump();
+}
+
+fifo_enforcer_sink_t::exit_write_range_t::~exit_write_range_t() THROWS_NOTHING {
+    mutex_assertion_t::acq_t acq(&parent->internal_lock);
+    if (is_pulsed()) {
+        parent->internal_finish_writers(token);
+    } else {
+        parent->internal_write_queue.swap_in_place(this,
+            new dummy_exit_write_t(token, parent));
+    }
+}
+
 fifo_enforcer_sink_t::~fifo_enforcer_sink_t() THROWS_NOTHING {
     while (!internal_read_queue.empty()) {
         internal_exit_read_t *read = internal_read_queue.pop();
@@ -186,7 +251,7 @@ void fifo_enforcer_sink_t::internal_pump() THROWS_NOTHING {
                     internal_write_queue.peek()->get_token().timestamp.timestamp_before() == finished_state.timestamp &&
                     internal_write_queue.peek()->get_token().num_preceding_reads == finished_state.num_reads) {
                 internal_exit_write_t *write = internal_write_queue.peek();
-                popped_state.advance_by_write(write->get_token());
+                popped_state.advance_by_writes(write->get_range());
                 write->on_reached_head_of_queue();
             }
         } while (pump_should_keep_going);
@@ -207,3 +272,10 @@ void fifo_enforcer_sink_t::internal_finish_a_writer(fifo_enforcer_write_token_t
     finished_state.advance_by_write(token);
     internal_pump();
 }
+
+void fifo_enforcer_sink_t::internal_finish_writers(fifo_enforcer_write_range_token_t token) THROWS_NOTHING {
+    rassert(popped_state.timestamp == token.last.timestamp_after());
+    rassert(popped_state.num_reads == 0);
+    finished_state.advance_by_writes(token);
+    internal_pump();
+}
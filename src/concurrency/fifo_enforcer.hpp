@@ -62,6 +62,27 @@ private:
     RDB_MAKE_ME_SERIALIZABLE_2(timestamp, num_preceding_reads);
 };
 
+/* Stands for a run of consecutive write tokens with no reads between them, such
+as a batch of writes gets from `fifo_enforcer_source_t::enter_writes()`.  A sink
+lets the whole run through at once, with one entry in its queue and one wakeup,
+instead of one for each write.  The run goes from `first` to `last`. */
+class fifo_enforcer_write_range_token_t {
+public:
+    fifo_enforcer_write_range_token_t() THROWS_NOTHING : num_writes(0) { }
+    explicit fifo_enforcer_write_range_token_t(fifo_enforcer_write_token_t f) THROWS_NOTHING :
+        first(f), last(f.timestamp), num_writes(1) { }
+
+    /* Adds `next` to the end of the run and returns true if it's the write right
+    after the run, with no reads in between. Otherwise returns false. */
+    MUST_USE bool extend(fifo_enforcer_write_token_t next) THROWS_NOTHING;
+
+    fifo_enforcer_write_token_t first;
+    transition_timestamp_t last;
+    int64_t num_writes;
+private:
+    RDB_MAKE_ME_SERIALIZABLE_3(first, last, num_writes);
+};
+
 class fifo_enforcer_state_t {
 public:
     fifo_enforcer_state_t() THROWS_NOTHING :
@@ -72,6 +93,7 @@ public:
 
     void advance_by_read(fifo_enforcer_read_token_t tok) THROWS_NOTHING;
     void advance_by_write(fifo_enforcer_write_token_t tok) THROWS_NOTHING;
+    void advance_by_writes(fifo_enforcer_write_range_token_t tok) THROWS_NOTHING;
 
     state_timestamp_t timestamp;
     int64_t num_reads;
@@ -90,6 +112,9 @@ public:
     /* Enters the FIFO for write. Does not block. */
     fifo_enforcer_write_token_t enter_write() THROWS_NOTHING;
 
+    /* Enters the FIFO for `num_writes` writes in a row. Does not block. */
+    fifo_enforcer_write_range_token_t enter_writes(int64_t num_writes) THROWS_NOTHING;
+
     fifo_enforcer_state_t get_state() THROWS_NOTHING {
         return state;
     }
@@ -143,6 +168,12 @@ public:
         the operation in the queue. */
         virtual fifo_enforcer_write_token_t get_token() const = 0;
 
+        /* The consecutive writes, starting with `get_token()`'s, that the
+        operation stands for. They all go through together. */
+        virtual fifo_enforcer_write_range_token_t get_range() const {
+            return fifo_enforcer_write_range_token_t(get_token());
+        }
+
         /* Called when the operation has reached the head of the queue. It
         should remove the operation from the queue. (Or change its token, which
         is used to efficiently implement an object that stands for more than one
@@ -230,6 +261,33 @@ public:
         fifo_enforcer_write_token_t token;
     };
 
+    /* Like `exit_write_t`, but for a run of writes, which all go through at once.
+    Destroying it lets the writes after the run proceed. */
+    class exit_write_range_t : public signal_t, public internal_exit_write_t {
+    public:
+        exit_write_range_t(fifo_enforcer_sink_t *, fifo_enforcer_write_range_token_t) THROWS_NOTHING;
+        ~exit_write_range_t() THROWS_NOTHING;
+
+    private:
+        fifo_enforcer_write_token_t get_token() const {
+            return token.first;
+        }
+        fifo_enforcer_write_range_token_t get_range() const {
+            return token;
+        }
+        void on_reached_head_of_queue() {
+            parent->internal_write_queue.remove(this);
+            pulse();
+        }
+        void on_early_shutdown() {
+            crash("illegal to destroy fifo_enforcer_sink_t while outstanding "
+                "exit_write_range_t objects exist");
+        }
+
+        fifo_enforcer_sink_t *parent;
+        fifo_enforcer_write_range_token_t token;
+    };
+
     fifo_enforcer_sink_t() THROWS_NOTHING :
         popped_state(state_timestamp_t::zero(), 0),
         finished_state(state_timestamp_t::zero(), 0),
@@ -251,6 +309,7 @@ public:
     void internal_pump() THROWS_NOTHING;
     void internal_finish_a_reader(fifo_enforcer_read_token_t token) THROWS_NOTHING;
     void internal_finish_a_writer(fifo_enforcer_write_token_t token) THROWS_NOTHING;
+    void internal_finish_writers(fifo_enforcer_write_range_token_t token) THROWS_NOTHING;
 
     mutex_assertion_t internal_lock;
     intrusive_priority_queue_t<internal_exit_read_t> internal_read_queue;
@@ -25,22 +25,48 @@ void mutex_t::acq_t::reset(mutex_t *l, bool eager) {
     co_lock_mutex(l);
 }
 
+void mutex_t::inherit_priority(int priority) {
+    rassert(holder != NULL);
+    if (priority > holder->get_priority()) {
+        if (!boosted) {
+            holder_priority = holder->get_priority();
+            boosted = true;
+        }
+        holder->set_priority(priority);
+    }
+}
+
 void co_lock_mutex(mutex_t *mutex) {
+    coro_t *self = coro_t::self();
     if (mutex->locked) {
-        mutex->waiters.push_back(coro_t::self());
+        mutex->inherit_priority(self->get_priority());
+        mutex->waiters.push_back(self);
         coro_t::wait();
+        rassert(mutex->holder == self);
     } else {
         mutex->locked = true;
+        mutex->holder = self;
     }
 }
 
 void unlock_mutex(mutex_t *mutex, bool eager) {
     rassert(mutex->locked);
+    if (mutex->boosted) {
+        rassert(mutex->holder == coro_t::self());
+        mutex->holder->set_priority(mutex->holder_priority);
+        mutex->boosted = false;
+    }
     if (mutex->waiters.empty()) {
         mutex->locked = false;
+        mutex->holder = NULL;
     } else {
         coro_t *next = mutex->waiters.front();
         mutex->waiters.pop_front();
+        mutex->holder = next;
+        // The new holder inherits from the coroutines that are still waiting.
+        for (auto it = mutex->waiters.begin(); it != mutex->waiters.end(); ++it) {
+            mutex->inherit_priority((*it)->get_priority());
+        }
         if (eager) {
             next->notify_now_deprecated();
         } else {
@@ -33,7 +33,7 @@ public:
         DISABLE_COPYING(acq_t);
     };
 
-    mutex_t() : locked(false) { }
+    mutex_t() : locked(false), holder(NULL), boosted(false), holder_priority(0) { }
     ~mutex_t() { rassert(!locked); }
 
     bool is_locked() {
@@ -44,7 +44,17 @@ public:
     friend void unlock_mutex(mutex_t *mutex, bool eager);
 
 private:
+    /* While a coroutine waits for the mutex, the holder runs with at least the
+    waiter's priority, so that a low-priority holder can't keep higher-priority
+    coroutines waiting (priority inheritance). */
+    void inherit_priority(int priority);
+
     bool locked;
+    // The coroutine that acquired the mutex, and (if `boosted`) its priority from
+    // before it inherited a higher one.
+    coro_t *holder;
+    bool boosted;
+    int holder_priority;
     std::deque<coro_t *> waiters;
 
     DISABLE_COPYING(mutex_t);
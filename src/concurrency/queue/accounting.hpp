@@ -2,8 +2,13 @@
 #ifndef CONCURRENCY_QUEUE_ACCOUNTING_HPP_
 #define CONCURRENCY_QUEUE_ACCOUNTING_HPP_
 
+#include <stdint.h>
+
+#include <algorithm>
+
 #include "concurrency/queue/passive_producer.hpp"
 #include "containers/intrusive_list.hpp"
+#include "utils.hpp"
 
 /* `accounting_queue_t` is useful when you have some number of actors competing
 for a shared resource, and you want them to be granted access to the resource in
@@ -15,7 +20,33 @@ from a number of other `passive_producer_t`s. To associate the
 `account_t`s determines which `passive_producer_t`s the `accounting_queue_t`
 will `pop()` from when its own `pop()` method is called. When one of the sub-
 `passive_producer_t`s is not available, then it is ignored until it becomes
-available. */
+available.
+
+The shares are enforced with start-time fair queueing: every account has a virtual
+time that advances by the inverse of its shares whenever we pop from it, and we pop
+from the available account with the smallest virtual time.  An account that becomes
+available catches up to the virtual time of the queue, so that being idle doesn't
+let it bank credit.  To preserve sequential access patterns, we pop `batch_factor`
+times in a row from an account before looking for the next one.
+
+An account can also have a latency target.  Its source then has to implement
+`latency_sensitive_source_t`, so that we know how long the value it would `pop()`
+next has been waiting.  Once that is longer than the latency target, the account is
+served ahead of the fair share order (earliest deadline first, if several accounts
+are late).  It is still charged for it in virtual time, so a latency target lets an
+account borrow from its future share, not exceed it: accounts with lower shares
+(background work) get the capacity that is left over. */
+
+class latency_sensitive_source_t {
+public:
+    // Returns false if the source has nothing to pop.  Otherwise sets
+    // *enqueue_time_out to the time (as of `get_ticks()`) at which the value that
+    // `pop()` would return next was queued.
+    virtual bool get_head_enqueue_time(ticks_t *enqueue_time_out) = 0;
+
+protected:
+    virtual ~latency_sensitive_source_t() { }
+};
 
 template<class value_t>
 class accounting_queue_t :
@@ -25,8 +56,10 @@ class accounting_queue_t :
 public:
     explicit accounting_queue_t(int _batch_factor) :
         passive_producer_t<value_t>(&available_control),
-        total_shares(0),
-        selector(0),
+        virtual_time(0),
+        current_account(NULL),
+        current_batch_remaining(0),
+        num_active_latency_sensitive(0),
         batch_factor(_batch_factor) {
 
         rassert(batch_factor > 0);
@@ -40,16 +73,20 @@ public:
     class account_t : private availability_callback_t, public intrusive_list_node_t<account_t> {
     public:
         account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, int _shares)
-            : parent(p), source(s), shares(_shares), active(false) {
-            parent->assert_thread();
-            rassert(shares > 0);
-            if (source->available->get()) {
-                activate();
-            } else {
-                parent->inactive_accounts.push_back(this);
-            }
-            source->available->set_callback(this);
-            parent->available_control.set_available(!parent->active_accounts.empty());
+            : parent(p), source(s), shares(_shares),
+              latency_source(NULL), latency_target(0),
+              virtual_time(0), active(false) {
+            init();
+        }
+        // `ls` must be the same object as `s`, seen through its
+        // `latency_sensitive_source_t` interface.
+        account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, int _shares,
+                  latency_sensitive_source_t *ls, ticks_t _latency_target)
+            : parent(p), source(s), shares(_shares),
+              latency_source(ls), latency_target(_latency_target),
+              virtual_time(0), active(false) {
+            rassert(latency_source != NULL);
+            init();
         }
         ~account_t() {
             parent->assert_thread();
@@ -65,6 +102,18 @@ public:
     private:
         friend class accounting_queue_t;
 
+        void init() {
+            parent->assert_thread();
+            rassert(shares > 0);
+            if (source->available->get()) {
+                activate();
+            } else {
+                parent->inactive_accounts.push_back(this);
+            }
+            source->available->set_callback(this);
+            parent->available_control.set_available(!parent->active_accounts.empty());
+        }
+
         void on_source_availability_changed() {
             parent->assert_thread();
             if (source->available->get() && !active) {
@@ -80,50 +129,107 @@ public:
         void activate() {
             active = true;
             parent->active_accounts.push_back(this);
-            parent->total_shares += shares;
+            virtual_time = std::max(virtual_time, parent->virtual_time);
+            if (latency_source != NULL) {
+                ++parent->num_active_latency_sensitive;
+            }
         }
         void deactivate() {
             active = false;
             parent->active_accounts.remove(this);
-            parent->total_shares -= shares;
+            if (latency_source != NULL) {
+                --parent->num_active_latency_sensitive;
+            }
+            if (parent->current_account == this) {
+                parent->current_account = NULL;
+            }
         }
 
         accounting_queue_t *parent;
         passive_producer_t<value_t> *source;
         int shares;
+        latency_sensitive_source_t *latency_source;
+        ticks_t latency_target;
+        // The virtual time at which this account's next value is served.
+        uint64_t virtual_time;
         bool active;
     };
 
 private:
     friend class account_t;
 
+    // The virtual time charged for popping one value from an account with a single
+    // share.
+    static const uint64_t VIRTUAL_TIME_PER_SHARE = 1 << 20;
+
+    // Returns the account whose latency target passed longest ago, or NULL if no
+    // account is late.
+    account_t *most_overdue_account() {
+        const ticks_t now = get_ticks();
+        account_t *overdue = NULL;
+        ticks_t earliest_deadline = 0;
+        for (account_t *acct = active_accounts.head();
+             acct != NULL;
+             acct = active_accounts.next(acct)) {
+            ticks_t enqueue_time;
+            if (acct->latency_source != NULL
+                && acct->latency_source->get_head_enqueue_time(&enqueue_time)) {
+                const ticks_t deadline = enqueue_time + acct->latency_target;
+                if (deadline <= now
+                    && (overdue == NULL || deadline < earliest_deadline)) {
+                    overdue = acct;
+                    earliest_deadline = deadline;
+                }
+            }
+        }
+        return overdue;
+    }
+
+    account_t *account_with_earliest_virtual_time() {
+        account_t *best = active_accounts.head();
+        for (account_t *acct = active_accounts.next(best);
+             acct != NULL;
+             acct = active_accounts.next(acct)) {
+            if (acct->virtual_time < best->virtual_time) {
+                best = acct;
+            }
+        }
+        return best;
+    }
+
     intrusive_list_t<account_t> active_accounts, inactive_accounts;
 
-    int total_shares, selector, batch_factor;
+    // The virtual time of the last value we popped.
+    uint64_t virtual_time;
+
+    // The account we're popping a batch from, or NULL.
+    account_t *current_account;
+    int current_batch_remaining;
+
+    int num_active_latency_sensitive;
+
+    int batch_factor;
 
     availability_control_t available_control;
     value_t produce_next_value() {
         assert_thread();
+        rassert(!active_accounts.empty());
 
-        selector %= total_shares * batch_factor;
-        // TODO: Maybe that line should be like this instead?
-        // It would be very fair, but there might be some issues with that (like
-        // less sequential access patterns (<-- definitely a problem on rotational drives!),
-        // maybe other problems)
-        //selector = randint(total_shares);
-
-        int batch_selector = selector / batch_factor;
-
-        account_t *acct = active_accounts.head();
-        int count = 0;
-        for (;;) {
-            count += acct->shares;
-            if (count > batch_selector) {
-                break;
+        account_t *acct = NULL;
+        if (num_active_latency_sensitive > 0) {
+            acct = most_overdue_account();
+        }
+        if (acct == NULL) {
+            if (current_account == NULL || current_batch_remaining == 0) {
+                current_account = account_with_earliest_virtual_time();
+                current_batch_remaining = batch_factor;
             }
-            acct = active_accounts.next(acct);
+            --current_batch_remaining;
+            acct = current_account;
         }
-        selector++;
+
+        virtual_time = std::max(virtual_time, acct->virtual_time);
+        acct->virtual_time += VIRTUAL_TIME_PER_SHARE / acct->shares;
         return acct->source->pop();
     }
 };
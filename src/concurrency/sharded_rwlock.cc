@@ -0,0 +1,92 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/sharded_rwlock.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/cond_var.hpp"
+
+class sharded_rwlock_t::waiter_t : public intrusive_list_node_t<waiter_t> {
+public:
+    cond_t cond;
+};
+
+sharded_rwlock_t::sharded_rwlock_t() : shards(get_num_threads()) { }
+
+sharded_rwlock_t::~sharded_rwlock_t() {
+    for (size_t i = 0; i < shards.size(); ++i) {
+        guarantee(shards[i].value.readers == 0);
+        guarantee(!shards[i].value.writer);
+        guarantee(shards[i].value.waiters.empty());
+    }
+}
+
+sharded_rwlock_t::shard_t *sharded_rwlock_t::get_shard() {
+    return &shards[get_thread_id().threadnum].value;
+}
+
+void sharded_rwlock_t::acquire_shard(access_t access) {
+    shard_t *shard = get_shard();
+    // A writer that gets here first may have been overtaken by another writer by
+    // the time we run, so we have to check again after every wakeup.
+    while (shard->writer) {
+        waiter_t waiter;
+        shard->waiters.push_back(&waiter);
+        waiter.cond.wait_lazily_unordered();
+    }
+
+    if (access == access_t::read) {
+        ++shard->readers;
+    } else {
+        shard->writer = true;
+        if (shard->readers > 0) {
+            cond_t drained;
+            shard->writer_drained = &drained;
+            drained.wait_lazily_unordered();
+            shard->writer_drained = NULL;
+        }
+    }
+}
+
+void sharded_rwlock_t::release_shard(access_t access) {
+    shard_t *shard = get_shard();
+    if (access == access_t::read) {
+        rassert(shard->readers > 0);
+        --shard->readers;
+        if (shard->readers == 0 && shard->writer_drained != NULL) {
+            shard->writer_drained->pulse_if_not_already_pulsed();
+        }
+    } else {
+        rassert(shard->writer);
+        shard->writer = false;
+        while (!shard->waiters.empty()) {
+            waiter_t *waiter = shard->waiters.head();
+            shard->waiters.remove(waiter);
+            waiter->cond.pulse();
+        }
+    }
+}
+
+
+sharded_rwlock_acq_t::sharded_rwlock_acq_t(sharded_rwlock_t *lock, access_t access)
+    : lock_(lock), access_(access) {
+    if (access_ == access_t::read) {
+        lock_->acquire_shard(access_);
+    } else {
+        for (size_t i = 0; i < lock_->shards.size(); ++i) {
+            on_thread_t th((threadnum_t(i)));
+            lock_->acquire_shard(access_);
+        }
+    }
+}
+
+sharded_rwlock_acq_t::~sharded_rwlock_acq_t() {
+    assert_thread();
+    if (access_ == access_t::read) {
+        lock_->release_shard(access_);
+    } else {
+        for (size_t i = 0; i < lock_->shards.size(); ++i) {
+            on_thread_t th((threadnum_t(i)));
+            lock_->release_shard(access_);
+        }
+    }
+}
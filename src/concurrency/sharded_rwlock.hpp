@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_SHARDED_RWLOCK_HPP_
+#define CONCURRENCY_SHARDED_RWLOCK_HPP_
+
+#include "concurrency/access.hpp"
+#include "containers/intrusive_list.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+class cond_t;
+class sharded_rwlock_acq_t;
+
+/* `sharded_rwlock_t` is a read/write lock for structures that are read far more
+often than they are written, such as metadata that every query looks at.
+
+The lock keeps one shard of state per thread. A read acquisition only looks at the
+shard of its own thread, without queueing or crossing threads, so it's about as
+cheap as incrementing a counter unless a writer is around. A write acquisition
+visits every thread in turn, blocking out new readers there and waiting for the
+current ones to leave; releasing the write lock visits every thread again. So
+writers are much more expensive than with `rwlock_t`, and unlike `rwlock_t`
+acquisitions aren't granted in FIFO order across threads.
+
+Writers take the shards in thread order, so two writers can't deadlock; the later
+one waits at the first shard the other one has taken. */
+class sharded_rwlock_t {
+public:
+    sharded_rwlock_t();
+    ~sharded_rwlock_t();
+
+private:
+    friend class sharded_rwlock_acq_t;
+
+    class waiter_t;
+
+    struct shard_t {
+        shard_t() : readers(0), writer(false), writer_drained(NULL) { }
+        // The number of read acquisitions on this thread.
+        int readers;
+        // Whether a writer holds, or is waiting for the readers of, this shard.
+        bool writer;
+        // The writer waits on this for `readers` to drop to zero.
+        cond_t *writer_drained;
+        // Readers and writers that wait for `writer` to be cleared.
+        intrusive_list_t<waiter_t> waiters;
+    };
+
+    void acquire_shard(access_t access);
+    void release_shard(access_t access);
+    shard_t *get_shard();
+
+    // Each shard is only ever touched on its own thread.
+    scoped_array_t<cache_line_padded_t<shard_t> > shards;
+
+    DISABLE_COPYING(sharded_rwlock_t);
+};
+
+class sharded_rwlock_acq_t : public home_thread_mixin_debug_only_t {
+public:
+    // Blocks until the lock is acquired. The lock must be released on the same
+    // thread.
+    sharded_rwlock_acq_t(sharded_rwlock_t *lock, access_t access);
+    ~sharded_rwlock_acq_t();
+
+private:
+    sharded_rwlock_t *const lock_;
+    const access_t access_;
+
+    DISABLE_COPYING(sharded_rwlock_acq_t);
+};
+
+#endif  // CONCURRENCY_SHARDED_RWLOCK_HPP_
@@ -16,17 +16,23 @@
  */
 
 #define SOFTWARE_NAME_STRING "RethinkDB"
-#define SERIALIZER_VERSION_STRING "1.12"
+#define SERIALIZER_VERSION_STRING "1.13"
 
 /**
  * Basic configuration parameters.
  */
 
-// The number of hash-based CPU shards per table.
-// This "must" be hard-coded because a cluster cannot run with
-// differing cpu sharding factors.
+// The default number of hash-based CPU shards per table.  Each table has its
+// own count (its `cpu_shards` setting), which replicas only agree on once they
+// have all applied it.  Changing the count of an existing table takes it out of
+// service on each server until its data has been copied into the new stores, so
+// it is best chosen when the table is created.
 #define CPU_SHARDING_FACTOR                       8
 
+// The most CPU shards a table can have.  Every shard has its own store, with its
+// own cache and btree, so going past the number of cores buys nothing.
+#define MAX_CPU_SHARDING_FACTOR                   64
+
 // Defines the maximum size of the batch of IO events to process on
 // each loop iteration. A larger number will increase throughput but
 // decrease concurrency
@@ -45,6 +51,57 @@
 // useful.
 #define DEFAULT_IO_BATCH_FACTOR                   1
 
+// The largest read or write the disk backend makes by merging requests for
+// contiguous ranges of a file into a single vectored request.
+#define DISK_MERGED_REQUEST_MAX_SIZE              (1 * MEGABYTE)
+
+// In write combining mode (--write-combining), contiguous writes are gathered
+// into chunks of up to this many bytes before going to the disk.
+#define WRITE_COMBINING_BUFFER_SIZE               (1 * MEGABYTE)
+
+// The disk backend adapts how many requests it keeps in flight to the latency it
+// observes (see arch/io/disk/queue_depth.hpp), between DISK_MIN_QUEUE_DEPTH and the
+// queue depth that max_concurrent_io_requests allows.  It decides every
+// DISK_QUEUE_DEPTH_WINDOW_SIZE completions, and re-measures the latency of the
+// unloaded device every DISK_QUEUE_DEPTH_MIN_LATENCY_RESET_WINDOWS decisions.
+#define DISK_MIN_QUEUE_DEPTH                      4
+#define DISK_QUEUE_DEPTH_WINDOW_SIZE              64
+#define DISK_QUEUE_DEPTH_MIN_LATENCY_RESET_WINDOWS 256
+
+// How many milliseconds the serializer waits for other concurrent index writes
+// before writing a metablock, so that their metablock updates can share a single
+// metablock write and sync.  0 disables the wait; index writes whose LBA syncs have
+// already completed are still grouped together.
+#define DEFAULT_METABLOCK_GROUP_COMMIT_WINDOW_MS  0
+
+// How many extents the log serializer keeps allocated in the database file beyond
+// the ones that are in use, so that new extents don't have to wait for the file to
+// grow.  0 disables preallocation.
+#define DEFAULT_PREALLOCATED_EXTENTS              8
+
+// The base two logarithm of the zlib window size used for compressing blocks in the
+// log serializer.
+#define BLOCK_COMPRESSION_WINDOW_BITS             12
+
+// With sampled checksum verification, the log serializer verifies the checksum of
+// one in this many blocks it reads from disk.
+#define CHECKSUM_VERIFICATION_SAMPLE_INTERVAL     16
+
+// How often (in seconds) the log serializer's background scrubber verifies the
+// checksums of all blocks in the file.  0 disables scrubbing.
+#define DEFAULT_SCRUB_INTERVAL_SECS               (7 * 24 * 60 * 60)
+
+// How long (in seconds) a block has to go without being written before the GC moves
+// it to the log serializer's cold tier file, if there is one.
+#define DEFAULT_COLD_TIER_AGE_SECS                (24 * 60 * 60)
+
+// How many times per cold tier age the log serializer notes the latest block recency,
+// to tell which recencies are older than the cold tier age.
+#define COLD_TIER_RECENCY_CHECKPOINTS             64
+
+// I/O priority of the background scrubber.  It is the lowest we use.
+#define SCRUB_IO_PRIORITY                         1
+
 // Currently, each cache uses two IO accounts:
 // one account for writes, and one account for reads.
 // By adjusting the priorities of these accounts, reads
@@ -52,11 +109,61 @@
 #define CACHE_READS_IO_PRIORITY                   (512 / CPU_SHARDING_FACTOR)
 #define CACHE_WRITES_IO_PRIORITY                  (64 / CPU_SHARDING_FACTOR)
 
+// Reads through a cache's default read account get sent to the disk ahead of
+// other accounts' requests once they have been queued for this long (in
+// milliseconds).  Backfills and secondary index construction use their own read
+// accounts, which have no latency target.
+#define CACHE_READS_IO_LATENCY_TARGET_MS          20
+
 // The cache priority to use for secondary index post construction
 // 100 = same priority as all other read operations in the cache together.
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// The percentage of a cache's memory limit that the pages last touched by
+// backfills or by secondary index post construction may occupy.  These traverse
+// the whole btree, so without a limit they would evict everybody else's pages.
+#define BACKFILL_CACHE_MEMORY_LIMIT_PERCENT                   10
+#define SINDEX_POST_CONSTRUCTION_CACHE_MEMORY_LIMIT_PERCENT   10
+
+// Into how many ranges of keys a backfill is split.  The ranges are backfilled one
+// after another, and a backfill that's interrupted doesn't have to start over on
+// the ranges that were done (see `backfillee()`).
+#define BACKFILL_CHECKPOINT_SUBRANGES             16
+
+// How many milliseconds' worth of a backfill bandwidth limit that went unused may
+// be sent at once (see `wait_for_backfill_bandwidth()`).
+#define BACKFILL_BANDWIDTH_BURST_MS               100
+
+// The background work governor (see background_governor.hpp) judges the foreground
+// latency over windows of this many milliseconds, by this percentile of the query
+// latency and by the percentage of cache reads that waited longer than their I/O
+// latency target.  A window needs this many samples to count.  Background jobs
+// pause for at most this many milliseconds at a time while the target is at risk.
+#define BACKGROUND_GOVERNOR_WINDOW_MS             500
+#define BACKGROUND_GOVERNOR_LATENCY_PERCENTILE    99
+#define BACKGROUND_GOVERNOR_IO_MISSED_PERCENT     5
+#define BACKGROUND_GOVERNOR_MIN_SAMPLES           20
+#define BACKGROUND_GOVERNOR_MAX_PAUSE_MS          2000
+
+// The most writes the broadcaster sends to a listener in one message.  Writes that
+// reach the broadcaster while a batch is waiting to be sent join that batch.
+#define BROADCASTER_WRITE_BATCH_MAX_SIZE          256
+
+// How much each new latency counts in the moving averages that the namespace
+// interface keeps of how long masters and direct readers take to answer it.
+#define QUERY_ROUTING_LATENCY_EWMA_WEIGHT         0.2
+
+// How long a replica waits to catch up with a client's writes before it
+// refuses a read-your-writes read, in milliseconds.
+#define READ_YOUR_WRITES_MAX_WAIT_MS              200
+
+// How many times the average load of a table's shards a shard must carry for the
+// suggester to split it, and how little a run of neighbouring shards must carry
+// together for it to merge them (see `suggest_shard_changes()`).
+#define SHARD_SPLIT_LOAD_FACTOR                   2.0
+#define SHARD_MERGE_LOAD_FACTOR                   0.5
+
 // Garbage Collection uses its own two IO accounts.
 // There is one low-priority account that is meant to guarantee
 // (performance-wise) unintrusive garbage collection.
@@ -73,12 +180,95 @@
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
+// Each TCP connection reads into its buffer in chunks of at least IO_BUFFER_SIZE
+// bytes.  The chunk doubles whenever a read fills it, up to this size, so busy
+// connections get their data in few system calls, and shrinks again when reads
+// come back mostly empty.
+#define TCP_MAX_READ_CHUNK_SIZE                   (256 * KILOBYTE)
+
+// How many of the 4 KB buffers that serialized messages are built in each thread
+// keeps around for the next message, rather than freeing them.
+#define WRITE_MESSAGE_BUFFER_POOL_SIZE            64
+
+// A disk-backed queue keeps up to this many bytes of values in memory before it
+// starts writing them to its file.
+#define DBQ_MEMORY_TIER_SIZE                      (4 * MEGABYTE)
+
+// Once it's writing to its file, a disk-backed queue collects pushed values until
+// it has this many bytes of them and writes them all in one transaction.
+#define DBQ_WRITE_BATCH_SIZE                      MEGABYTE
+
+// When a disk-backed queue has to read from its file, it reads values ahead until
+// it has this many bytes of them in memory.
+#define DBQ_READ_AHEAD_SIZE                       MEGABYTE
+
+// Driver protocol responses up to this size are copied into the connection's write
+// buffer and sent together with other responses produced in the same event loop
+// pass; bigger ones are written directly.
+#define PROTOB_COALESCED_RESPONSE_MAX_SIZE        (4 * KILOBYTE)
+
+// How many requests on one client connection may run at the same time. Reading
+// further requests from the connection waits until one of them finishes.
+#define PROTOB_MAX_CONCURRENT_REQUESTS            64
+
+// How often a TLS connection checks whether it can go on when a read has to wait
+// for the socket to be writable, or a write for it to be readable (see
+// `linux_tcp_conn_t::wait_for_tls()`).
+#define TLS_POLL_INTERVAL_MS                      10
+
+// How long a peer or client gets to complete the TLS handshake.
+#define TLS_HANDSHAKE_TIMEOUT_MS                  10000
+
+// How many connections a node opens to each peer it connects to for the mailbox
+// messages to go over, besides the one for the cluster's control traffic (see
+// `connectivity_cluster_t::run_t::stripe_t`), and how long the peer gets to accept
+// them all.
+#define CLUSTER_STRIPED_CONNECTIONS               4
+#define CLUSTER_STRIPE_TIMEOUT_MS                 10000
+
+// How many buffers each thread keeps for serializing the messages it sends to
+// other nodes, and how big a buffer may grow before it's freed rather than kept.
+#define CLUSTER_SEND_BUFFER_POOL_SIZE             16
+#define CLUSTER_SEND_BUFFER_MAX_SIZE              (64 * KILOBYTE)
+
+// How many bytes of outgoing messages each thread may have queued for other nodes,
+// and how many bytes of outgoing messages may be queued for any one node, before
+// whoever sends the next message has to wait.
+#define CLUSTER_SEND_QUEUE_THREAD_BYTES           (64 * MEGABYTE)
+#define CLUSTER_SEND_QUEUE_PEER_BYTES             (32 * MEGABYTE)
+
+// How often a node sends its peers a digest of its semilattice metadata, so that
+// a peer whose metadata differs sends all of it back (see `semilattice_manager_t`).
+#define SEMILATTICE_DIGEST_INTERVAL_MS            (30 * THOUSAND)
+
+// How old the stats a server sends may be (see `stat_manager_t`), and how old the
+// stats the admin HTTP server got from the servers may be when it answers another
+// request with them.  Most stats cover one-second intervals anyway.
+#define STATS_DIGEST_MAX_AGE_MS                   1000
+
+// How often the process, cgroup and disk space stats are read, in the background;
+// stats requests get the latest reading.
+#define SYSTEM_STATS_SAMPLE_INTERVAL_MS           1000
+
+// How long the HTTP server keeps a connection open, waiting for the client's next
+// request, after answering one.
+#define HTTP_KEEPALIVE_IDLE_TIMEOUT_MS            (60 * THOUSAND)
+
 // Size of the device block size (in bytes)
 #define DEVICE_BLOCK_SIZE                         512
 
 // Size of the metablock (in bytes)
 #define METABLOCK_SIZE                            (4 * KILOBYTE)
 
+// Serializer block buffers up to SER_BUFFER_ARENA_MAX_BUFFER_SIZE bytes are carved out
+// of chunks of a single address space reservation (see serializer/buffer_arena.hpp).
+// The chunk size matches the size of a huge page.  Each thread keeps up to
+// SER_BUFFER_ARENA_THREAD_CACHE_SIZE bytes of free buffers of every size for itself.
+#define SER_BUFFER_ARENA_RESERVATION              (256 * GIGABYTE)
+#define SER_BUFFER_ARENA_CHUNK_SIZE               (2 * MEGABYTE)
+#define SER_BUFFER_ARENA_MAX_BUFFER_SIZE          (64 * KILOBYTE)
+#define SER_BUFFER_ARENA_THREAD_CACHE_SIZE        (8 * MEGABYTE)
+
 // Size of each btree node (in bytes) on disk
 #define DEFAULT_BTREE_BLOCK_SIZE                  (4 * KILOBYTE)
 
@@ -98,6 +288,25 @@
 // small values of this variable.
 #define MERGER_SERIALIZER_MAX_ACTIVE_WRITES       1
 
+// An index write that could start right away waits for this fraction of the recent
+// latency of index writes, but at most MERGER_SERIALIZER_MAX_WINDOW_MS, for more
+// index writes to merge with it, if they have recently been arriving more often
+// than that.  Timers have a resolution of a millisecond, so on SSDs the window is
+// usually empty.  It ends as soon as MERGER_SERIALIZER_MAX_BATCH_OPS block ids are
+// waiting to be written.
+#define MERGER_SERIALIZER_WINDOW_LATENCY_RATIO    0.5
+#define MERGER_SERIALIZER_MAX_WINDOW_MS           4
+#define MERGER_SERIALIZER_MAX_BATCH_OPS           4096
+// The weight of a new sample in the merger serializer's moving averages of index
+// write latency and arrival interval.
+#define MERGER_SERIALIZER_AVERAGE_WEIGHT          0.125
+
+// The most tables of one protocol whose files are opened (or created) at once,
+// such as when a server with many tables starts.  Every table opens its files and
+// stores on several threads, so a few tables keep the disk busy; more would only
+// slow each of them down.
+#define MAX_CONCURRENT_TABLE_OPENS                8
+
 // I/O priority of (merged) index writes used by the
 // merger serializer.
 #define MERGED_INDEX_WRITE_IO_PRIORITY            128
@@ -110,6 +319,10 @@
 // Ticks (in milliseconds) the internal timed tasks are performed at
 #define TIMER_TICKS_IN_MS                         5
 
+// The resolution of coarse timers (see `timer_wheel_t`); they ring up to this many
+// milliseconds late.
+#define TIMER_WHEEL_TICK_MS                       10
+
 // How many milliseconds to allow changes to sit in memory before flushing to disk
 #define DEFAULT_FLUSH_TIMER_MS                    1000
 
@@ -124,6 +337,34 @@
 // then the page replacement algorithm will on average be unable to evict pages from the cache.
 #define PAGE_REPL_NUM_TRIES                       10
 
+// The percentage of the cache's memory limit that pages which have been accessed
+// more than once since they were loaded (the "protected" segment) may occupy.
+// Keeping the rest for once-accessed pages stops a large scan from flushing the
+// frequently used pages out of the cache.
+#define CACHE_PROTECTED_SEGMENT_PERCENT           80
+
+// How often the cache balancer moves memory between the page caches on a server,
+// and the percentage of its configured memory limit that every cache keeps no
+// matter how idle it is.
+#define CACHE_BALANCER_REBALANCE_INTERVAL_MS      1000
+#define CACHE_BALANCER_MIN_SHARE_PERCENT          25
+
+// The percentage of the cgroup memory limit, if the server runs under one, that
+// the page caches may use between them.  Their configured limits are scaled down
+// to fit.
+#define CACHE_BALANCER_CGROUP_MEMORY_PERCENT      50
+
+// How often a page cache with a warm-up file writes its hot block list to it, and
+// how many of the listed blocks it reads at a time when warming up after a restart.
+#define CACHE_WARMUP_FILE_WRITE_INTERVAL_MS       (5 * 60 * 1000)
+#define CACHE_WARMUP_FILE_READ_BATCH_SIZE         64
+
+// The default size of each table's flash cache (see --flash-cache-directory), and
+// how many evicted pages a page cache may be writing to its flash cache at a time.
+// Pages evicted while that many writes are in flight just aren't cached.
+#define DEFAULT_FLASH_CACHE_SIZE_MB               1024
+#define FLASH_CACHE_MAX_WRITES_IN_FLIGHT          64
+
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
@@ -135,6 +376,62 @@
 // memcached specifies the maximum value size to be 1MB, but customers asked this to be much higher
 #define MAX_VALUE_SIZE                            (10 * MEGABYTE)
 
+// How many blob leaf blocks a blob_read_stream_t acquires at a time.
+#define BLOB_READ_STREAM_CHUNK_LEAVES             64
+
+// How many partitions a range scan that feeds an aggregation (count, sum, reduce...)
+// splits into, to load blocks from different parts of the btree at the same time.
+#define RGET_AGGREGATION_SCAN_PARTITIONS          8
+
+// Range reads that start by skipping at least SKIP_SEEK_MIN_ROWS rows (`skip`,
+// `slice`, `nth`) move the start of the range past them instead of reading them.
+// Each of up to SKIP_SEEK_MAX_ROUNDS rounds picks a key from a distribution of
+// SKIP_SEEK_SAMPLE_COUNT sampled keys and counts the rows before it on the shards.
+#define SKIP_SEEK_MIN_ROWS                        1000
+#define SKIP_SEEK_SAMPLE_COUNT                    256
+#define SKIP_SEEK_MAX_ROUNDS                      8
+
+// How many blocks of the subtrees cut out of a btree by an erase_range the background
+// reclaimer frees per transaction, and how long it pauses between transactions.
+#define ERASE_RANGE_RECLAIM_BATCH_SIZE            64
+#define ERASE_RANGE_RECLAIM_INTERVAL_MS           10
+
+// How many leaves a background compaction of a btree visits per transaction, and how
+// long it pauses between transactions (see btree_compact_leaves).
+#define BTREE_COMPACT_BATCH_LEAVES                16
+#define BTREE_COMPACT_INTERVAL_MS                 10
+
+// When a row is replaced by one of the same serialized size, only the bytes that
+// changed are written over in its blob.  Runs of changed bytes that are at most this
+// far apart are written together.
+#define ROW_PATCH_MERGE_GAP                       64
+
+// How often a rethinkdb store looks for expired rows in its expiry indexes, how many
+// it deletes per transaction, and how long it pauses between transactions while there
+// are more.  Its reads and writes go through a cache account of
+// EXPIRY_REAP_CACHE_PRIORITY.
+#define EXPIRY_REAP_INTERVAL_MS                   1000
+#define EXPIRY_REAP_BATCH_SIZE                    128
+#define EXPIRY_REAP_BATCH_INTERVAL_MS             10
+#define EXPIRY_REAP_CACHE_PRIORITY                5
+
+// How much memory each rethinkdb store may use to remember the documents of its most
+// recently read keys, so that point reads of hot keys skip the btree (see
+// hot_key_cache_t).  Zero turns the cache off.
+#define HOT_KEY_CACHE_SIZE                        (2 * MEGABYTE)
+
+// A rethinkdb store's Bloom filter of its primary btree's keys, which point reads
+// of missing keys check instead of the btree (see key_filter_t), has as many bits
+// per key as the --key-filter-bits-per-key option says, and is off by default.  It
+// is sized for KEY_FILTER_HEADROOM_PERCENT more keys than are there when it's
+// built, but for at least KEY_FILTER_MIN_KEYS.  It's built with a cache account of
+// KEY_FILTER_REBUILD_CACHE_PRIORITY, and waits for its background turn after every
+// KEY_FILTER_REBUILD_BATCH_SIZE keys.
+#define KEY_FILTER_HEADROOM_PERCENT               50
+#define KEY_FILTER_MIN_KEYS                       1024
+#define KEY_FILTER_REBUILD_CACHE_PRIORITY         5
+#define KEY_FILTER_REBUILD_BATCH_SIZE             1000
+
 // Values larger than this will be streamed in a get operation
 #define MAX_BUFFERED_GET_SIZE                     MAX_VALUE_SIZE // streaming is too slow for now, so we disable it completely
 
@@ -142,9 +439,17 @@
 // have to wait until the first one finishes
 #define MAX_CONCURRENT_QUERIES_PER_CONNECTION     500
 
+// The most keys of a run of binary protocol quiet gets that are looked up together
+// and answered with one write; a longer run is split.
+#define MEMCACHED_BINARY_MAX_GET_BATCH            1000
+
 // The number of concurrent queries when loading memcached operations from a file.
 #define MAX_CONCURRENT_QUEURIES_ON_IMPORT         1000
 
+// How much of the file is read at a time when loading memcached operations from a
+// file; the next chunk is read while the current one is parsed.
+#define IMPORT_READ_CHUNK_SIZE                    MEGABYTE
+
 // How many timestamps we store in a leaf node.  We store the
 // NUM_LEAF_NODE_EARLIER_TIMES+1 most-recent timestamps.
 #define NUM_LEAF_NODE_EARLIER_TIMES               4
@@ -163,6 +468,16 @@
 // The ratio at which we don't want to keep GC'ing.
 #define DEFAULT_GC_LOW_RATIO                      0.15
 
+// How many extents the data block GC collects in a single round.  The live blocks
+// of all of them are read at once and rewritten in a single index write.
+#define DEFAULT_GC_MAX_CONCURRENT_EXTENTS         4
+
+// The write amplification (bytes written to data extents, divided by bytes written
+// by the serializer's users) the data block GC aims for when it collects garbage
+// between the low and the high ratio.  0 disables pacing, so the GC only uses the
+// garbage ratio thresholds.
+#define DEFAULT_GC_WRITE_AMPLIFICATION_TARGET     0.0
+
 // What's the maximum number of "young" extents we can have?
 #define GC_YOUNG_EXTENT_MAX_SIZE                  50
 // What's the definition of a "young" extent in microseconds?
@@ -200,10 +515,19 @@
 
 #define COROUTINE_STACK_SIZE                      131072
 
+// When a coroutine finishes after having used more than this much of its stack,
+// the rest of the stack's memory is given back to the OS, so that stacks on the
+// free list only keep this much each.
+#define COROUTINE_STACK_RETAINED_SIZE             (32 * KILOBYTE)
+
 // How many unused coroutine stacks to keep around (maximally), before they are
 // freed. This value is per thread.
 #define COROUTINE_FREE_LIST_SIZE                  64
 
+// While the sampling profiler is on, it samples one in this many coroutine
+// resumes on each thread.
+#define SAMPLING_PROFILER_PERIOD                  64
+
 #define MAX_COROS_PER_THREAD                      10000
 
 
@@ -246,15 +570,131 @@
 // 2^(MESSAGE_SCHEDULER_MAX_PRIORITY - MESSAGE_SCHEDULER_MIN_PRIORITY + 1)
 #define MESSAGE_SCHEDULER_GRANULARITY           32
 
+// Coroutine priorities of the latency classes (see `latency_class_t`). Messages
+// sent by a coroutine, including the ones that move it to another thread, get its
+// priority, so these decide the order in which the message hub runs work.
+#define CORO_PRIORITY_INTERACTIVE               1
+#define CORO_PRIORITY_REPLICATION               MESSAGE_SCHEDULER_DEFAULT_PRIORITY
+#define CORO_PRIORITY_BACKFILL                  (-2)
+#define CORO_PRIORITY_GC                        (-2)
+
+// Cache account priority of backfill traversals, relative to the
+// `CACHE_READS_IO_PRIORITY` that interactive and replication reads go through.
+#define BACKFILL_CACHE_PRIORITY                 10
+
 // Priorities for specific tasks
-#define CORO_PRIORITY_SINDEX_CONSTRUCTION       (-2)
-#define CORO_PRIORITY_BACKFILL_SENDER           (-2)
-#define CORO_PRIORITY_BACKFILL_RECEIVER         (-2)
-#define CORO_PRIORITY_RESET_DATA                (-2)
+#define CORO_PRIORITY_SINDEX_CONSTRUCTION       CORO_PRIORITY_BACKFILL
+#define CORO_PRIORITY_BACKFILL_SENDER           CORO_PRIORITY_BACKFILL
+#define CORO_PRIORITY_BACKFILL_RECEIVER         CORO_PRIORITY_BACKFILL
+#define CORO_PRIORITY_RESET_DATA                CORO_PRIORITY_BACKFILL
+#define CORO_PRIORITY_EXPIRY_REAP               CORO_PRIORITY_BACKFILL
+#define CORO_PRIORITY_KEY_FILTER_REBUILD        CORO_PRIORITY_BACKFILL
 #define CORO_PRIORITY_REACTOR                   (-1)
 #define CORO_PRIORITY_DIRECTORY_CHANGES         (-2)
-#define CORO_PRIORITY_LBA_GC                    (-2)
-
+#define CORO_PRIORITY_LBA_GC                    CORO_PRIORITY_GC
+
+// How stale the per-thread copies of the cluster metadata that queries look at may
+// get. Changes within this period are sent to the other threads together.
+#define CROSS_THREAD_METADATA_MAX_STALENESS_MS  10
+
+// Defaults for coroutine pools that adapt their concurrency to the latency of the
+// work items (see `adaptive_concurrency_limit_t`). The limit is adjusted once per
+// window of completed items. It is cut by the backoff ratio when the average
+// latency of a window exceeds the best recent average by more than the tolerance
+// factor, and is raised by one otherwise.
+#define ADAPTIVE_CONCURRENCY_WINDOW             32
+#define ADAPTIVE_CONCURRENCY_LATENCY_TOLERANCE  2.0
+#define ADAPTIVE_CONCURRENCY_BACKOFF_RATIO      0.75
+
+// Bounds for the size cap of the batches a cursor sends. The cap starts out at
+// `batchspec_t::DEFAULT_MAX_SIZE` and adapts to how fast the client reads (see
+// `stream_cache2_t`).
+#define CURSOR_BATCH_MIN_SIZE                   (32 * KILOBYTE)
+#define CURSOR_BATCH_MAX_SIZE                   (4 * MEGABYTE)
+// A client counts as slow if it takes this many times longer than the server took
+// to produce a batch, and at least the given time, to ask for the next one.
+#define CURSOR_SLOW_CLIENT_FACTOR               8
+#define CURSOR_SLOW_CLIENT_MIN_WAIT_MS          100
+// How many bytes of batches the cursors of a connection may read ahead of the
+// client in total.
+#define CURSOR_PREFETCH_BUDGET                  (16 * MEGABYTE)
+// How many bytes of read-ahead batches the cursors of all connections may hold in
+// memory, split evenly between the threads. Past that, the batches read ahead the
+// longest time ago are spilled to disk.
+#define CURSOR_MEMORY_BUDGET                    (256 * MEGABYTE)
+
+// How many compiled queries each client connection keeps around to reuse when the
+// same query comes in again, and the size above which queries aren't kept (those
+// are usually writes of literal documents, which rarely repeat).
+#define QUERY_TERM_CACHE_SIZE                   64
+#define QUERY_TERM_CACHE_MAX_QUERY_SIZE         (16 * KILOBYTE)
+
+// How many batches of a multi-row insert may be written at the same time.
+#define INSERT_PIPELINE_WINDOW                  4
+
+// How the extproc pool resizes itself between its minimum and maximum number of
+// worker processes: it checks every so often, keeps this many idle workers started
+// ahead of demand, and shuts down the workers beyond that which have been idle
+// for the given time.
+#define EXTPROC_POOL_RESIZE_INTERVAL_MS         200
+#define EXTPROC_POOL_SPARE_WORKERS              1
+#define EXTPROC_WORKER_IDLE_TIMEOUT_MS          (60 * 1000)
+
+// The size of the shared memory ring buffer in each direction between the main
+// process and a worker process, and the size from which messages go through it
+// rather than through the socket.
+#define EXTPROC_SHM_RING_SIZE                   (4 * MEGABYTE)
+#define EXTPROC_SHM_MIN_PAYLOAD_SIZE            (16 * KILOBYTE)
+
+// The defaults of the slow query log (see `slow_query_log_t`): how many entries it
+// keeps, the duration and number of rows read from which a query is logged, and
+// how often a query is profiled so that its rows read and profile can be logged
+// (one in this many queries on each thread; 0 turns it off).
+#define SLOW_QUERY_LOG_SIZE                     100
+#define SLOW_QUERY_LOG_DURATION_THRESHOLD_MS    1000
+#define SLOW_QUERY_LOG_ROWS_READ_THRESHOLD      100000
+#define SLOW_QUERY_LOG_SAMPLE_PERIOD            1000
+
+// The defaults of query capture (see `query_capture_t`): one in how many client
+// connections have their queries captured, and how large the trace may grow.  The
+// captured queries are written out in chunks of at least the flush size, and are
+// dropped rather than buffered beyond the buffer size while the disk falls behind.
+#define QUERY_CAPTURE_SAMPLE_PERIOD             1
+#define QUERY_CAPTURE_MAX_BYTES                 (1 * GIGABYTE)
+#define QUERY_CAPTURE_FLUSH_SIZE                (64 * KILOBYTE)
+#define QUERY_CAPTURE_MAX_BUFFER_SIZE           (16 * MEGABYTE)
+
+// How many compiled `match` patterns the server keeps for reuse across queries
+// (see `get_compiled_regex`), and the length from which a pattern isn't kept.
+#define REGEX_CACHE_SIZE                        1024
+#define REGEX_CACHE_MAX_PATTERN_SIZE            (4 * KILOBYTE)
+
+// How much memory a query may hold in the arrays, groups and buffers it builds
+// before it fails (see `memory_accountant_t`), unless it sets `memory_limit`.
+#define QUERY_MEMORY_LIMIT                      (1 * GIGABYTE)
+
+// How many batches of changes a table shard queues for its changefeed clients while
+// it's still sending earlier ones, and how many changes a changefeed holds for its
+// query to read.  A changefeed that falls further behind than either is stopped
+// with an error, rather than holding up the writes or running out of memory.
+#define CHANGEFEED_SERVER_QUEUE_SIZE            1000
+#define CHANGEFEED_CLIENT_QUEUE_SIZE            100000
+
+// The log file's timestamp index has an entry about every this many bytes of the
+// file, so a read of old log messages starts this close to them; and log reads
+// are sent to the asking server in batches of this many messages.
+#define LOG_INDEX_INTERVAL_BYTES                (64 * KILOBYTE)
+#define LOG_TRANSFER_CHUNK_SIZE                 1000
+
+// How many object keys each thread keeps around to share with the next objects it
+// deserializes with the same keys (see `datum_key_interner_t`), and the length from
+// which a key isn't kept.
+#define DATUM_KEY_INTERN_SLOTS                  256
+#define DATUM_KEY_INTERN_MAX_SIZE               64
+
+// How many uuids' worth of random bytes each thread reads from /dev/urandom at a
+// time (see `generate_uuid`).
+#define UUID_RANDOM_BATCH_SIZE                  256
 
 #endif  // CONFIG_ARGS_HPP_
 
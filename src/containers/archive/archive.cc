@@ -5,9 +5,12 @@
 #include <netinet/in.h>
 
 #include <algorithm>
+#include <vector>
 
+#include "config/args.hpp"
 #include "containers/uuid.hpp"
 #include "rpc/serialize_macros.hpp"
+#include "thread_local.hpp"
 
 const char *archive_result_as_str(archive_result_t archive_result) {
     switch (archive_result) {
@@ -55,17 +58,61 @@ int64_t force_read(read_stream_t *s, void *p, int64_t n) {
     return written_so_far;
 }
 
+#ifndef THREADED_COROUTINES
+// With `THREADED_COROUTINES`, TLS is indexed by the thread pool's thread number, and
+// messages are also built in the blocker pool, which has none; so there is no pool
+// then.
+TLS_with_init(write_buffer_t *, free_write_buffers, NULL);
+TLS_with_init(int, num_free_write_buffers, 0);
+#endif
+
+write_buffer_t *write_buffer_t::allocate() {
+#ifndef THREADED_COROUTINES
+    write_buffer_t *buffer = TLS_get_free_write_buffers();
+    if (buffer != NULL) {
+        TLS_set_free_write_buffers(buffer->next_free_);
+        TLS_set_num_free_write_buffers(TLS_get_num_free_write_buffers() - 1);
+        buffer->next_free_ = NULL;
+        buffer->size = 0;
+        return buffer;
+    }
+#endif
+    return new write_buffer_t;
+}
+
+void write_buffer_t::release(write_buffer_t *buffer) {
+#ifndef THREADED_COROUTINES
+    const int num_free = TLS_get_num_free_write_buffers();
+    if (num_free < WRITE_MESSAGE_BUFFER_POOL_SIZE) {
+        buffer->next_free_ = TLS_get_free_write_buffers();
+        TLS_set_free_write_buffers(buffer);
+        TLS_set_num_free_write_buffers(num_free + 1);
+        return;
+    }
+#endif
+    delete buffer;
+}
+
 write_message_t::~write_message_t() {
     while (write_buffer_t *buffer = buffers_.head()) {
         buffers_.remove(buffer);
-        delete buffer;
+        write_buffer_t::release(buffer);
+    }
+    while (write_buffer_t *buffer = free_buffers_.head()) {
+        free_buffers_.remove(buffer);
+        write_buffer_t::release(buffer);
     }
 }
 
-void write_message_t::append(const void *p, int64_t n) {
+void write_message_t::append_to_new_buffers(const void *p, int64_t n) {
     while (n > 0) {
         if (buffers_.empty() || buffers_.tail()->size == write_buffer_t::DATA_SIZE) {
-            buffers_.push_back(new write_buffer_t);
+            if (write_buffer_t *buffer = free_buffers_.head()) {
+                free_buffers_.remove(buffer);
+                buffers_.push_back(buffer);
+            } else {
+                buffers_.push_back(write_buffer_t::allocate());
+            }
         }
 
         write_buffer_t *b = buffers_.tail();
@@ -78,6 +125,14 @@ void write_message_t::append(const void *p, int64_t n) {
     }
 }
 
+void write_message_t::clear() {
+    while (write_buffer_t *buffer = buffers_.head()) {
+        buffers_.remove(buffer);
+        buffer->size = 0;
+        free_buffers_.push_back(buffer);
+    }
+}
+
 size_t write_message_t::size() const {
     size_t ret = 0;
     for (write_buffer_t *h = buffers_.head(); h != NULL; h = buffers_.next(h)) {
@@ -86,15 +141,40 @@ size_t write_message_t::size() const {
     return ret;
 }
 
-int send_write_message(write_stream_t *s, const write_message_t *msg) {
-    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(msg)->unsafe_expose_buffers();
-    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
-        int64_t res = s->write(p->data, p->size);
+int64_t write_stream_t::writev(const iovec *iov, size_t iovcnt) {
+    int64_t total = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        int64_t res = write(iov[i].iov_base, iov[i].iov_len);
         if (res == -1) {
             return -1;
         }
-        rassert(res == p->size);
+        rassert(res == static_cast<int64_t>(iov[i].iov_len));
+        total += res;
+    }
+    return total;
+}
+
+int send_write_message(write_stream_t *s, const write_message_t *msg) {
+    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(msg)->unsafe_expose_buffers();
+    // Hand all the buffers to the stream at once, so a socket can send them with
+    // one system call instead of one per buffer.
+    std::vector<iovec> iov;
+    int64_t expected = 0;
+    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
+        iovec v;
+        v.iov_base = p->data;
+        v.iov_len = p->size;
+        iov.push_back(v);
+        expected += p->size;
+    }
+    if (iov.empty()) {
+        return 0;
+    }
+    int64_t res = s->writev(iov.data(), iov.size());
+    if (res == -1) {
+        return -1;
     }
+    rassert(res == expected);
     return 0;
 }
 
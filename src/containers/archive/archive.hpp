@@ -3,6 +3,10 @@
 #define CONTAINERS_ARCHIVE_ARCHIVE_HPP_
 
 #include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <type_traits>
 
 #include "containers/intrusive_list.hpp"
 #include "utils.hpp"
@@ -75,6 +79,10 @@ public:
     write_stream_t() { }
     // Returns n, or -1 upon error. Blocks until all bytes are written.
     virtual MUST_USE int64_t write(const void *p, int64_t n) = 0;
+    // Writes the buffers in order.  Returns the total size, or -1 upon error.  The
+    // default implementation calls write() for each buffer; streams that can send
+    // several buffers at once without copying them should override it.
+    virtual MUST_USE int64_t writev(const iovec *iov, size_t iovcnt);
 protected:
     virtual ~write_stream_t() { }
 private:
@@ -83,13 +91,22 @@ private:
 
 class write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
 public:
-    write_buffer_t() : size(0) { }
+    write_buffer_t() : size(0), next_free_(NULL) { }
+
+    // Buffers come from and go back to a small pool on each thread, so that
+    // building a message usually doesn't allocate.  A buffer may be released on a
+    // different thread than it was allocated on.
+    static write_buffer_t *allocate();
+    static void release(write_buffer_t *buffer);
 
     static const int DATA_SIZE = 4096;
     int size;
     char data[DATA_SIZE];
 
 private:
+    // The next buffer in the thread's pool, while this one is in it.
+    write_buffer_t *next_free_;
+
     DISABLE_COPYING(write_buffer_t);
 };
 
@@ -104,7 +121,21 @@ public:
     write_message_t() { }
     ~write_message_t();
 
-    void append(const void *p, int64_t n);
+    void append(const void *p, int64_t n) {
+        // Most values are a few bytes that fit in the last buffer, so that case
+        // is inlined into the serialization code.
+        write_buffer_t *b = buffers_.tail();
+        if (b != NULL && n <= write_buffer_t::DATA_SIZE - b->size) {
+            memcpy(b->data + b->size, p, n);
+            b->size += n;
+        } else {
+            append_to_new_buffers(p, n);
+        }
+    }
+
+    // Empties the message.  Its buffers are kept for what's appended next, so a
+    // write_message_t that's reused for many messages doesn't allocate for each.
+    void clear();
 
     size_t size() const;
 
@@ -118,7 +149,11 @@ public:
 private:
     friend int send_write_message(write_stream_t *s, const write_message_t *msg);
 
+    void append_to_new_buffers(const void *p, int64_t n);
+
     intrusive_list_t<write_buffer_t> buffers_;
+    // The buffers clear() emptied.
+    intrusive_list_t<write_buffer_t> free_buffers_;
 
     DISABLE_COPYING(write_message_t);
 };
@@ -187,6 +222,17 @@ empty_ok_t<T> empty_ok(T &field) {  // NOLINT(runtime/references)
 template <class T>
 struct serialized_size_t;
 
+/* `serialize_as_raw_t<T>::value` is true for types that are serialized as exactly
+the bytes they hold in memory, which means they have no padding either. Vectors
+of them are serialized with one `append()` and deserialized with one
+`force_read()`, rather than one element at a time. */
+template <class T>
+struct serialize_as_raw_t : public std::false_type { };
+
+#define ARCHIVE_MAKE_SERIALIZED_AS_RAW(typ)                             \
+    template <>                                                         \
+    struct serialize_as_raw_t<typ> : public std::true_type { }
+
 // Keep in sync with serialized_size_t defined below.
 #define ARCHIVE_PRIM_MAKE_WRITE_SERIALIZABLE(typ1, typ2)                \
     inline write_message_t &operator<<(write_message_t &msg, typ1 x) {  \
@@ -249,7 +295,9 @@ struct serialized_size_t;
                                                                         \
     template <>                                                         \
     struct serialized_size_t<typ>                                       \
-        : public std::integral_constant<size_t, sizeof(typ)> { }
+        : public std::integral_constant<size_t, sizeof(typ)> { };       \
+                                                                        \
+    ARCHIVE_MAKE_SERIALIZED_AS_RAW(typ)
 
 
 ARCHIVE_PRIM_MAKE_RAW_SERIALIZABLE(unsigned char);  // NOLINT(runtime/int)
@@ -274,6 +322,7 @@ struct serialized_size_t<bool> : public serialized_size_t<int8_t> { };
 
 write_message_t &operator<<(write_message_t &msg, const uuid_u &uuid);
 MUST_USE archive_result_t deserialize(read_stream_t *s, uuid_u *uuid);
+ARCHIVE_MAKE_SERIALIZED_AS_RAW(uuid_u);
 
 struct in_addr;
 struct in6_addr;
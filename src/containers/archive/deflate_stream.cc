@@ -0,0 +1,108 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/archive/deflate_stream.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+// How much compressed data the streams hold at a time.
+static const size_t deflate_stream_buffer_size = 64 * KILOBYTE;
+
+deflate_write_stream_t::deflate_write_stream_t(write_stream_t *stream)
+    : stream_(stream), buffer_(deflate_stream_buffer_size),
+      total_in_(0), total_out_(0) {
+    memset(&zstream_, 0, sizeof(zstream_));
+    // The fastest level, since we compress on the connection's thread as we send.
+    int res = deflateInit(&zstream_, Z_BEST_SPEED);
+    guarantee(res == Z_OK, "deflateInit failed (zlib error %d)", res);
+}
+
+deflate_write_stream_t::~deflate_write_stream_t() {
+    deflateEnd(&zstream_);
+}
+
+int64_t deflate_write_stream_t::write(const void *p, int64_t n) {
+    const char *data = static_cast<const char *>(p);
+    int64_t remaining = n;
+    do {
+        const uInt chunk_size = std::min<int64_t>(remaining, std::numeric_limits<uInt>::max());
+        zstream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        zstream_.avail_in = chunk_size;
+        data += chunk_size;
+        remaining -= chunk_size;
+        // Only the end of the write gets flushed.
+        const int flush = remaining == 0 ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+
+        // `deflate()` consumes all of the input and flushes it once it leaves
+        // some of the output buffer unused.
+        do {
+            zstream_.next_out = reinterpret_cast<Bytef *>(buffer_.data());
+            zstream_.avail_out = buffer_.size();
+            int res = deflate(&zstream_, flush);
+            guarantee(res == Z_OK || res == Z_BUF_ERROR, "deflate failed (zlib error %d)", res);
+            const int64_t out_size = buffer_.size() - zstream_.avail_out;
+            if (out_size > 0) {
+                if (stream_->write(buffer_.data(), out_size) != out_size) {
+                    return -1;
+                }
+                total_out_ += out_size;
+            }
+        } while (zstream_.avail_out == 0);
+    } while (remaining > 0);
+
+    total_in_ += n;
+    return n;
+}
+
+inflate_read_stream_t::inflate_read_stream_t(read_stream_t *stream)
+    : stream_(stream), buffer_(deflate_stream_buffer_size), failed_(false) {
+    memset(&zstream_, 0, sizeof(zstream_));
+    int res = inflateInit(&zstream_);
+    guarantee(res == Z_OK, "inflateInit failed (zlib error %d)", res);
+}
+
+inflate_read_stream_t::~inflate_read_stream_t() {
+    inflateEnd(&zstream_);
+}
+
+int64_t inflate_read_stream_t::read(void *p, int64_t n) {
+    if (failed_) {
+        return -1;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    const uInt max_size = std::min<int64_t>(n, std::numeric_limits<uInt>::max());
+    zstream_.next_out = static_cast<Bytef *>(p);
+    zstream_.avail_out = max_size;
+    for (;;) {
+        // `inflate()` may have output left over from earlier input, so we only
+        // read more input once it has none.
+        int res = inflate(&zstream_, Z_SYNC_FLUSH);
+        if (res != Z_OK && res != Z_BUF_ERROR) {
+            // The stream never ends, so `Z_STREAM_END` means corrupt data too.
+            failed_ = true;
+            return -1;
+        }
+        const int64_t out_size = max_size - zstream_.avail_out;
+        if (out_size > 0) {
+            return out_size;
+        }
+        if (zstream_.avail_in != 0) {
+            if (res == Z_BUF_ERROR) {
+                failed_ = true;
+                return -1;
+            }
+            continue;
+        }
+
+        const int64_t in_size = stream_->read(buffer_.data(), buffer_.size());
+        if (in_size <= 0) {
+            return in_size;
+        }
+        zstream_.next_in = reinterpret_cast<Bytef *>(buffer_.data());
+        zstream_.avail_in = in_size;
+    }
+}
@@ -0,0 +1,56 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_ARCHIVE_DEFLATE_STREAM_HPP_
+#define CONTAINERS_ARCHIVE_DEFLATE_STREAM_HPP_
+
+#include <zlib.h>
+
+#include "containers/archive/archive.hpp"
+#include "containers/scoped.hpp"
+
+/* `deflate_write_stream_t` compresses what's written to it into one zlib stream,
+which it writes to `stream`.  Every write is flushed, so that the other side can
+decompress it as soon as it arrives.  The compression still carries over from one
+write to the next, so a small write that resembles earlier ones compresses well
+too. */
+class deflate_write_stream_t : public write_stream_t {
+public:
+    // `stream` must outlive us.
+    explicit deflate_write_stream_t(write_stream_t *stream);
+    virtual ~deflate_write_stream_t();
+
+    virtual MUST_USE int64_t write(const void *p, int64_t n);
+
+    // How many bytes have been written to us, and how many we wrote to `stream`.
+    int64_t total_in() const { return total_in_; }
+    int64_t total_out() const { return total_out_; }
+
+private:
+    write_stream_t *const stream_;
+    z_stream zstream_;
+    scoped_array_t<char> buffer_;
+    int64_t total_in_;
+    int64_t total_out_;
+
+    DISABLE_COPYING(deflate_write_stream_t);
+};
+
+/* `inflate_read_stream_t` decompresses what a `deflate_write_stream_t` wrote to
+`stream`.  Once the data turns out to be corrupt, every read fails. */
+class inflate_read_stream_t : public read_stream_t {
+public:
+    // `stream` must outlive us.
+    explicit inflate_read_stream_t(read_stream_t *stream);
+    virtual ~inflate_read_stream_t();
+
+    virtual MUST_USE int64_t read(void *p, int64_t n);
+
+private:
+    read_stream_t *const stream_;
+    z_stream zstream_;
+    scoped_array_t<char> buffer_;
+    bool failed_;
+
+    DISABLE_COPYING(inflate_read_stream_t);
+};
+
+#endif  // CONTAINERS_ARCHIVE_DEFLATE_STREAM_HPP_
@@ -23,11 +23,8 @@ archive_result_t deserialize(read_stream_t *s, std::string *out) {
         return ARCHIVE_RANGE_ERROR;
     }
 
-    // Unfortunately we have to do an extra copy before dumping data
-    // into a std::string.
-    std::vector<char> v(sz);
-
-    int64_t num_read = force_read(s, v.data(), sz);
+    out->resize(sz);
+    int64_t num_read = force_read(s, &(*out)[0], sz);
     if (num_read == -1) {
         return ARCHIVE_SOCK_ERROR;
     }
@@ -35,8 +32,6 @@ archive_result_t deserialize(read_stream_t *s, std::string *out) {
         return ARCHIVE_SOCK_EOF;
     }
 
-    out->assign(v.data(), v.size());
-
     return ARCHIVE_SUCCESS;
 }
 
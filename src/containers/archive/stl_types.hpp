@@ -128,27 +128,73 @@ size_t serialized_size(const std::string &s);
 write_message_t &operator<<(write_message_t &msg, const std::string &s);
 MUST_USE archive_result_t deserialize(read_stream_t *s, std::string *out);
 
-// Think twice before using this function on vectors containing a primitive type --
-// it'll take O(n) time!
-// Keep in sync with operator<<.
+// The elements of vectors of types that are serialized as their raw bytes (see
+// `serialize_as_raw_t`) are copied all at once.  The result is the same as
+// serializing them one at a time.
+
 template <class T>
-size_t serialized_size(const std::vector<T> &v) {
-    size_t ret = varint_uint64_serialized_size(v.size());
+size_t serialized_vector_elements_size(const std::vector<T> &v, std::true_type) {
+    return v.size() * sizeof(T);
+}
+
+// Think twice before using this function on vectors containing a primitive type
+// that isn't serialized as its raw bytes -- it'll take O(n) time!
+template <class T>
+size_t serialized_vector_elements_size(const std::vector<T> &v, std::false_type) {
+    size_t ret = 0;
     for (auto it = v.begin(), e = v.end(); it != e; ++it) {
         ret += serialized_size(*it);
     }
     return ret;
 }
 
+template <class T>
+void serialize_vector_elements(write_message_t *msg, const std::vector<T> &v, std::true_type) {
+    msg->append(v.data(), v.size() * sizeof(T));
+}
 
-// Keep in sync with serialized_size.
 template <class T>
-write_message_t &operator<<(write_message_t &msg, const std::vector<T> &v) {
-    serialize_varint_uint64(&msg, v.size());
+void serialize_vector_elements(write_message_t *msg, const std::vector<T> &v, std::false_type) {
     for (auto it = v.begin(), e = v.end(); it != e; ++it) {
-        msg << *it;
+        *msg << *it;
+    }
+}
+
+template <class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s, std::vector<T> *v, std::true_type) {
+    const int64_t size = v->size() * sizeof(T);
+    int64_t num_read = force_read(s, v->data(), size);
+    if (num_read == -1) {
+        return ARCHIVE_SOCK_ERROR;
     }
+    if (num_read < size) {
+        return ARCHIVE_SOCK_EOF;
+    }
+    return ARCHIVE_SUCCESS;
+}
 
+template <class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s, std::vector<T> *v, std::false_type) {
+    for (size_t i = 0; i < v->size(); ++i) {
+        archive_result_t res = deserialize(s, &(*v)[i]);
+        if (res) { return res; }
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+// Keep in sync with operator<<.
+template <class T>
+size_t serialized_size(const std::vector<T> &v) {
+    return varint_uint64_serialized_size(v.size())
+        + serialized_vector_elements_size(v, serialize_as_raw_t<T>());
+}
+
+
+// Keep in sync with serialized_size.
+template <class T>
+write_message_t &operator<<(write_message_t &msg, const std::vector<T> &v) {
+    serialize_varint_uint64(&msg, v.size());
+    serialize_vector_elements(&msg, v, serialize_as_raw_t<T>());
     return msg;
 }
 
@@ -160,17 +206,12 @@ MUST_USE archive_result_t deserialize(read_stream_t *s, std::vector<T> *v) {
     archive_result_t res = deserialize_varint_uint64(s, &sz);
     if (res) { return res; }
 
-    if (sz > std::numeric_limits<size_t>::max()) {
+    if (sz > std::numeric_limits<size_t>::max() / sizeof(T)) {
         return ARCHIVE_RANGE_ERROR;
     }
 
     v->resize(sz);
-    for (uint64_t i = 0; i < sz; ++i) {
-        res = deserialize(s, &(*v)[i]);
-        if (res) { return res; }
-    }
-
-    return ARCHIVE_SUCCESS;
+    return deserialize_vector_elements(s, v, serialize_as_raw_t<T>());
 }
 
 // TODO: Stop using std::list! What are you thinking?
@@ -11,6 +11,18 @@ int64_t string_stream_t::write(const void *p, int64_t n) {
     return n;
 }
 
+int64_t string_stream_t::writev(const iovec *iov, size_t iovcnt) {
+    size_t total = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    str_.reserve(str_.size() + total);
+    for (size_t i = 0; i < iovcnt; ++i) {
+        str_.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+    }
+    return total;
+}
+
 string_read_stream_t::string_read_stream_t(std::string &&_source, int64_t _offset) :
     source(std::move(_source)), offset(_offset) {
     guarantee(offset >= 0);
@@ -12,6 +12,8 @@ public:
     virtual ~string_stream_t();
 
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    // Grows the string once for all of the buffers.
+    virtual MUST_USE int64_t writev(const iovec *iov, size_t iovcnt);
 
     std::string &str() { return str_; }
 
@@ -6,6 +6,9 @@
 tcp_conn_stream_t::tcp_conn_stream_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port)
     : conn_(new tcp_conn_t(host, port, interruptor, local_port)) { }
 
+tcp_conn_stream_t::tcp_conn_stream_t(const std::string &local_name, signal_t *interruptor)
+    : conn_(new tcp_conn_t(local_name, interruptor)) { }
+
 tcp_conn_stream_t::tcp_conn_stream_t(tcp_conn_t *conn) : conn_(conn) {
     rassert(conn_ != NULL);
 }
@@ -39,6 +42,20 @@ int64_t tcp_conn_stream_t::write(const void *p, int64_t n) {
     }
 }
 
+int64_t tcp_conn_stream_t::writev(const iovec *iov, size_t iovcnt) {
+    try {
+        cond_t non_closer;
+        conn_->writev(iov, iovcnt, &non_closer);
+        int64_t total = 0;
+        for (size_t i = 0; i < iovcnt; ++i) {
+            total += iov[i].iov_len;
+        }
+        return total;
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        return -1;
+    }
+}
+
 void tcp_conn_stream_t::rethread(threadnum_t new_thread) {
     conn_->rethread(new_thread);
 }
@@ -68,6 +85,10 @@ keepalive_tcp_conn_stream_t::keepalive_tcp_conn_stream_t(const ip_address_t &hos
     tcp_conn_stream_t(host, port, interruptor, local_port),
     keepalive_callback(NULL) { }
 
+keepalive_tcp_conn_stream_t::keepalive_tcp_conn_stream_t(const std::string &local_name, signal_t *interruptor) :
+    tcp_conn_stream_t(local_name, interruptor),
+    keepalive_callback(NULL) { }
+
 keepalive_tcp_conn_stream_t::keepalive_tcp_conn_stream_t(tcp_conn_t *conn) :
     tcp_conn_stream_t(conn),
     keepalive_callback(NULL) { }
@@ -98,6 +119,14 @@ int64_t keepalive_tcp_conn_stream_t::write(const void *p, int64_t n) {
     return tcp_conn_stream_t::write(p, n);
 }
 
+int64_t keepalive_tcp_conn_stream_t::writev(const iovec *iov, size_t iovcnt) {
+    if (keepalive_callback != NULL) {
+        keepalive_callback->keepalive_write();
+    }
+
+    return tcp_conn_stream_t::writev(iov, iovcnt);
+}
+
 rethread_tcp_conn_stream_t::rethread_tcp_conn_stream_t(tcp_conn_stream_t *conn, threadnum_t thread)
     : conn_(conn), old_thread_(conn->home_thread()), new_thread_(thread) {
     conn->rethread(thread);
@@ -11,6 +11,8 @@ class signal_t;
 class tcp_conn_stream_t : public read_stream_t, public write_stream_t {
 public:
     tcp_conn_stream_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port = 0);
+    // Connects to a `local_listener_t` on this host.
+    tcp_conn_stream_t(const std::string &local_name, signal_t *interruptor);
 
     // Takes ownership.
     explicit tcp_conn_stream_t(tcp_conn_t *conn);
@@ -18,6 +20,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t writev(const iovec *iov, size_t iovcnt);
 
     void rethread(threadnum_t new_thread);
 
@@ -41,6 +44,7 @@ private:
 class keepalive_tcp_conn_stream_t : public tcp_conn_stream_t {
 public:
     keepalive_tcp_conn_stream_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port = 0);
+    keepalive_tcp_conn_stream_t(const std::string &local_name, signal_t *interruptor);
 
     // Takes ownership.
     explicit keepalive_tcp_conn_stream_t(tcp_conn_t *conn);
@@ -57,6 +61,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t writev(const iovec *iov, size_t iovcnt);
 
 private:
     keepalive_callback_t *keepalive_callback;
@@ -15,23 +15,18 @@ size_t varint_uint64_serialized_size(uint64_t value) {
     return count;
 }
 
-void serialize_varint_uint64(write_message_t *msg, const uint64_t value) {
+void serialize_multibyte_varint_uint64(write_message_t *msg, const uint64_t value) {
     // buf needs to be 10 or more -- ceil(64/7) is 10.
     uint8_t buf[16];
     size_t size = 0;
-    if (value == 0) {
-        buf[0] = 0;
-        size = 1;
-    } else {
-        uint64_t n = value;
-        while (n >= (1 << 7)) {
-            buf[size] = ((n & ((1 << 7) - 1)) | (1 << 7));
-            ++size;
-            n >>= 7;
-        }
-        buf[size] = n;
+    uint64_t n = value;
+    while (n >= (1 << 7)) {
+        buf[size] = ((n & ((1 << 7) - 1)) | (1 << 7));
         ++size;
+        n >>= 7;
     }
+    buf[size] = n;
+    ++size;
     msg->append(buf, size);
 }
 
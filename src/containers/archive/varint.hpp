@@ -22,7 +22,18 @@
 // silently truncate out-of-range varints when decoding.
 
 size_t varint_uint64_serialized_size(uint64_t value);
-void serialize_varint_uint64(write_message_t *msg, const uint64_t value);
+
+void serialize_multibyte_varint_uint64(write_message_t *msg, const uint64_t value);
+
+// Most varints are sizes and counts that fit in one byte, so that case is inlined.
+inline void serialize_varint_uint64(write_message_t *msg, const uint64_t value) {
+    if (value < (1 << 7)) {
+        const uint8_t byte = value;
+        msg->append(&byte, 1);
+    } else {
+        serialize_multibyte_varint_uint64(msg, value);
+    }
+}
 archive_result_t deserialize_varint_uint64(read_stream_t *s, uint64_t *value_out);
 
 #endif  // CONTAINERS_ARCHIVE_VARINT_HPP_
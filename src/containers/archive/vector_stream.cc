@@ -14,6 +14,19 @@ int64_t vector_stream_t::write(const void *p, int64_t n) {
     return n;
 }
 
+int64_t vector_stream_t::writev(const iovec *iov, size_t iovcnt) {
+    size_t total = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    vec_.reserve(vec_.size() + total);
+    for (size_t i = 0; i < iovcnt; ++i) {
+        const char *chp = static_cast<const char *>(iov[i].iov_base);
+        vec_.insert(vec_.end(), chp, chp + iov[i].iov_len);
+    }
+    return total;
+}
+
 void vector_stream_t::swap(std::vector<char> *other) {
     other->swap(vec_);
 }
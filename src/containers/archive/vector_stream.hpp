@@ -12,6 +12,8 @@ public:
     virtual ~vector_stream_t();
 
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    // Grows the vector once for all of the buffers.
+    virtual MUST_USE int64_t writev(const iovec *iov, size_t iovcnt);
 
     const std::vector<char> &vector() { return vec_; }
 
@@ -5,6 +5,7 @@
 #include "buffer_cache/alt/alt.hpp"
 #include "buffer_cache/alt/blob.hpp"
 #include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
+#include "config/args.hpp"
 #include "serializer/config.hpp"
 
 
@@ -16,6 +17,9 @@ internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_ba
     : perfmon_membership(stats_parent, &perfmon_collection,
                          filename.permanent_path().c_str()),
       queue_size(0),
+      tail_values_bytes(0),
+      head_values_bytes(0),
+      file_size(0),
       head_block_id(NULL_BLOCK_ID),
       tail_block_id(NULL_BLOCK_ID) {
     filepath_file_opener_t file_opener(filename, io_backender);
@@ -33,7 +37,7 @@ internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_ba
 
     alt_cache_config_t cache_dynamic_config;
     cache_dynamic_config.page_config.memory_limit = MEGABYTE;
-    cache.init(new cache_t(serializer.get(), cache_dynamic_config,
+    cache.init(new cache_t(serializer.get(), cache_dynamic_config, NULL,
                            &perfmon_collection));
     cache_conn.init(new cache_conn_t(cache.get()));
     // Emulate cache_t::create behavior by zeroing the block with id SUPERBLOCK_ID.
@@ -51,42 +55,27 @@ internal_disk_backed_queue_t::~internal_disk_backed_queue_t() { }
 void internal_disk_backed_queue_t::push(const write_message_t &wm) {
     mutex_t::acq_t mutex_acq(&mutex);
 
-    // There's no need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
-              repli_timestamp_t::distant_past, 2);
-
-    if (head_block_id == NULL_BLOCK_ID) {
-        add_block_to_head(&txn);
+    std::vector<char> value;
+    {
+        vector_stream_t stream;
+        stream.reserve(wm.size());
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        stream.swap(&value);
     }
 
-    auto _head = make_scoped<buf_lock_t>(buf_parent_t(&txn), head_block_id,
-                                         access_t::write);
-    auto write = make_scoped<buf_write_t>(_head.get());
-    queue_block_t *head = static_cast<queue_block_t *>(write->get_data_write());
-
-    char buffer[DBQ_MAX_REF_SIZE];
-    memset(buffer, 0, DBQ_MAX_REF_SIZE);
-
-    blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
-
-    write_onto_blob(buf_parent_t(_head.get()), &blob, wm);
-
-    if (static_cast<size_t>((head->data + head->data_size) - reinterpret_cast<char *>(head)) + blob.refsize(cache->max_block_size()) > cache->max_block_size().value()) {
-        // The data won't fit in our current head block, so it's time to make a new one.
-        head = NULL;
-        write.reset();
-        _head.reset();
-        add_block_to_head(&txn);
-        _head.init(new buf_lock_t(buf_parent_t(&txn), head_block_id,
-                                  access_t::write));
-        write.init(new buf_write_t(_head.get()));
-        head = static_cast<queue_block_t *>(write->get_data_write());
+    if (file_size == 0 && head_values.empty()
+        && tail_values_bytes + value.size() <= DBQ_MEMORY_TIER_SIZE) {
+        tail_values_bytes += value.size();
+        tail_values.push_back(std::move(value));
+    } else {
+        head_values_bytes += value.size();
+        head_values.push_back(std::move(value));
+        if (head_values_bytes >= DBQ_WRITE_BATCH_SIZE) {
+            write_head_values();
+        }
     }
 
-    memcpy(head->data + head->data_size, buffer,
-           blob.refsize(cache->max_block_size()));
-    head->data_size += blob.refsize(cache->max_block_size());
-
     queue_size++;
 }
 
@@ -94,59 +83,131 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
     guarantee(size() != 0);
     mutex_t::acq_t mutex_acq(&mutex);
 
-    char buffer[DBQ_MAX_REF_SIZE];
-    // No need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
-              repli_timestamp_t::distant_past, 2);
+    if (tail_values.empty()) {
+        if (file_size != 0) {
+            read_tail_values();
+        } else {
+            // Nothing is older than the values we haven't written yet.
+            tail_values.swap(head_values);
+            tail_values_bytes = head_values_bytes;
+            head_values_bytes = 0;
+        }
+    }
+    rassert(!tail_values.empty());
 
-    buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
+    std::vector<char> value(std::move(tail_values.front()));
+    tail_values.pop_front();
+    tail_values_bytes -= value.size();
+    queue_size--;
 
-    /* Grab the data from the blob and delete it. */
-    {
-        buf_read_t read(&_tail);
-        const queue_block_t *tail
-            = static_cast<const queue_block_t *>(read.get_data_read());
-        rassert(tail->data_size != tail->live_data_offset);
-        memcpy(buffer, tail->data + tail->live_data_offset,
-               blob::ref_size(cache->max_block_size(),
-                              tail->data + tail->live_data_offset,
-                              DBQ_MAX_REF_SIZE));
+    buffer_group_t group;
+    group.add_buffer(value.size(), value.data());
+    viewer->view_buffer_group(const_view(&group));
+}
+
+void internal_disk_backed_queue_t::write_head_values() {
+    // There's no need for hard durability with an unlinked dbq file.
+    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
+              repli_timestamp_t::distant_past, head_values.size() + 1);
+
+    if (head_block_id == NULL_BLOCK_ID) {
+        add_block_to_head(&txn);
     }
 
-    /* Grab the data from the blob and delete it. */
+    auto _head = make_scoped<buf_lock_t>(buf_parent_t(&txn), head_block_id,
+                                         access_t::write);
+    auto write = make_scoped<buf_write_t>(_head.get());
+    queue_block_t *head = static_cast<queue_block_t *>(write->get_data_write());
 
-    std::vector<char> data_vec;
+    for (auto it = head_values.begin(); it != head_values.end(); ++it) {
+        char buffer[DBQ_MAX_REF_SIZE];
+        memset(buffer, 0, DBQ_MAX_REF_SIZE);
+
+        blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
+        blob.append_region(buf_parent_t(_head.get()), it->size());
+        {
+            blob_acq_t acq;
+            buffer_group_t group;
+            blob.expose_all(buf_parent_t(_head.get()), access_t::write, &group, &acq);
+            buffer_group_copy_data(&group, it->data(), it->size());
+        }
 
-    blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
-    {
-        blob_acq_t acq_group;
-        buffer_group_t blob_group;
-        blob.expose_all(buf_parent_t(&_tail), access_t::read,
-                        &blob_group, &acq_group);
+        if (static_cast<size_t>((head->data + head->data_size) - reinterpret_cast<char *>(head)) + blob.refsize(cache->max_block_size()) > cache->max_block_size().value()) {
+            // The data won't fit in our current head block, so it's time to make a new one.
+            head = NULL;
+            write.reset();
+            _head.reset();
+            add_block_to_head(&txn);
+            _head.init(new buf_lock_t(buf_parent_t(&txn), head_block_id,
+                                      access_t::write));
+            write.init(new buf_write_t(_head.get()));
+            head = static_cast<queue_block_t *>(write->get_data_write());
+        }
 
-        viewer->view_buffer_group(const_view(&blob_group));
+        memcpy(head->data + head->data_size, buffer,
+               blob.refsize(cache->max_block_size()));
+        head->data_size += blob.refsize(cache->max_block_size());
     }
 
-    int32_t data_size;
-    int32_t live_data_offset;
-    {
-        buf_write_t write(&_tail);
-        queue_block_t *tail = static_cast<queue_block_t *>(write.get_data_write());
-        /* Record how far along in the blob we are. */
-        tail->live_data_offset += blob.refsize(cache->max_block_size());
-        data_size = tail->data_size;
-        live_data_offset = tail->live_data_offset;
-    }
+    file_size += head_values.size();
+    head_values.clear();
+    head_values_bytes = 0;
+}
 
-    blob.clear(buf_parent_t(&_tail));
+void internal_disk_backed_queue_t::read_tail_values() {
+    // No need for hard durability with an unlinked dbq file.
+    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
+              repli_timestamp_t::distant_past, 2);
 
-    queue_size--;
+    while (file_size != 0 && tail_values_bytes < DBQ_READ_AHEAD_SIZE) {
+        buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
+
+        int32_t data_size;
+        int32_t live_data_offset;
+        {
+            buf_write_t write(&_tail);
+            queue_block_t *tail = static_cast<queue_block_t *>(write.get_data_write());
+            rassert(tail->data_size != tail->live_data_offset);
+
+            // Read the values in this block that we want and delete their blobs.
+            while (tail->live_data_offset != tail->data_size
+                   && tail_values_bytes < DBQ_READ_AHEAD_SIZE) {
+                char buffer[DBQ_MAX_REF_SIZE];
+                memcpy(buffer, tail->data + tail->live_data_offset,
+                       blob::ref_size(cache->max_block_size(),
+                                      tail->data + tail->live_data_offset,
+                                      DBQ_MAX_REF_SIZE));
+
+                blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
+                std::vector<char> value(blob.valuesize());
+                {
+                    blob_acq_t acq_group;
+                    buffer_group_t blob_group;
+                    blob.expose_all(buf_parent_t(&_tail), access_t::read,
+                                    &blob_group, &acq_group);
+                    buffer_group_t value_group;
+                    value_group.add_buffer(value.size(), value.data());
+                    buffer_group_copy_data(&value_group, const_view(&blob_group));
+                }
+
+                /* Record how far along in the block we are. */
+                tail->live_data_offset += blob.refsize(cache->max_block_size());
+                blob.clear(buf_parent_t(&_tail));
+
+                tail_values_bytes += value.size();
+                tail_values.push_back(std::move(value));
+                --file_size;
+            }
+            data_size = tail->data_size;
+            live_data_offset = tail->live_data_offset;
+        }
 
-    _tail.reset_buf_lock();
+        _tail.reset_buf_lock();
 
-    /* If that was the last blob in this block move on to the next one. */
-    if (live_data_offset == data_size) {
-        remove_block_from_tail(&txn);
+        /* If that was the last blob in this block move on to the next one. */
+        if (live_data_offset == data_size) {
+            remove_block_from_tail(&txn);
+        }
     }
 }
 
@@ -2,6 +2,7 @@
 #ifndef CONTAINERS_DISK_BACKED_QUEUE_HPP_
 #define CONTAINERS_DISK_BACKED_QUEUE_HPP_
 
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -39,6 +40,11 @@ protected:
     DISABLE_COPYING(buffer_group_viewer_t);
 };
 
+/* Values are only written to the file once more than `DBQ_MEMORY_TIER_SIZE` bytes
+of them are queued.  From then on, pushed values are collected in memory and written
+`DBQ_WRITE_BATCH_SIZE` bytes at a time, each batch in one transaction, and pops read
+`DBQ_READ_AHEAD_SIZE` bytes of values back from the file at a time.  So in queue
+order there are `tail_values`, then the values in the file, then `head_values`. */
 class internal_disk_backed_queue_t {
 public:
     internal_disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent);
@@ -55,6 +61,8 @@ public:
     int64_t size();
 
 private:
+    void write_head_values();
+    void read_tail_values();
     void add_block_to_head(txn_t *txn);
     void remove_block_from_tail(txn_t *txn);
 
@@ -67,6 +75,15 @@ private:
 
     int64_t queue_size;
 
+    // The oldest values, which were never written or have been read back.
+    std::deque<std::vector<char> > tail_values;
+    size_t tail_values_bytes;
+    // Values pushed since we started using the file, waiting to be written to it.
+    std::deque<std::vector<char> > head_values;
+    size_t head_values_bytes;
+    // How many values are in the file.
+    int64_t file_size;
+
     // The end we push onto.
     block_id_t head_block_id;
     // The end we pop from.
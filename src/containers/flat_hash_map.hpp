@@ -0,0 +1,244 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_FLAT_HASH_MAP_HPP_
+#define CONTAINERS_FLAT_HASH_MAP_HPP_
+
+#include <stdint.h>
+
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "errors.hpp"
+
+/* A hash map that keeps its elements in one array, with open addressing and linear
+probing, so that a lookup usually reads a single cache line instead of following
+pointers through a tree.  It has the parts of the `std::unordered_map` interface that
+its users need.
+
+Unlike with `std::unordered_map`, inserting or erasing an element moves other
+elements and invalidates all iterators and references into the map.  An erased
+element is destroyed after the map is consistent again, so its destructor may block
+or use the map. */
+template <class key_t, class mapped_t, class hash_t = std::hash<key_t>,
+          class equal_t = std::equal_to<key_t> >
+class flat_hash_map_t {
+public:
+    typedef std::pair<const key_t, mapped_t> value_type;
+
+private:
+    struct slot_t {
+        bool full;
+        typename std::aligned_storage<sizeof(value_type),
+                                      alignof(value_type)>::type storage;
+
+        value_type *value() { return reinterpret_cast<value_type *>(&storage); }
+    };
+
+    template <class map_t, class result_t>
+    class iterator_base_t {
+    public:
+        iterator_base_t() : slot_(NULL), end_(NULL) { }
+        result_t &operator*() const { return *slot_->value(); }
+        result_t *operator->() const { return slot_->value(); }
+        iterator_base_t &operator++() {
+            ++slot_;
+            skip_empty();
+            return *this;
+        }
+        bool operator==(const iterator_base_t &other) const {
+            return slot_ == other.slot_;
+        }
+        bool operator!=(const iterator_base_t &other) const {
+            return slot_ != other.slot_;
+        }
+
+    private:
+        friend class flat_hash_map_t;
+        iterator_base_t(slot_t *slot, slot_t *end) : slot_(slot), end_(end) { }
+        void skip_empty() {
+            while (slot_ != end_ && !slot_->full) {
+                ++slot_;
+            }
+        }
+
+        slot_t *slot_;
+        slot_t *end_;
+    };
+
+public:
+    typedef iterator_base_t<flat_hash_map_t, value_type> iterator;
+    typedef iterator_base_t<const flat_hash_map_t, const value_type> const_iterator;
+
+    flat_hash_map_t() : slots_(NULL), capacity_(0), size_(0), shift_(64) { }
+
+    ~flat_hash_map_t() {
+        clear();
+        delete[] slots_;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    iterator begin() { return make_iterator<iterator>(slots_); }
+    iterator end() { return iterator(slots_ + capacity_, slots_ + capacity_); }
+    const_iterator begin() const { return make_iterator<const_iterator>(slots_); }
+    const_iterator end() const {
+        return const_iterator(slots_ + capacity_, slots_ + capacity_);
+    }
+
+    iterator find(const key_t &key) {
+        slot_t *slot = find_slot(key);
+        return slot == NULL ? end() : iterator(slot, slots_ + capacity_);
+    }
+    const_iterator find(const key_t &key) const {
+        slot_t *slot = find_slot(key);
+        return slot == NULL ? end() : const_iterator(slot, slots_ + capacity_);
+    }
+    size_t count(const key_t &key) const { return find_slot(key) == NULL ? 0 : 1; }
+
+    // Like `std::unordered_map::insert`, doesn't replace an existing element.
+    template <class pair_t>
+    std::pair<iterator, bool> insert(pair_t &&pair) {
+        slot_t *slot = find_slot(pair.first);
+        if (slot != NULL) {
+            return std::make_pair(iterator(slot, slots_ + capacity_), false);
+        }
+        if ((size_ + 1) * 4 > capacity_ * 3) {
+            grow();
+        }
+        slot = place(std::forward<pair_t>(pair));
+        ++size_;
+        return std::make_pair(iterator(slot, slots_ + capacity_), true);
+    }
+
+    mapped_t &operator[](const key_t &key) {
+        return insert(std::make_pair(key, mapped_t())).first->second;
+    }
+
+    size_t erase(const key_t &key) {
+        slot_t *slot = find_slot(key);
+        if (slot == NULL) {
+            return 0;
+        }
+        erase_slot(slot);
+        return 1;
+    }
+
+    void erase(iterator it) {
+        rassert(it.slot_ != slots_ + capacity_ && it.slot_->full);
+        erase_slot(it.slot_);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (slots_[i].full) {
+                slots_[i].full = false;
+                slots_[i].value()->~value_type();
+            }
+        }
+        size_ = 0;
+    }
+
+private:
+    template <class it_t>
+    it_t make_iterator(slot_t *slot) const {
+        it_t it(slot, slots_ + capacity_);
+        it.skip_empty();
+        return it;
+    }
+
+    // Fibonacci hashing: the multiplication spreads keys that differ only in their
+    // low bits, such as sequential ids, over the table.
+    size_t home(const key_t &key) const {
+        return static_cast<size_t>(
+            (static_cast<uint64_t>(hash_t()(key)) * 0x9E3779B97F4A7C15ULL) >> shift_);
+    }
+
+    slot_t *find_slot(const key_t &key) const {
+        if (size_ == 0) {
+            return NULL;
+        }
+        const size_t mask = capacity_ - 1;
+        for (size_t i = home(key); ; i = (i + 1) & mask) {
+            if (!slots_[i].full) {
+                return NULL;
+            }
+            if (equal_t()(slots_[i].value()->first, key)) {
+                return &slots_[i];
+            }
+        }
+    }
+
+    // The key must not be in the map, and there must be an empty slot.
+    template <class pair_t>
+    slot_t *place(pair_t &&pair) {
+        const size_t mask = capacity_ - 1;
+        size_t i = home(pair.first);
+        while (slots_[i].full) {
+            i = (i + 1) & mask;
+        }
+        new (slots_[i].value()) value_type(std::forward<pair_t>(pair));
+        slots_[i].full = true;
+        return &slots_[i];
+    }
+
+    void grow() {
+        slot_t *old_slots = slots_;
+        const size_t old_capacity = capacity_;
+        if (old_capacity == 0) {
+            capacity_ = 8;
+            shift_ = 64 - 3;
+        } else {
+            capacity_ = old_capacity * 2;
+            --shift_;
+        }
+        slots_ = new slot_t[capacity_];
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].full = false;
+        }
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_slots[i].full) {
+                place(std::move(*old_slots[i].value()));
+                old_slots[i].value()->~value_type();
+            }
+        }
+        delete[] old_slots;
+    }
+
+    void erase_slot(slot_t *slot) {
+        // Destroyed when we return, once the map is consistent.
+        value_type erased(std::move(*slot->value()));
+        slot->value()->~value_type();
+        slot->full = false;
+        --size_;
+
+        // Move later elements of the probe sequence back into the hole, so that
+        // lookups never have to skip over deleted slots.
+        const size_t mask = capacity_ - 1;
+        size_t hole = slot - slots_;
+        for (size_t i = (hole + 1) & mask; slots_[i].full; i = (i + 1) & mask) {
+            const size_t h = home(slots_[i].value()->first);
+            // Whether `h` is cyclically in `(hole, i]`, so the element must stay.
+            const bool stays = hole <= i ? (hole < h && h <= i) : (hole < h || h <= i);
+            if (!stays) {
+                new (slots_[hole].value()) value_type(std::move(*slots_[i].value()));
+                slots_[hole].full = true;
+                slots_[i].value()->~value_type();
+                slots_[i].full = false;
+                hole = i;
+            }
+        }
+    }
+
+    slot_t *slots_;
+    // Zero or a power of two.
+    size_t capacity_;
+    size_t size_;
+    // 64 minus log2(capacity_).
+    int shift_;
+
+    DISABLE_COPYING(flat_hash_map_t);
+};
+
+#endif  // CONTAINERS_FLAT_HASH_MAP_HPP_
@@ -0,0 +1,103 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_FLAT_MAP_HPP_
+#define CONTAINERS_FLAT_MAP_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+
+/* A map kept in one vector sorted by key, for small maps and maps whose keys mostly
+arrive in increasing order.  Lookups are binary searches over contiguous memory, and
+iteration is in key order.  It has the parts of the `std::map` interface that its
+users need.
+
+Unlike with `std::map`, inserting or erasing an element moves the elements after it
+and invalidates iterators and references to them.  The keys mustn't be changed
+through an iterator.  An erased element is destroyed after the map is consistent
+again, so its destructor may block or use the map. */
+template <class key_t, class mapped_t, class less_t = std::less<key_t> >
+class flat_map_t {
+public:
+    typedef std::pair<key_t, mapped_t> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    flat_map_t() { }
+
+    size_t size() const { return pairs_.size(); }
+    bool empty() const { return pairs_.empty(); }
+
+    iterator begin() { return pairs_.begin(); }
+    iterator end() { return pairs_.end(); }
+    const_iterator begin() const { return pairs_.begin(); }
+    const_iterator end() const { return pairs_.end(); }
+
+    iterator lower_bound(const key_t &key) {
+        // Appending is the common case, so check the last element first.
+        if (pairs_.empty() || less_t()(pairs_.back().first, key)) {
+            return pairs_.end();
+        }
+        return std::lower_bound(pairs_.begin(), pairs_.end(), key, key_less_t());
+    }
+    const_iterator lower_bound(const key_t &key) const {
+        return std::lower_bound(pairs_.begin(), pairs_.end(), key, key_less_t());
+    }
+
+    iterator find(const key_t &key) {
+        iterator it = lower_bound(key);
+        return it != pairs_.end() && !less_t()(key, it->first) ? it : pairs_.end();
+    }
+    const_iterator find(const key_t &key) const {
+        const_iterator it = lower_bound(key);
+        return it != pairs_.end() && !less_t()(key, it->first) ? it : pairs_.end();
+    }
+    size_t count(const key_t &key) const { return find(key) == end() ? 0 : 1; }
+
+    // Like `std::map::insert`, doesn't replace an existing element.
+    template <class pair_t>
+    std::pair<iterator, bool> insert(pair_t &&pair) {
+        iterator it = lower_bound(pair.first);
+        if (it != pairs_.end() && !less_t()(pair.first, it->first)) {
+            return std::make_pair(it, false);
+        }
+        it = pairs_.insert(it, value_type(std::forward<pair_t>(pair)));
+        return std::make_pair(it, true);
+    }
+
+    mapped_t &operator[](const key_t &key) {
+        return insert(std::make_pair(key, mapped_t())).first->second;
+    }
+
+    size_t erase(const key_t &key) {
+        iterator it = find(key);
+        if (it == pairs_.end()) {
+            return 0;
+        }
+        erase(it);
+        return 1;
+    }
+
+    void erase(iterator it) {
+        // Destroyed when we return, once the map is consistent.
+        value_type erased(std::move(*it));
+        pairs_.erase(it);
+    }
+
+    void clear() { pairs_.clear(); }
+
+private:
+    struct key_less_t {
+        bool operator()(const value_type &pair, const key_t &key) const {
+            return less_t()(pair.first, key);
+        }
+    };
+
+    std::vector<value_type> pairs_;
+
+    DISABLE_COPYING(flat_map_t);
+};
+
+#endif  // CONTAINERS_FLAT_MAP_HPP_
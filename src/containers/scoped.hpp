@@ -209,6 +209,20 @@ private:
 
 // For dumb structs that get malloc/free for allocation.
 
+// Serializer block buffers may come from the buffer arena instead (see
+// serializer/buffer_arena.hpp), so they have to be freed through it.
+struct ser_buffer_t;
+void free_ser_buffer(ser_buffer_t *buf);
+
+template <class T>
+inline void scoped_malloc_free(T *ptr) {
+    free(ptr);
+}
+
+inline void scoped_malloc_free(ser_buffer_t *ptr) {
+    free_ser_buffer(ptr);
+}
+
 template <class T>
 class scoped_malloc_t {
 public:
@@ -227,7 +241,7 @@ public:
     }
 
     ~scoped_malloc_t() {
-        free(ptr_);
+        scoped_malloc_free(ptr_);
     }
 
     void operator=(scoped_malloc_t &&movee) {
@@ -6,8 +6,8 @@
 #include <sys/stat.h>
 #include <string.h>
 #include <fcntl.h>
-#include <array>
 
+#include "config/args.hpp"
 #include "containers/printf_buffer.hpp"
 #include "utils.hpp"
 #include "thread_local.hpp"
@@ -42,58 +42,86 @@ bool operator<(const uuid_u& x, const uuid_u& y) {
     return memcmp(x.data(), y.data(), uuid_u::static_size()) < 0;
 }
 
-TLS_with_init(bool, next_uuid_initialized, false);
-typedef std::array<uint8_t, uuid_u::kStaticSize> next_uuid_t;
-TLS(next_uuid_t, next_uuid);
-
-uuid_u get_and_increment_uuid() {
-    uuid_u result;
-
-    next_uuid_t next_uuid = TLS_get_next_uuid();
-
-    // Copy over the next_uuid buffer
-    uint8_t *result_buffer = result.data();
-    memcpy(result_buffer, next_uuid.data(), uuid_u::static_size());
-
-    // Increment the next_uuid buffer
-    bool carry = true;
-    for (size_t i = uuid_u::static_size(); carry && i > 0; --i) {
-        next_uuid[i - 1] = next_uuid[i - 1] + 1;
-        carry = (next_uuid[i - 1] == 0);
+/* Each thread reads the random bytes of its uuids from /dev/urandom a batch of
+uuids at a time, so that generating one is mostly a copy. */
+struct uuid_generator_t {
+    uuid_generator_t() : next(UUID_RANDOM_BATCH_SIZE), last_ms(0), seq(0) { }
+
+    uint8_t random_bytes[UUID_RANDOM_BATCH_SIZE * uuid_u::kStaticSize];
+    // How many uuids' worth of `random_bytes` have been handed out.
+    size_t next;
+
+    // The timestamp of the last time-ordered uuid, and its sequence number within
+    // that millisecond.
+    uint64_t last_ms;
+    uint16_t seq;
+};
+
+TLS_with_init(uuid_generator_t *, uuid_generator, NULL);
+
+static uuid_generator_t *get_uuid_generator() {
+    uuid_generator_t *generator = TLS_get_uuid_generator();
+    if (generator == NULL) {
+        // This lives as long as the thread does.
+        generator = new uuid_generator_t;
+        TLS_set_uuid_generator(generator);
     }
-    TLS_set_next_uuid(next_uuid);
-
-    return result;
+    return generator;
 }
 
-// TODO(sam):  Make sure this isn't messed up somehow.
-void hash_uuid(uuid_u *uuid) {
-    CT_ASSERT(20 >= uuid_u::kStaticSize);
-    uint8_t output_buffer[20];
+static void take_random_bytes(uuid_generator_t *generator, uuid_u *out) {
+    if (generator->next == UUID_RANDOM_BATCH_SIZE) {
+        get_dev_urandom(generator->random_bytes, sizeof(generator->random_bytes));
+        generator->next = 0;
+    }
+    memcpy(out->data(),
+           generator->random_bytes + generator->next * uuid_u::kStaticSize,
+           uuid_u::kStaticSize);
+    ++generator->next;
+}
 
-    sha1::calc(uuid->data(), uuid_u::static_size(), output_buffer);
+uuid_u generate_uuid() {
+    uuid_u result;
+    take_random_bytes(get_uuid_generator(), &result);
 
     // Set some bits to obey standard for version 4 UUIDs.
-    output_buffer[6] = ((output_buffer[6] & 0x0f) | 0x40);
-    output_buffer[8] = ((output_buffer[8] & 0x3f) | 0x80);
-
-    // Copy the beginning of the hash into our uuid
-    memcpy(uuid->data(), output_buffer, uuid_u::static_size());
+    uint8_t *data = result.data();
+    data[6] = ((data[6] & 0x0f) | 0x40);
+    data[8] = ((data[8] & 0x3f) | 0x80);
+    return result;
 }
 
-void initialize_dev_random_uuid() {
-    next_uuid_t next_uuid;
-    get_dev_urandom(next_uuid.data(), uuid_u::static_size());
-    TLS_set_next_uuid(next_uuid);
-}
+uuid_u generate_time_ordered_uuid() {
+    uuid_generator_t *generator = get_uuid_generator();
+
+    uint64_t ms = current_microtime() / THOUSAND;
+    if (ms <= generator->last_ms) {
+        // The clock hasn't moved on (or went back), so count on from the last uuid
+        // to keep this thread's uuids increasing.
+        ms = generator->last_ms;
+        if (generator->seq == 0xfff) {
+            ++ms;
+            generator->seq = 0;
+        } else {
+            ++generator->seq;
+        }
+    } else {
+        generator->seq = 0;
+    }
+    generator->last_ms = ms;
 
-uuid_u generate_uuid() {
-    if (!TLS_get_next_uuid_initialized()) {
-        initialize_dev_random_uuid();
-        TLS_set_next_uuid_initialized(true);
+    uuid_u result;
+    take_random_bytes(generator, &result);
+
+    // The layout of version 7 UUIDs: 48 bits of milliseconds, big-endian, then the
+    // version and 12 bits of sequence number, then the variant and random bits.
+    uint8_t *data = result.data();
+    for (int i = 0; i < 6; ++i) {
+        data[i] = static_cast<uint8_t>(ms >> (8 * (5 - i)));
     }
-    uuid_u result = get_and_increment_uuid();
-    hash_uuid(&result);
+    data[6] = static_cast<uint8_t>(0x70 | (generator->seq >> 8));
+    data[7] = static_cast<uint8_t>(generator->seq & 0xff);
+    data[8] = ((data[8] & 0x3f) | 0x80);
     return result;
 }
 
@@ -107,40 +135,24 @@ void debug_print(printf_buffer_t *buf, const uuid_u& id) {
     buf->appendf("%s", uuid_to_str(id).c_str());
 }
 
-void push_hex(std::string *s, uint8_t byte) {
-    const char *buf = "0123456789abcdef";
-    s->push_back(buf[byte >> 4]);
-    s->push_back(buf[byte & 0x0f]);
-}
-
 std::string uuid_to_str(uuid_u id) {
+    static const char *const hex = "0123456789abcdef";
     const uint8_t *data = id.data();
 
-    std::string ret;
-    ret.reserve(uuid_u::kStringSize);
-    size_t i = 0;
-    for (; i < 4; ++i) {
-        push_hex(&ret, data[i]);
-    }
-    ret.push_back('-');
-    for (; i < 6; ++i) {
-        push_hex(&ret, data[i]);
-    }
-    ret.push_back('-');
-    for (; i < 8; ++i) {
-        push_hex(&ret, data[i]);
-    }
-    ret.push_back('-');
-    for (; i < 10; ++i) {
-        push_hex(&ret, data[i]);
-    }
-    ret.push_back('-');
+    // Fill a buffer and make the string once, rather than appending to it.
+    char buf[uuid_u::kStringSize];
+    size_t j = 0;
     CT_ASSERT(uuid_u::kStaticSize == 16);  // This code just feels this assertion in its bones.
-    for (; i < uuid_u::kStaticSize; ++i) {
-        push_hex(&ret, data[i]);
+    for (size_t i = 0; i < uuid_u::kStaticSize; ++i) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            buf[j++] = '-';
+        }
+        buf[j++] = hex[data[i] >> 4];
+        buf[j++] = hex[data[i] & 0x0f];
     }
+    rassert(j == uuid_u::kStringSize);
 
-    return ret;
+    return std::string(buf, uuid_u::kStringSize);
 }
 
 uuid_u str_to_uuid(const std::string &uuid) {
@@ -44,6 +44,12 @@ bool operator<(const uuid_u& x, const uuid_u& y);
 Valgrind won't complain about it. */
 uuid_u generate_uuid();
 
+/* Generates a version 7 UUID, which starts with the time in milliseconds, so that
+uuids (and their strings) generated later compare greater.  Those generated on the
+same thread in the same millisecond still increase.  Used as primary keys, they
+make inserts go to the last leaves of the btree instead of all over it. */
+uuid_u generate_time_ordered_uuid();
+
 // Returns boost::uuids::nil_generator()().
 uuid_u nil_uuid();
 
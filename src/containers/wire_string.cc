@@ -2,6 +2,7 @@
 #include "containers/wire_string.hpp"
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits>
@@ -29,6 +30,19 @@ void wire_string_t::operator delete(void *p) {
     ::free(p);
 }
 
+size_t wire_string_t::memory_size(size_t _size) {
+    return offsetof(wire_string_t, data_) + _size + 1;
+}
+wire_string_t *wire_string_t::create_in_place(void *memory, size_t _size,
+                                              const char *_data) {
+    rassert(divides(alignof(size_t), reinterpret_cast<uintptr_t>(memory)));
+    wire_string_t *result = static_cast<wire_string_t *>(memory);
+    result->size_ = _size;
+    memcpy(result->data_, _data, _size);
+    result->data_[_size] = '\0';
+    return result;
+}
+
 const char *wire_string_t::c_str() const {
     return data_;
 }
@@ -16,6 +16,8 @@
  * `wire_string_t` has no public constructors, and doesn't have
  * a fixed size. You can allocate one through the create() or create_and_init()
  * function. The returned object can be freed by using the delete operator.
+ * A short string can also be put in memory of its owner's with create_in_place(),
+ * and must not be deleted then.
  */
 class wire_string_t {
 public:
@@ -25,6 +27,12 @@ public:
     static wire_string_t *create_and_init(size_t _size, const char *_data);
     static void operator delete(void *p);
 
+    // The number of bytes a string of `_size` bytes takes up.
+    static size_t memory_size(size_t _size);
+    // Creates a string in `memory`, which must be aligned like a `size_t` and hold
+    // at least `memory_size(_size)` bytes.
+    static wire_string_t *create_in_place(void *memory, size_t _size, const char *_data);
+
     // The memory pointed to by the result to c_str() is guaranteed to be null
     // terminated.
     const char *c_str() const;
@@ -16,7 +16,27 @@ extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
     }
 
     worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor);
+    start(worker_fn);
+}
+
+extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
+                             bool (*worker_fn) (read_stream_t *, write_stream_t *),
+                             signal_t *_user_interruptor,
+                             size_t affinity) :
+    pool(_pool),
+    user_error(false),
+    user_interruptor(_user_interruptor),
+    combined_interruptor(pool->get_shutdown_signal())
+{
+    if (user_interruptor != NULL) {
+        combined_interruptor.add(user_interruptor);
+    }
+
+    worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor, affinity);
+    start(worker_fn);
+}
 
+void extproc_job_t::start(bool (*worker_fn) (read_stream_t *, write_stream_t *)) {
     try {
         worker_lock.get()->get_value()->acquired(&combined_interruptor);
         worker_lock.get()->get_value()->run_job(worker_fn);
@@ -18,6 +18,12 @@ public:
     extproc_job_t(extproc_pool_t *_pool,
                   bool (*worker_fn) (read_stream_t *, write_stream_t *),
                   signal_t *_user_interruptor);
+    // Runs on the worker that `affinity` picks if it is free, so that jobs with the
+    //  same affinity find what earlier ones left behind in the worker process
+    extproc_job_t(extproc_pool_t *_pool,
+                  bool (*worker_fn) (read_stream_t *, write_stream_t *),
+                  signal_t *_user_interruptor,
+                  size_t affinity);
     ~extproc_job_t();
 
     // All data written and read by the user must be accounted for, or the worker will
@@ -31,6 +37,8 @@ public:
     void worker_error();
 
 private:
+    void start(bool (*worker_fn) (read_stream_t *, write_stream_t *));
+
     extproc_pool_t *pool;
     bool user_error;
     signal_t *user_interruptor;
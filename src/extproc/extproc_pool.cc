@@ -1,11 +1,22 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "extproc/extproc_pool.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include "config/args.hpp"
 #include "extproc/extproc_spawner.hpp"
 
-extproc_pool_t::extproc_pool_t(size_t worker_count) :
+extproc_pool_t::extproc_pool_t(size_t max_workers) :
+    extproc_pool_t(0, max_workers) { }
+
+extproc_pool_t::extproc_pool_t(size_t _min_workers, size_t max_workers) :
+    min_workers(std::min(_min_workers, max_workers)),
     ct_interruptors(&interruptor),
-    worker_semaphore(worker_count,
-                     extproc_spawner_t::get_instance()) { }
+    worker_semaphore(max_workers,
+                     extproc_spawner_t::get_instance()),
+    resize_in_progress(false),
+    resize_timer(EXTPROC_POOL_RESIZE_INTERVAL_MS, this) { }
 
 extproc_pool_t::~extproc_pool_t() {
     // Can only be destructed on the same thread we were created on
@@ -23,6 +34,60 @@ signal_t *extproc_pool_t::get_shutdown_signal() {
     return ct_interruptors.get();
 }
 
+void extproc_pool_t::on_ring() {
+    assert_thread();
+    // Starting or stopping a worker process can take longer than the timer interval
+    if (!resize_in_progress && !interruptor.is_pulsed()) {
+        resize_in_progress = true;
+        coro_t::spawn_sometime(std::bind(&extproc_pool_t::resize,
+                                         this, drainer.lock()));
+    }
+}
+
+static bool is_stopped(extproc_worker_t *worker) {
+    return !worker->is_running();
+}
+
+static bool is_running(extproc_worker_t *worker) {
+    return worker->is_running();
+}
+
+static bool is_idle_since(microtime_t cutoff, extproc_worker_t *worker) {
+    return worker->is_running() && worker->get_idle_since() < cutoff;
+}
+
+void extproc_pool_t::resize(auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    // Workers that are acquired are running, or about to be started by their job
+    size_t busy = worker_semaphore.count_locked();
+    size_t running = busy + worker_semaphore.count_available(&is_running);
+    size_t target = std::max(min_workers, busy + EXTPROC_POOL_SPARE_WORKERS);
+
+    while (running < target && !keepalive.get_drain_signal()->is_pulsed()) {
+        cross_thread_semaphore_t<extproc_worker_t>::try_lock_t
+            lock(&worker_semaphore, &is_stopped);
+        if (lock.get_value() == NULL) {
+            // All workers are running
+            break;
+        }
+        lock.get_value()->start_process();
+        ++running;
+    }
+
+    microtime_t cutoff = current_microtime() - EXTPROC_WORKER_IDLE_TIMEOUT_MS * 1000;
+    while (running > target && !keepalive.get_drain_signal()->is_pulsed()) {
+        cross_thread_semaphore_t<extproc_worker_t>::try_lock_t
+            lock(&worker_semaphore, std::bind(&is_idle_since, cutoff, ph::_1));
+        if (lock.get_value() == NULL) {
+            break;
+        }
+        lock.get_value()->stop_process();
+        --running;
+    }
+
+    resize_in_progress = false;
+}
+
 extproc_pool_t::ct_interruptors_t::ct_interruptors_t(signal_t *shutdown_signal) :
     ct_signals(get_num_threads())
 {
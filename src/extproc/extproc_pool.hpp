@@ -3,7 +3,9 @@
 #define EXTPROC_EXTPROC_POOL_HPP_
 
 #include "utils.hpp"
+#include "arch/timing.hpp"
 #include "containers/scoped.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/cond_var.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/cross_thread_semaphore.hpp"
@@ -11,9 +13,14 @@
 
 // Extproc pool is used to acquire and release workers from any thread,
 //  must be created from within the thread pool
-class extproc_pool_t : public home_thread_mixin_t {
+class extproc_pool_t : public home_thread_mixin_t,
+                       private repeating_timer_callback_t {
 public:
-    explicit extproc_pool_t(size_t worker_count);
+    // Runs at most `max_workers` worker processes, and shuts down all but a spare
+    //  one when they are idle
+    explicit extproc_pool_t(size_t max_workers);
+    // Keeps at least `min_workers` worker processes running even when they are idle
+    extproc_pool_t(size_t min_workers, size_t max_workers);
     ~extproc_pool_t();
 
     // Get the signal for the current thread that will indicate when this object is being
@@ -24,6 +31,13 @@ public:
     cross_thread_semaphore_t<extproc_worker_t> *get_worker_semaphore();
 
 private:
+    void on_ring();
+    // Starts and stops idle worker processes so that the running ones cover the
+    //  busy ones plus a few spares, within the minimum and maximum
+    void resize(auto_drainer_t::lock_t keepalive);
+
+    const size_t min_workers;
+
     // The interruptor to be pulsed when shutting down
     cond_t interruptor;
 
@@ -39,6 +53,10 @@ private:
 
     // Cross-threaded semaphore allowing workers to be acquired from any thread
     cross_thread_semaphore_t<extproc_worker_t> worker_semaphore;
+
+    bool resize_in_progress;
+    auto_drainer_t drainer;
+    repeating_timer_t resize_timer;
 };
 
 #endif /* EXTPROC_EXTPROC_POOL_HPP_ */
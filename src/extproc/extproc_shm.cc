@@ -0,0 +1,173 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "extproc/extproc_shm.hpp"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "config/args.hpp"
+#include "containers/archive/socket_stream.hpp"
+#include "utils.hpp"
+
+// Each side only writes one of the positions, the other side only reads it.  They
+//  are kept on separate cache lines.
+struct extproc_shm_t::ring_header_t {
+    // Where the writer will put the next message
+    uint64_t write_position;
+    char padding0[CACHE_LINE_SIZE - sizeof(uint64_t)];
+    // Everything before this has been read and may be overwritten
+    uint64_t read_position;
+    char padding1[CACHE_LINE_SIZE - sizeof(uint64_t)];
+};
+
+static const size_t shm_size =
+    2 * (sizeof(extproc_shm_t::ring_header_t) + EXTPROC_SHM_RING_SIZE);
+
+fd_t extproc_shm_t::create_fd() {
+    // The name is unlinked right away, it only needs to be unique until then
+    static uint64_t counter = 0;
+    std::string name = strprintf("/rethinkdb-extproc-%d-%" PRIu64,
+                                 static_cast<int>(getpid()),
+                                 __sync_add_and_fetch(&counter, 1));
+    fd_t fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    guarantee_err(fd != INVALID_FD, "could not create shared memory for worker process");
+    int res = shm_unlink(name.c_str());
+    guarantee_err(res == 0, "could not unlink shared memory for worker process");
+    res = ftruncate(fd, shm_size);
+    guarantee_err(res == 0, "could not size shared memory for worker process");
+    return fd;
+}
+
+extproc_shm_t::extproc_shm_t(fd_t fd) {
+    mapping = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    guarantee_err(mapping != MAP_FAILED, "could not map shared memory for worker process");
+}
+
+extproc_shm_t::~extproc_shm_t() {
+    int res = munmap(mapping, shm_size);
+    guarantee_err(res == 0, "could not unmap shared memory for worker process");
+}
+
+extproc_shm_t::ring_t extproc_shm_t::parent_to_worker() {
+    ring_t ring;
+    ring.header = static_cast<ring_header_t *>(mapping);
+    ring.data = reinterpret_cast<char *>(ring.header + 2);
+    return ring;
+}
+
+extproc_shm_t::ring_t extproc_shm_t::worker_to_parent() {
+    ring_t ring;
+    ring.header = static_cast<ring_header_t *>(mapping) + 1;
+    ring.data = reinterpret_cast<char *>(ring.header + 1) + EXTPROC_SHM_RING_SIZE;
+    return ring;
+}
+
+const uint64_t extproc_shm_stream_t::INLINE = std::numeric_limits<uint64_t>::max();
+
+extproc_shm_stream_t::extproc_shm_stream_t(socket_stream_t *_socket_stream,
+                                           extproc_shm_t::ring_t _read_ring,
+                                           extproc_shm_t::ring_t _write_ring) :
+    socket_stream(_socket_stream),
+    read_ring(_read_ring),
+    write_ring(_write_ring) {
+    current.position = INLINE;
+    current.size = 0;
+}
+
+int64_t extproc_shm_stream_t::read(void *p, int64_t n) {
+    if (current.size == 0) {
+        int64_t res = force_read(socket_stream, &current, sizeof(current));
+        if (res != static_cast<int64_t>(sizeof(current))) {
+            current.size = 0;
+            return res == 0 ? 0 : -1;
+        }
+        guarantee(current.size > 0);
+    }
+
+    int64_t to_read = std::min<uint64_t>(n, current.size);
+    if (current.position == INLINE) {
+        int64_t res = socket_stream->read(p, to_read);
+        if (res > 0) {
+            current.size -= res;
+        }
+        return res;
+    }
+
+    memcpy(p, read_ring.data + current.position % EXTPROC_SHM_RING_SIZE, to_read);
+    current.position += to_read;
+    current.size -= to_read;
+    if (current.size == 0) {
+        // Let the writer reuse the space
+        __atomic_store_n(&read_ring.header->read_position, current.position,
+                         __ATOMIC_RELEASE);
+    }
+    return to_read;
+}
+
+int64_t extproc_shm_stream_t::write(const void *p, int64_t n) {
+    iovec iov;
+    iov.iov_base = const_cast<void *>(p);
+    iov.iov_len = n;
+    return writev(&iov, 1);
+}
+
+int64_t extproc_shm_stream_t::writev(const iovec *iov, size_t iovcnt) {
+    record_t record;
+    record.size = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        record.size += iov[i].iov_len;
+    }
+    if (record.size == 0) {
+        return 0;
+    }
+
+    if (record.size >= EXTPROC_SHM_MIN_PAYLOAD_SIZE
+        && allocate(record.size, &record.position)) {
+        char *out = write_ring.data + record.position % EXTPROC_SHM_RING_SIZE;
+        for (size_t i = 0; i < iovcnt; ++i) {
+            memcpy(out, iov[i].iov_base, iov[i].iov_len);
+            out += iov[i].iov_len;
+        }
+        __atomic_store_n(&write_ring.header->write_position,
+                         record.position + record.size, __ATOMIC_RELEASE);
+        if (socket_stream->write(&record, sizeof(record)) == -1) {
+            return -1;
+        }
+        return record.size;
+    }
+
+    record.position = INLINE;
+    std::vector<iovec> with_record(iov, iov + iovcnt);
+    iovec record_iov;
+    record_iov.iov_base = &record;
+    record_iov.iov_len = sizeof(record);
+    with_record.insert(with_record.begin(), record_iov);
+    int64_t res = socket_stream->writev(with_record.data(), with_record.size());
+    if (res == -1) {
+        return -1;
+    }
+    return record.size;
+}
+
+bool extproc_shm_stream_t::allocate(uint64_t size, uint64_t *position_out) {
+    uint64_t write_position = write_ring.header->write_position;
+    uint64_t read_position = __atomic_load_n(&write_ring.header->read_position,
+                                             __ATOMIC_ACQUIRE);
+    // Messages don't wrap around the end of the ring, the space up to the end is
+    //  skipped instead
+    uint64_t offset = write_position % EXTPROC_SHM_RING_SIZE;
+    uint64_t skipped = offset + size > EXTPROC_SHM_RING_SIZE
+        ? EXTPROC_SHM_RING_SIZE - offset : 0;
+    if (write_position + skipped + size - read_position > EXTPROC_SHM_RING_SIZE) {
+        return false;
+    }
+    *position_out = write_position + skipped;
+    return true;
+}
@@ -0,0 +1,78 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef EXTPROC_EXTPROC_SHM_HPP_
+#define EXTPROC_EXTPROC_SHM_HPP_
+
+#include <stdint.h>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "containers/archive/archive.hpp"
+
+class socket_stream_t;
+
+// Shared memory between the main process and a worker process, holding a ring
+//  buffer for each direction.  It lives as long as the worker process, so the
+//  positions in the rings carry over from one job to the next.
+class extproc_shm_t {
+public:
+    // Creates an anonymous shared memory object of the right size, to be mapped
+    //  by both processes
+    static fd_t create_fd();
+
+    // Maps the shared memory object, `fd` may be closed afterwards
+    explicit extproc_shm_t(fd_t fd);
+    ~extproc_shm_t();
+
+    struct ring_header_t;
+    class ring_t {
+    public:
+        ring_header_t *header;
+        char *data;
+    };
+
+    ring_t parent_to_worker();
+    ring_t worker_to_parent();
+
+private:
+    void *mapping;
+
+    DISABLE_COPYING(extproc_shm_t);
+};
+
+// The stream that jobs talk through.  Messages of at least
+//  `EXTPROC_SHM_MIN_PAYLOAD_SIZE` bytes are copied into the ring buffer, and
+//  only their position goes over the socket to wake up the reader.  Smaller
+//  messages, and messages that don't fit in the free part of the ring, go over
+//  the socket as before.
+class extproc_shm_stream_t : public read_stream_t, public write_stream_t {
+public:
+    extproc_shm_stream_t(socket_stream_t *_socket_stream,
+                         extproc_shm_t::ring_t _read_ring,
+                         extproc_shm_t::ring_t _write_ring);
+
+    MUST_USE int64_t read(void *p, int64_t n);
+    MUST_USE int64_t write(const void *p, int64_t n);
+    MUST_USE int64_t writev(const iovec *iov, size_t iovcnt);
+
+private:
+    // Precedes every message on the socket
+    struct record_t {
+        // The position of the message in the ring, or `INLINE` if the message
+        //  follows on the socket
+        uint64_t position;
+        uint64_t size;
+    };
+    static const uint64_t INLINE;
+
+    // Finds room for `size` contiguous bytes in the write ring, returns false if
+    //  there isn't enough free space
+    bool allocate(uint64_t size, uint64_t *position_out);
+
+    socket_stream_t *socket_stream;
+    extproc_shm_t::ring_t read_ring;
+    extproc_shm_t::ring_t write_ring;
+
+    // What is left of the message being read
+    record_t current;
+};
+
+#endif /* EXTPROC_EXTPROC_SHM_HPP_ */
@@ -8,6 +8,7 @@
 
 #include "extproc/extproc_spawner.hpp"
 #include "extproc/extproc_worker.hpp"
+#include "extproc/extproc_shm.hpp"
 #include "arch/fd_send_recv.hpp"
 
 extproc_spawner_t *extproc_spawner_t::instance = NULL;
@@ -40,6 +41,15 @@ public:
         msg << getpid();
         int res = send_write_message(&socket_stream, &msg);
         guarantee(res == 0);
+
+        fd_t shm_fd;
+        fd_recv_result_t recv_res = recv_fds(socket.get(), 1, &shm_fd);
+        guarantee(recv_res == FD_RECV_OK, "worker: could not receive shared memory");
+        scoped_fd_t shm_closer(shm_fd);
+        shm.init(new extproc_shm_t(shm_fd));
+        shm_stream.init(new extproc_shm_stream_t(&socket_stream,
+                                                 shm->parent_to_worker(),
+                                                 shm->worker_to_parent()));
     }
 
     ~worker_run_t() {
@@ -58,7 +68,7 @@ public:
                 break;
             }
 
-            if (!fn(&socket_stream, &socket_stream)) {
+            if (!fn(shm_stream.get(), shm_stream.get())) {
                 break;
             }
 
@@ -93,6 +103,9 @@ private:
     scoped_fd_t socket;
     blocking_fd_watcher_t blocking_watcher;
     socket_stream_t socket_stream;
+    // Jobs talk through this, the job functions and magic numbers go over the socket
+    scoped_ptr_t<extproc_shm_t> shm;
+    scoped_ptr_t<extproc_shm_stream_t> shm_stream;
 };
 
 pid_t worker_run_t::spawner_pid = -1;
@@ -204,7 +217,8 @@ void extproc_spawner_t::fork_spawner() {
 }
 
 // Spawns a new worker process and returns the fd of the socket used to communicate with it
-fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out) {
+fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out,
+                              scoped_fd_t *shm_out) {
     guarantee(spawner_socket.get() != INVALID_FD);
 
     fd_t fds[2];
@@ -222,6 +236,12 @@ fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_
     guarantee_deserialization(archive_res, "pid_out");
     guarantee(*pid_out != -1);
 
+    // Hand the worker the shared memory for large messages
+    shm_out->reset(extproc_shm_t::create_fd());
+    fd_t shm_fd = shm_out->get();
+    res = send_fds(fds[0], 1, &shm_fd);
+    guarantee_err(res == 0, "could not send shared memory to worker process");
+
     scoped_fd_t closer(fds[1]);
     return fds[0];
 }
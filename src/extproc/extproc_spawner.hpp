@@ -21,8 +21,10 @@ public:
     ~extproc_spawner_t();
 
     // Spawns a new worker, and returns the socket file descriptor for communication
-    //  with the worker process
-    fd_t spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out);
+    //  with the worker process, and the shared memory it was given for its
+    //  `extproc_shm_t`
+    fd_t spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out,
+               scoped_fd_t *shm_out);
 
     static extproc_spawner_t *get_instance();
 
@@ -23,28 +23,64 @@ NORETURN bool worker_exit_fn(read_stream_t *stream_in, write_stream_t *) {
 extproc_worker_t::extproc_worker_t(extproc_spawner_t *_spawner) :
     spawner(_spawner),
     worker_pid(-1),
-    interruptor(NULL) { }
+    interruptor(NULL),
+    idle_since(current_microtime()) { }
 
 extproc_worker_t::~extproc_worker_t() {
     if (worker_pid != -1) {
+        stop_process();
+    }
+}
+
+void extproc_worker_t::start_process() {
+    guarantee(worker_pid == -1);
+    guarantee(interruptor == NULL);
+    spawn();
+    socket_stream.reset();
+}
+
+void extproc_worker_t::spawn() {
+    scoped_fd_t shm_fd;
+    socket.reset(spawner->spawn(&socket_stream, &worker_pid, &shm_fd));
+    shm.init(new extproc_shm_t(shm_fd.get()));
+}
+
+void extproc_worker_t::create_streams() {
+    if (!socket_stream.has()) {
         socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+    }
+    shm_stream.create(socket_stream.get(), shm->worker_to_parent(),
+                      shm->parent_to_worker());
+}
+
+void extproc_worker_t::destroy_streams() {
+    shm_stream.reset();
+    socket_stream.reset();
+}
 
-        // TODO: check that worker is extant and/or catch exceptions
-        run_job(&worker_exit_fn);
+void extproc_worker_t::stop_process() {
+    guarantee(worker_pid != -1);
+    guarantee(interruptor == NULL);
+    create_streams();
 
-        int exit_code = 0;
-        write_message_t msg;
-        msg << exit_code;
-        int res = send_write_message(get_write_stream(), &msg);
+    // TODO: check that worker is extant and/or catch exceptions
+    run_job(&worker_exit_fn);
 
-        socket_stream.reset();
+    int exit_code = 0;
+    write_message_t msg;
+    msg << exit_code;
+    int res = send_write_message(get_write_stream(), &msg);
 
-        if (res != 0) {
-            logERR("Could not shut down worker orderly, killing it...");
-            kill_process();
-        } else {
-            // TODO: Give some time to exit, then kill
-        }
+    destroy_streams();
+
+    if (res != 0) {
+        logERR("Could not shut down worker orderly, killing it...");
+        kill_process();
+    } else {
+        // TODO: Give some time to exit, then kill
+        worker_pid = -1;
+        socket.reset();
+        shm.reset();
     }
 }
 
@@ -54,10 +90,9 @@ void extproc_worker_t::acquired(signal_t *_interruptor) {
 
     // We create the streams here, since they are thread-dependant
     if (worker_pid == -1) {
-        socket.reset(spawner->spawn(&socket_stream, &worker_pid));
-    } else {
-        socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+        spawn();
     }
+    create_streams();
 
     // Apply the user interruptor to our stream along with the extproc pool's interruptor
     guarantee(interruptor == NULL);
@@ -102,8 +137,9 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
         }
     }
 
-    socket_stream.reset();
+    destroy_streams();
     interruptor = NULL;
+    idle_since = current_microtime();
 
     // If anything went wrong, we just kill the worker and recreate it later
     if (errored) {
@@ -119,19 +155,21 @@ void extproc_worker_t::kill_process() {
 
     // Clean up our socket fd
     socket.reset();
+    shm.reset();
 }
 
 void extproc_worker_t::run_job(bool (*fn) (read_stream_t *, write_stream_t *)) {
     write_message_t msg;
     msg.append(&fn, sizeof(fn));
-    int res = send_write_message(get_write_stream(), &msg);
+    // The worker reads the job function straight from the socket
+    int res = send_write_message(socket_stream.get(), &msg);
     if (res != 0) { throw std::runtime_error("failed to send job function to worker"); }
 }
 
 read_stream_t *extproc_worker_t::get_read_stream() {
-    return socket_stream.get();
+    return shm_stream.get();
 }
 
 write_stream_t *extproc_worker_t::get_write_stream() {
-    return socket_stream.get();
+    return shm_stream.get();
 }
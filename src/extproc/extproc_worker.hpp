@@ -3,12 +3,14 @@
 #define EXTPROC_EXTPROC_WORKER_HPP_
 
 #include <sys/types.h>
+#include "utils.hpp"
 #include "arch/io/io_utils.hpp"
 #include "concurrency/wait_any.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "containers/object_buffer.hpp"
 #include "containers/scoped.hpp"
 #include "containers/archive/socket_stream.hpp"
+#include "extproc/extproc_shm.hpp"
 
 class extproc_spawner_t;
 
@@ -28,6 +30,13 @@ public:
     read_stream_t *get_read_stream();
     write_stream_t *get_write_stream();
 
+    // Used by the pool to start the worker process ahead of the first job, and to
+    //  shut it down when it has been idle for long, while no job holds the worker
+    bool is_running() const { return worker_pid != -1; }
+    microtime_t get_idle_since() const { return idle_since; }
+    void start_process();
+    void stop_process();
+
     static const uint64_t parent_to_worker_magic;
     static const uint64_t worker_to_parent_magic;
 
@@ -35,6 +44,11 @@ private:
     void spawn();
     void kill_process();
 
+    // The streams are thread-dependant, so they are created each time the worker is
+    //  used
+    void create_streams();
+    void destroy_streams();
+
     // This will run inside the blocker pool so the worker process doesn't inherit any
     //  of our coroutine stuff
     void spawn_internal();
@@ -45,7 +59,15 @@ private:
 
     object_buffer_t<socket_stream_t> socket_stream;
 
+    // Jobs read and write through the shared memory stream, which sends large
+    //  messages through `shm` and the rest through `socket_stream`
+    scoped_ptr_t<extproc_shm_t> shm;
+    object_buffer_t<extproc_shm_stream_t> shm_stream;
+
     signal_t *interruptor;
+
+    // When the worker was last released
+    microtime_t idle_since;
 };
 
 #endif /* EXTPROC_EXTPROC_WORKER_HPP_ */
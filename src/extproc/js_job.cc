@@ -18,7 +18,9 @@
 #include "rdb_protocol/rdb_protocol_json.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/flat_hash_map.hpp"
 #include "extproc/extproc_job.hpp"
+#include "stl_utils.hpp"
 
 #ifdef V8_PRE_3_19
 #define DECLARE_HANDLE_SCOPE(scope) v8::HandleScope scope
@@ -55,7 +57,8 @@ private:
     const boost::shared_ptr<v8::Persistent<v8::Value> > find_value(js_id_t id);
 
     js_id_t next_id;
-    std::map<js_id_t, boost::shared_ptr<v8::Persistent<v8::Value> > > values;
+    // Every call of a JS function looks the function up here.
+    flat_hash_map_t<js_id_t, boost::shared_ptr<v8::Persistent<v8::Value> > > values;
 };
 
 // Cleans the worker process's environment when instantiated
@@ -87,12 +90,13 @@ enum js_task_t {
     TASK_EVAL,
     TASK_CALL,
     TASK_RELEASE,
-    TASK_EXIT
+    TASK_EXIT,
+    TASK_CALL_EACH
 };
 
 // The job_t runs in the context of the main rethinkdb process
-js_job_t::js_job_t(extproc_pool_t *pool, signal_t *interruptor) :
-    extproc_job(pool, &worker_fn, interruptor) { }
+js_job_t::js_job_t(extproc_pool_t *pool, signal_t *interruptor, size_t affinity) :
+    extproc_job(pool, &worker_fn, interruptor, affinity) { }
 
 js_result_t js_job_t::eval(const std::string &source) {
     js_task_t task = js_task_t::TASK_EVAL;
@@ -123,6 +127,22 @@ js_result_t js_job_t::call(js_id_t id, const std::vector<counted_t<const ql::dat
     return result;
 }
 
+std::vector<js_result_t> js_job_t::call_each(
+        js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args) {
+    js_task_t task = js_task_t::TASK_CALL_EACH;
+    write_message_t msg;
+    msg.append(&task, sizeof(task));
+    msg << id;
+    msg << args;
+    int res = send_write_message(extproc_job.write_stream(), &msg);
+    if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
+
+    std::vector<js_result_t> results;
+    res = deserialize(extproc_job.read_stream(), &results);
+    if (res != ARCHIVE_SUCCESS) { throw js_worker_exc_t("failed to deserialize result from worker"); }
+    return results;
+}
+
 void js_job_t::release(js_id_t id) {
     js_task_t task = js_task_t::TASK_RELEASE;
     write_message_t msg;
@@ -184,6 +204,29 @@ bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
                 if (res != 0) { return false; }
             }
             break;
+        case TASK_CALL_EACH:
+            {
+                js_id_t id;
+                std::vector<counted_t<const ql::datum_t> > args;
+                res = deserialize(stream_in, &id);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+                res = deserialize(stream_in, &args);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+
+                std::vector<js_result_t> js_results;
+                js_results.reserve(args.size());
+                for (auto it = args.begin(); it != args.end(); ++it) {
+                    js_results.push_back(js_env.call(id, make_vector(*it)));
+                    if (boost::get<std::string>(&js_results.back()) != NULL) {
+                        break;
+                    }
+                }
+                write_message_t msg;
+                msg << js_results;
+                res = send_write_message(stream_out, &msg);
+                if (res != 0) { return false; }
+            }
+            break;
         case TASK_RELEASE:
             {
                 js_id_t id;
@@ -289,7 +332,7 @@ js_id_t js_env_t::remember_value(const v8::Handle<v8::Value> &value) {
 }
 
 const boost::shared_ptr<v8::Persistent<v8::Value> > js_env_t::find_value(js_id_t id) {
-    std::map<js_id_t, boost::shared_ptr<v8::Persistent<v8::Value> > >::iterator it = values.find(id);
+    auto it = values.find(id);
     guarantee(it != values.end());
     return it->second;
 }
@@ -520,7 +563,7 @@ v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum) {
             return date;
         } else {
             v8::Handle<v8::Object> obj = v8::Object::New();
-            const std::map<std::string, counted_t<const ql::datum_t> > &source_map = datum->as_object();
+            const ql::datum_object_t &source_map = datum->as_object();
 
             for (auto it = source_map.begin(); it != source_map.end(); ++it) {
                 DECLARE_HANDLE_SCOPE(scope);
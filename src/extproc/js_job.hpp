@@ -19,10 +19,14 @@
 
 class js_job_t {
 public:
-    js_job_t(extproc_pool_t *pool, signal_t *interruptor);
+    js_job_t(extproc_pool_t *pool, signal_t *interruptor, size_t affinity);
 
     js_result_t eval(const std::string &source);
     js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
+    // Calls the function once for each of `args`, with it as the only argument.
+    // Stops after the first call that results in an error.
+    std::vector<js_result_t> call_each(
+        js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
     void release(js_id_t id);
     void exit();
 
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "extproc/js_runner.hpp"
 
+#include <algorithm>
 #include <map>
 
 #include "extproc/js_job.hpp"
@@ -19,7 +20,7 @@ public:
             if (parent->timer.is_pulsed()) {
                 throw interrupted_exc_t();
             }
-            parent->timer.start(timeout_ms);
+            parent->timer.start(timeout_ms, COARSE_TIMER);
         }
         ~sentry_t() {
             if (!parent->timer.is_pulsed()) {
@@ -42,12 +43,12 @@ private:
 //  easily clear it all and replace it
 class js_runner_t::job_data_t {
 public:
-    job_data_t(extproc_pool_t *pool, signal_t *interruptor) :
+    job_data_t(extproc_pool_t *pool, signal_t *interruptor, size_t affinity) :
         combined_interruptor(interruptor, js_timeout.get_signal()),
-        js_job(pool, &combined_interruptor) { }
+        js_job(pool, &combined_interruptor, affinity) { }
 
-    explicit job_data_t(extproc_pool_t *pool) :
-        js_job(pool, js_timeout.get_signal()) { }
+    job_data_t(extproc_pool_t *pool, size_t affinity) :
+        js_job(pool, js_timeout.get_signal(), affinity) { }
 
     struct func_info_t {
         explicit func_info_t(js_id_t _id) :
@@ -88,12 +89,13 @@ bool js_runner_t::connected() const {
 }
 
 // Starts the javascript function in the worker process
-void js_runner_t::begin(extproc_pool_t *pool, signal_t *interruptor) {
+void js_runner_t::begin(extproc_pool_t *pool, signal_t *interruptor,
+                        size_t affinity) {
     assert_thread();
     if (interruptor == NULL) {
-        job_data.init(new job_data_t(pool));
+        job_data.init(new job_data_t(pool, affinity));
     } else {
-        job_data.init(new job_data_t(pool, interruptor));
+        job_data.init(new job_data_t(pool, interruptor, affinity));
     }
 }
 
@@ -170,6 +172,44 @@ js_result_t js_runner_t::call(const std::string &source,
     return result;
 }
 
+std::vector<js_result_t> js_runner_t::call_each(
+        const std::string &source,
+        const std::vector<counted_t<const ql::datum_t> > &args,
+        const req_config_t &config) {
+    assert_thread();
+    guarantee(job_data.has());
+
+    // This will retrieve the function from the cache if it's there, or re-eval it
+    js_result_t fn = eval(source, config);
+    js_id_t *fn_id = boost::get<js_id_t>(&fn);
+    guarantee(fn_id != NULL);
+
+    object_buffer_t<js_timeout_t::sentry_t> sentry;
+    sentry.create(&job_data->js_timeout,
+                  config.timeout_ms * std::max<uint64_t>(args.size(), 1));
+
+    std::vector<js_result_t> results;
+    try {
+        results = job_data->js_job.call_each(*fn_id, args);
+        // A function returned by a call can't be a row.  The caller makes a new one
+        // from `source` to report that, so the worker needn't keep it.
+        for (auto it = results.begin(); it != results.end(); ++it) {
+            if (js_id_t *any_id = boost::get<js_id_t>(&*it)) {
+                release_id(*any_id);
+            }
+        }
+    } catch (...) {
+        // Sentry must be destroyed before the js_timeout
+        sentry.reset();
+        // This will mark the worker as errored so we don't try to re-sync with it
+        //  on the next line (since we're in a catch statement, we aren't allowed)
+        job_data->js_job.worker_error();
+        job_data.reset();
+        throw;
+    }
+    return results;
+}
+
 void js_runner_t::cache_id(js_id_t id, const std::string &source) {
     guarantee(job_data.has());
     guarantee(id != INVALID_ID);
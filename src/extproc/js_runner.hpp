@@ -52,8 +52,11 @@ public:
         uint64_t timeout_ms;
     };
 
+    // Jobs begun with the same `affinity` go to the same worker process when it is
+    //  free, where V8 may still have their functions compiled
     void begin(extproc_pool_t *pool,
-               signal_t *interruptor);
+               signal_t *interruptor,
+               size_t affinity);
 
     // Evalute JS source string to either a value or a function ID to call later
     js_result_t eval(const std::string &source,
@@ -64,6 +67,15 @@ public:
                      const std::vector<counted_t<const ql::datum_t> > &args,
                      const req_config_t &config);
 
+    // Calls a previously compiled function once for each of `args`, with it as the
+    // only argument, in one round trip to the worker.  Stops after the first call
+    // that results in an error, so the last result may be an error string.  The
+    // timeout applies to each call, so the batch gets `args.size()` times as long.
+    std::vector<js_result_t> call_each(
+        const std::string &source,
+        const std::vector<counted_t<const ql::datum_t> > &args,
+        const req_config_t &config);
+
 private:
     static const size_t CACHE_SIZE;
 
@@ -12,6 +12,9 @@
 #include <boost/algorithm/string.hpp>
 
 #include "arch/io/network.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
 
@@ -166,6 +169,25 @@ void http_res_t::add_header_line(const std::string& key, const std::string& val)
     header_lines.push_back(hdr_ln);
 }
 
+bool http_res_t::has_header_line(const std::string& key) const {
+    for (std::vector<header_line_t>::const_iterator it = header_lines.begin(); it != header_lines.end(); ++it) {
+        if (boost::iequals(it->key, key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void http_res_t::set_body_writer(const std::string &content_type,
+                                 const body_writer_t &writer) {
+    guarantee(!has_header_line("Content-Type"));
+    guarantee(!has_header_line("Content-Length"));
+    guarantee(body.empty() && !body_writer);
+
+    add_header_line("Content-Type", content_type);
+    body_writer = writer;
+}
+
 void http_res_t::set_body(const std::string& content_type, const std::string& content) {
     for (std::vector<header_line_t>::iterator it = header_lines.begin(); it != header_lines.end(); ++it) {
         guarantee(it->key != "Content-Type");
@@ -435,33 +457,138 @@ std::string human_readable_status(int code) {
     }
 }
 
-void write_http_msg(tcp_conn_t *conn, const http_res_t &res, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
-    conn->writef(closer, "HTTP/%s %d %s\r\n", res.version.c_str(), res.code, human_readable_status(res.code).c_str());
-    for (std::vector<header_line_t>::const_iterator it = res.header_lines.begin(); it != res.header_lines.end(); ++it) {
-        conn->writef(closer, "%s: %s\r\n", it->key.c_str(), it->val.c_str());
+/* Writes a body from an `http_res_t::body_writer`, in chunks if `chunked`. */
+class conn_body_writer_t : public http_body_writer_t {
+public:
+    conn_body_writer_t(tcp_conn_t *_conn, bool _chunked, signal_t *_closer)
+        : conn(_conn), chunked(_chunked), closer(_closer), closed(false) { }
+
+    void write(const char *data, size_t size) {
+        // An empty chunk would end the body.
+        if (closed || size == 0) {
+            return;
+        }
+        try {
+            if (chunked) {
+                const std::string chunk_header = strprintf("%zx\r\n", size);
+                conn->write_buffered(chunk_header.data(), chunk_header.size(), closer);
+                conn->write_buffered(data, size, closer);
+                conn->write_buffered("\r\n", 2, closer);
+            } else {
+                conn->write_buffered(data, size, closer);
+            }
+            conn->flush_buffer_eventually(closer);
+        } catch (const tcp_conn_write_closed_exc_t &) {
+            closed = true;
+        }
+    }
+
+    void finish() THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+        if (closed) {
+            throw tcp_conn_write_closed_exc_t();
+        }
+        if (chunked) {
+            conn->write_buffered("0\r\n\r\n", 5, closer);
+        }
+        conn->flush_buffer(closer);
+    }
+
+private:
+    tcp_conn_t *conn;
+    bool chunked;
+    signal_t *closer;
+    bool closed;
+};
+
+static bool is_http_1_1(const std::string &version) {
+    return version == "1.1";
+}
+
+/* Whether the client wants the connection kept open after this request. */
+static bool wants_keep_alive(const http_req_t &req) {
+    boost::optional<std::string> connection = req.find_header_line("Connection");
+    if (is_http_1_1(req.version)) {
+        return !connection || !boost::iequals(connection.get(), "close");
+    }
+    return connection && boost::iequals(connection.get(), "keep-alive");
+}
+
+/* Writes `res`, and returns whether the connection can be used for another
+request afterwards. */
+bool write_http_msg(tcp_conn_t *conn, http_res_t *res, bool keep_alive,
+                    signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    const bool chunked = res->body_writer && is_http_1_1(res->version);
+    if (res->body_writer) {
+        if (chunked) {
+            res->add_header_line("Transfer-Encoding", "chunked");
+        } else {
+            // The end of the connection is the end of the body.
+            keep_alive = false;
+        }
+    } else if (!res->has_header_line("Content-Length")
+               && res->code != HTTP_NO_CONTENT && res->code != 304) {
+        // Otherwise the client would read the body up to the end of the connection.
+        res->add_header_line("Content-Length", strprintf("%zu", res->body.size()));
+    }
+    if (!keep_alive) {
+        res->add_header_line("Connection", "close");
+    } else if (!is_http_1_1(res->version)) {
+        res->add_header_line("Connection", "keep-alive");
+    }
+
+    std::string head = strprintf("HTTP/%s %d %s\r\n", res->version.c_str(), res->code,
+                                 human_readable_status(res->code).c_str());
+    for (std::vector<header_line_t>::const_iterator it = res->header_lines.begin(); it != res->header_lines.end(); ++it) {
+        head += strprintf("%s: %s\r\n", it->key.c_str(), it->val.c_str());
+    }
+    head += "\r\n";
+    conn->write_buffered(head.data(), head.size(), closer);
+
+    if (res->body_writer) {
+        conn_body_writer_t writer(conn, chunked, closer);
+        res->body_writer(&writer, closer);
+        writer.finish();
+    } else {
+        conn->write(res->body.data(), res->body.size(), closer);
     }
-    conn->writef(closer, "\r\n");
-    conn->write(res.body.c_str(), res.body.size(), closer);
+    return keep_alive;
 }
 
 void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t keepalive) {
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
 
-    http_req_t req;
     tcp_http_msg_parser_t http_msg_parser;
 
-    // Parse the request
     try {
-        http_res_t res;
-        if (http_msg_parser.parse(conn.get(), &req, keepalive.get_drain_signal())) {
-            application->handle(req, &res, keepalive.get_drain_signal());
-            res.version = req.version;
-            maybe_gzip_response(req, &res);
-        } else {
-            res = http_res_t(HTTP_BAD_REQUEST);
+        bool keep_alive = true;
+        while (keep_alive) {
+            // Wait for the next request, or give up on the connection if the client
+            // doesn't send one.  Pipelined requests are already in the buffer.
+            if (conn->peek().beg == conn->peek().end) {
+                signal_timer_t idle_timer;
+                idle_timer.start(HTTP_KEEPALIVE_IDLE_TIMEOUT_MS);
+                wait_any_t idle_closer(keepalive.get_drain_signal(), &idle_timer);
+                conn->read_more_buffered(&idle_closer);
+            }
+
+            // Parse the request
+            http_req_t req;
+            http_res_t res;
+            if (http_msg_parser.parse(conn.get(), &req, keepalive.get_drain_signal())) {
+                application->handle(req, &res, keepalive.get_drain_signal());
+                res.version = req.version;
+                keep_alive = wants_keep_alive(req);
+                maybe_gzip_response(req, &res);
+            } else {
+                // We can't tell where the next request would start.
+                res = http_res_t(HTTP_BAD_REQUEST);
+                res.version = "1.1";
+                keep_alive = false;
+            }
+            keep_alive = write_http_msg(conn.get(), &res, keep_alive,
+                                        keepalive.get_drain_signal());
         }
-        write_http_msg(conn.get(), res, keepalive.get_drain_signal());
     } catch (const interrupted_exc_t &) {
         // The query was interrupted, no response since we are shutting down
     } catch (const tcp_conn_read_closed_exc_t &) {
@@ -2,6 +2,7 @@
 #ifndef HTTP_HTTP_HPP_
 #define HTTP_HTTP_HPP_
 
+#include <functional>
 #include <string>
 #include <stdexcept>
 #include <vector>
@@ -99,16 +100,37 @@ enum http_status_code_t {
     HTTP_INTERNAL_SERVER_ERROR = 500
 };
 
+/* Writes a response body a piece at a time; see `http_res_t::set_body_writer()`.
+Once the client has gone away, writes do nothing. */
+class http_body_writer_t {
+public:
+    virtual void write(const char *data, size_t size) = 0;
+    void write(const std::string &data) { write(data.data(), data.size()); }
+protected:
+    virtual ~http_body_writer_t() { }
+};
+
 class http_res_t {
 public:
+    typedef std::function<void(http_body_writer_t *, signal_t *)> body_writer_t;
+
     std::string version;
     int code;
     std::vector<header_line_t> header_lines;
     std::string body;
+    body_writer_t body_writer;
 
     void add_header_line(const std::string&, const std::string&);
+    bool has_header_line(const std::string&) const;
     void set_body(const std::string&, const std::string&);
 
+    /* Instead of being kept in `body`, the response body is written by `writer`
+    after the app's `handle()` returns, as fast as the connection takes it.  It's
+    sent in chunks to HTTP/1.1 clients, and up to the end of the connection to
+    HTTP/1.0 ones.  The interruptor that was passed to `handle()` stays valid until
+    the writer returns. */
+    void set_body_writer(const std::string &content_type, const body_writer_t &writer);
+
     http_res_t();
     explicit http_res_t(http_status_code_t rescode);
     http_res_t(http_status_code_t rescode, const std::string&, const std::string&);
@@ -165,7 +187,9 @@ public:
 /* creating an http server will bind to the specified port and listen for http
  * connections, the data from incoming connections will be parsed into
  * http_req_ts and passed to the handle function which must then return an http
- * msg that's a meaningful response */
+ * msg that's a meaningful response.  Connections are kept open for further
+ * requests unless the client asks otherwise, and pipelined requests are answered
+ * in order. */
 class http_server_t {
 public:
     http_server_t(const std::set<ip_address_t> &local_addresses, int port, http_app_t *application);
@@ -13,6 +13,9 @@ class http_res_t;
 
 void http_json_res(cJSON *json, http_res_t *result);
 
+// How `http_json_res()` prints JSON: indented in debug builds.
+extern std::string (*cJSON_default_print)(cJSON *json);
+
 //TODO: do we both merge and cJSON_merge?
 //Merge two cJSON objects, crashes if there are overlapping keys
 cJSON *merge(cJSON *, cJSON *);
@@ -1,52 +1,136 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "memcached/file.hpp"
-#include "memcached/parser.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/types.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/fifo_checker.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "memcached/parser.hpp"
+#include "memcached/stats.hpp"
 
 /* `file_memcached_interface_t` is a `memcached_interface_t` that reads queries
-from a file and ignores the responses to its queries. */
+from a file and ignores the responses to its queries.  The file is read in
+`IMPORT_READ_CHUNK_SIZE` chunks in the blocker pool, and the next chunk is read
+while the parser works through the current one, so that parsing never waits on
+the disk unless the disk is the bottleneck. */
 
 class file_memcached_interface_t : public memcached_interface_t {
 
 private:
     FILE *file;
 
+    // The chunk being parsed, and how far into it the parser has got.
+    std::vector<char> chunk;
+    size_t chunk_offset;
+
+    // The chunk being read ahead.  It's empty once we've reached the end of the file.
+    std::vector<char> next_chunk;
+    scoped_ptr_t<cond_t> next_chunk_ready;
+
+    // Reset before the file is closed, so that no read ahead is using it.
+    scoped_ptr_t<auto_drainer_t> drainer;
+
+    void read_chunk_blocking(std::vector<char> *chunk_out) {
+        chunk_out->resize(IMPORT_READ_CHUNK_SIZE);
+        const size_t res = file == NULL ? 0 : fread(chunk_out->data(), 1, chunk_out->size(), file);
+        chunk_out->resize(res);
+    }
+
+    void read_ahead(auto_drainer_t::lock_t) {
+        thread_pool_t::run_in_blocker_pool(boost::bind(&file_memcached_interface_t::read_chunk_blocking,
+                                                       this, &next_chunk));
+        next_chunk_ready->pulse();
+    }
+
+    void start_read_ahead() {
+        next_chunk_ready.init(new cond_t);
+        coro_t::spawn_sometime(boost::bind(&file_memcached_interface_t::read_ahead,
+                                           this, drainer->lock()));
+    }
+
+    /* Makes sure there's something left in `chunk` to parse. */
+    void fill_chunk(signal_t *interruptor) {
+        if (chunk_offset < chunk.size()) {
+            return;
+        }
+        wait_any_t waiter(next_chunk_ready.get(), interruptor);
+        waiter.wait_lazily_unordered();
+        if (interruptor->is_pulsed()) throw no_more_data_exc_t();
+        if (next_chunk.empty()) throw no_more_data_exc_t();
+        chunk.swap(next_chunk);
+        chunk_offset = 0;
+        start_read_ahead();
+    }
+
 public:
     explicit file_memcached_interface_t(const char *filename) :
-        file(fopen(filename, "r"))
-    { }
+        file(fopen(filename, "r")),
+        chunk_offset(0),
+        drainer(new auto_drainer_t) {
+        start_read_ahead();
+    }
     ~file_memcached_interface_t() {
-        fclose(file);
+        drainer.reset();
+        if (file != NULL) {
+            fclose(file);
+        }
     }
 
     /* We throw away the responses */
     void write(UNUSED const char *buffer, UNUSED size_t bytes, UNUSED signal_t *interruptor) { }
     void write_unbuffered(UNUSED const char *buffer, UNUSED size_t bytes, UNUSED signal_t *interruptor) { }
+    void writev(UNUSED const iovec *iov, UNUSED size_t iovcnt, UNUSED signal_t *interruptor) { }
     void flush_buffer(UNUSED signal_t *interruptor) { }
     bool is_write_open() { return false; }
 
     void read(void *buf, size_t nbytes, signal_t *interruptor) {
-        if (interruptor->is_pulsed()) throw no_more_data_exc_t();
-        if (fread(buf, nbytes, 1, file) == 0)
-            throw no_more_data_exc_t();
+        char *dest = static_cast<char *>(buf);
+        while (nbytes > 0) {
+            fill_chunk(interruptor);
+            const size_t n = std::min(nbytes, chunk.size() - chunk_offset);
+            memcpy(dest, chunk.data() + chunk_offset, n);
+            chunk_offset += n;
+            dest += n;
+            nbytes -= n;
+        }
+    }
+
+    char peek_byte(signal_t *interruptor) {
+        fill_chunk(interruptor);
+        return chunk[chunk_offset];
     }
 
     void read_line(std::vector<char> *dest, signal_t *interruptor) {
-        if (interruptor->is_pulsed()) throw no_more_data_exc_t();
-        int limit = MEGABYTE;
+        size_t limit = MEGABYTE;
         dest->clear();
-        char c;
-        const char *head = "\r\n";
-        while ((*head) && ((c = getc(file)) != EOF) && (limit--) > 0) {
-            dest->push_back(c);
-            if (c == *head) {
-                head++;
-            } else {
-                head = "\r\n";
+        for (;;) {
+            fill_chunk(interruptor);
+            const char *start = chunk.data() + chunk_offset;
+            const size_t available = std::min(chunk.size() - chunk_offset, limit);
+            const char *newline = static_cast<const char *>(memchr(start, '\n', available));
+            const size_t n = newline == NULL ? available : newline - start + 1;
+            dest->insert(dest->end(), start, start + n);
+            chunk_offset += n;
+            limit -= n;
+            if (newline != NULL && dest->size() >= 2 && (*dest)[dest->size() - 2] == '\r') {
+                return;
             }
+            //we didn't every find a crlf unleash the exception
+            if (limit == 0) throw no_more_data_exc_t();
         }
-        //we didn't every find a crlf unleash the exception
-        if (*head) throw no_more_data_exc_t();
     }
 };
 
@@ -56,5 +140,9 @@ void import_memcache(const char *filename, namespace_interface_t<memcached_proto
 
     file_memcached_interface_t interface(filename);
 
-    handle_memcache(&interface, nsi, MAX_CONCURRENT_QUEURIES_ON_IMPORT, NULL, interrupter);
+    // The parser times what it does; these stats aren't reported anywhere.
+    perfmon_collection_t stats_collection;
+    memcached_stats_t stats(&stats_collection);
+
+    handle_memcache(&interface, nsi, MAX_CONCURRENT_QUEURIES_ON_IMPORT, &stats, interrupter);
 }
@@ -2,18 +2,23 @@
 #ifndef MEMCACHED_FILE_HPP_
 #define MEMCACHED_FILE_HPP_
 
+class memcached_protocol_t;
+template <class> class namespace_interface_t;
 class signal_t;
-class set_store_interface_t;
 
 
 /* `import_memcache()` opens the file specified by its first parameter and reads
-memcache commands from it, sending the commands to the given `set_store_interface_t`.
+memcache commands from it, sending the commands to the given `namespace_interface_t`.
 It stops when it reaches the end of the file or when the `interrupt` cond that you
 pass is pulsed.
 
+The file is read ahead in large chunks, and up to `MAX_CONCURRENT_QUEURIES_ON_IMPORT`
+commands are in flight at once, each going to the shard its key is in, so the
+shards are all written to at the same time.
+
 The main use of `import_memcache()` is to implement the `rethinkdb import`
 subcommand.*/
 
-void import_memcache(const char *filename, set_store_interface_t *set_store, int n_slices, signal_t *interrupt);
+void import_memcache(const char *filename, namespace_interface_t<memcached_protocol_t> *nsi, signal_t *interrupt);
 
 #endif /* MEMCACHED_FILE_HPP_ */
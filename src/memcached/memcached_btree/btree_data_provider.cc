@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "memcached/memcached_btree/btree_data_provider.hpp"
 
+#include <string.h>
+
 #include "buffer_cache/alt/alt.hpp"
 #include "buffer_cache/alt/blob.hpp"
 #include "containers/buffer_group.hpp"
@@ -11,6 +13,17 @@ counted_t<data_buffer_t> value_to_data_buffer(const memcached_value_t *value,
                                               buf_parent_t parent) {
     parent.cache()->assert_thread();
 
+    // Small values are in the leaf node itself, so we copy them straight out of it
+    // rather than setting up a blob and a buffer group for them.
+    const char *inline_data = blob::inline_value_data(value->value_ref(),
+                                                      blob::btree_maxreflen);
+    if (inline_data != NULL) {
+        const int64_t size = value->value_size();
+        counted_t<data_buffer_t> ret = data_buffer_t::create(size);
+        memcpy(ret->buf(), inline_data, size);
+        return ret;
+    }
+
     blob_t blob(parent.cache()->get_block_size(),
                 const_cast<memcached_value_t *>(value)->value_ref(),
                 blob::btree_maxreflen);
@@ -1,9 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "memcached/memcached_btree/get_cas.hpp"
 
-#include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt/alt.hpp"
-#include "concurrency/promise.hpp"
 #include "memcached/memcached_btree/btree_data_provider.hpp"
 #include "memcached/memcached_btree/modify_oper.hpp"
 
@@ -15,14 +13,14 @@
 // unnecessary.
 
 struct memcached_get_cas_oper_t : public memcached_modify_oper_t, public home_thread_mixin_debug_only_t {
-    memcached_get_cas_oper_t(cas_t _proposed_cas, promise_t<get_result_t> *_res)
-        : proposed_cas(_proposed_cas), res(_res) { }
+    explicit memcached_get_cas_oper_t(cas_t _proposed_cas)
+        : proposed_cas(_proposed_cas) { }
 
     bool operate(buf_parent_t leaf,
                  scoped_malloc_t<memcached_value_t> *value) {
         if (!value->has()) {
             // If not found, there's nothing to do.
-            res->pulse(get_result_t());
+            result = get_result_t();
             return false;
         }
 
@@ -38,9 +36,8 @@ struct memcached_get_cas_oper_t : public memcached_modify_oper_t, public home_th
             cas_to_report = proposed_cas;
         }
 
-        // Deliver the value to the client via the promise_t we got.
         counted_t<data_buffer_t> dp = value_to_data_buffer(value->get(), leaf);
-        res->pulse(get_result_t(dp, (*value)->mcflags(), cas_to_report));
+        result = get_result_t(dp, (*value)->mcflags(), cas_to_report);
 
         // Return whether we made a change to the value.
         return !there_was_cas_before;
@@ -52,27 +49,16 @@ struct memcached_get_cas_oper_t : public memcached_modify_oper_t, public home_th
 
     cas_t proposed_cas;
     get_result_t result;
-    promise_t<get_result_t> *res;
 };
 
-void co_memcached_get_cas(const store_key_t &key, cas_t proposed_cas,
-                          exptime_t effective_time, repli_timestamp_t timestamp,
-                          btree_slice_t *slice, promise_t<get_result_t> *res,
-                          superblock_t *superblock) {
-
-    memcached_get_cas_oper_t oper(proposed_cas, res);
-    run_memcached_modify_oper(&oper, slice, key, proposed_cas, effective_time, timestamp, superblock);
-}
-
 get_result_t memcached_get_cas(const store_key_t &key, btree_slice_t *slice,
                                cas_t proposed_cas, exptime_t effective_time,
                                repli_timestamp_t timestamp,
                                superblock_t *superblock) {
-    promise_t<get_result_t> res;
-    coro_t::spawn_now_dangerously(std::bind(co_memcached_get_cas, std::ref(key),
-                                            proposed_cas, effective_time,
-                                            timestamp, slice, &res,
-                                            std::ref(superblock)));
-    return res.wait();
+    // This used to run in a coroutine of its own and hand the result back through a
+    // promise; nothing in the operation needs that.
+    memcached_get_cas_oper_t oper(proposed_cas);
+    run_memcached_modify_oper(&oper, slice, key, proposed_cas, effective_time, timestamp, superblock);
+    return oper.result;
 }
 
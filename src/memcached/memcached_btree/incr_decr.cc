@@ -33,15 +33,15 @@ struct memcached_incr_decr_oper_t : public memcached_modify_oper_t {
                       (*value)->value_ref(), blob::btree_maxreflen);
         rassert(50 <= blob::btree_maxreflen);
         if (b.valuesize() < 50) {
-            buffer_group_t buffergroup;
-            blob_acq_t acqs;
-            b.expose_region(leaf, access_t::read,
-                            0, b.valuesize(), &buffergroup, &acqs);
-            rassert(buffergroup.num_buffers() == 1);
+            // A value this short is inline in the leaf node, so we read it from
+            // there without exposing the blob.
+            const char *data = blob::inline_value_data((*value)->value_ref(),
+                                                       blob::btree_maxreflen);
+            guarantee(data != NULL);
 
             char buffer[50];
-            memcpy(buffer, buffergroup.get_buffer(0).data, buffergroup.get_buffer(0).size);
-            buffer[buffergroup.get_buffer(0).size] = '\0';
+            memcpy(buffer, data, b.valuesize());
+            buffer[b.valuesize()] = '\0';
             const char *endptr;
             number = strtou64_strict(buffer, &endptr, 10);
             valid = (endptr != buffer);
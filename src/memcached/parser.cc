@@ -2,11 +2,15 @@
 #include "memcached/parser.hpp"
 
 #include <inttypes.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <deque>
 #include <set>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "errors.hpp"
@@ -29,6 +33,35 @@
 
 static const char *crlf = "\r\n";
 
+/* The pieces of a response, which are sent with one `writev()` so that the values
+don't have to be copied into the write buffer. */
+class response_iovecs_t {
+public:
+    response_iovecs_t() { }
+
+    // `data` has to stay valid until the response is sent.
+    void add(const char *data, size_t size) {
+        iovec iov;
+        iov.iov_base = const_cast<char *>(data);
+        iov.iov_len = size;
+        iovecs.push_back(iov);
+    }
+
+    void add_copy(const std::string &s) {
+        copies.push_back(s);
+        add(copies.back().data(), copies.back().size());
+    }
+
+    const std::vector<iovec> &get() const { return iovecs; }
+
+private:
+    // A `deque` doesn't move its elements when it grows.
+    std::deque<std::string> copies;
+    std::vector<iovec> iovecs;
+
+    DISABLE_COPYING(response_iovecs_t);
+};
+
 /* txt_memcached_handler_t only exists as a convenient thing to pass around to do_get(),
 do_storage(), and the like. */
 
@@ -93,6 +126,14 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
         }
     }
 
+    void writev(const response_iovecs_t &response) THROWS_NOTHING {
+        try {
+            interface->writev(response.get().data(), response.get().size(), interruptor);
+        } catch (const interrupted_exc_t &) {
+            /* ignore */
+        }
+    }
+
     void write_from_data_provider(data_buffer_t *dp) THROWS_NOTHING {
         if (dp->size() < MAX_BUFFERED_GET_SIZE) {
             write(dp->buf(), dp->size());
@@ -101,14 +142,18 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
         }
     }
 
-    void write_value_header(const char *key, size_t key_size, mcflags_t mcflags, size_t value_size) THROWS_NOTHING {
-        writef("VALUE %*.*s %u %zu\r\n",
-               static_cast<int>(key_size), static_cast<int>(key_size), key, mcflags, value_size);
+    static std::string value_header(const char *key, size_t key_size, mcflags_t mcflags, size_t value_size) {
+        return strprintf("VALUE %*.*s %u %zu\r\n",
+                         static_cast<int>(key_size), static_cast<int>(key_size), key, mcflags, value_size);
+    }
+
+    static std::string value_header(const char *key, size_t key_size, mcflags_t mcflags, size_t value_size, cas_t cas) {
+        return strprintf("VALUE %*.*s %u %zu %" PRIu64 "\r\n",
+                         static_cast<int>(key_size), static_cast<int>(key_size), key, mcflags, value_size, cas);
     }
 
-    void write_value_header(const char *key, size_t key_size, mcflags_t mcflags, size_t value_size, cas_t cas) THROWS_NOTHING {
-        writef("VALUE %*.*s %u %zu %" PRIu64 "\r\n",
-               static_cast<int>(key_size), static_cast<int>(key_size), key, mcflags, value_size, cas);
+    void write_value_header(const char *key, size_t key_size, mcflags_t mcflags, size_t value_size) THROWS_NOTHING {
+        write(value_header(key, key_size, mcflags, value_size));
     }
 
     void error() THROWS_NOTHING {
@@ -182,6 +227,14 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
             throw memcached_interface_t::no_more_data_exc_t();
         }
     }
+
+    char peek_byte() THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
+        try {
+            return interface->peek_byte(interruptor);
+        } catch (const interrupted_exc_t &) {
+            throw memcached_interface_t::no_more_data_exc_t();
+        }
+    }
 };
 
 class pipeliner_t {
@@ -351,7 +404,8 @@ void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas,
         }
     }
 
-    /* Handle the results in sequence */
+    /* Handle the results in sequence, sending them all with one write */
+    response_iovecs_t response;
     for (size_t i = 0; i < gets.size(); ++i) {
         get_result_t &res = gets[i].res;
 
@@ -363,21 +417,22 @@ void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas,
             if (rh->is_write_open()) {
                 const store_key_t &key = gets[i].key;
 
-                /* Write the "VALUE ..." header */
+                /* The "VALUE ..." header */
                 if (with_cas) {
-                    rh->write_value_header(reinterpret_cast<const char *>(key.contents()), key.size(), res.flags, res.value->size(), res.cas);
+                    response.add_copy(txt_memcached_handler_t::value_header(reinterpret_cast<const char *>(key.contents()), key.size(), res.flags, res.value->size(), res.cas));
                 } else {
                     guarantee(res.cas == 0);
-                    rh->write_value_header(reinterpret_cast<const char *>(key.contents()), key.size(), res.flags, res.value->size());
+                    response.add_copy(txt_memcached_handler_t::value_header(reinterpret_cast<const char *>(key.contents()), key.size(), res.flags, res.value->size()));
                 }
 
-                rh->write_from_data_provider(res.value.get());
-                rh->write_crlf();
+                response.add(res.value->buf(), res.value->size());
+                response.add(crlf, 2);
             }
         }
     }
 
-    rh->write_end();
+    response.add("END\r\n", 5);
+    rh->writev(response);
 
     pipeliner_acq.end_write();
 };
@@ -488,7 +543,9 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
         std::set<key_range_t>::const_iterator shard_it = real_shards.begin();
 
         while (max_items > 0) {
-            rget_query_t rget_query(region_intersection(memcached_protocol_t::region_t(range), memcached_protocol_t::region_t(*shard_it)), max_items);
+            // `rget_query_t::maximum` is an `int`.
+            const int chunk_max_items = std::min<uint64_t>(max_items, INT_MAX);
+            rget_query_t rget_query(region_intersection(memcached_protocol_t::region_t(range), memcached_protocol_t::region_t(*shard_it)), chunk_max_items);
             memcached_protocol_t::read_t read(rget_query, time(NULL));
             memcached_protocol_t::read_response_t response;
             rh->nsi->read(read, &response, order_source->check_in("do_rget").with_read_mode(), rh->interruptor);
@@ -501,6 +558,11 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
                 rh->write_from_data_provider(it->value_provider.get());
                 rh->write_crlf();
             }
+            /* Send each chunk as soon as we have it, rather than letting the
+            write buffer hold on to it while we fetch the next one, so that the
+            client gets the first results early and the buffer never holds more than
+            one chunk. */
+            rh->flush_buffer();
 
             if (results.truncated) {
                 /* This round of the range scan stopped because the chunk was
@@ -572,6 +634,27 @@ struct storage_metadata_t {
         : mcflags(_mcflags), exptime(_exptime), unique(_unique) { }
 };
 
+exptime_t absolute_exptime(exptime_t exptime) {
+    // This is protocol.txt, verbatim:
+    // Some commands involve a client sending some kind of expiration time
+    // (relative to an item or to an operation requested by the client) to
+    // the server. In all such cases, the actual value sent may either be
+    // Unix time (number of seconds since January 1, 1970, as a 32-bit
+    // value), or a number of seconds starting from current time. In the
+    // latter case, this number of seconds may not exceed 60*60*24*30 (number
+    // of seconds in 30 days); if the number sent by a client is larger than
+    // that, the server will consider it to be real Unix time value rather
+    // than an offset from current time.
+    if (exptime <= 60*60*24*30 && exptime > 0) {
+        // If 60*60*24*30 < exptime <= time(NULL), that's fine, the
+        // btree code needs to handle that case gracefully anyway
+        // (since the clock can tick in the middle of an insert
+        // anyway...).  We have tests in expiration.py.
+        exptime += time(NULL);
+    }
+    return exptime;
+}
+
 void run_storage_command(txt_memcached_handler_t *rh,
                          pipeliner_acq_t *pipeliner_acq_raw,
                          storage_command_t sc,
@@ -766,23 +849,7 @@ void do_storage(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, storage_com
         return;
     }
 
-    // This is protocol.txt, verbatim:
-    // Some commands involve a client sending some kind of expiration time
-    // (relative to an item or to an operation requested by the client) to
-    // the server. In all such cases, the actual value sent may either be
-    // Unix time (number of seconds since January 1, 1970, as a 32-bit
-    // value), or a number of seconds starting from current time. In the
-    // latter case, this number of seconds may not exceed 60*60*24*30 (number
-    // of seconds in 30 days); if the number sent by a client is larger than
-    // that, the server will consider it to be real Unix time value rather
-    // than an offset from current time.
-    if (exptime <= 60*60*24*30 && exptime > 0) {
-        // If 60*60*24*30 < exptime <= time(NULL), that's fine, the
-        // btree code needs to handle that case gracefully anyway
-        // (since the clock can tick in the middle of an insert
-        // anyway...).  We have tests in expiration.py.
-        exptime += time(NULL);
-    }
+    exptime = absolute_exptime(exptime);
 
     /* Now parse the value length */
     size_t value_size = strtou64_strict(argv[4], &invalid_char, 10);
@@ -1096,39 +1163,24 @@ void memcached_stats(int argc, char **argv, std::vector<std::string> *stat_respo
     stat_response_lines->push_back(end_marker);
 }
 
-/* Handle memcached, takes a txt_memcached_handler_t and handles the memcached commands that come in on it */
-void handle_memcache(memcached_interface_t *interface,
-        namespace_interface_t<memcached_protocol_t> *nsi,
-        int max_concurrent_queries_per_connection,
-        memcached_stats_t *stats,
-        signal_t *interruptor) {
-    logDBG("Opened memcached stream: %p", coro_t::self());
-
-    /* This object just exists to group everything together so we don't have to pass a lot of
-    context around. */
-    txt_memcached_handler_t rh(interface, nsi, max_concurrent_queries_per_connection, stats, interruptor);
-
-    /* The commands from each individual memcached handler must be performed in the order
-    that the handler parses them. This `order_source_t` is used to guarantee that. */
-    order_source_t order_source;
-
+/* The text protocol: a command line, followed by a data block for the storage
+commands. */
+static void handle_text_requests(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t *order_source) {
     /* Declared outside the while-loop so it doesn't repeatedly reallocate its buffer */
     std::vector<char> line;
     std::vector<char*> args;
 
-    pipeliner_t pipeliner(&rh);
-
-    while (pipeliner.lock_argparsing(), !interruptor->is_pulsed()) {
+    while (pipeliner->lock_argparsing(), !rh->interruptor->is_pulsed()) {
         /* Read a line off the socket */
-        block_pm_duration read_timer(&rh.stats->pm_conns_reading);
+        block_pm_duration read_timer(&rh->stats->pm_conns_reading);
         try {
-            rh.read_line(&line);
+            rh->read_line(&line);
         } catch (const memcached_interface_t::no_more_data_exc_t &) {
             break;
         }
         read_timer.end();
 
-        block_pm_duration action_timer(&rh.stats->pm_conns_acting);
+        block_pm_duration action_timer(&rh->stats->pm_conns_acting);
 
         /* Tokenize the line */
         line.push_back('\0');   // Null terminator
@@ -1140,55 +1192,55 @@ void handle_memcache(memcached_interface_t *interface,
         }
 
         if (args.empty()) {
-            pipeliner_acq_t pipeliner_acq(&pipeliner);
+            pipeliner_acq_t pipeliner_acq(pipeliner);
             pipeliner_acq.done_argparsing();
             pipeliner_acq.begin_write();
-            rh.error();
+            rh->error();
             pipeliner_acq.end_write();
             continue;
         }
 
         /* Dispatch to the appropriate subclass */
-        order_token_t token = order_source.check_in(std::string("handle_memcache+") + args[0]);
+        order_token_t token = order_source->check_in(std::string("handle_memcache+") + args[0]);
         if (!strcmp(args[0], "get")) {    // check for retrieval commands
-            coro_t::spawn_now_dangerously(boost::bind(do_get, &rh, &pipeliner, false, args.size(), args.data(), token.with_read_mode()));
+            coro_t::spawn_now_dangerously(boost::bind(do_get, rh, pipeliner, false, args.size(), args.data(), token.with_read_mode()));
         } else if (!strcmp(args[0], "gets")) {
-            coro_t::spawn_now_dangerously(boost::bind(do_get, &rh, &pipeliner, true, args.size(), args.data(), token));
+            coro_t::spawn_now_dangerously(boost::bind(do_get, rh, pipeliner, true, args.size(), args.data(), token));
         } else if (!strcmp(args[0], "rget")) {
-            coro_t::spawn_now_dangerously(boost::bind(do_rget, &rh, &pipeliner, &order_source, args.size(), args.data()));
+            coro_t::spawn_now_dangerously(boost::bind(do_rget, rh, pipeliner, order_source, args.size(), args.data()));
         } else if (!strcmp(args[0], "set")) {     // check for storage commands
-            do_storage(&rh, &pipeliner, set_command, args.size(), args.data(), token);
+            do_storage(rh, pipeliner, set_command, args.size(), args.data(), token);
         } else if (!strcmp(args[0], "add")) {
-            do_storage(&rh, &pipeliner, add_command, args.size(), args.data(), token);
+            do_storage(rh, pipeliner, add_command, args.size(), args.data(), token);
         } else if (!strcmp(args[0], "replace")) {
-            do_storage(&rh, &pipeliner, replace_command, args.size(), args.data(), token);
+            do_storage(rh, pipeliner, replace_command, args.size(), args.data(), token);
         } else if (!strcmp(args[0], "append")) {
-            do_storage(&rh, &pipeliner, append_command, args.size(), args.data(), token);
+            do_storage(rh, pipeliner, append_command, args.size(), args.data(), token);
         } else if (!strcmp(args[0], "prepend")) {
-            do_storage(&rh, &pipeliner, prepend_command, args.size(), args.data(), token);
+            do_storage(rh, pipeliner, prepend_command, args.size(), args.data(), token);
         } else if (!strcmp(args[0], "cas")) {
-            do_storage(&rh, &pipeliner, cas_command, args.size(), args.data(), token);
+            do_storage(rh, pipeliner, cas_command, args.size(), args.data(), token);
         } else if (!strcmp(args[0], "delete")) {
-            coro_t::spawn_now_dangerously(boost::bind(do_delete, &rh, &pipeliner, args.size(), args.data(), token));
+            coro_t::spawn_now_dangerously(boost::bind(do_delete, rh, pipeliner, args.size(), args.data(), token));
         } else if (!strcmp(args[0], "incr")) {
-            coro_t::spawn_now_dangerously(boost::bind(do_incr_decr, &rh, &pipeliner, true, args.size(), args.data(), token));
+            coro_t::spawn_now_dangerously(boost::bind(do_incr_decr, rh, pipeliner, true, args.size(), args.data(), token));
         } else if (!strcmp(args[0], "decr")) {
-            coro_t::spawn_now_dangerously(boost::bind(do_incr_decr, &rh, &pipeliner, false, args.size(), args.data(), token));
+            coro_t::spawn_now_dangerously(boost::bind(do_incr_decr, rh, pipeliner, false, args.size(), args.data(), token));
         } else if (!strcmp(args[0], "quit")) {
             // Make sure there's no more tokens (the kind in args, not
             // order tokens)
             if (args.size() > 1) {
-                pipeliner_acq_t pipeliner_acq(&pipeliner);
+                pipeliner_acq_t pipeliner_acq(pipeliner);
                 // We block everybody, but who cares?
                 pipeliner_acq.done_argparsing();
                 pipeliner_acq.begin_write();
-                rh.error();
+                rh->error();
                 pipeliner_acq.end_write();
             } else {
                 break;
             }
         } else if (!strcmp(args[0], "stats") || !strcmp(args[0], "stat")) {
-            pipeliner_acq_t pipeliner_acq(&pipeliner);
+            pipeliner_acq_t pipeliner_acq(pipeliner);
 
             std::vector<std::string> stat_response_lines;
             memcached_stats(args.size(), args.data(), &stat_response_lines);
@@ -1197,31 +1249,585 @@ void handle_memcache(memcached_interface_t *interface,
             pipeliner_acq.done_argparsing();
             pipeliner_acq.begin_write();
             for (std::vector<std::string>::const_iterator i = stat_response_lines.begin(); i != stat_response_lines.end(); ++i) {
-                rh.write(*i);
+                rh->write(*i);
             }
             pipeliner_acq.end_write();
         } else if (!strcmp(args[0], "version")) {
-            pipeliner_acq_t pipeliner_acq(&pipeliner);
+            pipeliner_acq_t pipeliner_acq(pipeliner);
 
             pipeliner_acq.done_argparsing();
             pipeliner_acq.begin_write();
             if (args.size() == 1) {
-                rh.writef("VERSION rethinkdb-%s\r\n", RETHINKDB_VERSION);
+                rh->writef("VERSION rethinkdb-%s\r\n", RETHINKDB_VERSION);
             } else {
-                rh.error();
+                rh->error();
             }
             pipeliner_acq.end_write();
         } else {
-            pipeliner_acq_t pipeliner_acq(&pipeliner);
+            pipeliner_acq_t pipeliner_acq(pipeliner);
             pipeliner_acq.done_argparsing();
             pipeliner_acq.begin_write();
-            rh.error();
+            rh->error();
             pipeliner_acq.end_write();
         }
 
         action_timer.end();
     }
 
+}
+
+/* The binary protocol.  Each request and response is a 24-byte header, with
+big-endian fields, followed by the extras, the key and the value. */
+
+static const uint8_t binary_request_magic = 0x80;
+static const uint8_t binary_response_magic = 0x81;
+static const size_t binary_header_size = 24;
+
+enum binary_opcode_t {
+    binary_get = 0x00,
+    binary_set = 0x01,
+    binary_add = 0x02,
+    binary_replace = 0x03,
+    binary_delete = 0x04,
+    binary_increment = 0x05,
+    binary_decrement = 0x06,
+    binary_quit = 0x07,
+    binary_getq = 0x09,
+    binary_noop = 0x0a,
+    binary_version = 0x0b,
+    binary_getk = 0x0c,
+    binary_getkq = 0x0d,
+    binary_append = 0x0e,
+    binary_prepend = 0x0f,
+    binary_setq = 0x11,
+    binary_addq = 0x12,
+    binary_replaceq = 0x13,
+    binary_deleteq = 0x14,
+    binary_incrementq = 0x15,
+    binary_decrementq = 0x16,
+    binary_quitq = 0x17,
+    binary_appendq = 0x19,
+    binary_prependq = 0x1a
+};
+
+enum binary_status_t {
+    binary_no_error = 0x0000,
+    binary_key_not_found = 0x0001,
+    binary_key_exists = 0x0002,
+    binary_value_too_large = 0x0003,
+    binary_invalid_arguments = 0x0004,
+    binary_item_not_stored = 0x0005,
+    binary_non_numeric_value = 0x0006,
+    binary_unknown_command = 0x0081,
+    binary_internal_error = 0x0084
+};
+
+struct binary_request_t {
+    binary_request_t() : opcode(0), opaque(0), cas(0), rejection(binary_no_error) { }
+
+    uint8_t opcode;
+    uint32_t opaque;
+    cas_t cas;
+    // If this isn't `binary_no_error`, the header was rejected with this status, and
+    // the request has no extras, key or value.
+    binary_status_t rejection;
+    std::string extras;
+    std::string key;
+    counted_t<data_buffer_t> value;
+};
+
+static uint64_t decode_big_endian(const char *data, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(data[i]);
+    }
+    return value;
+}
+
+static void encode_big_endian(uint64_t value, size_t size, std::string *out) {
+    for (size_t i = size; i > 0; --i) {
+        out->push_back(static_cast<char>((value >> (8 * (i - 1))) & 0xff));
+    }
+}
+
+/* Returns the opcode that `opcode` is the quiet variant of, or `opcode` itself,
+and whether it was a quiet one.  Quiet requests are only answered if they fail,
+except that a quiet get that misses isn't answered either. */
+static uint8_t binary_base_opcode(uint8_t opcode, bool *quiet_out) {
+    *quiet_out = true;
+    switch (opcode) {
+    case binary_getq: return binary_get;
+    case binary_getkq: return binary_getk;
+    case binary_setq: return binary_set;
+    case binary_addq: return binary_add;
+    case binary_replaceq: return binary_replace;
+    case binary_deleteq: return binary_delete;
+    case binary_incrementq: return binary_increment;
+    case binary_decrementq: return binary_decrement;
+    case binary_quitq: return binary_quit;
+    case binary_appendq: return binary_append;
+    case binary_prependq: return binary_prepend;
+    default:
+        *quiet_out = false;
+        return opcode;
+    }
+}
+
+static bool is_binary_get(uint8_t opcode) {
+    bool quiet;
+    const uint8_t base = binary_base_opcode(opcode, &quiet);
+    return base == binary_get || base == binary_getk;
+}
+
+/* Checks the sizes in a request's header against what its opcode takes: the
+extras, a key that fits in a `store_key_t`, and a value only for the opcodes
+that have one, of at most `MAX_VALUE_SIZE`.  Returns the status to reject the
+request with, or `binary_no_error`. */
+static binary_status_t check_binary_header(uint8_t opcode, uint64_t key_size,
+                                           uint64_t extras_size, uint64_t value_size) {
+    uint64_t expected_extras_size;
+    bool has_key, has_value;
+    bool quiet;
+    switch (binary_base_opcode(opcode, &quiet)) {
+    case binary_get:
+    case binary_getk:
+    case binary_delete:
+        expected_extras_size = 0; has_key = true; has_value = false; break;
+    case binary_set:
+    case binary_add:
+    case binary_replace:
+        expected_extras_size = 8; has_key = true; has_value = true; break;
+    case binary_append:
+    case binary_prepend:
+        expected_extras_size = 0; has_key = true; has_value = true; break;
+    case binary_increment:
+    case binary_decrement:
+        expected_extras_size = 20; has_key = true; has_value = false; break;
+    case binary_quit:
+    case binary_noop:
+    case binary_version:
+        expected_extras_size = 0; has_key = false; has_value = false; break;
+    default:
+        return binary_unknown_command;
+    }
+    if (extras_size != expected_extras_size
+        || (has_key ? key_size == 0 || key_size > MAX_KEY_SIZE : key_size != 0)
+        || (!has_value && value_size != 0)) {
+        return binary_invalid_arguments;
+    }
+    if (value_size > MAX_VALUE_SIZE) {
+        return binary_value_too_large;
+    }
+    return binary_no_error;
+}
+
+/* Reads a request off the connection.  Returns false if it isn't a binary
+protocol request or its body is larger than memcached allows, in which case we
+can't tell where the next request starts and the connection should be closed.
+
+The header is checked before any of the body is read, so that a request with an
+unknown opcode or sizes that don't fit it doesn't make us read or allocate its
+body.  Such a request comes back with its `rejection` set; it gets an error
+response, and then the connection is closed, since its body is still in the way
+of the next request. */
+static bool read_binary_request(txt_memcached_handler_t *rh, binary_request_t *request_out)
+        THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
+    char header[binary_header_size];
+    rh->read(header, sizeof(header));
+
+    const uint64_t key_size = decode_big_endian(header + 2, 2);
+    const uint64_t extras_size = decode_big_endian(header + 4, 1);
+    const uint64_t body_size = decode_big_endian(header + 8, 4);
+    // Check for signed 32 bit max value for Memcached compatibility...
+    if (static_cast<uint8_t>(header[0]) != binary_request_magic
+        || body_size < key_size + extras_size
+        || body_size >= (1u << 31) - 1) {
+        return false;
+    }
+
+    request_out->opcode = header[1];
+    request_out->opaque = decode_big_endian(header + 12, 4);
+    request_out->cas = decode_big_endian(header + 16, 8);
+
+    const size_t value_size = body_size - key_size - extras_size;
+    request_out->rejection = check_binary_header(request_out->opcode, key_size,
+                                                 extras_size, value_size);
+    if (request_out->rejection != binary_no_error) {
+        return true;
+    }
+
+    request_out->extras.resize(extras_size);
+    if (extras_size > 0) {
+        rh->read(&request_out->extras[0], extras_size);
+    }
+    request_out->key.resize(key_size);
+    if (key_size > 0) {
+        rh->read(&request_out->key[0], key_size);
+    }
+    request_out->value = data_buffer_t::create(value_size);
+    if (value_size > 0) {
+        rh->read(request_out->value->buf(), value_size);
+    }
+    return true;
+}
+
+static std::string binary_response_header(const binary_request_t &request, uint16_t status,
+                                          size_t key_size, size_t extras_size,
+                                          size_t value_size, cas_t cas) {
+    std::string header;
+    header.reserve(binary_header_size);
+    header.push_back(binary_response_magic);
+    header.push_back(request.opcode);
+    encode_big_endian(key_size, 2, &header);
+    encode_big_endian(extras_size, 1, &header);
+    header.push_back(0);   // Data type
+    encode_big_endian(status, 2, &header);
+    encode_big_endian(key_size + extras_size + value_size, 4, &header);
+    encode_big_endian(request.opaque, 4, &header);
+    encode_big_endian(cas, 8, &header);
+    return header;
+}
+
+/* A response whose value, if it has one, is `message`. */
+static void add_binary_status(response_iovecs_t *response, const binary_request_t &request,
+                              uint16_t status, const std::string &message) {
+    response->add_copy(binary_response_header(request, status, 0, 0, message.size(), 0) + message);
+}
+
+/* The response to a request that failed with `status`.  Failures are answered
+even if the request was quiet. */
+static void add_binary_error(response_iovecs_t *response, const binary_request_t &request,
+                             uint16_t status) {
+    switch (status) {
+    case binary_key_not_found: add_binary_status(response, request, status, "Not found"); break;
+    case binary_key_exists: add_binary_status(response, request, status, "Data exists for key."); break;
+    case binary_value_too_large: add_binary_status(response, request, status, "Too large."); break;
+    case binary_invalid_arguments: add_binary_status(response, request, status, "Invalid arguments"); break;
+    case binary_item_not_stored: add_binary_status(response, request, status, "Not stored."); break;
+    case binary_non_numeric_value:
+        add_binary_status(response, request, status, "Non-numeric server-side value for incr or decr");
+        break;
+    case binary_unknown_command: add_binary_status(response, request, status, "Unknown command"); break;
+    default: unreachable();
+    }
+}
+
+/* Performs a request that isn't a get, adding the response, if any, to `response`. */
+static void perform_binary_request(txt_memcached_handler_t *rh, const binary_request_t &request,
+                                   order_token_t token, response_iovecs_t *response)
+        THROWS_ONLY(interrupted_exc_t) {
+    if (request.rejection != binary_no_error) {
+        add_binary_error(response, request, request.rejection);
+        return;
+    }
+    bool quiet;
+    const uint8_t opcode = binary_base_opcode(request.opcode, &quiet);
+    const store_key_t key(request.key);
+    uint16_t status = binary_no_error;
+
+    try {
+        switch (opcode) {
+        case binary_set:
+        case binary_add:
+        case binary_replace: {
+            block_pm_duration set_timer(&rh->stats->pm_cmd_set);
+            rh->stats->pm_storage_key_size.record(key.size());
+            rh->stats->pm_storage_value_size.record(request.value->size());
+
+            const mcflags_t mcflags = decode_big_endian(request.extras.data(), 4);
+            const exptime_t exptime = absolute_exptime(decode_big_endian(request.extras.data() + 4, 4));
+            // A set with a CAS is the text protocol's "cas".
+            const bool with_cas = opcode == binary_set && request.cas != 0;
+            sarc_mutation_t sarc_mutation(key, request.value, mcflags, exptime,
+                (opcode == binary_replace || with_cas) ? add_policy_no : add_policy_yes,
+                opcode == binary_add ? replace_policy_no
+                    : with_cas ? replace_policy_if_cas_matches : replace_policy_yes,
+                with_cas ? request.cas : NO_CAS_SUPPLIED);
+            memcached_protocol_t::write_t write(sarc_mutation, rh->generate_cas(), time(NULL));
+            memcached_protocol_t::write_response_t result;
+            rh->nsi->write(write, &result, token, rh->interruptor);
+            switch (boost::get<set_result_t>(result.result)) {
+            case sr_stored: break;
+            case sr_didnt_add: status = binary_key_not_found; break;
+            case sr_didnt_replace: status = binary_key_exists; break;
+            case sr_too_large: status = binary_value_too_large; break;
+            default: unreachable();
+            }
+        } break;
+        case binary_append:
+        case binary_prepend: {
+            block_pm_duration set_timer(&rh->stats->pm_cmd_set);
+            rh->stats->pm_storage_key_size.record(key.size());
+            rh->stats->pm_storage_value_size.record(request.value->size());
+
+            append_prepend_mutation_t append_prepend_mutation(
+                opcode == binary_append ? append_prepend_APPEND : append_prepend_PREPEND,
+                key, request.value);
+            memcached_protocol_t::write_t write(append_prepend_mutation, rh->generate_cas(), time(NULL));
+            memcached_protocol_t::write_response_t result;
+            rh->nsi->write(write, &result, token, rh->interruptor);
+            switch (boost::get<append_prepend_result_t>(result.result)) {
+            case apr_success: break;
+            case apr_not_found: status = binary_item_not_stored; break;
+            case apr_too_large: status = binary_value_too_large; break;
+            default: unreachable();
+            }
+        } break;
+        case binary_delete: {
+            block_pm_duration set_timer(&rh->stats->pm_cmd_set);
+            rh->stats->pm_delete_key_size.record(key.size());
+
+            delete_mutation_t delete_mutation(key, false);
+            memcached_protocol_t::write_t write(delete_mutation, INVALID_CAS, time(NULL));
+            memcached_protocol_t::write_response_t result;
+            rh->nsi->write(write, &result, token, rh->interruptor);
+            switch (boost::get<delete_result_t>(result.result)) {
+            case dr_deleted: break;
+            case dr_not_found: status = binary_key_not_found; break;
+            default: unreachable();
+            }
+        } break;
+        case binary_increment:
+        case binary_decrement: {
+            block_pm_duration set_timer(&rh->stats->pm_cmd_set);
+
+            /* The extras are the amount, an initial value and an expiration time.
+            We can't create missing keys, as the text protocol can't either, so the
+            last two are ignored. */
+            incr_decr_mutation_t incr_decr_mutation(
+                opcode == binary_increment ? incr_decr_INCR : incr_decr_DECR,
+                key, decode_big_endian(request.extras.data(), 8));
+            memcached_protocol_t::write_t write(incr_decr_mutation, rh->generate_cas(), time(NULL));
+            memcached_protocol_t::write_response_t result;
+            rh->nsi->write(write, &result, token, rh->interruptor);
+            const incr_decr_result_t res = boost::get<incr_decr_result_t>(result.result);
+            switch (res.res) {
+            case incr_decr_result_t::idr_success:
+                if (!quiet) {
+                    std::string value;
+                    encode_big_endian(res.new_value, 8, &value);
+                    response->add_copy(binary_response_header(request, binary_no_error, 0, 0, value.size(), 0) + value);
+                }
+                return;
+            case incr_decr_result_t::idr_not_found: status = binary_key_not_found; break;
+            case incr_decr_result_t::idr_not_numeric: status = binary_non_numeric_value; break;
+            default: unreachable();
+            }
+        } break;
+        case binary_noop:
+        case binary_quit:
+            break;
+        case binary_version:
+            if (!quiet) {
+                add_binary_status(response, request, binary_no_error,
+                                  strprintf("rethinkdb-%s", RETHINKDB_VERSION));
+            }
+            return;
+        default:
+            status = binary_unknown_command;
+            break;
+        }
+    } catch (const cannot_perform_query_exc_t &e) {
+        add_binary_status(response, request, binary_internal_error, e.what());
+        return;
+    }
+
+    if (status != binary_no_error) {
+        add_binary_error(response, request, status);
+    } else if (!quiet) {
+        add_binary_status(response, request, status, "");
+    }
+}
+
+void run_binary_request(txt_memcached_handler_t *rh,
+                        pipeliner_acq_t *pipeliner_acq_raw,
+                        const binary_request_t &request,
+                        order_token_t token) {
+    scoped_ptr_t<pipeliner_acq_t> pipeliner_acq(pipeliner_acq_raw);
+
+    response_iovecs_t response;
+    try {
+        perform_binary_request(rh, request, token, &response);
+    } catch (const interrupted_exc_t &) {
+        pipeliner_acq->begin_write();
+        pipeliner_acq->end_write();
+        return;
+    }
+
+    pipeliner_acq->begin_write();
+    if (!response.get().empty()) {
+        rh->writev(response);
+    }
+    pipeliner_acq->end_write();
+}
+
+/* Looks up the keys of a run of gets together, spreading the reads over the
+shards, and sends all of their responses with one write. */
+void run_binary_gets(txt_memcached_handler_t *rh,
+                     pipeliner_acq_t *pipeliner_acq_raw,
+                     std::vector<binary_request_t> *requests_raw,
+                     order_token_t token) {
+    scoped_ptr_t<pipeliner_acq_t> pipeliner_acq(pipeliner_acq_raw);
+    scoped_ptr_t<std::vector<binary_request_t> > requests(requests_raw);
+
+    block_pm_duration get_timer(&rh->stats->pm_cmd_get);
+
+    // Their headers were checked, so their keys are all valid.
+    std::vector<get_t> gets(requests->size());
+    for (size_t i = 0; i < requests->size(); ++i) {
+        gets[i].key = store_key_t((*requests)[i].key);
+        rh->stats->pm_get_key_size.record(gets[i].key.size());
+    }
+
+    pmap(gets.size(), boost::bind(&do_one_get, rh, false, gets.data(), _1, token));
+
+    if (rh->interruptor->is_pulsed()) {
+        pipeliner_acq->begin_write();
+        pipeliner_acq->end_write();
+        return;
+    }
+
+    response_iovecs_t response;
+    for (size_t i = 0; i < requests->size(); ++i) {
+        const binary_request_t &request = (*requests)[i];
+        bool quiet;
+        const bool with_key = binary_base_opcode(request.opcode, &quiet) == binary_getk;
+        get_t &get = gets[i];
+        if (!get.ok) {
+            add_binary_status(&response, request, binary_internal_error, get.error_message);
+        } else if (!get.res.value.has()) {
+            if (!quiet) {
+                add_binary_status(&response, request, binary_key_not_found, "Not found");
+            }
+        } else {
+            std::string extras;
+            encode_big_endian(get.res.flags, 4, &extras);
+            const size_t key_size = with_key ? request.key.size() : 0;
+            response.add_copy(binary_response_header(request, binary_no_error, key_size,
+                                                     extras.size(), get.res.value->size(),
+                                                     get.res.cas)
+                              + extras + request.key.substr(0, key_size));
+            response.add(get.res.value->buf(), get.res.value->size());
+        }
+    }
+
+    pipeliner_acq->begin_write();
+    if (!response.get().empty()) {
+        rh->writev(response);
+    }
+    pipeliner_acq->end_write();
+}
+
+static void handle_binary_requests(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t *order_source) {
+    /* A request that ended a run of gets without being one, to be handled next */
+    binary_request_t pending;
+    bool has_pending = false;
+    bool closed = false;
+
+    while (pipeliner->lock_argparsing(), !closed && !rh->interruptor->is_pulsed()) {
+        block_pm_duration read_timer(&rh->stats->pm_conns_reading);
+
+        /* Clients send a run of quiet gets, usually ended by a noop or a plain
+        get, to fetch many keys at once.  We collect the run so that its keys are
+        looked up together. */
+        scoped_ptr_t<std::vector<binary_request_t> > gets(new std::vector<binary_request_t>());
+        binary_request_t request;
+        bool has_request = false;
+        for (;;) {
+            binary_request_t next;
+            if (has_pending) {
+                next = pending;
+                pending = binary_request_t();
+                has_pending = false;
+            } else {
+                try {
+                    closed = !read_binary_request(rh, &next);
+                } catch (const memcached_interface_t::no_more_data_exc_t &) {
+                    closed = true;
+                }
+                if (closed) {
+                    break;
+                }
+            }
+
+            bool quiet;
+            binary_base_opcode(next.opcode, &quiet);
+            if (is_binary_get(next.opcode) && next.rejection == binary_no_error) {
+                gets->push_back(next);
+                if (!quiet || gets->size() >= MEMCACHED_BINARY_MAX_GET_BATCH) {
+                    break;
+                }
+            } else if (gets->empty()) {
+                request = next;
+                has_request = true;
+                break;
+            } else {
+                pending = next;
+                has_pending = true;
+                break;
+            }
+        }
+        read_timer.end();
+
+        block_pm_duration action_timer(&rh->stats->pm_conns_acting);
+
+        if (!gets->empty()) {
+            order_token_t token = order_source->check_in("handle_memcache+binary_get");
+            pipeliner_acq_t *pipeliner_acq = new pipeliner_acq_t(pipeliner);
+            pipeliner_acq->done_argparsing();
+            coro_t::spawn_now_dangerously(boost::bind(&run_binary_gets, rh, pipeliner_acq, gets.release(), token.with_read_mode()));
+        } else if (has_request) {
+            bool quiet;
+            if (binary_base_opcode(request.opcode, &quiet) == binary_quit
+                || request.rejection != binary_no_error) {
+                closed = true;
+            }
+            order_token_t token = order_source->check_in("handle_memcache+binary");
+            pipeliner_acq_t *pipeliner_acq = new pipeliner_acq_t(pipeliner);
+            pipeliner_acq->done_argparsing();
+            coro_t::spawn_now_dangerously(boost::bind(&run_binary_request, rh, pipeliner_acq, request, token));
+        } else {
+            // The connection closed without another request.
+            break;
+        }
+
+        action_timer.end();
+    }
+}
+
+/* Handle memcached, takes a txt_memcached_handler_t and handles the memcached commands that come in on it */
+void handle_memcache(memcached_interface_t *interface,
+        namespace_interface_t<memcached_protocol_t> *nsi,
+        int max_concurrent_queries_per_connection,
+        memcached_stats_t *stats,
+        signal_t *interruptor) {
+    logDBG("Opened memcached stream: %p", coro_t::self());
+
+    /* This object just exists to group everything together so we don't have to pass a lot of
+    context around. */
+    txt_memcached_handler_t rh(interface, nsi, max_concurrent_queries_per_connection, stats, interruptor);
+
+    /* The commands from each individual memcached handler must be performed in the order
+    that the handler parses them. This `order_source_t` is used to guarantee that. */
+    order_source_t order_source;
+
+    pipeliner_t pipeliner(&rh);
+
+    /* No text protocol command starts with the binary protocol's magic byte, so the
+    first byte tells us which protocol the client speaks. */
+    bool binary = false;
+    try {
+        binary = static_cast<uint8_t>(rh.peek_byte()) == binary_request_magic;
+    } catch (const memcached_interface_t::no_more_data_exc_t &) {
+        /* The text loop will find that out too */
+    }
+
+    if (binary) {
+        handle_binary_requests(&rh, &pipeliner, &order_source);
+    } else {
+        handle_text_requests(&rh, &pipeliner, &order_source);
+    }
+
     // Make sure anything that would be running has finished.
     pipeliner_acq_t pipeliner_acq(&pipeliner);
     pipeliner_acq.done_argparsing();
@@ -2,6 +2,8 @@
 #ifndef MEMCACHED_PARSER_HPP_
 #define MEMCACHED_PARSER_HPP_
 
+#include <sys/uio.h>
+
 #include <vector>
 
 #include "memcached/protocol.hpp"
@@ -11,7 +13,8 @@
 /* `handle_memcache()` handles memcache queries from the given `memcached_interface_t`,
 sending the results to the same `memcached_interface_t`, until either SIGINT is sent to
 the server or `memcache_interface_t::read()` or `memcache_interface_t::read_line()`
-throws `no_more_data_exc_t`.
+throws `no_more_data_exc_t`.  It speaks the text protocol, or the binary protocol if
+the first byte of the stream is the binary request magic byte.
 
 See `memcache/file.hpp` and `memcache/tcp_conn.hpp` for premade functions to handle
 memcache traffic from either a file or a TCP connection. */
@@ -20,6 +23,8 @@ struct memcached_interface_t {
 
     virtual void write(const char *, size_t, signal_t *interruptor) = 0;
     virtual void write_unbuffered(const char *buffer, size_t bytes, signal_t *interruptor) = 0;
+    // Sends the buffers after what was written before, without copying them.
+    virtual void writev(const iovec *iov, size_t iovcnt, signal_t *interruptor) = 0;
 
     virtual void flush_buffer(signal_t *interruptor) = 0;
     virtual bool is_write_open() = 0;
@@ -31,6 +36,8 @@ struct memcached_interface_t {
     };
     virtual void read(void *, size_t, signal_t *interruptor) = 0;
     virtual void read_line(std::vector<char> *, signal_t *interruptor) = 0;
+    // Returns the next byte without consuming it.
+    virtual char peek_byte(signal_t *interruptor) = 0;
 
     virtual ~memcached_interface_t() { }
 };
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "memcached/protocol.hpp"
 
+#include <algorithm>
+
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
@@ -11,6 +13,7 @@
 #include "concurrency/pmap.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/varint.hpp"
 #include "containers/scoped.hpp"
 #include "memcached/memcached_btree/append_prepend.hpp"
 #include "memcached/memcached_btree/delete.hpp"
@@ -73,12 +76,70 @@ archive_result_t deserialize(read_stream_t *s, counted_t<data_buffer_t> *buf) {
     return ARCHIVE_SUCCESS;
 }
 
+/* The keys of an `rget_result_t` are in order, so each usually shares a long prefix
+with the one before it.  We send only the length of that prefix and the rest of
+the key. */
+write_message_t &operator<<(write_message_t &msg, const rget_result_t &result) {
+    serialize_varint_uint64(&msg, result.pairs.size());
+    const store_key_t *previous = NULL;
+    for (auto it = result.pairs.begin(); it != result.pairs.end(); ++it) {
+        const store_key_t &key = it->key;
+        uint8_t shared = 0;
+        if (previous != NULL) {
+            const int max_shared = std::min(key.size(), previous->size());
+            while (shared < max_shared && key.contents()[shared] == previous->contents()[shared]) {
+                ++shared;
+            }
+        }
+        const uint8_t suffix_size = key.size() - shared;
+        msg << shared;
+        msg << suffix_size;
+        msg.append(key.contents() + shared, suffix_size);
+        msg << it->mcflags;
+        msg << it->value_provider;
+        previous = &key;
+    }
+    msg << result.truncated;
+    return msg;
+}
+
+archive_result_t deserialize(read_stream_t *s, rget_result_t *result) {
+    uint64_t count;
+    archive_result_t res = deserialize_varint_uint64(s, &count);
+    if (res) { return res; }
+    result->pairs.clear();
+    uint8_t buf[MAX_KEY_SIZE];
+    int previous_size = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint8_t shared, suffix_size;
+        res = deserialize(s, &shared);
+        if (res) { return res; }
+        res = deserialize(s, &suffix_size);
+        if (res) { return res; }
+        if (shared > previous_size || shared + suffix_size > MAX_KEY_SIZE) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+        int64_t num_read = force_read(s, buf + shared, suffix_size);
+        if (num_read == -1) { return ARCHIVE_SOCK_ERROR; }
+        if (num_read < suffix_size) { return ARCHIVE_SOCK_EOF; }
+        previous_size = shared + suffix_size;
+
+        key_with_data_buffer_t pair;
+        pair.key.assign(previous_size, buf);
+        res = deserialize(s, &pair.mcflags);
+        if (res) { return res; }
+        res = deserialize(s, &pair.value_provider);
+        if (res) { return res; }
+        result->pairs.push_back(pair);
+    }
+    return deserialize(s, &result->truncated);
+}
+
 RDB_IMPL_SERIALIZABLE_1(get_query_t, key);
 RDB_IMPL_SERIALIZABLE_2(rget_query_t, region, maximum);
 RDB_IMPL_SERIALIZABLE_3(distribution_get_query_t, max_depth, result_limit, region);
 RDB_IMPL_SERIALIZABLE_3(get_result_t, value, flags, cas);
 RDB_IMPL_SERIALIZABLE_3(key_with_data_buffer_t, key, mcflags, value_provider);
-RDB_IMPL_SERIALIZABLE_2(rget_result_t, pairs, truncated);
 RDB_IMPL_SERIALIZABLE_2(distribution_result_t, region, key_counts);
 RDB_IMPL_SERIALIZABLE_1(get_cas_mutation_t, key);
 RDB_IMPL_SERIALIZABLE_7(sarc_mutation_t, key, data, flags, exptime, add_policy, replace_policy, old_cas);
@@ -405,13 +466,14 @@ region_t memcached_protocol_t::cpu_sharding_subspace(int subregion_number, int n
 store_t::store_t(serializer_t *serializer,
                  const std::string &perfmon_name,
                  int64_t cache_size,
+                 cache_balancer_t *balancer,
                  bool create,
                  perfmon_collection_t *parent_perfmon_collection,
                  context_t *ctx,
                  io_backender_t *io,
                  const base_path_t &base_path)
     : btree_store_t<memcached_protocol_t>(
-            serializer, perfmon_name, cache_size,
+            serializer, perfmon_name, cache_size, balancer,
             create, parent_perfmon_collection, ctx, io,
             base_path)
 { }
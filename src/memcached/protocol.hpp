@@ -22,6 +22,7 @@
 #include "perfmon/types.hpp"
 #include "repli_timestamp.hpp"
 
+class cache_balancer_t;
 class io_backender_t;
 class real_superblock_t;
 class traversal_progress_combiner_t;
@@ -112,6 +113,12 @@ public:
 
         region_t get_region() const THROWS_NOTHING;
 
+        // Memcached mutations can depend on the old value (CAS, incr/decr, append),
+        // so we never treat them as overwriting their region.
+        bool get_overwritten_region(UNUSED region_t *region_out) const THROWS_NOTHING {
+            return false;
+        }
+
         // Returns true if the write had any applicability to the region, and a non-empty
         // write was written to write_out.
         bool shard(const region_t &region,
@@ -177,6 +184,7 @@ public:
         store_t(serializer_t *serializer,
                 const std::string &perfmon_name,
                 int64_t cache_quota,
+                cache_balancer_t *balancer,
                 bool create,
                 perfmon_collection_t *collection,
                 context_t *,
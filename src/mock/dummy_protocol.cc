@@ -93,6 +93,11 @@ dummy_protocol_t::region_t dummy_protocol_t::write_t::get_region() const {
     return region;
 }
 
+bool dummy_protocol_t::write_t::get_overwritten_region(region_t *region_out) const {
+    *region_out = get_region();
+    return true;
+}
+
 bool dummy_protocol_t::write_t::shard(const region_t &region,
                                       write_t *write_out) const {
     std::map<std::string, std::string> tmp;
@@ -213,7 +218,8 @@ dummy_protocol_t::store_t::store_t() : store_view_t<dummy_protocol_t>(dummy_prot
 }
 
 dummy_protocol_t::store_t::store_t(serializer_t *_serializer, UNUSED const std::string &,
-                                   UNUSED int64_t , bool create,
+                                   UNUSED int64_t , UNUSED cache_balancer_t *,
+                                   bool create,
                                    UNUSED perfmon_collection_t *, UNUSED context_t *,
                                    io_backender_t *, const base_path_t &) :
     store_view_t<dummy_protocol_t>(dummy_protocol_t::region_t('a', 'z')),
@@ -18,6 +18,7 @@
 #include "utils.hpp"
 
 class signal_t;
+class cache_balancer_t;
 class io_backender_t;
 class serializer_t;
 
@@ -73,6 +74,8 @@ public:
         durability_requirement_t durability() const { return DURABILITY_REQUIREMENT_DEFAULT; }
 
         region_t get_region() const;
+        // Every dummy write sets the values of all of its keys.
+        bool get_overwritten_region(region_t *region_out) const;
         // Returns true if the write had any applicability to the region, and a non-empty
         // write was written to write_out.
         bool shard(const region_t &region,
@@ -107,11 +110,16 @@ public:
 
         store_t();
         store_t(serializer_t *serializer, const std::string &perfmon_name,
-                UNUSED int64_t cache_size, bool create,
+                UNUSED int64_t cache_size, cache_balancer_t *balancer, bool create,
                 perfmon_collection_t *collection, context_t *ctx,
                 io_backender_t *io, const base_path_t &);
         ~store_t();
 
+        // The dummy store has no cache to warm up or back with flash.
+        void use_cache_warmup_file(UNUSED const std::string &filepath) { }
+        void use_cache_flash_file(UNUSED const std::string &filepath,
+                                  UNUSED uint64_t size) { }
+
         void new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out) THROWS_NOTHING;
         void new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out) THROWS_NOTHING;
 
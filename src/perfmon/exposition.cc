@@ -0,0 +1,218 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "perfmon/exposition.hpp"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "containers/scoped_regex.hpp"
+#include "containers/uuid.hpp"
+#include "perfmon/perfmon.hpp"
+
+static const char *metric_prefix = "rethinkdb";
+
+/* Metric names may only have letters, digits, underscores and colons; we don't
+use colons, which are for recording rules. */
+static std::string sanitize_name(const std::string &s) {
+    std::string res = s;
+    for (size_t i = 0; i < res.size(); ++i) {
+        const char c = res[i];
+        if (!(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z')
+              || ('0' <= c && c <= '9') || c == '_')) {
+            res[i] = '_';
+        }
+    }
+    return res;
+}
+
+static void append_label_value(const std::string &value, std::string *out) {
+    for (size_t i = 0; i < value.size(); ++i) {
+        switch (value[i]) {
+        case '\\': out->append("\\\\"); break;
+        case '"': out->append("\\\""); break;
+        case '\n': out->append("\\n"); break;
+        default: out->push_back(value[i]); break;
+        }
+    }
+}
+
+static void append_sample(const std::string &name,
+                          const perfmon_exposition_t::labels_t &labels,
+                          const char *le,
+                          const std::string &value,
+                          std::string *out) {
+    out->append(name);
+    if (!labels.empty() || le != NULL) {
+        out->push_back('{');
+        bool first = true;
+        for (auto it = labels.begin(); it != labels.end(); ++it) {
+            if (!first) {
+                out->push_back(',');
+            }
+            first = false;
+            out->append(it->first);
+            out->append("=\"");
+            append_label_value(it->second, out);
+            out->push_back('"');
+        }
+        if (le != NULL) {
+            if (!first) {
+                out->push_back(',');
+            }
+            out->append("le=\"");
+            out->append(le);
+            out->push_back('"');
+        }
+        out->push_back('}');
+    }
+    out->push_back(' ');
+    out->append(value);
+    out->push_back('\n');
+}
+
+static bool is_finite_number(const std::string &s) {
+    if (s.empty()) {
+        return false;
+    }
+    char *end;
+    const double d = strtod(s.c_str(), &end);
+    return end == s.c_str() + s.size() && isfinite(d);
+}
+
+static bool is_stripe_name(const std::string &s) {
+    static const std::string prefix = "stripe_";
+    if (s.size() <= prefix.size() || s.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    return std::all_of(s.begin() + prefix.size(), s.end(),
+                       [](char c) { return '0' <= c && c <= '9'; });
+}
+
+// The "buckets" map of a `perfmon_latency_histogram_t` result, or NULL.
+static const perfmon_result_t *get_histogram_buckets(const perfmon_result_t &map) {
+    perfmon_result_t::const_iterator it = map.get_map()->find("buckets");
+    if (it == map.cend() || !it->second->is_map()) {
+        return NULL;
+    }
+    return it->second;
+}
+
+perfmon_exposition_t::perfmon_exposition_t() { }
+
+perfmon_exposition_t::~perfmon_exposition_t() {
+    for (auto it = match_patterns.begin(); it != match_patterns.end(); ++it) {
+        delete *it;
+    }
+}
+
+bool perfmon_exposition_t::add_match_pattern(const std::string &pattern,
+                                             std::string *error_out) {
+    scoped_ptr_t<scoped_regex_t> regex(new scoped_regex_t());
+    if (!regex->compile(pattern)) {
+        *error_out = regex->get_error();
+        return false;
+    }
+    match_patterns.push_back(regex.release());
+    return true;
+}
+
+bool perfmon_exposition_t::matches(const std::string &name) const {
+    if (match_patterns.empty()) {
+        return true;
+    }
+    for (auto it = match_patterns.begin(); it != match_patterns.end(); ++it) {
+        if ((*it)->matches(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void perfmon_exposition_t::render(const perfmon_result_t &result,
+                                  const labels_t &labels,
+                                  std::string *out) const {
+    if (result.is_map()) {
+        render_map(result, metric_prefix, labels, false, true, out);
+    }
+}
+
+void perfmon_exposition_t::render_map(const perfmon_result_t &map,
+                                      const std::string &name,
+                                      const labels_t &labels,
+                                      bool in_regions,
+                                      bool at_root,
+                                      std::string *out) const {
+    for (perfmon_result_t::const_iterator it = map.cbegin(); it != map.cend(); ++it) {
+        std::string child_name = name;
+        labels_t child_labels = labels;
+        bool is_label = true;
+        if (at_root && is_uuid(it->first)) {
+            child_labels.push_back(std::make_pair("table", it->first));
+        } else if (in_regions) {
+            child_labels.push_back(std::make_pair("shard", it->first));
+        } else if (is_stripe_name(it->first)) {
+            child_labels.push_back(std::make_pair("stripe", it->first));
+        } else {
+            child_name += "_" + sanitize_name(it->first);
+            is_label = false;
+        }
+
+        const perfmon_result_t &child = *it->second;
+        if (child.is_map()) {
+            if (get_histogram_buckets(child) != NULL) {
+                render_histogram(child, child_name, child_labels, out);
+            } else {
+                render_map(child, child_name, child_labels,
+                           !is_label && it->first == "regions", false, out);
+            }
+        } else if (child.is_string() && is_finite_number(*child.get_string())
+                   && matches(child_name)) {
+            append_sample(child_name, child_labels, NULL, *child.get_string(), out);
+        }
+    }
+}
+
+void perfmon_exposition_t::render_histogram(const perfmon_result_t &histogram,
+                                            const std::string &name,
+                                            const labels_t &labels,
+                                            std::string *out) const {
+    using perfmon_latency_histogram::NUM_BUCKETS;
+    if (!matches(name)) {
+        return;
+    }
+
+    int64_t counts[NUM_BUCKETS];
+    std::fill(counts, counts + NUM_BUCKETS, 0);
+    const perfmon_result_t *buckets = get_histogram_buckets(histogram);
+    for (perfmon_result_t::const_iterator it = buckets->cbegin();
+         it != buckets->cend();
+         ++it) {
+        int bucket;
+        int64_t count;
+        if (it->second->is_string()
+            && strtoi64_strict(*it->second->get_string(), 10, &count)
+            && perfmon_latency_histogram::bucket_for_name(it->first, &bucket)) {
+            counts[bucket] += count;
+        }
+    }
+
+    // Only the buckets that have something in them, like in the results.
+    const std::string bucket_name = name + "_bucket";
+    int64_t total = 0;
+    for (int i = 0; i < NUM_BUCKETS - 1; ++i) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        total += counts[i];
+        const double upper_bound_secs =
+            perfmon_latency_histogram::bucket_upper_bound_micros(i) / static_cast<double>(MILLION);
+        append_sample(bucket_name, labels, strprintf("%.6f", upper_bound_secs).c_str(),
+                      strprintf("%" PRIi64, total), out);
+    }
+    total += counts[NUM_BUCKETS - 1];
+    const std::string total_str = strprintf("%" PRIi64, total);
+    append_sample(bucket_name, labels, "+Inf", total_str, out);
+    append_sample(name + "_count", labels, NULL, total_str, out);
+}
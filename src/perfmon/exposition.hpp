@@ -0,0 +1,57 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef PERFMON_EXPOSITION_HPP_
+#define PERFMON_EXPOSITION_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+
+class perfmon_result_t;
+class scoped_regex_t;
+
+/* `perfmon_exposition_t` writes perfmon results in the Prometheus text
+exposition format, one line per value, straight from the results: there's no
+intermediate JSON tree.
+
+The path to a value names the metric, e.g. "rethinkdb_query_routing_master_ops_in_flight",
+except for the path components that stand for one of many instances of the same
+thing, which become labels instead: a table's UUID becomes `table`, a region
+under "regions" becomes `shard`, and a serializer stripe becomes `stripe`.  That
+way the same stat for different tables or devices is the same metric.
+Latency histograms become cumulative `_bucket` series with an `le` label in
+seconds, and a `_count`.  Values that aren't numbers are left out.
+
+There are no `# TYPE` lines, because the caller writes one server's results
+after the other and so a metric's samples aren't all together. */
+class perfmon_exposition_t {
+public:
+    typedef std::vector<std::pair<std::string, std::string> > labels_t;
+
+    perfmon_exposition_t();
+    ~perfmon_exposition_t();
+
+    /* Only the metrics whose names match at least one of the patterns, which are
+    extended regular expressions, are written.  Without any patterns, they all
+    are. */
+    MUST_USE bool add_match_pattern(const std::string &pattern, std::string *error_out);
+
+    /* Appends the metrics in `result` to `out`, with `labels` on each of them. */
+    void render(const perfmon_result_t &result, const labels_t &labels,
+                std::string *out) const;
+
+private:
+    void render_map(const perfmon_result_t &map, const std::string &name,
+                    const labels_t &labels, bool in_regions, bool at_root,
+                    std::string *out) const;
+    void render_histogram(const perfmon_result_t &histogram, const std::string &name,
+                          const labels_t &labels, std::string *out) const;
+    bool matches(const std::string &name) const;
+
+    std::vector<scoped_regex_t *> match_patterns;
+
+    DISABLE_COPYING(perfmon_exposition_t);
+};
+
+#endif  // PERFMON_EXPOSITION_HPP_
@@ -1,7 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "perfmon/perfmon.hpp"
 
+#include <inttypes.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <math.h>
 #include <map>
 
@@ -30,35 +32,42 @@ bool global_full_perfmon = false;
 /* perfmon_counter_t */
 
 perfmon_counter_t::perfmon_counter_t()
-    : perfmon_perthread_t<cache_line_padded_t<int64_t>, int64_t>(),
-      thread_data(new padded_int64_t[MAX_THREADS])
+    : thread_data(new padded_int64_t[MAX_THREADS])
 {
-    for (int i = 0; i < MAX_THREADS; i++) thread_data[i].value = 0;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        thread_data[i].value.store(0, std::memory_order_relaxed);
+    }
 }
 
 perfmon_counter_t::~perfmon_counter_t() {
     delete[] thread_data;
 }
 
-int64_t &perfmon_counter_t::get() {
+void perfmon_counter_t::add(int64_t num) {
     rassert(get_thread_id().threadnum >= 0);
-    return thread_data[get_thread_id().threadnum].value;
+    std::atomic<int64_t> *counter = &thread_data[get_thread_id().threadnum].value;
+    // Nobody else writes to our counter, so this doesn't need to be a locked
+    // read-modify-write. Readers on other threads only need to see whole values.
+    counter->store(counter->load(std::memory_order_relaxed) + num,
+                   std::memory_order_relaxed);
 }
 
-void perfmon_counter_t::get_thread_stat(padded_int64_t *stat) {
-    stat->value = get();
-}
-
-int64_t perfmon_counter_t::combine_stats(const padded_int64_t *data) {
+int64_t perfmon_counter_t::get_value() const {
     int64_t value = 0;
     for (int i = 0; i < get_num_threads(); i++) {
-        value += data[i].value;
+        value += thread_data[i].value.load(std::memory_order_relaxed);
     }
     return value;
 }
 
-scoped_ptr_t<perfmon_result_t> perfmon_counter_t::output_stat(const int64_t &stat) {
-    return make_scoped<perfmon_result_t>(strprintf("%" PRIi64, stat));
+void *perfmon_counter_t::begin_stats() {
+    return NULL;
+}
+
+void perfmon_counter_t::visit_stats(void *) { }
+
+scoped_ptr_t<perfmon_result_t> perfmon_counter_t::end_stats(void *) {
+    return make_scoped<perfmon_result_t>(strprintf("%" PRIi64, get_value()));
 }
 
 /* perfmon_sampler_t */
@@ -289,6 +298,199 @@ scoped_ptr_t<perfmon_result_t> perfmon_rate_monitor_t::output_stat(const double
     return make_scoped<perfmon_result_t>(strprintf("%.8f", stat / ticks_to_secs(length)));
 }
 
+/* perfmon_latency_histogram_t */
+
+int perfmon_latency_histogram::bucket_for_duration(ticks_t ticks) {
+    const uint64_t micros = ticks / THOUSAND;
+    if (micros < static_cast<uint64_t>(SUB_BUCKETS)) {
+        return micros;
+    }
+    // The top `SUB_BUCKET_BITS + 1` bits pick the power of two and the
+    // sub-bucket in it.
+    const int msb = 63 - __builtin_clzll(micros);
+    const int bucket = (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+        + static_cast<int>((micros >> (msb - SUB_BUCKET_BITS)) - SUB_BUCKETS);
+    return std::min(bucket, NUM_BUCKETS - 1);
+}
+
+uint64_t perfmon_latency_histogram::bucket_lower_bound_micros(int bucket) {
+    rassert(bucket >= 0 && bucket < NUM_BUCKETS);
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    const int octave = bucket / SUB_BUCKETS;
+    return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << (octave - 1);
+}
+
+uint64_t perfmon_latency_histogram::bucket_upper_bound_micros(int bucket) {
+    rassert(bucket >= 0 && bucket < NUM_BUCKETS - 1);
+    if (bucket < SUB_BUCKETS) {
+        return bucket + 1;
+    }
+    return bucket_lower_bound_micros(bucket)
+        + (static_cast<uint64_t>(1) << (bucket / SUB_BUCKETS - 1));
+}
+
+bool perfmon_latency_histogram::bucket_for_name(const std::string &name,
+                                                int *bucket_out) {
+    uint64_t bound;
+    if (sscanf(name.c_str(), "under_%" SCNu64 "us", &bound) == 1 && bound > 0) {
+        *bucket_out = bucket_for_duration((bound - 1) * THOUSAND);
+        return true;
+    } else if (sscanf(name.c_str(), "over_%" SCNu64 "us", &bound) == 1) {
+        *bucket_out = NUM_BUCKETS - 1;
+        return true;
+    }
+    return false;
+}
+
+static const char *histogram_buckets = "buckets";
+
+static scoped_ptr_t<perfmon_result_t> histogram_result(
+        const perfmon_latency_histogram::stats_t &aggregated) {
+    using perfmon_latency_histogram::NUM_BUCKETS;
+
+    scoped_ptr_t<perfmon_result_t> stat = perfmon_result_t::alloc_map_result();
+    perfmon_result_t *buckets = perfmon_result_t::alloc_map_result().release();
+
+    int64_t count = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        count += aggregated.buckets[i];
+        if (aggregated.buckets[i] != 0) {
+            buckets->insert(i == NUM_BUCKETS - 1
+                            ? strprintf("over_%" PRIu64 "us",
+                                        perfmon_latency_histogram::bucket_lower_bound_micros(i))
+                            : strprintf("under_%" PRIu64 "us",
+                                        perfmon_latency_histogram::bucket_upper_bound_micros(i)),
+                            new perfmon_result_t(
+                                strprintf("%" PRIi64, aggregated.buckets[i])));
+        }
+    }
+    stat->insert(stat_count, new perfmon_result_t(strprintf("%" PRIi64, count)));
+    stat->insert(histogram_buckets, buckets);
+
+    const struct { const char *name; double fraction; } percentiles[] = {
+        { "p50", 0.5 }, { "p90", 0.9 }, { "p99", 0.99 }, { "p999", 0.999 }
+    };
+    for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); ++p) {
+        if (count == 0) {
+            stat->insert(percentiles[p].name, new perfmon_result_t(no_value));
+            continue;
+        }
+        const int64_t rank = static_cast<int64_t>(ceil(percentiles[p].fraction * count));
+        int64_t seen = 0;
+        int bucket = 0;
+        for (; bucket < NUM_BUCKETS - 1; ++bucket) {
+            seen += aggregated.buckets[bucket];
+            if (seen >= rank) {
+                break;
+            }
+        }
+        // The upper bound of the bucket, or its lower bound for the last one,
+        // which has no upper bound.
+        const double micros = bucket == NUM_BUCKETS - 1
+            ? static_cast<double>(perfmon_latency_histogram::bucket_lower_bound_micros(bucket))
+            : static_cast<double>(
+                perfmon_latency_histogram::bucket_upper_bound_micros(bucket));
+        stat->insert(percentiles[p].name,
+                     new perfmon_result_t(strprintf("%.8f", micros / MILLION)));
+    }
+
+    return stat;
+}
+
+// Adds the bucket counts of a result made by `histogram_result()` to `stats`.
+static void add_histogram_result(const perfmon_result_t &result,
+                                 perfmon_latency_histogram::stats_t *stats) {
+    if (!result.is_map()) {
+        return;
+    }
+    perfmon_result_t::const_iterator buckets = result.get_map()->find(histogram_buckets);
+    if (buckets == result.cend() || !buckets->second->is_map()) {
+        return;
+    }
+    for (perfmon_result_t::const_iterator it = buckets->second->cbegin();
+         it != buckets->second->cend();
+         ++it) {
+        int64_t count;
+        int bucket;
+        if (!it->second->is_string()
+            || !strtoi64_strict(*it->second->get_string(), 10, &count)
+            || !perfmon_latency_histogram::bucket_for_name(it->first, &bucket)) {
+            continue;
+        }
+        stats->buckets[bucket] += count;
+    }
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_latency_histogram::merge_results(
+        const std::vector<const perfmon_result_t *> &results) {
+    stats_t merged;
+    for (auto it = results.begin(); it != results.end(); ++it) {
+        add_histogram_result(**it, &merged);
+    }
+    return histogram_result(merged);
+}
+
+perfmon_latency_histogram_t::perfmon_latency_histogram_t(ticks_t _length)
+    : perfmon_perthread_t<stats_t>(), thread_data(new thread_info_t[MAX_THREADS]),
+      length(_length) {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        thread_data[i].current_interval = get_ticks() / length;
+    }
+}
+
+perfmon_latency_histogram_t::~perfmon_latency_histogram_t() {
+    delete[] thread_data;
+}
+
+void perfmon_latency_histogram_t::update(ticks_t now) {
+    int interval = now / length;
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = &thread_data[get_thread_id().threadnum];
+
+    if (thread->current_interval == interval) {
+        /* We're up to date; nothing to do */
+    } else if (thread->current_interval + 1 == interval) {
+        /* We're one step behind */
+        thread->last_stats = thread->current_stats;
+        thread->current_stats = stats_t();
+        thread->current_interval++;
+    } else {
+        /* We're more than one step behind */
+        thread->last_stats = thread->current_stats = stats_t();
+        thread->current_interval = interval;
+    }
+}
+
+void perfmon_latency_histogram_t::record(ticks_t duration) {
+    update(get_ticks());
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = &thread_data[get_thread_id().threadnum];
+    ++thread->current_stats.buckets[
+        perfmon_latency_histogram::bucket_for_duration(duration)];
+}
+
+void perfmon_latency_histogram_t::get_thread_stat(stats_t *stat) {
+    update(get_ticks());
+    rassert(get_thread_id().threadnum >= 0);
+    *stat = thread_data[get_thread_id().threadnum].last_stats;
+}
+
+perfmon_latency_histogram_t::stats_t
+perfmon_latency_histogram_t::combine_stats(const stats_t *stats) {
+    stats_t aggregated;
+    for (int i = 0; i < get_num_threads(); i++) {
+        aggregated.aggregate(stats[i]);
+    }
+    return aggregated;
+}
+
+scoped_ptr_t<perfmon_result_t>
+perfmon_latency_histogram_t::output_stat(const stats_t &aggregated) {
+    return histogram_result(aggregated);
+}
+
 perfmon_duration_sampler_t::perfmon_duration_sampler_t(ticks_t length, bool _ignore_global_full_perfmon)
     : stat(), active(), total(), recent(length, true),
       active_membership(&stat, &active, "active_count"),
@@ -9,10 +9,12 @@
 #define PERFMON_PERFMON_HPP_
 
 #include <algorithm>
+#include <atomic>
 #include <limits>
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "perfmon/types.hpp"
 #include "perfmon/core.hpp"
@@ -55,25 +57,32 @@ protected:
 /* perfmon_counter_t is a perfmon_t that keeps a global counter that can be
  * incremented and decremented. (Internally, it keeps many individual counters
  * for thread-safety.)
+ *
+ * Each thread only ever writes its own counter, and every counter is an atomic
+ * on its own cache line, so the counters can be summed from any thread.
+ * Collecting the stats therefore doesn't need to visit the other threads.
  */
-class perfmon_counter_t : public perfmon_perthread_t<cache_line_padded_t<int64_t>, int64_t> {
+class perfmon_counter_t : public perfmon_t {
     friend class perfmon_counter_step_t;
 protected:
-    typedef cache_line_padded_t<int64_t> padded_int64_t;
+    typedef cache_line_padded_t<std::atomic<int64_t> > padded_int64_t;
     padded_int64_t *thread_data;
 
-    int64_t &get();
-
-    void get_thread_stat(padded_int64_t *);
-    int64_t combine_stats(const padded_int64_t *);
-    scoped_ptr_t<perfmon_result_t> output_stat(const int64_t&);
+    void add(int64_t num);
 public:
     perfmon_counter_t();
     virtual ~perfmon_counter_t();
-    void operator++() { get()++; }
-    void operator+=(int64_t num) { get() += num; }
-    void operator--() { get()--; }
-    void operator-=(int64_t num) { get() -= num; }
+    void operator++() { add(1); }
+    void operator+=(int64_t num) { add(num); }
+    void operator--() { add(-1); }
+    void operator-=(int64_t num) { add(-num); }
+
+    /* The sum of all the threads' counters. Can be called on any thread. */
+    int64_t get_value() const;
+
+    void *begin_stats();
+    void visit_stats(void *);
+    scoped_ptr_t<perfmon_result_t> end_stats(void *);
 };
 
 /* perfmon_sampler_t is a perfmon_t that keeps a log of events that happen.
@@ -202,6 +211,83 @@ public:
     void record(double value = 1.0);
 };
 
+/* `perfmon_latency_histogram_t` records durations into log-linear buckets, in
+ * the manner of an HDR histogram: each power of two of microseconds is split
+ * into `SUB_BUCKETS` equally wide buckets, so a bucket's width is at most a
+ * quarter of its lower bound.  Durations under `SUB_BUCKETS` microseconds each
+ * get their own bucket, and the last bucket takes everything that's too long
+ * for the others.  Like `perfmon_sampler_t`, it reports the last complete
+ * interval of `length` ticks: the number of events, the bucket counts, and
+ * percentiles (as the upper bound of the bucket they fall in, in seconds).
+ * Unlike an average, that shows whether the slow events are a different
+ * population from the fast ones.
+ *
+ * Histograms merge exactly, because they all use the same buckets: the threads'
+ * ones are summed when the stats are gathered, and `merge_results()` sums the
+ * results that different servers reported.
+ */
+namespace perfmon_latency_histogram {
+
+static const int SUB_BUCKET_BITS = 2;
+static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+// Enough for durations of up to 2^26 microseconds, about a minute.
+static const int NUM_BUCKETS = (26 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+struct stats_t {
+    int64_t buckets[NUM_BUCKETS];
+    stats_t() {
+        std::fill(buckets, buckets + NUM_BUCKETS, 0);
+    }
+    void aggregate(const stats_t &s) {
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            buckets[i] += s.buckets[i];
+        }
+    }
+};
+
+// The bucket a duration of `ticks` goes to.
+int bucket_for_duration(ticks_t ticks);
+
+// The shortest duration, in microseconds, that goes to `bucket`.
+uint64_t bucket_lower_bound_micros(int bucket);
+
+// The durations that go to `bucket` are shorter than this.  The last bucket has
+// no upper bound.
+uint64_t bucket_upper_bound_micros(int bucket);
+
+// The bucket that `name`, a key of the "buckets" map in the results, stands for.
+MUST_USE bool bucket_for_name(const std::string &name, int *bucket_out);
+
+/* Sums the results of histograms with the same buckets, e.g. the ones that
+different servers reported for the same stat.  Results that aren't histogram
+results are ignored. */
+scoped_ptr_t<perfmon_result_t> merge_results(
+        const std::vector<const perfmon_result_t *> &results);
+
+}  // namespace perfmon_latency_histogram
+
+class perfmon_latency_histogram_t
+    : public perfmon_perthread_t<perfmon_latency_histogram::stats_t> {
+    typedef perfmon_latency_histogram::stats_t stats_t;
+    struct thread_info_t {
+        stats_t current_stats, last_stats;
+        int current_interval;
+    };
+
+    thread_info_t *thread_data;
+    ticks_t length;
+
+    void update(ticks_t now);
+
+    void get_thread_stat(stats_t *);
+    stats_t combine_stats(const stats_t *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const stats_t &);
+public:
+    explicit perfmon_latency_histogram_t(ticks_t length);
+    ~perfmon_latency_histogram_t();
+    void record(ticks_t duration);
+};
+
 /* perfmon_duration_sampler_t is a perfmon_t that monitors events that have a
  * starting and ending time. When something starts, call begin(); when
  * something ends, call end() with the same value as begin. It will produce
@@ -14,14 +14,20 @@
 
 #include "arch/runtime/runtime.hpp"
 #include "arch/timing.hpp"
+#include "config/args.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "concurrency/one_per_thread.hpp"
 #include "containers/archive/archive.hpp"
 #include "http/http.hpp"
 
 class auth_key_t;
 class auth_semilattice_metadata_t;
 template <class> class semilattice_readwrite_view_t;
+template <class> class vclock_t;
+class tls_ctx_t;
 
 enum protob_server_callback_mode_t {
     INLINE, //protobs that arrive will be called inline
@@ -122,25 +128,62 @@ private:
 // // Retrieves the protocol buffers object from an initialized request_t.
 // request_t::protob_type *underlying_protob_value(request_t *request);
 //
+// // In CORO_UNORDERED mode, whether the request may only start once every request
+// // that came before it on the connection has finished.
+// bool waits_for_earlier_requests(request_t *request);
+//
 // "request_t::protob_type" does not actually have to be defined.
 
 
 template <class request_t, class response_t, class context_t>
 class protob_server_t : public http_app_t {
 public:
+    // If `accept_on_all_threads` is true and the kernel supports `SO_REUSEPORT`, every
+    // db thread accepts connections on the port and serves the ones it accepted;
+    // otherwise one listener hands connections out to the db threads round-robin.
+    // If `tls_ctx` isn't NULL, connections start with a TLS handshake.
     protob_server_t(const std::set<ip_address_t> &local_addresses,
                     int port,
                     boost::function<bool(request_t, response_t *, context_t *)> _f,  // NOLINT(readability/casting)
                     response_t (*_on_unparsable_query)(request_t, std::string),
                     boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > _auth_metadata,
-                    protob_server_callback_mode_t _cb_mode = CORO_ORDERED);
+                    protob_server_callback_mode_t _cb_mode = CORO_ORDERED,
+                    bool accept_on_all_threads = false,
+                    tls_ctx_t *_tls_ctx = NULL);
     ~protob_server_t();
 
     int get_port() const;
 private:
 
     void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t);
+    // Used with `reuseport_listener`, which calls it on the thread that accepted the
+    // connection.
+    void handle_conn_on_this_thread(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn);
+    void serve_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+                    const vclock_t<auth_key_t> &auth_vclock,
+                    signal_t *keepalive);
     void send(const response_t &, tcp_conn_t *conn, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
+    // What the requests running concurrently on a connection share in
+    // CORO_UNORDERED mode.
+    struct running_requests_t {
+        running_requests_t(tcp_conn_t *_conn, context_t *_ctx, signal_t *_closer)
+            : conn(_conn), ctx(_ctx), closer(_closer),
+              semaphore(PROTOB_MAX_CONCURRENT_REQUESTS) { }
+        tcp_conn_t *const conn;
+        context_t *const ctx;
+        signal_t *const closer;
+        // Each running request holds one unit, so reading further requests waits
+        // while the limit is reached.
+        new_semaphore_t semaphore;
+        // Responses are written one at a time.
+        mutex_t send_mutex;
+        // Destroyed first, which waits for the requests.
+        auto_drainer_t drainer;
+    };
+    // Takes ownership of `acq`.
+    void handle_unordered(request_t request, new_semaphore_acq_t *acq,
+                          running_requests_t *running, auto_drainer_t::lock_t);
     static auth_key_t read_auth_key(tcp_conn_t *conn, signal_t *interruptor);
 
     // For HTTP server
@@ -153,11 +196,15 @@ private:
 
     protob_server_callback_mode_t cb_mode;
 
+    tls_ctx_t *tls_ctx;
+
     /* WARNING: The order here is fragile. */
     cond_t main_shutting_down_cond;
     signal_t *shutdown_signal() { return &shutting_down_conds[get_thread_id().threadnum]; }
     boost::ptr_vector<cross_thread_signal_t> shutting_down_conds;
     auto_drainer_t auto_drainer;
+    // Keeps connections accepted by `reuseport_listener` alive.
+    one_per_thread_t<auto_drainer_t> per_thread_drainers;
     struct pulse_on_destruct_t {
         explicit pulse_on_destruct_t(cond_t *_cond) : cond(_cond) { }
         ~pulse_on_destruct_t() { cond->pulse(); }
@@ -165,7 +212,12 @@ private:
     } pulse_sdc_on_shutdown;
     http_conn_cache_t<context_t> http_conn_cache;
 
+    // Exactly one of these is used.
     scoped_ptr_t<tcp_listener_t> tcp_listener;
+    scoped_ptr_t<reuseport_tcp_listener_t> reuseport_listener;
+
+    // `auth_metadata` can only be read on this thread.
+    const threadnum_t auth_metadata_thread;
 
     unsigned next_thread;
 };
@@ -17,6 +17,7 @@
 #include "arch/io/network.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/wait_any.hpp"
 #include "containers/auth_key.hpp"
 #include "rpc/semilattice/joins/vclock.hpp"
 #include "rpc/semilattice/view.hpp"
@@ -30,13 +31,17 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
     boost::function<bool(request_t, response_t *, context_t *)> _f,  // NOLINT(readability/casting)
     response_t (*_on_unparsable_query)(request_t, std::string),
     boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > _auth_metadata,
-    protob_server_callback_mode_t _cb_mode)
+    protob_server_callback_mode_t _cb_mode,
+    bool accept_on_all_threads,
+    tls_ctx_t *_tls_ctx)
     : f(_f),
       on_unparsable_query(_on_unparsable_query),
       auth_metadata(_auth_metadata),
       cb_mode(_cb_mode),
+      tls_ctx(_tls_ctx),
       shutting_down_conds(get_num_threads()),
       pulse_sdc_on_shutdown(&main_shutting_down_cond),
+      auth_metadata_thread(get_thread_id()),
       next_thread(0) {
 
     for (int i = 0; i < get_num_threads(); ++i) {
@@ -46,12 +51,27 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
         rassert(s == &shutting_down_conds[i]);
     }
 
+    if (accept_on_all_threads && !tcp_reuse_port_is_supported()) {
+        logWRN("Accepting client driver connections on one thread, because this "
+               "kernel doesn't support SO_REUSEPORT.");
+        accept_on_all_threads = false;
+    }
+
     try {
-        tcp_listener.init(new tcp_listener_t(
-            local_addresses,
-            port,
-            boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
-                        this, _1, auto_drainer_t::lock_t(&auto_drainer))));
+        if (accept_on_all_threads) {
+            reuseport_listener.init(new reuseport_tcp_listener_t(
+                local_addresses,
+                port,
+                get_num_db_threads(),
+                boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn_on_this_thread,
+                            this, _1)));
+        } else {
+            tcp_listener.init(new tcp_listener_t(
+                local_addresses,
+                port,
+                boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
+                            this, _1, auto_drainer_t::lock_t(&auto_drainer))));
+        }
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(strprintf("Could not bind to RDB protocol port: %s", ex.what()));
     }
@@ -61,7 +81,9 @@ protob_server_t<request_t, response_t, context_t>::~protob_server_t() { }
 
 template <class request_t, class response_t, class context_t>
 int protob_server_t<request_t, response_t, context_t>::get_port() const {
-    return tcp_listener->get_port();
+    return reuseport_listener.has()
+        ? reuseport_listener->get_port()
+        : tcp_listener->get_port();
 }
 
 struct protob_server_exc_t : public std::exception {
@@ -107,9 +129,48 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
     cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
     on_thread_t rethreader(chosen_thread);
 
+    serve_conn(nconn, auth_vclock, &ct_keepalive);
+}
+
+template <class request_t, class response_t, class context_t>
+void protob_server_t<request_t, response_t, context_t>::handle_conn_on_this_thread(
+    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    // The listener calls us before it can be destroyed, so the drainer isn't
+    // draining yet.
+    auto_drainer_t::lock_t keepalive(per_thread_drainers.get());
+
+    // The connection stays on this thread; only the auth key read goes to the home
+    // thread of `auth_metadata`.
+    vclock_t<auth_key_t> auth_vclock;
+    {
+        on_thread_t rethreader(auth_metadata_thread);
+        auth_vclock = auth_metadata->get().auth_key;
+    }
+
+    serve_conn(nconn, auth_vclock, keepalive.get_drain_signal());
+}
+
+template <class request_t, class response_t, class context_t>
+void protob_server_t<request_t, response_t, context_t>::serve_conn(
+    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+    const vclock_t<auth_key_t> &auth_vclock,
+    signal_t *keepalive) {
+    // Everything that runs on behalf of the client inherits this.
+    with_latency_class_t latency_class(LATENCY_CLASS_INTERACTIVE);
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
 
+    if (tls_ctx != NULL) {
+        signal_timer_t handshake_timeout;
+        handshake_timeout.start(TLS_HANDSHAKE_TIMEOUT_MS, COARSE_TIMER);
+        wait_any_t handshake_interruptor(&handshake_timeout, keepalive);
+        try {
+            conn->start_tls(tls_ctx, true, &handshake_interruptor);
+        } catch (const tcp_conn_read_closed_exc_t &) {
+            return;
+        }
+    }
+
 #ifdef __linux
     linux_event_watcher_t *ew = conn->get_event_watcher();
     linux_event_watcher_t::watch_t conn_interrupted(ew, poll_event_rdhup);
@@ -129,19 +190,19 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         }
 
         int32_t client_magic_number;
-        conn->read(&client_magic_number, sizeof(int32_t), &ct_keepalive);
+        conn->read(&client_magic_number, sizeof(int32_t), keepalive);
 
         if (client_magic_number == context_t::no_auth_magic_number) {
             if (!auth_vclock.get().str().empty()) {
                 throw protob_server_exc_t("authorization required, client does not support it");
             }
         } else if (client_magic_number == context_t::auth_magic_number) {
-            auth_key_t provided_auth = read_auth_key(conn.get(), &ct_keepalive);
+            auth_key_t provided_auth = read_auth_key(conn.get(), keepalive);
             if (!timing_sensitive_equals(provided_auth, auth_vclock.get())) {
                 throw protob_server_exc_t("incorrect authorization key");
             }
             const char *success_msg = "SUCCESS";
-            conn->write(success_msg, strlen(success_msg) + 1, &ct_keepalive);
+            conn->write(success_msg, strlen(success_msg) + 1, keepalive);
         } else {
             throw protob_server_exc_t("this is the rdb protocol port (bad magic number)");
         }
@@ -157,7 +218,7 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
 
     try {
         if (!init_error.empty()) {
-            conn->write(init_error.c_str(), init_error.length() + 1, &ct_keepalive);
+            conn->write(init_error.c_str(), init_error.length() + 1, keepalive);
             conn->shutdown_write();
             return;
         }
@@ -165,6 +226,10 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         return;
     }
 
+    // Destroyed before `ctx` and `conn`, after waiting for the requests still
+    // running.  The client closing the connection interrupts them.
+    running_requests_t running(conn.get(), &ctx, keepalive);
+
     //TODO figure out how to do this with less copying
     for (;;) {
         request_t request;
@@ -174,14 +239,14 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         std::string err;
         try {
             int32_t size;
-            conn->read(&size, sizeof(int32_t), &ct_keepalive);
+            conn->read(&size, sizeof(int32_t), keepalive);
             if (size < 0) {
                 err = strprintf("Negative protobuf size (%d).", size);
                 forced_response = on_unparsable_query(request_t(), err);
                 force_response = true;
             } else {
                 scoped_array_t<char> data(size);
-                conn->read(data.data(), size, &ct_keepalive);
+                conn->read(data.data(), size, keepalive);
 
                 const bool res
                     = underlying_protob_value(&request)->ParseFromArray(data.data(), size);
@@ -201,12 +266,12 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
             switch (cb_mode) {
             case INLINE:
                 if (force_response) {
-                    send(forced_response, conn.get(), &ct_keepalive);
+                    send(forced_response, conn.get(), keepalive);
                 } else {
                     response_t response;
                     bool response_needed = f(request, &response, &ctx);
                     if (response_needed) {
-                        send(response, conn.get(), &ct_keepalive);
+                        send(response, conn.get(), keepalive);
                     }
                 }
                 break;
@@ -214,7 +279,21 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
                 crash("unimplemented");
                 break;
             case CORO_UNORDERED:
-                crash("unimplemented");
+                if (force_response) {
+                    mutex_t::acq_t send_acq(&running.send_mutex);
+                    send(forced_response, conn.get(), keepalive);
+                } else {
+                    scoped_ptr_t<new_semaphore_acq_t> acq(new new_semaphore_acq_t(
+                        &running.semaphore,
+                        waits_for_earlier_requests(&request)
+                            ? running.semaphore.capacity()
+                            : 1));
+                    wait_interruptible(acq->acquisition_signal(), keepalive);
+                    coro_t::spawn_sometime(std::bind(
+                        &protob_server_t<request_t, response_t, context_t>::handle_unordered,
+                        this, request, acq.release(), &running,
+                        auto_drainer_t::lock_t(&running.drainer)));
+                }
                 break;
             default:
                 crash("unreachable");
@@ -224,6 +303,28 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
             //TODO need to figure out what blocks us up here in non inline cb
             //mode
             return;
+        } catch (const interrupted_exc_t &) {
+            return;
+        }
+    }
+}
+
+template <class request_t, class response_t, class context_t>
+void protob_server_t<request_t, response_t, context_t>::handle_unordered(
+    request_t request,
+    new_semaphore_acq_t *acq_ptr,
+    running_requests_t *running,
+    auto_drainer_t::lock_t) {
+    // Released once the response is out, so the next request may start.
+    scoped_ptr_t<new_semaphore_acq_t> acq(acq_ptr);
+    response_t response;
+    bool response_needed = f(request, &response, running->ctx);
+    if (response_needed) {
+        try {
+            mutex_t::acq_t send_acq(&running->send_mutex);
+            send(response, running->conn, running->closer);
+        } catch (const tcp_conn_write_closed_exc_t &) {
+            // The read loop notices too and stops.
         }
     }
 }
@@ -234,11 +335,17 @@ void protob_server_t<request_t, response_t, context_t>::send(
     tcp_conn_t *conn,
     signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     int size = res.ByteSize();
-    conn->write(&size, sizeof(res.ByteSize()), closer);
     scoped_array_t<char> data(size);
-
     res.SerializeToArray(data.data(), size);
-    conn->write(data.data(), size, closer);
+
+    // Small responses are coalesced with the ones to pipelined queries that finish
+    // around the same time. Big ones are sent right away without another copy.
+    conn->write_coalesced(&size, sizeof(res.ByteSize()), closer);
+    if (static_cast<size_t>(size) <= PROTOB_COALESCED_RESPONSE_MAX_SIZE) {
+        conn->write_coalesced(data.data(), size, closer);
+    } else {
+        conn->write(data.data(), size, closer);
+    }
 }
 
 // Used in protob_server_t::handle(...) below to combine the interruptor from the
@@ -328,6 +435,10 @@ void protob_server_t<request_t, response_t, context_t>::handle(const http_req_t
             response_t response;
             switch (cb_mode) {
             case INLINE:
+            case CORO_UNORDERED:
+                // An HTTP request carries one query and already runs in a coroutine
+                // of its own, and the HTTP connection runs one query at a time, so
+                // the callback is called inline in both modes.
                 {
                     boost::shared_ptr<typename http_conn_cache_t<context_t>::http_conn_t> conn =
                         http_conn_cache.find(conn_id);
@@ -368,7 +479,6 @@ void protob_server_t<request_t, response_t, context_t>::handle(const http_req_t
                 }
                 break;
             case CORO_ORDERED:
-            case CORO_UNORDERED:
                 crash("unimplemented");
             default:
                 crash("unreachable");
@@ -48,6 +48,12 @@ class namespace_interface_t {
 public:
     virtual void read(const typename protocol_t::read_t &, typename protocol_t::read_response_t *response, order_token_t tok, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) = 0;
     virtual void read_outdated(const typename protocol_t::read_t &, typename protocol_t::read_response_t *response, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) = 0;
+    /* Like `read_outdated()`, but the data may be at most `max_staleness_ms`
+    milliseconds behind the primary.  The default does an up to date read,
+    which is never stale. */
+    virtual void read_bounded_staleness(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, UNUSED int64_t max_staleness_ms, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+        read(r, response, order_token_t::ignore, interruptor);
+    }
     virtual void write(const typename protocol_t::write_t &, typename protocol_t::write_response_t *response, order_token_t tok, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) = 0;
 
     /* These calls are for the sole purpose of optimizing queries; don't rely
@@ -0,0 +1,801 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/batch_predicate.hpp"
+
+#include <math.h>
+
+#include <utility>
+
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/regex_cache.hpp"
+
+namespace ql {
+
+// One value per row. An empty entry means the row is `UNKNOWN` at this point.
+typedef std::vector<counted_t<const datum_t> > column_t;
+
+class batch_node_t {
+public:
+    virtual ~batch_node_t() { }
+
+    // Returns the node's value if it's the same for every row, and NULL otherwise.
+    virtual const counted_t<const datum_t> *constant() const { return NULL; }
+
+    // Fills `out` with the node's value for each row in `rows`.
+    virtual void eval(const column_t &rows, column_t *out) const = 0;
+};
+
+namespace {
+
+// The value of a node for every row, without making copies of a constant.
+class operand_t {
+public:
+    operand_t(const batch_node_t *node, const column_t &rows)
+        : constant(node->constant()) {
+        if (constant == NULL) {
+            node->eval(rows, &column);
+        }
+    }
+
+    const counted_t<const datum_t> &get(size_t i) const {
+        return constant != NULL ? *constant : column[i];
+    }
+
+private:
+    const counted_t<const datum_t> *constant;
+    column_t column;
+};
+
+class row_node_t : public batch_node_t {
+public:
+    void eval(const column_t &rows, column_t *out) const {
+        *out = rows;
+    }
+};
+
+class constant_node_t : public batch_node_t {
+public:
+    explicit constant_node_t(counted_t<const datum_t> &&_value)
+        : value(std::move(_value)) { }
+    const counted_t<const datum_t> *constant() const { return &value; }
+    void eval(const column_t &rows, column_t *out) const {
+        out->assign(rows.size(), value);
+    }
+private:
+    counted_t<const datum_t> value;
+};
+
+class field_node_t : public batch_node_t {
+public:
+    // `object` is NULL for a field of the row itself.
+    field_node_t(scoped_ptr_t<batch_node_t> &&_object, std::string &&_key)
+        : object(std::move(_object)), key(std::move(_key)) { }
+
+    void eval(const column_t &rows, column_t *out) const {
+        column_t objects;
+        if (object.has()) {
+            object->eval(rows, &objects);
+        }
+        const column_t &src = object.has() ? objects : rows;
+        out->resize(src.size());
+        for (size_t i = 0; i < src.size(); ++i) {
+            // Fields of sequences and missing fields are left to the interpreter.
+            if (src[i].has() && src[i]->get_type() == datum_t::R_OBJECT) {
+                (*out)[i] = src[i]->get(key, NOTHROW);
+            } else {
+                (*out)[i].reset();
+            }
+        }
+    }
+
+private:
+    scoped_ptr_t<batch_node_t> object;
+    std::string key;
+};
+
+class bool_node_t : public batch_node_t {
+protected:
+    bool_node_t()
+        : true_datum(make_counted<const datum_t>(datum_t::R_BOOL, true)),
+          false_datum(make_counted<const datum_t>(datum_t::R_BOOL, false)) { }
+
+    const counted_t<const datum_t> &boolean(bool b) const {
+        return b ? true_datum : false_datum;
+    }
+
+private:
+    counted_t<const datum_t> true_datum, false_datum;
+};
+
+// EQ, NE, LT, LE, GT and GE, with the same chaining as `predicate_term_t`.
+class compare_node_t : public bool_node_t {
+public:
+    compare_node_t(Term::TermType _type, std::vector<scoped_ptr_t<batch_node_t> > &&_args)
+        : type(_type), args(std::move(_args)) { }
+
+    void eval(const column_t &rows, column_t *out) const {
+        std::vector<operand_t> operands;
+        operands.reserve(args.size());
+        for (size_t j = 0; j < args.size(); ++j) {
+            operands.push_back(operand_t(args[j].get(), rows));
+        }
+
+        out->resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            (*out)[i].reset();
+            try {
+                bool result = true;
+                bool known = operands[0].get(i).has();
+                for (size_t j = 1; known && j < operands.size(); ++j) {
+                    const counted_t<const datum_t> &lhs = operands[j - 1].get(i);
+                    const counted_t<const datum_t> &rhs = operands[j].get(i);
+                    if (!rhs.has()) {
+                        known = false;
+                    } else if (!compare(*lhs, *rhs)) {
+                        result = false;
+                        break;
+                    }
+                }
+                if (known) {
+                    (*out)[i] = boolean(type == Term::NE ? !result : result);
+                }
+            } catch (const base_exc_t &) {
+                // E.g. comparing malformed pseudotypes; the interpreter will
+                // produce the error.
+            }
+        }
+    }
+
+private:
+    bool compare(const datum_t &lhs, const datum_t &rhs) const {
+        // Not switches: the term types we don't handle would all need cases.
+        if (type == Term::EQ || type == Term::NE) {
+            return lhs == rhs;
+        } else if (type == Term::LT) {
+            return lhs < rhs;
+        } else if (type == Term::LE) {
+            return lhs <= rhs;
+        } else if (type == Term::GT) {
+            return lhs > rhs;
+        } else if (type == Term::GE) {
+            return lhs >= rhs;
+        } else {
+            unreachable();
+        }
+    }
+
+    const Term::TermType type;
+    std::vector<scoped_ptr_t<batch_node_t> > args;
+};
+
+class not_node_t : public bool_node_t {
+public:
+    explicit not_node_t(scoped_ptr_t<batch_node_t> &&_arg) : arg(std::move(_arg)) { }
+
+    void eval(const column_t &rows, column_t *out) const {
+        operand_t operand(arg.get(), rows);
+        out->resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const counted_t<const datum_t> &value = operand.get(i);
+            if (value.has()) {
+                (*out)[i] = boolean(!value->as_bool());
+            } else {
+                (*out)[i].reset();
+            }
+        }
+    }
+
+private:
+    scoped_ptr_t<batch_node_t> arg;
+};
+
+// ALL and ANY.  Like `all_term_t` and `any_term_t`, they short-circuit, so a row
+// whose later arguments are unknown can still be decided.
+class all_any_node_t : public bool_node_t {
+public:
+    all_any_node_t(bool _is_all, std::vector<scoped_ptr_t<batch_node_t> > &&_args)
+        : is_all(_is_all), args(std::move(_args)) { }
+
+    void eval(const column_t &rows, column_t *out) const {
+        std::vector<operand_t> operands;
+        operands.reserve(args.size());
+        for (size_t j = 0; j < args.size(); ++j) {
+            operands.push_back(operand_t(args[j].get(), rows));
+        }
+
+        out->resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            (*out)[i].reset();
+            for (size_t j = 0; j < operands.size(); ++j) {
+                const counted_t<const datum_t> &value = operands[j].get(i);
+                if (!value.has()) {
+                    break;
+                }
+                if (is_all && (!value->as_bool() || j == operands.size() - 1)) {
+                    (*out)[i] = value;
+                    break;
+                }
+                if (!is_all && value->as_bool()) {
+                    (*out)[i] = value;
+                    break;
+                }
+                if (!is_all && j == operands.size() - 1) {
+                    (*out)[i] = boolean(false);
+                }
+            }
+        }
+    }
+
+private:
+    const bool is_all;
+    std::vector<scoped_ptr_t<batch_node_t> > args;
+};
+
+// ADD, SUB, MUL and DIV, on numbers only.  Strings, arrays and times are left to
+// the interpreter, as are divisions by zero and non-finite results.
+class arith_node_t : public batch_node_t {
+public:
+    arith_node_t(Term::TermType _type, std::vector<scoped_ptr_t<batch_node_t> > &&_args)
+        : type(_type), args(std::move(_args)) { }
+
+    void eval(const column_t &rows, column_t *out) const {
+        std::vector<operand_t> operands;
+        operands.reserve(args.size());
+        for (size_t j = 0; j < args.size(); ++j) {
+            operands.push_back(operand_t(args[j].get(), rows));
+        }
+
+        out->resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            (*out)[i].reset();
+            const counted_t<const datum_t> &first = operands[0].get(i);
+            if (!first.has() || first->get_type() != datum_t::R_NUM) {
+                continue;
+            }
+            if (operands.size() == 1) {
+                (*out)[i] = first;
+                continue;
+            }
+            double acc = first->as_num();
+            bool known = true;
+            for (size_t j = 1; known && j < operands.size(); ++j) {
+                const counted_t<const datum_t> &value = operands[j].get(i);
+                if (!value.has() || value->get_type() != datum_t::R_NUM) {
+                    known = false;
+                } else {
+                    known = apply(value->as_num(), &acc);
+                }
+            }
+            // so we can use `isfinite` in a GCC 4.4.3-compatible way
+            using namespace std;  // NOLINT(build/namespaces)
+            if (known && isfinite(acc)) {
+                (*out)[i] = make_counted<const datum_t>(acc);
+            }
+        }
+    }
+
+private:
+    bool apply(double rhs, double *acc) const {
+        if (type == Term::ADD) {
+            *acc += rhs;
+        } else if (type == Term::SUB) {
+            *acc -= rhs;
+        } else if (type == Term::MUL) {
+            *acc *= rhs;
+        } else if (type == Term::DIV) {
+            if (rhs == 0) {
+                return false;
+            }
+            *acc /= rhs;
+        } else {
+            unreachable();
+        }
+        return true;
+    }
+
+    const Term::TermType type;
+    std::vector<scoped_ptr_t<batch_node_t> > args;
+};
+
+// MATCH with a constant pattern, compiled once for all rows.  It only says whether
+// each row matches, which is all a filter needs to know; that's why it's only
+// compiled where just the truth of its value matters.  Values other than strings
+// are left to the interpreter, which fails on them.
+class match_node_t : public bool_node_t {
+public:
+    match_node_t(scoped_ptr_t<batch_node_t> &&_arg,
+                 counted_t<const compiled_regex_t> &&_regex)
+        : arg(std::move(_arg)), regex(std::move(_regex)) { }
+
+    void eval(const column_t &rows, column_t *out) const {
+        operand_t operand(arg.get(), rows);
+        out->resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const counted_t<const datum_t> &value = operand.get(i);
+            if (value.has() && value->get_type() == datum_t::R_STR) {
+                const wire_string_t &str = value->as_str();
+                (*out)[i] = boolean(RE2::PartialMatch(
+                    re2::StringPiece(str.data(), str.size()), regex->get()));
+            } else {
+                (*out)[i].reset();
+            }
+        }
+    }
+
+private:
+    scoped_ptr_t<batch_node_t> arg;
+    counted_t<const compiled_regex_t> regex;
+};
+
+}  // namespace
+
+batch_predicate_t::batch_predicate_t() : reads_whole_row(false) { }
+
+batch_predicate_t::~batch_predicate_t() { }
+
+void batch_predicate_t::evaluate(const std::vector<counted_t<const datum_t> > &rows,
+                                 std::vector<result_t> *results_out) const {
+    column_t values;
+    root->eval(rows, &values);
+    results_out->resize(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (!values[i].has()) {
+            (*results_out)[i] = UNKNOWN;
+        } else {
+            (*results_out)[i] = values[i]->as_bool() ? PASS : FAIL;
+        }
+    }
+}
+
+bool batch_predicate_t::get_row_field_equality(
+        std::string *field_out, counted_t<const datum_t> *value_out) const {
+    if (!equality_value.has()) {
+        return false;
+    }
+    *field_out = equality_field;
+    *value_out = equality_value;
+    return true;
+}
+
+bool batch_predicate_t::get_row_field_range(row_field_range_t *range_out) const {
+    if (!range_left.has()) {
+        return false;
+    }
+    range_out->field = range_field;
+    range_out->left = range_left;
+    range_out->left_bound = range_left_bound;
+    range_out->right = range_right;
+    range_out->right_bound = range_right_bound;
+    return true;
+}
+
+// Returns true if `term` is `VAR` referencing `var`.
+static bool is_var(const Term &term, sym_t var) {
+    return term.type() == Term::VAR
+        && term.args_size() == 1
+        && term.args(0).type() == Term::DATUM
+        && term.args(0).datum().type() == Datum::R_NUM
+        && term.args(0).datum().r_num() == static_cast<double>(var.value);
+}
+
+// Returns true if `term` is a constant string, and sets `str_out` to it.
+static bool is_str_datum(const Term &term, std::string *str_out) {
+    if (term.type() != Term::DATUM || term.optargs_size() != 0
+        || term.datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *str_out = term.datum().r_str();
+    return true;
+}
+
+// Returns true if `term` is `var(field)` for a constant `field`, and sets
+// `field_out` to it.
+static bool is_var_field(const Term &term, sym_t var, std::string *field_out) {
+    return term.type() == Term::GET_FIELD
+        && term.args_size() == 2
+        && term.optargs_size() == 0
+        && is_var(term.args(0), var)
+        && is_str_datum(term.args(1), field_out);
+}
+
+// Returns true if `term` is `var(field) OP value` or `value OP var(field)` for a
+// constant `field` and `value`, where `OP` is `<`, `<=`, `>` or `>=`.  `op_out` is
+// set to the comparison with the field on the left.
+static bool is_var_field_comparison(const Term &term, sym_t var,
+                                    std::string *field_out, Term::TermType *op_out,
+                                    const Datum **value_out) {
+    Term::TermType op = term.type();
+    if ((op != Term::LT && op != Term::LE && op != Term::GT && op != Term::GE)
+        || term.args_size() != 2 || term.optargs_size() != 0) {
+        return false;
+    }
+    for (int i = 0; i < 2; ++i) {
+        const Term &value = term.args(1 - i);
+        if (is_var_field(term.args(i), var, field_out) && value.type() == Term::DATUM) {
+            if (i == 1) {
+                if (op == Term::LT) {
+                    op = Term::GT;
+                } else if (op == Term::LE) {
+                    op = Term::GE;
+                } else if (op == Term::GT) {
+                    op = Term::LT;
+                } else {
+                    op = Term::LE;
+                }
+            }
+            *op_out = op;
+            *value_out = &value.datum();
+            return true;
+        }
+    }
+    return false;
+}
+
+class batch_predicate_compiler_t : public func_visitor_t {
+public:
+    batch_predicate_compiler_t() { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        row_var = reql_func->arg_names[0];
+
+        protob_t<const Term> body = reql_func->body->get_src();
+        // A constant object as the body means `filter_match`, which we leave to the
+        // interpreter.
+        if (body->type() == Term::DATUM) {
+            return;
+        }
+
+        scoped_ptr_t<batch_predicate_t> predicate(new batch_predicate_t());
+        predicate->root = compile(*body, predicate.get(), true);
+        if (!predicate->root.has()) {
+            return;
+        }
+        if (body->type() == Term::EQ && body->args_size() == 2) {
+            for (int i = 0; i < 2; ++i) {
+                const Term &field = body->args(i);
+                const Term &value = body->args(1 - i);
+                if (field.type() == Term::GET_FIELD && is_row_var(field.args(0))
+                    && value.type() == Term::DATUM) {
+                    predicate->equality_field = field.args(1).datum().r_str();
+                    predicate->equality_value = make_counted<const datum_t>(
+                        &value.datum());
+                    break;
+                }
+            }
+        }
+        if (predicate->equality_value.has()) {
+            predicate->range_field = predicate->equality_field;
+            predicate->range_left = predicate->range_right = predicate->equality_value;
+            predicate->range_left_bound = key_range_t::closed;
+            predicate->range_right_bound = key_range_t::closed;
+        } else if (body->type() == Term::ALL && body->args_size() == 2) {
+            find_range(*body, predicate.get());
+        } else if (body->type() == Term::MATCH) {
+            find_prefix_range(*body, predicate.get());
+        }
+        result = std::move(predicate);
+    }
+
+    void on_js_func(UNUSED const js_func_t *js_func) { }
+
+    scoped_ptr_t<batch_predicate_t> result;
+
+private:
+    // Returns an empty pointer if `term` can't be compiled.  `truth_only` is set
+    // if only the truth of the term's value matters, not the value itself.
+    scoped_ptr_t<batch_node_t> compile(const Term &term, batch_predicate_t *predicate,
+                                       bool truth_only = false) {
+        if (term.optargs_size() != 0) {
+            return scoped_ptr_t<batch_node_t>();
+        }
+
+        const Term::TermType type = term.type();
+        if (type == Term::DATUM) {
+            try {
+                counted_t<const datum_t> value
+                    = make_counted<const datum_t>(&term.datum());
+                return scoped_ptr_t<batch_node_t>(
+                    new constant_node_t(std::move(value)));
+            } catch (const base_exc_t &) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+        }
+        if (type == Term::VAR) {
+            if (is_row_var(term)) {
+                predicate->reads_whole_row = true;
+                return scoped_ptr_t<batch_node_t>(new row_node_t());
+            }
+            return scoped_ptr_t<batch_node_t>();
+        }
+        if (type == Term::GET_FIELD) {
+            std::string key;
+            if (term.args_size() != 2 || !is_str_datum(term.args(1), &key)) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            if (is_row_var(term.args(0))) {
+                predicate->row_fields.insert(key);
+                return scoped_ptr_t<batch_node_t>(
+                    new field_node_t(scoped_ptr_t<batch_node_t>(), std::move(key)));
+            }
+            scoped_ptr_t<batch_node_t> object = compile(term.args(0), predicate);
+            if (!object.has()) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            return scoped_ptr_t<batch_node_t>(
+                new field_node_t(std::move(object), std::move(key)));
+        }
+        if (type == Term::EQ
+            || type == Term::NE
+            || type == Term::LT
+            || type == Term::LE
+            || type == Term::GT
+            || type == Term::GE) {
+            std::vector<scoped_ptr_t<batch_node_t> > args;
+            if (term.args_size() < 2 || !compile_args(term, predicate, &args)) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            return scoped_ptr_t<batch_node_t>(
+                new compare_node_t(term.type(), std::move(args)));
+        }
+        if (type == Term::NOT) {
+            if (term.args_size() != 1) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            scoped_ptr_t<batch_node_t> arg = compile(term.args(0), predicate, true);
+            if (!arg.has()) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            return scoped_ptr_t<batch_node_t>(new not_node_t(std::move(arg)));
+        }
+        if (type == Term::ALL || type == Term::ANY) {
+            // Their value is one of their arguments'.
+            std::vector<scoped_ptr_t<batch_node_t> > args;
+            if (term.args_size() < 1
+                || !compile_args(term, predicate, &args, truth_only)) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            return scoped_ptr_t<batch_node_t>(
+                new all_any_node_t(term.type() == Term::ALL, std::move(args)));
+        }
+        if (type == Term::ADD
+            || type == Term::SUB
+            || type == Term::MUL
+            || type == Term::DIV) {
+            std::vector<scoped_ptr_t<batch_node_t> > args;
+            if (term.args_size() < 1 || !compile_args(term, predicate, &args)) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            return scoped_ptr_t<batch_node_t>(
+                new arith_node_t(term.type(), std::move(args)));
+        }
+        if (type == Term::MATCH) {
+            std::string pattern;
+            if (!truth_only || term.args_size() != 2
+                || !is_str_datum(term.args(1), &pattern)) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            counted_t<const compiled_regex_t> regex = get_compiled_regex(pattern);
+            if (!regex->get().ok()) {
+                // The interpreter reports the error.
+                return scoped_ptr_t<batch_node_t>();
+            }
+            scoped_ptr_t<batch_node_t> arg = compile(term.args(0), predicate);
+            if (!arg.has()) {
+                return scoped_ptr_t<batch_node_t>();
+            }
+            return scoped_ptr_t<batch_node_t>(
+                new match_node_t(std::move(arg), std::move(regex)));
+        }
+        return scoped_ptr_t<batch_node_t>();
+    }
+
+    bool compile_args(const Term &term, batch_predicate_t *predicate,
+                      std::vector<scoped_ptr_t<batch_node_t> > *args_out,
+                      bool truth_only = false) {
+        args_out->reserve(term.args_size());
+        for (int i = 0; i < term.args_size(); ++i) {
+            args_out->push_back(compile(term.args(i), predicate, truth_only));
+            if (!args_out->back().has()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool is_row_var(const Term &term) const {
+        return is_var(term, row_var);
+    }
+
+    // Sets the predicate's range if `all` bounds one field from below and above.
+    void find_range(const Term &all, batch_predicate_t *predicate) {
+        std::string fields[2];
+        Term::TermType ops[2];
+        const Datum *values[2];
+        for (int i = 0; i < 2; ++i) {
+            if (!is_var_field_comparison(all.args(i), row_var,
+                                         &fields[i], &ops[i], &values[i])) {
+                return;
+            }
+        }
+        if (fields[0] != fields[1]) {
+            return;
+        }
+        // Put the lower bound first.
+        const bool lower_first = ops[0] == Term::GT || ops[0] == Term::GE;
+        const int lower = lower_first ? 0 : 1;
+        const int upper = 1 - lower;
+        if (!(ops[lower] == Term::GT || ops[lower] == Term::GE)
+            || !(ops[upper] == Term::LT || ops[upper] == Term::LE)) {
+            return;
+        }
+        try {
+            predicate->range_left = make_counted<const datum_t>(values[lower]);
+            predicate->range_right = make_counted<const datum_t>(values[upper]);
+        } catch (const base_exc_t &) {
+            predicate->range_left.reset();
+            predicate->range_right.reset();
+            return;
+        }
+        predicate->range_field = fields[0];
+        predicate->range_left_bound
+            = ops[lower] == Term::GE ? key_range_t::closed : key_range_t::open;
+        predicate->range_right_bound
+            = ops[upper] == Term::LE ? key_range_t::closed : key_range_t::open;
+    }
+
+    // Sets the predicate's range if `match` is `row(field).match(pattern)` for a
+    // pattern that only matches strings with a given prefix: the range is then
+    // from the prefix up to the prefix with its last character incremented.
+    void find_prefix_range(const Term &match, batch_predicate_t *predicate) {
+        std::string field, pattern, prefix;
+        if (match.args_size() != 2 || match.optargs_size() != 0
+            || !is_var_field(match.args(0), row_var, &field)
+            || !is_str_datum(match.args(1), &pattern)
+            || !get_regex_prefix(pattern, &prefix)) {
+            return;
+        }
+        std::string next = prefix;
+        ++next[next.size() - 1];
+        predicate->range_field = field;
+        predicate->range_left = make_counted<const datum_t>(std::move(prefix));
+        predicate->range_left_bound = key_range_t::closed;
+        predicate->range_right = make_counted<const datum_t>(std::move(next));
+        predicate->range_right_bound = key_range_t::open;
+    }
+
+    sym_t row_var;
+
+    DISABLE_COPYING(batch_predicate_compiler_t);
+};
+
+scoped_ptr_t<batch_predicate_t> compile_batch_predicate(const counted_t<func_t> &f) {
+    batch_predicate_compiler_t compiler;
+    f->visit(&compiler);
+    return std::move(compiler.result);
+}
+
+class row_projection_visitor_t : public func_visitor_t {
+public:
+    explicit row_projection_visitor_t(std::set<std::string> *_fields_out)
+        : fields_out(_fields_out), is_projection(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        protob_t<const Term> body = reql_func->body->get_src();
+        if (body->type() != Term::PLUCK || body->args_size() < 2
+            || !is_var(body->args(0), reql_func->arg_names[0])) {
+            return;
+        }
+        // `pluck` on a sequence maps itself over the elements with
+        // `_NO_RECURSE_` set; any other optarg changes its meaning.
+        for (int i = 0; i < body->optargs_size(); ++i) {
+            if (body->optargs(i).key() != "_NO_RECURSE_") {
+                return;
+            }
+        }
+        std::set<std::string> fields;
+        for (int i = 1; i < body->args_size(); ++i) {
+            std::string field;
+            if (!is_str_datum(body->args(i), &field)) {
+                return;
+            }
+            fields.insert(field);
+        }
+        fields_out->swap(fields);
+        is_projection = true;
+    }
+
+    void on_js_func(UNUSED const js_func_t *js_func) { }
+
+    std::set<std::string> *const fields_out;
+    bool is_projection;
+
+private:
+    DISABLE_COPYING(row_projection_visitor_t);
+};
+
+bool get_row_projection(const counted_t<func_t> &f, std::set<std::string> *fields_out) {
+    row_projection_visitor_t visitor(fields_out);
+    f->visit(&visitor);
+    return visitor.is_projection;
+}
+
+class join_equality_visitor_t : public func_visitor_t {
+public:
+    join_equality_visitor_t(std::string *_left_field_out,
+                            std::string *_right_field_out)
+        : left_field_out(_left_field_out), right_field_out(_right_field_out),
+          is_equality(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 2) {
+            return;
+        }
+        sym_t left = reql_func->arg_names[0];
+        sym_t right = reql_func->arg_names[1];
+        protob_t<const Term> body = reql_func->body->get_src();
+        if (body->type() != Term::EQ || body->args_size() != 2
+            || body->optargs_size() != 0) {
+            return;
+        }
+        std::string left_field, right_field;
+        if ((is_var_field(body->args(0), left, &left_field)
+             && is_var_field(body->args(1), right, &right_field))
+            || (is_var_field(body->args(0), right, &right_field)
+                && is_var_field(body->args(1), left, &left_field))) {
+            *left_field_out = left_field;
+            *right_field_out = right_field;
+            is_equality = true;
+        }
+    }
+
+    void on_js_func(UNUSED const js_func_t *js_func) { }
+
+    std::string *const left_field_out;
+    std::string *const right_field_out;
+    bool is_equality;
+
+private:
+    DISABLE_COPYING(join_equality_visitor_t);
+};
+
+bool get_join_equality(const counted_t<func_t> &f,
+                       std::string *left_field_out, std::string *right_field_out) {
+    join_equality_visitor_t visitor(left_field_out, right_field_out);
+    f->visit(&visitor);
+    return visitor.is_equality;
+}
+
+class row_field_visitor_t : public func_visitor_t {
+public:
+    explicit row_field_visitor_t(std::string *_field_out)
+        : field_out(_field_out), is_row_field(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        protob_t<const Term> body = reql_func->body->get_src();
+        is_row_field = is_var_field(*body, reql_func->arg_names[0], field_out);
+    }
+
+    void on_js_func(UNUSED const js_func_t *js_func) { }
+
+    std::string *const field_out;
+    bool is_row_field;
+
+private:
+    DISABLE_COPYING(row_field_visitor_t);
+};
+
+bool get_row_field(const counted_t<func_t> &f, std::string *field_out) {
+    row_field_visitor_t visitor(field_out);
+    f->visit(&visitor);
+    return visitor.is_row_field;
+}
+
+}  // namespace ql
@@ -0,0 +1,108 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_BATCH_PREDICATE_HPP_
+#define RDB_PROTOCOL_BATCH_PREDICATE_HPP_
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+class batch_node_t;
+class func_t;
+
+/* A `batch_predicate_t` is a `filter` function compiled into a tree of kernels that
+each work on a whole batch of rows at once: a field access produces the column of
+that field's values, a comparison turns two columns into a column of booleans, and
+so on. That skips the `term_t`/`val_t` machinery per row.
+
+Only simple functions can be compiled (see `compile_batch_predicate`). Even then,
+rows for which the kernels hit an error or a case they don't implement (a missing
+field, a comparison involving a malformed pseudotype, adding strings, ...) come out
+`UNKNOWN`, and the caller has to run the function through the interpreter for
+them. That way errors and `default` are handled in exactly one place. */
+class batch_predicate_t {
+public:
+    enum result_t { FAIL = 0, PASS = 1, UNKNOWN = 2 };
+
+    ~batch_predicate_t();
+
+    void evaluate(const std::vector<counted_t<const datum_t> > &rows,
+                  std::vector<result_t> *results_out) const;
+
+    // True if the predicate only looks at the row through `get_row_fields()`. Then
+    // evaluating it on an object with only those fields of a row gives the same
+    // result as evaluating it on the whole row.
+    bool reads_only_row_fields() const { return !reads_whole_row; }
+    const std::set<std::string> &get_row_fields() const { return row_fields; }
+
+    // Returns true if the predicate is just `row(field) == value` for a constant
+    // `value`, in either order.
+    bool get_row_field_equality(std::string *field_out,
+                                counted_t<const datum_t> *value_out) const;
+
+    // The values of one field that a predicate accepts.
+    struct row_field_range_t {
+        std::string field;
+        counted_t<const datum_t> left, right;
+        key_range_t::bound_t left_bound, right_bound;
+    };
+
+    // Returns true if the predicate is just an equality as above, or
+    // `r.all(row(field) > left, row(field) < right)` for constant `left` and
+    // `right`, with `>=` and `<=` allowed as well and either comparison first, or
+    // `row(field).match(pattern)` for a constant pattern that only matches strings
+    // starting with a literal prefix (see `get_regex_prefix`).
+    bool get_row_field_range(row_field_range_t *range_out) const;
+
+private:
+    friend class batch_predicate_compiler_t;
+    batch_predicate_t();
+
+    scoped_ptr_t<batch_node_t> root;
+    std::set<std::string> row_fields;
+    bool reads_whole_row;
+
+    // Set if the predicate is an equality as described above.
+    std::string equality_field;
+    counted_t<const datum_t> equality_value;
+
+    // Set if the predicate is a range as described above.
+    std::string range_field;
+    counted_t<const datum_t> range_left, range_right;
+    key_range_t::bound_t range_left_bound, range_right_bound;
+
+    DISABLE_COPYING(batch_predicate_t);
+};
+
+// Returns an empty pointer unless `f` is a one-argument ReQL function whose body
+// only uses constants, `GET_FIELD`, comparisons, `NOT`, `ALL`, `ANY`,
+// arithmetic, and `MATCH` with a constant pattern whose result is only tested for
+// truth, and doesn't reference captured variables.
+scoped_ptr_t<batch_predicate_t> compile_batch_predicate(const counted_t<func_t> &f);
+
+// Returns true if `f` is a one-argument ReQL function that plucks constant top-level
+// fields from its argument, as `pluck` on a sequence produces. Then `fields_out` is
+// set to those fields, and `f` gives the same result on an object with only those
+// fields of a row as on the whole row.
+bool get_row_projection(const counted_t<func_t> &f, std::set<std::string> *fields_out);
+
+// Returns true if `f` is a one-argument ReQL function that returns the constant
+// top-level field `field_out` of its argument, like the function of a secondary
+// index created with just a field name.
+bool get_row_field(const counted_t<func_t> &f, std::string *field_out);
+
+// Returns true if `f` is a two-argument ReQL function of the form
+// `left(left_field) == right(right_field)` for constant field names, as used for
+// `inner_join` and `outer_join`.
+bool get_join_equality(const counted_t<func_t> &f,
+                       std::string *left_field_out, std::string *right_field_out);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_BATCH_PREDICATE_HPP_
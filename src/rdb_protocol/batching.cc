@@ -23,7 +23,8 @@ batchspec_t::batchspec_t(
 }
 
 batchspec_t batchspec_t::user(batch_type_t batch_type,
-                              const counted_t<const datum_t> &conf) {
+                              const counted_t<const datum_t> &conf,
+                              int64_t default_max_size) {
     counted_t<const datum_t> max_els_d, max_size_d, max_dur_d;
     if (conf.has()) {
         max_els_d = conf->get("max_els", NOTHROW);
@@ -35,7 +36,7 @@ batchspec_t batchspec_t::user(batch_type_t batch_type,
         max_els_d.has()
             ? max_els_d->as_int()
             : std::numeric_limits<decltype(batchspec_t().els_left)>::max(),
-        max_size_d.has() ? max_size_d->as_int() : MEGABYTE / 4,
+        max_size_d.has() ? max_size_d->as_int() : default_max_size,
         (batch_type == batch_type_t::NORMAL)
             ? current_microtime() + (max_dur_d.has() ? max_dur_d->as_int() : 500 * 1000)
             : std::numeric_limits<decltype(batchspec_t().end_time)>::max());
@@ -48,11 +49,13 @@ batchspec_t batchspec_t::all() {
                        std::numeric_limits<decltype(batchspec_t().end_time)>::max());
 }
 
-batchspec_t batchspec_t::user(batch_type_t batch_type, env_t *env) {
+batchspec_t batchspec_t::user(batch_type_t batch_type, env_t *env,
+                              int64_t default_max_size) {
     counted_t<val_t> vconf = env->global_optargs.get_optarg(env, "batch_conf");
     return user(
         batch_type,
-        vconf.has() ? vconf->as_datum() : counted_t<const datum_t>());
+        vconf.has() ? vconf->as_datum() : counted_t<const datum_t>(),
+        default_max_size);
 }
 
 batchspec_t batchspec_t::with_new_batch_type(batch_type_t new_batch_type) const {
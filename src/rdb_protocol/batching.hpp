@@ -3,6 +3,7 @@
 #define RDB_PROTOCOL_BATCHING_HPP_
 
 #include "utils.hpp"
+#include "config/args.hpp"
 #include "rpc/serialize_macros.hpp"
 
 template<class T>
@@ -57,9 +58,12 @@ private:
 
 class batchspec_t {
 public:
+    // `default_max_size` is the size cap used unless `conf` sets `max_size`.
     static batchspec_t user(batch_type_t batch_type,
-                            const counted_t<const datum_t> &conf);
-    static batchspec_t user(batch_type_t batch_type, env_t *env);
+                            const counted_t<const datum_t> &conf,
+                            int64_t default_max_size = DEFAULT_MAX_SIZE);
+    static batchspec_t user(batch_type_t batch_type, env_t *env,
+                            int64_t default_max_size = DEFAULT_MAX_SIZE);
     static batchspec_t all(); // Gimme everything.
     static batchspec_t empty() { return batchspec_t(); }
     batch_type_t get_batch_type() const { return batch_type; }
@@ -68,6 +72,8 @@ public:
     batchspec_t scale_down(int64_t divisor) const;
     batcher_t to_batcher() const;
     RDB_MAKE_ME_SERIALIZABLE_4(batch_type, els_left, size_left, end_time);
+
+    static const int64_t DEFAULT_MAX_SIZE = MEGABYTE / 4;
 private:
     // I made this private and accessible through a static function because it
     // was being accidentally default-initialized.
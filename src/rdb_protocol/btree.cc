@@ -1,6 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
+#include <deque>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -11,10 +14,12 @@
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
+#include "concurrency/background_governor.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/scoped.hpp"
+#include "rdb_protocol/batch_predicate.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
@@ -75,6 +80,7 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
     keyvalue_location_t<rdb_value_t> kv_location;
     find_keyvalue_location_for_read(superblock, store_key.btree_key(), &kv_location,
                                     &slice->stats, trace);
+    profile::count_rows_read(trace, 1);
 
     if (!kv_location.value.has()) {
         response->data.reset(new ql::datum_t(ql::datum_t::R_NULL));
@@ -84,6 +90,31 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
     }
 }
 
+void rdb_get_batch(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                   superblock_t *superblock,
+                   std::vector<counted_t<const ql::datum_t> > *rows_out,
+                   profile::trace_t *trace) {
+    std::vector<const btree_key_t *> btree_keys;
+    btree_keys.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        btree_keys.push_back(it->btree_key());
+    }
+    rows_out->clear();
+    rows_out->resize(keys.size());
+    find_keyvalue_locations_for_read<rdb_value_t>(
+        superblock, btree_keys,
+        [&](size_t i, keyvalue_location_t<rdb_value_t> *kv_location) {
+            if (!kv_location->value.has()) {
+                (*rows_out)[i].reset(new ql::datum_t(ql::datum_t::R_NULL));
+            } else {
+                (*rows_out)[i] = get_data(kv_location->value.get(),
+                                          buf_parent_t(&kv_location->buf));
+            }
+        },
+        &slice->stats, trace);
+    profile::count_rows_read(trace, keys.size());
+}
+
 void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
                         const store_key_t &key,
                         repli_timestamp_t timestamp,
@@ -123,7 +154,9 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
     const block_size_t block_size = kv_location->buf.cache()->get_block_size();
     {
         blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
-        serialize_onto_blob(buf_parent_t(&kv_location->buf), &blob, data);
+        write_message_t wm;
+        ql::serialize_row(&wm, data);
+        write_onto_blob(buf_parent_t(&kv_location->buf), &blob, wm);
     }
 
     if (mod_info_out) {
@@ -150,6 +183,84 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                           expired_t::NO, &null_cb);
 }
 
+// Replaces the row at *kv_location with `data` by writing over the bytes of its blob
+// that changed, if the blob has blocks of its own and `data` serializes to as many
+// bytes as it holds.  Then only the blob's leaf blocks with changes get written, and
+// the row keeps its value ref.  Returns false, without changing anything, otherwise.
+bool kv_location_patch(keyvalue_location_t<rdb_value_t> *kv_location,
+                       const store_key_t &key,
+                       counted_t<const ql::datum_t> data,
+                       repli_timestamp_t timestamp,
+                       rdb_modification_info_t *mod_info_out) {
+    guarantee(kv_location->value.has());
+    const block_size_t block_size = kv_location->buf.cache()->get_block_size();
+    buf_parent_t parent(&kv_location->buf);
+    blob_t blob(block_size, kv_location->value->value_ref(), blob::btree_maxreflen);
+    const int64_t size = blob.valuesize();
+    if (blob::size_would_be_small(size, blob::btree_maxreflen)) {
+        return false;
+    }
+
+    write_message_t wm;
+    ql::serialize_row(&wm, data);
+    if (static_cast<int64_t>(wm.size()) != size) {
+        return false;
+    }
+    vector_stream_t new_stream;
+    new_stream.reserve(wm.size());
+    int res = send_write_message(&new_stream, &wm);
+    guarantee(res == 0);
+    const std::vector<char> &new_bytes = new_stream.vector();
+
+    // The blocks are in the cache, since the old row was just read from them.
+    std::vector<char> old_bytes(size);
+    {
+        buffer_group_t group;
+        blob_acq_t acq;
+        blob.expose_all(parent, access_t::read, &group, &acq);
+        buffer_group_t dest;
+        dest.add_buffer(size, old_bytes.data());
+        buffer_group_copy_data(&dest, const_view(&group));
+    }
+
+    // Write the runs of changed bytes, with the ones that are close together merged.
+    int64_t i = 0;
+    while (i < size) {
+        if (old_bytes[i] == new_bytes[i]) {
+            ++i;
+            continue;
+        }
+        int64_t end = i + 1;
+        int64_t last_change = i;
+        while (end < size && end - last_change <= ROW_PATCH_MERGE_GAP) {
+            if (old_bytes[end] != new_bytes[end]) {
+                last_change = end;
+            }
+            ++end;
+        }
+        blob.write_from_string(std::string(new_bytes.data() + i,
+                                           new_bytes.data() + last_change + 1),
+                               parent, i);
+        i = last_change + 1;
+    }
+
+    if (mod_info_out != NULL) {
+        guarantee(mod_info_out->deleted.second.empty());
+        guarantee(mod_info_out->added.second.empty());
+        mod_info_out->deleted.second.assign(
+            kv_location->value->value_ref(),
+            kv_location->value->value_ref()
+            + kv_location->value->inline_size(block_size));
+        mod_info_out->added.second = mod_info_out->deleted.second;
+    }
+
+    // The leaf still gets the new recency.
+    null_key_modification_callback_t<rdb_value_t> null_cb;
+    apply_keyvalue_change(kv_location, key.btree_key(), timestamp,
+                          expired_t::NO, &null_cb);
+    return true;
+}
+
 void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                      const store_key_t &key,
                      const std::vector<char> &value_ref,
@@ -170,36 +281,29 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                           expired_t::NO, &null_cb);
 }
 
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+// Replaces the value at *kv_location, which must have been found for `key`.
+batched_replace_response_t rdb_replace_at_location(
+    const btree_info_t &info,
+    const store_key_t &key,
+    keyvalue_location_t<rdb_value_t> *kv_location,
     const btree_point_replacer_t *replacer,
-    promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_info_t *mod_info_out,
-    profile::trace_t *trace)
+    rdb_modification_info_t *mod_info_out)
 {
     bool return_vals = replacer->should_return_vals();
-    const std::string &primary_key = *info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    const std::string &primary_key = *info.primary_key;
     ql::datum_ptr_t resp(ql::datum_t::R_OBJECT);
     try {
-        keyvalue_location_t<rdb_value_t> kv_location;
-        find_keyvalue_location_for_write(info.superblock, info.key->btree_key(),
-                                         &kv_location,
-                                         &info.btree->slice->stats,
-                                         trace,
-                                         superblock_promise);
-
         bool started_empty, ended_empty;
         counted_t<const ql::datum_t> old_val;
-        if (!kv_location.value.has()) {
+        if (!kv_location->value.has()) {
             // If there's no entry with this key, pass NULL to the function.
             started_empty = true;
             old_val = make_counted<ql::datum_t>(ql::datum_t::R_NULL);
         } else {
             // Otherwise pass the entry with this key to the function.
             started_empty = false;
-            old_val = get_data(kv_location.value.get(),
-                               buf_parent_t(&kv_location.buf));
+            old_val = get_data(kv_location->value.get(),
+                               buf_parent_t(&kv_location->buf));
             guarantee(old_val->get(primary_key, ql::NOTHROW).has());
         }
         guarantee(old_val.has());
@@ -249,7 +353,7 @@ batched_replace_response_t rdb_replace_and_return_superblock(
             } else {
                 conflict = resp.add("inserted", make_counted<ql::datum_t>(1.0));
                 r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                kv_location_set(&kv_location, *info.key, new_val, info.btree->timestamp,
+                kv_location_set(kv_location, key, new_val, info.timestamp,
                                 mod_info_out);
                 guarantee(mod_info_out->deleted.second.empty());
                 guarantee(!mod_info_out->added.second.empty());
@@ -258,7 +362,7 @@ batched_replace_response_t rdb_replace_and_return_superblock(
         } else {
             if (ended_empty) {
                 conflict = resp.add("deleted", make_counted<ql::datum_t>(1.0));
-                kv_location_delete(&kv_location, *info.key, info.btree->timestamp,
+                kv_location_delete(kv_location, key, info.timestamp,
                                    mod_info_out);
                 guarantee(!mod_info_out->deleted.second.empty());
                 guarantee(mod_info_out->added.second.empty());
@@ -272,9 +376,12 @@ batched_replace_response_t rdb_replace_and_return_superblock(
                 } else {
                     conflict = resp.add("replaced", make_counted<ql::datum_t>(1.0));
                     r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                    kv_location_set(&kv_location, *info.key, new_val,
-                                    info.btree->timestamp,
-                                    mod_info_out);
+                    if (!kv_location_patch(kv_location, key, new_val,
+                                           info.timestamp, mod_info_out)) {
+                        kv_location_set(kv_location, key, new_val,
+                                        info.timestamp,
+                                        mod_info_out);
+                    }
                     guarantee(!mod_info_out->deleted.second.empty());
                     guarantee(!mod_info_out->added.second.empty());
                     mod_info_out->added.first = new_val;
@@ -311,31 +418,61 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+// Replaces the keys `order[begin]`, `order[begin + 1]`, ... for as long as they fall
+// in the leaf found for the first of them (or in its siblings), so that they share a
+// single walk down the tree.  Pulses `end_promise` with the position in `order` of
+// the first key it didn't handle, and appends its modification reports to
+// `mod_reports_out` in turn with the other leaves.
+void do_a_leaf_of_replaces_from_batched_replace(
     auto_drainer_t::lock_t,
     fifo_enforcer_sink_t *batched_replaces_fifo_sink,
     const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
+    const btree_info_t *info,
+    superblock_t *superblock,
+    const std::vector<store_key_t> *keys,
+    const std::vector<size_t> *order,
+    size_t begin,
+    const btree_batched_replacer_t *replacer,
     promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_report_cb_t *sindex_cb,
+    promise_t<size_t> *end_promise,
+    std::vector<rdb_modification_report_t> *mod_reports_out,
     batched_replace_response_t *stats_out,
     profile::trace_t *trace)
 {
     fifo_enforcer_sink_t::exit_write_t exiter(
         batched_replaces_fifo_sink, batched_replaces_fifo_token);
 
-    rdb_modification_report_t mod_report(*info.key);
-    counted_t<const ql::datum_t> res = rdb_replace_and_return_superblock(
-        info, &one_replace, superblock_promise, &mod_report.info, trace);
-    *stats_out = (*stats_out)->merge(res, ql::stats_merge);
+    std::vector<rdb_modification_report_t> mod_reports;
+    {
+        keyvalue_location_t<rdb_value_t> kv_location;
+        find_keyvalue_location_for_write(superblock, (*keys)[(*order)[begin]].btree_key(),
+                                         &kv_location,
+                                         &info->slice->stats,
+                                         trace,
+                                         superblock_promise);
+        size_t i = begin;
+        do {
+            const size_t index = (*order)[i];
+            const one_replace_t one_replace(replacer, index);
+            mod_reports.push_back(rdb_modification_report_t((*keys)[index]));
+            counted_t<const ql::datum_t> res = rdb_replace_at_location(
+                *info, (*keys)[index], &kv_location, &one_replace,
+                &mod_reports.back().info);
+            *stats_out = (*stats_out)->merge(res, ql::stats_merge);
+            ++i;
+        } while (i < order->size()
+                 && find_nearby_keyvalue_location_for_write(
+                     (*keys)[(*order)[i]].btree_key(), &kv_location));
+        end_promise->pulse(i);
+    }
 
     // KSI: What is this for?  are we waiting to get in line to call on_mod_report?
     // I guess so.
 
     // JD: Looks like this is a do_a_replace_from_batched_replace specific thing.
     exiter.wait();
-    sindex_cb->on_mod_report(mod_report);
+    mod_reports_out->insert(mod_reports_out->end(),
+                            mod_reports.begin(), mod_reports.end());
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -351,6 +488,21 @@ batched_replace_response_t rdb_batched_replace(
 
     counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
 
+    // We go through the keys in sorted order, so that keys which share a leaf are
+    // next to each other.  The sort is stable, so that repeats of a key are still
+    // applied in the order they were given.
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+    // The leaves' modification reports, in the order of the keys they're for.  We
+    // update the secondary indexes for all of them together, once every leaf is
+    // done.
+    std::vector<rdb_modification_report_t> mod_reports;
+
     // We have to drain write operations before destructing everything above us,
     // because the coroutines being drained use them.
     {
@@ -358,27 +510,38 @@ batched_replace_response_t rdb_batched_replace(
         // Note the destructor ordering: We release the superblock before draining
         // on all the write operations.
         scoped_ptr_t<superblock_t> current_superblock(superblock->release());
-        for (size_t i = 0; i < keys.size(); ++i) {
-            // Pass out the point_replace_response_t.
+        size_t i = 0;
+        while (i < order.size()) {
             promise_t<superblock_t *> superblock_promise;
+            promise_t<size_t> end_promise;
             coro_t::spawn_sometime(
                 std::bind(
-                    &do_a_replace_from_batched_replace,
+                    &do_a_leaf_of_replaces_from_batched_replace,
                     auto_drainer_t::lock_t(&drainer),
                     &batched_replaces_fifo_sink,
                     batched_replaces_fifo_source.enter_write(),
 
-                    btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                    one_replace_t(replacer, i),
+                    &info,
+                    current_superblock.release(),
+                    &keys,
+                    &order,
+                    i,
+                    replacer,
 
                     &superblock_promise,
-                    sindex_cb,
+                    &end_promise,
+                    &mod_reports,
                     &stats,
                     trace));
 
+            // The coroutine decides where its leaf's keys end before it gives the
+            // superblock back, unless it gave the superblock back while walking
+            // down the tree.
+            i = end_promise.wait();
             current_superblock.init(superblock_promise.wait());
         }
-    } // Make sure the drainer is destructed before the return statement.
+    } // Make sure the drainer is destructed before we use the reports.
+    sindex_cb->on_mod_reports(mod_reports);
     return stats;
 }
 
@@ -533,7 +696,9 @@ void sindex_erase_range(const key_range_t &key_range,
     }
 }
 
-/* Spawns a coro to carry out the erase range for each sindex. */
+/* Spawns a coro to carry out the erase range for each sindex.  Counting indexes are
+ * skipped: they have no entries for the rows, and rdb_erase_range subtracts the rows
+ * from their counts itself. */
 void spawn_sindex_erase_ranges(
         const sindex_access_vector_t *sindex_access,
         const key_range_t &key_range,
@@ -542,6 +707,9 @@ void spawn_sindex_erase_ranges(
         bool release_superblock,
         signal_t *interruptor) {
     for (auto it = sindex_access->begin(); it != sindex_access->end(); ++it) {
+        if (sindex_is_counting(it->sindex)) {
+            continue;
+        }
         coro_t::spawn_sometime(std::bind(
                     &sindex_erase_range, key_range, it->super_block.get(),
                     auto_drainer_t::lock_t(drainer), interruptor,
@@ -549,16 +717,43 @@ void spawn_sindex_erase_ranges(
     }
 }
 
+void subtract_from_counting_indexes(key_tester_t *tester,
+                                    const key_range_t &key_range,
+                                    superblock_t *superblock,
+                                    btree_store_t<rdb_protocol_t> *store,
+                                    const sindex_access_vector_t *sindexes);
+
 void rdb_erase_range(key_tester_t *tester,
                      const key_range_t &key_range,
                      buf_lock_t *sindex_block,
                      superblock_t *superblock,
                      btree_store_t<rdb_protocol_t> *store,
+                     detached_subtree_reclaimer_t *reclaimer,
                      signal_t *interruptor) {
     /* This is guaranteed because the way the keys are calculated below would
      * lead to a single key being deleted even if the range was empty. */
     guarantee(!key_range.is_empty());
 
+    /* Counting indexes, even ones still being post-constructed, need the rows to be
+     * erased to take them off their counts. */
+    {
+        std::map<std::string, secondary_index_t> sindexes;
+        get_secondary_indexes(sindex_block, &sindexes);
+        std::set<std::string> counting_ids;
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            if (sindex_is_counting(it->second)) {
+                counting_ids.insert(it->first);
+            }
+        }
+        if (!counting_ids.empty()) {
+            sindex_access_vector_t counting_sindexes;
+            store->acquire_sindex_superblocks_for_write(counting_ids, sindex_block,
+                                                        &counting_sindexes);
+            subtract_from_counting_indexes(tester, key_range, superblock, store,
+                                           &counting_sindexes);
+        }
+    }
+
     /* Dispatch the erase range to the sindexes. */
     sindex_access_vector_t sindex_superblocks;
     {
@@ -617,7 +812,7 @@ void rdb_erase_range(key_tester_t *tester,
     btree_erase_range_generic(sizer, tester, &deleter,
         left_key_supplied ? left_key_exclusive.btree_key() : NULL,
         right_key_supplied ? right_key_inclusive.btree_key() : NULL,
-        superblock, interruptor);
+        superblock, interruptor, true, reclaimer);
 }
 
 // This is actually a kind of misleading name. This function estimates the size
@@ -634,15 +829,20 @@ typedef rdb_protocol_details::terminal_variant_t terminal_variant_t;
 class sindex_data_t {
 public:
     sindex_data_t(const key_range_t &_pkey_range, const datum_range_t &_range,
-                  ql::map_wire_func_t wire_func, sindex_multi_bool_t _multi)
+                  ql::map_wire_func_t wire_func, sindex_multi_bool_t _multi,
+                  const std::vector<std::string> &_covered_fields, bool _counting)
         : pkey_range(_pkey_range),range(_range),
-          func(wire_func.compile_wire_func()), multi(_multi) { }
+          func(wire_func.compile_wire_func()), multi(_multi),
+          covered_fields(_covered_fields), counting(_counting) { }
 private:
     friend class rget_cb_t;
     const key_range_t pkey_range;
     const datum_range_t range;
     const counted_t<ql::func_t> func;
     const sindex_multi_bool_t multi;
+    // Empty unless this is a covering index.
+    const std::vector<std::string> covered_fields;
+    const bool counting;
 };
 
 class job_data_t {
@@ -661,11 +861,15 @@ public:
             transformers.emplace_back(ql::make_op(env, _transforms[i]));
         }
         guarantee(transformers.size() == _transforms.size());
+        init_row_fields(_transforms);
     }
     job_data_t(job_data_t &&jd)
         : env(jd.env),
           batcher(std::move(jd.batcher)),
           transformers(std::move(jd.transformers)),
+          prefilter(std::move(jd.prefilter)),
+          row_fields_known(jd.row_fields_known),
+          row_fields(std::move(jd.row_fields)),
           sorting(jd.sorting),
           accumulator(jd.accumulator.release()) {
     }
@@ -674,6 +878,48 @@ private:
     ql::env_t *const env;
     ql::batcher_t batcher;
     std::vector<scoped_ptr_t<ql::op_t> > transformers;
+    // Looks for filters that only read some fields of the row, followed by a
+    // `pluck`.  Then the transformers only need those fields of each row.
+    void init_row_fields(const std::vector<transform_variant_t> &transforms) {
+        row_fields_known = false;
+        for (size_t i = 0; i < transforms.size(); ++i) {
+            if (const ql::filter_wire_func_t *filter
+                    = boost::get<ql::filter_wire_func_t>(&transforms[i])) {
+                scoped_ptr_t<ql::batch_predicate_t> predicate
+                    = ql::compile_batch_predicate(
+                        filter->filter_func.compile_wire_func());
+                if (!predicate.has() || !predicate->reads_only_row_fields()) {
+                    break;
+                }
+                row_fields.insert(predicate->get_row_fields().begin(),
+                                  predicate->get_row_fields().end());
+                if (i == 0) {
+                    prefilter = std::move(predicate);
+                }
+            } else if (const ql::map_wire_func_t *map
+                           = boost::get<ql::map_wire_func_t>(&transforms[i])) {
+                std::set<std::string> plucked;
+                if (ql::get_row_projection(map->compile_wire_func(), &plucked)) {
+                    row_fields.insert(plucked.begin(), plucked.end());
+                    row_fields_known = true;
+                }
+                break;
+            } else {
+                break;
+            }
+        }
+        if (!row_fields_known) {
+            row_fields.clear();
+        }
+    }
+
+    // The first transformer's predicate, if it's a `filter` that only reads some
+    // fields of the row.  It lets us drop rows without loading all of them.
+    scoped_ptr_t<ql::batch_predicate_t> prefilter;
+    // If `row_fields_known`, the transformers give the same results on an object
+    // with just `row_fields` of a row as on the whole row, so that's all we read.
+    bool row_fields_known;
+    std::set<std::string> row_fields;
     sorting_t sorting;
     scoped_ptr_t<ql::accumulator_t> accumulator;
 };
@@ -733,6 +979,30 @@ void rget_cb_t::finish() THROWS_ONLY(interrupted_exc_t) {
     }
 }
 
+// Returns an object with just the fields `keys` of `row`, reading as little of the
+// row as possible.
+counted_t<const ql::datum_t> load_row_fields(const lazy_json_t &row,
+                                             const std::set<std::string> &keys) {
+    ql::datum_object_t fields;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        counted_t<const ql::datum_t> field = row.get_field(*it);
+        if (field.has()) {
+            fields.set(*it, field, ql::NOCLOBBER);
+        }
+    }
+    return make_counted<const ql::datum_t>(std::move(fields));
+}
+
+// Returns true if `prefilter` rejects `row` given only the fields it reads.
+bool prefilter_rejects(const ql::batch_predicate_t &prefilter, const lazy_json_t &row) {
+    std::vector<ql::batch_predicate_t::result_t> results;
+    prefilter.evaluate(
+        std::vector<counted_t<const ql::datum_t> >{
+            load_row_fields(row, prefilter.get_row_fields())},
+        &results);
+    return results[0] == ql::batch_predicate_t::FAIL;
+}
+
 // Handle a keyvalue pair.  Returns whether or not we're done early.
 done_t rget_cb_t::handle_pair(scoped_key_value_t &&keyvalue,
                               concurrent_traversal_fifo_enforcer_signal_t waiter)
@@ -748,12 +1018,24 @@ THROWS_ONLY(interrupted_exc_t) {
     if (sindex && !sindex->pkey_range.contains_key(ql::datum_t::extract_primary(key))) {
         return done_t::NO;
     }
+    profile::count_rows_read(job.env->trace.get_or_null(), 1);
 
     lazy_json_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
                     keyvalue.expose_buf());
+    // Rows the first filter rejects based on a few of their fields are never loaded.
+    const bool filtered_out = job.prefilter.has() && !sindex
+        && prefilter_rejects(*job.prefilter, row);
     counted_t<const ql::datum_t> val;
     // We only load the value if we actually use it (`count` does not).
-    if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
+    if (filtered_out) {
+        row.reset();
+    } else if (job.row_fields_known && !sindex) {
+        // The transformers only look at these fields (see `init_row_fields`), so we
+        // don't read the rest of the row.
+        val = load_row_fields(row, job.row_fields);
+        io.slice->stats.pm_keys_read.record();
+        row.reset();
+    } else if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
         val = row.get();
         io.slice->stats.pm_keys_read.record();
     } else {
@@ -773,20 +1055,45 @@ THROWS_ONLY(interrupted_exc_t) {
         // Check whether we're out of sindex range.
         counted_t<const ql::datum_t> sindex_val; // NULL if no sindex.
         if (sindex) {
-            sindex_val = sindex->func->call(job.env, val)->as_datum();
-            if (sindex->multi == sindex_multi_bool_t::MULTI
-                && sindex_val->get_type() == ql::datum_t::R_ARRAY) {
-                boost::optional<uint64_t> tag = *ql::datum_t::extract_tag(key);
-                guarantee(tag);
-                sindex_val = sindex_val->get(*tag, ql::NOTHROW);
-                guarantee(sindex_val);
+            if (sindex->counting) {
+                // A counting entry (see make_counting_entry) is read as a row with
+                // the group and its number of rows.
+                sindex_val = val->get(0, ql::THROW);
+                std::map<std::string, counted_t<const ql::datum_t> > group;
+                group["group"] = sindex_val;
+                group["count"] = val->get(1, ql::THROW);
+                val = make_counted<ql::datum_t>(std::move(group));
+            } else if (!sindex->covered_fields.empty()
+                       && val->get_type() == ql::datum_t::R_ARRAY) {
+                // A covering entry (see make_covering_entry) already has the index
+                // value (for this key's tag, for a multi index) and the row's
+                // projection.
+                sindex_val = val->get(0, ql::THROW);
+                val = val->get(1, ql::THROW);
+            } else {
+                sindex_val = sindex->func->call(job.env, val)->as_datum();
+                if (sindex->multi == sindex_multi_bool_t::MULTI
+                    && sindex_val->get_type() == ql::datum_t::R_ARRAY) {
+                    boost::optional<uint64_t> tag = *ql::datum_t::extract_tag(key);
+                    guarantee(tag);
+                    sindex_val = sindex_val->get(*tag, ql::NOTHROW);
+                    guarantee(sindex_val);
+                }
+                if (!sindex->covered_fields.empty()) {
+                    // The entry didn't fit, so it points at the row itself.  Rows
+                    // read through a covering index are always projections.
+                    val = project_covered_fields(val, sindex->covered_fields);
+                }
             }
             if (!sindex->range.contains(sindex_val)) {
                 return done_t::NO;
             }
         }
 
-        ql::groups_t data{{counted_t<const ql::datum_t>(), ql::datums_t{val}}};
+        // The transformers and the accumulator still see a row that was filtered
+        // out, as an empty group, just like after the filter dropped it.
+        ql::groups_t data{{counted_t<const ql::datum_t>(),
+                           filtered_out ? ql::datums_t{} : ql::datums_t{val}}};
 
         for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
             (**it)(&data);
@@ -808,6 +1115,21 @@ THROWS_ONLY(interrupted_exc_t) {
     }
 }
 
+// Terminals consume the whole range and don't care about the order of the rows (the
+// rows come from several hash shards anyway), so their scans can be split up.
+void rget_traversal(btree_slice_t *slice, superblock_t *superblock,
+                    const key_range_t &range, rget_cb_t *callback,
+                    direction_t direction, bool has_terminal) {
+    if (has_terminal) {
+        btree_partitioned_concurrent_traversal(slice, superblock, range, callback,
+                                               direction,
+                                               RGET_AGGREGATION_SCAN_PARTITIONS,
+                                               partition_order_t::UNORDERED);
+    } else {
+        btree_concurrent_traversal(slice, superblock, range, callback, direction);
+    }
+}
+
 // TODO: Having two functions which are 99% the same sucks.
 void rdb_rget_slice(
     btree_slice_t *slice,
@@ -826,8 +1148,8 @@ void rdb_rget_slice(
         job_data_t(ql_env, batchspec, transforms, terminal, sorting),
         boost::optional<sindex_data_t>(),
         range);
-    btree_concurrent_traversal(slice, superblock, range, &callback,
-                               (!reversed(sorting) ? FORWARD : BACKWARD));
+    rget_traversal(slice, superblock, range, &callback,
+                   (!reversed(sorting) ? FORWARD : BACKWARD), terminal.is_initialized());
     callback.finish();
 }
 
@@ -844,17 +1166,19 @@ void rdb_rget_secondary_slice(
     sorting_t sorting,
     const ql::map_wire_func_t &sindex_func,
     sindex_multi_bool_t sindex_multi,
+    const std::vector<std::string> &covered_fields,
+    bool counting,
     rget_read_response_t *response) {
     r_sanity_check(boost::get<ql::exc_t>(&response->result) == NULL);
     profile::starter_t starter("Do range scan on secondary index.", ql_env->trace);
     rget_cb_t callback(
         io_data_t(response, slice),
         job_data_t(ql_env, batchspec, transforms, terminal, sorting),
-        sindex_data_t(pk_range, sindex_range, sindex_func, sindex_multi),
+        sindex_data_t(pk_range, sindex_range, sindex_func, sindex_multi,
+                      covered_fields, counting),
         sindex_region.inner);
-    btree_concurrent_traversal(
-        slice, superblock, sindex_region.inner, &callback,
-        (!reversed(sorting) ? FORWARD : BACKWARD));
+    rget_traversal(slice, superblock, sindex_region.inner, &callback,
+                   (!reversed(sorting) ? FORWARD : BACKWARD), terminal.is_initialized());
     callback.finish();
 }
 
@@ -882,6 +1206,31 @@ void rdb_distribution_get(int max_depth,
     }
 }
 
+class rdb_value_size_estimator_t : public value_size_estimator_t {
+public:
+    int64_t value_bytes(const void *value) {
+        return static_cast<const rdb_value_t *>(value)->value_size();
+    }
+};
+
+void rdb_distribution_sample(int sample_count,
+                             int bucket_count,
+                             const store_key_t &left_key,
+                             superblock_t *superblock,
+                             distribution_read_response_t *response) {
+    rdb_value_size_estimator_t estimator;
+    key_distribution_histogram_t histogram;
+    sample_btree_key_distribution(superblock, &estimator, sample_count, bucket_count,
+                                  &histogram);
+
+    response->key_counts[left_key] = histogram.key_counts[0];
+    response->byte_counts[left_key] = histogram.byte_counts[0];
+    for (size_t i = 0; i < histogram.split_keys.size(); ++i) {
+        response->key_counts[histogram.split_keys[i]] = histogram.key_counts[i + 1];
+        response->byte_counts[histogram.split_keys[i]] = histogram.byte_counts[i + 1];
+    }
+}
+
 static const int8_t HAS_VALUE = 0;
 static const int8_t HAS_NO_VALUE = 1;
 
@@ -931,146 +1280,639 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_erase_range_report_t, range_to_erase);
 
 rdb_modification_report_cb_t::rdb_modification_report_cb_t(
         btree_store_t<rdb_protocol_t> *store,
+        ql::changefeed::server_t *changefeed_server,
         buf_lock_t *sindex_block,
         auto_drainer_t::lock_t lock)
-    : lock_(lock), store_(store),
-      sindex_block_(sindex_block) {
-    store_->acquire_post_constructed_sindex_superblocks_for_write(
-            sindex_block_, &sindexes_);
-}
+    : lock_(lock), store_(store), changefeed_server_(changefeed_server),
+      sindex_block_(sindex_block) { }
 
 rdb_modification_report_cb_t::~rdb_modification_report_cb_t() { }
 
 void rdb_modification_report_cb_t::on_mod_report(
         const rdb_modification_report_t &mod_report) {
-    mutex_t::acq_t acq;
-    store_->lock_sindex_queue(sindex_block_, &acq);
+    on_mod_reports(std::vector<rdb_modification_report_t>(1, mod_report));
+}
 
-    write_message_t wm;
-    wm << rdb_sindex_change_t(mod_report);
-    store_->sindex_queue_push(wm, &acq);
+void rdb_modification_report_cb_t::on_mod_reports(
+        const std::vector<rdb_modification_report_t> &mod_reports) {
+    txn_t *txn = sindex_block_->txn();
+    rdb_queue_sindex_changes(store_, changefeed_server_, sindex_block_, mod_reports,
+                             &sindexes_);
+    rdb_update_sindexes(sindexes_, mod_reports, txn,
+                        release_sindex_superblocks_t::YES);
+}
 
-    rdb_update_sindexes(sindexes_, &mod_report, sindex_block_->txn());
+void rdb_queue_sindex_changes(
+        btree_store_t<rdb_protocol_t> *store,
+        ql::changefeed::server_t *changefeed_server,
+        buf_lock_t *sindex_block,
+        const std::vector<rdb_modification_report_t> &mod_reports,
+        sindex_access_vector_t *sindexes_out) {
+    {
+        mutex_t::acq_t acq;
+        store->lock_sindex_queue(sindex_block, &acq);
+
+        for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+            write_message_t wm;
+            wm << rdb_sindex_change_t(*it);
+            store->sindex_queue_push(wm, &acq);
+        }
+    }
+
+    store->acquire_post_constructed_sindex_superblocks_for_write(sindex_block,
+                                                                 sindexes_out);
+
+    // Anyone who hears about the changes and then reads an index gets in line for
+    // its superblock after us.
+    rdb_send_changes(changefeed_server, mod_reports);
+
+    sindex_block->reset_buf_lock();
+}
+
+void rdb_send_changes(ql::changefeed::server_t *changefeed_server,
+                      const std::vector<rdb_modification_report_t> &mod_reports) {
+    if (changefeed_server == NULL || !changefeed_server->has_clients()) {
+        return;
+    }
+    std::vector<ql::changefeed::change_t> changes;
+    changes.reserve(mod_reports.size());
+    for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+        // Replacements that left the row as it was have nothing in the report.
+        if (it->info.deleted.first.has() || it->info.added.first.has()) {
+            changes.push_back(ql::changefeed::change_t(it->info.deleted.first,
+                                                       it->info.added.first));
+        }
+    }
+    changefeed_server->send_changes(std::move(changes));
 }
 
 typedef btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindex_access_vector_t;
 
+// If index_values_out isn't NULL, it gets the index value each key was made from.
 void compute_keys(const store_key_t &primary_key, counted_t<const ql::datum_t> doc,
                   ql::map_wire_func_t *mapping, sindex_multi_bool_t multi, ql::env_t *env,
-                  std::vector<store_key_t> *keys_out) {
+                  std::vector<store_key_t> *keys_out,
+                  std::vector<counted_t<const ql::datum_t> > *index_values_out) {
     guarantee(keys_out->empty());
     counted_t<const ql::datum_t> index =
         mapping->compile_wire_func()->call(env, doc)->as_datum();
 
     if (multi == sindex_multi_bool_t::MULTI && index->get_type() == ql::datum_t::R_ARRAY) {
         for (uint64_t i = 0; i < index->size(); ++i) {
-            keys_out->push_back(
-                store_key_t(index->get(i, ql::THROW)->print_secondary(primary_key, i)));
+            counted_t<const ql::datum_t> value = index->get(i, ql::THROW);
+            keys_out->push_back(store_key_t(value->print_secondary(primary_key, i)));
+            if (index_values_out != NULL) {
+                index_values_out->push_back(value);
+            }
         }
     } else {
         keys_out->push_back(store_key_t(index->print_secondary(primary_key)));
+        if (index_values_out != NULL) {
+            index_values_out->push_back(index);
+        }
     }
 }
 
-/* Used below by rdb_update_sindexes. */
-void rdb_update_single_sindex(
+counted_t<const ql::datum_t> project_covered_fields(
+        counted_t<const ql::datum_t> doc,
+        const std::vector<std::string> &covered_fields) {
+    std::map<std::string, counted_t<const ql::datum_t> > projection;
+    for (auto it = covered_fields.begin(); it != covered_fields.end(); ++it) {
+        counted_t<const ql::datum_t> field = doc->get(*it, ql::NOTHROW);
+        if (field.has()) {
+            projection[*it] = field;
+        }
+    }
+    return make_counted<ql::datum_t>(std::move(projection));
+}
+
+/* A covering index stores an entry of the form [index value, projection of the row]
+ * at its keys, so that reads of the index can be answered without loading the row.
+ * We only do that when the entry fits inline in the value's blob ref: then it has no
+ * blocks of its own, and the index can go on detaching its values instead of
+ * deleting them.  Returns an empty pointer when the entry doesn't fit; the key then
+ * points at the row, as it would in an ordinary index. */
+counted_t<const ql::datum_t> make_covering_entry(
+        counted_t<const ql::datum_t> index_value,
+        counted_t<const ql::datum_t> doc,
+        const std::vector<std::string> &covered_fields) {
+    std::vector<counted_t<const ql::datum_t> > entry;
+    entry.push_back(index_value);
+    entry.push_back(project_covered_fields(doc, covered_fields));
+    counted_t<const ql::datum_t> res = make_counted<ql::datum_t>(std::move(entry));
+
+    write_message_t wm;
+    wm << res;
+    if (!blob::size_would_be_small(wm.size(), blob::btree_maxreflen)) {
+        return counted_t<const ql::datum_t>();
+    }
+    return res;
+}
+
+/* A counting index keeps one entry for each group of rows, of the form [group,
+ * number of rows in it], where an ordinary index keeps one for each row.  The entry
+ * is at the group's index key with an empty primary key.  Groups only get an entry if
+ * their key isn't truncated, so that no two groups share a key, and if their entry
+ * fits inline in the value's blob ref, so that the index can detach its values like
+ * any other index (see make_covering_entry).  Rows in other groups are left out of
+ * the index, like rows the index function fails on. */
+counted_t<const ql::datum_t> make_counting_entry(counted_t<const ql::datum_t> group,
+                                                 int64_t count) {
+    std::vector<counted_t<const ql::datum_t> > entry;
+    entry.push_back(group);
+    entry.push_back(make_counted<ql::datum_t>(static_cast<double>(count)));
+    return make_counted<ql::datum_t>(std::move(entry));
+}
+
+bool group_can_be_counted(const store_key_t &key, counted_t<const ql::datum_t> group) {
+    if (ql::datum_t::key_is_truncated(key)) {
+        return false;
+    }
+    // Counts are serialized in fewer bytes the smaller they are, so we check the
+    // entry with the largest count a double holds exactly.
+    write_message_t wm;
+    wm << make_counting_entry(group, static_cast<int64_t>(1) << 53);
+    return blob::size_would_be_small(wm.size(), blob::btree_maxreflen);
+}
+
+struct counting_delta_t {
+    counting_delta_t() : delta(0) { }
+    counted_t<const ql::datum_t> group;
+    int64_t delta;
+};
+
+/* The changes to the counts of a counting index's groups, by the groups' keys. */
+typedef std::map<store_key_t, counting_delta_t> counting_deltas_t;
+
+/* Adds `delta` to the count of every group `doc` is in.  A row is counted once in
+ * each of its groups, even if a multi index function returns a group twice. */
+void add_counting_deltas(counted_t<const ql::datum_t> doc,
+                         ql::map_wire_func_t *mapping, sindex_multi_bool_t multi,
+                         ql::env_t *env, int64_t delta, counting_deltas_t *deltas) {
+    std::vector<counted_t<const ql::datum_t> > groups;
+    std::vector<store_key_t> keys;
+    try {
+        counted_t<const ql::datum_t> index =
+            mapping->compile_wire_func()->call(env, doc)->as_datum();
+        if (multi == sindex_multi_bool_t::MULTI
+            && index->get_type() == ql::datum_t::R_ARRAY) {
+            groups = index->as_array();
+        } else {
+            groups.push_back(index);
+        }
+        for (auto it = groups.begin(); it != groups.end(); ++it) {
+            keys.push_back(store_key_t((*it)->print_secondary(store_key_t(),
+                                                              boost::none)));
+        }
+    } catch (const ql::base_exc_t &) {
+        // Do nothing (we just leave the row out of the index).
+        return;
+    }
+    std::set<store_key_t> counted;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (!counted.insert(keys[i]).second || !group_can_be_counted(keys[i], groups[i])) {
+            continue;
+        }
+        counting_delta_t *group_delta = &(*deltas)[keys[i]];
+        group_delta->group = groups[i];
+        group_delta->delta += delta;
+    }
+}
+
+/* Adds `deltas` to the counts in the counting index.  Groups that end up with no rows
+ * lose their entry.  (While the index is being post-constructed, a count can go
+ * negative for a while: rows erased from the table are subtracted right away, even if
+ * the post-construction hasn't counted them yet.) */
+void apply_counting_deltas(
         const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
-        const rdb_modification_report_t *modification,
+        const counting_deltas_t *deltas,
         auto_drainer_t::lock_t) {
-    // Note if you get this error it's likely that you've passed in a default
-    // constructed mod_report. Don't do that.  Mod reports should always be passed
-    // to a function as an output parameter before they're passed to this
-    // function.
-    guarantee(modification->primary_key.size() != 0);
+    superblock_t *super_block = sindex->super_block.get();
+    auto it = deltas->begin();
+    while (it != deltas->end()) {
+        promise_t<superblock_t *> return_superblock_local;
+        {
+            keyvalue_location_t<rdb_value_t> kv_location;
+            find_keyvalue_location_for_write(super_block,
+                                             it->first.btree_key(),
+                                             &kv_location,
+                                             &sindex->btree->stats,
+                                             NULL,
+                                             &return_superblock_local);
+            do {
+                if (it->second.delta != 0) {
+                    int64_t count = 0;
+                    if (kv_location.value.has()) {
+                        counted_t<const ql::datum_t> entry
+                            = get_data(kv_location.value.get(),
+                                       buf_parent_t(&kv_location.buf));
+                        count = entry->get(1, ql::THROW)->as_int();
+                    }
+                    count += it->second.delta;
+                    if (count != 0) {
+                        kv_location_set(&kv_location, it->first,
+                                        make_counting_entry(it->second.group, count),
+                                        repli_timestamp_t::distant_past, NULL);
+                    } else if (kv_location.value.has()) {
+                        kv_location_delete(&kv_location, it->first,
+                                           repli_timestamp_t::distant_past, NULL);
+                    }
+                }
+                ++it;
+            } while (it != deltas->end()
+                     && find_nearby_keyvalue_location_for_write(it->first.btree_key(),
+                                                                &kv_location));
+            // The keyvalue location gets destroyed here.
+        }
+        super_block = return_superblock_local.wait();
+    }
+}
 
-    ql::map_wire_func_t mapping;
-    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
-    inplace_vector_read_stream_t read_stream(&sindex->sindex.opaque_definition);
-    archive_result_t success = deserialize(&read_stream, &mapping);
+secondary_index_t::opaque_definition_t serialize_sindex_definition(
+        const ql::map_wire_func_t &mapping, sindex_multi_bool_t multi,
+        const std::vector<std::string> &covered_fields, bool counting,
+        const std::string &expiry_pkey) {
+    write_message_t wm;
+    wm << mapping;
+    wm << multi;
+    wm << covered_fields;
+    wm << counting;
+    wm << expiry_pkey;
+    wm << ql::key_format_t::COMPACT;
+
+    vector_stream_t stream;
+    stream.reserve(wm.size());
+    int write_res = send_write_message(&stream, &wm);
+    guarantee(write_res == 0);
+    return stream.vector();
+}
+
+void deserialize_sindex_definition(
+        const secondary_index_t::opaque_definition_t &definition,
+        ql::map_wire_func_t *mapping_out, sindex_multi_bool_t *multi_out,
+        std::vector<std::string> *covered_fields_out, bool *counting_out,
+        std::string *expiry_pkey_out, ql::key_format_t *key_format_out) {
+    inplace_vector_read_stream_t read_stream(&definition);
+    archive_result_t success = deserialize(&read_stream, mapping_out);
     guarantee_deserialization(success, "sindex deserialize");
-    success = deserialize(&read_stream, &multi);
+    success = deserialize(&read_stream, multi_out);
     guarantee_deserialization(success, "sindex deserialize");
+    // Indexes created before covering indexes existed end here.
+    covered_fields_out->clear();
+    *counting_out = false;
+    expiry_pkey_out->clear();
+    *key_format_out = ql::key_format_t::PRINTED;
+    success = deserialize(&read_stream, covered_fields_out);
+    if (success == ARCHIVE_SOCK_EOF) {
+        covered_fields_out->clear();
+        return;
+    }
+    guarantee_deserialization(success, "sindex deserialize");
+    // And indexes created before counting indexes existed end here.
+    success = deserialize(&read_stream, counting_out);
+    if (success == ARCHIVE_SOCK_EOF) {
+        *counting_out = false;
+        return;
+    }
+    guarantee_deserialization(success, "sindex deserialize");
+    // And the ones created before expiry indexes existed here.
+    success = deserialize(&read_stream, expiry_pkey_out);
+    if (success == ARCHIVE_SOCK_EOF) {
+        expiry_pkey_out->clear();
+        return;
+    }
+    guarantee_deserialization(success, "sindex deserialize");
+    // And the ones whose keys are in the printed format here.
+    success = deserialize(&read_stream, key_format_out);
+    if (success == ARCHIVE_SOCK_EOF) {
+        *key_format_out = ql::key_format_t::PRINTED;
+    } else {
+        guarantee_deserialization(success, "sindex deserialize");
+    }
+}
 
-    // TODO we just use a NULL environment here. People should not be able
-    // to do anything that requires an environment like gets from other
-    // tables etc. but we don't have a nice way to disallow those things so
-    // for now we pass null and it will segfault if an illegal sindex
-    // mapping is passed.
-    cond_t non_interruptor;
-    ql::env_t env(NULL, &non_interruptor);
+void deserialize_sindex_definition(
+        const secondary_index_t::opaque_definition_t &definition,
+        ql::map_wire_func_t *mapping_out, sindex_multi_bool_t *multi_out,
+        std::vector<std::string> *covered_fields_out, bool *counting_out,
+        std::string *expiry_pkey_out) {
+    ql::key_format_t key_format;
+    deserialize_sindex_definition(definition, mapping_out, multi_out,
+                                  covered_fields_out, counting_out, expiry_pkey_out,
+                                  &key_format);
+}
 
-    superblock_t *super_block = sindex->super_block.get();
+void deserialize_sindex_definition(
+        const secondary_index_t::opaque_definition_t &definition,
+        ql::map_wire_func_t *mapping_out, sindex_multi_bool_t *multi_out,
+        std::vector<std::string> *covered_fields_out, bool *counting_out) {
+    std::string expiry_pkey;
+    deserialize_sindex_definition(definition, mapping_out, multi_out,
+                                  covered_fields_out, counting_out, &expiry_pkey);
+}
 
-    if (modification->info.deleted.first) {
-        guarantee(!modification->info.deleted.second.empty());
-        try {
-            counted_t<const ql::datum_t> deleted = modification->info.deleted.first;
+bool sindex_is_counting(const secondary_index_t &sindex) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> covered_fields;
+    bool counting;
+    deserialize_sindex_definition(sindex.opaque_definition, &mapping, &multi,
+                                  &covered_fields, &counting);
+    return counting;
+}
 
-            std::vector<store_key_t> keys;
+ql::key_format_t sindex_key_format(const secondary_index_t &sindex) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> covered_fields;
+    bool counting;
+    std::string expiry_pkey;
+    ql::key_format_t key_format;
+    deserialize_sindex_definition(sindex.opaque_definition, &mapping, &multi,
+                                  &covered_fields, &counting, &expiry_pkey,
+                                  &key_format);
+    return key_format;
+}
 
-            compute_keys(modification->primary_key, deleted, &mapping, multi, &env, &keys);
+/* Collects the rows rdb_erase_range is about to erase, as deltas of -1 to the counts
+ * of their groups in each counting index. */
+class counting_erase_cb_t : public depth_first_traversal_callback_t {
+public:
+    counting_erase_cb_t(key_tester_t *_tester,
+                        const sindex_access_vector_t *sindexes)
+        : tester(_tester), definitions(sindexes->size()), deltas(sindexes->size()) {
+        for (size_t i = 0; i < sindexes->size(); ++i) {
+            std::vector<std::string> covered_fields;
+            bool counting;
+            deserialize_sindex_definition((*sindexes)[i].sindex.opaque_definition,
+                                          &definitions[i].first,
+                                          &definitions[i].second,
+                                          &covered_fields, &counting);
+        }
+    }
 
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        if (!tester->key_should_be_erased(keyvalue.key())) {
+            return true;
+        }
+        counted_t<const ql::datum_t> doc
+            = get_data(static_cast<const rdb_value_t *>(keyvalue.value()),
+                       keyvalue.expose_buf());
+        keyvalue.reset();
+        // TODO we just use a NULL environment here, like rdb_update_single_sindex
+        // does.
+        cond_t non_interruptor;
+        ql::env_t env(NULL, &non_interruptor);
+        for (size_t i = 0; i < definitions.size(); ++i) {
+            add_counting_deltas(doc, &definitions[i].first, definitions[i].second,
+                                &env, -1, &deltas[i]);
+        }
+        return true;
+    }
 
-                    find_keyvalue_location_for_write(super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
+    key_tester_t *tester;
+    std::vector<std::pair<ql::map_wire_func_t, sindex_multi_bool_t> > definitions;
+    std::vector<counting_deltas_t> deltas;
+};
 
-                    if (kv_location.value.has()) {
-                        kv_location_delete(&kv_location, *it,
-                            repli_timestamp_t::distant_past, NULL);
-                    }
-                    // The keyvalue location gets destroyed here.
+void subtract_from_counting_indexes(key_tester_t *tester,
+                                    const key_range_t &key_range,
+                                    superblock_t *superblock,
+                                    btree_store_t<rdb_protocol_t> *store,
+                                    const sindex_access_vector_t *sindexes) {
+    counting_erase_cb_t callback(tester, sindexes);
+    block_id_t root_block_id = superblock->get_root_block_id();
+    if (root_block_id != NULL_BLOCK_ID) {
+        // We only read the rows here, and keep hold of the superblock for the erase.
+        btree_depth_first_traversal(
+            store->btree.get(),
+            make_counted<counted_buf_lock_t>(superblock->expose_buf(), root_block_id,
+                                             access_t::read),
+            key_range, &callback, FORWARD);
+    }
+
+    auto_drainer_t drainer;
+    for (size_t i = 0; i < sindexes->size(); ++i) {
+        coro_t::spawn_sometime(std::bind(&apply_counting_deltas, &(*sindexes)[i],
+                                         &callback.deltas[i],
+                                         auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+/* One change to a secondary index btree: the entry at `key` is set to
+ * covering_entry if that is non-empty, and otherwise is made to point at the row
+ * whose value ref is *value_ref, or is deleted if value_ref is NULL. */
+struct sindex_change_t {
+    sindex_change_t(const store_key_t &_key, const std::vector<char> *_value_ref)
+        : key(_key), value_ref(_value_ref) { }
+    sindex_change_t(const store_key_t &_key,
+                    counted_t<const ql::datum_t> _covering_entry)
+        : key(_key), value_ref(NULL), covering_entry(_covering_entry) { }
+    store_key_t key;
+    const std::vector<char> *value_ref;
+    counted_t<const ql::datum_t> covering_entry;
+};
+
+/* Applies `changes`, which must be sorted by key, to the secondary index.  Keys that
+ * land in the same leaf of the sindex btree (or one of its siblings) share a single
+ * walk down from the sindex superblock. */
+void apply_sindex_changes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const std::vector<sindex_change_t> *changes,
+        auto_drainer_t::lock_t) {
+    superblock_t *super_block = sindex->super_block.get();
+    size_t i = 0;
+    while (i < changes->size()) {
+        promise_t<superblock_t *> return_superblock_local;
+        {
+            keyvalue_location_t<rdb_value_t> kv_location;
+            find_keyvalue_location_for_write(super_block,
+                                             (*changes)[i].key.btree_key(),
+                                             &kv_location,
+                                             &sindex->btree->stats,
+                                             NULL,
+                                             &return_superblock_local);
+            do {
+                const sindex_change_t &change = (*changes)[i];
+                if (change.covering_entry.has()) {
+                    kv_location_set(&kv_location, change.key, change.covering_entry,
+                                    repli_timestamp_t::distant_past, NULL);
+                } else if (change.value_ref != NULL) {
+                    kv_location_set(&kv_location, change.key, *change.value_ref,
+                                    repli_timestamp_t::distant_past);
+                } else if (kv_location.value.has()) {
+                    kv_location_delete(&kv_location, change.key,
+                                       repli_timestamp_t::distant_past, NULL);
                 }
-                super_block = return_superblock_local.wait();
-            }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (it wasn't actually in the index).
+                ++i;
+            } while (i < changes->size()
+                     && find_nearby_keyvalue_location_for_write(
+                         (*changes)[i].key.btree_key(), &kv_location));
+            // The keyvalue location gets destroyed here.
         }
+        super_block = return_superblock_local.wait();
     }
+}
 
-    if (modification->info.added.first) {
-        try {
-            counted_t<const ql::datum_t> added = modification->info.added.first;
+void sort_sindex_changes(std::vector<sindex_change_t> *changes) {
+    // The sort is stable so that changes to the same key (from repeats of a primary
+    // key in a batch) are still applied in order.
+    std::stable_sort(changes->begin(), changes->end(),
+                     [](const sindex_change_t &a, const sindex_change_t &b) {
+                         return a.key < b.key;
+                     });
+}
 
-            std::vector<store_key_t> keys;
+typedef std::vector<std::pair<store_key_t, counted_t<const ql::datum_t> > >
+    sindex_entries_t;
+
+/* Computes the index entries of `doc`, sorted by key: the secondary keys, each with
+ * the covering entry to store there (see make_covering_entry), if the index has
+ * covered fields and the entry fits.  A row the index function fails on has no
+ * entries. */
+void compute_sindex_entries(const store_key_t &primary_key,
+                            counted_t<const ql::datum_t> doc,
+                            ql::map_wire_func_t *mapping, sindex_multi_bool_t multi,
+                            const std::vector<std::string> &covered_fields,
+                            ql::env_t *env,
+                            sindex_entries_t *entries_out) {
+    guarantee(entries_out->empty());
+    std::vector<store_key_t> keys;
+    std::vector<counted_t<const ql::datum_t> > index_values;
+    try {
+        compute_keys(primary_key, doc, mapping, multi, env, &keys, &index_values);
+    } catch (const ql::base_exc_t &) {
+        // Do nothing (we just leave the row out of the index).
+        return;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        entries_out->push_back(std::make_pair(
+            keys[i],
+            covered_fields.empty()
+                ? counted_t<const ql::datum_t>()
+                : make_covering_entry(index_values[i], doc, covered_fields)));
+    }
+    std::sort(entries_out->begin(), entries_out->end(),
+              [](const sindex_entries_t::value_type &x,
+                 const sindex_entries_t::value_type &y) {
+                  return x.first < y.first;
+              });
+}
 
-            compute_keys(modification->primary_key, added, &mapping, multi, &env, &keys);
+/* Used below by rdb_update_sindexes.  Computes the index entries of every old and
+ * new document in `modifications` first, then applies them to the index in key
+ * order. */
+void rdb_update_single_sindex(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const std::vector<const rdb_modification_report_t *> *modifications,
+        release_sindex_superblocks_t release_superblock,
+        auto_drainer_t::lock_t lock) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> covered_fields;
+    bool counting;
+    deserialize_sindex_definition(sindex->sindex.opaque_definition, &mapping, &multi,
+                                  &covered_fields, &counting);
+
+    // TODO we just use a NULL environment here. People should not be able
+    // to do anything that requires an environment like gets from other
+    // tables etc. but we don't have a nice way to disallow those things so
+    // for now we pass null and it will segfault if an illegal sindex
+    // mapping is passed.
+    cond_t non_interruptor;
+    ql::env_t env(NULL, &non_interruptor);
+
+    if (counting) {
+        counting_deltas_t deltas;
+        for (auto it = modifications->begin(); it != modifications->end(); ++it) {
+            const rdb_modification_report_t *modification = *it;
+            guarantee(modification->primary_key.size() != 0);
+            if (modification->info.deleted.first) {
+                add_counting_deltas(modification->info.deleted.first, &mapping, multi,
+                                    &env, -1, &deltas);
+            }
+            if (modification->info.added.first) {
+                add_counting_deltas(modification->info.added.first, &mapping, multi,
+                                    &env, 1, &deltas);
+            }
+        }
+        apply_counting_deltas(sindex, &deltas, lock);
+        if (release_superblock == release_sindex_superblocks_t::YES) {
+            sindex->super_block->release();
+        }
+        return;
+    }
 
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
+    std::vector<sindex_change_t> changes;
+    for (auto it = modifications->begin(); it != modifications->end(); ++it) {
+        const rdb_modification_report_t *modification = *it;
+        // Note if you get this error it's likely that you've passed in a default
+        // constructed mod_report. Don't do that.  Mod reports should always be passed
+        // to a function as an output parameter before they're passed to this
+        // function.
+        guarantee(modification->primary_key.size() != 0);
+
+        sindex_entries_t deleted_entries;
+        if (modification->info.deleted.first) {
+            guarantee(!modification->info.deleted.second.empty());
+            compute_sindex_entries(modification->primary_key,
+                                   modification->info.deleted.first,
+                                   &mapping, multi, covered_fields, &env,
+                                   &deleted_entries);
+        }
 
-                    find_keyvalue_location_for_write(super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
+        sindex_entries_t added_entries;
+        if (modification->info.added.first) {
+            compute_sindex_entries(modification->primary_key,
+                                   modification->info.added.first,
+                                   &mapping, multi, covered_fields, &env,
+                                   &added_entries);
+        }
 
-                    kv_location_set(&kv_location, *it,
-                                    modification->info.added.second,
-                                    repli_timestamp_t::distant_past);
-                    // The keyvalue location gets destroyed here.
+        // Entries pointing at the row have to be rewritten even if their key didn't
+        // change, unless the row still has the same value ref.  Covering entries only
+        // have to be rewritten if they changed.
+        const bool same_value_ref
+            = modification->info.deleted.second == modification->info.added.second;
+        auto deleted_it = deleted_entries.begin();
+        for (auto jt = added_entries.begin(); jt != added_entries.end(); ++jt) {
+            for (; deleted_it != deleted_entries.end() && deleted_it->first < jt->first;
+                 ++deleted_it) {
+                changes.push_back(sindex_change_t(deleted_it->first, NULL));
+            }
+            if (deleted_it != deleted_entries.end() && deleted_it->first == jt->first) {
+                const counted_t<const ql::datum_t> &old_entry = deleted_it->second;
+                ++deleted_it;
+                if (jt->second.has()
+                    ? old_entry.has() && *old_entry == *jt->second
+                    : !old_entry.has() && same_value_ref) {
+                    continue;
                 }
-                super_block = return_superblock_local.wait();
             }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (we just drop the row from the index).
+            if (jt->second.has()) {
+                changes.push_back(sindex_change_t(jt->first, jt->second));
+            } else {
+                changes.push_back(sindex_change_t(jt->first,
+                                                  &modification->info.added.second));
+            }
+        }
+        for (; deleted_it != deleted_entries.end(); ++deleted_it) {
+            changes.push_back(sindex_change_t(deleted_it->first, NULL));
         }
     }
+
+    sort_sindex_changes(&changes);
+    apply_sindex_changes(sindex, &changes, lock);
+    if (release_superblock == release_sindex_superblocks_t::YES) {
+        // The next write can go ahead on this index while we finish the others.
+        sindex->super_block->release();
+    }
 }
 
 void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
-                         const rdb_modification_report_t *modification,
-                         txn_t *txn) {
+                         const std::vector<const rdb_modification_report_t *> &modifications,
+                         txn_t *txn,
+                         release_sindex_superblocks_t release_superblocks) {
     {
         auto_drainer_t drainer;
 
@@ -1079,22 +1921,50 @@ void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
                                                     ++it) {
             coro_t::spawn_sometime(std::bind(
                         &rdb_update_single_sindex, &*it,
-                        modification, auto_drainer_t::lock_t(&drainer)));
+                        &modifications, release_superblocks,
+                        auto_drainer_t::lock_t(&drainer)));
         }
     }
 
     /* All of the sindex have been updated now it's time to actually clear the
-     * deleted blob if it exists. */
-    if (modification->info.deleted.first) {
-        // Deleting the value unfortunately updates the ref in-place as it operates, so
-        // we need to make a copy of the blob reference that is extended to the
-        // appropriate width.
-        std::vector<char> ref_cpy(modification->info.deleted.second);
-        ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
-        guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
+     * deleted blobs if they exist. */
+    for (auto it = modifications.begin(); it != modifications.end(); ++it) {
+        const rdb_modification_report_t *modification = *it;
+        // A row that was patched in place (see kv_location_patch) still uses its
+        // blob.
+        if (modification->info.deleted.first
+            && modification->info.deleted.second != modification->info.added.second) {
+            // Deleting the value unfortunately updates the ref in-place as it
+            // operates, so we need to make a copy of the blob reference that is
+            // extended to the appropriate width.
+            std::vector<char> ref_cpy(modification->info.deleted.second);
+            ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
+            guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
+
+            actually_delete_rdb_value(buf_parent_t(txn), ref_cpy.data());
+        }
+    }
+}
 
-        actually_delete_rdb_value(buf_parent_t(txn), ref_cpy.data());
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+                         const rdb_modification_report_t *modification,
+                         txn_t *txn,
+                         release_sindex_superblocks_t release_superblocks) {
+    rdb_update_sindexes(
+        sindexes, std::vector<const rdb_modification_report_t *>(1, modification), txn,
+        release_superblocks);
+}
+
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+                         const std::vector<rdb_modification_report_t> &modifications,
+                         txn_t *txn,
+                         release_sindex_superblocks_t release_superblocks) {
+    std::vector<const rdb_modification_report_t *> pointers;
+    pointers.reserve(modifications.size());
+    for (auto it = modifications.begin(); it != modifications.end(); ++it) {
+        pointers.push_back(&*it);
     }
+    rdb_update_sindexes(sindexes, pointers, txn, release_superblocks);
 }
 
 void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
@@ -1107,22 +1977,99 @@ void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
                               false /* don't release the superblock */, interruptor);
 }
 
+/* The definition of a secondary index being post-constructed, deserialized once so
+ * that the leaves don't each have to do it again. */
+struct post_construct_sindex_t {
+    uuid_u id;
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi;
+    std::vector<std::string> covered_fields;
+    bool counting;
+};
+
 class post_construct_traversal_helper_t : public btree_traversal_helper_t {
 public:
     post_construct_traversal_helper_t(
             btree_store_t<rdb_protocol_t> *store,
             const std::set<uuid_u> &sindexes_to_post_construct,
+            std::vector<post_construct_sindex_t> *definitions,
             cond_t *interrupt_myself,
             signal_t *interruptor
             )
         : store_(store),
           sindexes_to_post_construct_(sindexes_to_post_construct),
+          definitions_(definitions),
           interrupt_myself_(interrupt_myself), interruptor_(interruptor)
     { }
 
     void process_a_leaf(buf_lock_t *leaf_node_buf,
                         const btree_key_t *, const btree_key_t *,
                         signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
+        // First we evaluate the index functions on the leaf's rows.  This is where
+        // the time goes, and we do it holding nothing but our snapshotted read of
+        // the leaf, so the traversal's coroutines can do it for many leaves at once
+        // without getting in the way of writes to the table.
+        // The rows' value refs go in a deque, so that the changes can point into it
+        // as it grows.
+        std::deque<std::vector<char> > value_refs;
+        std::vector<std::vector<sindex_change_t> > changes(definitions_->size());
+        // Counting indexes get the leaf's counts instead.
+        std::vector<counting_deltas_t> deltas(definitions_->size());
+        {
+            // TODO we just use a NULL environment here, like
+            // rdb_update_single_sindex does.
+            cond_t non_interruptor;
+            ql::env_t env(NULL, &non_interruptor);
+
+            buf_read_t leaf_read(leaf_node_buf);
+            const leaf_node_t *leaf_node
+                = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
+            const block_size_t block_size = leaf_node_buf->cache()->get_block_size();
+
+            for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+                store_->btree->stats.pm_keys_read.record();
+
+                /* Grab relevant values from the leaf node. */
+                const btree_key_t *key = (*it).first;
+                const void *value = (*it).second;
+                guarantee(key);
+
+                store_key_t pk(key);
+                const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
+                counted_t<const ql::datum_t> doc
+                    = get_data(rdb_value, buf_parent_t(leaf_node_buf));
+                value_refs.push_back(std::vector<char>(rdb_value->value_ref(),
+                    rdb_value->value_ref() + rdb_value->inline_size(block_size)));
+
+                for (size_t i = 0; i < definitions_->size(); ++i) {
+                    post_construct_sindex_t *definition = &(*definitions_)[i];
+                    if (definition->counting) {
+                        add_counting_deltas(doc, &definition->mapping,
+                                            definition->multi, &env, 1, &deltas[i]);
+                        continue;
+                    }
+                    sindex_entries_t entries;
+                    compute_sindex_entries(pk, doc, &definition->mapping,
+                                           definition->multi,
+                                           definition->covered_fields, &env, &entries);
+                    for (auto jt = entries.begin(); jt != entries.end(); ++jt) {
+                        if (jt->second.has()) {
+                            changes[i].push_back(sindex_change_t(jt->first, jt->second));
+                        } else {
+                            changes[i].push_back(sindex_change_t(jt->first,
+                                                                 &value_refs.back()));
+                        }
+                    }
+                }
+                // Let live traffic (and the other leaves) have a turn between rows.
+                coro_t::yield();
+            }
+        }
+
+        for (auto it = changes.begin(); it != changes.end(); ++it) {
+            sort_sindex_changes(&*it);
+        }
+
         write_token_pair_t token_pair;
         store_->new_write_token_pair(&token_pair);
 
@@ -1131,6 +2078,10 @@ public:
         btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes;
 
         try {
+            // Before taking the write locks, so that we don't hold them while
+            // waiting.
+            wait_for_background_turn(interruptor_);
+
             scoped_ptr_t<real_superblock_t> superblock;
 
             // We want soft durability because having a partially constructed
@@ -1167,30 +2118,24 @@ public:
             return;
         }
 
-        buf_read_t leaf_read(leaf_node_buf);
-        const leaf_node_t *leaf_node
-            = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
-
-        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
-            store_->btree->stats.pm_keys_read.record();
-
-            /* Grab relevant values from the leaf node. */
-            const btree_key_t *key = (*it).first;
-            const void *value = (*it).second;
-            guarantee(key);
-
-            store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
-            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
-            const block_size_t block_size = leaf_node_buf->cache()->get_block_size();
-            mod_report.info.added
-                = std::make_pair(
-                    get_data(rdb_value, buf_parent_t(leaf_node_buf)),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
-
-            rdb_update_sindexes(sindexes, &mod_report, wtxn.get());
-            coro_t::yield();
+        // Then we merge each index's sorted run into its btree.  (Indexes that have
+        // been dropped since we started have no superblock here and are skipped.)
+        auto_drainer_t drainer;
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            for (size_t i = 0; i < definitions_->size(); ++i) {
+                if ((*definitions_)[i].id != it->sindex.id) {
+                    continue;
+                }
+                if ((*definitions_)[i].counting) {
+                    coro_t::spawn_sometime(std::bind(
+                                &apply_counting_deltas, &*it, &deltas[i],
+                                auto_drainer_t::lock_t(&drainer)));
+                } else {
+                    coro_t::spawn_sometime(std::bind(
+                                &apply_sindex_changes, &*it, &changes[i],
+                                auto_drainer_t::lock_t(&drainer)));
+                }
+            }
         }
     }
 
@@ -1210,6 +2155,7 @@ public:
 
     btree_store_t<rdb_protocol_t> *store_;
     const std::set<uuid_u> &sindexes_to_post_construct_;
+    std::vector<post_construct_sindex_t> *definitions_;
     cond_t *interrupt_myself_;
     signal_t *interruptor_;
 };
@@ -1223,8 +2169,11 @@ void post_construct_secondary_indexes(
 
     wait_any_t wait_any(&local_interruptor, interruptor);
 
+    // Filled in below, once we have the superblock.
+    std::vector<post_construct_sindex_t> definitions;
+
     post_construct_traversal_helper_t helper(store,
-            sindexes_to_post_construct, &local_interruptor, interruptor);
+            sindexes_to_post_construct, &definitions, &local_interruptor, interruptor);
     /* Notice the ordering of progress_tracker and insertion_sentries matters.
      * insertion_sentries puts pointers in the progress tracker map. Once
      * insertion_sentries is destructed nothing has a reference to
@@ -1258,8 +2207,31 @@ void post_construct_secondary_indexes(
         interruptor,
         true /* USE_SNAPSHOT */);
 
+    {
+        buf_lock_t sindex_block
+            = store->acquire_sindex_block_for_read(superblock->expose_buf(),
+                                                   superblock->get_sindex_block_id());
+        std::map<std::string, secondary_index_t> sindexes;
+        get_secondary_indexes(&sindex_block, &sindexes);
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            if (sindexes_to_post_construct.count(it->second.id) == 1) {
+                definitions.push_back(post_construct_sindex_t());
+                definitions.back().id = it->second.id;
+                deserialize_sindex_definition(it->second.opaque_definition,
+                                              &definitions.back().mapping,
+                                              &definitions.back().multi,
+                                              &definitions.back().covered_fields,
+                                              &definitions.back().counting);
+            }
+        }
+    }
+
     cache_account
-        = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
+        = txn->cache()->create_cache_account(
+            SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY,
+            0,
+            txn->cache()->memory_limit() / 100
+                * SINDEX_POST_CONSTRUCTION_CACHE_MEMORY_LIMIT_PERCENT);
     txn->set_account(&cache_account);
 
     btree_parallel_traversal(superblock.get(), &helper, &wait_any);
@@ -85,6 +85,15 @@ void rdb_get(
     point_read_response_t *response,
     profile::trace_t *trace);
 
+// Looks up several keys under one superblock acquisition.  `rows_out` gets a row
+// for each key, in order, which is null if the key doesn't exist.
+void rdb_get_batch(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    superblock_t *superblock,
+    std::vector<counted_t<const ql::datum_t> > *rows_out,
+    profile::trace_t *trace);
+
 enum return_vals_t {
     NO_RETURN_VALS = 0,
     RETURN_VALS = 1
@@ -104,20 +113,6 @@ struct btree_info_t {
     const std::string *primary_key;
 };
 
-struct btree_loc_info_t {
-    btree_loc_info_t(const btree_info_t *_btree,
-                     superblock_t *_superblock,
-                     const store_key_t *_key)
-        : btree(_btree), superblock(_superblock), key(_key) {
-        guarantee(btree != NULL);
-        guarantee(superblock != NULL);
-        guarantee(key != NULL);
-    }
-    const btree_info_t *const btree;
-    superblock_t *const superblock;
-    const store_key_t *const key;
-};
-
 struct btree_batched_replacer_t {
     virtual ~btree_batched_replacer_t() { }
     virtual counted_t<const ql::datum_t> replace(
@@ -187,11 +182,15 @@ class rdb_value_detacher_t : public value_deleter_t {
     void delete_value(buf_parent_t parent, void *value);
 };
 
+/* If reclaimer is non-NULL, tester must erase every key in the range, and the
+subtrees inside the range are cut out and left to the reclaimer to free (see
+btree_erase_range_generic). */
 void rdb_erase_range(key_tester_t *tester,
                      const key_range_t &keys,
                      buf_lock_t *sindex_block,
                      superblock_t *superblock,
                      btree_store_t<rdb_protocol_t> *store,
+                     detached_subtree_reclaimer_t *reclaimer,
                      signal_t *interruptor);
 
 /* RGETS */
@@ -221,6 +220,8 @@ void rdb_rget_secondary_slice(
     sorting_t sorting,
     const ql::map_wire_func_t &sindex_func,
     sindex_multi_bool_t sindex_multi,
+    const std::vector<std::string> &covered_fields,
+    bool counting,
     rget_read_response_t *response);
 
 void rdb_distribution_get(int max_depth,
@@ -228,6 +229,12 @@ void rdb_distribution_get(int max_depth,
                           superblock_t *superblock,
                           distribution_read_response_t *response);
 
+void rdb_distribution_sample(int sample_count,
+                             int bucket_count,
+                             const store_key_t &left_key,
+                             superblock_t *superblock,
+                             distribution_read_response_t *response);
+
 /* Secondary Indexes */
 
 struct rdb_modification_info_t {
@@ -268,12 +275,17 @@ typedef boost::variant<rdb_modification_report_t,
  * modify the secondary while they perform an operation. */
 class rdb_modification_report_cb_t {
 public:
+    // The changes go to changefeed_server too, unless it's NULL.
     rdb_modification_report_cb_t(
             btree_store_t<rdb_protocol_t> *store,
+            ql::changefeed::server_t *changefeed_server,
             buf_lock_t *sindex_block,
             auto_drainer_t::lock_t lock);
 
     void on_mod_report(const rdb_modification_report_t &mod_report);
+    // Like calling on_mod_report on each of mod_reports in turn, but the secondary
+    // indexes are updated for all of them at once.
+    void on_mod_reports(const std::vector<rdb_modification_report_t> &mod_reports);
 
     ~rdb_modification_report_cb_t();
 
@@ -281,16 +293,90 @@ private:
     /* Fields initialized by the constructor. */
     auto_drainer_t::lock_t lock_;
     btree_store_t<rdb_protocol_t> *store_;
+    ql::changefeed::server_t *changefeed_server_;
     buf_lock_t *sindex_block_;
 
     /* Fields initialized by calls to on_mod_report */
     btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes_;
 };
 
+// Passes the rows the reports changed on to the changefeeds subscribed to
+// changefeed_server, unless it's NULL.
+void rdb_send_changes(ql::changefeed::server_t *changefeed_server,
+                      const std::vector<rdb_modification_report_t> &mod_reports);
+
+/* Puts `mod_reports` on the sindex queues, gets in line for the superblocks of the
+ * post-constructed secondary indexes and sends the changes to `changefeed_server`,
+ * then releases `sindex_block`.  Once a write is in line for every index's
+ * superblock no later write can overtake it on any of them, so the next write can
+ * take the sindex block and get in line behind it while it updates the indexes.
+ * Pass `release_sindex_superblocks_t::YES` to `rdb_update_sindexes` afterwards, so
+ * that the next write can update each index as soon as this one is done with it.
+ * Each index still gets the writes in the order they took the sindex block, so the
+ * changes to a key are applied in order. */
+void rdb_queue_sindex_changes(
+        btree_store_t<rdb_protocol_t> *store,
+        ql::changefeed::server_t *changefeed_server,
+        buf_lock_t *sindex_block,
+        const std::vector<rdb_modification_report_t> &mod_reports,
+        btree_store_t<rdb_protocol_t>::sindex_access_vector_t *sindexes_out);
+
+/* Makes the definition of an index whose keys are in the compact format. */
+secondary_index_t::opaque_definition_t serialize_sindex_definition(
+        const ql::map_wire_func_t &mapping, sindex_multi_bool_t multi,
+        const std::vector<std::string> &covered_fields, bool counting,
+        const std::string &expiry_pkey);
+
+/* Reads the definition an index was created with.  covered_fields_out gets the fields
+ * the rows read through the index are projected to, and is empty unless the index is
+ * a covering index.  counting_out is set if the index is a counting index, which keeps
+ * the number of rows for each index value instead of the rows.  expiry_pkey_out is
+ * the table's primary key if the index is an expiry index, and empty otherwise.
+ * key_format_out is the format of the index's keys. */
+void deserialize_sindex_definition(
+        const secondary_index_t::opaque_definition_t &definition,
+        ql::map_wire_func_t *mapping_out, sindex_multi_bool_t *multi_out,
+        std::vector<std::string> *covered_fields_out, bool *counting_out,
+        std::string *expiry_pkey_out, ql::key_format_t *key_format_out);
+void deserialize_sindex_definition(
+        const secondary_index_t::opaque_definition_t &definition,
+        ql::map_wire_func_t *mapping_out, sindex_multi_bool_t *multi_out,
+        std::vector<std::string> *covered_fields_out, bool *counting_out,
+        std::string *expiry_pkey_out);
+void deserialize_sindex_definition(
+        const secondary_index_t::opaque_definition_t &definition,
+        ql::map_wire_func_t *mapping_out, sindex_multi_bool_t *multi_out,
+        std::vector<std::string> *covered_fields_out, bool *counting_out);
+
+bool sindex_is_counting(const secondary_index_t &sindex);
+
+ql::key_format_t sindex_key_format(const secondary_index_t &sindex);
+
+/* The projection of `doc` that a covering index stores. */
+counted_t<const ql::datum_t> project_covered_fields(
+        counted_t<const ql::datum_t> doc,
+        const std::vector<std::string> &covered_fields);
+
+// Whether `rdb_update_sindexes` releases each index's superblock as soon as it's
+// done with that index.  Callers that use the superblocks again keep them.
+enum class release_sindex_superblocks_t { NO, YES };
+
 void rdb_update_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
         const rdb_modification_report_t *modification,
-        txn_t *txn);
+        txn_t *txn,
+        release_sindex_superblocks_t release_superblocks
+            = release_sindex_superblocks_t::NO);
+
+/* Updates the secondary indexes for a batch of modifications.  This computes all the
+ * old and new index keys first and applies them to each index in key order, so that
+ * keys sharing a leaf of the index share a walk down it. */
+void rdb_update_sindexes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &modifications,
+        txn_t *txn,
+        release_sindex_superblocks_t release_superblocks
+            = release_sindex_superblocks_t::NO);
 
 
 void rdb_erase_range_sindexes(
@@ -307,7 +393,8 @@ void post_construct_secondary_indexes(
 class rdb_value_deleter_t : public value_deleter_t {
     friend void rdb_update_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
-        const rdb_modification_report_t *modification, txn_t *txn);
+        const rdb_modification_report_t *modification, txn_t *txn,
+        release_sindex_superblocks_t release_superblocks);
 
     void delete_value(buf_parent_t parent, void *_value);
 };
@@ -0,0 +1,333 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/changefeed.hpp"
+
+#include <functional>
+#include <set>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "containers/archive/boost_types.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/val.hpp"
+
+namespace ql {
+namespace changefeed {
+
+change_t::change_t(counted_t<const datum_t> _old_val, counted_t<const datum_t> _new_val)
+    : old_val(_old_val.has() ? _old_val : make_counted<const datum_t>(datum_t::R_NULL)),
+      new_val(_new_val.has() ? _new_val : make_counted<const datum_t>(datum_t::R_NULL)) { }
+
+counted_t<const datum_t> change_t::to_datum() const {
+    std::map<std::string, counted_t<const datum_t> > obj;
+    obj["old_val"] = old_val;
+    obj["new_val"] = new_val;
+    return make_counted<const datum_t>(std::move(obj));
+}
+
+RDB_IMPL_ME_SERIALIZABLE_2(change_t, old_val, new_val);
+RDB_IMPL_ME_SERIALIZABLE_1(msg_t::change_batch_t, changes);
+RDB_IMPL_ME_SERIALIZABLE_1(msg_t::stop_t, reason);
+RDB_IMPL_ME_SERIALIZABLE_1(msg_t, op);
+
+// These run in their own coroutines, so that whoever sends the message doesn't
+// wait for it to go out.
+static void send_msg(mailbox_manager_t *manager, client_addr_t addr, msg_t msg) {
+    send(manager, addr, msg);
+}
+
+static void send_unsubscribe(mailbox_manager_t *manager, server_t::addr_t addr,
+                             client_addr_t client_addr) {
+    send(manager, addr, client_addr);
+}
+
+struct server_t::client_info_t {
+    client_info_t(mailbox_manager_t *manager, const client_addr_t &_addr)
+        : addr(_addr),
+          disconnected(manager->get_connectivity_service(), addr.get_peer()) { }
+
+    client_addr_t addr;
+    // The client is dropped once its machine goes away, since it can't unsubscribe.
+    disconnect_watcher_t disconnected;
+};
+
+server_t::server_t(mailbox_manager_t *_manager)
+    : manager(_manager),
+      sending(false),
+      stop_mailbox(manager, std::bind(&server_t::stop_client, this,
+                                      std::placeholders::_1)) { }
+
+server_t::~server_t() {
+    stop_all("The table's data moved, e.g. because the table was dropped or "
+             "resharded.");
+}
+
+void server_t::add_client(const client_addr_t &addr) {
+    assert_thread();
+    clients.push_back(make_scoped<client_info_t>(manager, addr));
+}
+
+server_t::addr_t server_t::get_stop_addr() {
+    return stop_mailbox.get_address();
+}
+
+void server_t::send_changes(std::vector<change_t> &&changes) {
+    assert_thread();
+    if (clients.empty() || changes.empty()) {
+        return;
+    }
+    if (queue.size() >= CHANGEFEED_SERVER_QUEUE_SIZE) {
+        stop_all("The changefeed fell too far behind the writes to the table.");
+        return;
+    }
+    msg_t::change_batch_t batch;
+    batch.changes = std::move(changes);
+    queue.push_back(msg_t(std::move(batch)));
+    if (!sending) {
+        sending = true;
+        coro_t::spawn_sometime(std::bind(&server_t::send_loop, this,
+                                         auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+void server_t::stop_client(const client_addr_t &addr) {
+    assert_thread();
+    for (auto it = clients.begin(); it != clients.end(); ++it) {
+        if ((*it)->addr == addr) {
+            clients.erase(it);
+            return;
+        }
+    }
+}
+
+void server_t::stop_all(const std::string &reason) {
+    assert_thread();
+    queue.clear();
+    for (auto it = clients.begin(); it != clients.end(); ++it) {
+        msg_t::stop_t stop;
+        stop.reason = reason;
+        coro_t::spawn_sometime(std::bind(&send_msg, manager, (*it)->addr,
+                                         msg_t(std::move(stop))));
+    }
+    clients.clear();
+}
+
+void server_t::send_loop(auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    while (!queue.empty() && !keepalive.get_drain_signal()->is_pulsed()) {
+        msg_t msg = std::move(queue.front());
+        queue.pop_front();
+        // Clients may come and go while we send, so we send to the ones there were
+        // when we started.
+        std::vector<client_addr_t> addrs;
+        for (auto it = clients.begin(); it != clients.end();) {
+            if ((*it)->disconnected.is_pulsed()) {
+                it = clients.erase(it);
+            } else {
+                addrs.push_back((*it)->addr);
+                ++it;
+            }
+        }
+        for (auto it = addrs.begin(); it != addrs.end(); ++it) {
+            send(manager, *it, msg);
+        }
+    }
+    sending = false;
+}
+
+class subscription_t;
+
+// The subscription of one thread of the parsing node to the changes of one table.
+// It belongs to the streams it passes the changes on to.
+class feed_t : public single_threaded_countable_t<feed_t> {
+public:
+    feed_t(client_t *client, mailbox_manager_t *manager, env_t *env, table_t *tbl);
+    ~feed_t();
+
+    void add_sub(subscription_t *sub);
+    void del_sub(subscription_t *sub);
+
+private:
+    void on_msg(const msg_t &msg);
+
+    client_t *const client;
+    mailbox_manager_t *const manager;
+    const uuid_u table_id;
+    std::set<subscription_t *> subs;
+    bool stopped;
+    mailbox_t<void(msg_t)> mailbox;
+    // Where to unsubscribe from each store of the table.
+    std::vector<server_t::addr_t> stop_addrs;
+
+    DISABLE_COPYING(feed_t);
+};
+
+// The stream `table.changes()` returns.  It never ends, and waits for a change to
+// come in if there's none to return.
+class subscription_t : public eager_datum_stream_t {
+public:
+    subscription_t(counted_t<feed_t> _feed, const protob_t<const Backtrace> &bt)
+        : eager_datum_stream_t(bt), feed(_feed), waiter(NULL) {
+        feed->add_sub(this);
+    }
+    ~subscription_t() {
+        feed->del_sub(this);
+    }
+
+    virtual bool is_exhausted() const { return false; }
+
+    void add_changes(const std::vector<change_t> &changes) {
+        if (error) {
+            return;
+        }
+        if (queue.size() + changes.size() > CHANGEFEED_CLIENT_QUEUE_SIZE) {
+            queue.clear();
+            error = strprintf("The changefeed fell more than %d changes behind the "
+                              "writes to the table.", CHANGEFEED_CLIENT_QUEUE_SIZE);
+        } else {
+            for (auto it = changes.begin(); it != changes.end(); ++it) {
+                queue.push_back(it->to_datum());
+            }
+        }
+        wake();
+    }
+
+    // The changes that came before `reason` can still be read.
+    void stop(const std::string &reason) {
+        if (!error) {
+            error = "The changefeed stopped: " + reason;
+            wake();
+        }
+    }
+
+private:
+    virtual bool is_array() { return false; }
+
+    virtual std::vector<counted_t<const datum_t> >
+    next_raw_batch(env_t *env, const batchspec_t &bs) {
+        while (queue.empty() && !error) {
+            cond_t ready;
+            assignment_sentry_t<cond_t *> sentry(&waiter, &ready);
+            wait_interruptible(&ready, env->interruptor);
+        }
+        rcheck(!queue.empty(), base_exc_t::GENERIC, *error);
+        // We return whatever has arrived, rather than wait for a full batch.
+        batcher_t batcher = bs.to_batcher();
+        std::vector<counted_t<const datum_t> > batch;
+        while (!queue.empty() && !batcher.should_send_batch()) {
+            batcher.note_el(queue.front());
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        return batch;
+    }
+
+    void wake() {
+        if (waiter != NULL) {
+            waiter->pulse_if_not_already_pulsed();
+        }
+    }
+
+    const counted_t<feed_t> feed;
+    std::deque<counted_t<const datum_t> > queue;
+    // Why there are no more changes after the ones in `queue`.
+    boost::optional<std::string> error;
+    // Pulsed when there's something for `next_raw_batch` to return.
+    cond_t *waiter;
+};
+
+feed_t::feed_t(client_t *_client, mailbox_manager_t *_manager, env_t *env,
+               table_t *tbl)
+    : client(_client),
+      manager(_manager),
+      table_id(tbl->get_uuid()),
+      stopped(false),
+      mailbox(manager, std::bind(&feed_t::on_msg, this, std::placeholders::_1)) {
+    stop_addrs = tbl->changefeed_subscribe(env, mailbox.get_address());
+}
+
+feed_t::~feed_t() {
+    guarantee(subs.empty());
+    if (!stopped) {
+        client->remove_feed(table_id, this);
+    }
+    for (auto it = stop_addrs.begin(); it != stop_addrs.end(); ++it) {
+        coro_t::spawn_sometime(std::bind(&send_unsubscribe, manager, *it,
+                                         mailbox.get_address()));
+    }
+}
+
+void feed_t::add_sub(subscription_t *sub) {
+    subs.insert(sub);
+}
+
+void feed_t::del_sub(subscription_t *sub) {
+    size_t erased = subs.erase(sub);
+    guarantee(erased == 1);
+}
+
+void feed_t::on_msg(const msg_t &msg) {
+    if (stopped) {
+        return;
+    }
+    if (const msg_t::change_batch_t *batch = boost::get<msg_t::change_batch_t>(&msg.op)) {
+        for (auto it = subs.begin(); it != subs.end(); ++it) {
+            (*it)->add_changes(batch->changes);
+        }
+    } else {
+        const msg_t::stop_t *stop = boost::get<msg_t::stop_t>(&msg.op);
+        guarantee(stop != NULL);
+        // The other stores keep sending, but without this one's changes the feed is
+        // incomplete.  New changefeeds get a feed of their own.
+        stopped = true;
+        client->remove_feed(table_id, this);
+        for (auto it = subs.begin(); it != subs.end(); ++it) {
+            (*it)->stop(stop->reason);
+        }
+    }
+}
+
+client_t::client_t(mailbox_manager_t *_manager)
+    : manager(_manager), feeds(get_num_threads()) { }
+
+client_t::~client_t() {
+    for (size_t i = 0; i < feeds.size(); ++i) {
+        guarantee(feeds[i].empty());
+    }
+}
+
+counted_t<datum_stream_t> client_t::new_stream(env_t *env,
+                                               const counted_t<table_t> &tbl,
+                                               const protob_t<const Backtrace> &bt) {
+    std::map<uuid_u, feed_t *> *thread_feeds = &feeds[get_thread_id().threadnum];
+    counted_t<feed_t> feed;
+    auto it = thread_feeds->find(tbl->get_uuid());
+    if (it != thread_feeds->end()) {
+        feed = counted_t<feed_t>(it->second);
+    } else {
+        feed = make_counted<feed_t>(this, manager, env, tbl.get());
+        // Another changefeed may have subscribed while we did.
+        it = thread_feeds->find(tbl->get_uuid());
+        if (it != thread_feeds->end()) {
+            feed = counted_t<feed_t>(it->second);
+        } else {
+            thread_feeds->insert(std::make_pair(tbl->get_uuid(), feed.get()));
+        }
+    }
+    return make_counted<subscription_t>(feed, bt);
+}
+
+void client_t::remove_feed(const uuid_u &table_id, feed_t *feed) {
+    std::map<uuid_u, feed_t *> *thread_feeds = &feeds[get_thread_id().threadnum];
+    auto it = thread_feeds->find(table_id);
+    if (it != thread_feeds->end() && it->second == feed) {
+        thread_feeds->erase(it);
+    }
+}
+
+}  // namespace changefeed
+}  // namespace ql
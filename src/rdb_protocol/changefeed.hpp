@@ -0,0 +1,159 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_CHANGEFEED_HPP_
+#define RDB_PROTOCOL_CHANGEFEED_HPP_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/variant.hpp>
+
+#include "concurrency/auto_drainer.hpp"
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "containers/uuid.hpp"
+#include "rpc/connectivity/connectivity.hpp"
+#include "rpc/mailbox/typed.hpp"
+#include "rpc/serialize_macros.hpp"
+
+class Backtrace;
+
+namespace ql {
+
+class datum_t;
+class datum_stream_t;
+class env_t;
+template <class> class protob_t;
+class table_t;
+
+/* Changefeeds push the changes that writes make to a table to the queries that
+asked for them with `table.changes()`, instead of the queries polling for them.
+
+Each store of the table has a `server_t`.  When the write path modifies rows, it
+hands the old and new values of the rows to the server, which sends them as one
+batch to every client that subscribed to it.  The sending happens in the
+background, so the writes don't wait on the network.
+
+The parsing node has a `client_t`, which keeps one feed for each table on each
+thread.  A feed subscribes its mailbox to the servers of every shard of the table
+with a read, and passes the batches it gets on to the changefeed streams on its
+table.  The streams hand out what has arrived since they were last read, and block
+while nothing has.
+
+Neither end holds up the writes for a changefeed that can't keep up.  A server
+that has too many batches waiting to be sent, or a stream that has too many
+changes waiting to be read, stops the changefeed with an error instead (see
+`CHANGEFEED_SERVER_QUEUE_SIZE` and `CHANGEFEED_CLIENT_QUEUE_SIZE`). */
+namespace changefeed {
+
+// A change to one row.  `old_val` is null if the row was inserted, and `new_val` is
+// null if it was deleted.
+struct change_t {
+    change_t() { }
+    change_t(counted_t<const datum_t> _old_val, counted_t<const datum_t> _new_val);
+
+    // The `{old_val: ..., new_val: ...}` object the changefeed returns.
+    counted_t<const datum_t> to_datum() const;
+
+    counted_t<const datum_t> old_val, new_val;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
+struct msg_t {
+    // The rows one write changed on one store, in the order it changed them.
+    struct change_batch_t {
+        std::vector<change_t> changes;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+    // The server won't send any more changes, e.g. because its store went away
+    // when the table was dropped or resharded.
+    struct stop_t {
+        std::string reason;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    msg_t() { }
+    explicit msg_t(change_batch_t &&batch) : op(std::move(batch)) { }
+    explicit msg_t(stop_t &&stop) : op(std::move(stop)) { }
+
+    boost::variant<change_batch_t, stop_t> op;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
+typedef mailbox_addr_t<void(msg_t)> client_addr_t;
+
+// Sends the changes made to one store to the clients subscribed to it.  It lives on
+// the store's thread.
+class server_t : public home_thread_mixin_t {
+public:
+    // Where a client unsubscribes from the server.
+    typedef mailbox_addr_t<void(client_addr_t)> addr_t;
+
+    explicit server_t(mailbox_manager_t *manager);
+    // Tells the clients that their feed has stopped.
+    ~server_t();
+
+    void add_client(const client_addr_t &addr);
+    addr_t get_stop_addr();
+
+    // Writes only collect their changes if somebody wants them.
+    bool has_clients() const { return !clients.empty(); }
+    void send_changes(std::vector<change_t> &&changes);
+
+private:
+    struct client_info_t;
+
+    void stop_client(const client_addr_t &addr);
+    void stop_all(const std::string &reason);
+    void send_loop(auto_drainer_t::lock_t keepalive);
+
+    mailbox_manager_t *const manager;
+    std::vector<scoped_ptr_t<client_info_t> > clients;
+
+    // The batches that haven't been sent yet, oldest first.  `send_loop` runs while
+    // there are any.
+    std::deque<msg_t> queue;
+    bool sending;
+
+    mailbox_t<void(client_addr_t)> stop_mailbox;
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(server_t);
+};
+
+class feed_t;
+
+// Creates the changefeed streams of the queries on the parsing node.
+class client_t {
+public:
+    explicit client_t(mailbox_manager_t *manager);
+    ~client_t();
+
+    // Subscribes to the changes of `tbl` (sharing the feed of any other changefeed
+    // on `tbl` on this thread), and returns the stream of them.
+    counted_t<datum_stream_t> new_stream(env_t *env, const counted_t<table_t> &tbl,
+                                         const protob_t<const Backtrace> &bt);
+
+private:
+    friend class feed_t;
+    // Called by a feed that new streams mustn't share any more, because it stopped
+    // or because its last stream went away.
+    void remove_feed(const uuid_u &table_id, feed_t *feed);
+
+    mailbox_manager_t *const manager;
+    // The feeds on each thread, by the id of their table.  The feeds belong to
+    // their streams.
+    scoped_array_t<std::map<uuid_u, feed_t *> > feeds;
+
+    DISABLE_COPYING(client_t);
+};
+
+}  // namespace changefeed
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_CHANGEFEED_HPP_
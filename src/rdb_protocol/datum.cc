@@ -3,15 +3,22 @@
 
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <new>
 
 #include "errors.hpp"
 #include <boost/detail/endian.hpp>
 
+#include "config/args.hpp"
 #include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/datum_json.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/pseudo_literal.hpp"
@@ -39,17 +46,45 @@ datum_t::datum_t(double _num) : type(R_NUM), r_num(_num) {
 }
 
 datum_t::datum_t(std::string &&_str)
-    : type(R_STR), r_str(wire_string_t::create_and_init(_str.size(), _str.data())) {
+    : type(R_STR), str_is_inline(false),
+      r_str(wire_string_t::create_and_init(_str.size(), _str.data())) {
     check_str_validity(r_str);
 }
 
 datum_t::datum_t(wire_string_t *str)
-    : type(R_STR), r_str(str) {
+    : type(R_STR), str_is_inline(false), r_str(str) {
     check_str_validity(r_str);
 }
 
 datum_t::datum_t(const char *cstr)
-    : type(R_STR), r_str(wire_string_t::create_and_init(::strlen(cstr), cstr)) { }
+    : type(R_STR), str_is_inline(false),
+      r_str(wire_string_t::create_and_init(::strlen(cstr), cstr)) { }
+
+datum_t::datum_t(inline_str_tag_t, const char *data, size_t size)
+    : type(R_STR), str_is_inline(true),
+      r_str(wire_string_t::create_in_place(this + 1, size, data)) {
+    check_str_validity(r_str);
+}
+
+counted_t<const datum_t> datum_t::create_inline_str(const char *data, size_t size) {
+    rassert(size <= MAX_INLINE_STR_SIZE);
+    void *memory = ::operator new(sizeof(datum_t) + wire_string_t::memory_size(size));
+    try {
+        return counted_t<const datum_t>(
+            ::new (memory) datum_t(inline_str_tag_t(), data, size));
+    } catch (...) {
+        ::operator delete(memory);
+        throw;
+    }
+}
+
+void *datum_t::operator new(size_t size) {
+    return ::operator new(size);
+}
+
+void datum_t::operator delete(void *p) {
+    ::operator delete(p);
+}
 
 datum_t::datum_t(std::vector<counted_t<const datum_t> > &&_array)
     : type(R_ARRAY),
@@ -59,15 +94,21 @@ datum_t::datum_t(std::vector<counted_t<const datum_t> > &&_array)
 
 datum_t::datum_t(std::map<std::string, counted_t<const datum_t> > &&_object)
     : type(R_OBJECT),
-      r_object(new std::map<std::string, counted_t<const datum_t> >(
-                   std::move(_object))) {
+      r_object(new datum_object_t(std::move(_object))) {
+    maybe_sanitize_ptype();
+}
+
+datum_t::datum_t(datum_object_t &&_object)
+    : type(R_OBJECT),
+      r_object(new datum_object_t(std::move(_object))) {
     maybe_sanitize_ptype();
 }
 
 datum_t::datum_t(grouped_data_t &&gd)
     : type(R_OBJECT),
-      r_object(new std::map<std::string, counted_t<const datum_t> >()) {
-    (*r_object)[reql_type_string] = make_counted<const datum_t>("GROUPED_DATA");
+      r_object(new datum_object_t()) {
+    r_object->set(reql_type_string, make_counted<const datum_t>("GROUPED_DATA"),
+                  CLOBBER);
     std::vector<counted_t<const datum_t> > v;
     v.reserve(gd.size());
     for (auto kv = gd.begin(); kv != gd.end(); ++kv) {
@@ -75,7 +116,7 @@ datum_t::datum_t(grouped_data_t &&gd)
                         std::vector<counted_t<const datum_t> >{
                             std::move(kv->first), std::move(kv->second)}));
     }
-    (*r_object)["data"] = make_counted<const datum_t>(std::move(v));
+    r_object->set("data", make_counted<const datum_t>(std::move(v)), CLOBBER);
     // We don't sanitize the ptype because this is a fake ptype that should only
     // be used for serialization.
 }
@@ -93,7 +134,7 @@ datum_t::datum_t(datum_t::type_t _type) : type(_type) {
         r_array = new std::vector<counted_t<const datum_t> >();
     } break;
     case R_OBJECT: {
-        r_object = new std::map<std::string, counted_t<const datum_t> >();
+        r_object = new datum_object_t();
     } break;
     case UNINITIALIZED: // fallthru
     default: unreachable();
@@ -106,8 +147,10 @@ datum_t::~datum_t() {
     case R_BOOL: // fallthru
     case R_NUM: break;
     case R_STR: {
-        r_sanity_check(r_str != NULL);
-        delete r_str;
+        if (!str_is_inline) {
+            r_sanity_check(r_str != NULL);
+            delete r_str;
+        }
     } break;
     case R_ARRAY: {
         r_sanity_check(r_array != NULL);
@@ -124,6 +167,7 @@ datum_t::~datum_t() {
 
 void datum_t::init_str(size_t size, const char *data) {
     type = R_STR;
+    str_is_inline = false;
     r_str = wire_string_t::create_and_init(size, data);
 }
 
@@ -134,7 +178,7 @@ void datum_t::init_array() {
 
 void datum_t::init_object() {
     type = R_OBJECT;
-    r_object = new std::map<std::string, counted_t<const datum_t> >();
+    r_object = new datum_object_t();
 }
 
 void datum_t::init_json(cJSON *json) {
@@ -171,12 +215,19 @@ void datum_t::init_json(cJSON *json) {
     } break;
     case cJSON_Object: {
         init_object();
+        // Sorting all the fields at once is cheaper than inserting them one by
+        // one into the sorted `datum_object_t`.
+        std::vector<datum_object_t::value_type> fields;
         json_object_iterator_t it(json);
         while (cJSON *item = it.next()) {
-            bool conflict = add(item->string, make_counted<datum_t>(item));
-            rcheck(!conflict, base_exc_t::GENERIC,
-                   strprintf("Duplicate key `%s` in JSON.", item->string));
+            check_str_validity(item->string);
+            fields.push_back(std::make_pair(std::string(item->string),
+                                            make_counted<const datum_t>(item)));
         }
+        std::string duplicate;
+        bool unique = r_object->assign_unsorted(std::move(fields), &duplicate);
+        rcheck(unique, base_exc_t::GENERIC,
+               strprintf("Duplicate key `%s` in JSON.", duplicate.c_str()));
         maybe_sanitize_ptype();
     } break;
     default: unreachable();
@@ -215,7 +266,7 @@ datum_t::datum_t(const scoped_cJSON_t &json) {
 datum_t::type_t datum_t::get_type() const { return type; }
 
 bool datum_t::is_ptype() const {
-    return type == R_OBJECT && std_contains(*r_object, reql_type_string);
+    return type == R_OBJECT && r_object->count(reql_type_string) > 0;
 }
 
 bool datum_t::is_ptype(const std::string &reql_type) const {
@@ -270,10 +321,10 @@ std::string datum_t::trunc_print() const {
     return s;
 }
 
-void datum_t::pt_to_str_key(std::string *str_out) const {
+void datum_t::pt_to_str_key(key_format_t format, std::string *str_out) const {
     r_sanity_check(is_ptype());
     if (get_reql_type() == pseudo::time_string) {
-        pseudo::time_to_str_key(*this, str_out);
+        pseudo::time_to_str_key(*this, format, str_out);
     } else {
         rfail(base_exc_t::GENERIC,
               "Cannot use psuedotype %s as a primary or secondary key value .",
@@ -281,7 +332,7 @@ void datum_t::pt_to_str_key(std::string *str_out) const {
     }
 }
 
-void datum_t::num_to_str_key(std::string *str_out) const {
+void datum_t::num_to_str_key(key_format_t format, std::string *str_out) const {
     r_sanity_check(type == R_NUM);
     str_out->append("N");
     union {
@@ -304,6 +355,15 @@ void datum_t::num_to_str_key(std::string *str_out) const {
         // highest bit flipped as well).
         packed.u ^= (1ULL << 63);
     }
+    if (format == key_format_t::COMPACT) {
+        // Big-endian, so that the bytes compare like the mangled value.  The
+        // encoding has a fixed width, so its zero bytes can't be confused with the
+        // terminators of the array elements in array_to_str_key.
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            str_out->push_back(static_cast<char>((packed.u >> shift) & 0xFF));
+        }
+        return;
+    }
     // The formatting here is sensitive.  Talk to mlucy before changing it.
     str_out->append(strprintf("%.*" PRIx64, static_cast<int>(sizeof(double)*2), packed.u));
     str_out->append(strprintf("#" DBLPRI, as_num()));
@@ -328,7 +388,7 @@ void datum_t::bool_to_str_key(std::string *str_out) const {
 // The key for an array is stored as a string of all its elements, each separated by a
 //  null character, with another null character at the end to signify the end of the
 //  array (this is necessary to prevent ambiguity when nested arrays are involved).
-void datum_t::array_to_str_key(std::string *str_out) const {
+void datum_t::array_to_str_key(key_format_t format, std::string *str_out) const {
     r_sanity_check(type == R_ARRAY);
     str_out->append("A");
 
@@ -337,13 +397,13 @@ void datum_t::array_to_str_key(std::string *str_out) const {
         r_sanity_check(item.has());
 
         switch (item->get_type()) {
-        case R_NUM: item->num_to_str_key(str_out); break;
+        case R_NUM: item->num_to_str_key(format, str_out); break;
         case R_STR: item->str_to_str_key(str_out); break;
         case R_BOOL: item->bool_to_str_key(str_out); break;
-        case R_ARRAY: item->array_to_str_key(str_out); break;
+        case R_ARRAY: item->array_to_str_key(format, str_out); break;
         case R_OBJECT:
             if (item->is_ptype()) {
-                item->pt_to_str_key(str_out);
+                item->pt_to_str_key(format, str_out);
                 break;
             }
             // fallthru
@@ -424,13 +484,13 @@ void datum_t::rcheck_valid_replace(counted_t<const datum_t> old_val,
 std::string datum_t::print_primary() const {
     std::string s;
     switch (get_type()) {
-    case R_NUM: num_to_str_key(&s); break;
+    case R_NUM: num_to_str_key(key_format_t::PRINTED, &s); break;
     case R_STR: str_to_str_key(&s); break;
     case R_BOOL: bool_to_str_key(&s); break;
-    case R_ARRAY: array_to_str_key(&s); break;
+    case R_ARRAY: array_to_str_key(key_format_t::PRINTED, &s); break;
     case R_OBJECT:
         if (is_ptype()) {
-            pt_to_str_key(&s);
+            pt_to_str_key(key_format_t::PRINTED, &s);
             break;
         }
         // fallthru
@@ -481,15 +541,15 @@ std::string datum_t::print_secondary(const store_key_t &primary_key,
     }
 
     if (type == R_NUM) {
-        num_to_str_key(&secondary_key_string);
+        num_to_str_key(key_format_t::COMPACT, &secondary_key_string);
     } else if (type == R_STR) {
         str_to_str_key(&secondary_key_string);
     } else if (type == R_BOOL) {
         bool_to_str_key(&secondary_key_string);
     } else if (type == R_ARRAY) {
-        array_to_str_key(&secondary_key_string);
+        array_to_str_key(key_format_t::COMPACT, &secondary_key_string);
     } else if (type == R_OBJECT && is_ptype()) {
-        pt_to_str_key(&secondary_key_string);
+        pt_to_str_key(key_format_t::COMPACT, &secondary_key_string);
     } else {
         type_error(strprintf(
             "Secondary keys must be a number, string, bool, pseudotype, or array "
@@ -571,15 +631,15 @@ boost::optional<uint64_t> datum_t::extract_tag(const store_key_t &key) {
 store_key_t datum_t::truncated_secondary() const {
     std::string s;
     if (type == R_NUM) {
-        num_to_str_key(&s);
+        num_to_str_key(key_format_t::COMPACT, &s);
     } else if (type == R_STR) {
         str_to_str_key(&s);
     } else if (type == R_BOOL) {
         bool_to_str_key(&s);
     } else if (type == R_ARRAY) {
-        array_to_str_key(&s);
+        array_to_str_key(key_format_t::COMPACT, &s);
     } else if (type == R_OBJECT && is_ptype()) {
-        pt_to_str_key(&s);
+        pt_to_str_key(key_format_t::COMPACT, &s);
     } else {
         type_error(strprintf(
             "Secondary keys must be a number, string, bool, or array "
@@ -679,7 +739,7 @@ void datum_t::change(size_t index, counted_t<const datum_t> val) {
            base_exc_t::NON_EXISTENCE,
            strprintf("Index `%zu` out of bounds for array of size: `%zu`.",
                      index, r_array->size()));
-    (*r_array)[index] = val;
+    (*r_array)[index] = std::move(val);
 }
 
 void datum_t::insert(size_t index, counted_t<const datum_t> val) {
@@ -688,7 +748,7 @@ void datum_t::insert(size_t index, counted_t<const datum_t> val) {
            base_exc_t::NON_EXISTENCE,
            strprintf("Index `%zu` out of bounds for array of size: `%zu`.",
                      index, r_array->size()));
-    r_array->insert(r_array->begin() + index, val);
+    r_array->insert(r_array->begin() + index, std::move(val));
 }
 
 void datum_t::erase(size_t index) {
@@ -743,8 +803,7 @@ counted_t<const datum_t> datum_t::get(size_t index, throw_bool_t throw_bool) con
 
 counted_t<const datum_t> datum_t::get(const std::string &key,
                                       throw_bool_t throw_bool) const {
-    std::map<std::string, counted_t<const datum_t> >::const_iterator it
-        = as_object().find(key);
+    datum_object_t::const_iterator it = as_object().find(key);
     if (it != as_object().end()) return it->second;
     if (throw_bool == THROW) {
         rfail(base_exc_t::NON_EXISTENCE,
@@ -753,7 +812,7 @@ counted_t<const datum_t> datum_t::get(const std::string &key,
     return counted_t<const datum_t>();
 }
 
-const std::map<std::string, counted_t<const datum_t> > &datum_t::as_object() const {
+const datum_object_t &datum_t::as_object() const {
     check_type(R_OBJECT);
     return *r_object;
 }
@@ -773,7 +832,7 @@ cJSON *datum_t::as_json_raw() const {
     } break;
     case R_OBJECT: {
         scoped_cJSON_t obj(cJSON_CreateObject());
-        for (std::map<std::string, counted_t<const datum_t> >::const_iterator
+        for (datum_object_t::const_iterator
                  it = r_object->begin(); it != r_object->end(); ++it) {
             obj.AddItemToObject(it->first.c_str(), it->second->as_json_raw());
         }
@@ -812,7 +871,7 @@ datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
 void datum_t::add(counted_t<const datum_t> val) {
     check_type(R_ARRAY);
     r_sanity_check(val.has());
-    r_array->push_back(val);
+    r_array->push_back(std::move(val));
     rcheck_array_size(*r_array, base_exc_t::GENERIC);
 }
 
@@ -821,9 +880,7 @@ MUST_USE bool datum_t::add(const std::string &key, counted_t<const datum_t> val,
     check_type(R_OBJECT);
     check_str_validity(key);
     r_sanity_check(val.has());
-    bool key_in_obj = r_object->count(key) > 0;
-    if (!key_in_obj || (clobber_bool == CLOBBER)) (*r_object)[key] = val;
-    return key_in_obj;
+    return r_object->set(key, std::move(val), clobber_bool);
 }
 
 MUST_USE bool datum_t::delete_field(const std::string &key) {
@@ -834,7 +891,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
     if (get_type() != R_OBJECT || rhs->get_type() != R_OBJECT) { return rhs; }
 
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         counted_t<const datum_t> sub_lhs = d->get(it->first, NOTHROW);
         bool is_literal = it->second->is_ptype(pseudo::literal_string);
@@ -860,7 +917,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
 counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs,
                                         merge_resoluter_t f) const {
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         if (counted_t<const datum_t> left = get(it->first, NOTHROW)) {
             bool b = d.add(it->first, f(it->first, left, it->second), CLOBBER);
@@ -915,9 +972,8 @@ int datum_t::cmp(const datum_t &rhs) const {
             }
             return pseudo_cmp(rhs);
         } else {
-            const std::map<std::string, counted_t<const datum_t> > &obj = as_object();
-            const std::map<std::string, counted_t<const datum_t> > &rhs_obj
-                = rhs.as_object();
+            const datum_object_t &obj = as_object();
+            const datum_object_t &rhs_obj = rhs.as_object();
             auto it = obj.begin();
             auto it2 = rhs_obj.begin();
             while (it != obj.end() && it2 != rhs_obj.end()) {
@@ -949,6 +1005,148 @@ bool datum_t::operator<=(const datum_t &rhs) const { return cmp(rhs) <= 0; }
 bool datum_t::operator>(const datum_t &rhs) const { return cmp(rhs) > 0; }
 bool datum_t::operator>=(const datum_t &rhs) const { return cmp(rhs) >= 0; }
 
+static uint64_t hash_combine(uint64_t seed, uint64_t h) {
+    return seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// 64-bit FNV-1a, which is the same everywhere, unlike `std::hash`.
+static uint64_t hash_bytes(const char *data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t datum_t::hash() const {
+    // This has to agree with `cmp`, so times are hashed by their epoch time alone
+    // and 0 and -0 hash the same.
+    uint64_t h = static_cast<uint64_t>(get_type());
+    switch (get_type()) {
+    case R_NULL: return h;
+    case R_BOOL: return hash_combine(h, as_bool());
+    case R_NUM: {
+        union {
+            double d;
+            uint64_t u;
+        } packed;
+        packed.d = as_num() == 0 ? 0.0 : as_num();
+        return hash_combine(h, packed.u);
+    }
+    case R_STR: {
+        const wire_string_t &str = as_str();
+        return hash_combine(h, hash_bytes(str.data(), str.size()));
+    }
+    case R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &arr = as_array();
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            h = hash_combine(h, (*it)->hash());
+        }
+        return h;
+    }
+    case R_OBJECT: {
+        if (is_ptype(pseudo::time_string)) {
+            return hash_combine(h, get(pseudo::epoch_time_key)->hash());
+        }
+        const datum_object_t &obj = as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            h = hash_combine(h, hash_bytes(it->first.data(), it->first.size()));
+            h = hash_combine(h, it->second->hash());
+        }
+        return h;
+    }
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+// The tags of the sort key encodings.  They're ordered like `cmp` orders the
+// types, with pseudotypes after all the others, and they're all above the 0 that
+// ends arrays and objects.
+static const char SORT_KEY_PTYPE = 7;
+
+// Strings are followed by two zero bytes, and zero bytes in them are escaped as a
+// zero byte followed by 0xFF, so a string sorts before the strings it's a prefix
+// of and its encoding can be followed by more.
+static void append_sort_key_str(const char *data, size_t size, std::string *out) {
+    for (size_t i = 0; i < size; ++i) {
+        out->push_back(data[i]);
+        if (data[i] == '\0') {
+            out->push_back('\xFF');
+        }
+    }
+    out->push_back('\0');
+    out->push_back('\0');
+}
+
+bool datum_t::append_sort_key(std::string *out) const {
+    if (is_ptype()) {
+        // Times are the only pseudotype `cmp` can compare to each other.
+        if (!is_ptype(pseudo::time_string)) {
+            return false;
+        }
+        out->push_back(SORT_KEY_PTYPE);
+        const std::string reql_type = get_reql_type();
+        append_sort_key_str(reql_type.data(), reql_type.size(), out);
+        return get(pseudo::epoch_time_key)->append_sort_key(out);
+    }
+    out->push_back(static_cast<char>(get_type()));
+    switch (get_type()) {
+    case R_NULL: return true;
+    case R_BOOL: {
+        out->push_back(as_bool() ? 1 : 0);
+        return true;
+    }
+    case R_NUM: {
+        union {
+            double d;
+            uint64_t u;
+        } packed;
+        packed.d = as_num() == 0 ? 0.0 : as_num();
+        // The same mangling as `num_to_str_key`, big-endian.
+        if (packed.u & (1ULL << 63)) {
+            packed.u = ~packed.u;
+        } else {
+            packed.u ^= (1ULL << 63);
+        }
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out->push_back(static_cast<char>((packed.u >> shift) & 0xFF));
+        }
+        return true;
+    }
+    case R_STR: {
+        const wire_string_t &str = as_str();
+        append_sort_key_str(str.data(), str.size(), out);
+        return true;
+    }
+    case R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &arr = as_array();
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            if (!(*it)->append_sort_key(out)) {
+                return false;
+            }
+        }
+        out->push_back('\0');
+        return true;
+    }
+    case R_OBJECT: {
+        const datum_object_t &obj = as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            out->push_back(1);
+            append_sort_key_str(it->first.data(), it->first.size(), out);
+            if (!it->second->append_sort_key(out)) {
+                return false;
+            }
+        }
+        out->push_back('\0');
+        return true;
+    }
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 void datum_t::runtime_fail(base_exc_t::type_t exc_type,
                            const char *test, const char *file, int line,
                            std::string msg) const {
@@ -961,6 +1159,8 @@ datum_t::datum_t(const Datum *d) : type(UNINITIALIZED) {
     init_from_pb(d);
 }
 
+static void read_packed(const char **p, const char *end, Datum *d);
+
 void datum_t::init_from_pb(const Datum *d) {
     r_sanity_check(type == UNINITIALIZED);
     switch (d->type()) {
@@ -988,6 +1188,14 @@ void datum_t::init_from_pb(const Datum *d) {
         scoped_cJSON_t cjson(cJSON_Parse(d->r_str().c_str()));
         init_json(cjson.get());
     } break;
+    case Datum::R_PACKED: {
+        const char *p = d->r_str().data();
+        const char *end = p + d->r_str().size();
+        Datum unpacked;
+        read_packed(&p, end, &unpacked);
+        rcheck_datum(p == end, base_exc_t::GENERIC, "Trailing bytes in packed datum.");
+        init_from_pb(&unpacked);
+    } break;
     case Datum::R_ARRAY: {
         init_array();
         for (int i = 0; i < d->r_array_size(); ++i) {
@@ -996,15 +1204,19 @@ void datum_t::init_from_pb(const Datum *d) {
     } break;
     case Datum::R_OBJECT: {
         init_object();
+        std::vector<datum_object_t::value_type> fields;
+        fields.reserve(d->r_object_size());
         for (int i = 0; i < d->r_object_size(); ++i) {
             const Datum_AssocPair *ap = &d->r_object(i);
             const std::string &key = ap->key();
             check_str_validity(key);
-            rcheck(r_object->count(key) == 0,
-                   base_exc_t::GENERIC,
-                   strprintf("Duplicate key %s in object.", key.c_str()));
-            (*r_object)[key] = make_counted<datum_t>(&ap->val());
+            fields.push_back(std::make_pair(key,
+                                            make_counted<const datum_t>(&ap->val())));
         }
+        std::string duplicate;
+        bool unique = r_object->assign_unsorted(std::move(fields), &duplicate);
+        rcheck(unique, base_exc_t::GENERIC,
+               strprintf("Duplicate key %s in object.", duplicate.c_str()));
         std::set<std::string> allowed_ptypes = { pseudo::literal_string };
         maybe_sanitize_ptype(allowed_ptypes);
     } break;
@@ -1075,12 +1287,212 @@ void datum_t::write_to_protobuf(Datum *d, use_json_t use_json) const {
     } break;
     case use_json_t::YES: {
         d->set_type(Datum::R_JSON);
-        d->set_r_str(as_json().PrintUnformatted());
+        write_json(*this, d->mutable_r_str());
+    } break;
+    case use_json_t::PACKED: {
+        d->set_type(Datum::R_PACKED);
+        write_packed(d->mutable_r_str());
     } break;
     default: unreachable();
     }
 }
 
+// The tags of the `R_PACKED` encoding.
+enum class packed_tag_t : uint8_t {
+    NULL_VALUE = 0, FALSE_VALUE = 1, TRUE_VALUE = 2, NUM = 3, STR = 4, ARRAY = 5, OBJECT = 6
+};
+
+static void append_packed_tag(packed_tag_t tag, std::string *out) {
+    out->push_back(static_cast<char>(tag));
+}
+
+static void append_packed_uint32(size_t n, std::string *out) {
+    guarantee(n <= std::numeric_limits<uint32_t>::max());
+    uint32_t n32 = n;
+#ifndef BOOST_LITTLE_ENDIAN
+    static_assert(false, "This piece of code will break on big-endian systems.");
+#endif
+    out->append(reinterpret_cast<const char *>(&n32), sizeof(n32));
+}
+
+static void append_packed_str(const char *data, size_t size, std::string *out) {
+    append_packed_uint32(size, out);
+    out->append(data, size);
+}
+
+void datum_t::write_packed(std::string *out) const {
+    switch (get_type()) {
+    case R_NULL: {
+        append_packed_tag(packed_tag_t::NULL_VALUE, out);
+    } break;
+    case R_BOOL: {
+        append_packed_tag(r_bool ? packed_tag_t::TRUE_VALUE : packed_tag_t::FALSE_VALUE, out);
+    } break;
+    case R_NUM: {
+        append_packed_tag(packed_tag_t::NUM, out);
+        using namespace std;  // NOLINT(build/namespaces)
+        r_sanity_check(isfinite(r_num));
+        static_assert(sizeof(r_num) == 8, "The encoding has 64-bit doubles.");
+#ifndef BOOST_LITTLE_ENDIAN
+        static_assert(false, "This piece of code will break on big-endian systems.");
+#endif
+        out->append(reinterpret_cast<const char *>(&r_num), sizeof(r_num));
+    } break;
+    case R_STR: {
+        append_packed_tag(packed_tag_t::STR, out);
+        append_packed_str(r_str->data(), r_str->size(), out);
+    } break;
+    case R_ARRAY: {
+        append_packed_tag(packed_tag_t::ARRAY, out);
+        append_packed_uint32(r_array->size(), out);
+        for (auto it = r_array->begin(); it != r_array->end(); ++it) {
+            (*it)->write_packed(out);
+        }
+    } break;
+    case R_OBJECT: {
+        append_packed_tag(packed_tag_t::OBJECT, out);
+        append_packed_uint32(r_object->size(), out);
+        for (auto it = r_object->begin(); it != r_object->end(); ++it) {
+            append_packed_str(it->first.data(), it->first.size(), out);
+            it->second->write_packed(out);
+        }
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+static void check_packed_size(const char *p, const char *end, size_t size) {
+    rcheck_datum(static_cast<size_t>(end - p) >= size, base_exc_t::GENERIC,
+                 "Truncated packed datum.");
+}
+
+static uint32_t read_packed_uint32(const char **p, const char *end) {
+    check_packed_size(*p, end, sizeof(uint32_t));
+    uint32_t n;
+    memcpy(&n, *p, sizeof(n));
+    *p += sizeof(n);
+    return n;
+}
+
+static std::string read_packed_str(const char **p, const char *end) {
+    uint32_t size = read_packed_uint32(p, end);
+    check_packed_size(*p, end, size);
+    std::string res(*p, size);
+    *p += size;
+    return res;
+}
+
+// Decodes the value that `write_packed` wrote at `*p` into `d`, and moves `*p`
+// past it.
+static void read_packed(const char **p, const char *end, Datum *d) {
+    check_packed_size(*p, end, 1);
+    packed_tag_t tag = static_cast<packed_tag_t>(**p);
+    ++*p;
+    switch (tag) {
+    case packed_tag_t::NULL_VALUE: {
+        d->set_type(Datum::R_NULL);
+    } break;
+    case packed_tag_t::FALSE_VALUE: // fallthru
+    case packed_tag_t::TRUE_VALUE: {
+        d->set_type(Datum::R_BOOL);
+        d->set_r_bool(tag == packed_tag_t::TRUE_VALUE);
+    } break;
+    case packed_tag_t::NUM: {
+        double num;
+        check_packed_size(*p, end, sizeof(num));
+        memcpy(&num, *p, sizeof(num));
+        *p += sizeof(num);
+        d->set_type(Datum::R_NUM);
+        d->set_r_num(num);
+    } break;
+    case packed_tag_t::STR: {
+        d->set_type(Datum::R_STR);
+        d->set_r_str(read_packed_str(p, end));
+    } break;
+    case packed_tag_t::ARRAY: {
+        d->set_type(Datum::R_ARRAY);
+        uint32_t size = read_packed_uint32(p, end);
+        for (uint32_t i = 0; i < size; ++i) {
+            read_packed(p, end, d->add_r_array());
+        }
+    } break;
+    case packed_tag_t::OBJECT: {
+        d->set_type(Datum::R_OBJECT);
+        uint32_t size = read_packed_uint32(p, end);
+        for (uint32_t i = 0; i < size; ++i) {
+            Datum_AssocPair *ap = d->add_r_object();
+            ap->set_key(read_packed_str(p, end));
+            read_packed(p, end, ap->mutable_val());
+        }
+    } break;
+    default:
+        rfail_datum(base_exc_t::GENERIC, "Unknown tag %d in packed datum.",
+                    static_cast<int>(tag));
+    }
+}
+
+datum_object_t::datum_object_t(
+        std::map<std::string, counted_t<const datum_t> > &&map) {
+    pairs.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        pairs.push_back(std::make_pair(it->first, std::move(it->second)));
+    }
+}
+
+static bool key_less(const datum_object_t::value_type &pair, const std::string &key) {
+    return pair.first < key;
+}
+
+std::vector<datum_object_t::value_type>::iterator
+datum_object_t::lower_bound(const std::string &key) {
+    return std::lower_bound(pairs.begin(), pairs.end(), key, &key_less);
+}
+
+datum_object_t::const_iterator datum_object_t::find(const std::string &key) const {
+    const_iterator it = std::lower_bound(pairs.begin(), pairs.end(), key, &key_less);
+    return (it != pairs.end() && it->first == key) ? it : pairs.end();
+}
+
+bool datum_object_t::set(const std::string &key, counted_t<const datum_t> val,
+                         clobber_bool_t clobber_bool) {
+    auto it = lower_bound(key);
+    if (it != pairs.end() && it->first == key) {
+        if (clobber_bool == CLOBBER) {
+            it->second = std::move(val);
+        }
+        return true;
+    }
+    pairs.insert(it, std::make_pair(key, std::move(val)));
+    return false;
+}
+
+bool datum_object_t::erase(const std::string &key) {
+    auto it = lower_bound(key);
+    if (it != pairs.end() && it->first == key) {
+        pairs.erase(it);
+        return true;
+    }
+    return false;
+}
+
+bool datum_object_t::assign_unsorted(std::vector<value_type> &&unsorted,
+                                     std::string *duplicate_out) {
+    pairs = std::move(unsorted);
+    std::stable_sort(pairs.begin(), pairs.end(),
+                     [](const value_type &a, const value_type &b) {
+                         return a.first < b.first;
+                     });
+    for (size_t i = 1; i < pairs.size(); ++i) {
+        if (pairs[i - 1].first == pairs[i].first) {
+            *duplicate_out = pairs[i].first;
+            pairs.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
 enum class datum_serialized_type_t {
     R_ARRAY = 1,
     R_BOOL = 2,
@@ -1090,11 +1502,150 @@ enum class datum_serialized_type_t {
     R_STR = 6,
     INT_NEGATIVE = 7,
     INT_POSITIVE = 8,
+    // An object preceded by an offset table, written only by `serialize_row`.
+    R_INDEXED_OBJECT = 9,
 };
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
                                       datum_serialized_type_t::R_ARRAY,
-                                      datum_serialized_type_t::INT_POSITIVE);
+                                      datum_serialized_type_t::R_INDEXED_OBJECT);
+
+// The serialization of a `datum_object_t` must stay the same as that of the
+// `std::map` it replaced, because it is stored on disk.
+size_t serialized_size(const datum_object_t &object) {
+    size_t sz = varint_uint64_serialized_size(object.size());
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        sz += serialized_size(*it);
+    }
+    return sz;
+}
+
+write_message_t &operator<<(write_message_t &wm, const datum_object_t &object) {
+    serialize_varint_uint64(&wm, object.size());
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        wm << *it;
+    }
+    return wm;
+}
+
+/* Rows of a table mostly have the same few keys, so each thread remembers the
+last keys it deserialized, and a key that's already there shares its string's
+buffer instead of allocating one of its own.  It's a direct-mapped cache, so it
+stays small however many different keys go by.
+
+Only copy-on-write strings share buffers when copied, so there's no interning
+with the C++11 ABI's `std::string` (which keeps keys of up to 15 bytes inline
+instead).  There's none with `THREADED_COROUTINES` either, where a coroutine
+isn't tied to one OS thread's cache.  Keys are then read the usual way. */
+#if !(defined(_GLIBCXX_USE_CXX11_ABI) && _GLIBCXX_USE_CXX11_ABI) \
+    && !defined(THREADED_COROUTINES)
+#define DATUM_KEY_INTERNING 1
+#endif
+
+#ifdef DATUM_KEY_INTERNING
+class datum_key_interner_t {
+public:
+    datum_key_interner_t() : slots_(DATUM_KEY_INTERN_SLOTS) { }
+
+    void intern(const char *data, size_t size, std::string *out) {
+        std::string *slot = &slots_[hash_bytes(data, size) % slots_.size()];
+        if (slot->size() != size || memcmp(slot->data(), data, size) != 0) {
+            slot->assign(data, size);
+        }
+        *out = *slot;
+    }
+
+private:
+    std::vector<std::string> slots_;
+
+    DISABLE_COPYING(datum_key_interner_t);
+};
+
+// The interners are freed by the thread-specific key's destructor when their
+// threads exit.
+static pthread_key_t datum_key_interner_key;
+static pthread_once_t datum_key_interner_key_once = PTHREAD_ONCE_INIT;
+
+static void destroy_datum_key_interner(void *interner) {
+    delete static_cast<datum_key_interner_t *>(interner);
+}
+
+static void create_datum_key_interner_key() {
+    int res = pthread_key_create(&datum_key_interner_key, &destroy_datum_key_interner);
+    guarantee_xerr(res == 0, res, "pthread_key_create failed");
+}
+
+static datum_key_interner_t *get_datum_key_interner() {
+    pthread_once(&datum_key_interner_key_once, &create_datum_key_interner_key);
+    datum_key_interner_t *interner = static_cast<datum_key_interner_t *>(
+        pthread_getspecific(datum_key_interner_key));
+    if (interner == NULL) {
+        interner = new datum_key_interner_t;
+        int res = pthread_setspecific(datum_key_interner_key, interner);
+        guarantee_xerr(res == 0, res, "pthread_setspecific failed");
+    }
+    return interner;
+}
+#endif  // DATUM_KEY_INTERNING
+
+static archive_result_t deserialize_datum_key(read_stream_t *s, std::string *out) {
+#ifdef DATUM_KEY_INTERNING
+    uint64_t sz;
+    archive_result_t res = deserialize_varint_uint64(s, &sz);
+    if (res) { return res; }
+
+    if (sz > DATUM_KEY_INTERN_MAX_SIZE) {
+        // The usual way, without a detour through a buffer.
+        if (sz > std::numeric_limits<size_t>::max()) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+        out->resize(sz);
+        int64_t num_read = force_read(s, &(*out)[0], sz);
+        if (num_read == -1) { return ARCHIVE_SOCK_ERROR; }
+        if (static_cast<uint64_t>(num_read) < sz) { return ARCHIVE_SOCK_EOF; }
+        return ARCHIVE_SUCCESS;
+    }
+
+    char buf[DATUM_KEY_INTERN_MAX_SIZE];
+    int64_t num_read = force_read(s, buf, sz);
+    if (num_read == -1) { return ARCHIVE_SOCK_ERROR; }
+    if (static_cast<uint64_t>(num_read) < sz) { return ARCHIVE_SOCK_EOF; }
+    get_datum_key_interner()->intern(buf, sz, out);
+    return ARCHIVE_SUCCESS;
+#else
+    return deserialize(s, out);
+#endif
+}
+
+archive_result_t deserialize(read_stream_t *s, datum_object_t *object) {
+    object->pairs.clear();
+
+    uint64_t sz;
+    archive_result_t res = deserialize_varint_uint64(s, &sz);
+    if (res) { return res; }
+
+    if (sz > std::numeric_limits<size_t>::max()) {
+        return ARCHIVE_RANGE_ERROR;
+    }
+
+    // The fields were written in key order, so they can usually just be appended.
+    object->pairs.reserve(sz);
+    for (uint64_t i = 0; i < sz; ++i) {
+        datum_object_t::value_type p;
+        res = deserialize_datum_key(s, &p.first);
+        if (res) { return res; }
+        res = deserialize(s, &p.second);
+        if (res) { return res; }
+        if (object->pairs.empty() || object->pairs.back().first < p.first) {
+            object->pairs.push_back(std::move(p));
+        } else {
+            // Like `std::map`'s deserialization, keep the first of any duplicates.
+            UNUSED bool existed = object->set(p.first, std::move(p.second), NOCLOBBER);
+        }
+    }
+
+    return ARCHIVE_SUCCESS;
+}
 
 // This must be kept in sync with operator<<(write_message_t &, const counted_t<const
 // datum_T> &).
@@ -1255,8 +1806,23 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
             return ARCHIVE_RANGE_ERROR;
         }
     } break;
+    case datum_serialized_type_t::R_INDEXED_OBJECT: {
+        // The offset table is only for `get_row_field`, so we skip over it.
+        uint64_t num_fields;
+        res = deserialize_varint_uint64(s, &num_fields);
+        if (res) {
+            return res;
+        }
+        for (uint64_t i = 0; i < num_fields; ++i) {
+            uint32_t offset;
+            res = deserialize(s, &offset);
+            if (res) {
+                return res;
+            }
+        }
+    } // fallthru
     case datum_serialized_type_t::R_OBJECT: {
-        std::map<std::string, counted_t<const datum_t> > value;
+        datum_object_t value;
         res = deserialize(s, &value);
         if (res) {
             return res;
@@ -1268,14 +1834,36 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
         }
     } break;
     case datum_serialized_type_t::R_STR: {
-        wire_string_t *value;
-        res = deserialize(s, &value);
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
         if (res) {
-            guarantee(value == NULL);
             return res;
         }
+        if (sz > std::numeric_limits<size_t>::max()) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+        // Short strings are read onto the stack and go in the datum's own
+        // allocation; only the longer ones get a `wire_string_t` of their own.
+        scoped_ptr_t<wire_string_t> value;
+        char buf[datum_t::MAX_INLINE_STR_SIZE];
+        char *data = buf;
+        if (sz > datum_t::MAX_INLINE_STR_SIZE) {
+            value.init(wire_string_t::create(sz));
+            data = value->data();
+        }
+        int64_t num_read = force_read(s, data, sz);
+        if (num_read == -1) {
+            return ARCHIVE_SOCK_ERROR;
+        }
+        if (static_cast<uint64_t>(num_read) < sz) {
+            return ARCHIVE_SOCK_EOF;
+        }
         try {
-            datum->reset(new datum_t(value));
+            if (value.has()) {
+                datum->reset(new datum_t(value.release()));
+            } else {
+                *datum = datum_t::create_inline_str(buf, sz);
+            }
         } catch (const base_exc_t &) {
             return ARCHIVE_RANGE_ERROR;
         }
@@ -1287,6 +1875,79 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
     return ARCHIVE_SUCCESS;
 }
 
+// Objects with fewer fields than this are cheap enough to deserialize whole, so
+// they aren't worth an offset table.
+static const size_t ROW_OFFSET_TABLE_MIN_FIELDS = 8;
+
+void serialize_row(write_message_t *wm, const counted_t<const datum_t> &row) {
+    r_sanity_check(row.has());
+    if (row->get_type() != datum_t::R_OBJECT
+        || row->as_object().size() < ROW_OFFSET_TABLE_MIN_FIELDS) {
+        *wm << row;
+        return;
+    }
+
+    const datum_object_t &obj = row->as_object();
+    std::vector<uint32_t> offsets;
+    offsets.reserve(obj.size());
+    // The fields follow the table in the same layout as in a plain object, whose
+    // size comes first.
+    uint64_t offset = varint_uint64_serialized_size(obj.size());
+    for (auto it = obj.begin(); it != obj.end(); ++it) {
+        if (offset > std::numeric_limits<uint32_t>::max()) {
+            // Too big to index; this will hardly ever happen.
+            *wm << row;
+            return;
+        }
+        offsets.push_back(offset);
+        offset += serialized_size(*it);
+    }
+
+    *wm << datum_serialized_type_t::R_INDEXED_OBJECT;
+    serialize_varint_uint64(wm, offsets.size());
+    for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+        *wm << *it;
+    }
+    *wm << obj;
+}
+
+archive_result_t deserialize_row_offsets(read_stream_t *s, bool *indexed_out,
+                                         std::vector<uint32_t> *offsets_out,
+                                         int64_t *fields_start_out) {
+    *indexed_out = false;
+    offsets_out->clear();
+
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+    if (type != datum_serialized_type_t::R_INDEXED_OBJECT) {
+        return ARCHIVE_SUCCESS;
+    }
+
+    uint64_t num_fields;
+    res = deserialize_varint_uint64(s, &num_fields);
+    if (res) {
+        return res;
+    }
+    offsets_out->reserve(num_fields);
+    for (uint64_t i = 0; i < num_fields; ++i) {
+        uint32_t offset;
+        res = deserialize(s, &offset);
+        if (res) {
+            return res;
+        }
+        offsets_out->push_back(offset);
+    }
+
+    *indexed_out = true;
+    *fields_start_out = 1  // 1 byte for the type
+        + varint_uint64_serialized_size(num_fields)
+        + num_fields * serialized_size_t<uint32_t>::value;
+    return ARCHIVE_SUCCESS;
+}
+
 write_message_t &operator<<(write_message_t &wm,
                             const empty_ok_t<const counted_t<const datum_t> > &datum) {
     const counted_t<const datum_t> *pointer = datum.get();
@@ -1316,20 +1977,21 @@ archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const da
 }
 
 
-bool wire_datum_map_t::has(counted_t<const datum_t> key) {
+bool wire_datum_map_t::has(const counted_t<const datum_t> &key) {
     r_sanity_check(state == COMPILED);
     return map.count(key) > 0;
 }
 
-counted_t<const datum_t> wire_datum_map_t::get(counted_t<const datum_t> key) {
+counted_t<const datum_t> wire_datum_map_t::get(const counted_t<const datum_t> &key) {
     r_sanity_check(state == COMPILED);
-    r_sanity_check(has(key));
-    return map[key];
+    auto it = map.find(key);
+    r_sanity_check(it != map.end());
+    return it->second;
 }
 
 void wire_datum_map_t::set(counted_t<const datum_t> key, counted_t<const datum_t> val) {
     r_sanity_check(state == COMPILED);
-    map[key] = val;
+    map[std::move(key)] = std::move(val);
 }
 
 void wire_datum_map_t::compile() {
@@ -29,9 +29,21 @@ class datum_stream_t;
 class env_t;
 class val_t;
 
+// How a datum is turned into a btree key.  The two formats only differ in numbers:
+// primary keys print them as 16 hex digits followed by a printed copy of the number
+// (which is only there so that they are readable), and secondary keys store them as 8
+// raw bytes, so that compound keys are far less likely to be truncated.  Secondary
+// indexes record the format of their keys, because indexes created before the
+// compact format existed used the printed one (see
+// store_t::rebuild_outdated_sindexes).
+enum class key_format_t { PRINTED = 0, COMPACT = 1 };
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(key_format_t, int8_t,
+                                      key_format_t::PRINTED, key_format_t::COMPACT);
+
 namespace pseudo {
 class datum_cmp_t;
-void time_to_str_key(const datum_t &d, std::string *str_out);
+void time_to_str_key(const datum_t &d, key_format_t format, std::string *str_out);
 void sanitize_time(datum_t *time);
 } // namespace pseudo
 
@@ -47,9 +59,12 @@ enum throw_bool_t { NOTHROW = 0, THROW = 1};
 // CLOBBER: Overwrite existing values.
 enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1};
 
-enum class use_json_t { NO = 0, YES = 1 };
+// How `write_to_protobuf` encodes a datum: as nested `Datum` messages, as JSON
+// (`R_JSON`), or in the packed format of `R_PACKED`.
+enum class use_json_t { NO = 0, YES = 1, PACKED = 2 };
 
 class grouped_data_t;
+class datum_object_t;
 
 // A `datum_t` is basically a JSON value, although we may extend it later.
 class datum_t : public slow_atomic_countable_t<datum_t> {
@@ -76,6 +91,7 @@ public:
     explicit datum_t(const char *cstr);
     explicit datum_t(std::vector<counted_t<const datum_t> > &&_array);
     explicit datum_t(std::map<std::string, counted_t<const datum_t> > &&object);
+    explicit datum_t(datum_object_t &&object);
 
     // This should only be used to send responses to the client.
     explicit datum_t(grouped_data_t &&gd);
@@ -87,9 +103,20 @@ public:
     explicit datum_t(cJSON *json);
     explicit datum_t(const scoped_cJSON_t &json);
 
+    // Makes a string datum whose string, of at most `MAX_INLINE_STR_SIZE` bytes, is
+    // in the same allocation as the datum itself.
+    static counted_t<const datum_t> create_inline_str(const char *data, size_t size);
+
+    // Only so that `delete` never passes the size of a plain datum to a sized
+    // deallocation function, which `create_inline_str` allocates more than.
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     ~datum_t();
 
     void write_to_protobuf(Datum *out, use_json_t use_json) const;
+    // Appends the `R_PACKED` encoding of the datum (see ql2.proto) to `out`.
+    void write_packed(std::string *out) const;
 
     type_t get_type() const;
     bool is_ptype() const;
@@ -126,7 +153,7 @@ public:
     // Access an element of an array.
     counted_t<const datum_t> get(size_t index, throw_bool_t throw_bool = THROW) const;
     // Use of `get` is preferred to `as_object` when possible.
-    const std::map<std::string, counted_t<const datum_t> > &as_object() const;
+    const datum_object_t &as_object() const;
 
     // Access an element of an object.
     counted_t<const datum_t> get(const std::string &key,
@@ -156,6 +183,16 @@ public:
     bool operator>(const datum_t &rhs) const;
     bool operator>=(const datum_t &rhs) const;
 
+    // Data that are `==` have the same hash, which is the same on every machine.
+    uint64_t hash() const;
+
+    // Appends a key that compares with `memcmp` (as unsigned bytes) like the datum
+    // compares with `cmp`, so a sort can encode each element once rather than
+    // walking two of them in every comparison.  No key is a prefix of another.
+    // Returns false if the datum is or holds a pseudotype other than a time, which
+    // can't be encoded, leaving `*out` with a partial key.
+    MUST_USE bool append_sort_key(std::string *out) const;
+
     void runtime_fail(base_exc_t::type_t exc_type,
                       const char *test, const char *file, int line,
                       std::string msg) const NORETURN;
@@ -190,6 +227,9 @@ private:
     // Returns true if key was in object.
     MUST_USE bool delete_field(const std::string &key);
 
+    struct inline_str_tag_t { };
+    datum_t(inline_str_tag_t, const char *data, size_t size);
+
     void init_empty();
     void init_str(size_t size, const char *data);
     void init_array();
@@ -199,38 +239,120 @@ private:
     void check_str_validity(const wire_string_t *str);
     void check_str_validity(const std::string &str);
 
-    friend void pseudo::time_to_str_key(const datum_t &d, std::string *str_out);
-    void pt_to_str_key(std::string *str_out) const;
-    void num_to_str_key(std::string *str_out) const;
+    friend void pseudo::time_to_str_key(const datum_t &d, key_format_t format,
+                                        std::string *str_out);
+    void pt_to_str_key(key_format_t format, std::string *str_out) const;
+    void num_to_str_key(key_format_t format, std::string *str_out) const;
     void str_to_str_key(std::string *str_out) const;
     void bool_to_str_key(std::string *str_out) const;
-    void array_to_str_key(std::string *str_out) const;
+    void array_to_str_key(key_format_t format, std::string *str_out) const;
 
     int pseudo_cmp(const datum_t &rhs) const;
     static const std::set<std::string> _allowed_pts;
     void maybe_sanitize_ptype(const std::set<std::string> &allowed_pts = _allowed_pts);
 
     type_t type;
+    // Whether an `R_STR`'s `r_str` comes right after the datum, in the same
+    // allocation, and so isn't deleted with it.  It fits in the padding after
+    // `type`, so datums are no bigger for it.
+    bool str_is_inline;
     union {
         bool r_bool;
         double r_num;
         wire_string_t *r_str;
         std::vector<counted_t<const datum_t> > *r_array;
-        std::map<std::string, counted_t<const datum_t> > *r_object;
+        datum_object_t *r_object;
     };
 
 public:
     static const char* const reql_type_string;
+    // The longest string that `create_inline_str()` takes.
+    static const size_t MAX_INLINE_STR_SIZE = 64;
 
 private:
     DISABLE_COPYING(datum_t);
 };
 
+// For hash containers of data, such as the one `distinct` dedups rows with.
+struct datum_hash_t {
+    size_t operator()(const counted_t<const datum_t> &d) const {
+        return static_cast<size_t>(d->hash());
+    }
+};
+struct datum_equal_t {
+    bool operator()(const counted_t<const datum_t> &a,
+                    const counted_t<const datum_t> &b) const {
+        return *a == *b;
+    }
+};
+
+/* `datum_object_t` holds the fields of an object datum. They are kept in one vector
+sorted by key, so an object costs a single allocation for all of its fields rather
+than one tree node per field as with a `std::map`, and lookups are binary searches
+over contiguous memory. It offers the parts of the `std::map` interface that users
+of `datum_t::as_object()` need. Iteration is in key order, as before. */
+class datum_object_t {
+public:
+    typedef std::pair<std::string, counted_t<const datum_t> > value_type;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+    typedef std::vector<value_type>::const_reverse_iterator const_reverse_iterator;
+
+    datum_object_t() { }
+    explicit datum_object_t(std::map<std::string, counted_t<const datum_t> > &&map);
+
+    size_t size() const { return pairs.size(); }
+    bool empty() const { return pairs.empty(); }
+    const_iterator begin() const { return pairs.begin(); }
+    const_iterator end() const { return pairs.end(); }
+    const_reverse_iterator rbegin() const { return pairs.rbegin(); }
+    const_reverse_iterator rend() const { return pairs.rend(); }
+
+    const_iterator find(const std::string &key) const;
+    size_t count(const std::string &key) const { return find(key) == end() ? 0 : 1; }
+
+    // Returns true if `key` was already present. Its value is only replaced if
+    // `clobber_bool` is `CLOBBER`, in which case iterators stay valid.
+    bool set(const std::string &key, counted_t<const datum_t> val,
+             clobber_bool_t clobber_bool);
+    // Returns true if `key` was present.
+    bool erase(const std::string &key);
+
+    // Replaces the contents with `unsorted`, which may be in any order. Returns
+    // false and leaves the object empty if a key occurs more than once; the
+    // offending key is stored in `*duplicate_out`.
+    MUST_USE bool assign_unsorted(std::vector<value_type> &&unsorted,
+                                  std::string *duplicate_out);
+
+private:
+    std::vector<value_type>::iterator lower_bound(const std::string &key);
+
+    friend archive_result_t deserialize(read_stream_t *s, datum_object_t *object);
+    std::vector<value_type> pairs;
+};
+
+size_t serialized_size(const datum_object_t &object);
+write_message_t &operator<<(write_message_t &wm, const datum_object_t &object);
+archive_result_t deserialize(read_stream_t *s, datum_object_t *object);
+
 size_t serialized_size(const counted_t<const datum_t> &datum);
 
 write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t> &datum);
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum);
 
+// Rows are stored in the btree in this form. It is the regular serialization,
+// except that objects with many fields get a table of the offsets of their fields,
+// so that one field can be read without deserializing the others (see
+// `lazy_json_t::get_field`). `deserialize` reads both forms.
+void serialize_row(write_message_t *wm, const counted_t<const datum_t> &row);
+
+// Reads the start of a row written by `serialize_row`. If the row has an offset
+// table, sets `*indexed_out` and fills `offsets_out` with the offsets of the
+// fields (in key order) relative to `*fields_start_out`, the offset of the field
+// count from the start of the row. Each field is a serialized key and value pair.
+archive_result_t deserialize_row_offsets(read_stream_t *s, bool *indexed_out,
+                                         std::vector<uint32_t> *offsets_out,
+                                         int64_t *fields_start_out);
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum);
 archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const datum_t> > datum);
 
@@ -263,17 +385,21 @@ public:
         UNUSED bool first_error_clobber =
             ptr()->add("first_error", make_counted<const datum_t>(msg), NOCLOBBER);
     }
-    void add(counted_t<const datum_t> val) { ptr()->add(val); }
-    void change(size_t i, counted_t<const datum_t> val) { ptr()->change(i, val); }
-    void insert(size_t i, counted_t<const datum_t> val) { ptr()->insert(i, val); }
+    void add(counted_t<const datum_t> val) { ptr()->add(std::move(val)); }
+    void change(size_t i, counted_t<const datum_t> val) {
+        ptr()->change(i, std::move(val));
+    }
+    void insert(size_t i, counted_t<const datum_t> val) {
+        ptr()->insert(i, std::move(val));
+    }
     void erase(size_t i) { ptr()->erase(i); }
     void erase_range(size_t start, size_t end) { ptr()->erase_range(start, end); }
     void splice(size_t index, counted_t<const datum_t> values) {
-        ptr()->splice(index, values);
+        ptr()->splice(index, std::move(values));
     }
     MUST_USE bool add(const std::string &key, counted_t<const datum_t> val,
                       clobber_bool_t clobber_bool = NOCLOBBER) {
-        return ptr()->add(key, val, clobber_bool);
+        return ptr()->add(key, std::move(val), clobber_bool);
     }
     MUST_USE bool delete_field(const std::string &key) {
         return ptr()->delete_field(key);
@@ -299,8 +425,8 @@ private:
 class wire_datum_map_t {
 public:
     wire_datum_map_t() : state(COMPILED) { }
-    bool has(counted_t<const datum_t> key);
-    counted_t<const datum_t> get(counted_t<const datum_t> key);
+    bool has(const counted_t<const datum_t> &key);
+    counted_t<const datum_t> get(const counted_t<const datum_t> &key);
     void set(counted_t<const datum_t> key, counted_t<const datum_t> val);
 
     void compile();
@@ -309,7 +435,8 @@ public:
     counted_t<const datum_t> to_arr() const;
 private:
     struct datum_value_compare_t {
-        bool operator()(counted_t<const datum_t> a, counted_t<const datum_t> b) const {
+        bool operator()(const counted_t<const datum_t> &a,
+                        const counted_t<const datum_t> &b) const {
             return *a < *b;
         }
     };
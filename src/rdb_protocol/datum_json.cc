@@ -0,0 +1,316 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum_json.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+#include <vector>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+static void write_json_string(const char *data, size_t size, std::string *out) {
+    out->push_back('"');
+    const char *run = data;
+    const char *end = data + size;
+    for (const char *p = data; p < end; ++p) {
+        unsigned char c = *p;
+        if (c > 31 && c != '"' && c != '\\') {
+            continue;
+        }
+        // Copy the characters that need no escaping in one go.
+        out->append(run, p - run);
+        run = p + 1;
+        switch (c) {
+        case '\\': out->append("\\\\"); break;
+        case '"': out->append("\\\""); break;
+        case '\b': out->append("\\b"); break;
+        case '\f': out->append("\\f"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default: {
+            char buf[7];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out->append(buf);
+        } break;
+        }
+    }
+    out->append(run, end - run);
+    out->push_back('"');
+}
+
+void write_json(const datum_t &datum, std::string *out) {
+    switch (datum.get_type()) {
+    case datum_t::R_NULL: {
+        out->append("null");
+    } break;
+    case datum_t::R_BOOL: {
+        out->append(datum.as_bool() ? "true" : "false");
+    } break;
+    case datum_t::R_NUM: {
+        double num = datum.as_num();
+        // so we can use `isfinite` in a GCC 4.4.3-compatible way
+        using namespace std;  // NOLINT(build/namespaces)
+        guarantee(isfinite(num));
+        // Enough for any double printed with 20 significant digits.
+        char buf[64];
+        int size = snprintf(buf, sizeof(buf), "%.20g", num);
+        guarantee(size > 0 && static_cast<size_t>(size) < sizeof(buf));
+        out->append(buf, size);
+    } break;
+    case datum_t::R_STR: {
+        const wire_string_t &str = datum.as_str();
+        write_json_string(str.data(), str.size(), out);
+    } break;
+    case datum_t::R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &arr = datum.as_array();
+        out->push_back('[');
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            if (it != arr.begin()) {
+                out->push_back(',');
+            }
+            write_json(**it, out);
+        }
+        out->push_back(']');
+    } break;
+    case datum_t::R_OBJECT: {
+        const datum_object_t &obj = datum.as_object();
+        out->push_back('{');
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            if (it != obj.begin()) {
+                out->push_back(',');
+            }
+            write_json_string(it->first.data(), it->first.size(), out);
+            out->push_back(':');
+            write_json(*it->second, out);
+        }
+        out->push_back('}');
+    } break;
+    case datum_t::UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+static const char *skip_whitespace(const char *p) {
+    while (*p != '\0' && static_cast<unsigned char>(*p) <= 32) {
+        ++p;
+    }
+    return p;
+}
+
+// Reads the four hex digits of a `\u` escape.  Returns false if they aren't.
+static bool parse_hex4(const char *p, unsigned *out) {
+    unsigned value = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    *out = value;
+    return true;
+}
+
+static void append_utf8(unsigned code_point, std::string *out) {
+    if (code_point < 0x80) {
+        out->push_back(code_point);
+    } else if (code_point < 0x800) {
+        out->push_back(0xC0 | (code_point >> 6));
+        out->push_back(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out->push_back(0xE0 | (code_point >> 12));
+        out->push_back(0x80 | ((code_point >> 6) & 0x3F));
+        out->push_back(0x80 | (code_point & 0x3F));
+    } else {
+        out->push_back(0xF0 | (code_point >> 18));
+        out->push_back(0x80 | ((code_point >> 12) & 0x3F));
+        out->push_back(0x80 | ((code_point >> 6) & 0x3F));
+        out->push_back(0x80 | (code_point & 0x3F));
+    }
+}
+
+// Parses the string starting at the `"` at `p` into `out`.  Like cJSON, a string
+// that isn't terminated runs to the end of the text.
+static const char *parse_json_string(const char *p, std::string *out) {
+    if (*p != '"') {
+        return NULL;
+    }
+    ++p;
+    for (;;) {
+        // Copy the characters that need no unescaping in one go.
+        const char *run = p;
+        while (*p != '"' && *p != '\\' && *p != '\0') {
+            ++p;
+        }
+        out->append(run, p - run);
+        if (*p != '\\') {
+            break;
+        }
+        ++p;
+        switch (*p) {
+        case '\0': return p;
+        case 'b': out->push_back('\b'); break;
+        case 'f': out->push_back('\f'); break;
+        case 'n': out->push_back('\n'); break;
+        case 'r': out->push_back('\r'); break;
+        case 't': out->push_back('\t'); break;
+        case 'u': {
+            unsigned code_point;
+            if (!parse_hex4(p + 1, &code_point)) {
+                break;
+            }
+            p += 4;
+            // Invalid code points are dropped.
+            if ((code_point >= 0xDC00 && code_point <= 0xDFFF) || code_point == 0) {
+                break;
+            }
+            if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                unsigned low;
+                if (p[1] != '\\' || p[2] != 'u' || !parse_hex4(p + 3, &low)) {
+                    break;
+                }
+                p += 6;
+                if (low < 0xDC00 || low > 0xDFFF) {
+                    break;
+                }
+                code_point = 0x10000 | ((code_point & 0x3FF) << 10) | (low & 0x3FF);
+            }
+            append_utf8(code_point, out);
+        } break;
+        default: out->push_back(*p); break;
+        }
+        ++p;
+    }
+    return *p == '"' ? p + 1 : p;
+}
+
+// Parses the value at `p` into `out`, and returns where it ends, or NULL if there's
+// no value at `p`.
+static const char *parse_json_value(const char *p, counted_t<const datum_t> *out) {
+    if (strncmp(p, "null", 4) == 0) {
+        *out = make_counted<const datum_t>(datum_t::R_NULL);
+        return p + 4;
+    }
+    if (strncmp(p, "false", 5) == 0) {
+        *out = make_counted<const datum_t>(datum_t::R_BOOL, false);
+        return p + 5;
+    }
+    if (strncmp(p, "true", 4) == 0) {
+        *out = make_counted<const datum_t>(datum_t::R_BOOL, true);
+        return p + 4;
+    }
+    if (*p == '"') {
+        std::string str;
+        p = parse_json_string(p, &str);
+        *out = make_counted<const datum_t>(std::move(str));
+        return p;
+    }
+    if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        double num;
+        const char *end;
+        // `strtod` would also read hexadecimal floats.
+        if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+            num = 0;
+            end = p + 1;
+        } else {
+            char *strtod_end;
+            num = strtod(p, &strtod_end);
+            if (strtod_end == p) {
+                return NULL;
+            }
+            end = strtod_end;
+        }
+        // so we can use `isfinite` in a GCC 4.4.3-compatible way
+        using namespace std;  // NOLINT(build/namespaces)
+        rcheck_datum(isfinite(num), base_exc_t::GENERIC,
+                     strprintf("Non-finite value `%lf` in JSON.", num));
+        *out = make_counted<const datum_t>(num);
+        return end;
+    }
+    if (*p == '[') {
+        std::vector<counted_t<const datum_t> > arr;
+        p = skip_whitespace(p + 1);
+        if (*p != ']') {
+            for (;;) {
+                counted_t<const datum_t> item;
+                p = parse_json_value(skip_whitespace(p), &item);
+                if (p == NULL) {
+                    return NULL;
+                }
+                arr.push_back(std::move(item));
+                p = skip_whitespace(p);
+                if (*p != ',') {
+                    break;
+                }
+                ++p;
+            }
+            if (*p != ']') {
+                return NULL;
+            }
+        }
+        *out = make_counted<const datum_t>(std::move(arr));
+        return p + 1;
+    }
+    if (*p == '{') {
+        std::vector<datum_object_t::value_type> fields;
+        p = skip_whitespace(p + 1);
+        if (*p != '}') {
+            for (;;) {
+                std::string key;
+                p = parse_json_string(skip_whitespace(p), &key);
+                if (p == NULL) {
+                    return NULL;
+                }
+                p = skip_whitespace(p);
+                if (*p != ':') {
+                    return NULL;
+                }
+                counted_t<const datum_t> val;
+                p = parse_json_value(skip_whitespace(p + 1), &val);
+                if (p == NULL) {
+                    return NULL;
+                }
+                fields.push_back(std::make_pair(std::move(key), std::move(val)));
+                p = skip_whitespace(p);
+                if (*p != ',') {
+                    break;
+                }
+                ++p;
+            }
+            if (*p != '}') {
+                return NULL;
+            }
+        }
+        datum_object_t obj;
+        std::string duplicate;
+        bool unique = obj.assign_unsorted(std::move(fields), &duplicate);
+        rcheck_datum(unique, base_exc_t::GENERIC,
+                     strprintf("Duplicate key `%s` in JSON.", duplicate.c_str()));
+        *out = make_counted<const datum_t>(std::move(obj));
+        return p + 1;
+    }
+    return NULL;
+}
+
+counted_t<const datum_t> parse_json(const char *text) {
+    counted_t<const datum_t> res;
+    if (parse_json_value(skip_whitespace(text), &res) == NULL) {
+        return counted_t<const datum_t>();
+    }
+    return res;
+}
+
+}  // namespace ql
@@ -0,0 +1,29 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_DATUM_JSON_HPP_
+#define RDB_PROTOCOL_DATUM_JSON_HPP_
+
+#include <string>
+
+#include "containers/counted.hpp"
+
+namespace ql {
+
+class datum_t;
+
+/* These go straight between datums and JSON text, without the `cJSON` tree that
+`datum_t::as_json` and `datum_t(cJSON *)` go through. */
+
+// Appends the JSON text of `datum` to `out`, exactly as `cJSON_PrintUnformatted`
+// prints `datum.as_json()`.
+void write_json(const datum_t &datum, std::string *out);
+
+// Parses the NUL-terminated `text` the way `cJSON_Parse` does, including its
+// leniency: text after the value is ignored, unknown escapes stand for the
+// escaped character, and invalid `\u` escapes are dropped.  Returns an empty
+// pointer if `text` doesn't start with a JSON value, and throws if the value
+// isn't a valid datum (e.g. an object has duplicate keys).
+counted_t<const datum_t> parse_json(const char *text);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_JSON_HPP_
@@ -3,7 +3,11 @@
 
 #include <map>
 
+#include "arch/runtime/coroutines.hpp"
 #include "clustering/administration/metadata.hpp"
+#include "concurrency/wait_any.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "containers/uuid.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
@@ -26,7 +30,9 @@ void rdb_namespace_interface_t::read(
     profile::splitter_t splitter(env_->trace);
     r_sanity_check(read.profile == env_->profile());
     /* Do the actual read. */
+    ticks_t start_time = get_ticks();
     internal_->read(read, response, tok, interruptor);
+    profile::count_wait_time(env_->trace.get_or_null(), get_ticks() - start_time);
     /* Append the results of the parallel tasks to the current trace */
     splitter.give_splits(response->n_shards, response->event_log);
 }
@@ -41,7 +47,27 @@ void rdb_namespace_interface_t::read_outdated(
     /* propagate whether or not we're doing profiles */
     r_sanity_check(read.profile == env_->profile());
     /* Do the actual read. */
+    ticks_t start_time = get_ticks();
     internal_->read_outdated(read, response, interruptor);
+    profile::count_wait_time(env_->trace.get_or_null(), get_ticks() - start_time);
+    /* Append the results of the profile to the current task */
+    splitter.give_splits(response->n_shards, response->event_log);
+}
+
+void rdb_namespace_interface_t::read_bounded_staleness(
+        const rdb_protocol_t::read_t &read,
+        rdb_protocol_t::read_response_t *response,
+        int64_t max_staleness_ms,
+        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+    profile::starter_t starter("Perform bounded staleness read.", env_->trace);
+    profile::splitter_t splitter(env_->trace);
+    /* propagate whether or not we're doing profiles */
+    r_sanity_check(read.profile == env_->profile());
+    /* Do the actual read. */
+    ticks_t start_time = get_ticks();
+    internal_->read_bounded_staleness(read, response, max_staleness_ms, interruptor);
+    profile::count_wait_time(env_->trace.get_or_null(), get_ticks() - start_time);
     /* Append the results of the profile to the current task */
     splitter.give_splits(response->n_shards, response->event_log);
 }
@@ -57,7 +83,9 @@ void rdb_namespace_interface_t::write(
     /* propagate whether or not we're doing profiles */
     write->profile = env_->profile();
     /* Do the actual read. */
+    ticks_t start_time = get_ticks();
     internal_->write(*write, response, tok, interruptor);
+    profile::count_wait_time(env_->trace.get_or_null(), get_ticks() - start_time);
     /* Append the results of the profile to the current task */
     splitter.give_splits(response->n_shards, response->event_log);
 }
@@ -106,7 +134,13 @@ reader_t::reader_t(
       use_outdated(_use_outdated),
       started(false), shards_exhausted(false),
       readgen(std::move(_readgen)),
-      active_range(readgen->original_keyrange()) { }
+      active_range(readgen->original_keyrange()),
+      items_index(0),
+      fanned_out(false) { }
+
+reader_t::~reader_t() {
+    drainer.reset();
+}
 
 void reader_t::add_transformation(transform_variant_t &&tv) {
     r_sanity_check(!started);
@@ -118,7 +152,7 @@ void reader_t::accumulate(env_t *env, eager_acc_t *acc, const terminal_variant_t
     started = shards_exhausted = true;
     batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
     read_t read = readgen->terminal_read(transforms, tv, batchspec);
-    result_t res = do_read(env, std::move(read)).result;
+    result_t res = do_read(std::move(read), env->interruptor).result;
     acc->add_res(&res);
 }
 
@@ -127,7 +161,7 @@ void reader_t::accumulate_all(env_t *env, eager_acc_t *acc) {
     started = true;
     batchspec_t batchspec = batchspec_t::all();
     read_t read = readgen->next_read(active_range, transforms, batchspec);
-    rget_read_response_t resp = do_read(env, std::move(read));
+    rget_read_response_t resp = do_read(std::move(read), env->interruptor);
 
     auto rr = boost::get<rget_read_t>(&read.read);
     auto final_key = !reversed(rr->sorting) ? store_key_t::max() : store_key_t::min();
@@ -138,18 +172,23 @@ void reader_t::accumulate_all(env_t *env, eager_acc_t *acc) {
     acc->add_res(&resp.result);
 }
 
-rget_read_response_t reader_t::do_read(env_t *env, const read_t &read) {
+read_response_t reader_t::do_raw_read(const read_t &read, signal_t *interruptor) {
     read_response_t res;
     try {
         if (use_outdated) {
-            ns_access.get_namespace_if().read_outdated(read, &res, env->interruptor);
+            ns_access.get_namespace_if().read_outdated(read, &res, interruptor);
         } else {
             ns_access.get_namespace_if().read(
-                read, &res, order_token_t::ignore, env->interruptor);
+                read, &res, order_token_t::ignore, interruptor);
         }
     } catch (const cannot_perform_query_exc_t &e) {
         rfail_datum(ql::base_exc_t::GENERIC, "cannot perform read: %s", e.what());
     }
+    return res;
+}
+
+rget_read_response_t reader_t::do_read(const read_t &read, signal_t *interruptor) {
+    read_response_t res = do_raw_read(read, interruptor);
     auto rget_res = boost::get<rget_read_response_t>(&res.response);
     r_sanity_check(rget_res != NULL);
     if (auto e = boost::get<ql::exc_t>(&rget_res->result)) {
@@ -158,8 +197,10 @@ rget_read_response_t reader_t::do_read(env_t *env, const read_t &read) {
     return std::move(*rget_res);
 }
 
-std::vector<rget_item_t> reader_t::do_range_read(env_t *env, const read_t &read) {
-    rget_read_response_t res = do_read(env, read);
+std::vector<rget_item_t> reader_t::do_range_read(
+        const read_t &read, signal_t *interruptor,
+        key_range_t *range, bool *exhausted_out) {
+    rget_read_response_t res = do_read(read, interruptor);
 
     // It's called `do_range_read`.  If we have more than one type of range
     // read (which we might; rget_read_t should arguably be two types), this
@@ -182,7 +223,7 @@ std::vector<rget_item_t> reader_t::do_range_read(env_t *env, const read_t &read)
         *key = rng.left;
     }
 
-    shards_exhausted = readgen->update_range(&active_range, res.last_key);
+    *exhausted_out = readgen->update_range(range, res.last_key);
     grouped_t<stream_t> *gs = boost::get<grouped_t<stream_t> >(&res.result);
     return groups_to_batch(gs->get_underlying_map());
 }
@@ -192,12 +233,14 @@ bool reader_t::load_items(env_t *env, const batchspec_t &batchspec) {
     if (items_index >= items.size() && !shards_exhausted) { // read some more
         items_index = 0;
         items = do_range_read(
-            env, readgen->next_read(active_range, transforms, batchspec));
+            readgen->next_read(active_range, transforms, batchspec),
+            env->interruptor, &active_range, &shards_exhausted);
         // Everything below this point can handle `items` being empty (this is
         // good hygiene anyway).
         while (boost::optional<read_t> read = readgen->sindex_sort_read(
                    active_range, items, transforms, batchspec)) {
-            std::vector<rget_item_t> new_items = do_range_read(env, *read);
+            std::vector<rget_item_t> new_items = do_range_read(
+                *read, env->interruptor, &active_range, &shards_exhausted);
             if (new_items.size() == 0) {
                 break;
             }
@@ -225,9 +268,208 @@ bool reader_t::load_items(env_t *env, const batchspec_t &batchspec) {
     return items_index < items.size();
 }
 
+uint64_t reader_t::skip(env_t *env, uint64_t n) {
+    if (started || !readgen->can_seek() || !transforms.empty()) {
+        return 0;
+    }
+    const bool reverse = reversed(readgen->get_sorting());
+    uint64_t skipped = 0;
+    uint64_t target = n;
+    for (int round = 0;
+         round < SKIP_SEEK_MAX_ROUNDS && target >= SKIP_SEEK_MIN_ROWS;
+         ++round) {
+        store_key_t key;
+        if (!find_skip_key(env, target, reverse, &key)) {
+            break;
+        }
+        key_range_t skipped_range = active_range;
+        if (!reverse) {
+            skipped_range.right = key_range_t::right_bound_t(key);
+        } else {
+            skipped_range.left = key;
+        }
+        // The distribution is only an estimate, the count isn't.
+        const uint64_t count = count_rows(env, skipped_range);
+        if (count > n - skipped) {
+            target /= 2;
+            continue;
+        }
+        if (!reverse) {
+            active_range.left = key;
+        } else {
+            active_range.right = key_range_t::right_bound_t(key);
+        }
+        skipped += count;
+        target = n - skipped;
+        if (active_range.is_empty()) {
+            break;
+        }
+    }
+    return skipped;
+}
+
+bool reader_t::find_skip_key(env_t *env, uint64_t target, bool reverse,
+                             store_key_t *out) {
+    rdb_protocol_t::distribution_read_t dg(0, SKIP_SEEK_SAMPLE_COUNT,
+                                           SKIP_SEEK_SAMPLE_COUNT);
+    dg.region = region_t(active_range);
+    read_response_t res = do_raw_read(read_t(dg, env->profile()), env->interruptor);
+    auto dist = boost::get<rdb_protocol_t::distribution_read_response_t>(&res.response);
+    r_sanity_check(dist != NULL);
+    // `key_counts[k]` is the number of keys from `k` to the next key.
+    const std::map<store_key_t, int64_t> &counts = dist->key_counts;
+    bool found = false;
+    uint64_t total = 0;
+    if (!reverse) {
+        for (auto it = counts.begin(); it != counts.end(); ++it) {
+            if (total > target) {
+                break;
+            }
+            if (active_range.left < it->first) {
+                *out = it->first;
+                found = true;
+            }
+            total += std::max<int64_t>(it->second, 0);
+        }
+    } else {
+        for (auto it = counts.rbegin(); it != counts.rend(); ++it) {
+            total += std::max<int64_t>(it->second, 0);
+            if (total > target) {
+                break;
+            }
+            if (active_range.right.unbounded || it->first < active_range.right.key) {
+                *out = it->first;
+                found = true;
+            }
+        }
+    }
+    return found && active_range.contains_key(*out);
+}
+
+uint64_t reader_t::count_rows(env_t *env, const key_range_t &range) {
+    // Counting doesn't load the rows, it only walks the keys.
+    read_t read = readgen->next_read(
+        range, transforms, batchspec_t::user(batch_type_t::TERMINAL, env));
+    auto rr = boost::get<rget_read_t>(&read.read);
+    r_sanity_check(rr != NULL);
+    rr->terminal = terminal_variant_t(count_wire_func_t());
+    rget_read_response_t res = do_read(read, env->interruptor);
+    auto counts = boost::get<grouped_t<uint64_t> >(&res.result);
+    r_sanity_check(counts != NULL);
+    return groups_to_batch(counts->get_underlying_map());
+}
+
+bool reader_t::start_fan_out(env_t *env, const batchspec_t &batchspec) {
+    // Profiles expect the reads of a batch to happen during `next_batch`.
+    if (!readgen->can_fan_out() || env->trace.has()
+        || batchspec.get_batch_type() == batch_type_t::SINDEX_CONSTANT) {
+        return false;
+    }
+    std::set<region_t> scheme;
+    try {
+        scheme = ns_access.get_namespace_if().get_sharding_scheme();
+    } catch (const cannot_perform_query_exc_t &) {
+        // The first read will report this.
+        return false;
+    }
+    std::vector<shard_t> new_shards;
+    for (auto it = scheme.begin(); it != scheme.end(); ++it) {
+        key_range_t range = it->inner.intersection(active_range);
+        if (!range.is_empty()) {
+            shard_t shard;
+            shard.active_range = range;
+            shard.reading = shard.exhausted = false;
+            new_shards.push_back(shard);
+        }
+    }
+    if (new_shards.size() < 2) {
+        return false;
+    }
+    fanned_out = true;
+    shards = std::move(new_shards);
+    shard_read_done.init(new cond_t());
+    drainer.init(new auto_drainer_t());
+    return true;
+}
+
+void reader_t::read_shard(size_t shard, batchspec_t batchspec,
+                          auto_drainer_t::lock_t lock) {
+    std::vector<rget_item_t> shard_items;
+    try {
+        read_t read = readgen->next_read(shards[shard].active_range,
+                                         transforms, batchspec);
+        shard_items = do_range_read(read, lock.get_drain_signal(),
+                                    &shards[shard].active_range,
+                                    &shards[shard].exhausted);
+    } catch (const interrupted_exc_t &) {
+        // The reader is going away.
+        return;
+    } catch (const std::exception &) {
+        shard_error = std::current_exception();
+    }
+    // Like `load_items`, we take an empty batch to mean the shard is done.
+    if (shard_items.empty()) {
+        shards[shard].exhausted = true;
+    } else {
+        arrived.push_back(std::make_pair(shard, std::move(shard_items)));
+    }
+    shards[shard].reading = false;
+    shard_read_done->pulse_if_not_already_pulsed();
+}
+
+std::vector<counted_t<const datum_t> > reader_t::next_fanned_out_batch(
+        env_t *env, const batchspec_t &batchspec) {
+    for (;;) {
+        if (shard_error != std::exception_ptr()) {
+            std::exception_ptr error = shard_error;
+            shard_error = std::exception_ptr();
+            std::rethrow_exception(error);
+        }
+
+        // Start reading every shard that isn't being read and has nothing waiting to
+        // be handed out, so that the rows after this batch are on their way.
+        std::vector<bool> waiting(shards.size(), false);
+        for (auto it = arrived.begin(); it != arrived.end(); ++it) {
+            waiting[it->first] = true;
+        }
+        bool any_reading = false;
+        for (size_t i = 0; i < shards.size(); ++i) {
+            if (!shards[i].reading && !shards[i].exhausted && !waiting[i]) {
+                shards[i].reading = true;
+                coro_t::spawn_sometime(std::bind(&reader_t::read_shard, this, i,
+                                                 batchspec, drainer->lock()));
+            }
+            any_reading |= shards[i].reading;
+        }
+
+        if (!arrived.empty()) {
+            std::vector<rget_item_t> batch_items = std::move(arrived.front().second);
+            arrived.pop_front();
+            std::vector<counted_t<const datum_t> > res;
+            res.reserve(batch_items.size());
+            for (auto it = batch_items.begin(); it != batch_items.end(); ++it) {
+                res.push_back(std::move(it->data));
+            }
+            return res;
+        }
+        if (!any_reading) {
+            shards_exhausted = true;
+            return std::vector<counted_t<const datum_t> >();
+        }
+        shard_read_done->reset();
+        wait_interruptible(shard_read_done.get(), env->interruptor);
+    }
+}
+
 std::vector<counted_t<const datum_t> >
 reader_t::next_batch(env_t *env, const batchspec_t &batchspec) {
-    started = true;
+    if (!started) {
+        started = true;
+        start_fan_out(env, batchspec);
+    }
+    if (fanned_out) {
+        return next_fanned_out_batch(env, batchspec);
+    }
     if (!load_items(env, batchspec)) {
         return std::vector<counted_t<const datum_t> >();
     }
@@ -287,6 +529,7 @@ reader_t::next_batch(env_t *env, const batchspec_t &batchspec) {
     } break;
     default: unreachable();
     }
+    profile::count_rows_returned(env->trace.get_or_null(), res.size());
 
     if (items_index >= items.size()) { // free memory immediately
         items_index = 0;
@@ -299,6 +542,17 @@ reader_t::next_batch(env_t *env, const batchspec_t &batchspec) {
 }
 
 bool reader_t::is_finished() const {
+    if (fanned_out) {
+        if (!arrived.empty()) {
+            return false;
+        }
+        for (auto it = shards.begin(); it != shards.end(); ++it) {
+            if (it->reading || !it->exhausted) {
+                return false;
+            }
+        }
+        return true;
+    }
     return shards_exhausted && items_index >= items.size();
 }
 
@@ -403,6 +657,10 @@ std::string primary_readgen_t::sindex_name() const {
     return "";
 }
 
+bool primary_readgen_t::can_fan_out() const {
+    return sorting == sorting_t::UNORDERED;
+}
+
 sindex_readgen_t::sindex_readgen_t(
     const std::map<std::string, wire_func_t> &global_optargs,
     const std::string &_sindex,
@@ -513,7 +771,7 @@ counted_t<val_t> datum_stream_t::run_terminal(
 }
 
 counted_t<val_t> datum_stream_t::to_array(env_t *env) {
-    scoped_ptr_t<eager_acc_t> acc(make_to_array());
+    scoped_ptr_t<eager_acc_t> acc(make_to_array(env));
     accumulate_all(env, acc.get());
     return acc->finish_eager(backtrace(), is_grouped());
 }
@@ -637,10 +895,12 @@ eager_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &bs) {
 counted_t<const datum_t> eager_datum_stream_t::as_array(env_t *env) {
     if (is_grouped()) return counted_t<const datum_t>();
     datum_ptr_t arr(datum_t::R_ARRAY);
+    memory_charge_t arr_charge(env);
     batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
     {
         profile::sampler_t sampler("Evaluating stream eagerly.", env->trace);
         while (counted_t<const datum_t> d = next(env, batchspec)) {
+            arr_charge.add(d);
             arr.add(d);
             sampler.new_sample();
         }
@@ -684,6 +944,13 @@ bool lazy_datum_stream_t::is_exhausted() const {
     return reader.is_finished() && batch_cache_exhausted();
 }
 
+uint64_t lazy_datum_stream_t::skip_ahead(env_t *env, uint64_t n) {
+    if (!batch_cache_exhausted() || current_batch_offset < current_batch.size()) {
+        return 0;
+    }
+    return reader.skip(env, n);
+}
+
 array_datum_stream_t::array_datum_stream_t(counted_t<const datum_t> _arr,
                                            const protob_t<const Backtrace> &bt_source)
     : eager_datum_stream_t(bt_source), index(0), arr(_arr) { }
@@ -761,6 +1028,294 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
     return ret;
 }
 
+// HASH_JOIN_DATUM_STREAM_T
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+    counted_t<datum_stream_t> _source,
+    counted_t<func_t> _left_key,
+    std::vector<counted_t<const datum_t> > &&_right,
+    counted_t<func_t> _right_key,
+    bool _outer)
+    : wrapper_datum_stream_t(_source), left_key(_left_key), right_key(_right_key),
+      outer(_outer), right(std::move(_right)), table_built(false) {
+    guarantee(left_key.has() && right_key.has());
+}
+
+void hash_join_datum_stream_t::build_table(env_t *env) {
+    profile::sampler_t sampler("Building join table.", env->trace);
+    for (auto it = right.begin(); it != right.end(); ++it) {
+        sampler.new_sample();
+        counted_t<const datum_t> key = right_key->call(env, *it)->as_datum();
+        table[key].push_back(std::move(*it));
+    }
+    right.clear();
+    table_built = true;
+}
+
+std::vector<counted_t<const datum_t> >
+hash_join_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<counted_t<const datum_t> > ret;
+    while (ret.size() == 0) {
+        std::vector<counted_t<const datum_t> > v = source->next_batch(env, batchspec);
+        if (v.size() == 0) {
+            break;
+        }
+        if (!table_built) {
+            build_table(env);
+        }
+        profile::sampler_t sampler("Probing join table.", env->trace);
+        for (auto it = v.begin(); it != v.end(); ++it) {
+            sampler.new_sample();
+            // Like the nested loop, never look at the left row if there's nothing
+            // to join it with.
+            auto match = table.end();
+            if (!table.empty()) {
+                match = table.find(left_key->call(env, *it)->as_datum());
+            }
+            if (match != table.end()) {
+                for (auto r = match->second.begin(); r != match->second.end(); ++r) {
+                    std::map<std::string, counted_t<const datum_t> > pair;
+                    pair["left"] = *it;
+                    pair["right"] = *r;
+                    ret.push_back(make_counted<const datum_t>(std::move(pair)));
+                }
+            } else if (outer) {
+                std::map<std::string, counted_t<const datum_t> > pair;
+                pair["left"] = *it;
+                ret.push_back(make_counted<const datum_t>(std::move(pair)));
+            }
+        }
+    }
+    return ret;
+}
+
+// EQ_JOIN_DATUM_STREAM_T
+eq_join_datum_stream_t::eq_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                                               counted_t<func_t> _left_key,
+                                               counted_t<table_t> _table)
+    : wrapper_datum_stream_t(_source), left_key(_left_key), table(_table) {
+    guarantee(left_key.has() && table.has());
+}
+
+eq_join_datum_stream_t::~eq_join_datum_stream_t() { }
+
+std::vector<counted_t<const datum_t> >
+eq_join_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<counted_t<const datum_t> > ret;
+    while (ret.size() == 0) {
+        std::vector<counted_t<const datum_t> > v = source->next_batch(env, batchspec);
+        if (v.size() == 0) {
+            break;
+        }
+        std::vector<counted_t<const datum_t> > keys;
+        keys.reserve(v.size());
+        {
+            profile::sampler_t sampler("Evaluating eq_join keys.", env->trace);
+            for (auto it = v.begin(); it != v.end(); ++it) {
+                sampler.new_sample();
+                keys.push_back(left_key->call(env, *it)->as_datum());
+            }
+        }
+        std::vector<counted_t<const datum_t> > rows = table->get_rows(env, keys);
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (rows[i]->get_type() != datum_t::R_NULL) {
+                std::map<std::string, counted_t<const datum_t> > pair;
+                pair["left"] = v[i];
+                pair["right"] = rows[i];
+                ret.push_back(make_counted<const datum_t>(std::move(pair)));
+            }
+        }
+    }
+    return ret;
+}
+
+// EXTERNAL_SORT_DATUM_STREAM_T
+external_sort_datum_stream_t::external_sort_datum_stream_t(
+    spill_storage_t *_spill_storage,
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const counted_t<const datum_t> &,
+                       const counted_t<const datum_t> &)> _lt_cmp,
+    const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src), spill_storage(_spill_storage), lt_cmp(_lt_cmp),
+      started(false) {
+    guarantee(spill_storage != NULL);
+}
+
+external_sort_datum_stream_t::~external_sort_datum_stream_t() { }
+
+void external_sort_datum_stream_t::add_run(
+    env_t *env, std::vector<counted_t<const datum_t> > &&run) {
+    guarantee(!started);
+    {
+        profile::sampler_t sampler("Sorting in-memory.", env->trace);
+        std::sort(run.begin(), run.end(),
+                  std::bind(lt_cmp, env, &sampler, ph::_1, ph::_2));
+    }
+    profile::starter_t starter("Writing sorted run to disk.", env->trace);
+    scoped_ptr_t<disk_backed_queue_t<counted_t<const datum_t> > > queue(
+        new disk_backed_queue_t<counted_t<const datum_t> >(
+            spill_storage->io_backender,
+            serializer_filepath_t(spill_storage->base_path,
+                                  "orderby_" + uuid_to_str(generate_uuid())),
+            spill_storage->stats_parent));
+    for (auto it = run.begin(); it != run.end(); ++it) {
+        queue->push(*it);
+    }
+    run.clear();
+    runs.push_back(std::move(queue));
+}
+
+bool external_sort_datum_stream_t::is_exhausted() const {
+    if (!started) {
+        return runs.empty() && batch_cache_exhausted();
+    }
+    for (auto it = heads.begin(); it != heads.end(); ++it) {
+        if (it->has()) {
+            return false;
+        }
+    }
+    return batch_cache_exhausted();
+}
+
+std::vector<counted_t<const datum_t> >
+external_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    if (!started) {
+        started = true;
+        heads.resize(runs.size());
+        for (size_t i = 0; i < runs.size(); ++i) {
+            if (!runs[i]->empty()) {
+                runs[i]->pop(&heads[i]);
+            }
+        }
+    }
+
+    std::vector<counted_t<const datum_t> > ret;
+    batcher_t batcher = batchspec.to_batcher();
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    while (!batcher.should_send_batch()) {
+        // There are few runs (each holds up to `array_size_limit()` elements), so a
+        // linear scan for the smallest head is good enough.
+        size_t min = heads.size();
+        for (size_t i = 0; i < heads.size(); ++i) {
+            if (heads[i].has()
+                && (min == heads.size() || lt_cmp(env, &sampler, heads[i], heads[min]))) {
+                min = i;
+            }
+        }
+        if (min == heads.size()) {
+            break;
+        }
+        batcher.note_el(heads[min]);
+        ret.push_back(std::move(heads[min]));
+        heads[min].reset();
+        if (!runs[min]->empty()) {
+            runs[min]->pop(&heads[min]);
+        }
+    }
+    return ret;
+}
+
+// DISTINCT_DATUM_STREAM_T
+distinct_datum_stream_t::distinct_datum_stream_t(counted_t<datum_stream_t> _source,
+                                                 bool _sorted)
+    : wrapper_datum_stream_t(_source), sorted(_sorted), source_done(false) { }
+
+bool distinct_datum_stream_t::is_exhausted() const {
+    return (source_done || (source->is_exhausted() && overflow.empty()))
+        && (!spilled.has() || spilled->is_exhausted())
+        && batch_cache_exhausted();
+}
+
+static bool distinct_lt(env_t *, profile::sampler_t *,
+                        const counted_t<const datum_t> &l,
+                        const counted_t<const datum_t> &r) {
+    return *l < *r;
+}
+
+std::vector<counted_t<const datum_t> >
+distinct_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<counted_t<const datum_t> > ret;
+    if (!source_done) {
+        read_source(env, batchspec, &ret);
+    }
+    if (ret.empty() && spilled.has()) {
+        read_spilled(env, batchspec, &ret);
+    }
+    return ret;
+}
+
+void distinct_datum_stream_t::read_source(
+    env_t *env, const batchspec_t &batchspec,
+    std::vector<counted_t<const datum_t> > *out) {
+    profile::sampler_t sampler("Removing duplicates.", env->trace);
+    while (out->empty()) {
+        std::vector<counted_t<const datum_t> > data = source->next_batch(env, batchspec);
+        if (data.empty()) {
+            source_done = true;
+            seen.clear();
+            if (!overflow.empty()) {
+                spilled->add_run(env, std::move(overflow));
+                overflow.clear();
+            }
+            return;
+        }
+        for (auto it = data.begin(); it != data.end(); ++it) {
+            if (sorted) {
+                // Equal values are next to each other in the index, except that
+                // values whose index keys got truncated are ordered by primary key.
+                store_key_t key = (*it)->truncated_secondary();
+                if (key != run_key) {
+                    seen.clear();
+                    run_key = std::move(key);
+                }
+                if (seen.insert(*it).second) {
+                    out->push_back(std::move(*it));
+                }
+            } else if (seen.count(*it) == 0) {
+                if (seen.size() < array_size_limit()) {
+                    seen.insert(*it);
+                    out->push_back(std::move(*it));
+                } else {
+                    // `seen` doesn't change anymore, so the rows we spill are
+                    // never ones we've already returned.
+                    rcheck(env->spill_storage != NULL, base_exc_t::GENERIC,
+                           strprintf("Array over size limit %zu.",
+                                     seen.size() + 1).c_str());
+                    if (!spilled.has()) {
+                        spilled = make_counted<external_sort_datum_stream_t>(
+                            env->spill_storage, &distinct_lt, backtrace());
+                    }
+                    overflow.push_back(std::move(*it));
+                    if (overflow.size() >= array_size_limit()) {
+                        spilled->add_run(env, std::move(overflow));
+                        overflow.clear();
+                    }
+                }
+            }
+            sampler.new_sample();
+        }
+    }
+}
+
+void distinct_datum_stream_t::read_spilled(
+    env_t *env, const batchspec_t &batchspec,
+    std::vector<counted_t<const datum_t> > *out) {
+    // The merged runs are sorted, so their duplicates are next to each other.
+    while (out->empty()) {
+        std::vector<counted_t<const datum_t> > data
+            = spilled->next_batch(env, batchspec);
+        if (data.empty()) {
+            return;
+        }
+        for (auto it = data.begin(); it != data.end(); ++it) {
+            if (!last_spilled.has() || *last_spilled != **it) {
+                last_spilled = *it;
+                out->push_back(std::move(*it));
+            }
+        }
+    }
+}
+
 // INDEXES_OF_DATUM_STREAM_T
 indexes_of_datum_stream_t::indexes_of_datum_stream_t(counted_t<func_t> _f,
                                                      counted_t<datum_stream_t> _source)
@@ -798,6 +1353,9 @@ slice_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &_batchspec)
         return std::vector<counted_t<const datum_t> >();
     }
 
+    if (index == 0 && left > 0) {
+        index = source->skip_ahead(env, left);
+    }
     const batchspec_t batchspec = _batchspec.with_at_most(right - index);
 
     profile::sampler_t sampler("Slicing eagerly.", env->trace);
@@ -897,10 +1455,12 @@ counted_t<const datum_t> union_datum_stream_t::as_array(env_t *env) {
         return counted_t<const datum_t>();
     }
     datum_ptr_t arr(datum_t::R_ARRAY);
+    memory_charge_t arr_charge(env);
     batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
     {
         profile::sampler_t sampler("Evaluating stream eagerly.", env->trace);
         while (counted_t<const datum_t> d = next(env, batchspec)) {
+            arr_charge.add(d);
             arr.add(d);
             sampler.new_sample();
         }
@@ -4,10 +4,13 @@
 
 #include <algorithm>
 #include <deque>
+#include <exception>
 #include <list>
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -19,11 +22,17 @@
 #include <boost/variant/get.hpp>
 
 #include "clustering/administration/namespace_interface_repository.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "rdb_protocol/protocol.hpp"
 
+template <class T> class disk_backed_queue_t;
+
 namespace ql {
 
 class env_t;
+class spill_storage_t;
+class table_t;
 
 /* This wraps a namespace_interface_t and makes it automatically handle getting
  * profiling information from them. It acheives this by doing the following in
@@ -48,6 +57,11 @@ public:
                        rdb_protocol_t::read_response_t *response,
                        signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
+    void read_bounded_staleness(const rdb_protocol_t::read_t &,
+                                rdb_protocol_t::read_response_t *response,
+                                int64_t max_staleness_ms,
+                                signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
     void write(rdb_protocol_t::write_t *,
                rdb_protocol_t::write_response_t *response,
                order_token_t tok,
@@ -120,6 +134,12 @@ public:
         env_t *env, eager_acc_t *acc, const terminal_variant_t &tv) = 0;
     virtual void accumulate_all(env_t *env, eager_acc_t *acc) = 0;
 
+    // Drops up to `n` elements from the front of the stream without reading them,
+    // if the stream can do that cheaply, and returns how many it dropped.  Only
+    // lazy streams of rows in primary key order (or no order) that haven't been
+    // read from can.
+    virtual uint64_t skip_ahead(UNUSED env_t *env, UNUSED uint64_t n) { return 0; }
+
 protected:
     bool batch_cache_exhausted() const;
     void check_not_grouped();
@@ -249,6 +269,124 @@ size_t index;
 std::vector<counted_t<const datum_t> > data;
 };
 
+// Joins `source` with an in-memory sequence on `left_key(row) == right_key(row)`,
+// producing the same `{left: ..., right: ...}` objects in the same order as the
+// nested loop that `inner_join` and `outer_join` rewrite to.  The keys of the
+// in-memory side are only computed once `source` turns out not to be empty.
+class hash_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    hash_join_datum_stream_t(counted_t<datum_stream_t> source,
+                             counted_t<func_t> left_key,
+                             std::vector<counted_t<const datum_t> > &&right,
+                             counted_t<func_t> right_key,
+                             bool outer);
+
+private:
+    std::vector<counted_t<const datum_t> >
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+    void build_table(env_t *env);
+
+    const counted_t<func_t> left_key;
+    const counted_t<func_t> right_key;
+    // If set, left rows without a match produce `{left: ...}`.
+    const bool outer;
+
+    // Moved into `table` by `build_table`.
+    std::vector<counted_t<const datum_t> > right;
+    bool table_built;
+    std::unordered_map<counted_t<const datum_t>, std::vector<counted_t<const datum_t> >,
+                       datum_hash_t, datum_equal_t> table;
+};
+
+// Joins `source` with the rows of `table` whose primary key is `left_key(row)`,
+// like `eq_join` on the primary index.  The rows for a whole batch of `source` are
+// read at once, with one read per shard.
+class eq_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    eq_join_datum_stream_t(counted_t<datum_stream_t> source,
+                           counted_t<func_t> left_key,
+                           counted_t<table_t> table);
+    ~eq_join_datum_stream_t();
+
+private:
+    std::vector<counted_t<const datum_t> >
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    const counted_t<func_t> left_key;
+    const counted_t<table_t> table;
+};
+
+// Sorts a sequence too big to hold in memory.  The sequence is handed over in
+// runs, which are sorted and written to disk; reading from the stream merges them.
+class external_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    external_sort_datum_stream_t(
+        spill_storage_t *spill_storage,
+        std::function<bool(env_t *,  // NOLINT(readability/casting)
+                           profile::sampler_t *,
+                           const counted_t<const datum_t> &,
+                           const counted_t<const datum_t> &)> lt_cmp,
+        const protob_t<const Backtrace> &bt_src);
+    ~external_sort_datum_stream_t();
+
+    // Must not be called once the stream has been read from.
+    void add_run(env_t *env, std::vector<counted_t<const datum_t> > &&run);
+
+    virtual bool is_exhausted() const;
+
+private:
+    virtual bool is_array() { return false; }
+    virtual std::vector<counted_t<const datum_t> >
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    spill_storage_t *const spill_storage;
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const counted_t<const datum_t> &,
+                       const counted_t<const datum_t> &)> lt_cmp;
+    std::vector<scoped_ptr_t<disk_backed_queue_t<counted_t<const datum_t> > > > runs;
+    // The smallest element of each run that hasn't been returned yet, or an empty
+    // pointer if there is none left.
+    std::vector<counted_t<const datum_t> > heads;
+    bool started;
+};
+
+// Returns the rows of `source` that aren't equal to an earlier row, as they
+// arrive.  The first `array_size_limit()` unique rows are remembered in a hash
+// set; rows that aren't in it once it's full are spilled to disk in runs, which
+// are merged and deduplicated and returned (in sorted order) after `source` is
+// done.  If `sorted` is set, `source` must be the values of an index in index
+// order, and only the rows that share a truncated index key are remembered.
+class distinct_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    distinct_datum_stream_t(counted_t<datum_stream_t> source, bool sorted);
+
+    virtual bool is_exhausted() const;
+
+private:
+    typedef std::unordered_set<counted_t<const datum_t>, datum_hash_t, datum_equal_t>
+        datum_set_t;
+
+    std::vector<counted_t<const datum_t> >
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+    void read_source(env_t *env, const batchspec_t &batchspec,
+                     std::vector<counted_t<const datum_t> > *out);
+    void read_spilled(env_t *env, const batchspec_t &batchspec,
+                      std::vector<counted_t<const datum_t> > *out);
+
+    const bool sorted;
+    bool source_done;
+
+    datum_set_t seen;
+    // If `sorted`, `seen` holds the rows whose truncated index key is `run_key`.
+    store_key_t run_key;
+
+    // The rows not in `seen` since the last run was spilled.
+    std::vector<counted_t<const datum_t> > overflow;
+    counted_t<external_sort_datum_stream_t> spilled;
+    counted_t<const datum_t> last_spilled;
+};
+
 class union_datum_stream_t : public datum_stream_t {
 public:
     union_datum_stream_t(std::vector<counted_t<datum_stream_t> > &&_streams,
@@ -307,6 +445,14 @@ public:
 
     virtual key_range_t original_keyrange() const = 0;
     virtual std::string sindex_name() const = 0; // Used for error checking.
+    // True if reads of disjoint parts of `original_keyrange()` can be made and
+    // their results handed out in any order.
+    virtual bool can_fan_out() const { return false; }
+    // True if the rows come in the order of their primary keys (or in no order),
+    // so the first n of them are the rows of some prefix of the key range (or
+    // suffix, if the sorting is reversed).
+    virtual bool can_seek() const { return false; }
+    sorting_t get_sorting() const { return sorting; }
 
     // Returns `true` if there is no more to read.
     bool update_range(key_range_t *active_range,
@@ -345,6 +491,8 @@ private:
     virtual void sindex_sort(std::vector<rget_item_t> *vec) const;
     virtual key_range_t original_keyrange() const;
     virtual std::string sindex_name() const; // Used for error checking.
+    virtual bool can_fan_out() const;
+    virtual bool can_seek() const { return true; }
 };
 
 class sindex_readgen_t : public readgen_t {
@@ -381,17 +529,40 @@ public:
         const rdb_namespace_access_t &ns_access,
         bool use_outdated,
         scoped_ptr_t<readgen_t> &&readgen);
+    ~reader_t();
     void add_transformation(transform_variant_t &&tv);
     void accumulate(env_t *env, eager_acc_t *acc, const terminal_variant_t &tv);
     void accumulate_all(env_t *env, eager_acc_t *acc);
     std::vector<counted_t<const datum_t> >
     next_batch(env_t *env, const batchspec_t &batchspec);
     bool is_finished() const;
+    // Skips up to `n` rows before anything has been read, by moving the start of
+    // the range past keys that the shards count that many rows before.  Returns
+    // how many rows it skipped, which is 0 unless the rows are in primary key
+    // order (or no order) and are transformed in no way.
+    uint64_t skip(env_t *env, uint64_t n);
 private:
     // Returns `true` if there's data in `items`.
     bool load_items(env_t *env, const batchspec_t &batchspec);
-    rget_read_response_t do_read(env_t *env, const read_t &read);
-    std::vector<rget_item_t> do_range_read(env_t *env, const read_t &read);
+    read_response_t do_raw_read(const read_t &read, signal_t *interruptor);
+    rget_read_response_t do_read(const read_t &read, signal_t *interruptor);
+    // Picks a key to move the start of the range to (or the end, if `reverse`)
+    // that a sampled distribution puts at most `target` rows from it.  Returns
+    // false if there is none.
+    bool find_skip_key(env_t *env, uint64_t target, bool reverse, store_key_t *out);
+    uint64_t count_rows(env_t *env, const key_range_t &range);
+    // Reads `read`, which covers `*range`, and moves `*range` past what was read.
+    // `*exhausted_out` is set if nothing is left of it.
+    std::vector<rget_item_t> do_range_read(
+        const read_t &read, signal_t *interruptor,
+        key_range_t *range, bool *exhausted_out);
+
+    // An unordered read of a table with several shards reads each shard on its own
+    // (see `next_fanned_out_batch`).  Returns false if this read can't.
+    bool start_fan_out(env_t *env, const batchspec_t &batchspec);
+    std::vector<counted_t<const datum_t> > next_fanned_out_batch(
+        env_t *env, const batchspec_t &batchspec);
+    void read_shard(size_t shard, batchspec_t batchspec, auto_drainer_t::lock_t lock);
 
     rdb_namespace_access_t ns_access;
     const bool use_outdated;
@@ -404,6 +575,24 @@ private:
     // We need this to handle the SINDEX_CONSTANT case.
     std::vector<rget_item_t> items;
     size_t items_index;
+
+    // Set if the read is fanned out.  Each shard is read by its own coroutine, at
+    // most one batch ahead, and the batches are handed out in the order they arrive,
+    // so a slow shard doesn't hold up the rows of the others.
+    struct shard_t {
+        key_range_t active_range;
+        bool reading, exhausted;
+    };
+    bool fanned_out;
+    std::vector<shard_t> shards;
+    // Shard batches that arrived and haven't been handed out, with their shard.
+    std::deque<std::pair<size_t, std::vector<rget_item_t> > > arrived;
+    // The error of a shard read, thrown by the next `next_batch`.
+    std::exception_ptr shard_error;
+    // Pulsed when a shard read finishes.
+    scoped_ptr_t<cond_t> shard_read_done;
+    // Destroyed first, which interrupts the shard reads and waits for them.
+    scoped_ptr_t<auto_drainer_t> drainer;
 };
 
 class lazy_datum_stream_t : public datum_stream_t {
@@ -420,6 +609,7 @@ public:
     }
 
     bool is_exhausted() const;
+    virtual uint64_t skip_ahead(env_t *env, uint64_t n);
 private:
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
@@ -1,9 +1,13 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/env.hpp"
 
+#include <algorithm>
+#include <functional>
+
 #include "clustering/administration/database_metadata.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "config/args.hpp"
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/func.hpp"
@@ -21,6 +25,16 @@ bool is_joined(const T &multiple, const T &divisor) {
     return cpy == multiple;
 }
 
+static uint64_t memory_limit_optarg(protob_t<Query> q) {
+    if (q.has()) {
+        counted_t<const datum_t> limit = static_optarg("memory_limit", q);
+        if (limit.has() && limit->get_type() == datum_t::R_NUM && limit->as_num() > 0) {
+            return limit->as_num();
+        }
+    }
+    return QUERY_MEMORY_LIMIT;
+}
+
 counted_t<const datum_t> static_optarg(const std::string &key, protob_t<Query> q) {
     for (int i = 0; i < q->global_optargs_size(); ++i) {
         const Query::AssocPair &ap = q->global_optargs(i);
@@ -151,11 +165,11 @@ void cluster_access_t::join_and_wait_to_propagate(
     }
 }
 
-js_runner_t *env_t::get_js_runner() {
+js_runner_t *env_t::get_js_runner(const std::string &source) {
     assert_thread();
     r_sanity_check(extproc_pool != NULL);
     if (!js_runner.connected()) {
-        js_runner.begin(extproc_pool, interruptor);
+        js_runner.begin(extproc_pool, interruptor, std::hash<std::string>()(source));
     }
     return &js_runner;
 }
@@ -177,6 +191,9 @@ env_t::env_t(rdb_protocol_t::context_t *ctx, signal_t *_interruptor)
           NULL,
           ctx ? ctx->machine_id : uuid_u()),
       interruptor(_interruptor),
+      spill_storage(ctx ? ctx->spill_storage : NULL),
+      changefeed_client(ctx ? ctx->changefeed_client : NULL),
+      memory(QUERY_MEMORY_LIMIT),
       eval_callback(NULL) { }
 
 env_t::env_t(
@@ -202,6 +219,9 @@ env_t::env_t(
                    _directory_read_manager,
                    _this_machine),
     interruptor(_interruptor),
+    spill_storage(NULL),
+    changefeed_client(NULL),
+    memory(memory_limit_optarg(query)),
     eval_callback(NULL)
 {
     if (query.has()) {
@@ -238,6 +258,9 @@ env_t::env_t(
                    _directory_read_manager,
                    _this_machine),
     interruptor(_interruptor),
+    spill_storage(NULL),
+    changefeed_client(NULL),
+    memory(QUERY_MEMORY_LIMIT),
     eval_callback(NULL)
 {
     if (_profile == profile_bool_t::PROFILE) {
@@ -245,7 +268,39 @@ env_t::env_t(
     }
 }
 
-env_t::~env_t() { }
+env_t::~env_t() {
+    // Everything that charged memory to this query is gone by now.
+    rassert(memory.get_usage() == 0);
+}
+
+void memory_accountant_t::charge(uint64_t size) {
+    rcheck_datum(size <= limit && usage <= limit - size, base_exc_t::GENERIC,
+                 strprintf("Query uses more memory than its limit of %" PRIu64
+                           " bytes (set the `memory_limit` optarg to change it).",
+                           limit));
+    usage += size;
+    peak_usage = std::max(peak_usage, usage);
+}
+
+void memory_accountant_t::release(uint64_t size) {
+    rassert(size <= usage);
+    usage -= size;
+}
+
+void memory_charge_t::add(const counted_t<const datum_t> &datum) {
+    add(serialized_size(datum));
+}
+
+void memory_charge_t::add(uint64_t bytes) {
+    env->memory.charge(bytes);
+    size += bytes;
+    profile::count_memory(env->trace.get_or_null(), bytes);
+}
+
+void memory_charge_t::clear() {
+    env->memory.release(size);
+    size = 0;
+}
 
 void env_t::maybe_yield() {
     if (++evals_since_yield > EVALS_BEFORE_YIELD) {
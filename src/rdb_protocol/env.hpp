@@ -17,11 +17,75 @@
 #include "rdb_protocol/val.hpp"
 
 class extproc_pool_t;
+class io_backender_t;
+class perfmon_collection_t;
 
 namespace ql {
 class datum_t;
 class term_t;
 
+/* Where queries can spill data that doesn't fit in memory (see
+`external_sort_datum_stream_t`).  Only servers with a data directory have one. */
+class spill_storage_t {
+public:
+    spill_storage_t(io_backender_t *_io_backender, const base_path_t &_base_path,
+                    perfmon_collection_t *_stats_parent)
+        : io_backender(_io_backender), base_path(_base_path),
+          stats_parent(_stats_parent) { }
+
+    io_backender_t *const io_backender;
+    const base_path_t base_path;
+    perfmon_collection_t *const stats_parent;
+
+private:
+    DISABLE_COPYING(spill_storage_t);
+};
+
+/* Keeps track of the memory a query holds where it can hold a lot of it: the arrays
+and groups it builds and the rows it sorts or buffers.  The query fails once that
+goes over its limit, which is the `memory_limit` optarg or `QUERY_MEMORY_LIMIT`.
+Memory is charged through `memory_charge_t`. */
+class memory_accountant_t {
+public:
+    explicit memory_accountant_t(uint64_t _limit)
+        : limit(_limit), usage(0), peak_usage(0) { }
+
+    uint64_t get_limit() const { return limit; }
+    uint64_t get_usage() const { return usage; }
+    uint64_t get_peak_usage() const { return peak_usage; }
+
+private:
+    friend class memory_charge_t;
+    // Throws if `size` more bytes would go over the limit.
+    void charge(uint64_t size);
+    void release(uint64_t size);
+
+    uint64_t limit;
+    uint64_t usage;
+    uint64_t peak_usage;
+
+    DISABLE_COPYING(memory_accountant_t);
+};
+
+/* Charges the memory of what's added to it to the query until it's destroyed or
+cleared, so it should live as long as what it charges for (or at least as long
+as that's being built).  Datums are charged their serialized size. */
+class memory_charge_t {
+public:
+    explicit memory_charge_t(env_t *_env) : env(_env), size(0) { }
+    ~memory_charge_t() { clear(); }
+
+    void add(const counted_t<const datum_t> &datum);
+    void add(uint64_t bytes);
+    void clear();
+
+private:
+    env_t *env;
+    uint64_t size;
+
+    DISABLE_COPYING(memory_charge_t);
+};
+
 /* If and optarg with the given key is present and is of type DATUM it will be
  * returned. Otherwise an empty counted_t<const datum_t> will be returned. */
 counted_t<const datum_t> static_optarg(const std::string &key, protob_t<Query> q);
@@ -130,8 +194,9 @@ public:
     void maybe_yield();
 
     // Returns js_runner, but first calls js_runner->begin() if it hasn't
-    // already been called.
-    js_runner_t *get_js_runner();
+    // already been called.  `source` is the JS code about to be run; the job
+    // goes to the worker that ran it before if it can.
+    js_runner_t *get_js_runner(const std::string &source);
 
     // This is a callback used in unittests to control things during a query
     class eval_callback_t {
@@ -159,6 +224,14 @@ public:
 
     scoped_ptr_t<profile::trace_t> trace;
 
+    // May be NULL, in which case nothing is spilled to disk.
+    spill_storage_t *spill_storage;
+
+    // May be NULL, in which case there are no changefeeds.
+    changefeed::client_t *changefeed_client;
+
+    memory_accountant_t memory;
+
     profile_bool_t profile();
 
 private:
@@ -32,6 +32,13 @@ counted_t<val_t> func_t::call(env_t *env,
     return call(env, make_vector(arg1, arg2), eval_flags);
 }
 
+void func_t::call_on_each(env_t *env,
+                          std::vector<counted_t<const datum_t> > *items) const {
+    for (auto it = items->begin(); it != items->end(); ++it) {
+        *it = call(env, *it)->as_datum();
+    }
+}
+
 void func_t::assert_deterministic(const char *extra_msg) const {
     rcheck(is_deterministic(),
            base_exc_t::GENERIC,
@@ -98,7 +105,7 @@ counted_t<val_t> js_func_t::call(
         js_result_t result;
 
         try {
-            result = env->get_js_runner()->call(js_source, args, config);
+            result = env->get_js_runner(js_source)->call(js_source, args, config);
         } catch (const js_worker_exc_t &e) {
             rfail(base_exc_t::GENERIC,
                   "Javascript query `%s` caused a crash in a worker process.",
@@ -118,6 +125,44 @@ counted_t<val_t> js_func_t::call(
     }
 }
 
+void js_func_t::call_on_each(env_t *env,
+                             std::vector<counted_t<const datum_t> > *items) const {
+    if (items->empty()) {
+        return;
+    }
+    try {
+        js_runner_t::req_config_t config;
+        config.timeout_ms = js_timeout_ms;
+
+        r_sanity_check(!js_source.empty());
+        std::vector<js_result_t> results;
+
+        try {
+            results = env->get_js_runner(js_source)->call_each(js_source, *items, config);
+        } catch (const js_worker_exc_t &e) {
+            rfail(base_exc_t::GENERIC,
+                  "Javascript query `%s` caused a crash in a worker process.",
+                  js_source.c_str());
+        } catch (const interrupted_exc_t &e) {
+            rfail(base_exc_t::GENERIC,
+                  "JavaScript query `%s` timed out after "
+                  "%" PRIu64 ".%03" PRIu64 " seconds.",
+                  js_source.c_str(), js_timeout_ms / 1000, js_timeout_ms % 1000);
+        }
+
+        // The worker stops at the first error, which the visitor throws.
+        r_sanity_check(!results.empty() && results.size() <= items->size());
+        js_result_visitor_t visitor(js_source, js_timeout_ms, this);
+        for (size_t i = 0; i < results.size(); ++i) {
+            (*items)[i] = boost::apply_visitor(visitor, results[i])->as_datum();
+        }
+        r_sanity_check(results.size() == items->size());
+    } catch (const datum_exc_t &e) {
+        rfail(e.get_type(), "%s", e.what());
+        unreachable();
+    }
+}
+
 bool js_func_t::is_deterministic() const {
     return false;
 }
@@ -223,8 +268,7 @@ bool filter_match(counted_t<const datum_t> predicate, counted_t<const datum_t> v
     if (predicate->is_ptype(pseudo::literal_string)) {
         return *predicate->get(pseudo::value_key) == *value;
     } else {
-        const std::map<std::string, counted_t<const datum_t> > &obj
-            = predicate->as_object();
+        const datum_object_t &obj = predicate->as_object();
         for (auto it = obj.begin(); it != obj.end(); ++it) {
             r_sanity_check(it->second.has());
             counted_t<const datum_t> elt = value->get(it->first, NOTHROW);
@@ -242,7 +286,7 @@ bool filter_match(counted_t<const datum_t> predicate, counted_t<const datum_t> v
     }
 }
 
-bool reql_func_t::filter_helper(env_t *env, counted_t<const datum_t> arg) const {
+bool reql_func_t::filter_helper(env_t *env, const counted_t<const datum_t> &arg) const {
     counted_t<const datum_t> d = call(env, make_vector(arg), NO_FLAGS)->as_datum();
     if (d->get_type() == datum_t::R_OBJECT &&
         (body->get_src()->type() == Term::MAKE_OBJ ||
@@ -272,12 +316,13 @@ std::string js_func_t::print_source() const {
     return ret;
 }
 
-bool js_func_t::filter_helper(env_t *env, counted_t<const datum_t> arg) const {
+bool js_func_t::filter_helper(env_t *env, const counted_t<const datum_t> &arg) const {
     counted_t<const datum_t> d = call(env, make_vector(arg), NO_FLAGS)->as_datum();
     return d->as_bool();
 }
 
-bool func_t::filter_call(env_t *env, counted_t<const datum_t> arg, counted_t<func_t> default_filter_val) const {
+bool func_t::filter_call(env_t *env, const counted_t<const datum_t> &arg,
+                         counted_t<func_t> default_filter_val) const {
     // We have to catch every exception type and save it so we can rethrow it later
     // So we don't trigger a coroutine wait in a catch statement
     std::exception_ptr saved_exception;
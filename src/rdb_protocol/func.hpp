@@ -43,9 +43,14 @@ public:
     void assert_deterministic(const char *extra_msg) const;
 
     bool filter_call(env_t *env,
-                     counted_t<const datum_t> arg,
+                     const counted_t<const datum_t> &arg,
                      counted_t<func_t> default_filter_val) const;
 
+    // Replaces each of `items` with the result of calling the function on it, as
+    // `map` does.  Throws at the first error.
+    virtual void call_on_each(env_t *env,
+                              std::vector<counted_t<const datum_t> > *items) const;
+
     // These are simple, they call the vector version of call.
     counted_t<val_t> call(env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
     counted_t<val_t> call(env_t *env,
@@ -60,7 +65,7 @@ protected:
     explicit func_t(const protob_t<const Backtrace> &bt_source);
 
 private:
-    virtual bool filter_helper(env_t *env, counted_t<const datum_t> arg) const = 0;
+    virtual bool filter_helper(env_t *env, const counted_t<const datum_t> &arg) const = 0;
 
     DISABLE_COPYING(func_t);
 };
@@ -85,7 +90,11 @@ public:
 
 private:
     friend class wire_func_serialization_visitor_t;
-    bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
+    friend class batch_predicate_compiler_t;
+    friend class row_projection_visitor_t;
+    friend class join_equality_visitor_t;
+    friend class row_field_visitor_t;
+    bool filter_helper(env_t *env, const counted_t<const datum_t> &arg) const;
 
     // Only contains the parts of the scope that `body` uses.
     var_scope_t captured_scope;
@@ -112,6 +121,9 @@ public:
                           const std::vector<counted_t<const datum_t> > &args,
                           eval_flags_t eval_flags) const;
 
+    // Calls the worker process once for the whole batch, instead of once per item.
+    void call_on_each(env_t *env, std::vector<counted_t<const datum_t> > *items) const;
+
     bool is_deterministic() const;
 
     std::string print_source() const;
@@ -120,7 +132,7 @@ public:
 
 private:
     friend class wire_func_serialization_visitor_t;
-    bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
+    bool filter_helper(env_t *env, const counted_t<const datum_t> &arg) const;
 
     std::string js_source;
     uint64_t js_timeout_ms;
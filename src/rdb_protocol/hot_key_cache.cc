@@ -0,0 +1,106 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/hot_key_cache.hpp"
+
+#include "hash_region.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/datum.hpp"
+
+hot_key_cache_t::hot_key_cache_t(int64_t max_bytes, perfmon_collection_t *parent)
+    : max_bytes_(max_bytes),
+      bytes_(0),
+      invalidation_count_(0),
+      stats_collection_membership_(parent, &stats_collection_, "hot_key_cache"),
+      pm_membership_(&stats_collection_,
+                     &pm_hits_, "hits",
+                     &pm_misses_, "misses",
+                     &pm_bytes_, "bytes",
+                     &pm_keys_, "keys") { }
+
+size_t hot_key_cache_t::key_hasher_t::operator()(const store_key_t &key) const {
+    return hash_region_hasher(key.contents(), key.size());
+}
+
+bool hot_key_cache_t::lookup(const store_key_t &key,
+                             counted_t<const ql::datum_t> *value_out) {
+    assert_thread();
+    if (max_bytes_ == 0) {
+        return false;
+    }
+
+    entries_t::iterator it = entries_.find(key);
+    if (it == entries_.end()) {
+        ++pm_misses_;
+        return false;
+    }
+
+    ++pm_hits_;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+    *value_out = it->second.value;
+    return true;
+}
+
+void hot_key_cache_t::fill(const store_key_t &key,
+                           const counted_t<const ql::datum_t> &value,
+                           fill_ticket_t ticket) {
+    assert_thread();
+    if (ticket != invalidation_count_ || !value.has()) {
+        return;
+    }
+
+    // The key is stored twice, once in entries_ and once in lru_.
+    const int64_t bytes = 2 * sizeof(store_key_t) + sizeof(entry_t)
+        + estimate_rget_response_size(value);
+    if (bytes > max_bytes_) {
+        return;
+    }
+
+    entries_t::iterator existing = entries_.find(key);
+    if (existing != entries_.end()) {
+        erase(existing);
+    }
+    while (bytes_ + bytes > max_bytes_) {
+        rassert(!lru_.empty());
+        erase(entries_.find(lru_.back()));
+    }
+
+    lru_.push_front(key);
+    entry_t *entry = &entries_[key];
+    entry->value = value;
+    entry->bytes = bytes;
+    entry->lru_position = lru_.begin();
+    bytes_ += bytes;
+    pm_bytes_ += bytes;
+    ++pm_keys_;
+}
+
+void hot_key_cache_t::invalidate(const store_key_t &key) {
+    assert_thread();
+    ++invalidation_count_;
+    entries_t::iterator it = entries_.find(key);
+    if (it != entries_.end()) {
+        erase(it);
+    }
+}
+
+void hot_key_cache_t::invalidate(const std::vector<store_key_t> &keys) {
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        invalidate(*it);
+    }
+}
+
+void hot_key_cache_t::invalidate_all() {
+    assert_thread();
+    ++invalidation_count_;
+    while (!entries_.empty()) {
+        erase(entries_.begin());
+    }
+}
+
+void hot_key_cache_t::erase(entries_t::iterator it) {
+    rassert(it != entries_.end());
+    bytes_ -= it->second.bytes;
+    pm_bytes_ -= it->second.bytes;
+    --pm_keys_;
+    lru_.erase(it->second.lru_position);
+    entries_.erase(it);
+}
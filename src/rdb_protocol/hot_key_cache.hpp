@@ -0,0 +1,78 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_HOT_KEY_CACHE_HPP_
+#define RDB_PROTOCOL_HOT_KEY_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "containers/counted.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+namespace ql { class datum_t; }
+
+/* Remembers the documents of the most recently read keys of a store's primary btree,
+so that point reads of hot keys don't have to descend from the superblock (and load
+the value's blob) every time.  The memory it uses is bounded by max_bytes, with the
+least recently used keys making way for new ones; a max_bytes of zero turns it off.
+
+The cache has to agree with the btree as of the point in the store's operation
+order at which a read holds the superblock.  So every write must invalidate the
+keys it's going to modify while it holds the superblock, before it modifies
+anything.  A read that misses takes a fill_ticket_t while it holds the superblock,
+and may fill the cache with what it found only if no write has invalidated
+anything since then -- otherwise it might put back a value that a write which
+came after it has already replaced. */
+class hot_key_cache_t : public home_thread_mixin_debug_only_t {
+public:
+    typedef uint64_t fill_ticket_t;
+
+    hot_key_cache_t(int64_t max_bytes, perfmon_collection_t *parent);
+
+    bool lookup(const store_key_t &key, counted_t<const ql::datum_t> *value_out);
+
+    fill_ticket_t fill_ticket() const { return invalidation_count_; }
+    void fill(const store_key_t &key, const counted_t<const ql::datum_t> &value,
+              fill_ticket_t ticket);
+
+    void invalidate(const store_key_t &key);
+    void invalidate(const std::vector<store_key_t> &keys);
+    void invalidate_all();
+
+private:
+    struct key_hasher_t {
+        size_t operator()(const store_key_t &key) const;
+    };
+
+    struct entry_t {
+        counted_t<const ql::datum_t> value;
+        int64_t bytes;
+        // Our position in lru_.
+        std::list<store_key_t>::iterator lru_position;
+    };
+
+    typedef std::unordered_map<store_key_t, entry_t, key_hasher_t> entries_t;
+
+    void erase(entries_t::iterator it);
+
+    const int64_t max_bytes_;
+    int64_t bytes_;
+    fill_ticket_t invalidation_count_;
+
+    entries_t entries_;
+    // The keys in entries_, the most recently used first.
+    std::list<store_key_t> lru_;
+
+    perfmon_collection_t stats_collection_;
+    perfmon_membership_t stats_collection_membership_;
+    perfmon_counter_t pm_hits_, pm_misses_, pm_bytes_, pm_keys_;
+    perfmon_multi_membership_t pm_membership_;
+
+    DISABLE_COPYING(hot_key_cache_t);
+};
+
+#endif  // RDB_PROTOCOL_HOT_KEY_CACHE_HPP_
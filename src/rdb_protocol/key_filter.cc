@@ -0,0 +1,198 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/key_filter.hpp"
+
+#include <algorithm>
+
+#include "buffer_cache/alt/alt.hpp"
+#include "config/args.hpp"
+#include "hash_region.hpp"
+
+static int key_filter_bits_per_key = 0;
+
+void set_key_filter_bits_per_key(int bits_per_key) {
+    guarantee(bits_per_key >= 0);
+    key_filter_bits_per_key = bits_per_key;
+}
+
+int get_key_filter_bits_per_key() {
+    return key_filter_bits_per_key;
+}
+
+/* The bits of one filter.  A key sets `num_probes_` bits, which are picked by
+double hashing of its 64-bit hash. */
+class key_filter_t::bits_t {
+public:
+    bits_t(int64_t capacity, int bits_per_key)
+        : words_(std::max<int64_t>(1, (capacity * bits_per_key + 63) / 64), 0),
+          num_bits_(static_cast<uint64_t>(words_.size()) * 64),
+          // The number of probes that makes false positives the rarest is
+          // bits_per_key * ln(2).
+          num_probes_(std::max(1, static_cast<int>(bits_per_key * 0.693 + 0.5))),
+          capacity_(capacity),
+          num_keys_(0) { }
+
+    bool may_contain(uint64_t hash) const {
+        const uint64_t delta = (hash >> 33) | 1;
+        for (int i = 0; i < num_probes_; ++i) {
+            const uint64_t bit = hash % num_bits_;
+            if ((words_[bit / 64] & (1ULL << (bit % 64))) == 0) {
+                return false;
+            }
+            hash += delta;
+        }
+        return true;
+    }
+
+    void add(uint64_t hash) {
+        // Keys that are already there (or look like they are) don't use up any of
+        // the capacity.
+        if (may_contain(hash)) {
+            return;
+        }
+        ++num_keys_;
+        const uint64_t delta = (hash >> 33) | 1;
+        for (int i = 0; i < num_probes_; ++i) {
+            const uint64_t bit = hash % num_bits_;
+            words_[bit / 64] |= 1ULL << (bit % 64);
+            hash += delta;
+        }
+    }
+
+    bool is_overfull() const { return num_keys_ > capacity_; }
+    int64_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+private:
+    std::vector<uint64_t> words_;
+    const uint64_t num_bits_;
+    const int num_probes_;
+    const int64_t capacity_;
+    int64_t num_keys_;
+
+    DISABLE_COPYING(bits_t);
+};
+
+key_filter_t::key_filter_t(int bits_per_key, cache_t *cache,
+                           perfmon_collection_t *parent)
+    : bits_per_key_(bits_per_key),
+      cache_(cache),
+      rebuilding_(false),
+      stats_collection_membership_(parent, &stats_collection_, "key_filter"),
+      pm_membership_(&stats_collection_,
+                     &pm_negatives_, "negatives",
+                     &pm_bytes_, "bytes",
+                     &pm_rebuilds_, "rebuilds") {
+    guarantee(bits_per_key_ >= 0);
+}
+
+key_filter_t::~key_filter_t() {
+    assert_thread();
+    charge_memory(-((current_.has() ? current_->bytes() : 0)
+                    + (next_.has() ? next_->bytes() : 0)));
+}
+
+void key_filter_t::charge_memory(int64_t delta) {
+    if (delta == 0) {
+        return;
+    }
+    pm_bytes_ += delta;
+    if (cache_ != NULL) {
+        cache_->change_outside_memory(delta);
+    }
+}
+
+uint64_t key_filter_t::hash_key(const uint8_t *contents, int size) {
+    // The hash that shards the keys, with its bits mixed up some more (this is
+    // MurmurHash3's finalizer), since all the keys of a store have hashes in the
+    // store's hash range.
+    uint64_t h = hash_region_hasher(contents, size);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bool key_filter_t::may_contain(const store_key_t &key) {
+    assert_thread();
+    if (!current_.has()) {
+        return true;
+    }
+    if (current_->may_contain(hash_key(key.contents(), key.size()))) {
+        return true;
+    }
+    ++pm_negatives_;
+    return false;
+}
+
+void key_filter_t::add(const store_key_t &key) {
+    assert_thread();
+    if (!is_enabled()) {
+        return;
+    }
+    const uint64_t hash = hash_key(key.contents(), key.size());
+    if (current_.has()) {
+        current_->add(hash);
+    }
+    if (next_.has()) {
+        next_->add(hash);
+    } else if (rebuilding_) {
+        pending_.push_back(hash);
+    }
+}
+
+void key_filter_t::add(const std::vector<store_key_t> &keys) {
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        add(*it);
+    }
+}
+
+bool key_filter_t::is_overfull() const {
+    return current_.has() && current_->is_overfull();
+}
+
+void key_filter_t::start_rebuild() {
+    assert_thread();
+    guarantee(is_enabled() && !rebuilding_);
+    rebuilding_ = true;
+}
+
+void key_filter_t::size_rebuild(int64_t num_keys) {
+    assert_thread();
+    guarantee(rebuilding_ && !next_.has());
+    // With some room for the keys that are yet to come.
+    const int64_t capacity = std::max<int64_t>(
+        KEY_FILTER_MIN_KEYS, num_keys + num_keys * KEY_FILTER_HEADROOM_PERCENT / 100);
+    next_.init(new bits_t(capacity, bits_per_key_));
+    charge_memory(next_->bytes());
+    for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+        next_->add(*it);
+    }
+    pending_.clear();
+}
+
+void key_filter_t::add_rebuilt(const btree_key_t *key) {
+    rassert(next_.has());
+    next_->add(hash_key(key->contents, key->size));
+}
+
+void key_filter_t::finish_rebuild() {
+    assert_thread();
+    guarantee(rebuilding_ && next_.has());
+    if (current_.has()) {
+        charge_memory(-current_->bytes());
+    }
+    ++pm_rebuilds_;
+    current_ = std::move(next_);
+    rebuilding_ = false;
+}
+
+void key_filter_t::abandon_rebuild() {
+    assert_thread();
+    if (next_.has()) {
+        charge_memory(-next_->bytes());
+        next_.reset();
+    }
+    pending_.clear();
+    rebuilding_ = false;
+}
@@ -0,0 +1,103 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_KEY_FILTER_HPP_
+#define RDB_PROTOCOL_KEY_FILTER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+class cache_t;
+
+/* A Bloom filter of the keys in a store's primary btree, so that point reads of keys
+that aren't there can answer without descending the btree.  It may say that a key
+might be there when it isn't, but never that a key isn't there when it is.  It has
+`bits_per_key` bits for each key it's sized for; zero turns it off.  Its bits are
+counted against the memory limit of `cache`, the store's cache, so that a store's
+filter and pages together stay within the store's share of the cache memory.
+
+Only the primary btree has a filter.  A filter of each secondary index's values,
+for get_all() of values that aren't there, would have to be kept up to date by
+every one of the secondary index write paths and rebuilt whenever an index is
+created, and is left for a separate change.
+
+Like the hot key cache, the filter has to agree with the btree as of the point in
+the store's operation order at which a read holds the superblock.  So every write
+must add the keys it might insert while it holds the superblock, before it
+inserts anything.  Deleted keys stay in the filter until it's rebuilt from the
+btree, which the store does after compactions and when more new keys have been
+added than the filter was sized for.  The first filter is built after the first
+point read, so that stores that aren't read don't scan their btrees.
+
+A rebuild goes like this: `start_rebuild()` before the rebuild's read takes the
+superblock, so that the writes after it in the operation order go to the new
+filter; `size_rebuild()` with the number of keys in the btree once the read has
+the superblock; `add_rebuilt()` for every key the read finds; and then
+`finish_rebuild()`.  Until then the point reads keep using the old filter, which
+writes keep adding to as well. */
+class key_filter_t : public home_thread_mixin_debug_only_t {
+public:
+    // `cache` may be NULL, in which case nobody's memory limit is charged.
+    key_filter_t(int bits_per_key, cache_t *cache, perfmon_collection_t *parent);
+    ~key_filter_t();
+
+    // False if `key` is certainly not in the btree.  True while no filter has
+    // been built yet.
+    bool may_contain(const store_key_t &key);
+
+    void add(const store_key_t &key);
+    void add(const std::vector<store_key_t> &keys);
+
+    bool is_enabled() const { return bits_per_key_ != 0; }
+    // False until the first rebuild finishes.
+    bool is_built() const { return current_.has(); }
+    // True once more new keys have been added than the filter was sized for, so
+    // that it says "maybe" more often than it should.
+    bool is_overfull() const;
+
+    void start_rebuild();
+    void size_rebuild(int64_t num_keys);
+    void add_rebuilt(const btree_key_t *key);
+    void finish_rebuild();
+    // If the rebuild is interrupted.
+    void abandon_rebuild();
+
+private:
+    class bits_t;
+
+    static uint64_t hash_key(const uint8_t *contents, int size);
+
+    // Adds `delta` bytes to what the filter takes from the cache's memory.
+    void charge_memory(int64_t delta);
+
+    const int bits_per_key_;
+    cache_t *const cache_;
+
+    // The filter that reads use, or empty before the first rebuild.
+    scoped_ptr_t<bits_t> current_;
+    // The filter that a rebuild is filling, once it's sized.
+    scoped_ptr_t<bits_t> next_;
+    bool rebuilding_;
+    // The hashes of the keys added after start_rebuild() but before size_rebuild().
+    std::vector<uint64_t> pending_;
+
+    perfmon_collection_t stats_collection_;
+    perfmon_membership_t stats_collection_membership_;
+    perfmon_counter_t pm_negatives_, pm_bytes_, pm_rebuilds_;
+    perfmon_multi_membership_t pm_membership_;
+
+    DISABLE_COPYING(key_filter_t);
+};
+
+/* How many bits per key the stores created from now on give their key filters.
+It's zero, which means the stores have no filters, until this is set.  Like the
+background latency target, it's shared by all threads and should be set before
+any stores are created. */
+void set_key_filter_bits_per_key(int bits_per_key);
+int get_key_filter_bits_per_key();
+
+#endif  // RDB_PROTOCOL_KEY_FILTER_HPP_
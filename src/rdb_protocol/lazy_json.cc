@@ -1,20 +1,16 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/lazy_json.hpp"
 
-#include "containers/archive/buffer_group_stream.hpp"
-#include "rdb_protocol/blob_wrapper.hpp"
+#include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
 
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value, buf_parent_t parent) {
-    rdb_blob_wrapper_t blob(parent.cache()->get_block_size(),
-                            const_cast<rdb_value_t *>(value)->value_ref(),
-                            blob::btree_maxreflen);
-
     counted_t<const ql::datum_t> data;
 
-    blob_acq_t acq_group;
-    buffer_group_t buffer_group;
-    blob.expose_all(parent, access_t::read, &buffer_group, &acq_group);
-    buffer_group_read_stream_t read_stream(const_view(&buffer_group));
+    // We stream the value off the blob, so that large documents don't have all of
+    // their blocks acquired at once.  (The stream only reads.)
+    blob_read_stream_t read_stream(parent,
+                                   const_cast<rdb_value_t *>(value)->value_ref(),
+                                   blob::btree_maxreflen);
     archive_result_t res = deserialize(&read_stream, &data);
     guarantee_deserialization(res, "rdb value");
 
@@ -31,6 +27,51 @@ const counted_t<const ql::datum_t> &lazy_json_t::get() const {
     return pointee->ptr;
 }
 
+counted_t<const ql::datum_t> lazy_json_t::get_field(const std::string &key) const {
+    guarantee(pointee.has());
+    if (pointee->ptr.has()) {
+        return pointee->ptr->get(key, ql::NOTHROW);
+    }
+
+    char *ref = const_cast<rdb_value_t *>(pointee->rdb_value)->value_ref();
+    bool indexed;
+    std::vector<uint32_t> offsets;
+    int64_t fields_start;
+    {
+        blob_read_stream_t header_stream(pointee->parent, ref, blob::btree_maxreflen);
+        archive_result_t res = ql::deserialize_row_offsets(&header_stream, &indexed,
+                                                           &offsets, &fields_start);
+        guarantee_deserialization(res, "rdb value header");
+    }
+    if (!indexed) {
+        return get()->get(key, ql::NOTHROW);
+    }
+
+    // The fields are sorted by key, so we binary search for the one we want,
+    // reading one key per step.
+    size_t lo = 0, hi = offsets.size();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        blob_read_stream_t field_stream(pointee->parent, ref, blob::btree_maxreflen,
+                                        fields_start + offsets[mid]);
+        std::string field_key;
+        archive_result_t res = deserialize(&field_stream, &field_key);
+        guarantee_deserialization(res, "rdb value field key");
+        const int cmp = field_key.compare(key);
+        if (cmp == 0) {
+            counted_t<const ql::datum_t> value;
+            res = deserialize(&field_stream, &value);
+            guarantee_deserialization(res, "rdb value field");
+            return value;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return counted_t<const ql::datum_t>();
+}
+
 bool lazy_json_t::references_parent() const {
     return pointee.has() && !pointee->parent.empty();
 }
@@ -63,6 +63,11 @@ public:
         : pointee(new lazy_json_pointee_t(rdb_value, parent)) { }
 
     const counted_t<const ql::datum_t> &get() const;
+    // Returns the field `key` of the row, or an empty pointer if there is no such
+    // field.  If the row hasn't been loaded and was stored with an offset table
+    // (see `ql::serialize_row`), only that field is read, and the row stays
+    // unloaded.
+    counted_t<const ql::datum_t> get_field(const std::string &key) const;
     bool references_parent() const;
     void reset();
 
@@ -1,14 +1,25 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/pb_server.hpp"
 
+#include "concurrency/background_governor.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/wait_any.hpp"
 #include "concurrency/watchable.hpp"
+#include "containers/map_sentries.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/query_capture.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 #include "rpc/semilattice/view/field.hpp"
 
+// How long the queries (and the continuations of their streams) took to run.
+static perfmon_latency_histogram_t pm_query_latency(secs_to_ticks(1));
+static perfmon_membership_t pm_query_latency_membership(&get_global_perfmon_collection(),
+                                                        &pm_query_latency, "query_latency");
+
 Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
     Response res;
     res.set_token((q.has() && q->has_token()) ? q->token() : -1);
@@ -18,13 +29,17 @@ Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
 
 query2_server_t::query2_server_t(const std::set<ip_address_t> &local_addresses,
                                  int port,
-                                 rdb_protocol_t::context_t *_ctx) :
+                                 rdb_protocol_t::context_t *_ctx,
+                                 bool accept_on_all_threads,
+                                 tls_ctx_t *tls_ctx) :
     server(local_addresses,
            port,
            boost::bind(&query2_server_t::handle, this, _1, _2, _3),
            &on_unparsable_query2,
            _ctx->auth_metadata,
-           INLINE),
+           CORO_UNORDERED,
+           accept_on_all_threads,
+           tls_ctx),
     ctx(_ctx), parser_id(generate_uuid()), thread_counters(0)
 { }
 
@@ -42,7 +57,8 @@ namespace ql {
              rdb_protocol_t::context_t *ctx,
              signal_t *interruptor,
              Response *res,
-             stream_cache2_t *stream_cache2);
+             stream_cache2_t *stream_cache2,
+             term_cache_t *term_cache);
 }
 
 class scoped_ops_running_stat_t {
@@ -59,35 +75,121 @@ private:
     DISABLE_COPYING(scoped_ops_running_stat_t);
 };
 
+// Turns on profiling for `q`, unless the client already asked for it.  Returns
+// true if it did.
+static bool force_profile(ql::protob_t<Query> q) {
+    counted_t<const ql::datum_t> profile = static_optarg("profile", q);
+    if (profile.has() && profile->get_type() == ql::datum_t::R_BOOL
+        && profile->as_bool()) {
+        return false;
+    }
+    for (int i = 0; i < q->global_optargs_size(); ++i) {
+        if (q->global_optargs(i).key() == "profile") {
+            // Something the client evaluates, leave it be.
+            return false;
+        }
+    }
+    Query::AssocPair *ap = q->add_global_optargs();
+    ap->set_key("profile");
+    Term *val = ap->mutable_val();
+    val->set_type(Term::DATUM);
+    val->mutable_datum()->set_type(Datum::R_BOOL);
+    val->mutable_datum()->set_r_bool(true);
+    return true;
+}
+
 bool query2_server_t::handle(ql::protob_t<Query> q,
                              Response *response_out,
                              context_t *query2_context) {
     ql::stream_cache2_t *stream_cache2 = &query2_context->stream_cache2;
     signal_t *interruptor = query2_context->interruptor;
     guarantee(interruptor);
-    response_out->set_token(q->token());
+    int64_t token = q->token();
+    response_out->set_token(token);
+
+    // Before anything is added to the query, so it's captured as the client sent it.
+    query_capture_t::get_global_capture().on_query(*q, &query2_context->capture_connection);
 
     counted_t<const ql::datum_t> noreply = static_optarg("noreply", q);
     bool response_needed = !(noreply.has() &&
          noreply->get_type() == ql::datum_t::type_t::R_BOOL &&
          noreply->as_bool());
+
+    // Queries on a connection run concurrently, but not two with the same token.
+    auto running = query2_context->running_queries.find(token);
+    if (running != query2_context->running_queries.end()) {
+        if (q->type() == Query::STOP) {
+            // The stopped query answers for the token.
+            running->second->pulse_if_not_already_pulsed();
+            return false;
+        }
+        ql::fill_error(response_out, Response::CLIENT_ERROR,
+                       strprintf("ERROR: duplicate token %" PRIi64, token));
+        return response_needed;
+    }
+    cond_t stopped;
+    map_insertion_sentry_t<int64_t, cond_t *> running_sentry(
+        &query2_context->running_queries, token, &stopped);
+    wait_any_t query_interruptor(interruptor, &stopped);
+
+    slow_query_log_t *slow_query_log = &slow_query_log_t::get_global_log();
+    const bool is_start = q->type() == Query::START;
+    bool sampled = false;
+    bool profile_forced = false;
+    if (is_start && slow_query_log->should_sample()) {
+        sampled = true;
+        profile_forced = force_profile(q);
+    }
+    const ticks_t start_time = get_ticks();
+
     try {
         scoped_ops_running_stat_t stat(&ctx->ql_ops_running);
         guarantee(ctx->directory_read_manager);
         // `ql::run` will set the status code
-        ql::run(q, ctx, interruptor, response_out, stream_cache2);
+        ql::run(q, ctx, &query_interruptor, response_out, stream_cache2,
+                &query2_context->term_cache);
     } catch (const ql::exc_t &e) {
         fill_error(response_out, Response::COMPILE_ERROR, e.what(), e.backtrace());
     } catch (const ql::datum_exc_t &e) {
         fill_error(response_out, Response::COMPILE_ERROR, e.what(), ql::backtrace_t());
     } catch (const interrupted_exc_t &e) {
-        ql::fill_error(response_out, Response::RUNTIME_ERROR,
-                       "Query interrupted.  Did you shut down the server?");
+        if (stopped.is_pulsed()) {
+            response_out->Clear();
+            response_out->set_token(token);
+            response_out->set_type(Response::SUCCESS_SEQUENCE);
+        } else {
+            ql::fill_error(response_out, Response::RUNTIME_ERROR,
+                           "Query interrupted.  Did you shut down the server?");
+        }
     } catch (const std::exception &e) {
         ql::fill_error(response_out, Response::RUNTIME_ERROR,
                        strprintf("Unexpected exception: %s\n", e.what()));
     }
 
+    pm_query_latency.record(get_ticks() - start_time);
+    record_foreground_latency(get_ticks() - start_time);
+
+    if (is_start) {
+        if (!sampled) {
+            counted_t<const ql::datum_t> profile = static_optarg("profile", q);
+            sampled = profile.has() && profile->get_type() == ql::datum_t::R_BOOL
+                && profile->as_bool();
+        }
+        slow_query_log->on_query_done(*q, *response_out, get_ticks() - start_time,
+                                      sampled);
+        if (profile_forced && response_out->type() == Response::SUCCESS_PARTIAL) {
+            query2_context->sampled_streams.insert(token);
+        }
+    } else if (query2_context->sampled_streams.count(token) != 0) {
+        profile_forced = true;
+        if (response_out->type() != Response::SUCCESS_PARTIAL) {
+            query2_context->sampled_streams.erase(token);
+        }
+    }
+    if (profile_forced) {
+        response_out->clear_profile();
+    }
+
     return response_needed;
 }
 
@@ -98,3 +200,8 @@ void make_empty_protob_bearer(ql::protob_t<Query> *request) {
 Query *underlying_protob_value(ql::protob_t<Query> *request) {
     return request->get();
 }
+
+bool waits_for_earlier_requests(ql::protob_t<Query> *request) {
+    // NOREPLY_WAIT promises that the queries sent before it are done.
+    return (*request)->type() == Query::NOREPLY_WAIT;
+}
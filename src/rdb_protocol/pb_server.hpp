@@ -9,18 +9,24 @@
 #include "protob/protob.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_capture.hpp"
 #include "rdb_protocol/stream_cache.hpp"
+#include "rdb_protocol/term_cache.hpp"
 
 namespace ql { template <class> class protob_t; }
 
 // Overloads used by protob_server_t.
 void make_empty_protob_bearer(ql::protob_t<Query> *request);
 Query *underlying_protob_value(ql::protob_t<Query> *request);
+bool waits_for_earlier_requests(ql::protob_t<Query> *request);
 
 class query2_server_t {
 public:
+    // See protob_server_t for `accept_on_all_threads` and `tls_ctx`.
     query2_server_t(const std::set<ip_address_t> &local_addresses, int port,
-                    rdb_protocol_t::context_t *_ctx);
+                    rdb_protocol_t::context_t *_ctx,
+                    bool accept_on_all_threads = false,
+                    tls_ctx_t *tls_ctx = NULL);
 
     http_app_t *get_http_app();
 
@@ -31,7 +37,16 @@ public:
         static const int32_t no_auth_magic_number = VersionDummy::V0_1;
         static const int32_t auth_magic_number = VersionDummy::V0_2;
         ql::stream_cache2_t stream_cache2;
+        ql::term_cache_t term_cache;
         signal_t *interruptor;
+        // The queries running on the connection by token, and the conds that stop
+        // them.
+        std::map<int64_t, cond_t *> running_queries;
+        // The streams that the slow query log profiles without the client
+        // having asked for it, so their profiles are left out of the responses.
+        std::set<int64_t> sampled_streams;
+        // Whether the connection's queries are being captured.
+        query_capture_t::connection_t capture_connection;
     };
 private:
     MUST_USE bool handle(ql::protob_t<Query> q,
@@ -9,6 +9,28 @@
 
 namespace profile {
 
+counters_t::counters_t()
+    : rows_read_(0), rows_returned_(0), shard_round_trips_(0), blocks_read_(0),
+      wait_time_(0), memory_charged_(0) { }
+
+void counters_t::add(const counters_t &other) {
+    rows_read_ += other.rows_read_;
+    rows_returned_ += other.rows_returned_;
+    shard_round_trips_ += other.shard_round_trips_;
+    blocks_read_ += other.blocks_read_;
+    wait_time_ += other.wait_time_;
+    memory_charged_ += other.memory_charged_;
+}
+
+bool counters_t::is_zero() const {
+    return rows_read_ == 0 && rows_returned_ == 0 && shard_round_trips_ == 0
+        && blocks_read_ == 0 && wait_time_ == 0 && memory_charged_ == 0;
+}
+
+RDB_IMPL_ME_SERIALIZABLE_6(counters_t, rows_read_, rows_returned_,
+                           shard_round_trips_, blocks_read_, wait_time_,
+                           memory_charged_);
+
 start_t::start_t() { }
 
 start_t::start_t(const std::string &description)
@@ -36,15 +58,44 @@ RDB_IMPL_ME_SERIALIZABLE_3(sample_t, description_, mean_duration_, n_samples_);
 stop_t::stop_t()
     : when_(get_ticks()) { }
 
-RDB_IMPL_ME_SERIALIZABLE_1(stop_t, when_);
+stop_t::stop_t(const counters_t &counters)
+    : when_(get_ticks()), counters_(counters) { }
+
+RDB_IMPL_ME_SERIALIZABLE_2(stop_t, when_, counters_);
 
 counted_t<const ql::datum_t> construct_start(
         ticks_t duration, std::string &&description,
+        const counters_t &counters,
         counted_t<const ql::datum_t> sub_tasks) {
     std::map<std::string, counted_t<const ql::datum_t> > res;
     res["duration(ms)"] = make_counted<const ql::datum_t>(safe_to_double(duration) / MILLION);
     res["description"] = make_counted<const ql::datum_t>(std::move(description));
     res["sub_tasks"] = sub_tasks;
+    // Most tasks count nothing, so only the counters that did are shown.
+    if (counters.rows_read_ != 0) {
+        res["rows_read"] = make_counted<const ql::datum_t>(
+            safe_to_double(counters.rows_read_));
+    }
+    if (counters.rows_returned_ != 0) {
+        res["rows_returned"] = make_counted<const ql::datum_t>(
+            safe_to_double(counters.rows_returned_));
+    }
+    if (counters.shard_round_trips_ != 0) {
+        res["shard_round_trips"] = make_counted<const ql::datum_t>(
+            safe_to_double(counters.shard_round_trips_));
+    }
+    if (counters.blocks_read_ != 0) {
+        res["blocks_read"] = make_counted<const ql::datum_t>(
+            safe_to_double(counters.blocks_read_));
+    }
+    if (counters.wait_time_ != 0) {
+        res["wait_time(ms)"] = make_counted<const ql::datum_t>(
+            safe_to_double(counters.wait_time_) / MILLION);
+    }
+    if (counters.memory_charged_ != 0) {
+        res["memory_charged"] = make_counted<const ql::datum_t>(
+            safe_to_double(counters.memory_charged_));
+    }
     return make_counted<const ql::datum_t>(std::move(res));
 }
 
@@ -83,7 +134,8 @@ public:
         auto stop = boost::get<stop_t>(&**begin_);
         guarantee(stop);
         res_->push_back(construct_start(
-            stop->when_ - start.when_, std::move(start.description_), sub_tasks));
+            stop->when_ - start.when_, std::move(start.description_),
+            stop->counters_, sub_tasks));
         (*begin_)++;
     }
     void operator()(const split_t &split) const {
@@ -124,6 +176,31 @@ counted_t<const ql::datum_t> construct_datum(
     return make_counted<const ql::datum_t>(std::move(res));
 }
 
+// Moves `*it` past the stop_t that ends the current task or parallel job, adding
+// the counters of the tasks directly within it to `counters`, and returns that
+// stop_t.  (Each task's stop_t already includes the tasks within that task.)
+const stop_t *skip_to_stop(event_log_t::const_iterator *it,
+                           event_log_t::const_iterator end,
+                           counters_t *counters) {
+    while (*it != end) {
+        const event_t &event = **it;
+        ++*it;
+        if (auto stop = boost::get<stop_t>(&event)) {
+            return stop;
+        } else if (boost::get<start_t>(&event)) {
+            counters_t ignored;
+            const stop_t *task_stop = skip_to_stop(it, end, &ignored);
+            guarantee(task_stop);
+            counters->add(task_stop->counters_);
+        } else if (auto split = boost::get<split_t>(&event)) {
+            for (size_t i = 0; i < split->n_parallel_jobs_; ++i) {
+                guarantee(skip_to_stop(it, end, counters));
+            }
+        }
+    }
+    return NULL;
+}
+
 class print_event_log_visitor_t : public boost::static_visitor<> {
 public:
     void operator()(const start_t &start) const {
@@ -269,8 +346,44 @@ void disabler_t::init(trace_t *parent) {
     }
 }
 
+void count_rows_read(trace_t *parent, uint64_t n) {
+    if (parent) {
+        parent->counters_target()->rows_read_ += n;
+    }
+}
+
+void count_rows_returned(trace_t *parent, uint64_t n) {
+    if (parent) {
+        parent->counters_target()->rows_returned_ += n;
+    }
+}
+
+void count_shard_round_trips(trace_t *parent, uint64_t n) {
+    if (parent) {
+        parent->counters_target()->shard_round_trips_ += n;
+    }
+}
+
+void count_blocks_read(trace_t *parent, uint64_t n) {
+    if (parent) {
+        parent->counters_target()->blocks_read_ += n;
+    }
+}
+
+void count_wait_time(trace_t *parent, ticks_t duration) {
+    if (parent) {
+        parent->counters_target()->wait_time_ += duration;
+    }
+}
+
+void count_memory(trace_t *parent, uint64_t bytes) {
+    if (parent) {
+        parent->counters_target()->memory_charged_ += bytes;
+    }
+}
+
 trace_t::trace_t()
-    : redirected_event_log_(NULL), disabled_ref_count(0) { }
+    : redirected_event_log_(NULL), disabled_ref_count(0), running_counters_(1) { }
 
 counted_t<const ql::datum_t> trace_t::as_datum() {
     guarantee(!redirected_event_log_);
@@ -283,6 +396,8 @@ event_log_t trace_t::extract_event_log() RVALUE_THIS {
     // state (which is valid, thereby acceptable for an RVALUE_THIS function).
     guarantee(redirected_event_log_ == NULL);
     guarantee(disabled_ref_count == 0);
+    guarantee(running_counters_.size() == 1);
+    running_counters_[0] = counters_t();
     return std::move(event_log_);
 }
 
@@ -290,12 +405,17 @@ void trace_t::start(const std::string &description) {
     if (disabled()) { return; }
     //debugf("Start %s %p.\n", description.c_str(), this);
     event_log_target()->push_back(start_t(description));
+    running_counters_.push_back(counters_t());
 }
 
 void trace_t::stop() {
     if (disabled()) { return; }
     //debugf("Stop %p.\n", this);
-    event_log_target()->push_back(stop_t());
+    guarantee(running_counters_.size() > 1);
+    counters_t counters = running_counters_.back();
+    running_counters_.pop_back();
+    running_counters_.back().add(counters);
+    event_log_target()->push_back(stop_t(counters));
 }
 
 void trace_t::start_split() {
@@ -311,6 +431,11 @@ void trace_t::stop_split(size_t n_parallel_jobs_, const event_log_t &par_event_l
     guarantee(split);
     split->n_parallel_jobs_ = n_parallel_jobs_;
     event_log_target()->insert(event_log_target()->end(), par_event_log.begin(), par_event_log.end());
+    /* The parallel jobs count towards the task that split. */
+    event_log_t::const_iterator it = par_event_log.begin();
+    for (size_t i = 0; i < n_parallel_jobs_; ++i) {
+        guarantee(skip_to_stop(&it, par_event_log.end(), counters_target()));
+    }
 }
 
 void trace_t::start_sample(event_log_t *event_log) {
@@ -360,6 +485,10 @@ bool trace_t::disabled() {
     return disabled_ref_count > 0;
 }
 
+counters_t *trace_t::counters_target() {
+    return &running_counters_.back();
+}
+
 event_log_t *trace_t::event_log_target() {
     if (redirected_event_log_) {
         return redirected_event_log_;
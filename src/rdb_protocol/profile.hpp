@@ -21,6 +21,29 @@ class datum_t;
 
 namespace profile {
 
+/* The counters of a task.  They include the counters of the tasks within it, the
+ * same way its duration does. */
+struct counters_t {
+    counters_t();
+    void add(const counters_t &other);
+    bool is_zero() const;
+
+    // Rows the shards read from their btrees.
+    uint64_t rows_read_;
+    // Rows that reads of a table gave to the query.
+    uint64_t rows_returned_;
+    // Reads and writes on a shard.
+    uint64_t shard_round_trips_;
+    // btree blocks acquired for reading.
+    uint64_t blocks_read_;
+    // Time spent waiting for the shards.
+    ticks_t wait_time_;
+    // Bytes charged to the query's memory limit (see `memory_charge_t`).
+    uint64_t memory_charged_;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
 struct start_t {
     start_t();
     explicit start_t(const std::string &description);
@@ -52,7 +75,9 @@ struct sample_t {
 
 struct stop_t {
     stop_t();
+    explicit stop_t(const counters_t &counters);
     ticks_t when_;
+    counters_t counters_;
 
     RDB_DECLARE_ME_SERIALIZABLE;
 };
@@ -73,6 +98,12 @@ private:
     friend class splitter_t;
     friend class sampler_t;
     friend class disabler_t;
+    friend void count_rows_read(trace_t *parent, uint64_t n);
+    friend void count_rows_returned(trace_t *parent, uint64_t n);
+    friend void count_shard_round_trips(trace_t *parent, uint64_t n);
+    friend void count_blocks_read(trace_t *parent, uint64_t n);
+    friend void count_wait_time(trace_t *parent, ticks_t duration);
+    friend void count_memory(trace_t *parent, uint64_t bytes);
     void start(const std::string &description);
     void stop();
     void start_split();
@@ -83,6 +114,8 @@ private:
     void stop_sample(event_log_t *sample_event_log);
     void disable();
     void enable();
+    /* returns the counters of the innermost task that's running */
+    counters_t *counters_target();
 
     /* returns the event_log_t that we should put events in */
     event_log_t *event_log_target();
@@ -92,6 +125,9 @@ private:
     event_log_t *redirected_event_log_;
     size_t disabled_ref_count;
     bool disabled();
+    /* The counters of the tasks that are running, innermost last.  The first
+     * element holds the counters of everything outside of a task. */
+    std::vector<counters_t> running_counters_;
 };
 
 /* These are the instruments for adding profiling to code. You construct this
@@ -197,6 +233,23 @@ private:
     trace_t *parent_;
 };
 
+/* These add to the counters of the innermost task that's running.  Unlike the
+ * instruments above they still count while profiling is disabled, since counters
+ * don't depend on the order in which reentrant code runs.  Example:
+ *
+ *  {
+ *      starter_t starter("Acquire block for read.", trace);
+ *      count_blocks_read(trace, 1);
+ *      Acquire the block in here
+ *  }
+ */
+void count_rows_read(trace_t *parent, uint64_t n);
+void count_rows_returned(trace_t *parent, uint64_t n);
+void count_shard_round_trips(trace_t *parent, uint64_t n);
+void count_blocks_read(trace_t *parent, uint64_t n);
+void count_wait_time(trace_t *parent, ticks_t duration);
+void count_memory(trace_t *parent, uint64_t bytes);
+
 void print_event_log(const event_log_t &event_log);
 
 }  // namespace profile
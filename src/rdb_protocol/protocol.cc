@@ -2,28 +2,37 @@
 #include "rdb_protocol/protocol.hpp"
 
 #include <algorithm>
+#include <functional>
+#include <limits>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
 #include "arch/io/disk.hpp"
+#include "arch/timing.hpp"
+#include "btree/depth_first_traversal.hpp"
 #include "btree/erase_range.hpp"
+#include "btree/node.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
 #include "btree/superblock.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/reactor/reactor.hpp"
+#include "concurrency/background_governor.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/archive/archive.hpp"
-#include "containers/archive/vector_stream.hpp"
 #include "protob/protob.hpp"
+#include "rdb_protocol/batch_predicate.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/hot_key_cache.hpp"
+#include "rdb_protocol/key_filter.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 #include "rdb_protocol/term_walker.hpp"
 #include "rpc/semilattice/view/field.hpp"
 #include "rpc/semilattice/watchable.hpp"
@@ -42,6 +51,8 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::batched_point_read_t batched_point_read_t;
+typedef rdb_protocol_t::batched_point_read_response_t batched_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
@@ -55,6 +66,9 @@ typedef rdb_protocol_t::sindex_list_response_t sindex_list_response_t;
 typedef rdb_protocol_t::sindex_status_t sindex_status_t;
 typedef rdb_protocol_t::sindex_status_response_t sindex_status_response_t;
 
+typedef rdb_protocol_t::changefeed_subscribe_t changefeed_subscribe_t;
+typedef rdb_protocol_t::changefeed_subscribe_response_t changefeed_subscribe_response_t;
+
 typedef rdb_protocol_t::write_t write_t;
 typedef rdb_protocol_t::write_response_t write_response_t;
 
@@ -372,12 +386,17 @@ void add_status(const single_sindex_status_t &new_status,
     status_out->blocks_processed += new_status.blocks_processed;
     status_out->blocks_total += new_status.blocks_total;
     status_out->ready &= new_status.ready;
+    // Every shard has the same index function.
+    if (status_out->row_field.empty()) {
+        status_out->row_field = new_status.row_field;
+    }
 }
 
 }  // namespace rdb_protocol_details
 
 rdb_protocol_t::context_t::context_t()
-    : extproc_pool(NULL), ns_repo(NULL),
+    : extproc_pool(NULL), ns_repo(NULL), spill_storage(NULL),
+    manager(NULL), changefeed_client(NULL),
     cross_thread_namespace_watchables(get_num_threads()),
     cross_thread_database_watchables(get_num_threads()),
     directory_read_manager(NULL),
@@ -397,7 +416,8 @@ rdb_protocol_t::context_t::context_t(
         *_directory_read_manager,
     machine_id_t _machine_id,
     perfmon_collection_t *global_stats)
-    : extproc_pool(_extproc_pool), ns_repo(_ns_repo),
+    : extproc_pool(_extproc_pool), ns_repo(_ns_repo), spill_storage(NULL),
+      manager(NULL), changefeed_client(NULL),
       cross_thread_namespace_watchables(get_num_threads()),
       cross_thread_database_watchables(get_num_threads()),
       cluster_metadata(_cluster_metadata),
@@ -412,12 +432,14 @@ rdb_protocol_t::context_t::context_t(
         cross_thread_namespace_watchables[thread].init(new cross_thread_watchable_variable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
                                                     clone_ptr_t<semilattice_watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > >
                                                         (new semilattice_watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
-                                                            metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _cluster_metadata))), threadnum_t(thread)));
+                                                            metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _cluster_metadata))), threadnum_t(thread),
+                                                    CROSS_THREAD_METADATA_MAX_STALENESS_MS));
 
         cross_thread_database_watchables[thread].init(new cross_thread_watchable_variable_t<databases_semilattice_metadata_t>(
                                                     clone_ptr_t<semilattice_watchable_t<databases_semilattice_metadata_t> >
                                                         (new semilattice_watchable_t<databases_semilattice_metadata_t>(
-                                                            metadata_field(&cluster_semilattice_metadata_t::databases, _cluster_metadata))), threadnum_t(thread)));
+                                                            metadata_field(&cluster_semilattice_metadata_t::databases, _cluster_metadata))), threadnum_t(thread),
+                                                    CROSS_THREAD_METADATA_MAX_STALENESS_MS));
 
         signals[thread].init(new cross_thread_signal_t(&interruptor, threadnum_t(thread)));
     }
@@ -463,6 +485,25 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
         return rdb_protocol_t::monokey_region(pr.key);
     }
 
+    // The smallest region containing every key's monokey region, so that a read
+    // sharded for one CPU shard stays within that shard's hash range.
+    region_t operator()(const batched_point_read_t &bpr) const {
+        guarantee(!bpr.keys.empty());
+        region_t region = rdb_protocol_t::monokey_region(bpr.keys[0]);
+        for (auto it = bpr.keys.begin() + 1; it != bpr.keys.end(); ++it) {
+            region_t key_region = rdb_protocol_t::monokey_region(*it);
+            region.beg = std::min(region.beg, key_region.beg);
+            region.end = std::max(region.end, key_region.end);
+            if (*it < region.inner.left) {
+                region.inner.left = *it;
+            }
+            if (region.inner.right < key_region.inner.right) {
+                region.inner.right = key_region.inner.right;
+            }
+        }
+        return region;
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -478,6 +519,10 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const sindex_status_t &ss) const {
         return ss.region;
     }
+
+    region_t operator()(const changefeed_subscribe_t &s) const {
+        return s.region;
+    }
 };
 
 region_t read_t::get_region() const THROWS_NOTHING {
@@ -504,6 +549,20 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const batched_point_read_t &bpr) const {
+        batched_point_read_t tmp;
+        for (auto it = bpr.keys.begin(); it != bpr.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                tmp.keys.push_back(*it);
+            }
+        }
+        if (tmp.keys.empty()) {
+            return false;
+        }
+        *read_out = read_t(tmp, profile);
+        return true;
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -522,7 +581,12 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         bool do_read = rangey_read(rg);
         if (do_read) {
             auto rg_out = boost::get<rget_read_t>(&read_out->read);
-            rg_out->batchspec = rg_out->batchspec.scale_down(CPU_SHARDING_FACTOR);
+            // The region is one of the table's CPU shards, so its share of the
+            // hash space tells how many of them the batch gets split between.
+            const uint64_t hash_width = std::max<uint64_t>(region->end - region->beg, 1);
+            const uint64_t cpu_shards = (HASH_REGION_HASH_SIZE + hash_width / 2) / hash_width;
+            rg_out->batchspec = rg_out->batchspec.scale_down(
+                std::max<uint64_t>(cpu_shards, 1));
         }
         return do_read;
     }
@@ -539,6 +603,10 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_read(ss);
     }
 
+    bool operator()(const changefeed_subscribe_t &s) const {
+        return rangey_read(s);
+    }
+
     const hash_region_t<key_range_t> *region;
     profile_bool_t profile;
     read_t *read_out;
@@ -564,7 +632,10 @@ public:
 
 // Scale the distribution down by combining ranges to fit it within the limit of
 // the query
-void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t> *key_counts) {
+// byte_counts is either empty or has the same keys as key_counts, and gets its
+// ranges combined the same way.
+void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t> *key_counts,
+                             std::map<store_key_t, int64_t> *byte_counts) {
     guarantee(result_limit > 0);
     const size_t combine = (key_counts->size() / result_limit); // Combine this many other ranges into the previous range
     for (std::map<store_key_t, int64_t>::iterator it = key_counts->begin(); it != key_counts->end(); ) {
@@ -572,6 +643,13 @@ void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t>
         ++next;
         for (size_t i = 0; i < combine && next != key_counts->end(); ++i) {
             it->second += next->second;
+            if (!byte_counts->empty()) {
+                std::map<store_key_t, int64_t>::iterator next_bytes
+                    = byte_counts->find(next->first);
+                guarantee(next_bytes != byte_counts->end());
+                (*byte_counts)[it->first] += next_bytes->second;
+                byte_counts->erase(next_bytes);
+            }
             std::map<store_key_t, int64_t>::iterator tmp = next;
             ++next;
             key_counts->erase(tmp);
@@ -591,11 +669,13 @@ public:
           env(ctx, interruptor) { }
 
     void operator()(const point_read_t &);
+    void operator()(const batched_point_read_t &);
 
     void operator()(const rget_read_t &rg);
     void operator()(const distribution_read_t &rg);
     void operator()(const sindex_list_t &rg);
     void operator()(const sindex_status_t &rg);
+    void operator()(const changefeed_subscribe_t &s);
 
 private:
     read_response_t *responses; // Cannibalized for efficiency.
@@ -610,6 +690,16 @@ void rdb_r_unshard_visitor_t::operator()(const point_read_t &) {
     *response_out = responses[0];
 }
 
+void rdb_r_unshard_visitor_t::operator()(const batched_point_read_t &) {
+    response_out->response = batched_point_read_response_t();
+    auto out = boost::get<batched_point_read_response_t>(&response_out->response);
+    for (size_t i = 0; i < count; ++i) {
+        auto resp = boost::get<batched_point_read_response_t>(&responses[i].response);
+        guarantee(resp != NULL);
+        out->rows.insert(resp->rows.begin(), resp->rows.end());
+    }
+}
+
 void rdb_r_unshard_visitor_t::operator()(const rget_read_t &rg) {
     // Initialize response.
     response_out->response = rget_read_response_t();
@@ -697,17 +787,25 @@ void rdb_r_unshard_visitor_t::operator()(const distribution_read_t &dg) {
                  ++mit) {
                 mit->second = static_cast<int64_t>(mit->second * scale_factor);
             }
+            for (auto mit = results[largest_index].byte_counts.begin();
+                 mit != results[largest_index].byte_counts.end();
+                 ++mit) {
+                mit->second = static_cast<int64_t>(mit->second * scale_factor);
+            }
 
             // TODO: move semantics.
             res.key_counts.insert(
                 results[largest_index].key_counts.begin(),
                 results[largest_index].key_counts.end());
+            res.byte_counts.insert(
+                results[largest_index].byte_counts.begin(),
+                results[largest_index].byte_counts.end());
         }
     }
 
     // If the result is larger than the requested limit, scale it down
     if (dg.result_limit > 0 && res.key_counts.size() > dg.result_limit) {
-        scale_down_distribution(dg.result_limit, &res.key_counts);
+        scale_down_distribution(dg.result_limit, &res.key_counts, &res.byte_counts);
     }
 
     response_out->response = res;
@@ -723,7 +821,7 @@ void rdb_r_unshard_visitor_t::operator()(UNUSED const sindex_status_t &ss) {
     *response_out = read_response_t(sindex_status_response_t());
     auto ss_response = boost::get<sindex_status_response_t>(&response_out->response);
     for (size_t i = 0; i < count; ++i) {
-        auto resp = boost::get<sindex_status_response_t>(&responses[0].response);
+        auto resp = boost::get<sindex_status_response_t>(&responses[i].response);
         guarantee(resp != NULL);
         for (auto it = resp->statuses.begin(); it != resp->statuses.end(); ++it) {
             add_status(it->second, &ss_response->statuses[it->first]);
@@ -731,6 +829,17 @@ void rdb_r_unshard_visitor_t::operator()(UNUSED const sindex_status_t &ss) {
     }
 }
 
+void rdb_r_unshard_visitor_t::operator()(UNUSED const changefeed_subscribe_t &s) {
+    *response_out = read_response_t(changefeed_subscribe_response_t());
+    auto s_response = boost::get<changefeed_subscribe_response_t>(&response_out->response);
+    for (size_t i = 0; i < count; ++i) {
+        auto resp = boost::get<changefeed_subscribe_response_t>(&responses[i].response);
+        guarantee(resp != NULL);
+        s_response->addrs.insert(s_response->addrs.end(),
+                                 resp->addrs.begin(), resp->addrs.end());
+    }
+}
+
 void read_t::unshard(read_response_t *responses, size_t count,
                      read_response_t *response_out, context_t *ctx,
                      signal_t *interruptor) const
@@ -836,6 +945,36 @@ region_t write_t::get_region() const THROWS_NOTHING {
 }
 #endif // NDEBUG
 
+struct rdb_w_get_overwritten_region_visitor_t : public boost::static_visitor<bool> {
+    explicit rdb_w_get_overwritten_region_visitor_t(region_t *_region_out)
+        : region_out(_region_out) { }
+
+    bool operator()(const point_write_t &pw) const {
+        if (!pw.overwrite) {
+            return false;
+        }
+        *region_out = rdb_protocol_t::monokey_region(pw.key);
+        return true;
+    }
+
+    bool operator()(const point_delete_t &pd) const {
+        *region_out = rdb_protocol_t::monokey_region(pd.key);
+        return true;
+    }
+
+    template <class T>
+    bool operator()(const T &) const {
+        return false;
+    }
+
+    region_t *region_out;
+};
+
+bool write_t::get_overwritten_region(region_t *region_out) const THROWS_NOTHING {
+    return boost::apply_visitor(rdb_w_get_overwritten_region_visitor_t(region_out),
+                                write);
+}
+
 /* write_t::shard implementation */
 
 struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
@@ -1032,15 +1171,34 @@ void write_t::unshard(write_response_t *responses, size_t count,
 store_t::store_t(serializer_t *serializer,
                  const std::string &perfmon_name,
                  int64_t cache_target,
+                 cache_balancer_t *balancer,
                  bool create,
                  perfmon_collection_t *parent_perfmon_collection,
                  context_t *_ctx,
                  io_backender_t *io,
                  const base_path_t &base_path) :
     btree_store_t<rdb_protocol_t>(serializer, perfmon_name, cache_target,
-            create, parent_perfmon_collection, _ctx, io, base_path),
-    ctx(_ctx)
+            balancer, create, parent_perfmon_collection, _ctx, io, base_path),
+    ctx(_ctx),
+    reclaimer_sizer(new value_sizer_t<rdb_value_t>(cache->get_block_size())),
+    reclaimer_deleter(new rdb_value_deleter_t()),
+    reclaimer(new detached_subtree_reclaimer_t(general_cache_conn.get(),
+                                               reclaimer_sizer.get(),
+                                               reclaimer_deleter.get())),
+    hot_keys(new hot_key_cache_t(HOT_KEY_CACHE_SIZE, &perfmon_collection)),
+    key_filter(new key_filter_t(get_key_filter_bits_per_key(), cache.get(),
+                                &perfmon_collection)),
+    rebuilding_key_filter(false),
+    key_filter_rebuild_requested(false),
+    compacting(false),
+    compaction_requested(false)
 {
+    if (ctx != NULL && ctx->manager != NULL) {
+        changefeed_server.init(new ql::changefeed::server_t(ctx->manager));
+    }
+
+    rebuild_outdated_sindexes();
+
     // Make sure to continue bringing sindexes up-to-date if it was interrupted earlier
 
     // This uses a dummy interruptor because this is the only thing using the store at
@@ -1075,19 +1233,438 @@ store_t::store_t(serializer_t *serializer,
         rdb_protocol_details::bring_sindexes_up_to_date(sindexes_to_update, this,
                                                         &sindex_block);
     }
+
+    coro_t::spawn_sometime(std::bind(&store_t::reap_expired, this,
+                                     expiry_drainer.lock()));
 }
 
 store_t::~store_t() {
     assert_thread();
 }
 
+void store_t::rebuild_outdated_sindexes() {
+    // Like the constructor, this is the only thing using the store.
+    cond_t dummy_interruptor;
+    {
+        read_token_pair_t token_pair;
+        new_read_token_pair(&token_pair);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_read(&token_pair.main_read_token, &txn,
+                                    &superblock, &dummy_interruptor, false);
+        buf_lock_t sindex_block
+            = acquire_sindex_block_for_read(superblock->expose_buf(),
+                                            superblock->get_sindex_block_id());
+        superblock.reset();
+        std::map<std::string, secondary_index_t> sindexes;
+        get_secondary_indexes(&sindex_block, &sindexes);
+        bool any_outdated = false;
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            if (sindex_key_format(it->second) != ql::key_format_t::COMPACT) {
+                any_outdated = true;
+            }
+        }
+        if (!any_outdated) {
+            return;
+        }
+    }
+
+    write_token_pair_t token_pair;
+    new_write_token_pair(&token_pair);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    // Soft durability is enough: if we die before the new indexes are on disk, the
+    // old ones get replaced again.
+    acquire_superblock_for_write(repli_timestamp_t::distant_past, 2,
+                                 write_durability_t::SOFT, &token_pair, &txn,
+                                 &superblock, &dummy_interruptor);
+    buf_lock_t sindex_block
+        = acquire_sindex_block_for_write(superblock->expose_buf(),
+                                         superblock->get_sindex_block_id());
+    superblock.reset();
+
+    std::map<std::string, secondary_index_t> sindexes;
+    get_secondary_indexes(&sindex_block, &sindexes);
+    std::map<std::string, secondary_index_t::opaque_definition_t> new_definitions;
+    for (auto it = sindexes.begin(); it != sindexes.end();) {
+        ql::map_wire_func_t mapping;
+        sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+        std::vector<std::string> covered_fields;
+        bool counting;
+        std::string expiry_pkey;
+        ql::key_format_t key_format;
+        deserialize_sindex_definition(it->second.opaque_definition, &mapping, &multi,
+                                      &covered_fields, &counting, &expiry_pkey,
+                                      &key_format);
+        if (key_format == ql::key_format_t::COMPACT) {
+            ++it;
+            continue;
+        }
+        logINF("Rebuilding secondary index %s, whose keys are in an old format.\n",
+               it->first.c_str());
+        new_definitions[it->first] = serialize_sindex_definition(
+            mapping, multi, covered_fields, counting, expiry_pkey);
+        sindexes.erase(it++);
+    }
+
+    // The old indexes are dropped and the new ones created in the same transaction,
+    // so that a crash can't lose them.
+    value_sizer_t<rdb_value_t> sizer(cache->get_block_size());
+    rdb_value_detacher_t deleter;
+    std::set<std::string> created_sindexes;
+    set_sindexes(sindexes, &sindex_block, &sizer, &deleter, &created_sindexes,
+                 &dummy_interruptor);
+    for (auto it = new_definitions.begin(); it != new_definitions.end(); ++it) {
+        bool added = add_sindex(it->first, it->second, &sindex_block);
+        guarantee(added);
+    }
+}
+
+void store_t::spawn_compaction() {
+    assert_thread();
+    if (compacting) {
+        // The pass that's running may already be past the leaves that were just
+        // thinned out.
+        compaction_requested = true;
+        return;
+    }
+    compacting = true;
+    coro_t::spawn_sometime(std::bind(&store_t::compact, this,
+                                     compaction_drainer.lock()));
+}
+
+void store_t::compact(auto_drainer_t::lock_t keepalive) {
+    with_priority_t p(CORO_PRIORITY_RESET_DATA);
+    try {
+        do {
+            compaction_requested = false;
+            compact_primary_btree(reclaimer_sizer.get(), keepalive.get_drain_signal());
+        } while (compaction_requested);
+        // The compaction follows erase ranges, whose keys are still in the filter.
+        if (key_filter->is_built()) {
+            spawn_key_filter_rebuild();
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're being destroyed, and the rest of the btree is left as it is.
+    }
+    compacting = false;
+}
+
+void store_t::spawn_key_filter_rebuild() {
+    assert_thread();
+    if (!key_filter->is_enabled()) {
+        return;
+    }
+    if (rebuilding_key_filter) {
+        // The rebuild that's running may already be past the keys that changed.
+        key_filter_rebuild_requested = true;
+        return;
+    }
+    rebuilding_key_filter = true;
+    coro_t::spawn_sometime(std::bind(&store_t::rebuild_key_filter, this,
+                                     key_filter_drainer.lock()));
+}
+
+// Adds the keys of the primary btree to the key filter that's being rebuilt.  It
+// holds back while the foreground queries are too slow; since the traversal is of
+// a snapshot, that doesn't hold up any writes.
+class key_filter_rebuild_callback_t : public depth_first_traversal_callback_t {
+public:
+    key_filter_rebuild_callback_t(key_filter_t *_key_filter, signal_t *_interruptor)
+        : key_filter(_key_filter), interruptor(_interruptor), keys_in_batch(0) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        key_filter->add_rebuilt(keyvalue.key());
+        if (++keys_in_batch == KEY_FILTER_REBUILD_BATCH_SIZE) {
+            keys_in_batch = 0;
+            try {
+                wait_for_background_turn(interruptor);
+            } catch (const interrupted_exc_t &) {
+                return false;
+            }
+        }
+        return !interruptor->is_pulsed();
+    }
+
+private:
+    key_filter_t *key_filter;
+    signal_t *interruptor;
+    int keys_in_batch;
+};
+
+void store_t::rebuild_key_filter(auto_drainer_t::lock_t keepalive) {
+    with_priority_t p(CORO_PRIORITY_KEY_FILTER_REBUILD);
+    cache_account_t account
+        = cache->create_cache_account(KEY_FILTER_REBUILD_CACHE_PRIORITY);
+    try {
+        do {
+            key_filter_rebuild_requested = false;
+            // Before we get in line for the superblock, so that the writes after us
+            // add their keys to the new filter.
+            key_filter->start_rebuild();
+            bool finished;
+            {
+                read_token_pair_t token_pair;
+                new_read_token_pair(&token_pair);
+                scoped_ptr_t<txn_t> txn;
+                scoped_ptr_t<real_superblock_t> superblock;
+                acquire_superblock_for_read(&token_pair.main_read_token, &txn,
+                                            &superblock, keepalive.get_drain_signal(),
+                                            true /* USE_SNAPSHOT */);
+                txn->set_account(&account);
+
+                int64_t population = 0;
+                const block_id_t stat_block_id = superblock->get_stat_block_id();
+                if (stat_block_id != NULL_BLOCK_ID) {
+                    buf_lock_t stat_block(superblock->expose_buf(), stat_block_id,
+                                          access_t::read);
+                    buf_read_t read(&stat_block);
+                    population = static_cast<const btree_statblock_t *>(
+                        read.get_data_read())->population;
+                }
+                key_filter->size_rebuild(population);
+
+                key_filter_rebuild_callback_t callback(key_filter.get(),
+                                                       keepalive.get_drain_signal());
+                finished = btree_depth_first_traversal(btree.get(), superblock.get(),
+                                                       key_range_t::universe(),
+                                                       &callback, FORWARD);
+            }
+            if (!finished) {
+                // We're being destroyed.
+                key_filter->abandon_rebuild();
+                break;
+            }
+            key_filter->finish_rebuild();
+        } while (key_filter_rebuild_requested);
+    } catch (const interrupted_exc_t &) {
+        key_filter->abandon_rebuild();
+    }
+    rebuilding_key_filter = false;
+}
+
+// Returns the field if `sindex` is a single index on `row(field)`, and "" otherwise.
+static std::string get_sindex_row_field(const secondary_index_t &sindex) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> covered_fields;
+    bool counting;
+    deserialize_sindex_definition(sindex.opaque_definition, &mapping, &multi,
+                                  &covered_fields, &counting);
+    std::string field;
+    if (multi != sindex_multi_bool_t::SINGLE || counting
+        || !ql::get_row_field(mapping.compile_wire_func(), &field)) {
+        return "";
+    }
+    return field;
+}
+
+void store_t::reap_expired(auto_drainer_t::lock_t keepalive) {
+    with_priority_t p(CORO_PRIORITY_EXPIRY_REAP);
+    cache_account_t account = cache->create_cache_account(EXPIRY_REAP_CACHE_PRIORITY);
+    try {
+        for (;;) {
+            nap(EXPIRY_REAP_INTERVAL_MS, keepalive.get_drain_signal());
+
+            // The expiry indexes that are ready to be read, with their fields and
+            // their tables' primary keys.
+            std::map<std::string, std::pair<std::string, std::string> > expiry_indexes;
+            {
+                read_token_pair_t token_pair;
+                new_read_token_pair(&token_pair);
+                scoped_ptr_t<txn_t> txn;
+                scoped_ptr_t<real_superblock_t> superblock;
+                acquire_superblock_for_read(&token_pair.main_read_token, &txn,
+                                            &superblock, keepalive.get_drain_signal(),
+                                            false);
+                buf_lock_t sindex_block
+                    = acquire_sindex_block_for_read(superblock->expose_buf(),
+                                                    superblock->get_sindex_block_id());
+                superblock.reset();
+                std::map<std::string, secondary_index_t> sindexes;
+                get_secondary_indexes(&sindex_block, &sindexes);
+                for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+                    ql::map_wire_func_t mapping;
+                    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+                    std::vector<std::string> covered_fields;
+                    bool counting;
+                    std::string pkey;
+                    deserialize_sindex_definition(it->second.opaque_definition,
+                                                  &mapping, &multi, &covered_fields,
+                                                  &counting, &pkey);
+                    const std::string field = get_sindex_row_field(it->second);
+                    if (it->second.post_construction_complete
+                        && !pkey.empty() && !field.empty()) {
+                        expiry_indexes[it->first] = std::make_pair(field, pkey);
+                    }
+                }
+            }
+
+            for (auto it = expiry_indexes.begin(); it != expiry_indexes.end(); ++it) {
+                while (reap_expired_batch(it->first, it->second.first,
+                                          it->second.second, &account,
+                                          keepalive.get_drain_signal())) {
+                    nap(EXPIRY_REAP_BATCH_INTERVAL_MS, keepalive.get_drain_signal());
+                    wait_for_background_turn(keepalive.get_drain_signal());
+                }
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're being destroyed.
+    }
+}
+
+/* Collects the primary keys of the rows an expiry index has in a range of times. */
+class expired_keys_cb_t : public depth_first_traversal_callback_t {
+public:
+    explicit expired_keys_cb_t(std::vector<store_key_t> *_keys_out)
+        : keys_out(_keys_out) { }
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        keys_out->push_back(ql::datum_t::extract_primary(
+            store_key_t(keyvalue.key()->size, keyvalue.key()->contents)));
+        return keys_out->size() < static_cast<size_t>(EXPIRY_REAP_BATCH_SIZE);
+    }
+private:
+    std::vector<store_key_t> *const keys_out;
+};
+
+/* Deletes the rows whose `field` is a time no later than `now`, and leaves the others
+(which got a new time after we found them) alone. */
+class expired_row_replacer_t : public btree_batched_replacer_t {
+public:
+    expired_row_replacer_t(const std::string &_field,
+                           const counted_t<const ql::datum_t> &_now)
+        : field(_field), now(_now) { }
+    counted_t<const ql::datum_t> replace(
+        const counted_t<const ql::datum_t> &d, size_t) const {
+        if (d->get_type() != ql::datum_t::R_NULL) {
+            counted_t<const ql::datum_t> expiry = d->get(field, ql::NOTHROW);
+            if (expiry.has() && expiry->is_ptype(ql::pseudo::time_string)
+                && ql::pseudo::time_cmp(*expiry, *now) <= 0) {
+                return make_counted<ql::datum_t>(ql::datum_t::R_NULL);
+            }
+        }
+        return d;
+    }
+    bool should_return_vals() const { return false; }
+private:
+    const std::string field;
+    const counted_t<const ql::datum_t> now;
+};
+
+bool store_t::reap_expired_batch(const std::string &sindex_id,
+                                 const std::string &field,
+                                 const std::string &pkey,
+                                 cache_account_t *account,
+                                 signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    const counted_t<const ql::datum_t> now = ql::pseudo::time_now();
+
+    // Find the rows whose time has passed in the index, and forget about the index
+    // if it's being dropped.
+    std::vector<store_key_t> keys;
+    {
+        read_token_pair_t token_pair;
+        new_read_token_pair(&token_pair);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_read(&token_pair.main_read_token, &txn, &superblock,
+                                    interruptor, false);
+        txn->set_account(account);
+        scoped_ptr_t<real_superblock_t> sindex_sb;
+        try {
+            if (!acquire_sindex_superblock_for_read(sindex_id, superblock.get(),
+                                                    &sindex_sb, NULL)) {
+                return false;
+            }
+        } catch (const sindex_not_post_constructed_exc_t &) {
+            return false;
+        }
+        // Only times sort between these, and the index can't hold times before the
+        // first one.
+        const key_range_t range = rdb_protocol_t::sindex_key_range(
+            store_key_t(ql::pseudo::make_time(-std::numeric_limits<double>::max(),
+                                              "+00:00")->truncated_secondary()),
+            store_key_t(now->truncated_secondary()));
+        expired_keys_cb_t cb(&keys);
+        btree_depth_first_traversal(get_sindex_slice(sindex_id), sindex_sb.get(),
+                                    range, &cb, FORWARD);
+    }
+    if (keys.empty()) {
+        return false;
+    }
+
+    // Delete them, if they're still expired, through the same path as the writes.
+    write_token_pair_t token_pair;
+    new_write_token_pair(&token_pair);
+    wait_interruptible(token_pair.main_write_token.get(), interruptor);
+    // The deletions need a recency that backfills don't skip, and nothing can be more
+    // recent than the superblock while we hold the write token.
+    const repli_timestamp_t timestamp = cache->peek_recency(SUPERBLOCK_ID);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> real_superblock;
+    acquire_superblock_for_write(timestamp, keys.size(), write_durability_t::SOFT,
+                                 &token_pair, &txn, &real_superblock, interruptor);
+    txn->set_account(account);
+    buf_lock_t sindex_block
+        = acquire_sindex_block_for_write(real_superblock->expose_buf(),
+                                         real_superblock->get_sindex_block_id());
+    rdb_modification_report_cb_t sindex_cb(this, changefeed_server.get(),
+                                           &sindex_block,
+                                           auto_drainer_t::lock_t(&drainer));
+    hot_keys->invalidate(keys);
+    scoped_ptr_t<superblock_t> superblock(real_superblock.release());
+    expired_row_replacer_t replacer(field, now);
+    rdb_batched_replace(btree_info_t(btree.get(), timestamp, &pkey),
+                        &superblock, keys, &replacer, &sindex_cb, NULL);
+    return keys.size() == static_cast<size_t>(EXPIRY_REAP_BATCH_SIZE);
+}
+
 // TODO: get rid of this extra response_t copy on the stack
 struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const point_read_t &get) {
         response->response = point_read_response_t();
         point_read_response_t *res =
             boost::get<point_read_response_t>(&response->response);
+        if (hot_keys->lookup(get.key, &res->data)) {
+            return;
+        }
+        if (!key_filter->may_contain(get.key)) {
+            res->data.reset(new ql::datum_t(ql::datum_t::R_NULL));
+            return;
+        }
+        const hot_key_cache_t::fill_ticket_t ticket = hot_keys->fill_ticket();
         rdb_get(get.key, btree, superblock, res, ql_env.trace.get_or_null());
+        hot_keys->fill(get.key, res->data, ticket);
+    }
+
+    void operator()(const batched_point_read_t &get) {
+        response->response = batched_point_read_response_t();
+        batched_point_read_response_t *res =
+            boost::get<batched_point_read_response_t>(&response->response);
+        std::vector<store_key_t> misses;
+        for (auto it = get.keys.begin(); it != get.keys.end(); ++it) {
+            counted_t<const ql::datum_t> row;
+            if (!hot_keys->lookup(*it, &row)) {
+                if (key_filter->may_contain(*it)) {
+                    misses.push_back(*it);
+                }
+            } else if (row->get_type() != ql::datum_t::R_NULL) {
+                res->rows[*it] = row;
+            }
+        }
+        if (misses.empty()) {
+            return;
+        }
+        const hot_key_cache_t::fill_ticket_t ticket = hot_keys->fill_ticket();
+        std::vector<counted_t<const ql::datum_t> > rows;
+        rdb_get_batch(misses, btree, superblock, &rows, ql_env.trace.get_or_null());
+        for (size_t i = 0; i < misses.size(); ++i) {
+            hot_keys->fill(misses[i], rows[i], ticket);
+            if (rows[i]->get_type() != ql::datum_t::R_NULL) {
+                res->rows[misses[i]] = rows[i];
+            }
+        }
     }
 
     void operator()(const rget_read_t &rget) {
@@ -1134,28 +1711,49 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             //  between sindex_start_value and sindex_end_value.
             ql::map_wire_func_t sindex_mapping;
             sindex_multi_bool_t multi_bool = sindex_multi_bool_t::MULTI;
-            inplace_vector_read_stream_t read_stream(&sindex_mapping_data);
-            archive_result_t success = deserialize(&read_stream, &sindex_mapping);
-            guarantee_deserialization(success, "sindex description");
-            success = deserialize(&read_stream, &multi_bool);
-            guarantee_deserialization(success, "sindex description");
+            std::vector<std::string> covered_fields;
+            bool counting;
+            deserialize_sindex_definition(sindex_mapping_data, &sindex_mapping,
+                                          &multi_bool, &covered_fields, &counting);
+
+            // A counting index counts all of the store's rows, so if only some of
+            // them are being read (because the store holds more than one shard of
+            // the table), we can't tell which of the counts belong to the read.
+            if (counting && !rget.region.inner.is_superset(store->get_region().inner)) {
+                res->result = ql::exc_t(
+                    ql::base_exc_t::GENERIC,
+                    strprintf("Counting index `%s` can't be read on a server that "
+                              "holds more than one shard of the table.",
+                              rget.sindex->id.c_str()),
+                    NULL);
+                return;
+            }
 
             rdb_rget_secondary_slice(
                 store->get_sindex_slice(rget.sindex->id),
                 rget.sindex->original_range, rget.sindex->region,
                 sindex_sb.get(), &ql_env, rget.batchspec, rget.transforms,
                 rget.terminal, rget.region.inner, rget.sorting,
-                sindex_mapping, multi_bool, res);
+                sindex_mapping, multi_bool, covered_fields, counting, res);
         }
     }
 
     void operator()(const distribution_read_t &dg) {
         response->response = distribution_read_response_t();
         distribution_read_response_t *res = boost::get<distribution_read_response_t>(&response->response);
-        rdb_distribution_get(dg.max_depth, dg.region.inner.left,
-                             superblock, res);
+        if (dg.sample_count > 0) {
+            rdb_distribution_sample(dg.sample_count,
+                                    dg.result_limit > 0
+                                        ? static_cast<int>(dg.result_limit)
+                                        : dg.sample_count,
+                                    dg.region.inner.left, superblock, res);
+        } else {
+            rdb_distribution_get(dg.max_depth, dg.region.inner.left,
+                                 superblock, res);
+        }
         for (std::map<store_key_t, int64_t>::iterator it = res->key_counts.begin(); it != res->key_counts.end(); ) {
             if (!dg.region.inner.contains_key(store_key_t(it->first))) {
+                res->byte_counts.erase(it->first);
                 std::map<store_key_t, int64_t>::iterator tmp = it;
                 ++it;
                 res->key_counts.erase(tmp);
@@ -1166,7 +1764,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
         // If the result is larger than the requested limit, scale it down
         if (dg.result_limit > 0 && res->key_counts.size() > dg.result_limit) {
-            scale_down_distribution(dg.result_limit, &res->key_counts);
+            scale_down_distribution(dg.result_limit, &res->key_counts, &res->byte_counts);
         }
 
         res->region = dg.region;
@@ -1212,6 +1810,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                 rdb_protocol_details::single_sindex_status_t *s =
                     &res->statuses[it->first];
                 s->ready = it->second.post_construction_complete;
+                s->row_field = get_sindex_row_field(it->second);
                 if (!s->ready) {
                     if (frac.estimate_of_total_nodes == -1) {
                         s->blocks_processed = 0;
@@ -1225,8 +1824,23 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         }
     }
 
+    void operator()(const changefeed_subscribe_t &s) {
+        response->response = changefeed_subscribe_response_t();
+        auto res = boost::get<changefeed_subscribe_response_t>(&response->response);
+        // We subscribe while we hold the superblock, so that the client gets the
+        // changes of exactly the writes that come after this read.
+        if (changefeed_server != NULL) {
+            changefeed_server->add_client(s.addr);
+            res->addrs.push_back(changefeed_server->get_stop_addr());
+        }
+        superblock->release();
+    }
+
     rdb_read_visitor_t(btree_slice_t *_btree,
                        btree_store_t<rdb_protocol_t> *_store,
+                       hot_key_cache_t *_hot_keys,
+                       key_filter_t *_key_filter,
+                       ql::changefeed::server_t *_changefeed_server,
                        superblock_t *_superblock,
                        rdb_protocol_t::context_t *ctx,
                        read_response_t *_response,
@@ -1235,6 +1849,9 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response(_response),
         btree(_btree),
         store(_store),
+        hot_keys(_hot_keys),
+        key_filter(_key_filter),
+        changefeed_server(_changefeed_server),
         superblock(_superblock),
         interruptor(_interruptor, ctx->signals[get_thread_id().threadnum].get()),
         ql_env(ctx->extproc_pool,
@@ -1266,6 +1883,9 @@ private:
     read_response_t *response;
     btree_slice_t *btree;
     btree_store_t<rdb_protocol_t> *store;
+    hot_key_cache_t *hot_keys;
+    key_filter_t *key_filter;
+    ql::changefeed::server_t *changefeed_server;
     superblock_t *superblock;
     wait_any_t interruptor;
     ql::env_t ql_env;
@@ -1279,13 +1899,20 @@ void store_t::protocol_read(const read_t &read,
                             superblock_t *superblock,
                             signal_t *interruptor) {
     rdb_read_visitor_t v(
-        btree, this,
+        btree, this, hot_keys.get(), key_filter.get(), changefeed_server.get(),
         superblock,
         ctx, response, read.profile, interruptor);
     {
         profile::starter_t start_write("Perform read on shard.", v.get_env()->trace);
+        profile::count_shard_round_trips(v.get_env()->trace.get_or_null(), 1);
         boost::apply_visitor(v, read.read);
     }
+    // The key filter is only built once it has point reads to answer.
+    if (key_filter->is_enabled() && !key_filter->is_built() && !rebuilding_key_filter
+        && (boost::get<point_read_t>(&read.read) != NULL
+            || boost::get<batched_point_read_t>(&read.read) != NULL)) {
+        spawn_key_filter_rebuild();
+    }
 
     response->n_shards = 1;
     response->event_log = v.extract_event_log();
@@ -1339,8 +1966,10 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
     void operator()(const batched_replace_t &br) {
         ql_env.global_optargs.init_optargs(br.optargs);
         rdb_modification_report_cb_t sindex_cb(
-            store, &sindex_block,
+            store, changefeed_server, &sindex_block,
             auto_drainer_t::lock_t(&store->drainer));
+        hot_keys->invalidate(br.keys);
+        key_filter->add(br.keys);
         func_replacer_t replacer(&ql_env, br.f, br.return_vals);
         response->response =
             rdb_batched_replace(
@@ -1353,6 +1982,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
     void operator()(const batched_insert_t &bi) {
         rdb_modification_report_cb_t sindex_cb(
             store,
+            changefeed_server,
             &sindex_block,
             auto_drainer_t::lock_t(&store->drainer));
         datum_replacer_t replacer(&bi.inserts, bi.upsert, bi.pkey, bi.return_vals);
@@ -1361,6 +1991,8 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
             keys.emplace_back((*it)->get(bi.pkey)->print_primary());
         }
+        hot_keys->invalidate(keys);
+        key_filter->add(keys);
         response->response =
             rdb_batched_replace(
                 btree_info_t(btree, timestamp,
@@ -1374,11 +2006,13 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         point_write_response_t *res =
             boost::get<point_write_response_t>(&response->response);
 
+        hot_keys->invalidate(w.key);
+        key_filter->add(w.key);
         rdb_modification_report_t mod_report(w.key);
         rdb_set(w.key, w.data, w.overwrite, btree, timestamp, superblock->get(),
                 res, &mod_report.info, ql_env.trace.get_or_null());
 
-        update_sindexes(&mod_report);
+        update_sindexes(mod_report);
     }
 
     void operator()(const point_delete_t &d) {
@@ -1386,28 +2020,21 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         point_delete_response_t *res =
             boost::get<point_delete_response_t>(&response->response);
 
+        hot_keys->invalidate(d.key);
         rdb_modification_report_t mod_report(d.key);
         rdb_delete(d.key, btree, timestamp, superblock->get(), res,
                 &mod_report.info, ql_env.trace.get_or_null());
 
-        update_sindexes(&mod_report);
+        update_sindexes(mod_report);
     }
 
     void operator()(const sindex_create_t &c) {
         sindex_create_response_t res;
 
-        write_message_t wm;
-        wm << c.mapping;
-        wm << c.multi;
-
-        vector_stream_t stream;
-        stream.reserve(wm.size());
-        int write_res = send_write_message(&stream, &wm);
-        guarantee(write_res == 0);
-
         res.success = store->add_sindex(
             c.id,
-            stream.vector(),
+            serialize_sindex_definition(c.mapping, c.multi, c.covered_fields,
+                                        c.counting, c.expiry_pkey),
             &sindex_block);
 
         if (res.success) {
@@ -1447,6 +2074,9 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
     rdb_write_visitor_t(btree_slice_t *_btree,
                         btree_store_t<rdb_protocol_t> *_store,
+                        hot_key_cache_t *_hot_keys,
+                        key_filter_t *_key_filter,
+                        ql::changefeed::server_t *_changefeed_server,
                         txn_t *_txn,
                         scoped_ptr_t<superblock_t> *_superblock,
                         repli_timestamp_t _timestamp,
@@ -1455,6 +2085,9 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
                         signal_t *_interruptor) :
         btree(_btree),
         store(_store),
+        hot_keys(_hot_keys),
+        key_filter(_key_filter),
+        changefeed_server(_changefeed_server),
         txn(_txn),
         response(_response),
         superblock(_superblock),
@@ -1487,22 +2120,20 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
     }
 
 private:
-    void update_sindexes(const rdb_modification_report_t *mod_report) {
-        mutex_t::acq_t acq;
-        store->lock_sindex_queue(&sindex_block, &acq);
-
-        write_message_t wm;
-        wm << rdb_sindex_change_t(*mod_report);
-        store->sindex_queue_push(wm, &acq);
-
+    void update_sindexes(const rdb_modification_report_t &mod_report) {
+        std::vector<rdb_modification_report_t> mod_reports(1, mod_report);
         sindex_access_vector_t sindexes;
-        store->acquire_post_constructed_sindex_superblocks_for_write(&sindex_block,
-                                                                     &sindexes);
-        rdb_update_sindexes(sindexes, mod_report, txn);
+        rdb_queue_sindex_changes(store, changefeed_server, &sindex_block, mod_reports,
+                                 &sindexes);
+        rdb_update_sindexes(sindexes, mod_reports, txn,
+                            release_sindex_superblocks_t::YES);
     }
 
     btree_slice_t *btree;
     btree_store_t<rdb_protocol_t> *store;
+    hot_key_cache_t *hot_keys;
+    key_filter_t *key_filter;
+    ql::changefeed::server_t *changefeed_server;
     txn_t *txn;
     write_response_t *response;
     scoped_ptr_t<superblock_t> *superblock;
@@ -1520,15 +2151,20 @@ void store_t::protocol_write(const write_t &write,
                              btree_slice_t *btree,
                              scoped_ptr_t<superblock_t> *superblock,
                              signal_t *interruptor) {
-    rdb_write_visitor_t v(btree, this,
+    rdb_write_visitor_t v(btree, this, hot_keys.get(), key_filter.get(),
+                          changefeed_server.get(),
                           (*superblock)->expose_buf().txn(),
                           superblock,
                           timestamp.to_repli_timestamp(), ctx,
                           response, interruptor);
     {
         profile::starter_t start_write("Perform write on shard.", v.get_env()->trace);
+        profile::count_shard_round_trips(v.get_env()->trace.get_or_null(), 1);
         boost::apply_visitor(v, write.write);
     }
+    if (key_filter->is_overfull() && !rebuilding_key_filter) {
+        spawn_key_filter_rebuild();
+    }
 
     response->n_shards = 1;
     response->event_log = v.extract_event_log();
@@ -1658,7 +2294,7 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
                    superblock, &response, &mod_report.info,
                    static_cast<profile::trace_t *>(NULL));
 
-        update_sindexes(&mod_report);
+        update_sindexes(mod_report);
     }
 
     void operator()(const backfill_chunk_t::delete_range_t &delete_range) {
@@ -1666,7 +2302,7 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
         rdb_erase_range(&tester, delete_range.range.inner,
                         &sindex_block,
                         superblock, store,
-                        interruptor);
+                        NULL, interruptor);
     }
 
     void operator()(const backfill_chunk_t::key_value_pair_t &kv) {
@@ -1678,7 +2314,7 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
                 superblock, &response,
                 &mod_report.info, static_cast<profile::trace_t *>(NULL));
 
-        update_sindexes(&mod_report);
+        update_sindexes(mod_report);
     }
 
     void operator()(const backfill_chunk_t::sindexes_t &s) {
@@ -1701,18 +2337,12 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
     }
 
 private:
-    void update_sindexes(rdb_modification_report_t *mod_report) {
-        mutex_t::acq_t acq;
-        store->lock_sindex_queue(&sindex_block, &acq);
-
-        write_message_t wm;
-        wm << rdb_sindex_change_t(*mod_report);
-        store->sindex_queue_push(wm, &acq);
-
+    void update_sindexes(const rdb_modification_report_t &mod_report) {
+        std::vector<rdb_modification_report_t> mod_reports(1, mod_report);
         sindex_access_vector_t sindexes;
-        store->acquire_post_constructed_sindex_superblocks_for_write(
-                &sindex_block, &sindexes);
-        rdb_update_sindexes(sindexes, mod_report, txn);
+        rdb_queue_sindex_changes(store, NULL, &sindex_block, mod_reports, &sindexes);
+        rdb_update_sindexes(sindexes, mod_reports, txn,
+                            release_sindex_superblocks_t::YES);
     }
 
     btree_store_t<rdb_protocol_t> *store;
@@ -1730,11 +2360,26 @@ void store_t::protocol_receive_backfill(btree_slice_t *btree,
                                         signal_t *interruptor,
                                         const backfill_chunk_t &chunk) {
     with_priority_t p(CORO_PRIORITY_BACKFILL_RECEIVER);
+    // Backfills are rare enough that we don't bother with the chunk's keys.
+    hot_keys->invalidate_all();
+    if (const backfill_chunk_t::key_value_pair_t *kv
+            = boost::get<backfill_chunk_t::key_value_pair_t>(&chunk.val)) {
+        key_filter->add(kv->backfill_atom.key);
+    }
     rdb_receive_backfill_visitor_t v(this, btree,
                                      superblock->expose_buf().txn(),
                                      superblock,
                                      interruptor);
     boost::apply_visitor(v, chunk.val);
+
+    // A delete range chunk erases the keys of a hash shard, which are spread out
+    // over the whole key range.
+    if (boost::get<backfill_chunk_t::delete_range_t>(&chunk.val) != NULL) {
+        spawn_compaction();
+    }
+    if (key_filter->is_overfull() && !rebuilding_key_filter) {
+        spawn_key_filter_rebuild();
+    }
 }
 
 void store_t::protocol_reset_data(const region_t& subregion,
@@ -1744,14 +2389,24 @@ void store_t::protocol_reset_data(const region_t& subregion,
     with_priority_t p(CORO_PRIORITY_RESET_DATA);
     value_sizer_t<rdb_value_t> sizer(btree->cache()->get_block_size());
 
+    hot_keys->invalidate_all();
+
     always_true_key_tester_t key_tester;
     buf_lock_t sindex_block
         = acquire_sindex_block_for_write(superblock->expose_buf(),
                                          superblock->get_sindex_block_id());
+    // The data is going away for good, so instead of erasing it key by key while
+    // we hold up the writes behind us, we cut it out of the btree and leave the
+    // blocks for the reclaimer to free.
     rdb_erase_range(&key_tester, subregion.inner,
                     &sindex_block,
                     superblock, this,
+                    reclaimer.get(),
                     interruptor);
+
+    // The subregion might be a hash shard, in which case the leaves were thinned
+    // out rather than cut out of the btree.
+    spawn_compaction();
 }
 
 region_t rdb_protocol_t::cpu_sharding_subspace(int subregion_number,
@@ -1769,20 +2424,23 @@ region_t rdb_protocol_t::cpu_sharding_subspace(int subregion_number,
     return region_t(beg, end, key_range_t::universe());
 }
 
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::single_sindex_status_t,
-                           blocks_total, blocks_processed, ready);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_details::single_sindex_status_t,
+                           blocks_total, blocks_processed, ready, row_field);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_response_t, data);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::batched_point_read_response_t, rows);
 RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::rget_read_response_t,
                            result, key_range, truncated, last_key);
-RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::distribution_read_response_t,
-                           region, key_counts);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_response_t,
+                           region, key_counts, byte_counts);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_list_response_t, sindexes);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::read_response_t,
                            response, event_log, n_shards);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_status_response_t, statuses);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::changefeed_subscribe_response_t, addrs);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_t, key);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::batched_point_read_t, keys);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::sindex_rangespec_t,
                            id, region, original_range);
 
@@ -1795,10 +2453,11 @@ RDB_IMPL_ME_SERIALIZABLE_7(rdb_protocol_t::rget_read_t,
                            region, optargs, batchspec,
                            transforms, terminal, sindex, sorting);
 
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_t,
-                           max_depth, result_limit, region);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::distribution_read_t,
+                           max_depth, result_limit, sample_count, region);
 RDB_IMPL_ME_SERIALIZABLE_0(rdb_protocol_t::sindex_list_t);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_status_t, sindexes, region);
+RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::changefeed_subscribe_t, addr, region);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::read_t, read, profile);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_write_response_t, result);
 
@@ -1817,7 +2476,8 @@ RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::batched_insert_t,
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::point_write_t, key, data, overwrite);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_delete_t, key);
 
-RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::sindex_create_t, id, mapping, region, multi);
+RDB_IMPL_ME_SERIALIZABLE_7(rdb_protocol_t::sindex_create_t, id, mapping, region, multi,
+                           covered_fields, counting, expiry_pkey);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_drop_t, id, region);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sync_t, region);
 
@@ -24,10 +24,16 @@
 #include "http/json/cJSON.hpp"
 #include "memcached/region.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "utils.hpp"
 
+class cache_balancer_t;
 class extproc_pool_t;
+class hot_key_cache_t;
+class key_filter_t;
+class rdb_value_deleter_t;
+struct rdb_value_t;
 class cluster_directory_metadata_t;
 template <class> class cow_ptr_t;
 template <class> class cross_thread_watchable_variable_t;
@@ -94,6 +100,7 @@ class env_t;
 class primary_readgen_t;
 class readgen_t;
 class sindex_readgen_t;
+class spill_storage_t;
 } // namespace ql
 
 class datum_range_t {
@@ -166,6 +173,9 @@ struct single_sindex_status_t {
           blocks_total(_blocks_total), ready(_ready) { }
     size_t blocks_processed, blocks_total;
     bool ready;
+    // Set if the index function is `row(row_field)` and the index isn't a multi
+    // index, so that the index holds every row with an indexable `row_field`.
+    std::string row_field;
 
     RDB_DECLARE_ME_SERIALIZABLE;
 };
@@ -210,6 +220,12 @@ struct rdb_protocol_t {
 
         extproc_pool_t *extproc_pool;
         namespace_repo_t<rdb_protocol_t> *ns_repo;
+        // NULL unless the server has somewhere to spill query data to.
+        ql::spill_storage_t *spill_storage;
+        // Both NULL unless the server is in a cluster, without which there are no
+        // changefeeds.  The stores send their changes through `manager`.
+        mailbox_manager_t *manager;
+        ql::changefeed::client_t *changefeed_client;
 
         /* These arrays contain a watchable for each thread.
          * ie cross_thread_namespace_watchables[0] is a watchable for thread 0. */
@@ -243,6 +259,12 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct batched_point_read_response_t {
+        // Only the keys that have a row are present.
+        std::map<store_key_t, counted_t<const ql::datum_t> > rows;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct rget_read_response_t {
 
         class empty_t { RDB_MAKE_ME_SERIALIZABLE_0() };
@@ -271,6 +293,10 @@ struct rdb_protocol_t {
         // key_counts[kn] = the number of keys in [kn, right_key)
         region_t region;
         std::map<store_key_t, int64_t> key_counts;
+        // The same for the number of bytes the keys and their values take up.  Only
+        // sampled distributions (see distribution_read_t) estimate these; otherwise
+        // this is empty.
+        std::map<store_key_t, int64_t> byte_counts;
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -290,12 +316,21 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct changefeed_subscribe_response_t {
+        // Where to unsubscribe from each store the read went to.
+        std::vector<ql::changefeed::server_t::addr_t> addrs;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct read_response_t {
         typedef boost::variant<point_read_response_t,
+                               batched_point_read_response_t,
                                rget_read_response_t,
                                distribution_read_response_t,
                                sindex_list_response_t,
-                               sindex_status_response_t> variant_t;
+                               sindex_status_response_t,
+                               changefeed_subscribe_response_t> variant_t;
         variant_t response;
         profile::event_log_t event_log;
         size_t n_shards;
@@ -317,6 +352,25 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    // Reads the rows for several primary keys at once.  It's sharded like a range
+    // read over the keys, with each shard looking up the keys it has.  The keys
+    // are sorted so that each shard walks its B-tree in key order, with
+    // neighbouring keys finding the blocks they share already in the cache.
+    class batched_point_read_t {
+    public:
+        batched_point_read_t() { }
+        explicit batched_point_read_t(std::vector<store_key_t> &&_keys)
+            : keys(std::move(_keys)) {
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        }
+
+        // Not empty, sorted and without duplicates.
+        std::vector<store_key_t> keys;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct sindex_rangespec_t {
         sindex_rangespec_t() { }
         sindex_rangespec_t(const std::string &_id,
@@ -374,15 +428,21 @@ struct rdb_protocol_t {
     class distribution_read_t {
     public:
         distribution_read_t()
-            : max_depth(0), result_limit(0), region(region_t::universe())
+            : max_depth(0), result_limit(0), sample_count(0),
+              region(region_t::universe())
         { }
-        distribution_read_t(int _max_depth, size_t _result_limit)
+        distribution_read_t(int _max_depth, size_t _result_limit,
+                            int _sample_count = 0)
             : max_depth(_max_depth), result_limit(_result_limit),
-              region(region_t::universe())
+              sample_count(_sample_count), region(region_t::universe())
         { }
 
         int max_depth;
         size_t result_limit;
+        // If this is positive, the distribution is an equi-depth histogram built
+        // from this many random descents to the leaves of each btree, instead of
+        // the split points of the internal nodes down to max_depth.
+        int sample_count;
         region_t region;
 
         RDB_DECLARE_ME_SERIALIZABLE;
@@ -405,12 +465,26 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    // Subscribes `addr` to the changes made to the stores the read goes to (see
+    // rdb_protocol/changefeed.hpp).  It goes to every shard, like a range read.
+    class changefeed_subscribe_t {
+    public:
+        changefeed_subscribe_t() { }
+        explicit changefeed_subscribe_t(const ql::changefeed::client_addr_t &_addr)
+            : addr(_addr), region(region_t::universe()) { }
+        ql::changefeed::client_addr_t addr;
+        region_t region;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct read_t {
         typedef boost::variant<point_read_t,
+                               batched_point_read_t,
                                rget_read_t,
                                distribution_read_t,
                                sindex_list_t,
-                               sindex_status_t> variant_t;
+                               sindex_status_t,
+                               changefeed_subscribe_t> variant_t;
         variant_t read;
         profile_bool_t profile;
 
@@ -429,8 +503,12 @@ struct rdb_protocol_t {
         read_t(const variant_t &r, profile_bool_t _profile)
             : read(r), profile(_profile) { }
 
-        // Only use snapshotting if we're doing a range get.
-        bool use_snapshot() const THROWS_NOTHING { return boost::get<rget_read_t>(&read); }
+        // Only use snapshotting if we're doing a range get, or sampling a
+        // distribution, which visits nodes all over the btree.
+        bool use_snapshot() const THROWS_NOTHING {
+            const distribution_read_t *dg = boost::get<distribution_read_t>(&read);
+            return boost::get<rget_read_t>(&read) || (dg != NULL && dg->sample_count > 0);
+        }
 
         // Returns true if this read should be sent to every replica.
         bool all_read() const THROWS_NOTHING { return boost::get<sindex_status_t>(&read); }
@@ -582,14 +660,31 @@ struct rdb_protocol_t {
     public:
         sindex_create_t() { }
         sindex_create_t(const std::string &_id, const ql::map_wire_func_t &_mapping,
-                        sindex_multi_bool_t _multi)
-            : id(_id), mapping(_mapping), region(region_t::universe()), multi(_multi)
+                        sindex_multi_bool_t _multi,
+                        const std::vector<std::string> &_covered_fields
+                            = std::vector<std::string>(),
+                        bool _counting = false,
+                        const std::string &_expiry_pkey = "")
+            : id(_id), mapping(_mapping), region(region_t::universe()), multi(_multi),
+              covered_fields(_covered_fields), counting(_counting),
+              expiry_pkey(_expiry_pkey)
         { }
 
         std::string id;
         ql::map_wire_func_t mapping;
         region_t region;
         sindex_multi_bool_t multi;
+        // If this isn't empty, the index is a covering index: it stores these fields
+        // of each row (where they fit), and rows read through it are projected to
+        // them.
+        std::vector<std::string> covered_fields;
+        // If this is set, the index is a counting index: it keeps the number of rows
+        // for each index value, which are what's read through it.
+        bool counting;
+        // If this isn't empty, the index is an expiry index on a field of the rows,
+        // and this is the table's primary key: the stores delete the rows whose field
+        // is a time that has passed in the background.
+        std::string expiry_pkey;
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -631,6 +726,10 @@ struct rdb_protocol_t {
         profile_bool_t profile;
 
         region_t get_region() const THROWS_NOTHING;
+        // Returns true if the write replaces everything in its region no matter
+        // what was there before, and writes the region to region_out.  An earlier
+        // write that also replaces everything in that region needn't be applied.
+        bool get_overwritten_region(region_t *region_out) const THROWS_NOTHING;
         // Returns true if the write had any side effects applicable to the
         // region, and a non-empty write was written to write_out.
         bool shard(const region_t &region,
@@ -758,6 +857,7 @@ struct rdb_protocol_t {
         store_t(serializer_t *serializer,
                 const std::string &perfmon_name,
                 int64_t cache_target,
+                cache_balancer_t *balancer,
                 bool create,
                 perfmon_collection_t *parent_perfmon_collection,
                 context_t *ctx,
@@ -800,6 +900,63 @@ struct rdb_protocol_t {
                                  superblock_t *superblock,
                                  signal_t *interruptor);
         context_t *ctx;
+
+        // Replaces the secondary indexes whose keys are in the printed format with
+        // empty ones in the compact format, which the constructor then brings up to
+        // date like any other new index.  Queries compute secondary key ranges in the
+        // compact format, so the old indexes couldn't be read.
+        void rebuild_outdated_sindexes();
+
+        // Frees the blocks that protocol_reset_data cuts out of the btree.  It comes
+        // after the sizer and deleter it uses, so that it's destroyed first.
+        scoped_ptr_t<value_sizer_t<rdb_value_t> > reclaimer_sizer;
+        scoped_ptr_t<rdb_value_deleter_t> reclaimer_deleter;
+        scoped_ptr_t<detached_subtree_reclaimer_t> reclaimer;
+
+        // Documents of recently read keys, which point reads check before the btree.
+        scoped_ptr_t<hot_key_cache_t> hot_keys;
+
+        // A Bloom filter of the primary btree's keys, which point reads that miss
+        // hot_keys check before the btree.
+        scoped_ptr_t<key_filter_t> key_filter;
+
+        // Sends the changes the writes make to the changefeeds subscribed to them.
+        // It's only there if `ctx` has a mailbox manager.
+        scoped_ptr_t<ql::changefeed::server_t> changefeed_server;
+
+        // Rebuilds key_filter from the primary btree in the background, once the
+        // first point read comes and from then on when the filter needs it.  If a
+        // rebuild is requested while one is running, another follows it.  This
+        // comes before the compaction, which requests a rebuild when it's done, so
+        // that its drainer is destroyed after the compaction's.
+        void spawn_key_filter_rebuild();
+        void rebuild_key_filter(auto_drainer_t::lock_t keepalive);
+        bool rebuilding_key_filter;
+        bool key_filter_rebuild_requested;
+        auto_drainer_t key_filter_drainer;
+
+        // Compacts the primary btree in the background (with reclaimer_sizer), after
+        // erase ranges that may have thinned out its leaves.  If a compaction is
+        // requested while one is running, another pass follows it.
+        void spawn_compaction();
+        void compact(auto_drainer_t::lock_t keepalive);
+        bool compacting;
+        bool compaction_requested;
+        auto_drainer_t compaction_drainer;
+
+        // Deletes the rows of the expiry indexes whose time has passed, a batch per
+        // write txn.  Every replica of a shard reaps its own store, so they all
+        // delete the same rows without the writes going through the cluster.
+        void reap_expired(auto_drainer_t::lock_t keepalive);
+        // Deletes up to EXPIRY_REAP_BATCH_SIZE expired rows of the expiry index
+        // `sindex_id` on `field`, and returns true if there may be more.
+        bool reap_expired_batch(const std::string &sindex_id,
+                                const std::string &field,
+                                const std::string &pkey,
+                                cache_account_t *account,
+                                signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t);
+        auto_drainer_t expiry_drainer;
     };
 
     static region_t cpu_sharding_subspace(int subregion_number, int num_cpu_shards);
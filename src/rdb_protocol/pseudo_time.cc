@@ -1,8 +1,10 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/pseudo_time.hpp"
 
-#include <time.h>
+#include <inttypes.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
 
 #include "errors.hpp"
 #include <boost/date_time.hpp>
@@ -293,6 +295,168 @@ std::string iso8601(const std::string &s, const std::string &default_tz, date_fo
 
 } // namespace sanitize
 
+// The fast path.  A time is an epoch time plus a fixed offset from UTC, so its
+// fields in its own time zone are plain arithmetic on the epoch time, without
+// sanitizing the time zone and building boost objects for every row.  It only
+// covers what boost handles (years 1401 through 9998, offsets from -12:00 to
+// +14:00, complete ISO 8601 calendar dates) and computes exactly what the boost
+// code below does, which handles everything else and reports the errors.
+namespace fast {
+
+const int64_t micros_per_day = INT64_C(86400000000);
+
+int64_t floor_div(int64_t x, int64_t y) {
+    return x / y - (x % y != 0 && (x < 0) != (y < 0));
+}
+
+// The days since the epoch of a date in the proleptic Gregorian calendar.
+int64_t days_from_civil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = floor_div(year, 400);
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Parses a sanitized time zone, `[+-]HH:MM`, into an offset in seconds.
+bool parse_tz_offset(const char *tz, size_t size, int64_t *offset_out) {
+    // `-00:00` isn't a valid offset.
+    if (size != 6 || (tz[0] != '+' && tz[0] != '-') || tz[3] != ':' || tz[4] > '5'
+        || memcmp(tz, "-00:00", 6) == 0) {
+        return false;
+    }
+    const int digits[] = { 1, 2, 4, 5 };
+    for (size_t i = 0; i < 4; ++i) {
+        if (tz[digits[i]] < '0' || tz[digits[i]] > '9') {
+            return false;
+        }
+    }
+    int64_t offset = ((tz[1] - '0') * 10 + (tz[2] - '0')) * 3600
+        + ((tz[4] - '0') * 10 + (tz[5] - '0')) * 60;
+    offset = tz[0] == '-' ? -offset : offset;
+    // Boost rejects the offsets outside of this.
+    if (offset < -12 * 3600 || offset > 14 * 3600) {
+        return false;
+    }
+    *offset_out = offset;
+    return true;
+}
+
+struct local_time_t {
+    int64_t utc_micros;
+    // The days since the epoch in the time's own time zone, and the time since
+    // the start of that day.
+    int64_t days;
+    int64_t day_micros;
+    int year;
+    int month;
+    int day;
+};
+
+bool to_local_time(const datum_t &time, local_time_t *out) {
+    counted_t<const datum_t> tz = time.get(timezone_key, NOTHROW);
+    int64_t offset;
+    if (!tz.has() || tz->get_type() != datum_t::R_STR
+        || !parse_tz_offset(tz->as_str().data(), tz->as_str().size(), &offset)) {
+        return false;
+    }
+    double raw_sec = time.get(epoch_time_key)->as_num();
+    if (!(fabs(raw_sec) < 1e12)) {
+        return false;
+    }
+    // Rounded the same way as `add_seconds_to_ptime`.
+    int64_t sec = raw_sec;
+    int64_t microsec = (raw_sec * 1000000.0) - (sec * 1000000);
+    out->utc_micros = sec * 1000000 + microsec;
+    int64_t local_micros = out->utc_micros + offset * 1000000;
+    out->days = floor_div(local_micros, micros_per_day);
+    out->day_micros = local_micros - out->days * micros_per_day;
+
+    int64_t z = out->days + 719468;
+    int64_t era = floor_div(z, 146097);
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    out->day = doy - (153 * mp + 2) / 5 + 1;
+    out->month = mp < 10 ? mp + 3 : mp - 9;
+    int64_t year = yoe + era * 400 + (out->month <= 2);
+    if (year < 1401 || year > 9998) {
+        return false;
+    }
+    out->year = year;
+    return true;
+}
+
+// Reads `n` digits at `*p`, returns false if there aren't.
+bool read_digits(const char **p, const char *end, int n, int *out) {
+    int value = 0;
+    for (int i = 0; i < n; ++i, ++*p) {
+        if (*p == end || **p < '0' || **p > '9') {
+            return false;
+        }
+        value = value * 10 + (**p - '0');
+    }
+    *out = value;
+    return true;
+}
+
+// Parses the usual complete form, `YYYY-MM-DDTHH:MM:SS[.sss][Z|+HH:MM|-HH:MM]`.
+bool parse_iso8601(const std::string &s, const std::string &default_tz,
+                   double *epoch_time_out, std::string *tz_out) {
+    const char *p = s.data();
+    const char *end = p + s.size();
+    int year, month, day, hours, minutes, seconds;
+    if (!read_digits(&p, end, 4, &year) || p == end || *p++ != '-'
+        || !read_digits(&p, end, 2, &month) || p == end || *p++ != '-'
+        || !read_digits(&p, end, 2, &day) || p == end || *p++ != 'T'
+        || !read_digits(&p, end, 2, &hours) || p == end || *p++ != ':'
+        || !read_digits(&p, end, 2, &minutes) || p == end || *p++ != ':'
+        || !read_digits(&p, end, 2, &seconds)) {
+        return false;
+    }
+    // Only the first three digits of the fraction count.
+    int64_t millis = 0;
+    if (p != end && *p == '.') {
+        ++p;
+        int digits = 0;
+        for (; p != end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            if (digits < 3) {
+                millis = millis * 10 + (*p - '0');
+            }
+        }
+        if (digits == 0) {
+            return false;
+        }
+        for (; digits < 3; ++digits) {
+            millis *= 10;
+        }
+    }
+    std::string tz = p == end ? default_tz : std::string(p, end);
+    if (tz == "Z") {
+        tz = "+00:00";
+    }
+    int64_t offset;
+    if (!parse_tz_offset(tz.data(), tz.size(), &offset)) {
+        return false;
+    }
+    if (year < 1401 || year > 9998 || month < 1 || month > 12 || day < 1
+        || hours > 23 || minutes > 59 || seconds > 59) {
+        return false;
+    }
+    int64_t days = days_from_civil(year, month, day);
+    if (days >= days_from_civil(year + (month == 12), month % 12 + 1, 1)) {
+        return false;
+    }
+    int64_t sec = days * 86400 + hours * 3600 + minutes * 60 + seconds - offset;
+    *epoch_time_out = (sec * 1000000 + millis * 1000) / 1000000.0;
+    *tz_out = std::move(tz);
+    return true;
+}
+
+} // namespace fast
+
 bool tz_valid(const std::string &tz, std::string *tz_out = NULL) {
     try {
         std::string s = sanitize::tz(tz);
@@ -338,6 +502,11 @@ counted_t<const datum_t> boost_to_time(time_t t, const rcheckable_t *target) {
 
 counted_t<const datum_t> iso8601_to_time(
     const std::string &s, const std::string &default_tz, const rcheckable_t *target) {
+    double epoch_time;
+    std::string tz;
+    if (fast::parse_iso8601(s, default_tz, &epoch_time, &tz)) {
+        return make_time(epoch_time, std::move(tz));
+    }
     try {
         date_format_t df = UNSET;
         std::string sanitized;
@@ -411,6 +580,23 @@ const std::locale tz_format =
 const std::locale no_tz_format =
     std::locale(std::locale::classic(), new output_timefmt_t("%Y-%m-%dT%H:%M:%S%F"));
 std::string time_to_iso8601(counted_t<const datum_t> d) {
+    fast::local_time_t local;
+    if (fast::to_local_time(*d, &local)) {
+        int64_t sec = local.day_micros / 1000000;
+        int64_t frac = local.day_micros % 1000000;
+        std::string res = strprintf("%04d-%02d-%02dT%02d:%02d:%02d",
+                                    local.year, local.month, local.day,
+                                    static_cast<int>(sec / 3600),
+                                    static_cast<int>(sec / 60 % 60),
+                                    static_cast<int>(sec % 60));
+        // Like boost, this leaves out the fraction only if it is exactly zero.
+        if (frac != 0) {
+            res += strprintf(".%03d", static_cast<int>(frac / 1000));
+        }
+        const wire_string_t &tz = d->get(timezone_key)->as_str();
+        res.append(tz.data(), tz.size());
+        return res;
+    }
     try {
         time_t t = time_to_boost(d);
         int year = t.date().year();
@@ -620,6 +806,29 @@ counted_t<const datum_t> time_sub(counted_t<const datum_t> time,
 }
 
 double time_portion(counted_t<const datum_t> time, time_component_t c) {
+    fast::local_time_t local;
+    if (fast::to_local_time(*time, &local)) {
+        switch (c) {
+        case YEAR: return local.year;
+        case MONTH: return local.month;
+        case DAY: return local.day;
+        case DAY_OF_WEEK: {
+            // The epoch was a Thursday.
+            int64_t d = local.days + 3;
+            return d - fast::floor_div(d, 7) * 7 + 1;
+        } break;
+        case DAY_OF_YEAR:
+            return local.days - fast::days_from_civil(local.year, 1, 1) + 1;
+        case HOURS: return local.day_micros / INT64_C(3600000000);
+        case MINUTES: return local.day_micros / 60000000 % 60;
+        case SECONDS: {
+            double frac = modf(time->get(epoch_time_key)->as_num(), &frac);
+            frac = round(frac * 1000) / 1000;
+            return local.day_micros / 1000000 % 60 + frac;
+        } break;
+        default: unreachable();
+        }
+    }
     try {
         ptime_t ptime = time_to_boost(time).local_time();
         switch (c) {
@@ -652,12 +861,24 @@ time_t boost_date(time_t boost_time) {
 
 counted_t<const datum_t> time_date(counted_t<const datum_t> time,
                                    const rcheckable_t *target) {
+    fast::local_time_t local;
+    if (fast::to_local_time(*time, &local)) {
+        // Like the boost code, this is midnight UTC of the day in the time's own
+        // time zone.
+        return make_time(local.days * 86400.0,
+                         time->get(timezone_key)->as_str().to_std());
+    }
     try {
         return boost_to_time(boost_date(time_to_boost(time)), target);
     } HANDLE_BOOST_ERRORS(target);
 }
 
 counted_t<const datum_t> time_of_day(counted_t<const datum_t> time) {
+    fast::local_time_t local;
+    if (fast::to_local_time(*time, &local)) {
+        double sec = (local.utc_micros - local.days * fast::micros_per_day) / 1000000.0;
+        return make_counted<const datum_t>(round(sec * 1000) / 1000);
+    }
     try {
         time_t boost_time = time_to_boost(time);
         double sec =
@@ -667,11 +888,11 @@ counted_t<const datum_t> time_of_day(counted_t<const datum_t> time) {
     } HANDLE_BOOST_ERRORS_NO_TARGET;
 }
 
-void time_to_str_key(const datum_t &d, std::string *str_out) {
+void time_to_str_key(const datum_t &d, key_format_t format, std::string *str_out) {
     // We need to prepend "P" and append a character less than [a-zA-Z] so that
     // different pseudotypes sort correctly.
     str_out->append(std::string("P") + time_string + ":");
-    d.get(epoch_time_key)->num_to_str_key(str_out);
+    d.get(epoch_time_key)->num_to_str_key(format, str_out);
 }
 
 } // namespace pseudo
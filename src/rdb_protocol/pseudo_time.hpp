@@ -9,9 +9,11 @@ template <class> class counted_t;
 namespace ql {
 class rcheckable_t;
 class datum_t;
+enum class key_format_t;
 
 namespace pseudo {
 extern const char *const time_string;
+extern const char *const epoch_time_key;
 
 counted_t<const datum_t> iso8601_to_time(
     const std::string &s, const std::string &default_tz, const rcheckable_t *t);
@@ -49,7 +51,7 @@ counted_t<const datum_t> time_date(counted_t<const datum_t> time,
                                    const rcheckable_t *target);
 counted_t<const datum_t> time_of_day(counted_t<const datum_t> time);
 
-void time_to_str_key(const datum_t &d, std::string *str_out);
+void time_to_str_key(const datum_t &d, key_format_t format, std::string *str_out);
 
 } // namespace pseudo
 } // namespace ql
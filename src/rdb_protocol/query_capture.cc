@@ -0,0 +1,288 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_capture.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "arch/types.hpp"
+#include "logger.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+static const char trace_magic[] = "RQLTRACE";
+
+static void append_le32(uint32_t value, std::string *out) {
+    for (int i = 0; i < 4; ++i) {
+        out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+static void append_le64(uint64_t value, std::string *out) {
+    for (int i = 0; i < 8; ++i) {
+        out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+void serialize_trace_header(microtime_t start_time, std::string *out) {
+    out->append(trace_magic, sizeof(trace_magic) - 1);
+    append_le32(query_capture_t::trace_version, out);
+    append_le64(start_time, out);
+}
+
+void serialize_trace_record(int64_t time_us, uint32_t connection_id,
+                            const std::string &serialized_query, std::string *out) {
+    append_le32(serialized_query.size(), out);
+    append_le64(time_us, out);
+    append_le32(connection_id, out);
+    out->append(serialized_query);
+}
+
+query_capture_t::settings_t::settings_t()
+    : sample_period(QUERY_CAPTURE_SAMPLE_PERIOD),
+      max_bytes(QUERY_CAPTURE_MAX_BYTES) { }
+
+query_capture_t::query_capture_t()
+    : generation(0), connections_seen(0), start_time(0), fd(-1), flushing(false) {
+    status.active = false;
+    status.connections = 0;
+    status.queries = 0;
+    status.bytes = 0;
+    status.dropped = 0;
+}
+
+query_capture_t::~query_capture_t() {
+    if (fd != -1) {
+        ::close(fd);
+    }
+}
+
+query_capture_t &query_capture_t::get_global_capture() {
+    // Singleton implementation as in `slow_query_log_t`.
+    static query_capture_t capture;
+    return capture;
+}
+
+void query_capture_t::set_directory(const std::string &_directory) {
+    spinlock_acq_t lock(&spinlock);
+    directory = _directory;
+}
+
+bool query_capture_t::start(const settings_t &settings, std::string *error_out) {
+    if (settings.file_name.empty() || settings.file_name == "."
+        || settings.file_name == ".." || settings.file_name.find('/') != std::string::npos) {
+        *error_out = "The trace file must be a plain file name.";
+        return false;
+    }
+    if (settings.sample_period < 1 || settings.max_bytes < 1) {
+        *error_out = "`sample_period` and `max_bytes` must be positive.";
+        return false;
+    }
+    std::string path;
+    {
+        spinlock_acq_t lock(&spinlock);
+        if (directory.empty()) {
+            *error_out = "This server has no data directory to write the trace to.";
+            return false;
+        }
+        if (status.active || fd != -1) {
+            *error_out = "A capture is running already.";
+            return false;
+        }
+        path = directory + "/" + settings.file_name;
+    }
+
+    int new_fd;
+    int open_errno = 0;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        do {
+            new_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        } while (new_fd == -1 && get_errno() == EINTR);
+        if (new_fd == -1) {
+            open_errno = get_errno();
+        }
+    });
+    if (new_fd == -1) {
+        *error_out = strprintf("Could not create `%s`: %s", path.c_str(),
+                               errno_string(open_errno).c_str());
+        return false;
+    }
+
+    {
+        spinlock_acq_t lock(&spinlock);
+        if (status.active || fd != -1) {
+            // Someone started another one while we were creating the file.
+            ::close(new_fd);
+            *error_out = "A capture is running already.";
+            return false;
+        }
+        ++generation;
+        status.active = true;
+        status.settings = settings;
+        status.connections = 0;
+        status.queries = 0;
+        status.bytes = 0;
+        status.dropped = 0;
+        status.error.clear();
+        connections_seen = 0;
+        start_time = current_microtime();
+        fd = new_fd;
+        buffer.clear();
+        serialize_trace_header(start_time, &buffer);
+    }
+    logINF("Started capturing queries to `%s`, from one in %" PRIi64 " connections.\n",
+           path.c_str(), settings.sample_period);
+    return true;
+}
+
+void query_capture_t::stop() {
+    int trace_fd;
+    std::string data;
+    for (;;) {
+        {
+            spinlock_acq_t lock(&spinlock);
+            if (!flushing) {
+                status.active = false;
+                trace_fd = fd;
+                fd = -1;
+                data.swap(buffer);
+                flushing = trace_fd != -1;
+                break;
+            }
+        }
+        // Another coroutine is writing to the file; let it finish.
+        nap(1);
+    }
+    if (trace_fd == -1) {
+        return;
+    }
+
+    std::string error;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        write_blocking(trace_fd, data, &error);
+        ::close(trace_fd);
+    });
+
+    status_t final_status;
+    {
+        spinlock_acq_t lock(&spinlock);
+        flushing = false;
+        if (error.empty()) {
+            status.bytes += data.size();
+        } else if (status.error.empty()) {
+            status.error = error;
+        }
+        final_status = status;
+    }
+    logINF("Stopped capturing queries to `%s`: %" PRIi64 " queries of %" PRIi64
+           " connections, %" PRIi64 " bytes, %" PRIi64 " dropped.%s%s\n",
+           final_status.settings.file_name.c_str(), final_status.queries,
+           final_status.connections, final_status.bytes, final_status.dropped,
+           final_status.error.empty() ? "" : " ", final_status.error.c_str());
+}
+
+query_capture_t::status_t query_capture_t::get_status() {
+    spinlock_acq_t lock(&spinlock);
+    return status;
+}
+
+void query_capture_t::on_query(const Query &query, connection_t *connection) {
+    {
+        spinlock_acq_t lock(&spinlock);
+        if (!status.active) {
+            return;
+        }
+        if (connection->generation != generation) {
+            connection->generation = generation;
+            connection->sampled = connections_seen % status.settings.sample_period == 0;
+            ++connections_seen;
+            if (connection->sampled) {
+                connection->id = status.connections;
+                ++status.connections;
+            }
+        }
+    }
+    if (!connection->sampled) {
+        return;
+    }
+
+    std::string serialized_query;
+    query.SerializeToString(&serialized_query);
+
+    bool need_flush = false;
+    bool need_stop = false;
+    {
+        spinlock_acq_t lock(&spinlock);
+        if (!status.active || connection->generation != generation) {
+            return;
+        }
+        // The time is taken under the lock, so the records are in order.
+        int64_t time_us = current_microtime() - start_time;
+        const int64_t record_size = record_header_size + serialized_query.size();
+        if (status.bytes + static_cast<int64_t>(buffer.size()) + record_size
+            > status.settings.max_bytes) {
+            status.error = "The trace reached its maximum size.";
+            need_stop = true;
+        } else if (buffer.size() >= QUERY_CAPTURE_MAX_BUFFER_SIZE) {
+            ++status.dropped;
+        } else {
+            serialize_trace_record(time_us, connection->id, serialized_query, &buffer);
+            ++status.queries;
+            if (buffer.size() >= QUERY_CAPTURE_FLUSH_SIZE && !flushing) {
+                flushing = true;
+                need_flush = true;
+            }
+        }
+    }
+
+    if (need_flush) {
+        flush_buffer();
+    } else if (need_stop) {
+        stop();
+    }
+}
+
+void query_capture_t::flush_buffer() {
+    int trace_fd;
+    std::string data;
+    {
+        spinlock_acq_t lock(&spinlock);
+        rassert(flushing);
+        trace_fd = fd;
+        data.swap(buffer);
+    }
+
+    std::string error;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        write_blocking(trace_fd, data, &error);
+    });
+
+    {
+        spinlock_acq_t lock(&spinlock);
+        flushing = false;
+        if (error.empty()) {
+            status.bytes += data.size();
+            return;
+        }
+        status.error = error;
+    }
+    stop();
+}
+
+void query_capture_t::write_blocking(int trace_fd, const std::string &data,
+                                     std::string *error_out) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t res = ::write(trace_fd, data.data() + written, data.size() - written);
+        if (res == -1) {
+            if (get_errno() == EINTR) {
+                continue;
+            }
+            *error_out = strprintf("Could not write the trace: %s",
+                                   errno_string(get_errno()).c_str());
+            return;
+        }
+        written += res;
+    }
+}
@@ -0,0 +1,122 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_CAPTURE_HPP_
+#define RDB_PROTOCOL_QUERY_CAPTURE_HPP_
+
+#include <string>
+
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+class Query;
+
+/*
+ * The `query_capture_t` records the queries that clients send to this server in a
+ * trace file, so that bench/stress-client's `replay` can send them again, with the
+ * same timing and concurrency, to a test cluster.  It's controlled through
+ * `query_capture_http_app_t`.
+ *
+ * It samples connections rather than queries: one in every `sample_period`
+ * connections has all of its queries recorded, so that the CONTINUEs and STOPs of
+ * its streams are there with the STARTs, and so that the replayed connections keep
+ * the original ones' mix of queries.  A connection that was already open when the
+ * capture started is sampled from its next query on.
+ *
+ * The trace is a header, then one record per query, all integers little endian:
+ *
+ *     header:  "RQLTRACE", uint32 version, int64 start time in unix microseconds
+ *     record:  uint32 size of the query, int64 microseconds since the start,
+ *              uint32 connection id, then the query as a serialized `Query`
+ *
+ * The query is recorded as the client sent it, before the server adds anything to
+ * it (such as the slow query log's `profile`), re-serialized so that the same query
+ * always has the same bytes.  Records are buffered and written in chunks by the
+ * query that fills the buffer; if the disk falls behind, records are dropped and
+ * counted rather than buffered without limit.  The capture stops by itself when
+ * the file reaches `max_bytes`.
+ */
+class query_capture_t {
+public:
+    static const uint32_t trace_version = 1;
+    // The size of a record without its query.
+    static const size_t record_header_size = 16;
+
+    struct settings_t {
+        settings_t();
+        // The name of the trace file in the data directory.
+        std::string file_name;
+        int64_t sample_period;
+        int64_t max_bytes;
+    };
+
+    struct status_t {
+        bool active;
+        settings_t settings;
+        int64_t connections;
+        int64_t queries;
+        int64_t bytes;
+        int64_t dropped;
+        // Why the capture stopped, if it wasn't asked to.
+        std::string error;
+    };
+
+    /* What the capture knows of a client connection, kept with the connection. */
+    struct connection_t {
+        connection_t() : generation(0), sampled(false), id(0) { }
+        // The capture the rest is about; 0 for none yet.
+        uint64_t generation;
+        bool sampled;
+        uint32_t id;
+    };
+
+    query_capture_t();
+    ~query_capture_t();
+
+    static query_capture_t &get_global_capture();
+
+    /* The directory the trace files go to.  Without one, captures can't start. */
+    void set_directory(const std::string &directory);
+
+    /* Starts writing a new trace.  Returns false and sets `*error_out` if there's a
+    capture running already, the file name isn't a plain name, or the file can't be
+    created.  Must be called in a coroutine. */
+    bool start(const settings_t &settings, std::string *error_out);
+
+    /* Writes out what's buffered and closes the trace.  Must be called in a
+    coroutine. */
+    void stop();
+
+    status_t get_status();
+
+    /* Records `query` if `connection` is sampled.  Must be called in a coroutine,
+    which may block to write out the buffer. */
+    void on_query(const Query &query, connection_t *connection);
+
+private:
+    void flush_buffer();
+    void write_blocking(int fd, const std::string &data, std::string *error_out);
+
+    spinlock_t spinlock;
+    std::string directory;
+    // Counts the captures that were started, so connections know when theirs is
+    // out of date.
+    uint64_t generation;
+    status_t status;
+    // The connections that sent a query during this capture, sampled or not.
+    int64_t connections_seen;
+    microtime_t start_time;
+    int fd;
+    std::string buffer;
+    // Set while a coroutine writes out the buffer, so that only one does.
+    bool flushing;
+
+    DISABLE_COPYING(query_capture_t);
+};
+
+/* Appends the header of a trace, or a record of one, to `*out`. */
+void serialize_trace_header(microtime_t start_time, std::string *out);
+void serialize_trace_record(int64_t time_us, uint32_t connection_id,
+                            const std::string &serialized_query, std::string *out);
+
+#endif  // RDB_PROTOCOL_QUERY_CAPTURE_HPP_
@@ -0,0 +1,120 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/regex_cache.hpp"
+
+#include <ctype.h>
+#include <string.h>
+
+#include <list>
+#include <map>
+#include <utility>
+
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+
+namespace ql {
+
+compiled_regex_t::compiled_regex_t(const std::string &pattern)
+    : regexp(pattern, RE2::Quiet) { }
+
+namespace {
+
+class regex_cache_t {
+public:
+    counted_t<const compiled_regex_t> find(const std::string &pattern) {
+        spinlock_acq_t lock(&spinlock);
+        auto it = entries.find(pattern);
+        if (it == entries.end()) {
+            return counted_t<const compiled_regex_t>();
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    void insert(const std::string &pattern,
+                const counted_t<const compiled_regex_t> &regex) {
+        spinlock_acq_t lock(&spinlock);
+        if (entries.count(pattern) != 0) {
+            // Another query compiled it at the same time.
+            return;
+        }
+        lru.push_front(std::make_pair(pattern, regex));
+        entries[pattern] = lru.begin();
+        if (lru.size() > REGEX_CACHE_SIZE) {
+            entries.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+
+private:
+    typedef std::list<std::pair<std::string, counted_t<const compiled_regex_t> > > lru_t;
+
+    spinlock_t spinlock;
+    // Most recently used first.
+    lru_t lru;
+    std::map<std::string, lru_t::iterator> entries;
+};
+
+regex_cache_t &get_regex_cache() {
+    // Singleton implementation as in `slow_query_log_t`.
+    static regex_cache_t cache;
+    return cache;
+}
+
+}  // namespace
+
+counted_t<const compiled_regex_t> get_compiled_regex(const std::string &pattern) {
+    if (pattern.size() > REGEX_CACHE_MAX_PATTERN_SIZE) {
+        return make_counted<const compiled_regex_t>(pattern);
+    }
+    regex_cache_t *cache = &get_regex_cache();
+    counted_t<const compiled_regex_t> regex = cache->find(pattern);
+    if (!regex.has()) {
+        // Compiled without the lock held, since it can take a while.
+        regex = make_counted<const compiled_regex_t>(pattern);
+        if (regex->get().ok()) {
+            cache->insert(pattern, regex);
+        }
+    }
+    return regex;
+}
+
+static bool is_literal_char(char c) {
+    return c >= 0x20 && c <= 0x7e && strchr("\\^$.|?*+()[]{}", c) == NULL;
+}
+
+bool get_regex_prefix(const std::string &pattern, std::string *prefix_out) {
+    if (pattern.empty() || pattern[0] != '^'
+        || pattern.find('|') != std::string::npos) {
+        return false;
+    }
+    std::string prefix;
+    size_t i = 1;
+    while (i < pattern.size()) {
+        const char c = pattern[i];
+        if (is_literal_char(c)) {
+            prefix.push_back(c);
+            ++i;
+        } else if (c == '\\' && i + 1 < pattern.size()
+                   && pattern[i + 1] >= 0x20 && pattern[i + 1] <= 0x7e
+                   && !isalnum(pattern[i + 1])) {
+            // An escaped punctuation character stands for itself; escaped letters
+            // and digits are classes and assertions.
+            prefix.push_back(pattern[i + 1]);
+            i += 2;
+        } else {
+            break;
+        }
+    }
+    if (i < pattern.size() && !prefix.empty()
+        && (pattern[i] == '?' || pattern[i] == '*' || pattern[i] == '{')) {
+        // The last character may not be there.
+        prefix.resize(prefix.size() - 1);
+    }
+    if (prefix.empty()) {
+        return false;
+    }
+    *prefix_out = prefix;
+    return true;
+}
+
+}  // namespace ql
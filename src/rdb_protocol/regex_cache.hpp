@@ -0,0 +1,44 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_REGEX_CACHE_HPP_
+#define RDB_PROTOCOL_REGEX_CACHE_HPP_
+
+#include <re2/re2.h>
+
+#include <string>
+
+#include "containers/counted.hpp"
+#include "errors.hpp"
+
+namespace ql {
+
+/* A pattern compiled by RE2.  RE2 objects can be used by several threads at once,
+so a `compiled_regex_t` can be shared by all of the queries that use its pattern. */
+class compiled_regex_t : public slow_atomic_countable_t<compiled_regex_t> {
+public:
+    explicit compiled_regex_t(const std::string &pattern);
+
+    // Check `get().ok()` before matching with it.
+    const RE2 &get() const { return regexp; }
+
+private:
+    RE2 regexp;
+
+    DISABLE_COPYING(compiled_regex_t);
+};
+
+/* Returns `pattern` compiled.  The server keeps the last `REGEX_CACHE_SIZE`
+patterns that compiled, so queries that use the same pattern over and over don't
+compile it every time. */
+counted_t<const compiled_regex_t> get_compiled_regex(const std::string &pattern);
+
+/* Returns true if every string that `pattern` matches starts with a non-empty
+literal prefix, which is set to `prefix_out`: the pattern starts with `^`, has no
+`|`, and the prefix is what comes before its first special character, less a last
+character that the special character makes optional.  Only printable ASCII
+characters count, so the next string after all strings with the prefix is the
+prefix with its last character incremented. */
+bool get_regex_prefix(const std::string &pattern, std::string *prefix_out);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_REGEX_CACHE_HPP_
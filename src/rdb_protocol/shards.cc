@@ -1,7 +1,12 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
 #include "boost/variant.hpp"
 
+#include "rdb_protocol/batch_predicate.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -167,11 +172,16 @@ accumulator_t *make_append(const sorting_t &sorting, batcher_t *batcher) {
 // This can't be a normal terminal because it wouldn't preserve ordering.
 // (Also, I'm sorry for this absurd type hierarchy.)
 class to_array_t : public eager_acc_t {
+public:
+    explicit to_array_t(env_t *env) : charge(env) { }
 private:
     virtual void operator()(groups_t *gs) {
         for (auto kv = gs->begin(); kv != gs->end(); ++kv) {
             datums_t *lst1 = &groups[kv->first];
             datums_t *lst2 = &kv->second;
+            for (auto it = lst2->begin(); it != lst2->end(); ++it) {
+                charge.add(*it);
+            }
             lst1->reserve(lst1->size() + lst2->size());
             std::move(lst2->begin(), lst2->end(), std::back_inserter(*lst1));
         }
@@ -186,6 +196,7 @@ private:
             stream_t *stream = &kv->second;
             lst->reserve(lst->size() + stream->size());
             for (auto it = stream->begin(); it != stream->end(); ++it) {
+                charge.add(it->data);
                 lst->push_back(std::move(it->data));
             }
         }
@@ -210,10 +221,12 @@ private:
     }
 
     groups_t groups;
+    // Charges the query for `groups` while they're being built.
+    memory_charge_t charge;
 };
 
-eager_acc_t *make_to_array() {
-    return new to_array_t();
+eager_acc_t *make_to_array(env_t *env) {
+    return new to_array_t(env);
 }
 
 template<class T>
@@ -259,20 +272,50 @@ private:
 
     virtual void add_res(result_t *res) {
         grouped_t<T> *acc = grouped_accumulator_t<T>::get_acc();
-        const T *default_val = grouped_accumulator_t<T>::get_default_val();
         if (auto e = boost::get<exc_t>(res)) {
             throw *e;
         }
         grouped_t<T> *gres = boost::get<grouped_t<T> >(res);
         r_sanity_check(gres);
-        if (acc->size() == 0) {
-            acc->swap(*gres);
-        } else {
-            for (auto kv = gres->begin(); kv != gres->end(); ++kv) {
-                auto t_it = acc->insert(std::make_pair(kv->first, *default_val)).first;
-                unshard_impl(&t_it->second, &kv->second);
+        merge_groups(gres, acc);
+    }
+
+    // Unlike `append_t`, terminals combine partial results pairwise, so the shards'
+    // results are folded in one at a time rather than collected per group first.
+    virtual void unshard(const store_key_t &,
+                         const std::vector<result_t *> &results) {
+        grouped_t<T> *acc = grouped_accumulator_t<T>::get_acc();
+        guarantee(acc->size() == 0);
+        for (auto res = results.begin(); res != results.end(); ++res) {
+            guarantee(*res);
+            grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
+            guarantee(gres);
+            merge_groups(gres, acc);
+        }
+    }
+
+    // Folds `from` into `into` and leaves `from` empty.  The bigger of the two maps
+    // is kept, and since both are sorted by group they're walked side by side, so
+    // with many groups this costs about one step per group rather than a lookup
+    // and a copy of the default value.  A group only `from` has is moved over as it
+    // is, which is what `unshard_impl` would make of it.
+    void merge_groups(grouped_t<T> *from, grouped_t<T> *into) {
+        if (into->size() < from->size()) {
+            into->swap(*from);
+        }
+        std::map<counted_t<const datum_t>, T> *m = into->get_underlying_map();
+        auto it = m->begin();
+        for (auto kv = from->begin(); kv != from->end(); ++kv) {
+            while (it != m->end() && it->first < kv->first) {
+                ++it;
+            }
+            if (it != m->end() && !(kv->first < it->first)) {
+                unshard_impl(&it->second, &kv->second);
+            } else {
+                it = m->insert(it, std::make_pair(kv->first, std::move(kv->second)));
             }
         }
+        from->clear();
     }
 
     virtual void accumulate(
@@ -429,6 +472,143 @@ private:
     counted_t<func_t> f;
 };
 
+// Keeps the first `k` elements seen as a heap, so each shard only sends `k` rows.
+// The elements are stored as `[keys, row]`, with each of the keys wrapped in an
+// array that's empty if the key function hit a non-existence error.  That way the
+// key functions run once per row rather than once per comparison.
+class top_k_terminal_t : public terminal_t<datums_t> {
+public:
+    top_k_terminal_t(env_t *_env, const top_k_wire_func_t &f)
+        : terminal_t<datums_t>(datums_t()), env(_env), k(f.k) {
+        r_sanity_check(!f.comparisons.empty());
+        for (auto it = f.comparisons.begin(); it != f.comparisons.end(); ++it) {
+            key_funcs.push_back(it->first.compile_wire_func());
+            descending.push_back(it->second);
+        }
+    }
+private:
+    virtual void accumulate(const counted_t<const datum_t> &el, datums_t *heap) {
+        try {
+            std::vector<counted_t<const datum_t> > keys;
+            keys.reserve(key_funcs.size());
+            for (auto it = key_funcs.begin(); it != key_funcs.end(); ++it) {
+                std::vector<counted_t<const datum_t> > key;
+                try {
+                    key.push_back((*it)->call(env, el)->as_datum());
+                } catch (const base_exc_t &e) {
+                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                        throw;
+                    }
+                }
+                keys.push_back(make_counted<const datum_t>(std::move(key)));
+            }
+            push(make_counted<const datum_t>(
+                     std::vector<counted_t<const datum_t> >{
+                         make_counted<const datum_t>(std::move(keys)), el}),
+                 heap);
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, key_funcs[0]->backtrace().get(), 1);
+        }
+    }
+
+    // The same order as `orderby_term_t`'s `lt_cmp_t`.
+    bool lt(const counted_t<const datum_t> &l, const counted_t<const datum_t> &r) const {
+        const counted_t<const datum_t> &lkeys = l->get(0), &rkeys = r->get(0);
+        for (size_t i = 0; i < descending.size(); ++i) {
+            counted_t<const datum_t> lval = lkeys->get(i)->get(0, NOTHROW);
+            counted_t<const datum_t> rval = rkeys->get(i)->get(0, NOTHROW);
+            if (!lval.has() && !rval.has()) {
+                continue;
+            }
+            if (!lval.has()) {
+                return !descending[i];
+            }
+            if (!rval.has()) {
+                return descending[i];
+            }
+            if (*lval == *rval) {
+                continue;
+            }
+            return (*lval < *rval) != descending[i];
+        }
+        return false;
+    }
+
+    // `heap` is a max-heap, so the element we'd drop next is at the front.
+    void push(counted_t<const datum_t> &&item, datums_t *heap) {
+        auto cmp = std::bind(&top_k_terminal_t::lt, this, ph::_1, ph::_2);
+        if (heap->size() < k) {
+            heap->push_back(std::move(item));
+            std::push_heap(heap->begin(), heap->end(), cmp);
+        } else if (k != 0 && lt(item, heap->front())) {
+            std::pop_heap(heap->begin(), heap->end(), cmp);
+            heap->back() = std::move(item);
+            std::push_heap(heap->begin(), heap->end(), cmp);
+        }
+    }
+
+    virtual counted_t<const datum_t> unpack(datums_t *heap) {
+        std::sort_heap(heap->begin(), heap->end(),
+                       std::bind(&top_k_terminal_t::lt, this, ph::_1, ph::_2));
+        std::vector<counted_t<const datum_t> > rows;
+        rows.reserve(heap->size());
+        for (auto it = heap->begin(); it != heap->end(); ++it) {
+            rows.push_back((*it)->get(1));
+        }
+        return make_counted<const datum_t>(std::move(rows));
+    }
+    virtual void unshard_impl(datums_t *out, datums_t *heap) {
+        for (auto it = heap->begin(); it != heap->end(); ++it) {
+            push(std::move(*it), out);
+        }
+    }
+
+    env_t *env;
+    const uint64_t k;
+    std::vector<counted_t<func_t> > key_funcs;
+    std::vector<bool> descending;
+};
+
+class count_distinct_terminal_t : public terminal_t<hyperloglog_t> {
+public:
+    count_distinct_terminal_t(env_t *, const count_distinct_wire_func_t &)
+        : terminal_t<hyperloglog_t>(hyperloglog_t()) { }
+private:
+    virtual void accumulate(const counted_t<const datum_t> &el, hyperloglog_t *out) {
+        out->add(el);
+    }
+    virtual counted_t<const datum_t> unpack(hyperloglog_t *h) {
+        return make_counted<const datum_t>(static_cast<double>(h->estimate()));
+    }
+    virtual void unshard_impl(hyperloglog_t *out, hyperloglog_t *el) {
+        out->merge(*el);
+    }
+};
+
+class quantile_terminal_t : public terminal_t<tdigest_t> {
+public:
+    quantile_terminal_t(env_t *, const quantile_wire_func_t &f)
+        : terminal_t<tdigest_t>(tdigest_t()), q(f.q), bt(f.get_bt()) { }
+private:
+    virtual void accumulate(const counted_t<const datum_t> &el, tdigest_t *out) {
+        try {
+            out->add(el->as_num());
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, bt.get());
+        }
+    }
+    virtual counted_t<const datum_t> unpack(tdigest_t *t) {
+        rcheck_datum(!t->empty(), base_exc_t::NON_EXISTENCE,
+                     "Cannot take a quantile of an empty stream.");
+        return make_counted<const datum_t>(t->quantile(q));
+    }
+    virtual void unshard_impl(tdigest_t *out, tdigest_t *el) {
+        out->merge(*el);
+    }
+    const double q;
+    protob_t<const Backtrace> bt;
+};
+
 template<class T>
 class terminal_visitor_t : public boost::static_visitor<T *> {
 public:
@@ -451,6 +631,15 @@ public:
     T *operator()(const reduce_wire_func_t &f) const {
         return new reduce_terminal_t(env, f);
     }
+    T *operator()(const top_k_wire_func_t &f) const {
+        return new top_k_terminal_t(env, f);
+    }
+    T *operator()(const count_distinct_wire_func_t &f) const {
+        return new count_distinct_terminal_t(env, f);
+    }
+    T *operator()(const quantile_wire_func_t &f) const {
+        return new quantile_terminal_t(env, f);
+    }
     env_t *env;
 };
 
@@ -531,9 +720,7 @@ public:
 private:
     virtual void lst_transform(datums_t *lst) {
         try {
-            for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
-            }
+            f->call_on_each(env, lst);
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
         }
@@ -549,14 +736,26 @@ public:
           f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<func_t>()) { }
+                      : counted_t<func_t>()),
+          predicate(compile_batch_predicate(f)) { }
 private:
     virtual void lst_transform(datums_t *lst) {
+        // The compiled predicate decides most rows of the batch at once; the rest
+        // go through the interpreter.
+        std::vector<batch_predicate_t::result_t> results;
+        if (predicate.has()) {
+            predicate->evaluate(*lst, &results);
+        }
         auto it = lst->begin();
         auto loc = it;
         try {
             for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
+                const batch_predicate_t::result_t result = predicate.has()
+                    ? results[it - lst->begin()]
+                    : batch_predicate_t::UNKNOWN;
+                if (result == batch_predicate_t::PASS
+                    || (result == batch_predicate_t::UNKNOWN
+                        && f->filter_call(env, *it, default_val))) {
                     loc->swap(*it);
                     ++loc;
                 }
@@ -568,6 +767,8 @@ private:
     }
     env_t *env;
     counted_t<func_t> f, default_val;
+    // Empty if `f` is too complicated to compile.
+    scoped_ptr_t<batch_predicate_t> predicate;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
@@ -599,6 +800,30 @@ private:
     counted_t<func_t> f;
 };
 
+// The shards run transformations on one row at a time, so this remembers the rows
+// it has let through for as long as it lives (one batch of a shard's read).  It's
+// only there to save sending duplicates, so it forgets them rather than growing
+// past `array_size_limit()`.
+class distinct_trans_t : public ungrouped_op_t {
+public:
+    distinct_trans_t() { }
+private:
+    virtual void lst_transform(datums_t *lst) {
+        auto loc = lst->begin();
+        for (auto it = lst->begin(); it != lst->end(); ++it) {
+            if (seen.size() >= array_size_limit()) {
+                seen.clear();
+            }
+            if (seen.insert(*it).second) {
+                loc->swap(*it);
+                ++loc;
+            }
+        }
+        lst->erase(loc, lst->end());
+    }
+    std::unordered_set<counted_t<const datum_t>, datum_hash_t, datum_equal_t> seen;
+};
+
 class transform_visitor_t : public boost::static_visitor<op_t *> {
 public:
     transform_visitor_t(env_t *_env) : env(_env) { }
@@ -614,6 +839,9 @@ public:
     op_t *operator()(const concatmap_wire_func_t &f) const {
         return new concatmap_trans_t(env, f);
     }
+    op_t *operator()(const distinct_wire_func_t &) const {
+        return new distinct_trans_t();
+    }
 private:
     env_t *env;
 };
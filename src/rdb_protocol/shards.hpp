@@ -11,6 +11,7 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/rdb_protocol_json.hpp"
+#include "rdb_protocol/sketches.hpp"
 #include "rdb_protocol/wire_func.hpp"
 
 namespace ql {
@@ -67,6 +68,12 @@ static inline void serialize_grouped(write_message_t *msg, const stream_t &sz) {
 static inline void serialize_grouped(write_message_t *msg, const datums_t &ds) {
     *msg << ds;
 }
+static inline void serialize_grouped(write_message_t *msg, const hyperloglog_t &h) {
+    *msg << h;
+}
+static inline void serialize_grouped(write_message_t *msg, const tdigest_t &t) {
+    *msg << t;
+}
 
 static inline archive_result_t deserialize_grouped(
     read_stream_t *s, counted_t<const datum_t> *d) {
@@ -92,6 +99,12 @@ static inline archive_result_t deserialize_grouped(read_stream_t *s, stream_t *s
 static inline archive_result_t deserialize_grouped(read_stream_t *s, datums_t *ds) {
     return deserialize(s, ds);
 }
+static inline archive_result_t deserialize_grouped(read_stream_t *s, hyperloglog_t *h) {
+    return deserialize(s, h);
+}
+static inline archive_result_t deserialize_grouped(read_stream_t *s, tdigest_t *t) {
+    return deserialize(s, t);
+}
 
 // This is basically a templated typedef with special serialization.
 template<class T>
@@ -155,13 +168,17 @@ typedef boost::variant<
     grouped_t<std::pair<double, uint64_t> >, // Avg.
     grouped_t<counted_t<const ql::datum_t> >, // Reduce (may be NULL), min, max.
     grouped_t<stream_t>, // No terminal.,
+    grouped_t<datums_t>, // Top k.
+    grouped_t<hyperloglog_t>, // Approximate count distinct.
+    grouped_t<tdigest_t>, // Approximate quantile.
     exc_t // Don't re-order (we don't want this to initialize to an error.)
     > result_t;
 
 typedef boost::variant<map_wire_func_t,
                        group_wire_func_t,
                        filter_wire_func_t,
-                       concatmap_wire_func_t
+                       concatmap_wire_func_t,
+                       distinct_wire_func_t
                        > transform_variant_t;
 
 typedef boost::variant<count_wire_func_t,
@@ -169,7 +186,10 @@ typedef boost::variant<count_wire_func_t,
                        avg_wire_func_t,
                        min_wire_func_t,
                        max_wire_func_t,
-                       reduce_wire_func_t
+                       reduce_wire_func_t,
+                       top_k_wire_func_t,
+                       count_distinct_wire_func_t,
+                       quantile_wire_func_t
                        > terminal_variant_t;
 
 class op_t {
@@ -217,7 +237,7 @@ accumulator_t *make_append(const sorting_t &sorting, batcher_t *batcher);
 accumulator_t *make_terminal(
     ql::env_t *env, const terminal_variant_t &t);
 
-eager_acc_t *make_to_array();
+eager_acc_t *make_to_array(env_t *env);
 eager_acc_t *make_eager_terminal(
     ql::env_t *env, const terminal_variant_t &t);
 
@@ -0,0 +1,201 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/sketches.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+// 2^12 registers.
+static const int HYPERLOGLOG_PRECISION = 12;
+static const size_t HYPERLOGLOG_REGISTERS = 1 << HYPERLOGLOG_PRECISION;
+
+// Roughly how many centroids a compressed digest keeps.
+static const double TDIGEST_COMPRESSION = 100;
+// How many centroids may pile up before the digest is compressed again.
+static const size_t TDIGEST_BUFFER_SIZE = 500;
+
+// FNV-1a followed by the splitmix64 finalizer, so that every bit of the result
+// depends on every byte of the input.  HyperLogLog relies on that.
+static uint64_t hash_bytes(const std::string &s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < s.size(); ++i) {
+        h ^= static_cast<uint8_t>(s[i]);
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+void hyperloglog_t::add(const counted_t<const datum_t> &value) {
+    // `print` is canonical: objects print their keys in order, and equal numbers
+    // print the same way.
+    add_hash(hash_bytes(value->print()));
+}
+
+void hyperloglog_t::add_hash(uint64_t hash) {
+    if (registers.empty()) {
+        registers.resize(HYPERLOGLOG_REGISTERS, 0);
+    }
+    size_t index = hash >> (64 - HYPERLOGLOG_PRECISION);
+    uint64_t rest = hash << HYPERLOGLOG_PRECISION;
+    uint8_t rank = rest == 0
+        ? 64 - HYPERLOGLOG_PRECISION + 1
+        : __builtin_clzll(rest) + 1;
+    registers[index] = std::max(registers[index], rank);
+}
+
+void hyperloglog_t::merge(const hyperloglog_t &other) {
+    if (other.registers.empty()) {
+        return;
+    }
+    if (registers.empty()) {
+        registers = other.registers;
+        return;
+    }
+    guarantee(registers.size() == other.registers.size());
+    for (size_t i = 0; i < registers.size(); ++i) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+uint64_t hyperloglog_t::estimate() const {
+    if (registers.empty()) {
+        return 0;
+    }
+    const double m = registers.size();
+    double sum = 0;
+    size_t zeroes = 0;
+    for (auto it = registers.begin(); it != registers.end(); ++it) {
+        sum += ldexp(1.0, -static_cast<int>(*it));
+        if (*it == 0) {
+            ++zeroes;
+        }
+    }
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    // With few values most registers are still empty, and counting those is the
+    // better estimate.  The hashes are 64 bits wide, so there's no correction for
+    // collisions at the other end.
+    if (estimate <= 2.5 * m && zeroes != 0) {
+        estimate = m * log(m / zeroes);
+    }
+    return static_cast<uint64_t>(estimate + 0.5);
+}
+
+RDB_IMPL_ME_SERIALIZABLE_1(hyperloglog_t, registers);
+
+void tdigest_t::add(double value) {
+    if (empty()) {
+        min = max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    centroids.push_back(std::make_pair(value, 1.0));
+    total_weight += 1;
+    if (centroids.size() > TDIGEST_BUFFER_SIZE) {
+        compress();
+    }
+}
+
+void tdigest_t::merge(const tdigest_t &other) {
+    if (other.empty()) {
+        return;
+    }
+    if (empty()) {
+        min = other.min;
+        max = other.max;
+    } else {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    centroids.insert(centroids.end(), other.centroids.begin(), other.centroids.end());
+    total_weight += other.total_weight;
+    if (centroids.size() > TDIGEST_BUFFER_SIZE) {
+        compress();
+    }
+}
+
+// The k_1 scale function from the paper and its inverse.  A centroid may cover at
+// most one unit of k, and k changes fastest near q = 0 and q = 1.
+static double scale(double q) {
+    return TDIGEST_COMPRESSION / (2 * M_PI) * asin(2 * q - 1);
+}
+static double inverse_scale(double k) {
+    return (sin(std::min(k * 2 * M_PI / TDIGEST_COMPRESSION, M_PI / 2)) + 1) / 2;
+}
+
+void tdigest_t::compress() {
+    if (centroids.empty()) {
+        return;
+    }
+    std::sort(centroids.begin(), centroids.end());
+    std::vector<std::pair<double, double> > merged;
+    merged.push_back(centroids[0]);
+    double weight_before = 0;
+    double q_limit = inverse_scale(scale(0) + 1);
+    for (size_t i = 1; i < centroids.size(); ++i) {
+        std::pair<double, double> *last = &merged.back();
+        double q = (weight_before + last->second + centroids[i].second) / total_weight;
+        if (q <= q_limit) {
+            last->second += centroids[i].second;
+            last->first += (centroids[i].first - last->first)
+                * centroids[i].second / last->second;
+        } else {
+            weight_before += last->second;
+            q_limit = inverse_scale(scale(weight_before / total_weight) + 1);
+            merged.push_back(centroids[i]);
+        }
+    }
+    centroids.swap(merged);
+}
+
+double tdigest_t::quantile(double q) {
+    guarantee(!empty());
+    guarantee(q >= 0 && q <= 1);
+    compress();
+
+    // Each centroid's weight is taken to be centered on its mean, and we
+    // interpolate between neighbouring centers, or towards `min` and `max` past
+    // the first and last one.
+    const double target = q * total_weight;
+    double weight_before = 0;
+    double result;
+    if (target <= centroids.front().second / 2) {
+        double center = centroids.front().second / 2;
+        result = min + (centroids.front().first - min) * target / center;
+    } else {
+        result = centroids.back().first;
+        for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+            double center = weight_before + centroids[i].second / 2;
+            double next_center = weight_before + centroids[i].second
+                + centroids[i + 1].second / 2;
+            if (target <= next_center) {
+                result = centroids[i].first
+                    + (centroids[i + 1].first - centroids[i].first)
+                    * (target - center) / (next_center - center);
+                break;
+            }
+            weight_before += centroids[i].second;
+        }
+        double last_center = total_weight - centroids.back().second / 2;
+        if (target > last_center) {
+            result = centroids.back().first + (max - centroids.back().first)
+                * (target - last_center) / (centroids.back().second / 2);
+        }
+    }
+    return std::max(min, std::min(max, result));
+}
+
+RDB_IMPL_ME_SERIALIZABLE_4(tdigest_t, centroids, total_weight, min, max);
+
+}  // namespace ql
@@ -0,0 +1,74 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SKETCHES_HPP_
+#define RDB_PROTOCOL_SKETCHES_HPP_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "containers/archive/stl_types.hpp"
+#include "containers/counted.hpp"
+#include "rpc/serialize_macros.hpp"
+
+namespace ql {
+
+class datum_t;
+
+/* A HyperLogLog sketch of the distinct values in a sequence.  Every value is hashed,
+the first `HYPERLOGLOG_PRECISION` bits of the hash pick a register, and the register
+remembers the longest run of leading zeroes seen in the rest of the hash.  The
+registers take a fixed 4KB however many values there are, and the estimate is off by
+about 1.6% on average.  Two sketches merge by taking the maximum of each register,
+so shards can each build one and the results are combined afterwards. */
+class hyperloglog_t {
+public:
+    hyperloglog_t() { }
+
+    void add(const counted_t<const datum_t> &value);
+    void merge(const hyperloglog_t &other);
+    uint64_t estimate() const;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+
+private:
+    void add_hash(uint64_t hash);
+
+    // Empty until the first value is added, which counts as all zeroes, so the
+    // empty sketch a terminal starts each group from is cheap to copy.
+    std::vector<uint8_t> registers;
+};
+
+/* A merging t-digest (Dunning, "Computing extremely accurate quantiles using
+t-digests") summarizing the distribution of the numbers in a sequence.  Nearby
+values are folded into weighted centroids, and the scale function keeps the
+centroids near either end of the distribution small, so extreme quantiles stay
+accurate.  There are never more than a few hundred centroids.  Two digests merge by
+pooling their centroids and compressing the result. */
+class tdigest_t {
+public:
+    tdigest_t() : total_weight(0), min(0), max(0) { }
+
+    void add(double value);
+    void merge(const tdigest_t &other);
+
+    bool empty() const { return total_weight == 0; }
+    // `q` must be in [0, 1].  The digest may not be empty.
+    double quantile(double q);
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+
+private:
+    void compress();
+
+    // Pairs of (mean, weight).  Only sorted and within the size bound right after
+    // `compress`; values added since are appended as centroids of weight 1.
+    std::vector<std::pair<double, double> > centroids;
+    double total_weight;
+    // The centroids blur the extremes, so these are kept exactly.
+    double min, max;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_SKETCHES_HPP_
@@ -0,0 +1,146 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/slow_query_log.hpp"
+
+#include "logger.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_json.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "thread_local.hpp"
+
+TLS_with_init(int64_t, slow_query_sample_countdown, 0);
+
+slow_query_log_t::thresholds_t::thresholds_t()
+    : duration_ms(SLOW_QUERY_LOG_DURATION_THRESHOLD_MS),
+      rows_read(SLOW_QUERY_LOG_ROWS_READ_THRESHOLD),
+      sample_period(SLOW_QUERY_LOG_SAMPLE_PERIOD) { }
+
+slow_query_log_t::slow_query_log_t() { }
+
+slow_query_log_t &slow_query_log_t::get_global_log() {
+    // Singleton implementation as in `sampling_profiler_t`.
+    static slow_query_log_t log;
+    return log;
+}
+
+slow_query_log_t::thresholds_t slow_query_log_t::get_thresholds() {
+    spinlock_acq_t lock(&spinlock);
+    return thresholds;
+}
+
+void slow_query_log_t::set_thresholds(const thresholds_t &_thresholds) {
+    spinlock_acq_t lock(&spinlock);
+    thresholds = _thresholds;
+}
+
+bool slow_query_log_t::should_sample() {
+    int64_t sample_period = get_thresholds().sample_period;
+    if (sample_period <= 0) {
+        return false;
+    }
+    int64_t countdown = TLS_get_slow_query_sample_countdown() - 1;
+    if (countdown > 0 && countdown < sample_period) {
+        TLS_set_slow_query_sample_countdown(countdown);
+        return false;
+    }
+    TLS_set_slow_query_sample_countdown(sample_period);
+    return true;
+}
+
+static int64_t count_rows_returned(const Response &response) {
+    if (response.type() == Response::SUCCESS_ATOM && response.response_size() == 1
+        && response.response(0).type() == Datum::R_ARRAY) {
+        return response.response(0).r_array_size();
+    }
+    return response.response_size();
+}
+
+void slow_query_log_t::on_query_done(const Query &query, const Response &response,
+                                     ticks_t duration, bool sampled) {
+    entry_t entry;
+    entry.duration_ms = safe_to_double(duration) / MILLION;
+    entry.rows_read = -1;
+    if (sampled && response.has_profile()) {
+        try {
+            ql::datum_t profile(&response.profile());
+            // The counters of a task include those of its sub-tasks, so the top
+            // level tasks add up to the whole query.
+            entry.rows_read = 0;
+            for (size_t i = 0; i < profile.size(); ++i) {
+                counted_t<const ql::datum_t> rows_read
+                    = profile.get(i)->get("rows_read", ql::NOTHROW);
+                if (rows_read.has()) {
+                    entry.rows_read += rows_read->as_int();
+                }
+            }
+            ql::write_json(profile, &entry.profile_json);
+        } catch (const ql::base_exc_t &) {
+            entry.rows_read = -1;
+            entry.profile_json.clear();
+        }
+    }
+
+    thresholds_t current_thresholds = get_thresholds();
+    if (entry.duration_ms < current_thresholds.duration_ms
+        && entry.rows_read < current_thresholds.rows_read) {
+        return;
+    }
+
+    entry.time = clock_realtime();
+    entry.shape = query_shape(query.query());
+    entry.rows_returned = count_rows_returned(response);
+    if (entry.rows_read >= 0) {
+        logINF("Slow query (%.3f ms, %" PRIi64 " rows read, %" PRIi64 " rows "
+               "returned): %s\n", entry.duration_ms, entry.rows_read,
+               entry.rows_returned, entry.shape.c_str());
+    } else {
+        logINF("Slow query (%.3f ms, %" PRIi64 " rows returned): %s\n",
+               entry.duration_ms, entry.rows_returned, entry.shape.c_str());
+    }
+
+    spinlock_acq_t lock(&spinlock);
+    entries.push_back(std::move(entry));
+    if (entries.size() > SLOW_QUERY_LOG_SIZE) {
+        entries.pop_front();
+    }
+}
+
+std::deque<slow_query_log_t::entry_t> slow_query_log_t::get_entries() {
+    spinlock_acq_t lock(&spinlock);
+    return entries;
+}
+
+void slow_query_log_t::reset() {
+    spinlock_acq_t lock(&spinlock);
+    entries.clear();
+}
+
+static void append_query_shape(const Term &term, std::string *out) {
+    if (term.type() == Term::DATUM) {
+        out->push_back('?');
+        return;
+    }
+    out->append(Term::TermType_Name(term.type()));
+    out->push_back('(');
+    for (int i = 0; i < term.args_size(); ++i) {
+        if (i != 0) {
+            out->append(", ");
+        }
+        append_query_shape(term.args(i), out);
+    }
+    for (int i = 0; i < term.optargs_size(); ++i) {
+        if (i != 0 || term.args_size() != 0) {
+            out->append(", ");
+        }
+        out->append(term.optargs(i).key());
+        out->push_back('=');
+        append_query_shape(term.optargs(i).val(), out);
+    }
+    out->push_back(')');
+}
+
+std::string query_shape(const Term &term) {
+    std::string res;
+    append_query_shape(term, &res);
+    return res;
+}
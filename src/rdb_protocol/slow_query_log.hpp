@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
+#define RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
+
+#include <time.h>
+
+#include <deque>
+#include <string>
+
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+class Query;
+class Response;
+class Term;
+
+/*
+ * The `slow_query_log_t` keeps the last `SLOW_QUERY_LOG_SIZE` queries that took
+ * longer than the duration threshold or read more rows than the rows threshold,
+ * and also writes them to the server log.  It's served by
+ * `slow_query_log_http_app_t`.
+ *
+ * The rows a query read are only known when the query is profiled, so one in every
+ * `sample_period` queries on each thread is profiled on the server's behalf; the
+ * log keeps the profile of those that turn out to be slow, and the profile is left
+ * out of their responses.  Queries the client profiles count as sampled too.  Only
+ * the time until a query's first response is measured.
+ */
+class slow_query_log_t {
+public:
+    struct thresholds_t {
+        thresholds_t();
+        int64_t duration_ms;
+        int64_t rows_read;
+        int64_t sample_period;
+    };
+
+    struct entry_t {
+        struct timespec time;
+        // The query with its data left out, e.g. `FILTER(TABLE(DB(?), ?), FUNC(...))`.
+        std::string shape;
+        double duration_ms;
+        int64_t rows_returned;
+        // These are -1 and empty if the query wasn't sampled.
+        int64_t rows_read;
+        std::string profile_json;
+    };
+
+    slow_query_log_t();
+
+    static slow_query_log_t &get_global_log();
+
+    thresholds_t get_thresholds();
+    void set_thresholds(const thresholds_t &thresholds);
+
+    /* Returns true if the query that's about to start on this thread should be
+    sampled. */
+    bool should_sample();
+
+    /* Records `query` if it was slow.  `response` is the first response to it, and
+    `duration` how long that took. */
+    void on_query_done(const Query &query, const Response &response,
+                       ticks_t duration, bool sampled);
+
+    std::deque<entry_t> get_entries();
+    void reset();
+
+private:
+    spinlock_t spinlock;
+    thresholds_t thresholds;
+    std::deque<entry_t> entries;
+
+    DISABLE_COPYING(slow_query_log_t);
+};
+
+/* Prints `term` with every literal datum replaced by `?`, so that queries that
+only differ in their data have the same shape. */
+std::string query_shape(const Term &term);
+
+#endif  // RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
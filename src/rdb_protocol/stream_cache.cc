@@ -1,10 +1,33 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream_cache.hpp"
 
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/wait_any.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "containers/uuid.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rdb_protocol/env.hpp"
+#include "thread_local.hpp"
 
 namespace ql {
 
+// What the read-ahead batches of the cursors on this thread take up in memory,
+// and the entries holding them, most recently read first.  The list is allocated
+// while it isn't empty.
+TLS_with_init(int64_t, cursor_memory, 0);
+TLS_with_init(intrusive_list_t<stream_cache2_t::entry_t> *, spillable_entries, NULL);
+
+static perfmon_collection_t pm_cursors;
+static perfmon_membership_t pm_cursors_membership(&get_global_perfmon_collection(),
+                                                  &pm_cursors, "cursors");
+static perfmon_counter_t pm_cursors_open, pm_cursor_memory, pm_cursor_batches_spilled;
+static perfmon_multi_membership_t pm_cursor_stats_membership(&pm_cursors,
+    &pm_cursors_open, "open",
+    &pm_cursor_memory, "memory_bytes",
+    &pm_cursor_batches_spilled, "batches_spilled");
+
+stream_cache2_t::stream_cache2_t() : prefetch_budget_left(CURSOR_PREFETCH_BUDGET) { }
+
 bool stream_cache2_t::contains(int64_t key) {
     return streams.find(key) != streams.end();
 }
@@ -14,52 +37,221 @@ void stream_cache2_t::insert(int64_t key,
                              scoped_ptr_t<env_t> &&val_env,
                              counted_t<datum_stream_t> val_stream) {
     maybe_evict();
-    std::pair<boost::ptr_map<int64_t, entry_t>::iterator, bool> res = streams.insert(
-        key, new entry_t(time(0), use_json, std::move(val_env), val_stream));
+    auto res = streams.insert(std::make_pair(
+        key, make_scoped<entry_t>(time(0), use_json, std::move(val_env), val_stream)));
     guarantee(res.second);
 }
 
 void stream_cache2_t::erase(int64_t key) {
-    size_t num_erased = streams.erase(key);
-    guarantee(num_erased == 1);
+    auto it = streams.find(key);
+    guarantee(it != streams.end());
+    prefetch_budget_left += it->second->prefetch_reserved;
+    // This waits for a prefetch or spill that's still running.
+    streams.erase(it);
 }
 
 bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor) {
-    boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
+    auto it = streams.find(key);
     if (it == streams.end()) return false;
-    entry_t *entry = it->second;
+    entry_t *entry = it->second.get();
+    // Queries with the same token don't run at the same time.
+    guarantee(!entry->serving);
+    entry->serving = true;
     entry->last_activity = time(0);
+    microtime_t start = current_microtime();
+    // Erasing the entry may have to wait for a prefetch, which we can't do in a
+    // `catch` block.
+    std::exception_ptr error;
     try {
-        // Reset the env_t's interruptor to a good one before we use it.  This may be a
-        // hack.  (I'd rather not have env_t be mutable this way -- could we construct
-        // a new env_t instead?  Why do we keep env_t's around anymore?)
-        entry->env->interruptor = interruptor;
+        std::vector<counted_t<const datum_t> > ds;
+        microtime_t serve_time;
+        if (entry->prefetch_done.has()) {
+            wait_interruptible(entry->prefetch_done.get(), interruptor);
+            entry->env->interruptor = interruptor;
+            entry->prefetch_done.reset();
+            prefetch_budget_left += entry->prefetch_reserved;
+            entry->prefetch_reserved = 0;
+            entry->unlink();
+            entry->set_memory(0);
+            if (entry->prefetch_error) {
+                std::exception_ptr prefetch_error = entry->prefetch_error;
+                entry->prefetch_error = std::exception_ptr();
+                std::rethrow_exception(prefetch_error);
+            }
+            ds.swap(entry->prefetched);
+            if (entry->spilled.has()) {
+                while (!entry->spilled->empty()) {
+                    counted_t<const datum_t> d;
+                    entry->spilled->pop(&d);
+                    ds.push_back(d);
+                }
+                entry->spilled.reset();
+            }
+            serve_time = entry->prefetch_time;
+        } else {
+            // Reset the env_t's interruptor to a good one before we use it.  This
+            // may be a hack.  (I'd rather not have env_t be mutable this way --
+            // could we construct a new env_t instead?  Why do we keep env_t's
+            // around anymore?)
+            entry->env->interruptor = interruptor;
 
-        std::vector<counted_t<const datum_t> > ds
-            = entry->stream->next_batch(
+            microtime_t read_start = current_microtime();
+            ds = entry->stream->next_batch(
                 entry->env.get(),
-                batchspec_t::user(batch_type_t::NORMAL, entry->env.get()));
+                batchspec_t::user(batch_type_t::NORMAL, entry->env.get(),
+                                  entry->max_batch_size));
+            serve_time = current_microtime() - read_start;
+        }
+        int64_t batch_size = 0;
         for (auto d = ds.begin(); d != ds.end(); ++d) {
+            batch_size += serialized_size(*d);
             (*d)->write_to_protobuf(res->add_response(), entry->use_json);
         }
+        entry->adapt_batch_size(start - entry->last_served, serve_time, batch_size);
         if (entry->env->trace.has()) {
             entry->env->trace->as_datum()->write_to_protobuf(
                 res->mutable_profile(), entry->use_json);
         }
-    } catch (const std::exception &e) {
+    } catch (const std::exception &) {
+        error = std::current_exception();
+    }
+    entry->serving = false;
+    if (error) {
         erase(key);
-        throw;
+        std::rethrow_exception(error);
     }
     if (entry->stream->is_exhausted() || res->response_size() == 0) {
         erase(key);
         res->set_type(Response::SUCCESS_SEQUENCE);
     } else {
         res->set_type(Response::SUCCESS_PARTIAL);
+        maybe_prefetch(entry);
     }
 
     return true;
 }
 
+void stream_cache2_t::maybe_prefetch(entry_t *entry) {
+    // Reading ahead would mix the next batch's events into this batch's profile.
+    if (entry->env->trace.has() || prefetch_budget_left < entry->max_batch_size
+        || !make_room(entry->max_batch_size)) {
+        return;
+    }
+    prefetch_budget_left -= entry->max_batch_size;
+    entry->prefetch_reserved = entry->max_batch_size;
+    // Until we know how big the batch is, it's charged for as much as it may be.
+    entry->set_memory(entry->max_batch_size);
+    entry->prefetch_done.init(new cond_t());
+    coro_t::spawn_sometime(std::bind(&entry_t::prefetch, entry,
+                                     auto_drainer_t::lock_t(entry->drainer.get())));
+}
+
+bool stream_cache2_t::make_room(int64_t bytes) {
+    const int64_t budget = CURSOR_MEMORY_BUDGET / get_num_threads();
+    intrusive_list_t<entry_t> *entries = TLS_get_spillable_entries();
+    entry_t *victim = entries != NULL ? entries->tail() : NULL;
+    while (TLS_get_cursor_memory() + bytes > budget && victim != NULL) {
+        // `unlink` may free `entries` along with the last entry in it.
+        entry_t *next_victim = entries->prev(victim);
+        // `serve` may be about to take the batch, or waiting for it to be noticed.
+        if (victim->env->spill_storage != NULL && !victim->serving) {
+            // The batch is written out in the background, but its memory is as
+            // good as freed.
+            victim->unlink();
+            victim->set_memory(0);
+            victim->prefetch_done.reset();
+            victim->prefetch_done.init(new cond_t());
+            coro_t::spawn_sometime(
+                std::bind(&entry_t::spill, victim,
+                          auto_drainer_t::lock_t(victim->drainer.get())));
+        }
+        victim = next_victim;
+    }
+    return TLS_get_cursor_memory() + bytes <= budget;
+}
+
+void stream_cache2_t::entry_t::prefetch(auto_drainer_t::lock_t keepalive) {
+    // The interruptor `serve` got may not outlive it (see `interruptor_mixer_t`), so
+    // we're only interrupted when the entry is erased.  The connection going away
+    // erases it.
+    env->interruptor = keepalive.get_drain_signal();
+    microtime_t start = current_microtime();
+    try {
+        prefetched = stream->next_batch(
+            env.get(),
+            batchspec_t::user(batch_type_t::NORMAL, env.get(), max_batch_size));
+    } catch (const std::exception &) {
+        // Passed on to whoever asks for the batch.  If the entry is being erased,
+        // nobody will.
+        prefetch_error = std::current_exception();
+    }
+    prefetch_time = current_microtime() - start;
+    int64_t bytes = 0;
+    for (auto d = prefetched.begin(); d != prefetched.end(); ++d) {
+        bytes += serialized_size(*d);
+    }
+    set_memory(bytes);
+    if (!prefetched.empty()) {
+        intrusive_list_t<entry_t> *entries = TLS_get_spillable_entries();
+        if (entries == NULL) {
+            entries = new intrusive_list_t<entry_t>();
+            TLS_set_spillable_entries(entries);
+        }
+        entries->push_front(this);
+    }
+    prefetch_done->pulse();
+}
+
+void stream_cache2_t::entry_t::spill(auto_drainer_t::lock_t) {
+    spilled.init(new disk_backed_queue_t<counted_t<const datum_t> >(
+        env->spill_storage->io_backender,
+        serializer_filepath_t(env->spill_storage->base_path,
+                              "cursor_" + uuid_to_str(generate_uuid())),
+        env->spill_storage->stats_parent));
+    for (auto d = prefetched.begin(); d != prefetched.end(); ++d) {
+        spilled->push(*d);
+    }
+    prefetched.clear();
+    ++pm_cursor_batches_spilled;
+    prefetch_done->pulse();
+}
+
+void stream_cache2_t::entry_t::set_memory(int64_t bytes) {
+    assert_thread();
+    TLS_set_cursor_memory(TLS_get_cursor_memory() + bytes - memory);
+    pm_cursor_memory += bytes - memory;
+    memory = bytes;
+}
+
+void stream_cache2_t::entry_t::unlink() {
+    assert_thread();
+    if (in_a_list()) {
+        intrusive_list_t<entry_t> *entries = TLS_get_spillable_entries();
+        entries->remove(this);
+        if (entries->empty()) {
+            delete entries;
+            TLS_set_spillable_entries(NULL);
+        }
+    }
+}
+
+void stream_cache2_t::entry_t::adapt_batch_size(microtime_t wait,
+                                                microtime_t serve_time,
+                                                int64_t batch_size) {
+    if (last_served != 0) {
+        // The batcher only stops on size once the cap is used up.
+        if (batch_size >= max_batch_size && wait <= serve_time) {
+            max_batch_size = std::min<int64_t>(max_batch_size * 2,
+                                               CURSOR_BATCH_MAX_SIZE);
+        } else if (wait > serve_time * CURSOR_SLOW_CLIENT_FACTOR
+                   && wait > CURSOR_SLOW_CLIENT_MIN_WAIT_MS * 1000) {
+            max_batch_size = std::max<int64_t>(max_batch_size / 2,
+                                               CURSOR_BATCH_MIN_SIZE);
+        }
+    }
+    last_served = current_microtime();
+}
+
 void stream_cache2_t::maybe_evict() {
     // We never evict right now.
 }
@@ -72,9 +264,23 @@ stream_cache2_t::entry_t::entry_t(time_t _last_activity,
       use_json(_use_json),
       env(std::move(env_ptr)),
       stream(_stream),
-      max_age(DEFAULT_MAX_AGE) { }
+      max_age(DEFAULT_MAX_AGE),
+      max_batch_size(batchspec_t::DEFAULT_MAX_SIZE),
+      last_served(0),
+      serving(false),
+      prefetch_time(0),
+      prefetch_reserved(0),
+      memory(0),
+      drainer(new auto_drainer_t()) {
+    ++pm_cursors_open;
+}
 
-stream_cache2_t::entry_t::~entry_t() { }
+stream_cache2_t::entry_t::~entry_t() {
+    drainer.reset();
+    unlink();
+    set_memory(0);
+    --pm_cursors_open;
+}
 
 
 } // namespace ql
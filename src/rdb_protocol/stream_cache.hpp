@@ -4,25 +4,48 @@
 
 #include <time.h>
 
-#include <map>
+#include <exception>
+#include <vector>
 
 #include "errors.hpp"
-#include <boost/ptr_container/ptr_map.hpp>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/signal.hpp"
+#include "containers/flat_map.hpp"
+#include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/ql2.pb.h"
 
+template <class T> class disk_backed_queue_t;
+
 namespace ql {
 class env_t;
 }
 
 namespace ql {
 
+/* Keeps the cursors of a connection between the batches the client asks for.
+
+The size cap of a cursor's batches adapts to the client. When the client asks for
+the next batch sooner than the last one took to produce, round trips are what
+holds it back, and full batches get twice as big. When the client takes much
+longer, it reads at its own pace, and the batches shrink so the server doesn't
+read far ahead of it. A `max_size` in the query's `batch_conf` takes precedence.
+
+After sending a batch, the next one is read in the background, so it's usually
+ready by the time the client asks for it. The batches read ahead for a connection
+may take up `CURSOR_PREFETCH_BUDGET` bytes between them; cursors that would exceed
+that read on demand.
+
+The read-ahead batches of all connections on a thread share that thread's part of
+`CURSOR_MEMORY_BUDGET`.  When a read-ahead doesn't fit, the batches that were read
+the longest time ago are spilled to disk (if the server has somewhere to spill
+to), and read back when their client asks for them. */
 class stream_cache2_t {
 public:
-    stream_cache2_t() { }
+    stream_cache2_t();
     MUST_USE bool contains(int64_t key);
     void insert(int64_t key,
                 use_json_t use_json,
@@ -30,26 +53,71 @@ public:
                 counted_t<datum_stream_t> val_stream);
     void erase(int64_t key);
     MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor);
-private:
-    void maybe_evict();
 
-    struct entry_t {
-        ~entry_t(); // `env_t` is incomplete
+    // Public so that the bookkeeping of the read-ahead batches on each thread can
+    // refer to it.
+    struct entry_t : public intrusive_list_node_t<entry_t>,
+                     public home_thread_mixin_debug_only_t {
+        ~entry_t();
         static const time_t DEFAULT_MAX_AGE = 0; // 0 = never evict
         entry_t(time_t _last_activity,
                 use_json_t use_json,
                 scoped_ptr_t<env_t> &&env_ptr,
                 counted_t<datum_stream_t> _stream);
+        // Adjusts `max_batch_size` after the client waited `wait` to ask for a
+        // batch of `batch_size` bytes that took `serve_time` to read, and notes
+        // that the batch is being sent.  `wait` is meaningless for the first
+        // batch.
+        void adapt_batch_size(microtime_t wait, microtime_t serve_time,
+                              int64_t batch_size);
+        void prefetch(auto_drainer_t::lock_t keepalive);
+        void spill(auto_drainer_t::lock_t keepalive);
+        // Charges `bytes` of buffered rows for this entry to the thread.
+        void set_memory(int64_t bytes);
+        // Takes the entry out of the thread's list of spillable batches.
+        void unlink();
+
         time_t last_activity;
         use_json_t use_json;
         scoped_ptr_t<env_t> env;
         counted_t<datum_stream_t> stream;
         time_t max_age;
+        int64_t max_batch_size;
+        // When the last batch was sent, or 0 before the first one.
+        microtime_t last_served;
+
+        // Whether `serve` is working with the entry, which keeps it from being
+        // spilled.
+        bool serving;
+        // Set while a batch is being read ahead or spilled, and pulsed once it's
+        // there.
+        scoped_ptr_t<cond_t> prefetch_done;
+        std::vector<counted_t<const datum_t> > prefetched;
+        // Where `prefetched` went if it was spilled.
+        scoped_ptr_t<disk_backed_queue_t<counted_t<const datum_t> > > spilled;
+        std::exception_ptr prefetch_error;
+        microtime_t prefetch_time;
+        // How much of the prefetch budget this entry holds.
+        int64_t prefetch_reserved;
+        // How much of the thread's cursor memory this entry is charged for.
+        int64_t memory;
+        // Reset first thing in the destructor, which interrupts a running prefetch
+        // and waits for it and for a running spill.
+        scoped_ptr_t<auto_drainer_t> drainer;
     private:
         DISABLE_COPYING(entry_t);
     };
 
-    boost::ptr_map<int64_t, entry_t> streams;
+private:
+    void maybe_evict();
+    void maybe_prefetch(entry_t *entry);
+    // Spills read-ahead batches on this thread until `bytes` more fit in its cursor
+    // memory.  Returns false if that's not possible.
+    static bool make_room(int64_t bytes);
+
+    // Tokens mostly increase, so new streams go at the end.
+    flat_map_t<int64_t, scoped_ptr_t<entry_t> > streams;
+    int64_t prefetch_budget_left;
     DISABLE_COPYING(stream_cache2_t);
 };
 
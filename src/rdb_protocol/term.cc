@@ -6,6 +6,7 @@
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/stream_cache.hpp"
+#include "rdb_protocol/term_cache.hpp"
 #include "rdb_protocol/term_walker.hpp"
 #include "rdb_protocol/validate.hpp"
 
@@ -73,6 +74,8 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::AVG:                return make_avg_term(env, t);
     case Term::MIN:                return make_min_term(env, t);
     case Term::MAX:                return make_max_term(env, t);
+    case Term::APPROX_COUNT_DISTINCT: return make_approx_count_distinct_term(env, t);
+    case Term::APPROX_QUANTILE:    return make_approx_quantile_term(env, t);
     case Term::UNION:              return make_union_term(env, t);
     case Term::NTH:                return make_nth_term(env, t);
     case Term::LIMIT:              return make_limit_term(env, t);
@@ -98,6 +101,7 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::TABLE_DROP:         return make_table_drop_term(env, t);
     case Term::TABLE_LIST:         return make_table_list_term(env, t);
     case Term::SYNC:               return make_sync_term(env, t);
+    case Term::CHANGES:            return make_changes_term(env, t);
     case Term::INDEX_CREATE:       return make_sindex_create_term(env, t);
     case Term::INDEX_DROP:         return make_sindex_drop_term(env, t);
     case Term::INDEX_LIST:         return make_sindex_list_term(env, t);
@@ -170,7 +174,8 @@ void run(protob_t<Query> q,
          rdb_protocol_t::context_t *ctx,
          signal_t *interruptor,
          Response *res,
-         stream_cache2_t *stream_cache2) {
+         stream_cache2_t *stream_cache2,
+         term_cache_t *term_cache) {
     try {
         validate_pb(*q);
     } catch (const base_exc_t &e) {
@@ -182,7 +187,9 @@ void run(protob_t<Query> q,
 #endif // INSTRUMENT
 
     int64_t token = q->token();
-    use_json_t use_json = q->accepts_r_json() ? use_json_t::YES : use_json_t::NO;
+    use_json_t use_json = q->accepts_r_packed() ? use_json_t::PACKED
+        : q->accepts_r_json() ? use_json_t::YES
+        : use_json_t::NO;
 
     switch (q->type()) {
     case Query_QueryType_START: {
@@ -194,19 +201,34 @@ void run(protob_t<Query> q,
                 ctx->cross_thread_database_watchables[th.threadnum]->get_watchable(),
                 ctx->cluster_metadata, ctx->directory_read_manager,
                 interruptor, ctx->machine_id, q));
+        env->spill_storage = ctx->spill_storage;
+        env->changefeed_client = ctx->changefeed_client;
 
+        // The key is taken after `env` preprocessed the query, so queries that
+        // call `r.now()` never match.
+        std::string cache_key;
+        bool cacheable = term_cache != NULL
+            && term_cache_t::compute_key(q->query(), &cache_key);
         counted_t<term_t> root_term;
-        try {
-            Term *t = q->mutable_query();
-            compile_env_t compile_env((var_visibility_t()));
-            root_term = compile_term(&compile_env, q.make_child(t));
-            // TODO: handle this properly
-        } catch (const exc_t &e) {
-            fill_error(res, Response::COMPILE_ERROR, e.what(), e.backtrace());
-            return;
-        } catch (const datum_exc_t &e) {
-            fill_error(res, Response::COMPILE_ERROR, e.what(), backtrace_t());
-            return;
+        if (cacheable) {
+            root_term = term_cache->find(cache_key);
+        }
+        if (!root_term.has()) {
+            try {
+                Term *t = q->mutable_query();
+                compile_env_t compile_env((var_visibility_t()));
+                root_term = compile_term(&compile_env, q.make_child(t));
+                // TODO: handle this properly
+            } catch (const exc_t &e) {
+                fill_error(res, Response::COMPILE_ERROR, e.what(), e.backtrace());
+                return;
+            } catch (const datum_exc_t &e) {
+                fill_error(res, Response::COMPILE_ERROR, e.what(), backtrace_t());
+                return;
+            }
+            if (cacheable) {
+                term_cache->insert(cache_key, root_term);
+            }
         }
 
         try {
@@ -305,9 +327,9 @@ void run(protob_t<Query> q,
         }
 
         // NOREPLY_WAIT is just a no-op.
-        // This works because we only evaluate one Query at a time
-        // on the connection level. Once we get to the NOREPLY_WAIT Query
-        // we know that all previous Queries have completed processing.
+        // This works because the connection only starts a NOREPLY_WAIT Query
+        // once every Query it received before has completed processing (see
+        // `waits_for_earlier_requests`).
 
         // Send back a WAIT_COMPLETE response.
         res->set_type(Response_ResponseType_WAIT_COMPLETE);
@@ -0,0 +1,124 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/term_cache.hpp"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/term.hpp"
+
+namespace ql {
+
+static bool renumber_var(Datum *d, std::map<double, double> *numbers) {
+    if (d->type() != Datum::R_NUM) {
+        return false;
+    }
+    auto it = numbers->insert(std::make_pair(d->r_num(), numbers->size())).first;
+    d->set_r_num(it->second);
+    return true;
+}
+
+// Renumbers the variables in `t` in order of first appearance.  Returns false if a
+// variable is declared twice or a function's variables aren't a literal array of
+// numbers, in which case the renumbering might not preserve what refers to what.
+static bool renumber_vars(Term *t, std::map<double, double> *numbers,
+                          std::set<double> *declared) {
+    if (t->type() == Term::FUNC && t->args_size() == 2) {
+        Term *vars = t->mutable_args(0);
+        std::vector<Datum *> datums;
+        if (vars->type() == Term::DATUM
+            && vars->datum().type() == Datum::R_ARRAY) {
+            for (int i = 0; i < vars->datum().r_array_size(); ++i) {
+                datums.push_back(vars->mutable_datum()->mutable_r_array(i));
+            }
+        } else if (vars->type() == Term::MAKE_ARRAY) {
+            for (int i = 0; i < vars->args_size(); ++i) {
+                if (vars->args(i).type() != Term::DATUM) {
+                    return false;
+                }
+                datums.push_back(vars->mutable_args(i)->mutable_datum());
+            }
+        } else {
+            return false;
+        }
+        for (auto it = datums.begin(); it != datums.end(); ++it) {
+            if (!declared->insert((*it)->r_num()).second
+                || !renumber_var(*it, numbers)) {
+                return false;
+            }
+        }
+        return renumber_vars(t->mutable_args(1), numbers, declared);
+    }
+    if (t->type() == Term::VAR) {
+        return t->args_size() == 1 && t->args(0).type() == Term::DATUM
+            && renumber_var(t->mutable_args(0)->mutable_datum(), numbers);
+    }
+    for (int i = 0; i < t->args_size(); ++i) {
+        if (!renumber_vars(t->mutable_args(i), numbers, declared)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t->optargs_size(); ++i) {
+        if (!renumber_vars(t->mutable_optargs(i)->mutable_val(), numbers, declared)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+term_cache_t::term_cache_t() : thread(get_thread_id()) { }
+
+term_cache_t::~term_cache_t() { }
+
+bool term_cache_t::compute_key(const Term &query, std::string *key_out) {
+    if (query.ByteSize() > QUERY_TERM_CACHE_MAX_QUERY_SIZE) {
+        return false;
+    }
+    Term renumbered = query;
+    std::map<double, double> numbers;
+    std::set<double> declared;
+    if (renumber_vars(&renumbered, &numbers, &declared)) {
+        *key_out = renumbered.SerializeAsString();
+    } else {
+        *key_out = query.SerializeAsString();
+    }
+    return true;
+}
+
+void term_cache_t::check_thread() {
+    if (!(get_thread_id() == thread)) {
+        lru.clear();
+        entries.clear();
+        thread = get_thread_id();
+    }
+}
+
+counted_t<term_t> term_cache_t::find(const std::string &key) {
+    check_thread();
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return counted_t<term_t>();
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+void term_cache_t::insert(const std::string &key, const counted_t<term_t> &term) {
+    check_thread();
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        lru.erase(it->second);
+        entries.erase(it);
+    }
+    lru.push_front(std::make_pair(key, term));
+    entries.insert(std::make_pair(key, lru.begin()));
+    if (lru.size() > QUERY_TERM_CACHE_SIZE) {
+        entries.erase(lru.back().first);
+        lru.pop_back();
+    }
+}
+
+}  // namespace ql
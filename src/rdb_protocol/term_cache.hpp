@@ -0,0 +1,57 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_TERM_CACHE_HPP_
+#define RDB_PROTOCOL_TERM_CACHE_HPP_
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "containers/counted.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+class Term;
+
+namespace ql {
+
+class term_t;
+
+/* `term_cache_t` keeps the compiled term trees of the queries a client connection
+ran most recently, so a query the client sends again isn't compiled again. Term
+trees hold values that may only be used on the thread they were created on, so a
+cache belongs to one connection and is dropped if the connection's queries start
+running on another thread.
+
+Queries are looked up by their preprocessed `Term`, with the variables renumbered
+in order of appearance because drivers number them afresh every time a query is
+built. Literals are part of the key: the compiled tree keeps pointing into the
+`Term` it came from, and sends pieces of it (function bodies, for instance) to the
+shards, so it can't be reused with other literal values. */
+class term_cache_t {
+public:
+    term_cache_t();
+    ~term_cache_t();
+
+    // Returns false if the query shouldn't be cached, e.g. because it's too big.
+    static bool compute_key(const Term &query, std::string *key_out);
+
+    // Returns an empty pointer if there's no tree for `key`.
+    counted_t<term_t> find(const std::string &key);
+    void insert(const std::string &key, const counted_t<term_t> &term);
+
+private:
+    void check_thread();
+
+    typedef std::list<std::pair<std::string, counted_t<term_t> > > lru_t;
+    // Most recently used first.
+    lru_t lru;
+    std::map<std::string, lru_t::iterator> entries;
+    threadnum_t thread;
+
+    DISABLE_COPYING(term_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_TERM_CACHE_HPP_
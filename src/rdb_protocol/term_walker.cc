@@ -164,6 +164,8 @@ private:
         case Term::AVG:
         case Term::MIN:
         case Term::MAX:
+        case Term::APPROX_COUNT_DISTINCT:
+        case Term::APPROX_QUANTILE:
         case Term::UNION:
         case Term::NTH:
         case Term::LIMIT:
@@ -240,6 +242,7 @@ private:
         case Term::TABLE_LIST:
         case Term::INDEX_LIST:
         case Term::INDEX_STATUS:
+        case Term::CHANGES:
             return false;
         default: unreachable();
         }
@@ -278,6 +281,8 @@ private:
         case Term::AVG:
         case Term::MIN:
         case Term::MAX:
+        case Term::APPROX_COUNT_DISTINCT:
+        case Term::APPROX_QUANTILE:
             return true;
 
         case Term::DATUM:
@@ -344,6 +349,7 @@ private:
         case Term::INDEX_LIST:
         case Term::INDEX_STATUS:
         case Term::INDEX_WAIT:
+        case Term::CHANGES:
         case Term::FUNCALL:
         case Term::BRANCH:
         case Term::ANY:
@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <math.h>
+
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
@@ -85,13 +87,17 @@ private:
                    base_exc_t::GENERIC,
                    strprintf("Cannot use an index < -1 (%d) on a stream.", n));
 
+            // A table can often skip the first rows without reading them.
+            const int32_t skipped = n > 0
+                ? static_cast<int32_t>(s->skip_ahead(env->env, n))
+                : 0;
             batchspec_t batchspec =
                 batchspec_t::user(batch_type_t::TERMINAL, env->env).with_at_most(
-                    int64_t(n)+1);
+                    int64_t(n)+1-skipped);
             counted_t<const datum_t> last_d;
             {
                 profile::sampler_t sampler("Find nth element.", env->env->trace);
-                for (int32_t i = 0; ; ++i) {
+                for (int32_t i = skipped; ; ++i) {
                     sampler.new_sample();
                     counted_t<const datum_t> d = s->next(env->env, batchspec);
                     if (!d.has()) {
@@ -197,10 +203,40 @@ private:
     virtual const char *name() const { return "slice"; }
 };
 
+// `order_by(...).limit(n)` with a constant `n` only needs the first `n` elements of
+// the ordering, so we tell the `order_by` about `n` with the `_LIMIT_` optarg.
+static protob_t<const Term> push_limit_into_orderby(const protob_t<const Term> &term) {
+    if (term->args_size() != 2) {
+        return term;
+    }
+    const Term &seq = term->args(0);
+    const Term &n = term->args(1);
+    if (seq.type() != Term::ORDERBY
+        || n.type() != Term::DATUM
+        || n.datum().type() != Datum::R_NUM) {
+        return term;
+    }
+    const double k = n.datum().r_num();
+    if (!(k >= 0 && k <= array_size_limit() && k == floor(k))) {
+        return term;
+    }
+    for (int i = 0; i < seq.optargs_size(); ++i) {
+        if (seq.optargs(i).key() == "_LIMIT_") {
+            return term;
+        }
+    }
+
+    protob_t<Term> rewritten = make_counted_term_copy(*term);
+    Term_AssocPair *limit = rewritten->mutable_args(0)->add_optargs();
+    limit->set_key("_LIMIT_");
+    limit->mutable_val()->CopyFrom(n);
+    return rewritten;
+}
+
 class limit_term_t : public op_term_t {
 public:
     limit_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2)) { }
+        : op_term_t(env, push_limit_into_orderby(term), argspec_t(2)) { }
 private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<val_t> v = arg(env, 0);
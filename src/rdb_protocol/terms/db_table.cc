@@ -7,6 +7,7 @@
 #include "clustering/administration/main/ports.hpp"
 #include "clustering/administration/suggester.hpp"
 #include "containers/wire_string.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/meta_utils.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rpc/directory/read_manager.hpp"
@@ -176,7 +177,8 @@ public:
     table_create_term_t(compile_env_t *env, const protob_t<const Term> &term) :
         meta_write_op_t(env, term, argspec_t(1, 2),
                         optargspec_t({"datacenter", "primary_key",
-                                    "cache_size", "durability"})) { }
+                                    "cache_size", "cpu_shards",
+                                    "durability"})) { }
 private:
     virtual std::string write_eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         uuid_u dc_id = nil_uuid();
@@ -204,6 +206,15 @@ private:
             cache_size = v->as_int<int64_t>();
         }
 
+        int32_t cpu_shards = CPU_SHARDING_FACTOR;
+        if (counted_t<val_t> v = optarg(env, "cpu_shards")) {
+            cpu_shards = v->as_int<int32_t>();
+            rcheck(cpu_shards >= 1 && cpu_shards <= MAX_CPU_SHARDING_FACTOR,
+                   base_exc_t::GENERIC,
+                   strprintf("`cpu_shards` must be between 1 and %d, got %d.",
+                             MAX_CPU_SHARDING_FACTOR, cpu_shards));
+        }
+
         uuid_u db_id;
         name_string_t tbl_name;
         if (num_args() == 1) {
@@ -236,7 +247,7 @@ private:
                 new_namespace<rdb_protocol_t>(
                     env->env->cluster_access.this_machine, db_id, dc_id, tbl_name,
                     primary_key, port_defaults::reql_port,
-                    cache_size);
+                    cache_size, cpu_shards);
 
             // Set Durability
             std::map<datacenter_id_t, ack_expectation_t> *ack_map =
@@ -478,6 +489,22 @@ private:
     virtual const char *name() const { return "table"; }
 };
 
+class changes_term_t : public op_term_t {
+public:
+    changes_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(1)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> table = arg(env, 0)->as_table();
+        rcheck(env->env->changefeed_client != NULL, base_exc_t::GENERIC,
+               "Changefeeds are not available on this server.");
+        return new_val(env->env, env->env->changefeed_client->new_stream(
+                           env->env, table, backtrace()));
+    }
+    virtual bool is_deterministic() const { return false; }
+    virtual const char *name() const { return "changes"; }
+};
+
 class get_term_t : public op_term_t {
 public:
     get_term_t(compile_env_t *env, const protob_t<const Term> &term) : op_term_t(env, term, argspec_t(2)) { }
@@ -512,12 +539,18 @@ private:
                 = make_counted<union_datum_stream_t>(std::move(streams), backtrace());
             return new_val(stream, table);
         } else {
-            datum_ptr_t arr(datum_t::R_ARRAY);
+            // All the keys are read at once, with one read per shard.
+            std::vector<counted_t<const datum_t> > keys;
+            keys.reserve(num_args() - 1);
             for (size_t i = 1; i < num_args(); ++i) {
-                counted_t<const datum_t> key = arg(env, i)->as_datum();
-                counted_t<const datum_t> row = table->get_row(env->env, key);
-                if (row->get_type() != datum_t::R_NULL) {
-                    arr.add(row);
+                keys.push_back(arg(env, i)->as_datum());
+            }
+            std::vector<counted_t<const datum_t> > rows
+                = table->get_rows(env->env, keys);
+            datum_ptr_t arr(datum_t::R_ARRAY);
+            for (auto it = rows.begin(); it != rows.end(); ++it) {
+                if ((*it)->get_type() != datum_t::R_NULL) {
+                    arr.add(*it);
                 }
             }
             counted_t<datum_stream_t> stream
@@ -572,6 +605,10 @@ counted_t<term_t> make_sync_term(compile_env_t *env, const protob_t<const Term>
     return make_counted<sync_term_t>(env, term);
 }
 
+counted_t<term_t> make_changes_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<changes_term_t>(env, term);
+}
+
 
 
 } // namespace ql
@@ -37,7 +37,7 @@ private:
         config.timeout_ms = timeout_ms;
 
         try {
-            js_result_t result = env->env->get_js_runner()->eval(source, config);
+            js_result_t result = env->env->get_js_runner(source)->eval(source, config);
             return boost::apply_visitor(js_result_visitor_t(source, timeout_ms, this),
                                         result);
         } catch (const js_worker_exc_t &e) {
@@ -5,24 +5,45 @@
 
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
+#include "rdb_protocol/regex_cache.hpp"
 
 namespace ql {
 
 class match_term_t : public op_term_t {
 public:
     match_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2)) { }
+        : op_term_t(env, term, argspec_t(2)) {
+        // A constant pattern is compiled along with the term, rather than for
+        // every row that a `filter` calls it on.  Bad patterns are left for
+        // `eval_impl` to report, in case it's never run.
+        const Term &pattern_term = term->args(1);
+        if (pattern_term.type() == Term::DATUM
+            && pattern_term.datum().type() == Datum::R_STR) {
+            counted_t<const compiled_regex_t> compiled
+                = get_compiled_regex(pattern_term.datum().r_str());
+            if (compiled->get().ok()) {
+                regex = compiled;
+            }
+        }
+    }
 private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         std::string str = arg(env, 0)->as_str().to_std();
-        RE2 regexp(arg(env, 1)->as_str().c_str());
-        if (!regexp.ok()) {
-            rfail(base_exc_t::GENERIC,
-                  "Error in regexp `%s` (portion `%s`): %s",
-                  regexp.pattern().c_str(),
-                  regexp.error_arg().c_str(),
-                  regexp.error().c_str());
+        std::string pattern = arg(env, 1)->as_str().to_std();
+        // The last pattern stays compiled, whether or not it's constant.
+        if (!regex.has() || regex->get().pattern() != pattern) {
+            counted_t<const compiled_regex_t> compiled = get_compiled_regex(pattern);
+            const RE2 &regexp = compiled->get();
+            if (!regexp.ok()) {
+                rfail(base_exc_t::GENERIC,
+                      "Error in regexp `%s` (portion `%s`): %s",
+                      regexp.pattern().c_str(),
+                      regexp.error_arg().c_str(),
+                      regexp.error().c_str());
+            }
+            regex = compiled;
         }
+        const RE2 &regexp = regex->get();
         // We add 1 to account for $0.
         int ngroups = regexp.NumberOfCapturingGroups() + 1;
         scoped_array_t<re2::StringPiece> groups(ngroups);
@@ -64,6 +85,8 @@ private:
         }
     }
     virtual const char *name() const { return "match"; }
+
+    counted_t<const compiled_regex_t> regex;
 };
 
 counted_t<term_t> make_match_term(compile_env_t *env,
@@ -2,9 +2,16 @@
 #include "rdb_protocol/terms/terms.hpp"
 
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "rdb_protocol/batch_predicate.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
 
@@ -77,6 +84,8 @@ public:
     }
 
     virtual const char *name() const { return "inner_join"; }
+
+    static const bool is_outer = false;
 };
 
 class outer_join_term_t : public rewrite_term_t {
@@ -116,6 +125,62 @@ public:
     }
 
     virtual const char *name() const { return "outer_join"; }
+
+    static const bool is_outer = true;
+};
+
+// `inner_join` and `outer_join` evaluate their function for every pair of rows.
+// When the function is just `left(a) == right(b)`, this instead reads the right
+// sequence once into a table keyed on `b` and streams the left sequence past it.
+// Anything else, including a right sequence over the array size limit, runs the
+// nested loop.
+template <class nested_loop_term_t>
+class join_term_t : public op_term_t {
+public:
+    join_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3)),
+          nested_loop(make_counted<nested_loop_term_t>(env, term)) { }
+
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        std::string left_field, right_field;
+        if (!get_join_equality(arg(env, 2)->as_func(), &left_field, &right_field)) {
+            return nested_loop->eval(env);
+        }
+        counted_t<datum_stream_t> left = arg(env, 0)->as_seq(env->env);
+        counted_t<datum_stream_t> right = arg(env, 1)->as_seq(env->env);
+        if (left->is_grouped() || right->is_grouped()) {
+            return nested_loop->eval(env);
+        }
+
+        std::vector<counted_t<const datum_t> > right_rows;
+        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
+        for (;;) {
+            std::vector<counted_t<const datum_t> > data
+                = right->next_batch(env->env, batchspec);
+            if (data.size() == 0) {
+                break;
+            }
+            std::move(data.begin(), data.end(), std::back_inserter(right_rows));
+            if (right_rows.size() > array_size_limit()) {
+                return nested_loop->eval(env);
+            }
+        }
+
+        counted_t<datum_stream_t> joined = make_counted<hash_join_datum_stream_t>(
+            left,
+            new_get_field_func(make_counted<const datum_t>(std::move(left_field)),
+                               backtrace()),
+            std::move(right_rows),
+            new_get_field_func(make_counted<const datum_t>(std::move(right_field)),
+                               backtrace()),
+            nested_loop_term_t::is_outer);
+        return new_val(env->env, joined);
+    }
+
+    virtual const char *name() const { return nested_loop->name(); }
+
+    counted_t<nested_loop_term_t> nested_loop;
 };
 
 class eq_join_term_t : public rewrite_term_t {
@@ -151,6 +216,35 @@ private:
     virtual const char *name() const { return "inner_join"; }
 };
 
+// `eq_join` on the primary index looks the right rows up for a whole batch of left
+// rows at once, instead of the rewrite's one `get_all` per left row.  Secondary
+// indexes still use the rewrite.
+class batched_eq_join_term_t : public op_term_t {
+public:
+    batched_eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3), optargspec_t({ "index" })),
+          rewritten(make_counted<eq_join_term_t>(env, term)) { }
+
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> left = arg(env, 0)->as_seq(env->env);
+        counted_t<func_t> left_key = arg(env, 1)->as_func(GET_FIELD_SHORTCUT);
+        counted_t<table_t> right = arg(env, 2)->as_table();
+        counted_t<val_t> index = optarg(env, "index");
+        if ((index.has() && index->as_str().to_std() != right->get_pkey())
+            || left->is_grouped()) {
+            return rewritten->eval(env);
+        }
+        counted_t<datum_stream_t> joined
+            = make_counted<eq_join_datum_stream_t>(left, left_key, right);
+        return new_val(env->env, joined);
+    }
+
+    virtual const char *name() const { return "inner_join"; }
+
+    counted_t<eq_join_term_t> rewritten;
+};
+
 class delete_term_t : public rewrite_term_t {
 public:
     delete_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -268,15 +362,15 @@ counted_t<term_t> make_skip_term(
 }
 counted_t<term_t> make_inner_join_term(
     compile_env_t *env, const protob_t<const Term> &term) {
-    return make_counted<inner_join_term_t>(env, term);
+    return make_counted<join_term_t<inner_join_term_t> >(env, term);
 }
 counted_t<term_t> make_outer_join_term(
     compile_env_t *env, const protob_t<const Term> &term) {
-    return make_counted<outer_join_term_t>(env, term);
+    return make_counted<join_term_t<outer_join_term_t> >(env, term);
 }
 counted_t<term_t> make_eq_join_term(
     compile_env_t *env, const protob_t<const Term> &term) {
-    return make_counted<eq_join_term_t>(env, term);
+    return make_counted<batched_eq_join_term_t>(env, term);
 }
 counted_t<term_t> make_update_term(
     compile_env_t *env, const protob_t<const Term> &term) {
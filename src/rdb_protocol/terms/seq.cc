@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "rdb_protocol/batch_predicate.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
@@ -59,6 +60,38 @@ private:
     virtual const char *name() const { return "max"; }
 };
 
+// These two are approximate: `approx_count_distinct` is typically within a couple
+// of percent, and `approx_quantile` within a percent of the rank it's asked for, but
+// neither needs memory proportional to the sequence.
+class approx_count_distinct_term_t
+    : public map_acc_term_t<count_distinct_wire_func_t> {
+public:
+    template<class... Args> approx_count_distinct_term_t(Args... args)
+        : map_acc_term_t<count_distinct_wire_func_t>(args...) { }
+private:
+    virtual const char *name() const { return "approx_count_distinct"; }
+};
+
+class approx_quantile_term_t : public op_term_t {
+public:
+    approx_quantile_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(2, 3)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> seq = arg(env, 0)->as_seq(env->env);
+        if (num_args() == 3) {
+            auto f = arg(env, 1)->as_func(GET_FIELD_SHORTCUT);
+            seq = seq->add_transformation(env->env, map_wire_func_t(f));
+        }
+        double q = arg(env, num_args() - 1)->as_num();
+        rcheck(q >= 0 && q <= 1, base_exc_t::GENERIC,
+               strprintf("Quantile must be between 0 and 1 (got %s).",
+                         make_counted<const datum_t>(q)->print().c_str()));
+        return seq->run_terminal(env->env, quantile_wire_func_t(q, backtrace()));
+    }
+    virtual const char *name() const { return "approx_quantile"; }
+};
+
 class count_term_t : public op_term_t {
 public:
     count_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -130,6 +163,34 @@ private:
     virtual const char *name() const { return "group"; }
 };
 
+// Returns false if `pval` can't be a primary key.
+static bool is_valid_primary_key(const counted_t<const datum_t> &pval) {
+    try {
+        pval->print_primary();
+        return true;
+    } catch (const base_exc_t &) {
+        return false;
+    }
+}
+
+// Returns true if every value in `range` would be in a secondary index on the field,
+// i.e. if the values in the range are all numbers, all strings or all booleans,
+// and it isn't empty.  (Values of different types are ordered by type, so values
+// between two bounds of the same type have that type.)
+static bool is_indexable_range(const batch_predicate_t::row_field_range_t &range) {
+    datum_t::type_t type = range.left->get_type();
+    if (range.right->get_type() != type
+        || (type != datum_t::R_NUM && type != datum_t::R_STR
+            && type != datum_t::R_BOOL)) {
+        return false;
+    }
+    if (*range.left == *range.right) {
+        return range.left_bound == key_range_t::closed
+            && range.right_bound == key_range_t::closed;
+    }
+    return *range.left < *range.right;
+}
+
 class filter_term_t : public op_term_t {
 public:
     filter_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -146,6 +207,40 @@ private:
             defval = wire_func_t(default_filter_term->eval_to_func(env->scope));
         }
 
+        // `table.filter(row(pkey) == value)` only has to read one row, and a filter
+        // on a range of a field with a secondary index only has to read that range
+        // of the index.  We only do this for a table that this term is the only
+        // user of, since it changes the table's bounds.  The filter still runs on
+        // the rows that are read.
+        if (get_src()->args(0).type() == Term::TABLE
+            && v0->get_type().is_convertible(val_t::type_t::TABLE)) {
+            counted_t<table_t> tbl = v0->as_table();
+            scoped_ptr_t<batch_predicate_t> predicate = compile_batch_predicate(f);
+            std::string field;
+            counted_t<const datum_t> value;
+            batch_predicate_t::row_field_range_t range;
+            if (!predicate.has()) {
+                // Nothing to narrow.
+            } else if (predicate->get_row_field_equality(&field, &value)
+                       && field == tbl->get_pkey()) {
+                if (is_valid_primary_key(value)) {
+                    tbl->restrict_to_primary_key(value);
+                }
+            } else if (!default_filter_term.has()
+                       && predicate->get_row_field_range(&range)
+                       && range.field != tbl->get_pkey()
+                       && is_indexable_range(range)) {
+                // Rows without the field aren't in the index, which is why this
+                // needs the filter to drop them, as it does without a default.
+                // For a `match`, rows whose field isn't a string aren't read, so
+                // the filter doesn't fail on them as a full scan would.
+                tbl->restrict_to_field_index(
+                    env->env, range.field,
+                    datum_range_t(range.left, range.left_bound,
+                                  range.right, range.right_bound));
+            }
+        }
+
         if (v0->get_type().is_convertible(val_t::type_t::SELECTION)) {
             std::pair<counted_t<table_t>, counted_t<datum_stream_t> > ts
                 = v0->as_selection(env->env);
@@ -287,6 +382,14 @@ counted_t<term_t> make_max_term(
     compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<max_term_t>(env, term);
 }
+counted_t<term_t> make_approx_count_distinct_term(
+    compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<approx_count_distinct_term_t>(env, term);
+}
+counted_t<term_t> make_approx_quantile_term(
+    compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<approx_quantile_term_t>(env, term);
+}
 counted_t<term_t> make_union_term(
     compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<union_term_t>(env, term);
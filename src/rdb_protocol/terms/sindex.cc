@@ -2,7 +2,9 @@
 #include "rdb_protocol/terms/terms.hpp"
 
 #include <string>
+#include <vector>
 
+#include "rdb_protocol/batch_predicate.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
@@ -16,7 +18,7 @@ namespace ql {
 class sindex_create_term_t : public op_term_t {
 public:
     sindex_create_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi"})) { }
+        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi", "covering", "count", "expire"})) { }
 
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<table_t> table = arg(env, 0)->as_table();
@@ -50,7 +52,38 @@ public:
              ? sindex_multi_bool_t::MULTI
              : sindex_multi_bool_t::SINGLE);
 
-        bool success = table->sindex_create(env->env, name, index_func, multi);
+        /* Check if we're making a covering index, and which fields it covers. */
+        std::vector<std::string> covered_fields;
+        counted_t<val_t> covering_val = optarg(env, "covering");
+        if (covering_val) {
+            counted_t<const datum_t> fields = covering_val->as_datum();
+            rcheck(fields->get_type() == datum_t::R_ARRAY && fields->size() != 0,
+                   base_exc_t::GENERIC,
+                   "`covering` must be a non-empty array of field names.");
+            for (size_t i = 0; i < fields->size(); ++i) {
+                covered_fields.push_back(fields->get(i)->as_str().to_std());
+            }
+        }
+
+        /* Check if we're making a counting index.  It keeps the number of rows
+           for each index value, and reading it gives those instead of the rows. */
+        counted_t<val_t> count_val = optarg(env, "count");
+        bool counting = count_val && count_val->as_datum()->as_bool();
+        rcheck(!counting || covered_fields.empty(), base_exc_t::GENERIC,
+               "A counting index can't also be a covering index.");
+
+        /* Check if we're making an expiry index.  The stores delete the rows whose
+           indexed field is a time that has passed in the background. */
+        counted_t<val_t> expire_val = optarg(env, "expire");
+        bool expiring = expire_val && expire_val->as_datum()->as_bool();
+        std::string expiry_field;
+        rcheck(!expiring || (multi == sindex_multi_bool_t::SINGLE && !counting
+                             && get_row_field(index_func, &expiry_field)),
+               base_exc_t::GENERIC,
+               "An expiry index must be a single index on a field of the row.");
+
+        bool success = table->sindex_create(env->env, name, index_func, multi,
+                                            covered_fields, counting, expiring);
         if (success) {
             datum_ptr_t res(datum_t::R_OBJECT);
             UNUSED bool b = res.add("created", make_counted<datum_t>(1.0));
@@ -8,6 +8,7 @@
 #include <boost/bind.hpp>
 
 #include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
@@ -49,7 +50,7 @@ class orderby_term_t : public op_term_t {
 public:
     orderby_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(1, -1),
-          optargspec_t({"index"})), src_term(term) { }
+          optargspec_t({"index", "_LIMIT_"})), src_term(term) { }
 private:
     enum order_direction_t { ASC, DESC };
     class lt_cmp_t {
@@ -102,6 +103,59 @@ private:
             return false;
         }
 
+        // Sorts `data` like `std::sort` with this comparison, but calls the
+        // functions once per element and compares sort keys built from their
+        // values (see `datum_t::append_sort_key`).  If some value has no sort key,
+        // it falls back to `std::sort`.
+        void sort(env_t *env, profile::sampler_t *sampler,
+                  std::vector<counted_t<const datum_t> > *data) const {
+            if (data->size() < 2) {
+                return;
+            }
+            std::vector<std::pair<std::string, counted_t<const datum_t> > > keyed;
+            keyed.reserve(data->size());
+            for (auto row = data->begin(); row != data->end(); ++row) {
+                sampler->new_sample();
+                std::string key;
+                for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+                    const size_t start = key.size();
+                    counted_t<const datum_t> val;
+                    try {
+                        val = it->second->call(env, *row)->as_datum();
+                    } catch (const base_exc_t &e) {
+                        if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                            throw;
+                        }
+                    }
+                    if (!val.has()) {
+                        // Missing values come first, and no sort key starts
+                        // with a zero byte.
+                        key.push_back('\0');
+                    } else if (!val->append_sort_key(&key)) {
+                        std::sort(data->begin(), data->end(),
+                                  boost::bind(*this, env, sampler, _1, _2));
+                        return;
+                    }
+                    if (it->first == DESC) {
+                        // No sort key is a prefix of another, so complementing
+                        // one reverses its order.
+                        for (size_t i = start; i < key.size(); ++i) {
+                            key[i] = ~key[i];
+                        }
+                    }
+                }
+                keyed.push_back(std::make_pair(std::move(key), *row));
+            }
+            std::sort(keyed.begin(), keyed.end(),
+                      [](const std::pair<std::string, counted_t<const datum_t> > &l,
+                         const std::pair<std::string, counted_t<const datum_t> > &r) {
+                          return l.first < r.first;
+                      });
+            for (size_t i = 0; i < keyed.size(); ++i) {
+                (*data)[i] = std::move(keyed[i].second);
+            }
+        }
+
     private:
         const std::vector<std::pair<order_direction_t, counted_t<func_t> > >
             comparisons;
@@ -167,7 +221,26 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::GENERIC,
                    "Must specify something to order by.");
+            // `_LIMIT_` is set by `limit_term_t`.  Then we only need the first few
+            // elements, which the shards can find without sending us the rest.
+            counted_t<val_t> limit = optarg(env, "_LIMIT_");
+            if (limit.has() && !seq->is_grouped()) {
+                std::vector<std::pair<counted_t<func_t>, bool> > cmps;
+                for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+                    cmps.push_back(std::make_pair(it->second, it->first == DESC));
+                }
+                counted_t<const datum_t> top = seq->run_terminal(
+                    env->env,
+                    top_k_wire_func_t(limit->as_int<uint64_t>(), cmps))->as_datum();
+                seq = make_counted<array_datum_stream_t>(top, backtrace());
+                return tbl.has() ? new_val(seq, tbl) : new_val(env->env, seq);
+            }
             std::vector<counted_t<const datum_t> > to_sort;
+            memory_charge_t to_sort_charge(env->env);
+            // Once more than `array_size_limit()` elements have been read, they are
+            // sorted in runs that are spilled to disk and merged as the result is
+            // read.  Without anywhere to spill to, that's an error instead.
+            counted_t<external_sort_datum_stream_t> spilled;
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             for (;;) {
                 std::vector<counted_t<const datum_t> > data
@@ -175,15 +248,34 @@ private:
                 if (data.size() == 0) {
                     break;
                 }
+                for (auto it = data.begin(); it != data.end(); ++it) {
+                    to_sort_charge.add(*it);
+                }
                 std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck(to_sort.size() <= array_size_limit(), base_exc_t::GENERIC,
-                       strprintf("Array over size limit %zu.", to_sort.size()).c_str());
+                if (to_sort.size() > array_size_limit()) {
+                    rcheck(env->env->spill_storage != NULL, base_exc_t::GENERIC,
+                           strprintf("Array over size limit %zu.",
+                                     to_sort.size()).c_str());
+                    if (!spilled.has()) {
+                        spilled = make_counted<external_sort_datum_stream_t>(
+                            env->env->spill_storage, lt_cmp, backtrace());
+                    }
+                    spilled->add_run(env->env, std::move(to_sort));
+                    to_sort.clear();
+                    to_sort_charge.clear();
+                }
+            }
+            if (spilled.has()) {
+                if (!to_sort.empty()) {
+                    spilled->add_run(env->env, std::move(to_sort));
+                }
+                seq = std::move(spilled);
+            } else {
+                profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
+                lt_cmp.sort(env->env, &sampler, &to_sort);
+                seq = make_counted<array_datum_stream_t>(
+                    make_counted<const datum_t>(std::move(to_sort)), backtrace());
             }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                make_counted<const datum_t>(std::move(to_sort)), backtrace());
         }
         return tbl.has() ? new_val(seq, tbl) : new_val(env->env, seq);
     }
@@ -197,7 +289,7 @@ private:
 class distinct_term_t : public op_term_t {
 public:
     distinct_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(1)) { }
+        : op_term_t(env, term, argspec_t(1), optargspec_t({"index"})) { }
 private:
     static bool lt_cmp(env_t *,
                        counted_t<const datum_t> l,
@@ -205,23 +297,79 @@ private:
         return *l < *r;
     }
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
-        counted_t<datum_stream_t> s = arg(env, 0)->as_seq(env->env);
+        counted_t<val_t> v0 = arg(env, 0);
+        if (counted_t<val_t> index = optarg(env, "index")) {
+            // The index's values come in order, so the shards only send us the
+            // values and we only have to compare neighbours.
+            rcheck(v0->get_type().is_convertible(val_t::type_t::TABLE),
+                   base_exc_t::GENERIC,
+                   "Indexed distinct can only be performed on a TABLE.");
+            counted_t<table_t> tbl = v0->as_table();
+            const std::string index_str = index->as_str().to_std();
+            const std::string field = tbl->get_index_field(env->env, index_str);
+            rcheck(!field.empty(), base_exc_t::GENERIC,
+                   strprintf("Index `%s` is not ready or isn't on a single field, "
+                             "so distinct can't use it.", index_str.c_str()));
+            tbl->add_sorting(index_str, sorting_t::ASCENDING, this);
+            counted_t<datum_stream_t> seq = tbl->as_datum_stream(env->env, backtrace());
+            seq = seq->add_transformation(
+                env->env,
+                map_wire_func_t(new_get_field_func(
+                                    make_counted<const datum_t>(std::string(field)),
+                                    backtrace())));
+            seq = seq->add_transformation(env->env, distinct_wire_func_t());
+            return new_val(env->env, make_counted<distinct_datum_stream_t>(seq, true));
+        }
+
+        counted_t<datum_stream_t> s = v0->as_seq(env->env);
+        if (!s->is_array() && !s->is_grouped()) {
+            // Streams are deduplicated by hashing, first by the shards for each
+            // batch and then here, so the rows come back as they arrive.
+            s = s->add_transformation(env->env, distinct_wire_func_t());
+            return new_val(env->env, make_counted<distinct_datum_stream_t>(s, false));
+        }
         std::vector<counted_t<const datum_t> > arr;
+        memory_charge_t arr_charge(env->env);
         counted_t<const datum_t> last;
         batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
         {
             profile::sampler_t sampler("Evaluating elements in distinct.",
                                        env->env->trace);
             while (counted_t<const datum_t> d = s->next(env->env, batchspec)) {
+                arr_charge.add(d);
                 arr.push_back(std::move(d));
                 rcheck_array_size(arr, base_exc_t::GENERIC);
                 sampler.new_sample();
             }
         }
+        // Equal data have equal sort keys, so we sort and compare those if we can.
+        std::vector<std::pair<std::string, counted_t<const datum_t> > > keyed;
+        keyed.reserve(arr.size());
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            std::string key;
+            if (!(*it)->append_sort_key(&key)) {
+                keyed.clear();
+                break;
+            }
+            keyed.push_back(std::make_pair(std::move(key), *it));
+        }
+        std::vector<counted_t<const datum_t> > toret;
+        if (keyed.size() == arr.size()) {
+            std::sort(keyed.begin(), keyed.end(),
+                      [](const std::pair<std::string, counted_t<const datum_t> > &l,
+                         const std::pair<std::string, counted_t<const datum_t> > &r) {
+                          return l.first < r.first;
+                      });
+            for (size_t i = 0; i < keyed.size(); ++i) {
+                if (i == 0 || keyed[i].first != keyed[i - 1].first) {
+                    toret.push_back(std::move(keyed[i].second));
+                }
+            }
+            return new_val(make_counted<const datum_t>(std::move(toret)));
+        }
         std::sort(arr.begin(), arr.end(),
                   std::bind(lt_cmp, env->env,
                             ph::_1, ph::_2));
-        std::vector<counted_t<const datum_t> > toret;
         for (auto it = arr.begin(); it != arr.end(); ++it) {
             if (toret.size() == 0 || **it != *toret[toret.size()-1]) {
                 toret.push_back(std::move(*it));
@@ -97,6 +97,8 @@ counted_t<term_t> make_table_list_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_sync_term(
     compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_changes_term(
+    compile_env_t *env, const protob_t<const Term> &term);
 
 // error.cc
 counted_t<term_t> make_error_term(
@@ -189,6 +191,10 @@ counted_t<term_t> make_min_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_max_term(
     compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_approx_count_distinct_term(
+    compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_approx_quantile_term(
+    compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_union_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_zip_term(
@@ -1,9 +1,17 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include <deque>
+#include <exception>
+#include <functional>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/wait_any.hpp"
+#include "containers/scoped.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
@@ -41,19 +49,138 @@ durability_requirement_t parse_durability_optarg(counted_t<val_t> arg,
                  str.c_str());
 }
 
+// Keeps up to `INSERT_PIPELINE_WINDOW` batched inserts of a multi-row insert in
+// flight, so that the shards write one batch while the next one is read and
+// checked.  A batch that has a primary key in common with a batch in flight waits
+// for it, so rows with the same key are still inserted in order.
+class insert_pipeline_t {
+public:
+    insert_pipeline_t(env_t *_env, counted_t<table_t> _table, bool _upsert,
+                      durability_requirement_t _durability_requirement)
+        : env(_env), table(_table), upsert(_upsert),
+          durability_requirement(_durability_requirement),
+          // Profiles expect each write to happen in turn.
+          window(env->trace.has() ? 1 : INSERT_PIPELINE_WINDOW),
+          stats(new_stats_object()) { }
+
+    void insert(std::vector<counted_t<const datum_t> > &&datums) {
+        scoped_ptr_t<batch_t> batch(new batch_t());
+        const std::string &pkey = table->get_pkey();
+        for (auto it = datums.begin(); it != datums.end(); ++it) {
+            counted_t<const datum_t> key = (*it)->get(pkey, NOTHROW);
+            if (!key.has()) {
+                continue;
+            }
+            try {
+                batch->keys.insert(key->print_primary());
+            } catch (const base_exc_t &) {
+                // `batched_insert` reports this.
+            }
+        }
+
+        while (in_flight.size() >= window) {
+            finish_oldest();
+        }
+        for (size_t i = in_flight.size(); i-- > 0;) {
+            if (intersects(in_flight[i]->keys, batch->keys)) {
+                while (in_flight.size() > i) {
+                    finish_oldest();
+                }
+                break;
+            }
+        }
+
+        coro_t::spawn_sometime(std::bind(&insert_pipeline_t::run, this, batch.get(),
+                                         std::move(datums), drainer.lock()));
+        in_flight.push_back(std::move(batch));
+    }
+
+    // Waits for all the inserts, and returns their stats merged in order.
+    counted_t<const datum_t> finish() {
+        while (!in_flight.empty()) {
+            finish_oldest();
+        }
+        return stats;
+    }
+
+private:
+    struct batch_t {
+        std::set<std::string> keys;
+        counted_t<const datum_t> stats;
+        std::exception_ptr error;
+        cond_t done;
+    };
+
+    static bool intersects(const std::set<std::string> &x,
+                           const std::set<std::string> &y) {
+        auto xit = x.begin();
+        auto yit = y.begin();
+        while (xit != x.end() && yit != y.end()) {
+            if (*xit < *yit) {
+                ++xit;
+            } else if (*yit < *xit) {
+                ++yit;
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(batch_t *batch, std::vector<counted_t<const datum_t> > &datums,
+             auto_drainer_t::lock_t) {
+        try {
+            batch->stats = table->batched_insert(
+                env, std::move(datums), upsert, durability_requirement, false);
+        } catch (const std::exception &) {
+            batch->error = std::current_exception();
+        }
+        batch->done.pulse();
+    }
+
+    void finish_oldest() {
+        batch_t *oldest = in_flight.front().get();
+        wait_interruptible(&oldest->done, env->interruptor);
+        if (oldest->error != std::exception_ptr()) {
+            std::exception_ptr error = oldest->error;
+            in_flight.pop_front();
+            std::rethrow_exception(error);
+        }
+        stats = stats->merge(oldest->stats, stats_merge);
+        in_flight.pop_front();
+    }
+
+    env_t *env;
+    counted_t<table_t> table;
+    bool upsert;
+    durability_requirement_t durability_requirement;
+    size_t window;
+
+    counted_t<const datum_t> stats;
+    std::deque<scoped_ptr_t<batch_t> > in_flight;
+    // Destroyed first, so the inserts still running finish before their batches go.
+    auto_drainer_t drainer;
+};
+
 class insert_term_t : public op_term_t {
 public:
     insert_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(2),
-                    optargspec_t({"upsert", "durability", "return_vals"})) { }
+                    optargspec_t({"upsert", "durability", "return_vals",
+                                  "ordered_keys"})) { }
 
 private:
+    // With `ordered_keys`, the generated keys are time-ordered uuids, which keep
+    // the inserts at the end of the btree.
     void maybe_generate_key(counted_t<table_t> tbl,
+                            bool ordered_keys,
                             std::vector<std::string> *generated_keys_out,
                             size_t *keys_skipped_out,
                             counted_t<const datum_t> *datum_out) {
         if (!(*datum_out)->get(tbl->get_pkey(), NOTHROW).has()) {
-            std::string key = uuid_to_str(generate_uuid());
+            std::string key = uuid_to_str(ordered_keys
+                                          ? generate_time_ordered_uuid()
+                                          : generate_uuid());
             counted_t<const datum_t> keyd(new datum_t(std::string(key)));
             datum_ptr_t d(datum_t::R_OBJECT);
             bool conflict = d.add(tbl->get_pkey(), keyd);
@@ -73,6 +200,9 @@ private:
         bool upsert = upsert_val.has() ? upsert_val->as_bool() : false;
         counted_t<val_t> return_vals_val = optarg(env, "return_vals");
         bool return_vals = return_vals_val.has() ? return_vals_val->as_bool() : false;
+        counted_t<val_t> ordered_keys_val = optarg(env, "ordered_keys");
+        bool ordered_keys
+            = ordered_keys_val.has() ? ordered_keys_val->as_bool() : false;
 
         const durability_requirement_t durability_requirement
             = parse_durability_optarg(optarg(env, "durability"), this);
@@ -87,7 +217,8 @@ private:
             datums.push_back(v1->as_datum());
             if (datums[0]->get_type() == datum_t::R_OBJECT) {
                 try {
-                    maybe_generate_key(t, &generated_keys, &keys_skipped, &datums[0]);
+                    maybe_generate_key(t, ordered_keys, &generated_keys, &keys_skipped,
+                                       &datums[0]);
                 } catch (const base_exc_t &) {
                     // We just ignore it, the same error will be handled in `replace`.
                     // TODO: that solution sucks.
@@ -106,6 +237,7 @@ private:
                    "Optarg RETURN_VALS is invalid for multi-row inserts.");
 
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
+            insert_pipeline_t pipeline(env->env, t, upsert, durability_requirement);
             for (;;) {
                 std::vector<counted_t<const datum_t> > datums
                     = datum_stream->next_batch(env->env, batchspec);
@@ -115,17 +247,17 @@ private:
 
                 for (auto it = datums.begin(); it != datums.end(); ++it) {
                     try {
-                        maybe_generate_key(t, &generated_keys, &keys_skipped, &*it);
+                        maybe_generate_key(t, ordered_keys, &generated_keys,
+                                           &keys_skipped, &*it);
                     } catch (const base_exc_t &) {
                         // We just ignore it, the same error will be handled in
                         // `replace`.  TODO: that solution sucks.
                     }
                 }
 
-                counted_t<const datum_t> replace_stats = t->batched_insert(
-                    env->env, std::move(datums), upsert, durability_requirement, false);
-                stats = stats->merge(replace_stats, stats_merge);
+                pipeline.insert(std::move(datums));
             }
+            stats = stats->merge(pipeline.finish(), stats_merge);
         }
 
         if (generated_keys.size() > 0) {
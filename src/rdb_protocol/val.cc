@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/val.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/meta_utils.hpp"
@@ -30,11 +32,11 @@ table_t::table_t(env_t *env,
         ns_searcher(&namespaces_metadata.get()->namespaces);
     // TODO: fold into iteration below
     namespace_predicate_t pred(&table_name, &db_id);
-    uuid_u id = meta_get_uuid(&ns_searcher, pred,
-                              strprintf("Table `%s` does not exist.",
-                                        table_name.c_str()), this);
+    uuid = meta_get_uuid(&ns_searcher, pred,
+                         strprintf("Table `%s` does not exist.",
+                                   table_name.c_str()), this);
 
-    access.init(new rdb_namespace_access_t(id, env));
+    access.init(new rdb_namespace_access_t(uuid, env));
 
     metadata_search_status_t status;
     const_metadata_searcher_t<namespace_semilattice_metadata_t<rdb_protocol_t> >::iterator
@@ -172,11 +174,23 @@ counted_t<const datum_t> table_t::batched_insert(
 MUST_USE bool table_t::sindex_create(env_t *env,
                                      const std::string &id,
                                      counted_t<func_t> index_func,
-                                     sindex_multi_bool_t multi) {
+                                     sindex_multi_bool_t multi,
+                                     const std::vector<std::string> &covered_fields,
+                                     bool counting,
+                                     bool expiring) {
     index_func->assert_deterministic("Index functions must be deterministic.");
     map_wire_func_t wire_func(index_func);
+    // Rows read through a covering index keep their primary key, so that they can
+    // still be written back to the table.
+    std::vector<std::string> fields(covered_fields);
+    if (!fields.empty()
+        && std::find(fields.begin(), fields.end(), get_pkey()) == fields.end()) {
+        fields.push_back(get_pkey());
+    }
     rdb_protocol_t::write_t write(
-            rdb_protocol_t::sindex_create_t(id, wire_func, multi), env->profile());
+            rdb_protocol_t::sindex_create_t(id, wire_func, multi, fields, counting,
+                                            expiring ? get_pkey() : ""),
+            env->profile());
 
     rdb_protocol_t::write_response_t res;
     access->get_namespace_if().write(
@@ -226,6 +240,25 @@ counted_t<const datum_t> table_t::sindex_list(env_t *env) {
     }
 }
 
+std::vector<changefeed::server_t::addr_t> table_t::changefeed_subscribe(
+        env_t *env, const changefeed::client_addr_t &addr) {
+    rdb_protocol_t::changefeed_subscribe_t subscribe(addr);
+    rdb_protocol_t::read_t read(subscribe, env->profile());
+    try {
+        rdb_protocol_t::read_response_t res;
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+        auto s_res =
+            boost::get<rdb_protocol_t::changefeed_subscribe_response_t>(&res.response);
+        r_sanity_check(s_res);
+        rcheck(!s_res->addrs.empty(), base_exc_t::GENERIC,
+               "Changefeeds are not available on this table.");
+        return s_res->addrs;
+    } catch (const cannot_perform_query_exc_t &ex) {
+        rfail(base_exc_t::GENERIC, "cannot subscribe to changes: %s", ex.what());
+    }
+}
+
 counted_t<const datum_t> table_t::sindex_status(env_t *env, std::set<std::string> sindexes) {
     rdb_protocol_t::sindex_status_t sindex_status(sindexes);
     rdb_protocol_t::read_t read(sindex_status, env->profile());
@@ -304,6 +337,39 @@ counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> p
     return p_res->data;
 }
 
+std::vector<counted_t<const datum_t> > table_t::get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals) {
+    std::vector<counted_t<const datum_t> > rows(pvals.size());
+    if (pvals.empty()) {
+        return rows;
+    }
+    std::vector<store_key_t> keys;
+    keys.reserve(pvals.size());
+    for (auto it = pvals.begin(); it != pvals.end(); ++it) {
+        keys.push_back(store_key_t((*it)->print_primary()));
+    }
+    rdb_protocol_t::read_t read(
+            rdb_protocol_t::batched_point_read_t(std::vector<store_key_t>(keys)),
+            env->profile());
+    rdb_protocol_t::read_response_t res;
+    if (use_outdated) {
+        access->get_namespace_if().read_outdated(read, &res, env->interruptor);
+    } else {
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    }
+    rdb_protocol_t::batched_point_read_response_t *bp_res =
+        boost::get<rdb_protocol_t::batched_point_read_response_t>(&res.response);
+    r_sanity_check(bp_res);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto it = bp_res->rows.find(keys[i]);
+        rows[i] = it != bp_res->rows.end()
+            ? it->second
+            : make_counted<const datum_t>(datum_t::R_NULL);
+    }
+    return rows;
+}
+
 counted_t<datum_stream_t> table_t::get_all(
         env_t *env,
         counted_t<const datum_t> value,
@@ -362,6 +428,67 @@ void table_t::add_bounds(datum_range_t &&new_bounds,
     bounds = std::move(new_bounds);
 }
 
+bool table_t::restrict_to_primary_key(counted_t<const datum_t> pval) {
+    if (sindex_id || !bounds.is_universe() || sorting != sorting_t::UNORDERED) {
+        return false;
+    }
+    sindex_id = get_pkey();
+    bounds = datum_range_t(pval);
+    return true;
+}
+
+bool table_t::restrict_to_field_index(env_t *env, const std::string &field,
+                                      datum_range_t &&range) {
+    if (sindex_id || !bounds.is_universe() || sorting != sorting_t::UNORDERED) {
+        return false;
+    }
+    std::map<std::string, rdb_protocol_details::single_sindex_status_t> statuses;
+    if (!read_sindex_statuses(env, &statuses)) {
+        return false;
+    }
+    for (auto it = statuses.begin(); it != statuses.end(); ++it) {
+        if (it->second.ready && it->second.row_field == field) {
+            sindex_id = it->first;
+            bounds = std::move(range);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string table_t::get_index_field(env_t *env, const std::string &sindex_id) {
+    if (sindex_id == get_pkey()) {
+        return sindex_id;
+    }
+    std::map<std::string, rdb_protocol_details::single_sindex_status_t> statuses;
+    if (!read_sindex_statuses(env, &statuses)) {
+        return std::string();
+    }
+    auto it = statuses.find(sindex_id);
+    return it != statuses.end() && it->second.ready
+        ? it->second.row_field
+        : std::string();
+}
+
+bool table_t::read_sindex_statuses(
+    env_t *env,
+    std::map<std::string, rdb_protocol_details::single_sindex_status_t> *out) {
+    rdb_protocol_t::sindex_status_t sindex_status((std::set<std::string>()));
+    rdb_protocol_t::read_t read(sindex_status, env->profile());
+    rdb_protocol_t::read_response_t res;
+    try {
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    } catch (const cannot_perform_query_exc_t &) {
+        // The query itself will report this.
+        return false;
+    }
+    auto s_res = boost::get<rdb_protocol_t::sindex_status_response_t>(&res.response);
+    r_sanity_check(s_res);
+    *out = std::move(s_res->statuses);
+    return true;
+}
+
 counted_t<datum_stream_t> table_t::as_datum_stream(env_t *env,
                                                    const protob_t<const Backtrace> &bt) {
     return make_counted<lazy_datum_stream_t>(
@@ -38,6 +38,10 @@ public:
                                               const protob_t<const Backtrace> &bt);
     const std::string &get_pkey();
     counted_t<const datum_t> get_row(env_t *env, counted_t<const datum_t> pval);
+    // Reads the rows for all of `pvals` with one read per shard.  Returns a row for
+    // each of `pvals`, in order, which is null if there is none.
+    std::vector<counted_t<const datum_t> > get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals);
     counted_t<datum_stream_t> get_all(
             env_t *env,
             counted_t<const datum_t> value,
@@ -49,6 +53,17 @@ public:
     void add_bounds(datum_range_t &&new_bounds,
                     const std::string &new_sindex_id,
                     const rcheckable_t *parent);
+    // Restricts the table to the row with primary key `pval`, unless it's already
+    // restricted or ordered.  Returns whether it did.
+    bool restrict_to_primary_key(counted_t<const datum_t> pval);
+    // Restricts the table to the rows whose `field` is in `range`, if the table
+    // isn't already restricted or ordered and has a ready secondary index on
+    // `row(field)`.  The range's bounds must be indexable.  Returns whether it did.
+    bool restrict_to_field_index(env_t *env, const std::string &field,
+                                 datum_range_t &&range);
+    // The field that index `sindex_id` is on if it's the primary index or a ready
+    // secondary index on `row(field)`, and the empty string otherwise.
+    std::string get_index_field(env_t *env, const std::string &sindex_id);
 
     counted_t<const datum_t> make_error_datum(const base_exc_t &exception);
 
@@ -68,15 +83,29 @@ public:
         durability_requirement_t durability_requirement,
         bool return_vals);
 
+    // If covered_fields isn't empty, this creates a covering index over those
+    // fields (and the primary key).  If counting is set, it creates a counting
+    // index, which keeps the number of rows for each index value.  If expiring is
+    // set, it creates an expiry index: the rows whose indexed field is a time that
+    // has passed get deleted in the background.
     MUST_USE bool sindex_create(
         env_t *env, const std::string &name,
-        counted_t<func_t> index_func, sindex_multi_bool_t multi);
+        counted_t<func_t> index_func, sindex_multi_bool_t multi,
+        const std::vector<std::string> &covered_fields, bool counting,
+        bool expiring);
     MUST_USE bool sindex_drop(env_t *env, const std::string &name);
     counted_t<const datum_t> sindex_list(env_t *env);
     counted_t<const datum_t> sindex_status(env_t *env,
         std::set<std::string> sindex);
     MUST_USE bool sync(env_t *env, const rcheckable_t *parent);
 
+    // Subscribes `addr` to the changes on every shard of the table, and returns
+    // where to unsubscribe it from each.
+    std::vector<changefeed::server_t::addr_t> changefeed_subscribe(
+        env_t *env, const changefeed::client_addr_t &addr);
+
+    const uuid_u &get_uuid() const { return uuid; }
+
     counted_t<const db_t> db;
     const std::string name;
 
@@ -97,6 +126,12 @@ private:
     MUST_USE bool sync_depending_on_durability(
         env_t *env, durability_requirement_t durability_requirement);
 
+    // Returns false if the statuses can't be read right now.
+    MUST_USE bool read_sindex_statuses(
+        env_t *env,
+        std::map<std::string, rdb_protocol_details::single_sindex_status_t> *out);
+
+    uuid_u uuid;
     bool use_outdated;
     std::string pkey;
     scoped_ptr_t<rdb_namespace_access_t> access;
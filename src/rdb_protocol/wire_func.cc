@@ -158,6 +158,8 @@ map_wire_func_t map_wire_func_t::make_safely(
 
 RDB_IMPL_SERIALIZABLE_2(filter_wire_func_t, filter_func, default_filter_val);
 
+RDB_IMPL_SERIALIZABLE_2(top_k_wire_func_t, k, comparisons);
+
 void bt_wire_func_t::rdb_serialize(write_message_t &msg) const { // NOLINT
     msg << *bt;
 }
@@ -167,4 +169,14 @@ archive_result_t bt_wire_func_t::rdb_deserialize(read_stream_t *s) {
     return deserialize(s, const_cast<Backtrace *>(&*bt));
 }
 
+void quantile_wire_func_t::rdb_serialize(write_message_t &msg) const { // NOLINT
+    bt_wire_func_t::rdb_serialize(msg);
+    msg << q;
+}
+
+archive_result_t quantile_wire_func_t::rdb_deserialize(read_stream_t *s) {
+    if (auto res = bt_wire_func_t::rdb_deserialize(s)) return res;
+    return deserialize(s, &q);
+}
+
 }  // namespace ql
@@ -5,6 +5,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "containers/uuid.hpp"
@@ -97,6 +98,12 @@ public:
     explicit concatmap_wire_func_t(Args... args) : wire_func_t(args...) { }
 };
 
+// Drops rows that are equal to an earlier row of the same batch, so the shards
+// don't send `distinct` the duplicates they find.
+struct distinct_wire_func_t {
+    RDB_MAKE_ME_SERIALIZABLE_0();
+};
+
 // These are fake functions because we don't need to send anything.
 struct count_wire_func_t {
     RDB_MAKE_ME_SERIALIZABLE_0();
@@ -135,6 +142,41 @@ struct max_wire_func_t {
     RDB_MAKE_ME_SERIALIZABLE_0();
 };
 
+struct count_distinct_wire_func_t {
+    count_distinct_wire_func_t() { }
+    explicit count_distinct_wire_func_t(const protob_t<const Backtrace> &) { }
+    RDB_MAKE_ME_SERIALIZABLE_0();
+};
+// `q` is in [0, 1].
+class quantile_wire_func_t : public bt_wire_func_t {
+public:
+    quantile_wire_func_t() : q(0) { }
+    quantile_wire_func_t(double _q, const protob_t<const Backtrace> &_bt)
+        : bt_wire_func_t(_bt), q(_q) { }
+    void rdb_serialize(write_message_t &msg) const;
+    archive_result_t rdb_deserialize(read_stream_t *s);
+    double q;
+};
+
+// The first `k` elements of a sequence in `order_by` order, which is what
+// `order_by(...).limit(k)` returns.
+class top_k_wire_func_t {
+public:
+    top_k_wire_func_t() : k(0) { }
+    // Each comparison is a key function, and whether it sorts descending.
+    top_k_wire_func_t(uint64_t _k,
+                      const std::vector<std::pair<counted_t<func_t>, bool> > &cmps)
+        : k(_k) {
+        for (auto it = cmps.begin(); it != cmps.end(); ++it) {
+            comparisons.push_back(std::make_pair(wire_func_t(it->first), it->second));
+        }
+    }
+
+    uint64_t k;
+    std::vector<std::pair<wire_func_t, bool> > comparisons;
+};
+RDB_DECLARE_SERIALIZABLE(top_k_wire_func_t);
+
 }  // namespace ql
 
 #endif  // RDB_PROTOCOL_WIRE_FUNC_HPP_
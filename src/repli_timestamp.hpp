@@ -37,6 +37,7 @@ repli_timestamp_t superceding_recency(repli_timestamp_t x, repli_timestamp_t y);
 
 write_message_t &operator<<(write_message_t &msg, repli_timestamp_t tstamp);
 archive_result_t deserialize(read_stream_t *s, repli_timestamp_t *tstamp);
+ARCHIVE_MAKE_SERIALIZED_AS_RAW(repli_timestamp_t);
 
 void debug_print(printf_buffer_t *buf, repli_timestamp_t tstamp);
 
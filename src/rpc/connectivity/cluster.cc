@@ -3,6 +3,7 @@
 
 #include <netinet/in.h>
 
+#include <algorithm>
 #include <functional>
 
 #include "errors.hpp"
@@ -12,6 +13,7 @@
 #include "arch/timing.hpp"
 
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/wait_any.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/semaphore.hpp"
 #include "containers/archive/vector_stream.hpp"
@@ -71,17 +73,27 @@ peer_address_t our_peer_address(std::set<ip_address_t> local_addresses,
     return peer_address_t(our_addrs);
 }
 
+/* The name of the local socket that the node with the cluster port `port`
+listens on, if any. See `connectivity_cluster_t::run_t::local_listener`. */
+std::string cluster_local_socket_name(int port) {
+    return strprintf("rethinkdb-cluster-%d", port);
+}
+
 connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
                                      const std::set<ip_address_t> &local_addresses,
                                      const peer_address_t &canonical_addresses,
                                      int port,
                                      message_handler_t *mh,
                                      int client_port,
-                                     heartbeat_manager_t *_heartbeat_manager)
+                                     heartbeat_manager_t *_heartbeat_manager,
+                                     tls_ctx_t *_tls_ctx,
+                                     bool _compress_messages)
         THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t) :
     parent(p),
     message_handler(mh),
     heartbeat_manager(_heartbeat_manager),
+    tls_ctx(_tls_ctx),
+    compress_messages(_compress_messages),
 
     /* Create the socket to use when listening for connections from peers */
     cluster_listener_socket(new tcp_bound_socket_t(local_addresses, port)),
@@ -112,7 +124,8 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me]),
+    connection_to_ourself(this, parent->me, NULL, std::vector<stripe_t *>(),
+                          routing_table[parent->me], false),
 
     listener(new tcp_listener_t(cluster_listener_socket.get(),
                                 std::bind(&connectivity_cluster_t::run_t::on_new_connection,
@@ -120,6 +133,18 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
 {
     rassert(message_handler != NULL);
     parent->assert_thread();
+
+    if (local_addresses.empty()) {
+        local_listener.init(new local_listener_t(
+            cluster_local_socket_name(cluster_listener_port),
+            std::bind(&connectivity_cluster_t::run_t::on_new_connection,
+                      this, ph::_1, auto_drainer_t::lock_t(&drainer))));
+        if (!local_listener->begin_listening()) {
+            logINF("Couldn't listen for connections from peers on this host on a "
+                   "local socket, they will connect over TCP.\n");
+            local_listener.reset();
+        }
+    }
 }
 
 connectivity_cluster_t::run_t::~run_t() { }
@@ -147,12 +172,24 @@ void connectivity_cluster_t::run_t::join(const peer_address_t &address) THROWS_N
 connectivity_cluster_t::run_t::connection_entry_t::connection_entry_t(run_t *p,
                                                                       peer_id_t id,
                                                                       tcp_conn_stream_t *c,
-                                                                      const peer_address_t &a) THROWS_NOTHING :
-    conn(c), address(a), session_id(generate_uuid()),
+                                                                      const std::vector<stripe_t *> &s,
+                                                                      const peer_address_t &a,
+                                                                      bool compress) THROWS_NOTHING :
+    conn(c), stripes(s), address(a),
+    send_queue_semaphore(CLUSTER_SEND_QUEUE_PEER_BYTES),
+    compressor(compress ? new compressor_t : NULL),
+    session_id(generate_uuid()),
     pm_collection(),
     pm_bytes_sent(secs_to_ticks(1), true),
+    pm_bytes_sent_compressed(secs_to_ticks(1), true),
+    pm_compression(secs_to_ticks(1), true),
     pm_collection_membership(&p->parent->connectivity_collection, &pm_collection, uuid_to_str(id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
+    pm_bytes_sent_compressed_membership(&pm_collection, &pm_bytes_sent_compressed,
+                                        "bytes_sent_compressed"),
+    pm_compression_membership(&pm_collection, &pm_compression, "compression"),
+    pm_send_queue_bytes_membership(&pm_collection, &pm_send_queue_bytes,
+                                   "send_queue_bytes"),
     parent(p), peer(id),
     entries(new one_per_thread_t<entry_installation_t>(this)) {
     if (peer != parent->parent->me && parent->heartbeat_manager != NULL) {
@@ -220,7 +257,18 @@ void connectivity_cluster_t::run_t::on_new_connection(const scoped_ptr_t<tcp_con
     nconn->make_overcomplicated(&conn);
     keepalive_tcp_conn_stream_t conn_stream(conn);
 
-    handle(&conn_stream, boost::none, boost::none, lock, NULL);
+    if (tls_ctx != NULL) {
+        signal_timer_t timeout;
+        timeout.start(TLS_HANDSHAKE_TIMEOUT_MS, COARSE_TIMER);
+        wait_any_t interruptor(&timeout, lock.get_drain_signal());
+        try {
+            conn->start_tls(tls_ctx, true, &interruptor);
+        } catch (const tcp_conn_read_closed_exc_t &) {
+            return;
+        }
+    }
+
+    handle(&conn_stream, boost::none, boost::none, lock, NULL, NULL);
 }
 
 void connectivity_cluster_t::run_t::connect_to_peer(const peer_address_t *address,
@@ -252,13 +300,25 @@ void connectivity_cluster_t::run_t::connect_to_peer(const peer_address_t *addres
     // Don't bother if there's already a connection
     if (!*successful_join) {
         try {
-            keepalive_tcp_conn_stream_t conn(selected_addr->ip(), selected_addr->port().value(),
-                                             drainer_lock.get_drain_signal(), cluster_client_port);
+            scoped_ptr_t<keepalive_tcp_conn_stream_t> conn(
+                open_connection(*selected_addr, drainer_lock.get_drain_signal(),
+                                cluster_client_port));
+            if (tls_ctx != NULL) {
+                signal_timer_t handshake_timeout;
+                handshake_timeout.start(TLS_HANDSHAKE_TIMEOUT_MS, COARSE_TIMER);
+                wait_any_t handshake_interruptor(&handshake_timeout,
+                                                 drainer_lock.get_drain_signal());
+                conn->get_underlying_conn()->start_tls(tls_ctx, false,
+                                                       &handshake_interruptor);
+            }
             if (!*successful_join) {
-                handle(&conn, expected_id, boost::optional<peer_address_t>(*address), drainer_lock, successful_join);
+                handle(conn.get(), expected_id, boost::optional<peer_address_t>(*address),
+                       drainer_lock, successful_join, &*selected_addr);
             }
         } catch (const tcp_conn_t::connect_failed_exc_t &) {
             /* Ignore */
+        } catch (const tcp_conn_read_closed_exc_t &) {
+            /* The TLS handshake failed; `start_tls()` logged why. */
         } catch (const interrupted_exc_t &) {
             /* Ignore */
         }
@@ -324,13 +384,31 @@ private:
     DISABLE_COPYING(cluster_conn_closing_subscription_t);
 };
 
+/* Takes whether the flag was set, and clears it. The flags are set from other
+threads. */
+static bool test_and_clear_traffic_flag(volatile intptr_t *flag) {
+    return *flag != 0 && __sync_lock_test_and_set(flag, 0) != 0;
+}
+
+static void set_traffic_flag(volatile intptr_t *flag) {
+    // Most reads and writes find the flag set already.
+    if (*flag == 0) {
+        __sync_lock_test_and_set(flag, 1);
+    }
+}
+
 class heartbeat_keepalive_t : public keepalive_tcp_conn_stream_t::keepalive_callback_t,
                               public heartbeat_manager_t::heartbeat_keepalive_tracker_t {
 public:
-    heartbeat_keepalive_t(keepalive_tcp_conn_stream_t *_conn, heartbeat_manager_t *_heartbeat, peer_id_t _peer) :
+    heartbeat_keepalive_t(keepalive_tcp_conn_stream_t *_conn, heartbeat_manager_t *_heartbeat, peer_id_t _peer,
+                          volatile intptr_t *_stripe_reads_seen, volatile intptr_t *_stripe_writes_seen) :
         conn(_conn),
         heartbeat(_heartbeat),
-        peer(_peer)
+        peer(_peer),
+        stripe_reads_seen(_stripe_reads_seen),
+        stripe_writes_seen(_stripe_writes_seen),
+        read_done(false),
+        write_done(false)
     {
         rassert(conn != NULL);
         rassert(heartbeat != NULL);
@@ -354,12 +432,19 @@ public:
     bool check_and_reset_reads() {
         bool result = read_done;
         read_done = false;
+        // Traffic on any of the stripes counts too.
+        if (test_and_clear_traffic_flag(stripe_reads_seen)) {
+            result = true;
+        }
         return result;
     }
 
     bool check_and_reset_writes() {
         bool result = write_done;
         write_done = false;
+        if (test_and_clear_traffic_flag(stripe_writes_seen)) {
+            result = true;
+        }
         return result;
     }
 
@@ -367,12 +452,44 @@ private:
     keepalive_tcp_conn_stream_t * const conn;
     heartbeat_manager_t * const heartbeat;
     const peer_id_t peer;
+    volatile intptr_t * const stripe_reads_seen;
+    volatile intptr_t * const stripe_writes_seen;
     bool read_done;
     bool write_done;
 
     DISABLE_COPYING(heartbeat_keepalive_t);
 };
 
+/* Reports the traffic on a stripe to the `heartbeat_keepalive_t` of the control
+connection, which is on another thread. */
+class stripe_keepalive_t : public keepalive_tcp_conn_stream_t::keepalive_callback_t {
+public:
+    stripe_keepalive_t(keepalive_tcp_conn_stream_t *_conn,
+                       volatile intptr_t *_reads_seen, volatile intptr_t *_writes_seen) :
+        conn(_conn), reads_seen(_reads_seen), writes_seen(_writes_seen) {
+        conn->set_keepalive_callback(this);
+    }
+
+    ~stripe_keepalive_t() {
+        conn->set_keepalive_callback(NULL);
+    }
+
+    void keepalive_read() {
+        set_traffic_flag(reads_seen);
+    }
+
+    void keepalive_write() {
+        set_traffic_flag(writes_seen);
+    }
+
+private:
+    keepalive_tcp_conn_stream_t * const conn;
+    volatile intptr_t * const reads_seen;
+    volatile intptr_t * const writes_seen;
+
+    DISABLE_COPYING(stripe_keepalive_t);
+};
+
 // Error-handling helper for connectivity_cluster_t::run_t::handle(). Returns true if handle()
 // should return.
 template<typename T>
@@ -522,34 +639,13 @@ bool connectivity_cluster_t::run_t::get_routing_table_to_send_and_add_peer(
     return true;
 }
 
-// We log error conditions as follows:
-// - silent: network error; conflict between parallel connections
-// - warning: invalid header
-// - error: id or address don't match expected id or address; deserialization range error; unknown error
-// In all cases we close the connection and quit.
-void connectivity_cluster_t::run_t::handle(
-        /* `conn` should remain valid until `handle()` returns.
-         * `handle()` does not take ownership of `conn`. */
+bool connectivity_cluster_t::run_t::exchange_headers(
         keepalive_tcp_conn_stream_t *conn,
-        boost::optional<peer_id_t> expected_id,
-        boost::optional<peer_address_t> expected_address,
-        auto_drainer_t::lock_t drainer_lock,
-        bool *successful_join) THROWS_NOTHING
-{
-    parent->assert_thread();
-
-    // Get the name of our peer, for error reporting.
-    ip_address_t peer_addr;
-    std::string peerstr = "(unknown)";
-    if (!conn->get_underlying_conn()->getpeername(&peer_addr))
-        peerstr = peer_addr.to_string();
-    const char *peername = peerstr.c_str();
-
-    // Make sure that if we're ordered to shut down, any pending read
-    // or write gets interrupted.
-    cluster_conn_closing_subscription_t conn_closer_1(conn);
-    conn_closer_1.reset(drainer_lock.get_drain_signal());
-
+        const char *peername,
+        const connection_kind_t &our_kind,
+        peer_id_t *other_id_out,
+        std::set<host_and_port_t> *other_peer_addr_hosts_out,
+        connection_kind_t *other_kind_out) THROWS_NOTHING {
     // Each side sends a header followed by its own ID and address, then receives and checks the
     // other side's.
     {
@@ -563,8 +659,12 @@ void connectivity_cluster_t::run_t::handle(
         msg.append(cluster_build_mode.data(), cluster_build_mode.length());
         msg << parent->me;
         msg << routing_table[parent->me].hosts();
+        msg << our_kind.connection_id;
+        msg << our_kind.stripe;
+        msg << our_kind.num_stripes;
+        msg << our_kind.compressed;
         if (send_write_message(conn, &msg))
-            return; // network error.
+            return false; // network error.
     }
 
     // Receive & check header.
@@ -575,12 +675,12 @@ void connectivity_cluster_t::run_t::handle(
         for (uint64_t i = 0; i < cluster_proto_header.length(); i += r) {
             r = conn->read(buffer, std::min(buffer_size, int64_t(cluster_proto_header.length() - i)));
             if (-1 == r)
-                return; // network error.
+                return false; // network error.
             rassert(r >= 0);
             // If EOF or remote_header does not match header, terminate connection.
             if (0 == r || memcmp(cluster_proto_header.c_str() + i, buffer, r) != 0) {
                 logWRN("Received invalid clustering header from %s, closing connection -- something might be connecting to the wrong port.", peername);
-                return;
+                return false;
             }
         }
     }
@@ -590,14 +690,14 @@ void connectivity_cluster_t::run_t::handle(
         std::string remote_version;
 
         if (!deserialize_compatible_string(conn, &remote_version, peername)) {
-            return;
+            return false;
         }
 
         if (remote_version != cluster_version) {
             logWRN("Connection attempt with a RethinkDB node of the wrong version, "
                    "peer: %s, local version: %s, remote version: %s, connection dropped\n",
                    peername, cluster_version.c_str(), remote_version.c_str());
-            return;
+            return false;
         }
     }
 
@@ -606,14 +706,14 @@ void connectivity_cluster_t::run_t::handle(
         std::string remote_arch_bitsize;
 
         if (!deserialize_compatible_string(conn, &remote_arch_bitsize, peername)) {
-            return;
+            return false;
         }
 
         if (remote_arch_bitsize != cluster_arch_bitsize) {
             logWRN("Connection attempt with a RethinkDB node of the wrong architecture, "
                    "peer: %s, local: %s, remote: %s, connection dropped\n",
                    peername, cluster_arch_bitsize.c_str(), remote_arch_bitsize.c_str());
-            return;
+            return false;
         }
 
     }
@@ -623,22 +723,85 @@ void connectivity_cluster_t::run_t::handle(
         std::string remote_build_mode;
 
         if (!deserialize_compatible_string(conn, &remote_build_mode, peername)) {
-            return;
+            return false;
         }
 
         if (remote_build_mode != cluster_build_mode) {
             logWRN("Connection attempt with a RethinkDB node of the wrong build mode, "
                    "peer: %s, local: %s, remote: %s, connection dropped\n",
                    peername, cluster_build_mode.c_str(), remote_build_mode.c_str());
-            return;
+            return false;
         }
     }
 
-    // Receive id, host/ports.
+    // Receive id, host/ports, and what the connection is for.
+    if (deserialize_and_check(conn, other_id_out, peername) ||
+        deserialize_and_check(conn, other_peer_addr_hosts_out, peername) ||
+        deserialize_and_check(conn, &other_kind_out->connection_id, peername) ||
+        deserialize_and_check(conn, &other_kind_out->stripe, peername) ||
+        deserialize_and_check(conn, &other_kind_out->num_stripes, peername) ||
+        deserialize_and_check(conn, &other_kind_out->compressed, peername))
+        return false;
+
+    // The other node runs the same version as we do, so it can't want more
+    // stripes than we would.
+    if (other_kind_out->num_stripes < 0 ||
+        other_kind_out->num_stripes > CLUSTER_STRIPED_CONNECTIONS ||
+        other_kind_out->stripe < connection_kind_t::control_stripe ||
+        other_kind_out->stripe >= CLUSTER_STRIPED_CONNECTIONS) {
+        logERR("received invalid connection kind from %s, closing connection", peername);
+        return false;
+    }
+
+    return true;
+}
+
+// We log error conditions as follows:
+// - silent: network error; conflict between parallel connections
+// - warning: invalid header
+// - error: id or address don't match expected id or address; deserialization range error; unknown error
+// In all cases we close the connection and quit.
+void connectivity_cluster_t::run_t::handle(
+        /* `conn` should remain valid until `handle()` returns.
+         * `handle()` does not take ownership of `conn`. */
+        keepalive_tcp_conn_stream_t *conn,
+        boost::optional<peer_id_t> expected_id,
+        boost::optional<peer_address_t> expected_address,
+        auto_drainer_t::lock_t drainer_lock,
+        bool *successful_join,
+        /* The address we connected to, or NULL if the other node connected
+        to us. */
+        const ip_and_port_t *dialed_address) THROWS_NOTHING
+{
+    parent->assert_thread();
+
+    // Get the name of our peer, for error reporting.
+    ip_address_t peer_addr;
+    std::string peerstr = "(unknown)";
+    if (!conn->get_underlying_conn()->getpeername(&peer_addr))
+        peerstr = peer_addr.to_string();
+    const char *peername = peerstr.c_str();
+
+    // Make sure that if we're ordered to shut down, any pending read
+    // or write gets interrupted.
+    cluster_conn_closing_subscription_t conn_closer_1(conn);
+    conn_closer_1.reset(drainer_lock.get_drain_signal());
+
+    /* If we opened the connection, we'll open its stripes too. All of them go
+    from the same source port if `cluster_client_port` is set, so then TCP
+    couldn't tell them apart, and we don't open any. */
+    connection_kind_t our_kind;
+    our_kind.compressed = compress_messages;
+    if (dialed_address != NULL) {
+        our_kind.connection_id = generate_uuid();
+        our_kind.num_stripes = cluster_client_port == 0 ? CLUSTER_STRIPED_CONNECTIONS : 0;
+    }
+
     peer_id_t other_id;
     std::set<host_and_port_t> other_peer_addr_hosts;
-    if (deserialize_and_check(conn, &other_id, peername) ||
-        deserialize_and_check(conn, &other_peer_addr_hosts, peername))
+    connection_kind_t other_kind;
+    if (!exchange_headers(conn, peername, our_kind,
+                          &other_id, &other_peer_addr_hosts, &other_kind))
         return;
 
     // Look up the ip addresses for the other host
@@ -675,6 +838,41 @@ void connectivity_cluster_t::run_t::handle(
     // Just saying that we're still on the rpc listener thread.
     parent->assert_thread();
 
+    /* If the other node opened the connection as a stripe of a control
+    connection, hand it to that control connection. If there's no such control
+    connection waiting for it, e.g. because it gave up on its stripes, we just
+    close the stripe. */
+    if (dialed_address == NULL && other_kind.stripe != connection_kind_t::control_stripe) {
+        auto it = pending_stripe_sets.find(other_kind.connection_id);
+        if (it == pending_stripe_sets.end()
+            || it->second->peer != other_id
+            || static_cast<size_t>(other_kind.stripe) >= it->second->stripes.size()
+            || it->second->stripes[other_kind.stripe] != NULL) {
+            return;
+        }
+        conn_closer_1.reset();
+        handle_stripe(conn, other_id, other_kind.compressed, other_kind.stripe, it->second,
+                      auto_drainer_t::lock_t(&it->second->drainer));
+        return;
+    }
+
+    /* The stripes of this connection. If the other node opened the connection,
+    it will open the stripes too, and we register the stripe set so that they
+    find it. */
+    const connection_kind_t &opener_kind
+        = dialed_address != NULL ? our_kind : other_kind;
+    stripe_set_t stripe_set(other_id, opener_kind.num_stripes);
+    map_insertion_sentry_t<uuid_u, stripe_set_t *> stripe_set_registration;
+    if (dialed_address == NULL && !stripe_set.stripes.empty()) {
+        if (pending_stripe_sets.find(opener_kind.connection_id)
+            != pending_stripe_sets.end()) {
+            logERR("received duplicate connection id from %s, closing connection", peername);
+            return;
+        }
+        stripe_set_registration.reset(&pending_stripe_sets,
+                                      opener_kind.connection_id, &stripe_set);
+    }
+
     /* The trickiest case is when there are two or more parallel connections
     that are trying to be established between the same two machines. We can get
     this when e.g. machine A and machine B try to connect to each other at the
@@ -775,6 +973,31 @@ void connectivity_cluster_t::run_t::handle(
         }
     }
 
+    /* The peer doesn't count as connected until all the stripes are up. If
+    one of them fails, or they take too long, we give up on the connection. */
+    if (!stripe_set.stripes.empty()) {
+        if (dialed_address != NULL) {
+            for (int32_t i = 0; i < our_kind.num_stripes; ++i) {
+                connection_kind_t stripe_kind = our_kind;
+                stripe_kind.stripe = i;
+                coro_t::spawn_sometime(std::bind(
+                    &connectivity_cluster_t::run_t::connect_stripe, this,
+                    *dialed_address, other_id, stripe_kind, &stripe_set,
+                    auto_drainer_t::lock_t(&stripe_set.drainer)));
+            }
+        }
+
+        signal_timer_t timeout;
+        timeout.start(CLUSTER_STRIPE_TIMEOUT_MS);
+        wait_any_t waiter(&stripe_set.all_established, &stripe_set.closed,
+                          &timeout, drainer_lock.get_drain_signal());
+        waiter.wait_lazily_unordered();
+        if (!stripe_set.all_established.is_pulsed() || stripe_set.closed.is_pulsed()) {
+            return;
+        }
+        stripe_set_registration.reset();
+    }
+
     /* Now that we're about to switch threads, it's not safe to try to close
     the connection from this thread anymore. This is safe because we won't do
     anything that permanently blocks before setting up `conn_closer_2`. */
@@ -785,54 +1008,203 @@ void connectivity_cluster_t::run_t::handle(
     threadnum_t chosen_thread = threadnum_t(rng.randint(get_num_threads()));
 
     cross_thread_signal_t connection_thread_drain_signal(drainer_lock.get_drain_signal(), chosen_thread);
+    cross_thread_signal_t stripe_closed_signal(&stripe_set.closed, chosen_thread);
 
+    const threadnum_t listener_thread = get_thread_id();
     rethread_tcp_conn_stream_t unregister_conn(conn, INVALID_THREAD);
     on_thread_t conn_threader(chosen_thread);
     rethread_tcp_conn_stream_t reregister_conn(conn, get_thread_id());
 
-    // Make sure that if we're ordered to shut down, any pending read
-    // or write gets interrupted.
+    // Make sure that if we're ordered to shut down, or one of the stripes
+    // closes, any pending read or write gets interrupted.
+    wait_any_t close_signal(&connection_thread_drain_signal, &stripe_closed_signal);
     cluster_conn_closing_subscription_t conn_closer_2(conn);
-    conn_closer_2.reset(&connection_thread_drain_signal);
+    conn_closer_2.reset(&close_signal);
 
     {
         /* `connection_entry_t` is the public interface of this coroutine. Its
         constructor registers it in the `connectivity_cluster_t`'s connection
         map and notifies any connect listeners. */
-        connection_entry_t conn_structure(this, other_id, conn, other_peer_addr);
+        connection_entry_t conn_structure(this, other_id, conn, stripe_set.stripes,
+                                          other_peer_addr, compress_messages);
         object_buffer_t<heartbeat_keepalive_t> keepalive;
 
         if (heartbeat_manager != NULL) {
-            keepalive.create(conn, heartbeat_manager, other_id);
+            keepalive.create(conn, heartbeat_manager, other_id,
+                             &stripe_set.reads_seen, &stripe_set.writes_seen);
+        }
+
+        /* Now that everybody knows the peer is connected, the stripes can
+        pass its messages on. */
+        if (!stripe_set.stripes.empty()) {
+            on_thread_t rethreader(listener_thread);
+            stripe_set.connected.pulse();
         }
 
         /* Main message-handling loop: read messages off the connection until
         it's closed, which may be due to network events, or the other end
         shutting down, or us shutting down. */
+        receive_messages(other_id, conn, other_kind.compressed);
+
+        /* The `conn_structure` destructor removes us from the connection map
+        and notifies any disconnect listeners. Once nobody can send over the
+        stripes any more, `stripe_set`'s destructor closes them. */
+    }
+}
+
+keepalive_tcp_conn_stream_t *connectivity_cluster_t::run_t::open_connection(
+        const ip_and_port_t &address,
+        signal_t *interruptor,
+        int local_port) {
+    parent->assert_thread();
+    bool is_local = address.ip().is_loopback();
+    const std::set<ip_and_port_t> &our_ips = routing_table.at(parent->me).ips();
+    for (auto it = our_ips.begin(); it != our_ips.end() && !is_local; ++it) {
+        is_local = it->ip() == address.ip();
+    }
+    if (is_local) {
         try {
-            int messages_handled_since_yield = 0;
-            while (true) {
-                message_handler->on_message(other_id, conn); // might raise fake_archive_exc_t
-
-                ++messages_handled_since_yield;
-                if (messages_handled_since_yield >= MESSAGE_HANDLER_MAX_BATCH_SIZE) {
-                    coro_t::yield();
-                    messages_handled_since_yield = 0;
-                }
+            return new keepalive_tcp_conn_stream_t(
+                cluster_local_socket_name(address.port().value()), interruptor);
+        } catch (const tcp_conn_t::connect_failed_exc_t &) {
+            /* The peer doesn't have a local socket; use TCP. */
+        }
+    }
+    return new keepalive_tcp_conn_stream_t(address.ip(), address.port().value(),
+                                           interruptor, local_port);
+}
+
+void connectivity_cluster_t::run_t::connect_stripe(
+        ip_and_port_t address,
+        peer_id_t expected_id,
+        connection_kind_t kind,
+        stripe_set_t *stripe_set,
+        auto_drainer_t::lock_t stripe_set_lock) THROWS_NOTHING {
+    parent->assert_thread();
+    try {
+        scoped_ptr_t<keepalive_tcp_conn_stream_t> conn(
+            open_connection(address, stripe_set_lock.get_drain_signal(), 0));
+        if (tls_ctx != NULL) {
+            signal_timer_t handshake_timeout;
+            handshake_timeout.start(TLS_HANDSHAKE_TIMEOUT_MS, COARSE_TIMER);
+            wait_any_t handshake_interruptor(&handshake_timeout,
+                                             stripe_set_lock.get_drain_signal());
+            conn->get_underlying_conn()->start_tls(tls_ctx, false,
+                                                   &handshake_interruptor);
+        }
+
+        std::string peerstr = address.ip().to_string();
+        cluster_conn_closing_subscription_t conn_closer(conn.get());
+        conn_closer.reset(stripe_set_lock.get_drain_signal());
+
+        peer_id_t other_id;
+        std::set<host_and_port_t> other_peer_addr_hosts;
+        connection_kind_t other_kind;
+        if (exchange_headers(conn.get(), peerstr.c_str(), kind,
+                             &other_id, &other_peer_addr_hosts, &other_kind)
+            && other_id == expected_id) {
+            conn_closer.reset();
+            handle_stripe(conn.get(), other_id, other_kind.compressed, kind.stripe,
+                          stripe_set, stripe_set_lock);
+            return;
+        }
+    } catch (const tcp_conn_t::connect_failed_exc_t &) {
+        /* Ignore */
+    } catch (const tcp_conn_read_closed_exc_t &) {
+        /* The TLS handshake failed; `start_tls()` logged why. */
+    } catch (const interrupted_exc_t &) {
+        /* Ignore */
+    }
+
+    // The control connection can't go on without this stripe.
+    stripe_set->closed.pulse_if_not_already_pulsed();
+}
+
+void connectivity_cluster_t::run_t::handle_stripe(
+        keepalive_tcp_conn_stream_t *conn,
+        peer_id_t other_id,
+        bool other_compresses,
+        int32_t index,
+        stripe_set_t *stripe_set,
+        auto_drainer_t::lock_t stripe_set_lock) THROWS_NOTHING {
+    parent->assert_thread();
+
+    // Each stripe gets a thread of its own choosing, as the control connection
+    // does.
+    threadnum_t chosen_thread = threadnum_t(rng.randint(get_num_threads()));
+
+    cross_thread_signal_t stripe_thread_drain_signal(stripe_set_lock.get_drain_signal(),
+                                                     chosen_thread);
+    cross_thread_signal_t connected_signal(&stripe_set->connected, chosen_thread);
+
+    stripe_t stripe(conn, compress_messages);
+    {
+        const threadnum_t listener_thread = get_thread_id();
+        rethread_tcp_conn_stream_t unregister_conn(conn, INVALID_THREAD);
+        on_thread_t conn_threader(chosen_thread);
+        rethread_tcp_conn_stream_t reregister_conn(conn, get_thread_id());
+
+        cluster_conn_closing_subscription_t conn_closer(conn);
+        conn_closer.reset(&stripe_thread_drain_signal);
+
+        stripe_keepalive_t keepalive(conn, &stripe_set->reads_seen, &stripe_set->writes_seen);
+
+        {
+            on_thread_t rethreader(listener_thread);
+            guarantee(stripe_set->stripes[index] == NULL);
+            stripe_set->stripes[index] = &stripe;
+            ++stripe_set->num_established;
+            if (stripe_set->num_established == stripe_set->stripes.size()) {
+                stripe_set->all_established.pulse();
             }
-        } catch (const fake_archive_exc_t &) {
-            /* The exception broke us out of the loop, and that's what we
-            wanted. This could either be because we lost contact with the peer
-            or because the cluster is shutting down and `close_conn()` got
-            called. */
         }
 
-        if(conn->is_read_open()) {
-            logWRN("Received invalid data on a cluster connection. Disconnecting.");
+        wait_any_t waiter(&connected_signal, &stripe_thread_drain_signal);
+        waiter.wait_lazily_unordered();
+        if (!stripe_thread_drain_signal.is_pulsed()) {
+            receive_messages(other_id, conn, other_compresses);
         }
 
-        /* The `conn_structure` destructor removes us from the connection map
-        and notifies any disconnect listeners. */
+        // Take down the control connection, and with it the other stripes.
+        {
+            on_thread_t rethreader(listener_thread);
+            stripe_set->closed.pulse_if_not_already_pulsed();
+        }
+
+        // The control connection may still be sending over `stripe`.
+        stripe_thread_drain_signal.wait_lazily_unordered();
+    }
+}
+
+void connectivity_cluster_t::run_t::receive_messages(peer_id_t other_id,
+                                                     tcp_conn_stream_t *conn,
+                                                     bool compressed) THROWS_NOTHING {
+    object_buffer_t<inflate_read_stream_t> inflater;
+    read_stream_t *stream = conn;
+    if (compressed) {
+        stream = inflater.create(conn);
+    }
+
+    try {
+        int messages_handled_since_yield = 0;
+        while (true) {
+            message_handler->on_message(other_id, stream); // might raise fake_archive_exc_t
+
+            ++messages_handled_since_yield;
+            if (messages_handled_since_yield >= MESSAGE_HANDLER_MAX_BATCH_SIZE) {
+                coro_t::yield();
+                messages_handled_since_yield = 0;
+            }
+        }
+    } catch (const fake_archive_exc_t &) {
+        /* The exception broke us out of the loop, and that's what we
+        wanted. This could either be because we lost contact with the peer
+        or because the cluster is shutting down and `close_conn()` got
+        called. */
+    }
+
+    if(conn->is_read_open()) {
+        logWRN("Received invalid data on a cluster connection. Disconnecting.");
     }
 }
 
@@ -881,18 +1253,48 @@ connectivity_service_t *connectivity_cluster_t::get_connectivity_service() THROW
     return this;
 }
 
+connectivity_cluster_t::thread_info_t::thread_info_t()
+    : send_queue_semaphore(CLUSTER_SEND_QUEUE_THREAD_BYTES) { }
+
 void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_callback_t *callback) THROWS_NOTHING {
+    send_message_on(dest, boost::none, callback);
+}
+
+void connectivity_cluster_t::send_striped_message(peer_id_t dest, uint64_t stripe,
+                                                  send_message_write_callback_t *callback) THROWS_NOTHING {
+    send_message_on(dest, boost::optional<uint64_t>(stripe), callback);
+}
+
+void connectivity_cluster_t::send_message_on(peer_id_t dest,
+                                             const boost::optional<uint64_t> &stripe,
+                                             send_message_write_callback_t *callback) THROWS_NOTHING {
     // We could be on _any_ thread.
 
     guarantee(!dest.is_nil());
 
+    /* Wait for this thread's send queue to have room before serializing the
+    message, so that senders to a slow peer wait instead of piling up serialized
+    messages. We don't know how big the message is until it's serialized, so we
+    wait for a single byte and count the rest once we know. */
+    new_semaphore_acq_t thread_queue_acq(&thread_info.get()->send_queue_semaphore, 1);
+    thread_queue_acq.acquisition_signal()->wait();
+
     /* We currently write the message to a vector_stream_t, then
        serialize that as a string. It's horribly inefficient, of course. */
     // TODO: If we don't do it this way, we (or the caller) will need
     // to worry about having the writer run on the connection thread.
     vector_stream_t buffer;
-    // Reserve some space to reduce overhead (especially for small messages)
-    buffer.reserve(1024);
+    {
+        // Reuse the space of an earlier message if we can
+        std::vector<std::vector<char> > *send_buffers = &thread_info.get()->send_buffers;
+        if (!send_buffers->empty()) {
+            buffer.swap(&send_buffers->back());
+            send_buffers->pop_back();
+        } else {
+            // Reserve some space to reduce overhead (especially for small messages)
+            buffer.reserve(1024);
+        }
+    }
     {
         ASSERT_FINITE_CORO_WAITING;
         callback->write(&buffer);
@@ -937,10 +1339,14 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
     }
 
     size_t bytes_sent = buffer.vector().size();
+    const int64_t queued_bytes = std::max<int64_t>(1, bytes_sent);
+    thread_queue_acq.change_count(queued_bytes);
 
     if (conn_structure->conn == NULL) {
         // We're sending a message to ourself
         guarantee(dest == me);
+        /* Nothing gets queued, and the handler might send messages itself. */
+        thread_queue_acq.reset();
         // We could be on any thread here! Oh no!
         std::vector<char> buffer_data;
         buffer.swap(&buffer_data);
@@ -948,29 +1354,75 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         current_run->message_handler->on_message(me, &read_stream);
     } else {
         guarantee(dest != me);
-        on_thread_t threader(conn_structure->conn->home_thread());
+
+        /* Messages with the same stripe always go over the same connection, so
+        they stay in order. */
+        tcp_conn_stream_t *conn = conn_structure->conn;
+        mutex_t *send_mutex = &conn_structure->send_mutex;
+        run_t::compressor_t *compressor = conn_structure->compressor.get_or_null();
+        if (stripe && !conn_structure->stripes.empty()) {
+            run_t::stripe_t *s = conn_structure->stripes[*stripe % conn_structure->stripes.size()];
+            conn = s->conn;
+            send_mutex = &s->send_mutex;
+            compressor = s->compressor.get_or_null();
+        }
+
+        on_thread_t threader(conn->home_thread());
+
+        /* Wait for the peer's send queue to have room too, which limits what all
+        threads together can queue for a peer that's slow to read it. */
+        conn_structure->pm_send_queue_bytes += queued_bytes;
+        new_semaphore_acq_t peer_queue_acq(&conn_structure->send_queue_semaphore,
+                                           queued_bytes);
+        peer_queue_acq.acquisition_signal()->wait();
 
         /* Acquire the send-mutex so we don't collide with other things trying
-        to send on the same connection. */
-        mutex_t::acq_t acq(&conn_structure->send_mutex);
+        to send on the same connection. The compression carries over from one
+        message to the next, so it happens under the mutex too. */
+        mutex_t::acq_t acq(send_mutex);
+
+        std::vector<char> compressed_data;
+        const std::vector<char> *data = &buffer.vector();
+        if (compressor != NULL) {
+            block_pm_duration compression_timer(&conn_structure->pm_compression);
+            int64_t res = compressor->deflater.write(data->data(), data->size());
+            guarantee(res == static_cast<int64_t>(data->size()));
+            compressor->buffer.swap(&compressed_data);
+            data = &compressed_data;
+            compression_timer.end();
+            conn_structure->pm_bytes_sent_compressed.record(compressed_data.size());
+        }
 
         {
-            int64_t res = conn_structure->conn->write(buffer.vector().data(),
-                                                      buffer.vector().size());
+            int64_t res = conn->write(data->data(), data->size());
             if (res == -1) {
                 /* Close the other half of the connection to make sure that
-                   `connectivity_cluster_t::run_t::handle()` notices that something is
-                   up */
-                if (conn_structure->conn->is_read_open()) {
-                    conn_structure->conn->shutdown_read();
+                   `connectivity_cluster_t::run_t::handle()` (or
+                   `handle_stripe()`) notices that something is up */
+                if (conn->is_read_open()) {
+                    conn->shutdown_read();
                 }
             } else {
-                guarantee(res == static_cast<int64_t>(buffer.vector().size()));
+                guarantee(res == static_cast<int64_t>(data->size()));
             }
         }
+
+        conn_structure->pm_send_queue_bytes -= queued_bytes;
     }
 
     conn_structure->pm_bytes_sent.record(bytes_sent);
+
+    /* Keep the buffer for the next message, unless it went to ourself or grew
+    too big to hold on to. */
+    std::vector<std::vector<char> > *send_buffers = &thread_info.get()->send_buffers;
+    if (send_buffers->size() < CLUSTER_SEND_BUFFER_POOL_SIZE
+        && buffer.vector().capacity() != 0
+        && buffer.vector().capacity() <= CLUSTER_SEND_BUFFER_MAX_SIZE) {
+        std::vector<char> data;
+        buffer.swap(&data);
+        data.clear();
+        send_buffers->push_back(std::move(data));
+    }
 }
 
 void connectivity_cluster_t::kill_connection(peer_id_t peer) THROWS_NOTHING {
@@ -982,7 +1434,12 @@ void connectivity_cluster_t::kill_connection(peer_id_t peer) THROWS_NOTHING {
     if (it != connection_map->end()) {
         tcp_conn_stream_t *conn = it->second.first->conn;
         guarantee(conn != NULL, "Attempted to kill connection to myself.");
-        guarantee(get_thread_id() == conn->home_thread());
+
+        /* The connection may be on another thread, e.g. if the message that
+        made us kill it came over one of its stripes. Closing it closes the
+        stripes too. */
+        auto_drainer_t::lock_t conn_structure_lock = it->second.second;
+        on_thread_t threader(conn->home_thread());
 
         if (conn->is_read_open()) {
             conn->shutdown_read();
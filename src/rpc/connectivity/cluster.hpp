@@ -10,9 +10,13 @@
 
 #include "arch/types.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/new_semaphore.hpp"
 #include "concurrency/one_per_thread.hpp"
 #include "concurrency/semaphore.hpp"
+#include "containers/archive/deflate_stream.hpp"
 #include "containers/archive/tcp_conn_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "containers/map_sentries.hpp"
 #include "perfmon/perfmon.hpp"
 #include "rpc/connectivity/connectivity.hpp"
@@ -20,6 +24,8 @@
 #include "rpc/connectivity/heartbeat.hpp"
 #include "containers/uuid.hpp"
 
+class tls_ctx_t;
+
 namespace boost {
 template <class> class optional;
 template <class> class scoped_ptr;
@@ -74,7 +80,9 @@ public:
               int port,
               message_handler_t *message_handler,
               int client_port,
-              heartbeat_manager_t *_heartbeat_manager)
+              heartbeat_manager_t *_heartbeat_manager,
+              tls_ctx_t *_tls_ctx = NULL,
+              bool _compress_messages = false)
             THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t);
 
         ~run_t();
@@ -90,17 +98,117 @@ public:
     private:
         friend class connectivity_cluster_t;
 
+        /* Besides the connection that `handle()` runs, which carries the control
+        traffic, the node that opened it opens `CLUSTER_STRIPED_CONNECTIONS`
+        more to the peer, its "stripes". Striped messages (see
+        `message_service_t::send_striped_message()`) go over the stripes, so
+        that they don't hold up the control traffic, and so that they don't all
+        have to go through one socket on one thread. The stripes are set up
+        before the peer counts as connected, and once any of the connections
+        closes, they all do. */
+        /* Compresses the messages we send over one connection. The compressed
+        data collects in `buffer` rather than going straight to the connection,
+        so that we can tell how long the compression itself takes. */
+        class compressor_t {
+        public:
+            compressor_t() : deflater(&buffer) { }
+
+            vector_stream_t buffer;
+            deflate_write_stream_t deflater;
+
+        private:
+            DISABLE_COPYING(compressor_t);
+        };
+
+        class stripe_t {
+        public:
+            stripe_t(tcp_conn_stream_t *c, bool compress)
+                : conn(c), compressor(compress ? new compressor_t : NULL) { }
+
+            tcp_conn_stream_t *const conn;
+            mutex_t send_mutex;
+            /* NULL unless we compress what we send over `conn` */
+            scoped_ptr_t<compressor_t> compressor;
+
+        private:
+            DISABLE_COPYING(stripe_t);
+        };
+
+        /* The stripes of one control connection, which `handle()` keeps on our
+        thread while the control connection is up. */
+        class stripe_set_t {
+        public:
+            stripe_set_t(peer_id_t _peer, size_t num_stripes)
+                : peer(_peer), reads_seen(0), writes_seen(0),
+                  stripes(num_stripes, NULL), num_established(0) { }
+
+            const peer_id_t peer;
+
+            /* Set on the stripes' threads when they read from or write to the
+            peer, and taken by the control connection's heartbeat, so that the
+            traffic on the stripes counts towards the peer's liveness. */
+            volatile intptr_t reads_seen;
+            volatile intptr_t writes_seen;
+
+            /* Filled in by the stripes as they're established */
+            std::vector<stripe_t *> stripes;
+            size_t num_established;
+            cond_t all_established;
+
+            /* Pulsed once the peer counts as connected. The stripes don't read
+            messages from the peer before that. */
+            cond_t connected;
+
+            /* Pulsed when any of the stripes closes */
+            cond_t closed;
+
+            /* Once the peer doesn't count as connected any more, this drains,
+            which closes the stripes. */
+            auto_drainer_t drainer;
+
+        private:
+            DISABLE_COPYING(stripe_set_t);
+        };
+
+        /* What a connection is for. The node that opened the connection sends
+        this at the end of its header; the other node sends a default one,
+        except for `compressed`, which both nodes fill in. */
+        struct connection_kind_t {
+            static const int32_t control_stripe = -1;
+
+            connection_kind_t()
+                : stripe(control_stripe), num_stripes(0), compressed(false) { }
+
+            /* The id of the control connection, which its stripes send too */
+            uuid_u connection_id;
+            /* Which stripe of the control connection this is, or
+            `control_stripe` if this is the control connection */
+            int32_t stripe;
+            /* How many stripes the control connection will have */
+            int32_t num_stripes;
+            /* Whether the node compresses the messages it sends over the
+            connection. Each node decides that for itself. */
+            bool compressed;
+        };
+
         class connection_entry_t : public home_thread_mixin_debug_only_t {
         public:
             /* The constructor registers us in every thread's `connection_map`;
             the destructor deregisters us. Both also notify all subscribers. */
             connection_entry_t(run_t *, peer_id_t, tcp_conn_stream_t *,
-                               const peer_address_t &peer) THROWS_NOTHING;
+                               const std::vector<stripe_t *> &stripes,
+                               const peer_address_t &peer,
+                               bool compress) THROWS_NOTHING;
             ~connection_entry_t() THROWS_NOTHING;
 
             /* NULL for our "connection" to ourself */
             tcp_conn_stream_t *conn;
 
+            /* The stripes of `conn`, which stay up as long as it does. Empty for
+            our connection to ourself, or if the node that opened `conn` didn't
+            open any. */
+            const std::vector<stripe_t *> stripes;
+
             /* `connection_t` contains the addresses so that we can call
             `get_peers_list()` on any thread. Otherwise, we would have to go
             cross-thread to access the routing table. */
@@ -108,12 +216,28 @@ public:
 
             /* Unused for our connection to ourself */
             mutex_t send_mutex;
+            /* Counts the bytes of the messages that are waiting to be written
+            to `conn` or its stripes, or are being written. See
+            `CLUSTER_SEND_QUEUE_PEER_BYTES`. */
+            new_semaphore_t send_queue_semaphore;
+            /* NULL unless we compress what we send over `conn` */
+            scoped_ptr_t<compressor_t> compressor;
 
             uuid_u session_id;
 
+            /* `pm_bytes_sent` counts the bytes of the messages we send, and
+            `pm_bytes_sent_compressed` what they compressed to, over `conn` and
+            its stripes. `pm_send_queue_bytes` is how many bytes of messages
+            are queued to be sent, including those waiting for room in
+            `send_queue_semaphore`. */
             perfmon_collection_t pm_collection;
             perfmon_sampler_t pm_bytes_sent;
-            perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership;
+            perfmon_sampler_t pm_bytes_sent_compressed;
+            perfmon_duration_sampler_t pm_compression;
+            perfmon_counter_t pm_send_queue_bytes;
+            perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership,
+                pm_bytes_sent_compressed_membership, pm_compression_membership,
+                pm_send_queue_bytes_membership;
 
         private:
             /* We only hold this information so we can deregister ourself */
@@ -193,7 +317,48 @@ public:
             boost::optional<peer_id_t> expected_id,
             boost::optional<peer_address_t> expected_address,
             auto_drainer_t::lock_t,
-            bool *successful_join) THROWS_NOTHING;
+            bool *successful_join,
+            const ip_and_port_t *dialed_address) THROWS_NOTHING;
+
+        /* Sends our header over `conn` and receives and checks the other
+        node's. Returns false if the connection should be closed. */
+        bool exchange_headers(keepalive_tcp_conn_stream_t *conn,
+                              const char *peername,
+                              const connection_kind_t &our_kind,
+                              peer_id_t *other_id_out,
+                              std::set<host_and_port_t> *other_peer_addr_hosts_out,
+                              connection_kind_t *other_kind_out) THROWS_NOTHING;
+
+        /* Opens a connection to `address`. If the address is one of ours, the
+        peer is on this host, and we try its local socket (see
+        `local_listener`) before falling back to TCP. Throws like the
+        `tcp_conn_t` constructor. */
+        keepalive_tcp_conn_stream_t *open_connection(const ip_and_port_t &address,
+                                                     signal_t *interruptor,
+                                                     int local_port);
+
+        /* `connect_stripe()` is spawned by `handle()` for each stripe of a
+        control connection that we opened. */
+        void connect_stripe(ip_and_port_t address,
+                            peer_id_t expected_id,
+                            connection_kind_t kind,
+                            stripe_set_t *stripe_set,
+                            auto_drainer_t::lock_t stripe_set_lock) THROWS_NOTHING;
+
+        /* `handle_stripe()` is responsible for the lifetime of a stripe once
+        the headers have been exchanged, on either node. */
+        void handle_stripe(keepalive_tcp_conn_stream_t *conn,
+                           peer_id_t other_id,
+                           bool other_compresses,
+                           int32_t index,
+                           stripe_set_t *stripe_set,
+                           auto_drainer_t::lock_t stripe_set_lock) THROWS_NOTHING;
+
+        /* Passes the messages that come in over `conn` to `message_handler`
+        until it closes. `compressed` says whether the other node compresses
+        them. */
+        void receive_messages(peer_id_t other_id, tcp_conn_stream_t *conn,
+                              bool compressed) THROWS_NOTHING;
 
         connectivity_cluster_t *parent;
 
@@ -201,6 +366,15 @@ public:
 
         heartbeat_manager_t *heartbeat_manager;
 
+        /* If not NULL, every connection to or from a peer starts with a TLS
+        handshake, and peers are authenticated if `tls_ctx` has CA certificates.
+        Every node in the cluster must use TLS, or none. */
+        tls_ctx_t *tls_ctx;
+
+        /* Whether we compress the messages we send to peers. Each peer decides
+        for itself, and tells the other in its header. */
+        bool compress_messages;
+
         /* `attempt_table` is a table of all the host:port pairs we're currently
         trying to connect to or have connected to. If we are told to connect to
         an address already in this table, we'll just ignore it. That's important
@@ -220,6 +394,10 @@ public:
         redundant connections to the same peer. */
         mutex_t new_connection_mutex;
 
+        /* The stripe sets of the control connections that other nodes opened to
+        us and that are still waiting for their stripes, by connection id. */
+        std::map<uuid_u, stripe_set_t *> pending_stripe_sets;
+
         scoped_ptr_t<tcp_bound_socket_t> cluster_listener_socket;
         int cluster_listener_port;
         int cluster_client_port;
@@ -237,6 +415,14 @@ public:
         /* This must be destroyed before `drainer` is. */
         scoped_ptr_t<tcp_listener_t> listener;
 
+        /* Peers on the same host connect to us over this, which skips the TCP
+        stack, rather than over `listener`. It's named after our cluster port,
+        so we only have it if we listen on all addresses; otherwise another
+        process on this host could be listening on the same port on other
+        addresses. Empty if that's not the case or if binding it failed. This
+        must be destroyed before `drainer` is. */
+        scoped_ptr_t<local_listener_t> local_listener;
+
         /* A place to put our stats */
     };
 
@@ -251,6 +437,8 @@ public:
     /* `message_service_t` public methods: */
     connectivity_service_t *get_connectivity_service() THROWS_NOTHING;
     void send_message(peer_id_t, send_message_write_callback_t *callback) THROWS_NOTHING;
+    void send_striped_message(peer_id_t, uint64_t stripe,
+                              send_message_write_callback_t *callback) THROWS_NOTHING;
     void kill_connection(peer_id_t) THROWS_NOTHING;
 
     /* Other public methods: */
@@ -265,6 +453,8 @@ private:
 
     class thread_info_t {
     public:
+        thread_info_t();
+
         /* `connection_map` holds open connections to other peers. It's the same
         on every thread. It has an entry for every peer that we are fully and
         officially connected to, not including us.  That means it's a subset of
@@ -277,8 +467,22 @@ private:
         rwi_lock_assertion_t lock;
 
         publisher_controller_t<peers_list_callback_t *> publisher;
+
+        /* Empty vectors that `send_message_on()` serialized earlier messages
+        into, kept so that serializing the next one doesn't have to allocate.
+        See `CLUSTER_SEND_BUFFER_POOL_SIZE`. */
+        std::vector<std::vector<char> > send_buffers;
+
+        /* Counts the bytes of the messages this thread is sending to other
+        peers. See `CLUSTER_SEND_QUEUE_THREAD_BYTES`. */
+        new_semaphore_t send_queue_semaphore;
     };
 
+    /* Sends the message over the stripe that `stripe` picks, or over the
+    control connection if `stripe` is empty or the peer has no stripes. */
+    void send_message_on(peer_id_t, const boost::optional<uint64_t> &stripe,
+                         send_message_write_callback_t *callback) THROWS_NOTHING;
+
     /* `connectivity_service_t` private methods: */
     rwi_lock_assertion_t *get_peers_list_lock() THROWS_NOTHING;
     publisher_t<peers_list_callback_t *> *get_peers_list_publisher() THROWS_NOTHING;
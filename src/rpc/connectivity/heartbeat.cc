@@ -1,9 +1,46 @@
 #include "rpc/connectivity/heartbeat.hpp"
 
+#include <math.h>
+
+#include <algorithm>
 #include <functional>
 
 #include "logger.hpp"
 
+// How unlikely a peer's silence must be for us to drop it. A `phi` of 8 means the
+// peer had a 1 in 10^8 chance of being silent for this long.
+static const double HEARTBEAT_PHI_THRESHOLD = 8.0;
+
+phi_accrual_detector_t::phi_accrual_detector_t() :
+    interval_sum(0), interval_squares_sum(0) { }
+
+void phi_accrual_detector_t::heard_after(int64_t interval_ms) {
+    intervals.push_back(interval_ms);
+    interval_sum += interval_ms;
+    interval_squares_sum += static_cast<double>(interval_ms) * interval_ms;
+    if (intervals.size() > WINDOW_SIZE) {
+        const int64_t oldest = intervals.front();
+        intervals.pop_front();
+        interval_sum -= oldest;
+        interval_squares_sum -= static_cast<double>(oldest) * oldest;
+    }
+}
+
+double phi_accrual_detector_t::phi(int64_t silent_ms) const {
+    if (intervals.empty()) {
+        return 0;
+    }
+    const double mean = interval_sum / intervals.size();
+    const double variance = std::max(0.0, interval_squares_sum / intervals.size() - mean * mean);
+    const double standard_deviation = std::max(sqrt(variance),
+                                               static_cast<double>(MIN_STANDARD_DEVIATION_MS));
+    // The probability that a normally distributed interval is longer than
+    // `silent_ms`.
+    const double z = (silent_ms - mean) / standard_deviation;
+    const double p_later = 0.5 * erfc(z / M_SQRT2);
+    return -log10(p_later);
+}
+
 heartbeat_manager_t::heartbeat_manager_t(message_service_t *_message_service) :
     message_service(_message_service) {
     // Do nothing
@@ -74,9 +111,21 @@ void heartbeat_manager_t::on_timer() {
             write_done = it->second.tracker->check_and_reset_writes();
         }
 
-        if (it->second.outstanding >= HEARTBEAT_TIMEOUT_INTERVALS) {
+        if (read_done) {
+            // We heard from the peer since the last timer, so it's alive
+            if (it->second.outstanding > 0) {
+                it->second.detector.heard_after(it->second.outstanding * HEARTBEAT_INTERVAL_MS);
+            }
+            it->second.outstanding = 0;
+        }
+
+        const int64_t silent_ms = it->second.outstanding * HEARTBEAT_INTERVAL_MS;
+        if (it->second.outstanding >= HEARTBEAT_MAX_TIMEOUT_INTERVALS
+            || (it->second.outstanding >= HEARTBEAT_TIMEOUT_INTERVALS
+                && it->second.detector.phi(silent_ms) > HEARTBEAT_PHI_THRESHOLD)) {
             const std::string peer_str(uuid_to_str(it->first.get_uuid()).c_str());
-            logERR("Heartbeat timeout, killing connection to peer: %s.", peer_str.c_str());
+            logERR("Heartbeat timeout after %" PRIi64 " ms, killing connection to peer: %s.",
+                   silent_ms, peer_str.c_str());
             coro_t::spawn_later_ordered(std::bind(&heartbeat_manager_t::kill_connection_wrapper,
                                                   self,
                                                   it->first,
@@ -89,11 +138,6 @@ void heartbeat_manager_t::on_timer() {
                                                   auto_drainer_t::lock_t(&data->drainer)));
         }
 
-        if (read_done) {
-            // If we've read data from the socket since the last timer, clear the outstanding acks
-            it->second.outstanding = 0;
-        }
-
         ++it->second.outstanding;
     }
 }
@@ -2,6 +2,7 @@
 #ifndef RPC_CONNECTIVITY_HEARTBEAT_HPP_
 #define RPC_CONNECTIVITY_HEARTBEAT_HPP_
 
+#include <deque>
 #include <map>
 
 #include "arch/timer.hpp"
@@ -11,6 +12,30 @@
 #include "rpc/connectivity/messages.hpp"
 #include "utils.hpp"
 
+/* `phi_accrual_detector_t` decides how suspicious it is that we haven't heard
+from a peer for a while, in the manner of a phi accrual failure detector. It
+learns how far apart the peer's traffic usually arrives, and `phi()` is the
+negative base-10 logarithm of the probability that the peer would be silent for
+as long as it has been. A peer whose traffic has been arriving irregularly, e.g.
+because its connections are busy with a backfill, gets more time than one whose
+traffic has been arriving like clockwork. */
+class phi_accrual_detector_t {
+public:
+    phi_accrual_detector_t();
+
+    /* Records that we heard from the peer `interval_ms` after the time before. */
+    void heard_after(int64_t interval_ms);
+
+    double phi(int64_t silent_ms) const;
+
+private:
+    static const size_t WINDOW_SIZE = 100;
+    static const int64_t MIN_STANDARD_DEVIATION_MS = 1000;
+
+    std::deque<int64_t> intervals;
+    double interval_sum;
+    double interval_squares_sum;
+};
 
 class heartbeat_manager_t : public message_handler_t, private timer_callback_t {
 public:
@@ -22,7 +47,8 @@ public:
 
     void message_from_peer(const peer_id_t &source_peer);
 
-    // Callback class which keeps track of traffic on the connection
+    // Callback class which keeps track of traffic with the peer. Any traffic we
+    // receive from the peer shows that it's alive, not just heartbeats.
     class heartbeat_keepalive_tracker_t {
     public:
         virtual ~heartbeat_keepalive_tracker_t() { }
@@ -34,7 +60,10 @@ public:
 
 private:
     static const int64_t HEARTBEAT_INTERVAL_MS = 2000;
+    // A peer is never dropped sooner than this, and always once it's been
+    // silent for the maximum. In between, its `phi_accrual_detector_t` decides.
     static const uint32_t HEARTBEAT_TIMEOUT_INTERVALS = 5;
+    static const uint32_t HEARTBEAT_MAX_TIMEOUT_INTERVALS = 30;
 
     void on_timer();
 
@@ -56,7 +85,9 @@ private:
 
         struct conn_data_t {
             conn_data_t();
+            // The number of timer intervals since we last heard from the peer
             uint32_t outstanding;
+            phi_accrual_detector_t detector;
             heartbeat_keepalive_tracker_t *tracker;
         };
 
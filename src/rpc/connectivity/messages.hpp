@@ -55,6 +55,12 @@ public:
 class message_service_t  {
 public:
     virtual void send_message(peer_id_t dest_peer, send_message_write_callback_t *callback) = 0;
+    /* Like `send_message()`, but the message may go over a different connection
+    to the peer than the cluster's control traffic does, so that bulk traffic
+    doesn't hold the control traffic up. Messages are only guaranteed to arrive
+    in the order they were sent if they have the same `stripe`. */
+    virtual void send_striped_message(peer_id_t dest_peer, uint64_t stripe,
+                                      send_message_write_callback_t *callback) = 0;
     virtual void kill_connection(peer_id_t dest_peer) = 0;
     virtual connectivity_service_t *get_connectivity_service() = 0;
 protected:
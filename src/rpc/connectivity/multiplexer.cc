@@ -100,6 +100,16 @@ void message_multiplexer_t::client_t::send_message(peer_id_t dest, send_message_
     }
 }
 
+void message_multiplexer_t::client_t::send_striped_message(peer_id_t dest, uint64_t stripe,
+                                                           send_message_write_callback_t *callback) {
+    tagged_message_writer_t writer(tag, callback);
+    {
+        semaphore_acq_t outstanding_write_acq (outstanding_writes_semaphores.get());
+        parent->message_service->send_striped_message(dest, stripe, &writer);
+        // Release outstanding_writes_semaphore
+    }
+}
+
 void message_multiplexer_t::client_t::kill_connection(peer_id_t peer) {
     parent->message_service->kill_connection(peer);
 }
@@ -0,0 +1,132 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rpc/directory/delta.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "containers/archive/varint.hpp"
+
+directory_delta_t::directory_delta_t()
+    : old_size_(0), prefix_size_(0), suffix_size_(0) { }
+
+directory_delta_t::directory_delta_t(const std::vector<char> &old_data,
+                                     const std::vector<char> &new_data)
+    : old_size_(old_data.size()) {
+    const size_t max_common = std::min(old_data.size(), new_data.size());
+    size_t prefix = 0;
+    while (prefix < max_common && old_data[prefix] == new_data[prefix]) {
+        ++prefix;
+    }
+    // The suffix can't overlap the prefix in either value.
+    size_t suffix = 0;
+    while (suffix < max_common - prefix
+           && old_data[old_data.size() - suffix - 1] == new_data[new_data.size() - suffix - 1]) {
+        ++suffix;
+    }
+    prefix_size_ = prefix;
+    suffix_size_ = suffix;
+    middle_.assign(new_data.begin() + prefix, new_data.end() - suffix);
+}
+
+bool directory_delta_t::apply(const std::vector<char> &old_data,
+                              std::vector<char> *new_data_out) const {
+    if (old_data.size() != old_size_ || prefix_size_ + suffix_size_ > old_size_) {
+        return false;
+    }
+    new_data_out->clear();
+    new_data_out->reserve(prefix_size_ + middle_.size() + suffix_size_);
+    new_data_out->insert(new_data_out->end(),
+                         old_data.begin(), old_data.begin() + prefix_size_);
+    new_data_out->insert(new_data_out->end(), middle_.begin(), middle_.end());
+    new_data_out->insert(new_data_out->end(),
+                         old_data.end() - suffix_size_, old_data.end());
+    return true;
+}
+
+void directory_delta_t::rdb_serialize(write_message_t &msg) const {  // NOLINT(runtime/references)
+    serialize_varint_uint64(&msg, old_size_);
+    serialize_varint_uint64(&msg, prefix_size_);
+    serialize_varint_uint64(&msg, suffix_size_);
+    serialize_directory_data(&msg, middle_);
+}
+
+archive_result_t directory_delta_t::rdb_deserialize(read_stream_t *s) {
+    archive_result_t res = deserialize_varint_uint64(s, &old_size_);
+    if (res) { return res; }
+    res = deserialize_varint_uint64(s, &prefix_size_);
+    if (res) { return res; }
+    res = deserialize_varint_uint64(s, &suffix_size_);
+    if (res) { return res; }
+    return deserialize_directory_data(s, &middle_);
+}
+
+directory_update_t::directory_update_t() : version_(0), is_delta_(false) { }
+
+directory_update_t::directory_update_t(uint64_t version,
+                                       const std::vector<char> &old_data,
+                                       const std::vector<char> &new_data)
+    : version_(version), delta_(old_data, new_data) {
+    // The delta also carries three sizes, which is a few bytes at most.
+    is_delta_ = delta_.size() + 16 < new_data.size();
+    if (!is_delta_) {
+        data_ = new_data;
+        delta_ = directory_delta_t();
+    }
+}
+
+bool directory_update_t::apply(uint64_t old_version,
+                               const std::vector<char> &old_data,
+                               std::vector<char> *new_data_out) const {
+    if (!is_delta_) {
+        *new_data_out = data_;
+        return true;
+    }
+    return old_version + 1 == version_ && delta_.apply(old_data, new_data_out);
+}
+
+void directory_update_t::rdb_serialize(write_message_t &msg) const {  // NOLINT(runtime/references)
+    serialize_varint_uint64(&msg, version_);
+    msg << is_delta_;
+    if (is_delta_) {
+        msg << delta_;
+    } else {
+        serialize_directory_data(&msg, data_);
+    }
+}
+
+archive_result_t directory_update_t::rdb_deserialize(read_stream_t *s) {
+    archive_result_t res = deserialize_varint_uint64(s, &version_);
+    if (res) { return res; }
+    res = deserialize(s, &is_delta_);
+    if (res) { return res; }
+    if (is_delta_) {
+        return deserialize(s, &delta_);
+    } else {
+        return deserialize_directory_data(s, &data_);
+    }
+}
+
+void serialize_directory_data(write_message_t *msg, const std::vector<char> &data) {
+    serialize_varint_uint64(msg, data.size());
+    msg->append(data.data(), data.size());
+}
+
+archive_result_t deserialize_directory_data(read_stream_t *s,
+                                            std::vector<char> *data_out) {
+    uint64_t size;
+    archive_result_t res = deserialize_varint_uint64(s, &size);
+    if (res) { return res; }
+    if (size > std::numeric_limits<size_t>::max()) {
+        return ARCHIVE_RANGE_ERROR;
+    }
+
+    data_out->resize(size);
+    int64_t num_read = force_read(s, data_out->data(), size);
+    if (num_read == -1) {
+        return ARCHIVE_SOCK_ERROR;
+    }
+    if (static_cast<uint64_t>(num_read) < size) {
+        return ARCHIVE_SOCK_EOF;
+    }
+    return ARCHIVE_SUCCESS;
+}
@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RPC_DIRECTORY_DELTA_HPP_
+#define RPC_DIRECTORY_DELTA_HPP_
+
+#include <vector>
+
+#include "containers/archive/archive.hpp"
+#include "rpc/serialize_macros.hpp"
+
+/* `directory_delta_t` turns one serialized metadata value into another.  It
+keeps the bytes the two have in common at the start and at the end, and carries
+the bytes in between.  Usually only a small part of the directory metadata
+changes at a time, so the delta is much smaller than the metadata. */
+class directory_delta_t {
+public:
+    directory_delta_t();
+    directory_delta_t(const std::vector<char> &old_data,
+                      const std::vector<char> &new_data);
+
+    /* Fails if `old_data` can't be what the delta was computed against. */
+    MUST_USE bool apply(const std::vector<char> &old_data,
+                        std::vector<char> *new_data_out) const;
+
+    /* How many bytes of the new value the delta carries. */
+    size_t size() const { return middle_.size(); }
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+
+private:
+    uint64_t old_size_;
+    uint64_t prefix_size_;
+    uint64_t suffix_size_;
+    std::vector<char> middle_;
+};
+
+/* `directory_update_t` is what the directory write manager sends when its
+metadata changes.  It's either all of the new serialized metadata or a delta
+against the serialized metadata it sent before, whichever is smaller.  The
+versions count up by one with every update, so the receiving end can check that
+a delta applies to the value it has. */
+class directory_update_t {
+public:
+    directory_update_t();
+    directory_update_t(uint64_t version,
+                       const std::vector<char> &old_data,
+                       const std::vector<char> &new_data);
+
+    uint64_t version() const { return version_; }
+
+    /* Fails if this is a delta that doesn't apply to `old_data`, which should
+    be the serialized metadata of version `version() - 1`. */
+    MUST_USE bool apply(uint64_t old_version,
+                        const std::vector<char> &old_data,
+                        std::vector<char> *new_data_out) const;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+
+private:
+    uint64_t version_;
+    bool is_delta_;
+    /* The new serialized metadata, if this isn't a delta. */
+    std::vector<char> data_;
+    directory_delta_t delta_;
+};
+
+/* Raw byte vectors are serialized as a size followed by the bytes, rather than
+the generic `std::vector` serialization's one element at a time. */
+void serialize_directory_data(write_message_t *msg, const std::vector<char> &data);
+MUST_USE archive_result_t deserialize_directory_data(read_stream_t *s,
+                                                     std::vector<char> *data_out);
+
+#endif  // RPC_DIRECTORY_DELTA_HPP_
@@ -2,6 +2,8 @@
 #ifndef RPC_DIRECTORY_READ_MANAGER_HPP_
 #define RPC_DIRECTORY_READ_MANAGER_HPP_
 
+#include <vector>
+
 #include "errors.hpp"
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/shared_ptr.hpp>
@@ -15,6 +17,8 @@
 #include "rpc/connectivity/messages.hpp"
 #include "containers/incremental_lenses.hpp"
 
+class directory_update_t;
+
 template<class metadata_t>
 class directory_read_manager_t :
     public home_thread_mixin_t,
@@ -33,12 +37,16 @@ private:
     when they disconnect. A new `session_t` is created if they reconnect. */
     class session_t {
     public:
-        explicit session_t(uuid_u si) : session_id(si) { }
+        explicit session_t(uuid_u si) : session_id(si), data_version(0) { }
         /* We get this by calling `get_connection_session_id()` on the
         `connectivity_service_t` from `super_connectivity_service`. */
         const uuid_u session_id;
         cond_t got_initial_message;
         scoped_ptr_t<fifo_enforcer_sink_t> metadata_fifo_sink;
+        /* The serialization of the peer's current value, which its next update
+        may be a delta against, and its version. */
+        std::vector<char> data;
+        uint64_t data_version;
         auto_drainer_t drainer;
     };
 
@@ -57,8 +65,8 @@ private:
      * They assume ownership of new_value. Semantically, the argument here is `metadata_t &&new_value`
      * but we cannot easily pass that through to the coroutine call, which is why
      * we use boost::shared_ptr instead. */
-    void propagate_initialization(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING;
-    void propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING;
+    void propagate_initialization(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, const boost::shared_ptr<std::vector<char> > &initial_data, uint64_t version, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING;
+    void propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<directory_update_t> &update, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING;
     void interrupt_updates_and_free_session(session_t *session, auto_drainer_t::lock_t global_keepalive) THROWS_NOTHING;
 
     /* The connectivity service telling us which peers are connected */
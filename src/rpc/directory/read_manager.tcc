@@ -4,12 +4,17 @@
 
 #include "rpc/directory/read_manager.hpp"
 
+#include <inttypes.h>
+
 #include <map>
 #include <utility>
 
 #include "concurrency/wait_any.hpp"
 #include "config/args.hpp"
 #include "containers/archive/archive.hpp"
+#include "containers/archive/varint.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "rpc/directory/delta.hpp"
 
 template<class metadata_t>
 directory_read_manager_t<metadata_t>::directory_read_manager_t(connectivity_service_t *conn_serv) THROWS_NOTHING :
@@ -49,12 +54,19 @@ void directory_read_manager_t<metadata_t>::on_message(peer_id_t source_peer,
         case 'I': {
             /* Initial message from another peer */
             boost::shared_ptr<metadata_t> initial_value(new metadata_t());
+            boost::shared_ptr<std::vector<char> > initial_data(new std::vector<char>());
+            uint64_t version;
             fifo_enforcer_state_t metadata_fifo_state;
             {
-                archive_result_t res = deserialize(s, initial_value.get());
+                archive_result_t res = deserialize_varint_uint64(s, &version);
+                if (res != ARCHIVE_SUCCESS) { throw fake_archive_exc_t(); }
+                res = deserialize_directory_data(s, initial_data.get());
                 if (res != ARCHIVE_SUCCESS) { throw fake_archive_exc_t(); }
                 res = deserialize(s, &metadata_fifo_state);
                 if (res != ARCHIVE_SUCCESS) { throw fake_archive_exc_t(); }
+                inplace_vector_read_stream_t data_stream(initial_data.get());
+                res = deserialize(&data_stream, initial_value.get());
+                if (res != ARCHIVE_SUCCESS) { throw fake_archive_exc_t(); }
             }
 
             /* Spawn a new coroutine because we might not be on the home thread
@@ -62,18 +74,20 @@ void directory_read_manager_t<metadata_t>::on_message(peer_id_t source_peer,
             coro_t::spawn_sometime(boost::bind(
                 &directory_read_manager_t::propagate_initialization, this,
                 source_peer, connectivity_service->get_connection_session_id(source_peer),
-                initial_value, metadata_fifo_state,
+                initial_value, initial_data, version, metadata_fifo_state,
                 auto_drainer_t::lock_t(per_thread_drainers.get())));
 
             break;
         }
 
         case 'U': {
-            /* Update from another peer */
-            boost::shared_ptr<metadata_t> new_value(new metadata_t());
+            /* Update from another peer. It may be a delta against the peer's
+            previous value, so it can only be applied once it's this update's
+            turn. */
+            boost::shared_ptr<directory_update_t> update(new directory_update_t());
             fifo_enforcer_write_token_t metadata_fifo_token;
             {
-                archive_result_t res = deserialize(s, new_value.get());
+                archive_result_t res = deserialize(s, update.get());
                 if (res != ARCHIVE_SUCCESS) { throw fake_archive_exc_t(); }
                 res = deserialize(s, &metadata_fifo_token);
                 if (res != ARCHIVE_SUCCESS) { throw fake_archive_exc_t(); }
@@ -84,7 +98,7 @@ void directory_read_manager_t<metadata_t>::on_message(peer_id_t source_peer,
             coro_t::spawn_sometime(boost::bind(
                 &directory_read_manager_t::propagate_update, this,
                 source_peer, connectivity_service->get_connection_session_id(source_peer),
-                new_value, metadata_fifo_token,
+                update, metadata_fifo_token,
                 auto_drainer_t::lock_t(per_thread_drainers.get())));
 
             break;
@@ -134,7 +148,7 @@ void directory_read_manager_t<metadata_t>::on_disconnect(peer_id_t peer) THROWS_
 }
 
 template<class metadata_t>
-void directory_read_manager_t<metadata_t>::propagate_initialization(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
+void directory_read_manager_t<metadata_t>::propagate_initialization(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &initial_value, const boost::shared_ptr<std::vector<char> > &initial_data, uint64_t version, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
     per_thread_keepalive.assert_is_holding(per_thread_drainers.get());
     on_thread_t thread_switcher(home_thread());
 
@@ -178,11 +192,13 @@ void directory_read_manager_t<metadata_t>::propagate_initialization(peer_id_t pe
     // that it'll be initialized only once.
     session->metadata_fifo_sink.reset();
     session->metadata_fifo_sink.init(new fifo_enforcer_sink_t(metadata_fifo_state));
+    session->data.swap(*initial_data);
+    session->data_version = version;
     session->got_initial_message.pulse();
 }
 
 template<class metadata_t>
-void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
+void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<directory_update_t> &update, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
     per_thread_keepalive.assert_is_holding(per_thread_drainers.get());
     on_thread_t thread_switcher(home_thread());
 
@@ -223,6 +239,23 @@ void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid
         //  3. Reshard the table to 32 shards
         coro_t::yield();
 
+        /* The FIFO hands us the peer's updates in the order it sent them, so a
+        delta always applies to the value we have. A peer that reconnects
+        starts a new session with its full value, so there are never any gaps
+        in between. */
+        std::vector<char> new_data;
+        guarantee(update->apply(session->data_version, session->data, &new_data),
+                  "Directory update %" PRIu64 " doesn't apply to version %" PRIu64 ".",
+                  update->version(), session->data_version);
+        boost::shared_ptr<metadata_t> new_value(new metadata_t());
+        {
+            inplace_vector_read_stream_t data_stream(&new_data);
+            archive_result_t res = deserialize(&data_stream, new_value.get());
+            guarantee_deserialization(res, "directory update");
+        }
+        session->data.swap(new_data);
+        session->data_version = update->version();
+
         {
             DEBUG_VAR mutex_assertion_t::acq_t acq(&variable_lock);
 
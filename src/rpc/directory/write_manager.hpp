@@ -2,6 +2,8 @@
 #ifndef RPC_DIRECTORY_WRITE_MANAGER_HPP_
 #define RPC_DIRECTORY_WRITE_MANAGER_HPP_
 
+#include <vector>
+
 #include "errors.hpp"
 #include <boost/shared_ptr.hpp>
 
@@ -10,6 +12,7 @@
 #include "concurrency/watchable.hpp"
 #include "rpc/connectivity/connectivity.hpp"
 
+class directory_update_t;
 class message_service_t;
 
 template<class metadata_t>
@@ -25,14 +28,20 @@ private:
     void on_disconnect(UNUSED peer_id_t p) { }
     void on_change() THROWS_NOTHING;
 
-    void send_initialization(peer_id_t peer, const metadata_t &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
-    void send_update(peer_id_t peer, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+    static boost::shared_ptr<const std::vector<char> > serialize_value(const metadata_t &value);
+
+    void send_initialization(peer_id_t peer, const boost::shared_ptr<const std::vector<char> > &initial_data, uint64_t version, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+    void send_update(peer_id_t peer, const boost::shared_ptr<const directory_update_t> &update, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
 
     class initialization_writer_t;
     class update_writer_t;
 
     message_service_t *const message_service;
     clone_ptr_t<watchable_t<metadata_t> > value_watchable;
+    /* The serialization of the value we sent last, and its version.  New peers
+    get it in full, and updates are deltas against it. */
+    boost::shared_ptr<const std::vector<char> > last_data;
+    uint64_t last_version;
     fifo_enforcer_source_t metadata_fifo_source;
     auto_drainer_t drainer;
     typename watchable_t<metadata_t>::subscription_t value_subscription;
@@ -7,7 +7,10 @@
 #include <set>
 
 #include "arch/runtime/coroutines.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "containers/archive/varint.hpp"
 #include "rpc/connectivity/messages.hpp"
+#include "rpc/directory/delta.hpp"
 
 template<class metadata_t>
 directory_write_manager_t<metadata_t>::directory_write_manager_t(
@@ -15,11 +18,13 @@ directory_write_manager_t<metadata_t>::directory_write_manager_t(
         const clone_ptr_t<watchable_t<metadata_t> > &value) THROWS_NOTHING :
     message_service(sub),
     value_watchable(value),
+    last_version(0),
     value_subscription(boost::bind(&directory_write_manager_t::on_change, this)),
     connectivity_subscription(this) {
     typename watchable_t<metadata_t>::freeze_t value_freeze(value_watchable);
     connectivity_service_t::peers_list_freeze_t connectivity_freeze(message_service->get_connectivity_service());
     guarantee(message_service->get_connectivity_service()->get_peers_list().empty());
+    last_data = serialize_value(value_watchable->get());
     value_subscription.reset(value_watchable, &value_freeze);
     connectivity_subscription.reset(message_service->get_connectivity_service(), &connectivity_freeze);
 }
@@ -33,7 +38,7 @@ void directory_write_manager_t<metadata_t>::on_connect(peer_id_t peer) THROWS_NO
     coro_t::spawn_sometime(boost::bind(
         &directory_write_manager_t::send_initialization, this,
         peer,
-        value_watchable->get(), metadata_fifo_source.get_state(),
+        last_data, last_version, metadata_fifo_source.get_state(),
         auto_drainer_t::lock_t(&drainer)));
 }
 
@@ -46,28 +51,47 @@ void directory_write_manager_t<metadata_t>::on_change() THROWS_NOTHING {
     connectivity_service_t::peers_list_freeze_t freeze(message_service->get_connectivity_service());
     fifo_enforcer_write_token_t metadata_fifo_token = metadata_fifo_source.enter_write();
     std::set<peer_id_t> peers = message_service->get_connectivity_service()->get_peers_list();
-    boost::shared_ptr<metadata_t> new_value(new metadata_t(std::move(value_watchable->get())));
+    /* Every peer gets the same update, so we serialize the value only once. */
+    boost::shared_ptr<const std::vector<char> > new_data = serialize_value(value_watchable->get());
+    ++last_version;
+    boost::shared_ptr<const directory_update_t> update(
+        new directory_update_t(last_version, *last_data, *new_data));
+    last_data = new_data;
     for (std::set<peer_id_t>::iterator it = peers.begin(); it != peers.end(); it++) {
         coro_t::spawn_sometime(boost::bind(
             &directory_write_manager_t::send_update, this,
             *it,
-            new_value, metadata_fifo_token,
+            update, metadata_fifo_token,
             auto_drainer_t::lock_t(&drainer)));
     }
 }
 
+template<class metadata_t>
+boost::shared_ptr<const std::vector<char> > directory_write_manager_t<metadata_t>::serialize_value(const metadata_t &value) {
+    write_message_t msg;
+    msg << value;
+    vector_stream_t stream;
+    stream.reserve(msg.size());
+    int res = send_write_message(&stream, &msg);
+    guarantee(res == 0);
+    boost::shared_ptr<std::vector<char> > data(new std::vector<char>());
+    stream.swap(data.get());
+    return data;
+}
+
 template <class metadata_t>
 class directory_write_manager_t<metadata_t>::initialization_writer_t : public send_message_write_callback_t {
 public:
-    initialization_writer_t(const metadata_t &_initial_value, fifo_enforcer_state_t _metadata_fifo_state) :
-        initial_value(_initial_value), metadata_fifo_state(_metadata_fifo_state) { }
+    initialization_writer_t(const std::vector<char> &_initial_data, uint64_t _version, fifo_enforcer_state_t _metadata_fifo_state) :
+        initial_data(_initial_data), version(_version), metadata_fifo_state(_metadata_fifo_state) { }
     ~initialization_writer_t() { }
 
     void write(write_stream_t *stream) {
         write_message_t msg;
         uint8_t code = 'I';
         msg << code;
-        msg << initial_value;
+        serialize_varint_uint64(&msg, version);
+        serialize_directory_data(&msg, initial_data);
         msg << metadata_fifo_state;
         int res = send_write_message(stream, &msg);
         if (res) {
@@ -75,22 +99,23 @@ public:
         }
     }
 private:
-    const metadata_t &initial_value;
+    const std::vector<char> &initial_data;
+    uint64_t version;
     fifo_enforcer_state_t metadata_fifo_state;
 };
 
 template <class metadata_t>
 class directory_write_manager_t<metadata_t>::update_writer_t : public send_message_write_callback_t {
 public:
-    update_writer_t(const metadata_t &_new_value, fifo_enforcer_write_token_t _metadata_fifo_token) :
-        new_value(_new_value), metadata_fifo_token(_metadata_fifo_token) { }
+    update_writer_t(const directory_update_t &_update, fifo_enforcer_write_token_t _metadata_fifo_token) :
+        update(_update), metadata_fifo_token(_metadata_fifo_token) { }
     ~update_writer_t() { }
 
     void write(write_stream_t *stream) {
         write_message_t msg;
         uint8_t code = 'U';
         msg << code;
-        msg << new_value;
+        msg << update;
         msg << metadata_fifo_token;
         int res = send_write_message(stream, &msg);
         if (res) {
@@ -98,19 +123,19 @@ public:
         }
     }
 private:
-    const metadata_t &new_value;
+    const directory_update_t &update;
     fifo_enforcer_write_token_t metadata_fifo_token;
 };
 
 template<class metadata_t>
-void directory_write_manager_t<metadata_t>::send_initialization(peer_id_t peer, const metadata_t &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t) THROWS_NOTHING {
-    initialization_writer_t writer(initial_value, metadata_fifo_state);
+void directory_write_manager_t<metadata_t>::send_initialization(peer_id_t peer, const boost::shared_ptr<const std::vector<char> > &initial_data, uint64_t version, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t) THROWS_NOTHING {
+    initialization_writer_t writer(*initial_data, version, metadata_fifo_state);
     message_service->send_message(peer, &writer);
 }
 
 template<class metadata_t>
-void directory_write_manager_t<metadata_t>::send_update(peer_id_t peer, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t) THROWS_NOTHING {
-    update_writer_t writer(*new_value, metadata_fifo_token);
+void directory_write_manager_t<metadata_t>::send_update(peer_id_t peer, const boost::shared_ptr<const directory_update_t> &update, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t) THROWS_NOTHING {
+    update_writer_t writer(*update, metadata_fifo_token);
     message_service->send_message(peer, &writer);
 }
 
@@ -55,47 +55,57 @@ raw_mailbox_t::address_t raw_mailbox_t::get_address() const {
 
 class raw_mailbox_writer_t : public send_message_write_callback_t {
 public:
-    raw_mailbox_writer_t(int32_t _dest_thread, raw_mailbox_t::id_t _dest_mailbox_id, mailbox_write_callback_t *_subwriter) :
-        dest_thread(_dest_thread), dest_mailbox_id(_dest_mailbox_id), subwriter(_subwriter) { }
+    raw_mailbox_writer_t(int32_t _dest_thread, raw_mailbox_t::id_t _dest_mailbox_id,
+                         mailbox_write_callback_t *_subwriter,
+                         write_message_t *_msg, write_message_t *_length_msg) :
+        dest_thread(_dest_thread), dest_mailbox_id(_dest_mailbox_id), subwriter(_subwriter),
+        msg(_msg), length_msg(_length_msg) { }
     virtual ~raw_mailbox_writer_t() { }
 
     void write(write_stream_t *stream) {
-        write_message_t msg;
-        msg << dest_thread;
-        msg << dest_mailbox_id;
-        uint64_t prefix_length = static_cast<uint64_t>(msg.size());
+        msg->clear();
+        *msg << dest_thread;
+        *msg << dest_mailbox_id;
+        uint64_t prefix_length = static_cast<uint64_t>(msg->size());
 
-        subwriter->write(&msg);
+        subwriter->write(msg);
 
         // Prepend the message length
         // TODO: It would be more efficient if we could make this part of `msg`.
         //  e.g. with a `prepend()` method on write_message_t.
-        write_message_t length_msg;
-        length_msg << (static_cast<uint64_t>(msg.size()) - prefix_length);
+        length_msg->clear();
+        *length_msg << (static_cast<uint64_t>(msg->size()) - prefix_length);
 
-        int res = send_write_message(stream, &length_msg);
+        int res = send_write_message(stream, length_msg);
         if (res) { throw fake_archive_exc_t(); }
-        res = send_write_message(stream, &msg);
+        res = send_write_message(stream, msg);
         if (res) { throw fake_archive_exc_t(); }
     }
 private:
     int32_t dest_thread;
     raw_mailbox_t::id_t dest_mailbox_id;
     mailbox_write_callback_t *subwriter;
+    write_message_t *msg;
+    write_message_t *length_msg;
 };
 
 void send(mailbox_manager_t *src, raw_mailbox_t::address_t dest, mailbox_write_callback_t *callback) {
     guarantee(src);
     guarantee(!dest.is_nil());
-    raw_mailbox_writer_t writer(dest.thread, dest.mailbox_id, callback);
-    src->message_service->send_message(dest.peer, &writer);
+    mailbox_manager_t::mailbox_table_t *table = src->mailbox_tables.get();
+    raw_mailbox_writer_t writer(dest.thread, dest.mailbox_id, callback,
+                                &table->send_msg, &table->send_length_msg);
+    // Messages to the same mailbox stay in order, but may overtake the messages
+    // to other mailboxes.
+    src->message_service->send_striped_message(dest.peer, dest.mailbox_id, &writer);
 }
 
 mailbox_manager_t::mailbox_manager_t(message_service_t *ms) :
     message_service(ms)
     { }
 
-mailbox_manager_t::mailbox_table_t::mailbox_table_t() {
+mailbox_manager_t::mailbox_table_t::mailbox_table_t()
+    : received_messages(get_num_threads()) {
     next_mailbox_id = (UINT64_MAX / get_num_threads()) * get_thread_id().threadnum;
 }
 
@@ -104,7 +114,7 @@ mailbox_manager_t::mailbox_table_t::~mailbox_table_t() {
 }
 
 raw_mailbox_t *mailbox_manager_t::mailbox_table_t::find_mailbox(raw_mailbox_t::id_t id) {
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator it = mailboxes.find(id);
+    auto it = mailboxes.find(id);
     if (it == mailboxes.end()) {
         return NULL;
     } else {
@@ -158,19 +168,44 @@ void mailbox_manager_t::on_message(peer_id_t source_peer, read_stream_t *stream)
     if (dest_thread == raw_mailbox_t::address_t::ANY_THREAD) {
         // TODO: this will just run the callback on the current thread, maybe do some load balancing, instead
         dest_thread = get_thread_id().threadnum;
+    } else if (dest_thread < 0 || dest_thread >= get_num_threads()) {
+        throw fake_archive_exc_t();
     }
 
-    // We use `spawn_now_dangerously()` to avoid having to heap-allocate `stream_data`.
-    // Instead we pass in a pointer to our local automatically allocated object
-    // and `mailbox_read_coroutine()` moves the data out of it before it yields.
-    coro_t::spawn_now_dangerously(std::bind(&mailbox_manager_t::mailbox_read_coroutine,
-                                            this, source_peer, threadnum_t(dest_thread),
-                                            dest_mailbox_id, &stream_data,
-                                            stream_data_offset));
+    if (dest_thread == get_thread_id().threadnum) {
+        // We use `spawn_now_dangerously()` to avoid having to heap-allocate `stream_data`.
+        // Instead we pass in a pointer to our local automatically allocated object
+        // and `mailbox_read_coroutine()` moves the data out of it before it yields.
+        coro_t::spawn_now_dangerously(std::bind(&mailbox_manager_t::mailbox_read_coroutine,
+                                                this, source_peer, dest_mailbox_id,
+                                                &stream_data, stream_data_offset));
+    } else {
+        // The messages that arrive before the coroutine gets to run go along with
+        // this one.
+        std::vector<received_message_t> *batch
+            = &mailbox_tables.get()->received_messages[dest_thread];
+        if (batch->empty()) {
+            coro_t::spawn_sometime(std::bind(&mailbox_manager_t::deliver_received_messages,
+                                             this, threadnum_t(dest_thread)));
+        }
+        batch->push_back(received_message_t(source_peer, dest_mailbox_id,
+                                            std::move(stream_data), stream_data_offset));
+    }
+}
+
+void mailbox_manager_t::deliver_received_messages(threadnum_t dest_thread) {
+    std::vector<received_message_t> batch;
+    batch.swap(mailbox_tables.get()->received_messages[dest_thread.threadnum]);
+
+    on_thread_t rethreader(dest_thread);
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        coro_t::spawn_now_dangerously(std::bind(&mailbox_manager_t::mailbox_read_coroutine,
+                                                this, it->source_peer, it->dest_mailbox_id,
+                                                &it->data, it->data_offset));
+    }
 }
 
 void mailbox_manager_t::mailbox_read_coroutine(peer_id_t source_peer,
-                                               threadnum_t dest_thread,
                                                raw_mailbox_t::id_t dest_mailbox_id,
                                                std::vector<char> *stream_data,
                                                int64_t stream_data_offset) {
@@ -178,23 +213,19 @@ void mailbox_manager_t::mailbox_read_coroutine(peer_id_t source_peer,
     // Construct a new stream to use
     vector_read_stream_t stream(std::move(*stream_data), stream_data_offset);
     stream_data = NULL; // <- It is not safe to use `stream_data` anymore once we
-                        //    switch the thread
+                        //    yield
 
     bool archive_exception = false;
-    {
-        on_thread_t rethreader(dest_thread);
-
-        try {
-            raw_mailbox_t *mbox = mailbox_tables.get()->find_mailbox(dest_mailbox_id);
-            if (mbox != NULL) {
-                mbox->callback->read(&stream);
-            }
-        } catch (const fake_archive_exc_t &e) {
-            // Set a flag and handle the exception later.
-            // This is to avoid doing thread switches and other coroutine things
-            // while being in the exception handler. Just a precaution...
-            archive_exception = true;
+    try {
+        raw_mailbox_t *mbox = mailbox_tables.get()->find_mailbox(dest_mailbox_id);
+        if (mbox != NULL) {
+            mbox->callback->read(&stream);
         }
+    } catch (const fake_archive_exc_t &e) {
+        // Set a flag and handle the exception later.
+        // This is to avoid doing thread switches and other coroutine things
+        // while being in the exception handler. Just a precaution...
+        archive_exception = true;
     }
     if (archive_exception) {
         logWRN("Received an invalid cluster message from a peer. Disconnecting.");
@@ -209,9 +240,7 @@ raw_mailbox_t::id_t mailbox_manager_t::generate_mailbox_id() {
 
 raw_mailbox_t::id_t mailbox_manager_t::register_mailbox(raw_mailbox_t *mb) {
     raw_mailbox_t::id_t id = generate_mailbox_id();
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *> *mailboxes = &mailbox_tables.get()->mailboxes;
-    std::pair<std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator, bool> res
-        = mailboxes->insert(std::make_pair(id, mb));
+    auto res = mailbox_tables.get()->mailboxes.insert(std::make_pair(id, mb));
     guarantee(res.second);  // Assert a new element was inserted.
     return id;
 }
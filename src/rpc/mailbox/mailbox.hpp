@@ -2,11 +2,12 @@
 #ifndef RPC_MAILBOX_MAILBOX_HPP_
 #define RPC_MAILBOX_MAILBOX_HPP_
 
-#include <map>
 #include <string>
+#include <vector>
 
 #include "containers/archive/archive.hpp"
 #include "containers/archive/vector_stream.hpp"
+#include "containers/flat_hash_map.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/semilattice/joins/macros.hpp"
 
@@ -122,13 +123,37 @@ private:
 
     message_service_t *message_service;
 
+    struct received_message_t {
+        received_message_t(peer_id_t _source_peer, raw_mailbox_t::id_t _dest_mailbox_id,
+                           std::vector<char> &&_data, int64_t _data_offset)
+            : source_peer(_source_peer), dest_mailbox_id(_dest_mailbox_id),
+              data(std::move(_data)), data_offset(_data_offset) { }
+
+        peer_id_t source_peer;
+        raw_mailbox_t::id_t dest_mailbox_id;
+        std::vector<char> data;
+        int64_t data_offset;
+    };
+
     struct mailbox_table_t {
         mailbox_table_t();
         ~mailbox_table_t();
         raw_mailbox_t::id_t next_mailbox_id;
-        // TODO: use a buffered structure to reduce dynamic allocation
-        std::map<raw_mailbox_t::id_t, raw_mailbox_t *> mailboxes;
+        // Every message looks its mailbox up here.
+        flat_hash_map_t<raw_mailbox_t::id_t, raw_mailbox_t *> mailboxes;
         raw_mailbox_t *find_mailbox(raw_mailbox_t::id_t);
+
+        /* `send()` serializes its messages and their length prefixes into these,
+        so that they keep their buffers from one message to the next. The message
+        service writes the message out without blocking, so only one `send()` on
+        the thread uses them at a time. */
+        write_message_t send_msg;
+        write_message_t send_length_msg;
+
+        /* The messages that arrived on this thread for the mailboxes on each
+        other thread, and haven't been passed on yet. They're passed on together,
+        so that a burst of messages for a thread only switches threads once. */
+        std::vector<std::vector<received_message_t> > received_messages;
     };
     one_per_thread_t<mailbox_table_t> mailbox_tables;
 
@@ -144,7 +169,12 @@ private:
 
     void on_message(peer_id_t source_peer, read_stream_t *stream);
 
-    void mailbox_read_coroutine(peer_id_t source_peer, threadnum_t dest_thread,
+    /* Takes the messages that arrived on this thread for `dest_thread` to it,
+    and starts a `mailbox_read_coroutine()` there for each of them. */
+    void deliver_received_messages(threadnum_t dest_thread);
+
+    /* Runs on the thread of the mailbox the message is for */
+    void mailbox_read_coroutine(peer_id_t source_peer,
                                 raw_mailbox_t::id_t dest_mailbox_id,
                                 std::vector<char> *stream_data,
                                 int64_t stream_data_offset);
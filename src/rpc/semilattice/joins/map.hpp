@@ -21,6 +21,22 @@ void semilattice_join(std::map<key_t, value_t> *a, const std::map<key_t, value_t
     }
 }
 
+/* `semilattice_changes()` sets `*changes_out` to the entries of `added` that
+aren't the same in `base`. Joining them into `base` has the same result as
+joining all of `added`, because the other entries' joins wouldn't change
+anything. */
+template<class key_t, class value_t>
+void semilattice_changes(const std::map<key_t, value_t> &base,
+                         const std::map<key_t, value_t> &added,
+                         std::map<key_t, value_t> *changes_out) {
+    for (typename std::map<key_t, value_t>::const_iterator it = added.begin(); it != added.end(); it++) {
+        typename std::map<key_t, value_t>::const_iterator it2 = base.find(it->first);
+        if (it2 == base.end() || !(it2->second == it->second)) {
+            changes_out->insert(changes_out->end(), *it);
+        }
+    }
+}
+
 }   /* namespace std */
 
 #endif /* RPC_SEMILATTICE_JOINS_MAP_HPP_ */
@@ -5,6 +5,7 @@
 #include <map>
 #include <utility>
 
+#include "arch/timing.hpp"
 #include "rpc/mailbox/mailbox.hpp"
 #include "rpc/semilattice/view.hpp"
 
@@ -29,11 +30,25 @@ constraints:
     such that `metadata_t` is a semilattice and `semilattice_join(a, b)` sets
     `*a` to the semilattice-join of `*a` and `b`.
 
+4. Optionally, there may be a function:
+
+        void semilattice_changes(const metadata_t &base, const metadata_t &added,
+                                 metadata_t *changes_out);
+
+    which sets `*changes_out` to a value that has the same join with `base` as
+    `added` does, typically just the parts of `added` that differ from `base`.
+    When `join()` is called on the root view, only those changes are sent to
+    the other nodes. Without it, all of `added` is sent.
+
+Because only changes are sent, every node periodically sends its peers a digest
+of its metadata. A peer whose metadata turns out to be different answers with
+all of its metadata, which repairs any divergence.
+
 Currently it's not thread-safe at all; all accesses to the metadata must be on
 the home thread of the `semilattice_manager_t`. */
 
 template<class metadata_t>
-class semilattice_manager_t : public home_thread_mixin_t, public message_handler_t, private peers_list_callback_t {
+class semilattice_manager_t : public home_thread_mixin_t, public message_handler_t, private peers_list_callback_t, private repeating_timer_callback_t {
 public:
     semilattice_manager_t(message_service_t *service, const metadata_t &initial_metadata);
     ~semilattice_manager_t() THROWS_NOTHING;
@@ -57,6 +72,7 @@ private:
     };
 
     class metadata_writer_t;
+    class digest_writer_t;
     class sync_from_query_writer_t;
     class sync_from_reply_writer_t;
     class sync_to_query_writer_t;
@@ -68,9 +84,14 @@ private:
     void on_connect(peer_id_t);
     void on_disconnect(peer_id_t);
 
+    /* Sends our digest to all of our peers. */
+    void on_ring();
+
     /* These are spawned in new coroutines. */
     void send_metadata_to_peer(peer_id_t, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void send_digest_to_peer(peer_id_t, uint32_t digest, auto_drainer_t::lock_t);
     void deliver_metadata_on_home_thread(peer_id_t sender, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void deliver_digest_on_home_thread(peer_id_t sender, uint32_t digest, auto_drainer_t::lock_t);
     void deliver_sync_from_query_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, auto_drainer_t::lock_t);
     void deliver_sync_from_reply_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
     void deliver_sync_to_query_on_home_thread(peer_id_t sender, sync_to_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
@@ -78,6 +99,7 @@ private:
 
     static void call_function_with_no_args(const boost::function<void()> &);
     void join_metadata_locally(metadata_t);
+    uint32_t get_metadata_digest();
     void wait_for_version_from_peer(peer_id_t peer, metadata_version_t version, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, sync_failed_exc_t);
 
     message_service_t *const message_service;
@@ -88,6 +110,11 @@ private:
     publisher_controller_t<boost::function<void()> > metadata_publisher;
     rwi_lock_assertion_t metadata_mutex;
 
+    /* A checksum of the serialized metadata, computed when a digest is needed
+    after the metadata changed. */
+    bool metadata_digest_valid;
+    uint32_t metadata_digest;
+
     std::map<peer_id_t, metadata_version_t> last_versions_seen;
     std::multimap<std::pair<peer_id_t, metadata_version_t>, cond_t *> version_waiters;
     mutex_assertion_t peer_version_mutex;
@@ -101,6 +128,8 @@ private:
     one_per_thread_t<auto_drainer_t> drainers;
 
     connectivity_service_t::peers_list_subscription_t event_watcher;
+
+    repeating_timer_t digest_timer;
 };
 
 #endif /* RPC_SEMILATTICE_SEMILATTICE_MANAGER_HPP_ */
@@ -6,6 +6,8 @@
 #include <set>
 #include <utility>
 
+#include <zlib.h>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
@@ -14,16 +16,28 @@
 #include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
 #include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "logger.hpp"
 
+/* Metadata types without a `semilattice_changes()` of their own send all of what
+is joined in; see `semilattice_manager_t`. */
+template<class metadata_t>
+void semilattice_changes(UNUSED const metadata_t &base, const metadata_t &added,
+                         metadata_t *changes_out) {
+    *changes_out = added;
+}
+
 template<class metadata_t>
 semilattice_manager_t<metadata_t>::semilattice_manager_t(message_service_t *ms, const metadata_t &initial_metadata) :
     message_service(ms),
     root_view(boost::make_shared<root_view_t>(this)),
     metadata_version(0),
     metadata(initial_metadata),
+    metadata_digest_valid(false),
+    metadata_digest(0),
     next_sync_from_query_id(0), next_sync_to_query_id(0),
-    event_watcher(this) {
+    event_watcher(this),
+    digest_timer(SEMILATTICE_DIGEST_INTERVAL_MS, this) {
     ASSERT_FINITE_CORO_WAITING;
     connectivity_service_t::peers_list_freeze_t freeze(message_service->get_connectivity_service());
     guarantee(message_service->get_connectivity_service()->get_peers_list().empty());
@@ -61,6 +75,10 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
     parent->assert_thread();
 
     metadata_version_t new_version = ++parent->metadata_version;
+    /* Callers usually join in a copy of the whole metadata with a few things
+    changed, so we only send the other nodes what's different. */
+    metadata_t changes;
+    semilattice_changes(parent->metadata, added_metadata, &changes);
     parent->join_metadata_locally(added_metadata);
 
     /* Distribute changes to all peers we can currently see. If we can't
@@ -72,13 +90,14 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
         if (*it != parent->message_service->get_connectivity_service()->get_me()) {
             coro_t::spawn_sometime(boost::bind(
                 &semilattice_manager_t<metadata_t>::send_metadata_to_peer, parent,
-                *it, added_metadata, new_version,
+                *it, changes, new_version,
                 auto_drainer_t::lock_t(parent->drainers.get())));
         }
     }
 }
 
 static const char message_code_metadata = 'M';
+static const char message_code_digest = 'D';
 static const char message_code_sync_from_query = 'F';
 static const char message_code_sync_from_reply = 'f';
 static const char message_code_sync_to_query = 'T';
@@ -104,6 +123,24 @@ private:
     metadata_version_t mdv;
 };
 
+template <class metadata_t>
+class semilattice_manager_t<metadata_t>::digest_writer_t : public send_message_write_callback_t {
+public:
+    explicit digest_writer_t(uint32_t _digest) :
+        digest(_digest) { }
+
+    void write(write_stream_t *stream) {
+        write_message_t msg;
+        uint8_t code = message_code_digest;
+        msg << code;
+        msg << digest;
+        int res = send_write_message(stream, &msg);
+        if (res) { throw fake_archive_exc_t(); }
+    }
+private:
+    uint32_t digest;
+};
+
 template <class metadata_t>
 class semilattice_manager_t<metadata_t>::sync_from_query_writer_t : public send_message_write_callback_t {
 public:
@@ -246,6 +283,17 @@ void semilattice_manager_t<metadata_t>::on_message(peer_id_t sender, read_stream
                 sender, added_metadata, change_version, auto_drainer_t::lock_t(drainers.get())));
             break;
         }
+        case message_code_digest: {
+            uint32_t digest;
+            {
+                int res = deserialize(stream, &digest);
+                if (res) { throw fake_archive_exc_t(); }
+            }
+            coro_t::spawn_sometime(boost::bind(
+                &semilattice_manager_t<metadata_t>::deliver_digest_on_home_thread, this,
+                sender, digest, auto_drainer_t::lock_t(drainers.get())));
+            break;
+        }
         case message_code_sync_from_query: {
             sync_from_query_id_t query_id;
             {
@@ -323,12 +371,34 @@ void semilattice_manager_t<metadata_t>::on_disconnect(peer_id_t) {
     /* ignore */
 }
 
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::on_ring() {
+    assert_thread();
+
+    uint32_t digest = get_metadata_digest();
+    DEBUG_VAR connectivity_service_t::peers_list_freeze_t freeze(message_service->get_connectivity_service());
+    std::set<peer_id_t> peers = message_service->get_connectivity_service()->get_peers_list();
+    for (std::set<peer_id_t>::iterator it = peers.begin(); it != peers.end(); it++) {
+        if (*it != message_service->get_connectivity_service()->get_me()) {
+            coro_t::spawn_sometime(boost::bind(
+                &semilattice_manager_t<metadata_t>::send_digest_to_peer, this,
+                *it, digest, auto_drainer_t::lock_t(drainers.get())));
+        }
+    }
+}
+
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::send_metadata_to_peer(peer_id_t peer, metadata_t m, metadata_version_t mv, auto_drainer_t::lock_t) {
     metadata_writer_t writer(m, mv);
     message_service->send_message(peer, &writer);
 }
 
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::send_digest_to_peer(peer_id_t peer, uint32_t digest, auto_drainer_t::lock_t) {
+    digest_writer_t writer(digest);
+    message_service->send_message(peer, &writer);
+}
+
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::deliver_metadata_on_home_thread(peer_id_t sender, metadata_t md, metadata_version_t mv, auto_drainer_t::lock_t) {
     on_thread_t thread_switcher(home_thread());
@@ -347,6 +417,18 @@ void semilattice_manager_t<metadata_t>::deliver_metadata_on_home_thread(peer_id_
     }
 }
 
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::deliver_digest_on_home_thread(peer_id_t sender, uint32_t digest, auto_drainer_t::lock_t keepalive) {
+    on_thread_t thread_switcher(home_thread());
+    if (digest != get_metadata_digest()) {
+        /* The metadata may just differ because changes are still on their way,
+        but it doesn't hurt to join it again if it does. The sender sends us its
+        digest too, so it sends us all of its metadata if it's missing some of
+        ours. */
+        send_metadata_to_peer(sender, metadata, metadata_version, keepalive);
+    }
+}
+
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::deliver_sync_from_query_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, auto_drainer_t::lock_t) {
     on_thread_t thread_switcher(home_thread());
@@ -405,9 +487,27 @@ void semilattice_manager_t<metadata_t>::join_metadata_locally(metadata_t added_m
     assert_thread();
     DEBUG_VAR rwi_lock_assertion_t::write_acq_t acq(&metadata_mutex);
     semilattice_join(&metadata, added_metadata);
+    metadata_digest_valid = false;
     metadata_publisher.publish(&semilattice_manager_t<metadata_t>::call_function_with_no_args);
 }
 
+template<class metadata_t>
+uint32_t semilattice_manager_t<metadata_t>::get_metadata_digest() {
+    assert_thread();
+    if (!metadata_digest_valid) {
+        write_message_t msg;
+        msg << metadata;
+        uLong crc = crc32(0L, Z_NULL, 0);
+        intrusive_list_t<write_buffer_t> *buffers = msg.unsafe_expose_buffers();
+        for (write_buffer_t *buffer = buffers->head(); buffer != NULL; buffer = buffers->next(buffer)) {
+            crc = crc32(crc, reinterpret_cast<const Bytef *>(buffer->data), buffer->size);
+        }
+        metadata_digest = crc;
+        metadata_digest_valid = true;
+    }
+    return metadata_digest;
+}
+
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::wait_for_version_from_peer(peer_id_t peer, metadata_version_t version, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, sync_failed_exc_t) {
     assert_thread();
@@ -0,0 +1,259 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/buffer_arena.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "thread_local.hpp"
+#include "utils.hpp"
+
+namespace {
+
+// Buffers are handed out in multiples of DEVICE_BLOCK_SIZE.  Size class `i` holds
+// buffers of (i + 1) * DEVICE_BLOCK_SIZE bytes.
+const size_t NUM_SIZE_CLASSES = SER_BUFFER_ARENA_MAX_BUFFER_SIZE / DEVICE_BLOCK_SIZE;
+
+size_t size_class_buffer_size(size_t size_class) {
+    return (size_class + 1) * DEVICE_BLOCK_SIZE;
+}
+
+// How many free buffers of a size class a thread keeps before giving half of them
+// back to the shared free list.
+size_t thread_cache_limit(size_t size_class) {
+    return std::max<size_t>(2, SER_BUFFER_ARENA_THREAD_CACHE_SIZE
+                               / size_class_buffer_size(size_class));
+}
+
+// Free buffers are linked together through their own first bytes.
+struct free_buffer_t {
+    free_buffer_t *next;
+};
+
+class free_list_t {
+public:
+    free_list_t() : head_(NULL), count_(0) { }
+
+    bool empty() const { return head_ == NULL; }
+    size_t count() const { return count_; }
+
+    void push(void *buf) {
+        free_buffer_t *node = static_cast<free_buffer_t *>(buf);
+        node->next = head_;
+        head_ = node;
+        ++count_;
+    }
+
+    void *pop() {
+        rassert(head_ != NULL);
+        free_buffer_t *node = head_;
+        head_ = node->next;
+        --count_;
+        return node;
+    }
+
+    // Moves up to n buffers from the front of this list to the front of *other.
+    void move_to(size_t n, free_list_t *other) {
+        if (n == 0 || head_ == NULL) {
+            return;
+        }
+        free_buffer_t *first = head_;
+        free_buffer_t *last = head_;
+        size_t moved = 1;
+        while (moved < n && last->next != NULL) {
+            last = last->next;
+            ++moved;
+        }
+        head_ = last->next;
+        count_ -= moved;
+        last->next = other->head_;
+        other->head_ = first;
+        other->count_ += moved;
+    }
+
+private:
+    free_buffer_t *head_;
+    size_t count_;
+
+    DISABLE_COPYING(free_list_t);
+};
+
+// The address space reservation and the free lists shared by all threads.
+class ser_buffer_arena_t {
+public:
+    ser_buffer_arena_t() : base_(NULL), num_chunks_(0), next_chunk_(0) {
+        // We reserve one chunk more than we need, so that we can align the start of
+        // the arena to a chunk (i.e. huge page) boundary.
+        const size_t reservation_size = SER_BUFFER_ARENA_RESERVATION
+            + SER_BUFFER_ARENA_CHUNK_SIZE;
+        int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+        flags |= MAP_NORESERVE;
+#endif
+        void *reservation = mmap(NULL, reservation_size, PROT_NONE, flags, -1, 0);
+        if (reservation == MAP_FAILED) {
+            // Everything will simply come from malloc.
+            return;
+        }
+        base_ = reinterpret_cast<char *>(
+            ceil_aligned(reinterpret_cast<uintptr_t>(reservation),
+                         static_cast<uintptr_t>(SER_BUFFER_ARENA_CHUNK_SIZE)));
+        num_chunks_ = SER_BUFFER_ARENA_RESERVATION / SER_BUFFER_ARENA_CHUNK_SIZE;
+        chunk_size_classes_.init(num_chunks_);
+    }
+
+    bool contains(const void *buf) const {
+        const char *p = static_cast<const char *>(buf);
+        return base_ != NULL
+            && p >= base_
+            && p < base_ + num_chunks_ * SER_BUFFER_ARENA_CHUNK_SIZE;
+    }
+
+    size_t size_class_of(const void *buf) const {
+        rassert(contains(buf));
+        const char *p = static_cast<const char *>(buf);
+        return chunk_size_classes_[(p - base_) / SER_BUFFER_ARENA_CHUNK_SIZE];
+    }
+
+    // Commits a new chunk for buffers of the given size class.  Returns NULL if the
+    // reservation is used up or the memory can't be committed.
+    char *new_chunk(size_t size_class) {
+        char *chunk;
+        {
+            spinlock_acq_t acq(&lock_);
+            if (next_chunk_ == num_chunks_) {
+                return NULL;
+            }
+            chunk_size_classes_[next_chunk_] = size_class;
+            chunk = base_ + next_chunk_ * SER_BUFFER_ARENA_CHUNK_SIZE;
+            ++next_chunk_;
+        }
+
+        if (mprotect(chunk, SER_BUFFER_ARENA_CHUNK_SIZE,
+                     PROT_READ | PROT_WRITE) != 0) {
+            // The chunk is lost, and the caller falls back to malloc.
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        // This is only a hint; if transparent huge pages are disabled we just get
+        // ordinary pages.
+        UNUSED int res = madvise(chunk, SER_BUFFER_ARENA_CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+        return chunk;
+    }
+
+    void give(size_t size_class, free_list_t *from, size_t n) {
+        // Detach the buffers before taking the lock, so that we don't walk the list
+        // while holding it.
+        free_list_t batch;
+        from->move_to(n, &batch);
+        spinlock_acq_t acq(&lock_);
+        batch.move_to(batch.count(), &shared_free_lists_[size_class]);
+    }
+
+    void take(size_t size_class, free_list_t *to, size_t n) {
+        spinlock_acq_t acq(&lock_);
+        shared_free_lists_[size_class].move_to(n, to);
+    }
+
+private:
+    char *base_;
+    size_t num_chunks_;
+
+    spinlock_t lock_;
+    // These are protected by lock_.  A chunk's size class is written before the chunk
+    // is handed out, and never changes afterwards, so reading it needs no lock.
+    size_t next_chunk_;
+    scoped_array_t<uint8_t> chunk_size_classes_;
+    free_list_t shared_free_lists_[NUM_SIZE_CLASSES];
+
+    DISABLE_COPYING(ser_buffer_arena_t);
+};
+
+// Never destroyed, so that buffers may be freed during static destruction.
+ser_buffer_arena_t *get_arena() {
+    static ser_buffer_arena_t *arena = new ser_buffer_arena_t();
+    return arena;
+}
+
+struct thread_cache_t {
+    thread_cache_t() {
+        for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i) {
+            chunk_pos[i] = NULL;
+            chunk_end[i] = NULL;
+        }
+    }
+
+    free_list_t free_lists[NUM_SIZE_CLASSES];
+    // The unused part of the chunk we're currently carving buffers out of, for each
+    // size class.
+    char *chunk_pos[NUM_SIZE_CLASSES];
+    char *chunk_end[NUM_SIZE_CLASSES];
+};
+
+// Threads live as long as the process, so their caches are never freed.
+TLS_with_init(thread_cache_t *, ser_buffer_thread_cache, NULL);
+
+thread_cache_t *get_thread_cache() {
+    thread_cache_t *cache = TLS_get_ser_buffer_thread_cache();
+    if (cache == NULL) {
+        cache = new thread_cache_t();
+        TLS_set_ser_buffer_thread_cache(cache);
+    }
+    return cache;
+}
+
+}  // namespace
+
+void *allocate_ser_buffer(size_t size) {
+    const size_t rounded_size = ceil_aligned(size, DEVICE_BLOCK_SIZE);
+    if (rounded_size == 0 || rounded_size > SER_BUFFER_ARENA_MAX_BUFFER_SIZE) {
+        return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+    }
+    const size_t size_class = rounded_size / DEVICE_BLOCK_SIZE - 1;
+
+    thread_cache_t *cache = get_thread_cache();
+    free_list_t *free_list = &cache->free_lists[size_class];
+    if (free_list->empty()) {
+        get_arena()->take(size_class, free_list, thread_cache_limit(size_class) / 2);
+    }
+    if (!free_list->empty()) {
+        return free_list->pop();
+    }
+
+    if (cache->chunk_pos[size_class] == cache->chunk_end[size_class]) {
+        char *chunk = get_arena()->new_chunk(size_class);
+        if (chunk == NULL) {
+            return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+        }
+        cache->chunk_pos[size_class] = chunk;
+        cache->chunk_end[size_class] = chunk + (SER_BUFFER_ARENA_CHUNK_SIZE / rounded_size)
+            * rounded_size;
+    }
+    void *ret = cache->chunk_pos[size_class];
+    cache->chunk_pos[size_class] += rounded_size;
+    return ret;
+}
+
+void free_ser_buffer(ser_buffer_t *buf) {
+    if (buf == NULL) {
+        return;
+    }
+    ser_buffer_arena_t *arena = get_arena();
+    if (!arena->contains(buf)) {
+        free(buf);
+        return;
+    }
+
+    const size_t size_class = arena->size_class_of(buf);
+    free_list_t *free_list = &get_thread_cache()->free_lists[size_class];
+    free_list->push(buf);
+    if (free_list->count() > thread_cache_limit(size_class)) {
+        arena->give(size_class, free_list, free_list->count() / 2);
+    }
+}
@@ -0,0 +1,31 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_BUFFER_ARENA_HPP_
+#define SERIALIZER_BUFFER_ARENA_HPP_
+
+#include <stddef.h>
+
+#include "serializer/types.hpp"
+
+/* Serializer block buffers come from a dedicated arena instead of from malloc, because
+the cache allocates and frees them at a high rate and in equal sizes.
+
+The arena reserves one large range of address space up front and commits it in chunks
+of SER_BUFFER_ARENA_CHUNK_SIZE, which are advised to be backed by transparent huge
+pages.  Each chunk is carved into buffers of a single size, a multiple of
+DEVICE_BLOCK_SIZE, so every buffer can be used for O_DIRECT I/O as it is.  Freed
+buffers go on a per-thread free list, and only the excess beyond
+SER_BUFFER_ARENA_THREAD_CACHE_SIZE is handed back to the shared free lists, so most
+allocations and frees take no locks at all.  Memory given to the arena is never
+returned to the operating system.
+
+Requests larger than SER_BUFFER_ARENA_MAX_BUFFER_SIZE, or made once the reservation is
+exhausted (or couldn't be made at all), fall back to malloc_aligned(). */
+
+/* Returns a DEVICE_BLOCK_SIZE aligned buffer of at least `size` bytes. */
+void *allocate_ser_buffer(size_t size);
+
+/* Frees a buffer returned by allocate_ser_buffer(), or one that was allocated with
+malloc.  scoped_malloc_t<ser_buffer_t> calls this, so ordinarily nobody else has to. */
+void free_ser_buffer(ser_buffer_t *buf);
+
+#endif  // SERIALIZER_BUFFER_ARENA_HPP_
@@ -0,0 +1,96 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/block_checksum.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "errors.hpp"
+#include <boost/crc.hpp>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+typedef boost::crc_optimal<32, 0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, true, true> crc32c_type;
+
+uint32_t crc32c_portable(const void *data, size_t size) {
+    crc32c_type crc_computer;
+    crc_computer.process_bytes(data, size);
+    return crc_computer.checksum();
+}
+
+#if defined(__x86_64__)
+
+// We use inline assembly rather than the SSE4.2 intrinsics, so that this file
+// doesn't have to be compiled with -msse4.2.
+inline uint64_t crc32c_u64(uint64_t crc, uint64_t value) {
+    __asm__("crc32q %1, %0" : "+r"(crc) : "rm"(value));
+    return crc;
+}
+
+inline uint32_t crc32c_u8(uint32_t crc, uint8_t value) {
+    __asm__("crc32b %1, %0" : "+r"(crc) : "rm"(value));
+    return crc;
+}
+
+bool cpu_has_sse42() {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+    return (ecx & bit_SSE4_2) != 0;
+}
+
+#define HAVE_HARDWARE_CRC32C 1
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+inline uint64_t crc32c_u64(uint64_t crc, uint64_t value) {
+    return __crc32cd(crc, value);
+}
+
+inline uint32_t crc32c_u8(uint32_t crc, uint8_t value) {
+    return __crc32cb(crc, value);
+}
+
+#define HAVE_HARDWARE_CRC32C 1
+
+#endif
+
+#ifdef HAVE_HARDWARE_CRC32C
+uint32_t crc32c_hardware(const void *data, size_t size) {
+    const char *p = static_cast<const char *>(data);
+    uint64_t crc = 0xFFFFFFFF;
+    for (; size >= sizeof(uint64_t); p += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        crc = crc32c_u64(crc, value);
+    }
+    uint32_t crc32 = crc;
+    for (; size > 0; ++p, --size) {
+        crc32 = crc32c_u8(crc32, *p);
+    }
+    return crc32 ^ 0xFFFFFFFF;
+}
+#endif  // HAVE_HARDWARE_CRC32C
+
+uint32_t crc32c(const void *data, size_t size) {
+#if defined(__x86_64__)
+    static const bool use_hardware = cpu_has_sse42();
+    return use_hardware ? crc32c_hardware(data, size) : crc32c_portable(data, size);
+#elif defined(HAVE_HARDWARE_CRC32C)
+    return crc32c_hardware(data, size);
+#else
+    return crc32c_portable(data, size);
+#endif
+}
+
+uint32_t compute_block_checksum(const ser_buffer_t *buf, block_size_t block_size) {
+    // The block id is part of the checksummed data, so that a block that got written
+    // to the place of another one doesn't pass for it.
+    const size_t skipped = offsetof(ls_buf_data_t, block_id);
+    return crc32c(reinterpret_cast<const char *>(buf) + skipped,
+                  block_size.ser_value() - skipped);
+}
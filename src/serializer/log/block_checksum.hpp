@@ -0,0 +1,28 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_BLOCK_CHECKSUM_HPP_
+#define SERIALIZER_LOG_BLOCK_CHECKSUM_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "serializer/types.hpp"
+
+/* Computes the CRC32C (Castagnoli) of `size` bytes at `data`.  This uses the CRC32
+instructions of SSE4.2 or ARMv8 when they are available, and falls back to
+crc32c_portable() otherwise. */
+uint32_t crc32c(const void *data, size_t size);
+
+/* The same, without hardware support. */
+uint32_t crc32c_portable(const void *data, size_t size);
+
+/* The checksum the log serializer stores in the ser_header of every block it writes.
+It covers the block id and the cache data, i.e. everything in the `block_size` bytes
+of the block that follows the block id.  For compressed blocks, `block_size` is the
+compressed size. */
+uint32_t compute_block_checksum(const ser_buffer_t *buf, block_size_t block_size);
+
+inline bool block_checksum_matches(const ser_buffer_t *buf, block_size_t block_size) {
+    return buf->ser_header.checksum == compute_block_checksum(buf, block_size);
+}
+
+#endif  // SERIALIZER_LOG_BLOCK_CHECKSUM_HPP_
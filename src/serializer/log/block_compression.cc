@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/block_compression.hpp"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "config/args.hpp"
+#include "utils.hpp"
+
+block_compressor_t::block_compressor_t() {
+    memset(&deflate_stream_, 0, sizeof(deflate_stream_));
+    memset(&inflate_stream_, 0, sizeof(inflate_stream_));
+
+    // Blocks are small, so a small window is enough and keeps the stream's memory
+    // footprint low.
+    int res = deflateInit2(&deflate_stream_, Z_BEST_SPEED, Z_DEFLATED,
+                           BLOCK_COMPRESSION_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY);
+    guarantee(res == Z_OK, "deflateInit2 failed (zlib error %d)", res);
+    res = inflateInit2(&inflate_stream_, MAX_WBITS);
+    guarantee(res == Z_OK, "inflateInit2 failed (zlib error %d)", res);
+}
+
+block_compressor_t::~block_compressor_t() {
+    deflateEnd(&deflate_stream_);
+    inflateEnd(&inflate_stream_);
+}
+
+bool block_compressor_t::compress(const ser_buffer_t *buf, block_size_t block_size,
+                                  ser_buffer_t *buf_out,
+                                  block_size_t *compressed_size_out) {
+    const uint32_t aligned_size = ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE);
+    if (aligned_size <= DEVICE_BLOCK_SIZE) {
+        return false;
+    }
+    // The compressed block must fit into one device block less than the original.
+    const uint32_t max_compressed_size = aligned_size - DEVICE_BLOCK_SIZE;
+
+    int res = deflateReset(&deflate_stream_);
+    guarantee(res == Z_OK, "deflateReset failed (zlib error %d)", res);
+
+    deflate_stream_.next_in
+        = reinterpret_cast<Bytef *>(const_cast<char *>(buf->cache_data));
+    deflate_stream_.avail_in = block_size.value();
+    deflate_stream_.next_out = reinterpret_cast<Bytef *>(buf_out->cache_data);
+    deflate_stream_.avail_out = max_compressed_size - sizeof(ls_buf_data_t);
+
+    res = deflate(&deflate_stream_, Z_FINISH);
+    if (res != Z_STREAM_END) {
+        // We ran out of output space, i.e. the block doesn't compress well enough.
+        guarantee(res == Z_OK || res == Z_BUF_ERROR, "deflate failed (zlib error %d)", res);
+        return false;
+    }
+
+    buf_out->ser_header = buf->ser_header;
+    const uint32_t compressed_size = sizeof(ls_buf_data_t) + deflate_stream_.total_out;
+    memset(reinterpret_cast<char *>(buf_out) + compressed_size, 0,
+           ceil_aligned(compressed_size, DEVICE_BLOCK_SIZE) - compressed_size);
+
+    *compressed_size_out = block_size_t::unsafe_make(compressed_size);
+    return true;
+}
+
+void block_compressor_t::decompress(const ser_buffer_t *buf, block_size_t compressed_size,
+                                    ser_buffer_t *buf_out, block_size_t block_size) {
+    guarantee(compressed_size.ser_value() >= sizeof(ls_buf_data_t));
+
+    int res = inflateReset(&inflate_stream_);
+    guarantee(res == Z_OK, "inflateReset failed (zlib error %d)", res);
+
+    inflate_stream_.next_in
+        = reinterpret_cast<Bytef *>(const_cast<char *>(buf->cache_data));
+    inflate_stream_.avail_in = compressed_size.ser_value() - sizeof(ls_buf_data_t);
+    inflate_stream_.next_out = reinterpret_cast<Bytef *>(buf_out->cache_data);
+    inflate_stream_.avail_out = block_size.value();
+
+    res = inflate(&inflate_stream_, Z_FINISH);
+    guarantee(res == Z_STREAM_END && inflate_stream_.total_out == block_size.value(),
+              "Corrupted compressed block %" PRIu64 " (zlib error %d)",
+              buf->ser_header.block_id, res);
+
+    buf_out->ser_header = buf->ser_header;
+}
@@ -0,0 +1,38 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+#define SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+
+#include <zlib.h>
+
+#include "errors.hpp"
+#include "serializer/types.hpp"
+
+/* Compresses and decompresses blocks for the log serializer.  A compressed block
+consists of the block's ls_buf_data_t header, followed by the zlib-compressed
+cache data.  block_compressor_t keeps its zlib streams around between blocks, so
+that we don't pay for setting them up on every block. */
+class block_compressor_t {
+public:
+    block_compressor_t();
+    ~block_compressor_t();
+
+    /* Compresses the `block_size` bytes long block in `buf` into `buf_out`, which must
+    have room for `block_size` bytes.  Returns false (and leaves `buf_out` in an
+    undefined state) if compression doesn't save at least one DEVICE_BLOCK_SIZE of
+    disk space.  The remainder of the last device block of `buf_out` is zeroed. */
+    bool compress(const ser_buffer_t *buf, block_size_t block_size,
+                  ser_buffer_t *buf_out, block_size_t *compressed_size_out);
+
+    /* Decompresses a block compressed by compress(). Crashes if the compressed data
+    doesn't decompress to exactly `block_size` bytes. */
+    void decompress(const ser_buffer_t *buf, block_size_t compressed_size,
+                    ser_buffer_t *buf_out, block_size_t block_size);
+
+private:
+    z_stream deflate_stream_;
+    z_stream inflate_stream_;
+
+    DISABLE_COPYING(block_compressor_t);
+};
+
+#endif  // SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
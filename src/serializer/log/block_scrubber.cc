@@ -0,0 +1,85 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/block_scrubber.hpp"
+
+#include <inttypes.h>
+
+#include <functional>
+
+#include "arch/arch.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "logger.hpp"
+#include "serializer/buffer_arena.hpp"
+#include "serializer/log/block_checksum.hpp"
+#include "serializer/log/log_serializer.hpp"
+
+block_scrubber_t::block_scrubber_t(log_serializer_t *serializer)
+    : serializer_(serializer),
+      io_account_(serializer->make_io_account(SCRUB_IO_PRIORITY, 1)) {
+    guarantee(serializer_->dynamic_config.scrub_interval_secs > 0);
+    coro_t::spawn_sometime(std::bind(&block_scrubber_t::run, this,
+                                     auto_drainer_t::lock_t(&drainer_)));
+}
+
+block_scrubber_t::~block_scrubber_t() {
+    serializer_->assert_thread();
+}
+
+void block_scrubber_t::run(auto_drainer_t::lock_t keepalive) {
+    try {
+        for (;;) {
+            nap(static_cast<int64_t>(serializer_->dynamic_config.scrub_interval_secs) * 1000,
+                keepalive.get_drain_signal());
+            scrub(keepalive.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // The serializer is shutting down.
+    }
+}
+
+void block_scrubber_t::scrub(signal_t *interruptor) {
+    serializer_->assert_thread();
+
+    // Compressed blocks are smaller than this, so the buffer fits every block.
+    const int64_t buf_size = ceil_aligned(serializer_->static_config.block_size().ser_value(),
+                                          DEVICE_BLOCK_SIZE);
+    scoped_malloc_t<ser_buffer_t> buf(allocate_ser_buffer(buf_size));
+
+    int64_t corrupted_blocks = 0;
+    for (block_id_t block_id = 0;
+         block_id < serializer_->lba_index->end_block_id();
+         ++block_id) {
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+
+        const index_block_info_t info = serializer_->lba_index->get_block_info(block_id);
+        if (!info.offset.has_value()) {
+            continue;
+        }
+
+        // The token keeps the GC from reusing the block's space while we read it.
+        counted_t<ls_block_token_pointee_t> token
+            = serializer_->generate_block_token_from_lba(info.offset.get_value(),
+                                                         info.ser_block_size);
+        const block_size_t disk_block_size = token->disk_block_size();
+        co_read(serializer_->dbfile, token->offset(),
+                ceil_aligned(disk_block_size.ser_value(), DEVICE_BLOCK_SIZE),
+                buf.get(), io_account_.get());
+
+        ++serializer_->stats->pm_serializer_scrubbed_blocks;
+        ++serializer_->stats->pm_serializer_checksum_verifications;
+        if (!block_checksum_matches(buf.get(), disk_block_size)) {
+            ++serializer_->stats->pm_serializer_checksum_failures;
+            ++corrupted_blocks;
+            logERR("Block %" PR_BLOCK_ID " at offset %" PRIi64 " of the database file "
+                   "is corrupted (its checksum doesn't match).",
+                   block_id, token->offset());
+        }
+    }
+
+    if (corrupted_blocks > 0) {
+        logERR("Scrubbing the database file found %" PRIi64 " corrupted blocks.",
+               corrupted_blocks);
+    }
+}
@@ -0,0 +1,35 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_BLOCK_SCRUBBER_HPP_
+#define SERIALIZER_LOG_BLOCK_SCRUBBER_HPP_
+
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+
+class file_account_t;
+class log_serializer_t;
+class signal_t;
+
+/* Every dynamic_config.scrub_interval_secs, block_scrubber_t reads every live block
+of the log serializer's file with SCRUB_IO_PRIORITY and verifies its checksum, so
+that corruption gets found even in blocks nobody reads.  Corrupted blocks are
+logged and counted in the serializer_checksum_failures stat.  Destroying the
+scrubber waits for a running scrub to stop, so it must happen in a coroutine. */
+class block_scrubber_t {
+public:
+    explicit block_scrubber_t(log_serializer_t *serializer);
+    ~block_scrubber_t();
+
+private:
+    void run(auto_drainer_t::lock_t keepalive);
+    void scrub(signal_t *interruptor);
+
+    log_serializer_t *const serializer_;
+    scoped_ptr_t<file_account_t> io_account_;
+
+    auto_drainer_t drainer_;
+
+    DISABLE_COPYING(block_scrubber_t);
+};
+
+#endif  // SERIALIZER_LOG_BLOCK_SCRUBBER_HPP_
@@ -8,29 +8,97 @@
 #include "serializer/types.hpp"
 #include "rpc/serialize_macros.hpp"
 
+/* When the log serializer verifies the checksums of the blocks it reads.  Blocks
+always get checksummed when they are written. */
+enum class block_checksum_verification_t {
+    // Every block read from disk gets verified.
+    ALWAYS = 0,
+    // One in CHECKSUM_VERIFICATION_SAMPLE_INTERVAL blocks read from disk gets
+    // verified.
+    SAMPLED = 1,
+    // Only the background scrubber verifies checksums.
+    SCRUB_ONLY = 2
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(block_checksum_verification_t, int8_t,
+                                      block_checksum_verification_t::ALWAYS,
+                                      block_checksum_verification_t::SCRUB_ONLY);
+
 /* Configuration for the serializer that can change from run to run */
 
 struct log_serializer_dynamic_config_t {
     log_serializer_dynamic_config_t() {
         gc_low_ratio = DEFAULT_GC_LOW_RATIO;
         gc_high_ratio = DEFAULT_GC_HIGH_RATIO;
+        gc_max_concurrent_extents = DEFAULT_GC_MAX_CONCURRENT_EXTENTS;
+        gc_write_amplification_target = DEFAULT_GC_WRITE_AMPLIFICATION_TARGET;
         read_ahead = true;
+        compress_blocks = false;
+        preallocated_extents = DEFAULT_PREALLOCATED_EXTENTS;
+        punch_holes = false;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        metablock_group_commit_window_ms = DEFAULT_METABLOCK_GROUP_COMMIT_WINDOW_MS;
+        checksum_verification = block_checksum_verification_t::SAMPLED;
+        scrub_interval_secs = DEFAULT_SCRUB_INTERVAL_SECS;
+        cold_tier_age_secs = DEFAULT_COLD_TIER_AGE_SECS;
     }
 
     /* When the proportion of garbage blocks hits gc_high_ratio, then the serializer will collect
     garbage until it reaches gc_low_ratio. */
     double gc_low_ratio, gc_high_ratio;
 
+    /* The maximal number of extents that are garbage collected at the same time. */
+    int32_t gc_max_concurrent_extents;
+
+    /* If greater than 1, the serializer starts collecting garbage as soon as the
+    garbage ratio exceeds gc_low_ratio, but it only rewrites up to
+    (gc_write_amplification_target - 1) bytes of live data per byte written by its
+    users.  This spreads the GC work evenly over the write load instead of running
+    it in bursts.  Above gc_high_ratio, GC runs unthrottled. */
+    double gc_write_amplification_target;
+
     /* The (minimal) batch size of i/o requests being taken from a single i/o account.
     It is a factor because the actual batch size is this factor multiplied by the
     i/o priority of the account. */
     int32_t io_batch_factor;
 
+    /* How long (in milliseconds) a metablock write waits for other concurrent index
+    writes to join it, so that they share one metablock write and sync. */
+    int32_t metablock_group_commit_window_ms;
+
     /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
     bool read_ahead;
 
-    RDB_MAKE_ME_SERIALIZABLE_4(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead);
+    /* Compress full-sized blocks before writing them to disk.  Blocks that have been
+    written compressed stay readable if this is turned off again. */
+    bool compress_blocks;
+
+    /* How many extents beyond the ones in use are kept allocated in the file (using
+    fallocate in the background), so that new extents never have to wait for the file
+    to grow. */
+    int32_t preallocated_extents;
+
+    /* Give the disk space of extents that become free in the middle of the file back
+    to the file system. */
+    bool punch_holes;
+
+    /* Which block reads verify the block's checksum. */
+    block_checksum_verification_t checksum_verification;
+
+    /* How often (in seconds) a background scrubber reads every block in the file
+    with low priority and verifies its checksum.  0 disables the scrubber. */
+    int32_t scrub_interval_secs;
+
+    /* If the serializer has a cold tier file, the GC moves blocks that haven't been
+    written for this many seconds there.  0 keeps all blocks in the database file. */
+    int32_t cold_tier_age_secs;
+
+    RDB_MAKE_ME_SERIALIZABLE_13(gc_low_ratio, gc_high_ratio, gc_max_concurrent_extents,
+                                gc_write_amplification_target, io_batch_factor,
+                                metablock_group_commit_window_ms, read_ahead,
+                                compress_blocks, preallocated_extents, punch_holes,
+                                checksum_verification, scrub_interval_secs,
+                                cold_tier_age_secs);
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
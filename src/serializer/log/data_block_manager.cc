@@ -4,19 +4,36 @@
 #include <inttypes.h>
 #include <sys/uio.h>
 
+#include <algorithm>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
 #include "arch/arch.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "concurrency/background_governor.hpp"
 #include "concurrency/mutex.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/log/block_checksum.hpp"
+#include "serializer/log/block_compression.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "stl_utils.hpp"
 
 // Max amount of bytes which can be read ahead in one i/o transaction (if enabled)
 const int64_t APPROXIMATE_READ_AHEAD_SIZE = 32 * DEFAULT_BTREE_BLOCK_SIZE;
 
+// Read-ahead size for reads that are detected to be sequential, e.g. because a
+// btree traversal walks over blocks that were written in key order.
+const int64_t SEQUENTIAL_READ_AHEAD_SIZE = 128 * DEFAULT_BTREE_BLOCK_SIZE;
+
+// How many reads in a row have to go forward through the file (by at most
+// SEQUENTIAL_READ_AHEAD_SIZE) before we consider the reads to be sequential.
+const int SEQUENTIAL_READ_THRESHOLD = 4;
+
+// How many I/O accounts we track sequential reads for.  Accounts come and go
+// without telling us, so once there are more than this we start over.
+const size_t MAX_SEQUENTIAL_READ_ACCOUNTS = 64;
+
 // Identifies an extent, the time we started writing to the
 // extent, whether it's the extent we're currently writing to, and
 // describes blocks are garbage.
@@ -30,10 +47,14 @@ private:
     };
 
 public:
-    /* This constructor is for starting a new active extent. */
-    explicit gc_entry_t(data_block_manager_t *_parent)
+    /* This constructor is for starting a new active extent, in the cold tier if
+    it's for blocks of that temperature. */
+    gc_entry_t(data_block_manager_t *_parent,
+               data_block_manager_t::block_temperature_t temperature)
         : parent(_parent),
-          extent_ref(parent->extent_manager->gen_extent()),
+          extent_ref(temperature == data_block_manager_t::block_cold_tier
+                     ? parent->extent_manager->gen_cold_tier_extent()
+                     : parent->extent_manager->gen_extent()),
           timestamp(current_microtime()),
           was_written(false),
           state(state_active),
@@ -346,7 +367,7 @@ public:
         state_young,
         // Candidate to be GCed. It is in gc_pq.
         state_old,
-        // Currently being GCed. It is equal to gc_state.current_entry.
+        // Currently being GCed. It is in gc_state.current_entries.
         state_in_gc
     } state;
 
@@ -382,7 +403,7 @@ private:
 data_block_manager_t::data_block_manager_t(const log_serializer_dynamic_config_t *_dynamic_config, extent_manager_t *em, log_serializer_t *_serializer, const log_serializer_on_disk_static_config_t *_static_config, log_serializer_stats_t *_stats)
     : stats(_stats), shutdown_callback(NULL), state(state_unstarted), dynamic_config(_dynamic_config),
       static_config(_static_config), extent_manager(em), serializer(_serializer),
-      gc_state(), gc_stats(stats)
+      latest_recency(repli_timestamp_t::invalid), gc_state(), gc_stats(stats)
 {
     rassert(dynamic_config != NULL);
     rassert(static_config != NULL);
@@ -458,6 +479,9 @@ void data_block_manager_t::start_existing(file_t *file,
         active_extent = NULL;
     }
 
+    cold_active_extent = NULL;
+    cold_tier_active_extent = NULL;
+
     /* Convert any extents that we found live blocks in, but that are not active
     extents, into old extents */
     while (gc_entry_t *entry = reconstructed_extents.head()) {
@@ -549,12 +573,13 @@ void read_ahead_interval(const int64_t block_offset,
 void read_ahead_offset_and_size(int64_t off_in,
                                 int64_t ser_block_size_in,
                                 int64_t extent_size,
+                                int64_t read_ahead_size,
                                 const std::vector<uint32_t> &boundaries,
                                 int64_t *offset_out, int64_t *size_out) {
     int64_t offset;
     int64_t end_offset;
     read_ahead_interval(off_in, ser_block_size_in, extent_size,
-                        APPROXIMATE_READ_AHEAD_SIZE,
+                        read_ahead_size,
                         DEVICE_BLOCK_SIZE,
                         boundaries,
                         &offset,
@@ -578,6 +603,7 @@ public:
     static void perform_read_ahead(data_block_manager_t *const parent,
                                    const int64_t off_in,
                                    const uint32_t ser_block_size_in,
+                                   const int64_t approximate_read_ahead_size,
                                    void *const buf_out,
                                    file_account_t *const io_account) {
         const std::vector<uint32_t> boundaries = get_boundaries(parent, off_in);
@@ -589,6 +615,7 @@ public:
         read_ahead_offset_and_size(off_in,
                                    ser_block_size_in,
                                    parent->static_config->extent_size(),
+                                   approximate_read_ahead_size,
                                    boundaries,
                                    &read_ahead_offset,
                                    &read_ahead_size);
@@ -639,13 +666,23 @@ public:
                     continue;
                 }
 
-                scoped_malloc_t<ser_buffer_t> data = parent->serializer->malloc();
-                memcpy(data.get(), current_buf, info.ser_block_size);
-                guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
-
                 counted_t<ls_block_token_pointee_t> ls_token
-                    = parent->serializer->generate_block_token(current_offset,
-                                                               block_size_t::unsafe_make(info.ser_block_size));
+                    = parent->serializer->generate_block_token_from_lba(current_offset,
+                                                                        info.ser_block_size);
+                const uint32_t disk_block_size = ls_token->disk_block_size().ser_value();
+                guarantee(disk_block_size <= *(lower_it + 1) - *lower_it);
+
+                parent->serializer->maybe_verify_block_checksum(
+                        ls_token, reinterpret_cast<const ser_buffer_t *>(current_buf));
+
+                scoped_malloc_t<ser_buffer_t> data = parent->serializer->malloc();
+                if (ls_token->is_compressed()) {
+                    parent->serializer->decompress_block(
+                            ls_token, reinterpret_cast<const ser_buffer_t *>(current_buf),
+                            data.get());
+                } else {
+                    memcpy(data.get(), current_buf, disk_block_size);
+                }
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, ls_token);
@@ -662,7 +699,27 @@ public:
 };
 
 
-bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
+int64_t data_block_manager_t::choose_read_ahead_size(int64_t offset,
+                                                     file_account_t *io_account) {
+    if (sequential_reads.size() >= MAX_SEQUENTIAL_READ_ACCOUNTS
+        && sequential_reads.find(io_account) == sequential_reads.end()) {
+        sequential_reads.clear();
+    }
+    sequential_read_state_t *sequential = &sequential_reads[io_account];
+
+    // A read is part of a sequential scan if it goes forward from the previous read
+    // through the same account.  Blocks that got read ahead are not read from disk
+    // again, so the next read of a scan can be up to a whole read-ahead window
+    // further.
+    if (sequential->last_read_offset != NULL_OFFSET
+        && offset > sequential->last_read_offset
+        && offset - sequential->last_read_offset <= SEQUENTIAL_READ_AHEAD_SIZE) {
+        ++sequential->count;
+    } else {
+        sequential->count = 0;
+    }
+    sequential->last_read_offset = offset;
+
     uint64_t extent_id = static_config->extent_index(offset);
 
     gc_entry_t *entry = entries.get(extent_id);
@@ -670,15 +727,28 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
     // If the extent was written, we don't perform read ahead because it would
     // a) be potentially useless and b) has an elevated risk of conflicting with
     // active writes on the io queue.
-    return !entry->was_written && serializer->should_perform_read_ahead();
+    if (entry->was_written) {
+        return 0;
+    }
+
+    if (serializer->should_perform_read_ahead()) {
+        return APPROXIMATE_READ_AHEAD_SIZE;
+    } else if (sequential->count >= SEQUENTIAL_READ_THRESHOLD
+               && serializer->should_perform_sequential_read_ahead()) {
+        ++stats->pm_serializer_sequential_read_aheads;
+        return SEQUENTIAL_READ_AHEAD_SIZE;
+    } else {
+        return 0;
+    }
 }
 
 void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
                                 void *buf_out, file_account_t *io_account) {
     guarantee(state == state_ready);
-    if (should_perform_read_ahead(off_in)) {
+    const int64_t read_ahead_size = choose_read_ahead_size(off_in, io_account);
+    if (read_ahead_size > 0) {
         dbm_read_ahead_t::perform_read_ahead(this, off_in, ser_block_size_in,
-                                             buf_out, io_account);
+                                             read_ahead_size, buf_out, io_account);
     } else {
         if (divides(DEVICE_BLOCK_SIZE, reinterpret_cast<intptr_t>(buf_out)) &&
             divides(DEVICE_BLOCK_SIZE, off_in) &&
@@ -702,18 +772,149 @@ std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
+    const double wa_target = dynamic_config->gc_write_amplification_target;
+    if (wa_target > 1.0) {
+        // Every byte our users write allows the GC to rewrite (wa_target - 1) bytes.
+        // We cap the credit at what a single GC round can consume, so that an idle
+        // period doesn't turn into a GC burst later on.
+        int64_t bytes = 0;
+        for (auto it = writes.begin(); it != writes.end(); ++it) {
+            bytes += gc_entry_t::aligned_value(it->block_size);
+        }
+        const int64_t max_credit = std::max<int64_t>(1, dynamic_config->gc_max_concurrent_extents)
+            * static_config->extent_size();
+        gc_state.write_credit
+            = std::min(max_credit,
+                       gc_state.write_credit + static_cast<int64_t>(bytes * (wa_target - 1.0)));
+    }
+
+    return write_blocks(writes, false, io_account, cb);
+}
+
+data_block_manager_t::block_temperature_t
+data_block_manager_t::block_temperature(block_id_t block_id) const {
+    const index_block_info_t info = serializer->lba_index->get_block_info(block_id);
+    if (!info.offset.has_value()) {
+        return block_hot;
+    }
+
+    const gc_entry_t *entry
+        = entries.get(static_config->extent_index(info.offset.get_value()));
+    if (entry != NULL
+        && (entry->state == gc_entry_t::state_old
+            || entry->state == gc_entry_t::state_in_gc)) {
+        return block_cold;
+    }
+    return block_hot;
+}
+
+gc_entry_t *&data_block_manager_t::active_extent_for(block_temperature_t temperature) {
+    switch (temperature) {
+    case block_hot:
+        return active_extent;
+    case block_cold:
+        return cold_active_extent;
+    case block_cold_tier:
+        return cold_tier_active_extent;
+    default:
+        unreachable();
+    }
+}
+
+void data_block_manager_t::note_recency(repli_timestamp_t recency) {
+    latest_recency = superceding_recency(latest_recency, recency);
+    if (!extent_manager->has_cold_tier() || dynamic_config->cold_tier_age_secs <= 0) {
+        return;
+    }
+
+    const microtime_t now = current_microtime();
+    const microtime_t interval
+        = std::max<microtime_t>(MILLION,
+                                static_cast<microtime_t>(dynamic_config->cold_tier_age_secs)
+                                * MILLION / COLD_TIER_RECENCY_CHECKPOINTS);
+    if (recency_checkpoints.empty()
+        || now >= recency_checkpoints.back().first + interval) {
+        recency_checkpoints.push_back(std::make_pair(now, latest_recency));
+    }
+}
+
+repli_timestamp_t data_block_manager_t::cold_tier_recency_threshold() {
+    if (!extent_manager->has_cold_tier() || dynamic_config->cold_tier_age_secs <= 0) {
+        return repli_timestamp_t::invalid;
+    }
+
+    const microtime_t age
+        = static_cast<microtime_t>(dynamic_config->cold_tier_age_secs) * MILLION;
+    const microtime_t now = current_microtime();
+    if (now < age) {
+        return repli_timestamp_t::invalid;
+    }
+    const microtime_t cutoff = now - age;
+    while (recency_checkpoints.size() >= 2 && recency_checkpoints[1].first <= cutoff) {
+        recency_checkpoints.pop_front();
+    }
+    if (recency_checkpoints.empty() || recency_checkpoints.front().first > cutoff) {
+        return repli_timestamp_t::invalid;
+    }
+    // Every block that was written after the checkpoint has at least its recency.
+    return recency_checkpoints.front().second;
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_blocks(const std::vector<buf_write_info_t> &writes,
+                                   bool rewritten_by_gc,
+                                   file_account_t *io_account,
+                                   iocallback_t *cb) {
     // Either we're ready to write, or we're shutting down and just finished reading
     // blocks for gc and called do_write.
     guarantee(state == state_ready ||
               (state == state_shutting_down && gc_state.step() == gc_write));
 
-    // These tokens are grouped by extent.  You can do a contiguous write in each
-    // extent.
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
-
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         it->buf->ser_header.block_id = it->block_id;
+        // The GC rewrites blocks as it read them from disk, so they keep the checksum
+        // they were first written with.  A new one would make a block that got
+        // corrupted on disk look sound to the scrubber from then on.
+        if (!rewritten_by_gc) {
+            it->buf->ser_header.padding = 0;
+            it->buf->ser_header.checksum = compute_block_checksum(it->buf, it->block_size);
+        }
+    }
+
+    // Split the writes up by temperature.  write_indices[t][k] is the index in
+    // writes of temperature_writes[t][k].
+    const size_t num_temperatures = 3;
+    std::vector<buf_write_info_t> temperature_writes[num_temperatures];
+    std::vector<size_t> write_indices[num_temperatures];
+    const repli_timestamp_t cold_tier_threshold
+        = rewritten_by_gc ? cold_tier_recency_threshold() : repli_timestamp_t::invalid;
+    for (size_t i = 0; i < writes.size(); ++i) {
+        block_temperature_t temperature;
+        if (!rewritten_by_gc) {
+            temperature = block_temperature(writes[i].block_id);
+        } else if (cold_tier_threshold != repli_timestamp_t::invalid
+                   && serializer->lba_index->get_block_recency(writes[i].block_id)
+                      < cold_tier_threshold) {
+            temperature = block_cold_tier;
+        } else {
+            temperature = block_cold;
+        }
+        temperature_writes[temperature].push_back(writes[i]);
+        write_indices[temperature].push_back(i);
+    }
+
+    // These tokens are grouped by extent.  You can do a contiguous write in each
+    // extent.
+    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
+        token_groups[num_temperatures];
+    size_t num_token_groups = 0;
+    for (size_t t = 0; t < num_temperatures; ++t) {
+        if (!temperature_writes[t].empty()) {
+            token_groups[t]
+                = gimme_some_new_offsets(temperature_writes[t],
+                                         static_cast<block_temperature_t>(t));
+            num_token_groups += token_groups[t].size();
+        }
     }
 
     struct intermediate_cb_t : public iocallback_t {
@@ -733,59 +934,63 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
     intermediate_cb_t *const intermediate_cb = new intermediate_cb_t;
     // We add 1 for degenerate case where token_groups is empty -- we call
     // intermediate_cb->on_io_complete later.
-    intermediate_cb->ops_remaining = token_groups.size() + 1;
+    intermediate_cb->ops_remaining = num_token_groups + 1;
     intermediate_cb->cb = cb;
 
-    size_t write_number = 0;
-    for (size_t i = 0; i < token_groups.size(); ++i) {
+    std::vector<counted_t<ls_block_token_pointee_t> > ret(writes.size());
 
-        const int64_t front_offset = token_groups[i].front()->offset();
-        const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+    for (size_t t = 0; t < num_temperatures; ++t) {
+        const std::vector<buf_write_info_t> &t_writes = temperature_writes[t];
+        std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > &t_groups
+            = token_groups[t];
 
-        guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
+        size_t write_number = 0;
+        for (size_t i = 0; i < t_groups.size(); ++i) {
 
-        const int64_t write_size = back_offset - front_offset;
+            const int64_t front_offset = t_groups[i].front()->offset();
+            const int64_t back_offset = t_groups[i].back()->offset()
+                + gc_entry_t::aligned_value(t_groups[i].back()->disk_block_size());
 
-        scoped_array_t<iovec> iovecs(token_groups[i].size());
+            guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
-        int64_t last_written_offset = front_offset;
+            const int64_t write_size = back_offset - front_offset;
 
-        for (size_t j = 0; j < token_groups[i].size(); ++j) {
-            const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
-            guarantee(j_offset == last_written_offset);
-            const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
+            scoped_array_t<iovec> iovecs(t_groups[i].size());
 
-            // The behavior of gimme_some_new_offsets is supposed to retain order, so
-            // we expect writes[write_number] to have the currently-relevant write.
-            guarantee(writes[write_number].block_size == j_block_size);
+            int64_t last_written_offset = front_offset;
 
-            iovecs[j].iov_base = writes[write_number].buf;
-            iovecs[j].iov_len = j_aligned_size;
-            last_written_offset = j_offset + j_aligned_size;
+            for (size_t j = 0; j < t_groups[i].size(); ++j) {
+                const int64_t j_offset = t_groups[i][j]->offset();
+                const block_size_t j_block_size = t_groups[i][j]->disk_block_size();
+                guarantee(j_offset == last_written_offset);
+                const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
 
-            ++write_number;
-        }
+                // The behavior of gimme_some_new_offsets is supposed to retain order,
+                // so we expect t_writes[write_number] to have the currently-relevant
+                // write.
+                guarantee(t_writes[write_number].block_size == j_block_size);
 
-        guarantee(last_written_offset == back_offset);
+                iovecs[j].iov_base = t_writes[write_number].buf;
+                iovecs[j].iov_len = j_aligned_size;
+                last_written_offset = j_offset + j_aligned_size;
 
-        dbfile->writev_async(front_offset, write_size,
-                             std::move(iovecs), io_account, intermediate_cb);
+                ret[write_indices[t][write_number]] = std::move(t_groups[i][j]);
+
+                ++write_number;
+            }
+
+            guarantee(last_written_offset == back_offset);
+
+            dbfile->writev_async(front_offset, write_size,
+                                 std::move(iovecs), io_account, intermediate_cb);
+        }
+        guarantee(write_number == t_writes.size());
     }
 
     // Call on_io_complete for degenerate case (we added 1 to ops_remaining
     // earlier).
     intermediate_cb->on_io_complete();
 
-    std::vector<counted_t<ls_block_token_pointee_t> > ret;
-    ret.reserve(writes.size());
-    for (auto it = token_groups.begin(); it != token_groups.end(); ++it) {
-        for (auto jt = it->begin(); jt != it->end(); ++jt) {
-            ret.push_back(std::move(*jt));
-        }
-    }
-
     return ret;
 }
 
@@ -822,10 +1027,14 @@ void data_block_manager_t::check_and_handle_empty_extent(uint64_t extent_id) {
                 break;
 
             /* Notify the GC that the extent got released during GC */
-            case gc_entry_t::state_in_gc:
-                guarantee(gc_state.current_entry == entry);
-                gc_state.current_entry = NULL;
+            case gc_entry_t::state_in_gc: {
+                auto jt = std::find(gc_state.current_entries.begin(),
+                                    gc_state.current_entries.end(),
+                                    entry);
+                guarantee(jt != gc_state.current_entries.end());
+                *jt = NULL;
                 break;
+            }
             default:
                 unreachable();
         }
@@ -847,7 +1056,11 @@ file_account_t *data_block_manager_t::choose_gc_io_account() {
 
     // This means that we can end up oscillating between both accounts, which
     // is probably fine. TODO: Make sure it actually is in practice!
-    if (garbage_ratio() > dynamic_config->gc_high_ratio * 1.02) {
+
+    // While the background work governor says foreground queries are too slow,
+    // we let the garbage pile up further before we compete with them.
+    const double high_ratio_margin = foreground_latency_at_risk() ? 1.1 : 1.02;
+    if (garbage_ratio() > dynamic_config->gc_high_ratio * high_ratio_margin) {
         return gc_io_account_high.get();
     } else {
         return gc_io_account_nice.get();
@@ -924,7 +1137,17 @@ struct block_write_cond_t : public cond_t, public iocallback_t {
 };
 
 void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num_writes) {
-    if (parent->gc_state.current_entry != NULL) {
+    // Extents whose blocks all became garbage since we read them have been set to
+    // NULL in current_entries.  We must not write their blocks.
+    std::vector<gc_write_t> live_writes;
+    live_writes.reserve(num_writes);
+    for (size_t i = 0; i < num_writes; ++i) {
+        if (parent->gc_state.current_entries[writes[i].entry_index] != NULL) {
+            live_writes.push_back(writes[i]);
+        }
+    }
+
+    if (!live_writes.empty()) {
         block_write_cond_t block_write_cond;
 
         // We acquire block tokens for all the blocks before writing new
@@ -932,7 +1155,7 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
         // correctly "alive" when we write it.
 
         std::vector<counted_t<ls_block_token_pointee_t> > old_block_tokens;
-        old_block_tokens.reserve(num_writes);
+        old_block_tokens.reserve(live_writes.size());
 
         // New block tokens, to hold the return value of
         // data_block_manager_t::write() instead of immediately discarding the
@@ -944,30 +1167,41 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
             ASSERT_NO_CORO_WAITING;
 
             std::vector<buf_write_info_t> the_writes;
-            the_writes.reserve(num_writes);
-            for (size_t i = 0; i < num_writes; ++i) {
-                old_block_tokens.push_back(parent->serializer->generate_block_token(writes[i].old_offset,
-                                                                                    writes[i].block_size));
-
-                the_writes.push_back(buf_write_info_t(writes[i].buf,
-                                                      writes[i].block_size,
-                                                      writes[i].buf->ser_header.block_id));
+            the_writes.reserve(live_writes.size());
+            for (auto it = live_writes.begin(); it != live_writes.end(); ++it) {
+                old_block_tokens.push_back(parent->serializer->generate_block_token(it->old_offset,
+                                                                                    it->block_size));
+
+                the_writes.push_back(buf_write_info_t(it->buf,
+                                                      it->block_size,
+                                                      it->buf->ser_header.block_id));
             }
 
             new_block_tokens
-                = parent->many_writes(the_writes, parent->choose_gc_io_account(),
-                                      &block_write_cond);
-
-            guarantee(new_block_tokens.size() == num_writes);
+                = parent->write_blocks(the_writes, true, parent->choose_gc_io_account(),
+                                       &block_write_cond);
+
+            guarantee(new_block_tokens.size() == live_writes.size());
+
+            // write_blocks() gives us tokens for the on-disk sizes of the blocks.
+            // Blocks that are stored compressed need tokens that know about that,
+            // or their index entries would lose the compression flag.
+            for (size_t i = 0; i < live_writes.size(); ++i) {
+                const index_block_info_t info = parent->serializer->lba_index->get_block_info(
+                        live_writes[i].buf->ser_header.block_id);
+                if (info.offset.has_value()
+                    && info.offset.get_value() == live_writes[i].old_offset
+                    && lba_block_is_compressed(info.ser_block_size)) {
+                    new_block_tokens[i]
+                        = parent->serializer->generate_block_token_from_lba(
+                                new_block_tokens[i]->offset(), info.ser_block_size);
+                }
+            }
         }
 
         // Step 2: Wait on all writes to finish
         block_write_cond.wait();
 
-        // We created block tokens for our blocks we're writing, so
-        // there's no way the current entry could have become NULL.
-        guarantee(parent->gc_state.current_entry != NULL);
-
         std::vector<index_write_op_t> index_write_ops;
 
         // Step 3: Figure out index ops.  It's important that we do this
@@ -976,12 +1210,16 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
         {
             ASSERT_NO_CORO_WAITING;
 
-            for (size_t i = 0; i < num_writes; ++i) {
-                unsigned int block_index
-                    = parent->gc_state.current_entry->block_index(writes[i].old_offset);
+            for (size_t i = 0; i < live_writes.size(); ++i) {
+                // We created block tokens for our blocks we're writing, so
+                // there's no way the entry could have become NULL.
+                gc_entry_t *entry = parent->gc_state.current_entries[live_writes[i].entry_index];
+                guarantee(entry != NULL);
 
-                if (parent->gc_state.current_entry->block_referenced_by_index(block_index)) {
-                    block_id_t block_id = writes[i].buf->ser_header.block_id;
+                unsigned int block_index = entry->block_index(live_writes[i].old_offset);
+
+                if (entry->block_referenced_by_index(block_index)) {
+                    block_id_t block_id = live_writes[i].buf->ser_header.block_id;
 
                     index_write_ops.push_back(
                             index_write_op_t(block_id,
@@ -998,13 +1236,13 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
             // Step 4A: Remap tokens to new offsets.  It is important
             // that we do this _before_ calling index_write.
             // Otherwise, the token_offset map would still point to
-            // the extent we're gcing.  Then somebody could do an
+            // the extents we're gcing.  Then somebody could do an
             // index_write after our index_write starts but before it
             // returns in Step 4 below, resulting in i_array entries
-            // that point to the current entry.  This should empty out
+            // that point to the current entries.  This should empty out
             // all the t_array bits.
-            for (size_t i = 0; i < num_writes; ++i) {
-                parent->serializer->remap_block_to_new_offset(writes[i].old_offset, new_block_tokens[i]->offset());
+            for (size_t i = 0; i < live_writes.size(); ++i) {
+                parent->serializer->remap_block_to_new_offset(live_writes[i].old_offset, new_block_tokens[i]->offset());
             }
 
             // Step 4A-2: Now that the block tokens have been remapped
@@ -1042,6 +1280,54 @@ void data_block_manager_t::on_gc_write_done() {
     run_gc();
 }
 
+void data_block_manager_t::read_live_blocks_for_gc(gc_entry_t *entry, char *buf) {
+    // We're going to send as few discrete reads as possible, minimizing
+    // disk->CPU bandwidth usage, instead of simply reading the entire
+    // extent.
+
+    uint32_t current_interval_begin = 0;
+    uint32_t current_interval_end = 0;
+
+    const int64_t extent_offset = entry->extent_ref.offset();
+
+    for (unsigned int i = 0, bpe = entry->num_blocks(); i < bpe; ++i) {
+        if (!entry->block_is_garbage(i)) {
+            const uint32_t beg = entry->relative_offset(i);
+            rassert(divides(DEVICE_BLOCK_SIZE, beg));
+
+            const uint32_t end = entry->relative_offset(i)
+                + gc_entry_t::aligned_value(entry->block_size(i));
+
+            if (beg <= current_interval_end) {
+                current_interval_end = end;
+            } else {
+                if (current_interval_end > current_interval_begin) {
+                    gc_state.refcount++;
+                    dbfile->read_async(
+                            extent_offset + current_interval_begin,
+                            current_interval_end - current_interval_begin,
+                            buf + current_interval_begin,
+                            choose_gc_io_account(),
+                            &gc_state.gc_read_callback);
+                }
+
+                current_interval_begin = beg;
+                current_interval_end = end;
+            }
+        }
+    }
+
+    guarantee(current_interval_begin < current_interval_end);
+
+    gc_state.refcount++;
+    dbfile->read_async(
+            extent_offset + current_interval_begin,
+            current_interval_end - current_interval_begin,
+            buf + current_interval_begin,
+            choose_gc_io_account(),
+            &gc_state.gc_read_callback);
+}
+
 void data_block_manager_t::run_gc() {
     bool run_again = true;
     while (run_again) {
@@ -1054,16 +1340,32 @@ void data_block_manager_t::run_gc() {
 
                 ASSERT_NO_CORO_WAITING;
 
-                ++stats->pm_serializer_data_extents_gced;
-
-                /* grab the entry */
-                gc_state.current_entry = gc_pq.pop();
-                gc_state.current_entry->our_pq_entry = NULL;
+                /* grab the entries.  Every extent we take out of gc_pq lowers the
+                garbage ratio, so we stop as soon as we've got enough of them to get
+                back to gc_low_ratio (or to use up our write credit). */
+                guarantee(gc_state.current_entries.empty());
+                const size_t max_entries
+                    = std::max<int32_t>(1, dynamic_config->gc_max_concurrent_extents);
+                do {
+                    gc_entry_t *entry = gc_pq.pop();
+                    entry->our_pq_entry = NULL;
+
+                    guarantee(entry->state == gc_entry_t::state_old);
+                    entry->state = gc_entry_t::state_in_gc;
+                    gc_stats.old_garbage_block_bytes -= entry->garbage_bytes();
+                    gc_stats.old_total_block_bytes -= static_config->extent_size();
+
+                    if (dynamic_config->gc_write_amplification_target > 1.0) {
+                        // The live bytes are what we are going to rewrite.
+                        gc_state.write_credit
+                            -= static_config->extent_size() - entry->garbage_bytes();
+                    }
 
-                guarantee(gc_state.current_entry->state == gc_entry_t::state_old);
-                gc_state.current_entry->state = gc_entry_t::state_in_gc;
-                gc_stats.old_garbage_block_bytes -= gc_state.current_entry->garbage_bytes();
-                gc_stats.old_total_block_bytes -= static_config->extent_size();
+                    ++stats->pm_serializer_data_extents_gced;
+                    gc_state.current_entries.push_back(entry);
+                } while (gc_state.current_entries.size() < max_entries
+                         && !gc_pq.empty()
+                         && should_we_keep_gcing());
 
                 /* read all the live data into buffers */
 
@@ -1080,60 +1382,19 @@ void data_block_manager_t::run_gc() {
                 gc_state.refcount++;
 
                 guarantee(!gc_state.gc_blocks.has());
-                gc_state.gc_blocks.init(malloc_aligned(extent_manager->extent_size,
+                gc_state.gc_blocks.init(malloc_aligned(extent_manager->extent_size
+                                                       * gc_state.current_entries.size(),
                                                        DEVICE_BLOCK_SIZE));
                 gc_state.set_step(gc_read);
 
-                // We're going to send as few discrete reads as possible, minimizing
-                // disk->CPU bandwidth usage, instead of simply reading the entire
-                // extent.
-
-                uint32_t current_interval_begin = 0;
-                uint32_t current_interval_end = 0;
-
-                const int64_t extent_offset = gc_state.current_entry->extent_ref.offset();
-
-                for (unsigned int i = 0, bpe = gc_state.current_entry->num_blocks();
-                     i < bpe;
-                     ++i) {
-                    if (!gc_state.current_entry->block_is_garbage(i)) {
-                        const uint32_t beg
-                            = gc_state.current_entry->relative_offset(i);
-                        rassert(divides(DEVICE_BLOCK_SIZE, beg));
-
-                        const uint32_t end
-                            = gc_state.current_entry->relative_offset(i)
-                            + gc_entry_t::aligned_value(gc_state.current_entry->block_size(i));
-
-                        if (beg <= current_interval_end) {
-                            current_interval_end = end;
-                        } else {
-                            if (current_interval_end > current_interval_begin) {
-                                gc_state.refcount++;
-                                dbfile->read_async(
-                                        extent_offset + current_interval_begin,
-                                        current_interval_end - current_interval_begin,
-                                        gc_state.gc_blocks.get() + current_interval_begin,
-                                        choose_gc_io_account(),
-                                        &gc_state.gc_read_callback);
-                            }
-
-                            current_interval_begin = beg;
-                            current_interval_end = end;
-                        }
-                    }
+                // The reads for all extents are issued in one go, so that the disk
+                // can work on all of them at the same time.
+                for (size_t i = 0; i < gc_state.current_entries.size(); ++i) {
+                    read_live_blocks_for_gc(gc_state.current_entries[i],
+                                            gc_state.gc_blocks.get()
+                                            + i * extent_manager->extent_size);
                 }
 
-                guarantee(current_interval_begin < current_interval_end);
-
-                gc_state.refcount++;
-                dbfile->read_async(
-                        extent_offset + current_interval_begin,
-                        current_interval_end - current_interval_begin,
-                        gc_state.gc_blocks.get() + current_interval_begin,
-                        choose_gc_io_account(),
-                        &gc_state.gc_read_callback);
-
                 // Fall through to the gc_read case, where we
                 // decrement the refcount we incremented before the
                 // for loop.
@@ -1145,36 +1406,54 @@ void data_block_manager_t::run_gc() {
                     break;
                 }
 
-                /* If other forces cause all of the blocks in the extent to become
-                garbage before we even finish GCing it, they will set current_entry
-                to NULL. */
-                if (gc_state.current_entry == NULL) {
+                /* If other forces cause all of the blocks in the extents to become
+                garbage before we even finish GCing them, they will set their
+                current_entries slots to NULL. */
+                if (gc_state.all_current_entries_released()) {
                     guarantee(gc_state.gc_blocks.has());
                     gc_state.gc_blocks.reset();
+                    gc_state.current_entries.clear();
                     gc_state.set_step(gc_ready);
                     break;
                 }
 
                 /* an array to put our writes in */
-                size_t num_writes = gc_state.current_entry->num_live_blocks();
+                size_t num_writes = 0;
+                for (auto it = gc_state.current_entries.begin();
+                     it != gc_state.current_entries.end();
+                     ++it) {
+                    if (*it != NULL) {
+                        num_writes += (*it)->num_live_blocks();
+                    }
+                }
 
                 gc_writes.clear();
                 gc_writes.reserve(num_writes);
-                for (unsigned int i = 0, iend = gc_state.current_entry->num_blocks(); i < iend; ++i) {
-
-                    /* We re-check the bit array here in case a write came in for one
-                    of the blocks we are GCing. We wouldn't want to overwrite the new
-                    valid data with out-of-date data. */
-                    if (gc_state.current_entry->block_is_garbage(i)) {
+                for (size_t j = 0; j < gc_state.current_entries.size(); ++j) {
+                    gc_entry_t *entry = gc_state.current_entries[j];
+                    if (entry == NULL) {
                         continue;
                     }
 
-                    ser_buffer_t *block = reinterpret_cast<ser_buffer_t *>(gc_state.gc_blocks.get() + gc_state.current_entry->relative_offset(i));
-                    const int64_t block_offset = gc_state.current_entry->extent_ref.offset()
-                        + gc_state.current_entry->relative_offset(i);
+                    char *const extent_blocks
+                        = gc_state.gc_blocks.get() + j * extent_manager->extent_size;
 
-                    gc_writes.push_back(gc_write_t(block, block_offset,
-                                                   gc_state.current_entry->block_size(i)));
+                    for (unsigned int i = 0, iend = entry->num_blocks(); i < iend; ++i) {
+
+                        /* We re-check the bit array here in case a write came in for
+                        one of the blocks we are GCing. We wouldn't want to overwrite
+                        the new valid data with out-of-date data. */
+                        if (entry->block_is_garbage(i)) {
+                            continue;
+                        }
+
+                        ser_buffer_t *block = reinterpret_cast<ser_buffer_t *>(extent_blocks + entry->relative_offset(i));
+                        const int64_t block_offset = entry->extent_ref.offset()
+                            + entry->relative_offset(i);
+
+                        gc_writes.push_back(gc_write_t(block, block_offset,
+                                                       entry->block_size(i), j));
+                    }
                 }
 
                 guarantee(gc_writes.size() == num_writes);
@@ -1194,21 +1473,27 @@ void data_block_manager_t::run_gc() {
                 //We need to do this here so that we don't
                 //get stuck on the GC treadmill
                 mark_unyoung_entries();
-                /* Our write should have forced all of the blocks in the extent to
-                become garbage, which should have caused the extent to be released
-                and gc_state.current_entry to become NULL. */
-
-                guarantee(gc_state.current_entry == NULL,
-                          "%p: %" PRIu32 " garbage bytes left on the extent, %" PRIu32
-                          " index-referenced bytes, %" PRIu32
-                          " token-referenced bytes, at offset %" PRIi64
-                          ".  block dump:\n%s\n",
-                          this,
-                          gc_state.current_entry->garbage_bytes(),
-                          gc_state.current_entry->index_bytes(),
-                          gc_state.current_entry->token_bytes(),
-                          gc_state.current_entry->extent_ref.offset(),
-                          gc_state.current_entry->format_block_infos("\n").c_str());
+                /* Our write should have forced all of the blocks in the extents to
+                become garbage, which should have caused the extents to be released
+                and their gc_state.current_entries slots to become NULL. */
+
+                for (auto it = gc_state.current_entries.begin();
+                     it != gc_state.current_entries.end();
+                     ++it) {
+                    gc_entry_t *entry = *it;
+                    guarantee(entry == NULL,
+                              "%p: %" PRIu32 " garbage bytes left on the extent, %" PRIu32
+                              " index-referenced bytes, %" PRIu32
+                              " token-referenced bytes, at offset %" PRIi64
+                              ".  block dump:\n%s\n",
+                              this,
+                              entry->garbage_bytes(),
+                              entry->index_bytes(),
+                              entry->token_bytes(),
+                              entry->extent_ref.offset(),
+                              entry->format_block_infos("\n").c_str());
+                }
+                gc_state.current_entries.clear();
 
                 guarantee(gc_state.refcount == 0);
 
@@ -1268,6 +1553,18 @@ void data_block_manager_t::actually_shutdown() {
         active_extent = NULL;
     }
 
+    if (cold_active_extent != NULL) {
+        UNUSED int64_t extent = cold_active_extent->extent_ref.release();
+        delete cold_active_extent;
+        cold_active_extent = NULL;
+    }
+
+    if (cold_tier_active_extent != NULL) {
+        UNUSED int64_t extent = cold_tier_active_extent->extent_ref.release();
+        delete cold_tier_active_extent;
+        cold_tier_active_extent = NULL;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1286,17 +1583,20 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                                             block_temperature_t temperature) {
     ASSERT_NO_CORO_WAITING;
 
+    gc_entry_t *&extent = active_extent_for(temperature);
+
     // Start a new extent if necessary.
-    if (active_extent == NULL) {
-        active_extent = new gc_entry_t(this);
+    if (extent == NULL) {
+        extent = new gc_entry_t(this, temperature);
         ++stats->pm_serializer_data_extents_allocated;
     }
 
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee(extent->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
@@ -1304,25 +1604,25 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
+        if (!extent->new_offset(it->block_size,
+                                &relative_offset, &block_index)) {
+            // Move the active gc_entry_t to the young extent queue (if it's
             // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
+            if (extent->num_live_blocks() == 0) {
+                gc_entry_t *old_active_extent = extent;
+                extent = new gc_entry_t(this, temperature);
                 destroy_entry(old_active_extent);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                young_extent_queue.push_back(active_extent);
+                extent->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(extent);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                extent = new gc_entry_t(this, temperature);
             }
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = extent->new_offset(it->block_size,
+                                                      &relative_offset,
+                                                      &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1332,9 +1632,9 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = extent->extent_ref.offset() + relative_offset;
+        extent->was_written = true;
+        extent->mark_live_tokenwise(block_index);
 
         tokens.push_back(serializer->generate_block_token(offset, it->block_size));
     }
@@ -1380,19 +1680,33 @@ void data_block_manager_t::remove_last_unyoung_entry() {
 
 /* functions for gc structures */
 
+bool data_block_manager_t::gc_write_credit_available() const {
+    return dynamic_config->gc_write_amplification_target > 1.0
+        && gc_state.write_credit > 0;
+}
+
 // Answers the following question: We're in the middle of gc'ing, and
 // look, it's the next largest entry.  Should we keep gc'ing?  Returns
-// false when the entry is active or young, or when its garbage ratio
-// is lower than GC_THRESHOLD_RATIO_*.
+// false when the garbage ratio is lower than gc_low_ratio.  If the write
+// amplification target is enabled, we additionally need write credit unless
+// the garbage ratio is above gc_high_ratio.
 bool data_block_manager_t::should_we_keep_gcing() const {
-    return garbage_ratio() > dynamic_config->gc_low_ratio;
+    const double ratio = garbage_ratio();
+    if (dynamic_config->gc_write_amplification_target > 1.0
+        && ratio <= dynamic_config->gc_high_ratio) {
+        return ratio > dynamic_config->gc_low_ratio && gc_write_credit_available();
+    }
+    return ratio > dynamic_config->gc_low_ratio;
 }
 
 // Answers the following question: Do we want to bother gc'ing?
-// Returns true when our garbage_ratio is greater than
-// GC_THRESHOLD_RATIO_*.
+// Returns true when our garbage_ratio is greater than gc_high_ratio, or
+// when it is greater than gc_low_ratio and the write amplification
+// target lets us rewrite some more data.
 bool data_block_manager_t::do_we_want_to_start_gcing() const {
-    return garbage_ratio() > dynamic_config->gc_high_ratio;
+    const double ratio = garbage_ratio();
+    return ratio > dynamic_config->gc_high_ratio
+        || (ratio > dynamic_config->gc_low_ratio && gc_write_credit_available());
 }
 
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
@@ -2,6 +2,9 @@
 #ifndef SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 #define SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 
+#include <deque>
+#include <map>
+#include <utility>
 #include <vector>
 
 #include "arch/types.hpp"
@@ -10,6 +13,7 @@
 #include "containers/scoped.hpp"
 #include "containers/two_level_array.hpp"
 #include "perfmon/types.hpp"
+#include "repli_timestamp.hpp"
 #include "serializer/log/config.hpp"
 #include "serializer/log/extent_manager.hpp"
 #include "serializer/types.hpp"
@@ -37,10 +41,12 @@ private:
         ser_buffer_t *buf;
         int64_t old_offset;
         block_size_t block_size;
+        // The index of the extent the block comes from in gc_state.current_entries.
+        size_t entry_index;
         gc_write_t(ser_buffer_t *b, int64_t _old_offset,
-                   block_size_t _block_size)
+                   block_size_t _block_size, size_t _entry_index)
             : buf(b), old_offset(_old_offset),
-              block_size(_block_size) { }
+              block_size(_block_size), entry_index(_entry_index) { }
     };
 
     struct gc_writer_t {
@@ -102,13 +108,67 @@ public:
                 file_account_t *io_account,
                 iocallback_t *cb);
 
+    /* Tells the GC that a block was written with the given recency, so that it can
+    tell how old the recency of a block that it rewrites is in seconds. */
+    void note_recency(repli_timestamp_t recency);
+
+    /* Blocks are placed into different active extents depending on their
+    temperature, so that blocks that get rewritten often don't share extents with
+    blocks that stay around for a long time.  Hot extents then become almost
+    entirely garbage before they're GCed, and cold extents rarely need to be GCed
+    at all. */
+    enum block_temperature_t {
+        // New blocks, and blocks whose previous version was still in an active or a
+        // young extent.
+        block_hot,
+        // Blocks rewritten by the GC, and blocks whose previous version had aged
+        // into an old extent.
+        block_cold,
+        // Blocks rewritten by the GC that haven't been written for
+        // dynamic_config->cold_tier_age_secs, if the serializer has a cold tier.
+        // Their extents are in the cold tier file.
+        block_cold_tier
+    };
+
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
+    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                           block_temperature_t temperature);
 
 
 private:
     void actually_shutdown();
 
+    // Does the actual work for many_writes, without counting the writes against the
+    // GC write amplification target.  The GC calls this with rewritten_by_gc set
+    // to true, which makes all blocks go to the cold active extent.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_blocks(const std::vector<buf_write_info_t> &writes,
+                 bool rewritten_by_gc,
+                 file_account_t *io_account,
+                 iocallback_t *cb);
+
+    // Figures out the temperature of a block that is written by a user of the
+    // serializer, by looking at the extent that holds its current version.
+    block_temperature_t block_temperature(block_id_t block_id) const;
+
+    // The active extent that blocks of the given temperature are written to.
+    gc_entry_t *&active_extent_for(block_temperature_t temperature);
+
+    // Blocks whose recency is older than this haven't been written for
+    // dynamic_config->cold_tier_age_secs and go to the cold tier when the GC
+    // rewrites them.  Returns repli_timestamp_t::invalid if no block should go
+    // there, because there's no cold tier or the serializer hasn't been running
+    // for long enough to tell.
+    repli_timestamp_t cold_tier_recency_threshold();
+
+    // Issues the reads for all live blocks of entry into buf, which must be at
+    // least extent_size bytes large.
+    void read_live_blocks_for_gc(gc_entry_t *entry, char *buf);
+
+    // Tells if the GC write amplification target is enabled and would let us
+    // rewrite another extent right now.
+    bool gc_write_credit_available() const;
+
     file_account_t *choose_gc_io_account();
 
     /* Checks whether the extent is empty and if it is, notifies the extent manager
@@ -127,7 +187,10 @@ private:
 
     void destroy_entry(gc_entry_t *entry);
 
-    bool should_perform_read_ahead(int64_t offset);
+    /* Returns how much data should be read around a block read at `offset`, or 0 if
+    the block should be read on its own.  Also keeps track of whether the reads
+    through `io_account` look like a sequential scan. */
+    int64_t choose_read_ahead_size(int64_t offset, file_account_t *io_account);
 
     /* internal garbage collection structures */
     struct gc_read_callback_t : public iocallback_t {
@@ -172,15 +235,45 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* Contains the extent in the gc_entry_t::state_active state that hot blocks are
+    written to.  It is stored in the metablock. */
     gc_entry_t *active_extent;
 
+    /* Contains the extent in the gc_entry_t::state_active state that cold blocks
+    are written to.  It is not stored in the metablock, so after a restart it gets
+    reconstructed as an ordinary old extent. */
+    gc_entry_t *cold_active_extent;
+
+    /* The same for blocks that go to the cold tier. */
+    gc_entry_t *cold_tier_active_extent;
+
+    /* The latest recency that has been written, and what it was at most every
+    cold_tier_age_secs / COLD_TIER_RECENCY_CHECKPOINTS seconds, oldest first.
+    Recencies are logical timestamps, these tell what recency a block had to have
+    at a certain time.  Only the checkpoints younger than cold_tier_age_secs and
+    the one before them are kept. */
+    repli_timestamp_t latest_recency;
+    std::deque<std::pair<microtime_t, repli_timestamp_t> > recency_checkpoints;
+
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
 
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* The offset of the last block read, and the number of reads in a row before it
+    that went forward through the file.  Used to detect sequential scans. */
+    struct sequential_read_state_t {
+        sequential_read_state_t() : last_read_offset(NULL_OFFSET), count(0) { }
+        int64_t last_read_offset;
+        int count;
+    };
+
+    /* Kept per I/O account, so that a backfill or a table scan streaming through
+    its own account is still recognized as sequential while other queries read
+    blocks from all over the file. */
+    std::map<file_account_t *, sequential_read_state_t> sequential_reads;
+
 
     /* Buffer used during GC. */
     std::vector<gc_write_t> gc_writes;
@@ -219,14 +312,20 @@ private:
         scoped_malloc_t<char> gc_blocks;
 
 
-        // The entry we're currently GCing.
-        gc_entry_t *current_entry;
+        // The entries we're currently GCing.  The live blocks of
+        // current_entries[i] are read into gc_blocks at offset i * extent_size.  An
+        // entry is set to NULL when all of its blocks become garbage while we're
+        // GCing it.
+        std::vector<gc_entry_t *> current_entries;
+
+        // How many more bytes the GC may rewrite before it exceeds the write
+        // amplification target.  Only used if the target is enabled.
+        int64_t write_credit;
 
         data_block_manager_t::gc_read_callback_t gc_read_callback;
 
         gc_state_t()
-            : step_(gc_ready), refcount(0),
-              current_entry(NULL) { }
+            : step_(gc_ready), refcount(0), write_credit(0) { }
 
         ~gc_state_t() { }
 
@@ -236,6 +335,16 @@ private:
         void set_step(gc_step next_step) {
             step_ = next_step;
             rassert(step_ != gc_ready || !gc_blocks.has());
+            rassert(step_ != gc_ready || current_entries.empty());
+        }
+
+        bool all_current_entries_released() const {
+            for (auto it = current_entries.begin(); it != current_entries.end(); ++it) {
+                if (*it != NULL) {
+                    return false;
+                }
+            }
+            return true;
         }
     };
 
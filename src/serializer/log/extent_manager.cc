@@ -4,6 +4,7 @@
 #include <queue>
 
 #include "arch/arch.hpp"
+#include "arch/runtime/coroutines.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/log/log_serializer.hpp"
@@ -13,7 +14,10 @@ public:
     enum state_t {
         state_unreserved,
         state_in_use,
-        state_free
+        state_free,
+        // Not in use anymore, but not in the free queue yet because we're punching a
+        // hole into the file where it is.
+        state_punching
     };
 private:
     state_t state_;
@@ -43,9 +47,14 @@ public:
 class extent_zone_t {
     const size_t extent_size;
 
+    // The offset of the zone's file in the serializer's offset space.  The zone's
+    // extents are at base + id * extent_size, and at id * extent_size in the file.
+    const int64_t base;
+
     size_t offset_to_id(int64_t extent) const {
-        rassert(divides(extent_size, extent));
-        return extent / extent_size;
+        rassert(extent >= base);
+        rassert(divides(extent_size, extent - base));
+        return (extent - base) / extent_size;
     }
 
     /* free-list and extent map. Contains one entry per extent.  During the
@@ -68,13 +77,21 @@ class extent_zone_t {
     // The number of free extents in the file.
     size_t held_extents_;
 
+    // How many extents past the end of the used extents are preallocated in the file.
+    // We don't shrink the file below that, and not at all while a preallocation is
+    // running.
+    size_t preallocated_extents_;
+    bool preallocation_running_;
+
 public:
     size_t held_extents() const {
         return held_extents_;
     }
 
-    extent_zone_t(file_t *_dbfile, size_t _extent_size)
-        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0) {
+    extent_zone_t(file_t *_dbfile, size_t _extent_size, size_t _preallocated_extents,
+                  int64_t _base)
+        : extent_size(_extent_size), base(_base), dbfile(_dbfile), held_extents_(0),
+          preallocated_extents_(_preallocated_extents), preallocation_running_(false) {
         // (Avoid a bunch of reallocations by resize calls (avoiding O(n log n)
         // work on average).)
         extents.reserve(dbfile->get_size() / extent_size);
@@ -103,11 +120,11 @@ public:
     }
 
     extent_reference_t gen_extent() {
-        int64_t extent;
+        size_t id;
 
         if (free_queue.empty()) {
             rassert(held_extents_ == 0);
-            extent = extents.size() * extent_size;
+            id = extents.size();
             extents.push_back(extent_info_t());
         } else if (free_queue.top() >= extents.size()) {
             rassert(held_extents_ == 0);
@@ -115,24 +132,38 @@ public:
                                 std::vector<size_t>,
                                 std::greater<size_t> > tmp;
             free_queue = tmp;
-            extent = extents.size() * extent_size;
+            id = extents.size();
             extents.push_back(extent_info_t());
         } else {
-            extent = free_queue.top() * extent_size;
+            id = free_queue.top();
             free_queue.pop();
             --held_extents_;
         }
 
-        extent_info_t *info = &extents[offset_to_id(extent)];
+        extent_info_t *info = &extents[id];
         info->set_state(extent_info_t::state_in_use);
 
-        extent_reference_t extent_ref = make_extent_reference(extent);
+        extent_reference_t extent_ref = make_extent_reference(base + id * extent_size);
 
-        dbfile->set_size_at_least(extent + extent_size);
+        dbfile->set_size_at_least((id + 1) * extent_size);
 
         return extent_ref;
     }
 
+    // The end of the last extent that is in use (or free, but not yet given back to
+    // the file system), in the zone's file.
+    int64_t extents_end() const {
+        return extents.size() * extent_size;
+    }
+
+    void set_preallocated_extents(size_t preallocated_extents) {
+        preallocated_extents_ = preallocated_extents;
+    }
+
+    void set_preallocation_running(bool preallocation_running) {
+        preallocation_running_ = preallocation_running;
+    }
+
     extent_reference_t make_extent_reference(const int64_t extent) {
         size_t id = offset_to_id(extent);
         guarantee(id < extents.size());
@@ -152,7 +183,10 @@ public:
         }
 
         if (shrink_file) {
-            dbfile->set_size(extents.size() * extent_size);
+            const int64_t new_size = (extents.size() + preallocated_extents_) * extent_size;
+            if (!preallocation_running_ && new_size < dbfile->get_size()) {
+                dbfile->set_size(new_size);
+            }
 
             // Prevent the existence of a relatively large free queue after the file
             // size shrinks.
@@ -176,29 +210,62 @@ public:
         }
     }
 
-    void release_extent(extent_reference_t &&extent_ref) {
+    // Returns true if the extent went into state_punching, in which case the caller
+    // has to punch a hole where the extent is and then call finish_punching().  We
+    // don't bother with the last extent, since the file will be shrunk instead.
+    MUST_USE bool release_extent(extent_reference_t &&extent_ref, bool punch_hole) {
         int64_t extent = extent_ref.release();
-        extent_info_t *info = &extents[offset_to_id(extent)];
+        const size_t id = offset_to_id(extent);
+        extent_info_t *info = &extents[id];
         guarantee(info->state() == extent_info_t::state_in_use);
         guarantee(info->extent_use_refcount > 0);
         --info->extent_use_refcount;
         if (info->extent_use_refcount == 0) {
-            info->set_state(extent_info_t::state_free);
-            free_queue.push(offset_to_id(extent));
-            ++held_extents_;
-            try_shrink_file();
+            if (punch_hole && id + 1 < extents.size()) {
+                info->set_state(extent_info_t::state_punching);
+                return true;
+            }
+            free_extent(id);
         }
+        return false;
+    }
+
+    void finish_punching(int64_t extent) {
+        const size_t id = offset_to_id(extent);
+        guarantee(id < extents.size());
+        guarantee(extents[id].state() == extent_info_t::state_punching);
+        free_extent(id);
+    }
+
+private:
+    void free_extent(size_t id) {
+        extents[id].set_state(extent_info_t::state_free);
+        free_queue.push(id);
+        ++held_extents_;
+        try_shrink_file();
     }
 };
 
 extent_manager_t::extent_manager_t(file_t *file,
+                                   file_t *cold_tier_file,
+                                   const log_serializer_dynamic_config_t *_dynamic_config,
                                    const log_serializer_on_disk_static_config_t *static_config,
                                    log_serializer_stats_t *_stats)
     : stats(_stats), extent_size(static_config->extent_size()),
+      dynamic_config(_dynamic_config), dbfile(file),
+      preallocation_running(false), preallocation_failed(false),
+      hole_punching_failed(false), background_drainer(new auto_drainer_t),
       state(state_reserving_extents) {
     guarantee(divides(DEVICE_BLOCK_SIZE, extent_size));
 
-    zone.init(new extent_zone_t(file, extent_size));
+    zone.init(new extent_zone_t(file, extent_size,
+                                std::max<int32_t>(dynamic_config->preallocated_extents, 0),
+                                0));
+    if (cold_tier_file != NULL) {
+        // The cold tier grows on demand; it's written to by the GC only.
+        cold_zone.init(new extent_zone_t(cold_tier_file, extent_size, 0,
+                                         ls_block_token_pointee_t::cold_tier_offset_base));
+    }
 }
 
 extent_manager_t::~extent_manager_t() {
@@ -210,7 +277,10 @@ extent_reference_t extent_manager_t::reserve_extent(int64_t extent) {
     rassert(state == state_reserving_extents);
     ++stats->pm_extents_in_use;
     stats->pm_bytes_in_use += extent_size;
-    return zone->reserve_extent(extent);
+    if (extent >= ls_block_token_pointee_t::cold_tier_offset_base) {
+        ++stats->pm_serializer_cold_tier_extents;
+    }
+    return zone_for(extent)->reserve_extent(extent);
 }
 
 void extent_manager_t::prepare_initial_metablock(metablock_mixin_t *mb) {
@@ -222,6 +292,9 @@ void extent_manager_t::start_existing(UNUSED metablock_mixin_t *last_metablock)
     rassert(state == state_reserving_extents);
     current_transaction = NULL;
     zone->reconstruct_free_list();
+    if (cold_zone.has()) {
+        cold_zone->reconstruct_free_list();
+    }
     state = state_running;
 
 }
@@ -232,10 +305,17 @@ void extent_manager_t::prepare_metablock(metablock_mixin_t *metablock) {
     metablock->padding = 0;
 }
 
+void extent_manager_t::shutdown_background_io() {
+    assert_thread();
+    guarantee(coro_t::self() != NULL);
+    background_drainer.reset();
+}
+
 void extent_manager_t::shutdown() {
     assert_thread();
     rassert(state == state_running);
     rassert(!current_transaction);
+    rassert(!background_drainer.has());
     state = state_shut_down;
 }
 
@@ -252,31 +332,115 @@ extent_reference_t extent_manager_t::gen_extent() {
     ++stats->pm_extents_in_use;
     stats->pm_bytes_in_use += extent_size;
 
-    return zone->gen_extent();
+    extent_reference_t extent_ref = zone->gen_extent();
+    consider_preallocation();
+    return extent_ref;
+}
+
+extent_reference_t extent_manager_t::gen_cold_tier_extent() {
+    assert_thread();
+    rassert(state == state_running);
+    guarantee(cold_zone.has());
+    ++stats->pm_extents_in_use;
+    stats->pm_bytes_in_use += extent_size;
+    ++stats->pm_serializer_cold_tier_extents;
+
+    return cold_zone->gen_extent();
+}
+
+extent_zone_t *extent_manager_t::zone_for(int64_t extent) {
+    if (extent < ls_block_token_pointee_t::cold_tier_offset_base) {
+        return zone.get();
+    }
+    if (!cold_zone.has()) {
+        crash("The database file has blocks in its cold tier file, but the server "
+              "was started without a cold tier directory.");
+    }
+    return cold_zone.get();
+}
+
+void extent_manager_t::consider_preallocation() {
+    const int64_t preallocated_extents = dynamic_config->preallocated_extents;
+    if (preallocated_extents <= 0 || preallocation_running || preallocation_failed
+        || !background_drainer.has()) {
+        return;
+    }
+
+    // We preallocate in batches of half the preallocated extents, so that we don't
+    // call fallocate for every new extent.
+    const int64_t extents_end = zone->extents_end();
+    const int64_t low_water_mark
+        = extents_end + (preallocated_extents + 1) / 2 * static_cast<int64_t>(extent_size);
+    if (dbfile->get_size() >= low_water_mark) {
+        return;
+    }
+
+    preallocation_running = true;
+    zone->set_preallocation_running(true);
+    coro_t::spawn_sometime(std::bind(&extent_manager_t::preallocate, this,
+                                     extents_end + preallocated_extents * extent_size,
+                                     auto_drainer_t::lock_t(background_drainer.get())));
+}
+
+void extent_manager_t::preallocate(int64_t size, auto_drainer_t::lock_t) {
+    assert_thread();
+    if (!dbfile->preallocate(size)) {
+        logWRN("Could not preallocate disk space for the database file.  The file will "
+               "grow on demand instead.");
+        preallocation_failed = true;
+        zone->set_preallocated_extents(0);
+    }
+    preallocation_running = false;
+    zone->set_preallocation_running(false);
+}
+
+void extent_manager_t::release_into_zone(extent_reference_t &&extent_ref) {
+    const int64_t extent = extent_ref.offset();
+    const bool punch_hole = dynamic_config->punch_holes && !hole_punching_failed
+        && background_drainer.has();
+    if (zone_for(extent)->release_extent(std::move(extent_ref), punch_hole)) {
+        coro_t::spawn_sometime(std::bind(&extent_manager_t::punch_hole, this, extent,
+                                         auto_drainer_t::lock_t(background_drainer.get())));
+    }
+}
+
+void extent_manager_t::punch_hole(int64_t extent, auto_drainer_t::lock_t) {
+    assert_thread();
+    if (!dbfile->punch_hole(extent, extent_size)) {
+        if (!hole_punching_failed) {
+            logWRN("Could not punch a hole into the database file.  The disk space of "
+                   "free extents will not be given back to the file system.");
+        }
+        hole_punching_failed = true;
+    }
+    zone_for(extent)->finish_punching(extent);
 }
 
 extent_reference_t
 extent_manager_t::copy_extent_reference(const extent_reference_t &extent_ref) {
     int64_t offset = extent_ref.offset();
-    return zone->make_extent_reference(offset);
+    return zone_for(offset)->make_extent_reference(offset);
 }
 
 void extent_manager_t::release_extent_into_transaction(extent_reference_t &&extent_ref, extent_transaction_t *txn) {
-    release_extent_preliminaries();
+    release_extent_preliminaries(extent_ref.offset());
     rassert(current_transaction);
     txn->push_extent(std::move(extent_ref));
 }
 
 void extent_manager_t::release_extent(extent_reference_t &&extent_ref) {
-    release_extent_preliminaries();
-    zone->release_extent(std::move(extent_ref));
+    release_extent_preliminaries(extent_ref.offset());
+    release_into_zone(std::move(extent_ref));
 }
 
-void extent_manager_t::release_extent_preliminaries() {
+void extent_manager_t::release_extent_preliminaries(int64_t extent) {
     assert_thread();
     rassert(state == state_running);
     --stats->pm_extents_in_use;
     stats->pm_bytes_in_use -= extent_size;
+    if (extent >= ls_block_token_pointee_t::cold_tier_offset_base) {
+        --stats->pm_serializer_cold_tier_extents;
+    }
 }
 
 
@@ -292,11 +456,11 @@ void extent_manager_t::commit_transaction(extent_transaction_t *t) {
     assert_thread();
     std::vector<extent_reference_t> extents = t->reset();
     for (auto it = extents.begin(); it != extents.end(); ++it) {
-        zone->release_extent(std::move(*it));
+        release_into_zone(std::move(*it));
     }
 }
 
 size_t extent_manager_t::held_extents() {
     assert_thread();
-    return zone->held_extents();
+    return zone->held_extents() + (cold_zone.has() ? cold_zone->held_extents() : 0);
 }
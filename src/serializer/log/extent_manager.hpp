@@ -13,6 +13,7 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include "arch/types.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "serializer/log/config.hpp"
@@ -99,7 +100,11 @@ public:
         int64_t padding;
     };
 
+    // cold_tier_file is the raw cold tier file of the tiered file, or NULL if the
+    // serializer has no cold tier.
     extent_manager_t(file_t *file,
+                     file_t *cold_tier_file,
+                     const log_serializer_dynamic_config_t *dynamic_config,
                      const log_serializer_on_disk_static_config_t *static_config,
                      log_serializer_stats_t *);
     ~extent_manager_t();
@@ -112,6 +117,9 @@ public:
     static void prepare_initial_metablock(metablock_mixin_t *mb);
     void start_existing(metablock_mixin_t *last_metablock);
     void prepare_metablock(metablock_mixin_t *metablock);
+    /* Waits for running preallocations and hole punches to finish and stops starting
+    new ones.  Must be called in a coroutine, before shutdown(). */
+    void shutdown_background_io();
     void shutdown();
 
     /* The extent manager uses transactions to make sure that extents are not freed
@@ -127,6 +135,10 @@ public:
 
     void begin_transaction(extent_transaction_t *out);
     MUST_USE extent_reference_t gen_extent();
+    /* Like gen_extent(), but in the cold tier file.  Only call it if
+    has_cold_tier(). */
+    MUST_USE extent_reference_t gen_cold_tier_extent();
+    bool has_cold_tier() const { return cold_zone.has(); }
     void release_extent_into_transaction(extent_reference_t &&extent_ref,
                                          extent_transaction_t *txn);
     void release_extent(extent_reference_t &&extent_ref);
@@ -140,9 +152,35 @@ public:
     const uint64_t extent_size;   /* Same as static_config->extent_size */
 
 private:
-    void release_extent_preliminaries();
+    void release_extent_preliminaries(int64_t extent);
+
+    // The zone of the hot or the cold tier, depending on the offset.
+    extent_zone_t *zone_for(int64_t extent);
+
+    /* Starts preallocating space in the file in the background, if the preallocated
+    space past the used extents is running low. */
+    void consider_preallocation();
+    void preallocate(int64_t size, auto_drainer_t::lock_t);
+
+    /* Releases the extent reference into the zone, punching a hole where the extent
+    is if it becomes free and dynamic_config->punch_holes is set. */
+    void release_into_zone(extent_reference_t &&extent_ref);
+    void punch_hole(int64_t extent, auto_drainer_t::lock_t);
+
+    const log_serializer_dynamic_config_t *const dynamic_config;
+    file_t *const dbfile;
 
     scoped_ptr_t<extent_zone_t> zone;
+    // Empty if there's no cold tier.
+    scoped_ptr_t<extent_zone_t> cold_zone;
+
+    bool preallocation_running;
+    // We stop trying to preallocate or punch holes once the file system tells us it
+    // can't.
+    bool preallocation_failed;
+    bool hole_punching_failed;
+
+    scoped_ptr_t<auto_drainer_t> background_drainer;
 
     /* During serializer startup, each component informs the extent manager
     which extents in the file it was using at shutdown. This is the
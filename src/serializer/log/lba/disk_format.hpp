@@ -97,6 +97,21 @@ struct lba_entry_t {
 } __attribute__((__packed__));
 
 
+/* If this bit is set in the ser_block_size of an LBA entry, the block is stored
+compressed (see serializer/log/block_compression.hpp), and the remaining bits hold
+its compressed size.  The uncompressed size of a compressed block is always the
+serializer's (maximal) block size. */
+static const uint32_t LBA_COMPRESSED_BLOCK_FLAG = static_cast<uint32_t>(1) << 31;
+
+inline bool lba_block_is_compressed(uint32_t lba_ser_block_size) {
+    return (lba_ser_block_size & LBA_COMPRESSED_BLOCK_FLAG) != 0;
+}
+
+// The size the block takes up in its data extent.
+inline block_size_t lba_disk_block_size(uint32_t lba_ser_block_size) {
+    return block_size_t::unsafe_make(lba_ser_block_size & ~LBA_COMPRESSED_BLOCK_FLAG);
+}
+
 struct lba_shard_metablock_t {
     /* Reference to the last lba extent (that's currently being
      * written to). Once the extent is filled, the reference is
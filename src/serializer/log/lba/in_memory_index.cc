@@ -5,14 +5,179 @@
 
 #include "serializer/log/lba/disk_format.hpp"
 
+// The compact representation of an index_block_info_t.  The low OFFSET_BITS bits of
+// the packed word hold offset / DEVICE_BLOCK_SIZE + 1 (or 0 if the offset has no
+// value), the topmost bit holds the ser_block_size's LBA_COMPRESSED_BLOCK_FLAG, and
+// the bits in between hold the rest of the ser_block_size.
+const int OFFSET_BITS = 44;
+const uint64_t OFFSET_MASK = (static_cast<uint64_t>(1) << OFFSET_BITS) - 1;
+const uint64_t PACKED_COMPRESSED_FLAG = static_cast<uint64_t>(1) << 63;
+const uint64_t MAX_COMPACT_SER_BLOCK_SIZE = (static_cast<uint64_t>(1) << (63 - OFFSET_BITS)) - 1;
+
+// The recency delta that stands for repli_timestamp_t::invalid.
+const int32_t INVALID_RECENCY_DELTA = INT32_MIN;
+
+class in_memory_index_t::segment_t {
+public:
+    segment_t()
+        : count_(0),
+          has_recency_base_(false),
+          recency_base_(repli_timestamp_t::invalid),
+          packed_(SEGMENT_SIZE, 0),
+          recency_deltas_(SEGMENT_SIZE, INVALID_RECENCY_DELTA) {
+        // The compact representation of index_block_info_t() must be all zero
+        // offsets and invalid recencies, which is what we initialize it to.
+        rassert(decode(0, INVALID_RECENCY_DELTA) == index_block_info_t());
+    }
+
+    // The number of block infos in the segment that aren't index_block_info_t().
+    size_t count() const { return count_; }
+
+    index_block_info_t get(size_t index) const {
+        rassert(index < SEGMENT_SIZE);
+        if (!wide_.empty()) {
+            return wide_[index];
+        }
+        return decode(packed_[index], recency_deltas_[index]);
+    }
+
+    void set(size_t index, const index_block_info_t &info) {
+        rassert(index < SEGMENT_SIZE);
+        const index_block_info_t empty_info;
+        if (!(get(index) == empty_info)) {
+            --count_;
+        }
+
+        uint64_t packed;
+        int32_t recency_delta;
+        if (!wide_.empty()) {
+            wide_[index] = info;
+        } else if (encode(info, &packed, &recency_delta)) {
+            packed_[index] = packed;
+            recency_deltas_[index] = recency_delta;
+        } else {
+            make_wide();
+            wide_[index] = info;
+        }
+
+        if (!(info == empty_info)) {
+            ++count_;
+        }
+    }
+
+private:
+    bool encode(const index_block_info_t &info,
+                uint64_t *packed_out, int32_t *recency_delta_out) {
+        uint64_t offset_field;
+        if (info.offset.has_value()) {
+            const int64_t offset = info.offset.get_value();
+            if (!divides(DEVICE_BLOCK_SIZE, offset)
+                || static_cast<uint64_t>(offset / DEVICE_BLOCK_SIZE) >= OFFSET_MASK) {
+                return false;
+            }
+            offset_field = offset / DEVICE_BLOCK_SIZE + 1;
+        } else if (info.offset == flagged_off64_t::unused()) {
+            offset_field = 0;
+        } else {
+            return false;
+        }
+
+        const uint64_t size_field = info.ser_block_size & ~LBA_COMPRESSED_BLOCK_FLAG;
+        if (size_field > MAX_COMPACT_SER_BLOCK_SIZE) {
+            return false;
+        }
+
+        int32_t recency_delta;
+        if (info.recency == repli_timestamp_t::invalid) {
+            recency_delta = INVALID_RECENCY_DELTA;
+        } else {
+            if (!has_recency_base_) {
+                recency_base_ = info.recency;
+                has_recency_base_ = true;
+            }
+            const int64_t delta = info.recency.longtime - recency_base_.longtime;
+            if (delta <= INVALID_RECENCY_DELTA || delta > INT32_MAX) {
+                return false;
+            }
+            recency_delta = delta;
+        }
+
+        *packed_out = offset_field
+            | (size_field << OFFSET_BITS)
+            | (lba_block_is_compressed(info.ser_block_size) ? PACKED_COMPRESSED_FLAG : 0);
+        *recency_delta_out = recency_delta;
+        return true;
+    }
+
+    index_block_info_t decode(uint64_t packed, int32_t recency_delta) const {
+        const uint64_t offset_field = packed & OFFSET_MASK;
+        const flagged_off64_t offset = offset_field == 0
+            ? flagged_off64_t::unused()
+            : flagged_off64_t::make((offset_field - 1) * DEVICE_BLOCK_SIZE);
+
+        repli_timestamp_t recency = repli_timestamp_t::invalid;
+        if (recency_delta != INVALID_RECENCY_DELTA) {
+            rassert(has_recency_base_);
+            recency.longtime = recency_base_.longtime + recency_delta;
+        }
+
+        uint32_t ser_block_size = (packed & ~PACKED_COMPRESSED_FLAG) >> OFFSET_BITS;
+        if ((packed & PACKED_COMPRESSED_FLAG) != 0) {
+            ser_block_size |= LBA_COMPRESSED_BLOCK_FLAG;
+        }
+        return index_block_info_t(offset, recency, ser_block_size);
+    }
+
+    // Switches the segment over to storing plain index_block_info_ts.
+    void make_wide() {
+        rassert(wide_.empty());
+        std::vector<index_block_info_t> wide;
+        wide.reserve(SEGMENT_SIZE);
+        for (size_t i = 0; i < SEGMENT_SIZE; ++i) {
+            wide.push_back(decode(packed_[i], recency_deltas_[i]));
+        }
+        wide_.swap(wide);
+
+        // Actually free the memory of the compact representation.
+        std::vector<uint64_t>().swap(packed_);
+        std::vector<int32_t>().swap(recency_deltas_);
+    }
+
+    size_t count_;
+
+    bool has_recency_base_;
+    repli_timestamp_t recency_base_;
+
+    // The compact representation.  Empty once wide_ is used.
+    std::vector<uint64_t> packed_;
+    std::vector<int32_t> recency_deltas_;
+
+    // The fallback representation.  Empty unless some block info didn't fit the
+    // compact one.
+    std::vector<index_block_info_t> wide_;
+
+    DISABLE_COPYING(segment_t);
+};
+
 in_memory_index_t::in_memory_index_t() : end_block_id_(0) { }
 
+in_memory_index_t::~in_memory_index_t() {
+    for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        delete *it;
+    }
+}
+
 block_id_t in_memory_index_t::end_block_id() {
     return end_block_id_;
 }
 
 index_block_info_t in_memory_index_t::get_block_info(block_id_t id) {
-    return infos_.get(id);
+    const size_t segment_id = id / SEGMENT_SIZE;
+    if (segment_id < segments_.size() && segments_[segment_id] != NULL) {
+        return segments_[segment_id]->get(id % SEGMENT_SIZE);
+    } else {
+        return index_block_info_t();
+    }
 }
 
 void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
@@ -22,6 +187,27 @@ void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
     }
 
     index_block_info_t info(offset, recency, ser_block_size);
-    infos_.set(id, info);
-}
 
+    const size_t segment_id = id / SEGMENT_SIZE;
+    if (segment_id >= segments_.size() || segments_[segment_id] == NULL) {
+        if (info == index_block_info_t()) {
+            return;
+        }
+        if (segment_id >= segments_.size()) {
+            segments_.resize(segment_id + 1, NULL);
+        }
+        segments_[segment_id] = new segment_t;
+    }
+
+    segment_t *segment = segments_[segment_id];
+    segment->set(id % SEGMENT_SIZE, info);
+
+    if (segment->count() == 0) {
+        segments_[segment_id] = NULL;
+        delete segment;
+
+        while (!segments_.empty() && segments_.back() == NULL) {
+            segments_.pop_back();
+        }
+    }
+}
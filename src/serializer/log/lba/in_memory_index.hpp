@@ -2,7 +2,8 @@
 #ifndef SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 #define SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 
-#include "containers/two_level_array.hpp"
+#include <vector>
+
 #include "config/args.hpp"
 #include "serializer/serializer.hpp"
 #include "serializer/log/lba/disk_format.hpp"
@@ -34,12 +35,20 @@ struct index_block_info_t {
 
 
 
-class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
-    block_id_t end_block_id_;
+/* in_memory_index_t stores an index_block_info_t for every block id.  Block ids are
+grouped into segments of SEGMENT_SIZE consecutive ids, and segments in which every
+block info is index_block_info_t() are not allocated at all.
 
+Segments normally store their block infos in a compact form of 12 bytes per block
+(instead of sizeof(index_block_info_t) == 20): the offset (in units of
+DEVICE_BLOCK_SIZE) and the ser_block_size share one 64-bit word, and the recency is
+stored as a 32-bit difference to a recency shared by the whole segment.  If a block
+info doesn't fit that representation, its segment falls back to storing plain
+index_block_info_ts. */
+class in_memory_index_t {
 public:
     in_memory_index_t();
+    ~in_memory_index_t();
 
     // end_block_id is one greater than the max block id.
     block_id_t end_block_id();
@@ -48,6 +57,15 @@ public:
     void set_block_info(block_id_t id, repli_timestamp_t recency,
                         flagged_off64_t offset, uint32_t ser_block_size);
 
+    static const size_t SEGMENT_SIZE = 1 << 14;
+
+private:
+    class segment_t;
+
+    std::vector<segment_t *> segments_;
+    block_id_t end_block_id_;
+
+    DISABLE_COPYING(in_memory_index_t);
 };
 
 #endif  // SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
@@ -54,7 +54,6 @@ void lba_list_t::prepare_metablock(metablock_mixin_t *mb_out) {
 }
 
 class lba_start_fsm_t :
-    private lba_disk_structure_t::load_callback_t,
     private lba_disk_structure_t::read_callback_t
 {
 public:
@@ -75,24 +74,22 @@ public:
                last_metablock->inline_lba_entries,
                last_metablock->inline_lba_entries_count * sizeof(lba_entry_t));
         
+        // Every shard starts reading its extents as soon as its own superblock
+        // has been loaded.  The shards hold disjoint sets of block ids, so they
+        // can fill the in-memory index in any order relative to each other.
         cbs_out = LBA_SHARD_FACTOR;
         for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
+            shard_loaders[i].parent = this;
+            shard_loaders[i].shard = i;
             owner->disk_structures[i] = new lba_disk_structure_t(
                 owner->extent_manager, owner->dbfile,
                 &last_metablock->shards[i]);
-            owner->disk_structures[i]->set_load_callback(this);
+            owner->disk_structures[i]->set_load_callback(&shard_loaders[i]);
         }
     }
 
-    void on_lba_load() {
-        rassert(cbs_out > 0);
-        cbs_out--;
-        if (cbs_out == 0) {
-            cbs_out = LBA_SHARD_FACTOR;
-            for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
-            }
-        }
+    void on_shard_loaded(int shard) {
+        owner->disk_structures[shard]->read(&owner->in_memory_index, this);
     }
 
     void on_lba_extents_read() {
@@ -116,6 +113,17 @@ public:
             delete this;
         }
     }
+
+private:
+    struct shard_loader_t : public lba_disk_structure_t::load_callback_t {
+        void on_lba_load() {
+            parent->on_shard_loaded(shard);
+        }
+        lba_start_fsm_t *parent;
+        int shard;
+    };
+
+    shard_loader_t shard_loaders[LBA_SHARD_FACTOR];
 };
 
 bool lba_list_t::start_existing(file_t *file, metablock_mixin_t *last_metablock,
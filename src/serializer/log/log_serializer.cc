@@ -2,6 +2,7 @@
 #include "serializer/log/log_serializer.hpp"
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -10,14 +11,22 @@
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/types.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/buffer_arena.hpp"
+#include "serializer/log/block_checksum.hpp"
+#include "serializer/log/block_compression.hpp"
+#include "serializer/log/block_scrubber.hpp"
 #include "serializer/log/data_block_manager.hpp"
+#include "serializer/log/tiered_file.hpp"
 
 filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
-                                               io_backender_t *backender)
+                                               io_backender_t *backender,
+                                               const std::string &cold_tier_file_name)
     : filepath_(filepath),
+      cold_tier_file_name_(cold_tier_file_name),
       backender_(backender),
       opened_temporary_(false) { }
 
@@ -93,6 +102,14 @@ void filepath_file_opener_t::unlink_serializer_file() {
     guarantee_err(res == 0, "unlink() failed");
 }
 
+void filepath_file_opener_t::open_cold_tier_file(scoped_ptr_t<file_t> *file_out) {
+    mutex_assertion_t::acq_t acq(&reentrance_mutex_);
+    if (!cold_tier_file_name_.empty()) {
+        // The file is empty until the GC first moves blocks to it.
+        open_serializer_file(cold_tier_file_name_, linux_file_t::mode_create, file_out);
+    }
+}
+
 #ifdef SEMANTIC_SERIALIZER_CHECK
 void filepath_file_opener_t::open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out) {
     const std::string semantic_filepath = filepath_.permanent_path() + "_semantic";
@@ -117,8 +134,23 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_block_reads(secs_to_ticks(1)),
       pm_serializer_index_reads(),
       pm_serializer_block_writes(),
+      pm_serializer_bytes_read(),
+      pm_serializer_bytes_written(),
       pm_serializer_index_writes(secs_to_ticks(1)),
       pm_serializer_index_writes_size(secs_to_ticks(1), false),
+      pm_serializer_block_read_latency(secs_to_ticks(1)),
+      pm_serializer_index_write_latency(secs_to_ticks(1)),
+      pm_serializer_metablock_writes(),
+      pm_serializer_metablock_group_size(secs_to_ticks(1), false),
+      pm_serializer_block_compression_hits(),
+      pm_serializer_block_compression_misses(),
+      pm_serializer_block_compression_input_bytes(),
+      pm_serializer_block_compression_output_bytes(),
+      pm_serializer_checksum_verifications(),
+      pm_serializer_checksum_failures(),
+      pm_serializer_scrubbed_blocks(),
+      pm_serializer_cold_tier_block_reads(),
+      pm_serializer_cold_tier_extents(),
       pm_extents_in_use(),
       pm_bytes_in_use(),
       pm_serializer_lba_extents(),
@@ -127,14 +159,30 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_data_extents_gced(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
+      pm_serializer_sequential_read_aheads(),
       pm_serializer_lba_gcs(),
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
           &pm_serializer_block_reads, "serializer_block_reads",
           &pm_serializer_index_reads, "serializer_index_reads",
           &pm_serializer_block_writes, "serializer_block_writes",
+          &pm_serializer_bytes_read, "serializer_bytes_read",
+          &pm_serializer_bytes_written, "serializer_bytes_written",
           &pm_serializer_index_writes, "serializer_index_writes",
           &pm_serializer_index_writes_size, "serializer_index_writes_size",
+          &pm_serializer_block_read_latency, "serializer_block_read_latency",
+          &pm_serializer_index_write_latency, "serializer_index_write_latency",
+          &pm_serializer_metablock_writes, "serializer_metablock_writes",
+          &pm_serializer_metablock_group_size, "serializer_metablock_group_size",
+          &pm_serializer_block_compression_hits, "serializer_block_compression_hits",
+          &pm_serializer_block_compression_misses, "serializer_block_compression_misses",
+          &pm_serializer_block_compression_input_bytes, "serializer_block_compression_input_bytes",
+          &pm_serializer_block_compression_output_bytes, "serializer_block_compression_output_bytes",
+          &pm_serializer_checksum_verifications, "serializer_checksum_verifications",
+          &pm_serializer_checksum_failures, "serializer_checksum_failures",
+          &pm_serializer_scrubbed_blocks, "serializer_scrubbed_blocks",
+          &pm_serializer_cold_tier_block_reads, "serializer_cold_tier_block_reads",
+          &pm_serializer_cold_tier_extents, "serializer_cold_tier_extents",
           &pm_extents_in_use, "serializer_extents_in_use",
           &pm_bytes_in_use, "serializer_bytes_in_use",
           &pm_serializer_lba_extents, "serializer_lba_extents",
@@ -143,6 +191,7 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_data_extents_gced, "serializer_data_extents_gced",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
+          &pm_serializer_sequential_read_aheads, "serializer_sequential_read_aheads",
           &pm_serializer_lba_gcs, "serializer_lba_gcs")
 { }
 
@@ -191,7 +240,16 @@ struct ls_start_existing_fsm_t :
 
         scoped_ptr_t<file_t> dbfile;
         file_opener->open_serializer_file_existing(&dbfile);
-        ser->dbfile = dbfile.release();
+        scoped_ptr_t<file_t> cold_tier_file;
+        file_opener->open_cold_tier_file(&cold_tier_file);
+        if (cold_tier_file.has()) {
+            tiered_file_t *tiered_file
+                = new tiered_file_t(std::move(dbfile), std::move(cold_tier_file));
+            ser->cold_tier_file = tiered_file->cold_file();
+            ser->dbfile = tiered_file;
+        } else {
+            ser->dbfile = dbfile.release();
+        }
 
         start_existing_state = state_read_static_header;
         // STATE A above implies STATE B here
@@ -225,7 +283,9 @@ struct ls_start_existing_fsm_t :
 
         if (start_existing_state == state_find_metablock) {
             // STATE D
-            ser->extent_manager = new extent_manager_t(ser->dbfile, &ser->static_config,
+            ser->extent_manager = new extent_manager_t(ser->dbfile, ser->cold_tier_file,
+                                                       &ser->dynamic_config,
+                                                       &ser->static_config,
                                                        ser->stats.get());
             {
                 // We never end up releasing the static header extent reference.  Nobody says we
@@ -278,10 +338,11 @@ struct ls_start_existing_fsm_t :
         if (start_existing_state == state_reconstruct_ongoing) {
             int batch = 0;
             for (; num_blocks_reconstructed < ser->lba_index->end_block_id(); num_blocks_reconstructed++) {
-                flagged_off64_t offset = ser->lba_index->get_block_offset(num_blocks_reconstructed);
-                if (offset.has_value()) {
-                    ser->data_block_manager->mark_live(offset.get_value(),
-                        ser->lba_index->get_block_size(num_blocks_reconstructed));
+                const index_block_info_t info
+                    = ser->lba_index->get_block_info(num_blocks_reconstructed);
+                if (info.offset.has_value()) {
+                    ser->data_block_manager->mark_live(info.offset.get_value(),
+                        lba_disk_block_size(info.ser_block_size));
                 }
                 ++batch;
                 if (batch >= LBA_RECONSTRUCTION_BATCH_SIZE) {
@@ -302,6 +363,10 @@ struct ls_start_existing_fsm_t :
             rassert(ser->state == log_serializer_t::state_starting_up);
             ser->state = log_serializer_t::state_ready;
 
+            if (ser->dynamic_config.scrub_interval_secs > 0) {
+                ser->block_scrubber.init(new block_scrubber_t(ser));
+            }
+
             if (to_signal_when_done) to_signal_when_done->pulse();
 
             delete this;
@@ -368,7 +433,9 @@ private:
 };
 
 log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_file_opener_t *file_opener, perfmon_collection_t *_perfmon_collection)
-    : stats(new log_serializer_stats_t(_perfmon_collection)),  // can block in a perfmon_collection_t::add call.
+    : block_compressor(new block_compressor_t),
+      checksum_sample_counter(0),
+      stats(new log_serializer_stats_t(_perfmon_collection)),  // can block in a perfmon_collection_t::add call.
       disk_stats_collection(),
       disk_stats_membership(_perfmon_collection, &disk_stats_collection, "disk"),  // can block in a perfmon_collection_t::add call.
 #ifndef NDEBUG
@@ -378,6 +445,7 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
       shutdown_callback(NULL),
       state(state_unstarted),
       dbfile(NULL),
+      cold_tier_file(NULL),
       extent_manager(NULL),
       metablock_manager(NULL),
       lba_index(NULL),
@@ -402,16 +470,17 @@ log_serializer_t::~log_serializer_t() {
 
 scoped_malloc_t<ser_buffer_t> log_serializer_t::malloc() {
     scoped_malloc_t<ser_buffer_t> buf(
-        malloc_aligned(static_config.block_size().ser_value(),
-                       DEVICE_BLOCK_SIZE));
+        allocate_ser_buffer(static_config.block_size().ser_value()));
 
     return buf;
 }
 
-file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit) {
+file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit,
+                                                  int latency_target_ms) {
     assert_thread();
     rassert(dbfile);
-    return new file_account_t(dbfile, priority, outstanding_requests_limit);
+    return new file_account_t(dbfile, priority, outstanding_requests_limit,
+                              latency_target_ms);
 }
 
 void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &token,
@@ -422,11 +491,26 @@ void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &tok
 
     ticks_t pm_time;
     stats->pm_serializer_block_reads.begin(&pm_time);
+    const ticks_t start_time = get_ticks();
+    stats->pm_serializer_bytes_read += token->disk_block_size().ser_value();
+    if (token->in_cold_tier()) {
+        ++stats->pm_serializer_cold_tier_block_reads;
+    }
 
-    data_block_manager->read(token->offset_, token->block_size().ser_value(),
-                             buf, io_account);
+    if (token->is_compressed()) {
+        scoped_malloc_t<ser_buffer_t> disk_buf = malloc();
+        data_block_manager->read(token->offset_, token->disk_block_size().ser_value(),
+                                 disk_buf.get(), io_account);
+        maybe_verify_block_checksum(token, disk_buf.get());
+        decompress_block(token, disk_buf.get(), buf);
+    } else {
+        data_block_manager->read(token->offset_, token->block_size().ser_value(),
+                                 buf, io_account);
+        maybe_verify_block_checksum(token, buf);
+    }
 
     stats->pm_serializer_block_reads.end(&pm_time);
+    stats->pm_serializer_block_read_latency.record(get_ticks() - start_time);
 }
 
 // God this is such a hack.
@@ -452,6 +536,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
     ticks_t pm_time;
     stats->pm_serializer_index_writes.begin(&pm_time);
     stats->pm_serializer_index_writes_size.record(write_ops.size());
+    const ticks_t start_time = get_ticks();
 
     extent_transaction_t txn;
     index_write_prepare(&txn);
@@ -462,6 +547,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
         // atomic.
         ASSERT_NO_CORO_WAITING;
 
+        repli_timestamp_t latest_recency = repli_timestamp_t::invalid;
         for (std::vector<index_write_op_t>::const_iterator write_op_it = write_ops.begin();
              write_op_it != write_ops.end();
              ++write_op_it) {
@@ -482,10 +568,13 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
-                    ser_block_size = token->block_size().ser_value();
+                    ser_block_size = token->disk_block_size().ser_value();
+                    if (token->is_compressed()) {
+                        ser_block_size |= LBA_COMPRESSED_BLOCK_FLAG;
+                    }
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(), token->disk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
@@ -494,16 +583,24 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
 
             repli_timestamp_t recency = op.recency ? op.recency.get()
                 : lba_index->get_block_recency(op.block_id);
+            if (op.recency) {
+                latest_recency = superceding_recency(latest_recency, recency);
+            }
 
             lba_index->set_block_info(op.block_id, recency,
                                       offset, ser_block_size,
                                       io_account, &txn);
         }
+
+        if (latest_recency != repli_timestamp_t::invalid) {
+            data_block_manager->note_recency(latest_recency);
+        }
     }
 
     index_write_finish(&txn, io_account);
 
     stats->pm_serializer_index_writes.end(&pm_time);
+    stats->pm_serializer_index_write_latency.record(get_ticks() - start_time);
 }
 
 void log_serializer_t::index_write_prepare(extent_transaction_t *txn) {
@@ -553,56 +650,202 @@ void log_serializer_t::index_write_finish(extent_transaction_t *txn, file_accoun
 void log_serializer_t::write_metablock(const signal_t &safe_to_write_cond,
                                        file_account_t *io_account) {
     assert_thread();
-    metablock_t mb_buffer;
+    metablock_waiter_t waiter;
 
     /* Prepare metablock now instead of in when we write it so that we will have the correct
     metablock information for this write even if another write starts before we finish
     waiting on `safe_to_write_cond`. */
-    prepare_metablock(&mb_buffer);
+    prepare_metablock(&waiter.mb_buffer);
+    waiter.safe_to_write_cond = &safe_to_write_cond;
 
     /* Get in line for the metablock manager */
     bool waiting_for_prev_write = !metablock_waiter_queue.empty();
-    cond_t on_prev_write_submitted_metablock;
-    metablock_waiter_queue.push_back(&on_prev_write_submitted_metablock);
+    metablock_waiter_queue.push_back(&waiter);
 
     safe_to_write_cond.wait();
-    if (waiting_for_prev_write) on_prev_write_submitted_metablock.wait();
-    guarantee(metablock_waiter_queue.front() == &on_prev_write_submitted_metablock);
+    if (waiting_for_prev_write) waiter.on_turn.wait();
+
+    if (waiter.covered) {
+        /* An earlier waiter has written a newer metablock on our behalf. */
+        waiter.on_written.wait();
+        return;
+    }
+    guarantee(metablock_waiter_queue.front() == &waiter);
 
+    /* Give other running index writes a chance to catch up, so that they can share
+    this metablock write. */
+    if (dynamic_config.metablock_group_commit_window_ms > 0 && active_write_count > 1) {
+        nap(dynamic_config.metablock_group_commit_window_ms);
+    }
+
+    /* Take over the metablock writes of all subsequent waiters that are ready. */
+    std::vector<metablock_waiter_t *> group;
+    group.push_back(&waiter);
+    metablock_waiter_queue.pop_front();
+    while (!metablock_waiter_queue.empty()
+           && metablock_waiter_queue.front()->safe_to_write_cond->is_pulsed()) {
+        group.push_back(metablock_waiter_queue.front());
+        metablock_waiter_queue.pop_front();
+    }
+
+    ++stats->pm_serializer_metablock_writes;
+    stats->pm_serializer_metablock_group_size.record(group.size());
+
+    /* The newest metablock of the group supersedes all the others. It stays valid
+    because its waiter doesn't return before we pulse its `on_written`. */
     struct : public cond_t, public mb_manager_t::metablock_write_callback_t {
         void on_metablock_write() { pulse(); }
     } on_metablock_write;
     const bool done_with_metablock =
-        metablock_manager->write_metablock(&mb_buffer, io_account, &on_metablock_write);
+        metablock_manager->write_metablock(&group.back()->mb_buffer, io_account,
+                                           &on_metablock_write);
 
-    /* Remove ourselves from the list of metablock waiters. */
-    metablock_waiter_queue.pop_front();
+    for (size_t i = 1; i < group.size(); ++i) {
+        group[i]->covered = true;
+        group[i]->on_turn.pulse();
+    }
 
     /* If there was another transaction waiting for us to write our metablock so it could
     write its metablock, notify it now so it can write its metablock. */
     if (!metablock_waiter_queue.empty()) {
-        metablock_waiter_queue.front()->pulse();
+        metablock_waiter_queue.front()->on_turn.pulse();
     }
 
     if (!done_with_metablock) on_metablock_write.wait();
+
+    for (size_t i = 1; i < group.size(); ++i) {
+        group[i]->on_written.pulse();
+    }
 }
 
 counted_t<ls_block_token_pointee_t>
 log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    return generate_block_token(offset, block_size, block_size);
+}
+
+counted_t<ls_block_token_pointee_t>
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t disk_block_size) {
+    assert_thread();
+    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size,
+                                                                         disk_block_size));
     return ret;
 }
 
+counted_t<ls_block_token_pointee_t>
+log_serializer_t::generate_block_token_from_lba(int64_t offset,
+                                                uint32_t lba_ser_block_size) {
+    const block_size_t disk_block_size = lba_disk_block_size(lba_ser_block_size);
+    return generate_block_token(offset,
+                                lba_block_is_compressed(lba_ser_block_size)
+                                ? static_config.block_size() : disk_block_size,
+                                disk_block_size);
+}
+
+void log_serializer_t::decompress_block(const counted_t<ls_block_token_pointee_t> &token,
+                                        const ser_buffer_t *disk_buf,
+                                        ser_buffer_t *buf_out) {
+    assert_thread();
+    rassert(token->is_compressed());
+    block_compressor->decompress(disk_buf, token->disk_block_size(),
+                                 buf_out, token->block_size());
+}
+
+void log_serializer_t::maybe_verify_block_checksum(
+        const counted_t<ls_block_token_pointee_t> &token, const ser_buffer_t *disk_buf) {
+    assert_thread();
+    switch (dynamic_config.checksum_verification) {
+    case block_checksum_verification_t::ALWAYS:
+        break;
+    case block_checksum_verification_t::SAMPLED:
+        if (checksum_sample_counter++ % CHECKSUM_VERIFICATION_SAMPLE_INTERVAL != 0) {
+            return;
+        }
+        break;
+    case block_checksum_verification_t::SCRUB_ONLY:
+        return;
+    default:
+        unreachable();
+    }
+
+    ++stats->pm_serializer_checksum_verifications;
+    if (!block_checksum_matches(disk_buf, token->disk_block_size())) {
+        ++stats->pm_serializer_checksum_failures;
+        crash("The block at offset %" PRIi64 " of the database file is corrupted "
+              "(its checksum doesn't match).", token->offset());
+    }
+}
+
 std::vector<counted_t<ls_block_token_pointee_t> >
 log_serializer_t::block_writes(const std::vector<buf_write_info_t> &write_infos,
                                file_account_t *io_account, iocallback_t *cb) {
     assert_thread();
     stats->pm_serializer_block_writes += write_infos.size();
 
+    if (!dynamic_config.compress_blocks) {
+        std::vector<counted_t<ls_block_token_pointee_t> > result
+            = data_block_manager->many_writes(write_infos, io_account, cb);
+        guarantee(result.size() == write_infos.size());
+        for (size_t i = 0; i < write_infos.size(); ++i) {
+            stats->pm_serializer_bytes_written += write_infos[i].block_size.ser_value();
+        }
+        return result;
+    }
+
+    /* Keeps the compressed buffers alive until they have been written. */
+    struct compressed_writes_cb_t : public iocallback_t {
+        void on_io_complete() {
+            iocallback_t *local_cb = cb;
+            delete this;
+            local_cb->on_io_complete();
+        }
+        std::vector<scoped_malloc_t<ser_buffer_t> > compressed_bufs;
+        iocallback_t *cb;
+    };
+    compressed_writes_cb_t *compressed_cb = new compressed_writes_cb_t;
+    compressed_cb->cb = cb;
+
+    // Only blocks of the maximal block size get compressed, because the LBA doesn't
+    // record the uncompressed size of compressed blocks.
+    std::vector<buf_write_info_t> disk_writes = write_infos;
+    std::vector<bool> compressed(write_infos.size(), false);
+    for (size_t i = 0; i < write_infos.size(); ++i) {
+        const buf_write_info_t &info = write_infos[i];
+        if (!(info.block_size == static_config.block_size())) {
+            continue;
+        }
+        info.buf->ser_header.block_id = info.block_id;
+        scoped_malloc_t<ser_buffer_t> compressed_buf = malloc();
+        block_size_t compressed_size = block_size_t::undefined();
+        if (block_compressor->compress(info.buf, info.block_size,
+                                       compressed_buf.get(), &compressed_size)) {
+            ++stats->pm_serializer_block_compression_hits;
+            stats->pm_serializer_block_compression_input_bytes += info.block_size.ser_value();
+            stats->pm_serializer_block_compression_output_bytes += compressed_size.ser_value();
+            disk_writes[i] = buf_write_info_t(compressed_buf.get(), compressed_size,
+                                              info.block_id);
+            compressed[i] = true;
+            compressed_cb->compressed_bufs.push_back(std::move(compressed_buf));
+        } else {
+            ++stats->pm_serializer_block_compression_misses;
+        }
+    }
+
     std::vector<counted_t<ls_block_token_pointee_t> > result
-        = data_block_manager->many_writes(write_infos, io_account, cb);
+        = data_block_manager->many_writes(disk_writes, io_account, compressed_cb);
     guarantee(result.size() == write_infos.size());
+    for (size_t i = 0; i < disk_writes.size(); ++i) {
+        stats->pm_serializer_bytes_written += disk_writes[i].block_size.ser_value();
+    }
+
+    // The data block manager only knows about on-disk sizes.
+    for (size_t i = 0; i < result.size(); ++i) {
+        if (compressed[i]) {
+            result[i] = generate_block_token(result[i]->offset(), write_infos[i].block_size,
+                                             result[i]->disk_block_size());
+        }
+    }
     return result;
 }
 
@@ -723,7 +966,7 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token_from_lba(info.offset.get_value(), info.ser_block_size);
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -761,6 +1004,11 @@ bool log_serializer_t::shutdown(cond_t *cb) {
     // to most of the remaining shutdown process which is still FSM-based.
     lba_index->shutdown_gc();
 
+    // Preallocation and hole punching run in coroutines, so we wait for them here.
+    // The same goes for the scrubber.
+    extent_manager->shutdown_background_io();
+    block_scrubber.reset();
+
     return next_shutdown_step();
 }
 
@@ -820,6 +1068,7 @@ bool log_serializer_t::next_shutdown_step() {
 
         delete dbfile;
         dbfile = NULL;
+        cold_tier_file = NULL;
 
         state = state_shut_down;
 
@@ -897,15 +1146,30 @@ void log_serializer_t::offer_buf_to_read_ahead_callbacks(
 }
 
 bool log_serializer_t::should_perform_read_ahead() {
+    assert_thread();
+    if (!dynamic_config.read_ahead) {
+        return false;
+    }
+    for (auto it = read_ahead_callbacks.begin(); it != read_ahead_callbacks.end(); ++it) {
+        if ((*it)->wants_warmup_read_ahead()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool log_serializer_t::should_perform_sequential_read_ahead() {
     assert_thread();
     return dynamic_config.read_ahead && !read_ahead_callbacks.empty();
 }
 
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_block_size,
+                                                   block_size_t initial_disk_block_size)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size), disk_block_size_(initial_disk_block_size),
+      offset_(initial_offset) {
     serializer_->assert_thread();
     serializer_->register_block_token(this, initial_offset);
 }
@@ -20,6 +20,8 @@
 #include "serializer/log/lba/lba_list.hpp"
 #include "serializer/log/stats.hpp"
 
+class block_compressor_t;
+class block_scrubber_t;
 class cond_t;
 class data_block_manager_t;
 struct block_magic_t;
@@ -54,11 +56,13 @@ struct log_serializer_metablock_t {
 // TODO: This header data should maybe go to the cache
 typedef metablock_manager_t<log_serializer_metablock_t> mb_manager_t;
 
-// Used to open a file (with the given filepath) for the log serializer.
+// Used to open a file (with the given filepath) for the log serializer.  If
+// cold_tier_file_name isn't empty, the serializer gets a cold tier in that file.
 class filepath_file_opener_t : public serializer_file_opener_t {
 public:
     filepath_file_opener_t(const serializer_filepath_t &filepath,
-                           io_backender_t *backender);
+                           io_backender_t *backender,
+                           const std::string &cold_tier_file_name = std::string());
     ~filepath_file_opener_t();
 
     // The path of the final position of the file.
@@ -68,6 +72,7 @@ public:
     void move_serializer_file_to_permanent_location();
     void open_serializer_file_existing(scoped_ptr_t<file_t> *file_out);
     void unlink_serializer_file();
+    void open_cold_tier_file(scoped_ptr_t<file_t> *file_out);
 #ifdef SEMANTIC_SERIALIZER_CHECK
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
@@ -84,6 +89,8 @@ private:
     // The filepath of the final position of the file.
     const serializer_filepath_t filepath_;
 
+    const std::string cold_tier_file_name_;
+
     io_backender_t *const backender_;
 
     // Makes sure that only one member function gets called at a time.  Some of them are blocking,
@@ -115,6 +122,7 @@ class log_serializer_t :
     friend class data_block_manager_t;
     friend class dbm_read_ahead_t;
     friend class ls_block_token_pointee_t;
+    friend class block_scrubber_t;
 
 public:
     /* Serializer configuration. dynamic_config_t is everything that can be changed from run
@@ -141,7 +149,8 @@ public:
 #ifndef SEMANTIC_SERIALIZER_CHECK
     using serializer_t::make_io_account;
 #endif
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    int latency_target_ms);
 
     void register_read_ahead_cb(serializer_read_ahead_callback_t *cb);
     void unregister_read_ahead_cb(serializer_read_ahead_callback_t *cb);
@@ -170,12 +179,32 @@ private:
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
                                                              block_size_t block_size);
+    counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
+                                                             block_size_t block_size,
+                                                             block_size_t disk_block_size);
+    /* Generates a token for a block whose ser_block_size in the LBA is
+    `lba_ser_block_size`, which tells whether the block is compressed. */
+    counted_t<ls_block_token_pointee_t> generate_block_token_from_lba(
+            int64_t offset, uint32_t lba_ser_block_size);
+
+    /* Decompresses the compressed block `token` refers to, given its on-disk
+    contents in `disk_buf`. */
+    void decompress_block(const counted_t<ls_block_token_pointee_t> &token,
+                          const ser_buffer_t *disk_buf, ser_buffer_t *buf_out);
+
+    /* Verifies the checksum of a block read from disk, if
+    dynamic_config.checksum_verification asks for it.  `disk_buf` holds the block's
+    on-disk contents.  Crashes if the block is corrupted. */
+    void maybe_verify_block_checksum(const counted_t<ls_block_token_pointee_t> &token,
+                                     const ser_buffer_t *disk_buf);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
             scoped_malloc_t<ser_buffer_t> &&buf,
             const counted_t<standard_block_token_t>& token);
+    // Whether to read ahead on every read, or only on sequential reads.
     bool should_perform_read_ahead();
+    bool should_perform_sequential_read_ahead();
 
     /* Starts a new transaction, updates perfmons etc. */
     void index_write_prepare(extent_transaction_t *txn);
@@ -197,9 +226,29 @@ private:
     typedef log_serializer_metablock_t metablock_t;
     void prepare_metablock(metablock_t *mb_buffer);
 
+    /* A pending call to `write_metablock()`. The first waiter in the queue whose
+    `safe_to_write_cond` is pulsed writes the metablock not only for itself, but also
+    for all directly following waiters that are safe to write by then. Since the newest
+    metablock supersedes the older ones, only the last metablock of such a group
+    actually has to be written. */
+    struct metablock_waiter_t {
+        metablock_waiter_t() : safe_to_write_cond(NULL), covered(false) { }
+        metablock_t mb_buffer;
+        const signal_t *safe_to_write_cond;
+        /* Pulsed once this waiter is at the front of the queue, or once another
+        waiter has taken over its metablock write (in which case `covered` is set). */
+        cond_t on_turn;
+        bool covered;
+        /* Pulsed by the writing waiter once a covering metablock write completes. */
+        cond_t on_written;
+    };
+
     void consider_start_gc();
 
     std::multimap<int64_t, ls_block_token_pointee_t *> offset_tokens;
+    scoped_ptr_t<block_compressor_t> block_compressor;
+    // Counts block reads for sampled checksum verification.
+    uint64_t checksum_sample_counter;
     scoped_ptr_t<log_serializer_stats_t> stats;
     perfmon_collection_t disk_stats_collection;
     perfmon_membership_t disk_stats_membership;
@@ -233,17 +282,23 @@ private:
         state_shut_down
     } state;
 
+    // A tiered_file_t if the serializer has a cold tier.
     file_t *dbfile;
+    // The cold tier file inside dbfile, or NULL.
+    file_t *cold_tier_file;
 
     extent_manager_t *extent_manager;
     mb_manager_t *metablock_manager;
     lba_list_t *lba_index;
     data_block_manager_t *data_block_manager;
 
+    // Only exists while the serializer is ready, and if scrubbing is enabled.
+    scoped_ptr_t<block_scrubber_t> block_scrubber;
+
     /* The running index writes organize themselves into a list so that they can be sure to
     write their metablocks in the correct order. The first element in the list
     is the oldest transaction that started but did not finish. */
-    std::list<cond_t *> metablock_waiter_queue;
+    std::list<metablock_waiter_t *> metablock_waiter_queue;
 
     int active_write_count;
 
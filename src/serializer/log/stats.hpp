@@ -11,8 +11,33 @@ struct log_serializer_stats_t {
     perfmon_duration_sampler_t pm_serializer_block_reads;
     perfmon_counter_t pm_serializer_index_reads;
     perfmon_counter_t pm_serializer_block_writes;
+    /* The bytes of blocks read from and written to the file, as they are on disk. */
+    perfmon_counter_t pm_serializer_bytes_read;
+    perfmon_counter_t pm_serializer_bytes_written;
     perfmon_duration_sampler_t pm_serializer_index_writes;
     perfmon_sampler_t pm_serializer_index_writes_size;
+    /* How long block reads and index writes take, as histograms. */
+    perfmon_latency_histogram_t pm_serializer_block_read_latency;
+    perfmon_latency_histogram_t pm_serializer_index_write_latency;
+    /* The number of metablock writes, and the number of metablock updates that each
+    of them covered.  The latter is the batching factor of the group commit. */
+    perfmon_counter_t pm_serializer_metablock_writes;
+    perfmon_sampler_t pm_serializer_metablock_group_size;
+    /* Blocks that were written compressed (hits) or uncompressed because they didn't
+    compress well enough (misses), and the total sizes of the former before and after
+    compression. */
+    perfmon_counter_t pm_serializer_block_compression_hits;
+    perfmon_counter_t pm_serializer_block_compression_misses;
+    perfmon_counter_t pm_serializer_block_compression_input_bytes;
+    perfmon_counter_t pm_serializer_block_compression_output_bytes;
+    /* Blocks whose checksums were verified on read or by the scrubber, the ones the
+    scrubber found corrupted, and the blocks the scrubber has read. */
+    perfmon_counter_t pm_serializer_checksum_verifications;
+    perfmon_counter_t pm_serializer_checksum_failures;
+    perfmon_counter_t pm_serializer_scrubbed_blocks;
+    /* Block reads that went to the cold tier file, and the extents that are in it. */
+    perfmon_counter_t pm_serializer_cold_tier_block_reads;
+    perfmon_counter_t pm_serializer_cold_tier_extents;
 
     /* used in serializer/log/extent_manager.cc */
     perfmon_counter_t pm_extents_in_use;
@@ -27,6 +52,7 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_data_extents_gced;
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
+    perfmon_counter_t pm_serializer_sequential_read_aheads;
 
     /* used in serializer/log/lba/lba_list.cc */
     perfmon_counter_t pm_serializer_lba_gcs;
@@ -0,0 +1,108 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/tiered_file.hpp"
+
+#include <sys/uio.h>
+
+#include "arch/io/disk.hpp"
+
+tiered_file_t::tiered_file_t(scoped_ptr_t<file_t> &&hot_file,
+                             scoped_ptr_t<file_t> &&cold_file)
+    : hot_file_(std::move(hot_file)), cold_file_(std::move(cold_file)) {
+    guarantee(hot_file_.has());
+    guarantee(cold_file_.has());
+}
+
+tiered_file_t::~tiered_file_t() { }
+
+int64_t tiered_file_t::get_size() {
+    return hot_file_->get_size();
+}
+
+void tiered_file_t::set_size(int64_t size) {
+    hot_file_->set_size(size);
+}
+
+void tiered_file_t::set_size_at_least(int64_t size) {
+    hot_file_->set_size_at_least(size);
+}
+
+bool tiered_file_t::preallocate(int64_t size) {
+    return hot_file_->preallocate(size);
+}
+
+bool tiered_file_t::punch_hole(int64_t offset, int64_t length) {
+    int64_t file_offset;
+    file_account_t *file_account;
+    file_t *file = route(offset, length, DEFAULT_DISK_ACCOUNT,
+                         &file_offset, &file_account);
+    return file->punch_hole(file_offset, length);
+}
+
+void tiered_file_t::read_async(int64_t offset, size_t length, void *buf,
+                               file_account_t *account, linux_iocallback_t *cb) {
+    int64_t file_offset;
+    file_account_t *file_account;
+    file_t *file = route(offset, length, account, &file_offset, &file_account);
+    file->read_async(file_offset, length, buf, file_account, cb);
+}
+
+void tiered_file_t::write_async(int64_t offset, size_t length, const void *buf,
+                                file_account_t *account, linux_iocallback_t *cb,
+                                wrap_in_datasyncs_t wrap_in_datasyncs) {
+    int64_t file_offset;
+    file_account_t *file_account;
+    file_t *file = route(offset, length, account, &file_offset, &file_account);
+    file->write_async(file_offset, length, buf, file_account, cb, wrap_in_datasyncs);
+}
+
+void tiered_file_t::writev_async(int64_t offset, size_t length,
+                                 scoped_array_t<iovec> &&bufs,
+                                 file_account_t *account, linux_iocallback_t *cb) {
+    int64_t file_offset;
+    file_account_t *file_account;
+    file_t *file = route(offset, length, account, &file_offset, &file_account);
+    file->writev_async(file_offset, length, std::move(bufs), file_account, cb);
+}
+
+void *tiered_file_t::create_account(int priority, int outstanding_requests_limit,
+                                    int latency_target_ms) {
+    tiered_account_t *account = new tiered_account_t;
+    account->hot.init(new file_account_t(hot_file_.get(), priority,
+                                         outstanding_requests_limit,
+                                         latency_target_ms));
+    account->cold.init(new file_account_t(cold_file_.get(), priority,
+                                          outstanding_requests_limit,
+                                          latency_target_ms));
+    return account;
+}
+
+void tiered_file_t::destroy_account(void *account) {
+    delete static_cast<tiered_account_t *>(account);
+}
+
+bool tiered_file_t::coop_lock_and_check() {
+    return hot_file_->coop_lock_and_check() && cold_file_->coop_lock_and_check();
+}
+
+file_t *tiered_file_t::route(int64_t offset, size_t length, file_account_t *account,
+                             int64_t *offset_out, file_account_t **account_out) {
+    const int64_t base = ls_block_token_pointee_t::cold_tier_offset_base;
+    tiered_account_t *tiered_account = account == DEFAULT_DISK_ACCOUNT
+        ? NULL
+        : static_cast<tiered_account_t *>(account->get_account());
+    if (offset < base) {
+        // Read-ahead and the like must not cross into the other file.
+        guarantee(offset + static_cast<int64_t>(length) <= base);
+        *offset_out = offset;
+        *account_out = tiered_account == NULL
+            ? DEFAULT_DISK_ACCOUNT
+            : tiered_account->hot.get();
+        return hot_file_.get();
+    } else {
+        *offset_out = offset - base;
+        *account_out = tiered_account == NULL
+            ? DEFAULT_DISK_ACCOUNT
+            : tiered_account->cold.get();
+        return cold_file_.get();
+    }
+}
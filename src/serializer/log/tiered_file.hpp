@@ -0,0 +1,65 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_TIERED_FILE_HPP_
+#define SERIALIZER_LOG_TIERED_FILE_HPP_
+
+#include "arch/types.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+
+/* A `tiered_file_t` puts the log serializer's database file (the hot tier) and its
+cold tier file, which is usually on cheaper storage, into one offset space.
+Offsets below `ls_block_token_pointee_t::cold_tier_offset_base` are in the hot
+file, the ones from there on are in the cold file.  The extent manager only gives
+out cold extents to the GC, for blocks that haven't been written in a long time,
+so the LBA and the metablocks always stay in the hot file.
+
+The file size is the size of the hot file; the extent manager sizes the cold file
+through `cold_file()`. */
+class tiered_file_t : public file_t {
+public:
+    tiered_file_t(scoped_ptr_t<file_t> &&hot_file, scoped_ptr_t<file_t> &&cold_file);
+    ~tiered_file_t();
+
+    file_t *hot_file() { return hot_file_.get(); }
+    file_t *cold_file() { return cold_file_.get(); }
+
+    int64_t get_size();
+    void set_size(int64_t size);
+    void set_size_at_least(int64_t size);
+
+    bool preallocate(int64_t size);
+    bool punch_hole(int64_t offset, int64_t length);
+
+    void read_async(int64_t offset, size_t length, void *buf,
+                    file_account_t *account, linux_iocallback_t *cb);
+    void write_async(int64_t offset, size_t length, const void *buf,
+                     file_account_t *account, linux_iocallback_t *cb,
+                     wrap_in_datasyncs_t wrap_in_datasyncs);
+    void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
+                      file_account_t *account, linux_iocallback_t *cb);
+
+    // An account of the tiered file is an account of each of the two files.
+    void *create_account(int priority, int outstanding_requests_limit,
+                         int latency_target_ms);
+    void destroy_account(void *account);
+
+    bool coop_lock_and_check();
+
+private:
+    struct tiered_account_t {
+        scoped_ptr_t<file_account_t> hot;
+        scoped_ptr_t<file_account_t> cold;
+    };
+
+    // Returns the file that [offset, offset + length) is in, and sets *offset_out
+    // and *account_out to the offset and the account to use with it.
+    file_t *route(int64_t offset, size_t length, file_account_t *account,
+                  int64_t *offset_out, file_account_t **account_out);
+
+    scoped_ptr_t<file_t> hot_file_;
+    scoped_ptr_t<file_t> cold_file_;
+
+    DISABLE_COPYING(tiered_file_t);
+};
+
+#endif  // SERIALIZER_LOG_TIERED_FILE_HPP_
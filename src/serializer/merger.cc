@@ -1,22 +1,55 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "serializer/merger.hpp"
 
+#include <algorithm>
+
 #include "errors.hpp"
 
 #include "serializer/types.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
 #include "config/args.hpp"
 
+// Folds `sample` into the moving average `*average`, which starts out at the first
+// sample.
+static void update_average(double sample, double *average) {
+    if (*average == 0) {
+        *average = sample;
+    } else {
+        *average += MERGER_SERIALIZER_AVERAGE_WEIGHT * (sample - *average);
+    }
+}
 
+merger_serializer_t::stats_t::stats_t(perfmon_collection_t *parent)
+    : merger_collection(),
+      pm_merged_index_writes(secs_to_ticks(1), false),
+      pm_merged_index_write_ops(secs_to_ticks(1), false),
+      pm_index_write_queue_delay(secs_to_ticks(1)),
+      pm_batching_window_ms(secs_to_ticks(1), false),
+      parent_collection_membership(parent, &merger_collection, "merger"),
+      stats_membership(&merger_collection,
+          &pm_merged_index_writes, "merged_index_writes",
+          &pm_merged_index_write_ops, "merged_index_write_ops",
+          &pm_index_write_queue_delay, "index_write_queue_delay",
+          &pm_batching_window_ms, "batching_window_ms")
+{ }
 
 merger_serializer_t::merger_serializer_t(scoped_ptr_t<serializer_t> _inner,
-                                         int _max_active_writes) :
+                                         int _max_active_writes,
+                                         perfmon_collection_t *perfmon_collection) :
     inner(std::move(_inner)),
     index_writes_io_account(make_io_account(MERGED_INDEX_WRITE_IO_PRIORITY)),
     on_inner_index_write_complete(new counted_cond_t()),
     unhandled_index_write_waiter_exists(false),
+    num_queued_index_writes(0),
+    average_write_ticks(0),
+    average_arrival_ticks(0),
+    last_arrival(0),
+    batching_window_full(NULL),
     num_active_writes(0),
-    max_active_writes(_max_active_writes) {
+    max_active_writes(_max_active_writes),
+    stats(perfmon_collection) {
 }
 
 merger_serializer_t::~merger_serializer_t() {
@@ -30,6 +63,13 @@ void merger_serializer_t::index_write(const std::vector<index_write_op_t> &write
     rassert(coro_t::self() != NULL);
     assert_thread();
 
+    const ticks_t arrival = get_ticks();
+    if (last_arrival != 0) {
+        update_average(static_cast<double>(arrival - last_arrival),
+                       &average_arrival_ticks);
+    }
+    last_arrival = arrival;
+
     counted_t<counted_cond_t> write_complete;
     {
         // Our set of write ops must be processed atomically...
@@ -37,6 +77,11 @@ void merger_serializer_t::index_write(const std::vector<index_write_op_t> &write
         for (auto op = write_ops.begin(); op != write_ops.end(); ++op) {
             push_index_write_op(*op);
         }
+        ++num_queued_index_writes;
+        if (batching_window_full != NULL
+            && outstanding_index_write_ops.size() >= MERGER_SERIALIZER_MAX_BATCH_OPS) {
+            batching_window_full->pulse_if_not_already_pulsed();
+        }
         // ... and we also take a copy of the on_inner_index_write_complete signal
         // so we get notified exactly when all of our write ops have
         // been completed.
@@ -47,11 +92,44 @@ void merger_serializer_t::index_write(const std::vector<index_write_op_t> &write
     // Check if we can initiate a new index write
     if (num_active_writes < max_active_writes) {
         ++num_active_writes;
+        wait_for_batching_window();
         do_index_write();
     }
 
     // Wait for the write to complete
     write_complete->wait_lazily_unordered();
+    stats.pm_index_write_queue_delay.record(write_complete->write_start - arrival);
+}
+
+int64_t merger_serializer_t::batching_window_ms() const {
+    const double window_ticks =
+        average_write_ticks * MERGER_SERIALIZER_WINDOW_LATENCY_RATIO;
+    if (last_arrival == 0 || average_arrival_ticks > window_ticks) {
+        // Another index write isn't expected to arrive during the window.
+        return 0;
+    }
+    const int64_t window_ms = static_cast<int64_t>(window_ticks / MILLION);
+    return std::min<int64_t>(window_ms, MERGER_SERIALIZER_MAX_WINDOW_MS);
+}
+
+void merger_serializer_t::wait_for_batching_window() {
+    if (batching_window_full != NULL
+        || outstanding_index_write_ops.size() >= MERGER_SERIALIZER_MAX_BATCH_OPS) {
+        return;
+    }
+    const int64_t window_ms = batching_window_ms();
+    stats.pm_batching_window_ms.record(window_ms);
+    if (window_ms == 0) {
+        return;
+    }
+
+    cond_t full;
+    batching_window_full = &full;
+    signal_timer_t timer;
+    timer.start(window_ms);
+    wait_any_t waiter(&timer, &full);
+    waiter.wait_lazily_unordered();
+    batching_window_full = NULL;
 }
 
 void merger_serializer_t::do_index_write() {
@@ -63,6 +141,7 @@ void merger_serializer_t::do_index_write() {
     counted_t<counted_cond_t> write_complete;
     std::vector<index_write_op_t> write_ops;
     write_ops.reserve(outstanding_index_write_ops.size());
+    int num_merged_index_writes;
     {
         ASSERT_NO_CORO_WAITING;
         for (auto op_pair = outstanding_index_write_ops.begin();
@@ -72,6 +151,8 @@ void merger_serializer_t::do_index_write() {
         }
         outstanding_index_write_ops.clear();
         unhandled_index_write_waiter_exists = false;
+        num_merged_index_writes = num_queued_index_writes;
+        num_queued_index_writes = 0;
 
         // Swap out the on_inner_index_write_complete signal so subsequent index
         // writes can be captured by the next round of do_index_write().
@@ -79,7 +160,16 @@ void merger_serializer_t::do_index_write() {
         write_complete.swap(on_inner_index_write_complete);
     }
 
-    inner->index_write(write_ops, index_writes_io_account.get());
+    write_complete->write_start = get_ticks();
+    if (!write_ops.empty()) {
+        // With more than one active write, another one may have taken our ops
+        // while we waited out the batching window.
+        stats.pm_merged_index_writes.record(num_merged_index_writes);
+        stats.pm_merged_index_write_ops.record(write_ops.size());
+        inner->index_write(write_ops, index_writes_io_account.get());
+        update_average(static_cast<double>(get_ticks() - write_complete->write_start),
+                       &average_write_ticks);
+    }
 
     write_complete->pulse();
 
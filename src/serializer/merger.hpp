@@ -8,6 +8,7 @@
 
 #include "buffer_cache/types.hpp"
 #include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
 #include "serializer/serializer.hpp"
 
 /*
@@ -19,11 +20,18 @@
  * hash shards) can be merged together, improving efficiency and significantly
  * reducing the number of disk seeks on rotational drives.
  *
+ * An index write that could start right away is held back for a batching window
+ * when more index writes are expected to arrive during it, so that they are merged
+ * into it as well.  The window is a fraction of the recent latency of the inner
+ * serializer's index writes, and is only opened when index writes have recently
+ * arrived more often than that; on a fast device it rounds down to nothing, so the
+ * writes aren't delayed.  It ends early once enough block ids are queued.
  */
 
 class merger_serializer_t : public serializer_t {
 public:
-    merger_serializer_t(scoped_ptr_t<serializer_t> _inner, int _max_active_writes);
+    merger_serializer_t(scoped_ptr_t<serializer_t> _inner, int _max_active_writes,
+                        perfmon_collection_t *perfmon_collection);
     ~merger_serializer_t();
 
 
@@ -34,8 +42,10 @@ public:
     /* Allocates a new io account for the underlying file.
     Use delete to free it. */
     using serializer_t::make_io_account;
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit) {
-        return inner->make_io_account(priority, outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    int latency_target_ms) {
+        return inner->make_io_account(priority, outstanding_requests_limit,
+                                      latency_target_ms);
     }
 
     /* Some serializer implementations support read-ahead to speed up cache warmup.
@@ -112,6 +122,12 @@ private:
     void merge_index_write_op(const index_write_op_t &to_be_merged,
                               index_write_op_t *into_out) const;
 
+    // Returns how long an index write that could start now should wait for others
+    // to merge with, in milliseconds.
+    int64_t batching_window_ms() const;
+    // Waits out the batching window, unless another one is open already.
+    void wait_for_batching_window();
+
     const scoped_ptr_t<serializer_t> inner;
     const scoped_ptr_t<file_account_t> index_writes_io_account;
 
@@ -122,15 +138,45 @@ private:
     // It is pulsed once the write completes.
     class counted_cond_t : public cond_t,
                            public single_threaded_countable_t<counted_cond_t> {
+    public:
+        counted_cond_t() : write_start(0) { }
+        // When the inner index write that this is pulsed for was started.
+        ticks_t write_start;
     };
     counted_t<counted_cond_t> on_inner_index_write_complete;
     bool unhandled_index_write_waiter_exists;
+    // The number of `index_write()` calls in `outstanding_index_write_ops`.
+    int num_queued_index_writes;
+
+    // Moving averages of how long the inner serializer's index writes take and of
+    // the time between two calls to `index_write()`, in ticks.
+    double average_write_ticks;
+    double average_arrival_ticks;
+    ticks_t last_arrival;
+    // Pulsed to end the open batching window once enough block ids are queued, or
+    // NULL if there's no window open.
+    cond_t *batching_window_full;
 
     int num_active_writes;
     int max_active_writes;
 
     void do_index_write();
 
+    struct stats_t {
+        explicit stats_t(perfmon_collection_t *parent);
+
+        perfmon_collection_t merger_collection;
+        // The number of `index_write()` calls and of block ids in each merged write.
+        perfmon_sampler_t pm_merged_index_writes;
+        perfmon_sampler_t pm_merged_index_write_ops;
+        // How long `index_write()` calls wait before their merged write starts.
+        perfmon_latency_histogram_t pm_index_write_queue_delay;
+        perfmon_sampler_t pm_batching_window_ms;
+
+        perfmon_membership_t parent_collection_membership;
+        perfmon_multi_membership_t stats_membership;
+    } stats;
+
     DISABLE_COPYING(merger_serializer_t);
 };
 
@@ -67,8 +67,9 @@ semantic_checking_serializer_t<inner_serializer_t>::malloc() {
 }
 
 template<class inner_serializer_t>
-file_account_t *semantic_checking_serializer_t<inner_serializer_t>::make_io_account(int priority, int outstanding_requests_limit) {
-    return inner_serializer.make_io_account(priority, outstanding_requests_limit);
+file_account_t *semantic_checking_serializer_t<inner_serializer_t>::make_io_account(int priority, int outstanding_requests_limit, int latency_target_ms) {
+    return inner_serializer.make_io_account(priority, outstanding_requests_limit,
+                                            latency_target_ms);
 }
 
 template<class inner_serializer_t>
@@ -17,6 +17,12 @@ file_account_t *serializer_t::make_io_account(int priority) {
     return make_io_account(priority, UNLIMITED_OUTSTANDING_REQUESTS);
 }
 
+file_account_t *serializer_t::make_io_account(int priority,
+                                              int outstanding_requests_limit) {
+    assert_thread();
+    return make_io_account(priority, outstanding_requests_limit, NO_IO_LATENCY_TARGET);
+}
+
 ser_buffer_t *convert_buffer_cache_buf_to_ser_buffer(const void *buf) {
     return static_cast<ser_buffer_t *>(const_cast<void *>(buf)) - 1;
 }
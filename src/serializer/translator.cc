@@ -113,7 +113,10 @@ void create_proxies(const std::vector<serializer_t *>& underlying,
             "the same call to 'rethinkdb create'.");
     }
 
-    guarantee(c->n_files == static_cast<int>(underlying.size()));
+    if (c->n_files != static_cast<int>(underlying.size())) {
+        fail_due_to_user_error("The table was created with %d files, but the server was started "
+            "with %zu.  (Did the stripe directories change?)", c->n_files, underlying.size());
+    }
     guarantee(c->this_serializer >= 0 && c->this_serializer < static_cast<int>(underlying.size()));
     guarantee(c->n_proxies == static_cast<int>(proxies->size()));
 
@@ -215,8 +218,10 @@ scoped_malloc_t<ser_buffer_t> translator_serializer_t::malloc() {
     return inner->malloc();
 }
 
-file_account_t *translator_serializer_t::make_io_account(int priority, int outstanding_requests_limit) {
-    return inner->make_io_account(priority, outstanding_requests_limit);
+file_account_t *translator_serializer_t::make_io_account(int priority, int outstanding_requests_limit,
+                                                         int latency_target_ms) {
+    return inner->make_io_account(priority, outstanding_requests_limit,
+                                  latency_target_ms);
 }
 
 void translator_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account) {
@@ -317,6 +322,10 @@ void translator_serializer_t::offer_read_ahead_buf(
     }
 }
 
+bool translator_serializer_t::wants_warmup_read_ahead() const {
+    return read_ahead_callback != NULL && read_ahead_callback->wants_warmup_read_ahead();
+}
+
 void translator_serializer_t::register_read_ahead_cb(serializer_read_ahead_callback_t *cb) {
     assert_thread();
 
@@ -113,7 +113,9 @@ public:
     scoped_malloc_t<ser_buffer_t> malloc();
 
     /* Allocates a new io account for the underlying file */
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    using serializer_t::make_io_account;
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    int latency_target_ms);
 
     void index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account);
 
@@ -142,6 +144,7 @@ public:
     void offer_read_ahead_buf(block_id_t block_id,
                               scoped_malloc_t<ser_buffer_t> *buf,
                               const counted_t<standard_block_token_t> &token);
+    bool wants_warmup_read_ahead() const;
 };
 
 #endif /* SERIALIZER_TRANSLATOR_HPP_ */
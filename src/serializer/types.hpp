@@ -21,6 +21,11 @@ typedef uint64_t block_id_t;
 
 // The first bytes of any block stored on disk or (as it happens) cached in memory.
 struct ls_buf_data_t {
+    // The CRC32C of the block id and the cache data as they are stored on disk, see
+    // serializer/log/block_checksum.hpp.
+    uint32_t checksum;
+    // Keeps block_id and the cache data 8-byte aligned.  Always zero.
+    uint32_t padding;
     block_id_t block_id;
 } __attribute__((__packed__));
 
@@ -89,9 +94,22 @@ class log_serializer_t;
 
 class ls_block_token_pointee_t {
 public:
+    /* Offsets from this one on are in the log serializer's cold tier file, at
+    `offset - cold_tier_offset_base`.  See serializer/log/tiered_file.hpp. */
+    static const int64_t cold_tier_offset_base = INT64_C(1) << 46;
+
     int64_t offset() const { return offset_; }
     block_size_t block_size() const { return block_size_; }
 
+    // The size the block takes up on disk.  This is less than block_size() if the
+    // block is stored compressed.
+    block_size_t disk_block_size() const { return disk_block_size_; }
+    bool is_compressed() const {
+        return disk_block_size_.ser_value() != block_size_.ser_value();
+    }
+
+    bool in_cold_tier() const { return offset_ >= cold_tier_offset_base; }
+
 private:
     friend class log_serializer_t;
     friend class dbm_read_ahead_fsm_t;  // For read-ahead tokens.
@@ -100,14 +118,18 @@ private:
 
     ls_block_token_pointee_t(log_serializer_t *serializer,
                              int64_t initial_offset,
-                             block_size_t initial_ser_block_size);
+                             block_size_t initial_ser_block_size,
+                             block_size_t initial_disk_block_size);
 
     log_serializer_t *serializer_;
     intptr_t ref_count_;
 
-    // The block's size.
+    // The block's (uncompressed) size.
     block_size_t block_size_;
 
+    // The block's size on disk.
+    block_size_t disk_block_size_;
+
     // The block's offset on disk.
     int64_t offset_;
 
@@ -142,6 +164,10 @@ public:
     virtual void move_serializer_file_to_permanent_location() = 0;
     virtual void open_serializer_file_existing(scoped_ptr_t<file_t> *file_out) = 0;
     virtual void unlink_serializer_file() = 0;
+    // Opens (creating it if necessary) the file that the serializer moves blocks
+    // that haven't been written in a long time to, usually on cheaper storage.
+    // Leaves file_out empty if the serializer has no cold tier.
+    virtual void open_cold_tier_file(UNUSED scoped_ptr_t<file_t> *file_out) { }
 #ifdef SEMANTIC_SERIALIZER_CHECK
     virtual void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out) = 0;
 #endif
@@ -183,6 +209,10 @@ struct scs_block_token_t {
         return inner_token->block_size();
     }
 
+    bool in_cold_tier() const {
+        return inner_token->in_cold_tier();
+    }
+
     block_id_t block_id;    // NULL_BLOCK_ID if not associated with a block id
     scs_block_info_t info;      // invariant: info.state != scs_block_info_t::state_deleted
     counted_t<typename serializer_traits_t<inner_serializer_t>::block_token_type> inner_token;
@@ -270,6 +300,11 @@ public:
     virtual void offer_read_ahead_buf(block_id_t block_id,
                                       scoped_malloc_t<ser_buffer_t> *buf,
                                       const counted_t<standard_block_token_t> &token) = 0;
+
+    // Returns true if the callback wants the serializer to read ahead on every read
+    // (for warming up a cache).  Otherwise the serializer only reads ahead on reads
+    // that look like a sequential scan.
+    virtual bool wants_warmup_read_ahead() const = 0;
 };
 
 struct buf_write_info_t {
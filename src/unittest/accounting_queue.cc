@@ -0,0 +1,117 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <list>
+
+#include "concurrency/queue/accounting.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// A FIFO of ints, each queued at a given time.
+class timed_fifo_t : public passive_producer_t<int>, public latency_sensitive_source_t {
+public:
+    timed_fifo_t() : passive_producer_t<int>(&available_control) { }
+
+    void push(int value, ticks_t enqueue_time) {
+        queue.push_back(std::make_pair(value, enqueue_time));
+        available_control.set_available(true);
+    }
+
+    bool get_head_enqueue_time(ticks_t *enqueue_time_out) {
+        if (queue.empty()) {
+            return false;
+        }
+        *enqueue_time_out = queue.front().second;
+        return true;
+    }
+
+private:
+    int produce_next_value() {
+        int value = queue.front().first;
+        queue.pop_front();
+        available_control.set_available(!queue.empty());
+        return value;
+    }
+
+    availability_control_t available_control;
+    std::list<std::pair<int, ticks_t> > queue;
+};
+
+void run_shares_test() {
+    accounting_queue_t<int> queue(1);
+    timed_fifo_t heavy, light;
+    accounting_queue_t<int>::account_t heavy_account(&queue, &heavy, 3);
+    accounting_queue_t<int>::account_t light_account(&queue, &light, 1);
+
+    const ticks_t now = get_ticks();
+    for (int i = 0; i < 400; ++i) {
+        heavy.push(0, now);
+        light.push(1, now);
+    }
+    int light_pops = 0;
+    for (int i = 0; i < 400; ++i) {
+        light_pops += queue.pop();
+    }
+    EXPECT_GE(light_pops, 99);
+    EXPECT_LE(light_pops, 101);
+
+    // An account that was idle doesn't get to catch up on the pops it missed.
+    timed_fifo_t late;
+    accounting_queue_t<int>::account_t late_account(&queue, &late, 1);
+    for (int i = 0; i < 100; ++i) {
+        late.push(2, now);
+    }
+    int late_pops = 0;
+    for (int i = 0; i < 50; ++i) {
+        late_pops += (queue.pop() == 2);
+    }
+    EXPECT_GE(late_pops, 9);
+    EXPECT_LE(late_pops, 11);
+
+    while (queue.available->get()) {
+        queue.pop();
+    }
+}
+
+TEST(AccountingQueue, Shares) {
+    run_in_thread_pool(&run_shares_test);
+}
+
+void run_latency_target_test() {
+    accounting_queue_t<int> queue(4);
+    timed_fifo_t background, foreground;
+    accounting_queue_t<int>::account_t background_account(&queue, &background, 100);
+    accounting_queue_t<int>::account_t foreground_account(
+        &queue, &foreground, 1, &foreground, secs_to_ticks(1));
+
+    const ticks_t now = get_ticks();
+    for (int i = 0; i < 100; ++i) {
+        background.push(0, now);
+    }
+    // This starts a batch from the background account.
+    EXPECT_EQ(0, queue.pop());
+
+    // Requests within their latency target wait for the batch to finish.
+    foreground.push(1, now);
+    EXPECT_EQ(0, queue.pop());
+    EXPECT_EQ(0, queue.pop());
+    EXPECT_EQ(0, queue.pop());
+    EXPECT_EQ(1, queue.pop());
+
+    // Late ones go first, even though the foreground account has used up its share.
+    foreground.push(1, now - secs_to_ticks(2));
+    foreground.push(1, now - secs_to_ticks(2));
+    EXPECT_EQ(1, queue.pop());
+    EXPECT_EQ(1, queue.pop());
+    EXPECT_EQ(0, queue.pop());
+
+    while (queue.available->get()) {
+        queue.pop();
+    }
+}
+
+TEST(AccountingQueue, LatencyTarget) {
+    run_in_thread_pool(&run_latency_target_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,42 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/adaptive_limit.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+void run_window(adaptive_concurrency_limit_t *limit, ticks_t latency,
+                size_t in_flight) {
+    for (size_t i = 0; i < ADAPTIVE_CONCURRENCY_WINDOW; ++i) {
+        limit->report_completion(latency, in_flight);
+    }
+}
+
+TEST(AdaptiveLimitTest, GrowsWhileLatencyIsFlat) {
+    adaptive_concurrency_limit_t limit(adaptive_concurrency_params_t(1, 4, 6));
+    for (int i = 0; i < 10; ++i) {
+        run_window(&limit, 1000, limit.get_limit());
+    }
+    EXPECT_EQ(6u, limit.get_limit());
+}
+
+TEST(AdaptiveLimitTest, DoesNotGrowWhenUnsaturated) {
+    adaptive_concurrency_limit_t limit(adaptive_concurrency_params_t(1, 4, 16));
+    for (int i = 0; i < 10; ++i) {
+        run_window(&limit, 1000, 2);
+    }
+    EXPECT_EQ(4u, limit.get_limit());
+}
+
+TEST(AdaptiveLimitTest, BacksOffWhenLatencyRises) {
+    adaptive_concurrency_limit_t limit(adaptive_concurrency_params_t(2, 8, 16));
+    run_window(&limit, 1000, 8);
+    EXPECT_EQ(9u, limit.get_limit());
+    run_window(&limit, 10000, 9);
+    EXPECT_LT(limit.get_limit(), 9u);
+    for (int i = 0; i < 10; ++i) {
+        run_window(&limit, 100000, limit.get_limit());
+    }
+    EXPECT_EQ(2u, limit.get_limit());
+}
+
+}  // namespace unittest
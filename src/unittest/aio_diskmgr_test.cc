@@ -0,0 +1,199 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <functional>
+#include <vector>
+
+#include "arch/io/disk/aio.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const size_t aio_test_block_size = 4 * KILOBYTE;
+
+// Runs batches of actions through an `aio_diskmgr_t`, all pushed to its source in
+// the same pass of the event loop, so that it gets the chance to merge them.
+class aio_test_diskmgr_t {
+public:
+    explicit aio_test_diskmgr_t(bool use_kernel_aio)
+        : diskmgr(&linux_thread_pool_t::get_thread()->queue, &source, 8,
+                  use_kernel_aio),
+          n_waiting(0),
+          done_cond(NULL) {
+        diskmgr.done_fun = std::bind(&aio_test_diskmgr_t::on_done, this, ph::_1);
+    }
+
+    void run(const std::vector<aio_diskmgr_t::action_t *> &actions) {
+        cond_t done;
+        n_waiting = actions.size();
+        done_cond = &done;
+        for (auto it = actions.begin(); it != actions.end(); ++it) {
+            source.push(*it);
+        }
+        done.wait_lazily_unordered();
+        done_cond = NULL;
+    }
+
+private:
+    void on_done(UNUSED aio_diskmgr_t::action_t *a) {
+        ASSERT_TRUE(done_cond != NULL);
+        --n_waiting;
+        if (n_waiting == 0) {
+            done_cond->pulse();
+        }
+    }
+
+    unlimited_fifo_queue_t<aio_diskmgr_t::action_t *> source;
+    aio_diskmgr_t diskmgr;
+    size_t n_waiting;
+    cond_t *done_cond;
+};
+
+char *aligned_block() {
+    return static_cast<char *>(malloc_aligned(aio_test_block_size, DEVICE_BLOCK_SIZE));
+}
+
+// Opens the file with O_DIRECT if we can, so that the actions are eligible for
+// kernel AIO.  File systems like tmpfs refuse, and then every action takes the
+// blocker pool path.
+fd_t open_test_file(const temp_file_t &file, bool direct) {
+    const std::string path = file.name().permanent_path();
+    if (direct) {
+        const fd_t fd = ::open(path.c_str(), O_RDWR | O_DIRECT);
+        if (fd != -1) {
+            return fd;
+        }
+        guarantee_err(get_errno() == EINVAL, "Couldn't open the test file");
+        debugf("O_DIRECT isn't supported for %s; the kernel AIO path is untested.\n",
+               path.c_str());
+    }
+    const fd_t fd = ::open(path.c_str(), O_RDWR);
+    guarantee_err(fd != -1, "Couldn't open the test file");
+    return fd;
+}
+
+void run_round_trip_test(bool use_kernel_aio, bool direct) {
+    temp_file_t file;
+    const fd_t fd = open_test_file(file, direct);
+    aio_test_diskmgr_t diskmgr(use_kernel_aio);
+
+    // Contiguous writes, which get merged, then a separate vectored write.
+    const int n_blocks = 16;
+    std::vector<scoped_malloc_t<char> > blocks;
+    std::vector<scoped_ptr_t<aio_diskmgr_t::action_t> > actions;
+    std::vector<aio_diskmgr_t::action_t *> batch;
+    for (int i = 0; i < n_blocks; ++i) {
+        blocks.push_back(scoped_malloc_t<char>(aligned_block()));
+        memset(blocks.back().get(), 'a' + i, aio_test_block_size);
+        actions.push_back(make_scoped<aio_diskmgr_t::action_t>());
+        actions.back()->make_write(fd, blocks.back().get(), aio_test_block_size,
+                                   i * aio_test_block_size, false);
+        batch.push_back(actions.back().get());
+    }
+    scoped_array_t<iovec> vecs(2);
+    for (size_t i = 0; i < vecs.size(); ++i) {
+        blocks.push_back(scoped_malloc_t<char>(aligned_block()));
+        memset(blocks.back().get(), 'A' + i, aio_test_block_size);
+        vecs[i].iov_base = blocks.back().get();
+        vecs[i].iov_len = aio_test_block_size;
+    }
+    actions.push_back(make_scoped<aio_diskmgr_t::action_t>());
+    actions.back()->make_writev(fd, std::move(vecs), 2 * aio_test_block_size,
+                                (n_blocks + 1) * aio_test_block_size);
+    batch.push_back(actions.back().get());
+
+    diskmgr.run(batch);
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        ASSERT_TRUE((*it)->get_succeeded());
+    }
+
+    // Contiguous reads in reverse order, so that they only merge once sorted.
+    actions.clear();
+    batch.clear();
+    std::vector<scoped_malloc_t<char> > read_blocks;
+    for (int i = n_blocks + 2; i >= 0; --i) {
+        read_blocks.push_back(scoped_malloc_t<char>(aligned_block()));
+        actions.push_back(make_scoped<aio_diskmgr_t::action_t>());
+        actions.back()->make_read(fd, read_blocks.back().get(), aio_test_block_size,
+                                  i * aio_test_block_size);
+        batch.push_back(actions.back().get());
+    }
+
+    diskmgr.run(batch);
+    for (int i = n_blocks + 2, j = 0; i >= 0; --i, ++j) {
+        ASSERT_TRUE(batch[j]->get_succeeded());
+        char expected;
+        if (i < n_blocks) {
+            expected = 'a' + i;
+        } else if (i == n_blocks) {
+            // The gap between the writes reads back as zeros.
+            expected = 0;
+        } else {
+            expected = 'A' + (i - n_blocks - 1);
+        }
+        const char *data = read_blocks[j].get();
+        for (size_t k = 0; k < aio_test_block_size; ++k) {
+            ASSERT_EQ(expected, data[k]);
+        }
+    }
+
+    ::close(fd);
+}
+
+TEST(AioDiskmgr, KernelAioRoundTrip) {
+    run_in_thread_pool(std::bind(&run_round_trip_test, true, true));
+}
+
+TEST(AioDiskmgr, BufferedFileRoundTrip) {
+    run_in_thread_pool(std::bind(&run_round_trip_test, true, false));
+}
+
+TEST(AioDiskmgr, BlockerPoolRoundTrip) {
+    run_in_thread_pool(std::bind(&run_round_trip_test, false, true));
+}
+
+void run_short_merged_read_test() {
+    temp_file_t file;
+    const fd_t fd = open_test_file(file, true);
+    aio_test_diskmgr_t diskmgr(true);
+
+    scoped_malloc_t<char> block(aligned_block());
+    memset(block.get(), 'x', aio_test_block_size);
+    aio_diskmgr_t::action_t write;
+    write.make_write(fd, block.get(), aio_test_block_size, 0, false);
+    diskmgr.run(std::vector<aio_diskmgr_t::action_t *>(1, &write));
+    ASSERT_TRUE(write.get_succeeded());
+
+    // The second read is past the end of the file, so the merged read comes up
+    // short, and the two reads have to be told apart.
+    scoped_malloc_t<char> first(aligned_block());
+    scoped_malloc_t<char> second(aligned_block());
+    aio_diskmgr_t::action_t first_read;
+    aio_diskmgr_t::action_t second_read;
+    first_read.make_read(fd, first.get(), aio_test_block_size, 0);
+    second_read.make_read(fd, second.get(), aio_test_block_size, aio_test_block_size);
+    std::vector<aio_diskmgr_t::action_t *> batch;
+    batch.push_back(&first_read);
+    batch.push_back(&second_read);
+    diskmgr.run(batch);
+
+    EXPECT_TRUE(first_read.get_succeeded());
+    EXPECT_EQ('x', first.get()[0]);
+    EXPECT_EQ('x', first.get()[aio_test_block_size - 1]);
+    EXPECT_FALSE(second_read.get_succeeded());
+
+    ::close(fd);
+}
+
+TEST(AioDiskmgr, ShortMergedRead) {
+    run_in_thread_pool(&run_short_merged_read_test);
+}
+
+}  // namespace unittest
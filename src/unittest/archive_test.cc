@@ -1,10 +1,12 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include <string>
+#include <vector>
 
 #include "unittest/gtest.hpp"
 
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
 
 namespace unittest {
 
@@ -34,6 +36,80 @@ TEST(WriteMessageTest, Variant) {
     ASSERT_EQ(15u, s.size());
 }
 
+TEST(WriteMessageTest, Clear) {
+    write_message_t msg;
+    std::string big(write_buffer_t::DATA_SIZE * 2 + 10, 'a');
+    msg.append(big.data(), big.size());
+    ASSERT_EQ(big.size(), msg.size());
+
+    // The buffers are reused after the message is cleared.
+    write_buffer_t *first_buffer = msg.unsafe_expose_buffers()->head();
+    msg.clear();
+    ASSERT_EQ(0u, msg.size());
+    ASSERT_TRUE(msg.unsafe_expose_buffers()->empty());
+
+    msg << std::string("Hello, world!");
+    ASSERT_EQ(first_buffer, msg.unsafe_expose_buffers()->head());
+
+    std::string s;
+    dump_to_string(&msg, &s);
+    ASSERT_EQ(14u, s.size());
+    ASSERT_EQ('H', s[1]);
+}
 
+#ifndef THREADED_COROUTINES
+TEST(WriteMessageTest, BufferPool) {
+    write_buffer_t *first_buffer;
+    {
+        write_message_t msg;
+        msg << std::string("Hello, world!");
+        first_buffer = msg.unsafe_expose_buffers()->head();
+    }
+
+    // The next message on this thread gets the buffer the last one released.
+    write_message_t msg;
+    msg << std::string("Goodbye");
+    ASSERT_EQ(first_buffer, msg.unsafe_expose_buffers()->head());
+
+    std::string s;
+    dump_to_string(&msg, &s);
+    ASSERT_EQ(8u, s.size());
+    ASSERT_EQ('G', s[1]);
+}
+#endif  // THREADED_COROUTINES
+
+TEST(WriteMessageTest, RawVector) {
+    // Big enough to span several buffers.
+    std::vector<uint64_t> v;
+    for (uint64_t i = 0; i < 2000; ++i) {
+        v.push_back(i * 0x0101010101010101ULL);
+    }
+
+    write_message_t msg;
+    msg << v;
+    ASSERT_EQ(serialized_size(v), msg.size());
+
+    // The elements are copied all at once, but the result is the same as
+    // serializing them one at a time.
+    write_message_t elementwise_msg;
+    serialize_varint_uint64(&elementwise_msg, v.size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        elementwise_msg << v[i];
+    }
+    std::string s, elementwise_s;
+    dump_to_string(&msg, &s);
+    dump_to_string(&elementwise_msg, &elementwise_s);
+    ASSERT_EQ(elementwise_s, s);
+
+    string_read_stream_t read_stream(std::move(s), 0);
+    std::vector<uint64_t> result;
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &result));
+    ASSERT_EQ(v, result);
+
+    // A truncated vector fails to deserialize.
+    std::string truncated = elementwise_s.substr(0, elementwise_s.size() - 1);
+    string_read_stream_t truncated_stream(std::move(truncated), 0);
+    ASSERT_EQ(ARCHIVE_SOCK_EOF, deserialize(&truncated_stream, &result));
+}
 
 }  // namespace unittest
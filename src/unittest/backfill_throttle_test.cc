@@ -0,0 +1,44 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/timing.hpp"
+#include "clustering/immediate_consistency/branch/backfill_throttle.hpp"
+#include "concurrency/cond_var.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void run_backfill_throttle_test() {
+    cond_t non_interruptor;
+
+    // Without a limit, nothing waits.
+    ASSERT_FALSE(backfill_bandwidth_is_limited());
+    microtime_t start = current_microtime();
+    for (int i = 0; i < 100; ++i) {
+        wait_for_backfill_bandwidth(10 * MEGABYTE, &non_interruptor);
+    }
+    ASSERT_LT(current_microtime() - start, 100 * THOUSAND);
+
+    // 2 MB at 10 MB per second take 200 ms, minus the burst that's allowed.
+    set_backfill_bandwidth_limit(10 * MEGABYTE);
+    ASSERT_TRUE(backfill_bandwidth_is_limited());
+    start = current_microtime();
+    for (int i = 0; i < 20; ++i) {
+        wait_for_backfill_bandwidth(100 * KILOBYTE, &non_interruptor);
+    }
+    ASSERT_GE(current_microtime() - start,
+              (200 - BACKFILL_BANDWIDTH_BURST_MS - 20) * THOUSAND);
+
+    // Waiting can be interrupted.
+    cond_t interruptor;
+    interruptor.pulse();
+    ASSERT_THROW(wait_for_backfill_bandwidth(10 * MEGABYTE, &interruptor),
+                 interrupted_exc_t);
+
+    set_backfill_bandwidth_limit(0);
+}
+
+TEST(BackfillThrottleTest, Limit) {
+    unittest::run_in_thread_pool(&run_backfill_throttle_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,58 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/timing.hpp"
+#include "concurrency/background_governor.hpp"
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void record_latencies(int64_t ms) {
+    for (int i = 0; i < 2 * BACKGROUND_GOVERNOR_MIN_SAMPLES; ++i) {
+        record_foreground_latency(ms * MILLION);
+    }
+}
+
+void run_background_governor_test() {
+    cond_t non_interruptor;
+
+    // Without a target, nothing is held back however slow the queries are.
+    record_latencies(10 * THOUSAND);
+    ASSERT_FALSE(foreground_latency_at_risk());
+    microtime_t start = current_microtime();
+    wait_for_background_turn(&non_interruptor);
+    ASSERT_LT(current_microtime() - start, 100 * THOUSAND);
+
+    // Queries slower than the target put it at risk once their window is over.
+    set_background_latency_target(10 * THOUSAND);
+    record_latencies(100);
+    ASSERT_FALSE(foreground_latency_at_risk());
+    nap(BACKGROUND_GOVERNOR_WINDOW_MS + 10);
+    ASSERT_TRUE(foreground_latency_at_risk());
+
+    // Waiting can be interrupted.
+    cond_t interruptor;
+    interruptor.pulse();
+    ASSERT_THROW(wait_for_background_turn(&interruptor), interrupted_exc_t);
+
+    // A window of fast queries lets the background work go again.
+    record_latencies(1);
+    nap(BACKGROUND_GOVERNOR_WINDOW_MS + 10);
+    ASSERT_FALSE(foreground_latency_at_risk());
+
+    // So does a window without any.
+    record_latencies(100);
+    nap(BACKGROUND_GOVERNOR_WINDOW_MS + 10);
+    ASSERT_TRUE(foreground_latency_at_risk());
+    nap(BACKGROUND_GOVERNOR_WINDOW_MS + 10);
+    ASSERT_FALSE(foreground_latency_at_risk());
+
+    set_background_latency_target(0);
+}
+
+TEST(BackgroundGovernorTest, LatencyTarget) {
+    unittest::run_in_thread_pool(&run_background_governor_test);
+}
+
+}  // namespace unittest
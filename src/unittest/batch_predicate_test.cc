@@ -0,0 +1,244 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/batch_predicate.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/term_walker.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+static const ql::pb::dummy_var_t row_var = ql::pb::dummy_var_t::IGNORED;
+static const ql::pb::dummy_var_t left_var = ql::pb::dummy_var_t::INNERJOIN_N;
+static const ql::pb::dummy_var_t right_var = ql::pb::dummy_var_t::INNERJOIN_M;
+
+counted_t<ql::func_t> compile_func(ql::protob_t<Term> twrap) {
+    ql::protob_t<Backtrace> bt = ql::make_counted_backtrace();
+    ql::propagate_backtrace(twrap.get(), bt.get());
+
+    ql::compile_env_t empty_compile_env((ql::var_visibility_t()));
+    counted_t<ql::func_term_t> func_term
+        = make_counted<ql::func_term_t>(&empty_compile_env, twrap);
+    return func_term->eval_to_func(ql::var_scope_t());
+}
+
+counted_t<ql::func_t> make_row_func(ql::r::reql_t &&body) {
+    return compile_func(ql::r::fun(row_var, std::move(body)).release_counted());
+}
+
+counted_t<const ql::datum_t> make_row(const std::string &json) {
+    return make_counted<const ql::datum_t>(scoped_cJSON_t(cJSON_Parse(json.c_str())));
+}
+
+std::vector<ql::batch_predicate_t::result_t> evaluate(
+        const ql::batch_predicate_t &predicate, const std::vector<std::string> &rows) {
+    std::vector<counted_t<const ql::datum_t> > datums;
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        datums.push_back(make_row(*it));
+    }
+    std::vector<ql::batch_predicate_t::result_t> results;
+    predicate.evaluate(datums, &results);
+    EXPECT_EQ(rows.size(), results.size());
+    return results;
+}
+
+TEST(BatchPredicateTest, Comparison) {
+    scoped_ptr_t<ql::batch_predicate_t> predicate = ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var)[std::string("a")] > ql::r::expr(3.0)));
+    ASSERT_TRUE(predicate.has());
+    ASSERT_TRUE(predicate->reads_only_row_fields());
+    ASSERT_EQ(1u, predicate->get_row_fields().size());
+    ASSERT_EQ(1u, predicate->get_row_fields().count("a"));
+
+    std::vector<ql::batch_predicate_t::result_t> results
+        = evaluate(*predicate, {"{\"a\": 5}", "{\"a\": 1, \"b\": 7}", "{\"b\": 7}",
+                                "[1, 2]", "{\"a\": \"x\"}"});
+    EXPECT_EQ(ql::batch_predicate_t::PASS, results[0]);
+    EXPECT_EQ(ql::batch_predicate_t::FAIL, results[1]);
+    // A missing field and a non-object are left to the interpreter.
+    EXPECT_EQ(ql::batch_predicate_t::UNKNOWN, results[2]);
+    EXPECT_EQ(ql::batch_predicate_t::UNKNOWN, results[3]);
+    // Strings sort after numbers.
+    EXPECT_EQ(ql::batch_predicate_t::PASS, results[4]);
+}
+
+TEST(BatchPredicateTest, ShortCircuit) {
+    scoped_ptr_t<ql::batch_predicate_t> predicate = ql::compile_batch_predicate(
+        make_row_func(
+            (ql::r::var(row_var)[std::string("a")] == ql::r::expr(1.0))
+            && (ql::r::var(row_var)[std::string("b")] / ql::r::expr(2.0)
+                < ql::r::expr(4.0))));
+    ASSERT_TRUE(predicate.has());
+
+    std::vector<ql::batch_predicate_t::result_t> results
+        = evaluate(*predicate, {"{\"a\": 2}", "{\"a\": 1, \"b\": 6}",
+                                "{\"a\": 1, \"b\": 10}", "{\"a\": 1}",
+                                "{\"a\": 1, \"b\": \"x\"}"});
+    // `b` isn't needed when `a` already fails.
+    EXPECT_EQ(ql::batch_predicate_t::FAIL, results[0]);
+    EXPECT_EQ(ql::batch_predicate_t::PASS, results[1]);
+    EXPECT_EQ(ql::batch_predicate_t::FAIL, results[2]);
+    EXPECT_EQ(ql::batch_predicate_t::UNKNOWN, results[3]);
+    EXPECT_EQ(ql::batch_predicate_t::UNKNOWN, results[4]);
+}
+
+TEST(BatchPredicateTest, Uncompilable) {
+    // The whole row is used, so the predicate can't be evaluated on some fields.
+    scoped_ptr_t<ql::batch_predicate_t> predicate = ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var) == ql::r::expr(std::string("x"))));
+    ASSERT_TRUE(predicate.has());
+    EXPECT_FALSE(predicate->reads_only_row_fields());
+
+    // Unsupported terms aren't compiled at all.
+    EXPECT_FALSE(ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var).call(Term::COUNT))).has());
+}
+
+TEST(BatchPredicateTest, FieldEquality) {
+    scoped_ptr_t<ql::batch_predicate_t> predicate = ql::compile_batch_predicate(
+        make_row_func(ql::r::expr(std::string("x"))
+                      == ql::r::var(row_var)[std::string("id")]));
+    ASSERT_TRUE(predicate.has());
+    std::string field;
+    counted_t<const ql::datum_t> value;
+    ASSERT_TRUE(predicate->get_row_field_equality(&field, &value));
+    EXPECT_EQ("id", field);
+    EXPECT_EQ(ql::datum_t("x"), *value);
+
+    predicate = ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var)[std::string("id")] < ql::r::expr(1.0)));
+    ASSERT_TRUE(predicate.has());
+    EXPECT_FALSE(predicate->get_row_field_equality(&field, &value));
+}
+
+TEST(BatchPredicateTest, FieldRange) {
+    scoped_ptr_t<ql::batch_predicate_t> predicate = ql::compile_batch_predicate(
+        make_row_func((ql::r::expr(10.0) > ql::r::var(row_var)[std::string("a")])
+                      && (ql::r::var(row_var)[std::string("a")] >= ql::r::expr(1.0))));
+    ASSERT_TRUE(predicate.has());
+    ql::batch_predicate_t::row_field_range_t range;
+    ASSERT_TRUE(predicate->get_row_field_range(&range));
+    EXPECT_EQ("a", range.field);
+    EXPECT_EQ(ql::datum_t(1.0), *range.left);
+    EXPECT_EQ(key_range_t::closed, range.left_bound);
+    EXPECT_EQ(ql::datum_t(10.0), *range.right);
+    EXPECT_EQ(key_range_t::open, range.right_bound);
+
+    // An equality is a range with one value.
+    predicate = ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var)[std::string("a")] == ql::r::expr(2.0)));
+    ASSERT_TRUE(predicate.has());
+    ASSERT_TRUE(predicate->get_row_field_range(&range));
+    EXPECT_EQ(ql::datum_t(2.0), *range.left);
+    EXPECT_EQ(ql::datum_t(2.0), *range.right);
+
+    // Both bounds have to be on the same field, and from opposite sides.
+    predicate = ql::compile_batch_predicate(
+        make_row_func((ql::r::var(row_var)[std::string("a")] > ql::r::expr(1.0))
+                      && (ql::r::var(row_var)[std::string("b")] < ql::r::expr(2.0))));
+    ASSERT_TRUE(predicate.has());
+    EXPECT_FALSE(predicate->get_row_field_range(&range));
+    predicate = ql::compile_batch_predicate(
+        make_row_func((ql::r::var(row_var)[std::string("a")] > ql::r::expr(1.0))
+                      && (ql::r::var(row_var)[std::string("a")] > ql::r::expr(2.0))));
+    ASSERT_TRUE(predicate.has());
+    EXPECT_FALSE(predicate->get_row_field_range(&range));
+}
+
+TEST(BatchPredicateTest, Match) {
+    scoped_ptr_t<ql::batch_predicate_t> predicate = ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var)[std::string("a")].call(
+            Term::MATCH, ql::r::expr(std::string("^fo+b")))));
+    ASSERT_TRUE(predicate.has());
+
+    std::vector<ql::batch_predicate_t::result_t> results
+        = evaluate(*predicate, {"{\"a\": \"foobar\"}", "{\"a\": \"barfoob\"}",
+                                "{\"a\": 1}", "{\"b\": \"foob\"}"});
+    EXPECT_EQ(ql::batch_predicate_t::PASS, results[0]);
+    EXPECT_EQ(ql::batch_predicate_t::FAIL, results[1]);
+    // `match` fails on numbers, and a missing field is left to the interpreter.
+    EXPECT_EQ(ql::batch_predicate_t::UNKNOWN, results[2]);
+    EXPECT_EQ(ql::batch_predicate_t::UNKNOWN, results[3]);
+
+    // The pattern's literal prefix is a range of the field.
+    ql::batch_predicate_t::row_field_range_t range;
+    ASSERT_TRUE(predicate->get_row_field_range(&range));
+    EXPECT_EQ("a", range.field);
+    EXPECT_EQ(ql::datum_t("fo"), *range.left);
+    EXPECT_EQ(key_range_t::closed, range.left_bound);
+    EXPECT_EQ(ql::datum_t("fp"), *range.right);
+    EXPECT_EQ(key_range_t::open, range.right_bound);
+
+    // Only whether `match` matched is computed, so it isn't compiled where its
+    // value is used.
+    EXPECT_FALSE(ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var)[std::string("a")].call(
+            Term::MATCH, ql::r::expr(std::string("x"))) == ql::r::null())).has());
+    // Nor are patterns that aren't constant or don't compile.
+    EXPECT_FALSE(ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var)[std::string("a")].call(
+            Term::MATCH, ql::r::var(row_var)[std::string("b")]))).has());
+    EXPECT_FALSE(ql::compile_batch_predicate(
+        make_row_func(ql::r::var(row_var)[std::string("a")].call(
+            Term::MATCH, ql::r::expr(std::string("("))))).has());
+}
+
+TEST(BatchPredicateTest, RowField) {
+    std::string field;
+    ASSERT_TRUE(ql::get_row_field(
+        make_row_func(ql::r::var(row_var)[std::string("a")]), &field));
+    EXPECT_EQ("a", field);
+    EXPECT_FALSE(ql::get_row_field(
+        make_row_func(ql::r::var(row_var)[std::string("a")][std::string("b")]),
+        &field));
+}
+
+TEST(BatchPredicateTest, RowProjection) {
+    std::set<std::string> fields;
+    ASSERT_TRUE(ql::get_row_projection(
+        make_row_func(ql::r::var(row_var).call(Term::PLUCK,
+                                               ql::r::expr(std::string("a")),
+                                               ql::r::expr(std::string("b")))),
+        &fields));
+    EXPECT_EQ((std::set<std::string>{"a", "b"}), fields);
+
+    // Nested paths aren't simple field names.
+    EXPECT_FALSE(ql::get_row_projection(
+        make_row_func(ql::r::var(row_var).call(
+            Term::PLUCK, ql::r::object(ql::r::optarg("a", ql::r::boolean(true))))),
+        &fields));
+    EXPECT_FALSE(ql::get_row_projection(
+        make_row_func(ql::r::var(row_var)[std::string("a")]), &fields));
+}
+
+TEST(BatchPredicateTest, JoinEquality) {
+    std::string left_field, right_field;
+    ASSERT_TRUE(ql::get_join_equality(
+        compile_func(ql::r::fun(left_var, right_var,
+                                ql::r::var(right_var)[std::string("b")]
+                                == ql::r::var(left_var)[std::string("a")])
+                     .release_counted()),
+        &left_field, &right_field));
+    EXPECT_EQ("a", left_field);
+    EXPECT_EQ("b", right_field);
+
+    // Both sides have to come from different rows.
+    EXPECT_FALSE(ql::get_join_equality(
+        compile_func(ql::r::fun(left_var, right_var,
+                                ql::r::var(left_var)[std::string("b")]
+                                == ql::r::var(left_var)[std::string("a")])
+                     .release_counted()),
+        &left_field, &right_field));
+    EXPECT_FALSE(ql::get_join_equality(
+        compile_func(ql::r::fun(left_var, right_var,
+                                ql::r::var(left_var)[std::string("a")]
+                                < ql::r::var(right_var)[std::string("b")])
+                     .release_counted()),
+        &left_field, &right_field));
+}
+
+}  // namespace unittest
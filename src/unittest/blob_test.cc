@@ -1,5 +1,6 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "buffer_cache/alt/alt.hpp"
+#include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
 #include "buffer_cache/alt/blob.hpp"
 #include "containers/buffer_group.hpp"
 #include "containers/scoped.hpp"
@@ -10,7 +11,7 @@
 
 namespace unittest {
 
-static const int expected_cache_block_size = 4088;
+static const int expected_cache_block_size = 4080;
 static const int size_after_magic = expected_cache_block_size - sizeof(block_magic_t);
 
 class blob_tracker_t {
@@ -78,9 +79,40 @@ public:
         }
     }
 
+    void check_stream(txn_t *txn) {
+        SCOPED_TRACE("check_stream");
+        blob_read_stream_t stream(buf_parent_t(txn), buf_.data(), buf_.size());
+        std::string actual;
+        // An odd read size, so that reads straddle leaf and chunk boundaries.
+        char chunk[1237];
+        for (;;) {
+            int64_t res = stream.read(chunk, sizeof(chunk));
+            ASSERT_LE(0, res);
+            if (res == 0) {
+                break;
+            }
+            actual.append(chunk, res);
+        }
+        ASSERT_TRUE(stream.entire_stream_consumed());
+        ASSERT_TRUE(expected_ == actual);
+    }
+
+    void check_inline_data() {
+        size_t sizesize = buf_.size() <= 255 ? 1 : 2;
+        const char *data = blob::inline_value_data(buf_.data(), buf_.size());
+        if (expected_.size() <= buf_.size() - sizesize) {
+            ASSERT_TRUE(data != NULL);
+            ASSERT_TRUE(expected_ == std::string(data, expected_.size()));
+        } else {
+            ASSERT_TRUE(data == NULL);
+        }
+    }
+
     void check(txn_t *txn) {
         check_region(txn, 0, expected_.size());
+        check_stream(txn);
         check_normalization(txn);
+        check_inline_data();
     }
 
     void append(txn_t *txn, const std::string &x) {
@@ -406,6 +438,7 @@ void run_blob_test() {
 
     cache_t cache(&log_serializer,
                   alt_cache_config_t(),
+                  NULL,
                   &get_global_perfmon_collection());
 
     run_tests(&cache);
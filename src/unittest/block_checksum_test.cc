@@ -0,0 +1,55 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include <string.h>
+
+#include "containers/scoped.hpp"
+#include "serializer/log/block_checksum.hpp"
+
+namespace unittest {
+
+TEST(BlockChecksumTest, KnownValue) {
+    const char *data = "123456789";
+    EXPECT_EQ(0xE3069283u, crc32c(data, strlen(data)));
+    EXPECT_EQ(0xE3069283u, crc32c_portable(data, strlen(data)));
+    EXPECT_EQ(0u, crc32c(data, 0));
+}
+
+TEST(BlockChecksumTest, MatchesPortable) {
+    // Covers unaligned starts and lengths that aren't multiples of 8.
+    char data[300];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = static_cast<char>(i * 37 + 11);
+    }
+    for (size_t start = 0; start < 8; ++start) {
+        for (size_t size = 0; start + size <= sizeof(data); size += 13) {
+            ASSERT_EQ(crc32c_portable(data + start, size), crc32c(data + start, size));
+        }
+    }
+}
+
+TEST(BlockChecksumTest, DetectsCorruption) {
+    const block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<ser_buffer_t> buf(malloc_aligned(block_size.ser_value(),
+                                                     DEVICE_BLOCK_SIZE));
+    memset(buf.get(), 0, block_size.ser_value());
+    buf->ser_header.block_id = 17;
+    for (size_t i = 0; i < block_size.value(); ++i) {
+        buf->cache_data[i] = 'a' + i % 7;
+    }
+    buf->ser_header.checksum = compute_block_checksum(buf.get(), block_size);
+    ASSERT_TRUE(block_checksum_matches(buf.get(), block_size));
+
+    buf->cache_data[1000] ^= 4;
+    EXPECT_FALSE(block_checksum_matches(buf.get(), block_size));
+    buf->cache_data[1000] ^= 4;
+
+    // A block that got written in the place of another one doesn't pass for it.
+    buf->ser_header.block_id = 18;
+    EXPECT_FALSE(block_checksum_matches(buf.get(), block_size));
+    buf->ser_header.block_id = 17;
+
+    EXPECT_TRUE(block_checksum_matches(buf.get(), block_size));
+}
+
+}  // namespace unittest
@@ -0,0 +1,56 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "containers/scoped.hpp"
+#include "serializer/log/block_compression.hpp"
+
+namespace unittest {
+
+const uint32_t TEST_BLOCK_SIZE = 4096;
+
+scoped_malloc_t<ser_buffer_t> make_test_buf() {
+    return scoped_malloc_t<ser_buffer_t>(malloc_aligned(TEST_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
+}
+
+TEST(BlockCompressionTest, RoundTrip) {
+    const block_size_t block_size = block_size_t::unsafe_make(TEST_BLOCK_SIZE);
+    scoped_malloc_t<ser_buffer_t> buf = make_test_buf();
+    buf->ser_header.block_id = 17;
+    for (size_t i = 0; i < block_size.value(); ++i) {
+        buf->cache_data[i] = 'a' + i % 7;
+    }
+
+    block_compressor_t compressor;
+    scoped_malloc_t<ser_buffer_t> compressed = make_test_buf();
+    block_size_t compressed_size = block_size_t::undefined();
+    ASSERT_TRUE(compressor.compress(buf.get(), block_size,
+                                    compressed.get(), &compressed_size));
+    ASSERT_LE(compressed_size.ser_value(), TEST_BLOCK_SIZE - DEVICE_BLOCK_SIZE);
+    ASSERT_EQ(17u, compressed->ser_header.block_id);
+
+    // The compressor is reused for several blocks.
+    for (int i = 0; i < 3; ++i) {
+        scoped_malloc_t<ser_buffer_t> decompressed = make_test_buf();
+        compressor.decompress(compressed.get(), compressed_size,
+                              decompressed.get(), block_size);
+        ASSERT_EQ(0, memcmp(buf.get(), decompressed.get(), TEST_BLOCK_SIZE));
+    }
+}
+
+TEST(BlockCompressionTest, IncompressibleBlock) {
+    const block_size_t block_size = block_size_t::unsafe_make(TEST_BLOCK_SIZE);
+    scoped_malloc_t<ser_buffer_t> buf = make_test_buf();
+    uint32_t state = 12345;
+    for (size_t i = 0; i < block_size.value(); ++i) {
+        state = state * 1103515245 + 12345;
+        buf->cache_data[i] = state >> 24;
+    }
+
+    block_compressor_t compressor;
+    scoped_malloc_t<ser_buffer_t> compressed = make_test_buf();
+    block_size_t compressed_size = block_size_t::undefined();
+    ASSERT_FALSE(compressor.compress(buf.get(), block_size,
+                                     compressed.get(), &compressed_size));
+}
+
+}  // namespace unittest
@@ -0,0 +1,165 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/bulk_load.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+struct bulk_load_value_t;
+
+// Values are a length byte followed by that many bytes.
+template <>
+class value_sizer_t<bulk_load_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t<bulk_load_value_t>(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *static_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 'l', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<bulk_load_value_t>);
+};
+
+namespace unittest {
+
+std::string bulk_load_key(int i) {
+    return strprintf("key%08d", i);
+}
+
+std::string bulk_load_value(int i) {
+    std::string contents = strprintf("value%d", i);
+    return std::string(1, static_cast<char>(contents.size())) + contents;
+}
+
+void bulk_load_batch(cache_conn_t *cache_conn, int begin, int end) {
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn(cache_conn, write_access_t::write, 1,
+                                 repli_timestamp_t::distant_past,
+                                 write_durability_t::SOFT,
+                                 &superblock, &txn);
+    value_sizer_t<bulk_load_value_t> sizer(cache_conn->cache()->get_block_size());
+    btree_bulk_loader_t loader(&sizer, superblock.get(),
+                               repli_timestamp_t::distant_past);
+    for (int i = begin; i < end; ++i) {
+        store_key_t key(bulk_load_key(i));
+        std::string value = bulk_load_value(i);
+        loader.add(key.btree_key(), value.data());
+    }
+    loader.finish();
+    EXPECT_EQ(end - begin, loader.num_added());
+}
+
+bool bulk_load_lookup(value_sizer_t<void> *sizer, superblock_t *superblock,
+                      const std::string &key_str, std::string *value_out) {
+    store_key_t key(key_str);
+    buf_lock_t node_lock = get_root(sizer, superblock);
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&node_lock);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                uint8_t value[256];
+                if (!leaf::lookup(sizer, reinterpret_cast<const leaf_node_t *>(node),
+                                  key.btree_key(), value)) {
+                    return false;
+                }
+                value_out->assign(reinterpret_cast<const char *>(value), 1 + value[0]);
+                return true;
+            }
+            child_id = internal_node::lookup(
+                reinterpret_cast<const internal_node_t *>(node), key.btree_key());
+        }
+        buf_lock_t child(&node_lock, child_id, access_t::read);
+        node_lock = std::move(child);
+    }
+}
+
+void run_bulk_load_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(), NULL,
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    // Enough keys for several levels of internal nodes, loaded in two batches so
+    // that the second loader has to pick up the right edge the first one left.
+    const int num_keys = 100000;
+    bulk_load_batch(&cache_conn, 0, num_keys / 2);
+    bulk_load_batch(&cache_conn, num_keys / 2, num_keys);
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 0,
+                                 repli_timestamp_t::distant_past,
+                                 write_durability_t::SOFT,
+                                 &superblock, &txn);
+    value_sizer_t<bulk_load_value_t> sizer(cache.get_block_size());
+
+    for (int i = 0; i < num_keys; i += 7) {
+        std::string value;
+        ASSERT_TRUE(bulk_load_lookup(&sizer, superblock.get(), bulk_load_key(i),
+                                     &value)) << bulk_load_key(i);
+        EXPECT_EQ(bulk_load_value(i), value);
+    }
+    std::string value;
+    EXPECT_FALSE(bulk_load_lookup(&sizer, superblock.get(), bulk_load_key(num_keys),
+                                  &value));
+    EXPECT_FALSE(bulk_load_lookup(&sizer, superblock.get(), "", &value));
+
+    buf_lock_t stat_block(superblock->expose_buf(), superblock->get_stat_block_id(),
+                          access_t::read);
+    buf_read_t read(&stat_block);
+    EXPECT_EQ(num_keys,
+              static_cast<const btree_statblock_t *>(read.get_data_read())->population);
+}
+
+TEST(BtreeBulkLoad, AppendBatches) {
+    unittest::run_in_thread_pool(&run_bulk_load_test);
+}
+
+}  // namespace unittest
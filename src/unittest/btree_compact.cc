@@ -0,0 +1,218 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/bulk_load.hpp"
+#include "btree/compact.hpp"
+#include "btree/erase_range.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "concurrency/cond_var.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+struct compact_value_t;
+
+// Values are a length byte followed by that many bytes.
+template <>
+class value_sizer_t<compact_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t<compact_value_t>(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *static_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'c', 'm', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<compact_value_t>);
+};
+
+namespace unittest {
+
+std::string compact_key(int i) {
+    return strprintf("key%08d", i);
+}
+
+class every_nth_key_kept_t : public key_tester_t {
+public:
+    explicit every_nth_key_kept_t(int n) : n_(n) { }
+    bool key_should_be_erased(const btree_key_t *key) {
+        int i;
+        const int res = sscanf(key_to_unescaped_str(store_key_t(key)).c_str(),
+                               "key%d", &i);
+        guarantee(res == 1);
+        return i % n_ != 0;
+    }
+private:
+    int n_;
+};
+
+class noop_value_deleter_t : public value_deleter_t {
+public:
+    void delete_value(buf_parent_t, void *) { }
+};
+
+// Counts the leaves under `node_lock` and appends their keys to *keys_out.
+int count_leaves(buf_lock_t *node_lock, std::vector<std::string> *keys_out) {
+    std::vector<block_id_t> children;
+    {
+        buf_read_t read(node_lock);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_leaf(node)) {
+            const leaf_node_t *leaf_node = reinterpret_cast<const leaf_node_t *>(node);
+            for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+                keys_out->push_back(key_to_unescaped_str(store_key_t((*it).first)));
+            }
+            return 1;
+        }
+        const internal_node_t *internal = reinterpret_cast<const internal_node_t *>(node);
+        for (int i = 0; i < internal->npairs; ++i) {
+            children.push_back(internal_node::get_pair_by_index(internal, i)->lnode);
+        }
+    }
+    int leaves = 0;
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        buf_lock_t child(node_lock, *it, access_t::read);
+        leaves += count_leaves(&child, keys_out);
+    }
+    return leaves;
+}
+
+int count_leaves(cache_conn_t *cache_conn, value_sizer_t<void> *sizer,
+                 std::vector<std::string> *keys_out) {
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn(cache_conn, write_access_t::write, 0,
+                                 repli_timestamp_t::distant_past,
+                                 write_durability_t::SOFT,
+                                 &superblock, &txn);
+    buf_lock_t root = get_root(sizer, superblock.get());
+    return count_leaves(&root, keys_out);
+}
+
+void run_compact_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(), NULL,
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+    value_sizer_t<compact_value_t> sizer(cache.get_block_size());
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    const int num_keys = 50000;
+    const int kept_every = 16;
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        btree_bulk_loader_t loader(&sizer, superblock.get(),
+                                   repli_timestamp_t::distant_past);
+        for (int i = 0; i < num_keys; ++i) {
+            store_key_t key(compact_key(i));
+            std::string contents = strprintf("value%d", i);
+            std::string value = std::string(1, static_cast<char>(contents.size()))
+                + contents;
+            loader.add(key.btree_key(), value.data());
+        }
+        loader.finish();
+    }
+
+    // Erase ranges don't merge the leaves they empty out.
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        every_nth_key_kept_t tester(kept_every);
+        noop_value_deleter_t deleter;
+        cond_t non_interruptor;
+        btree_erase_range_generic(&sizer, &tester, &deleter, NULL, NULL,
+                                  superblock.get(), &non_interruptor);
+    }
+
+    std::vector<std::string> keys_before;
+    const int leaves_before = count_leaves(&cache_conn, &sizer, &keys_before);
+    ASSERT_EQ(static_cast<size_t>(num_keys / kept_every), keys_before.size());
+
+    store_key_t cursor = store_key_t::min();
+    bool more = true;
+    while (more) {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        more = btree_compact_leaves(&sizer, superblock.get(), 3, &cursor);
+    }
+
+    std::vector<std::string> keys_after;
+    const int leaves_after = count_leaves(&cache_conn, &sizer, &keys_after);
+    EXPECT_EQ(keys_before, keys_after);
+    EXPECT_LT(leaves_after * kept_every / 4, leaves_before)
+        << leaves_before << " leaves before, " << leaves_after << " after";
+
+    // A second pass finds nothing left to merge.
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        store_key_t start = store_key_t::min();
+        while (btree_compact_leaves(&sizer, superblock.get(), 100, &start)) { }
+    }
+    std::vector<std::string> keys_again;
+    EXPECT_EQ(leaves_after, count_leaves(&cache_conn, &sizer, &keys_again));
+    EXPECT_EQ(keys_after, keys_again);
+}
+
+TEST(BtreeCompact, MergesThinnedLeaves) {
+    unittest::run_in_thread_pool(&run_compact_test);
+}
+
+}  // namespace unittest
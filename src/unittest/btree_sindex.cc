@@ -28,7 +28,7 @@ void run_sindex_low_level_operations_test() {
         &file_opener,
         &get_global_perfmon_collection());
 
-    cache_t cache(&serializer, alt_cache_config_t(),
+    cache_t cache(&serializer, alt_cache_config_t(), NULL,
                   &get_global_perfmon_collection());
     cache_conn_t cache_conn(&cache);
 
@@ -124,6 +124,7 @@ void run_sindex_btree_store_api_test() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -0,0 +1,61 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <set>
+#include <vector>
+
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/buffer_arena.hpp"
+
+namespace unittest {
+
+TEST(BufferArenaTest, AlignedAndDistinct) {
+    std::vector<ser_buffer_t *> bufs;
+    std::set<ser_buffer_t *> seen;
+    for (size_t size = 1; size <= 3 * 4096; size += 511) {
+        ser_buffer_t *buf = static_cast<ser_buffer_t *>(allocate_ser_buffer(size));
+        ASSERT_TRUE(buf != NULL);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buf) % DEVICE_BLOCK_SIZE);
+        ASSERT_TRUE(seen.insert(buf).second);
+        memset(buf, 0xAB, size);
+        bufs.push_back(buf);
+    }
+    for (auto it = bufs.begin(); it != bufs.end(); ++it) {
+        free_ser_buffer(*it);
+    }
+}
+
+TEST(BufferArenaTest, ReusesFreedBuffers) {
+    ser_buffer_t *buf = static_cast<ser_buffer_t *>(allocate_ser_buffer(4096));
+    free_ser_buffer(buf);
+    ser_buffer_t *again = static_cast<ser_buffer_t *>(allocate_ser_buffer(4096));
+    EXPECT_EQ(buf, again);
+    free_ser_buffer(again);
+}
+
+TEST(BufferArenaTest, ManyBuffers) {
+    // Enough buffers to need several chunks and to overflow the thread cache.
+    const size_t count = 3 * SER_BUFFER_ARENA_THREAD_CACHE_SIZE / 4096;
+    std::vector<scoped_malloc_t<ser_buffer_t> > bufs(count);
+    for (size_t i = 0; i < count; ++i) {
+        bufs[i].init(allocate_ser_buffer(4096));
+        memset(bufs[i].get(), static_cast<int>(i), 4096);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(static_cast<char>(i), reinterpret_cast<char *>(bufs[i].get())[4095]);
+    }
+    bufs.clear();
+}
+
+TEST(BufferArenaTest, FreesMallocedBuffers) {
+    // Oversized requests and plain malloced buffers go back to malloc.
+    scoped_malloc_t<ser_buffer_t> big(allocate_ser_buffer(SER_BUFFER_ARENA_MAX_BUFFER_SIZE
+                                                          + 1));
+    scoped_malloc_t<ser_buffer_t> plain(malloc(100));
+}
+
+}  // namespace unittest
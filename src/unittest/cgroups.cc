@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+
+#include "arch/runtime/cgroups.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(Cgroups, ParseProcCgroup) {
+    std::map<std::string, std::string> paths;
+    ASSERT_TRUE(parse_proc_cgroup(
+        "12:memory:/docker/abc\n"
+        "4:cpu,cpuacct:/docker/abc\n"
+        "1:name=systemd:/init.scope\n"
+        "0::/user.slice/a:b\n", &paths));
+    EXPECT_EQ("/docker/abc", paths["memory"]);
+    EXPECT_EQ("/docker/abc", paths["cpu"]);
+    EXPECT_EQ("/docker/abc", paths["cpuacct"]);
+    EXPECT_EQ("/init.scope", paths["name=systemd"]);
+    EXPECT_EQ("/user.slice/a:b", paths[""]);
+
+    ASSERT_TRUE(parse_proc_cgroup("", &paths));
+    EXPECT_TRUE(paths.empty());
+
+    EXPECT_FALSE(parse_proc_cgroup("0:/\n", &paths));
+}
+
+TEST(Cgroups, ParseCpuMax) {
+    double cpus;
+    ASSERT_TRUE(parse_cgroup_cpu_max("150000 100000\n", &cpus));
+    EXPECT_DOUBLE_EQ(1.5, cpus);
+
+    ASSERT_TRUE(parse_cgroup_cpu_max("max 100000\n", &cpus));
+    EXPECT_EQ(0, cpus);
+
+    EXPECT_FALSE(parse_cgroup_cpu_max("max", &cpus));
+    EXPECT_FALSE(parse_cgroup_cpu_max("100 0", &cpus));
+    EXPECT_FALSE(parse_cgroup_cpu_max("lots 100000", &cpus));
+}
+
+TEST(Cgroups, UsableCpuCount) {
+    EXPECT_GE(get_usable_cpu_count(), 1);
+}
+
+}  // namespace unittest
@@ -83,5 +83,71 @@ TEST(ClusteringNamespaceInterface, ReadOutdated) {
     unittest::run_in_thread_pool(&run_read_outdated_test);
 }
 
+static void run_read_bounded_staleness_test() {
+    test_cluster_group_t<dummy_protocol_t> cluster_group(2);
+
+    cluster_group.construct_all_reactors(cluster_group.compile_blueprint("p,s"));
+
+    cluster_group.wait_until_blueprint_is_satisfied("p,s");
+
+    scoped_ptr_t<cluster_namespace_interface_t<dummy_protocol_t> > namespace_if;
+    cluster_group.make_namespace_interface(0, &namespace_if);
+
+    /* The primary and the up to date secondary are never stale, so even a
+    bound of zero is satisfied, and reading again uses what the first read
+    learned about the replicas. */
+    dummy_protocol_t::read_t r;
+    r.keys.keys.insert("a");
+    cond_t non_interruptor;
+    for (int i = 0; i < 2; ++i) {
+        dummy_protocol_t::read_response_t rr;
+        namespace_if->read_bounded_staleness(r, &rr, 0, &non_interruptor);
+        EXPECT_EQ("", rr.values["a"]);
+    }
+}
+
+TEST(ClusteringNamespaceInterface, ReadBoundedStaleness) {
+    unittest::run_in_thread_pool(&run_read_bounded_staleness_test);
+}
+
+static void run_read_your_writes_test() {
+    test_cluster_group_t<dummy_protocol_t> cluster_group(2);
+
+    cluster_group.construct_all_reactors(cluster_group.compile_blueprint("p,s"));
+
+    cluster_group.wait_until_blueprint_is_satisfied("p,s");
+
+    scoped_ptr_t<cluster_namespace_interface_t<dummy_protocol_t> > namespace_if;
+    cluster_group.make_namespace_interface(0, &namespace_if);
+
+    order_source_t order_source;
+    cond_t non_interruptor;
+    region_map_t<dummy_protocol_t, version_t> versions(
+        dummy_protocol_t::region_t::universe(), version_t::zero());
+
+    /* Whichever replica the reads go to, they have to see the writes before
+    them. */
+    for (int i = 0; i < 3; ++i) {
+        std::string value = strprintf("%d", i);
+        dummy_protocol_t::write_t w;
+        dummy_protocol_t::write_response_t wr;
+        w.values["a"] = value;
+        namespace_if->write_with_versions(w, &wr, &versions,
+                                          order_source.check_in("unittest::run_read_your_writes_test"),
+                                          &non_interruptor);
+        EXPECT_NE(version_t::zero(), versions.mask(w.get_region()).begin()->second);
+
+        dummy_protocol_t::read_t r;
+        dummy_protocol_t::read_response_t rr;
+        r.keys.keys.insert("a");
+        namespace_if->read_your_writes(r, &rr, versions, &non_interruptor);
+        EXPECT_EQ(value, rr.values["a"]);
+    }
+}
+
+TEST(ClusteringNamespaceInterface, ReadYourWrites) {
+    unittest::run_in_thread_pool(&run_read_your_writes_test);
+}
+
 }   /* namespace unittest */
 
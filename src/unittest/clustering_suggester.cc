@@ -1,8 +1,10 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include "clustering/suggester/shard_suggester.hpp"
 #include "clustering/suggester/suggester.hpp"
 #include "clustering/generic/nonoverlapping_regions.hpp"
+#include "memcached/protocol.hpp"
 #include "mock/dummy_protocol.hpp"
 
 namespace unittest {
@@ -57,4 +59,44 @@ TEST(ClusteringSuggester, NewNamespace) {
     EXPECT_EQ(machines.size(), blueprint.machines_roles.size());
 }
 
+TEST(ClusteringSuggester, ShardChanges) {
+    /* Four shards split at "g", "n" and "t", where almost all of the load is in
+    the first one. */
+    shard_suggestion_t split_points;
+    split_points.split_points_to_add.insert(store_key_t("g"));
+    split_points.split_points_to_add.insert(store_key_t("n"));
+    split_points.split_points_to_add.insert(store_key_t("t"));
+    nonoverlapping_regions_t<memcached_protocol_t> shards;
+    bool success = shards.add_region(memcached_protocol_t::region_t::universe());
+    ASSERT_TRUE(success);
+    success = apply_shard_suggestion(split_points, &shards);
+    ASSERT_TRUE(success);
+    ASSERT_EQ(4u, shards.size());
+
+    std::map<store_key_t, int64_t> load;
+    load[store_key_t("a")] = 50;
+    load[store_key_t("d")] = 50;
+    load[store_key_t("h")] = 1;
+    load[store_key_t("o")] = 1;
+    load[store_key_t("u")] = 1;
+
+    /* The hot shard is split in the middle of its load, and the three cold
+    ones are merged. */
+    shard_suggestion_t suggestion = suggest_shard_changes(shards, load);
+    EXPECT_EQ(std::set<store_key_t>({ store_key_t("d") }),
+              suggestion.split_points_to_add);
+    EXPECT_EQ(std::set<store_key_t>({ store_key_t("n"), store_key_t("t") }),
+              suggestion.split_points_to_remove);
+
+    success = apply_shard_suggestion(suggestion, &shards);
+    ASSERT_TRUE(success);
+    EXPECT_EQ(3u, shards.size());
+    EXPECT_TRUE(shards.valid_for_sharding());
+
+    /* It doesn't apply twice. */
+    success = apply_shard_suggestion(suggestion, &shards);
+    EXPECT_FALSE(success);
+    EXPECT_EQ(3u, shards.size());
+}
+
 }  // namespace unittest
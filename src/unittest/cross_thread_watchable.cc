@@ -66,4 +66,49 @@ TEST(CrossThreadWatchable, CrossThreadWatchableTest) {
     unittest::run_in_thread_pool(&runCrossThreadWatchabletest, 2);
 }
 
+void count_change(int *count) { ++*count; }
+
+void runCoalescedCrossThreadWatchableTest() {
+    boost::scoped_ptr<watchable_variable_t<int> > watchable;
+    boost::scoped_ptr<cross_thread_watchable_variable_t<int> > ctw;
+    {
+        on_thread_t thread_switcher(threadnum_t(0));
+        watchable.reset(new watchable_variable_t<int>(0));
+        ctw.reset(new cross_thread_watchable_variable_t<int>(
+            watchable->get_watchable(), threadnum_t(1), 50));
+    }
+
+    int changes_seen = 0;
+    on_thread_t switcher_1(threadnum_t(1));
+    {
+        clone_ptr_t<watchable_t<int> > proxy = ctw->get_watchable();
+        watchable_t<int>::subscription_t subs(boost::bind(&count_change, &changes_seen));
+        {
+            watchable_t<int>::freeze_t freeze(proxy);
+            subs.reset(proxy, &freeze);
+        }
+        {
+            on_thread_t switcher_0(threadnum_t(0));
+            for (int i = 1; i <= 100; ++i) {
+                watchable->set_value(i);
+                coro_t::yield();
+            }
+        }
+        signal_timer_t timer;
+        timer.start(5000);
+        proxy->run_until_satisfied(boost::bind(&equals, 100, _1), &timer);
+    }
+    // The first change goes out right away and the rest of the burst should be
+    // folded into very few deliveries.
+    EXPECT_LE(changes_seen, 5);
+
+    on_thread_t switcher_0(threadnum_t(0));
+    ctw.reset();
+    watchable.reset();
+}
+
+TEST(CrossThreadWatchable, CoalescedCrossThreadWatchableTest) {
+    unittest::run_in_thread_pool(&runCoalescedCrossThreadWatchableTest, 2);
+}
+
 } //namespace unittest
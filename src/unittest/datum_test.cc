@@ -1,7 +1,12 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <unordered_set>
 
+#include "btree/keys.hpp"
 #include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_json.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/ql2.pb.h"
 #include "unittest/gtest.hpp"
 
 
@@ -62,6 +67,247 @@ TEST(DatumTest, NumericSerialization) {
     test_datum_serialization(make_counted<ql::datum_t>(std::move(vec)));
 }
 
+TEST(DatumTest, SecondaryNumericKeys) {
+    double nums[] = { -std::numeric_limits<double>::max(), -6.02214179e23, -2.5,
+                      -1.0, -std::numeric_limits<double>::min(), 0.0,
+                      std::numeric_limits<double>::denorm_min(), 0.5, 1.0, 1.1,
+                      256.0, (1ull << 53) + 2, std::numeric_limits<double>::max() };
+    const store_key_t primary("pkey");
 
+    std::string prev;
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+        std::vector<counted_t<const ql::datum_t> > compound;
+        compound.push_back(make_counted<const ql::datum_t>(nums[i]));
+        compound.push_back(make_counted<const ql::datum_t>(std::string("x")));
+        counted_t<const ql::datum_t> d
+            = make_counted<const ql::datum_t>(std::move(compound));
+
+        std::string key = ql::datum_t::extract_secondary(d->print_secondary(primary));
+        // "A", then "N" and eight bytes, then "Sx", each element terminated.
+        EXPECT_EQ(1 + 9 + 1 + 2 + 1u, key.size());
+        if (i > 0) {
+            EXPECT_LT(prev, key) << nums[i];
+        }
+        prev = key;
+    }
+}
+
+
+
+TEST(DatumTest, ObjectFields) {
+    scoped_cJSON_t json(cJSON_Parse("{\"c\": 3, \"a\": 1, \"b\": {\"y\": 2, \"x\": 1}}"));
+    ASSERT_TRUE(json.get() != NULL);
+    auto const datum = make_counted<const ql::datum_t>(json);
+
+    // Fields are kept in key order no matter what order they arrive in.
+    const ql::datum_object_t &obj = datum->as_object();
+    ASSERT_EQ(3u, obj.size());
+    auto it = obj.begin();
+    EXPECT_EQ("a", it->first);
+    EXPECT_EQ("b", (++it)->first);
+    EXPECT_EQ("c", (++it)->first);
+
+    EXPECT_EQ(3.0, datum->get("c")->as_num());
+    EXPECT_FALSE(datum->get("d", ql::NOTHROW).has());
+    EXPECT_EQ(2.0, datum->get("b")->get("y")->as_num());
+
+    test_datum_serialization(datum);
+}
+
+TEST(DatumTest, StringSizes) {
+    // Around the longest string that's kept in the datum's own allocation.
+    const size_t inline_size = ql::datum_t::MAX_INLINE_STR_SIZE;
+    const size_t sizes[] = { 0, 1, inline_size - 1, inline_size, inline_size + 1,
+                             1000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        const std::string str(sizes[i], 'a' + i);
+        auto const datum = make_counted<const ql::datum_t>(std::string(str));
+        ASSERT_EQ(str, datum->as_str().to_std());
+        if (str.size() <= inline_size) {
+            auto const inline_datum
+                = ql::datum_t::create_inline_str(str.data(), str.size());
+            ASSERT_EQ(str, inline_datum->as_str().to_std());
+            ASSERT_EQ(*datum, *inline_datum);
+        }
+        test_datum_serialization(datum);
+    }
+
+    // Deserialized objects share their keys, and still get them right.
+    scoped_cJSON_t json(cJSON_Parse("[{\"id\": 1, \"name\": \"x\"}, "
+                                    "{\"id\": 2, \"name\": \"y\"}]"));
+    ASSERT_TRUE(json.get() != NULL);
+    test_datum_serialization(make_counted<const ql::datum_t>(json));
+}
+
+TEST(DatumTest, ObjectDuplicateKeys) {
+    scoped_cJSON_t json(cJSON_Parse("{\"a\": 1, \"b\": 2, \"a\": 3}"));
+    ASSERT_TRUE(json.get() != NULL);
+    EXPECT_THROW(make_counted<const ql::datum_t>(json), ql::base_exc_t);
+}
+
+TEST(DatumTest, RowOffsetTable) {
+    std::map<std::string, counted_t<const ql::datum_t> > fields;
+    for (int i = 0; i < 20; ++i) {
+        fields[strprintf("field%02d", i)] = make_counted<const ql::datum_t>(
+            std::string(i * 10, 'x'));
+    }
+    auto const row = make_counted<const ql::datum_t>(std::move(fields));
+
+    string_stream_t write_stream;
+    write_message_t wm;
+    ql::serialize_row(&wm, row);
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    const std::string serialized = write_stream.str();
+
+    // The whole row reads back like a regular datum.
+    {
+        string_read_stream_t read_stream(std::string(serialized), 0);
+        counted_t<const ql::datum_t> deserialized;
+        ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &deserialized));
+        ASSERT_EQ(*row, *deserialized);
+    }
+
+    bool indexed;
+    std::vector<uint32_t> offsets;
+    int64_t fields_start;
+    {
+        string_read_stream_t read_stream(std::string(serialized), 0);
+        ASSERT_EQ(ARCHIVE_SUCCESS,
+                  ql::deserialize_row_offsets(&read_stream, &indexed, &offsets,
+                                              &fields_start));
+    }
+    ASSERT_TRUE(indexed);
+    ASSERT_EQ(20u, offsets.size());
+
+    // Each offset points at its field.
+    auto it = row->as_object().begin();
+    for (size_t i = 0; i < offsets.size(); ++i, ++it) {
+        string_read_stream_t read_stream(std::string(serialized),
+                                         fields_start + offsets[i]);
+        std::pair<std::string, counted_t<const ql::datum_t> > field;
+        ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &field));
+        EXPECT_EQ(it->first, field.first);
+        EXPECT_EQ(*it->second, *field.second);
+    }
+}
+
+TEST(DatumTest, PackedEncoding) {
+    scoped_cJSON_t json(cJSON_Parse("[null, true, {\"b\": \"xy\", \"a\": 0.5}]"));
+    ASSERT_TRUE(json.get() != NULL);
+    auto const datum = make_counted<const ql::datum_t>(json);
+
+    std::string packed;
+    datum->write_packed(&packed);
+    const char expected[] =
+        "\x05" "\x03\x00\x00\x00"
+        "\x00"
+        "\x02"
+        "\x06" "\x02\x00\x00\x00"
+        "\x01\x00\x00\x00" "a" "\x03" "\x00\x00\x00\x00\x00\x00\xe0\x3f"
+        "\x01\x00\x00\x00" "b" "\x04" "\x02\x00\x00\x00" "xy";
+    EXPECT_EQ(std::string(expected, sizeof(expected) - 1), packed);
+
+    Datum pb;
+    datum->write_to_protobuf(&pb, ql::use_json_t::PACKED);
+    EXPECT_EQ(Datum::R_PACKED, pb.type());
+    EXPECT_EQ(packed, pb.r_str());
+
+    // And it reads back.
+    EXPECT_EQ(*datum, ql::datum_t(&pb));
+    pb.mutable_r_str()->resize(packed.size() - 1);
+    EXPECT_THROW(ql::datum_t unused(&pb), ql::base_exc_t);
+}
+
+TEST(DatumTest, JsonMatchesCJSON) {
+    const char *docs[] = {
+        "null",
+        "  [true, false, -0, 1e300, 0.1, 123456789012345678]",
+        "{\"b\": {\"c\": []}, \"a\": \"q\\\"\\\\\\/\\b\\f\\n\\r\\t\\u0001\\x\"}",
+        "[\"\\u00e9\\u20ac\\ud83d\\ude00\\u0000\\udc00\"]",
+        "{\"a\": 1} trailing garbage",
+        "\"unterminated",
+        "0x10",
+    };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        scoped_cJSON_t json(cJSON_Parse(docs[i]));
+        ASSERT_TRUE(json.get() != NULL) << docs[i];
+        auto const expected = make_counted<const ql::datum_t>(json);
+        counted_t<const ql::datum_t> parsed = ql::parse_json(docs[i]);
+        ASSERT_TRUE(parsed.has()) << docs[i];
+        EXPECT_EQ(*expected, *parsed) << docs[i];
+
+        std::string written;
+        ql::write_json(*parsed, &written);
+        EXPECT_EQ(expected->as_json().PrintUnformatted(), written) << docs[i];
+    }
+
+    EXPECT_FALSE(ql::parse_json("").has());
+    EXPECT_FALSE(ql::parse_json("[1, 2").has());
+    EXPECT_FALSE(ql::parse_json("{\"a\" 1}").has());
+    EXPECT_THROW(ql::parse_json("{\"a\": 1, \"a\": 2}"), ql::base_exc_t);
+}
+
+TEST(DatumTest, HashAgreesWithEquality) {
+    // Pairs of equal data, which must hash the same.
+    std::vector<std::pair<counted_t<const ql::datum_t>,
+                          counted_t<const ql::datum_t> > > equal;
+    equal.push_back(std::make_pair(ql::parse_json("0"), ql::parse_json("-0")));
+    equal.push_back(std::make_pair(ql::parse_json("{\"b\": [1, \"x\"], \"a\": null}"),
+                                   ql::parse_json("{\"a\": null, \"b\": [1, \"x\"]}")));
+    // Times are equal if they're the same moment, whatever their time zones.
+    equal.push_back(std::make_pair(ql::pseudo::make_time(1000.5, "+00:00"),
+                                   ql::pseudo::make_time(1000.5, "-07:00")));
+    for (auto it = equal.begin(); it != equal.end(); ++it) {
+        ASSERT_TRUE(it->first.has() && it->second.has());
+        ASSERT_EQ(*it->first, *it->second);
+        EXPECT_EQ(it->first->hash(), it->second->hash());
+    }
+
+    std::unordered_set<counted_t<const ql::datum_t>,
+                       ql::datum_hash_t, ql::datum_equal_t> set;
+    const char *docs[] = { "1", "1.0", "\"1\"", "[1]", "{\"a\": 1}", "{\"a\": 1.0}",
+                           "null", "false", "[1, [2]]", "[1, 2]" };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        set.insert(ql::parse_json(docs[i]));
+    }
+    EXPECT_EQ(8u, set.size());
+    EXPECT_EQ(1u, set.count(ql::parse_json("[1,2]")));
+    EXPECT_EQ(0u, set.count(ql::parse_json("[2, 1]")));
+}
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+TEST(DatumTest, SortKeysCompareLikeCmp) {
+    const char *docs[] = {
+        "null", "true", "false", "0", "-0", "-1.5", "2", "1e300", "-1e300",
+        "\"\"", "\"a\"", "\"ab\"", "\"a\\u0000\"", "\"a\\u0001\"", "\"\\u00e9\"",
+        "[]", "[1]", "[1, 2]", "[[1], 2]", "[[1, 2]]", "[\"a\"]", "[\"a\", \"\"]",
+        "{}", "{\"a\": 1}", "{\"a\": 1, \"b\": 2}", "{\"ab\": 1}", "{\"b\": null}",
+        "{\"a\": [1]}",
+    };
+    std::vector<counted_t<const ql::datum_t> > data;
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        data.push_back(ql::parse_json(docs[i]));
+        ASSERT_TRUE(data.back().has()) << docs[i];
+    }
+    data.push_back(ql::pseudo::make_time(-5, "+00:00"));
+    data.push_back(ql::pseudo::make_time(1000.5, "+00:00"));
+    data.push_back(ql::pseudo::make_time(1000.5, "-07:00"));
+
+    std::vector<std::string> keys;
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        std::string key;
+        ASSERT_TRUE((*it)->append_sort_key(&key)) << (*it)->print();
+        keys.push_back(key);
+    }
+    for (size_t i = 0; i < data.size(); ++i) {
+        for (size_t j = 0; j < data.size(); ++j) {
+            EXPECT_EQ(sign(data[i]->cmp(*data[j])), sign(keys[i].compare(keys[j])))
+                << data[i]->print() << " vs " << data[j]->print();
+        }
+    }
+}
 
 }  // namespace unittest
@@ -0,0 +1,74 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "containers/archive/deflate_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
+
+namespace unittest {
+
+std::string make_test_message(int i) {
+    std::string message = strprintf("message %d:", i);
+    for (int j = 0; j < 100; ++j) {
+        message += strprintf(" field_%d", j % 10);
+    }
+    return message;
+}
+
+TEST(DeflateStreamTest, RoundTrip) {
+    vector_stream_t compressed;
+    deflate_write_stream_t deflater(&compressed);
+    std::vector<size_t> sizes_after_writes;
+    int64_t total_size = 0;
+    for (int i = 0; i < 10; ++i) {
+        std::string message = make_test_message(i);
+        ASSERT_EQ(static_cast<int64_t>(message.size()),
+                  deflater.write(message.data(), message.size()));
+        total_size += message.size();
+        sizes_after_writes.push_back(compressed.vector().size());
+    }
+    ASSERT_EQ(total_size, deflater.total_in());
+    ASSERT_EQ(static_cast<int64_t>(compressed.vector().size()), deflater.total_out());
+    ASSERT_LT(deflater.total_out(), total_size / 4);
+
+    // Every write is flushed, and the later messages compress better because the
+    // earlier ones look like them.
+    ASSERT_LT(sizes_after_writes[9] - sizes_after_writes[8], sizes_after_writes[0]);
+
+    std::vector<char> data;
+    compressed.swap(&data);
+    vector_read_stream_t read_stream(std::move(data));
+    inflate_read_stream_t inflater(&read_stream);
+    for (int i = 0; i < 10; ++i) {
+        std::string message = make_test_message(i);
+        std::string result(message.size(), '\0');
+        ASSERT_EQ(static_cast<int64_t>(message.size()),
+                  force_read(&inflater, &result[0], result.size()));
+        ASSERT_EQ(message, result);
+    }
+    char c;
+    ASSERT_EQ(0, inflater.read(&c, 1));
+}
+
+TEST(DeflateStreamTest, CorruptData) {
+    vector_stream_t compressed;
+    deflate_write_stream_t deflater(&compressed);
+    std::string message = make_test_message(0);
+    ASSERT_EQ(static_cast<int64_t>(message.size()),
+              deflater.write(message.data(), message.size()));
+
+    std::vector<char> data;
+    compressed.swap(&data);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] ^= 0x5a;
+    }
+    vector_read_stream_t read_stream(std::move(data));
+    inflate_read_stream_t inflater(&read_stream);
+    std::string result(message.size(), '\0');
+    ASSERT_EQ(-1, force_read(&inflater, &result[0], result.size()));
+    ASSERT_EQ(-1, inflater.read(&result[0], 1));
+}
+
+}  // namespace unittest
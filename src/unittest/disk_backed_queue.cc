@@ -74,6 +74,48 @@ TEST(DiskBackedQueue, BigVals) {
     unittest::run_in_thread_pool(&run_big_values_test, 2);
 }
 
+void run_interleaved_test() {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const serializer_filepath_t serializer_path = dbq_serializer_path();
+
+    disk_backed_queue_t<std::string> queue(&io_backender, serializer_path, &get_global_perfmon_collection());
+    std::queue<std::string> ref_queue;
+
+    // Enough to go past the memory tier, so that values are in memory, in the
+    // file, and waiting to be written when we pop.
+    int next = 0;
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 300; ++i, ++next) {
+            std::string val = strprintf("%d:", next);
+            val.resize(20 * KILOBYTE + randint(1000), 'a' + next % 26);
+            queue.push(val);
+            ref_queue.push(val);
+        }
+        for (int i = 0; i < 200; ++i) {
+            ASSERT_FALSE(queue.empty());
+            std::string x;
+            queue.pop(&x);
+            EXPECT_EQ(ref_queue.front(), x);
+            ref_queue.pop();
+        }
+        EXPECT_EQ(static_cast<int64_t>(ref_queue.size()), queue.size());
+    }
+
+    while (!ref_queue.empty()) {
+        ASSERT_FALSE(queue.empty());
+        std::string x;
+        queue.pop(&x);
+        EXPECT_EQ(ref_queue.front(), x);
+        ref_queue.pop();
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(DiskBackedQueue, Interleaved) {
+    unittest::run_in_thread_pool(&run_interleaved_test, 2);
+}
+
 static void randomly_delay(int, signal_t *) {
     nap(randint(100));
 }
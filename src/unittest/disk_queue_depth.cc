@@ -0,0 +1,50 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <algorithm>
+
+#include "arch/io/disk/queue_depth.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+// Simulates a device that runs up to `parallelism` requests at a time, each in
+// 100us, and queues the rest.  Returns the depth we end up at.
+int simulate_device(int parallelism, int windows) {
+    adaptive_queue_depth_t depth(4, 128);
+    ticks_t now = 0;
+    for (int w = 0; w < windows; ++w) {
+        const int d = depth.get();
+        const ticks_t latency
+            = 100 * THOUSAND * std::max(1.0, static_cast<double>(d) / parallelism);
+        for (int i = 0; i < DISK_QUEUE_DEPTH_WINDOW_SIZE; ++i) {
+            depth.note_limited();
+            now += latency / d;
+            depth.record(latency, now);
+        }
+    }
+    return depth.get();
+}
+
+TEST(DiskQueueDepth, FindsSaturationPoint) {
+    const int d = simulate_device(16, 2000);
+    EXPECT_GE(d, 16);
+    EXPECT_LE(d, 32);
+}
+
+TEST(DiskQueueDepth, GrowsWithoutSaturation) {
+    EXPECT_EQ(128, simulate_device(1000, 2000));
+}
+
+TEST(DiskQueueDepth, IgnoresUnloadedWindows) {
+    adaptive_queue_depth_t depth(4, 128);
+    const int initial = depth.get();
+    ticks_t now = 0;
+    for (int i = 0; i < 100 * DISK_QUEUE_DEPTH_WINDOW_SIZE; ++i) {
+        // Very slow, but we never had more requests to send.
+        now += 10 * MILLION;
+        depth.record(10 * MILLION, now);
+    }
+    EXPECT_EQ(initial, depth.get());
+}
+
+}  // namespace unittest
@@ -510,3 +510,68 @@ TEST(ExtProc, InterruptJobByPool) {
     extproc_spawner_t extproc_spawner;
     unittest::run_in_thread_pool(boost::bind(&run_interrupt_job_by_pool_test));
 }
+
+// Sends strings to the worker and reads them back, small ones go over the socket and
+// large ones through the shared memory.
+class echo_job_t {
+public:
+    echo_job_t(extproc_pool_t *pool, signal_t *interruptor) :
+        extproc_job(pool, &worker_fn, interruptor) { }
+
+    ~echo_job_t() {
+        write_message_t wm;
+        wm << std::string();
+        int res = send_write_message(extproc_job.write_stream(), &wm);
+        guarantee(res == 0);
+    }
+
+    std::string echo(const std::string &data) {
+        write_message_t wm;
+        wm << data;
+        int res = send_write_message(extproc_job.write_stream(), &wm);
+        guarantee(res == 0);
+
+        std::string result;
+        res = deserialize(extproc_job.read_stream(), &result);
+        guarantee(res == ARCHIVE_SUCCESS);
+        return result;
+    }
+
+private:
+    static bool worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
+        while (true) {
+            std::string data;
+            int res = deserialize(stream_in, &data);
+            guarantee(res == ARCHIVE_SUCCESS);
+            if (data.empty()) {
+                return true;
+            }
+
+            write_message_t wm;
+            wm << data;
+            res = send_write_message(stream_out, &wm);
+            guarantee(res == 0);
+        }
+    }
+
+    extproc_job_t extproc_job;
+};
+
+void run_large_message_test() {
+    extproc_pool_t pool(1);
+
+    // Enough messages that the rings wrap around, some larger than the rings
+    const size_t sizes[] = { 10, 100 * KILOBYTE, 3 * MEGABYTE, 5 * MEGABYTE };
+    for (size_t i = 0; i < 20; ++i) {
+        echo_job_t job(&pool, NULL);
+        for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j) {
+            std::string data(sizes[j], 'a' + (i + j) % 26);
+            ASSERT_EQ(data, job.echo(data));
+        }
+    }
+}
+
+TEST(ExtProc, LargeMessages) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_large_message_test));
+}
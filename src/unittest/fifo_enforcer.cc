@@ -112,6 +112,57 @@ TEST(FIFOEnforcer, DummyEntry) {
     unittest::run_in_thread_pool(&run_dummy_entry_destruction_test);
 }
 
+void run_write_range_test() {
+    fifo_enforcer_source_t source;
+    fifo_enforcer_sink_t sink;
+
+    fifo_enforcer_read_token_t read = source.enter_read();
+    fifo_enforcer_write_range_token_t range = source.enter_writes(3);
+    EXPECT_EQ(3, range.num_writes);
+    EXPECT_EQ(1, range.first.num_preceding_reads);
+    fifo_enforcer_write_token_t after = source.enter_write();
+    EXPECT_TRUE(range.last.timestamp_after() == after.timestamp.timestamp_before());
+
+    // Individual tokens make the same run.
+    fifo_enforcer_source_t other_source;
+    fifo_enforcer_write_range_token_t built(other_source.enter_write());
+    EXPECT_TRUE(built.extend(other_source.enter_write()));
+    other_source.enter_read();
+    EXPECT_FALSE(built.extend(other_source.enter_write()));
+    EXPECT_EQ(2, built.num_writes);
+
+    // The write after the range waits for the read and the whole range.
+    fifo_enforcer_sink_t::exit_write_t exit_after(&sink, after);
+    EXPECT_FALSE(exit_after.is_pulsed());
+    {
+        fifo_enforcer_sink_t::exit_write_range_t exit_range(&sink, range);
+        EXPECT_FALSE(exit_range.is_pulsed());
+        {
+            fifo_enforcer_sink_t::exit_read_t exit_read(&sink, read);
+            EXPECT_TRUE(exit_read.is_pulsed());
+        }
+        EXPECT_TRUE(exit_range.is_pulsed());
+        EXPECT_FALSE(exit_after.is_pulsed());
+    }
+    EXPECT_TRUE(exit_after.is_pulsed());
+
+    // A range that's abandoned before its turn still lets later writes through.
+    fifo_enforcer_write_range_token_t abandoned = source.enter_writes(5);
+    fifo_enforcer_write_token_t last = source.enter_write();
+    {
+        fifo_enforcer_sink_t::exit_write_range_t exit_range(&sink, abandoned);
+        EXPECT_FALSE(exit_range.is_pulsed());
+    }
+    fifo_enforcer_sink_t::exit_write_t exit_last(&sink, last);
+    EXPECT_FALSE(exit_last.is_pulsed());
+    exit_after.end();
+    EXPECT_TRUE(exit_last.is_pulsed());
+}
+
+TEST(FIFOEnforcer, WriteRange) {
+    unittest::run_in_thread_pool(&run_write_range_test);
+}
+
 void run_queue_equivalence_test() {
     fifo_enforcer_source_t source;
     fifo_enforcer_sink_t sink;
@@ -0,0 +1,65 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "buffer_cache/alt/flash_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/mock_file.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static const uint32_t FLASH_TEST_SLOT_SIZE = 2 * DEVICE_BLOCK_SIZE;
+
+scoped_malloc_t<ser_buffer_t> make_flash_test_buf(char fill) {
+    scoped_malloc_t<ser_buffer_t> buf(malloc_aligned(FLASH_TEST_SLOT_SIZE,
+                                                     DEVICE_BLOCK_SIZE));
+    memset(buf.get(), fill, FLASH_TEST_SLOT_SIZE);
+    return buf;
+}
+
+uint64_t write_and_wait(alt::flash_cache_t *cache, char fill) {
+    const uint64_t entry = cache->write(make_flash_test_buf(fill));
+    EXPECT_NE(alt::flash_cache_t::NO_ENTRY, entry);
+    EXPECT_FALSE(cache->contains(entry));
+    while (!cache->contains(entry)) {
+        coro_t::yield();
+    }
+    return entry;
+}
+
+void run_FlashCacheRing() {
+    std::vector<char> data;
+    alt_memory_tracker_t tracker;
+    alt::flash_cache_t cache(
+        scoped_ptr_t<file_t>(new mock_file_t(mock_file_t::mode_rw, &data)),
+        2 * FLASH_TEST_SLOT_SIZE + 1, FLASH_TEST_SLOT_SIZE, &tracker);
+    ASSERT_EQ(2 * FLASH_TEST_SLOT_SIZE, data.size());
+
+    const uint64_t a = write_and_wait(&cache, 'a');
+    const uint64_t b = write_and_wait(&cache, 'b');
+
+    scoped_malloc_t<ser_buffer_t> buf = make_flash_test_buf(0);
+    ASSERT_TRUE(cache.read(a, buf.get()));
+    EXPECT_EQ('a', reinterpret_cast<char *>(buf.get())[FLASH_TEST_SLOT_SIZE - 1]);
+    ASSERT_TRUE(cache.read(b, buf.get()));
+    EXPECT_EQ('b', reinterpret_cast<char *>(buf.get())[0]);
+
+    // The third write reuses the first one's slot.
+    const uint64_t c = write_and_wait(&cache, 'c');
+    EXPECT_FALSE(cache.contains(a));
+    EXPECT_FALSE(cache.read(a, buf.get()));
+    ASSERT_TRUE(cache.read(c, buf.get()));
+    EXPECT_EQ('c', reinterpret_cast<char *>(buf.get())[0]);
+
+    cache.invalidate(b);
+    EXPECT_FALSE(cache.read(b, buf.get()));
+    EXPECT_FALSE(cache.read(alt::flash_cache_t::NO_ENTRY, buf.get()));
+}
+
+TEST(FlashCacheTest, Ring) {
+    run_in_thread_pool(run_FlashCacheRing, 4);
+}
+
+}  // namespace unittest
@@ -0,0 +1,140 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <inttypes.h>
+
+#include <map>
+#include <string>
+
+#include "containers/flat_hash_map.hpp"
+#include "containers/flat_map.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// Does random inserts and erases on `map` and a `std::map`, checking that they
+// agree.
+template <class map_t>
+void check_against_std_map(map_t *map, int key_range, int steps) {
+    std::map<int, int> ref;
+    for (int i = 0; i < steps; ++i) {
+        const int key = randint(key_range);
+        if (randint(3) == 0) {
+            ASSERT_EQ(ref.erase(key), map->erase(key));
+        } else {
+            const bool inserted = map->insert(std::make_pair(key, i)).second;
+            ASSERT_EQ(ref.insert(std::make_pair(key, i)).second, inserted);
+        }
+        ASSERT_EQ(ref.size(), map->size());
+    }
+    for (int key = 0; key < key_range; ++key) {
+        auto it = map->find(key);
+        auto ref_it = ref.find(key);
+        if (ref_it == ref.end()) {
+            ASSERT_TRUE(it == map->end());
+        } else {
+            ASSERT_TRUE(it != map->end());
+            ASSERT_EQ(ref_it->second, it->second);
+        }
+    }
+    size_t iterated = 0;
+    for (auto it = map->begin(); it != map->end(); ++it) {
+        ASSERT_EQ(1u, ref.count(it->first));
+        ++iterated;
+    }
+    ASSERT_EQ(ref.size(), iterated);
+}
+
+TEST(FlatHashMapTest, AgreesWithStdMap) {
+    flat_hash_map_t<int, int> map;
+    check_against_std_map(&map, 1000, 100000);
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(map.begin() == map.end());
+    // A small key range gives long probe sequences that erases have to repair.
+    check_against_std_map(&map, 50, 10000);
+}
+
+TEST(FlatMapTest, AgreesWithStdMap) {
+    flat_map_t<int, int> map;
+    check_against_std_map(&map, 1000, 20000);
+    int last = -1;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        EXPECT_LT(last, it->first);
+        last = it->first;
+    }
+}
+
+TEST(FlatHashMapTest, SequentialIds) {
+    // Like mailbox ids, which count up from a different base on each thread.
+    flat_hash_map_t<uint64_t, uint64_t> map;
+    const uint64_t base = UINT64_MAX / 3;
+    for (uint64_t i = 0; i < 10000; ++i) {
+        ASSERT_TRUE(map.insert(std::make_pair(base + i, i)).second);
+    }
+    for (uint64_t i = 0; i < 10000; i += 2) {
+        ASSERT_EQ(1u, map.erase(base + i));
+    }
+    for (uint64_t i = 0; i < 10000; ++i) {
+        auto it = map.find(base + i);
+        if (i % 2 == 0) {
+            ASSERT_TRUE(it == map.end());
+        } else {
+            ASSERT_TRUE(it != map.end());
+            ASSERT_EQ(i, it->second);
+        }
+    }
+}
+
+TEST(FlatMapTest, MoveOnlyValues) {
+    flat_map_t<int, scoped_ptr_t<std::string> > map;
+    flat_hash_map_t<int, scoped_ptr_t<std::string> > hash_map;
+    for (int i = 10; i >= 0; --i) {
+        map.insert(std::make_pair(i, make_scoped<std::string>(strprintf("%d", i))));
+        hash_map.insert(std::make_pair(i, make_scoped<std::string>(strprintf("%d", i))));
+    }
+    EXPECT_EQ(1u, map.erase(5));
+    EXPECT_EQ(1u, hash_map.erase(5));
+    EXPECT_EQ("7", *map.find(7)->second);
+    EXPECT_EQ("7", *hash_map.find(7)->second);
+    EXPECT_EQ(10u, map.size());
+    EXPECT_EQ(10u, hash_map.size());
+}
+
+// Times lookups of sequential ids in the maps, as the mailbox table does them.
+// Run it with --gtest_also_run_disabled_tests.
+template <class map_t>
+microtime_t time_lookups(map_t *map, uint64_t num_keys, int rounds) {
+    for (uint64_t i = 0; i < num_keys; ++i) {
+        map->insert(std::make_pair(i * 7, i));
+    }
+    uint64_t sum = 0;
+    const microtime_t start = current_microtime();
+    for (int round = 0; round < rounds; ++round) {
+        for (uint64_t i = 0; i < num_keys; ++i) {
+            sum += map->find(((i * 7919) % num_keys) * 7)->second;
+        }
+    }
+    const microtime_t elapsed = current_microtime() - start;
+    EXPECT_EQ(rounds * (num_keys * (num_keys - 1) / 2), sum);
+    return elapsed;
+}
+
+TEST(FlatHashMapTest, DISABLED_LookupBenchmark) {
+    const uint64_t sizes[] = { 100, 10000, 1000000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        const int rounds = 10000000 / sizes[i];
+        std::map<uint64_t, uint64_t> std_map;
+        flat_map_t<uint64_t, uint64_t> flat_map;
+        flat_hash_map_t<uint64_t, uint64_t> flat_hash_map;
+        const microtime_t std_time = time_lookups(&std_map, sizes[i], rounds);
+        const microtime_t flat_time = time_lookups(&flat_map, sizes[i], rounds);
+        const microtime_t hash_time = time_lookups(&flat_hash_map, sizes[i], rounds);
+        printf("%" PRIu64 " keys, %d lookups: std::map %" PRIu64 " us, "
+               "flat_map_t %" PRIu64 " us, flat_hash_map_t %" PRIu64 " us\n",
+               sizes[i], static_cast<int>(rounds * sizes[i]),
+               std_time, flat_time, hash_time);
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,45 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rpc/connectivity/heartbeat.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(HeartbeatTest, PhiAccrualRegularTraffic) {
+    phi_accrual_detector_t detector;
+    // We know nothing about a peer we haven't heard from yet.
+    EXPECT_EQ(0, detector.phi(100000));
+
+    for (int i = 0; i < 50; ++i) {
+        detector.heard_after(2000);
+    }
+    EXPECT_LT(detector.phi(2000), 1);
+    EXPECT_LT(detector.phi(4000), 8);
+    EXPECT_GT(detector.phi(10000), 8);
+    EXPECT_LT(detector.phi(6000), detector.phi(8000));
+}
+
+TEST(HeartbeatTest, PhiAccrualIrregularTraffic) {
+    phi_accrual_detector_t regular, irregular;
+    for (int i = 0; i < 50; ++i) {
+        regular.heard_after(2000);
+        irregular.heard_after(i % 5 == 0 ? 10000 : 2000);
+    }
+    // A peer whose traffic has been coming in bursts gets more time.
+    EXPECT_GT(regular.phi(10000), 8);
+    EXPECT_LT(irregular.phi(10000), 8);
+    EXPECT_GT(irregular.phi(30000), 8);
+}
+
+TEST(HeartbeatTest, PhiAccrualForgetsOldIntervals) {
+    phi_accrual_detector_t detector;
+    for (int i = 0; i < 50; ++i) {
+        detector.heard_after(10000);
+    }
+    EXPECT_LT(detector.phi(10000), 8);
+    for (int i = 0; i < 200; ++i) {
+        detector.heard_after(2000);
+    }
+    EXPECT_GT(detector.phi(10000), 8);
+}
+
+}  // namespace unittest
@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/hot_key_cache.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> hot_key_value(double num) {
+    return make_counted<const ql::datum_t>(num);
+}
+
+void run_fill_and_invalidate_test() {
+    perfmon_collection_t collection;
+    hot_key_cache_t cache(MEGABYTE, &collection);
+    store_key_t key("hot"), other("other");
+    counted_t<const ql::datum_t> value;
+
+    EXPECT_FALSE(cache.lookup(key, &value));
+    cache.fill(key, hot_key_value(1), cache.fill_ticket());
+    ASSERT_TRUE(cache.lookup(key, &value));
+    EXPECT_EQ(1, value->as_num());
+
+    // A read that started before a write mustn't fill the cache after it.
+    hot_key_cache_t::fill_ticket_t stale_ticket = cache.fill_ticket();
+    cache.invalidate(other);
+    cache.fill(other, hot_key_value(2), stale_ticket);
+    EXPECT_FALSE(cache.lookup(other, &value));
+
+    cache.invalidate(key);
+    EXPECT_FALSE(cache.lookup(key, &value));
+
+    cache.fill(key, hot_key_value(3), cache.fill_ticket());
+    cache.invalidate_all();
+    EXPECT_FALSE(cache.lookup(key, &value));
+}
+
+TEST(HotKeyCache, FillAndInvalidate) {
+    run_in_thread_pool(&run_fill_and_invalidate_test);
+}
+
+void run_eviction_test() {
+    perfmon_collection_t collection;
+    // Room for a few entries only.
+    hot_key_cache_t cache(4 * sizeof(store_key_t), &collection);
+    for (int i = 0; i < 10; ++i) {
+        cache.fill(store_key_t(strprintf("key%d", i)), hot_key_value(i),
+                   cache.fill_ticket());
+    }
+
+    // The most recently filled key is still there, the first ones aren't.
+    counted_t<const ql::datum_t> value;
+    ASSERT_TRUE(cache.lookup(store_key_t("key9"), &value));
+    EXPECT_EQ(9, value->as_num());
+    EXPECT_FALSE(cache.lookup(store_key_t("key0"), &value));
+}
+
+TEST(HotKeyCache, Eviction) {
+    run_in_thread_pool(&run_eviction_test);
+}
+
+}  // namespace unittest
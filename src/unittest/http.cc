@@ -221,4 +221,59 @@ TEST(Http, InterruptRoutingApp) {
     run_in_thread_pool(boost::bind(&run_routing_app_test));
 }
 
+class keep_alive_http_app_t : public http_app_t {
+public:
+    void handle(const http_req_t &req, http_res_t *res, signal_t *) {
+        if (req.resource.as_string() == "/streamed") {
+            res->code = HTTP_OK;
+            res->set_body_writer("text/plain",
+                [](http_body_writer_t *writer, signal_t *) {
+                    writer->write("ab");
+                    writer->write("cd");
+                });
+        } else {
+            *res = http_res_t(HTTP_OK, "text/plain", "hello");
+        }
+    }
+};
+
+void run_keep_alive_test() {
+    keep_alive_http_app_t app;
+    ip_address_t loopback("127.0.0.1");
+    std::set<ip_address_t> ip_addresses;
+    ip_addresses.insert(loopback);
+    http_server_t server(ip_addresses, 0, &app);
+
+    cond_t non_interruptor;
+    tcp_conn_t http_conn(loopback, server.get_port(), &non_interruptor);
+
+    // Three pipelined requests on one connection, the last of which closes it.
+    const std::string requests =
+        "GET /plain HTTP/1.1\r\n\r\n"
+        "GET /streamed HTTP/1.1\r\n\r\n"
+        "GET /plain HTTP/1.1\r\nConnection: close\r\n\r\n";
+    http_conn.write(requests.data(), requests.size(), &non_interruptor);
+
+    const std::string expected =
+        "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\n"
+        "hello"
+        "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "2\r\nab\r\n2\r\ncd\r\n0\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n"
+        "Connection: close\r\n\r\n"
+        "hello";
+    signal_timer_t timeout;
+    timeout.start(5000);
+    std::string received(expected.size(), '\0');
+    http_conn.read(&received[0], received.size(), &timeout);
+    EXPECT_EQ(expected, received);
+
+    char dummy;
+    EXPECT_THROW(http_conn.read(&dummy, 1, &timeout), tcp_conn_read_closed_exc_t);
+}
+
+TEST(Http, KeepAlivePipeliningAndChunks) {
+    run_in_thread_pool(&run_keep_alive_test);
+}
+
 }
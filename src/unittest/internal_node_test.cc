@@ -6,6 +6,7 @@
 
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
+#include "containers/scoped.hpp"
 
 namespace unittest {
 
@@ -61,6 +62,57 @@ TEST(InternalNodeTest, Offsets) {
     EXPECT_EQ(9u, sizeof(btree_internal_pair));
 }
 
+TEST(InternalNodeTest, KeyCmpSkippingPrefix) {
+    const char *strs[] = { "", "a", "ab", "abcdefgh", "abcdefghi", "abcdefgi",
+                           "abcdefghijklmnopq", "abcdefghijklmnopr", "abcdefghijklmnop",
+                           "abcdefgh\xff", "abcdefgh\x01" };
+    const int num_strs = sizeof(strs) / sizeof(strs[0]);
+    for (int i = 0; i < num_strs; ++i) {
+        for (int j = 0; j < num_strs; ++j) {
+            store_key_t left(strs[i]);
+            store_key_t right(strs[j]);
+            int expected = btree_key_cmp(left.btree_key(), right.btree_key());
+            int common;
+            int res = btree_key_cmp_skipping_prefix(left.btree_key(), right.btree_key(),
+                                                    0, &common);
+            EXPECT_EQ(expected < 0, res < 0);
+            EXPECT_EQ(expected > 0, res > 0);
+            ASSERT_LE(common, std::min(left.size(), right.size()));
+            EXPECT_EQ(0, memcmp(left.contents(), right.contents(), common));
+            EXPECT_TRUE(common == std::min(left.size(), right.size())
+                        || left.contents()[common] != right.contents()[common]);
+
+            int res2 = btree_key_cmp_skipping_prefix(left.btree_key(), right.btree_key(),
+                                                     common, &common);
+            EXPECT_EQ(res < 0, res2 < 0);
+            EXPECT_EQ(res > 0, res2 > 0);
+        }
+    }
+}
+
+TEST(InternalNodeTest, SharedPrefixLookup) {
+    block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(block_size.value());
+    internal_node::init(block_size, node.get());
+
+    const std::string prefix(40, 'p');
+    const int num_keys = 40;
+    for (int i = 0; i < num_keys; ++i) {
+        store_key_t key(prefix + strprintf("%03d", 2 * i));
+        ASSERT_TRUE(internal_node::insert(block_size, node.get(), key.btree_key(),
+                                          i, i + 1));
+    }
+    verify(block_size, node.get());
+
+    for (int j = 0; j <= 2 * num_keys; ++j) {
+        store_key_t key(prefix + strprintf("%03d", j));
+        EXPECT_EQ(static_cast<block_id_t>((j + 1) / 2),
+                  internal_node::lookup(node.get(), key.btree_key()));
+    }
+    EXPECT_EQ(0u, internal_node::lookup(node.get(), store_key_t("pppo").btree_key()));
+    EXPECT_EQ(static_cast<block_id_t>(num_keys),
+              internal_node::lookup(node.get(), store_key_t("pppq").btree_key()));
+}
 
 }  // namespace unittest
 
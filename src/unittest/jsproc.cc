@@ -15,7 +15,7 @@ void run_eval_timeout_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     const std::string loop_source = "for (var x = 0; x < 4e10; x++) {}";
 
@@ -35,7 +35,7 @@ void run_call_timeout_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     const std::string loop_source = "(function () { for (var x = 0; x < 4e10; x++) {} })";
 
@@ -64,7 +64,7 @@ void run_datum_test(const std::string &source_code, counted_t<const ql::datum_t>
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     js_runner_t::req_config_t config;
     config.timeout_ms = 10000;
@@ -107,7 +107,7 @@ void run_eval_and_call_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     const std::string source_code = "(function () { return 10337; })";
 
@@ -144,7 +144,7 @@ void run_broken_function_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     const std::string source_code = "(function () { return 4 / 0; })";
 
@@ -177,7 +177,7 @@ void run_invalid_function_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     const std::string source_code = "(function() {)";
 
@@ -200,7 +200,7 @@ void run_infinite_recursion_function_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     const std::string source_code = "(function f(x) { x = x + f(x); return x; })";
 
@@ -232,7 +232,7 @@ void run_overalloc_function_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
 
-    js_runner.begin(&extproc_pool, NULL);
+    js_runner.begin(&extproc_pool, NULL, 0);
 
     const std::string source_code = "(function f() {"
                                      "  var res = \"\";"
@@ -270,7 +270,7 @@ void passthrough_test_internal(extproc_pool_t *pool, const counted_t<const ql::d
     guarantee(arg.has());
 
     js_runner_t js_runner;
-    js_runner.begin(pool, NULL);
+    js_runner.begin(pool, NULL, 0);
 
     const std::string source_code = "(function f(arg) { return arg; })";
 
@@ -0,0 +1,93 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "rdb_protocol/key_filter.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+store_key_t filter_key(int i) {
+    return store_key_t(strprintf("key%d", i));
+}
+
+void run_rebuild_test() {
+    perfmon_collection_t collection;
+    key_filter_t filter(10, NULL, &collection);
+
+    // Before the first rebuild, anything might be there.
+    EXPECT_TRUE(filter.may_contain(filter_key(0)));
+
+    filter.start_rebuild();
+    // A write between the rebuild's start and its sizing.
+    filter.add(filter_key(1000));
+    filter.size_rebuild(1000);
+    for (int i = 0; i < 1000; ++i) {
+        filter.add_rebuilt(filter_key(i).btree_key());
+    }
+    // The old filter is still in use until the rebuild is done.
+    EXPECT_TRUE(filter.may_contain(filter_key(5000)));
+    filter.finish_rebuild();
+
+    // No false negatives, including for keys added while rebuilding.
+    for (int i = 0; i <= 1000; ++i) {
+        ASSERT_TRUE(filter.may_contain(filter_key(i)));
+    }
+    filter.add(filter_key(1001));
+    EXPECT_TRUE(filter.may_contain(filter_key(1001)));
+
+    // With ten bits per key, about 1% of the missing keys get through.
+    int false_positives = 0;
+    for (int i = 2000; i < 12000; ++i) {
+        if (filter.may_contain(filter_key(i))) {
+            ++false_positives;
+        }
+    }
+    EXPECT_LT(false_positives, 300);
+    EXPECT_FALSE(filter.is_overfull());
+
+    // An abandoned rebuild leaves the old filter as it was.
+    filter.start_rebuild();
+    filter.size_rebuild(0);
+    filter.abandon_rebuild();
+    EXPECT_TRUE(filter.may_contain(filter_key(500)));
+}
+
+TEST(KeyFilter, Rebuild) {
+    run_in_thread_pool(&run_rebuild_test);
+}
+
+void run_overfull_test() {
+    perfmon_collection_t collection;
+    key_filter_t filter(10, NULL, &collection);
+    filter.start_rebuild();
+    filter.size_rebuild(0);
+    filter.finish_rebuild();
+
+    // The filter is sized for at least KEY_FILTER_MIN_KEYS keys.
+    for (int i = 0; i < 1000; ++i) {
+        filter.add(filter_key(i));
+    }
+    EXPECT_FALSE(filter.is_overfull());
+    for (int i = 1000; i < 2000; ++i) {
+        filter.add(filter_key(i));
+    }
+    EXPECT_TRUE(filter.is_overfull());
+}
+
+TEST(KeyFilter, Overfull) {
+    run_in_thread_pool(&run_overfull_test);
+}
+
+void run_disabled_test() {
+    perfmon_collection_t collection;
+    key_filter_t filter(0, NULL, &collection);
+    EXPECT_FALSE(filter.is_enabled());
+    filter.add(filter_key(0));
+    EXPECT_TRUE(filter.may_contain(filter_key(1)));
+}
+
+TEST(KeyFilter, Disabled) {
+    run_in_thread_pool(&run_disabled_test);
+}
+
+}  // namespace unittest
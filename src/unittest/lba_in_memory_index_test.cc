@@ -0,0 +1,106 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "serializer/log/lba/disk_format.hpp"
+#include "serializer/log/lba/in_memory_index.hpp"
+
+namespace unittest {
+
+repli_timestamp_t make_recency(uint64_t longtime) {
+    repli_timestamp_t ret;
+    ret.longtime = longtime;
+    return ret;
+}
+
+void set_index_info(in_memory_index_t *index, block_id_t id, const index_block_info_t &info) {
+    index->set_block_info(id, info.recency, info.offset, info.ser_block_size);
+}
+
+TEST(LBAInMemoryIndexTest, UnsetIsDefault) {
+    in_memory_index_t index;
+    ASSERT_EQ(0u, index.end_block_id());
+    ASSERT_TRUE(index.get_block_info(0) == index_block_info_t());
+    ASSERT_TRUE(index.get_block_info(123456789) == index_block_info_t());
+}
+
+TEST(LBAInMemoryIndexTest, CompactRoundTrip) {
+    in_memory_index_t index;
+    std::vector<index_block_info_t> infos;
+    for (block_id_t i = 0; i < 3 * in_memory_index_t::SEGMENT_SIZE; ++i) {
+        infos.push_back(index_block_info_t(flagged_off64_t::make(i * DEVICE_BLOCK_SIZE * 9),
+                                           make_recency(1000 + (i * 7) % 5000),
+                                           4096 - i % 100));
+        set_index_info(&index, i, infos.back());
+    }
+    ASSERT_EQ(infos.size(), index.end_block_id());
+    for (block_id_t i = 0; i < infos.size(); ++i) {
+        ASSERT_TRUE(index.get_block_info(i) == infos[i]);
+    }
+}
+
+TEST(LBAInMemoryIndexTest, CompressedFlagRoundTrip) {
+    in_memory_index_t index;
+    const index_block_info_t compressed(flagged_off64_t::make(DEVICE_BLOCK_SIZE * 3),
+                                        make_recency(5),
+                                        1234 | LBA_COMPRESSED_BLOCK_FLAG);
+    const index_block_info_t plain(flagged_off64_t::make(DEVICE_BLOCK_SIZE * 5),
+                                   make_recency(6), 4096);
+    set_index_info(&index, 0, compressed);
+    set_index_info(&index, 1, plain);
+    ASSERT_TRUE(index.get_block_info(0) == compressed);
+    ASSERT_TRUE(index.get_block_info(1) == plain);
+    ASSERT_TRUE(lba_block_is_compressed(index.get_block_info(0).ser_block_size));
+    ASSERT_EQ(1234u, lba_disk_block_size(index.get_block_info(0).ser_block_size).ser_value());
+}
+
+TEST(LBAInMemoryIndexTest, DeletedAndInvalidValues) {
+    in_memory_index_t index;
+    const index_block_info_t deleted(flagged_off64_t::unused(), make_recency(55), 0);
+    const index_block_info_t no_recency(flagged_off64_t::make(DEVICE_BLOCK_SIZE),
+                                        repli_timestamp_t::invalid, 17);
+    set_index_info(&index, 5, deleted);
+    set_index_info(&index, 6, no_recency);
+    ASSERT_TRUE(index.get_block_info(5) == deleted);
+    ASSERT_TRUE(index.get_block_info(6) == no_recency);
+    ASSERT_TRUE(index.get_block_info(7) == index_block_info_t());
+}
+
+TEST(LBAInMemoryIndexTest, WideFallback) {
+    in_memory_index_t index;
+    const index_block_info_t compact(flagged_off64_t::make(DEVICE_BLOCK_SIZE * 3),
+                                     make_recency(10), 4096);
+    // Neither an unaligned offset, nor a far-away recency, nor a huge block fit the
+    // compact representation.
+    const index_block_info_t unaligned(flagged_off64_t::make(DEVICE_BLOCK_SIZE + 1),
+                                       make_recency(11), 4096);
+    const index_block_info_t far_recency(flagged_off64_t::make(0),
+                                         make_recency(UINT64_MAX / 2), 4096);
+    const index_block_info_t huge(flagged_off64_t::make(DEVICE_BLOCK_SIZE * 8),
+                                  make_recency(12), 100 * MEGABYTE);
+    set_index_info(&index, 0, compact);
+    set_index_info(&index, 1, unaligned);
+    set_index_info(&index, in_memory_index_t::SEGMENT_SIZE, compact);
+    set_index_info(&index, in_memory_index_t::SEGMENT_SIZE + 1, far_recency);
+    set_index_info(&index, 2 * in_memory_index_t::SEGMENT_SIZE, compact);
+    set_index_info(&index, 2 * in_memory_index_t::SEGMENT_SIZE + 1, huge);
+
+    ASSERT_TRUE(index.get_block_info(0) == compact);
+    ASSERT_TRUE(index.get_block_info(1) == unaligned);
+    ASSERT_TRUE(index.get_block_info(in_memory_index_t::SEGMENT_SIZE) == compact);
+    ASSERT_TRUE(index.get_block_info(in_memory_index_t::SEGMENT_SIZE + 1) == far_recency);
+    ASSERT_TRUE(index.get_block_info(2 * in_memory_index_t::SEGMENT_SIZE) == compact);
+    ASSERT_TRUE(index.get_block_info(2 * in_memory_index_t::SEGMENT_SIZE + 1) == huge);
+}
+
+TEST(LBAInMemoryIndexTest, ClearingEntries) {
+    in_memory_index_t index;
+    const index_block_info_t info(flagged_off64_t::make(0), make_recency(1), 1);
+    set_index_info(&index, 3 * in_memory_index_t::SEGMENT_SIZE + 2, info);
+    set_index_info(&index, 3 * in_memory_index_t::SEGMENT_SIZE + 2, index_block_info_t());
+    ASSERT_TRUE(index.get_block_info(3 * in_memory_index_t::SEGMENT_SIZE + 2)
+                == index_block_info_t());
+    // end_block_id never shrinks.
+    ASSERT_EQ(3 * in_memory_index_t::SEGMENT_SIZE + 3, index.end_block_id());
+}
+
+}  // namespace unittest
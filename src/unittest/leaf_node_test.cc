@@ -615,4 +615,30 @@ TEST(LeafNodeTest, Fullness) {
     ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)));
 }
 
+TEST(LeafNodeTest, SharedPrefixFindKey) {
+    LeafNodeTracker tracker;
+    const std::string prefix(40, 'p');
+    const int num_keys = 40;
+    for (int i = 0; i < num_keys; ++i) {
+        ASSERT_TRUE(tracker.Insert(store_key_t(prefix + strprintf("%03d", 2 * i)), "v"));
+    }
+
+    for (int j = 0; j < 2 * num_keys + 1; ++j) {
+        store_key_t key(prefix + strprintf("%03d", j));
+        int index;
+        bool found = leaf::find_key(tracker.node(), key.btree_key(), &index);
+        ASSERT_EQ(j % 2 == 0 && j < 2 * num_keys, found);
+        ASSERT_EQ((j + 1) / 2, index);
+    }
+
+    // Keys that diverge inside the shared prefix, or are a prefix of it.
+    int index;
+    ASSERT_FALSE(leaf::find_key(tracker.node(), store_key_t("pppo").btree_key(), &index));
+    ASSERT_EQ(0, index);
+    ASSERT_FALSE(leaf::find_key(tracker.node(), store_key_t(prefix).btree_key(), &index));
+    ASSERT_EQ(0, index);
+    ASSERT_FALSE(leaf::find_key(tracker.node(), store_key_t("pppq").btree_key(), &index));
+    ASSERT_EQ(num_keys, index);
+}
+
 }  // namespace unittest
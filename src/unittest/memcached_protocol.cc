@@ -2,6 +2,8 @@
 #include "errors.hpp"
 #include <boost/make_shared.hpp>
 
+#include "containers/archive/string_stream.hpp"
+#include "memcached/parser.hpp"
 #include "memcached/protocol.hpp"
 #include "serializer/config.hpp"
 #include "serializer/translator.hpp"
@@ -35,7 +37,8 @@ void run_with_namespace_interface(boost::function<void(namespace_interface_t<mem
                             new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
                                                       &file_opener,
                                                       &get_global_perfmon_collection())),
-                        MERGER_SERIALIZER_MAX_ACTIVE_WRITES));
+                        MERGER_SERIALIZER_MAX_ACTIVE_WRITES,
+                        &get_global_perfmon_collection()));
 
 
     scoped_ptr_t<serializer_multiplexer_t> multiplexer;
@@ -50,7 +53,7 @@ void run_with_namespace_interface(boost::function<void(namespace_interface_t<mem
         underlying_stores.push_back(
                 new memcached_protocol_t::store_t(multiplexer->proxies[i],
                     temp_file.name().permanent_path() + strprintf("_%zd", i),
-                    GIGABYTE, true, &get_global_perfmon_collection(), NULL,
+                    GIGABYTE, NULL, true, &get_global_perfmon_collection(), NULL,
                     &io_backender, base_path_t(".")));
     }
 
@@ -146,5 +149,457 @@ TEST(MemcachedProtocol, GetSet) {
     run_in_thread_pool_with_namespace_interface(&run_get_set_test);
 }
 
+TEST(MemcachedProtocol, RgetResultSerialization) {
+    rget_result_t result;
+    const char *keys[] = { "apple", "applesauce", "apply", "b", "", "banana" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        counted_t<data_buffer_t> value = data_buffer_t::create(1);
+        value->buf()[0] = 'A' + i;
+        result.pairs.push_back(key_with_data_buffer_t(store_key_t(keys[i]), i, value));
+    }
+    result.truncated = true;
+
+    write_message_t msg;
+    msg << result;
+    string_stream_t write_stream;
+    ASSERT_EQ(0, send_write_message(&write_stream, &msg));
+
+    std::string serialized = write_stream.str();
+    string_read_stream_t read_stream(std::move(serialized), 0);
+    rget_result_t read;
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &read));
+    EXPECT_TRUE(read.truncated);
+    ASSERT_EQ(result.pairs.size(), read.pairs.size());
+    for (size_t i = 0; i < result.pairs.size(); ++i) {
+        EXPECT_EQ(std::string(keys[i]), key_to_unescaped_str(read.pairs[i].key));
+        EXPECT_EQ(i, read.pairs[i].mcflags);
+        ASSERT_EQ(1, read.pairs[i].value_provider->size());
+        EXPECT_EQ('A' + static_cast<int>(i), read.pairs[i].value_provider->buf()[0]);
+    }
+}
+
+/* A `memcached_interface_t` that reads the requests from a string and collects
+the responses in another. */
+class string_memcached_interface_t : public memcached_interface_t {
+public:
+    explicit string_memcached_interface_t(const std::string &input)
+        : input_(input), offset_(0) { }
+
+    void write(const char *buffer, size_t bytes, UNUSED signal_t *interruptor) {
+        output_.append(buffer, bytes);
+    }
+    void write_unbuffered(const char *buffer, size_t bytes, UNUSED signal_t *interruptor) {
+        output_.append(buffer, bytes);
+    }
+    void writev(const iovec *iov, size_t iovcnt, UNUSED signal_t *interruptor) {
+        for (size_t i = 0; i < iovcnt; ++i) {
+            output_.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+        }
+    }
+    void flush_buffer(UNUSED signal_t *interruptor) { }
+    bool is_write_open() { return true; }
+
+    void read(void *buf, size_t nbytes, UNUSED signal_t *interruptor) {
+        if (nbytes > input_.size() - offset_) {
+            offset_ = input_.size();
+            throw no_more_data_exc_t();
+        }
+        memcpy(buf, input_.data() + offset_, nbytes);
+        offset_ += nbytes;
+    }
+    void read_line(std::vector<char> *dest, UNUSED signal_t *interruptor) {
+        const size_t end = input_.find("\r\n", offset_);
+        if (end == std::string::npos) {
+            offset_ = input_.size();
+            throw no_more_data_exc_t();
+        }
+        dest->assign(input_.begin() + offset_, input_.begin() + end + 2);
+        offset_ = end + 2;
+    }
+    char peek_byte(UNUSED signal_t *interruptor) {
+        if (offset_ == input_.size()) {
+            throw no_more_data_exc_t();
+        }
+        return input_[offset_];
+    }
+
+    const std::string &output() const { return output_; }
+    // How much of the input the parser read.
+    size_t bytes_read() const { return offset_; }
+
+private:
+    std::string input_;
+    size_t offset_;
+    std::string output_;
+};
+
+// The binary protocol's opcodes and statuses, from the memcached protocol spec.
+enum binary_test_opcode_t {
+    BIN_GET = 0x00, BIN_SET = 0x01, BIN_ADD = 0x02, BIN_REPLACE = 0x03,
+    BIN_DELETE = 0x04, BIN_INCREMENT = 0x05, BIN_DECREMENT = 0x06, BIN_QUIT = 0x07,
+    BIN_GETQ = 0x09, BIN_NOOP = 0x0a, BIN_VERSION = 0x0b, BIN_GETK = 0x0c,
+    BIN_GETKQ = 0x0d, BIN_APPEND = 0x0e, BIN_PREPEND = 0x0f, BIN_SETQ = 0x11,
+    BIN_ADDQ = 0x12, BIN_DELETEQ = 0x14, BIN_INCREMENTQ = 0x15
+};
+
+enum binary_test_status_t {
+    BIN_OK = 0x0000, BIN_KEY_NOT_FOUND = 0x0001, BIN_KEY_EXISTS = 0x0002,
+    BIN_VALUE_TOO_LARGE = 0x0003, BIN_INVALID_ARGUMENTS = 0x0004,
+    BIN_ITEM_NOT_STORED = 0x0005, BIN_NON_NUMERIC = 0x0006,
+    BIN_UNKNOWN_COMMAND = 0x0081
+};
+
+void append_big_endian(uint64_t value, size_t size, std::string *out) {
+    for (size_t i = size; i > 0; --i) {
+        out->push_back(static_cast<char>((value >> (8 * (i - 1))) & 0xff));
+    }
+}
+
+uint64_t read_big_endian(const std::string &data, size_t offset, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(data[offset + i]);
+    }
+    return value;
+}
+
+// The header of a request whose body is `body_size` bytes, of which the key and
+// the extras are the first `key_size + extras_size`.
+std::string binary_header(uint8_t opcode, size_t key_size, size_t extras_size,
+                          size_t body_size, uint32_t opaque, uint64_t cas = 0) {
+    std::string header;
+    header.push_back(static_cast<char>(0x80));
+    header.push_back(static_cast<char>(opcode));
+    append_big_endian(key_size, 2, &header);
+    append_big_endian(extras_size, 1, &header);
+    append_big_endian(0, 1, &header);   // Data type
+    append_big_endian(0, 2, &header);   // Reserved
+    append_big_endian(body_size, 4, &header);
+    append_big_endian(opaque, 4, &header);
+    append_big_endian(cas, 8, &header);
+    return header;
+}
+
+std::string binary_request(uint8_t opcode, uint32_t opaque,
+                           const std::string &key = "",
+                           const std::string &extras = "",
+                           const std::string &value = "",
+                           uint64_t cas = 0) {
+    return binary_header(opcode, key.size(), extras.size(),
+                         extras.size() + key.size() + value.size(), opaque, cas)
+        + extras + key + value;
+}
+
+// The extras of a set, add or replace.
+std::string storage_extras(uint32_t flags) {
+    std::string extras;
+    append_big_endian(flags, 4, &extras);
+    append_big_endian(0, 4, &extras);   // Expiration time
+    return extras;
+}
+
+// The extras of an increment or decrement.
+std::string incr_decr_extras(uint64_t delta) {
+    std::string extras;
+    append_big_endian(delta, 8, &extras);
+    append_big_endian(0, 8, &extras);   // Initial value
+    append_big_endian(0, 4, &extras);   // Expiration time
+    return extras;
+}
+
+struct binary_test_response_t {
+    uint8_t opcode;
+    uint16_t status;
+    uint32_t opaque;
+    std::string extras;
+    std::string key;
+    std::string value;
+};
+
+// Runs a connection that sends `input` and then closes, and returns the responses.
+std::vector<binary_test_response_t> run_binary_connection(
+        namespace_interface_t<memcached_protocol_t> *nsi,
+        const std::string &input,
+        size_t *bytes_read_out = NULL) {
+    string_memcached_interface_t interface(input);
+    perfmon_collection_t stats_collection;
+    memcached_stats_t stats(&stats_collection);
+    cond_t interruptor;
+    handle_memcache(&interface, nsi, 16, &stats, &interruptor);
+    if (bytes_read_out != NULL) {
+        *bytes_read_out = interface.bytes_read();
+    }
+
+    std::vector<binary_test_response_t> responses;
+    const std::string &output = interface.output();
+    size_t offset = 0;
+    while (offset < output.size()) {
+        EXPECT_LE(offset + 24, output.size());
+        if (offset + 24 > output.size()) {
+            break;
+        }
+        EXPECT_EQ(0x81, static_cast<uint8_t>(output[offset]));
+        binary_test_response_t response;
+        response.opcode = output[offset + 1];
+        const size_t key_size = read_big_endian(output, offset + 2, 2);
+        const size_t extras_size = read_big_endian(output, offset + 4, 1);
+        response.status = read_big_endian(output, offset + 6, 2);
+        const size_t body_size = read_big_endian(output, offset + 8, 4);
+        response.opaque = read_big_endian(output, offset + 12, 4);
+        EXPECT_LE(offset + 24 + body_size, output.size());
+        if (offset + 24 + body_size > output.size()) {
+            break;
+        }
+        response.extras = output.substr(offset + 24, extras_size);
+        response.key = output.substr(offset + 24 + extras_size, key_size);
+        response.value = output.substr(offset + 24 + extras_size + key_size,
+                                       body_size - extras_size - key_size);
+        responses.push_back(response);
+        offset += 24 + body_size;
+    }
+    return responses;
+}
+
+void expect_binary_response(const binary_test_response_t &response, uint8_t opcode,
+                            uint16_t status, uint32_t opaque) {
+    EXPECT_EQ(opcode, response.opcode);
+    EXPECT_EQ(status, response.status);
+    EXPECT_EQ(opaque, response.opaque);
+}
+
+/* `BinaryOpcodes` runs each of the binary protocol's commands. */
+void run_binary_opcodes_test(namespace_interface_t<memcached_protocol_t> *nsi,
+                             UNUSED order_source_t *order_source) {
+    std::string input;
+    input += binary_request(BIN_SET, 1, "a", storage_extras(7), "1");
+    input += binary_request(BIN_GET, 2, "a");
+    input += binary_request(BIN_GETK, 3, "a");
+    input += binary_request(BIN_APPEND, 4, "a", "", "0");
+    input += binary_request(BIN_PREPEND, 5, "a", "", "2");
+    input += binary_request(BIN_INCREMENT, 6, "a", incr_decr_extras(5));
+    input += binary_request(BIN_DECREMENT, 7, "a", incr_decr_extras(15));
+    input += binary_request(BIN_GET, 8, "a");
+    input += binary_request(BIN_DELETE, 9, "a");
+    input += binary_request(BIN_GET, 10, "a");
+    input += binary_request(BIN_VERSION, 11);
+    input += binary_request(BIN_NOOP, 12);
+    input += binary_request(BIN_QUIT, 13);
+    // The connection is closed after the quit.
+    input += binary_request(BIN_NOOP, 14);
+
+    std::vector<binary_test_response_t> responses = run_binary_connection(nsi, input);
+    ASSERT_EQ(13u, responses.size());
+
+    expect_binary_response(responses[0], BIN_SET, BIN_OK, 1);
+    expect_binary_response(responses[1], BIN_GET, BIN_OK, 2);
+    EXPECT_EQ(7u, read_big_endian(responses[1].extras, 0, 4));
+    EXPECT_EQ("", responses[1].key);
+    EXPECT_EQ("1", responses[1].value);
+    expect_binary_response(responses[2], BIN_GETK, BIN_OK, 3);
+    EXPECT_EQ("a", responses[2].key);
+    EXPECT_EQ("1", responses[2].value);
+    expect_binary_response(responses[3], BIN_APPEND, BIN_OK, 4);
+    expect_binary_response(responses[4], BIN_PREPEND, BIN_OK, 5);
+    expect_binary_response(responses[5], BIN_INCREMENT, BIN_OK, 6);
+    ASSERT_EQ(8u, responses[5].value.size());
+    EXPECT_EQ(215u, read_big_endian(responses[5].value, 0, 8));
+    expect_binary_response(responses[6], BIN_DECREMENT, BIN_OK, 7);
+    ASSERT_EQ(8u, responses[6].value.size());
+    EXPECT_EQ(200u, read_big_endian(responses[6].value, 0, 8));
+    expect_binary_response(responses[7], BIN_GET, BIN_OK, 8);
+    EXPECT_EQ("200", responses[7].value);
+    expect_binary_response(responses[8], BIN_DELETE, BIN_OK, 9);
+    expect_binary_response(responses[9], BIN_GET, BIN_KEY_NOT_FOUND, 10);
+    expect_binary_response(responses[10], BIN_VERSION, BIN_OK, 11);
+    EXPECT_EQ(0u, responses[10].value.find("rethinkdb-"));
+    expect_binary_response(responses[11], BIN_NOOP, BIN_OK, 12);
+    expect_binary_response(responses[12], BIN_QUIT, BIN_OK, 13);
+}
+TEST(MemcachedProtocol, BinaryOpcodes) {
+    run_in_thread_pool_with_namespace_interface(&run_binary_opcodes_test);
+}
+
+/* `BinaryStatuses` checks the statuses that failed storage commands get. */
+void run_binary_statuses_test(namespace_interface_t<memcached_protocol_t> *nsi,
+                              UNUSED order_source_t *order_source) {
+    std::string input;
+    input += binary_request(BIN_ADD, 1, "b", storage_extras(0), "x");
+    input += binary_request(BIN_ADD, 2, "b", storage_extras(0), "y");
+    input += binary_request(BIN_REPLACE, 3, "c", storage_extras(0), "z");
+    input += binary_request(BIN_REPLACE, 4, "b", storage_extras(0), "w");
+    // A set with a CAS that doesn't match, and one of a missing key.
+    input += binary_request(BIN_SET, 5, "b", storage_extras(0), "v", 12345);
+    input += binary_request(BIN_SET, 6, "d", storage_extras(0), "v", 12345);
+    input += binary_request(BIN_APPEND, 7, "e", "", "v");
+    input += binary_request(BIN_INCREMENT, 8, "b", incr_decr_extras(1));
+    input += binary_request(BIN_INCREMENT, 9, "f", incr_decr_extras(1));
+    input += binary_request(BIN_DELETE, 10, "g");
+    input += binary_request(BIN_GET, 11, "b");
+
+    std::vector<binary_test_response_t> responses = run_binary_connection(nsi, input);
+    ASSERT_EQ(11u, responses.size());
+
+    expect_binary_response(responses[0], BIN_ADD, BIN_OK, 1);
+    expect_binary_response(responses[1], BIN_ADD, BIN_KEY_EXISTS, 2);
+    expect_binary_response(responses[2], BIN_REPLACE, BIN_KEY_NOT_FOUND, 3);
+    expect_binary_response(responses[3], BIN_REPLACE, BIN_OK, 4);
+    expect_binary_response(responses[4], BIN_SET, BIN_KEY_EXISTS, 5);
+    expect_binary_response(responses[5], BIN_SET, BIN_KEY_NOT_FOUND, 6);
+    expect_binary_response(responses[6], BIN_APPEND, BIN_ITEM_NOT_STORED, 7);
+    expect_binary_response(responses[7], BIN_INCREMENT, BIN_NON_NUMERIC, 8);
+    expect_binary_response(responses[8], BIN_INCREMENT, BIN_KEY_NOT_FOUND, 9);
+    expect_binary_response(responses[9], BIN_DELETE, BIN_KEY_NOT_FOUND, 10);
+    // Neither of the failed sets changed the value.
+    expect_binary_response(responses[10], BIN_GET, BIN_OK, 11);
+    EXPECT_EQ("w", responses[10].value);
+}
+TEST(MemcachedProtocol, BinaryStatuses) {
+    run_in_thread_pool_with_namespace_interface(&run_binary_statuses_test);
+}
+
+/* `BinaryQuiet` checks that the quiet commands are only answered when they fail,
+except for gets, which are only answered when they hit. */
+void run_binary_quiet_test(namespace_interface_t<memcached_protocol_t> *nsi,
+                           UNUSED order_source_t *order_source) {
+    std::string input;
+    input += binary_request(BIN_SETQ, 1, "q", storage_extras(0), "5");
+    input += binary_request(BIN_GETQ, 2, "missing");
+    input += binary_request(BIN_GETKQ, 3, "q");
+    input += binary_request(BIN_ADDQ, 4, "q", storage_extras(0), "6");
+    input += binary_request(BIN_INCREMENTQ, 5, "q", incr_decr_extras(1));
+    input += binary_request(BIN_GETQ, 6, "q");
+    input += binary_request(BIN_DELETEQ, 7, "q");
+    input += binary_request(BIN_DELETEQ, 8, "q");
+    input += binary_request(BIN_GETQ, 9, "q");
+    input += binary_request(BIN_NOOP, 10);
+
+    std::vector<binary_test_response_t> responses = run_binary_connection(nsi, input);
+    ASSERT_EQ(5u, responses.size());
+
+    expect_binary_response(responses[0], BIN_GETKQ, BIN_OK, 3);
+    EXPECT_EQ("q", responses[0].key);
+    EXPECT_EQ("5", responses[0].value);
+    expect_binary_response(responses[1], BIN_ADDQ, BIN_KEY_EXISTS, 4);
+    expect_binary_response(responses[2], BIN_GETQ, BIN_OK, 6);
+    EXPECT_EQ("6", responses[2].value);
+    expect_binary_response(responses[3], BIN_DELETEQ, BIN_KEY_NOT_FOUND, 8);
+    expect_binary_response(responses[4], BIN_NOOP, BIN_OK, 10);
+}
+TEST(MemcachedProtocol, BinaryQuiet) {
+    run_in_thread_pool_with_namespace_interface(&run_binary_quiet_test);
+}
+
+/* `BinaryMalformed` checks that requests whose headers don't fit their opcodes
+are answered with an error before their bodies are read, after which the
+connection is closed, and that a connection with a bad header or a cut off body
+is just closed. */
+void run_binary_malformed_test(namespace_interface_t<memcached_protocol_t> *nsi,
+                               UNUSED order_source_t *order_source) {
+    const std::string noop = binary_request(BIN_NOOP, 99);
+    size_t bytes_read;
+
+    {
+        // An unknown opcode.
+        std::vector<binary_test_response_t> responses = run_binary_connection(
+            nsi, binary_request(0x30, 1, "", "", "body") + noop, &bytes_read);
+        ASSERT_EQ(1u, responses.size());
+        expect_binary_response(responses[0], 0x30, BIN_UNKNOWN_COMMAND, 1);
+        EXPECT_EQ(24u, bytes_read);
+    }
+    {
+        // A set with the wrong extras.
+        std::vector<binary_test_response_t> responses = run_binary_connection(
+            nsi, binary_request(BIN_SET, 2, "k", "1234", "v") + noop, &bytes_read);
+        ASSERT_EQ(1u, responses.size());
+        expect_binary_response(responses[0], BIN_SET, BIN_INVALID_ARGUMENTS, 2);
+        EXPECT_EQ(24u, bytes_read);
+    }
+    {
+        // A get without a key, a get with a key that's too long and a noop with a
+        // value, with a good request before each.
+        const std::string bad[] = {
+            binary_request(BIN_GET, 3),
+            binary_request(BIN_GET, 3, std::string(MAX_KEY_SIZE + 1, 'k')),
+            binary_request(BIN_NOOP, 3, "", "", "v")
+        };
+        for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+            std::vector<binary_test_response_t> responses
+                = run_binary_connection(nsi, noop + bad[i] + noop, &bytes_read);
+            ASSERT_EQ(2u, responses.size());
+            expect_binary_response(responses[0], BIN_NOOP, BIN_OK, 99);
+            EXPECT_EQ(BIN_INVALID_ARGUMENTS, responses[1].status);
+            EXPECT_EQ(3u, responses[1].opaque);
+            EXPECT_EQ(48u, bytes_read);
+        }
+    }
+    {
+        // A value larger than we store, whose body never comes.  It isn't read or
+        // allocated.
+        const size_t body_size = 8 + 1 + MAX_VALUE_SIZE + 1;
+        std::vector<binary_test_response_t> responses = run_binary_connection(
+            nsi, binary_header(BIN_SET, 1, 8, body_size, 4), &bytes_read);
+        ASSERT_EQ(1u, responses.size());
+        expect_binary_response(responses[0], BIN_SET, BIN_VALUE_TOO_LARGE, 4);
+        EXPECT_EQ(24u, bytes_read);
+    }
+    {
+        // A header without the request magic byte, after a good request.
+        std::string bad = binary_request(BIN_NOOP, 5);
+        bad[0] = static_cast<char>(0x81);
+        std::vector<binary_test_response_t> responses
+            = run_binary_connection(nsi, noop + bad + noop);
+        ASSERT_EQ(1u, responses.size());
+        expect_binary_response(responses[0], BIN_NOOP, BIN_OK, 99);
+    }
+    {
+        // A body that's cut off.
+        std::string cut = binary_request(BIN_SET, 6, "k", storage_extras(0), "value");
+        cut.resize(cut.size() - 1);
+        std::vector<binary_test_response_t> responses
+            = run_binary_connection(nsi, noop + cut);
+        ASSERT_EQ(1u, responses.size());
+        expect_binary_response(responses[0], BIN_NOOP, BIN_OK, 99);
+    }
+}
+TEST(MemcachedProtocol, BinaryMalformed) {
+    run_in_thread_pool_with_namespace_interface(&run_binary_malformed_test);
+}
+
+/* `BinaryPipelining` sends many requests at once and checks that they're answered
+in order, including a run of quiet gets that are looked up together. */
+void run_binary_pipelining_test(namespace_interface_t<memcached_protocol_t> *nsi,
+                                UNUSED order_source_t *order_source) {
+    const int num_keys = 100;
+    std::string input;
+    for (int i = 0; i < num_keys; ++i) {
+        input += binary_request(BIN_SET, i, strprintf("key%d", i), storage_extras(i),
+                                strprintf("value%d", i));
+    }
+    for (int i = 0; i < num_keys; ++i) {
+        input += binary_request(BIN_GETKQ, num_keys + i, strprintf("key%d", i));
+        // None of the other keys are there.
+        input += binary_request(BIN_GETKQ, 2 * num_keys + i, strprintf("other%d", i));
+    }
+    input += binary_request(BIN_NOOP, 3 * num_keys);
+
+    std::vector<binary_test_response_t> responses = run_binary_connection(nsi, input);
+    ASSERT_EQ(static_cast<size_t>(2 * num_keys + 1), responses.size());
+    for (int i = 0; i < num_keys; ++i) {
+        expect_binary_response(responses[i], BIN_SET, BIN_OK, i);
+    }
+    for (int i = 0; i < num_keys; ++i) {
+        const binary_test_response_t &response = responses[num_keys + i];
+        expect_binary_response(response, BIN_GETKQ, BIN_OK, num_keys + i);
+        EXPECT_EQ(strprintf("key%d", i), response.key);
+        EXPECT_EQ(strprintf("value%d", i), response.value);
+        EXPECT_EQ(static_cast<uint64_t>(i), read_big_endian(response.extras, 0, 4));
+    }
+    expect_binary_response(responses[2 * num_keys], BIN_NOOP, BIN_OK, 3 * num_keys);
+}
+TEST(MemcachedProtocol, BinaryPipelining) {
+    run_in_thread_pool_with_namespace_interface(&run_binary_pipelining_test);
+}
+
+
 }   /* namespace unittest */
 
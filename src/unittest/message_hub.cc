@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/pmap.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const int messages_per_sender = 10000;
+
+class ordering_checker_t;
+
+class numbered_message_t : public thread_message_t {
+public:
+    numbered_message_t() : checker(NULL), sender(0), seq(0) { }
+    void on_thread_switch();
+    ordering_checker_t *checker;
+    int sender;
+    int seq;
+};
+
+// Lives on thread 0 and checks the messages sent to it.
+class ordering_checker_t {
+public:
+    explicit ordering_checker_t(int num_senders)
+        : next_seq(num_senders, 0), remaining(num_senders * messages_per_sender) { }
+    void receive(const numbered_message_t *m) {
+        EXPECT_EQ(0, get_thread_id().threadnum);
+        EXPECT_EQ(next_seq[m->sender], m->seq);
+        next_seq[m->sender] = m->seq + 1;
+        if (--remaining == 0) {
+            done.pulse();
+        }
+    }
+    std::vector<int> next_seq;
+    int remaining;
+    cond_t done;
+};
+
+void numbered_message_t::on_thread_switch() {
+    checker->receive(this);
+}
+
+void send_numbered_messages(ordering_checker_t *checker,
+                            scoped_array_t<scoped_array_t<numbered_message_t> > *messages,
+                            int sender) {
+    on_thread_t th(threadnum_t(sender + 1));
+    for (int i = 0; i < messages_per_sender; ++i) {
+        numbered_message_t *m = &(*messages)[sender][i];
+        m->checker = checker;
+        m->sender = sender;
+        m->seq = i;
+        UNUSED bool res = continue_on_thread(threadnum_t(0), m);
+        if (i % 100 == 0) {
+            // Let the messages go out in several batches.
+            coro_t::yield();
+        }
+    }
+}
+
+void run_ordered_from_many_threads_test() {
+    const int num_senders = get_num_threads() - 1;
+    ordering_checker_t checker(num_senders);
+    scoped_array_t<scoped_array_t<numbered_message_t> > messages(num_senders);
+    for (int i = 0; i < num_senders; ++i) {
+        messages[i].init(messages_per_sender);
+    }
+    pmap(num_senders, std::bind(&send_numbered_messages, &checker, &messages,
+                                std::placeholders::_1));
+    checker.done.wait();
+}
+
+TEST(MessageHub, OrderedFromManyThreads) {
+    run_in_thread_pool(&run_ordered_from_many_threads_test, 4);
+}
+
+}  // namespace unittest
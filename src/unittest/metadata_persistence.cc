@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "clustering/administration/persist.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void run_cluster_metadata_round_trip_test() {
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const machine_id_t machine_id = generate_uuid();
+    const database_id_t kept_database = generate_uuid();
+    const database_id_t deleted_database = generate_uuid();
+
+    cluster_semilattice_metadata_t initial;
+    initial.databases.databases[kept_database]
+        = deletable_t<database_semilattice_metadata_t>(database_semilattice_metadata_t());
+    initial.databases.databases[deleted_database]
+        = deletable_t<database_semilattice_metadata_t>(database_semilattice_metadata_t());
+    {
+        metadata_persistence::cluster_persistent_file_t file(
+            &io_backender, temp_file.name(), &get_global_perfmon_collection(),
+            machine_id, initial);
+        EXPECT_TRUE(initial == file.read_metadata());
+    }
+
+    cluster_semilattice_metadata_t updated = initial;
+    updated.databases.databases[deleted_database].mark_deleted();
+    updated.machines.machines[machine_id]
+        = deletable_t<machine_semilattice_metadata_t>(machine_semilattice_metadata_t());
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> >::change_t
+            change(&updated.rdb_namespaces);
+        change.get()->namespaces[generate_uuid()]
+            = deletable_t<namespace_semilattice_metadata_t<rdb_protocol_t> >(
+                namespace_semilattice_metadata_t<rdb_protocol_t>());
+    }
+    {
+        metadata_persistence::cluster_persistent_file_t file(
+            &io_backender, temp_file.name(), &get_global_perfmon_collection());
+        EXPECT_EQ(machine_id, file.read_machine_id());
+        EXPECT_TRUE(initial == file.read_metadata());
+        file.update_metadata(updated);
+    }
+
+    {
+        metadata_persistence::cluster_persistent_file_t file(
+            &io_backender, temp_file.name(), &get_global_perfmon_collection());
+        const cluster_semilattice_metadata_t read = file.read_metadata();
+        EXPECT_TRUE(updated == read);
+        EXPECT_TRUE(read.databases.databases.at(deleted_database).is_deleted());
+        EXPECT_EQ(1u, read.rdb_namespaces->namespaces.size());
+    }
+}
+
+TEST(MetadataPersistence, ClusterRoundTrip) {
+    run_in_thread_pool(&run_cluster_metadata_round_trip_test);
+}
+
+}  // namespace unittest
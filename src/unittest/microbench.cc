@@ -0,0 +1,66 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/microbench.hpp"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace unittest {
+
+// Untimed samples first, to warm up caches and the allocator.
+const int MICROBENCH_WARMUP_SAMPLES = 3;
+const int MICROBENCH_SAMPLES = 31;
+
+static double median_of(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+double run_microbench(const char *name,
+                      int64_t ops_per_sample,
+                      const std::function<void()> &setup,
+                      const std::function<void()> &sample) {
+#ifndef NDEBUG
+    static bool warned = false;
+    if (!warned) {
+        printf("Warning: this is a debug build, so these numbers say little about "
+               "a release build.\n");
+        warned = true;
+    }
+#endif
+
+    for (int i = 0; i < MICROBENCH_WARMUP_SAMPLES; ++i) {
+        setup();
+        sample();
+    }
+
+    std::vector<double> ns_per_op;
+    for (int i = 0; i < MICROBENCH_SAMPLES; ++i) {
+        setup();
+        const ticks_t start = get_ticks();
+        sample();
+        const ticks_t end = get_ticks();
+        ns_per_op.push_back(static_cast<double>(end - start) / ops_per_sample);
+    }
+
+    const double median = median_of(ns_per_op);
+    std::vector<double> deviations;
+    for (size_t i = 0; i < ns_per_op.size(); ++i) {
+        deviations.push_back(fabs(ns_per_op[i] - median));
+    }
+    const double mad = median_of(deviations);
+    const double fastest = *std::min_element(ns_per_op.begin(), ns_per_op.end());
+
+    printf("%-32s %12.1f ns/op  (min %12.1f, MAD %5.1f%%, %d x %" PRIi64 " ops)\n",
+           name, median, fastest, median > 0 ? 100 * mad / median : 0.0,
+           MICROBENCH_SAMPLES, ops_per_sample);
+    fflush(stdout);
+    return median;
+}
+
+}  // namespace unittest
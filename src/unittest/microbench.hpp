@@ -0,0 +1,36 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef UNITTEST_MICROBENCH_HPP_
+#define UNITTEST_MICROBENCH_HPP_
+
+#include <stdint.h>
+
+#include <functional>
+
+namespace unittest {
+
+/* Microbenchmarks are tests in the `Microbench` test case whose names start with
+`DISABLED_`, so that ordinary unit test runs skip them and `make microbench` runs
+them (in a release build, they should be).
+
+`run_microbench()` calls `setup` and then times `sample`, over and over, and prints
+the time per operation: the median over all samples, the fastest sample, and the
+median absolute deviation as a percentage of the median.  A `sample` call should do
+`ops_per_sample` operations and take at least a millisecond or so; `setup` isn't
+timed, and can put back whatever state the last sample used up.  The median and the
+MAD are robust against the odd sample that got descheduled, so reruns on a quiet
+machine agree to within a few percent, and a MAD above that means the numbers
+shouldn't be trusted.  It returns the median, in nanoseconds per operation. */
+double run_microbench(const char *name,
+                    int64_t ops_per_sample,
+                    const std::function<void()> &setup,
+                    const std::function<void()> &sample);
+
+inline double run_microbench(const char *name,
+                             int64_t ops_per_sample,
+                             const std::function<void()> &sample) {
+    return run_microbench(name, ops_per_sample, [] () { }, sample);
+}
+
+}  // namespace unittest
+
+#endif  // UNITTEST_MICROBENCH_HPP_
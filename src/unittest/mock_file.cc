@@ -2,6 +2,8 @@
 #include "unittest/mock_file.hpp"
 
 #include <sys/uio.h>
+
+#include <algorithm>
 #include <functional>
 
 #include "arch/io/disk.hpp"
@@ -30,6 +32,19 @@ void mock_file_t::set_size_at_least(int64_t size) {
     }
 }
 
+bool mock_file_t::preallocate(int64_t size) {
+    set_size_at_least(size);
+    return true;
+}
+
+bool mock_file_t::punch_hole(int64_t offset, int64_t length) {
+    guarantee(mode_ & mode_write);
+    guarantee(0 <= offset && 0 <= length
+              && static_cast<uint64_t>(offset + length) <= data_->size());
+    std::fill(data_->begin() + offset, data_->begin() + offset + length, 0);
+    return true;
+}
+
 void mock_file_t::read_async(int64_t offset, size_t length, void *buf,
                              UNUSED file_account_t *account, linux_iocallback_t *cb) {
     guarantee(mode_ & mode_read);
@@ -23,6 +23,9 @@ public:
     void set_size(int64_t size);
     void set_size_at_least(int64_t size);
 
+    bool preallocate(int64_t size);
+    bool punch_hole(int64_t offset, int64_t length);
+
     void read_async(int64_t offset, size_t length, void *buf,
                     file_account_t *account, linux_iocallback_t *cb);
     void write_async(int64_t offset, size_t length, const void *buf,
@@ -31,7 +34,8 @@ public:
     void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                       file_account_t *account, linux_iocallback_t *cb);
 
-    void *create_account(UNUSED int priority, UNUSED int outstanding_requests_limit) {
+    void *create_account(UNUSED int priority, UNUSED int outstanding_requests_limit,
+                         UNUSED int latency_target_ms) {
         // We don't care about accounts.  Return an arbitrary non-null pointer.
         return this;
     }
@@ -79,6 +83,9 @@ public:
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
 
+    // For tests that look at or damage what the serializer wrote.
+    std::vector<char> *file_contents() { return &file_; }
+
 private:
     enum existence_state_t { no_file, temporary_file, permanent_file, unlinked_file };
     existence_state_t file_existence_state_;
@@ -0,0 +1,56 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/mutex.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+struct priority_inheritance_state_t {
+    mutex_t mutex;
+    cond_t acquired;
+    cond_t waiter_blocked;
+    cond_t done;
+    int priority_while_waited_for;
+};
+
+void low_priority_holder(priority_inheritance_state_t *s) {
+    with_latency_class_t latency_class(LATENCY_CLASS_BACKFILL);
+    {
+        mutex_t::acq_t acq(&s->mutex);
+        s->acquired.pulse();
+        s->waiter_blocked.wait();
+        s->priority_while_waited_for = coro_t::self()->get_priority();
+    }
+    EXPECT_EQ(CORO_PRIORITY_BACKFILL, coro_t::self()->get_priority());
+}
+
+void interactive_waiter(priority_inheritance_state_t *s) {
+    with_latency_class_t latency_class(LATENCY_CLASS_INTERACTIVE);
+    s->acquired.wait();
+    coro_t::spawn_sometime(std::bind(&cond_t::pulse, &s->waiter_blocked));
+    {
+        mutex_t::acq_t acq(&s->mutex);
+        EXPECT_EQ(CORO_PRIORITY_INTERACTIVE, coro_t::self()->get_priority());
+    }
+    s->done.pulse();
+}
+
+void run_priority_inheritance_test() {
+    priority_inheritance_state_t s;
+    coro_t::spawn_sometime(std::bind(&low_priority_holder, &s));
+    coro_t::spawn_sometime(std::bind(&interactive_waiter, &s));
+    s.done.wait();
+    EXPECT_EQ(CORO_PRIORITY_INTERACTIVE, s.priority_while_waited_for);
+    EXPECT_FALSE(s.mutex.is_locked());
+}
+
+TEST(MutexTest, PriorityInheritance) {
+    run_in_thread_pool(&run_priority_inheritance_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,43 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <set>
+#include <vector>
+
+#include "arch/runtime/numa.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(NUMATopology, ParseCPUList) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(numa_topology_t::parse_cpu_list("0-3,8,10-11\n", &cpus));
+    std::vector<int> expected = { 0, 1, 2, 3, 8, 10, 11 };
+    EXPECT_EQ(expected, cpus);
+
+    ASSERT_TRUE(numa_topology_t::parse_cpu_list("\n", &cpus));
+    EXPECT_TRUE(cpus.empty());
+
+    EXPECT_FALSE(numa_topology_t::parse_cpu_list("3-1", &cpus));
+    EXPECT_FALSE(numa_topology_t::parse_cpu_list("a", &cpus));
+}
+
+TEST(NUMATopology, SpreadsThreadsOverNodes) {
+    std::vector<std::vector<int> > nodes = { { 0, 1, 2, 3 }, { }, { 4, 5, 6, 7 } };
+    numa_topology_t topology(nodes);
+    ASSERT_EQ(2u, topology.num_nodes());
+
+    // Half the threads on each node, each on a core of its own.
+    std::set<int> used;
+    for (int i = 0; i < 4; ++i) {
+        const int cpu = topology.cpu_for_thread(i, 4);
+        EXPECT_EQ(i < 2, cpu < 4);
+        used.insert(cpu);
+    }
+    EXPECT_EQ(4u, used.size());
+
+    // With more threads than cores, they share.
+    for (int i = 0; i < 16; ++i) {
+        EXPECT_EQ(i / 2, topology.cpu_for_thread(i, 16));
+    }
+}
+
+}  // namespace unittest
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
+#include "buffer_cache/alt/evicter.hpp"
 #include "buffer_cache/alt/page_cache.hpp"
 // For alt_memory_tracker_t.  KSI: We'll want a mock memory_tracker_t subclass.
 #include "buffer_cache/alt/alt.hpp"
@@ -46,11 +47,11 @@ class test_txn_t;
 class test_cache_t : public page_cache_t {
 public:
     test_cache_t(serializer_t *serializer, alt_memory_tracker_t *tracker)
-        : page_cache_t(serializer, page_cache_config_t(), tracker),
+        : page_cache_t(serializer, page_cache_config_t(), tracker, NULL),
           tracker_(tracker) { }
     test_cache_t(serializer_t *serializer, alt_memory_tracker_t *tracker,
                  uint64_t memory_limit)
-        : page_cache_t(serializer, make_config(memory_limit), tracker),
+        : page_cache_t(serializer, make_config(memory_limit), tracker, NULL),
           tracker_(tracker) { }
 
     void flush(scoped_ptr_t<test_txn_t> txn) {
@@ -104,6 +105,11 @@ public:
         return current_page_acq_t::current_page_for_read(
                 page_cache()->default_reads_account());
     }
+
+    bool try_optimistic_read() {
+        return current_page_acq_t::try_optimistic_read(
+                page_cache()->default_reads_account());
+    }
 };
 
 class test_acq_t : public page_acq_t {
@@ -301,6 +307,70 @@ TEST(PageTest, ReadAfterWrite) {
     run_in_thread_pool(run_ReadAfterWrite, 4);
 }
 
+void run_OptimisticRead() {
+    mock_ser_t mock;
+    test_cache_t page_cache(mock.ser.get(), mock.tracker.get());
+    block_id_t block_id;
+    {
+        auto txn = make_scoped<test_txn_t>(&page_cache);
+        {
+            current_test_acq_t acq(txn.get(), alt_create_t::create);
+            block_id = acq.block_id();
+            acq.current_page_for_write();
+        }
+        page_cache.flush(std::move(txn));
+    }
+
+    auto write_txn = make_scoped<test_txn_t>(&page_cache);
+    auto read_txn = make_scoped<test_txn_t>(&page_cache);
+    {
+        scoped_ptr_t<current_test_acq_t> write_acq(
+            new current_test_acq_t(write_txn.get(), block_id, access_t::write));
+        write_acq->write_acq_signal()->wait();
+
+        // The reader can pass the writer, which hasn't modified the page yet.
+        current_test_acq_t read_acq(read_txn.get(), block_id, access_t::read);
+        ASSERT_FALSE(read_acq.read_acq_signal()->is_pulsed());
+        ASSERT_TRUE(read_acq.try_optimistic_read());
+        ASSERT_TRUE(read_acq.optimistic_read_is_valid());
+        page_t *old_page = read_acq.current_page_for_read();
+
+        // Once the writer modifies it, the reader keeps the old version, but knows
+        // it's stale.
+        page_t *new_page = write_acq->current_page_for_write();
+        ASSERT_NE(old_page, new_page);
+        ASSERT_FALSE(read_acq.optimistic_read_is_valid());
+        ASSERT_EQ(old_page, read_acq.current_page_for_read());
+
+        read_acq.abandon_optimistic_read();
+        write_acq.reset();
+        ASSERT_TRUE(read_acq.read_acq_signal()->is_pulsed());
+        ASSERT_EQ(new_page, read_acq.current_page_for_read());
+    }
+    page_cache.flush(std::move(write_txn));
+    page_cache.flush(std::move(read_txn));
+
+    write_txn = make_scoped<test_txn_t>(&page_cache);
+    read_txn = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_test_acq_t write_acq(write_txn.get(), block_id, access_t::write);
+        write_acq.write_acq_signal()->wait();
+        // The writer went on to acquire another block, so it might be modifying the
+        // children of this one.
+        current_test_acq_t create_acq(write_txn.get(), alt_create_t::create);
+
+        current_test_acq_t read_acq(read_txn.get(), block_id, access_t::read);
+        ASSERT_FALSE(read_acq.try_optimistic_read());
+        ASSERT_FALSE(read_acq.has_optimistic_read());
+    }
+    page_cache.flush(std::move(write_txn));
+    page_cache.flush(std::move(read_txn));
+}
+
+TEST(PageTest, OptimisticRead) {
+    run_in_thread_pool(run_OptimisticRead, 4);
+}
+
 struct WriteWaitForFlush_state_t {
     block_id_t block_id;
     cond_t coro_1_begin;
@@ -1120,13 +1190,13 @@ private:
         test_acq_t page_acq;
         page_acq.init(acq->current_page_for_write(), c);
         const uint32_t n = page_acq.get_buf_size();
-        ASSERT_EQ(4088u, n);
+        ASSERT_EQ(4080u, n);
         memset(page_acq.get_buf_write(), 0, n);
     }
 
     void check_page_acq(page_acq_t *page_acq, const std::string &expected) {
         const uint32_t n = page_acq->get_buf_size();
-        ASSERT_EQ(4088u, n);
+        ASSERT_EQ(4080u, n);
         const char *const p = static_cast<const char *>(page_acq->get_buf_read());
 
         ASSERT_LE(expected.size() + 1, n);
@@ -1159,7 +1229,7 @@ private:
             check_page_acq(&page_acq, expected);
 
             char *const p = static_cast<char *>(page_acq.get_buf_write());
-            ASSERT_EQ(4088u, page_acq.get_buf_size());
+            ASSERT_EQ(4080u, page_acq.get_buf_size());
             ASSERT_LE(expected.size() + append.size() + 1, page_acq.get_buf_size());
             memcpy(p + expected.size(), append.c_str(), append.size() + 1);
         }
@@ -1232,4 +1302,41 @@ TEST(PageTest, BiggerTestNoMemory) {
     run_in_thread_pool(run_BiggerTestNoMemory, 4);
 }
 
+// Remembers what the evicter last told it about the cache's memory.
+class recording_memory_tracker_t : public memory_tracker_t {
+public:
+    recording_memory_tracker_t() : in_memory_size(0), memory_limit(0) { }
+
+    void inform_memory_change(uint64_t _in_memory_size, uint64_t _memory_limit) {
+        in_memory_size = _in_memory_size;
+        memory_limit = _memory_limit;
+    }
+
+    uint64_t in_memory_size;
+    uint64_t memory_limit;
+};
+
+void run_OutsideMemory() {
+    recording_memory_tracker_t tracker;
+    alt::evicter_t evicter(&tracker, 10000, NULL);
+
+    evicter.change_outside_memory(3000);
+    EXPECT_EQ(3000u, tracker.in_memory_size);
+    EXPECT_EQ(10000u, tracker.memory_limit);
+    EXPECT_TRUE(evicter.interested_in_read_ahead_block(4000));
+
+    // The outside memory leaves less room for pages.
+    evicter.change_outside_memory(5000);
+    EXPECT_EQ(8000u, tracker.in_memory_size);
+    EXPECT_FALSE(evicter.interested_in_read_ahead_block(4000));
+
+    evicter.change_outside_memory(-8000);
+    EXPECT_EQ(0u, tracker.in_memory_size);
+    EXPECT_TRUE(evicter.interested_in_read_ahead_block(4000));
+}
+
+TEST(PageTest, OutsideMemory) {
+    run_in_thread_pool(run_OutsideMemory);
+}
+
 }  // namespace unittest
@@ -4,9 +4,15 @@
 #include <math.h>
 
 #include <cmath>  // for std::isnan -- read the comment below.
+#include <map>
+#include <string>
+#include <vector>
 
+#include "arch/runtime/thread_pool.hpp"
+#include "perfmon/exposition.hpp"
 #include "perfmon/perfmon.hpp"
 #include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
 
 namespace unittest {
 
@@ -57,4 +63,156 @@ TEST(PerfmonTest, StddevComputation) {
     }
 }
 
+static void run_counter_test() {
+    perfmon_counter_t counter;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        on_thread_t th((threadnum_t(i)));
+        counter += i + 1;
+        --counter;
+    }
+    /* Every thread's count is visible from this one without visiting the
+    others. */
+    int n = get_num_threads();
+    EXPECT_EQ(n * (n + 1) / 2 - n, counter.get_value());
+}
+
+TEST(PerfmonTest, CounterSumsThreads) {
+    unittest::run_in_thread_pool(&run_counter_test, 4);
+}
+
+TEST(PerfmonTest, LatencyHistogramBuckets) {
+    using perfmon_latency_histogram::bucket_for_duration;
+    using perfmon_latency_histogram::NUM_BUCKETS;
+
+    using perfmon_latency_histogram::bucket_lower_bound_micros;
+
+    EXPECT_EQ(0, bucket_for_duration(0));
+    EXPECT_EQ(0, bucket_for_duration(999));
+    EXPECT_EQ(1, bucket_for_duration(1000));
+    EXPECT_EQ(3, bucket_for_duration(3999));
+    EXPECT_EQ(4, bucket_for_duration(4000));
+    EXPECT_EQ(7, bucket_for_duration(7999));
+    EXPECT_EQ(8, bucket_for_duration(8000));
+    EXPECT_EQ(8, bucket_for_duration(9999));
+    EXPECT_EQ(9, bucket_for_duration(10000));
+    // 1000us is in [896us, 1024us).
+    EXPECT_EQ(35, bucket_for_duration(1000000));
+    EXPECT_EQ(896u, bucket_lower_bound_micros(35));
+    EXPECT_EQ(NUM_BUCKETS - 1, bucket_for_duration(3600 * 1000000000ull));
+
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        EXPECT_EQ(i, bucket_for_duration(bucket_lower_bound_micros(i) * 1000));
+        if (i > 0) {
+            EXPECT_EQ(i - 1, bucket_for_duration(bucket_lower_bound_micros(i) * 1000 - 1));
+        }
+    }
+}
+
+scoped_ptr_t<perfmon_result_t> make_histogram_result(
+        const std::map<std::string, std::string> &buckets) {
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    perfmon_result_t *buckets_result = perfmon_result_t::alloc_map_result().release();
+    for (auto it = buckets.begin(); it != buckets.end(); ++it) {
+        buckets_result->insert(it->first, new perfmon_result_t(it->second));
+    }
+    result->insert("buckets", buckets_result);
+    return result;
+}
+
+std::string get_result_field(const perfmon_result_t &result, const std::string &field) {
+    perfmon_result_t::const_iterator it = result.get_map()->find(field);
+    if (it == result.cend() || !it->second->is_string()) {
+        return "";
+    }
+    return *it->second->get_string();
+}
+
+TEST(PerfmonTest, LatencyHistogramMerge) {
+    std::map<std::string, std::string> a, b;
+    a["under_2us"] = "3";
+    a["under_1280us"] = "1";
+    b["under_2us"] = "2";
+    b["over_58720256us"] = "5";
+    scoped_ptr_t<perfmon_result_t> result_a = make_histogram_result(a);
+    scoped_ptr_t<perfmon_result_t> result_b = make_histogram_result(b);
+    std::vector<const perfmon_result_t *> results;
+    results.push_back(result_a.get());
+    results.push_back(result_b.get());
+
+    scoped_ptr_t<perfmon_result_t> merged
+        = perfmon_latency_histogram::merge_results(results);
+    EXPECT_EQ("11", get_result_field(*merged, "count"));
+    const perfmon_result_t &merged_ref = *merged;
+    perfmon_result_t::const_iterator buckets = merged_ref.get_map()->find("buckets");
+    ASSERT_TRUE(buckets != merged_ref.cend());
+    EXPECT_EQ("5", get_result_field(*buckets->second, "under_2us"));
+    EXPECT_EQ("1", get_result_field(*buckets->second, "under_1280us"));
+    EXPECT_EQ("5", get_result_field(*buckets->second, "over_58720256us"));
+    EXPECT_EQ("0.00128000", get_result_field(*merged, "p50"));
+    EXPECT_EQ("58.72025600", get_result_field(*merged, "p90"));
+
+    // Merging a merged result gives the same result.
+    std::vector<const perfmon_result_t *> again(1, merged.get());
+    scoped_ptr_t<perfmon_result_t> remerged
+        = perfmon_latency_histogram::merge_results(again);
+    EXPECT_EQ("11", get_result_field(*remerged, "count"));
+    EXPECT_EQ(get_result_field(*merged, "p99"), get_result_field(*remerged, "p99"));
+}
+
+TEST(PerfmonTest, Exposition) {
+    const std::string table = "7f0e7a6f-2d4d-4fd6-a3c2-5f1bfc8e6ad5";
+    scoped_ptr_t<perfmon_result_t> root = perfmon_result_t::alloc_map_result();
+    perfmon_result_t *routing = perfmon_result_t::alloc_map_result().release();
+    routing->insert("master_ops_in_flight", new perfmon_result_t("3"));
+    routing->insert("nothing_yet", new perfmon_result_t("-"));
+    root->insert("query_routing", routing);
+
+    perfmon_result_t *ns = perfmon_result_t::alloc_map_result().release();
+    perfmon_result_t *regions = perfmon_result_t::alloc_map_result().release();
+    perfmon_result_t *region = perfmon_result_t::alloc_map_result().release();
+    region->insert("queue", new perfmon_result_t("1"));
+    regions->insert("be_primary", region);
+    ns->insert("regions", regions);
+    perfmon_result_t *serializers = perfmon_result_t::alloc_map_result().release();
+    perfmon_result_t *stripe = perfmon_result_t::alloc_map_result().release();
+    std::map<std::string, std::string> buckets;
+    buckets["under_2us"] = "3";
+    buckets["over_58720256us"] = "1";
+    stripe->insert("read_latency", make_histogram_result(buckets).release());
+    serializers->insert("stripe_1", stripe);
+    ns->insert("serializers", serializers);
+    root->insert(table, ns);
+
+    perfmon_exposition_t::labels_t labels;
+    labels.push_back(std::make_pair("machine", "m\"1"));
+
+    {
+        perfmon_exposition_t exposition;
+        std::string out;
+        exposition.render(*root, labels, &out);
+        // The table's UUID sorts before "query_routing".
+        EXPECT_EQ("rethinkdb_regions_queue{machine=\"m\\\"1\",table=\"" + table
+                  + "\",shard=\"be_primary\"} 1\n"
+                  "rethinkdb_serializers_read_latency_bucket{machine=\"m\\\"1\",table=\""
+                  + table + "\",stripe=\"stripe_1\",le=\"0.000002\"} 3\n"
+                  "rethinkdb_serializers_read_latency_bucket{machine=\"m\\\"1\",table=\""
+                  + table + "\",stripe=\"stripe_1\",le=\"+Inf\"} 4\n"
+                  "rethinkdb_serializers_read_latency_count{machine=\"m\\\"1\",table=\""
+                  + table + "\",stripe=\"stripe_1\"} 4\n"
+                  "rethinkdb_query_routing_master_ops_in_flight{machine=\"m\\\"1\"} 3\n",
+                  out);
+    }
+
+    {
+        perfmon_exposition_t exposition;
+        std::string error;
+        ASSERT_TRUE(exposition.add_match_pattern("^rethinkdb_regions_", &error));
+        EXPECT_FALSE(exposition.add_match_pattern("(", &error));
+        std::string out;
+        exposition.render(*root, perfmon_exposition_t::labels_t(), &out);
+        EXPECT_EQ("rethinkdb_regions_queue{table=\"" + table
+                  + "\",shard=\"be_primary\"} 1\n", out);
+    }
+}
+
 }  // namespace unittest
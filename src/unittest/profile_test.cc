@@ -0,0 +1,65 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/profile.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+static double counter_of(const counted_t<const ql::datum_t> &task, const std::string &name) {
+    counted_t<const ql::datum_t> counter = task->get(name, ql::NOTHROW);
+    return counter.has() ? counter->as_num() : 0;
+}
+
+TEST(ProfileTest, CountersIncludeInnerTasks) {
+    profile::trace_t trace;
+    {
+        profile::starter_t outer("Outer.", &trace);
+        profile::count_rows_read(&trace, 2);
+        {
+            profile::starter_t inner("Inner.", &trace);
+            profile::count_rows_read(&trace, 3);
+            profile::count_blocks_read(&trace, 1);
+            profile::count_memory(&trace, 100);
+        }
+    }
+
+    counted_t<const ql::datum_t> tasks = trace.as_datum();
+    ASSERT_EQ(1u, tasks->size());
+    counted_t<const ql::datum_t> outer = tasks->get(0);
+    EXPECT_EQ(5, counter_of(outer, "rows_read"));
+    EXPECT_EQ(1, counter_of(outer, "blocks_read"));
+    EXPECT_EQ(100, counter_of(outer, "memory_charged"));
+    counted_t<const ql::datum_t> inner = outer->get("sub_tasks")->get(0);
+    EXPECT_EQ(3, counter_of(inner, "rows_read"));
+    // Counters that are zero are left out.
+    EXPECT_FALSE(inner->get("shard_round_trips", ql::NOTHROW).has());
+}
+
+TEST(ProfileTest, CountersIncludeParallelJobs) {
+    // Each job is what a shard sends back: one task, then a stop event.
+    profile::event_log_t jobs;
+    for (int i = 0; i < 2; ++i) {
+        profile::trace_t shard_trace;
+        {
+            profile::starter_t starter("Perform read on shard.", &shard_trace);
+            profile::count_shard_round_trips(&shard_trace, 1);
+            profile::count_rows_read(&shard_trace, 10);
+        }
+        profile::event_log_t log = std::move(shard_trace).extract_event_log();
+        jobs.insert(jobs.end(), log.begin(), log.end());
+        jobs.push_back(profile::stop_t());
+    }
+
+    profile::trace_t trace;
+    {
+        profile::starter_t starter("Perform read.", &trace);
+        profile::splitter_t splitter(&trace);
+        splitter.give_splits(2, jobs);
+    }
+
+    counted_t<const ql::datum_t> read = trace.as_datum()->get(0);
+    EXPECT_EQ(2, counter_of(read, "shard_round_trips"));
+    EXPECT_EQ(20, counter_of(read, "rows_read"));
+}
+
+}  // namespace unittest
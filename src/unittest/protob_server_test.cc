@@ -0,0 +1,228 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/network.hpp"
+#include "arch/timing.hpp"
+#include "clustering/administration/metadata.hpp"
+#include "protob/protob.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/pb_server.hpp"
+#include "unittest/dummy_metadata_controller.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+struct test_protob_context_t {
+    test_protob_context_t() : interruptor(NULL) { }
+    static const int32_t no_auth_magic_number = VersionDummy::V0_1;
+    static const int32_t auth_magic_number = VersionDummy::V0_2;
+    signal_t *interruptor;
+};
+
+// Answers every query with its token, once the gate for the token (if it has one)
+// is open.  It records the order the queries started in.
+class gated_handler_t {
+public:
+    bool handle(ql::protob_t<Query> q, Response *response,
+                UNUSED test_protob_context_t *ctx) {
+        started.push_back(q->token());
+        auto it = gates.find(q->token());
+        if (it != gates.end()) {
+            it->second->wait_lazily_unordered();
+        }
+        response->set_token(q->token());
+        response->set_type(Response::SUCCESS_ATOM);
+        return true;
+    }
+
+    std::map<int64_t, cond_t *> gates;
+    std::vector<int64_t> started;
+};
+
+Response on_unparsable_test_query(ql::protob_t<Query> q, std::string msg) {
+    Response response;
+    response.set_token((q.has() && q->has_token()) ? q->token() : -1);
+    ql::fill_error(&response, Response::CLIENT_ERROR, msg);
+    return response;
+}
+
+class test_protob_server_t {
+public:
+    test_protob_server_t()
+        : auth_controller((auth_semilattice_metadata_t())),
+          server(get_unittest_addresses(), 0,
+                 boost::bind(&gated_handler_t::handle, &handler, _1, _2, _3),
+                 &on_unparsable_test_query,
+                 auth_controller.get_view(),
+                 CORO_UNORDERED) { }
+
+    gated_handler_t handler;
+    dummy_semilattice_controller_t<auth_semilattice_metadata_t> auth_controller;
+    protob_server_t<ql::protob_t<Query>, Response, test_protob_context_t> server;
+};
+
+std::string serialize_query(Query::QueryType type, int64_t token) {
+    Query query;
+    query.set_type(type);
+    query.set_token(token);
+    std::string data;
+    query.SerializeToString(&data);
+    return data;
+}
+
+void send_query(linux_tcp_conn_t *conn, Query::QueryType type, int64_t token) {
+    cond_t non_interruptor;
+    std::string data = serialize_query(type, token);
+    int32_t size = data.size();
+    conn->write(&size, sizeof(size), &non_interruptor);
+    conn->write(data.data(), data.size(), &non_interruptor);
+}
+
+int64_t read_response_token(linux_tcp_conn_t *conn) {
+    cond_t non_interruptor;
+    int32_t size;
+    conn->read(&size, sizeof(size), &non_interruptor);
+    scoped_array_t<char> data(size);
+    conn->read(data.data(), size, &non_interruptor);
+    Response response;
+    EXPECT_TRUE(response.ParseFromArray(data.data(), size));
+    EXPECT_EQ(Response::SUCCESS_ATOM, response.type());
+    return response.token();
+}
+
+void connect_to_test_server(test_protob_server_t *server,
+                            scoped_ptr_t<linux_tcp_conn_t> *conn_out) {
+    cond_t non_interruptor;
+    conn_out->init(new linux_tcp_conn_t(ip_address_t("127.0.0.1"),
+                                        server->server.get_port(),
+                                        &non_interruptor));
+    int32_t magic_number = test_protob_context_t::no_auth_magic_number;
+    (*conn_out)->write(&magic_number, sizeof(magic_number), &non_interruptor);
+}
+
+void run_out_of_order_test() {
+    test_protob_server_t server;
+    cond_t gate;
+    server.handler.gates[1] = &gate;
+
+    scoped_ptr_t<linux_tcp_conn_t> conn;
+    connect_to_test_server(&server, &conn);
+    send_query(conn.get(), Query::START, 1);
+    send_query(conn.get(), Query::START, 2);
+
+    // The second query doesn't wait for the first one.
+    EXPECT_EQ(2, read_response_token(conn.get()));
+    gate.pulse();
+    EXPECT_EQ(1, read_response_token(conn.get()));
+}
+
+TEST(ProtobServer, OutOfOrderResponses) {
+    run_in_thread_pool(&run_out_of_order_test);
+}
+
+void run_noreply_wait_test() {
+    test_protob_server_t server;
+    cond_t gate;
+    server.handler.gates[1] = &gate;
+
+    scoped_ptr_t<linux_tcp_conn_t> conn;
+    connect_to_test_server(&server, &conn);
+    send_query(conn.get(), Query::START, 1);
+    send_query(conn.get(), Query::NOREPLY_WAIT, 2);
+    send_query(conn.get(), Query::START, 3);
+
+    // NOREPLY_WAIT waits for the query before it, and the query after it waits for
+    // NOREPLY_WAIT.
+    let_stuff_happen();
+    EXPECT_EQ(std::vector<int64_t>(1, 1), server.handler.started);
+    gate.pulse();
+    EXPECT_EQ(1, read_response_token(conn.get()));
+    EXPECT_EQ(2, read_response_token(conn.get()));
+    EXPECT_EQ(3, read_response_token(conn.get()));
+    EXPECT_EQ(3u, server.handler.started.size());
+}
+
+TEST(ProtobServer, NoreplyWaitWaitsForEarlierQueries) {
+    run_in_thread_pool(&run_noreply_wait_test);
+}
+
+void run_concurrency_limit_test() {
+    test_protob_server_t server;
+    cond_t gate;
+    for (int64_t token = 0; token < PROTOB_MAX_CONCURRENT_REQUESTS; ++token) {
+        server.handler.gates[token] = &gate;
+    }
+
+    scoped_ptr_t<linux_tcp_conn_t> conn;
+    connect_to_test_server(&server, &conn);
+    for (int64_t token = 0; token <= PROTOB_MAX_CONCURRENT_REQUESTS; ++token) {
+        send_query(conn.get(), Query::START, token);
+    }
+
+    // The query past the limit only starts once one of the others is done.
+    let_stuff_happen();
+    EXPECT_EQ(static_cast<size_t>(PROTOB_MAX_CONCURRENT_REQUESTS),
+              server.handler.started.size());
+    gate.pulse();
+    for (int i = 0; i <= PROTOB_MAX_CONCURRENT_REQUESTS; ++i) {
+        read_response_token(conn.get());
+    }
+    EXPECT_EQ(static_cast<size_t>(PROTOB_MAX_CONCURRENT_REQUESTS + 1),
+              server.handler.started.size());
+}
+
+TEST(ProtobServer, ConcurrencyLimit) {
+    run_in_thread_pool(&run_concurrency_limit_test);
+}
+
+void run_http_query_test() {
+    test_protob_server_t server;
+    http_app_t *app = &server.server;
+    cond_t non_interruptor;
+
+    http_req_t open_req("/open-new-connection");
+    open_req.method = GET;
+    http_res_t open_res;
+    app->handle(open_req, &open_res, &non_interruptor);
+    ASSERT_EQ(HTTP_OK, open_res.code);
+    ASSERT_EQ(sizeof(int32_t), open_res.body.size());
+    int32_t conn_id;
+    memcpy(&conn_id, open_res.body.data(), sizeof(conn_id));
+
+    // Queries over HTTP are answered inline, whatever the mode of the server.
+    std::string query = serialize_query(Query::START, 5);
+    int32_t query_size = query.size();
+    http_req_t query_req("/");
+    query_req.method = POST;
+    query_req.query_params.push_back(query_parameter_t());
+    query_req.query_params.back().key = "conn_id";
+    query_req.query_params.back().val = strprintf("%" PRIi32, conn_id);
+    query_req.body.assign(reinterpret_cast<const char *>(&query_size),
+                          sizeof(query_size));
+    query_req.body += query;
+    http_res_t query_res;
+    app->handle(query_req, &query_res, &non_interruptor);
+    ASSERT_EQ(HTTP_OK, query_res.code);
+
+    int32_t response_size;
+    ASSERT_LE(sizeof(response_size), query_res.body.size());
+    memcpy(&response_size, query_res.body.data(), sizeof(response_size));
+    Response response;
+    ASSERT_TRUE(response.ParseFromArray(query_res.body.data() + sizeof(response_size),
+                                        response_size));
+    EXPECT_EQ(5, response.token());
+}
+
+TEST(ProtobServer, HttpQuery) {
+    run_in_thread_pool(&run_http_query_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,45 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(PseudoTimeTest, Iso8601RoundTrip) {
+    const char *times[] = { "2013-07-17T12:34:56.789+05:30",
+                            "1969-12-31T23:59:59.999-08:00",
+                            "2000-02-29T00:00:00+00:00",
+                            "1500-03-01T06:07:08.010-12:00",
+                            "9998-12-31T23:59:59+14:00" };
+    for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); ++i) {
+        counted_t<const ql::datum_t> t = ql::pseudo::iso8601_to_time(times[i], "", NULL);
+        EXPECT_EQ(times[i], ql::pseudo::time_to_iso8601(t));
+    }
+}
+
+TEST(PseudoTimeTest, Portions) {
+    counted_t<const ql::datum_t> t
+        = ql::pseudo::iso8601_to_time("2012-02-29T23:30:15.250-05:00", "", NULL);
+    EXPECT_EQ(1330576215.25, ql::pseudo::time_to_epoch_time(t));
+    EXPECT_EQ(2012, ql::pseudo::time_portion(t, ql::pseudo::YEAR));
+    EXPECT_EQ(2, ql::pseudo::time_portion(t, ql::pseudo::MONTH));
+    EXPECT_EQ(29, ql::pseudo::time_portion(t, ql::pseudo::DAY));
+    EXPECT_EQ(3, ql::pseudo::time_portion(t, ql::pseudo::DAY_OF_WEEK));
+    EXPECT_EQ(60, ql::pseudo::time_portion(t, ql::pseudo::DAY_OF_YEAR));
+    EXPECT_EQ(23, ql::pseudo::time_portion(t, ql::pseudo::HOURS));
+    EXPECT_EQ(30, ql::pseudo::time_portion(t, ql::pseudo::MINUTES));
+    EXPECT_EQ(15.25, ql::pseudo::time_portion(t, ql::pseudo::SECONDS));
+}
+
+TEST(PseudoTimeTest, OtherFormsStillParse) {
+    // Only the first of these is in the complete form, boost parses the others.
+    const char *expected = "2013-07-30T20:56:05-07:00";
+    EXPECT_EQ(expected, ql::pseudo::time_to_iso8601(
+                  ql::pseudo::iso8601_to_time(expected, "", NULL)));
+    EXPECT_EQ(expected, ql::pseudo::time_to_iso8601(
+                  ql::pseudo::iso8601_to_time("2013-07-30T20:56:05", "-07", NULL)));
+    EXPECT_EQ(expected, ql::pseudo::time_to_iso8601(
+                  ql::pseudo::iso8601_to_time("2013-211T20:56:05-07:00", "", NULL)));
+}
+
+}  // namespace unittest
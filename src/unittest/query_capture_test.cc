@@ -0,0 +1,30 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_capture.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(QueryCaptureTest, HeaderLayout) {
+    std::string header;
+    serialize_trace_header(0x0102030405060708ULL, &header);
+    ASSERT_EQ(20u, header.size());
+    EXPECT_EQ("RQLTRACE", header.substr(0, 8));
+    EXPECT_EQ(std::string("\x01\x00\x00\x00", 4), header.substr(8, 4));
+    EXPECT_EQ(std::string("\x08\x07\x06\x05\x04\x03\x02\x01", 8), header.substr(12, 8));
+}
+
+TEST(QueryCaptureTest, RecordLayout) {
+    std::string record;
+    serialize_trace_record(0x1234, 7, "query", &record);
+    ASSERT_EQ(query_capture_t::record_header_size + 5, record.size());
+    EXPECT_EQ(std::string("\x05\x00\x00\x00", 4), record.substr(0, 4));
+    EXPECT_EQ(std::string("\x34\x12\x00\x00\x00\x00\x00\x00", 8), record.substr(4, 8));
+    EXPECT_EQ(std::string("\x07\x00\x00\x00", 4), record.substr(12, 4));
+    EXPECT_EQ("query", record.substr(16));
+
+    // Records are appended, so a buffer can hold several.
+    serialize_trace_record(0x1235, 8, "", &record);
+    EXPECT_EQ(2 * query_capture_t::record_header_size + 5, record.size());
+}
+
+}  // namespace unittest
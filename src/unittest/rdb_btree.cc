@@ -73,7 +73,9 @@ void insert_rows_and_pulse_when_done(int start, int finish,
     pulse_when_done->pulse();
 }
 
-std::string create_sindex(btree_store_t<rdb_protocol_t> *store) {
+/* Creates an index on `sid`.  If `outdated` is set, its definition is the one indexes
+ * had before their keys were in the compact format. */
+std::string create_sindex(btree_store_t<rdb_protocol_t> *store, bool outdated = false) {
     cond_t dummy_interruptor;
     std::string sindex_id = uuid_to_str(generate_uuid());
     write_token_pair_t token_pair;
@@ -93,25 +95,53 @@ std::string create_sindex(btree_store_t<rdb_protocol_t> *store) {
 
     sindex_multi_bool_t multi_bool = sindex_multi_bool_t::SINGLE;
 
-    write_message_t wm;
-    wm << m;
-    wm << multi_bool;
-
-    vector_stream_t stream;
-    stream.reserve(wm.size());
-    int res = send_write_message(&stream, &wm);
-    guarantee(res == 0);
+    secondary_index_t::opaque_definition_t definition;
+    if (outdated) {
+        write_message_t wm;
+        wm << m;
+        wm << multi_bool;
+
+        vector_stream_t stream;
+        stream.reserve(wm.size());
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        definition = stream.vector();
+    } else {
+        definition = serialize_sindex_definition(m, multi_bool,
+                                                 std::vector<std::string>(), false,
+                                                 std::string());
+    }
 
     buf_lock_t sindex_block
         = store->acquire_sindex_block_for_write(super_block->expose_buf(),
                                                 super_block->get_sindex_block_id());
     UNUSED bool b = store->add_sindex(
             sindex_id,
-            stream.vector(),
+            definition,
             &sindex_block);
     return sindex_id;
 }
 
+ql::key_format_t get_sindex_key_format(btree_store_t<rdb_protocol_t> *store,
+                                       const std::string &sindex_id) {
+    cond_t dummy_interruptor;
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store->acquire_superblock_for_read(&token_pair.main_read_token, &txn,
+                                       &super_block, &dummy_interruptor, false);
+
+    buf_lock_t sindex_block
+        = store->acquire_sindex_block_for_read(super_block->expose_buf(),
+                                               super_block->get_sindex_block_id());
+    secondary_index_t sindex;
+    bool found = get_secondary_index(&sindex_block, sindex_id, &sindex);
+    guarantee(found);
+    return sindex_key_format(sindex);
+}
+
 void drop_sindex(btree_store_t<rdb_protocol_t> *store,
                  const std::string &sindex_id) {
     cond_t dummy_interruptor;
@@ -222,8 +252,8 @@ void _check_keys_are_present(btree_store_t<rdb_protocol_t> *store,
         rdb_rget_slice(
             store->get_sindex_slice(sindex_id),
             rdb_protocol_t::sindex_key_range(
-                store_key_t(make_counted<const ql::datum_t>(ii)->print_primary()),
-                store_key_t(make_counted<const ql::datum_t>(ii)->print_primary())),
+                make_counted<const ql::datum_t>(ii)->truncated_secondary(),
+                make_counted<const ql::datum_t>(ii)->truncated_secondary()),
             sindex_sb.get(),
             &dummy_env, // env_t
             ql::batchspec_t::user(ql::batch_type_t::NORMAL,
@@ -288,8 +318,8 @@ void _check_keys_are_NOT_present(btree_store_t<rdb_protocol_t> *store,
         rdb_rget_slice(
             store->get_sindex_slice(sindex_id),
             rdb_protocol_t::sindex_key_range(
-                store_key_t(make_counted<const ql::datum_t>(ii)->print_primary()),
-                store_key_t(make_counted<const ql::datum_t>(ii)->print_primary())),
+                make_counted<const ql::datum_t>(ii)->truncated_secondary(),
+                make_counted<const ql::datum_t>(ii)->truncated_secondary()),
             sindex_sb.get(),
             &dummy_env, // env_t
             ql::batchspec_t::user(ql::batch_type_t::NORMAL,
@@ -338,6 +368,7 @@ void run_sindex_post_construction() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -382,6 +413,7 @@ void run_erase_range_test() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -425,7 +457,7 @@ void run_erase_range_test() {
                         key_range_t::universe(),
                         &sindex_block,
                         super_block.get(), &store,
-                        &dummy_interruptor);
+                        NULL, &dummy_interruptor);
     }
 
     check_keys_are_NOT_present(&store, sindex_id);
@@ -435,6 +467,62 @@ TEST(RDBBtree, SindexEraseRange) {
     run_in_thread_pool(&run_erase_range_test);
 }
 
+void run_rebuild_outdated_sindex_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    scoped_ptr_t<rdb_protocol_t::store_t> store(
+            new rdb_protocol_t::store_t(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            NULL,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t(".")));
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, store.get());
+
+    std::string sindex_id = create_sindex(store.get(), true);
+    bring_sindexes_up_to_date(store.get(), sindex_id);
+    EXPECT_EQ(ql::key_format_t::PRINTED, get_sindex_key_format(store.get(), sindex_id));
+
+    // Opening the store again replaces the index with one in the compact format,
+    // which gets all of the rows again.
+    store.reset();
+    store.init(new rdb_protocol_t::store_t(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            NULL,
+            false,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t(".")));
+    EXPECT_EQ(ql::key_format_t::COMPACT, get_sindex_key_format(store.get(), sindex_id));
+
+    check_keys_are_present(store.get(), sindex_id);
+}
+
+TEST(RDBBtree, RebuildOutdatedSindex) {
+    run_in_thread_pool(&run_rebuild_outdated_sindex_test);
+}
+
 void run_sindex_interruption_via_drop_test() {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -455,6 +543,7 @@ void run_sindex_interruption_via_drop_test() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -500,6 +589,7 @@ void run_sindex_interruption_via_store_delete() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
             true,
             &get_global_perfmon_collection(),
             NULL,
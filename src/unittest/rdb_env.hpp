@@ -66,10 +66,12 @@ private:
 
     struct read_visitor_t : public boost::static_visitor<void> {
         void operator()(const rdb_protocol_t::point_read_t &get);
+        void operator()(const rdb_protocol_t::batched_point_read_t &bpr);
         void NORETURN operator()(UNUSED const rdb_protocol_t::rget_read_t &rget);
         void NORETURN operator()(UNUSED const rdb_protocol_t::distribution_read_t &dg);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_list_t &sl);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_status_t &ss);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::changefeed_subscribe_t &s);
 
         read_visitor_t(std::map<store_key_t, scoped_cJSON_t*> *_data, rdb_protocol_t::read_response_t *_response);
 
@@ -0,0 +1,188 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stddef.h>
+#include <stdio.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/shards.hpp"
+#include "rdb_protocol/term.hpp"
+#include "rdb_protocol/val.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/microbench.hpp"
+#include "unittest/rdb_env.hpp"
+#include "unittest/unittest_utils.hpp"
+
+// tcmalloc's hooks, which we use to count allocations.  They're weak so that a
+// build without tcmalloc still links; then they're NULL and we don't count.
+extern "C" {
+typedef void (*MallocHook_NewHook)(const void *ptr, size_t size);
+int MallocHook_AddNewHook(MallocHook_NewHook hook) __attribute__((weak));
+int MallocHook_RemoveNewHook(MallocHook_NewHook hook) __attribute__((weak));
+}
+
+namespace unittest {
+
+/* These time the evaluation of queries over a synthetic in-memory dataset, without
+the network, the protobuf parsing or the storage engine.  The dataset is a literal
+array of `RDB_MICROBENCH_ROWS` documents that looks like
+
+    {id: i, group: i % 16, value: (i * 7919) % 10000, ref: "r<i % 1000>",
+     name: "row <i>"}
+
+and the eq_join benchmark joins it against a mock table of 1000 documents.  Each
+benchmark prints its rows per second and, when we're linked against tcmalloc,
+the number of allocations made per input row. */
+
+const int RDB_MICROBENCH_ROWS = 10000;
+const int RDB_MICROBENCH_JOIN_ROWS = 1000;
+
+static int64_t rdb_microbench_allocations = 0;
+
+static void count_allocation(UNUSED const void *ptr, UNUSED size_t size) {
+    __sync_fetch_and_add(&rdb_microbench_allocations, 1);
+}
+
+static counted_t<const ql::datum_t> rdb_microbench_dataset() {
+    std::vector<counted_t<const ql::datum_t> > rows;
+    for (int i = 0; i < RDB_MICROBENCH_ROWS; ++i) {
+        std::map<std::string, counted_t<const ql::datum_t> > row;
+        row["id"] = make_counted<const ql::datum_t>(static_cast<double>(i));
+        row["group"] = make_counted<const ql::datum_t>(static_cast<double>(i % 16));
+        row["value"] = make_counted<const ql::datum_t>(
+            static_cast<double>((i * 7919) % 10000));
+        row["ref"] = make_counted<const ql::datum_t>(
+            strprintf("r%d", i % RDB_MICROBENCH_JOIN_ROWS));
+        row["name"] = make_counted<const ql::datum_t>(strprintf("row %d", i));
+        rows.push_back(make_counted<const ql::datum_t>(std::move(row)));
+    }
+    return make_counted<const ql::datum_t>(std::move(rows));
+}
+
+// The dataset, as a term.
+static ql::r::reql_t rows() {
+    return ql::r::expr(rdb_microbench_dataset());
+}
+
+// The argument of a `row_fun()`.
+static ql::r::reql_t row() {
+    return ql::r::var(ql::sym_t(1));
+}
+
+static ql::r::reql_t row_fun(ql::r::reql_t &&body) {
+    return ql::r::reql_t(Term::FUNC, ql::r::array(1.0), std::move(body));
+}
+
+// Evaluates the query and reads all of the result, returning how many rows (or
+// groups) it had.
+static size_t run_query(ql::env_t *env, const counted_t<ql::term_t> &term) {
+    ql::scope_env_t scope_env(env, ql::var_scope_t());
+    counted_t<ql::val_t> val = term->eval(&scope_env);
+    if (val->get_type().is_convertible(ql::val_t::type_t::DATUM)) {
+        UNUSED counted_t<const ql::datum_t> d = val->as_datum();
+        return 1;
+    } else if (val->get_type().is_convertible(ql::val_t::type_t::SEQUENCE)) {
+        counted_t<ql::datum_stream_t> seq = val->as_seq(env);
+        const ql::batchspec_t batchspec
+            = ql::batchspec_t::user(ql::batch_type_t::NORMAL, env);
+        size_t count = 0;
+        for (;;) {
+            std::vector<counted_t<const ql::datum_t> > batch
+                = seq->next_batch(env, batchspec);
+            if (batch.empty()) {
+                return count;
+            }
+            count += batch.size();
+        }
+    } else {
+        guarantee(val->get_type().is_convertible(ql::val_t::type_t::GROUPED_DATA));
+        return val->as_grouped_data()->size();
+    }
+}
+
+static void bench_query_in_pool(test_rdb_env_t *test_env,
+                                const char *name,
+                                const ql::protob_t<const Term> &query,
+                                size_t expected_result_size) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance;
+    test_env->make_env(&env_instance);
+    ql::env_t *env = env_instance->get();
+
+    ql::compile_env_t compile_env((ql::var_visibility_t()));
+    counted_t<ql::term_t> term = ql::compile_term(&compile_env, query);
+    ASSERT_EQ(expected_result_size, run_query(env, term));
+
+    const double ns_per_row = run_microbench(name, RDB_MICROBENCH_ROWS, [&] () {
+        run_query(env, term);
+    });
+
+    if (MallocHook_AddNewHook != NULL && MallocHook_RemoveNewHook != NULL) {
+        rdb_microbench_allocations = 0;
+        MallocHook_AddNewHook(&count_allocation);
+        run_query(env, term);
+        MallocHook_RemoveNewHook(&count_allocation);
+        printf("%-32s %12.0f rows/s  %8.1f allocations/row\n", name,
+               1e9 / ns_per_row,
+               static_cast<double>(rdb_microbench_allocations) / RDB_MICROBENCH_ROWS);
+    } else {
+        printf("%-32s %12.0f rows/s\n", name, 1e9 / ns_per_row);
+    }
+}
+
+static void bench_query(const char *name,
+                        ql::r::reql_t &&query,
+                        size_t expected_result_size) {
+    test_rdb_env_t test_env;
+    database_id_t db_id = test_env.add_database("db");
+    std::set<std::map<std::string, std::string> > join_rows;
+    for (int i = 0; i < RDB_MICROBENCH_JOIN_ROWS; ++i) {
+        std::map<std::string, std::string> join_row;
+        join_row["id"] = strprintf("r%d", i);
+        join_row["label"] = strprintf("label %d", i);
+        join_rows.insert(join_row);
+    }
+    test_env.add_table("joined", db_id, "id", join_rows);
+
+    ql::protob_t<const Term> term = query.release_counted();
+    run_in_thread_pool(std::bind(&bench_query_in_pool,
+                                 &test_env, name, term, expected_result_size));
+}
+
+TEST(Microbench, DISABLED_QueryFilter) {
+    bench_query("query filter",
+                rows().filter(row_fun(row()[std::string("value")] < 2500.0)),
+                RDB_MICROBENCH_ROWS / 4);
+}
+
+TEST(Microbench, DISABLED_QueryMap) {
+    bench_query("query map",
+                rows().map(row_fun(row()[std::string("value")]
+                                   + row()[std::string("group")])),
+                RDB_MICROBENCH_ROWS);
+}
+
+TEST(Microbench, DISABLED_QueryGroupCount) {
+    bench_query("query group/count",
+                ql::r::reql_t(Term::COUNT,
+                              ql::r::reql_t(Term::GROUP, rows(), std::string("group"))),
+                16);
+}
+
+TEST(Microbench, DISABLED_QueryOrderBy) {
+    bench_query("query order_by",
+                ql::r::reql_t(Term::ORDERBY, rows(), std::string("value")),
+                RDB_MICROBENCH_ROWS);
+}
+
+TEST(Microbench, DISABLED_QueryEqJoin) {
+    bench_query("query eq_join",
+                ql::r::reql_t(Term::EQ_JOIN, rows(), std::string("ref"),
+                              ql::r::reql_t(Term::TABLE, ql::r::db("db"),
+                                            std::string("joined"))),
+                RDB_MICROBENCH_ROWS);
+}
+
+}  // namespace unittest
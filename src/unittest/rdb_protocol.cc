@@ -80,7 +80,7 @@ void run_with_namespace_interface(boost::function<void(namespace_interface_t<rdb
     for (size_t i = 0; i < store_shards.size(); ++i) {
         underlying_stores.push_back(
                 new rdb_protocol_t::store_t(serializers[i].get(),
-                    temp_files[i].name().permanent_path(), GIGABYTE, true,
+                    temp_files[i].name().permanent_path(), GIGABYTE, NULL, true,
                     &get_global_perfmon_collection(), &ctx,
                     &io_backender, base_path_t(".")));
     }
@@ -166,7 +166,11 @@ TEST(RDBProtocol, OvershardedGetSet) {
 }
 
 std::string create_sindex(namespace_interface_t<rdb_protocol_t> *nsi,
-                          order_source_t *osource) {
+                          order_source_t *osource,
+                          const std::vector<std::string> &covered_fields
+                              = std::vector<std::string>(),
+                          bool counting = false,
+                          const std::string &expiry_pkey = "") {
     std::string id = uuid_to_str(generate_uuid());
 
     const ql::sym_t arg(1);
@@ -174,7 +178,7 @@ std::string create_sindex(namespace_interface_t<rdb_protocol_t> *nsi,
 
     ql::map_wire_func_t m(mapping, make_vector(arg), get_backtrace(mapping));
 
-    rdb_protocol_t::write_t write(rdb_protocol_t::sindex_create_t(id, m, sindex_multi_bool_t::SINGLE), profile_bool_t::PROFILE);
+    rdb_protocol_t::write_t write(rdb_protocol_t::sindex_create_t(id, m, sindex_multi_bool_t::SINGLE, covered_fields, counting, expiry_pkey), profile_bool_t::PROFILE);
     rdb_protocol_t::write_response_t response;
 
     cond_t interruptor;
@@ -312,6 +316,280 @@ TEST(RDBProtocol, OvershardedSindexCreateDrop) {
     run_in_thread_pool_with_namespace_interface(&run_create_drop_sindex_test, true);
 }
 
+void run_covering_sindex_test(namespace_interface_t<rdb_protocol_t> *nsi,
+                              order_source_t *osource) {
+    std::vector<std::string> covered_fields;
+    covered_fields.push_back("sid");
+    covered_fields.push_back("id");
+    std::string id = create_sindex(nsi, osource, covered_fields);
+
+    nap(100);
+
+    std::shared_ptr<const scoped_cJSON_t> data(
+        new scoped_cJSON_t(cJSON_Parse(
+            "{\"id\" : 0, \"sid\" : 1, \"other\" : \"not covered\"}")));
+    ASSERT_TRUE(data->get());
+    counted_t<const ql::datum_t> d(
+        new ql::datum_t(cJSON_GetObjectItem(data->get(), "id")));
+    store_key_t pk = store_key_t(d->print_primary());
+
+    {
+        rdb_protocol_t::write_t write(
+            rdb_protocol_t::point_write_t(pk, make_counted<ql::datum_t>(*data)),
+            DURABILITY_REQUIREMENT_DEFAULT,
+            profile_bool_t::PROFILE);
+        rdb_protocol_t::write_response_t response;
+
+        cond_t interruptor;
+        nsi->write(write,
+                   &response,
+                   osource->check_in(
+                       "unittest::run_covering_sindex_test(rdb_protocol_t.cc-A"),
+                   &interruptor);
+        ASSERT_TRUE(boost::get<rdb_protocol_t::point_write_response_t>(
+                        &response.response) != NULL);
+    }
+
+    {
+        /* Reads through the index get the covered fields only. */
+        rdb_protocol_t::read_t read
+            = make_sindex_read(make_counted<ql::datum_t>(1.0), id);
+        rdb_protocol_t::read_response_t response;
+
+        cond_t interruptor;
+        nsi->read(read, &response, osource->check_in("unittest::run_covering_sindex_test(rdb_protocol_t.cc-A"), &interruptor);
+
+        rdb_protocol_t::rget_read_response_t *rget_resp
+            = boost::get<rdb_protocol_t::rget_read_response_t>(&response.response);
+        ASSERT_TRUE(rget_resp != NULL);
+        ql::stream_t *stream = boost::get<ql::stream_t>(&rget_resp->result);
+        ASSERT_TRUE(stream != NULL);
+        ASSERT_EQ(1u, stream->size());
+        scoped_cJSON_t expected(cJSON_Parse("{\"id\" : 0, \"sid\" : 1}"));
+        ASSERT_EQ(ql::datum_t(expected), *stream->at(0).data);
+    }
+
+    ASSERT_TRUE(drop_sindex(nsi, osource, id));
+}
+
+TEST(RDBProtocol, CoveringSindex) {
+    run_in_thread_pool_with_namespace_interface(&run_covering_sindex_test, false);
+}
+
+void write_row(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+               const char *json) {
+    counted_t<const ql::datum_t> row = make_counted<ql::datum_t>(
+        scoped_cJSON_t(cJSON_Parse(json)));
+    store_key_t pk(row->get("id")->print_primary());
+    rdb_protocol_t::write_t write(
+        rdb_protocol_t::point_write_t(pk, row, true),
+        DURABILITY_REQUIREMENT_DEFAULT,
+        profile_bool_t::PROFILE);
+    rdb_protocol_t::write_response_t response;
+
+    cond_t interruptor;
+    nsi->write(write, &response,
+               osource->check_in("unittest::write_row(rdb_protocol_t.cc-A"),
+               &interruptor);
+    ASSERT_TRUE(boost::get<rdb_protocol_t::point_write_response_t>(
+                    &response.response) != NULL);
+}
+
+// Returns the number of rows the counting index `id` has for `group`.
+double read_count(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+                  const std::string &id, double group) {
+    rdb_protocol_t::read_t read
+        = make_sindex_read(make_counted<ql::datum_t>(group), id);
+    rdb_protocol_t::read_response_t response;
+
+    cond_t interruptor;
+    nsi->read(read, &response,
+              osource->check_in("unittest::read_count(rdb_protocol_t.cc-A"),
+              &interruptor);
+
+    rdb_protocol_t::rget_read_response_t *rget_resp
+        = boost::get<rdb_protocol_t::rget_read_response_t>(&response.response);
+    EXPECT_TRUE(rget_resp != NULL);
+    ql::stream_t *stream = boost::get<ql::stream_t>(&rget_resp->result);
+    EXPECT_TRUE(stream != NULL);
+    // Each shard counts its own rows.
+    double count = 0;
+    for (auto it = stream->begin(); it != stream->end(); ++it) {
+        EXPECT_EQ(group, it->data->get("group")->as_num());
+        count += it->data->get("count")->as_num();
+    }
+    return count;
+}
+
+void run_counting_sindex_test(namespace_interface_t<rdb_protocol_t> *nsi,
+                              order_source_t *osource) {
+    // Rows already in the table are counted when the index is built.
+    write_row(nsi, osource, "{\"id\" : \"a\", \"sid\" : 1}");
+    write_row(nsi, osource, "{\"id\" : \"z\", \"sid\" : 1}");
+
+    std::string id = create_sindex(nsi, osource, std::vector<std::string>(), true);
+
+    nap(100);
+
+    EXPECT_EQ(2, read_count(nsi, osource, id, 1));
+
+    // Then every write updates the counts.
+    write_row(nsi, osource, "{\"id\" : \"b\", \"sid\" : 1}");
+    write_row(nsi, osource, "{\"id\" : \"z\", \"sid\" : 2}");
+    write_row(nsi, osource, "{\"id\" : \"c\"}");
+    EXPECT_EQ(2, read_count(nsi, osource, id, 1));
+    EXPECT_EQ(1, read_count(nsi, osource, id, 2));
+
+    {
+        rdb_protocol_t::write_t write(
+            rdb_protocol_t::point_delete_t(store_key_t(
+                make_counted<ql::datum_t>("z")->print_primary())),
+            DURABILITY_REQUIREMENT_DEFAULT, profile_bool_t::PROFILE);
+        rdb_protocol_t::write_response_t response;
+        cond_t interruptor;
+        nsi->write(write, &response,
+                   osource->check_in("unittest::run_counting_sindex_test(rdb_protocol_t.cc-A"),
+                   &interruptor);
+    }
+    // Groups without rows are gone.
+    EXPECT_EQ(0, read_count(nsi, osource, id, 2));
+
+    ASSERT_TRUE(drop_sindex(nsi, osource, id));
+}
+
+TEST(RDBProtocol, CountingSindex) {
+    run_in_thread_pool_with_namespace_interface(&run_counting_sindex_test, false);
+}
+
+bool row_exists(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+                const char *pk) {
+    rdb_protocol_t::read_t read(
+        rdb_protocol_t::point_read_t(store_key_t(
+            make_counted<ql::datum_t>(pk)->print_primary())),
+        profile_bool_t::PROFILE);
+    rdb_protocol_t::read_response_t response;
+
+    cond_t interruptor;
+    nsi->read(read, &response,
+              osource->check_in("unittest::row_exists(rdb_protocol_t.cc-A"),
+              &interruptor);
+    rdb_protocol_t::point_read_response_t *res
+        = boost::get<rdb_protocol_t::point_read_response_t>(&response.response);
+    EXPECT_TRUE(res != NULL);
+    return res->data->get_type() != ql::datum_t::R_NULL;
+}
+
+void run_expiry_sindex_test(namespace_interface_t<rdb_protocol_t> *nsi,
+                            order_source_t *osource) {
+    write_row(nsi, osource, "{\"id\" : \"past\", \"sid\" : "
+              "{\"$reql_type$\" : \"TIME\", \"epoch_time\" : 1, "
+              "\"timezone\" : \"+00:00\"}}");
+    write_row(nsi, osource, "{\"id\" : \"future\", \"sid\" : "
+              "{\"$reql_type$\" : \"TIME\", \"epoch_time\" : 4000000000, "
+              "\"timezone\" : \"+00:00\"}}");
+    write_row(nsi, osource, "{\"id\" : \"number\", \"sid\" : 1}");
+    write_row(nsi, osource, "{\"id\" : \"none\"}");
+
+    std::string id = create_sindex(nsi, osource, std::vector<std::string>(), false,
+                                   "id");
+
+    // Give the reapers of the stores a pass over the index.
+    nap(3 * EXPIRY_REAP_INTERVAL_MS);
+
+    // Only the row whose time has passed is gone.
+    EXPECT_FALSE(row_exists(nsi, osource, "past"));
+    EXPECT_TRUE(row_exists(nsi, osource, "future"));
+    EXPECT_TRUE(row_exists(nsi, osource, "number"));
+    EXPECT_TRUE(row_exists(nsi, osource, "none"));
+
+    ASSERT_TRUE(drop_sindex(nsi, osource, id));
+}
+
+TEST(RDBProtocol, ExpirySindex) {
+    run_in_thread_pool_with_namespace_interface(&run_expiry_sindex_test, false);
+}
+
+void upsert_row(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+                counted_t<const ql::datum_t> row) {
+    std::vector<counted_t<const ql::datum_t> > inserts(1, row);
+    rdb_protocol_t::write_t write(
+        rdb_protocol_t::batched_insert_t(std::move(inserts), "id", true, false),
+        DURABILITY_REQUIREMENT_DEFAULT,
+        profile_bool_t::PROFILE);
+    rdb_protocol_t::write_response_t response;
+
+    cond_t interruptor;
+    nsi->write(write, &response,
+               osource->check_in("unittest::upsert_row(rdb_protocol_t.cc-A"),
+               &interruptor);
+    ASSERT_TRUE(boost::get<counted_t<const ql::datum_t> >(&response.response) != NULL);
+}
+
+size_t count_sindex_rows(namespace_interface_t<rdb_protocol_t> *nsi,
+                         order_source_t *osource,
+                         const std::string &id, double value) {
+    rdb_protocol_t::read_t read = make_sindex_read(make_counted<ql::datum_t>(value), id);
+    rdb_protocol_t::read_response_t response;
+
+    cond_t interruptor;
+    nsi->read(read, &response,
+              osource->check_in("unittest::count_sindex_rows(rdb_protocol_t.cc-A"),
+              &interruptor);
+    rdb_protocol_t::rget_read_response_t *rget_resp
+        = boost::get<rdb_protocol_t::rget_read_response_t>(&response.response);
+    EXPECT_TRUE(rget_resp != NULL);
+    ql::stream_t *stream = boost::get<ql::stream_t>(&rget_resp->result);
+    EXPECT_TRUE(stream != NULL);
+    return stream->size();
+}
+
+counted_t<const ql::datum_t> make_big_row(double sid) {
+    ql::datum_ptr_t row(ql::datum_t::R_OBJECT);
+    UNUSED bool b = row.add("id", make_counted<ql::datum_t>("big"));
+    b = row.add("sid", make_counted<ql::datum_t>(sid));
+    b = row.add("padding", make_counted<ql::datum_t>(std::string(20000, 'p')));
+    return row.to_counted();
+}
+
+void run_patch_row_test(namespace_interface_t<rdb_protocol_t> *nsi,
+                        order_source_t *osource) {
+    std::string id = create_sindex(nsi, osource);
+    nap(100);
+
+    // The row is too big to be stored inline, and the update doesn't change its
+    // size, so it's written over in place.
+    upsert_row(nsi, osource, make_big_row(1));
+    upsert_row(nsi, osource, make_big_row(2));
+
+    rdb_protocol_t::read_t read(
+        rdb_protocol_t::point_read_t(store_key_t(
+            make_counted<ql::datum_t>("big")->print_primary())),
+        profile_bool_t::PROFILE);
+    rdb_protocol_t::read_response_t response;
+    cond_t interruptor;
+    nsi->read(read, &response,
+              osource->check_in("unittest::run_patch_row_test(rdb_protocol_t.cc-A"),
+              &interruptor);
+    rdb_protocol_t::point_read_response_t *res
+        = boost::get<rdb_protocol_t::point_read_response_t>(&response.response);
+    ASSERT_TRUE(res != NULL);
+    EXPECT_EQ(*make_big_row(2), *res->data);
+
+    // The index follows the row.
+    EXPECT_EQ(0u, count_sindex_rows(nsi, osource, id, 1));
+    EXPECT_EQ(1u, count_sindex_rows(nsi, osource, id, 2));
+
+    ASSERT_TRUE(drop_sindex(nsi, osource, id));
+}
+
+TEST(RDBProtocol, PatchRow) {
+    run_in_thread_pool_with_namespace_interface(&run_patch_row_test, false);
+}
+
+TEST(RDBProtocol, OvershardedPatchRow) {
+    run_in_thread_pool_with_namespace_interface(&run_patch_row_test, true);
+}
+
 std::set<std::string> list_sindexes(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource) {
     rdb_protocol_t::sindex_list_t l;
     rdb_protocol_t::read_t read(l, profile_bool_t::PROFILE);
@@ -0,0 +1,39 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+
+#include "rdb_protocol/regex_cache.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(RegexCacheTest, SharesCompiledPatterns) {
+    counted_t<const ql::compiled_regex_t> a = ql::get_compiled_regex("^a+b");
+    counted_t<const ql::compiled_regex_t> b = ql::get_compiled_regex("^a+b");
+    ASSERT_TRUE(a->get().ok());
+    EXPECT_EQ(a.get(), b.get());
+    EXPECT_TRUE(RE2::PartialMatch("aab", a->get()));
+
+    // Patterns that don't compile aren't kept, but still report their error.
+    counted_t<const ql::compiled_regex_t> bad = ql::get_compiled_regex("(");
+    EXPECT_FALSE(bad->get().ok());
+    EXPECT_NE(bad.get(), ql::get_compiled_regex("(").get());
+}
+
+TEST(RegexCacheTest, Prefix) {
+    std::string prefix;
+    ASSERT_TRUE(ql::get_regex_prefix("^foo", &prefix));
+    EXPECT_EQ("foo", prefix);
+    ASSERT_TRUE(ql::get_regex_prefix("^fo.bar", &prefix));
+    EXPECT_EQ("fo", prefix);
+    ASSERT_TRUE(ql::get_regex_prefix("^fo?", &prefix));
+    EXPECT_EQ("f", prefix);
+    ASSERT_TRUE(ql::get_regex_prefix("^a\\.b\\d", &prefix));
+    EXPECT_EQ("a.b", prefix);
+
+    EXPECT_FALSE(ql::get_regex_prefix("foo", &prefix));
+    EXPECT_FALSE(ql::get_regex_prefix("^foo|bar", &prefix));
+    EXPECT_FALSE(ql::get_regex_prefix("^f*", &prefix));
+    EXPECT_FALSE(ql::get_regex_prefix("^[a-z]", &prefix));
+}
+
+}  // namespace unittest
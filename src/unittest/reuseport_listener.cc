@@ -0,0 +1,77 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <set>
+#include <vector>
+
+#include "arch/io/network.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class accept_counter_t {
+public:
+    explicit accept_counter_t(int num_threads)
+        : home_thread(get_thread_id()), counts(num_threads, 0) { }
+
+    void on_connection(scoped_ptr_t<linux_tcp_conn_descriptor_t> &nconn) {
+        scoped_ptr_t<linux_tcp_conn_t> conn;
+        nconn->make_overcomplicated(&conn);
+        // Connections must be served on the thread that accepted them.
+        EXPECT_EQ(conn->home_thread(), get_thread_id());
+        const threadnum_t thread = get_thread_id();
+        on_thread_t th(home_thread);
+        ++counts[thread.threadnum];
+    }
+
+    const threadnum_t home_thread;
+    std::vector<int> counts;
+};
+
+void run_reuseport_test() {
+    if (!tcp_reuse_port_is_supported()) {
+        return;
+    }
+
+    const int num_threads = 2;
+    accept_counter_t counter(num_threads);
+    linux_reuseport_tcp_listener_t listener(
+        get_unittest_addresses(), 0, num_threads,
+        std::bind(&accept_counter_t::on_connection, &counter, std::placeholders::_1));
+    ASSERT_NE(0, listener.get_port());
+
+    const int num_connections = 64;
+    scoped_array_t<scoped_fd_t> socks(num_connections);
+    for (int i = 0; i < num_connections; ++i) {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(listener.get_port());
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socks[i].reset(::socket(AF_INET, SOCK_STREAM, 0));
+        ASSERT_NE(INVALID_FD, socks[i].get());
+        int res = ::connect(socks[i].get(), reinterpret_cast<sockaddr *>(&addr),
+                            sizeof(addr));
+        ASSERT_EQ(0, res);
+    }
+
+    let_stuff_happen();
+
+    int total = 0;
+    for (int i = 0; i < num_threads; ++i) {
+        total += counter.counts[i];
+    }
+    EXPECT_EQ(num_connections, total);
+}
+
+TEST(ReuseportListener, AcceptsOnEveryThread) {
+    run_in_thread_pool(&run_reuseport_test, 2);
+}
+
+}  // namespace unittest
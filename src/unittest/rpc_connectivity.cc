@@ -24,20 +24,13 @@ public:
         sequence_number(0)
         { }
     void send(int message, peer_id_t peer) {
-        class writer_t : public send_message_write_callback_t {
-        public:
-            explicit writer_t(int _data) : data(_data) { }
-            virtual ~writer_t() { }
-            void write(write_stream_t *stream) {
-                write_message_t msg;
-                msg << data;
-                int res = send_write_message(stream, &msg);
-                if (res) { throw fake_archive_exc_t(); }
-            }
-            int32_t data;
-        } writer(message);
+        writer_t writer(message);
         service->send_message(peer, &writer);
     }
+    void send_striped(int message, uint64_t stripe, peer_id_t peer) {
+        writer_t writer(message);
+        service->send_striped_message(peer, stripe, &writer);
+    }
     void expect(int message, peer_id_t peer) {
         expect_delivered(message);
         assert_thread();
@@ -59,6 +52,19 @@ public:
     }
 
 private:
+    class writer_t : public send_message_write_callback_t {
+    public:
+        explicit writer_t(int _data) : data(_data) { }
+        virtual ~writer_t() { }
+        void write(write_stream_t *stream) {
+            write_message_t msg;
+            msg << data;
+            int res = send_write_message(stream, &msg);
+            if (res) { throw fake_archive_exc_t(); }
+        }
+        int32_t data;
+    };
+
     void on_message(peer_id_t peer, read_stream_t *stream) {
         int i;
         int res = deserialize(stream, &i);
@@ -137,6 +143,32 @@ TEST(RPCConnectivityTest, MesssageMultiThread) {
     unittest::run_in_thread_pool(&run_message_test, 3);
 }
 
+/* `LocalSocket` is like `Message`, but the nodes listen on all addresses, so
+they connect to each other over their local sockets. */
+
+void run_local_socket_test() {
+    connectivity_cluster_t c1, c2;
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, std::set<ip_address_t>(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, std::set<ip_address_t>(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+    cr2.join(c1.get_peer_address(c1.get_me()));
+
+    let_stuff_happen();
+
+    a1.send(873, c2.get_me());
+    a2.send(66663, c1.get_me());
+    a2.send_striped(4321, 7, c1.get_me());
+
+    let_stuff_happen();
+
+    a2.expect(873, c1.get_me());
+    a1.expect(66663, c2.get_me());
+    a1.expect(4321, c2.get_me());
+}
+TEST(RPCConnectivityTest, LocalSocket) {
+    unittest::run_in_thread_pool(&run_local_socket_test);
+}
+
 /* `UnreachablePeer` tests that messages sent to unreachable peers silently
 fail. */
 
@@ -208,6 +240,44 @@ TEST(RPCConnectivityTest, OrderingMultiThread) {
     unittest::run_in_thread_pool(&run_ordering_test, 3);
 }
 
+/* `StripedOrdering` tests that striped messages arrive in the same order they
+were sent if they have the same stripe, whichever connection the stripe maps to,
+and that the messages of all stripes arrive. */
+
+void run_striped_ordering_test() {
+    connectivity_cluster_t c1, c2;
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    const int num_stripes = CLUSTER_STRIPED_CONNECTIONS + 1;
+    for (int i = 0; i < 10; i++) {
+        for (int stripe = 0; stripe < num_stripes; ++stripe) {
+            a1.send_striped(i * num_stripes + stripe, stripe, c2.get_me());
+            a2.send_striped(i * num_stripes + stripe, stripe, c1.get_me());
+        }
+    }
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 9; i++) {
+        for (int stripe = 0; stripe < num_stripes; ++stripe) {
+            a1.expect_order(i * num_stripes + stripe, (i + 1) * num_stripes + stripe);
+            a2.expect_order(i * num_stripes + stripe, (i + 1) * num_stripes + stripe);
+        }
+    }
+}
+TEST(RPCConnectivityTest, StripedOrdering) {
+    unittest::run_in_thread_pool(&run_striped_ordering_test);
+}
+TEST(RPCConnectivityTest, StripedOrderingMultiThread) {
+    unittest::run_in_thread_pool(&run_striped_ordering_test, 3);
+}
+
 /* `GetPeersList` confirms that the behavior of `cluster_t::get_peers_list()` is
 correct. */
 
@@ -558,6 +628,70 @@ TEST(RPCConnectivityTest, BinaryDataMultiThread) {
     unittest::run_in_thread_pool(&run_binary_data_test, 3);
 }
 
+/* `LargeMessage` sends a `write_message_t` made of more buffers than a single
+`writev()` call accepts, so it has to go out in several partial writes. */
+
+class large_message_test_application_t : public message_handler_t {
+public:
+    static const int64_t message_size = 5 * MEGABYTE + 123;
+
+    explicit large_message_test_application_t(message_service_t *s) :
+        service(s),
+        got_message(false)
+        { }
+    void send_large_message(peer_id_t peer) {
+        class large_message_writer_t : public send_message_write_callback_t {
+        public:
+            virtual ~large_message_writer_t() { }
+            void write(write_stream_t *stream) {
+                write_message_t msg;
+                for (int64_t i = 0; i < message_size; ++i) {
+                    char c = static_cast<char>(i % 251);
+                    msg.append(&c, 1);
+                }
+                int res = send_write_message(stream, &msg);
+                if (res) { throw fake_archive_exc_t(); }
+            }
+        } writer;
+        service->send_message(peer, &writer);
+    }
+    void on_message(peer_id_t, read_stream_t *stream) {
+        std::vector<char> data(message_size);
+        int64_t res = force_read(stream, data.data(), message_size);
+        if (res != message_size) { throw fake_archive_exc_t(); }
+
+        for (int64_t i = 0; i < message_size; ++i) {
+            if (data[i] != static_cast<char>(i % 251)) {
+                ADD_FAILURE() << "Byte " << i << " is corrupted.";
+                break;
+            }
+        }
+        got_message = true;
+    }
+    message_service_t *service;
+    bool got_message;
+};
+
+void run_large_message_test() {
+
+    connectivity_cluster_t c1, c2;
+    large_message_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    a1.send_large_message(c2.get_me());
+
+    let_stuff_happen();
+
+    EXPECT_TRUE(a2.got_message);
+}
+TEST(RPCConnectivityTest, LargeMessage) {
+    unittest::run_in_thread_pool(&run_large_message_test);
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 
 void run_peer_id_semantics_test() {
@@ -2,7 +2,9 @@
 #include "unittest/gtest.hpp"
 
 #include "arch/timing.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rpc/connectivity/cluster.hpp"
+#include "rpc/directory/delta.hpp"
 #include "rpc/directory/read_manager.hpp"
 #include "rpc/directory/write_manager.hpp"
 #include "unittest/unittest_utils.hpp"
@@ -92,6 +94,69 @@ TEST(RPCDirectoryTest, Update) {
     unittest::run_in_thread_pool(&run_update_test, 1);
 }
 
+/* `Delta` tests that directory deltas turn the old serialized value into the
+new one, and that they only apply to the value they were computed against. */
+
+std::vector<char> make_delta_test_data(const std::string &s) {
+    return std::vector<char>(s.begin(), s.end());
+}
+
+void check_delta(const std::string &old_string, const std::string &new_string) {
+    std::vector<char> old_data = make_delta_test_data(old_string);
+    std::vector<char> new_data = make_delta_test_data(new_string);
+    directory_delta_t delta(old_data, new_data);
+    EXPECT_LE(delta.size(), new_data.size());
+
+    write_message_t msg;
+    msg << delta;
+    vector_stream_t stream;
+    ASSERT_EQ(0, send_write_message(&stream, &msg));
+    std::vector<char> serialized;
+    stream.swap(&serialized);
+    vector_read_stream_t read_stream(std::move(serialized));
+    directory_delta_t received;
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &received));
+
+    std::vector<char> result;
+    ASSERT_TRUE(received.apply(old_data, &result));
+    EXPECT_EQ(new_string, std::string(result.begin(), result.end()));
+}
+
+TEST(RPCDirectoryTest, Delta) {
+    check_delta("", "");
+    check_delta("", "abc");
+    check_delta("abc", "");
+    check_delta("abcdef", "abcdef");
+    check_delta("abcdef", "abXYef");
+    check_delta("abcdef", "abcXYZdef");
+    check_delta("abcXYZdef", "abcdef");
+    check_delta("aaaa", "aaaaaa");
+    check_delta("aaaaaa", "aaaa");
+    check_delta("abcdef", "XYZ");
+
+    std::vector<char> old_data = make_delta_test_data("abcdef");
+    directory_delta_t delta(old_data, make_delta_test_data("abXYef"));
+    EXPECT_EQ(2u, delta.size());
+    std::vector<char> result;
+    EXPECT_FALSE(delta.apply(make_delta_test_data("abcdefg"), &result));
+
+    std::string big_value(10000, 'x');
+    std::string changed_value = big_value;
+    changed_value[5000] = 'y';
+    directory_update_t update(8, make_delta_test_data(big_value),
+                              make_delta_test_data(changed_value));
+    EXPECT_FALSE(update.apply(6, make_delta_test_data(big_value), &result));
+    ASSERT_TRUE(update.apply(7, make_delta_test_data(big_value), &result));
+    EXPECT_EQ(changed_value, std::string(result.begin(), result.end()));
+
+    /* An update that isn't much smaller as a delta carries the whole value, so
+    it applies to anything. */
+    directory_update_t full_update(8, make_delta_test_data("abc"),
+                                   make_delta_test_data("XYZ"));
+    ASSERT_TRUE(full_update.apply(3, make_delta_test_data("ab"), &result));
+    EXPECT_EQ("XYZ", std::string(result.begin(), result.end()));
+}
+
 /* `DestructorRace` tests a nasty race condition that we had at some point. */
 
 void run_destructor_race_test() {
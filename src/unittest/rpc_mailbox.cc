@@ -201,4 +201,39 @@ TEST(RPCMailboxTest, TypedMailboxMultiThread) {
     unittest::run_in_thread_pool(&run_typed_mailbox_test, 3);
 }
 
+/* `MailboxBurstMultiThread` sends a burst of messages from another node to a
+mailbox that isn't on the thread they arrive on. They're passed on to the mailbox's
+thread together, and must still arrive in order. */
+
+void run_mailbox_burst_test() {
+    connectivity_cluster_t c1, c2;
+    mailbox_manager_t m1(&c1), m2(&c2);
+    connectivity_cluster_t::run_t r1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m1, 0, NULL);
+    connectivity_cluster_t::run_t r2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m2, 0, NULL);
+    r1.join(c2.get_peer_address(c2.get_me()));
+    let_stuff_happen();
+
+    for (int thread = 0; thread < get_num_threads(); ++thread) {
+        on_thread_t thread_switcher((threadnum_t(thread)));
+
+        std::vector<std::string> inbox;
+        mailbox_t<void(std::string)> mbox(&m1, boost::bind(&string_push_back, &inbox, _1));
+        mailbox_addr_t<void(std::string)> addr = mbox.get_address();
+
+        for (int i = 0; i < 100; ++i) {
+            send(&m2, addr, strprintf("%d", i));
+        }
+
+        let_stuff_happen();
+
+        ASSERT_EQ(100u, inbox.size());
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(strprintf("%d", i), inbox[i]);
+        }
+    }
+}
+TEST(RPCMailboxTest, MailboxBurstMultiThread) {
+    unittest::run_in_thread_pool(&run_mailbox_burst_test, 3);
+}
+
 }   /* namespace unittest */
@@ -28,6 +28,10 @@ inline void semilattice_join(sl_int_t *a, sl_int_t b) {
     a->i |= b.i;
 }
 
+inline bool operator==(sl_int_t a, sl_int_t b) {
+    return a.i == b.i;
+}
+
 class sl_pair_t {
 public:
     sl_pair_t(sl_int_t _x, sl_int_t _y) : x(_x), y(_y) { }
@@ -281,6 +285,33 @@ TEST(RPCSemilatticeTest, MemberViewMultiThread) {
     unittest::run_in_thread_pool(&run_member_view_test, 3);
 }
 
+/* `Changes` tests that `semilattice_changes()` on a map only keeps the entries
+that are different, and that joining them has the same result as joining all. */
+
+TEST(RPCSemilatticeTest, Changes) {
+    std::map<std::string, sl_int_t> base;
+    base["foo"] = sl_int_t(8);
+    base["bar"] = sl_int_t(1);
+
+    std::map<std::string, sl_int_t> added = base;
+    added["bar"] = sl_int_t(2);
+    added["baz"] = sl_int_t(4);
+
+    std::map<std::string, sl_int_t> changes;
+    semilattice_changes(base, added, &changes);
+    ASSERT_EQ(2u, changes.size());
+    EXPECT_EQ(0u, changes.count("foo"));
+    EXPECT_EQ(2u, changes["bar"].i);
+    EXPECT_EQ(4u, changes["baz"].i);
+
+    std::map<std::string, sl_int_t> joined_changes = base;
+    semilattice_join(&joined_changes, changes);
+    std::map<std::string, sl_int_t> joined_all = base;
+    semilattice_join(&joined_all, added);
+    EXPECT_TRUE(joined_changes == joined_all);
+    EXPECT_EQ(3u, joined_changes["bar"].i);
+}
+
 }   /* namespace unittest */
 
 #include "rpc/semilattice/semilattice_manager.tcc"
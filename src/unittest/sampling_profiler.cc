@@ -0,0 +1,74 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/sampling_profiler.hpp"
+#include "arch/timing.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void run_records_samples_test() {
+    sampling_profiler_t *profiler = &sampling_profiler_t::get_global_profiler();
+    profiler->reset();
+    profiler->set_enabled(true);
+    for (int i = 0; i < 20 * SAMPLING_PROFILER_PERIOD; ++i) {
+        coro_t::yield();
+    }
+    profiler->set_enabled(false);
+    // Let the last sampled wait finish.
+    coro_t::yield();
+
+    sampling_profiler_t::report_t report;
+    profiler->get_report(&report);
+    int64_t runs = 0, waits = 0;
+    for (auto it = report.begin(); it != report.end(); ++it) {
+        runs += it->second.run_time.count;
+        waits += it->second.wait_time.count;
+    }
+    EXPECT_LE(10, runs);
+    EXPECT_LE(10, waits);
+    EXPECT_LE(waits, runs);
+
+    profiler->reset();
+    profiler->get_report(&report);
+    EXPECT_TRUE(report.empty());
+}
+
+TEST(SamplingProfiler, RecordsSamples) {
+    run_in_thread_pool(&run_records_samples_test);
+}
+
+void run_disabled_records_nothing_test() {
+    sampling_profiler_t *profiler = &sampling_profiler_t::get_global_profiler();
+    profiler->reset();
+    for (int i = 0; i < 20 * SAMPLING_PROFILER_PERIOD; ++i) {
+        coro_t::yield();
+    }
+    sampling_profiler_t::report_t report;
+    profiler->get_report(&report);
+    EXPECT_TRUE(report.empty());
+}
+
+TEST(SamplingProfiler, DisabledRecordsNothing) {
+    run_in_thread_pool(&run_disabled_records_nothing_test);
+}
+
+void run_coro_run_timer_test() {
+    coro_run_timer_t outer;
+    // Waiting doesn't count.  (Ticks are nanoseconds.)
+    nap(100);
+    EXPECT_GT(50 * MILLION, outer.get_run_time());
+
+    coro_run_timer_t inner;
+    const ticks_t spin_until = get_ticks() + 20 * MILLION;
+    while (get_ticks() < spin_until) { }
+    nap(10);
+    EXPECT_LE(20 * MILLION, inner.get_run_time());
+    EXPECT_LE(inner.get_run_time(), outer.get_run_time());
+}
+
+TEST(SamplingProfiler, CoroRunTimer) {
+    run_in_thread_pool(&run_coro_run_timer_test);
+}
+
+}  // namespace unittest
@@ -1,7 +1,12 @@
 #include <functional>
+#include <map>
 
 #include "arch/runtime/starter.hpp"
+#include "arch/timing.hpp"
 #include "serializer/config.hpp"
+#include "serializer/log/block_checksum.hpp"
+#include "serializer/log/log_serializer.hpp"
+#include "serializer/log/tiered_file.hpp"
 #include "unittest/mock_file.hpp"
 #include "unittest/gtest.hpp"
 
@@ -86,5 +91,224 @@ TEST(SerializerTest, AddDeleteRepeatedlyWithIndex) {
     run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, true), 4);
 }
 
+struct io_cond_t : public iocallback_t, public cond_t {
+    void on_io_complete() {
+        pulse();
+    }
+};
+
+void run_TieredFileRoutesByOffset() {
+    std::vector<char> hot_data;
+    std::vector<char> cold_data;
+    scoped_ptr_t<file_t> hot_file(new mock_file_t(mock_file_t::mode_rw, &hot_data));
+    scoped_ptr_t<file_t> cold_file(new mock_file_t(mock_file_t::mode_rw, &cold_data));
+    tiered_file_t file(std::move(hot_file), std::move(cold_file));
+
+    file.set_size_at_least(DEVICE_BLOCK_SIZE);
+    file.cold_file()->set_size_at_least(2 * DEVICE_BLOCK_SIZE);
+    ASSERT_EQ(static_cast<int64_t>(DEVICE_BLOCK_SIZE), file.get_size());
+
+    const int64_t cold_offset
+        = ls_block_token_pointee_t::cold_tier_offset_base + DEVICE_BLOCK_SIZE;
+    scoped_malloc_t<char> buf(malloc_aligned(DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
+    scoped_ptr_t<file_account_t> account(new file_account_t(&file, 1));
+
+    memset(buf.get(), 'h', DEVICE_BLOCK_SIZE);
+    {
+        io_cond_t cb;
+        file.write_async(0, DEVICE_BLOCK_SIZE, buf.get(), account.get(), &cb,
+                         file_t::NO_DATASYNCS);
+        cb.wait();
+    }
+    memset(buf.get(), 'c', DEVICE_BLOCK_SIZE);
+    {
+        io_cond_t cb;
+        file.write_async(cold_offset, DEVICE_BLOCK_SIZE, buf.get(), account.get(), &cb,
+                         file_t::NO_DATASYNCS);
+        cb.wait();
+    }
+
+    EXPECT_EQ('h', hot_data[0]);
+    EXPECT_EQ(0, cold_data[0]);
+    EXPECT_EQ('c', cold_data[DEVICE_BLOCK_SIZE]);
+
+    memset(buf.get(), 0, DEVICE_BLOCK_SIZE);
+    {
+        io_cond_t cb;
+        file.read_async(cold_offset, DEVICE_BLOCK_SIZE, buf.get(), DEFAULT_DISK_ACCOUNT,
+                        &cb);
+        cb.wait();
+    }
+    EXPECT_EQ('c', buf.get()[0]);
+}
+
+TEST(SerializerTest, TieredFileRoutesByOffset) {
+    run_in_thread_pool(run_TieredFileRoutesByOffset, 4);
+}
+
+// The GC tests look at where the log serializer puts blocks, which the semantic
+// checking serializer's tokens don't tell.
+#ifndef SEMANTIC_SERIALIZER_CHECK
+
+// The number of default-sized blocks in an extent.
+const block_id_t BLOCKS_PER_EXTENT = DEFAULT_EXTENT_SIZE / DEFAULT_BTREE_BLOCK_SIZE;
+
+// Writes the blocks `first` to `first + count - 1` and points the index at them.
+void write_gc_test_blocks(log_serializer_t *ser, file_account_t *account,
+                          block_id_t first, block_id_t count) {
+    std::vector<scoped_malloc_t<ser_buffer_t> > bufs;
+    std::vector<buf_write_info_t> infos;
+    for (block_id_t id = first; id < first + count; ++id) {
+        bufs.push_back(ser->malloc());
+        memset(bufs.back()->cache_data, 'a' + id % 26, ser->max_block_size().value());
+        infos.push_back(buf_write_info_t(bufs.back().get(), ser->max_block_size(), id));
+    }
+
+    io_cond_t cb;
+    std::vector<counted_t<ls_block_token_pointee_t> > tokens
+        = ser->block_writes(infos, account, &cb);
+    cb.wait();
+
+    std::vector<index_write_op_t> write_ops;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        write_ops.push_back(index_write_op_t(first + i, tokens[i],
+                                             repli_timestamp_t::distant_past));
+    }
+    ser->index_write(write_ops, account);
+}
+
+void delete_gc_test_blocks(log_serializer_t *ser, file_account_t *account,
+                           const std::vector<block_id_t> &block_ids) {
+    std::vector<index_write_op_t> write_ops;
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        write_ops.push_back(index_write_op_t(*it, counted_t<ls_block_token_pointee_t>()));
+    }
+    ser->index_write(write_ops, account);
+}
+
+// Whether the block at `offset` of the file has the checksum it should have.
+bool block_on_disk_is_sound(mock_file_opener_t *file_opener, int64_t offset,
+                            block_size_t block_size) {
+    scoped_malloc_t<ser_buffer_t> buf(malloc_aligned(block_size.ser_value(),
+                                                     DEVICE_BLOCK_SIZE));
+    memcpy(buf.get(), file_opener->file_contents()->data() + offset,
+           block_size.ser_value());
+    return block_checksum_matches(buf.get(), block_size);
+}
+
+void run_GcKeepsChecksumsOfCorruptBlocks() {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+    log_serializer_t::dynamic_config_t config;
+    // Reading the corrupted block would crash; only the GC may read it.
+    config.checksum_verification = block_checksum_verification_t::SCRUB_ONLY;
+    config.scrub_interval_secs = 0;
+    log_serializer_t ser(config, &file_opener, &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+    // Fill a few extents, damage block 0, and make everything but blocks 0 and 1
+    // garbage, so that their extent gets collected.
+    const block_id_t num_blocks = 4 * BLOCKS_PER_EXTENT;
+    write_gc_test_blocks(&ser, account.get(), 0, num_blocks);
+    const counted_t<ls_block_token_pointee_t> corrupt_token = ser.index_read(0);
+    const counted_t<ls_block_token_pointee_t> sound_token = ser.index_read(1);
+    const int64_t corrupt_offset = corrupt_token->offset();
+    const int64_t sound_offset = sound_token->offset();
+    const block_size_t block_size = corrupt_token->disk_block_size();
+    (*file_opener.file_contents())[corrupt_offset + sizeof(ls_buf_data_t) + 100] ^= 1;
+    ASSERT_FALSE(block_on_disk_is_sound(&file_opener, corrupt_offset, block_size));
+    ASSERT_TRUE(block_on_disk_is_sound(&file_opener, sound_offset, block_size));
+
+    std::vector<block_id_t> garbage;
+    for (block_id_t id = 2; id < num_blocks; ++id) {
+        garbage.push_back(id);
+    }
+    delete_gc_test_blocks(&ser, account.get(), garbage);
+
+    // Extents only get collected once they are no longer young, which takes new
+    // extents and some time.  Keep writing other blocks until the GC has moved
+    // ours.
+    for (int i = 0; i < 1000 && ser.index_read(0)->offset() == corrupt_offset; ++i) {
+        nap(5);
+        write_gc_test_blocks(&ser, account.get(), num_blocks, BLOCKS_PER_EXTENT);
+    }
+    const int64_t new_corrupt_offset = ser.index_read(0)->offset();
+    const int64_t new_sound_offset = ser.index_read(1)->offset();
+    ASSERT_NE(corrupt_offset, new_corrupt_offset);
+    ASSERT_NE(sound_offset, new_sound_offset);
+
+    // The corrupted block is still seen to be corrupted where the GC put it.
+    EXPECT_FALSE(block_on_disk_is_sound(&file_opener, new_corrupt_offset, block_size));
+    EXPECT_TRUE(block_on_disk_is_sound(&file_opener, new_sound_offset, block_size));
+}
+
+TEST(SerializerTest, GcKeepsChecksumsOfCorruptBlocks) {
+    run_in_thread_pool(run_GcKeepsChecksumsOfCorruptBlocks, 4);
+}
+
+void run_GcStaysWithinWriteAmplificationTarget() {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+    log_serializer_t::dynamic_config_t config;
+    // Below gc_high_ratio the GC may only rewrite (target - 1) bytes per byte we
+    // write.  The ratios keep it below gc_high_ratio, and keep it collecting until
+    // it's done.
+    const double target = 2.0;
+    config.gc_write_amplification_target = target;
+    config.gc_high_ratio = 0.9;
+    config.gc_low_ratio = 0.001;
+    config.gc_max_concurrent_extents = 1;
+    log_serializer_t ser(config, &file_opener, &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+    // Fill 32 extents, and then delete three quarters of the blocks in the first 16.
+    const block_id_t num_blocks = 32 * BLOCKS_PER_EXTENT;
+    write_gc_test_blocks(&ser, account.get(), 0, num_blocks);
+    std::vector<block_id_t> garbage;
+    std::map<block_id_t, int64_t> live_offsets;
+    for (block_id_t id = 0; id < num_blocks / 2; ++id) {
+        if (id % 4 == 0) {
+            live_offsets[id] = ser.index_read(id)->offset();
+        } else {
+            garbage.push_back(id);
+        }
+    }
+    delete_gc_test_blocks(&ser, account.get(), garbage);
+    const int64_t live_bytes = live_offsets.size() * DEFAULT_BTREE_BLOCK_SIZE;
+
+    // Write new blocks until the GC has moved all the live ones out of the 16
+    // extents.
+    const block_id_t batch_size = BLOCKS_PER_EXTENT / 4;
+    int64_t bytes_written = 0;
+    block_id_t next_id = num_blocks;
+    bool all_moved = false;
+    while (!all_moved && bytes_written <= 4 * live_bytes) {
+        nap(5);
+        write_gc_test_blocks(&ser, account.get(), next_id, batch_size);
+        next_id += batch_size;
+        bytes_written += batch_size * DEFAULT_BTREE_BLOCK_SIZE;
+
+        all_moved = true;
+        for (auto it = live_offsets.begin(); it != live_offsets.end(); ++it) {
+            if (ser.index_read(it->first)->offset() == it->second) {
+                all_moved = false;
+                break;
+            }
+        }
+    }
+
+    // The extents got collected, and the GC didn't rewrite more than the target
+    // lets it, give or take the extent of its last round.
+    ASSERT_TRUE(all_moved);
+    EXPECT_LE(live_bytes,
+              static_cast<int64_t>((target - 1) * bytes_written) + DEFAULT_EXTENT_SIZE);
+}
+
+TEST(SerializerTest, GcStaysWithinWriteAmplificationTarget) {
+    run_in_thread_pool(run_GcStaysWithinWriteAmplificationTarget, 4);
+}
+
+#endif  // SEMANTIC_SERIALIZER_CHECK
+
 
 }  // namespace unittest
@@ -0,0 +1,93 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/pmap.hpp"
+#include "concurrency/sharded_rwlock.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+struct sharded_read_after_write_state_t {
+    sharded_rwlock_t lock;
+    cond_t write_acquired;
+    cond_t write_released;
+    cond_t read_acquired;
+};
+
+void sharded_read_after_write_cases(sharded_read_after_write_state_t *s, int i) {
+    if (i == 0) {
+        {
+            sharded_rwlock_acq_t acq(&s->lock, access_t::write);
+            s->write_acquired.pulse();
+            // Give the reader on the other thread a chance to (wrongly) get in.
+            for (int j = 0; j < 10; ++j) {
+                nap(5);
+            }
+            ASSERT_FALSE(s->read_acquired.is_pulsed());
+        }
+        s->write_released.pulse();
+
+    } else if (i == 1) {
+        s->write_acquired.wait();
+        {
+            // The reader lives on a different thread from the writer, so this
+            // checks that the writer blocked out the other thread's shard.
+            on_thread_t th((threadnum_t(1)));
+            sharded_rwlock_acq_t acq(&s->lock, access_t::read);
+            s->read_acquired.pulse();
+        }
+        ASSERT_TRUE(s->write_released.is_pulsed());
+
+    } else {
+        unreachable();
+    }
+}
+
+void sharded_read_after_write() {
+    ASSERT_GE(get_num_threads(), 2);
+    sharded_read_after_write_state_t s;
+
+    pmap(2, std::bind(&sharded_read_after_write_cases, &s, ph::_1));
+}
+
+TEST(ShardedRwlockTest, ReadAfterWrite) {
+    run_in_thread_pool(&sharded_read_after_write, 2);
+}
+
+struct sharded_write_after_read_state_t {
+    sharded_rwlock_t lock;
+    cond_t reads_acquired;
+    cond_t reads_releasing;
+    cond_t write_acquired;
+};
+
+void sharded_write_after_read() {
+    sharded_write_after_read_state_t s;
+    {
+        sharded_rwlock_acq_t acq1(&s.lock, access_t::read);
+        // Readers on the same thread don't wait for each other.
+        sharded_rwlock_acq_t acq2(&s.lock, access_t::read);
+
+        coro_t::spawn_now_dangerously([&s]() {
+            sharded_rwlock_acq_t acq(&s.lock, access_t::write);
+            ASSERT_TRUE(s.reads_releasing.is_pulsed());
+            s.write_acquired.pulse();
+        });
+        nap(10);
+        ASSERT_FALSE(s.write_acquired.is_pulsed());
+        s.reads_releasing.pulse();
+    }
+    s.write_acquired.wait();
+}
+
+TEST(ShardedRwlockTest, WriteAfterRead) {
+    run_in_thread_pool(&sharded_write_after_read, 2);
+}
+
+}  // namespace unittest
@@ -0,0 +1,78 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sketches.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+void add_range(ql::hyperloglog_t *h, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        h->add(make_counted<const ql::datum_t>(static_cast<double>(i)));
+    }
+}
+
+TEST(SketchesTest, HyperLogLogSmall) {
+    ql::hyperloglog_t h;
+    EXPECT_EQ(0u, h.estimate());
+    add_range(&h, 0, 10);
+    add_range(&h, 0, 10);
+    EXPECT_EQ(10u, h.estimate());
+}
+
+TEST(SketchesTest, HyperLogLogMerge) {
+    ql::hyperloglog_t left, right, all;
+    add_range(&left, 0, 60000);
+    add_range(&right, 40000, 100000);
+    add_range(&all, 0, 100000);
+    left.merge(right);
+    EXPECT_EQ(all.estimate(), left.estimate());
+    EXPECT_LT(fabs(static_cast<double>(left.estimate()) - 100000), 5000);
+
+    // Merging an empty sketch changes nothing either way.
+    ql::hyperloglog_t empty;
+    empty.merge(all);
+    EXPECT_EQ(all.estimate(), empty.estimate());
+    all.merge(ql::hyperloglog_t());
+    EXPECT_EQ(empty.estimate(), all.estimate());
+}
+
+TEST(SketchesTest, TDigestQuantiles) {
+    std::vector<double> values;
+    for (int i = 0; i < 10000; ++i) {
+        values.push_back(i);
+    }
+    std::random_shuffle(values.begin(), values.end());
+
+    ql::tdigest_t digest;
+    EXPECT_TRUE(digest.empty());
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        digest.add(*it);
+    }
+    EXPECT_EQ(0, digest.quantile(0));
+    EXPECT_EQ(9999, digest.quantile(1));
+    EXPECT_LT(fabs(digest.quantile(0.5) - 5000), 100);
+    EXPECT_LT(fabs(digest.quantile(0.99) - 9900), 20);
+    EXPECT_LT(fabs(digest.quantile(0.001) - 10), 5);
+}
+
+TEST(SketchesTest, TDigestMerge) {
+    std::vector<ql::tdigest_t> digests(4);
+    for (int i = 0; i < 10000; ++i) {
+        digests[i % digests.size()].add(i);
+    }
+    ql::tdigest_t merged;
+    for (auto it = digests.begin(); it != digests.end(); ++it) {
+        merged.merge(*it);
+    }
+    EXPECT_EQ(0, merged.quantile(0));
+    EXPECT_EQ(9999, merged.quantile(1));
+    EXPECT_LT(fabs(merged.quantile(0.25) - 2500), 100);
+    EXPECT_LT(fabs(merged.quantile(0.75) - 7500), 100);
+}
+
+}  // namespace unittest
@@ -0,0 +1,29 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+static const ql::pb::dummy_var_t x = ql::pb::dummy_var_t::INNERJOIN_N;
+
+TEST(SlowQueryLogTest, ShapeLeavesOutData) {
+    ql::r::reql_t query = ql::r::db("test").call(Term::TABLE, "users").filter(
+        ql::r::fun(x, ql::r::var(x)["age"] > 18.0));
+    EXPECT_EQ("FILTER(TABLE(DB(?), ?), FUNC(MAKE_ARRAY(?), "
+              "GT(GET_FIELD(VAR(?), ?), ?)))",
+              query_shape(query.get()));
+
+    // The same query with other data has the same shape.
+    ql::r::reql_t other = ql::r::db("prod").call(Term::TABLE, "admins").filter(
+        ql::r::fun(x, ql::r::var(x)["age"] > 65.0));
+    EXPECT_EQ(query_shape(query.get()), query_shape(other.get()));
+}
+
+TEST(SlowQueryLogTest, ShapeHasOptargs) {
+    ql::r::reql_t query = ql::r::db("test").call(Term::TABLE,
+        "users", ql::r::optarg("use_outdated", true));
+    EXPECT_EQ("TABLE(DB(?), ?, use_outdated=?)", query_shape(query.get()));
+}
+
+}  // namespace unittest
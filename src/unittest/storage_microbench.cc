@@ -0,0 +1,335 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "repli_timestamp.hpp"
+#include "serializer/config.hpp"
+#include "serializer/log/lba/disk_format.hpp"
+#include "serializer/log/lba/in_memory_index.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/microbench.hpp"
+#include "unittest/mock_file.hpp"
+#include "unittest/unittest_utils.hpp"
+
+/* Microbenchmarks of the storage engine's hot paths, on an in-memory serializer
+where one is needed.  Every benchmark seeds its own `rng_t`, so that each run does
+the same work. */
+
+// A leaf node value: a length byte followed by that many bytes.
+struct microbench_value_t;
+
+template <>
+class value_sizer_t<microbench_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t<microbench_value_t>(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *reinterpret_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'm', 'b', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<microbench_value_t>);
+};
+
+namespace unittest {
+
+const int MICROBENCH_NODES = 100;
+const int MICROBENCH_VALUE_SIZE = 32;
+
+// Random keys of 8 to 24 characters, like short primary keys.
+std::vector<store_key_t> microbench_keys(rng_t *rng, size_t count) {
+    std::vector<store_key_t> keys;
+    for (size_t i = 0; i < count; ++i) {
+        std::string key = strprintf("%08d", rng->randint(100000000));
+        key.append(rng->randint(17), 'k');
+        keys.push_back(store_key_t(key));
+    }
+    return keys;
+}
+
+class microbench_leaves_t {
+public:
+    microbench_leaves_t()
+        : block_size_(block_size_t::unsafe_make(4096)), sizer_(block_size_) {
+        value_[0] = MICROBENCH_VALUE_SIZE;
+        memset(value_ + 1, 'v', MICROBENCH_VALUE_SIZE);
+        for (int i = 0; i < MICROBENCH_NODES; ++i) {
+            nodes_.push_back(make_scoped<scoped_malloc_t<leaf_node_t> >(block_size_.value()));
+        }
+
+        // As many keys as fit in one node.
+        rng_t rng(1);
+        init_nodes();
+        for (;;) {
+            store_key_t key = microbench_keys(&rng, 1)[0];
+            if (leaf::is_full(&sizer_, nodes_[0]->get(), key.btree_key(), value())) {
+                break;
+            }
+            insert(0, key);
+            keys_.push_back(key);
+        }
+    }
+
+    void init_nodes() {
+        for (int i = 0; i < MICROBENCH_NODES; ++i) {
+            leaf::init(&sizer_, nodes_[i]->get());
+        }
+    }
+
+    void fill_nodes() {
+        for (int i = 0; i < MICROBENCH_NODES; ++i) {
+            for (size_t j = 0; j < keys_.size(); ++j) {
+                insert(i, keys_[j]);
+            }
+        }
+    }
+
+    void insert(int i, const store_key_t &key) {
+        leaf::insert(&sizer_, nodes_[i]->get(), key.btree_key(), value(),
+                     repli_timestamp_t::distant_past,
+                     key_modification_proof_t::real_proof());
+    }
+
+    const microbench_value_t *value() const {
+        return reinterpret_cast<const microbench_value_t *>(value_);
+    }
+
+    value_sizer_t<microbench_value_t> *sizer() { return &sizer_; }
+    leaf_node_t *node(int i) { return nodes_[i]->get(); }
+    const std::vector<store_key_t> &keys() const { return keys_; }
+
+private:
+    block_size_t block_size_;
+    value_sizer_t<microbench_value_t> sizer_;
+    uint8_t value_[1 + MICROBENCH_VALUE_SIZE];
+    std::vector<scoped_ptr_t<scoped_malloc_t<leaf_node_t> > > nodes_;
+    std::vector<store_key_t> keys_;
+};
+
+TEST(Microbench, DISABLED_LeafInsert) {
+    microbench_leaves_t leaves;
+    run_microbench("leaf insert", MICROBENCH_NODES * leaves.keys().size(),
+                   [&] () { leaves.init_nodes(); },
+                   [&] () { leaves.fill_nodes(); });
+}
+
+TEST(Microbench, DISABLED_LeafLookup) {
+    microbench_leaves_t leaves;
+    leaves.init_nodes();
+    leaves.fill_nodes();
+    std::vector<store_key_t> keys = leaves.keys();
+    rng_t rng(2);
+    std::random_shuffle(keys.begin(), keys.end(),
+                        [&] (int n) { return rng.randint(n); });
+
+    uint8_t value_out[256];
+    run_microbench("leaf lookup", MICROBENCH_NODES * keys.size(), [&] () {
+        for (int i = 0; i < MICROBENCH_NODES; ++i) {
+            for (size_t j = 0; j < keys.size(); ++j) {
+                bool found = leaf::lookup(leaves.sizer(), leaves.node(i),
+                                          keys[j].btree_key(), value_out);
+                guarantee(found);
+            }
+        }
+    });
+}
+
+TEST(Microbench, DISABLED_InternalNodeLookup) {
+    const block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(block_size.value());
+    internal_node::init(block_size, node.get());
+
+    rng_t rng(3);
+    std::vector<store_key_t> keys = microbench_keys(&rng, 1000);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::random_shuffle(keys.begin(), keys.end(),
+                        [&] (int n) { return rng.randint(n); });
+    for (size_t i = 0; i < keys.size() && !internal_node::is_full(node.get()); ++i) {
+        internal_node::insert(block_size, node.get(), keys[i].btree_key(), i + 1, i + 2);
+    }
+
+    std::vector<store_key_t> lookups = microbench_keys(&rng, 10000);
+    run_microbench("internal node lookup", lookups.size(), [&] () {
+        block_id_t sum = 0;
+        for (size_t i = 0; i < lookups.size(); ++i) {
+            sum += internal_node::lookup(node.get(), lookups[i].btree_key());
+        }
+        guarantee(sum != NULL_BLOCK_ID);
+    });
+}
+
+// A cache on a serializer on a mock file, all in memory.
+class microbench_cache_t {
+public:
+    explicit microbench_cache_t(uint64_t memory_limit) {
+        standard_serializer_t::create(&opener_, standard_serializer_t::static_config_t());
+        serializer_.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
+                                                   &opener_,
+                                                   &get_global_perfmon_collection()));
+        alt_cache_config_t config;
+        config.page_config.memory_limit = memory_limit;
+        cache_.init(new cache_t(serializer_.get(), config, NULL,
+                                &get_global_perfmon_collection()));
+        conn_.init(new cache_conn_t(cache_.get()));
+    }
+
+    // Creates `count` blocks, and returns their ids.
+    std::vector<block_id_t> create_blocks(int count) {
+        std::vector<block_id_t> ids;
+        txn_t txn(conn_.get(), write_durability_t::SOFT, repli_timestamp_t::distant_past,
+                  count);
+        for (int i = 0; i < count; ++i) {
+            buf_lock_t lock(buf_parent_t(&txn), alt_create_t::create);
+            buf_write_t write(&lock);
+            memset(write.get_data_write(), i % 256, cache_->max_block_size().value());
+            ids.push_back(lock.block_id());
+        }
+        return ids;
+    }
+
+    // Acquires each block for read in turn, and reads a byte of it.
+    void read_blocks(const std::vector<block_id_t> &ids) {
+        txn_t txn(conn_.get(), read_access_t::read);
+        int sum = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            buf_lock_t lock(buf_parent_t(&txn), ids[i], access_t::read);
+            buf_read_t read(&lock);
+            sum += *static_cast<const uint8_t *>(read.get_data_read());
+        }
+        guarantee(sum >= 0);
+    }
+
+private:
+    mock_file_opener_t opener_;
+    scoped_ptr_t<standard_serializer_t> serializer_;
+    scoped_ptr_t<cache_t> cache_;
+    scoped_ptr_t<cache_conn_t> conn_;
+};
+
+void run_page_acquire_release_microbench() {
+    microbench_cache_t cache(GIGABYTE);
+    std::vector<block_id_t> ids = cache.create_blocks(1000);
+    rng_t rng(4);
+    std::random_shuffle(ids.begin(), ids.end(),
+                        [&] (int n) { return rng.randint(n); });
+    run_microbench("page acquire and release", ids.size(),
+                   [&] () { cache.read_blocks(ids); });
+}
+
+TEST(Microbench, DISABLED_PageAcquireRelease) {
+    run_in_thread_pool(run_page_acquire_release_microbench);
+}
+
+void run_eviction_microbench() {
+    // Sixteen times as many blocks as fit in memory, so nearly every acquisition
+    // reads a block from the serializer and evicts another.
+    const int num_blocks = 4096;
+    microbench_cache_t cache(num_blocks * 4 * KILOBYTE / 16);
+    std::vector<block_id_t> ids = cache.create_blocks(num_blocks);
+    rng_t rng(5);
+    std::random_shuffle(ids.begin(), ids.end(),
+                        [&] (int n) { return rng.randint(n); });
+    run_microbench("page eviction under pressure", ids.size(),
+                   [&] () { cache.read_blocks(ids); });
+}
+
+TEST(Microbench, DISABLED_EvictionUnderPressure) {
+    run_in_thread_pool(run_eviction_microbench);
+}
+
+TEST(Microbench, DISABLED_LBAIndexUpdate) {
+    const block_id_t num_blocks = 16 * in_memory_index_t::SEGMENT_SIZE;
+    rng_t rng(6);
+    std::vector<block_id_t> ids;
+    for (int i = 0; i < 1000000; ++i) {
+        ids.push_back(rng.randint(num_blocks));
+    }
+    in_memory_index_t index;
+    uint64_t longtime = 1;
+    run_microbench("lba index update", ids.size(), [&] () {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            repli_timestamp_t recency;
+            recency.longtime = longtime++;
+            index.set_block_info(ids[i], recency,
+                                 flagged_off64_t::make(ids[i] * DEVICE_BLOCK_SIZE * 8),
+                                 4096);
+        }
+    });
+}
+
+// A document like the ones a typical table holds.
+counted_t<const ql::datum_t> microbench_document(rng_t *rng) {
+    std::map<std::string, counted_t<const ql::datum_t> > fields;
+    fields["id"] = make_counted<const ql::datum_t>(
+        strprintf("%08x-%04x", rng->randint(1 << 30), rng->randint(1 << 16)));
+    fields["name"] = make_counted<const ql::datum_t>(std::string(20, 'n'));
+    fields["count"] = make_counted<const ql::datum_t>(
+        static_cast<double>(rng->randint(1000000)));
+    fields["score"] = make_counted<const ql::datum_t>(rng->randdouble());
+    fields["active"] = make_counted<const ql::datum_t>(ql::datum_t::R_BOOL, true);
+    std::vector<counted_t<const ql::datum_t> > tags;
+    for (int i = 0; i < 5; ++i) {
+        tags.push_back(make_counted<const ql::datum_t>(strprintf("tag%d", i)));
+    }
+    fields["tags"] = make_counted<const ql::datum_t>(std::move(tags));
+    return make_counted<const ql::datum_t>(std::move(fields));
+}
+
+TEST(Microbench, DISABLED_DatumSerialization) {
+    rng_t rng(7);
+    std::vector<counted_t<const ql::datum_t> > documents;
+    for (int i = 0; i < 1000; ++i) {
+        documents.push_back(microbench_document(&rng));
+    }
+
+    std::vector<std::string> serialized(documents.size());
+    run_microbench("datum serialize", documents.size(), [&] () {
+        for (size_t i = 0; i < documents.size(); ++i) {
+            string_stream_t stream;
+            write_message_t wm;
+            wm << documents[i];
+            int res = send_write_message(&stream, &wm);
+            guarantee(res == 0);
+            serialized[i] = std::move(stream.str());
+        }
+    });
+
+    run_microbench("datum deserialize", documents.size(), [&] () {
+        for (size_t i = 0; i < serialized.size(); ++i) {
+            string_read_stream_t stream(std::string(serialized[i]), 0);
+            counted_t<const ql::datum_t> datum;
+            archive_result_t res = deserialize(&stream, &datum);
+            guarantee_deserialization(res, "microbench datum");
+        }
+    });
+}
+
+}  // namespace unittest
@@ -0,0 +1,39 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/term_cache.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+static const ql::pb::dummy_var_t x = ql::pb::dummy_var_t::INNERJOIN_N;
+static const ql::pb::dummy_var_t y = ql::pb::dummy_var_t::INNERJOIN_M;
+
+std::string key_of(ql::r::reql_t &&query) {
+    std::string key;
+    EXPECT_TRUE(ql::term_cache_t::compute_key(query.get(), &key));
+    return key;
+}
+
+TEST(TermCacheTest, VariablesAreRenumbered) {
+    std::string xy = key_of(ql::r::fun(x, y, ql::r::var(x) + ql::r::var(y)));
+    std::string yx = key_of(ql::r::fun(y, x, ql::r::var(y) + ql::r::var(x)));
+    EXPECT_EQ(xy, yx);
+
+    // But which variable is used where still matters.
+    EXPECT_NE(xy, key_of(ql::r::fun(x, y, ql::r::var(y) + ql::r::var(x))));
+    // And so do literals.
+    EXPECT_NE(key_of(ql::r::fun(x, ql::r::var(x) + ql::r::expr(1.0))),
+              key_of(ql::r::fun(x, ql::r::var(x) + ql::r::expr(2.0))));
+}
+
+TEST(TermCacheTest, ShadowedVariablesAreKept) {
+    // `x` is declared twice, so the query is keyed as it is.
+    ql::r::reql_t shadowed = ql::r::fun(x, ql::r::fun(x, ql::r::var(x)));
+    std::string key;
+    ASSERT_TRUE(ql::term_cache_t::compute_key(shadowed.get(), &key));
+    EXPECT_EQ(shadowed.get().SerializeAsString(), key);
+}
+
+}  // namespace unittest
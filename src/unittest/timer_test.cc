@@ -3,6 +3,7 @@
 
 #include "arch/timing.hpp"
 #include "concurrency/pmap.hpp"
+#include "containers/scoped.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "utils.hpp"
 
@@ -33,6 +34,46 @@ TEST(TimerTest, TestApproximateWaitTimes) {
     unittest::run_in_thread_pool(run_TestApproximateWaitTimes);
 }
 
+void coarse_wait(int64_t ms) {
+    const ticks_t start = get_ticks();
+    signal_timer_t timer;
+    timer.start(ms, COARSE_TIMER);
+    timer.wait_lazily_unordered();
+    const int64_t diff = static_cast<int64_t>(get_ticks()) - static_cast<int64_t>(start);
+    // Coarse timers never ring early, and at most one wheel tick late.
+    ASSERT_GE(diff, ms * MILLION);
+    ASSERT_LT(diff, (ms + TIMER_WHEEL_TICK_MS + 2) * MILLION);
+}
+
+void run_TestCoarseWaitTimes() {
+    // The longer ones have to move down the levels of the wheel.
+    const int64_t waits[] = { 1, 7, 15, 90, 700, 1300 };
+    pmap(sizeof(waits) / sizeof(waits[0]), [&](int i) { coarse_wait(waits[i]); });
+}
+
+TEST(TimerTest, TestCoarseWaitTimes) {
+    unittest::run_in_thread_pool(run_TestCoarseWaitTimes);
+}
+
+void run_TestCancelManyCoarseTimers() {
+    const int num_timers = 10000;
+    scoped_array_t<signal_timer_t> timers(num_timers);
+    for (int i = 0; i < num_timers; ++i) {
+        timers[i].start(10 + i % 200, COARSE_TIMER);
+    }
+    for (int i = 0; i < num_timers; i += 2) {
+        ASSERT_TRUE(timers[i].cancel());
+    }
+    nap(250);
+    for (int i = 0; i < num_timers; ++i) {
+        ASSERT_EQ(i % 2 == 1, timers[i].is_pulsed());
+    }
+}
+
+TEST(TimerTest, TestCancelManyCoarseTimers) {
+    unittest::run_in_thread_pool(run_TestCancelManyCoarseTimers);
+}
+
 
 
 
@@ -0,0 +1,140 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdio.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <string>
+
+#include "arch/io/network.hpp"
+#include "arch/io/tls.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Writes a new self-signed certificate and its key to the given files.
+void make_self_signed_certificate(const std::string &cert_file,
+                                  const std::string &key_file) {
+    EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    ASSERT_TRUE(kctx != NULL);
+    EVP_PKEY *key = NULL;
+    ASSERT_EQ(1, EVP_PKEY_keygen_init(kctx));
+    ASSERT_EQ(1, EVP_PKEY_CTX_set_rsa_keygen_bits(kctx, 2048));
+    ASSERT_EQ(1, EVP_PKEY_keygen(kctx, &key));
+    EVP_PKEY_CTX_free(kctx);
+
+    X509 *cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert), 24 * 60 * 60);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>("rethinkdb"),
+                               -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    ASSERT_NE(0, X509_sign(cert, key, EVP_sha256()));
+
+    FILE *f = fopen(cert_file.c_str(), "w");
+    ASSERT_TRUE(f != NULL);
+    ASSERT_EQ(1, PEM_write_X509(f, cert));
+    fclose(f);
+    f = fopen(key_file.c_str(), "w");
+    ASSERT_TRUE(f != NULL);
+    ASSERT_EQ(1, PEM_write_PrivateKey(f, key, NULL, NULL, 0, NULL, NULL));
+    fclose(f);
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+}
+
+std::string make_payload(size_t size) {
+    std::string s(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        s[i] = 'a' + i % 26;
+    }
+    return s;
+}
+
+// Reads a request size, then sends back a payload of that size.
+void serve_echo(tls_ctx_t *ctx, scoped_ptr_t<linux_tcp_conn_descriptor_t> &nconn) {
+    scoped_ptr_t<linux_tcp_conn_t> conn;
+    nconn->make_overcomplicated(&conn);
+    cond_t never;
+    try {
+        conn->start_tls(ctx, true, &never);
+        uint64_t size;
+        conn->read(&size, sizeof(size), &never);
+        std::string payload = make_payload(size);
+        conn->write(payload.data(), payload.size(), &never);
+    } catch (const tcp_conn_read_closed_exc_t &) {
+    } catch (const tcp_conn_write_closed_exc_t &) {
+    }
+}
+
+class tls_test_files_t {
+public:
+    tls_test_files_t() {
+        make_self_signed_certificate(cert.name().permanent_path(),
+                                     key.name().permanent_path());
+    }
+    std::string cert_file() const { return cert.name().permanent_path(); }
+    std::string key_file() const { return key.name().permanent_path(); }
+private:
+    temp_file_t cert, key;
+};
+
+void run_round_trip_test() {
+    tls_test_files_t files;
+    tls_ctx_t server_ctx(files.cert_file(), files.key_file(), "");
+    // The client trusts the server's certificate because it's its own CA.
+    tls_ctx_t client_ctx(files.cert_file(), files.key_file(), files.cert_file());
+
+    linux_tcp_listener_t listener(get_unittest_addresses(), 0,
+                                  std::bind(&serve_echo, &server_ctx,
+                                            std::placeholders::_1));
+
+    cond_t never;
+    linux_tcp_conn_t conn(ip_address_t("127.0.0.1"), listener.get_port(), &never);
+    conn.start_tls(&client_ctx, false, &never);
+    ASSERT_TRUE(conn.is_tls());
+
+    // Big enough to need many records and partial writes.
+    const uint64_t size = 3 * MEGABYTE + 17;
+    conn.write(&size, sizeof(size), &never);
+    std::string got(size, '\0');
+    conn.read(&got[0], got.size(), &never);
+    EXPECT_TRUE(got == make_payload(size));
+}
+
+TEST(TLS, RoundTrip) {
+    run_in_thread_pool(&run_round_trip_test);
+}
+
+void run_untrusted_peer_test() {
+    tls_test_files_t server_files, other_files;
+    tls_ctx_t server_ctx(server_files.cert_file(), server_files.key_file(), "");
+    // This client only trusts a different certificate.
+    tls_ctx_t client_ctx(other_files.cert_file(), other_files.key_file(),
+                         other_files.cert_file());
+
+    linux_tcp_listener_t listener(get_unittest_addresses(), 0,
+                                  std::bind(&serve_echo, &server_ctx,
+                                            std::placeholders::_1));
+
+    cond_t never;
+    linux_tcp_conn_t conn(ip_address_t("127.0.0.1"), listener.get_port(), &never);
+    EXPECT_THROW(conn.start_tls(&client_ctx, false, &never), tcp_conn_read_closed_exc_t);
+    EXPECT_FALSE(conn.is_read_open());
+    EXPECT_FALSE(conn.is_write_open());
+}
+
+TEST(TLS, UntrustedPeer) {
+    run_in_thread_pool(&run_untrusted_peer_test);
+}
+
+}  // namespace unittest
@@ -1,6 +1,8 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include <arpa/inet.h>
 
+#include <set>
+
 #include "containers/uuid.hpp"
 #include "unittest/gtest.hpp"
 
@@ -61,6 +63,30 @@ TEST(UuidTest, StrToUuid) {
     ASSERT_FALSE(failure);
 }
 
+TEST(UuidTest, GenerateUuid) {
+    // Enough of them to go through a few batches of random bytes.
+    std::set<uuid_u> uuids;
+    for (int i = 0; i < 1000; ++i) {
+        uuid_u x = generate_uuid();
+        EXPECT_EQ(0x40, x.data()[6] & 0xf0);
+        EXPECT_EQ(0x80, x.data()[8] & 0xc0);
+        EXPECT_TRUE(uuids.insert(x).second);
+    }
+}
+
+TEST(UuidTest, GenerateTimeOrderedUuid) {
+    uuid_u last = generate_time_ordered_uuid();
+    for (int i = 0; i < 10000; ++i) {
+        uuid_u x = generate_time_ordered_uuid();
+        EXPECT_EQ(0x70, x.data()[6] & 0xf0);
+        EXPECT_EQ(0x80, x.data()[8] & 0xc0);
+        EXPECT_LT(last, x);
+        // Their strings, which are what primary keys are, are in the same order.
+        EXPECT_LT(uuid_to_str(last), uuid_to_str(x));
+        last = x;
+    }
+}
+
 void check_sha(const std::string &str, uint32_t expected[5]) {
     union {
         uint8_t hash[24];
@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+
+#include "arch/runtime/work_stealing.hpp"
+#include "arch/timing.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+struct stealable_counter_t {
+    stealable_counter_t() : count(0), on_spawning_thread(0) { }
+    void run(threadnum_t spawning_thread) {
+        if (get_thread_id() == spawning_thread) {
+            __sync_fetch_and_add(&on_spawning_thread, 1);
+        }
+        __sync_fetch_and_add(&count, 1);
+    }
+    volatile int count;
+    volatile int on_spawning_thread;
+};
+
+void run_idle_threads_steal_test() {
+    const int num_actions = 100;
+    stealable_counter_t counter;
+    for (int i = 0; i < num_actions; ++i) {
+        spawn_stealable(std::bind(&stealable_counter_t::run, &counter, get_thread_id()));
+    }
+
+    // This thread is too busy to run the actions, so other threads must take them.
+    const ticks_t deadline = get_ticks() + secs_to_ticks(10);
+    while (counter.count < num_actions && get_ticks() < deadline) { }
+    EXPECT_EQ(num_actions, counter.count);
+    EXPECT_EQ(0, counter.on_spawning_thread);
+
+    // Let our own queue notice that it's empty.
+    let_stuff_happen();
+}
+
+TEST(WorkStealing, IdleThreadsSteal) {
+    run_in_thread_pool(&run_idle_threads_steal_test, 3);
+}
+
+void run_runs_without_thieves_test() {
+    // With one db thread, there's nobody to steal from us.
+    const int num_actions = 100;
+    stealable_counter_t counter;
+    for (int i = 0; i < num_actions; ++i) {
+        spawn_stealable(std::bind(&stealable_counter_t::run, &counter, get_thread_id()));
+    }
+    const ticks_t deadline = get_ticks() + secs_to_ticks(10);
+    while (counter.count < num_actions && get_ticks() < deadline) {
+        nap(1);
+    }
+    EXPECT_EQ(num_actions, counter.count);
+    EXPECT_EQ(num_actions, counter.on_spawning_thread);
+}
+
+TEST(WorkStealing, RunsWithoutThieves) {
+    run_in_thread_pool(&run_runs_without_thieves_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,166 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "arch/io/disk/write_combining.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+struct submitted_write_t {
+    int64_t offset;
+    size_t length;
+    std::vector<char> data;
+    linux_iocallback_t *cb;
+    bool wrap_in_datasyncs;
+};
+
+struct counting_callback_t : public linux_iocallback_t {
+    counting_callback_t() : count(0) { }
+    void on_io_complete() { ++count; }
+    int count;
+};
+
+class write_combiner_tester_t {
+public:
+    write_combiner_tester_t()
+        : combiner([this](int64_t offset, size_t length, const void *buf,
+                          void *, linux_iocallback_t *cb, bool wrap_in_datasyncs) {
+              submitted_write_t w;
+              w.offset = offset;
+              w.length = length;
+              w.data.assign(static_cast<const char *>(buf),
+                            static_cast<const char *>(buf) + length);
+              w.cb = cb;
+              w.wrap_in_datasyncs = wrap_in_datasyncs;
+              submitted.push_back(w);
+          }) { }
+
+    ~write_combiner_tester_t() {
+        complete_all();
+    }
+
+    void complete(size_t i) {
+        linux_iocallback_t *cb = submitted[i].cb;
+        submitted[i].cb = NULL;
+        cb->on_io_complete();
+    }
+
+    void complete_all() {
+        for (size_t i = 0; i < submitted.size(); ++i) {
+            if (submitted[i].cb != NULL && !submitted[i].wrap_in_datasyncs) {
+                complete(i);
+            }
+        }
+    }
+
+    std::vector<submitted_write_t> submitted;
+    write_combiner_t combiner;
+};
+
+void run_combines_contiguous_writes_test() {
+    write_combiner_tester_t t;
+    counting_callback_t acks;
+    std::vector<char> block(DEVICE_BLOCK_SIZE);
+
+    for (int i = 0; i < 8; ++i) {
+        memset(block.data(), 'a' + i, block.size());
+        t.combiner.write(i * DEVICE_BLOCK_SIZE, block.size(), block.data(), NULL, &acks);
+    }
+    // We don't wait for the disk, but we don't acknowledge writes before returning
+    // either.
+    EXPECT_EQ(0, acks.count);
+    coro_t::yield();
+    EXPECT_EQ(8, acks.count);
+    EXPECT_TRUE(t.submitted.empty());
+
+    // Not contiguous, so the buffer gets written out.
+    t.combiner.write(100 * DEVICE_BLOCK_SIZE, block.size(), block.data(), NULL, &acks);
+    ASSERT_EQ(1u, t.submitted.size());
+    EXPECT_EQ(0, t.submitted[0].offset);
+    EXPECT_EQ(8u * DEVICE_BLOCK_SIZE, t.submitted[0].length);
+    EXPECT_EQ('a', t.submitted[0].data[0]);
+    EXPECT_EQ('h', t.submitted[0].data[8 * DEVICE_BLOCK_SIZE - 1]);
+
+    // Reading the buffered block writes it out first.
+    t.combiner.before_read(50 * DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE);
+    EXPECT_EQ(1u, t.submitted.size());
+    t.combiner.before_read(100 * DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE);
+    ASSERT_EQ(2u, t.submitted.size());
+    EXPECT_EQ(100 * DEVICE_BLOCK_SIZE, t.submitted[1].offset);
+
+    coro_t::yield();
+    EXPECT_EQ(9, acks.count);
+}
+
+TEST(WriteCombining, CombinesContiguousWrites) {
+    run_in_thread_pool(&run_combines_contiguous_writes_test);
+}
+
+void run_barrier_test() {
+    write_combiner_tester_t t;
+    counting_callback_t acks, barrier_acks;
+    std::vector<char> block(DEVICE_BLOCK_SIZE, 'x');
+
+    t.combiner.write(0, block.size(), block.data(), NULL, &acks);
+    t.combiner.write_barrier(1000 * DEVICE_BLOCK_SIZE, block.size(), block.data(),
+                             NULL, &barrier_acks);
+    // The barrier has flushed the buffer, but waits for the flush.
+    ASSERT_EQ(1u, t.submitted.size());
+    EXPECT_FALSE(t.submitted[0].wrap_in_datasyncs);
+
+    // Writes after the barrier don't hold it up.
+    t.combiner.write(2000 * DEVICE_BLOCK_SIZE, block.size(), block.data(), NULL, &acks);
+    t.combiner.before_read(2000 * DEVICE_BLOCK_SIZE, block.size());
+    ASSERT_EQ(2u, t.submitted.size());
+
+    t.complete(0);
+    ASSERT_EQ(3u, t.submitted.size());
+    EXPECT_TRUE(t.submitted[2].wrap_in_datasyncs);
+    EXPECT_EQ(1000 * DEVICE_BLOCK_SIZE, t.submitted[2].offset);
+
+    t.complete(2);
+    EXPECT_EQ(1, barrier_acks.count);
+    coro_t::yield();
+    EXPECT_EQ(2, acks.count);
+}
+
+TEST(WriteCombining, Barrier) {
+    run_in_thread_pool(&run_barrier_test);
+}
+
+void run_full_buffer_test() {
+    write_combiner_tester_t t;
+    counting_callback_t acks;
+    std::vector<char> chunk(WRITE_COMBINING_BUFFER_SIZE / 2 + DEVICE_BLOCK_SIZE, 'y');
+
+    t.combiner.write(0, chunk.size(), chunk.data(), NULL, &acks);
+    EXPECT_TRUE(t.submitted.empty());
+    t.combiner.write(chunk.size(), chunk.size(), chunk.data(), NULL, &acks);
+    ASSERT_EQ(1u, t.submitted.size());
+    EXPECT_EQ(static_cast<size_t>(WRITE_COMBINING_BUFFER_SIZE), t.submitted[0].length);
+
+    cond_t flushed;
+    coro_t::spawn_sometime([&]() {
+        t.combiner.flush_and_wait();
+        flushed.pulse();
+    });
+    coro_t::yield();
+    ASSERT_EQ(2u, t.submitted.size());
+    EXPECT_EQ(WRITE_COMBINING_BUFFER_SIZE, t.submitted[1].offset);
+    EXPECT_EQ(2u * DEVICE_BLOCK_SIZE, t.submitted[1].length);
+    EXPECT_FALSE(flushed.is_pulsed());
+
+    t.complete_all();
+    flushed.wait();
+}
+
+TEST(WriteCombining, FullBuffer) {
+    run_in_thread_pool(&run_full_buffer_test);
+}
+
+}  // namespace unittest
@@ -249,6 +249,16 @@ with_priority_t::~with_priority_t() {
     coro_t::self()->set_priority(previous_priority);
 }
 
+int latency_class_priority(latency_class_t latency_class) {
+    switch (latency_class) {
+    case LATENCY_CLASS_INTERACTIVE: return CORO_PRIORITY_INTERACTIVE;
+    case LATENCY_CLASS_REPLICATION: return CORO_PRIORITY_REPLICATION;
+    case LATENCY_CLASS_BACKFILL: return CORO_PRIORITY_BACKFILL;
+    case LATENCY_CLASS_GC: return CORO_PRIORITY_GC;
+    default: unreachable();
+    }
+}
+
 microtime_t current_microtime() {
     // This could be done more efficiently, surely.
     struct timeval t;
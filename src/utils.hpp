@@ -314,6 +314,28 @@ private:
     int previous_priority;
 };
 
+/* A latency class says how urgently work has to be done, independently of what it
+ is. Interactive queries go before replication, which goes before backfills and
+ garbage collection; see the `CORO_PRIORITY_*` values in config/args.hpp.
+ `with_latency_class_t` is a `with_priority_t` for the priority of a class. */
+
+enum latency_class_t {
+    LATENCY_CLASS_INTERACTIVE,
+    LATENCY_CLASS_REPLICATION,
+    LATENCY_CLASS_BACKFILL,
+    LATENCY_CLASS_GC
+};
+
+int latency_class_priority(latency_class_t latency_class);
+
+class with_latency_class_t {
+public:
+    explicit with_latency_class_t(latency_class_t latency_class)
+        : priority(latency_class_priority(latency_class)) { }
+private:
+    with_priority_t priority;
+};
+
 
 template <class InputIterator, class UnaryPredicate>
 bool all_match_predicate(InputIterator begin, InputIterator end, UnaryPredicate f) {
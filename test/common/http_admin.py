@@ -519,7 +519,7 @@ class ClusterAccess(object):
         self.do_query("POST", "/ajax/semilattice/%s_namespaces/%s/ack_expectations" % (namespace.protocol, namespace.uuid), ae_dict)
         self.update_cluster_data(10)
 
-    def add_namespace(self, protocol = "memcached", name = None, port = None, primary = None, affinities = { }, ack_expectations = { }, primary_key = None, database = None, check = False):
+    def add_namespace(self, protocol = "memcached", name = None, port = None, primary = None, affinities = { }, ack_expectations = { }, primary_key = None, database = None, cpu_shards = None, check = False):
         assert protocol in ["dummy", "memcached", "rdb"]
         if port is None:
             port = random.randint(10000, 20000)
@@ -556,8 +556,11 @@ class ClusterAccess(object):
             # server doesn't support setting the primary key.
             # data_to_post["primary_key"] = primary_key
             assert primary_key == "id"
+            if cpu_shards is not None:
+                data_to_post["cpu_shards"] = cpu_shards
         else:
             assert primary_key is None
+            assert cpu_shards is None
         info = self.do_query("POST", "/ajax/semilattice/%s_namespaces/new" % protocol, data_to_post)
         assert len(info) == 1
         uuid, json_data = next(info.iteritems())